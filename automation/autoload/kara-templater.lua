@@ -36,11 +36,17 @@ local tr = aegisub.gettext
 script_name = tr"Karaoke Templater"
 script_description = tr"Macro and export filter to apply karaoke effects using the template language"
 script_author = "Niels Martin Hansen"
-script_version = "2.1.7"
+script_version = "2.2.0"
 
 
 include("karaskel.lua")
 
+local template_impl = require("aegisub.__karaoke_template_impl")
+
+-- Parsed text templates for the current run, keyed by the template text, so
+-- that each template is only parsed and its expressions compiled once
+local parsed_templates = {}
+
 
 -- Find and parse/prepare all karaoke template lines
 function parse_templates(meta, styles, subs)
@@ -299,6 +305,7 @@ function apply_templates(meta, styles, subs, templates)
 		_G = _G
 	}
 	tenv.tenv = tenv
+	parsed_templates = {}
 
 	-- Define helper functions in tenv
 
@@ -649,49 +656,73 @@ function run_code_template(template, tenv)
 	end
 end
 
-function run_text_template(template, tenv, varctx)
-	local res = template
-	aegisub.debug.out(5, "Running text template '%s'\n", res)
-
-	-- Replace the variables in the string (this is probably faster than using a custom function, but doesn't provide error reporting)
-	if varctx then
-		aegisub.debug.out(5, "Has varctx, replacing variables\n")
-		local function var_replacer(varname)
-			varname = string.lower(varname)
-			aegisub.debug.out(5, "Found variable named '%s', ", varname)
-			if varctx[varname] ~= nil then
-				aegisub.debug.out(5, "it exists, value is '%s'\n", varctx[varname])
-				return varctx[varname]
-			else
-				aegisub.debug.out(5, "doesn't exist\n")
-				aegisub.debug.out(2, "Unknown variable name: %s\nIn karaoke template: %s\n\n", varname, template)
-				return "$" .. varname
-			end
-		end
-		res = string.gsub(res, "$([%a_]+)", var_replacer)
-		aegisub.debug.out(5, "Done replacing variables, new template string is '%s'\n", res)
+local function compile_expression(code, tenv, template)
+	local f, err = loadstring(string.format("return (%s)", code))
+	if not f then
+		aegisub.debug.out(2, "Error parsing expression: %s\nExpression producing error: %s\nTemplate with expression: %s\n\n", err, code, template)
+		aegisub.cancel()
 	end
+	setfenv(f, tenv)
+	return f
+end
 
-	-- Function for evaluating expressions
-	local function expression_evaluator(expression)
-		f, err = loadstring(string.format("return (%s)", expression))
-		if (err) ~= nil then
-			aegisub.debug.out(2, "Error parsing expression: %s\nExpression producing error: %s\nTemplate with expression: %s\n\n", err, expression, template)
-			aegisub.cancel()
+local function expand_template(parts, out, tenv, varctx, template)
+	for i = 1, #parts do
+		local part = parts[i]
+		if part.text then
+			out[#out+1] = part.text
+		elseif part.var then
+			-- Without a varctx variables are left as they are
+			if not varctx then
+				out[#out+1] = part.raw
+			elseif varctx[part.var] ~= nil then
+				out[#out+1] = varctx[part.var]
+			else
+				aegisub.debug.out(2, "Unknown variable name: %s\nIn karaoke template: %s\n\n", part.var, template)
+				out[#out+1] = "$" .. part.var
+			end
 		else
-			setfenv(f, tenv)
+			-- Expressions with variables in them are different each time
+			local code, f = part.code, part.func
+			if not f then
+				local code_parts = {}
+				expand_template(part.expr, code_parts, tenv, varctx, template)
+				code = table.concat(code_parts)
+				f = compile_expression(code, tenv, template)
+			end
+
 			local res, val = pcall(f)
-			if res then
-				return val
-			else
-				aegisub.debug.out(2, "Runtime error in template expression: %s\nExpression producing error: %s\nTemplate with expression: %s\n\n", val, expression, template)
+			if not res then
+				aegisub.debug.out(2, "Runtime error in template expression: %s\nExpression producing error: %s\nTemplate with expression: %s\n\n", val, code, template)
 				aegisub.cancel()
 			end
+			-- Like string.gsub, keep the original text if there's no value
+			if val == nil or val == false then
+				out[#out+1] = "!" .. code .. "!"
+			else
+				out[#out+1] = val
+			end
+		end
+	end
+end
+
+function run_text_template(template, tenv, varctx)
+	aegisub.debug.out(5, "Running text template '%s'\n", template)
+
+	local parts = parsed_templates[template]
+	if not parts then
+		parts = template_impl.parse(template)
+		for _, part in ipairs(parts) do
+			if part.code then
+				part.func = compile_expression(part.code, tenv, template)
+			end
 		end
+		parsed_templates[template] = parts
 	end
-	-- Find and evaluate expressions
-	aegisub.debug.out(5, "Now evaluating expressions\n")
-	res = string.gsub(res , "!(.-)!", expression_evaluator)
+
+	local out = {}
+	expand_template(parts, out, tenv, varctx, template)
+	local res = table.concat(out)
 	aegisub.debug.out(5, "After evaluation: %s\nDone handling template\n\n", res)
 
 	return res
@@ -0,0 +1,363 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/font_subset.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// See https://www.microsoft.com/typography/otspec/otff.htm for the format.
+// Everything is big-endian.
+
+namespace {
+/// Thrown internally for fonts which can't be subset
+struct Unsupported { };
+
+struct Table {
+	uint32_t tag;
+	uint32_t offset;
+	uint32_t length;
+};
+
+class Reader {
+	const unsigned char *data;
+	size_t size;
+
+public:
+	Reader(const char *data, size_t size)
+	: data(reinterpret_cast<const unsigned char *>(data)), size(size) { }
+
+	void Check(size_t offset, size_t len) const {
+		if (offset > size || len > size - offset)
+			throw Unsupported();
+	}
+
+	uint16_t U16(size_t offset) const {
+		Check(offset, 2);
+		return static_cast<uint16_t>(data[offset] << 8 | data[offset + 1]);
+	}
+
+	uint32_t U32(size_t offset) const {
+		Check(offset, 4);
+		return
+			static_cast<uint32_t>(data[offset]) << 24 |
+			static_cast<uint32_t>(data[offset + 1]) << 16 |
+			static_cast<uint32_t>(data[offset + 2]) << 8 |
+			static_cast<uint32_t>(data[offset + 3]);
+	}
+};
+
+inline uint32_t tag(const char *str) {
+	return
+		static_cast<uint32_t>(str[0]) << 24 | static_cast<uint32_t>(str[1]) << 16 |
+		static_cast<uint32_t>(str[2]) << 8 | static_cast<uint32_t>(str[3]);
+}
+
+void put16(std::vector<char>& out, size_t offset, uint32_t value) {
+	out[offset] = static_cast<char>(value >> 8);
+	out[offset + 1] = static_cast<char>(value);
+}
+
+void put32(std::vector<char>& out, size_t offset, uint32_t value) {
+	put16(out, offset, value >> 16);
+	put16(out, offset + 2, value & 0xFFFF);
+}
+
+uint32_t checksum(std::vector<char> const& data, size_t offset, size_t length) {
+	Reader r(data.data(), data.size());
+	uint32_t sum = 0;
+	// Tables are padded with zeros to a multiple of four bytes
+	for (size_t i = 0; i < (length + 3) / 4 * 4; i += 4)
+		sum += r.U32(offset + i);
+	return sum;
+}
+
+class Cmap {
+	Reader const& r;
+	std::vector<int> const& characters;
+	/// Glyphs which a used character maps to
+	std::vector<bool>& used;
+	/// Glyphs which any character maps to
+	std::vector<bool>& mapped;
+
+	bool Used(uint32_t c) const {
+		return std::binary_search(begin(characters), end(characters), static_cast<int>(c));
+	}
+
+	void Map(uint32_t c, uint32_t glyph) {
+		if (glyph >= mapped.size()) return;
+		mapped[glyph] = true;
+		if (Used(c))
+			used[glyph] = true;
+	}
+
+	void Format4(size_t offset) {
+		size_t seg_count = r.U16(offset + 6) / 2;
+		size_t ends = offset + 14;
+		size_t starts = ends + seg_count * 2 + 2;
+		size_t deltas = starts + seg_count * 2;
+		size_t range_offsets = deltas + seg_count * 2;
+
+		for (size_t i = 0; i < seg_count; ++i) {
+			uint32_t end = r.U16(ends + i * 2);
+			uint32_t start = r.U16(starts + i * 2);
+			uint16_t delta = r.U16(deltas + i * 2);
+			uint16_t range_offset = r.U16(range_offsets + i * 2);
+			for (uint32_t c = start; c <= end && c != 0xFFFF; ++c) {
+				uint16_t glyph;
+				if (!range_offset)
+					glyph = static_cast<uint16_t>(c + delta);
+				else {
+					glyph = r.U16(range_offsets + i * 2 + range_offset + (c - start) * 2);
+					if (glyph)
+						glyph = static_cast<uint16_t>(glyph + delta);
+				}
+				if (glyph)
+					Map(c, glyph);
+			}
+		}
+	}
+
+	void Format12(size_t offset) {
+		uint32_t groups = r.U32(offset + 12);
+		r.Check(offset + 16, groups * size_t(12));
+		for (uint32_t i = 0; i < groups; ++i) {
+			size_t group = offset + 16 + i * 12;
+			uint32_t start = r.U32(group);
+			uint32_t end = r.U32(group + 4);
+			uint32_t glyph = r.U32(group + 8);
+			if (end < start || end > 0x10FFFF)
+				throw Unsupported();
+			for (uint32_t c = start; c <= end && glyph + (c - start) < mapped.size(); ++c)
+				Map(c, glyph + (c - start));
+		}
+	}
+
+public:
+	Cmap(Reader const& r, std::vector<int> const& characters, std::vector<bool>& used, std::vector<bool>& mapped)
+	: r(r), characters(characters), used(used), mapped(mapped) { }
+
+	void Read(Table const& cmap) {
+		bool found_unicode = false;
+		uint16_t count = r.U16(cmap.offset + 2);
+		for (uint16_t i = 0; i < count; ++i) {
+			size_t record = cmap.offset + 4 + i * 8;
+			uint16_t platform = r.U16(record);
+			uint16_t encoding = r.U16(record + 2);
+			size_t offset = cmap.offset + r.U32(record + 4);
+
+			// Symbol and legacy encodings map codepoints which aren't the
+			// characters in the script
+			if (platform != 0 && !(platform == 3 && (encoding == 1 || encoding == 10)))
+				continue;
+
+			switch (r.U16(offset)) {
+				case 4: Format4(offset); found_unicode = true; break;
+				case 12: Format12(offset); found_unicode = true; break;
+				default: break;
+			}
+		}
+		if (!found_unicode)
+			throw Unsupported();
+	}
+};
+
+/// Keep the components of every composite glyph which is being kept
+void add_components(Reader const& r, Table const& glyf, std::vector<uint32_t> const& loca, std::vector<bool>& keep) {
+	std::vector<uint32_t> pending;
+	for (uint32_t glyph = 0; glyph < keep.size(); ++glyph) {
+		if (keep[glyph])
+			pending.push_back(glyph);
+	}
+
+	while (!pending.empty()) {
+		uint32_t glyph = pending.back();
+		pending.pop_back();
+		if (loca[glyph + 1] <= loca[glyph]) continue;
+
+		size_t offset = glyf.offset + loca[glyph];
+		if (static_cast<int16_t>(r.U16(offset)) >= 0) continue;
+
+		enum {
+			ARG_1_AND_2_ARE_WORDS = 0x1,
+			WE_HAVE_A_SCALE = 0x8,
+			MORE_COMPONENTS = 0x20,
+			WE_HAVE_AN_X_AND_Y_SCALE = 0x40,
+			WE_HAVE_A_TWO_BY_TWO = 0x80
+		};
+
+		uint16_t flags;
+		offset += 10;
+		do {
+			flags = r.U16(offset);
+			uint16_t component = r.U16(offset + 2);
+			if (component >= keep.size())
+				throw Unsupported();
+			if (!keep[component]) {
+				keep[component] = true;
+				pending.push_back(component);
+			}
+
+			offset += 4 + (flags & ARG_1_AND_2_ARE_WORDS ? 4 : 2);
+			if (flags & WE_HAVE_A_SCALE)
+				offset += 2;
+			else if (flags & WE_HAVE_AN_X_AND_Y_SCALE)
+				offset += 4;
+			else if (flags & WE_HAVE_A_TWO_BY_TWO)
+				offset += 8;
+		} while (flags & MORE_COMPONENTS);
+	}
+}
+
+std::vector<char> subset(const char *data, size_t size, std::vector<int> const& characters) {
+	Reader r(data, size);
+
+	// 'OTTO' is CFF outlines and 'ttcf' is a collection
+	uint32_t version = r.U32(0);
+	if (version != 0x00010000 && version != tag("true"))
+		throw Unsupported();
+
+	Table head{}, maxp{}, loca_table{}, glyf{}, cmap{};
+	std::vector<Table> tables;
+	uint16_t num_tables = r.U16(4);
+	for (uint16_t i = 0; i < num_tables; ++i) {
+		size_t record = 12 + i * 16;
+		Table table{r.U32(record), r.U32(record + 8), r.U32(record + 12)};
+		r.Check(table.offset, table.length);
+
+		// Per-glyph variation data would no longer match the outlines
+		if (table.tag == tag("gvar"))
+			throw Unsupported();
+		// The signature is for the original file
+		if (table.tag == tag("DSIG"))
+			continue;
+
+		if (table.tag == tag("head")) head = table;
+		else if (table.tag == tag("maxp")) maxp = table;
+		else if (table.tag == tag("loca")) loca_table = table;
+		else if (table.tag == tag("glyf")) glyf = table;
+		else if (table.tag == tag("cmap")) cmap = table;
+		tables.push_back(table);
+	}
+	if (!head.tag || !maxp.tag || !loca_table.tag || !glyf.tag || !cmap.tag)
+		throw Unsupported();
+
+	uint16_t num_glyphs = r.U16(maxp.offset + 4);
+	bool long_offsets = r.U16(head.offset + 50) != 0;
+
+	std::vector<uint32_t> loca(num_glyphs + 1);
+	for (size_t i = 0; i <= num_glyphs; ++i)
+		loca[i] = long_offsets ? r.U32(loca_table.offset + i * 4) : r.U16(loca_table.offset + i * 2) * 2u;
+	for (size_t i = 0; i < num_glyphs; ++i) {
+		if (loca[i] > loca[i + 1] || loca[i + 1] > glyf.length)
+			throw Unsupported();
+	}
+
+	std::vector<bool> used(num_glyphs), mapped(num_glyphs);
+	Cmap(r, characters, used, mapped).Read(cmap);
+
+	// Keep everything the cmap doesn't point to, as it may be reached through
+	// GSUB or be a component, and .notdef
+	std::vector<bool> keep(num_glyphs);
+	for (size_t i = 0; i < num_glyphs; ++i)
+		keep[i] = used[i] || !mapped[i];
+	if (num_glyphs)
+		keep[0] = true;
+	add_components(r, glyf, loca, keep);
+
+	// Build the new glyf and loca tables, with dropped glyphs being empty
+	std::string new_glyf;
+	std::vector<uint32_t> new_loca(num_glyphs + 1);
+	for (size_t i = 0; i < num_glyphs; ++i) {
+		new_loca[i] = new_glyf.size();
+		if (keep[i]) {
+			new_glyf.append(data + glyf.offset + loca[i], loca[i + 1] - loca[i]);
+			new_glyf.resize((new_glyf.size() + 3) & ~3);
+		}
+	}
+	new_loca[num_glyphs] = new_glyf.size();
+
+	std::string loca_data;
+	for (auto offset : new_loca) {
+		if (long_offsets) {
+			loca_data += static_cast<char>(offset >> 24);
+			loca_data += static_cast<char>(offset >> 16);
+		}
+		else
+			offset /= 2;
+		loca_data += static_cast<char>(offset >> 8);
+		loca_data += static_cast<char>(offset);
+	}
+
+	// Write the file back out with the tables in their original order
+	size_t header_size = 12 + tables.size() * 16;
+	std::vector<char> out(header_size);
+	std::copy(data, data + 4, out.begin());
+	uint16_t entry_selector = 0;
+	while ((2u << entry_selector) <= tables.size())
+		++entry_selector;
+	put16(out, 4, tables.size());
+	put16(out, 6, 16 << entry_selector);
+	put16(out, 8, entry_selector);
+	put16(out, 10, tables.size() * 16 - (16 << entry_selector));
+
+	size_t head_offset = 0;
+	for (size_t i = 0; i < tables.size(); ++i) {
+		auto const& table = tables[i];
+		const char *begin = data + table.offset;
+		size_t length = table.length;
+		if (table.tag == glyf.tag) {
+			begin = new_glyf.data();
+			length = new_glyf.size();
+		}
+		else if (table.tag == loca_table.tag) {
+			begin = loca_data.data();
+			length = loca_data.size();
+		}
+
+		size_t offset = out.size();
+		out.insert(out.end(), begin, begin + length);
+		out.resize((out.size() + 3) & ~3);
+
+		if (table.tag == head.tag) {
+			head_offset = offset;
+			put32(out, offset + 8, 0);
+		}
+
+		size_t record = 12 + i * 16;
+		put32(out, record, table.tag);
+		put32(out, record + 4, checksum(out, offset, length));
+		put32(out, record + 8, offset);
+		put32(out, record + 12, length);
+	}
+
+	put32(out, head_offset + 8, 0xB1B0AFBA - checksum(out, 0, out.size()));
+	return out;
+}
+}
+
+namespace agi { namespace ass {
+std::vector<char> SubsetFont(const char *data, size_t size, std::vector<int> const& characters) {
+	try {
+		return subset(data, size, characters);
+	}
+	catch (Unsupported const&) {
+		return std::vector<char>();
+	}
+}
+} }
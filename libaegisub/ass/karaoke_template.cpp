@@ -0,0 +1,106 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/ass/karaoke_template.h"
+
+namespace {
+using agi::ass::TemplatePart;
+
+bool is_name_char(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+void add_text(std::vector<TemplatePart> &parts, std::string const& text) {
+	if (text.empty()) return;
+	if (!parts.empty() && parts.back().type == TemplatePart::TEXT)
+		parts.back().text += text;
+	else
+		parts.push_back(TemplatePart{TemplatePart::TEXT, text, "", {}});
+}
+
+void add_part(std::vector<TemplatePart> &parts, TemplatePart part) {
+	if (part.type == TemplatePart::TEXT)
+		add_text(parts, part.text);
+	else
+		parts.push_back(std::move(part));
+}
+}
+
+namespace agi { namespace ass {
+std::vector<TemplatePart> ParseTemplate(std::string const& text) {
+	// Split out the variables first, as they're replaced before looking for
+	// expressions
+	std::vector<TemplatePart> tokens;
+	for (size_t i = 0; i < text.size(); ) {
+		size_t dollar = text.find('$', i);
+		if (dollar == std::string::npos) {
+			add_text(tokens, text.substr(i));
+			break;
+		}
+
+		size_t end = dollar + 1;
+		while (end < text.size() && is_name_char(text[end])) ++end;
+		if (end == dollar + 1) {
+			add_text(tokens, text.substr(i, end - i));
+			i = end;
+			continue;
+		}
+
+		add_text(tokens, text.substr(i, dollar - i));
+		std::string name = text.substr(dollar + 1, end - dollar - 1);
+		std::string lower = name;
+		for (auto& c : lower) {
+			if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+		}
+		tokens.push_back(TemplatePart{TemplatePart::VARIABLE, std::move(name), std::move(lower), {}});
+		i = end;
+	}
+
+	std::vector<TemplatePart> parts;
+	// The parts of the expression currently being read, if any
+	std::vector<TemplatePart> expression;
+	bool in_expression = false;
+	for (auto& token : tokens) {
+		if (token.type != TemplatePart::TEXT) {
+			add_part(in_expression ? expression : parts, std::move(token));
+			continue;
+		}
+
+		size_t start = 0;
+		for (size_t bang; (bang = token.text.find('!', start)) != std::string::npos; start = bang + 1) {
+			std::string before = token.text.substr(start, bang - start);
+			if (in_expression) {
+				add_text(expression, before);
+				parts.push_back(TemplatePart{TemplatePart::EXPRESSION, "", "", std::move(expression)});
+				expression.clear();
+			}
+			else
+				add_text(parts, before);
+			in_expression = !in_expression;
+		}
+		add_text(in_expression ? expression : parts, token.text.substr(start));
+	}
+
+	// An unpaired ! doesn't start an expression
+	if (in_expression) {
+		add_text(parts, "!");
+		for (auto& part : expression)
+			add_part(parts, std::move(part));
+	}
+
+	return parts;
+}
+} }
@@ -0,0 +1,82 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/ass/overlaps.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+struct Point {
+	int time;
+	size_t line;
+	bool start;
+};
+}
+
+namespace agi { namespace ass {
+std::vector<OverlapPiece> SplitOverlaps(std::vector<int> const& starts, std::vector<int> const& ends) {
+	std::vector<Point> points;
+	std::vector<size_t> instants;
+	points.reserve(starts.size() * 2);
+	for (size_t i = 0; i < starts.size(); ++i) {
+		if (ends[i] > starts[i]) {
+			points.push_back(Point{starts[i], i, true});
+			points.push_back(Point{ends[i], i, false});
+		}
+		else
+			instants.push_back(i);
+	}
+
+	std::sort(begin(points), end(points), [](Point const& a, Point const& b) {
+		return a.time < b.time;
+	});
+	std::stable_sort(begin(instants), end(instants), [&](size_t a, size_t b) {
+		return starts[a] < starts[b];
+	});
+
+	std::vector<OverlapPiece> pieces;
+	auto instant = begin(instants);
+	auto add_instants = [&](int until) {
+		for (; instant != end(instants) && starts[*instant] <= until; ++instant)
+			pieces.push_back(OverlapPiece{starts[*instant], ends[*instant], {*instant}});
+	};
+
+	// Kept sorted; a vector is much faster to copy into each piece than a set
+	// and there are rarely enough lines visible at once for the linear
+	// insertions to matter
+	std::vector<size_t> visible;
+	for (size_t i = 0; i < points.size(); ) {
+		const int time = points[i].time;
+		add_instants(time);
+
+		for (; i < points.size() && points[i].time == time; ++i) {
+			auto pos = std::lower_bound(begin(visible), end(visible), points[i].line);
+			if (points[i].start)
+				visible.insert(pos, points[i].line);
+			else
+				visible.erase(pos);
+		}
+
+		// Every visible line ends somewhere, so there's always a next point
+		if (!visible.empty())
+			pieces.push_back(OverlapPiece{time, points[i].time, visible});
+	}
+	add_instants(std::numeric_limits<int>::max());
+
+	return pieces;
+}
+} }
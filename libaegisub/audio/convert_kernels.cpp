@@ -0,0 +1,267 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "convert_kernels.h"
+
+#include "libaegisub/simd.h"
+
+namespace {
+template<typename Float>
+inline int16_t FloatSample(Float v) {
+	Float expanded = v < 0 ? v * 32768 : v * 32767;
+	// Written so that NaN ends up as the minimum, as it does with SSE
+	if (!(expanded > -32768)) return -32768;
+	if (expanded >= 32767) return 32767;
+	return static_cast<int16_t>(expanded);
+}
+
+/// Divide by two, rounding towards zero
+inline int32_t Halve(int32_t v) {
+	return v / 2;
+}
+
+/// Clamping before the conversion rather than after gives the same result
+/// and can't overflow the int for large volumes
+inline int16_t ScaleSample(int16_t v, double volume) {
+	double scaled = v * volume + 0.5;
+	if (scaled < -32768) return -32768;
+	if (scaled >= 32767) return 32767;
+	return static_cast<int16_t>(scaled);
+}
+
+#ifdef AGI_SSE2
+inline __m128i ConvertFloat4(__m128 x) {
+	const __m128 neg = _mm_cmplt_ps(x, _mm_setzero_ps());
+	const __m128 scale = _mm_or_ps(_mm_and_ps(neg, _mm_set1_ps(32768.f)), _mm_andnot_ps(neg, _mm_set1_ps(32767.f)));
+	x = _mm_max_ps(_mm_mul_ps(x, scale), _mm_set1_ps(-32768.f));
+	return _mm_cvttps_epi32(_mm_min_ps(x, _mm_set1_ps(32767.f)));
+}
+
+inline __m128i ConvertDouble2(__m128d x) {
+	const __m128d neg = _mm_cmplt_pd(x, _mm_setzero_pd());
+	const __m128d scale = _mm_or_pd(_mm_and_pd(neg, _mm_set1_pd(32768.)), _mm_andnot_pd(neg, _mm_set1_pd(32767.)));
+	x = _mm_max_pd(_mm_mul_pd(x, scale), _mm_set1_pd(-32768.));
+	return _mm_cvttpd_epi32(_mm_min_pd(x, _mm_set1_pd(32767.)));
+}
+
+inline __m128i ScaleDouble2(__m128d x, __m128d volume) {
+	x = _mm_add_pd(_mm_mul_pd(x, volume), _mm_set1_pd(0.5));
+	x = _mm_max_pd(x, _mm_set1_pd(-32768.));
+	return _mm_cvttpd_epi32(_mm_min_pd(x, _mm_set1_pd(32767.)));
+}
+
+/// Scale four 32-bit samples, two at a time as doubles so that the rounding
+/// matches ScaleSample exactly
+inline __m128i Scale4(__m128i v, __m128d volume) {
+	const __m128i lo = ScaleDouble2(_mm_cvtepi32_pd(v), volume);
+	const __m128i hi = ScaleDouble2(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)), volume);
+	return _mm_unpacklo_epi64(lo, hi);
+}
+
+inline __m128i Halve(__m128i v) {
+	return _mm_srai_epi32(_mm_add_epi32(v, _mm_srli_epi32(v, 31)), 1);
+}
+
+/// Sign-extend the low or high four samples to 32 bits
+inline __m128i WidenLow(__m128i v) { return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16); }
+inline __m128i WidenHigh(__m128i v) { return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16); }
+#endif
+
+#ifdef AGI_NEON
+inline int32x4_t ConvertFloat4(float32x4_t x) {
+	const float32x4_t scale = vbslq_f32(vcltq_f32(x, vdupq_n_f32(0.f)), vdupq_n_f32(32768.f), vdupq_n_f32(32767.f));
+	x = vmaxnmq_f32(vmulq_f32(x, scale), vdupq_n_f32(-32768.f));
+	return vcvtq_s32_f32(vminq_f32(x, vdupq_n_f32(32767.f)));
+}
+
+inline int32x4_t ConvertDouble4(const double *src) {
+	int64x2_t r[2];
+	for (int i = 0; i < 2; ++i) {
+		float64x2_t x = vld1q_f64(src + i * 2);
+		const float64x2_t scale = vbslq_f64(vcltq_f64(x, vdupq_n_f64(0.)), vdupq_n_f64(32768.), vdupq_n_f64(32767.));
+		x = vmaxnmq_f64(vmulq_f64(x, scale), vdupq_n_f64(-32768.));
+		r[i] = vcvtq_s64_f64(vminq_f64(x, vdupq_n_f64(32767.)));
+	}
+	return vcombine_s32(vmovn_s64(r[0]), vmovn_s64(r[1]));
+}
+
+inline int64x2_t ScaleDouble2(int32x2_t v, float64x2_t volume) {
+	float64x2_t x = vaddq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(v)), volume), vdupq_n_f64(0.5));
+	x = vmaxq_f64(x, vdupq_n_f64(-32768.));
+	return vcvtq_s64_f64(vminq_f64(x, vdupq_n_f64(32767.)));
+}
+
+/// Scale four samples as doubles so that the rounding matches ScaleSample
+inline int16x4_t Scale4(int16x4_t v, float64x2_t volume) {
+	const int32x4_t wide = vmovl_s16(v);
+	const int64x2_t lo = ScaleDouble2(vget_low_s32(wide), volume);
+	const int64x2_t hi = ScaleDouble2(vget_high_s32(wide), volume);
+	return vmovn_s32(vcombine_s32(vmovn_s64(lo), vmovn_s64(hi)));
+}
+
+/// Halve and narrow to 16 bits
+inline int16x4_t HalveNarrow(int32x4_t v) {
+	return vshrn_n_s32(vaddq_s32(v, vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(v), 31))), 1);
+}
+#endif
+}
+
+namespace agi { namespace audio_convert {
+void FloatToInt16(const float *src, int16_t *dst, size_t count) {
+	size_t i = 0;
+#if defined(AGI_SSE2)
+	for (; i + 8 <= count; i += 8) {
+		const __m128i lo = ConvertFloat4(_mm_loadu_ps(src + i));
+		const __m128i hi = ConvertFloat4(_mm_loadu_ps(src + i + 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+	}
+#elif defined(AGI_NEON)
+	for (; i + 8 <= count; i += 8) {
+		const int32x4_t lo = ConvertFloat4(vld1q_f32(src + i));
+		const int32x4_t hi = ConvertFloat4(vld1q_f32(src + i + 4));
+		vst1q_s16(dst + i, vcombine_s16(vmovn_s32(lo), vmovn_s32(hi)));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = FloatSample(src[i]);
+}
+
+void FloatToInt16(const double *src, int16_t *dst, size_t count) {
+	size_t i = 0;
+#if defined(AGI_SSE2)
+	for (; i + 8 <= count; i += 8) {
+		const __m128i a = _mm_unpacklo_epi64(ConvertDouble2(_mm_loadu_pd(src + i)), ConvertDouble2(_mm_loadu_pd(src + i + 2)));
+		const __m128i b = _mm_unpacklo_epi64(ConvertDouble2(_mm_loadu_pd(src + i + 4)), ConvertDouble2(_mm_loadu_pd(src + i + 6)));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(a, b));
+	}
+#elif defined(AGI_NEON)
+	for (; i + 8 <= count; i += 8)
+		vst1q_s16(dst + i, vcombine_s16(vmovn_s32(ConvertDouble4(src + i)), vmovn_s32(ConvertDouble4(src + i + 4))));
+#endif
+	for (; i < count; ++i)
+		dst[i] = FloatSample(src[i]);
+}
+
+void Int24ToInt16(const uint8_t *src, int16_t *dst, size_t count) {
+	for (size_t i = 0; i < count; ++i, src += 3)
+		dst[i] = static_cast<int16_t>(src[1] | src[2] << 8);
+}
+
+void Int32ToInt16(const uint8_t *src, int16_t *dst, size_t count) {
+	size_t i = 0;
+#if defined(AGI_SSE2)
+	for (; i + 8 <= count; i += 8) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4 + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16)));
+	}
+#elif defined(AGI_NEON)
+	for (; i + 8 <= count; i += 8) {
+		const int32x4_t a = vreinterpretq_s32_u8(vld1q_u8(src + i * 4));
+		const int32x4_t b = vreinterpretq_s32_u8(vld1q_u8(src + i * 4 + 16));
+		vst1q_s16(dst + i, vcombine_s16(vshrn_n_s32(a, 16), vshrn_n_s32(b, 16)));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = static_cast<int16_t>(src[i * 4 + 2] | src[i * 4 + 3] << 8);
+}
+
+void Downmix(const int16_t *src, int16_t *dst, size_t frames, int channels) {
+	size_t i = 0;
+	if (channels == 2) {
+#if defined(AGI_SSE2)
+		const __m128i ones = _mm_set1_epi16(1);
+		for (; i + 8 <= frames; i += 8) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2 + 8));
+			const __m128i lo = Halve(_mm_madd_epi16(a, ones));
+			const __m128i hi = Halve(_mm_madd_epi16(b, ones));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+		}
+#elif defined(AGI_NEON)
+		for (; i + 8 <= frames; i += 8) {
+			const int16x8x2_t v = vld2q_s16(src + i * 2);
+			const int32x4_t lo = vaddl_s16(vget_low_s16(v.val[0]), vget_low_s16(v.val[1]));
+			const int32x4_t hi = vaddl_s16(vget_high_s16(v.val[0]), vget_high_s16(v.val[1]));
+			vst1q_s16(dst + i, vcombine_s16(HalveNarrow(lo), HalveNarrow(hi)));
+		}
+#endif
+		for (; i < frames; ++i)
+			dst[i] = static_cast<int16_t>(Halve(src[i * 2] + src[i * 2 + 1]));
+		return;
+	}
+
+	for (; i < frames; ++i, src += channels) {
+		int sum = 0;
+		for (int c = 0; c < channels; ++c)
+			sum += src[c];
+		dst[i] = static_cast<int16_t>(sum / channels);
+	}
+}
+
+void DoubleSamples(const int16_t *src, int16_t *dst, size_t count) {
+	size_t i = 0;
+#if defined(AGI_SSE2)
+	for (; i + 16 <= count; i += 16) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i / 2));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i / 2 + 1));
+		const __m128i lo = Halve(_mm_add_epi32(WidenLow(a), WidenLow(b)));
+		const __m128i hi = Halve(_mm_add_epi32(WidenHigh(a), WidenHigh(b)));
+		const __m128i avg = _mm_packs_epi32(lo, hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi16(a, avg));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpackhi_epi16(a, avg));
+	}
+#elif defined(AGI_NEON)
+	for (; i + 16 <= count; i += 16) {
+		const int16x8_t a = vld1q_s16(src + i / 2);
+		const int16x8_t b = vld1q_s16(src + i / 2 + 1);
+		const int32x4_t lo = vaddl_s16(vget_low_s16(a), vget_low_s16(b));
+		const int32x4_t hi = vaddl_s16(vget_high_s16(a), vget_high_s16(b));
+		int16x8x2_t out;
+		out.val[0] = a;
+		out.val[1] = vcombine_s16(HalveNarrow(lo), HalveNarrow(hi));
+		vst2q_s16(dst + i, out);
+	}
+#endif
+	for (; i < count; ++i) {
+		if (i & 1)
+			dst[i] = static_cast<int16_t>(Halve(static_cast<int32_t>(src[i / 2]) + src[i / 2 + 1]));
+		else
+			dst[i] = src[i / 2];
+	}
+}
+
+void ApplyVolume(const int16_t *src, int16_t *dst, size_t count, double volume) {
+	size_t i = 0;
+#if defined(AGI_SSE2)
+	const __m128d vol = _mm_set1_pd(volume);
+	for (; i + 8 <= count; i += 8) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		const __m128i lo = Scale4(WidenLow(v), vol);
+		const __m128i hi = Scale4(WidenHigh(v), vol);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+	}
+#elif defined(AGI_NEON)
+	const float64x2_t vol = vdupq_n_f64(volume);
+	for (; i + 8 <= count; i += 8) {
+		const int16x8_t v = vld1q_s16(src + i);
+		vst1q_s16(dst + i, vcombine_s16(Scale4(vget_low_s16(v), vol), Scale4(vget_high_s16(v), vol)));
+	}
+#endif
+	for (; i < count; ++i)
+		dst[i] = ScaleSample(src[i], volume);
+}
+} }
@@ -0,0 +1,48 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Sample format conversion loops used by the converting audio providers.
+/// These use SSE2 on x86 and NEON on ARM64 when available, with identical
+/// results to the plain C++ versions.
+namespace agi { namespace audio_convert {
+/// Float in [-1, 1] to 16-bit, clamping anything outside that range
+void FloatToInt16(const float *src, int16_t *dst, size_t count);
+void FloatToInt16(const double *src, int16_t *dst, size_t count);
+
+/// Little-endian signed 24 or 32-bit to 16-bit, discarding the low bits
+void Int24ToInt16(const uint8_t *src, int16_t *dst, size_t count);
+void Int32ToInt16(const uint8_t *src, int16_t *dst, size_t count);
+
+/// Average interleaved 16-bit channels together
+/// @param frames Number of output samples
+void Downmix(const int16_t *src, int16_t *dst, size_t frames, int channels);
+
+/// Double the sample rate of 16-bit mono audio, linearly interpolating the
+/// new samples. Output sample i is src[i / 2] for even i and the average of
+/// src[i / 2] and src[i / 2 + 1] for odd i.
+/// @param count Number of output samples
+void DoubleSamples(const int16_t *src, int16_t *dst, size_t count);
+
+/// Scale 16-bit samples by volume, rounding and saturating. Output sample i
+/// is src[i] * volume + 0.5 truncated towards zero and clamped to 16 bits.
+/// src and dst may be the same buffer.
+void ApplyVolume(const int16_t *src, int16_t *dst, size_t count, double volume);
+} }
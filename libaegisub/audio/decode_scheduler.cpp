@@ -0,0 +1,79 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "decode_scheduler.h"
+
+#include <algorithm>
+
+namespace agi {
+AudioDecodeScheduler::AudioDecodeScheduler(int64_t num_samples, int64_t block_size, int workers)
+: block_size(block_size)
+, block_count((num_samples + block_size - 1) / block_size)
+, cursors(new int64_t[workers])
+{
+	state.reset(new std::atomic<uint8_t>[block_count]);
+	for (int64_t i = 0; i < block_count; ++i)
+		state[i] = PENDING;
+	for (int i = 0; i < workers; ++i)
+		cursors[i] = block_count * i / workers;
+}
+
+bool AudioDecodeScheduler::IsDecoded(int64_t start, int64_t count) const {
+	if (count <= 0) return true;
+	const int64_t first = std::max<int64_t>(start, 0) / block_size;
+	const int64_t last = std::min((start + count - 1) / block_size, block_count - 1);
+	for (int64_t i = first; i <= last; ++i) {
+		if (state[i] != DECODED) return false;
+	}
+	return true;
+}
+
+void AudioDecodeScheduler::Request(int64_t sample) const {
+	const int64_t block = sample / block_size;
+	if (block >= 0 && block < block_count && state[block] == PENDING)
+		requested = block;
+}
+
+bool AudioDecodeScheduler::Claim(int64_t block) {
+	uint8_t expected = PENDING;
+	return state[block].compare_exchange_strong(expected, DECODING);
+}
+
+int64_t AudioDecodeScheduler::Next(int worker) {
+	int64_t& cursor = cursors[worker];
+
+	const int64_t req = requested.exchange(-1);
+	if (req >= 0 && Claim(req))
+		return cursor = req;
+
+	for (; cursor < block_count; ++cursor) {
+		if (Claim(cursor))
+			return cursor;
+	}
+
+	// Reached the end, so go back to the first gap
+	for (cursor = 0; cursor < block_count; ++cursor) {
+		if (Claim(cursor))
+			return cursor;
+	}
+
+	return -1;
+}
+
+void AudioDecodeScheduler::MarkDecoded(int64_t block) {
+	state[block] = DECODED;
+}
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace agi {
+/// Tracks which blocks of a cached audio stream have been decoded and picks
+/// the block which each background decoder thread should work on next
+///
+/// With a single decoder, blocks are normally decoded in order from the start,
+/// but whenever samples which haven't been decoded yet are requested the
+/// decoder jumps to them and continues forward from there. Once it reaches
+/// the end of the stream it goes back to filling in the gaps from the start.
+///
+/// With more than one decoder the stream is split into equal segments with
+/// each decoder starting at the beginning of its own segment. Requests are
+/// picked up by whichever decoder asks for a block next, and a decoder which
+/// finishes its segment helps out with whatever is still left.
+///
+/// IsDecoded and Request may be called from any thread, while each decoder
+/// thread must only call Next and MarkDecoded with its own worker index.
+class AudioDecodeScheduler {
+	enum : uint8_t { PENDING, DECODING, DECODED };
+
+	std::unique_ptr<std::atomic<uint8_t>[]> state;
+	int64_t block_size;
+	int64_t block_count;
+
+	/// Undecoded block most recently asked for, or -1 if there's no
+	/// pending request
+	mutable std::atomic<int64_t> requested{-1};
+	/// Block each decoder is currently working forward from
+	std::unique_ptr<int64_t[]> cursors;
+
+	/// Try to take ownership of a block for decoding
+	bool Claim(int64_t block);
+
+public:
+	/// @param num_samples Total number of samples in the stream
+	/// @param block_size Number of samples per block
+	/// @param workers Number of decoder threads which will be pulling blocks
+	AudioDecodeScheduler(int64_t num_samples, int64_t block_size, int workers = 1);
+
+	int64_t BlockSize() const { return block_size; }
+	int64_t BlockCount() const { return block_count; }
+
+	/// Have all of the samples in the given range been decoded?
+	bool IsDecoded(int64_t start, int64_t count) const;
+	bool IsBlockDecoded(int64_t block) const { return state[block] == DECODED; }
+
+	/// Ask for the block containing the given sample to be decoded next
+	void Request(int64_t sample) const;
+
+	/// Get the next block for a decoder to decode. The block is reserved for
+	/// that decoder and won't be handed out again.
+	/// @return Block index, or -1 if there is nothing left to decode
+	int64_t Next(int worker = 0);
+
+	/// Flag a block as decoded, making it visible to IsDecoded
+	void MarkDecoded(int64_t block);
+};
+}
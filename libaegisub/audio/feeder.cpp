@@ -0,0 +1,213 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/audio/feeder.h"
+
+#include "libaegisub/audio/provider.h"
+#include "libaegisub/log.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace agi {
+AudioRingBuffer::AudioRingBuffer(size_t capacity, size_t frame_size)
+: data(capacity * frame_size)
+, frame_size(frame_size)
+, capacity(capacity)
+{
+}
+
+size_t AudioRingBuffer::Available() const {
+	return static_cast<size_t>(write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire));
+}
+
+size_t AudioRingBuffer::Space() const {
+	return capacity - Available();
+}
+
+size_t AudioRingBuffer::Write(const void *src, size_t count) {
+	const uint64_t write = write_pos.load(std::memory_order_relaxed);
+	const uint64_t read = read_pos.load(std::memory_order_acquire);
+	count = std::min<size_t>(count, capacity - static_cast<size_t>(write - read));
+	if (!count) return 0;
+
+	const size_t offset = static_cast<size_t>(write % capacity);
+	const size_t first = std::min(count, capacity - offset);
+	auto in = static_cast<const char *>(src);
+	memcpy(&data[offset * frame_size], in, first * frame_size);
+	if (first < count)
+		memcpy(&data[0], in + first * frame_size, (count - first) * frame_size);
+
+	write_pos.store(write + count, std::memory_order_release);
+	return count;
+}
+
+size_t AudioRingBuffer::Read(void *dst, size_t count) {
+	const uint64_t read = read_pos.load(std::memory_order_relaxed);
+	const uint64_t write = write_pos.load(std::memory_order_acquire);
+	count = std::min<size_t>(count, static_cast<size_t>(write - read));
+	if (!count) return 0;
+
+	const size_t offset = static_cast<size_t>(read % capacity);
+	const size_t first = std::min(count, capacity - offset);
+	auto out = static_cast<char *>(dst);
+	memcpy(out, &data[offset * frame_size], first * frame_size);
+	if (first < count)
+		memcpy(out + first * frame_size, &data[0], (count - first) * frame_size);
+
+	read_pos.store(read + count, std::memory_order_release);
+	return count;
+}
+
+size_t AudioRingBuffer::Skip(size_t count) {
+	const uint64_t read = read_pos.load(std::memory_order_relaxed);
+	const uint64_t write = write_pos.load(std::memory_order_acquire);
+	count = std::min<size_t>(count, static_cast<size_t>(write - read));
+	read_pos.store(read + count, std::memory_order_release);
+	return count;
+}
+
+void AudioRingBuffer::Reset() {
+	read_pos = 0;
+	write_pos = 0;
+}
+
+AudioFeeder::AudioFeeder(AudioProvider *provider, size_t buffer_frames)
+: provider(provider)
+, ring(std::max<size_t>(buffer_frames, 1), provider->GetChannels() * provider->GetBytesPerSample())
+, silence(provider->GetBytesPerSample() == 1 ? static_cast<char>(0x80) : 0)
+{
+	read_buffer.reserve(ring.GetCapacity() * ring.GetFrameSize());
+	thread = std::thread(&AudioFeeder::FeederThread, this);
+}
+
+AudioFeeder::~AudioFeeder() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+		ReportUnderruns();
+	}
+	cond.notify_all();
+	thread.join();
+}
+
+void AudioFeeder::FeederThread() {
+	// Read in chunks of a quarter of the buffer so that the provider isn't
+	// asked for a handful of frames each time the output takes some
+	const size_t chunk = std::max<size_t>(ring.GetCapacity() / 4, 1);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!quit) {
+		const int64_t remaining = active ? end - position : 0;
+		const size_t count = static_cast<size_t>(std::min<int64_t>(chunk, std::max<int64_t>(remaining, 0)));
+		if (count == 0 || ring.Space() < count) {
+			// Read() doesn't signal when it frees up space as it has to be
+			// callable from realtime threads, so poll well within the time
+			// it takes to play back a chunk
+			cond.wait_for(lock, std::chrono::milliseconds(10));
+			continue;
+		}
+		Fill(lock, count);
+	}
+}
+
+void AudioFeeder::Fill(std::unique_lock<std::mutex>& lock, size_t count) {
+	const uint64_t gen = generation;
+	const int64_t start = position;
+	read_buffer.resize(count * ring.GetFrameSize());
+
+	lock.unlock();
+	provider->GetAudioWithVolume(read_buffer.data(), start, count, volume);
+	lock.lock();
+
+	if (gen != generation) return;
+	ring.Write(read_buffer.data(), count);
+	position += count;
+}
+
+void AudioFeeder::Start(int64_t start, int64_t new_end, size_t prefill) {
+	std::lock_guard<std::mutex> lock(mutex);
+	ReportUnderruns();
+
+	++generation;
+	ring.Reset();
+	position = start;
+	end = new_end;
+	read_position = start;
+	pending_skip = 0;
+	active = true;
+
+	// Done while holding the lock so that the feeder thread waits for it
+	// rather than reading the same audio
+	prefill = static_cast<size_t>(std::min<int64_t>(std::min(prefill, ring.GetCapacity()), std::max<int64_t>(new_end - start, 0)));
+	if (prefill) {
+		std::vector<char> buf(prefill * ring.GetFrameSize());
+		provider->GetAudioWithVolume(buf.data(), start, prefill, volume);
+		ring.Write(buf.data(), prefill);
+		position += prefill;
+	}
+
+	cond.notify_all();
+}
+
+void AudioFeeder::Stop() {
+	std::lock_guard<std::mutex> lock(mutex);
+	++generation;
+	active = false;
+	ReportUnderruns();
+}
+
+void AudioFeeder::SetEnd(int64_t new_end) {
+	end = new_end;
+	cond.notify_all();
+}
+
+void AudioFeeder::Read(void *buf, size_t count) {
+	const size_t frame_size = ring.GetFrameSize();
+	auto out = static_cast<char *>(buf);
+
+	if (pending_skip)
+		pending_skip -= ring.Skip(pending_skip);
+
+	size_t read = pending_skip ? 0 : ring.Read(out, count);
+	if (read < count) {
+		memset(out + read * frame_size, silence, (count - read) * frame_size);
+
+		// Running out of audio after the end is expected, but before it
+		// means the feeder fell behind
+		const int64_t expected = std::min<int64_t>(count, std::max<int64_t>(end - read_position, 0));
+		if (static_cast<int64_t>(read) < expected) {
+			const size_t missing = static_cast<size_t>(expected) - read;
+			pending_skip += missing;
+			++underruns;
+			underrun_frames += missing;
+		}
+	}
+
+	read_position += count;
+}
+
+void AudioFeeder::ReportUnderruns() {
+	const uint64_t count = underruns - reported_underruns;
+	const uint64_t frames = underrun_frames - reported_underrun_frames;
+	if (!count) return;
+
+	reported_underruns += count;
+	reported_underrun_frames += frames;
+	LOG_W("audio/feeder") << count << " underruns during playback, "
+		<< frames * 1000 / std::max(provider->GetSampleRate(), 1) << " ms of audio replaced with silence";
+}
+}
@@ -0,0 +1,355 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/audio/peak_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+namespace {
+using agi::AudioPeakIndex;
+
+/// Coarsest level allowed; the ready counts need to fit in 32 bits
+const int MaxBits = 31;
+
+/// Identifies saved indexes, and changes whenever the format does
+const char index_magic[] = "AGIPEAK2";
+const size_t index_magic_size = sizeof(index_magic) - 1;
+
+AudioPeakIndex::Entry Summarize(const int16_t *samples, int64_t count) {
+	int min = 0, max = 0;
+	int64_t pos = 0, neg = 0;
+	for (int64_t i = 0; i < count; ++i) {
+		const int s = samples[i];
+		if (s > 0) {
+			max = std::max(max, s);
+			pos += s;
+		}
+		else {
+			min = std::min(min, s);
+			neg += s;
+		}
+	}
+	return AudioPeakIndex::Entry{
+		static_cast<int16_t>(min), static_cast<int16_t>(max),
+		static_cast<uint32_t>(count),
+		static_cast<float>(static_cast<double>(pos) / count),
+		static_cast<float>(static_cast<double>(neg) / count)};
+}
+
+/// Frames quieter than this much above the noise floor are never speech
+const float speech_margin = 15.f;
+/// Frames this much above the noise floor are speech if they're noisy enough
+const float fricative_margin = 8.f;
+/// Zero crossing rate above which a frame counts as noisy
+const float fricative_crossings = 0.3f;
+/// Number of speech frames in a row needed for speech to start
+const int onset_frames = 3;
+/// Number of non-speech frames in a row needed for speech to stop
+const int offset_frames = 15;
+}
+
+namespace agi {
+AudioPeakIndex::AudioPeakIndex(int64_t num_samples, int sample_rate)
+: num_samples(num_samples)
+, sample_rate(sample_rate)
+{
+	int64_t size = (num_samples + (1 << BaseBits) - 1) >> BaseBits;
+	levels.emplace_back(static_cast<size_t>(size), Entry{0, 0, 0, 0.f, 0.f});
+	for (int bits = BaseBits + 1; size > 1 && bits <= MaxBits; ++bits) {
+		size = (size + 1) / 2;
+		levels.emplace_back(static_cast<size_t>(size), Entry{0, 0, 0, 0.f, 0.f});
+	}
+
+	if (sample_rate > 0 && num_samples > 0) {
+		const int64_t frames = (num_samples - 1) * 1000 / (int64_t(sample_rate) * EnvelopeFrameMs) + 1;
+		envelope.resize(static_cast<size_t>(frames), EnvelopeEntry{0.f, 0, 0});
+	}
+}
+
+int64_t AudioPeakIndex::FrameStart(int64_t frame) const {
+	const int64_t divisor = 1000 / EnvelopeFrameMs;
+	return std::min(num_samples, (frame * sample_rate + divisor - 1) / divisor);
+}
+
+int64_t AudioPeakIndex::EntryLength(size_t level, int64_t i) const {
+	const int bits = BaseBits + static_cast<int>(level);
+	return std::min<int64_t>(int64_t(1) << bits, num_samples - (i << bits));
+}
+
+void AudioPeakIndex::AddSamples(const int16_t *samples, int64_t start, int64_t count) {
+	const int64_t base = int64_t(1) << BaseBits;
+	assert(start % base == 0);
+	assert(count % base == 0 || start + count == num_samples);
+	if (count <= 0) return;
+
+	// Summarize the samples before taking the lock, as this is the part
+	// which actually has to look at all of them
+	std::vector<Entry> entries;
+	entries.reserve(static_cast<size_t>((count + base - 1) / base));
+	for (int64_t i = 0; i < count; i += base)
+		entries.push_back(Summarize(samples + i, std::min(base, count - i)));
+
+	// Each envelope frame gets the part of it which is in these samples.
+	// Sign changes are counted for each pair of samples in the frame where
+	// the earlier one is also in these samples.
+	std::vector<EnvelopeEntry> frames;
+	int64_t first_frame = 0;
+	if (!envelope.empty()) {
+		const int64_t end = start + count;
+		first_frame = start * 1000 / (int64_t(sample_rate) * EnvelopeFrameMs);
+		for (int64_t frame = first_frame; frame < static_cast<int64_t>(envelope.size()) && FrameStart(frame) < end; ++frame) {
+			const int64_t b = std::max(start, FrameStart(frame));
+			const int64_t e = std::min(end, FrameStart(frame + 1));
+			double energy = 0;
+			uint32_t crossings = 0;
+			for (int64_t i = b; i < e; ++i) {
+				const double v = samples[i - start] / 32768.;
+				energy += v * v;
+				if (i > start && (samples[i - start] < 0) != (samples[i - start - 1] < 0))
+					++crossings;
+			}
+			frames.push_back(EnvelopeEntry{static_cast<float>(energy), crossings, static_cast<uint32_t>(e - b)});
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < frames.size(); ++i) {
+		auto& frame = envelope[first_frame + i];
+		// Frames which are already complete were loaded from a saved index
+		if (frame.ready == FrameStart(first_frame + i + 1) - FrameStart(first_frame + i)) continue;
+		frame.energy += frames[i].energy;
+		frame.crossings += frames[i].crossings;
+		frame.ready += frames[i].ready;
+	}
+	if (!frames.empty())
+		boundaries_found = false;
+
+	int64_t first = start >> BaseBits;
+	int64_t last = first + static_cast<int64_t>(entries.size()) - 1;
+	std::copy(entries.begin(), entries.end(), levels[0].begin() + first);
+
+	// Rebuild every coarser entry overlapping the new samples from its
+	// children. Children which haven't been added yet are still zero, and
+	// the entry is rebuilt again and marked fully ready once they are.
+	for (size_t level = 1; level < levels.size(); ++level) {
+		first /= 2;
+		last /= 2;
+		auto const& children = levels[level - 1];
+		for (int64_t i = first; i <= last; ++i) {
+			const size_t c = static_cast<size_t>(i * 2);
+			Entry e = children[c];
+			double pos = e.pos_mean * EntryLength(level - 1, c);
+			double neg = e.neg_mean * EntryLength(level - 1, c);
+			if (c + 1 < children.size()) {
+				Entry const& b = children[c + 1];
+				e.min = std::min(e.min, b.min);
+				e.max = std::max(e.max, b.max);
+				e.ready += b.ready;
+				pos += b.pos_mean * EntryLength(level - 1, c + 1);
+				neg += b.neg_mean * EntryLength(level - 1, c + 1);
+			}
+			const double length = static_cast<double>(EntryLength(level, i));
+			e.pos_mean = static_cast<float>(pos / length);
+			e.neg_mean = static_cast<float>(neg / length);
+			levels[level][static_cast<size_t>(i)] = e;
+		}
+	}
+}
+
+bool AudioPeakIndex::GetPeak(int64_t start, int64_t count, AudioPeak &out) const {
+	start = std::max<int64_t>(start, 0);
+	count = std::min(count, num_samples - start);
+	if (count < MinEntries << BaseBits) return false;
+
+	size_t level = 0;
+	while (level + 1 < levels.size() && count >= (int64_t(MinEntries) << (BaseBits + level + 1)))
+		++level;
+
+	const int bits = BaseBits + static_cast<int>(level);
+	const int64_t first = start >> bits;
+	const int64_t last = (start + count - 1) >> bits;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto const& entries = levels[level];
+	int min = 0, max = 0;
+	double pos = 0, neg = 0;
+	int64_t total = 0;
+	for (int64_t i = first; i <= last; ++i) {
+		Entry const& e = entries[static_cast<size_t>(i)];
+		const int64_t length = EntryLength(level, i);
+		if (e.ready != length) return false;
+		min = std::min<int>(min, e.min);
+		max = std::max<int>(max, e.max);
+		pos += e.pos_mean * length;
+		neg += e.neg_mean * length;
+		total += length;
+	}
+
+	out.min = static_cast<int16_t>(min);
+	out.max = static_cast<int16_t>(max);
+	out.pos_mean = static_cast<float>(pos / total);
+	out.neg_mean = static_cast<float>(neg / total);
+	return true;
+}
+
+bool AudioPeakIndex::IsComplete() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto const& top = levels.back();
+	for (size_t i = 0; i < top.size(); ++i) {
+		if (top[i].ready != EntryLength(levels.size() - 1, i))
+			return false;
+	}
+	return true;
+}
+
+bool AudioPeakIndex::EnvelopeComplete() const {
+	for (size_t i = 0; i < envelope.size(); ++i) {
+		if (envelope[i].ready != FrameStart(i + 1) - FrameStart(i))
+			return false;
+	}
+	return true;
+}
+
+AudioEnvelopeFrame AudioPeakIndex::EnvelopeFrame(size_t frame) const {
+	EnvelopeEntry const& e = envelope[frame];
+	AudioEnvelopeFrame out;
+	const double mean = e.ready ? e.energy / e.ready : 0.;
+	out.level = mean > 0 ? std::max<float>(SilenceLevel, static_cast<float>(10 * log10(mean))) : SilenceLevel;
+	out.zero_crossings = e.ready ? static_cast<float>(e.crossings) / e.ready : 0.f;
+	return out;
+}
+
+bool AudioPeakIndex::GetEnvelope(int64_t first, int64_t count, std::vector<AudioEnvelopeFrame> &out) const {
+	if (first < 0 || count < 0 || first + count > static_cast<int64_t>(envelope.size()))
+		return false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int64_t i = first; i < first + count; ++i) {
+		if (envelope[i].ready != FrameStart(i + 1) - FrameStart(i))
+			return false;
+	}
+	out.reserve(out.size() + static_cast<size_t>(count));
+	for (int64_t i = first; i < first + count; ++i)
+		out.push_back(EnvelopeFrame(static_cast<size_t>(i)));
+	return true;
+}
+
+bool AudioPeakIndex::GetSpeechBoundaries(int start, int end, std::vector<SpeechBoundary> &out) const {
+	if (envelope.empty()) return false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!boundaries_found) {
+		if (!EnvelopeComplete()) return false;
+		std::vector<AudioEnvelopeFrame> frames;
+		frames.reserve(envelope.size());
+		for (size_t i = 0; i < envelope.size(); ++i)
+			frames.push_back(EnvelopeFrame(i));
+		boundaries = FindSpeechBoundaries(frames);
+		boundaries_found = true;
+	}
+
+	auto cmp = [](SpeechBoundary const& b, int time) { return b.time < time; };
+	for (auto it = std::lower_bound(boundaries.begin(), boundaries.end(), start, cmp); it != boundaries.end() && it->time <= end; ++it)
+		out.push_back(*it);
+	return true;
+}
+
+std::vector<SpeechBoundary> AudioPeakIndex::FindSpeechBoundaries(std::vector<AudioEnvelopeFrame> const& frames) {
+	std::vector<SpeechBoundary> found;
+	if (frames.empty()) return found;
+
+	// Take the noise floor to be the level which a tenth of the frames are
+	// quieter than
+	std::vector<float> levels;
+	levels.reserve(frames.size());
+	for (auto const& frame : frames)
+		levels.push_back(frame.level);
+	auto nth = levels.begin() + levels.size() / 10;
+	std::nth_element(levels.begin(), nth, levels.end());
+	const float noise_floor = *nth;
+
+	auto is_speech = [&](AudioEnvelopeFrame const& frame) {
+		return frame.level > noise_floor + speech_margin
+			|| (frame.level > noise_floor + fricative_margin && frame.zero_crossings > fricative_crossings);
+	};
+
+	bool speaking = false;
+	int run = 0;
+	for (size_t i = 0; i < frames.size(); ++i) {
+		if (is_speech(frames[i]) != speaking) {
+			if (++run >= (speaking ? offset_frames : onset_frames)) {
+				speaking = !speaking;
+				found.push_back(SpeechBoundary{static_cast<int>((i + 1 - run) * EnvelopeFrameMs), speaking});
+				run = 0;
+			}
+		}
+		else
+			run = 0;
+	}
+	return found;
+}
+
+void AudioPeakIndex::Save(std::ostream &out) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	const uint32_t level_count = static_cast<uint32_t>(levels.size());
+	const uint32_t envelope_size = static_cast<uint32_t>(envelope.size());
+	out.write(index_magic, index_magic_size);
+	out.write(reinterpret_cast<const char *>(&num_samples), sizeof(num_samples));
+	out.write(reinterpret_cast<const char *>(&level_count), sizeof(level_count));
+	out.write(reinterpret_cast<const char *>(&envelope_size), sizeof(envelope_size));
+	for (auto const& level : levels)
+		out.write(reinterpret_cast<const char *>(level.data()), level.size() * sizeof(Entry));
+	out.write(reinterpret_cast<const char *>(envelope.data()), envelope.size() * sizeof(EnvelopeEntry));
+}
+
+bool AudioPeakIndex::Load(std::istream &in) {
+	char magic[index_magic_size];
+	int64_t saved_samples = 0;
+	uint32_t level_count = 0;
+	uint32_t envelope_size = 0;
+	in.read(magic, index_magic_size);
+	in.read(reinterpret_cast<char *>(&saved_samples), sizeof(saved_samples));
+	in.read(reinterpret_cast<char *>(&level_count), sizeof(level_count));
+	in.read(reinterpret_cast<char *>(&envelope_size), sizeof(envelope_size));
+	if (!in || memcmp(magic, index_magic, index_magic_size) || saved_samples != num_samples
+		|| level_count != levels.size() || envelope_size != envelope.size())
+		return false;
+
+	// The shape of the levels is fixed by the length, so read straight into
+	// copies of them
+	std::vector<std::vector<Entry>> loaded;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		loaded = levels;
+	}
+	for (auto& level : loaded)
+		in.read(reinterpret_cast<char *>(level.data()), level.size() * sizeof(Entry));
+	std::vector<EnvelopeEntry> loaded_envelope(envelope.size());
+	in.read(reinterpret_cast<char *>(loaded_envelope.data()), loaded_envelope.size() * sizeof(EnvelopeEntry));
+	if (!in) return false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	levels = std::move(loaded);
+	envelope = std::move(loaded_envelope);
+	boundaries_found = false;
+	return true;
+}
+}
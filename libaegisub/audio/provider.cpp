@@ -16,22 +16,40 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "convert_kernels.h"
+
 #include "libaegisub/fs.h"
 #include "libaegisub/io.h"
 #include "libaegisub/log.h"
+#include "libaegisub/parallel.h"
 #include "libaegisub/util.h"
 
 namespace agi {
 void AudioProvider::GetAudioWithVolume(void *buf, int64_t start, int64_t count, double volume) const {
-	GetAudio(buf, start, count);
-
-	if (volume == 1.0) return;
+	if (volume == 1.0) {
+		GetAudio(buf, start, count);
+		return;
+	}
 	if (bytes_per_sample != 2)
 		throw agi::InternalError("GetAudioWithVolume called on unconverted audio stream");
 
-	auto buffer = static_cast<int16_t *>(buf);
-	for (size_t i = 0; i < (size_t)count; ++i)
-		buffer[i] = util::mid(-0x8000, static_cast<int>(buffer[i] * volume + 0.5), 0x7FFF);
+	// Scale straight from the provider's storage when possible so that the
+	// copy to the output and the volume are a single pass over the samples
+	auto src = static_cast<const int16_t *>(GetAudioView(buf, start, count));
+	audio_convert::ApplyVolume(src, static_cast<int16_t *>(buf), static_cast<size_t>(count * channels), volume);
+}
+
+const void *AudioProvider::ViewAudio(int64_t start, int64_t count) const {
+	if (start < 0 || count <= 0 || start + count > num_samples)
+		return nullptr;
+	return ViewBuffer(start, count);
+}
+
+const void *AudioProvider::GetAudioView(void *buf, int64_t start, int64_t count) const {
+	if (auto view = ViewAudio(start, count))
+		return view;
+	GetAudio(buf, start, count);
+	return buf;
 }
 
 void AudioProvider::ZeroFill(void *buf, int64_t count) const {
@@ -92,29 +110,42 @@ public:
 		out.write(data.data(), data.size());
 	}
 
+	void write(const char *data, size_t size) {
+		out.write(data, size);
+	}
+
 	template<typename Dest, typename Src>
 	void write(Src v) {
 		auto converted = static_cast<Dest>(v);
 		out.write(reinterpret_cast<char *>(&converted), sizeof(Dest));
 	}
 };
-}
 
-void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time) {
+/// Size of the reads done when saving clips
+const size_t clip_read_size = 4 * 1024 * 1024;
+/// Maximum amount of audio SaveAudioClips holds in memory at once
+const size_t clip_batch_size = 64 * 1024 * 1024;
+/// Clips closer together than this are read with a single read rather than
+/// skipping the audio between them
+const size_t clip_max_gap = 256 * 1024;
+
+/// Sample range covered by a clip, clamped to the audio
+std::pair<int64_t, int64_t> clip_samples(AudioProvider const& provider, int start_time, int end_time) {
 	const auto max_samples = provider.GetNumSamples();
 	const auto start_sample = std::min(max_samples, ((int64_t)start_time * provider.GetSampleRate() + 999) / 1000);
 	const auto end_sample = util::mid(start_sample, ((int64_t)end_time * provider.GetSampleRate() + 999) / 1000, max_samples);
+	return {start_sample, end_sample};
+}
 
-	const size_t bytes_per_sample = provider.GetBytesPerSample() * provider.GetChannels();
-	const size_t bufsize = (end_sample - start_sample) * bytes_per_sample;
-
-	writer out{path};
+/// Write everything up to the start of the data chunk's samples
+/// @param extra_size Size of any chunks after the data chunk
+void write_wav_header(writer& out, AudioProvider const& provider, size_t data_size, size_t extra_size = 0) {
 	out.write("RIFF");
-	out.write<int32_t>(bufsize + 36);
+	out.write<int32_t>(data_size + 36 + extra_size);
 
 	out.write("WAVEfmt ");
 	out.write<int32_t>(16); // Size of chunk
-	out.write<int16_t>(1);  // compression format (PCM)
+	out.write<int16_t>(provider.AreSamplesFloat() ? 3 : 1); // compression format (IEEE float or PCM)
 	out.write<int16_t>(provider.GetChannels());
 	out.write<int32_t>(provider.GetSampleRate());
 	out.write<int32_t>(provider.GetSampleRate() * provider.GetChannels() * provider.GetBytesPerSample());
@@ -122,7 +153,119 @@ void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int star
 	out.write<int16_t>(provider.GetBytesPerSample() * 8);
 
 	out.write("data");
-	out.write<int32_t>(bufsize);
+	out.write<int32_t>(data_size);
+}
+
+/// A clip being saved by SaveAudioClips
+struct PendingClip {
+	AudioClip const *clip;
+	size_t index;  ///< Index in the list of clips passed in
+	int64_t start; ///< First sample
+	int64_t end;   ///< One past the last sample
+	size_t offset; ///< Byte offset of the clip in the batch buffer
+	int64_t container_offset; ///< Sample offset of the clip in the container
+};
+
+/// Writes the container file for SaveAudioClips, with a cue point and a
+/// labelled region for each clip after the data chunk
+class ClipContainer {
+	writer out;
+	std::vector<PendingClip> const& clips;
+	size_t data_size;
+	std::vector<std::string> labels;
+
+	/// Size of the labl subchunk of the adtl list for a clip, not including
+	/// the chunk header
+	static size_t label_size(std::string const& label) {
+		return 4 + label.size() + 1;
+	}
+
+	size_t extra_size() const {
+		size_t size = data_size & 1; // Pad byte
+		size += 8 + 4 + 24 * clips.size(); // cue chunk
+		size += 8 + 4; // LIST chunk header and adtl
+		for (auto const& label : labels) {
+			size += 8 + 20; // ltxt
+			size += 8 + (label_size(label) + 1) / 2 * 2; // labl
+		}
+		return size;
+	}
+
+public:
+	ClipContainer(fs::path const& path, AudioProvider const& provider, std::vector<PendingClip> const& clips)
+	: out(path)
+	, clips(clips)
+	, data_size(0)
+	{
+		const size_t frame_size = provider.GetBytesPerSample() * provider.GetChannels();
+		for (auto const& clip : clips) {
+			data_size += (clip.end - clip.start) * frame_size;
+			labels.push_back(clip.clip->path.empty()
+				? std::to_string(clip.index + 1)
+				: clip.clip->path.filename().string());
+		}
+		write_wav_header(out, provider, data_size, extra_size());
+	}
+
+	void write(const char *data, size_t size) {
+		out.write(data, size);
+	}
+
+	/// Write the chunks which go after the audio
+	void finish() {
+		if (data_size & 1)
+			out.write<int8_t>(0);
+
+		out.write("cue ");
+		out.write<int32_t>(4 + 24 * clips.size());
+		out.write<int32_t>(clips.size());
+		for (size_t i = 0; i < clips.size(); ++i) {
+			out.write<int32_t>(i + 1); // ID
+			out.write<int32_t>(clips[i].container_offset); // Position
+			out.write("data");
+			out.write<int32_t>(0); // Chunk start
+			out.write<int32_t>(0); // Block start
+			out.write<int32_t>(clips[i].container_offset); // Sample offset
+		}
+
+		size_t list_size = 4;
+		for (auto const& label : labels)
+			list_size += 8 + 20 + 8 + (label_size(label) + 1) / 2 * 2;
+		out.write("LIST");
+		out.write<int32_t>(list_size);
+		out.write("adtl");
+		for (size_t i = 0; i < clips.size(); ++i) {
+			out.write("ltxt");
+			out.write<int32_t>(20);
+			out.write<int32_t>(i + 1); // Cue point ID
+			out.write<int32_t>(clips[i].end - clips[i].start); // Length in samples
+			out.write("rgn ");
+			out.write<int16_t>(0); // Country
+			out.write<int16_t>(0); // Language
+			out.write<int16_t>(0); // Dialect
+			out.write<int16_t>(0); // Code page
+
+			auto const& label = labels[i];
+			out.write("labl");
+			out.write<int32_t>(label_size(label));
+			out.write<int32_t>(i + 1); // Cue point ID
+			out.write(label.c_str(), label.size() + 1);
+			if (label_size(label) & 1)
+				out.write<int8_t>(0);
+		}
+	}
+};
+}
+
+void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time) {
+	int64_t start_sample, end_sample;
+	std::tie(start_sample, end_sample) = clip_samples(provider, start_time, end_time);
+
+	const size_t bytes_per_sample = provider.GetBytesPerSample() * provider.GetChannels();
+	const size_t bufsize = (end_sample - start_sample) * bytes_per_sample;
+
+	writer out{path};
+	write_wav_header(out, provider, bufsize);
 
 	// samples per read
 	size_t spr = 65536 / bytes_per_sample;
@@ -134,4 +277,94 @@ void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int star
 		out.write(buf);
 	}
 }
+
+void SaveAudioClips(AudioProvider const& provider, std::vector<AudioClip> const& clips, fs::path const& container) {
+	const size_t frame_size = provider.GetBytesPerSample() * provider.GetChannels();
+
+	std::vector<PendingClip> pending;
+	pending.reserve(clips.size());
+	for (size_t i = 0; i < clips.size(); ++i) {
+		auto range = clip_samples(provider, clips[i].start_time, clips[i].end_time);
+		pending.push_back(PendingClip{&clips[i], i, range.first, range.second, 0, 0});
+	}
+	std::stable_sort(begin(pending), end(pending), [](PendingClip const& a, PendingClip const& b) {
+		return a.start < b.start;
+	});
+
+	int64_t container_offset = 0;
+	for (auto& clip : pending) {
+		clip.container_offset = container_offset;
+		container_offset += clip.end - clip.start;
+	}
+
+	std::unique_ptr<ClipContainer> out;
+	if (!container.empty())
+		out.reset(new ClipContainer(container, provider, pending));
+
+	// Read the clips in batches of up to clip_batch_size bytes, merging the
+	// clips in each batch into as few sequential ranges as possible
+	std::vector<char> buffer;
+	for (size_t batch_begin = 0; batch_begin < pending.size(); ) {
+		struct Range { int64_t start, end; size_t offset; };
+		std::vector<Range> ranges;
+		size_t batch_bytes = 0;
+		size_t batch_end = batch_begin;
+		for (; batch_end < pending.size(); ++batch_end) {
+			auto& clip = pending[batch_end];
+			if (!ranges.empty() && clip.start <= ranges.back().end + (int64_t)(clip_max_gap / frame_size)) {
+				// Extends the previous range
+				auto& range = ranges.back();
+				const size_t grow = std::max<int64_t>(0, clip.end - range.end) * frame_size;
+				if (batch_end > batch_begin && batch_bytes + grow > clip_batch_size) break;
+				batch_bytes += grow;
+				range.end = std::max(range.end, clip.end);
+			}
+			else {
+				const size_t size = (clip.end - clip.start) * frame_size;
+				if (batch_end > batch_begin && batch_bytes + size > clip_batch_size) break;
+				ranges.push_back(Range{clip.start, clip.end, batch_bytes});
+				batch_bytes += size;
+			}
+			auto const& range = ranges.back();
+			clip.offset = range.offset + (clip.start - range.start) * frame_size;
+		}
+
+		buffer.resize(batch_bytes);
+		const size_t samples_per_read = std::max<size_t>(1, clip_read_size / frame_size);
+		for (auto const& range : ranges) {
+			char *dst = buffer.data() + range.offset;
+			for (int64_t i = range.start; i < range.end; i += samples_per_read) {
+				const size_t count = std::min<int64_t>(samples_per_read, range.end - i);
+				provider.GetAudio(dst, i, count);
+				dst += count * frame_size;
+			}
+		}
+
+		// The container's part of the batch is written alongside the files
+		const size_t file_count = batch_end - batch_begin;
+		parallel_for(0, file_count + (out ? 1 : 0), 1, [&](size_t b, size_t e) {
+			for (size_t i = b; i < e; ++i) {
+				if (i == file_count) {
+					for (size_t j = batch_begin; j < batch_end; ++j) {
+						auto const& clip = pending[j];
+						out->write(buffer.data() + clip.offset, (clip.end - clip.start) * frame_size);
+					}
+					continue;
+				}
+
+				auto const& clip = pending[batch_begin + i];
+				if (clip.clip->path.empty()) continue;
+				const size_t size = (clip.end - clip.start) * frame_size;
+				writer file{clip.clip->path};
+				write_wav_header(file, provider, size);
+				file.write(buffer.data() + clip.offset, size);
+			}
+		}, dispatch::Priority::Background);
+
+		batch_begin = batch_end;
+	}
+
+	if (out)
+		out->finish();
+}
 }
@@ -0,0 +1,366 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file provider_compressed.cpp
+/// @brief RAM audio cache which stores the audio losslessly compressed
+///
+/// The audio is split into blocks which are each compressed with a simple
+/// FLAC-style codec: a fixed polynomial predictor of order 0-2 picked per
+/// block, followed by Rice coding of the residuals in short partitions with
+/// their own parameter. Recently used blocks are kept decompressed so that
+/// scrubbing over the same area doesn't repeatedly decode it.
+
+#include "libaegisub/audio/provider.h"
+
+#include "decode_scheduler.h"
+
+#include "libaegisub/audio/peak_index.h"
+#include "libaegisub/block_cache.h"
+#include "libaegisub/make_unique.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+using namespace agi;
+
+/// Samples per compressed block
+const int64_t BlockSamples = 1 << 16;
+/// Residuals per Rice partition
+const int PartitionSize = 256;
+/// Bits used to store each partition's Rice parameter
+const int ParamBits = 5;
+/// Unary quotients this long are replaced with the raw value
+const uint32_t EscapeLength = 24;
+/// Bits needed for any zigzagged residual of a 16-bit stream
+const int RawBits = 18;
+/// Predictor order marking a block stored uncompressed
+const uint8_t RawBlock = 0xFF;
+/// Number of decompressed blocks kept around for reuse
+const size_t HotBlocks = 32;
+
+class BitWriter {
+	std::vector<uint8_t>& out;
+	uint64_t buffer = 0;
+	int bits = 0;
+
+public:
+	BitWriter(std::vector<uint8_t>& out) : out(out) { }
+
+	/// Write the low count bits of value, count <= 32
+	void Write(uint32_t value, int count) {
+		buffer = (buffer << count) | (value & ((uint64_t(1) << count) - 1));
+		bits += count;
+		while (bits >= 8) {
+			bits -= 8;
+			out.push_back(static_cast<uint8_t>(buffer >> bits));
+		}
+	}
+
+	void Flush() {
+		if (bits > 0)
+			out.push_back(static_cast<uint8_t>(buffer << (8 - bits)));
+		bits = 0;
+	}
+};
+
+class BitReader {
+	const uint8_t *data;
+	const uint8_t *end;
+	uint64_t buffer = 0;
+	int bits = 0;
+
+	void Fill() {
+		while (bits <= 56) {
+			buffer = (buffer << 8) | (data < end ? *data++ : 0);
+			bits += 8;
+		}
+	}
+
+public:
+	BitReader(std::vector<uint8_t> const& in, size_t offset)
+	: data(in.data() + offset), end(in.data() + in.size()) { }
+
+	uint32_t Read(int count) {
+		if (count == 0) return 0;
+		if (bits < count) Fill();
+		bits -= count;
+		return static_cast<uint32_t>(buffer >> bits) & ((uint32_t(1) << count) - 1);
+	}
+
+	/// Read a run of one bits terminated by a zero, up to max ones
+	uint32_t ReadUnary(uint32_t max) {
+		uint32_t count = 0;
+		while (count < max && Read(1))
+			++count;
+		return count;
+	}
+};
+
+inline uint32_t ZigZag(int32_t v) {
+	return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+inline int32_t UnZigZag(uint32_t v) {
+	return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+}
+
+inline int32_t Predict(int order, const int16_t *s, size_t i) {
+	switch (order) {
+		case 1: return s[i - 1];
+		case 2: return 2 * s[i - 1] - s[i - 2];
+		default: return 0;
+	}
+}
+
+std::vector<uint8_t> Compress(const int16_t *samples, size_t count) {
+	// Pick the predictor which leaves the smallest residuals
+	uint64_t cost[3] = {0, 0, 0};
+	for (size_t i = 2; i < count; ++i) {
+		cost[0] += std::abs(samples[i]);
+		cost[1] += std::abs(samples[i] - samples[i - 1]);
+		cost[2] += std::abs(samples[i] - 2 * samples[i - 1] + samples[i - 2]);
+	}
+	const int order = static_cast<int>(std::min_element(cost, cost + 3) - cost);
+
+	std::vector<uint8_t> out;
+	out.reserve(count);
+	out.push_back(static_cast<uint8_t>(order));
+
+	BitWriter writer(out);
+	for (int i = 0; i < order; ++i)
+		writer.Write(static_cast<uint16_t>(samples[i]), 16);
+
+	uint32_t residuals[PartitionSize];
+	for (size_t start = order; start < count; start += PartitionSize) {
+		const size_t n = std::min<size_t>(PartitionSize, count - start);
+		uint64_t sum = 0;
+		for (size_t j = 0; j < n; ++j) {
+			residuals[j] = ZigZag(samples[start + j] - Predict(order, samples, start + j));
+			sum += residuals[j];
+		}
+
+		int k = 0;
+		while (k < RawBits - 1 && (static_cast<uint64_t>(n) << (k + 1)) < sum)
+			++k;
+		writer.Write(k, ParamBits);
+
+		for (size_t j = 0; j < n; ++j) {
+			const uint32_t q = residuals[j] >> k;
+			if (q >= EscapeLength) {
+				writer.Write((1 << EscapeLength) - 1, EscapeLength);
+				writer.Write(residuals[j], RawBits);
+				continue;
+			}
+			writer.Write(((1 << q) - 1) << 1, q + 1);
+			writer.Write(residuals[j], k);
+		}
+
+		// Give up on blocks which don't compress
+		if (out.size() >= count * sizeof(int16_t))
+			break;
+	}
+	writer.Flush();
+
+	if (out.size() >= count * sizeof(int16_t)) {
+		out.resize(count * sizeof(int16_t) + 1);
+		out[0] = RawBlock;
+		memcpy(&out[1], samples, count * sizeof(int16_t));
+	}
+
+	out.shrink_to_fit();
+	return out;
+}
+
+void Decompress(std::vector<uint8_t> const& in, int16_t *samples, size_t count) {
+	const int order = in[0];
+	if (order == RawBlock) {
+		memcpy(samples, &in[1], count * sizeof(int16_t));
+		return;
+	}
+
+	BitReader reader(in, 1);
+	for (int i = 0; i < order; ++i)
+		samples[i] = static_cast<int16_t>(reader.Read(16));
+
+	for (size_t start = order; start < count; start += PartitionSize) {
+		const size_t end = std::min<size_t>(start + PartitionSize, count);
+		const int k = reader.Read(ParamBits);
+		for (size_t i = start; i < end; ++i) {
+			const uint32_t q = reader.ReadUnary(EscapeLength);
+			const uint32_t u = q == EscapeLength ? reader.Read(RawBits) : (q << k) | reader.Read(k);
+			samples[i] = static_cast<int16_t>(UnZigZag(u) + Predict(order, samples, i));
+		}
+	}
+}
+
+class CompressedRAMAudioProvider;
+
+/// Produces decompressed blocks for the hot block cache
+struct DecompressedBlockFactory {
+	typedef std::unique_ptr<std::vector<int16_t>> BlockType;
+
+	const CompressedRAMAudioProvider *parent;
+
+	BlockType ProduceBlock(size_t i, BlockType spare);
+	size_t GetBlockSize() const { return BlockSamples * sizeof(int16_t); }
+};
+
+class CompressedRAMAudioProvider final : public AudioProviderWrapper {
+	friend struct DecompressedBlockFactory;
+
+	std::vector<std::vector<uint8_t>> blocks;
+	/// Additional sources for decoding in parallel
+	std::vector<std::unique_ptr<AudioProvider>> extra_sources;
+	mutable AudioPeakIndex peaks;
+	AudioDecodeScheduler scheduler;
+	std::atomic<bool> cancelled = {false};
+	std::vector<std::thread> decoders;
+
+	mutable std::mutex hot_mutex;
+	mutable DataBlockCache<std::vector<int16_t>, 0, DecompressedBlockFactory> hot;
+
+	/// Total size of the compressed blocks
+	std::atomic<size_t> compressed_bytes{0};
+	CacheBudget::Registration budget_registration;
+
+	size_t BlockLength(int64_t i) const {
+		return static_cast<size_t>(std::min(BlockSamples, num_samples - i * BlockSamples));
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override;
+
+	void Decode(int worker, AudioProvider *src) {
+		std::vector<int16_t> buffer(BlockSamples);
+		while (!cancelled) {
+			const int64_t i = scheduler.Next(worker);
+			if (i < 0) break;
+			const size_t length = BlockLength(i);
+			src->GetAudio(buffer.data(), i * BlockSamples, length);
+			peaks.AddSamples(buffer.data(), i * BlockSamples, length);
+			blocks[i] = Compress(buffer.data(), length);
+			compressed_bytes += blocks[i].size();
+			scheduler.MarkDecoded(i);
+			decoded_samples += length;
+		}
+	}
+
+public:
+	CompressedRAMAudioProvider(std::unique_ptr<AudioProvider> src, std::vector<std::unique_ptr<AudioProvider>> extra)
+	: AudioProviderWrapper(std::move(src))
+	, extra_sources(std::move(extra))
+	, peaks(num_samples, sample_rate)
+	, scheduler(num_samples, BlockSamples, static_cast<int>(extra_sources.size()) + 1)
+	, hot(static_cast<size_t>(scheduler.BlockCount()), DecompressedBlockFactory{this})
+	{
+		if (bytes_per_sample != 2 || channels != 1 || float_samples)
+			throw InternalError("Compressed RAM cache requires 16-bit mono audio");
+
+		decoded_samples = 0;
+		try {
+			blocks.resize(static_cast<size_t>(scheduler.BlockCount()));
+		}
+		catch (std::bad_alloc const&) {
+			throw AudioProviderError("Not enough memory available to cache in RAM");
+		}
+
+		// Only the decompressed blocks can be evicted, as the compressed
+		// data is the only copy of the audio
+		budget_registration = CacheBudget::Global().Register(CacheBudget::Cache{
+			"Audio (compressed RAM)",
+			[=] {
+				std::lock_guard<std::mutex> lock(hot_mutex);
+				return compressed_bytes + hot.GetSize();
+			},
+			[=] {
+				std::lock_guard<std::mutex> lock(hot_mutex);
+				return hot.GetOldestUse();
+			},
+			[=] {
+				std::lock_guard<std::mutex> lock(hot_mutex);
+				hot.AgeOldest();
+			}
+		});
+
+		decoders.emplace_back(&CompressedRAMAudioProvider::Decode, this, 0, source.get());
+		for (size_t i = 0; i < extra_sources.size(); ++i)
+			decoders.emplace_back(&CompressedRAMAudioProvider::Decode, this, i + 1, extra_sources[i].get());
+	}
+
+	bool IsDecoded(int64_t start, int64_t count) const override {
+		return scheduler.IsDecoded(start, count);
+	}
+
+	void Prefetch(int64_t start) const override {
+		scheduler.Request(start);
+	}
+
+	bool SupportsConcurrentReads() const override { return true; }
+
+	AudioPeakIndex *GetPeakIndex() const override { return &peaks; }
+
+	~CompressedRAMAudioProvider() {
+		budget_registration.Unregister();
+		cancelled = true;
+		for (auto& decoder : decoders)
+			decoder.join();
+	}
+};
+
+DecompressedBlockFactory::BlockType DecompressedBlockFactory::ProduceBlock(size_t i, BlockType spare) {
+	if (!spare)
+		spare = agi::make_unique<std::vector<int16_t>>();
+	spare->resize(parent->BlockLength(i));
+	Decompress(parent->blocks[i], spare->data(), spare->size());
+	return spare;
+}
+
+void CompressedRAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const {
+	auto out = static_cast<int16_t *>(buf);
+	while (count > 0) {
+		const int64_t i = start / BlockSamples;
+		const int64_t offset = start % BlockSamples;
+		const int64_t read_size = std::min(count, BlockSamples - offset);
+
+		if (scheduler.IsBlockDecoded(i)) {
+			std::lock_guard<std::mutex> lock(hot_mutex);
+			auto const& block = hot.Get(static_cast<size_t>(i));
+			memcpy(out, &block[offset], read_size * sizeof(int16_t));
+			hot.Age(HotBlocks * BlockSamples * sizeof(int16_t));
+		}
+		else {
+			scheduler.Request(start);
+			memset(out, 0, read_size * sizeof(int16_t));
+		}
+		out += read_size;
+		count -= read_size;
+		start += read_size;
+	}
+}
+}
+
+namespace agi {
+std::unique_ptr<AudioProvider> CreateCompressedRAMAudioProvider(std::unique_ptr<AudioProvider> src) {
+	return agi::make_unique<CompressedRAMAudioProvider>(std::move(src), std::vector<std::unique_ptr<AudioProvider>>());
+}
+
+std::unique_ptr<AudioProvider> CreateCompressedRAMAudioProvider(std::unique_ptr<AudioProvider> src, std::vector<std::unique_ptr<AudioProvider>> extra_sources) {
+	return agi::make_unique<CompressedRAMAudioProvider>(std::move(src), std::move(extra_sources));
+}
+}
@@ -16,22 +16,72 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "convert_kernels.h"
+
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
-#include <limits>
+#include <algorithm>
 
 using namespace agi;
 
-/// Anything integral -> 16 bit signed machine-endian audio converter
 namespace {
+/// Clone a converter by wrapping a clone of its source in a new converter
+template<class Converter>
+std::unique_ptr<AudioProvider> CloneConverter(AudioProvider const& source) {
+	auto src = source.Clone();
+	if (!src) return nullptr;
+	return agi::make_unique<Converter>(std::move(src));
+}
+
+/// Base class for the converters which don't change the sample rate
+///
+/// The source is read through a stack buffer rather than a member one, so
+/// that the converters have no state of their own and can be read from
+/// multiple threads whenever their source can. Decoding progress comes
+/// straight from the source, which may be a cache still being filled.
+class ConvertAudioProviderBase : public AudioProviderWrapper {
+	/// Size in bytes of the buffer the source is read through
+	static const int64_t BufferSize = 1 << 16;
+
+protected:
+	/// Read the source a buffer at a time, calling convert(src, dst, frames)
+	/// on each piece
+	template<typename Func>
+	void ReadConverted(void *buf, int64_t start, int64_t count, Func&& convert) const {
+		int64_t storage[BufferSize / sizeof(int64_t)];
+		const int64_t chunk = BufferSize / (source->GetBytesPerSample() * source->GetChannels());
+		auto dst = static_cast<char *>(buf);
+		while (count > 0) {
+			const auto frames = std::min(count, chunk);
+			source->GetAudio(storage, start, frames);
+			convert(storage, dst, static_cast<size_t>(frames));
+			dst += frames * bytes_per_sample * channels;
+			start += frames;
+			count -= frames;
+		}
+	}
+
+public:
+	ConvertAudioProviderBase(std::unique_ptr<AudioProvider> src) : AudioProviderWrapper(std::move(src)) { }
+
+	int64_t GetDecodedSamples() const override { return source->GetDecodedSamples(); }
+	bool IsDecoded(int64_t start, int64_t count) const override { return source->IsDecoded(start, count); }
+	void Prefetch(int64_t start) const override { source->Prefetch(start); }
+	bool SupportsConcurrentReads() const override { return source->SupportsConcurrentReads(); }
+
+	AudioProvider const& GetNativeProvider() const override {
+		return source->SupportsConcurrentReads() ? source->GetNativeProvider() : *this;
+	}
+};
+
+/// Anything integral -> 16 bit signed machine-endian audio converter
 template<class Target>
-class BitdepthConvertAudioProvider final : public AudioProviderWrapper {
+class BitdepthConvertAudioProvider final : public ConvertAudioProviderBase {
 	int src_bytes_per_sample;
-	mutable std::vector<uint8_t> src_buf;
 
 public:
-	BitdepthConvertAudioProvider(std::unique_ptr<AudioProvider> src) : AudioProviderWrapper(std::move(src)) {
+	BitdepthConvertAudioProvider(std::unique_ptr<AudioProvider> src) : ConvertAudioProviderBase(std::move(src)) {
 		if (bytes_per_sample > 8)
 			throw AudioProviderError("Audio format converter: audio with bitdepths greater than 64 bits/sample is currently unsupported");
 
@@ -39,16 +89,23 @@ public:
 		bytes_per_sample = sizeof(Target);
 	}
 
-	void FillBuffer(void *buf, int64_t start, int64_t count64) const override {
-		auto count = static_cast<size_t>(count64);
-		assert(count == count64);
-
-		src_buf.resize(count * src_bytes_per_sample * channels);
-		source->GetAudio(src_buf.data(), start, count);
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		ReadConverted(buf, start, count, [this](const void *src, void *dst, size_t frames) {
+			Convert(static_cast<const uint8_t *>(src), static_cast<int16_t *>(dst), frames * channels);
+		});
+	}
 
-		auto dest = static_cast<int16_t*>(buf);
+	void Convert(const uint8_t *src_buf, int16_t *dest, size_t count) const {
+		if (src_bytes_per_sample == 4) {
+			audio_convert::Int32ToInt16(src_buf, dest, count);
+			return;
+		}
+		if (src_bytes_per_sample == 3) {
+			audio_convert::Int24ToInt16(src_buf, dest, count);
+			return;
+		}
 
-		for (int64_t i = 0; i < count * channels; ++i) {
+		for (size_t i = 0; i < count; ++i) {
 			int64_t sample = 0;
 
 			// 8 bits per sample is assumed to be unsigned with a bias of 127,
@@ -70,74 +127,60 @@ public:
 			dest[i] = static_cast<Target>(sample);
 		}
 	}
+
+	std::unique_ptr<AudioProvider> Clone() const override {
+		return CloneConverter<BitdepthConvertAudioProvider>(*source);
+	}
 };
 
 /// Floating point -> 16 bit signed machine-endian audio converter
 template<class Source, class Target>
-class FloatConvertAudioProvider final : public AudioProviderWrapper {
-	mutable std::vector<Source> src_buf;
-
+class FloatConvertAudioProvider final : public ConvertAudioProviderBase {
 public:
-	FloatConvertAudioProvider(std::unique_ptr<AudioProvider> src) : AudioProviderWrapper(std::move(src)) {
+	FloatConvertAudioProvider(std::unique_ptr<AudioProvider> src) : ConvertAudioProviderBase(std::move(src)) {
 		bytes_per_sample = sizeof(Target);
 		float_samples = false;
 	}
 
-	void FillBuffer(void *buf, int64_t start, int64_t count64) const override {
-		auto count = static_cast<size_t>(count64);
-		assert(count == count64);
-
-		src_buf.resize(count * channels);
-		source->GetAudio(&src_buf[0], start, count);
-
-		auto dest = static_cast<Target*>(buf);
-
-		for (size_t i = 0; i < static_cast<size_t>(count * channels); ++i) {
-			Source expanded;
-			if (src_buf[i] < 0)
-				expanded = static_cast<Target>(-src_buf[i] * std::numeric_limits<Target>::min());
-			else
-				expanded = static_cast<Target>(src_buf[i] * std::numeric_limits<Target>::max());
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		ReadConverted(buf, start, count, [this](const void *src, void *dst, size_t frames) {
+			audio_convert::FloatToInt16(static_cast<const Source *>(src), static_cast<int16_t *>(dst), frames * channels);
+		});
+	}
 
-			dest[i] = expanded < std::numeric_limits<Target>::min() ? std::numeric_limits<Target>::min() :
-			          expanded > std::numeric_limits<Target>::max() ? std::numeric_limits<Target>::max() :
-			                                                          static_cast<Target>(expanded);
-		}
+	std::unique_ptr<AudioProvider> Clone() const override {
+		return CloneConverter<FloatConvertAudioProvider>(*source);
 	}
 };
 
 /// Non-mono 16-bit signed machine-endian -> mono 16-bit signed machine endian converter
-class DownmixAudioProvider final : public AudioProviderWrapper {
+class DownmixAudioProvider final : public ConvertAudioProviderBase {
 	int src_channels;
-	mutable std::vector<int16_t> src_buf;
 
 public:
-	DownmixAudioProvider(std::unique_ptr<AudioProvider> src) : AudioProviderWrapper(std::move(src)) {
+	DownmixAudioProvider(std::unique_ptr<AudioProvider> src) : ConvertAudioProviderBase(std::move(src)) {
 		src_channels = channels;
 		channels = 1;
 	}
 
-	void FillBuffer(void *buf, int64_t start, int64_t count64) const override {
-		auto count = static_cast<size_t>(count64);
-		assert(count == count64);
-
-		src_buf.resize(count * src_channels);
-		source->GetAudio(&src_buf[0], start, count);
-
-		auto dst = static_cast<int16_t*>(buf);
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
 		// Just average the channels together
-		while (count-- > 0) {
-			int sum = 0;
-			for (int c = 0; c < src_channels; ++c)
-				sum += src_buf[count * src_channels + c];
-			dst[count] = static_cast<int16_t>(sum / src_channels);
-		}
+		ReadConverted(buf, start, count, [this](const void *src, void *dst, size_t frames) {
+			audio_convert::Downmix(static_cast<const int16_t *>(src), static_cast<int16_t *>(dst), frames, src_channels);
+		});
+	}
+
+	std::unique_ptr<AudioProvider> Clone() const override {
+		return CloneConverter<DownmixAudioProvider>(*source);
 	}
 };
 
 /// Sample doubler with linear interpolation for the samples provider
 /// Requires 16-bit mono input
 class SampleDoublingAudioProvider final : public AudioProviderWrapper {
+	/// Output samples produced per read from the source
+	static const int64_t ChunkSize = 4096;
+
 public:
 	SampleDoublingAudioProvider(std::unique_ptr<AudioProvider> src) : AudioProviderWrapper(std::move(src)) {
 		sample_rate *= 2;
@@ -146,29 +189,47 @@ public:
 	}
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
-		int16_t *src, *dst = static_cast<int16_t *>(buf);
-
-		// We need to always get at least two samples to be able to interpolate
-		int16_t srcbuf[2];
-		if (count == 1) {
-			source->GetAudio(srcbuf, start / 2, 2);
-			src = srcbuf;
-		}
-		else {
-			source->GetAudio(buf, start / 2, (start + count) / 2 - start / 2 + 1);
-			src = dst;
+		auto dst = static_cast<int16_t *>(buf);
+
+		// Odd samples are interpolated from the source samples on either side
+		int16_t src[ChunkSize / 2 + 1];
+		if (start & 1) {
+			source->GetAudio(src, start / 2, 2);
+			*dst++ = static_cast<int16_t>(((int32_t)src[0] + src[1]) / 2);
+			++start;
+			--count;
 		}
 
-		// walking backwards so that the conversion can be done in place
-		for (; count > 0; --count) {
-			auto src_index = (start + count - 1) / 2 - start / 2;
-			auto i = count - 1;
-			if ((start + i) & 1)
-				dst[i] = (int16_t)(((int32_t)src[src_index] + src[src_index + 1]) / 2);
-			else
-				dst[i] = src[src_index];
+		while (count > 0) {
+			const auto chunk = std::min<int64_t>(count, int64_t(ChunkSize));
+			source->GetAudio(src, start / 2, chunk / 2 + 1);
+			audio_convert::DoubleSamples(src, dst, static_cast<size_t>(chunk));
+			dst += chunk;
+			start += chunk;
+			count -= chunk;
 		}
 	}
+
+	int64_t GetDecodedSamples() const override { return source->GetDecodedSamples() * 2; }
+
+	bool IsDecoded(int64_t start, int64_t count) const override {
+		if (count <= 0) return true;
+		const int64_t first = start / 2;
+		const int64_t last = std::min((start + count) / 2, source->GetNumSamples() - 1);
+		return source->IsDecoded(first, last - first + 1);
+	}
+
+	void Prefetch(int64_t start) const override { source->Prefetch(start / 2); }
+
+	bool SupportsConcurrentReads() const override { return source->SupportsConcurrentReads(); }
+
+	AudioProvider const& GetNativeProvider() const override {
+		return source->SupportsConcurrentReads() ? source->GetNativeProvider() : *this;
+	}
+
+	std::unique_ptr<AudioProvider> Clone() const override {
+		return CloneConverter<SampleDoublingAudioProvider>(*source);
+	}
 };
 }
 
@@ -59,6 +59,8 @@ class DummyAudioProvider final : public AudioProvider {
 			memset(buf, 0, static_cast<size_t>(count) * bytes_per_sample);
 	}
 
+	bool SupportsConcurrentReads() const override { return true; }
+
 public:
 	DummyAudioProvider(agi::fs::path const& uri) {
 		noise = boost::contains(uri.string(), ":noise?");
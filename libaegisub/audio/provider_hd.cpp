@@ -16,74 +16,219 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "decode_scheduler.h"
+
+#include <libaegisub/audio/peak_index.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/format.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/path.h>
+#include <libaegisub/trace.h>
 #include <libaegisub/make_unique.h>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/interprocess/detail/os_thread_functions.hpp>
 #include <ctime>
+#include <mutex>
 #include <thread>
 
 namespace {
 using namespace agi;
 
+/// Written after the sample data once a persistent cache file has been fully
+/// decoded, so that partially written files left by a crash aren't reused
+const char cache_magic[] = "AGIAUDC1";
+const int64_t cache_magic_size = sizeof(cache_magic) - 1;
+
 class HDAudioProvider final : public AudioProviderWrapper {
+	/// Should the cache file be kept around after we're done with it?
+	const bool persistent;
+	/// Was a fully decoded cache file from a previous session found?
+	bool complete = false;
 	mutable temp_file_mapping file;
+	/// Additional sources for decoding in parallel
+	std::vector<std::unique_ptr<AudioProvider>> extra_sources;
+	/// Peaks of the decoded audio, if it's in the display format
+	std::unique_ptr<AudioPeakIndex> peaks;
+	AudioDecodeScheduler scheduler;
 	std::atomic<bool> cancelled = {false};
-	std::thread decoder;
+	/// Number of decoder threads which haven't finished yet
+	std::atomic<int> running_decoders{0};
+	/// Serializes access to the write mapping when it may be moved around
+	/// while mapping different parts of the file. When the whole file is
+	/// mapped at once, decoders write to it directly.
+	std::mutex write_mutex;
+	std::vector<std::thread> decoders;
+
+	/// Bytes per sample for all channels together
+	int64_t FrameSize() const { return bytes_per_sample * channels; }
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
-		auto missing = std::min(count, start + count - decoded_samples);
-		if (missing > 0) {
-			memset(static_cast<int16_t*>(buf) + count - missing, 0, missing * bytes_per_sample);
-			count -= missing;
-		}
+		auto charbuf = static_cast<char *>(buf);
+		const int64_t block_size = scheduler.BlockSize();
+		while (count > 0) {
+			const int64_t block = start / block_size;
+			const int64_t read_count = std::min(count, (block + 1) * block_size - start);
+			const int64_t read_bytes = read_count * FrameSize();
+
+			if (scheduler.IsBlockDecoded(block))
+				memcpy(charbuf, file.read(start * FrameSize(), read_bytes), read_bytes);
+			else {
+				scheduler.Request(start);
+				memset(charbuf, 0, read_bytes);
+			}
 
-		if (count > 0) {
-			start *= bytes_per_sample;
-			count *= bytes_per_sample;
-			memcpy(buf, file.read(start, count), count);
+			charbuf += read_bytes;
+			start += read_count;
+			count -= read_count;
 		}
 	}
 
-	fs::path CacheFilename(fs::path const& dir) {
+	const void *ViewBuffer(int64_t start, int64_t count) const override {
+		if (!mapped_views_are_stable() || !scheduler.IsDecoded(start, count))
+			return nullptr;
+		return file.read(start * FrameSize(), count * FrameSize());
+	}
+
+	int64_t DataSize() const {
+		return num_samples * FrameSize();
+	}
+
+	fs::path CacheFilename(fs::path const& dir, std::string const& cache_key) {
+		if (persistent) {
+			auto path = dir / ("audio-" + cache_key + ".pcm");
+			// The size is part of the key, so a file of the right size is
+			// either complete or was left behind by an interrupted decode
+			complete = fs::FileExists(path) && fs::Size(path) == static_cast<uintmax_t>(DataSize() + cache_magic_size);
+			if (complete) return path;
+		}
+
 		// Check free space
-		if ((uint64_t)num_samples * bytes_per_sample > fs::FreeSpace(dir))
+		if ((uint64_t)DataSize() > fs::FreeSpace(dir))
 			throw AudioProviderError("Not enough free disk space in " + dir.string() + " to cache the audio");
 
-		return format("audio-%lld-%lld", time(nullptr),
-		              boost::interprocess::ipcdetail::get_current_process_id());
+		if (persistent)
+			return dir / ("audio-" + cache_key + ".pcm");
+		return dir / format("audio-%lld-%lld", time(nullptr),
+		                    boost::interprocess::ipcdetail::get_current_process_id());
+	}
+
+	void Decode(int worker, AudioProvider *src) {
+		const int64_t block_size = scheduler.BlockSize();
+		std::vector<char> buffer;
+		while (!cancelled) {
+			const int64_t i = scheduler.Next(worker);
+			if (i < 0) break;
+			AGI_TRACE_SCOPE("audio/decode");
+			const int64_t start = i * block_size;
+			const int64_t count = std::min(block_size, num_samples - start);
+			const int64_t bytes = count * FrameSize();
+
+			// Decode straight into the mapping when there's only one thread
+			if (extra_sources.empty()) {
+				char *dst = file.write(start * FrameSize(), bytes);
+				src->GetAudio(dst, start, count);
+				if (peaks)
+					peaks->AddSamples(reinterpret_cast<const int16_t *>(dst), start, count);
+			}
+			else {
+				buffer.resize(bytes);
+				src->GetAudio(buffer.data(), start, count);
+				if (peaks)
+					peaks->AddSamples(reinterpret_cast<const int16_t *>(buffer.data()), start, count);
+				std::unique_lock<std::mutex> lock(write_mutex, std::defer_lock);
+				if (!mapped_views_are_stable())
+					lock.lock();
+				memcpy(file.write(start * FrameSize(), bytes), buffer.data(), bytes);
+			}
+			scheduler.MarkDecoded(i);
+			decoded_samples += count;
+		}
+
+		// Whichever thread finishes last marks the cache file as complete
+		if (--running_decoders == 0 && persistent && !cancelled) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			memcpy(file.write(DataSize(), cache_magic_size), cache_magic, cache_magic_size);
+		}
+	}
+
+	/// Build the peak index for a cache file left by a previous session
+	void ScanPeaks() {
+		const int64_t block_size = scheduler.BlockSize();
+		std::vector<char> buffer(static_cast<size_t>(block_size * FrameSize()));
+		file.advise(access_pattern::sequential);
+		for (int64_t start = 0; start < num_samples && !cancelled; start += block_size) {
+			const int64_t count = std::min(block_size, num_samples - start);
+			file.read_ahead(start * FrameSize());
+			memcpy(buffer.data(), file.read(start * FrameSize(), count * FrameSize()), count * FrameSize());
+			peaks->AddSamples(reinterpret_cast<const int16_t *>(buffer.data()), start, count);
+		}
+		file.advise(access_pattern::normal);
 	}
 
 public:
-	HDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir)
+	HDAudioProvider(std::unique_ptr<AudioProvider> src, std::vector<std::unique_ptr<AudioProvider>> extra, agi::fs::path const& dir, std::string const& cache_key)
 	: AudioProviderWrapper(std::move(src))
-	, file(dir / CacheFilename(dir), num_samples * bytes_per_sample)
+	, persistent(!cache_key.empty())
+	, file(CacheFilename(dir, cache_key), DataSize() + (persistent ? cache_magic_size : 0), persistent)
+	, extra_sources(std::move(extra))
+	, scheduler(num_samples, 65536, static_cast<int>(extra_sources.size()) + 1)
 	{
 		decoded_samples = 0;
-		decoder = std::thread([&] {
-			int64_t block = 65536;
-			for (int64_t i = 0; i < num_samples; i += block) {
-				if (cancelled) break;
-				block = std::min(block, num_samples - i);
-				source->GetAudio(file.write(i * bytes_per_sample, block * bytes_per_sample), i, block);
-				decoded_samples += block;
-			}
-		});
+		if (bytes_per_sample == 2 && channels == 1 && !float_samples)
+			peaks = agi::make_unique<AudioPeakIndex>(num_samples, sample_rate);
+
+		if (complete && !memcmp(file.read(DataSize(), cache_magic_size), cache_magic, cache_magic_size)) {
+			// Bump the modification time so that the cache cleaner treats
+			// this file as recently used
+			fs::Touch(dir / ("audio-" + cache_key + ".pcm"));
+			for (int64_t i = 0; i < scheduler.BlockCount(); ++i)
+				scheduler.MarkDecoded(i);
+			decoded_samples = num_samples;
+			if (peaks)
+				decoders.emplace_back(&HDAudioProvider::ScanPeaks, this);
+			return;
+		}
+
+		running_decoders = static_cast<int>(extra_sources.size()) + 1;
+		decoders.emplace_back(&HDAudioProvider::Decode, this, 0, source.get());
+		for (size_t i = 0; i < extra_sources.size(); ++i)
+			decoders.emplace_back(&HDAudioProvider::Decode, this, i + 1, extra_sources[i].get());
+	}
+
+	bool IsDecoded(int64_t start, int64_t count) const override {
+		return scheduler.IsDecoded(start, count);
+	}
+
+	void Prefetch(int64_t start) const override {
+		scheduler.Request(start);
+		// A cache file from a previous session may not be in memory yet
+		if (complete)
+			file.read_ahead(start * FrameSize());
 	}
 
+	bool SupportsConcurrentReads() const override { return mapped_views_are_stable(); }
+
+	AudioPeakIndex *GetPeakIndex() const override { return peaks.get(); }
+
 	~HDAudioProvider() {
 		cancelled = true;
-		decoder.join();
+		for (auto& decoder : decoders)
+			decoder.join();
 	}
 };
 }
 
 namespace agi {
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir) {
-	return agi::make_unique<HDAudioProvider>(std::move(src), dir);
+	return agi::make_unique<HDAudioProvider>(std::move(src), std::vector<std::unique_ptr<AudioProvider>>(), dir, "");
+}
+
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, std::string const& cache_key) {
+	return agi::make_unique<HDAudioProvider>(std::move(src), std::vector<std::unique_ptr<AudioProvider>>(), dir, cache_key);
+}
+
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, std::vector<std::unique_ptr<AudioProvider>> extra_sources, agi::fs::path const& dir, std::string const& cache_key) {
+	return agi::make_unique<HDAudioProvider>(std::move(src), std::move(extra_sources), dir, cache_key);
 }
 }
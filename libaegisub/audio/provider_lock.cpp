@@ -19,21 +19,100 @@
 #include <libaegisub/make_unique.h>
 
 #include <mutex>
+#include <vector>
 
 namespace {
+/// Maximum number of clones of the source to open for concurrent readers
+const size_t MaxReaders = 4;
+
 class LockAudioProvider final : public agi::AudioProviderWrapper {
-	mutable std::mutex mutex;
+	/// Is the source safe to read from multiple threads without locking?
+	bool concurrent;
+
+	/// Held while reading from the source itself
+	mutable std::mutex source_mutex;
+
+	/// Guards the reader pool
+	mutable std::mutex pool_mutex;
+	/// Clones of the source which aren't currently being read from
+	mutable std::vector<std::unique_ptr<AudioProvider>> idle_readers;
+	/// Total number of clones opened, including ones in use
+	mutable size_t reader_count = 0;
+	/// Set once cloning the source has failed so that it isn't retried
+	mutable bool clone_failed = false;
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
-		std::unique_lock<std::mutex> lock(mutex);
-		source->GetAudio(buf, start, count);
+		if (concurrent) {
+			source->GetAudio(buf, start, count);
+			return;
+		}
+
+		// Use the source itself if nobody else is
+		std::unique_lock<std::mutex> lock(source_mutex, std::try_to_lock);
+		if (lock.owns_lock()) {
+			source->GetAudio(buf, start, count);
+			return;
+		}
+
+		auto reader = AcquireReader();
+		if (!reader) {
+			lock.lock();
+			source->GetAudio(buf, start, count);
+			return;
+		}
+
+		reader->GetAudio(buf, start, count);
+
+		std::lock_guard<std::mutex> pool_lock(pool_mutex);
+		idle_readers.push_back(std::move(reader));
+	}
+
+	const void *ViewBuffer(int64_t start, int64_t count) const override {
+		return concurrent ? source->ViewAudio(start, count) : nullptr;
+	}
+
+	/// Get an idle clone of the source, opening a new one if there are none
+	/// @return The clone, or nullptr if the caller needs to wait for the source
+	std::unique_ptr<AudioProvider> AcquireReader() const {
+		{
+			std::lock_guard<std::mutex> pool_lock(pool_mutex);
+			if (!idle_readers.empty()) {
+				auto reader = std::move(idle_readers.back());
+				idle_readers.pop_back();
+				return reader;
+			}
+			if (clone_failed || reader_count >= MaxReaders)
+				return nullptr;
+			++reader_count;
+		}
+
+		// Opening a clone can be slow, so don't block the other readers
+		auto reader = source->Clone();
+		if (!reader) {
+			std::lock_guard<std::mutex> pool_lock(pool_mutex);
+			--reader_count;
+			clone_failed = true;
+		}
+		return reader;
 	}
 
 public:
 	LockAudioProvider(std::unique_ptr<AudioProvider> src)
 	: AudioProviderWrapper(std::move(src))
+	, concurrent(source->SupportsConcurrentReads())
 	{
 	}
+
+	bool SupportsConcurrentReads() const override { return true; }
+
+	int64_t GetDecodedSamples() const override { return source->GetDecodedSamples(); }
+	bool IsDecoded(int64_t start, int64_t count) const override { return source->IsDecoded(start, count); }
+	void Prefetch(int64_t start) const override { source->Prefetch(start); }
+	agi::AudioPeakIndex *GetPeakIndex() const override { return source->GetPeakIndex(); }
+
+	AudioProvider const& GetNativeProvider() const override {
+		return concurrent ? source->GetNativeProvider() : *this;
+	}
 };
 }
 
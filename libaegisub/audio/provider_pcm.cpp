@@ -59,6 +59,38 @@ class PCMAudioProvider : public AudioProvider {
 		ZeroFill(write_buf, count);
 	}
 
+	const void *ViewBuffer(int64_t start, int64_t count) const override {
+		if (!mapped_views_are_stable()) return nullptr;
+
+		auto bps = bytes_per_sample * channels;
+		uint64_t pos = 0;
+		for (auto ip : index_points) {
+			if (pos + ip.num_samples <= (uint64_t)start) {
+				pos += ip.num_samples;
+				continue;
+			}
+			// Can only be viewed in place if it's all in one data chunk
+			if (start + count > static_cast<int64_t>(pos + ip.num_samples))
+				return nullptr;
+			return file.read(ip.start_byte + (start - pos) * bps, count * bps);
+		}
+		return nullptr;
+	}
+
+	bool SupportsConcurrentReads() const override { return mapped_views_are_stable(); }
+
+	void Prefetch(int64_t start) const override {
+		auto bps = bytes_per_sample * channels;
+		uint64_t pos = 0;
+		for (auto ip : index_points) {
+			if (pos + ip.num_samples > (uint64_t)start) {
+				file.read_ahead(ip.start_byte + (start - pos) * bps);
+				return;
+			}
+			pos += ip.num_samples;
+		}
+	}
+
 protected:
 	mutable read_file_mapping file;
 	uint64_t file_pos = 0;
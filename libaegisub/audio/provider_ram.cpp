@@ -16,7 +16,12 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "decode_scheduler.h"
+
+#include "libaegisub/audio/peak_index.h"
+#include "libaegisub/cache_budget.h"
 #include "libaegisub/make_unique.h"
+#include "libaegisub/trace.h"
 
 #include <array>
 #include <boost/container/stable_vector.hpp>
@@ -34,63 +39,124 @@ class RAMAudioProvider final : public AudioProviderWrapper {
 #else
 	boost::container::stable_vector<std::array<char, CacheBlockSize>> blockcache;
 #endif
+	/// Additional sources for decoding in parallel
+	std::vector<std::unique_ptr<AudioProvider>> extra_sources;
+	/// Peaks of the decoded audio, if it's in the display format
+	std::unique_ptr<AudioPeakIndex> peaks;
+	AudioDecodeScheduler scheduler;
 	std::atomic<bool> cancelled = {false};
-	std::thread decoder;
+	std::vector<std::thread> decoders;
+	CacheBudget::Registration budget_registration;
+
+	/// Bytes per sample for all channels together
+	int FrameSize() const { return bytes_per_sample * channels; }
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override;
 
+	const void *ViewBuffer(int64_t start, int64_t count) const override {
+		const int64_t block_size = scheduler.BlockSize();
+		const int64_t i = start / block_size;
+		const int64_t offset = start % block_size;
+		if (offset + count > block_size || !scheduler.IsBlockDecoded(i))
+			return nullptr;
+		return &blockcache[i][offset * FrameSize()];
+	}
+
+	void Decode(int worker, AudioProvider *src) {
+		int64_t readsize = scheduler.BlockSize();
+		while (!cancelled) {
+			const int64_t i = scheduler.Next(worker);
+			if (i < 0) break;
+			AGI_TRACE_SCOPE("audio/decode");
+			auto actual_read = std::min<int64_t>(readsize, num_samples - i * readsize);
+			src->GetAudio(&blockcache[i][0], i * readsize, actual_read);
+			if (peaks)
+				peaks->AddSamples(reinterpret_cast<const int16_t *>(&blockcache[i][0]), i * readsize, actual_read);
+			scheduler.MarkDecoded(i);
+			decoded_samples += actual_read;
+		}
+	}
+
 public:
-	RAMAudioProvider(std::unique_ptr<AudioProvider> src)
+	RAMAudioProvider(std::unique_ptr<AudioProvider> src, std::vector<std::unique_ptr<AudioProvider>> extra)
 	: AudioProviderWrapper(std::move(src))
+	, extra_sources(std::move(extra))
+	, scheduler(num_samples, CacheBlockSize / FrameSize(), static_cast<int>(extra_sources.size()) + 1)
 	{
 		decoded_samples = 0;
 
 		try {
-			blockcache.resize((source->GetNumSamples() * source->GetBytesPerSample() + CacheBlockSize - 1) >> CacheBits);
+			blockcache.resize(scheduler.BlockCount());
 		}
 		catch (std::bad_alloc const&) {
 			throw AudioProviderError("Not enough memory available to cache in RAM");
 		}
+		if (bytes_per_sample == 2 && channels == 1 && !float_samples)
+			peaks = agi::make_unique<AudioPeakIndex>(num_samples, sample_rate);
 
-		decoder = std::thread([&] {
-			int64_t readsize = CacheBlockSize / source->GetBytesPerSample();
-			for (size_t i = 0; i < blockcache.size(); i++) {
-				if (cancelled) break;
-				auto actual_read = std::min<int64_t>(readsize, num_samples - i * readsize);
-				source->GetAudio(&blockcache[i][0], i * readsize, actual_read);
-				decoded_samples += actual_read;
-			}
+		// The whole file has to stay in memory, so this is only registered
+		// to be reported and counted against the limit
+		const size_t size = blockcache.size() * CacheBlockSize;
+		budget_registration = CacheBudget::Global().Register(CacheBudget::Cache{
+			"Audio (RAM)",
+			[=] { return size; },
+			[] { return CacheBudget::NotEvictable; },
+			[] { }
 		});
+
+		decoders.emplace_back(&RAMAudioProvider::Decode, this, 0, source.get());
+		for (size_t i = 0; i < extra_sources.size(); ++i)
+			decoders.emplace_back(&RAMAudioProvider::Decode, this, i + 1, extra_sources[i].get());
+	}
+
+	bool IsDecoded(int64_t start, int64_t count) const override {
+		return scheduler.IsDecoded(start, count);
 	}
 
+	void Prefetch(int64_t start) const override {
+		scheduler.Request(start);
+	}
+
+	bool SupportsConcurrentReads() const override { return true; }
+
+	AudioPeakIndex *GetPeakIndex() const override { return peaks.get(); }
+
 	~RAMAudioProvider() {
+		budget_registration.Unregister();
 		cancelled = true;
-		decoder.join();
+		for (auto& decoder : decoders)
+			decoder.join();
 	}
 };
 
 void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const {
 	auto charbuf = static_cast<char *>(buf);
-	for (int64_t bytes_remaining = count * bytes_per_sample; bytes_remaining; ) {
-		if (start >= decoded_samples) {
-			memset(charbuf, 0, bytes_remaining);
-			break;
-		}
+	const int64_t block_size = scheduler.BlockSize();
+	while (count > 0) {
+		const int64_t i = start / block_size;
+		const int64_t offset = start % block_size;
+		const int64_t read_count = std::min(count, block_size - offset);
+		const size_t read_size = static_cast<size_t>(read_count * FrameSize());
 
-		const int i = (start * bytes_per_sample) >> CacheBits;
-		const int start_offset = (start * bytes_per_sample) & (CacheBlockSize-1);
-		const int read_size = std::min<int>(bytes_remaining, CacheBlockSize - start_offset);
-
-		memcpy(charbuf, &blockcache[i][start_offset], read_size);
+		if (scheduler.IsBlockDecoded(i))
+			memcpy(charbuf, &blockcache[i][offset * FrameSize()], read_size);
+		else {
+			scheduler.Request(start);
+			memset(charbuf, 0, read_size);
+		}
 		charbuf += read_size;
-		bytes_remaining -= read_size;
-		start += read_size / bytes_per_sample;
+		start += read_count;
+		count -= read_count;
 	}
 }
 }
 
 namespace agi {
 std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src) {
-	return agi::make_unique<RAMAudioProvider>(std::move(src));
+	return agi::make_unique<RAMAudioProvider>(std::move(src), std::vector<std::unique_ptr<AudioProvider>>());
+}
+
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src, std::vector<std::unique_ptr<AudioProvider>> extra_sources) {
+	return agi::make_unique<RAMAudioProvider>(std::move(src), std::move(extra_sources));
 }
 }
@@ -0,0 +1,76 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/buffer_lines.h"
+
+#include "libaegisub/charset_conv.h"
+#include "libaegisub/simd.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstring>
+
+#if defined(AGI_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+#ifdef AGI_SSE2
+inline int first_set_bit(unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+#endif
+}
+
+namespace agi {
+const char *find_newline(const char *begin, const char *end) {
+	// Lines in subtitle files are mostly short, so check 16 bytes at a time
+	// rather than paying memchr's setup cost for each line
+#if defined(AGI_SSE2)
+	const __m128i lf = _mm_set1_epi8('\n');
+	for (; end - begin >= 16; begin += 16) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+		if (int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf)))
+			return begin + first_set_bit(mask);
+	}
+#elif defined(AGI_NEON)
+	const uint8x16_t lf = vdupq_n_u8('\n');
+	for (; end - begin >= 16; begin += 16) {
+		const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(begin));
+		if (vmaxvq_u8(vceqq_u8(chunk, lf))) break;
+	}
+#endif
+	auto nl = static_cast<const char *>(memchr(begin, '\n', end - begin));
+	return nl ? nl : end;
+}
+
+buffer_lines::buffer_lines(const char *begin, const char *end, std::string const& encoding)
+: b(begin ? begin : "")
+, e(begin ? end : b)
+{
+	if (boost::iequals(encoding, "utf-8")) return;
+
+	charset::IconvWrapper conv(encoding.c_str(), "utf-8");
+	conv.Convert(b, e - b, converted);
+	b = converted.data();
+	e = b + converted.size();
+}
+}
@@ -0,0 +1,127 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/cache_budget.h"
+
+#include <algorithm>
+
+namespace agi {
+const uint64_t CacheBudget::NotEvictable;
+
+CacheBudget::Registration& CacheBudget::Registration::operator=(Registration&& other)
+{
+	if (this != &other) {
+		Unregister();
+		budget = other.budget;
+		id = other.id;
+		other.budget = nullptr;
+	}
+	return *this;
+}
+
+void CacheBudget::Registration::Unregister()
+{
+	if (budget)
+		budget->Unregister(id);
+	budget = nullptr;
+}
+
+CacheBudget::CacheBudget(size_t limit)
+: limit(limit)
+{
+}
+
+CacheBudget& CacheBudget::Global()
+{
+	static CacheBudget budget;
+	return budget;
+}
+
+uint64_t CacheBudget::Tick()
+{
+	static std::atomic<uint64_t> clock{0};
+	return ++clock;
+}
+
+CacheBudget::Registration CacheBudget::Register(Cache cache)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	caches.push_back(Entry{++next_id, std::move(cache)});
+	return Registration(this, next_id);
+}
+
+void CacheBudget::Unregister(uint64_t id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	caches.erase(remove_if(begin(caches), end(caches), [=](Entry const& e) { return e.id == id; }), end(caches));
+}
+
+void CacheBudget::SetLimit(size_t new_limit)
+{
+	limit = new_limit;
+	Trim();
+}
+
+void CacheBudget::Trim()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	size_t total = 0;
+	for (auto const& entry : caches)
+		total += entry.cache.size();
+
+	const size_t max_size = limit;
+	while (total > max_size) {
+		Cache *victim = nullptr;
+		uint64_t victim_age = NotEvictable;
+		for (auto& entry : caches) {
+			uint64_t age = entry.cache.oldest();
+			if (age < victim_age) {
+				victim = &entry.cache;
+				victim_age = age;
+			}
+		}
+		if (!victim) break;
+
+		const size_t before = victim->size();
+		victim->evict();
+		const size_t after = victim->size();
+		// A cache which says it has something to evict but doesn't free
+		// anything would otherwise make this loop forever
+		if (after >= before) break;
+		total -= before - after;
+	}
+}
+
+size_t CacheBudget::GetTotalSize()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t total = 0;
+	for (auto const& entry : caches)
+		total += entry.cache.size();
+	return total;
+}
+
+std::vector<CacheBudget::Usage> CacheBudget::GetUsage()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<Usage> usage;
+	usage.reserve(caches.size());
+	for (auto const& entry : caches)
+		usage.push_back(Usage{entry.cache.name, entry.cache.size()});
+	return usage;
+}
+}
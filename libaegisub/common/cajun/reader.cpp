@@ -9,7 +9,10 @@ Author: Terry Caton
 #include "libaegisub/cajun/reader.h"
 
 #include <boost/interprocess/streams/bufferstream.hpp>
-#include <cassert>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
 
 /*
 
@@ -20,332 +23,299 @@ TODO:
 */
 
 namespace json {
-/// Wrapper around istream to keep track of document/line offsets
-class Reader::InputStream {
-	std::istream& m_iStr;
-	Location m_Location;
-public:
-	InputStream(std::istream& iStr) : m_iStr(iStr) { }
-
-	int Get() {
-		assert(!m_iStr.eof());
-		int c = m_iStr.get();
-
-		++m_Location.m_nDocOffset;
-		if (c == '\n') {
-			++m_Location.m_nLine;
-			m_Location.m_nLineOffset = 0;
-		}
-		else {
-			++m_Location.m_nLineOffset;
-		}
-
-		return c;
+/// Recursive descent parser over an in-memory document
+class Reader::Parser {
+	const char *const m_pBegin;
+	const char *const m_pEnd;
+	const char *m_pPos;
+	Handler *m_pHandler = nullptr;
+
+	/// Buffer for the current string, reused so that reading a string
+	/// usually doesn't allocate
+	std::string m_sScratch;
+
+	bool EOS() const {
+		// A nul ends the document
+		return m_pPos == m_pEnd || *m_pPos == 0;
 	}
 
-	int Peek() {
-		assert(!m_iStr.eof());
-		return m_iStr.peek();
+	void EatWhiteSpace() {
+		while (m_pPos != m_pEnd && ::isspace(static_cast<unsigned char>(*m_pPos)))
+			++m_pPos;
 	}
 
-	bool EOS() {
-		// libc++ doesn't set eof when a peek fails
-		return m_iStr.peek() == EOF || m_iStr.eof();
+	[[noreturn]] void ScanError(std::string const& sMessage) const {
+		throw ScanException(sMessage, LocationOf(m_pPos));
 	}
 
-	Location const& GetLocation() const { return m_Location; }
-};
-
-class Reader::TokenStream {
-	Tokens const& m_Tokens;
-	Tokens::const_iterator m_itCurrent;
-
-public:
-	TokenStream(Tokens const& tokens) : m_Tokens(tokens), m_itCurrent(tokens.begin())
-	{ }
-
-	Token const& Peek() {
-		assert(!EOS());
-		return *m_itCurrent;
+	[[noreturn]] void ParseError(std::string const& sMessage, const char *pTokenBegin) const {
+		throw ParseException(sMessage, LocationOf(pTokenBegin), LocationOf(m_pPos));
 	}
-	Token const& Get() {
-		assert(!EOS());
-		return *m_itCurrent++;
-	}
-
-	bool EOS() const { return m_itCurrent == m_Tokens.end(); }
-};
 
-void Reader::Read(UnknownElement& unknown, std::istream& istr) {
-	Reader reader;
+	[[noreturn]] void UnexpectedToken() {
+		const char *pTokenBegin = m_pPos;
+		if (EOS())
+			ParseError("Unexpected end of token stream", pTokenBegin);
+		++m_pPos;
+		ParseError(std::string("Unexpected token: ") + *pTokenBegin, pTokenBegin);
+	}
 
-	Tokens tokens;
-	InputStream inputStream(istr);
-	reader.Scan(tokens, inputStream);
+	/// Skip whitespace and then consume c if it's next
+	bool Match(char c) {
+		EatWhiteSpace();
+		if (EOS() || *m_pPos != c) return false;
+		++m_pPos;
+		return true;
+	}
 
-	TokenStream tokenStream(tokens);
-	unknown = reader.Parse(tokenStream);
+	void MatchExpected(char c) {
+		if (!Match(c))
+			UnexpectedToken();
+	}
 
-	if (!tokenStream.EOS()) {
-		Token const& token = tokenStream.Peek();
-		throw ParseException("Expected End of token stream; found " + token.sValue, token.locBegin, token.locEnd);
+	void MatchExpectedString(const char *sExpected) {
+		for (const char *c = sExpected; *c; ++c) {
+			if (EOS() || *m_pPos != *c)
+				ScanError(std::string("Expected string: ") + sExpected);
+			++m_pPos;
+		}
 	}
-}
 
-void Reader::Scan(Tokens& tokens, InputStream& inputStream) {
-	while (EatWhiteSpace(inputStream), !inputStream.EOS()) {
-		// if all goes well, we'll create a token each pass
-		Token token;
-		token.locBegin = inputStream.GetLocation();
-
-		char c = inputStream.Peek();
-		switch (c) {
-			case '{':
-				token.sValue = c;
-				inputStream.Get();
-				token.nType = Token::TOKEN_OBJECT_BEGIN;
-				break;
+	void ParseValue() {
+		EatWhiteSpace();
+		if (EOS())
+			ParseError("Unexpected end of token stream", m_pPos);
 
-			case '}':
-				token.sValue = c;
-				inputStream.Get();
-				token.nType = Token::TOKEN_OBJECT_END;
-				break;
-
-			case '[':
-				token.sValue = c;
-				inputStream.Get();
-				token.nType = Token::TOKEN_ARRAY_BEGIN;
-				break;
+		switch (*m_pPos) {
+			case '{': return ParseObject();
+			case '[': return ParseArray();
+			case '"': return m_pHandler->String(ParseString());
+			case 't':
+				MatchExpectedString("true");
+				return m_pHandler->Boolean(true);
+			case 'f':
+				MatchExpectedString("false");
+				return m_pHandler->Boolean(false);
+			case 'n':
+				MatchExpectedString("null");
+				return m_pHandler->Null();
+			case '-': case '0': case '1': case '2': case '3': case '4':
+			case '5': case '6': case '7': case '8': case '9':
+				return ParseNumber();
+			case '}': case ']': case ',': case ':':
+				UnexpectedToken();
+			default:
+				ScanError(std::string("Unexpected character in stream: ") + *m_pPos);
+		}
+	}
 
-			case ']':
-				token.sValue = c;
-				inputStream.Get();
-				token.nType = Token::TOKEN_ARRAY_END;
-				break;
+	void ParseObject() {
+		MatchExpected('{');
+		m_pHandler->StartObject();
 
-			case ',':
-				token.sValue = c;
-				inputStream.Get();
-				token.nType = Token::TOKEN_NEXT_ELEMENT;
-				break;
+		while (!Match('}')) {
+			EatWhiteSpace();
+			if (EOS() || *m_pPos != '"')
+				UnexpectedToken();
+			m_pHandler->Key(ParseString());
 
-			case ':':
-				token.sValue = c;
-				inputStream.Get();
-				token.nType = Token::TOKEN_MEMBER_ASSIGN;
-				break;
+			MatchExpected(':');
+			ParseValue();
 
-			case '"':
-				MatchString(token.sValue, inputStream);
-				token.nType = Token::TOKEN_STRING;
+			// A trailing comma before the closing brace is allowed
+			if (!Match(',')) {
+				MatchExpected('}');
 				break;
+			}
+		}
 
-			case '-':
-			case '0':
-			case '1':
-			case '2':
-			case '3':
-			case '4':
-			case '5':
-			case '6':
-			case '7':
-			case '8':
-			case '9':
-				MatchNumber(token.sValue, inputStream);
-				token.nType = Token::TOKEN_NUMBER;
-				break;
+		m_pHandler->EndObject();
+	}
 
-			case 't':
-				token.sValue = "true";
-				MatchExpectedString(token.sValue, inputStream);
-				token.nType = Token::TOKEN_BOOLEAN;
-				break;
+	void ParseArray() {
+		MatchExpected('[');
+		m_pHandler->StartArray();
 
-			case 'f':
-				token.sValue = "false";
-				MatchExpectedString(token.sValue, inputStream);
-				token.nType = Token::TOKEN_BOOLEAN;
-				break;
+		while (!Match(']')) {
+			ParseValue();
 
-			case 'n':
-				token.sValue = "null";
-				MatchExpectedString(token.sValue, inputStream);
-				token.nType = Token::TOKEN_NULL;
+			if (!Match(',')) {
+				MatchExpected(']');
 				break;
-
-			case 0:
-				return;
-
-			default:
-				throw ScanException(std::string("Unexpected character in stream: ") + c, inputStream.GetLocation());
+			}
 		}
 
-		token.locEnd = inputStream.GetLocation();
-		tokens.push_back(token);
-	}
-}
-
-void Reader::EatWhiteSpace(InputStream& inputStream) {
-	while (!inputStream.EOS() && ::isspace(inputStream.Peek()))
-		inputStream.Get();
-}
-
-void Reader::MatchExpectedString(std::string const& sExpected, InputStream& inputStream) {
-	for (char c : sExpected) {
-		if (inputStream.EOS() || inputStream.Get() != c)
-			throw ScanException("Expected string: " + sExpected, inputStream.GetLocation());
+		m_pHandler->EndArray();
 	}
-}
-
-void Reader::MatchString(std::string& string, InputStream& inputStream) {
-	MatchExpectedString("\"", inputStream);
 
-	while (!inputStream.EOS() && inputStream.Peek() != '"') {
-		char c = inputStream.Get();
-
-		// escape?
-		if (c == '\\' && !inputStream.EOS()) { // shouldn't have reached the end yet
-			c = inputStream.Get();
+	std::string const& ParseString() {
+		++m_pPos; // opening quote, already checked by the caller
+		m_sScratch.clear();
+
+		for (;;) {
+			// Copy everything up to the next quote or escape at once
+			const char *pRun = m_pPos;
+			while (m_pPos != m_pEnd && *m_pPos != '"' && *m_pPos != '\\')
+				++m_pPos;
+			m_sScratch.append(pRun, m_pPos);
+
+			if (m_pPos == m_pEnd)
+				ScanError("Expected string: \"");
+			if (*m_pPos++ == '"')
+				return m_sScratch;
+
+			if (m_pPos == m_pEnd)
+				ScanError("Expected string: \"");
+			char c = *m_pPos++;
 			switch (c) {
-				case '/':  string.push_back('/');  break;
-				case '"':  string.push_back('"');  break;
-				case '\\': string.push_back('\\'); break;
-				case 'b':  string.push_back('\b'); break;
-				case 'f':  string.push_back('\f'); break;
-				case 'n':  string.push_back('\n'); break;
-				case 'r':  string.push_back('\r'); break;
-				case 't':  string.push_back('\t'); break;
+				case '/':  m_sScratch.push_back('/');  break;
+				case '"':  m_sScratch.push_back('"');  break;
+				case '\\': m_sScratch.push_back('\\'); break;
+				case 'b':  m_sScratch.push_back('\b'); break;
+				case 'f':  m_sScratch.push_back('\f'); break;
+				case 'n':  m_sScratch.push_back('\n'); break;
+				case 'r':  m_sScratch.push_back('\r'); break;
+				case 't':  m_sScratch.push_back('\t'); break;
 				case 'u':  // TODO: what do we do with this?
 				default:
-					throw ScanException(std::string("Unrecognized escape sequence found in string: \\") + c, inputStream.GetLocation());
+					ScanError(std::string("Unrecognized escape sequence found in string: \\") + c);
 			}
 		}
-		else {
-			string.push_back(c);
-		}
 	}
 
-	// eat the last '"' that we hopefully just peeked
-	MatchExpectedString("\"", inputStream);
-}
-
-void Reader::MatchNumber(std::string& sNumber, InputStream& inputStream) {
-	const char numericChars[] = "0123456789.eE-+";
-	while (!inputStream.EOS() && std::find(numericChars, std::end(numericChars), inputStream.Peek()) != std::end(numericChars))
-		sNumber.push_back(inputStream.Get());
-}
-
-UnknownElement Reader::Parse(Reader::TokenStream& tokenStream) {
-	if (tokenStream.EOS())
-		throw ParseException("Unexpected end of token stream", Location(), Location()); // nowhere to point to
-
-	Token const& token = tokenStream.Peek();
-	switch (token.nType) {
-		case Token::TOKEN_OBJECT_BEGIN: return ParseObject(tokenStream);
-		case Token::TOKEN_ARRAY_BEGIN:  return ParseArray(tokenStream);
-		case Token::TOKEN_STRING:       return ParseString(tokenStream);
-		case Token::TOKEN_NUMBER:       return ParseNumber(tokenStream);
-		case Token::TOKEN_BOOLEAN:      return ParseBoolean(tokenStream);
-		case Token::TOKEN_NULL:         return ParseNull(tokenStream);
-		default:
-			throw ParseException("Unexpected token: " + token.sValue, token.locBegin, token.locEnd);
-	}
-}
-
-UnknownElement Reader::ParseObject(Reader::TokenStream& tokenStream) {
-	MatchExpectedToken(Token::TOKEN_OBJECT_BEGIN, tokenStream);
-
-	Object object;
-
-	while (!tokenStream.EOS() && tokenStream.Peek().nType != Token::TOKEN_OBJECT_END) {
-		// first the member name. save the token in case we have to throw an exception
-		Token const& tokenName = tokenStream.Peek();
-		std::string const& name = MatchExpectedToken(Token::TOKEN_STRING, tokenStream);
-
-		if (object.count(name))
-			throw ParseException("Duplicate object member token: " + name, tokenName.locBegin, tokenName.locEnd);
+	void ParseNumber() {
+		const char *pTokenBegin = m_pPos;
+		const char numericChars[] = "0123456789.eE-+";
+		while (m_pPos != m_pEnd && *m_pPos && std::find(numericChars, std::end(numericChars) - 1, *m_pPos) != std::end(numericChars) - 1)
+			++m_pPos;
+
+		// Integers are by far the most common, so try them first without
+		// going through a stream
+		const char *p = pTokenBegin;
+		bool negative = *p == '-';
+		if (negative) ++p;
+		if (p != m_pPos) {
+			const uint64_t limit = negative ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX);
+			uint64_t value = 0;
+			for (; p != m_pPos && *p >= '0' && *p <= '9'; ++p) {
+				unsigned digit = *p - '0';
+				if (value > (limit - digit) / 10) break;
+				value = value * 10 + digit;
+			}
+			if (p == m_pPos)
+				return m_pHandler->Integer(negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value));
+		}
 
-		// ...then the key/value separator...
-		MatchExpectedToken(Token::TOKEN_MEMBER_ASSIGN, tokenStream);
+		boost::interprocess::ibufferstream iStr(pTokenBegin, m_pPos - pTokenBegin);
+		double dValue;
+		iStr >> dValue;
 
-		// ...then the value itself (can be anything).
-		object[name] = Parse(tokenStream);
+		// If there's still stuff left in the token then it's malformed
+		if (iStr.fail() || iStr.peek() != EOF)
+			ParseError("Unexpected character in NUMBER token: " + std::string(pTokenBegin, m_pPos), pTokenBegin);
 
-		if (!tokenStream.EOS() && tokenStream.Peek().nType != Token::TOKEN_OBJECT_END)
-			MatchExpectedToken(Token::TOKEN_NEXT_ELEMENT, tokenStream);
+		m_pHandler->Double(dValue);
 	}
 
-	MatchExpectedToken(Token::TOKEN_OBJECT_END, tokenStream);
-
-	return std::move(object);
-}
+public:
+	Parser(const char *pBegin, const char *pEnd)
+	: m_pBegin(pBegin), m_pEnd(pEnd), m_pPos(pBegin)
+	{ }
 
-UnknownElement Reader::ParseArray(Reader::TokenStream& tokenStream) {
-	MatchExpectedToken(Token::TOKEN_ARRAY_BEGIN, tokenStream);
+	/// Compute the line and column of a position in the document. Only
+	/// needed for errors, so it isn't tracked while reading.
+	Location LocationOf(const char *pPos) const {
+		Location loc;
+		for (const char *p = m_pBegin; p != pPos; ++p) {
+			++loc.m_nDocOffset;
+			if (*p == '\n') {
+				++loc.m_nLine;
+				loc.m_nLineOffset = 0;
+			}
+			else
+				++loc.m_nLineOffset;
+		}
+		return loc;
+	}
 
-	Array array;
+	Location Where() const { return LocationOf(m_pPos); }
 
-	while (!tokenStream.EOS() && tokenStream.Peek().nType != Token::TOKEN_ARRAY_END) {
-		array.push_back(Parse(tokenStream));
+	void Parse(Handler& handler) {
+		m_pHandler = &handler;
+		ParseValue();
 
-		if (!tokenStream.EOS() && tokenStream.Peek().nType != Token::TOKEN_ARRAY_END)
-			MatchExpectedToken(Token::TOKEN_NEXT_ELEMENT, tokenStream);
+		EatWhiteSpace();
+		if (!EOS()) {
+			const char *pTokenBegin = m_pPos++;
+			ParseError(std::string("Expected End of token stream; found ") + *pTokenBegin, pTokenBegin);
+		}
 	}
+};
 
-	MatchExpectedToken(Token::TOKEN_ARRAY_END, tokenStream);
-
-	return std::move(array);
-}
+/// Handler which builds an UnknownElement tree
+class Reader::DomBuilder final : public Reader::Handler {
+	Parser const& m_parser;
+	UnknownElement& m_root;
 
-UnknownElement Reader::ParseString(Reader::TokenStream& tokenStream) {
-	return MatchExpectedToken(Token::TOKEN_STRING, tokenStream);
-}
+	/// Containers currently being read, and whether each is an array
+	std::vector<std::pair<UnknownElement *, bool>> m_stack;
+	std::string m_sKey;
 
-UnknownElement Reader::ParseNumber(Reader::TokenStream& tokenStream) {
-	Token const& currentToken = tokenStream.Peek(); // might need this later for throwing exception
-	std::string const& sValue = MatchExpectedToken(Token::TOKEN_NUMBER, tokenStream);
+	UnknownElement& Next() {
+		if (m_stack.empty())
+			return m_root;
 
-	// First try to parse it as an int
-	boost::interprocess::ibufferstream iStr(sValue.data(), sValue.size());
-	int64_t iValue;
-	iStr >> iValue;
+		if (m_stack.back().second) {
+			Array& array = *m_stack.back().first;
+			array.emplace_back();
+			return array.back();
+		}
 
-	// If the entire token was consumed then it's not a double
-	if (iStr.eof())
-		return iValue;
+		Object& object = *m_stack.back().first;
+		auto it = object.lower_bound(m_sKey);
+		if (it != object.end() && it->first == m_sKey) {
+			Location loc = m_parser.Where();
+			throw ParseException("Duplicate object member token: " + m_sKey, loc, loc);
+		}
+		return object.emplace_hint(it, m_sKey, UnknownElement())->second;
+	}
 
-	// Try again as a double
-	iStr.seekg(0, std::ios::beg);
-	double dValue;
-	iStr >> dValue;
+	void Set(UnknownElement value) { Next() = std::move(value); }
 
-	// If there's still stuff left in the token then it's malformed
-	if (!iStr.eof())
-		throw ParseException(std::string("Unexpected character in NUMBER token: ") + (char)iStr.peek(),
-			currentToken.locBegin, currentToken.locEnd);
+	void Push(UnknownElement value, bool is_array) {
+		UnknownElement& element = Next();
+		element = std::move(value);
+		m_stack.emplace_back(&element, is_array);
+	}
 
-	return dValue;
-}
+public:
+	DomBuilder(Parser const& parser, UnknownElement& root) : m_parser(parser), m_root(root) { }
+
+	void StartObject() override { Push(Object(), false); }
+	void Key(std::string const& key) override { m_sKey = key; }
+	void EndObject() override { m_stack.pop_back(); }
+	void StartArray() override { Push(Array(), true); }
+	void EndArray() override { m_stack.pop_back(); }
+	void String(std::string const& value) override { Set(value); }
+	void Integer(int64_t value) override { Set(value); }
+	void Double(double value) override { Set(value); }
+	void Boolean(bool value) override { Set(value); }
+	void Null() override { Set(json::Null()); }
+};
 
-UnknownElement Reader::ParseBoolean(Reader::TokenStream& tokenStream) {
-	return MatchExpectedToken(Token::TOKEN_BOOLEAN, tokenStream) == "true";
+void Reader::Read(UnknownElement& unknown, std::istream& istr) {
+	std::string buffer{std::istreambuf_iterator<char>(istr), std::istreambuf_iterator<char>()};
+	Read(unknown, buffer.data(), buffer.data() + buffer.size());
 }
 
-UnknownElement Reader::ParseNull(Reader::TokenStream& tokenStream) {
-	MatchExpectedToken(Token::TOKEN_NULL, tokenStream);
-	return Null();
+void Reader::Read(UnknownElement& unknown, const char *begin, const char *end) {
+	Parser parser(begin, end);
+	DomBuilder builder(parser, unknown);
+	parser.Parse(builder);
 }
 
-std::string const& Reader::MatchExpectedToken(Token::Type nExpected, Reader::TokenStream& tokenStream) {
-	if (tokenStream.EOS())
-		throw ParseException("Unexpected End of token stream", Location(), Location()); // nowhere to point to
-
-	Token const& token = tokenStream.Get();
-	if (token.nType != nExpected)
-		throw ParseException("Unexpected token: " + token.sValue, token.locBegin, token.locEnd);
-
-	return token.sValue;
+void Reader::Read(Handler& handler, const char *begin, const char *end) {
+	Parser(begin, end).Parse(handler);
 }
 
 }
@@ -17,84 +17,143 @@
 #include "libaegisub/cajun/writer.h"
 
 #include <cmath>
-#include <iomanip>
+#include <cstdio>
 
 namespace agi {
-void JsonWriter::Visit(json::Array const& array) {
-	if (array.empty()) {
-		ostr << "[]";
+void JsonBufferWriter::Separator() {
+	if (after_key) {
+		after_key = false;
 		return;
 	}
+	if (!depth) return;
 
-	indent += '\t';
-	ostr << "[\n";
-
-	bool first = true;
-	for (auto const& entry : array) {
-		if (!first) ostr << ",\n";
-		first = false;
+	buffer += empty ? "\n" : ",\n";
+	buffer += indent;
+	empty = false;
+}
 
-		ostr << indent;
-		Visit(entry);
+void JsonBufferWriter::Escaped(std::string const& str) {
+	buffer += '"';
+
+	// Append the runs of characters which don't need escaping at once
+	const char *run = str.data(), *end = str.data() + str.size();
+	for (const char *c = run; c != end; ++c) {
+		const char *escape;
+		switch (*c) {
+			case '"':  escape = "\\\""; break;
+			case '\\': escape = "\\\\"; break;
+			case '\b': escape = "\\b";  break;
+			case '\f': escape = "\\f";  break;
+			case '\n': escape = "\\n";  break;
+			case '\r': escape = "\\r";  break;
+			case '\t': escape = "\\t";  break;
+			default: continue;
+		}
+		buffer.append(run, c);
+		buffer += escape;
+		run = c + 1;
 	}
+	buffer.append(run, end);
 
-	indent.pop_back();
-	ostr << '\n' << indent << ']';
+	buffer += '"';
 }
 
-void JsonWriter::Visit(json::Object const& object) {
-	if (object.empty()) {
-		ostr << "{}";
-		return;
+void JsonBufferWriter::StartObject() {
+	Separator();
+	buffer += '{';
+	indent += '\t';
+	++depth;
+	empty = true;
+}
+
+void JsonBufferWriter::EndObject() {
+	indent.pop_back();
+	--depth;
+	if (!empty) {
+		buffer += '\n';
+		buffer += indent;
 	}
+	buffer += '}';
+	empty = false;
+}
 
+void JsonBufferWriter::StartArray() {
+	Separator();
+	buffer += '[';
 	indent += '\t';
-	ostr << "{\n";
-
-	bool first = true;
-	for (auto const& entry : object) {
-		if (!first) ostr << ",\n";
-		first = false;
+	++depth;
+	empty = true;
+}
 
-		ostr << indent;
-		Visit(entry.first);
-		ostr << " : ";
-		Visit(entry.second);
+void JsonBufferWriter::EndArray() {
+	indent.pop_back();
+	--depth;
+	if (!empty) {
+		buffer += '\n';
+		buffer += indent;
 	}
+	buffer += ']';
+	empty = false;
+}
 
-	indent.pop_back();
-	ostr << '\n' << indent << '}';
+void JsonBufferWriter::Key(std::string const& key) {
+	Separator();
+	Escaped(key);
+	buffer += " : ";
+	after_key = true;
+}
+
+void JsonBufferWriter::String(std::string const& value) {
+	Separator();
+	Escaped(value);
+}
+
+void JsonBufferWriter::Integer(int64_t value) {
+	Separator();
+	buffer += std::to_string(value);
 }
 
-void JsonWriter::Visit(double d) {
-	ostr << std::setprecision(20) << d;
+void JsonBufferWriter::Double(double value) {
+	Separator();
+	char buf[64];
+	int len = snprintf(buf, sizeof buf, "%.20g", value);
+	buffer.append(buf, len);
 
 	double unused;
-	if (!std::modf(d, &unused))
-		ostr << ".0";
+	if (!std::modf(value, &unused))
+		buffer += ".0";
 }
 
-void JsonWriter::Visit(std::string const& str) {
-	ostr << '"';
-
-	for (auto c : str) {
-		switch (c) {
-			case '"':  ostr << "\\\""; break;
-			case '\\': ostr << "\\\\"; break;
-			case '\b': ostr << "\\b";  break;
-			case '\f': ostr << "\\f";  break;
-			case '\n': ostr << "\\n";  break;
-			case '\r': ostr << "\\r";  break;
-			case '\t': ostr << "\\t";  break;
-			default:   ostr << c;      break;
-		}
-	}
+void JsonBufferWriter::Boolean(bool value) {
+	Separator();
+	buffer += value ? "true" : "false";
+}
 
-	ostr << '"';
+void JsonBufferWriter::Null() {
+	Separator();
+	buffer += "null";
+}
+
+void JsonWriter::Visit(json::Array const& array) {
+	out.StartArray();
+	for (auto const& entry : array)
+		Visit(entry);
+	out.EndArray();
+}
+
+void JsonWriter::Visit(json::Object const& object) {
+	out.StartObject();
+	for (auto const& entry : object) {
+		out.Key(entry.first);
+		Visit(entry.second);
+	}
+	out.EndObject();
 }
 
-void JsonWriter::Visit(int64_t i) { ostr << i; }
-void JsonWriter::Visit(bool b) { ostr << (b ? "true" : "false"); }
-void JsonWriter::Visit(json::Null const&) { ostr << "null"; }
+void JsonWriter::Visit(double d) { out.Double(d); }
+void JsonWriter::Visit(std::string const& str) { out.String(str); }
+void JsonWriter::Visit(int64_t i) { out.Integer(i); }
+void JsonWriter::Visit(bool b) { out.Boolean(b); }
+void JsonWriter::Visit(json::Null const&) { out.Null(); }
 void JsonWriter::Visit(json::UnknownElement const& unknown) { unknown.Accept(*this); }
 }
@@ -22,6 +22,8 @@
 #include <unicode/uchar.h>
 #include <unicode/utf8.h>
 
+#include <cstdint>
+#include <cstring>
 #include <mutex>
 #include <unicode/brkiter.h>
 
@@ -52,9 +54,50 @@ icu::BreakIterator& get_break_iterator(const char *ptr, size_t len) {
 	return *bi;
 }
 
+/// Check if a range is entirely ASCII, eight bytes at a time
+bool is_ascii(const char *begin, const char *end) {
+	for (; end - begin >= 8; begin += 8) {
+		uint64_t chunk;
+		memcpy(&chunk, begin, sizeof(chunk));
+		if (chunk & UINT64_C(0x8080808080808080)) return false;
+	}
+	for (; begin != end; ++begin) {
+		if (static_cast<unsigned char>(*begin) >= 0x80) return false;
+	}
+	return true;
+}
+
+/// Count the characters in ASCII text without a break iterator. The only
+/// multi-byte grapheme cluster made of ASCII is CR LF, so every other byte
+/// is a character of its own.
+size_t count_ascii(const char *begin, const char *end, int mask) {
+	size_t count = 0;
+	for (const char *it = begin; it != end; ++it) {
+		if (*it == '\n' && it != begin && it[-1] == '\r') continue;
+		if (!mask) {
+			++count;
+			continue;
+		}
+
+		UChar32 c = static_cast<unsigned char>(*it);
+		if (U_GET_GC_MASK(c) & mask) continue;
+		if (mask & U_GC_Z_MASK && it != begin && (c == 'n' || c == 'N' || c == 'h')) {
+			if (it[-1] != '\\')
+				++count;
+			else if (!(mask & U_GC_P_MASK))
+				--count;
+		}
+		else
+			++count;
+	}
+	return count;
+}
+
 template <typename Iterator>
 size_t count_in_range(Iterator begin, Iterator end, int mask) {
 	if (begin == end) return 0;
+	if (is_ascii(&*begin, &*begin + (end - begin)))
+		return count_ascii(&*begin, &*begin + (end - begin), mask);
 
 	auto& character_bi = get_break_iterator(&*begin, end - begin);
 
@@ -21,6 +21,7 @@
 #include <cerrno>
 #include <iconv.h>
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/range/algorithm/lower_bound.hpp>
 
 namespace {
@@ -165,6 +166,56 @@ int get_iso6937(int codepoint) {
 	return ext->value;
 }
 
+/// Decode the next UTF-8 character from in
+/// @return Number of bytes used, or 0 with errno set if the input is invalid
+///         or ends partway through a character
+size_t decode_utf8(const unsigned char *in, size_t size, int *codepoint) {
+	size_t len;
+	int value;
+	if (in[0] < 0x80) {
+		*codepoint = in[0];
+		return 1;
+	}
+	else if ((in[0] & 0xE0) == 0xC0) {
+		len = 2;
+		value = in[0] & 0x1F;
+	}
+	else if ((in[0] & 0xF0) == 0xE0) {
+		len = 3;
+		value = in[0] & 0x0F;
+	}
+	else if ((in[0] & 0xF8) == 0xF0) {
+		len = 4;
+		value = in[0] & 0x07;
+	}
+	else {
+		errno = EILSEQ;
+		return 0;
+	}
+
+	for (size_t i = 1; i < len; ++i) {
+		if (i >= size) {
+			errno = EINVAL;
+			return 0;
+		}
+		if ((in[i] & 0xC0) != 0x80) {
+			errno = EILSEQ;
+			return 0;
+		}
+		value = (value << 6) | (in[i] & 0x3F);
+	}
+
+	// Reject overlong encodings, surrogates and values past the end of unicode
+	static const int min_value[] = {0, 0, 0x80, 0x800, 0x10000};
+	if (value < min_value[len] || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF)) {
+		errno = EILSEQ;
+		return 0;
+	}
+
+	*codepoint = value;
+	return len;
+}
+
 } // namespace {
 
 namespace agi { namespace charset {
@@ -176,9 +227,10 @@ namespace agi { namespace charset {
 #endif
 
 Converter6937::Converter6937(bool subst, const char *src)
-: to_ucs4(new IconvWrapper(src, INTERNAL_CHARSET))
-, subst(subst)
+: subst(subst)
 {
+	if (!boost::iequals(src, "UTF-8") && !boost::iequals(src, "UTF8"))
+		to_ucs4.reset(new IconvWrapper(src, INTERNAL_CHARSET));
 }
 
 size_t Converter6937::Convert(const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft) {
@@ -200,9 +252,18 @@ size_t Converter6937::Convert(const char **inbuf, size_t *inbytesleft, char **ou
 		size_t val_buf_size = sizeof(in_val);
 
 		// Get the next unicode character from the input
-		size_t ret = to_ucs4->Convert(&inbuftmp, &inbyteslefttmp, &val_buf, &val_buf_size);
-		if (ret == (size_t)-1 && errno != E2BIG)
-			return ret;
+		if (to_ucs4) {
+			size_t ret = to_ucs4->Convert(&inbuftmp, &inbyteslefttmp, &val_buf, &val_buf_size);
+			if (ret == (size_t)-1 && errno != E2BIG)
+				return ret;
+		}
+		else {
+			size_t len = decode_utf8(reinterpret_cast<const unsigned char *>(inbuftmp), inbyteslefttmp, &in_val);
+			if (!len)
+				return (size_t)-1;
+			inbuftmp += len;
+			inbyteslefttmp -= len;
+		}
 
 		// And convert that to ISO-6937-2
 		int val = get_iso6937(in_val);
@@ -27,6 +27,7 @@ namespace agi { namespace charset {
 /// it's not used by anything but old subtitle formats
 class Converter6937 final : public Converter {
 	/// Converter to UCS-4 so that we only have to deal with unicode codepoints
+	/// Not used when the source is UTF-8, which is decoded directly
 	std::unique_ptr<IconvWrapper> to_ucs4;
 
 	/// Should unsupported characters be replaced with '?'
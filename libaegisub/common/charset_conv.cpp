@@ -26,6 +26,7 @@
 #include <iconv.h>
 
 #include "charset_6937.h"
+#include "charset_unicode.h"
 
 // Check if we can use advanced fallback capabilities added in GNU's iconv
 // implementation
@@ -260,6 +261,11 @@ namespace {
 #endif
 
 	Converter *get_converter(bool subst, const char *src, const char *dst) {
+		// Conversions between the Unicode encodings can't need substitution,
+		// and are far more common than the rest
+		if (auto conv = CreateUnicodeConverter(get_real_encoding_name(src), get_real_encoding_name(dst)))
+			return conv;
+
 		try {
 			return new ConverterImpl(subst, src, dst);
 		}
@@ -307,20 +313,23 @@ std::string IconvWrapper::Convert(const char *source, size_t len) {
 }
 
 void IconvWrapper::Convert(const char *src, size_t srcLen, std::string &dest) {
-	char buff[512];
-
+	// Convert directly into the string, growing it when it fills up
+	size_t used = dest.size();
 	size_t res;
+	int err;
 	do {
-		char *dst = buff;
-		size_t dstLen = sizeof(buff);
+		dest.resize(std::max(used + srcLen + 16, dest.size() * 2));
+		char *dst = &dest[used];
+		size_t dstLen = dest.size() - used;
 		res = conv->Convert(&src, &srcLen, &dst, &dstLen);
+		err = errno;
 		if (res == 0) conv->Convert(nullptr, nullptr, &dst, &dstLen);
-
-		dest.append(buff, sizeof(buff) - dstLen);
-	} while (res == iconv_failed && errno == E2BIG);
+		used = dest.size() - dstLen;
+	} while (res == iconv_failed && err == E2BIG);
+	dest.resize(used);
 
 	if (res == iconv_failed) {
-		switch (errno) {
+		switch (err) {
 			case EILSEQ:
 			case EINVAL:
 				throw BadInput(
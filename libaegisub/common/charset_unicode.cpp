@@ -0,0 +1,410 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file charset_unicode.cpp
+/// @brief Converters between the Unicode encodings which don't use iconv
+/// @ingroup libaegisub
+
+#include "charset_unicode.h"
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+using namespace agi::charset;
+
+enum class Encoding { UTF8, UTF16LE, UTF16BE };
+
+/// Values returned by the decoders for input which isn't a code point
+const int32_t incomplete = -1;
+const int32_t invalid = -2;
+
+bool is_ascii(uint8_t c) { return c < 0x80; }
+
+/// Length of the run of ASCII bytes at the start of a UTF-8 string
+size_t ascii_run(const uint8_t *src, size_t len) {
+	size_t i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16) {
+		int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+		if (mask) {
+			while (!(mask & 1)) {
+				mask >>= 1;
+				++i;
+			}
+			return i;
+		}
+	}
+#else
+	for (; i + 8 <= len; i += 8) {
+		uint64_t word;
+		memcpy(&word, src + i, 8);
+		if (word & UINT64_C(0x8080808080808080)) break;
+	}
+#endif
+	while (i < len && is_ascii(src[i])) ++i;
+	return i;
+}
+
+template<Encoding E>
+uint32_t load16(const uint8_t *p) {
+	return E == Encoding::UTF16BE ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+template<Encoding E>
+void store16(uint8_t *p, uint32_t unit) {
+	p[E == Encoding::UTF16BE ? 1 : 0] = unit & 0xFF;
+	p[E == Encoding::UTF16BE ? 0 : 1] = unit >> 8;
+}
+
+int32_t decode_utf8(const uint8_t *&src, const uint8_t *end) {
+	const uint8_t lead = *src;
+	if (is_ascii(lead)) return *src++;
+
+	int len;
+	int32_t cp, min;
+	if (lead < 0xC2) return invalid;
+	else if (lead < 0xE0) { len = 2; cp = lead & 0x1F; min = 0x80; }
+	else if (lead < 0xF0) { len = 3; cp = lead & 0x0F; min = 0x800; }
+	else if (lead < 0xF5) { len = 4; cp = lead & 0x07; min = 0x10000; }
+	else return invalid;
+
+	for (int i = 1; i < len; ++i) {
+		if (src + i == end) return incomplete;
+		if ((src[i] & 0xC0) != 0x80) return invalid;
+		cp = (cp << 6) | (src[i] & 0x3F);
+	}
+	// Overlong forms, surrogates and values past the end of Unicode
+	if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+		return invalid;
+	src += len;
+	return cp;
+}
+
+template<Encoding E>
+int32_t decode_utf16(const uint8_t *&src, const uint8_t *end) {
+	if (end - src < 2) return incomplete;
+	const uint32_t high = load16<E>(src);
+	if (high < 0xD800 || high > 0xDFFF) {
+		src += 2;
+		return high;
+	}
+	if (high > 0xDBFF) return invalid;
+	if (end - src < 4) return incomplete;
+	const uint32_t low = load16<E>(src + 2);
+	if (low < 0xDC00 || low > 0xDFFF) return invalid;
+	src += 4;
+	return 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+}
+
+bool encode_utf8(uint32_t cp, uint8_t *&dst, uint8_t *end) {
+	if (cp < 0x80) {
+		if (dst == end) return false;
+		*dst++ = cp;
+	}
+	else if (cp < 0x800) {
+		if (end - dst < 2) return false;
+		*dst++ = 0xC0 | (cp >> 6);
+		*dst++ = 0x80 | (cp & 0x3F);
+	}
+	else if (cp < 0x10000) {
+		if (end - dst < 3) return false;
+		*dst++ = 0xE0 | (cp >> 12);
+		*dst++ = 0x80 | ((cp >> 6) & 0x3F);
+		*dst++ = 0x80 | (cp & 0x3F);
+	}
+	else {
+		if (end - dst < 4) return false;
+		*dst++ = 0xF0 | (cp >> 18);
+		*dst++ = 0x80 | ((cp >> 12) & 0x3F);
+		*dst++ = 0x80 | ((cp >> 6) & 0x3F);
+		*dst++ = 0x80 | (cp & 0x3F);
+	}
+	return true;
+}
+
+template<Encoding E>
+bool encode_utf16(uint32_t cp, uint8_t *&dst, uint8_t *end) {
+	if (cp < 0x10000) {
+		if (end - dst < 2) return false;
+		store16<E>(dst, cp);
+		dst += 2;
+	}
+	else {
+		if (end - dst < 4) return false;
+		cp -= 0x10000;
+		store16<E>(dst, 0xD800 + (cp >> 10));
+		store16<E>(dst + 2, 0xDC00 + (cp & 0x3FF));
+		dst += 4;
+	}
+	return true;
+}
+
+/// Convert the run of ASCII at the start of the input, which is most or all
+/// of it for nearly all subtitles
+/// @return Number of characters converted
+template<Encoding Src, Encoding Dst>
+size_t convert_ascii(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len);
+
+template<>
+size_t convert_ascii<Encoding::UTF8, Encoding::UTF8>(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+	size_t len = ascii_run(src, std::min(src_len, dst_len));
+	memcpy(dst, src, len);
+	return len;
+}
+
+template<Encoding Dst>
+size_t widen_ascii(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+	const size_t len = std::min(src_len, dst_len / 2);
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= len; i += 16) {
+		__m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		if (_mm_movemask_epi8(chars)) break;
+		__m128i lo = Dst == Encoding::UTF16BE ? _mm_unpacklo_epi8(zero, chars) : _mm_unpacklo_epi8(chars, zero);
+		__m128i hi = Dst == Encoding::UTF16BE ? _mm_unpackhi_epi8(zero, chars) : _mm_unpackhi_epi8(chars, zero);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2 + 16), hi);
+	}
+#endif
+	for (; i < len && is_ascii(src[i]); ++i)
+		store16<Dst>(dst + i * 2, src[i]);
+	return i;
+}
+
+template<>
+size_t convert_ascii<Encoding::UTF8, Encoding::UTF16LE>(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+	return widen_ascii<Encoding::UTF16LE>(src, src_len, dst, dst_len);
+}
+
+template<>
+size_t convert_ascii<Encoding::UTF8, Encoding::UTF16BE>(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+	return widen_ascii<Encoding::UTF16BE>(src, src_len, dst, dst_len);
+}
+
+template<Encoding Src>
+size_t narrow_ascii(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+	const size_t len = std::min(src_len / 2, dst_len);
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i non_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= len; i += 8) {
+		__m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+		if (Src == Encoding::UTF16BE)
+			units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, non_ascii), zero)) != 0xFFFF)
+			break;
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(units, units));
+	}
+#endif
+	for (; i < len; ++i) {
+		const uint32_t unit = load16<Src>(src + i * 2);
+		if (unit >= 0x80) break;
+		dst[i] = unit;
+	}
+	return i;
+}
+
+template<>
+size_t convert_ascii<Encoding::UTF16LE, Encoding::UTF8>(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+	return narrow_ascii<Encoding::UTF16LE>(src, src_len, dst, dst_len);
+}
+
+template<>
+size_t convert_ascii<Encoding::UTF16BE, Encoding::UTF8>(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len) {
+	return narrow_ascii<Encoding::UTF16BE>(src, src_len, dst, dst_len);
+}
+
+// UTF-16 to UTF-16 isn't worth a fast path
+template<>
+size_t convert_ascii<Encoding::UTF16LE, Encoding::UTF16LE>(const uint8_t *, size_t, uint8_t *, size_t) { return 0; }
+template<>
+size_t convert_ascii<Encoding::UTF16LE, Encoding::UTF16BE>(const uint8_t *, size_t, uint8_t *, size_t) { return 0; }
+template<>
+size_t convert_ascii<Encoding::UTF16BE, Encoding::UTF16LE>(const uint8_t *, size_t, uint8_t *, size_t) { return 0; }
+template<>
+size_t convert_ascii<Encoding::UTF16BE, Encoding::UTF16BE>(const uint8_t *, size_t, uint8_t *, size_t) { return 0; }
+
+template<Encoding E>
+int32_t decode(const uint8_t *&src, const uint8_t *end) {
+	return E == Encoding::UTF8 ? decode_utf8(src, end) : decode_utf16<E>(src, end);
+}
+
+template<Encoding E>
+bool encode(uint32_t cp, uint8_t *&dst, uint8_t *end) {
+	return E == Encoding::UTF8 ? encode_utf8(cp, dst, end) : encode_utf16<E>(cp, dst, end);
+}
+
+size_t ascii_width(Encoding e) { return e == Encoding::UTF8 ? 1 : 2; }
+
+template<Encoding Src, Encoding Dst>
+class UnicodeConverter final : public Converter {
+public:
+	size_t Convert(const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft) override {
+		// There's no shift state to reset
+		if (!inbuf || !*inbuf) return 0;
+
+		const uint8_t *src = reinterpret_cast<const uint8_t *>(*inbuf);
+		const uint8_t *src_end = src + *inbytesleft;
+		uint8_t *dst = reinterpret_cast<uint8_t *>(*outbuf);
+		uint8_t *dst_end = dst + *outbytesleft;
+
+		int error = 0;
+		while (src < src_end) {
+			const size_t ascii = convert_ascii<Src, Dst>(src, src_end - src, dst, dst_end - dst);
+			src += ascii * ascii_width(Src);
+			dst += ascii * ascii_width(Dst);
+			if (src == src_end) break;
+
+			const uint8_t *next = src;
+			const int32_t cp = decode<Src>(next, src_end);
+			if (cp < 0) {
+				error = cp == incomplete ? EINVAL : EILSEQ;
+				break;
+			}
+			if (!encode<Dst>(cp, dst, dst_end)) {
+				error = E2BIG;
+				break;
+			}
+			src = next;
+		}
+
+		*inbuf = reinterpret_cast<const char *>(src);
+		*inbytesleft = src_end - src;
+		*outbuf = reinterpret_cast<char *>(dst);
+		*outbytesleft = dst_end - dst;
+
+		if (error) {
+			errno = error;
+			return (size_t)-1;
+		}
+		return 0;
+	}
+};
+
+bool parse_encoding(const char *name, Encoding &enc) {
+	if (boost::iequals(name, "utf-8") || boost::iequals(name, "utf8"))
+		enc = Encoding::UTF8;
+	else if (boost::iequals(name, "utf-16le"))
+		enc = Encoding::UTF16LE;
+	else if (boost::iequals(name, "utf-16be"))
+		enc = Encoding::UTF16BE;
+	else
+		return false;
+	return true;
+}
+
+template<Encoding Src>
+Converter *create(Encoding dst) {
+	switch (dst) {
+		case Encoding::UTF8:    return new UnicodeConverter<Src, Encoding::UTF8>;
+		case Encoding::UTF16LE: return new UnicodeConverter<Src, Encoding::UTF16LE>;
+		case Encoding::UTF16BE: return new UnicodeConverter<Src, Encoding::UTF16BE>;
+	}
+	return nullptr;
+}
+} // namespace {
+
+namespace agi { namespace charset {
+Converter *CreateUnicodeConverter(const char *src, const char *dst) {
+	Encoding src_enc, dst_enc;
+	if (!parse_encoding(src, src_enc) || !parse_encoding(dst, dst_enc))
+		return nullptr;
+
+	switch (src_enc) {
+		case Encoding::UTF8:    return create<Encoding::UTF8>(dst_enc);
+		case Encoding::UTF16LE: return create<Encoding::UTF16LE>(dst_enc);
+		case Encoding::UTF16BE: return create<Encoding::UTF16BE>(dst_enc);
+	}
+	return nullptr;
+}
+
+bool Utf8ToWide(const char *src, size_t len, std::wstring &dst) {
+	// Each code unit needs at least one byte of UTF-8
+	dst.resize(len);
+	if (!len) return true;
+
+	auto in = reinterpret_cast<const uint8_t *>(src);
+	auto in_end = in + len;
+	wchar_t *out = &dst[0];
+
+	while (in < in_end) {
+		size_t ascii;
+		// wchar_t is only 16 bits on Windows, which is always little-endian
+		if (sizeof(wchar_t) == 2)
+			ascii = widen_ascii<Encoding::UTF16LE>(in, in_end - in, reinterpret_cast<uint8_t *>(out), (in_end - in) * 2);
+		else {
+			ascii = ascii_run(in, in_end - in);
+			for (size_t i = 0; i < ascii; ++i)
+				out[i] = in[i];
+		}
+		in += ascii;
+		out += ascii;
+		if (in == in_end) break;
+
+		const int32_t cp = decode_utf8(in, in_end);
+		if (cp < 0) return false;
+		if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+			*out++ = static_cast<wchar_t>(0xD800 + ((cp - 0x10000) >> 10));
+			*out++ = static_cast<wchar_t>(0xDC00 + ((cp - 0x10000) & 0x3FF));
+		}
+		else
+			*out++ = static_cast<wchar_t>(cp);
+	}
+
+	dst.resize(out - &dst[0]);
+	return true;
+}
+
+bool WideToUtf8(const wchar_t *src, size_t len, std::string &dst) {
+	dst.resize(len * (sizeof(wchar_t) == 2 ? 3 : 4));
+	if (!len) return true;
+
+	auto out = reinterpret_cast<uint8_t *>(&dst[0]);
+	auto out_end = out + dst.size();
+	for (size_t i = 0; i < len; ++i) {
+		if (sizeof(wchar_t) == 2) {
+			const size_t ascii = narrow_ascii<Encoding::UTF16LE>(reinterpret_cast<const uint8_t *>(src + i), (len - i) * 2, out, out_end - out);
+			i += ascii;
+			out += ascii;
+			if (i == len) break;
+		}
+
+		uint32_t cp = static_cast<uint32_t>(src[i]);
+		if (cp >= 0xD800 && cp <= 0xDFFF) {
+			if (sizeof(wchar_t) != 2 || cp > 0xDBFF || i + 1 == len) return false;
+			const uint32_t low = static_cast<uint32_t>(src[i + 1]);
+			if (low < 0xDC00 || low > 0xDFFF) return false;
+			cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+			++i;
+		}
+		else if (cp > 0x10FFFF)
+			return false;
+		encode_utf8(cp, out, out_end);
+	}
+
+	dst.resize(out - reinterpret_cast<uint8_t *>(&dst[0]));
+	return true;
+}
+} }
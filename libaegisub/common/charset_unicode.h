@@ -0,0 +1,29 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file charset_unicode.h
+/// @brief Converters between the Unicode encodings which don't use iconv
+/// @ingroup libaegisub
+
+#include <libaegisub/charset_conv.h>
+
+namespace agi { namespace charset {
+
+/// Create a converter between UTF-8, UTF-16LE and UTF-16BE which has the same
+/// interface as iconv but is several times faster for mostly-ASCII text
+/// @return The converter, or nullptr if either encoding isn't one of those
+Converter *CreateUnicodeConverter(const char *src, const char *dst);
+
+} }
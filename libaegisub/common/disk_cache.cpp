@@ -0,0 +1,256 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/disk_cache.h"
+
+#include "libaegisub/dispatch.h"
+#include "libaegisub/exception.h"
+#include "libaegisub/fs.h"
+#include "libaegisub/log.h"
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+namespace agi {
+DiskCache::DiskCache(fs::path const& root, uint64_t max_size, size_t max_files)
+: root(root)
+, max_size(max_size)
+, max_files(max_files)
+, queue(dispatch::Create())
+{
+	queue->Async([=] { Scan(root); }, dispatch::Priority::Background);
+}
+
+DiskCache::~DiskCache() {
+	Flush();
+}
+
+void DiskCache::Flush() {
+	queue->Sync([] { }, dispatch::Priority::Background);
+}
+
+std::string DiskCache::FileName(std::string const& key, std::string const& extension) {
+	// FNV-1a, which unlike std::hash gives the same names in every build
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : key) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+
+	static const char digits[] = "0123456789abcdef";
+	std::string name(16, '0');
+	for (int i = 15; i >= 0; --i, hash >>= 4)
+		name[i] = digits[hash & 0xF];
+	return name + extension;
+}
+
+std::string DiskCache::NameOf(fs::path const& path) const {
+	if (path.parent_path() != root) return "";
+	return path.filename().string();
+}
+
+void DiskCache::Scan(fs::path const& dir) {
+	try {
+		fs::CreateDirectory(dir);
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("disk_cache") << "Failed to create " << dir << ": " << e.GetMessage();
+		return;
+	}
+
+	// Read everything before locking so that Path() isn't held up by the disk
+	std::vector<std::pair<std::string, Entry>> found;
+	for (auto const& name : fs::DirectoryIterator(dir, "")) {
+		try {
+			auto path = dir/name;
+			found.push_back({name, Entry{fs::Size(path), fs::ModifiedTime(path), 0}});
+		}
+		catch (agi::Exception const&) {
+			// Directories and files which were deleted out from under us
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// The root may have changed again while this was queued
+		if (dir != root) return;
+		for (auto& file : found) {
+			// Anything which was added since the scan was queued is newer
+			if (entries.emplace(file.first, file.second).second)
+				total_size += file.second.size;
+		}
+		LOG_D("disk_cache") << "found " << entries.size() << " files using " << total_size << " bytes in " << dir;
+	}
+	Trim();
+}
+
+fs::path DiskCache::Path(std::string const& key, std::string const& extension) {
+	auto name = FileName(key, extension);
+	std::lock_guard<std::mutex> lock(mutex);
+	auto path = root/name;
+
+	auto it = entries.find(name);
+	if (it != entries.end()) {
+		it->second.last_use = time(nullptr);
+		it->second.seq = ++next_seq;
+		queue->Async([=] {
+			try {
+				// Touch would create it if it's since been deleted
+				if (fs::FileExists(path))
+					fs::Touch(path);
+			}
+			catch (agi::Exception const&) {
+				// Not being able to update the time just means the file may
+				// be evicted sooner than it should be
+			}
+		}, dispatch::Priority::Background);
+	}
+
+	return path;
+}
+
+void DiskCache::Added(fs::path const& path) {
+	queue->Async([=] {
+		uint64_t size;
+		try {
+			size = fs::Size(path);
+		}
+		catch (agi::Exception const&) {
+			Removed(path);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto name = NameOf(path);
+			if (name.empty()) return;
+
+			auto& entry = entries[name];
+			total_size += size - entry.size;
+			entry.size = size;
+			entry.last_use = time(nullptr);
+			entry.seq = ++next_seq;
+		}
+		Trim();
+	}, dispatch::Priority::Background);
+}
+
+void DiskCache::Removed(fs::path const& path) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = entries.find(NameOf(path));
+	if (it == entries.end()) return;
+	total_size -= it->second.size;
+	entries.erase(it);
+}
+
+void DiskCache::SetRoot(fs::path const& new_root) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (new_root == root) return;
+
+	root = new_root;
+	entries.clear();
+	total_size = 0;
+	queue->Async([=] { Scan(new_root); }, dispatch::Priority::Background);
+}
+
+fs::path DiskCache::Root() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return root;
+}
+
+void DiskCache::SetQuota(uint64_t new_max_size, size_t new_max_files) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (new_max_size == max_size && new_max_files == max_files) return;
+	max_size = new_max_size;
+	max_files = new_max_files;
+	QueueTrim();
+}
+
+void DiskCache::QueueTrim() {
+	if (trim_queued) return;
+	trim_queued = true;
+	queue->Async([=] { Trim(); }, dispatch::Priority::Background);
+}
+
+uint64_t DiskCache::GetSize() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return total_size;
+}
+
+size_t DiskCache::GetCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+void DiskCache::Trim() {
+	typedef std::tuple<time_t, uint64_t, std::string> Use;
+	std::vector<Use> uses;
+	fs::path dir;
+
+	auto over_quota = [&] {
+		return total_size > max_size || (max_files && entries.size() > max_files);
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		trim_queued = false;
+		if (!over_quota()) return;
+
+		dir = root;
+		uses.reserve(entries.size());
+		for (auto const& entry : entries)
+			uses.emplace_back(entry.second.last_use, entry.second.seq, entry.first);
+	}
+
+	sort(begin(uses), end(uses));
+	// The most recently used file is never evicted, as it's probably the
+	// one which was just written
+	uses.pop_back();
+
+	size_t deleted = 0;
+	for (auto const& use : uses) {
+		auto const& name = std::get<2>(use);
+		Entry entry;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!over_quota() || dir != root) break;
+
+			// Skip anything which has been used since the list was made
+			auto it = entries.find(name);
+			if (it == entries.end() || it->second.seq != std::get<1>(use) || it->second.last_use != std::get<0>(use))
+				continue;
+			entry = it->second;
+			total_size -= entry.size;
+			entries.erase(it);
+		}
+
+		try {
+			fs::Remove(dir/name);
+			++deleted;
+		}
+		catch (agi::Exception const& e) {
+			// Probably open somewhere, so keep counting it
+			LOG_D("disk_cache") << "failed to delete " << dir/name << ": " << e.GetMessage();
+			std::lock_guard<std::mutex> lock(mutex);
+			if (dir == root && entries.emplace(name, entry).second)
+				total_size += entry.size;
+		}
+	}
+
+	LOG_D("disk_cache") << "deleted " << deleted << " files from " << dir;
+}
+}
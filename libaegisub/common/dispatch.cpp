@@ -18,48 +18,114 @@
 
 #include "libaegisub/util.h"
 
-#include <atomic>
-#include <boost/asio/io_service.hpp>
-#include <boost/asio/strand.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
+#include <vector>
+
+using agi::dispatch::Priority;
+using agi::dispatch::Thunk;
+
+struct agi::dispatch::Queue::Counters {
+	std::atomic<size_t> depth{0};
+	std::atomic<uint64_t> started{0};
+	std::atomic<uint64_t> cancelled{0};
+	std::atomic<uint64_t> total_latency_us{0};
+	std::atomic<uint64_t> max_latency_us{0};
+};
 
 namespace {
-	boost::asio::io_service *service;
-	std::function<void (agi::dispatch::Thunk)> invoke_main;
+	std::function<void (Thunk)> invoke_main;
 	std::atomic<uint_fast32_t> threads_running;
 
-	class MainQueue final : public agi::dispatch::Queue {
-		void DoInvoke(agi::dispatch::Thunk thunk) override {
-			invoke_main(thunk);
-		}
+	const size_t priority_count = 3;
+
+	/// Thunks queued on a serial queue which can't run yet because an
+	/// earlier one is queued on or running in the thread pool
+	struct SerialState {
+		std::array<std::deque<Thunk>, priority_count> pending;
+		/// Does this queue have a thunk in the pool's ready lists or running?
+		bool scheduled = false;
 	};
 
-	class BackgroundQueue final : public agi::dispatch::Queue {
-		void DoInvoke(agi::dispatch::Thunk thunk) override {
-			service->post(thunk);
-		}
+	struct Task {
+		Thunk thunk;
+		/// Queue the thunk came from if it's a serial queue
+		std::shared_ptr<SerialState> serial;
 	};
 
-	class SerialQueue final : public agi::dispatch::Queue {
-		boost::asio::io_service::strand strand;
+	/// Thread pool which runs the thunks of the background queue and all
+	/// serial queues. Each serial queue has at most one thunk in the ready
+	/// lists at a time, and the next one is moved over when it finishes.
+	struct ThreadPool {
+		std::mutex lock;
+		std::condition_variable cv;
+		std::array<std::deque<Task>, priority_count> ready;
+		bool stopping = false;
+		std::vector<std::thread> threads;
 
-		void DoInvoke(agi::dispatch::Thunk thunk) override {
-			strand.post(thunk);
+		void Post(Thunk thunk, Priority priority, std::shared_ptr<SerialState> serial) {
+			const size_t p = static_cast<size_t>(priority);
+			{
+				std::lock_guard<std::mutex> l(lock);
+				if (serial) {
+					if (serial->scheduled) {
+						serial->pending[p].push_back(std::move(thunk));
+						return;
+					}
+					serial->scheduled = true;
+				}
+				ready[p].push_back(Task{std::move(thunk), std::move(serial)});
+			}
+			cv.notify_one();
 		}
-	public:
-		SerialQueue() : strand(*service) { }
-	};
 
-	struct IOServiceThreadPool {
-		boost::asio::io_service io_service;
-		std::unique_ptr<boost::asio::io_service::work> work;
-		std::vector<std::thread> threads;
+		/// Get the highest priority ready list with anything in it
+		std::deque<Task> *Next() {
+			for (auto& tasks : ready) {
+				if (!tasks.empty()) return &tasks;
+			}
+			return nullptr;
+		}
 
-		IOServiceThreadPool() : work(new boost::asio::io_service::work(io_service)) { }
-		~IOServiceThreadPool() {
-			work.reset();
+		void Run() {
+			std::unique_lock<std::mutex> l(lock);
+			for (;;) {
+				cv.wait(l, [&] { return stopping || Next(); });
+				auto tasks = Next();
+				// Queued work is finished before shutting down
+				if (!tasks) return;
+
+				Task task = std::move(tasks->front());
+				tasks->pop_front();
+				l.unlock();
+				task.thunk();
+				l.lock();
+
+				if (!task.serial) continue;
+				auto& serial = *task.serial;
+				serial.scheduled = false;
+				for (size_t p = 0; p < priority_count; ++p) {
+					if (serial.pending[p].empty()) continue;
+					ready[p].push_back(Task{std::move(serial.pending[p].front()), task.serial});
+					serial.pending[p].pop_front();
+					serial.scheduled = true;
+					cv.notify_one();
+					break;
+				}
+			}
+		}
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> l(lock);
+				stopping = true;
+			}
+			cv.notify_all();
 #ifndef _WIN32
 			for (auto& thread : threads) thread.join();
 #else
@@ -70,13 +136,53 @@ namespace {
 #endif
 		}
 	};
+
+	ThreadPool *pool;
+
+	class MainQueue final : public agi::dispatch::Queue {
+		void DoInvoke(Thunk thunk, Priority) override {
+			invoke_main(thunk);
+		}
+	};
+
+	class BackgroundQueue final : public agi::dispatch::Queue {
+		void DoInvoke(Thunk thunk, Priority priority) override {
+			pool->Post(std::move(thunk), priority, nullptr);
+		}
+	};
+
+	class SerialQueue final : public agi::dispatch::Queue {
+		std::shared_ptr<SerialState> state = std::make_shared<SerialState>();
+
+		void DoInvoke(Thunk thunk, Priority priority) override {
+			pool->Post(std::move(thunk), priority, state);
+		}
+	};
+
+	/// Wrap a thunk so that exceptions from it are rethrown on the main thread
+	Thunk errors_to_main(Thunk thunk) {
+		return [=] {
+			try {
+				thunk();
+			}
+			catch (...) {
+				auto e = std::current_exception();
+				invoke_main([=] { std::rethrow_exception(e); });
+			}
+		};
+	}
+
+	uint64_t now_us() {
+		using namespace std::chrono;
+		return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+	}
 }
 
 namespace agi { namespace dispatch {
 
 void Init(std::function<void (Thunk)> invoke_main) {
-	static IOServiceThreadPool thread_pool;
-	::service = &thread_pool.io_service;
+	static ThreadPool thread_pool;
+	::pool = &thread_pool;
 	::invoke_main = invoke_main;
 
 	thread_pool.threads.reserve(std::max<unsigned>(4, std::thread::hardware_concurrency()));
@@ -84,31 +190,54 @@ void Init(std::function<void (Thunk)> invoke_main) {
 		thread_pool.threads.emplace_back([]{
 			++threads_running;
 			agi::util::SetThreadName("Dispatch Worker");
-			service->run();
+			pool->Run();
 			--threads_running;
 		});
 	}
 }
 
-void Queue::Async(Thunk thunk) {
+CancelToken::CancelToken() : cancelled(std::make_shared<std::atomic<bool>>(false)) { }
+
+Queue::Queue() : counters(std::make_shared<Counters>()) { }
+
+void Queue::Invoke(Thunk thunk, Priority priority, std::shared_ptr<std::atomic<bool>> cancelled) {
+	// The counters are shared with the thunk as the queue may be destroyed
+	// before it runs
+	auto counters = this->counters;
+	const uint64_t queued = now_us();
+	++counters->depth;
 	DoInvoke([=] {
-		try {
-			thunk();
-		}
-		catch (...) {
-			auto e = std::current_exception();
-			invoke_main([=] { std::rethrow_exception(e); });
+		--counters->depth;
+		if (cancelled && *cancelled) {
+			++counters->cancelled;
+			return;
 		}
-	});
+
+		const uint64_t latency = now_us() - queued;
+		++counters->started;
+		counters->total_latency_us += latency;
+		uint64_t max = counters->max_latency_us;
+		while (latency > max && !counters->max_latency_us.compare_exchange_weak(max, latency)) ;
+
+		thunk();
+	}, priority);
 }
 
-void Queue::Sync(Thunk thunk) {
+void Queue::Async(Thunk thunk, Priority priority) {
+	Invoke(errors_to_main(std::move(thunk)), priority, nullptr);
+}
+
+void Queue::Async(Thunk thunk, Priority priority, CancelToken const& token) {
+	Invoke(errors_to_main(std::move(thunk)), priority, token.cancelled);
+}
+
+void Queue::Sync(Thunk thunk, Priority priority) {
 	std::mutex m;
 	std::condition_variable cv;
 	std::unique_lock<std::mutex> l(m);
 	std::exception_ptr e;
 	bool done = false;
-	DoInvoke([&]{
+	Invoke([&]{
 		std::unique_lock<std::mutex> l(m);
 		try {
 			thunk();
@@ -118,11 +247,21 @@ void Queue::Sync(Thunk thunk) {
 		}
 		done = true;
 		cv.notify_all();
-	});
+	}, priority, nullptr);
 	cv.wait(l, [&]{ return done; });
 	if (e) std::rethrow_exception(e);
 }
 
+QueueStats Queue::Stats() const {
+	QueueStats stats;
+	stats.depth = counters->depth;
+	stats.started = counters->started;
+	stats.cancelled = counters->cancelled;
+	stats.mean_latency_us = stats.started ? counters->total_latency_us / stats.started : 0;
+	stats.max_latency_us = counters->max_latency_us;
+	return stats;
+}
+
 Queue& Main() {
 	static MainQueue q;
 	return q;
@@ -0,0 +1,280 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/fft.h"
+
+#include "libaegisub/exception.h"
+#include "libaegisub/simd.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(AGI_SSE2) || defined(AGI_NEON)
+#define AGI_FFT_SIMD
+#endif
+
+namespace {
+const float sqrt2 = 1.41421356f;
+const float log10_2 = 0.301029996f;
+const float log10_e = 0.434294482f;
+
+/// Natural log of m in [sqrt(1/2), sqrt(2)) from the first three terms of the
+/// series for 2 atanh((m - 1) / (m + 1)), which is accurate to about 1e-6
+inline float LogReduced(float m) {
+	const float t = (m - 1.f) / (m + 1.f);
+	const float t2 = t * t;
+	return 2.f * t * (1.f + t2 * (1.f / 3.f + t2 * (1.f / 5.f)));
+}
+
+/// log10 of a positive normal float
+inline float FastLog10(float x) {
+	uint32_t bits;
+	memcpy(&bits, &x, sizeof bits);
+	float e = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+	bits = (bits & 0x7fffff) | 0x3f800000;
+	float m;
+	memcpy(&m, &bits, sizeof m);
+	if (m > sqrt2) {
+		m *= .5f;
+		e += 1.f;
+	}
+	return e * log10_2 + LogReduced(m) * log10_e;
+}
+
+#ifdef AGI_SSE2
+typedef __m128 Vec4;
+inline Vec4 Load(const float *p) { return _mm_loadu_ps(p); }
+inline void Store(float *p, Vec4 v) { _mm_storeu_ps(p, v); }
+inline Vec4 Splat(float v) { return _mm_set1_ps(v); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+inline Vec4 Div(Vec4 a, Vec4 b) { return _mm_div_ps(a, b); }
+inline Vec4 Sqrt(Vec4 v) { return _mm_sqrt_ps(v); }
+inline Vec4 Reverse(Vec4 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+/// Split positive normal floats into a mantissa in [sqrt(1/2), sqrt(2)) and
+/// an exponent
+inline void Split(Vec4 x, Vec4 &m, Vec4 &e) {
+	const __m128i bits = _mm_castps_si128(x);
+	e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x7fffff)), _mm_set1_epi32(0x3f800000)));
+	const __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(sqrt2));
+	m = _mm_or_ps(_mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(.5f))), _mm_andnot_ps(big, m));
+	e = _mm_add_ps(e, _mm_and_ps(big, _mm_set1_ps(1.f)));
+}
+
+/// Magnitudes of four interleaved complex doubles
+inline Vec4 Magnitude(const double *p) {
+	__m128 res[2];
+	for (int i = 0; i < 2; ++i) {
+		const __m128d a = _mm_loadu_pd(p + i * 4);
+		const __m128d b = _mm_loadu_pd(p + i * 4 + 2);
+		const __m128d re = _mm_unpacklo_pd(a, b);
+		const __m128d im = _mm_unpackhi_pd(a, b);
+		res[i] = _mm_cvtpd_ps(_mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(re, re), _mm_mul_pd(im, im))));
+	}
+	return _mm_movelh_ps(res[0], res[1]);
+}
+#endif
+
+#ifdef AGI_NEON
+typedef float32x4_t Vec4;
+inline Vec4 Load(const float *p) { return vld1q_f32(p); }
+inline void Store(float *p, Vec4 v) { vst1q_f32(p, v); }
+inline Vec4 Splat(float v) { return vdupq_n_f32(v); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+inline Vec4 Div(Vec4 a, Vec4 b) { return vdivq_f32(a, b); }
+inline Vec4 Sqrt(Vec4 v) { return vsqrtq_f32(v); }
+inline Vec4 Reverse(Vec4 v) {
+	const float32x4_t r = vrev64q_f32(v);
+	return vextq_f32(r, r, 2);
+}
+
+inline void Split(Vec4 x, Vec4 &m, Vec4 &e) {
+	const uint32x4_t bits = vreinterpretq_u32_f32(x);
+	e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+	m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x7fffff)), vdupq_n_u32(0x3f800000)));
+	const uint32x4_t big = vcgtq_f32(m, vdupq_n_f32(sqrt2));
+	m = vbslq_f32(big, vmulq_f32(m, vdupq_n_f32(.5f)), m);
+	e = vbslq_f32(big, vaddq_f32(e, vdupq_n_f32(1.f)), e);
+}
+
+inline Vec4 Magnitude(const double *p) {
+	float32x2_t res[2];
+	for (int i = 0; i < 2; ++i) {
+		const float64x2x2_t v = vld2q_f64(p + i * 4);
+		res[i] = vcvt_f32_f64(vsqrtq_f64(vaddq_f64(vmulq_f64(v.val[0], v.val[0]), vmulq_f64(v.val[1], v.val[1]))));
+	}
+	return vcombine_f32(res[0], res[1]);
+}
+#endif
+
+#ifdef AGI_FFT_SIMD
+inline Vec4 FastLog10(Vec4 x) {
+	Vec4 m, e;
+	Split(x, m, e);
+	const Vec4 one = Splat(1.f);
+	const Vec4 t = Div(Sub(m, one), Add(m, one));
+	const Vec4 t2 = Mul(t, t);
+	Vec4 ln = Add(Splat(1.f / 3.f), Mul(t2, Splat(1.f / 5.f)));
+	ln = Mul(Mul(Splat(2.f), t), Add(one, Mul(t2, ln)));
+	return Add(Mul(e, Splat(log10_2)), Mul(ln, Splat(log10_e)));
+}
+#endif
+}
+
+namespace agi {
+void SpectrumPower(size_t count, const float *real, const float *imag, float scale, float *power) {
+	size_t i = 0;
+#ifdef AGI_FFT_SIMD
+	const Vec4 vscale = Splat(scale);
+	const Vec4 one = Splat(1.f);
+	for (; i + 4 <= count; i += 4) {
+		const Vec4 re = Load(real + i);
+		const Vec4 im = Load(imag + i);
+		const Vec4 mag = Sqrt(Add(Mul(re, re), Mul(im, im)));
+		Store(power + i, FastLog10(Add(Mul(mag, vscale), one)));
+	}
+#endif
+	for (; i < count; ++i)
+		power[i] = FastLog10(std::sqrt(real[i] * real[i] + imag[i] * imag[i]) * scale + 1.f);
+}
+
+void SpectrumPower(size_t count, const double *complex, float scale, float *power) {
+	size_t i = 0;
+#ifdef AGI_FFT_SIMD
+	const Vec4 vscale = Splat(scale);
+	const Vec4 one = Splat(1.f);
+	for (; i + 4 <= count; i += 4)
+		Store(power + i, FastLog10(Add(Mul(Magnitude(complex + i * 2), vscale), one)));
+#endif
+	for (; i < count; ++i) {
+		const double re = complex[i * 2], im = complex[i * 2 + 1];
+		power[i] = FastLog10(static_cast<float>(std::sqrt(re * re + im * im)) * scale + 1.f);
+	}
+}
+
+RealFFT::RealFFT(size_t n_samples)
+: half_size(n_samples / 2)
+{
+	if (n_samples < 2 || (n_samples & (n_samples - 1)))
+		throw InternalError("FFT requires power of two input.");
+
+	const double pi = 3.1415926535897932384626433832795;
+
+	twiddle_r.resize(half_size);
+	twiddle_i.resize(half_size);
+	for (size_t h = 1; h < half_size; h <<= 1) {
+		for (size_t j = 0; j < h; ++j) {
+			twiddle_r[h - 1 + j] = (float)cos(pi * j / h);
+			twiddle_i[h - 1 + j] = (float)-sin(pi * j / h);
+		}
+	}
+
+	unpack_r.resize(half_size);
+	unpack_i.resize(half_size);
+	for (size_t k = 0; k < half_size; ++k) {
+		unpack_r[k] = (float)cos(pi * k / half_size);
+		unpack_i[k] = (float)-sin(pi * k / half_size);
+	}
+
+	unsigned int bits = 0;
+	while (((size_t)1 << bits) < half_size)
+		++bits;
+	bit_reverse.resize(half_size);
+	for (size_t i = 0; i < half_size; ++i) {
+		unsigned int rev = 0;
+		for (unsigned int b = 0; b < bits; ++b)
+			rev |= static_cast<unsigned int>((i >> b) & 1) << (bits - 1 - b);
+		bit_reverse[i] = rev;
+	}
+
+	work_r.resize(half_size);
+	work_i.resize(half_size);
+}
+
+void RealFFT::Transform(const float *input, float *output_r, float *output_i) {
+	const size_t n = half_size;
+	float *re = &work_r[0];
+	float *im = &work_i[0];
+
+	// Treat the even samples as the real parts and the odd samples as the
+	// imaginary parts of a complex transform of half the size
+	for (size_t i = 0; i < n; ++i) {
+		re[bit_reverse[i]] = input[i * 2];
+		im[bit_reverse[i]] = input[i * 2 + 1];
+	}
+
+	for (size_t h = 1; h < n; h <<= 1) {
+		const float *wr = &twiddle_r[h - 1];
+		const float *wi = &twiddle_i[h - 1];
+		for (size_t i = 0; i < n; i += h * 2) {
+			size_t j = 0;
+#ifdef AGI_FFT_SIMD
+			for (; j + 4 <= h; j += 4) {
+				const Vec4 w_r = Load(wr + j), w_i = Load(wi + j);
+				const Vec4 a_r = Load(re + i + j), a_i = Load(im + i + j);
+				const Vec4 b_r = Load(re + i + j + h), b_i = Load(im + i + j + h);
+				const Vec4 t_r = Sub(Mul(w_r, b_r), Mul(w_i, b_i));
+				const Vec4 t_i = Add(Mul(w_r, b_i), Mul(w_i, b_r));
+				Store(re + i + j + h, Sub(a_r, t_r));
+				Store(im + i + j + h, Sub(a_i, t_i));
+				Store(re + i + j, Add(a_r, t_r));
+				Store(im + i + j, Add(a_i, t_i));
+			}
+#endif
+			for (; j < h; ++j) {
+				float *a_r = re + i + j, *a_i = im + i + j;
+				float *b_r = a_r + h, *b_i = a_i + h;
+				const float t_r = wr[j] * *b_r - wi[j] * *b_i;
+				const float t_i = wr[j] * *b_i + wi[j] * *b_r;
+				*b_r = *a_r - t_r;
+				*b_i = *a_i - t_i;
+				*a_r += t_r;
+				*a_i += t_i;
+			}
+		}
+	}
+
+	// Separate the transforms of the even and odd samples from bins k and
+	// n - k of the packed transform, then combine them into bin k
+	output_r[0] = re[0] + im[0];
+	output_i[0] = 0.f;
+	size_t k = 1;
+#ifdef AGI_FFT_SIMD
+	const Vec4 half = Splat(.5f);
+	for (; k + 4 <= n; k += 4) {
+		const Vec4 a_r = Load(re + k), a_i = Load(im + k);
+		const Vec4 b_r = Reverse(Load(re + n - k - 3)), b_i = Reverse(Load(im + n - k - 3));
+		const Vec4 w_r = Load(&unpack_r[k]), w_i = Load(&unpack_i[k]);
+		const Vec4 s_r = Add(a_r, b_r), s_i = Sub(a_i, b_i);
+		const Vec4 d_r = Add(a_i, b_i), d_i = Sub(b_r, a_r);
+		Store(output_r + k, Mul(half, Add(s_r, Sub(Mul(w_r, d_r), Mul(w_i, d_i)))));
+		Store(output_i + k, Mul(half, Add(s_i, Add(Mul(w_r, d_i), Mul(w_i, d_r)))));
+	}
+#endif
+	for (; k < n; ++k) {
+		const float s_r = re[k] + re[n - k], s_i = im[k] - im[n - k];
+		const float d_r = im[k] + im[n - k], d_i = re[n - k] - re[k];
+		output_r[k] = .5f * (s_r + unpack_r[k] * d_r - unpack_i[k] * d_i);
+		output_i[k] = .5f * (s_i + unpack_r[k] * d_i + unpack_i[k] * d_r);
+	}
+}
+}
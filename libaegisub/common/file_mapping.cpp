@@ -26,14 +26,38 @@
 
 #ifdef _WIN32
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
 #endif
 
 using namespace boost::interprocess;
 
 namespace {
+/// How much of the file to map at once when the whole file can't be mapped.
+/// This grows while the file is read front to back, so that reading
+/// through a large file doesn't have to remap it every 16 MB.
+const uint64_t min_window = 16 * 1024 * 1024;
+const uint64_t max_window = 64 * 1024 * 1024;
+
+/// How far read_ahead() reads ahead, which grows the longer the file is read
+/// front to back
+const uint64_t min_read_ahead = 1024 * 1024;
+const uint64_t max_read_ahead = 32 * 1024 * 1024;
+
+void apply_pattern(agi::mapping_view& view) {
+	static const mapped_region::advice_types advice[] = {
+		mapped_region::advice_normal,
+		mapped_region::advice_sequential,
+		mapped_region::advice_random
+	};
+	// Not all platforms support this, and it's only a hint anyway
+	if (view.region)
+		view.region->advise(advice[static_cast<int>(view.pattern)]);
+}
+
 char *map(int64_t s_offset, uint64_t length, boost::interprocess::mode_t mode,
-	uint64_t file_size, agi::file_mapping const& file,
-	std::unique_ptr<mapped_region>& region, uint64_t& mapping_start)
+	uint64_t file_size, agi::file_mapping const& file, agi::mapping_view& view)
 {
 	static char dummy = 0;
 	if (length == 0) return &dummy;
@@ -43,18 +67,26 @@ char *map(int64_t s_offset, uint64_t length, boost::interprocess::mode_t mode,
 		throw agi::InternalError("Attempted to map beyond end of file");
 
 	// Check if we can just use the current mapping
-	if (region && offset >= mapping_start && offset + length <= mapping_start + region->get_size())
-		return static_cast<char *>(region->get_address()) + offset - mapping_start;
+	auto& region = view.region;
+	if (region && offset >= view.start && offset + length <= view.start + region->get_size())
+		return static_cast<char *>(region->get_address()) + offset - view.start;
 
+	uint64_t mapping_start = 0;
 	if (sizeof(size_t) == 4) {
+		// Reading on from within the current view means the file is being
+		// read front to back
+		if (region && offset >= view.start && offset <= view.start + region->get_size())
+			view.window = std::min(view.window * 2, max_window);
+		else
+			view.window = min_window;
+
 		mapping_start = offset & ~0xFFFFFULL; // Align to 1 MB bondary
 		length += static_cast<size_t>(offset - mapping_start);
-		// Map 16 MB or length rounded up to the next MB
-		length = std::min<uint64_t>(std::max<uint64_t>(0x1000000U, (length + 0xFFFFF) & ~0xFFFFF), file_size - mapping_start);
+		// Map the window size or length rounded up to the next MB
+		length = std::min<uint64_t>(std::max<uint64_t>(view.window, (length + 0xFFFFF) & ~0xFFFFF), file_size - mapping_start);
 	}
 	else {
 		// Just map the whole file
-		mapping_start = 0;
 		length = file_size;
 	}
 
@@ -67,10 +99,87 @@ char *map(int64_t s_offset, uint64_t length, boost::interprocess::mode_t mode,
 	catch (interprocess_exception const&) {
 		throw agi::fs::FileSystemUnknownError("Failed mapping a view of the file");
 	}
+	view.start = mapping_start;
+	apply_pattern(view);
 
 	return static_cast<char *>(region->get_address()) + offset - mapping_start;
 }
 
+/// Ask the OS to start reading part of the file into memory
+bool os_read_ahead(agi::file_mapping const& file, agi::mapping_view const& view, uint64_t offset, uint64_t length) {
+#ifdef _WIN32
+	// PrefetchVirtualMemory was added in Windows 8, and only works on the
+	// part of the file which is currently mapped
+	struct range_entry { PVOID address; SIZE_T size; };
+	typedef BOOL (WINAPI *prefetch_fn)(HANDLE, ULONG_PTR, range_entry *, ULONG);
+	static const auto prefetch = reinterpret_cast<prefetch_fn>(
+		GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory"));
+
+	if (!prefetch || !view.region || offset < view.start || offset + length > view.start + view.region->get_size())
+		return false;
+	range_entry range{static_cast<char *>(view.region->get_address()) + (offset - view.start), static_cast<SIZE_T>(length)};
+	return !!prefetch(GetCurrentProcess(), 1, &range, 0);
+#elif defined(__APPLE__)
+	radvisory advice;
+	advice.ra_offset = static_cast<off_t>(offset);
+	advice.ra_count = static_cast<int>(std::min<uint64_t>(length, std::numeric_limits<int>::max()));
+	return fcntl(file.get_mapping_handle().handle, F_RDADVISE, &advice) != -1;
+#else
+	return posix_fadvise(file.get_mapping_handle().handle, static_cast<off_t>(offset),
+		static_cast<off_t>(length), POSIX_FADV_WILLNEED) == 0;
+#endif
+}
+
+/// Read a byte from each page of the data on a background thread, for when
+/// the OS can't be asked to read ahead
+void touch_pages(agi::read_ahead_state& state, const char *data, uint64_t length) {
+	if (!state.queue)
+		state.queue = agi::dispatch::Create();
+
+	auto cancel = state.cancel;
+	state.queue->Async([=] {
+		volatile char sink = 0;
+		for (uint64_t i = 0; i < length && !cancel.IsCancelled(); i += 4096)
+			sink = data[i];
+		(void)sink;
+	}, agi::dispatch::Priority::Prefetch, state.cancel);
+}
+
+void read_ahead(int64_t s_offset, uint64_t file_size, agi::file_mapping const& file,
+	agi::mapping_view& view, agi::read_ahead_state& state)
+{
+	auto offset = static_cast<uint64_t>(s_offset);
+	if (offset >= file_size) return;
+
+	if (state.window && offset >= state.position && offset <= state.end) {
+		// Still reading forwards, so wait until most of what's already
+		// been read ahead has been used and then read further ahead
+		if (state.end - offset > state.window / 2) return;
+		state.window = std::min(state.window * 2, max_read_ahead);
+	}
+	else {
+		state.window = min_read_ahead;
+		state.end = offset;
+	}
+	state.position = offset;
+
+	const uint64_t end = std::min(offset + state.window, file_size);
+	if (end <= state.end) return;
+	const uint64_t start = state.end;
+	state.end = end;
+
+	if (os_read_ahead(file, view, start, end - start)) return;
+	// Touching pages on another thread needs the view to stay put
+	if (agi::mapped_views_are_stable())
+		touch_pages(state, map(start, end - start, read_only, file_size, file, view), end - start);
+}
+
+void stop_read_ahead(agi::read_ahead_state& state) {
+	if (!state.queue) return;
+	state.cancel.Cancel();
+	// Wait for one which has already started
+	state.queue->Sync([] { }, agi::dispatch::Priority::Background);
+}
 }
 
 namespace agi {
@@ -126,17 +235,31 @@ read_file_mapping::read_file_mapping(fs::path const& filename)
 	file_size = static_cast<uint64_t>(size);
 }
 
-read_file_mapping::~read_file_mapping() { }
+read_file_mapping::~read_file_mapping() {
+	stop_read_ahead(ahead);
+}
 
 const char *read_file_mapping::read() {
 	return read(0, size());
 }
 
 const char *read_file_mapping::read(int64_t offset, uint64_t length) {
-	return map(offset, length, read_only, file_size, file, region, mapping_start);
+	std::lock_guard<std::mutex> lock(mutex);
+	return map(offset, length, read_only, file_size, file, view);
+}
+
+void read_file_mapping::advise(access_pattern pattern) {
+	std::lock_guard<std::mutex> lock(mutex);
+	view.pattern = pattern;
+	apply_pattern(view);
+}
+
+void read_file_mapping::read_ahead(int64_t offset) {
+	std::lock_guard<std::mutex> lock(mutex);
+	::read_ahead(offset, file_size, file, view, ahead);
 }
 
-temp_file_mapping::temp_file_mapping(fs::path const& filename, uint64_t size)
+temp_file_mapping::temp_file_mapping(fs::path const& filename, uint64_t size, bool keep)
 : file(filename, true)
 , file_size(size)
 {
@@ -147,7 +270,8 @@ temp_file_mapping::temp_file_mapping(fs::path const& filename, uint64_t size)
 	SetFilePointerEx(handle, li, nullptr, FILE_BEGIN);
 	SetEndOfFile(handle);
 #else
-	unlink(filename.string().c_str());
+	if (!keep)
+		unlink(filename.string().c_str());
 	if (ftruncate(handle, size) == -1) {
 		switch (errno) {
 		case EBADF:  throw InternalError("Error opening file " + filename.string() + " not handled");
@@ -157,16 +281,54 @@ temp_file_mapping::temp_file_mapping(fs::path const& filename, uint64_t size)
 		default: throw fs::FileSystemUnknownError("Unknown error opening file: " + filename.string());
 		}
 	}
+#ifdef __linux__
+	// Allocate the disk space up front, so that running out of space is an
+	// error here rather than a SIGBUS when writing to the mapping. Not all
+	// filesystems support this, and ones which don't are just left sparse.
+	if (fallocate(handle, 0, 0, size) == -1 && errno == ENOSPC)
+		throw fs::DriveFull(filename);
 #endif
+#endif
+
+	if (mapped_views_are_stable() && size > 0) {
+		data = map(0, size, read_write, file_size, file, write_view);
+#ifdef MADV_HUGEPAGE
+		// Only does anything if the file is on a filesystem which supports
+		// huge pages, such as a tmpfs mounted with them enabled
+		madvise(data, static_cast<size_t>(size), MADV_HUGEPAGE);
+#endif
+	}
 }
 
-temp_file_mapping::~temp_file_mapping() { }
+temp_file_mapping::~temp_file_mapping() {
+	stop_read_ahead(ahead);
+}
 
 const char *temp_file_mapping::read(int64_t offset, uint64_t length) {
-	return map(offset, length, read_only, file_size, file, read_region, read_mapping_start);
+	if (data) return write(offset, length);
+	std::lock_guard<std::mutex> lock(mutex);
+	return map(offset, length, read_only, file_size, file, read_view);
 }
 
 char *temp_file_mapping::write(int64_t offset, uint64_t length) {
-	return map(offset, length, read_write, file_size, file, write_region, write_mapping_start);
+	if (data) {
+		if (static_cast<uint64_t>(offset) + length > file_size)
+			throw InternalError("Attempted to map beyond end of file");
+		return data + offset;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	return map(offset, length, read_write, file_size, file, write_view);
+}
+
+void temp_file_mapping::advise(access_pattern pattern) {
+	std::lock_guard<std::mutex> lock(mutex);
+	read_view.pattern = write_view.pattern = pattern;
+	apply_pattern(read_view);
+	apply_pattern(write_view);
+}
+
+void temp_file_mapping::read_ahead(int64_t offset) {
+	std::lock_guard<std::mutex> lock(mutex);
+	::read_ahead(offset, file_size, file, data ? write_view : read_view, ahead);
 }
 }
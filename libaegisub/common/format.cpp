@@ -20,6 +20,9 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <boost/filesystem/path.hpp>
+#include <cstdio>
+#include <iterator>
+#include <vector>
 
 #ifdef _MSC_VER
 #define WCHAR_T_ENC "utf-16le"
@@ -311,5 +314,285 @@ formatter<Char>::~formatter() {
 template class formatter<char>;
 template class formatter<wchar_t>;
 
+template<typename Char>
+bool string_formatter<Char>::parse_next() {
+	// Copy the literal text up to the next specifier
+	for (size_t len = 0; ; ++len) {
+		// Ran out of format specifiers; not an error due to that
+		// translated strings may not need them all
+		if (!fmt[len]) {
+			out.append(fmt, len);
+			fmt += len;
+			return false;
+		}
+
+		if (fmt[len] == '%') {
+			if (fmt[len + 1] == '%') {
+				out.append(fmt, len);
+				fmt += len + 1;
+				len = 0;
+				continue;
+			}
+
+			out.append(fmt, len);
+			fmt += len;
+			break;
+		}
+	}
+
+	width = 0;
+	precision = -1;
+	left = zero = plus = alt = upper = false;
+
+	// Don't touch fmt until the specifier is fully applied so that if we
+	// have insufficient arguments it'll get passed through to the output
+	fmt_cur = fmt + 1;
+
+	// Flags
+	for (; ; ++fmt_cur) {
+		if (*fmt_cur == '#')
+			alt = true;
+		else if (*fmt_cur == '0')
+			// overridden by left alignment ('-' flag)
+			zero = !left;
+		else if (*fmt_cur == '-') {
+			left = true;
+			zero = false;
+		}
+		else if (*fmt_cur == '+')
+			plus = true;
+		else
+			break;
+	}
+
+	auto read_int = [&] {
+		int i = 0;
+		for (; *fmt_cur >= '0' && *fmt_cur <= '9'; ++fmt_cur)
+			i = 10 * i + (*fmt_cur - '0');
+		return i;
+	};
+
+	// Width
+	if (*fmt_cur >= '0' && *fmt_cur <= '9')
+		width = read_int();
+	else if (*fmt_cur == '*') {
+		read_width = true;
+		pending = true;
+		++fmt_cur;
+	}
+
+	// Precision
+	if (*fmt_cur == '.') {
+		++fmt_cur;
+		if (*fmt_cur >= '0' && *fmt_cur <= '9')
+			precision = read_int();
+		else if (*fmt_cur == '*') {
+			read_precision = true;
+			pending = true;
+			++fmt_cur;
+		}
+		else
+			precision = 0;
+	}
+
+	// Length modifiers, which are skipped since we don't need them
+	for (Char c = *fmt_cur;
+		c == 'l' || c == 'h' || c == 'L' || c == 'j' || c == 'z' || c == 't';
+		c = *++fmt_cur);
+
+	return true;
+}
+
+template<typename Char>
+Char string_formatter<Char>::next_format() {
+	pending = false;
+
+	if (width < 0) {
+		left = true;
+		zero = false;
+		width = -width;
+	}
+
+	Char c = *fmt_cur ? fmt_cur[0] : 's';
+	if (c >= 'A' && c <= 'Z') {
+		upper = true;
+		c += 'a' - 'A';
+	}
+
+	fmt = *fmt_cur ? fmt_cur + 1 : fmt_cur;
+	return c;
+}
+
+template<typename Char>
+void string_formatter<Char>::pad(size_t start, size_t prefix) {
+	size_t len = out.size() - start;
+	if (static_cast<size_t>(width) <= len) return;
+	size_t count = width - len;
+
+	if (left)
+		out.append(count, ' ');
+	else if (zero)
+		out.insert(start + prefix, count, '0');
+	else
+		out.insert(start, count, ' ');
+}
+
+template<typename Char>
+void string_formatter<Char>::apply(std::basic_ostream<Char>& stream) const {
+	stream.fill(zero ? '0' : ' ');
+	if (left)
+		stream.setf(std::ios::left, std::ios::adjustfield);
+	else if (zero)
+		stream.setf(std::ios::internal, std::ios::adjustfield);
+	if (alt)
+		stream.setf(std::ios::showpoint | std::ios::showbase);
+	if (plus)
+		stream.setf(std::ios::showpos);
+	if (upper)
+		stream.setf(std::ios::uppercase);
+	stream.setf(std::ios::boolalpha);
+	stream.width(width);
+	stream.precision(precision < 0 ? 6 : precision);
+}
+
+template<typename Char>
+void string_formatter<Char>::write_integer(uintmax_t value, unsigned base, Char sign) {
+	// Written backwards from the end of the buffer
+	Char buffer[sizeof(uintmax_t) * 3 + 3];
+	Char *end = std::end(buffer), *cur = end;
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	const bool nonzero = value != 0;
+	do {
+		*--cur = digits[value % base];
+		value /= base;
+	} while (value);
+
+	// As with iostreams, the base is only shown for non-zero values and zero
+	// padding goes after the sign and 0x but before octal's leading zero
+	size_t prefix = 0;
+	if (alt && nonzero && base == 8)
+		*--cur = '0';
+	else if (alt && nonzero && base == 16) {
+		*--cur = upper ? 'X' : 'x';
+		*--cur = '0';
+		prefix = 2;
+	}
+	if (sign) {
+		*--cur = sign;
+		++prefix;
+	}
+
+	size_t start = out.size();
+	out.append(cur, end);
+	pad(start, prefix);
+}
+
+template<typename Char>
+void string_formatter<Char>::write_int(intmax_t value) {
+	if (value < 0)
+		write_integer(0 - static_cast<uintmax_t>(value), 10, '-');
+	else
+		write_integer(static_cast<uintmax_t>(value), 10, plus ? '+' : 0);
+}
+
+template<typename Char>
+void string_formatter<Char>::write_unsigned(uintmax_t value, unsigned base) {
+	write_integer(value, base, 0);
+}
+
+template<typename Char>
+void string_formatter<Char>::write_pointer(const void *value) {
+	// iostreams always write pointers as lower-case hex with the base
+	bool was_alt = alt, was_upper = upper;
+	alt = true;
+	upper = false;
+	write_integer(reinterpret_cast<uintptr_t>(value), 16, 0);
+	alt = was_alt;
+	upper = was_upper;
+}
+
+template<typename Char>
+void string_formatter<Char>::write_double(double value, Char conversion) {
+	// iostreams are specified in terms of printf, so use the same conversion
+	// they would. Fixed is always lower-case as %F isn't in C++98.
+	char spec[8];
+	char *cur = spec;
+	*cur++ = '%';
+	if (plus) *cur++ = '+';
+	if (alt) *cur++ = '#';
+	*cur++ = '.';
+	*cur++ = '*';
+	*cur++ = conversion == 'f' ? 'f' : upper ? conversion - 'a' + 'A' : conversion;
+	*cur = 0;
+
+	char buffer[64];
+	const int prec = precision < 0 ? 6 : precision;
+	int len = snprintf(buffer, sizeof(buffer), spec, prec, value);
+
+	size_t start = out.size();
+	if (len >= 0 && static_cast<size_t>(len) < sizeof(buffer))
+		out.append(buffer, buffer + len);
+	else {
+		// Only very large fixed values with a lot of precision get here
+		std::vector<char> large(len + 1);
+		snprintf(large.data(), large.size(), spec, prec, value);
+		out.append(large.begin(), large.end() - 1);
+	}
+
+	pad(start, out.size() > start && (out[start] == '-' || out[start] == '+'));
+}
+
+template<typename Char>
+void string_formatter<Char>::write_char(Char value) {
+	size_t start = out.size();
+	out += value;
+	pad(start, 0);
+}
+
+template<typename Char>
+void string_formatter<Char>::write_bool(bool value) {
+	static const Char true_str[] = {'t', 'r', 'u', 'e', 0};
+	static const Char false_str[] = {'f', 'a', 'l', 's', 'e', 0};
+	size_t start = out.size();
+	if (value)
+		out.append(true_str, 4);
+	else
+		out.append(false_str, 5);
+	pad(start, 0);
+}
+
+template<typename Char>
+void string_formatter<Char>::write_str(const Char *value, size_t len, bool padded) {
+	// Precision is the maximum length of strings which weren't padded
+	if (!padded && precision > 0 && static_cast<size_t>(precision) < len)
+		len = precision;
+
+	size_t start = out.size();
+	out.append(value, len);
+	if (padded)
+		pad(start, 0);
+}
+
+template<typename Char>
+string_formatter<Char>::~string_formatter() {
+	// Write remaining formatting string
+	for (size_t len = 0; ; ++len) {
+		if (!fmt[len]) {
+			out.append(fmt, len);
+			return;
+		}
+
+		if (fmt[len] == '%' && fmt[len + 1] == '%') {
+			out.append(fmt, len);
+			fmt += len + 1;
+			len = 0;
+			continue;
+		}
+	}
+}
+
+template class string_formatter<char>;
+template class string_formatter<wchar_t>;
+
 } }
 
@@ -96,6 +96,12 @@ namespace {
 		CHECKED_CALL(bfs::rename(from, to, ec), from, to);
 	}
 
+	bool HardLink(path const& from, path const& to) {
+		boost::system::error_code ec;
+		bfs::create_hard_link(from, to, ec);
+		return !ec;
+	}
+
 	bool HasExtension(path const& p, std::string const& ext) {
 		auto filename = p.filename().string();
 		if (filename.size() < ext.size() + 1) return false;
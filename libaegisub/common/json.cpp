@@ -24,13 +24,16 @@
 #include "libaegisub/log.h"
 
 #include <boost/interprocess/streams/bufferstream.hpp>
+#include <cstring>
 
 namespace agi { namespace json_util {
 
-json::UnknownElement parse(std::istream &stream) {
+namespace {
+template<typename... Args>
+json::UnknownElement read_logged(Args&&... args) {
 	try {
 		json::UnknownElement root;
-		json::Reader::Read(root, stream);
+		json::Reader::Read(root, std::forward<Args>(args)...);
 		return root;
 	} catch (json::Reader::ParseException& e) {
 		LOG_E("json/parse") << "json::ParseException: " << e.what() << ", Line/offset: " << e.m_locTokenBegin.m_nLine + 1 << '/' << e.m_locTokenBegin.m_nLineOffset + 1;
@@ -40,6 +43,126 @@ json::UnknownElement parse(std::istream &stream) {
 		throw;
 	}
 }
+}
+
+json::UnknownElement parse(std::istream &stream) {
+	return read_logged(stream);
+}
+
+namespace {
+const char flat_header[] = "\0agi-flat\1";
+const size_t flat_header_size = sizeof(flat_header) - 1;
+
+/// Cursor over a flattened document. The documents are generated at build
+/// time, so running off the end means the build is broken.
+struct FlatReader {
+	const char *pos;
+	const char *end;
+
+	void Need(size_t size) {
+		if (static_cast<size_t>(end - pos) < size)
+			throw agi::InternalError("Truncated flattened JSON document");
+	}
+
+	unsigned char Byte() {
+		Need(1);
+		return static_cast<unsigned char>(*pos++);
+	}
+
+	uint32_t U32() {
+		Need(4);
+		auto bytes = reinterpret_cast<const unsigned char *>(pos);
+		pos += 4;
+		return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+	}
+
+	std::string String() {
+		uint32_t size = U32();
+		Need(size);
+		std::string str(pos, size);
+		pos += size;
+		return str;
+	}
+
+	json::UnknownElement Value() {
+		switch (Byte()) {
+			case 's': return String();
+			case 'i': {
+				auto str = String();
+				return static_cast<int64_t>(std::stoll(str));
+			}
+			case 'd': {
+				// The same conversion as the cajun reader, which unlike
+				// strtod doesn't depend on the C locale
+				auto str = String();
+				boost::interprocess::ibufferstream stream(str.data(), str.size());
+				double value = 0;
+				stream >> value;
+				return value;
+			}
+			case 't': return true;
+			case 'f': return false;
+			case 'n': return json::Null();
+			case 'a': {
+				json::Array array;
+				array.resize(U32());
+				for (auto& element : array)
+					element = Value();
+				return std::move(array);
+			}
+			case 'o': {
+				json::Object object;
+				for (uint32_t count = U32(); count > 0; --count) {
+					auto key = String();
+					object[std::move(key)] = Value();
+				}
+				return std::move(object);
+			}
+			default:
+				throw agi::InternalError("Invalid value in flattened JSON document");
+		}
+	}
+};
+}
+
+bool is_flat(std::pair<const char *, size_t> data) {
+	return data.second >= flat_header_size && !memcmp(data.first, flat_header, flat_header_size);
+}
+
+void read_flat(std::pair<const char *, size_t> data, std::function<void (std::vector<std::string> const&, json::UnknownElement&)> const& fn) {
+	FlatReader reader{data.first + flat_header_size, data.first + data.second};
+	std::vector<std::string> path;
+	while (reader.pos < reader.end) {
+		size_t shared = reader.Byte();
+		size_t added = reader.Byte();
+		if (shared > path.size())
+			throw agi::InternalError("Invalid path in flattened JSON document");
+		path.resize(shared);
+		for (; added > 0; --added)
+			path.push_back(reader.String());
+		auto value = reader.Value();
+		fn(path, value);
+	}
+}
+
+json::UnknownElement parse(std::pair<const char *, size_t> data) {
+	if (!is_flat(data))
+		return read_logged(data.first, data.first + data.second);
+
+	json::UnknownElement root = json::Object();
+	read_flat(data, [&](std::vector<std::string> const& path, json::UnknownElement& value) {
+		if (path.empty()) {
+			root = std::move(value);
+			return;
+		}
+
+		json::Object *obj = &static_cast<json::Object&>(root);
+		for (size_t i = 0; i + 1 < path.size(); ++i)
+			obj = &static_cast<json::Object&>((*obj)[path[i]]);
+		(*obj)[path.back()] = std::move(value);
+	});
+	return root;
+}
 
 json::UnknownElement file(agi::fs::path const& file, std::pair<const char *, size_t> default_config) {
 	try {
@@ -55,8 +178,7 @@ json::UnknownElement file(agi::fs::path const& file, std::pair<const char *, siz
 	catch (agi::Exception& e) {
 		LOG_E("json/file") << "Unexpected error when reading config file " << file << ": " << e.GetMessage();
 	}
-	boost::interprocess::ibufferstream stream(default_config.first, default_config.second);
-	return parse(stream);
+	return parse(default_config);
 }
 
 } }
@@ -582,12 +582,25 @@ bool cmp_kana(agi::kana_pair const& kp, std::string const& kana) {
 	return strcmp(kp.kana, kana.c_str()) < 0;
 }
 
+/// strcmp of a table entry against the first len bytes of romaji, so that
+/// looking up each prefix of a syllable doesn't have to copy it
+int compare_prefix(const char *entry, const char *romaji, size_t len) {
+	if (int cmp = strncmp(entry, romaji, len))
+		return cmp;
+	return entry[len] ? 1 : 0;
+}
+
+struct romaji_prefix {
+	const char *str;
+	size_t len;
+};
+
 struct cmp_romaji {
-	bool operator()(agi::kana_pair const& kp, std::string const& romaji) const {
-		return strcmp(kp.romaji, romaji.c_str()) < 0;
+	bool operator()(agi::kana_pair const& kp, romaji_prefix const& romaji) const {
+		return compare_prefix(kp.romaji, romaji.str, romaji.len) < 0;
 	}
-	bool operator()(std::string const& romaji, agi::kana_pair const& kp) const {
-		return strcmp(kp.romaji, romaji.c_str()) > 0;
+	bool operator()(romaji_prefix const& romaji, agi::kana_pair const& kp) const {
+		return compare_prefix(kp.romaji, romaji.str, romaji.len) > 0;
 	}
 
 #ifdef _MSC_VER // debug iterator stuff needs this overload
@@ -611,7 +624,7 @@ std::vector<const char *> kana_to_romaji(std::string const& kana) {
 
 boost::iterator_range<const kana_pair *> romaji_to_kana(std::string const& romaji) {
 	for (size_t len = std::min<size_t>(3, romaji.size()); len > 0; --len) {
-		auto pair = boost::equal_range(::romaji_to_kana, romaji.substr(0, len).c_str(), cmp_romaji());
+		auto pair = boost::equal_range(::romaji_to_kana, romaji_prefix{romaji.c_str(), len}, cmp_romaji());
 		if (pair.first != pair.second)
 			return boost::make_iterator_range(pair.first, pair.second);
 	}
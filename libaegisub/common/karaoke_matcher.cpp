@@ -48,9 +48,10 @@ bool is_whitespace(std::string const& str) {
 }
 
 // strcmp but ignoring case and accents
-int compare(std::string const& a, std::string const& b) {
-	using namespace boost::locale;
-	return std::use_facet<collator<char>>(std::locale()).compare(collator_base::primary, a, b);
+template<typename Segment>
+int compare(boost::locale::collator<char> const& coll, Segment const& a, Segment const& b) {
+	return coll.compare(boost::locale::collator_base::primary,
+		&*a.begin(), &*a.begin() + a.length(), &*b.begin(), &*b.begin() + b.length());
 }
 
 }
@@ -64,6 +65,10 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 	using namespace boost::locale::boundary;
 	using boost::starts_with;
 
+	// Looked up once rather than for every character compared
+	std::locale locale;
+	auto const& coll = std::use_facet<boost::locale::collator<char>>(locale);
+
 	result.source_length = 1;
 	ssegment_index destination_characters(character, begin(dest_string), end(dest_string));
 	auto src = boost::to_lower_copy(source_strings[0]);
@@ -77,7 +82,7 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 		while (is_whitespace(next_codepoint(src.c_str(), &i)))
 			first_non_whitespace = i;
 		if (first_non_whitespace)
-			src = src.substr(first_non_whitespace);
+			src.erase(0, first_non_whitespace);
 
 		while (dst != dst_end && is_whitespace(dst->str())) {
 			++dst;
@@ -102,11 +107,11 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 	// character. If it does, match them and repeat.
 	while (!src.empty()) {
 		// First check for a basic match of the first character of the source and dest
-		auto first_src_char = ssegment_index(character, begin(src), end(src)).begin()->str();
-		if (compare(first_src_char, dst->str()) == 0) {
+		auto first_src_char = *ssegment_index(character, begin(src), end(src)).begin();
+		if (compare(coll, first_src_char, *dst) == 0) {
 			++dst;
 			++result.destination_length;
-			src.erase(0, first_src_char.size());
+			src.erase(0, first_src_char.length());
 			if (eat_whitespace()) return result;
 			continue;
 		}
@@ -114,7 +119,7 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 		auto check = [&](kana_pair const& kp) -> bool {
 			if (!starts_with(&*dst->begin(), kp.kana)) return false;
 
-			src = src.substr(strlen(kp.romaji));
+			src.erase(0, strlen(kp.romaji));
 			for (size_t i = 0; kp.kana[i]; ) {
 				i += dst->length();
 				++result.destination_length;
@@ -160,6 +165,16 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 	// skipping. Higher numbers probably increase false-positives.
 	static const int dst_lookahead_max = 3;
 
+	// The syllables which can be searched, lowercased once up front rather
+	// than for each destination character tried. Blank syllables don't count
+	// towards the search distance, and the current syllable is never a match.
+	std::vector<std::pair<std::string const*, std::string>> search_syllables;
+	for (auto const& syl : source_strings) {
+		if (is_whitespace(syl)) continue;
+		if (search_syllables.size() == static_cast<size_t>(dst_lookahead_max * max_character_length)) break;
+		search_syllables.emplace_back(&syl, boost::to_lower_copy(syl));
+	}
+
 	for (size_t lookahead = 0; lookahead < dst_lookahead_max; ++lookahead) {
 		if (++dst == dst_end) break;
 
@@ -173,14 +188,12 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 		// Search for it and the transliterated version in the source
 		int src_lookahead_max = (lookahead + 1) * max_character_length;
 		int src_lookahead_pos = 0;
-		for (auto const& syl : source_strings) {
-			// Don't count blank syllables in the max search distance
-			if (is_whitespace(syl)) continue;
+		for (auto const& syl : search_syllables) {
 			if (++src_lookahead_pos == 1) continue;
 			if (src_lookahead_pos > src_lookahead_max) break;
 
-			std::string lsyl = boost::to_lower_copy(syl);
-			if (!(starts_with(syl, dst->str()) || util::any_of(translit, [&](const char *str) { return starts_with(lsyl, str); })))
+			auto const& lsyl = syl.second;
+			if (!(starts_with(*syl.first, *dst) || util::any_of(translit, [&](const char *str) { return starts_with(lsyl, str); })))
 				continue;
 
 			// The syllable immediately after the current one matched, so
@@ -20,53 +20,59 @@
 #include "libaegisub/keyframe.h"
 
 #include "libaegisub/io.h"
-#include "libaegisub/line_iterator.h"
+
+#include "mapped_lines.h"
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/range/algorithm/copy.hpp>
 
 namespace {
-std::vector<int> agi_keyframes(std::istream &file) {
-	double fps;
-	std::string fps_str;
-	file >> fps_str;
-	file >> fps;
-
-	return std::vector<int>(agi::line_iterator<int>(file), agi::line_iterator<int>());
+std::vector<int> agi_keyframes(agi::read_file_mapping &file, uint64_t offset) {
+	// The "fps" line after the header isn't a number, so it's skipped along
+	// with any other junk
+	std::vector<int> ret;
+	agi::for_each_line(file, offset, [&](const char *begin, const char *end) {
+		int frame;
+		if (agi::parse_int(begin, end, frame))
+			ret.push_back(frame);
+	});
+	return ret;
 }
 
-std::vector<int> other_keyframes(std::istream &file, char (*func)(std::string const&)) {
+template<typename Func>
+std::vector<int> other_keyframes(agi::read_file_mapping &file, uint64_t offset, Func&& func) {
 	int count = 0;
 	std::vector<int> ret;
-	agi::line_iterator<std::string> end;
-	for (auto line : agi::line_iterator<std::string>(file)) {
-		char c = tolower(func(line));
+	agi::for_each_line(file, offset, [&](const char *begin, const char *end) {
+		char c = tolower(func(begin, end));
 		if (c == 'i')
 			ret.push_back(count++);
 		else if (c == 'p' || c == 'b')
 			++count;
-	}
+	});
 	return ret;
 }
 
-char xvid(std::string const& line) {
-	return line.empty() ? 0 : line[0];
+char xvid(const char *begin, const char *end) {
+	return begin == end ? 0 : *begin;
 }
 
-char divx(std::string const& line) {
+char divx(const char *begin, const char *end) {
 	char chrs[] = "IPB";
 	for (int i = 0; i < 3; ++i) {
-		std::string::size_type pos = line.find(chrs[i]);
-		if (pos != line.npos)
-			return line[pos];
+		if (memchr(begin, chrs[i], end - begin))
+			return chrs[i];
 	}
 	return 0;
 }
 
-char x264(std::string const& line) {
-	std::string::size_type pos = line.find("type:");
-	if (pos == line.npos || pos + 5 >= line.size()) return 0;
-	return line[pos + 5];
+char x264(const char *begin, const char *end) {
+	// The frame type is near the start of the line, so only that much of
+	// each line is looked at
+	static const char type[] = "type:";
+	auto pos = std::search(begin, end, type, type + 5);
+	if (pos == end || end - pos <= 5) return 0;
+	return pos[5];
 }
 }
 
@@ -80,18 +86,17 @@ void Save(agi::fs::path const& filename, std::vector<int> const& keyframes) {
 }
 
 std::vector<int> Load(agi::fs::path const& filename) {
-	auto file = io::Open(filename);
-	std::istream &is(*file);
-
-	std::string header;
-	getline(is, header);
-
-	if (header == "# keyframe format v1") return agi_keyframes(is);
-	if (boost::starts_with(header, "# XviD 2pass stat file")) return other_keyframes(is, xvid);
-	if (boost::starts_with(header, "# ffmpeg 2-pass log file, using xvid codec")) return other_keyframes(is, xvid);
-	if (boost::starts_with(header, "# avconv 2-pass log file, using xvid codec")) return other_keyframes(is, xvid);
-	if (boost::starts_with(header, "##map version")) return other_keyframes(is, divx);
-	if (boost::starts_with(header, "#options:")) return other_keyframes(is, x264);
+	read_file_mapping file(filename);
+
+	uint64_t offset;
+	auto header = first_line(file, offset);
+
+	if (header == "# keyframe format v1") return agi_keyframes(file, offset);
+	if (boost::starts_with(header, "# XviD 2pass stat file")) return other_keyframes(file, offset, xvid);
+	if (boost::starts_with(header, "# ffmpeg 2-pass log file, using xvid codec")) return other_keyframes(file, offset, xvid);
+	if (boost::starts_with(header, "# avconv 2-pass log file, using xvid codec")) return other_keyframes(file, offset, xvid);
+	if (boost::starts_with(header, "##map version")) return other_keyframes(file, offset, divx);
+	if (boost::starts_with(header, "#options:")) return other_keyframes(file, offset, x264);
 
 	throw Error("Unknown keyframe format");
 }
@@ -14,7 +14,6 @@
 
 #include "libaegisub/log.h"
 
-#include "libaegisub/cajun/elements.h"
 #include "libaegisub/cajun/writer.h"
 #include "libaegisub/dispatch.h"
 #include "libaegisub/util.h"
@@ -24,6 +23,7 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/range/algorithm/remove_if.hpp>
 #include <chrono>
+#include <cstring>
 
 namespace agi { namespace log {
 
@@ -43,17 +43,55 @@ LogSink::~LogSink() {
 	queue->Sync([&]{ swap(emitters_temp, emitters); });
 }
 
-void LogSink::Log(SinkMessage const& sm) {
-	queue->Async([=] {
+void LogSink::Log(SinkMessage sm) {
+	{
+		std::lock_guard<std::mutex> lock(pending_lock);
+		if (pending.size() >= max_pending) {
+			++dropped;
+			return;
+		}
+		pending.push_back(std::move(sm));
+		if (drain_scheduled) return;
+		drain_scheduled = true;
+	}
+	queue->Async([=] { Drain(); });
+}
+
+void LogSink::Drain() {
+	size_t lost;
+	{
+		std::lock_guard<std::mutex> lock(pending_lock);
+		swap(batch, pending);
+		lost = dropped;
+		dropped = 0;
+		drain_scheduled = false;
+	}
+
+	if (lost) {
+		SinkMessage sm;
+		sm.message = std::to_string(lost) + " log messages were dropped";
+		sm.time = batch.back().time;
+		sm.section = "agi/log/dropped";
+		sm.file = __FILE__;
+		sm.func = __FUNCTION__;
+		sm.severity = Warning;
+		sm.line = __LINE__;
+		batch.push_back(std::move(sm));
+	}
+
+	for (auto& sm : batch) {
+		for (auto& em : emitters) em->log(sm);
+
 		if (messages.size() < 250)
-			messages.push_back(sm);
+			messages.push_back(std::move(sm));
 		else {
-			messages[next_idx] = sm;
+			messages[next_idx] = std::move(sm);
 			if (++next_idx == 250)
 				next_idx = 0;
 		}
-		for (auto& em : emitters) em->log(sm);
-	});
+	}
+	for (auto& em : emitters) em->Flush();
+	batch.clear();
 }
 
 void LogSink::Subscribe(std::unique_ptr<Emitter> em) {
@@ -95,7 +133,7 @@ Message::Message(const char *section, Severity severity, const char *file, const
 
 Message::~Message() {
 	sm.message = std::string(buffer, (std::string::size_type)msg.tellp());
-	agi::log::log->Log(sm);
+	agi::log::log->Log(std::move(sm));
 }
 
 JsonEmitter::JsonEmitter(fs::path const& directory)
@@ -104,17 +142,88 @@ JsonEmitter::JsonEmitter(fs::path const& directory)
 }
 
 void JsonEmitter::log(SinkMessage const& sm) {
-	json::Object entry;
-	entry["sec"]      = sm.time / 1000000000;
-	entry["usec"]     = sm.time % 1000000000;
-	entry["severity"] = sm.severity;
-	entry["section"]  = sm.section;
-	entry["file"]     = sm.file;
-	entry["func"]     = sm.func;
-	entry["line"]     = sm.line;
-	entry["message"]  = sm.message;
-	agi::JsonWriter::Write(entry, *fp);
+	JsonBufferWriter entry;
+	entry.StartObject();
+	entry.Key("file");
+	entry.String(sm.file);
+	entry.Key("func");
+	entry.String(sm.func);
+	entry.Key("line");
+	entry.Integer(sm.line);
+	entry.Key("message");
+	entry.String(sm.message);
+	entry.Key("sec");
+	entry.Integer(sm.time / 1000000000);
+	entry.Key("section");
+	entry.String(sm.section);
+	entry.Key("severity");
+	entry.Integer(sm.severity);
+	entry.Key("usec");
+	entry.Integer(sm.time % 1000000000);
+	entry.EndObject();
+
+	auto const& json = entry.Get();
+	fp->write(json.data(), json.size());
+}
+
+void JsonEmitter::Flush() {
+	fp->flush();
+}
+
+namespace {
+void put_u32(std::string& out, uint32_t value) {
+	for (int i = 0; i < 4; ++i)
+		out += static_cast<char>(value >> (i * 8));
+}
+
+void put_i64(std::string& out, int64_t value) {
+	for (int i = 0; i < 8; ++i)
+		out += static_cast<char>(static_cast<uint64_t>(value) >> (i * 8));
+}
+
+void put_string(std::string& out, const char *str, size_t size) {
+	put_u32(out, size);
+	out.append(str, size);
+}
+}
+
+BinaryEmitter::BinaryEmitter(fs::path const& directory)
+: fp(new boost::filesystem::ofstream(unique_path(directory/util::strftime("%Y-%m-%d-%H-%M-%S-%%%%%%%%.agilog")), std::ios::binary))
+{
+	fp->write("agilog\0\1", 8);
+}
+
+uint32_t BinaryEmitter::Id(const char *str) {
+	auto it = ids.find(str);
+	if (it != ids.end()) return it->second;
+
+	uint32_t id = ids.size();
+	ids[str] = id;
+	buffer += 'S';
+	put_u32(buffer, id);
+	put_string(buffer, str, strlen(str));
+	return id;
+}
+
+void BinaryEmitter::log(SinkMessage const& sm) {
+	uint32_t section = Id(sm.section);
+	uint32_t file = Id(sm.file);
+	uint32_t func = Id(sm.func);
+
+	buffer += 'M';
+	put_i64(buffer, sm.time);
+	buffer += static_cast<char>(sm.severity);
+	put_u32(buffer, sm.line);
+	put_u32(buffer, section);
+	put_u32(buffer, file);
+	put_u32(buffer, func);
+	put_string(buffer, sm.message.data(), sm.message.size());
+}
+
+void BinaryEmitter::Flush() {
+	fp->write(buffer.data(), buffer.size());
 	fp->flush();
+	buffer.clear();
 }
 
 } }
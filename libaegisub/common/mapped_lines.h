@@ -0,0 +1,127 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file mapped_lines.h
+/// @brief Line splitting and number parsing for large ASCII files
+/// @ingroup libaegisub
+///
+/// Keyframe and timecode files can be hundreds of megabytes, and reading them
+/// through line_iterator copies every line into a string and parses every
+/// number with a stream. These read the file through a memory mapping instead.
+
+#pragma once
+
+#include <libaegisub/buffer_lines.h>
+#include <libaegisub/file_mapping.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <string>
+
+namespace agi {
+/// Get the first line of a file, without the line break
+/// @param[out] next Offset of the line after it
+inline std::string first_line(read_file_mapping& file, uint64_t& next) {
+	auto len = std::min<uint64_t>(file.size(), 4096);
+	if (!len) {
+		next = 0;
+		return "";
+	}
+
+	const char *begin = file.read(0, len);
+	const char *end = find_newline(begin, begin + len);
+	next = end - begin + (end != begin + len ? 1 : 0);
+	if (end != begin && end[-1] == '\r')
+		--end;
+	return std::string(begin, end);
+}
+
+/// Call func(begin, end) for each line of a file after the given offset,
+/// without the line break or a trailing CR
+///
+/// The file is mapped a window at a time so that this works for files which
+/// don't fit in the address space.
+template<typename Func>
+void for_each_line(read_file_mapping& file, uint64_t offset, Func&& func) {
+	const uint64_t window = 16 * 1024 * 1024;
+
+	auto emit = [&](const char *begin, const char *end) {
+		if (end != begin && end[-1] == '\r')
+			--end;
+		func(begin, end);
+	};
+
+	file.advise(access_pattern::sequential);
+
+	// A line which crosses the end of a window
+	std::string partial;
+	while (offset < file.size()) {
+		auto len = std::min(window, file.size() - offset);
+		const char *begin = file.read(offset, len);
+		const char *end = begin + len;
+		offset += len;
+
+		while (begin != end) {
+			const char *nl = find_newline(begin, end);
+			if (nl == end) {
+				partial.append(begin, end);
+				break;
+			}
+
+			if (partial.empty())
+				emit(begin, nl);
+			else {
+				partial.append(begin, nl);
+				emit(partial.data(), partial.data() + partial.size());
+				partial.clear();
+			}
+			begin = nl + 1;
+		}
+	}
+
+	if (!partial.empty())
+		emit(partial.data(), partial.data() + partial.size());
+}
+
+/// Parse an integer at the start of a string in the same way as
+/// std::istream's operator>>: leading whitespace is skipped, anything after
+/// the number is ignored, and values which don't fit are an error
+inline bool parse_int(const char *begin, const char *end, int &out) {
+	while (begin != end && (*begin == ' ' || (*begin >= '\t' && *begin <= '\r')))
+		++begin;
+
+	bool negative = false;
+	if (begin != end && (*begin == '-' || *begin == '+'))
+		negative = *begin++ == '-';
+	if (begin == end || *begin < '0' || *begin > '9')
+		return false;
+
+	int64_t value = 0;
+	for (; begin != end && *begin >= '0' && *begin <= '9'; ++begin) {
+		value = value * 10 + (*begin - '0');
+		if (value > int64_t(INT_MAX) + 1)
+			return false;
+	}
+
+	if (negative)
+		value = -value;
+	if (value > INT_MAX || value < INT_MIN)
+		return false;
+	out = static_cast<int>(value);
+	return true;
+}
+}
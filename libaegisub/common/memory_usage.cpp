@@ -0,0 +1,110 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/memory_usage.h"
+
+#include "libaegisub/cache_budget.h"
+#include "libaegisub/format.h"
+#include "libaegisub/log.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace {
+struct Entry {
+	uint64_t id;
+	std::string name;
+	std::function<size_t()> size;
+};
+
+struct Registry {
+	std::mutex mutex;
+	std::vector<Entry> entries;
+	uint64_t next_id = 0;
+};
+
+/// Never destroyed, as static registrations may be unregistered after it
+/// would have been
+Registry& registry() {
+	static auto registry = new Registry;
+	return *registry;
+}
+
+std::string format_size(size_t size) {
+	return agi::format("%.1f MB", size / (1024.0 * 1024.0));
+}
+}
+
+namespace agi { namespace memory {
+Registration& Registration::operator=(Registration&& other)
+{
+	if (this != &other) {
+		Unregister();
+		id = other.id;
+		other.id = 0;
+	}
+	return *this;
+}
+
+void Registration::Unregister()
+{
+	if (!id) return;
+	auto& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	auto& entries = r.entries;
+	entries.erase(remove_if(begin(entries), end(entries), [=](Entry const& e) { return e.id == id; }), end(entries));
+	id = 0;
+}
+
+Registration Register(std::string name, std::function<size_t()> size)
+{
+	auto& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	r.entries.push_back(Entry{++r.next_id, std::move(name), std::move(size)});
+	return Registration(r.next_id);
+}
+
+std::vector<Usage> GetUsage()
+{
+	std::map<std::string, size_t> totals;
+	for (auto const& cache : CacheBudget::Global().GetUsage())
+		totals[cache.name] += cache.size;
+	{
+		auto& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		for (auto const& entry : r.entries)
+			totals[entry.name] += entry.size();
+	}
+
+	std::vector<Usage> usage;
+	usage.reserve(totals.size());
+	for (auto const& total : totals)
+		usage.push_back(Usage{total.first, total.second});
+	std::stable_sort(begin(usage), end(usage), [](Usage const& a, Usage const& b) { return a.size > b.size; });
+	return usage;
+}
+
+void LogUsage(std::vector<Usage> const& usage)
+{
+	size_t total = 0;
+	for (auto const& part : usage) {
+		LOG_I("memory") << part.name << ": " << format_size(part.size);
+		total += part.size;
+	}
+	LOG_I("memory") << "Total accounted for: " << format_size(total);
+}
+} }
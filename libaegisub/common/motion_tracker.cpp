@@ -0,0 +1,254 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/motion_tracker.h"
+
+#include "libaegisub/scene_change.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+/// Smallest half-size of a patch which is matched at a pyramid level
+const int min_radius = 4;
+/// Largest half-size of a patch at full size, as bigger ones are slow to
+/// match and don't track any better
+const int max_radius = 24;
+/// How far each point is searched for at the smallest level, in that
+/// level's pixels
+const int coarse_range = 8;
+/// How far the estimate from the level below is searched around
+const int fine_range = 2;
+/// Largest mean difference per pixel of a match which counts as finding the
+/// point
+const double max_mean_diff = 24.0;
+
+const double pi = 3.14159265358979323846;
+
+const uint64_t no_match = std::numeric_limits<uint64_t>::max();
+
+/// Difference between the patch with top-left corner (x, y) in one level and
+/// the patch offset from it by (ox, oy) in the same level of another
+/// pyramid, or no_match if either isn't entirely inside the image
+uint64_t diff_at(agi::motion::Pyramid const& a, agi::motion::Pyramid const& b, size_t level, int x, int y, int size, int ox, int oy) {
+	const int w = a.Width(level), h = a.Height(level);
+	if (x < 0 || y < 0 || x + size > w || y + size > h)
+		return no_match;
+	const int bx = x + ox, by = y + oy;
+	if (bx < 0 || by < 0 || bx + size > b.Width(level) || by + size > b.Height(level))
+		return no_match;
+	return agi::motion::BlockSumAbsDiff(
+		a.Data(level) + y * w + x, w,
+		b.Data(level) + by * b.Width(level) + bx, b.Width(level),
+		size, size);
+}
+
+/// Sub-pixel offset of the lowest point between three neighbouring
+/// differences, from fitting a V to them (which suits absolute differences
+/// better than a parabola does)
+double sub_pixel(uint64_t left, uint64_t center, uint64_t right) {
+	if (left == no_match || right == no_match) return 0;
+	double rise = double(std::max(left, right)) - double(center);
+	if (rise <= 0) return 0;
+	return std::max(-0.5, std::min(0.5, (double(left) - double(right)) / (2.0 * rise)));
+}
+}
+
+namespace agi { namespace motion {
+uint64_t BlockSumAbsDiff(const uint8_t *a, ptrdiff_t a_pitch, const uint8_t *b, ptrdiff_t b_pitch, int width, int height) {
+	// Each row is one SSE2 sum where it's available
+	uint64_t sum = 0;
+	for (int y = 0; y < height; ++y)
+		sum += scene_change::SumAbsDiff(a + y * a_pitch, b + y * b_pitch, width);
+	return sum;
+}
+
+Pyramid::Pyramid(const uint8_t *data, int width, int height, ptrdiff_t pitch, size_t count) {
+	levels.push_back(Level{std::vector<uint8_t>(size_t(width) * height), width, height});
+	for (int y = 0; y < height; ++y)
+		memcpy(&levels[0].data[size_t(y) * width], data + y * pitch, width);
+
+	while (levels.size() < count && levels.back().width / 2 >= min_radius * 4 && levels.back().height / 2 >= min_radius * 4) {
+		auto const& src = levels.back();
+		Level dst{std::vector<uint8_t>(size_t(src.width / 2) * (src.height / 2)), src.width / 2, src.height / 2};
+		for (int y = 0; y < dst.height; ++y) {
+			const uint8_t *row1 = &src.data[size_t(y * 2) * src.width];
+			const uint8_t *row2 = row1 + src.width;
+			uint8_t *out = &dst.data[size_t(y) * dst.width];
+			for (int x = 0; x < dst.width; ++x)
+				out[x] = (row1[x * 2] + row1[x * 2 + 1] + row2[x * 2] + row2[x * 2 + 1] + 2) / 4;
+		}
+		levels.push_back(std::move(dst));
+	}
+}
+
+void Transform::Apply(double px, double py, double &out_x, double &out_y) const {
+	double rad = angle * pi / 180.0;
+	double c = std::cos(rad) * scale, s = std::sin(rad) * scale;
+	out_x = x + c * px - s * py;
+	out_y = y + s * px + c * py;
+}
+
+Tracker::Tracker(Pyramid first, double x1, double y1, double x2, double y2)
+: radius(std::max(min_radius, std::min(max_radius, int(std::min(std::abs(x2 - x1), std::abs(y2 - y1)) / 4))))
+, prev(std::move(first))
+{
+	current.x = (x1 + x2) / 2;
+	current.y = (y1 + y2) / 2;
+
+	// The centers of the four quarters of the region
+	const double qw = std::abs(x2 - x1) / 4, qh = std::abs(y2 - y1) / 4;
+	for (int i = 0; i < 4; ++i) {
+		Point p;
+		p.ref_x = (i % 2 ? qw : -qw);
+		p.ref_y = (i / 2 ? qh : -qh);
+		p.x = current.x + p.ref_x;
+		p.y = current.y + p.ref_y;
+		points.push_back(p);
+	}
+}
+
+bool Tracker::Match(Pyramid const& next, Point &point) const {
+	const int px = int(std::lround(point.x)), py = int(std::lround(point.y));
+
+	// Only use levels where the patch is still big enough to be distinctive
+	size_t levels = 1;
+	while (levels < prev.size() && levels < next.size() && (radius >> levels) >= min_radius)
+		++levels;
+
+	// Start from where the point would be if it kept moving as it was
+	int ox = int(std::lround(point.dx)) >> (levels - 1);
+	int oy = int(std::lround(point.dy)) >> (levels - 1);
+	int range = coarse_range;
+	uint64_t best = no_match;
+
+	for (size_t level = levels; level-- > 0; ) {
+		const int r = radius >> level;
+		const int x = (px >> level) - r, y = (py >> level) - r;
+
+		int best_x = ox, best_y = oy;
+		best = no_match;
+		for (int dy = oy - range; dy <= oy + range; ++dy) {
+			for (int dx = ox - range; dx <= ox + range; ++dx) {
+				uint64_t diff = diff_at(prev, next, level, x, y, r * 2, dx, dy);
+				if (diff < best) {
+					best = diff;
+					best_x = dx;
+					best_y = dy;
+				}
+			}
+		}
+		if (best == no_match) return false;
+
+		ox = best_x;
+		oy = best_y;
+		if (level) {
+			ox *= 2;
+			oy *= 2;
+			range = fine_range;
+		}
+	}
+
+	const int size = radius * 2;
+	if (best > max_mean_diff * size * size) return false;
+
+	const int x = px - radius, y = py - radius;
+	double sub_x = sub_pixel(
+		diff_at(prev, next, 0, x, y, size, ox - 1, oy), best,
+		diff_at(prev, next, 0, x, y, size, ox + 1, oy));
+	double sub_y = sub_pixel(
+		diff_at(prev, next, 0, x, y, size, ox, oy - 1), best,
+		diff_at(prev, next, 0, x, y, size, ox, oy + 1));
+
+	// The patch was centered on the rounded position, but the point keeps
+	// its fractional part
+	point.dx = ox + sub_x;
+	point.dy = oy + sub_y;
+	point.x += point.dx;
+	point.y += point.dy;
+	return true;
+}
+
+bool Tracker::Fit(std::vector<bool> const& found) {
+	double ref_x = 0, ref_y = 0, cur_x = 0, cur_y = 0;
+	size_t count = 0;
+	for (size_t i = 0; i < points.size(); ++i) {
+		if (!found[i]) continue;
+		ref_x += points[i].ref_x;
+		ref_y += points[i].ref_y;
+		cur_x += points[i].x;
+		cur_y += points[i].y;
+		++count;
+	}
+	if (!count) return false;
+	ref_x /= count;
+	ref_y /= count;
+	cur_x /= count;
+	cur_y /= count;
+
+	// Least squares similarity transform between the points' positions in
+	// the first frame and now, around their centroids. With only one point
+	// there's no way to tell rotation or scale, so they're kept as they were
+	Transform fit = current;
+	if (count > 1) {
+		double a = 0, b = 0, norm = 0;
+		for (size_t i = 0; i < points.size(); ++i) {
+			if (!found[i]) continue;
+			double qx = points[i].ref_x - ref_x, qy = points[i].ref_y - ref_y;
+			double px = points[i].x - cur_x, py = points[i].y - cur_y;
+			a += qx * px + qy * py;
+			b += qx * py - qy * px;
+			norm += qx * qx + qy * qy;
+		}
+		if (norm > 0) {
+			fit.scale = std::sqrt(a * a + b * b) / norm;
+			fit.angle = std::atan2(b, a) * 180.0 / pi;
+		}
+	}
+
+	// Pick the translation which puts the centroid in the right place
+	fit.x = fit.y = 0;
+	double mapped_x, mapped_y;
+	fit.Apply(ref_x, ref_y, mapped_x, mapped_y);
+	fit.x = cur_x - mapped_x;
+	fit.y = cur_y - mapped_y;
+	current = fit;
+
+	// Points which weren't found are put back where the fit says they
+	// should be, so that they can be picked up again once they reappear
+	for (size_t i = 0; i < points.size(); ++i) {
+		if (found[i]) continue;
+		double x, y;
+		current.Apply(points[i].ref_x, points[i].ref_y, x, y);
+		points[i].dx = points[i].dy = 0;
+		points[i].x = x;
+		points[i].y = y;
+	}
+	return true;
+}
+
+bool Tracker::Track(Pyramid next) {
+	// Points which aren't found are left where they were
+	std::vector<bool> found(points.size());
+	for (size_t i = 0; i < points.size(); ++i)
+		found[i] = Match(next, points[i]);
+
+	prev = std::move(next);
+	return Fit(found);
+}
+} }
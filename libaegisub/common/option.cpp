@@ -26,13 +26,14 @@
 #include "libaegisub/exception.h"
 #include "libaegisub/fs.h"
 #include "libaegisub/io.h"
+#include "libaegisub/json.h"
 #include "libaegisub/log.h"
 #include "libaegisub/option_value.h"
 #include "libaegisub/make_unique.h"
 
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/interprocess/streams/bufferstream.hpp>
-#include <cassert>
+#include <boost/algorithm/string/split.hpp>
+#include <iterator>
 #include <memory>
 
 namespace {
@@ -40,16 +41,37 @@ using namespace agi;
 
 DEFINE_EXCEPTION(OptionJsonValueError, Exception);
 
-class ConfigVisitor final : public json::ConstVisitor {
+/// Builds option values straight from the contents of a config file
+class ConfigHandler final : public json::Reader::Handler {
 	std::vector<std::unique_ptr<OptionValue>> values;
 
-	/// Option name prefix to add to read names
+	/// Name of the option currently being read
 	std::string name;
+	/// Length of name before the key of each object being read
+	std::vector<size_t> name_lengths;
 
 	/// Log errors rather than throwing them, for when loading user config files
 	/// (as a bad user config file shouldn't make the program fail to start)
 	bool ignore_errors;
 
+	/// Nesting level within the array option being read, or zero if not
+	/// reading an array. Each member of an array option is an object with
+	/// a single key giving the type of the value.
+	size_t array_depth = 0;
+	/// Type of the array option being read
+	std::string array_type;
+	/// Number of members of the array option read so far
+	size_t array_size = 0;
+	/// Number of keys in the array member being read
+	size_t member_keys = 0;
+	/// Error found while reading the array option, reported when it ends
+	const char *array_error = nullptr;
+
+	std::vector<std::string> array_strings;
+	std::vector<int64_t> array_ints;
+	std::vector<double> array_doubles;
+	std::vector<bool> array_bools;
+
 	void Error(const char *message) {
 		if (ignore_errors)
 			LOG_E("option/load/config_visitor") << "Error loading option from user configuration: " << message;
@@ -57,64 +79,114 @@ class ConfigVisitor final : public json::ConstVisitor {
 			throw OptionJsonValueError(message);
 	}
 
-	template<class OptionValueType>
-	void ReadArray(json::Array const& src, std::string const& array_type) {
-		typename OptionValueType::value_type arr;
-		arr.reserve(src.size());
-		for (json::Object const& obj : src)
-			arr.push_back((typename OptionValueType::value_type::value_type)(obj.begin()->second));
-
-		values.push_back(agi::make_unique<OptionValueType>(name, std::move(arr)));
+	void ArrayError(const char *message) {
+		if (!array_error)
+			array_error = message;
 	}
 
-	void Visit(const json::Object& object) {
-		auto old_name = name;
-		for (auto const& obj : object) {
-			name = old_name + (old_name.empty() ? "" : "/") + obj.first;
-			obj.second.Accept(*this);
-		}
-		name = old_name;
+	/// Check that a scalar is the value of an array member with the given
+	/// type, if an array is being read
+	/// @return Should the value be added to the array?
+	bool ArrayValue(const char *type) {
+		if (array_depth != 2 || member_keys != 1)
+			ArrayError("Invalid array member");
+		else if (array_type != type)
+			ArrayError("Attempt to insert value into array of wrong type");
+		else
+			return !array_error;
+		return false;
 	}
 
-	void Visit(const json::Array& array) {
-		if (array.empty())
-			return Error("Cannot infer the type of an empty array");
-
-		json::Object const& front = array.front();
-		if (front.size() != 1)
-			return Error("Invalid array member");
-
-		auto const& array_type = front.begin()->first;
-		for (json::Object const& obj : array) {
-			if (obj.size() != 1)
-				return Error("Invalid array member");
-			if (obj.begin()->first != array_type)
-				return Error("Attempt to insert value into array of wrong type");
-		}
+	template<class OptionValueType, class T>
+	void AddArray(std::vector<T>& src) {
+		typename OptionValueType::value_type arr(src.begin(), src.end());
+		values.push_back(agi::make_unique<OptionValueType>(name, std::move(arr)));
+	}
 
-		if (array_type == "string")
-			ReadArray<OptionValueListString>(array, array_type);
+	void EndOptionArray() {
+		if (array_error)
+			Error(array_error);
+		else if (!array_size)
+			Error("Cannot infer the type of an empty array");
+		else if (array_type == "string")
+			AddArray<OptionValueListString>(array_strings);
 		else if (array_type == "int")
-			ReadArray<OptionValueListInt>(array, array_type);
+			AddArray<OptionValueListInt>(array_ints);
 		else if (array_type == "double")
-			ReadArray<OptionValueListDouble>(array, array_type);
+			AddArray<OptionValueListDouble>(array_doubles);
 		else if (array_type == "bool")
-			ReadArray<OptionValueListBool>(array, array_type);
+			AddArray<OptionValueListBool>(array_bools);
 		else if (array_type == "color")
-			ReadArray<OptionValueListColor>(array, array_type);
+			AddArray<OptionValueListColor>(array_strings);
 		else
 			Error("Array type not handled");
 	}
 
-	void Visit(int64_t number) {
-		values.push_back(agi::make_unique<OptionValueInt>(name, number));
+public:
+	ConfigHandler(bool ignore_errors) : ignore_errors(ignore_errors) { }
+
+	void StartObject() override {
+		if (array_depth) {
+			if (++array_depth == 2)
+				member_keys = 0;
+			else
+				ArrayError("Invalid array member");
+			return;
+		}
+		name_lengths.push_back(name.size());
+	}
+
+	void Key(std::string const& key) override {
+		if (array_depth) {
+			if (array_depth != 2) return;
+			if (++member_keys != 1)
+				ArrayError("Invalid array member");
+			else if (array_size++ == 0)
+				array_type = key;
+			else if (key != array_type)
+				ArrayError("Attempt to insert value into array of wrong type");
+			return;
+		}
+		name.resize(name_lengths.back());
+		if (!name.empty()) name += '/';
+		name += key;
 	}
 
-	void Visit(double number) {
-		values.push_back(agi::make_unique<OptionValueDouble>(name, number));
+	void EndObject() override {
+		if (array_depth) {
+			if (array_depth-- == 2 && member_keys != 1)
+				ArrayError("Invalid array member");
+			return;
+		}
+		name.resize(name_lengths.back());
+		name_lengths.pop_back();
 	}
 
-	void Visit(const json::String& string) {
+	void StartArray() override {
+		if (array_depth++) {
+			ArrayError("Invalid array member");
+			return;
+		}
+		array_size = 0;
+		array_error = nullptr;
+		array_strings.clear();
+		array_ints.clear();
+		array_doubles.clear();
+		array_bools.clear();
+	}
+
+	void EndArray() override {
+		if (--array_depth == 0)
+			EndOptionArray();
+	}
+
+	void String(std::string const& string) override {
+		if (array_depth) {
+			if (array_type == "color" ? ArrayValue("color") : ArrayValue("string"))
+				array_strings.push_back(string);
+			return;
+		}
+
 		size_t size = string.size();
 		if ((size == 4 && string[0] == '#') ||
 			(size == 7 && string[0] == '#') ||
@@ -127,41 +199,93 @@ class ConfigVisitor final : public json::ConstVisitor {
 		}
 	}
 
-	void Visit(bool boolean) {
-		values.push_back(agi::make_unique<OptionValueBool>(name, boolean));
+	void Integer(int64_t number) override {
+		if (!array_depth)
+			values.push_back(agi::make_unique<OptionValueInt>(name, number));
+		else if (ArrayValue("int"))
+			array_ints.push_back(number);
 	}
 
-	void Visit(const json::Null& null) {
-		Error("Attempt to read null value");
+	void Double(double number) override {
+		if (!array_depth)
+			values.push_back(agi::make_unique<OptionValueDouble>(name, number));
+		else if (ArrayValue("double"))
+			array_doubles.push_back(number);
 	}
 
-public:
-	ConfigVisitor(bool ignore_errors) : ignore_errors(ignore_errors) { }
+	void Boolean(bool boolean) override {
+		if (!array_depth)
+			values.push_back(agi::make_unique<OptionValueBool>(name, boolean));
+		else if (ArrayValue("bool"))
+			array_bools.push_back(boolean);
+	}
+
+	void Null() override {
+		if (array_depth)
+			ArrayError("Invalid array member");
+		else
+			Error("Attempt to read null value");
+	}
+
+	/// Read a leaf of a flattened config
+	void Leaf(std::vector<std::string> const& path, json::UnknownElement const& value);
+
 	std::vector<std::unique_ptr<OptionValue>> Values() { return std::move(values); }
 };
 
-/// @brief Write an option to a json object
-/// @param[out] obj  Parent object
-/// @param[in] path  Path option should be stored in.
-/// @param[in] value Value to write.
-void put_option(json::Object &obj, const std::string &path, json::UnknownElement value) {
-	std::string::size_type pos = path.find('/');
-	// Not having a '/' denotes it is a leaf.
-	if (pos == std::string::npos) {
-		assert(obj.find(path) == obj.end());
-		obj[path] = std::move(value);
+/// Passes an already-read value to a handler
+class ReplayVisitor final : public json::ConstVisitor {
+	json::Reader::Handler& handler;
+
+	void Visit(json::Object const& object) override {
+		handler.StartObject();
+		for (auto const& entry : object) {
+			handler.Key(entry.first);
+			entry.second.Accept(*this);
+		}
+		handler.EndObject();
 	}
-	else
-		put_option(obj[path.substr(0, pos)], path.substr(pos + 1), std::move(value));
+
+	void Visit(json::Array const& array) override {
+		handler.StartArray();
+		for (auto const& entry : array)
+			entry.Accept(*this);
+		handler.EndArray();
+	}
+
+	void Visit(int64_t number) override { handler.Integer(number); }
+	void Visit(double number) override { handler.Double(number); }
+	void Visit(json::String const& string) override { handler.String(string); }
+	void Visit(bool boolean) override { handler.Boolean(boolean); }
+	void Visit(json::Null const&) override { handler.Null(); }
+
+public:
+	ReplayVisitor(json::Reader::Handler& handler) : handler(handler) { }
+};
+
+void ConfigHandler::Leaf(std::vector<std::string> const& path, json::UnknownElement const& value) {
+	name.clear();
+	for (auto const& component : path) {
+		if (!name.empty()) name += '/';
+		name += component;
+	}
+	ReplayVisitor visitor(*this);
+	value.Accept(visitor);
+	name.clear();
 }
 
-template<class T>
-void put_array(json::Object &obj, const std::string &path, const char *element_key, std::vector<T> const& value) {
-	json::Array array;
-	array.resize(value.size());
-	for (size_t i = 0, size = value.size(); i < size; ++i)
-		static_cast<json::Object&>(array[i])[element_key] = (json::UnknownElement)value[i];
-	put_option(obj, path, std::move(array));
+/// Write an array option, with each value wrapped in an object with the
+/// value's type as the key
+template<class T, class WriteValue>
+void write_array(JsonBufferWriter& out, const char *element_key, std::vector<T> const& value, WriteValue write_value) {
+	out.StartArray();
+	for (auto const& v : value) {
+		out.StartObject();
+		out.Key(element_key);
+		write_value(v);
+		out.EndObject();
+	}
+	out.EndArray();
 }
 
 struct option_name_cmp {
@@ -187,8 +311,7 @@ Options::Options(agi::fs::path const& file, std::pair<const char *, size_t> defa
 , setting(setting)
 {
 	LOG_D("agi/options") << "New Options object";
-	boost::interprocess::ibufferstream stream(default_config.first, default_config.second);
-	LoadConfig(stream);
+	LoadConfig(default_config);
 }
 
 Options::~Options() {
@@ -206,10 +329,22 @@ void Options::ConfigUser() {
 }
 
 void Options::LoadConfig(std::istream& stream, bool ignore_errors) {
-	json::UnknownElement config_root;
+	std::string config{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+	LoadConfig({config.data(), config.size()}, ignore_errors);
+}
+
+void Options::LoadConfig(std::pair<const char *, size_t> config, bool ignore_errors) {
+	ConfigHandler config_handler(ignore_errors);
+
+	if (json_util::is_flat(config)) {
+		json_util::read_flat(config, [&](std::vector<std::string> const& path, json::UnknownElement& value) {
+			config_handler.Leaf(path, value);
+		});
+		return SetValues(config_handler.Values(), ignore_errors);
+	}
 
 	try {
-		json::Reader::Read(config_root, stream);
+		json::Reader::Read(config_handler, config.first, config.first + config.second);
 	} catch (json::Reader::ParseException& e) {
 		LOG_E("option/load") << "json::ParseException: " << e.what() << ", Line/offset: " << e.m_locTokenBegin.m_nLine + 1 << '/' << e.m_locTokenBegin.m_nLineOffset + 1;
 		return;
@@ -218,13 +353,20 @@ void Options::LoadConfig(std::istream& stream, bool ignore_errors) {
 		return;
 	}
 
-	ConfigVisitor config_visitor(ignore_errors);
-	config_root.Accept(config_visitor);
+	SetValues(config_handler.Values(), ignore_errors);
+}
 
-	auto new_values = config_visitor.Values();
+void Options::SetValues(std::vector<std::unique_ptr<OptionValue>> new_values, bool ignore_errors) {
 	if (new_values.empty()) return;
 
-	sort(begin(new_values), end(new_values), option_name_cmp());
+	stable_sort(begin(new_values), end(new_values), option_name_cmp());
+
+	// Config files aren't checked for duplicate keys as they're read, so
+	// the last value for each option wins
+	new_values.erase(begin(new_values), unique(new_values.rbegin(), new_values.rend(),
+		[](std::unique_ptr<OptionValue> const& a, std::unique_ptr<OptionValue> const& b) {
+			return a->GetName() == b->GetName();
+		}).base());
 
 	if (values.empty()) {
 		values = std::move(new_values);
@@ -268,53 +410,79 @@ OptionValue *Options::Get(const char *name) {
 }
 
 void Options::Flush() const {
-	json::Object obj_out;
-
+	// values is sorted by name, so the options in each object are next to
+	// each other and the file can be written in one pass without building
+	// the objects first
+	JsonBufferWriter out;
+	out.StartObject();
+
+	std::vector<std::string> open_objects;
+	std::vector<std::string> path;
 	for (auto const& ov : values) {
+		if (ov->IsDefault()) continue;
+
+		boost::split(path, ov->GetName(), [](char c) { return c == '/'; });
+
+		size_t shared = 0;
+		while (shared < open_objects.size() && shared + 1 < path.size() && open_objects[shared] == path[shared])
+			++shared;
+		for (; open_objects.size() > shared; open_objects.pop_back())
+			out.EndObject();
+		for (; open_objects.size() + 1 < path.size(); open_objects.push_back(path[open_objects.size()])) {
+			out.Key(path[open_objects.size()]);
+			out.StartObject();
+		}
+		out.Key(path.back());
+
 		switch (ov->GetType()) {
 			case OptionType::String:
-				put_option(obj_out, ov->GetName(), ov->GetString());
+				out.String(ov->GetString());
 				break;
 
 			case OptionType::Int:
-				put_option(obj_out, ov->GetName(), ov->GetInt());
+				out.Integer(ov->GetInt());
 				break;
 
 			case OptionType::Double:
-				put_option(obj_out, ov->GetName(), ov->GetDouble());
+				out.Double(ov->GetDouble());
 				break;
 
 			case OptionType::Color:
-				put_option(obj_out, ov->GetName(), ov->GetColor().GetRgbFormatted());
+				out.String(ov->GetColor().GetRgbFormatted());
 				break;
 
 			case OptionType::Bool:
-				put_option(obj_out, ov->GetName(), ov->GetBool());
+				out.Boolean(ov->GetBool());
 				break;
 
 			case OptionType::ListString:
-				put_array(obj_out, ov->GetName(), "string", ov->GetListString());
+				write_array(out, "string", ov->GetListString(), [&](std::string const& v) { out.String(v); });
 				break;
 
 			case OptionType::ListInt:
-				put_array(obj_out, ov->GetName(), "int", ov->GetListInt());
+				write_array(out, "int", ov->GetListInt(), [&](int64_t v) { out.Integer(v); });
 				break;
 
 			case OptionType::ListDouble:
-				put_array(obj_out, ov->GetName(), "double", ov->GetListDouble());
+				write_array(out, "double", ov->GetListDouble(), [&](double v) { out.Double(v); });
 				break;
 
 			case OptionType::ListColor:
-				put_array(obj_out, ov->GetName(), "color", ov->GetListColor());
+				write_array(out, "color", ov->GetListColor(), [&](Color const& v) { out.String(v.GetRgbFormatted()); });
 				break;
 
 			case OptionType::ListBool:
-				put_array(obj_out, ov->GetName(), "bool", ov->GetListBool());
+				write_array(out, "bool", ov->GetListBool(), [&](bool v) { out.Boolean(v); });
 				break;
 		}
 	}
 
-	agi::JsonWriter::Write(obj_out, io::Save(config_file).Get());
+	for (; !open_objects.empty(); open_objects.pop_back())
+		out.EndObject();
+	out.EndObject();
+
+	auto const& json = out.Get();
+	io::Save(config_file).Get().write(json.data(), json.size());
 }
 
 } // namespace agi
@@ -0,0 +1,259 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+using agi::dispatch::Priority;
+
+/// Helpers queued on the background queue may not start until after the
+/// caller has finished everything itself, so they join through this: once
+/// the caller closes it, late helpers return without doing anything.
+struct Helpers {
+	std::mutex m;
+	std::condition_variable cv;
+	bool closed = false;
+	size_t active = 0;
+	std::exception_ptr error;
+	std::atomic<bool> failed{false};
+
+	bool Join() {
+		std::lock_guard<std::mutex> l(m);
+		if (closed) return false;
+		++active;
+		return true;
+	}
+
+	void Leave() {
+		std::lock_guard<std::mutex> l(m);
+		--active;
+		cv.notify_all();
+	}
+
+	/// Wait for the running helpers, then rethrow the first error
+	void Close() {
+		std::unique_lock<std::mutex> l(m);
+		closed = true;
+		cv.wait(l, [&] { return active == 0; });
+		if (error) std::rethrow_exception(error);
+	}
+
+	void Fail(std::exception_ptr e) {
+		std::lock_guard<std::mutex> l(m);
+		if (!error) error = e;
+		failed = true;
+	}
+};
+
+struct Loop : Helpers {
+	/// The part of the range currently owned by one thread. The owner claims
+	/// chunks from the front and thieves take the back half.
+	struct Part {
+		std::mutex m;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+
+	std::unique_ptr<Part[]> parts;
+	size_t part_count;
+	size_t grain;
+	std::function<void (size_t, size_t, size_t)> const *body;
+
+	bool ClaimOwn(size_t slot, size_t& begin, size_t& end) {
+		Part& own = parts[slot];
+		std::lock_guard<std::mutex> l(own.m);
+		if (own.begin == own.end) return false;
+		begin = own.begin;
+		end = std::min(own.end, own.begin + grain);
+		own.begin = end;
+		return true;
+	}
+
+	/// Move the back half of the part with the most left to this thread's
+	/// own part
+	/// @return false if there's nothing left anywhere
+	bool Steal(size_t slot) {
+		for (;;) {
+			size_t victim = part_count, most = 0;
+			for (size_t i = 0; i < part_count; ++i) {
+				std::lock_guard<std::mutex> l(parts[i].m);
+				if (parts[i].end - parts[i].begin > most) {
+					most = parts[i].end - parts[i].begin;
+					victim = i;
+				}
+			}
+			if (victim == part_count) return false;
+
+			size_t begin, end;
+			{
+				Part& part = parts[victim];
+				std::lock_guard<std::mutex> l(part.m);
+				// Someone else got there first
+				if (part.begin == part.end) continue;
+				begin = part.begin + (part.end - part.begin) / 2;
+				end = part.end;
+				part.end = begin;
+			}
+
+			Part& own = parts[slot];
+			std::lock_guard<std::mutex> l(own.m);
+			own.begin = begin;
+			own.end = end;
+			return true;
+		}
+	}
+
+	void Work(size_t slot) {
+		size_t begin, end;
+		while (!failed && (ClaimOwn(slot, begin, end) || (Steal(slot) && ClaimOwn(slot, begin, end)))) {
+			try {
+				(*body)(slot, begin, end);
+			}
+			catch (...) {
+				Fail(std::current_exception());
+			}
+		}
+	}
+};
+
+struct Graph : Helpers {
+	std::vector<std::function<void()>> const *fns;
+	std::vector<std::vector<size_t>> const *dependents;
+	std::vector<size_t> waiting_on;
+	std::deque<size_t> ready;
+	size_t finished = 0;
+
+	void Work() {
+		std::unique_lock<std::mutex> l(m);
+		for (;;) {
+			cv.wait(l, [&] { return !ready.empty() || finished == fns->size(); });
+			if (ready.empty()) return;
+
+			size_t task = ready.front();
+			ready.pop_front();
+			l.unlock();
+			if (!failed) {
+				try {
+					(*fns)[task]();
+				}
+				catch (...) {
+					Fail(std::current_exception());
+				}
+			}
+			l.lock();
+
+			++finished;
+			for (size_t dependent : (*dependents)[task]) {
+				if (--waiting_on[dependent] == 0)
+					ready.push_back(dependent);
+			}
+			cv.notify_all();
+		}
+	}
+};
+}
+
+namespace agi {
+size_t parallel_concurrency() {
+	static const size_t concurrency = std::max(1u, std::thread::hardware_concurrency());
+	return concurrency;
+}
+
+void parallel_for_slots(size_t begin, size_t end, size_t grain, std::function<void (size_t, size_t, size_t)> const& body, Priority priority) {
+	if (end <= begin) return;
+	grain = std::max<size_t>(grain, 1);
+
+	const size_t count = end - begin;
+	const size_t part_count = std::min(parallel_concurrency(), (count + grain - 1) / grain);
+	if (part_count <= 1) {
+		for (size_t i = begin; i < end; i += grain)
+			body(0, i, std::min(end, i + grain));
+		return;
+	}
+
+	auto loop = std::make_shared<Loop>();
+	loop->parts.reset(new Loop::Part[part_count]);
+	loop->part_count = part_count;
+	loop->grain = grain;
+	loop->body = &body;
+	for (size_t i = 0; i < part_count; ++i) {
+		loop->parts[i].begin = begin + count * i / part_count;
+		loop->parts[i].end = begin + count * (i + 1) / part_count;
+	}
+
+	for (size_t slot = 1; slot < part_count; ++slot) {
+		dispatch::Background().Async([=] {
+			if (!loop->Join()) return;
+			loop->Work(slot);
+			loop->Leave();
+		}, priority);
+	}
+
+	loop->Work(0);
+	loop->Close();
+}
+
+TaskGraph::Task TaskGraph::Add(std::function<void()> fn, std::initializer_list<Task> dependencies) {
+	return Add(std::move(fn), std::vector<Task>(dependencies));
+}
+
+TaskGraph::Task TaskGraph::Add(std::function<void()> fn, std::vector<Task> const& dependencies) {
+	const Task task = fns.size();
+	fns.push_back(std::move(fn));
+	dependency_counts.push_back(dependencies.size());
+	dependents.emplace_back();
+	for (Task dependency : dependencies) {
+		assert(dependency < task);
+		dependents[dependency].push_back(task);
+	}
+	return task;
+}
+
+void TaskGraph::Run(Priority priority) {
+	if (fns.empty()) return;
+
+	auto graph = std::make_shared<Graph>();
+	graph->fns = &fns;
+	graph->dependents = &dependents;
+	graph->waiting_on = dependency_counts;
+	for (size_t i = 0; i < fns.size(); ++i) {
+		if (!dependency_counts[i])
+			graph->ready.push_back(i);
+	}
+
+	const size_t helpers = std::min(parallel_concurrency(), fns.size()) - 1;
+	for (size_t i = 0; i < helpers; ++i) {
+		dispatch::Background().Async([=] {
+			if (!graph->Join()) return;
+			graph->Work();
+			graph->Leave();
+		}, priority);
+	}
+
+	graph->Work();
+	graph->Close();
+}
+}
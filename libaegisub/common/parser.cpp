@@ -18,6 +18,7 @@
 
 #include "libaegisub/color.h"
 #include "libaegisub/ass/dialogue_parser.h"
+#include "libaegisub/simd.h"
 
 #include <boost/spirit/include/qi.hpp>
 #include <boost/spirit/include/phoenix_core.hpp>
@@ -178,6 +179,48 @@ struct dialogue_tokens final : lex::lexer<Lexer> {
 	}
 };
 
+/// Can the character start anything other than a TEXT token outside of an
+/// override block?
+inline bool is_special(char c, bool karaoke_templater) {
+	if (c == '{' || c == '\\') return true;
+	if (karaoke_templater) return c == '!' || c == '$';
+	return c == '\1';
+}
+
+/// Find the first special character at or after pos
+size_t find_special(const char *str, size_t pos, size_t len, bool karaoke_templater) {
+	// Check 16 bytes at a time for any of the special characters, then find
+	// exactly which one it was one byte at a time
+#if defined(AGI_SSE2)
+	const __m128i open = _mm_set1_epi8('{');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i extra1 = _mm_set1_epi8(karaoke_templater ? '!' : '\1');
+	const __m128i extra2 = _mm_set1_epi8(karaoke_templater ? '$' : '\1');
+	for (; pos + 16 <= len; pos += 16) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + pos));
+		const __m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, open), _mm_cmpeq_epi8(chunk, backslash)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, extra1), _mm_cmpeq_epi8(chunk, extra2)));
+		if (_mm_movemask_epi8(hits)) break;
+	}
+#elif defined(AGI_NEON)
+	const uint8x16_t open = vdupq_n_u8('{');
+	const uint8x16_t backslash = vdupq_n_u8('\\');
+	const uint8x16_t extra1 = vdupq_n_u8(karaoke_templater ? '!' : '\1');
+	const uint8x16_t extra2 = vdupq_n_u8(karaoke_templater ? '$' : '\1');
+	for (; pos + 16 <= len; pos += 16) {
+		const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t *>(str + pos));
+		const uint8x16_t hits = vorrq_u8(
+			vorrq_u8(vceqq_u8(chunk, open), vceqq_u8(chunk, backslash)),
+			vorrq_u8(vceqq_u8(chunk, extra1), vceqq_u8(chunk, extra2)));
+		if (vmaxvq_u8(hits)) break;
+	}
+#endif
+	while (pos < len && !is_special(str[pos], karaoke_templater))
+		++pos;
+	return pos;
+}
+
 template<typename Parser, typename T>
 bool do_try_parse(std::string const& str, Parser parser, T *out) {
 	using namespace boost::spirit::qi;
@@ -210,19 +253,63 @@ namespace ass {
 		static const dialogue_tokens<lex::lexertl::actor_lexer<>> not_kt(false);
 		auto const& tokenizer = karaoke_templater ? kt : not_kt;
 
-		char const *first = str.c_str();
-		char const *last = first + str.size();
-		std::vector<DialogueToken> data;
-		auto it = tokenizer.begin(first, last), end = tokenizer.end();
+		using namespace agi::ass::DialogueTokenType;
 
-		for (; it != end && token_is_valid(*it); ++it) {
-			int id = it->id();
-			ptrdiff_t len = it->value().end() - it->value().begin();
-			assert(len > 0);
+		std::vector<DialogueToken> data;
+		auto add_token = [&](int id, size_t len) {
 			if (data.empty() || data.back().type != id)
-				data.push_back(DialogueToken{id, static_cast<size_t>(len)});
+				data.push_back(DialogueToken{id, len});
 			else
 				data.back().length += len;
+		};
+
+		char const *text = str.c_str();
+		const size_t len = str.size();
+		size_t pos = 0;
+		while (pos < len) {
+			// Outside of override blocks nearly every character is a
+			// single-character TEXT token, so skip over runs of them without
+			// going through the lexer
+			size_t next = find_special(text, pos, len, karaoke_templater);
+			if (next > pos)
+				add_token(TEXT, next - pos);
+			if ((pos = next) == len) break;
+
+			if (text[pos] == '\\') {
+				char c = pos + 1 < len ? text[pos + 1] : 0;
+				if (c == 'n' || c == 'N' || c == 'h') {
+					add_token(LINE_BREAK, 2);
+					pos += 2;
+				}
+				else {
+					add_token(TEXT, 1);
+					++pos;
+				}
+				continue;
+			}
+
+			// Run the lexer until it's back outside of an override block
+			char const *first = text + pos;
+			auto it = tokenizer.begin(first, text + len), end = tokenizer.end();
+			bool in_override = false;
+			for (; it != end && token_is_valid(*it); ++it) {
+				int id = it->id();
+				ptrdiff_t tok_len = it->value().end() - it->value().begin();
+				assert(tok_len > 0);
+				add_token(id, static_cast<size_t>(tok_len));
+				pos = it->value().end() - text;
+
+				if (id == OVR_BEGIN)
+					in_override = true;
+				else if (id == OVR_END)
+					in_override = false;
+				if (!in_override) break;
+			}
+
+			// The lexer stopped without leaving the override block, either
+			// due to reaching the end of the line or an invalid token
+			if (it == end || !token_is_valid(*it))
+				break;
 		}
 
 		return data;
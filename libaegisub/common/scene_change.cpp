@@ -0,0 +1,95 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/scene_change.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+/// Number of luma histogram bins
+const size_t bins = 32;
+/// Number of preceding frames whose scores a scene change is compared to
+const size_t window = 8;
+/// How many times the average of the preceding scores a scene change must be
+const double ratio = 3.0;
+
+void histogram(const uint8_t *data, size_t size, uint32_t (&out)[bins]) {
+	std::fill(std::begin(out), std::end(out), 0);
+	for (size_t i = 0; i < size; ++i)
+		++out[data[i] / (256 / bins)];
+}
+}
+
+namespace agi { namespace scene_change {
+uint64_t SumAbsDiff(const uint8_t *a, const uint8_t *b, size_t size) {
+	uint64_t sum = 0;
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 16 <= size; i += 16) {
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+	}
+	sum = static_cast<uint64_t>(_mm_cvtsi128_si32(acc))
+	    + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+	for (; i < size; ++i)
+		sum += std::abs(int(a[i]) - int(b[i]));
+	return sum;
+}
+
+double Score(const uint8_t *a, const uint8_t *b, size_t size) {
+	if (!size) return 0;
+
+	uint32_t ha[bins], hb[bins];
+	histogram(a, size, ha);
+	histogram(b, size, hb);
+	uint64_t hist_diff = 0;
+	for (size_t i = 0; i < bins; ++i)
+		hist_diff += ha[i] > hb[i] ? ha[i] - hb[i] : hb[i] - ha[i];
+
+	double pixel = double(SumAbsDiff(a, b, size)) / (255.0 * size);
+	double hist = double(hist_diff) / (2.0 * size);
+	return (pixel + hist) / 2;
+}
+
+std::vector<int> Choose(std::vector<double> const& scores, int min_interval, double threshold) {
+	std::vector<int> keyframes;
+	if (scores.empty()) return keyframes;
+	keyframes.push_back(0);
+
+	double window_sum = 0;
+	for (size_t i = 1; i < scores.size(); ++i) {
+		size_t count = std::min(i - 1, window);
+		double average = count ? window_sum / count : 0;
+
+		if (scores[i] >= threshold && scores[i] > average * ratio
+			&& static_cast<int>(i) - keyframes.back() >= min_interval)
+			keyframes.push_back(static_cast<int>(i));
+
+		window_sum += scores[i];
+		if (i > window)
+			window_sum -= scores[i - window];
+	}
+	return keyframes;
+}
+} }
@@ -0,0 +1,155 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/slab_pool.h"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+const size_t Alignment = alignof(std::max_align_t);
+
+size_t AlignUp(size_t size) {
+	return (size + Alignment - 1) / Alignment * Alignment;
+}
+}
+
+namespace agi {
+struct SlabPool::Slab {
+	SlabPool *pool;
+	Slab *prev;
+	Slab *next;
+	/// Blocks which have been freed, linked through their first bytes
+	char *free;
+	/// Number of blocks at the end of the slab which have never been used
+	size_t untouched;
+	/// Number of blocks in use
+	size_t live;
+
+	char *Blocks() { return reinterpret_cast<char *>(this) + AlignUp(sizeof(Slab)); }
+};
+
+/// Each block starts with a pointer to its slab so that Free can find it,
+/// padded to keep the object after it aligned
+union BlockHeader {
+	void *slab;
+	std::max_align_t align;
+};
+
+namespace {
+template<typename SlabT>
+void Link(SlabT *&list, SlabT *slab) {
+	slab->prev = nullptr;
+	slab->next = list;
+	if (list) list->prev = slab;
+	list = slab;
+}
+
+template<typename SlabT>
+void Unlink(SlabT *&list, SlabT *slab) {
+	if (slab->prev) slab->prev->next = slab->next;
+	else list = slab->next;
+	if (slab->next) slab->next->prev = slab->prev;
+}
+}
+
+SlabPool::SlabPool(size_t object_size, size_t slab_size)
+: block_size(sizeof(BlockHeader) + AlignUp(std::max(object_size, sizeof(char *))))
+, blocks_per_slab(std::max<size_t>(1, (slab_size - AlignUp(sizeof(Slab))) / block_size))
+{
+}
+
+SlabPool::~SlabPool() {
+	for (Slab *list : {partial, full}) {
+		while (list) {
+			Slab *next = list->next;
+			::operator delete(list);
+			list = next;
+		}
+	}
+	::operator delete(spare);
+}
+
+SlabPool::Slab *SlabPool::NewSlab() {
+	Slab *slab = spare;
+	if (slab)
+		spare = nullptr;
+	else
+		slab = static_cast<Slab *>(::operator new(AlignUp(sizeof(Slab)) + blocks_per_slab * block_size));
+	slab->pool = this;
+	slab->free = nullptr;
+	slab->untouched = blocks_per_slab;
+	slab->live = 0;
+	++slab_count;
+	return slab;
+}
+
+void SlabPool::Release(Slab *slab) {
+	--slab_count;
+	if (spare)
+		::operator delete(slab);
+	else
+		spare = slab;
+}
+
+void *SlabPool::Allocate() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!partial)
+		Link(partial, NewSlab());
+
+	Slab *slab = partial;
+	char *block;
+	if (slab->free) {
+		block = slab->free;
+		slab->free = *reinterpret_cast<char **>(block + sizeof(BlockHeader));
+	}
+	else
+		block = slab->Blocks() + (blocks_per_slab - slab->untouched--) * block_size;
+
+	reinterpret_cast<BlockHeader *>(block)->slab = slab;
+	if (++slab->live == blocks_per_slab) {
+		Unlink(partial, slab);
+		Link(full, slab);
+	}
+	return block + sizeof(BlockHeader);
+}
+
+void SlabPool::Free(void *p) {
+	if (!p) return;
+
+	char *block = static_cast<char *>(p) - sizeof(BlockHeader);
+	Slab *slab = static_cast<Slab *>(reinterpret_cast<BlockHeader *>(block)->slab);
+	SlabPool *pool = slab->pool;
+
+	std::lock_guard<std::mutex> lock(pool->mutex);
+	*static_cast<char **>(p) = slab->free;
+	slab->free = block;
+
+	if (slab->live-- == pool->blocks_per_slab) {
+		Unlink(pool->full, slab);
+		Link(pool->partial, slab);
+	}
+	if (slab->live == 0) {
+		Unlink(pool->partial, slab);
+		pool->Release(slab);
+	}
+}
+
+size_t SlabPool::SlabCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return slab_count;
+}
+}
@@ -18,49 +18,202 @@
 
 #include "libaegisub/thesaurus.h"
 
+#include "libaegisub/buffer_lines.h"
 #include "libaegisub/charset_conv.h"
 #include "libaegisub/file_mapping.h"
-#include "libaegisub/line_iterator.h"
+#include "libaegisub/fs.h"
+#include "libaegisub/io.h"
 #include "libaegisub/make_unique.h"
 #include "libaegisub/split.h"
 
-#include <boost/interprocess/streams/bufferstream.hpp>
+#include "mapped_lines.h"
+
+#include <algorithm>
+#include <boost/container/flat_map.hpp>
+#include <cstring>
+
+namespace {
+const char index_magic[8] = {'A', 'G', 'I', 'T', 'H', 'E', 'S', '1'};
+
+/// Start of a compiled index. It's followed by the name of the data file's
+/// encoding, padded to a multiple of eight bytes, then an IndexEntry for
+/// each word in sorted order, then the words.
+struct IndexHeader {
+	char magic[8];
+	/// Size of the index file it was compiled from
+	uint64_t idx_size;
+	/// Modification time of the index file it was compiled from
+	int64_t idx_mtime;
+	uint32_t word_count;
+	uint32_t encoding_length;
+};
+
+struct IndexEntry {
+	/// Byte position of the word's entry in the data file
+	uint64_t dat_offset;
+	/// Position of the word in the compiled index
+	uint32_t word_offset;
+	uint32_t word_length;
+};
+
+// The index is only read on the machine which wrote it, so the structs are
+// stored as-is, but they may not be aligned in the mapping
+template<typename T>
+T read_struct(const char *data) {
+	T ret;
+	memcpy(&ret, data, sizeof(T));
+	return ret;
+}
+
+template<typename T>
+void append_struct(std::vector<char>& out, T const& value) {
+	auto data = reinterpret_cast<const char *>(&value);
+	out.insert(out.end(), data, data + sizeof(T));
+}
+}
 
 namespace agi {
 
 Thesaurus::Thesaurus(agi::fs::path const& dat_path, agi::fs::path const& idx_path)
 : dat(make_unique<read_file_mapping>(dat_path))
+, index_buffer(CompileIndex(idx_path))
 {
-	read_file_mapping idx_file(idx_path);
-	boost::interprocess::ibufferstream idx(idx_file.read(), static_cast<size_t>(idx_file.size()));
+	UseIndex(index_buffer.data(), index_buffer.size());
+}
 
-	std::string encoding_name;
-	getline(idx, encoding_name);
-	std::string unused_entry_count;
-	getline(idx, unused_entry_count);
+Thesaurus::Thesaurus(agi::fs::path const& dat_path, agi::fs::path const& idx_path, agi::fs::path const& cache_path)
+: dat(make_unique<read_file_mapping>(dat_path))
+{
+	if (LoadIndex(idx_path, cache_path)) return;
 
-	conv = make_unique<charset::IconvWrapper>(encoding_name.c_str(), "utf-8");
+	index_buffer = CompileIndex(idx_path);
+	UseIndex(index_buffer.data(), index_buffer.size());
 
-	// Read the list of words and file offsets for those words
-	for (auto const& line : line_iterator<std::string>(idx, encoding_name)) {
-		auto pos = line.find('|');
-		if (pos != line.npos && line.find('|', pos + 1) == line.npos)
-			offsets[line.substr(0, pos)] = static_cast<size_t>(atoi(line.c_str() + pos + 1));
+	// The compiled index is used from memory this time either way, so
+	// failing to cache it only makes the next load slower
+	try {
+		fs::CreateDirectory(cache_path.parent_path());
+		io::Save file(cache_path, true);
+		file.Get().write(index_buffer.data(), index_buffer.size());
 	}
+	catch (fs::FileSystemError const&) { }
 }
 
 Thesaurus::~Thesaurus() { }
 
+bool Thesaurus::LoadIndex(agi::fs::path const& idx_path, agi::fs::path const& cache_path) {
+	try {
+		if (!fs::FileExists(cache_path)) return false;
+
+		auto file = make_unique<read_file_mapping>(cache_path);
+		if (file->size() < sizeof(IndexHeader)) return false;
+
+		const char *data = file->read();
+		auto header = read_struct<IndexHeader>(data);
+		if (memcmp(header.magic, index_magic, sizeof(index_magic)) != 0) return false;
+		if (header.idx_size != fs::Size(idx_path)) return false;
+		if (header.idx_mtime != static_cast<int64_t>(fs::ModifiedTime(idx_path))) return false;
+
+		if (!UseIndex(data, file->size())) return false;
+		index_file = std::move(file);
+		return true;
+	}
+	catch (fs::FileSystemError const&) {
+		return false;
+	}
+}
+
+bool Thesaurus::UseIndex(const char *data, uint64_t size) {
+	auto header = read_struct<IndexHeader>(data);
+	uint64_t encoding_end = sizeof(IndexHeader) + header.encoding_length;
+	uint64_t start = (encoding_end + 7) & ~7ull;
+	if (start + uint64_t(header.word_count) * sizeof(IndexEntry) > size)
+		return false;
+
+	conv = make_unique<charset::IconvWrapper>(std::string(data + sizeof(IndexHeader), header.encoding_length).c_str(), "utf-8");
+	index = data;
+	index_size = size;
+	word_count = header.word_count;
+	entries_start = start;
+	return true;
+}
+
+std::vector<char> Thesaurus::CompileIndex(agi::fs::path const& idx_path) {
+	read_file_mapping idx_file(idx_path);
+	const char *idx_begin = idx_file.size() ? idx_file.read() : "";
+	const char *idx_end = idx_begin + idx_file.size();
+
+	// The first line is the encoding and the second is the number of entries
+	buffer_line_iterator header_lines(idx_begin, idx_end), lines_end;
+	std::string encoding_name(header_lines->begin(), header_lines->end());
+	for (int i = 0; i < 2 && header_lines != lines_end; ++i)
+		++header_lines;
+	const char *words_begin = header_lines != lines_end ? header_lines->begin() : idx_end;
+
+	// Read the list of words and file offsets for those words
+	boost::container::flat_map<std::string, uint64_t> offsets;
+	for (auto const& line : buffer_lines(words_begin, idx_end, encoding_name)) {
+		auto bar = std::find(line.begin(), line.end(), '|');
+		if (bar == line.end() || std::find(bar + 1, line.end(), '|') != line.end())
+			continue;
+		int offset = 0;
+		parse_int(bar + 1, line.end(), offset);
+		offsets[std::string(line.begin(), bar)] = static_cast<size_t>(offset);
+	}
+
+	IndexHeader header;
+	memcpy(header.magic, index_magic, sizeof(index_magic));
+	header.idx_size = idx_file.size();
+	header.idx_mtime = fs::ModifiedTime(idx_path);
+	header.word_count = static_cast<uint32_t>(offsets.size());
+	header.encoding_length = static_cast<uint32_t>(encoding_name.size());
+
+	std::vector<char> out;
+	append_struct(out, header);
+	out.insert(out.end(), encoding_name.begin(), encoding_name.end());
+	out.resize((out.size() + 7) & ~size_t(7));
+
+	uint64_t word_offset = out.size() + offsets.size() * sizeof(IndexEntry);
+	for (auto const& word : offsets) {
+		append_struct(out, IndexEntry{word.second, static_cast<uint32_t>(word_offset), static_cast<uint32_t>(word.first.size())});
+		word_offset += word.first.size();
+	}
+	for (auto const& word : offsets)
+		out.insert(out.end(), word.first.begin(), word.first.end());
+
+	return out;
+}
+
+int Thesaurus::CompareWord(uint32_t i, std::string const& word) const {
+	auto entry = read_struct<IndexEntry>(index + entries_start + uint64_t(i) * sizeof(IndexEntry));
+	uint64_t offset = std::min<uint64_t>(entry.word_offset, index_size);
+	size_t len = static_cast<size_t>(std::min<uint64_t>(entry.word_length, index_size - offset));
+
+	int cmp = memcmp(index + offset, word.data(), std::min(len, word.size()));
+	if (cmp != 0) return cmp;
+	return len < word.size() ? -1 : len > word.size();
+}
+
 std::vector<Thesaurus::Entry> Thesaurus::Lookup(std::string const& word) {
 	std::vector<Entry> out;
-	if (!dat) return out;
+	if (!dat || !index) return out;
+
+	// Binary search the mapped index rather than building strings for it
+	uint32_t first = 0, last = word_count;
+	while (first < last) {
+		uint32_t mid = first + (last - first) / 2;
+		if (CompareWord(mid, word) < 0)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+	if (first == word_count || CompareWord(first, word) != 0) return out;
 
-	auto it = offsets.find(word);
-	if (it == offsets.end()) return out;
-	if (it->second >= dat->size()) return out;
+	auto offset = read_struct<IndexEntry>(index + entries_start + uint64_t(first) * sizeof(IndexEntry)).dat_offset;
+	if (offset >= dat->size()) return out;
 
-	auto len = dat->size() - it->second;
-	auto buff = dat->read(it->second, len);
+	auto len = dat->size() - offset;
+	auto buff = dat->read(offset, len);
 	auto buff_end = buff + len;
 
 	std::string temp;
@@ -0,0 +1,269 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "libaegisub/trace.h"
+
+#include "libaegisub/cajun/writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+namespace {
+using namespace agi::trace;
+
+/// Most events kept for each thread; older ones are overwritten
+const size_t max_events = 1 << 16;
+
+struct Event {
+	const char *name;
+	int64_t start;
+	/// Duration for spans, delta for counters
+	int64_t value;
+	bool counter;
+};
+
+/// Metric without the name, keyed by the name's pointer while recording
+struct Accumulator {
+	int64_t count = 0;
+	int64_t total = 0;
+	int64_t min = 0;
+	int64_t max = 0;
+	std::array<uint64_t, 64> buckets{};
+
+	void Add(int64_t value) {
+		if (!count || value < min) min = value;
+		if (!count || value > max) max = value;
+		++count;
+		total += value;
+
+		int bucket = 0;
+		for (uint64_t v = std::max<int64_t>(value, 0); v && bucket < 63; v >>= 1)
+			++bucket;
+		++buckets[bucket];
+	}
+};
+
+/// Everything recorded on one thread. The lock is only ever contended by
+/// the functions which read the results.
+struct ThreadBuffer {
+	std::mutex lock;
+	int tid;
+	std::vector<Event> events;
+	size_t next_event = 0;
+	std::unordered_map<const char *, Accumulator> metrics;
+
+	void Push(Event const& event) {
+		if (events.size() < max_events)
+			events.push_back(event);
+		else {
+			events[next_event] = event;
+			next_event = (next_event + 1) % max_events;
+		}
+	}
+};
+
+std::mutex buffers_lock;
+/// Buffers are kept after their thread exits so that what it recorded can
+/// still be read
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+ThreadBuffer& Buffer() {
+	static thread_local ThreadBuffer *buffer = nullptr;
+	if (!buffer) {
+		std::lock_guard<std::mutex> lock(buffers_lock);
+		buffers.emplace_back(new ThreadBuffer);
+		buffer = buffers.back().get();
+		buffer->tid = buffers.size();
+	}
+	return *buffer;
+}
+
+template<typename Func>
+void for_each_buffer(Func&& func) {
+	std::lock_guard<std::mutex> lock(buffers_lock);
+	for (auto& buffer : buffers) {
+		std::lock_guard<std::mutex> buffer_lock(buffer->lock);
+		func(*buffer);
+	}
+}
+
+void merge(Metric& dst, Accumulator const& src) {
+	if (!src.count) return;
+	if (!dst.count || src.min < dst.min) dst.min = src.min;
+	if (!dst.count || src.max > dst.max) dst.max = src.max;
+	dst.count += src.count;
+	dst.total += src.total;
+	for (size_t i = 0; i < dst.buckets.size(); ++i)
+		dst.buckets[i] += src.buckets[i];
+}
+}
+
+namespace agi { namespace trace {
+namespace detail {
+std::atomic<bool> enabled{false};
+
+int64_t Now() {
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Span(const char *name, int64_t start, int64_t end) {
+	auto& buffer = Buffer();
+	std::lock_guard<std::mutex> lock(buffer.lock);
+	buffer.Push(Event{name, start, end - start, false});
+	buffer.metrics[name].Add(end - start);
+}
+
+void Count(const char *name, int64_t delta) {
+	auto& buffer = Buffer();
+	std::lock_guard<std::mutex> lock(buffer.lock);
+	buffer.Push(Event{name, Now(), delta, true});
+	auto& metric = buffer.metrics[name];
+	metric.count += delta;
+	metric.total += delta;
+}
+
+void Sample(const char *name, int64_t value) {
+	auto& buffer = Buffer();
+	std::lock_guard<std::mutex> lock(buffer.lock);
+	buffer.metrics[name].Add(value);
+}
+}
+
+void Enable(bool enable) {
+	detail::enabled = enable;
+}
+
+void Clear() {
+	for_each_buffer([](ThreadBuffer& buffer) {
+		buffer.events.clear();
+		buffer.next_event = 0;
+		buffer.metrics.clear();
+	});
+}
+
+int64_t Metric::Percentile(double fraction) const {
+	uint64_t target = static_cast<uint64_t>(fraction * (count > 0 ? count : 0));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		seen += buckets[i];
+		if (buckets[i] && seen >= target) {
+			// Report the top of the bucket, clamped to what was seen
+			int64_t top = i == 0 ? 0 : i >= 63 ? max : (int64_t(1) << i) - 1;
+			return std::max(min, std::min(max, top));
+		}
+	}
+	return max;
+}
+
+std::vector<Metric> Metrics() {
+	// The same literal can have a different address in each module, so the
+	// metrics are merged by name
+	std::map<std::string, Metric> by_name;
+	for_each_buffer([&](ThreadBuffer& buffer) {
+		for (auto const& metric : buffer.metrics) {
+			auto& dst = by_name[metric.first];
+			dst.name = metric.first;
+			merge(dst, metric.second);
+		}
+	});
+
+	std::vector<Metric> ret;
+	ret.reserve(by_name.size());
+	for (auto& metric : by_name)
+		ret.push_back(std::move(metric.second));
+	return ret;
+}
+
+Metric Get(const char *name) {
+	Metric ret;
+	ret.name = name;
+	for_each_buffer([&](ThreadBuffer& buffer) {
+		for (auto const& metric : buffer.metrics) {
+			if (metric.first == name || !strcmp(metric.first, name))
+				merge(ret, metric.second);
+		}
+	});
+	return ret;
+}
+
+void WriteChromeTrace(std::ostream& out) {
+	struct TaggedEvent {
+		Event event;
+		int tid;
+	};
+	std::vector<TaggedEvent> events;
+	for_each_buffer([&](ThreadBuffer& buffer) {
+		for (auto const& event : buffer.events)
+			events.push_back(TaggedEvent{event, buffer.tid});
+	});
+	std::sort(begin(events), end(events), [](TaggedEvent const& a, TaggedEvent const& b) {
+		return a.event.start < b.event.start;
+	});
+
+	agi::JsonBufferWriter json;
+	json.StartObject();
+	json.Key("displayTimeUnit");
+	json.String("ms");
+	json.Key("traceEvents");
+	json.StartArray();
+
+	// Counters are recorded as deltas on each thread, but displayed as one
+	// running total
+	std::map<std::string, int64_t> counters;
+	for (auto const& tagged : events) {
+		auto const& event = tagged.event;
+		json.StartObject();
+		json.Key("name");
+		json.String(event.name);
+		json.Key("pid");
+		json.Integer(1);
+		json.Key("tid");
+		json.Integer(tagged.tid);
+		json.Key("ts");
+		json.Double(event.start / 1000.0);
+		if (event.counter) {
+			json.Key("ph");
+			json.String("C");
+			json.Key("args");
+			json.StartObject();
+			json.Key("value");
+			json.Integer(counters[event.name] += event.value);
+			json.EndObject();
+		}
+		else {
+			json.Key("ph");
+			json.String("X");
+			json.Key("dur");
+			json.Double(event.value / 1000.0);
+		}
+		json.EndObject();
+	}
+
+	json.EndArray();
+	json.EndObject();
+
+	auto const& str = json.Get();
+	out.write(str.data(), str.size());
+	out.flush();
+}
+} }
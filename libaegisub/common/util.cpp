@@ -17,6 +17,9 @@
 #include "libaegisub/util.h"
 #include "libaegisub/util_osx.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include <boost/locale/boundary.hpp>
 #include <boost/locale/conversion.hpp>
 #include <boost/range/distance.hpp>
@@ -52,6 +55,44 @@ std::pair<size_t, size_t> find_range(std::string const& haystack, std::string co
 	return {match_start, match_start + needle.size()};
 }
 
+bool is_ascii(std::string const& str) {
+	for (unsigned char c : str) {
+		if (c >= 0x80) return false;
+	}
+	return true;
+}
+
+inline unsigned char ascii_fold(unsigned char c) {
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+/// Case-insensitive Boyer-Moore-Horspool search for when both strings are
+/// ASCII, where case folding is just lowercasing A-Z and never changes the
+/// length of the string
+std::pair<size_t, size_t> ascii_ifind(std::string const& haystack, std::string const& needle) {
+	const size_t n = haystack.size(), m = needle.size();
+	if (m == 0) return {0, 0};
+	if (m > n) return bad_match;
+
+	std::string folded_n(needle);
+	for (auto& c : folded_n)
+		c = ascii_fold(c);
+
+	size_t skip[256];
+	std::fill(std::begin(skip), std::end(skip), m);
+	for (size_t i = 0; i + 1 < m; ++i)
+		skip[static_cast<unsigned char>(folded_n[i])] = m - 1 - i;
+
+	for (size_t pos = 0; pos + m <= n; pos += skip[ascii_fold(haystack[pos + m - 1])]) {
+		size_t i = m;
+		while (i > 0 && ascii_fold(haystack[pos + i - 1]) == static_cast<unsigned char>(folded_n[i - 1]))
+			--i;
+		if (i == 0)
+			return {pos, pos + m};
+	}
+	return bad_match;
+}
+
 void parse_blocks(std::vector<std::pair<size_t, size_t>>& blocks, std::string const& str) {
 	blocks.clear();
 
@@ -84,6 +125,11 @@ std::string strftime(const char *fmt, const tm *tmptr) {
 }
 
 std::pair<size_t, size_t> ifind(std::string const& haystack, std::string const& needle) {
+	// Folding with ICU is by far the slowest part of this, and most subtitle
+	// text doesn't need it
+	if (is_ascii(needle) && is_ascii(haystack))
+		return ascii_ifind(haystack, needle);
+
 	const auto folded_hs = boost::locale::fold_case(haystack);
 	const auto folded_n = boost::locale::fold_case(needle);
 	auto match = find_range(folded_hs, folded_n);
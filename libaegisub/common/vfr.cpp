@@ -22,15 +22,22 @@
 #include "libaegisub/io.h"
 #include "libaegisub/line_iterator.h"
 
+#include "mapped_lines.h"
+
 #include <algorithm>
 #include <boost/interprocess/streams/bufferstream.hpp>
 #include <boost/range/algorithm.hpp>
 #include <cmath>
 #include <functional>
-#include <iterator>
 
 namespace {
 static const int64_t default_denominator = 1000000000;
+/// Longest period in frames which is looked for when compressing timecodes.
+/// Rounding to milliseconds makes the frame times of NTSC-style rates repeat
+/// every 24, 30, 60 or 120 frames.
+static const int max_period = 120;
+/// Fewest frames a periodic run has to cover to be worth storing as one
+static const int min_run = 32;
 using agi::line_iterator;
 using namespace agi::vfr;
 
@@ -86,12 +93,12 @@ TimecodeRange v1_parse_line(std::string const& str) {
 }
 
 /// @brief Parse a v1 timecode file
-/// @param      file      Iterator of lines in the file
+/// @param      file      Lines in the file after the assumed fps
 /// @param      line      Header of file with assumed fps
 /// @param[out] timecodes Vector filled with frame start times
 /// @param[out] last      Unrounded time of the last frame
 /// @return Assumed fps times one million
-int64_t v1_parse(line_iterator<std::string> file, std::string line, std::vector<int> &timecodes, int64_t &last) {
+int64_t v1_parse(std::vector<std::string> const& file, std::string line, std::vector<int> &timecodes, int64_t &last) {
 	double fps = atof(line.substr(7).c_str());
 	if (fps <= 0.) throw InvalidFramerate("Assumed FPS must be greater than zero");
 	if (fps > 1000.) throw InvalidFramerate("Assumed FPS must not be greater than 1000");
@@ -131,13 +138,110 @@ int64_t v1_parse(line_iterator<std::string> file, std::string line, std::vector<
 }
 
 namespace agi { namespace vfr {
+struct Framerate::Timecodes {
+	/// A range of frames whose times are given by offsets from the start of
+	/// the period they're in. Frames which don't fit any period are stored
+	/// in runs with one period covering the whole run.
+	struct Run {
+		int frame;     ///< First frame of the run
+		int time;      ///< Start time of the first frame
+		int period;    ///< Number of frames after which the offsets repeat
+		int period_ms; ///< Length of each period in milliseconds
+		size_t offset; ///< Index of the run's first offset in offsets
+	};
+
+	std::vector<Run> runs;
+	/// Time of each frame in a period relative to the start of the period
+	std::vector<int> offsets;
+	/// Number of frames
+	int count;
+	/// Start time of the last frame
+	int back;
+
+	Timecodes(std::vector<int> const& times);
+
+	/// Get the time of a frame in [0, count)
+	int TimeAtFrame(int frame) const;
+	/// Get the last frame starting at or before a time in [0, back]
+	int FrameAtTime(int ms) const;
+};
+
+Framerate::Timecodes::Timecodes(std::vector<int> const& times)
+: count((int)times.size())
+, back(times.back())
+{
+	auto add_run = [&](int frame, int period, int period_ms) {
+		runs.push_back(Run{frame, times[frame], period, period_ms, offsets.size()});
+		for (int i = frame; i < frame + period; ++i)
+			offsets.push_back(times[i] - times[frame]);
+	};
+
+	int unmatched = -1;
+	for (int frame = 0; frame < count; ) {
+		// Use the shortest period which the next stretch of frames repeats
+		// for long enough
+		int period = 0, end = 0;
+		for (int p = 1; p <= max_period && frame + p < count; ++p) {
+			int period_ms = times[frame + p] - times[frame];
+			end = frame + p + 1;
+			while (end < count && times[end] - times[end - p] == period_ms)
+				++end;
+			if (end - frame >= std::max(min_run, 4 * p)) {
+				period = p;
+				break;
+			}
+		}
+
+		if (!period) {
+			if (unmatched < 0)
+				unmatched = frame;
+			++frame;
+			continue;
+		}
+
+		if (unmatched >= 0)
+			add_run(unmatched, frame - unmatched, 0);
+		unmatched = -1;
+		add_run(frame, period, times[frame + period] - times[frame]);
+		frame = end;
+	}
+	if (unmatched >= 0)
+		add_run(unmatched, count - unmatched, 0);
+}
+
+int Framerate::Timecodes::TimeAtFrame(int frame) const {
+	auto run = std::upper_bound(begin(runs), end(runs), frame, [](int frame, Run const& run) {
+		return frame < run.frame;
+	}) - 1;
+	int i = frame - run->frame;
+	return run->time + i / run->period * run->period_ms + offsets[run->offset + i % run->period];
+}
+
+int Framerate::Timecodes::FrameAtTime(int ms) const {
+	// The last run starting at or before ms has the frame in it, unless the
+	// frame is the last one in the run and the next run starts after ms
+	auto run = std::upper_bound(begin(runs), end(runs), ms, [](int ms, Run const& run) {
+		return ms < run.time;
+	}) - 1;
+	int length = (run + 1 == end(runs) ? count : (run + 1)->frame) - run->frame;
+	int last_period = (length - 1) / run->period;
+
+	int rel = ms - run->time;
+	int period = run->period_ms ? std::min(rel / run->period_ms, last_period) : last_period;
+	rel -= period * run->period_ms;
+
+	auto first = begin(offsets) + run->offset;
+	int i = int(std::upper_bound(first, first + run->period, rel) - first) - 1;
+	return run->frame + std::min(period * run->period + i, length - 1);
+}
+
 Framerate::Framerate(double fps)
 : denominator(default_denominator)
 , numerator(int64_t(fps * denominator))
 {
 	if (fps < 0.) throw InvalidFramerate("FPS must be greater than zero");
 	if (fps > 1000.) throw InvalidFramerate("FPS must not be greater than 1000");
-	timecodes.push_back(0);
+	timecodes = std::make_shared<Timecodes>(std::vector<int>{0});
 }
 
 Framerate::Framerate(int64_t numerator, int64_t denominator, bool drop)
@@ -148,44 +252,78 @@ Framerate::Framerate(int64_t numerator, int64_t denominator, bool drop)
 	if (numerator <= 0 || denominator <= 0)
 		throw InvalidFramerate("Numerator and denominator must both be greater than zero");
 	if (numerator / denominator > 1000) throw InvalidFramerate("FPS must not be greater than 1000");
-	timecodes.push_back(0);
+	timecodes = std::make_shared<Timecodes>(std::vector<int>{0});
 }
 
-void Framerate::SetFromTimecodes() {
-	validate_timecodes(timecodes);
-	normalize_timecodes(timecodes);
+void Framerate::SetFromTimecodes(std::vector<int> times) {
+	validate_timecodes(times);
+	normalize_timecodes(times);
 	denominator = default_denominator;
-	numerator = (timecodes.size() - 1) * denominator * 1000 / timecodes.back();
-	last = (timecodes.size() - 1) * denominator * 1000;
+	numerator = (times.size() - 1) * denominator * 1000 / times.back();
+	last = (times.size() - 1) * denominator * 1000;
+	timecodes = std::make_shared<Timecodes>(times);
 }
 
-Framerate::Framerate(std::vector<int> timecodes)
-: timecodes(std::move(timecodes))
-{
-	SetFromTimecodes();
+Framerate::Framerate(std::vector<int> timecodes) {
+	SetFromTimecodes(std::move(timecodes));
 }
 
-Framerate::Framerate(std::initializer_list<int> timecodes)
-: timecodes(timecodes)
-{
-	SetFromTimecodes();
+Framerate::Framerate(std::initializer_list<int> timecodes) {
+	SetFromTimecodes(timecodes);
 }
 
 Framerate::Framerate(fs::path const& filename)
 : denominator(default_denominator)
 {
+	// Files which start with one of the ASCII headers are read directly from
+	// a mapping of the file, as v2 files for long videos can be large and
+	// detecting the encoding means reading all of it
+	{
+		read_file_mapping mapping(filename);
+		uint64_t offset;
+		auto line = first_line(mapping, offset);
+		if (line == "# timecode format v2") {
+			std::vector<int> times;
+			times.reserve(mapping.size() / 8);
+			for_each_line(mapping, offset, [&](const char *begin, const char *end) {
+				int timecode;
+				if (parse_int(begin, end, timecode))
+					times.push_back(timecode);
+			});
+			SetFromTimecodes(std::move(times));
+			return;
+		}
+		if (line == "# timecode format v1" || line.substr(0, 7) == "Assume ") {
+			std::vector<std::string> lines;
+			for_each_line(mapping, offset, [&](const char *begin, const char *end) {
+				lines.emplace_back(begin, end);
+			});
+			if (line[0] == '#') {
+				line = lines.empty() ? "" : lines.front();
+				if (!lines.empty())
+					lines.erase(lines.begin());
+			}
+			std::vector<int> times;
+			numerator = v1_parse(lines, line, times, last);
+			timecodes = std::make_shared<Timecodes>(times);
+			return;
+		}
+	}
+
 	auto file = agi::io::Open(filename);
 	auto encoding = agi::charset::Detect(filename);
 	auto line = *line_iterator<std::string>(*file, encoding);
 	if (line == "# timecode format v2") {
-		copy(line_iterator<int>(*file, encoding), line_iterator<int>(), back_inserter(timecodes));
-		SetFromTimecodes();
+		SetFromTimecodes(std::vector<int>(line_iterator<int>(*file, encoding), line_iterator<int>()));
 		return;
 	}
 	if (line == "# timecode format v1" || line.substr(0, 7) == "Assume ") {
 		if (line[0] == '#')
 			line = *line_iterator<std::string>(*file, encoding);
-		numerator = v1_parse(line_iterator<std::string>(*file, encoding), line, timecodes, last);
+		std::vector<std::string> lines(line_iterator<std::string>(*file, encoding), line_iterator<std::string>());
+		std::vector<int> times;
+		numerator = v1_parse(lines, line, times, last);
+		timecodes = std::make_shared<Timecodes>(times);
 		return;
 	}
 
@@ -197,9 +335,12 @@ void Framerate::Save(fs::path const& filename, int length) const {
 	auto &out = file.Get();
 
 	out << "# timecode format v2\n";
-	boost::copy(timecodes, std::ostream_iterator<int>(out, "\n"));
-	for (int written = (int)timecodes.size(); written < length; ++written)
-		out << TimeAtFrame(written) << std::endl;
+	for (int frame = 0; frame < std::max(length, timecodes->count); ++frame)
+		out << TimeAtFrame(frame) << "\n";
+}
+
+bool Framerate::IsVFR() const {
+	return timecodes && timecodes->count > 1;
 }
 
 int Framerate::FrameAtTime(int ms, Time type) const {
@@ -224,10 +365,20 @@ int Framerate::FrameAtTime(int ms, Time type) const {
 	if (ms < 0)
 		return int((ms * numerator / denominator - 999) / 1000);
 
-	if (ms > timecodes.back())
-		return int((ms * numerator - last + denominator - 1) / denominator / 1000) + (int)timecodes.size() - 1;
+	if (ms > timecodes->back)
+		return int((ms * numerator - last + denominator - 1) / denominator / 1000) + timecodes->count - 1;
+
+	return timecodes->FrameAtTime(ms);
+}
+
+void Framerate::FramesAtTimes(const int *times, int *frames, size_t count, Time type) const {
+	for (size_t i = 0; i < count; ++i)
+		frames[i] = FrameAtTime(times[i], type);
+}
 
-	return (int)distance(lower_bound(timecodes.rbegin(), timecodes.rend(), ms, std::greater<int>()), timecodes.rend()) - 1;
+void Framerate::TimesAtFrames(const int *frames, int *times, size_t count, Time type) const {
+	for (size_t i = 0; i < count; ++i)
+		times[i] = TimeAtFrame(frames[i], type);
 }
 
 int Framerate::TimeAtFrame(int frame, Time type) const {
@@ -247,12 +398,12 @@ int Framerate::TimeAtFrame(int frame, Time type) const {
 	if (frame < 0)
 		return (int)(frame * denominator * 1000 / numerator);
 
-	if (frame >= (signed)timecodes.size()) {
-		int64_t frames_past_end = frame - (int)timecodes.size() + 1;
+	if (frame >= timecodes->count) {
+		int64_t frames_past_end = frame - timecodes->count + 1;
 		return int((frames_past_end * 1000 * denominator + last + numerator / 2) / numerator);
 	}
 
-	return timecodes[frame];
+	return timecodes->TimeAtFrame(frame);
 }
 
 void Framerate::SmpteAtFrame(int frame, int *h, int *m, int *s, int *f) const {
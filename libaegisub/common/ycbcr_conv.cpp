@@ -16,7 +16,16 @@
 
 #include "libaegisub/ycbcr_conv.h"
 
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace {
+/// Fractional bits of the fixed point coefficients. The SIMD path multiplies
+/// them as 16-bit values, which leaves room for coefficients up to 8
+const int fixed_bits = 12;
 double matrix_coefficients[][3] = {
 	{.299, .587, .114},    // BT.601
 	{.2126, .7152, .0722}, // BT.709
@@ -40,6 +49,58 @@ void col_mult(std::array<double, 9>& m, std::array<double, 3> v) {
 		m[6] * v[0], m[7] * v[1], m[8] * v[2],
 	}};
 }
+
+uint8_t clamp_fixed(int32_t v) {
+	if (v < 0) return 0;
+	v >>= fixed_bits;
+	return v > 255 ? 255 : v;
+}
+
+/// Apply an affine transform from init_fixed to the first three bytes of each
+/// four byte pixel, with the matrix in the order of the bytes
+void convert_pixels(std::array<int32_t, 12> const& m, uint8_t *px, size_t count) {
+	size_t i = 0;
+#ifdef __SSE2__
+	// Each 32-bit lane holds one pixel. Splitting the bytes into the even
+	// and odd ones gives 16-bit pairs of (c0, c2) and (c1, c3), so each
+	// output channel is two multiply-adds of those pairs and the offset
+	const __m128i low_bytes = _mm_set1_epi16(0xFF);
+	const __m128i alpha_mask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+	__m128i even_coeff[3], odd_coeff[3], offset[3];
+	for (int c = 0; c < 3; ++c) {
+		even_coeff[c] = _mm_set1_epi32(static_cast<int>((m[c * 3] & 0xFFFF) | (static_cast<uint32_t>(m[c * 3 + 2]) << 16)));
+		odd_coeff[c] = _mm_set1_epi32(m[c * 3 + 1] & 0xFFFF);
+		offset[c] = _mm_set1_epi32(m[9 + c]);
+	}
+
+	for (; i + 4 <= count; i += 4) {
+		auto ptr = reinterpret_cast<__m128i *>(px + i * 4);
+		__m128i v = _mm_loadu_si128(ptr);
+		__m128i even = _mm_and_si128(v, low_bytes);
+		__m128i odd = _mm_srli_epi16(v, 8);
+
+		__m128i out[3];
+		for (int c = 0; c < 3; ++c) {
+			__m128i sum = _mm_add_epi32(_mm_madd_epi16(even, even_coeff[c]), _mm_madd_epi16(odd, odd_coeff[c]));
+			out[c] = _mm_srai_epi32(_mm_add_epi32(sum, offset[c]), fixed_bits);
+		}
+		__m128i alpha = _mm_srli_epi32(_mm_and_si128(v, alpha_mask), 24);
+
+		// Saturate to bytes, giving c0 x4, c1 x4, c2 x4, alpha x4, then
+		// interleave twice to get back to one pixel per four bytes
+		__m128i planar = _mm_packus_epi16(_mm_packs_epi32(out[0], out[1]), _mm_packs_epi32(out[2], alpha));
+		__m128i pairs = _mm_unpacklo_epi8(planar, _mm_srli_si128(planar, 8));
+		_mm_storeu_si128(ptr, _mm_unpacklo_epi8(pairs, _mm_srli_si128(pairs, 8)));
+	}
+#endif
+
+	for (; i < count; ++i) {
+		uint8_t *p = px + i * 4;
+		int32_t c0 = p[0], c1 = p[1], c2 = p[2];
+		for (int c = 0; c < 3; ++c)
+			p[c] = clamp_fixed(m[c * 3] * c0 + m[c * 3 + 1] * c1 + m[c * 3 + 2] * c2 + m[9 + c]);
+	}
+}
 }
 
 namespace agi {
@@ -85,14 +146,47 @@ void ycbcr_converter::init_dst(ycbcr_matrix dst_mat, ycbcr_range dst_range) {
 	}
 }
 
+void ycbcr_converter::init_fixed() {
+	auto shift = prod(from_ycbcr, add(shift_to, shift_from));
+	const double one = 1 << fixed_bits;
+	for (int row = 0; row < 3; ++row) {
+		for (int col = 0; col < 3; ++col) {
+			double v = 0;
+			for (int k = 0; k < 3; ++k)
+				v += from_ycbcr[row * 3 + k] * to_ycbcr[k * 3 + col];
+			rgb_fixed[row * 3 + col] = static_cast<int32_t>(std::lround(v * one));
+		}
+		rgb_fixed[9 + row] = static_cast<int32_t>(std::lround((shift[row] + .5) * one));
+	}
+}
+
 ycbcr_converter::ycbcr_converter(ycbcr_matrix mat, ycbcr_range range) {
 	init_src(mat, range);
 	init_dst(mat, range);
+	init_fixed();
 }
 
 ycbcr_converter::ycbcr_converter(ycbcr_matrix src_mat, ycbcr_range src_range, ycbcr_matrix dst_mat, ycbcr_range dst_range) {
 	init_src(src_mat, src_range);
 	init_dst(dst_mat, dst_range);
+	init_fixed();
+}
+
+void ycbcr_converter::rgb_to_rgb(Color *colors, size_t count) const {
+	static_assert(sizeof(Color) == 4, "Colors must be packed RGBA");
+	convert_pixels(rgb_fixed, reinterpret_cast<uint8_t *>(colors), count);
+}
+
+void ycbcr_converter::bgra_to_bgra(uint8_t *pixels, size_t count) const {
+	// Same transform with the red and blue rows and columns swapped
+	auto const& m = rgb_fixed;
+	std::array<int32_t, 12> bgr{{
+		m[8], m[7], m[6],
+		m[5], m[4], m[3],
+		m[2], m[1], m[0],
+		m[11], m[10], m[9],
+	}};
+	convert_pixels(bgr, pixels, count);
 }
 }
 
@@ -0,0 +1,36 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <cstddef>
+#include <vector>
+
+namespace agi { namespace ass {
+/// Shrink a TrueType font to be attached to a script by dropping the
+/// outlines of characters which aren't used
+///
+/// Glyphs keep their indices, so every table other than glyf and loca is
+/// left as is. Only glyphs which the cmap maps a character to are candidates
+/// for dropping, so glyphs which are only reachable through substitutions,
+/// such as ligatures and contextual forms, are always kept.
+///
+/// @param data Contents of the font file
+/// @param size Size of the font file in bytes
+/// @param characters Sorted codepoints whose glyphs must be kept
+/// @return The subset font, or an empty vector if the font is not a single
+///         TrueType-outline font or is malformed, in which case it should be
+///         attached as is
+std::vector<char> SubsetFont(const char *data, size_t size, std::vector<int> const& characters);
+} }
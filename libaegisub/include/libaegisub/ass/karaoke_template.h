@@ -0,0 +1,51 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace agi { namespace ass {
+/// A piece of a karaoke template's text
+struct TemplatePart {
+	enum Type {
+		/// Literal text
+		TEXT,
+		/// A $variable
+		VARIABLE,
+		/// A Lua !expression!
+		EXPRESSION
+	};
+
+	Type type;
+	/// The text of a TEXT part, or the name of a VARIABLE as written
+	std::string text;
+	/// The lowercase name of a VARIABLE
+	std::string name;
+	/// The TEXT and VARIABLE parts making up the code of an EXPRESSION
+	std::vector<TemplatePart> code;
+};
+
+/// @brief Split a karaoke template into literal text, variables and expressions
+///
+/// This matches how kara-templater.lua reads templates, where a variable is
+/// a $ followed by letters and underscores, and an expression is the text
+/// between two !s, after the variables in it have been replaced. An
+/// unpaired ! is literal text. Unlike replacing the variables first, the
+/// values of variables can't contain the !s of an expression.
+std::vector<TemplatePart> ParseTemplate(std::string const& text);
+} }
@@ -0,0 +1,43 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace agi { namespace ass {
+/// A span of time during which the same set of lines is visible
+struct OverlapPiece {
+	int start;
+	int end;
+	/// Indexes of the visible lines, in increasing order
+	std::vector<size_t> lines;
+};
+
+/// @brief Split lines into pieces which don't overlap
+/// @param starts Start time of each line
+/// @param ends End time of each line
+/// @return Pieces sorted by start time
+///
+/// This is a single sweep over the sorted start and end times, so it takes
+/// O(n log n) time plus the size of the result, however many lines overlap.
+/// A line which doesn't overlap any others comes back as one piece covering
+/// the whole line. Lines with no duration can't overlap anything, so they are
+/// returned as pieces of their own, before any other piece starting at the
+/// same time, and don't split the lines around them.
+std::vector<OverlapPiece> SplitOverlaps(std::vector<int> const& starts, std::vector<int> const& ends);
+} }
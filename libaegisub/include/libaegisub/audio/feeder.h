@@ -0,0 +1,164 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file feeder.h
+/// @brief Read-ahead of audio for playback
+/// @ingroup audio_output
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+
+/// @class AudioRingBuffer
+/// @brief Lock-free ring buffer of audio frames with one reader and one writer
+///
+/// Write() may only be called from one thread and Read() and Skip() from one
+/// other thread at a time. Reset() must not be called while either is running.
+class AudioRingBuffer {
+	std::vector<char> data;
+	size_t frame_size;
+	size_t capacity;
+
+	/// Total frames ever read and written; the difference is what's buffered
+	std::atomic<uint64_t> read_pos{0};
+	std::atomic<uint64_t> write_pos{0};
+
+public:
+	/// @param capacity   Maximum number of frames which can be buffered
+	/// @param frame_size Size of a frame in bytes
+	AudioRingBuffer(size_t capacity, size_t frame_size);
+
+	size_t GetCapacity() const { return capacity; }
+	size_t GetFrameSize() const { return frame_size; }
+
+	/// Number of frames which can be read
+	size_t Available() const;
+	/// Number of frames which can be written
+	size_t Space() const;
+
+	/// Write up to count frames
+	/// @return Number of frames written
+	size_t Write(const void *src, size_t count);
+	/// Read up to count frames
+	/// @return Number of frames read
+	size_t Read(void *dst, size_t count);
+	/// Discard up to count frames
+	/// @return Number of frames discarded
+	size_t Skip(size_t count);
+
+	/// Discard everything
+	void Reset();
+};
+
+/// @class AudioFeeder
+/// @brief Reads audio from a provider ahead of playback on its own thread
+///
+/// Reading from a provider can block for a long time, such as when another
+/// thread is holding the provider's lock to render the spectrum, which
+/// makes the output underrun if done from the thread which feeds the audio
+/// device. The feeder reads from the provider on a background thread into
+/// a ring buffer, so that the device's thread only has to copy the audio
+/// out and never waits on anything.
+///
+/// Start(), Stop(), SetEnd() and SetVolume() may be called from any thread,
+/// but Read() must only be called from one thread at a time, and Start()
+/// must not be called while Read() is running.
+class AudioFeeder {
+	AudioProvider *provider;
+	AudioRingBuffer ring;
+	/// Buffer the feeder thread reads from the provider into
+	std::vector<char> read_buffer;
+	/// Value of a silent sample byte
+	char silence;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	/// Next frame to read from the provider
+	int64_t position = 0;
+	/// Incremented whenever playback is restarted, so that a read which was
+	/// in progress at the time isn't added to the new playback's audio
+	uint64_t generation = 0;
+	bool active = false;
+	bool quit = false;
+
+	std::atomic<int64_t> end{0};
+	std::atomic<double> volume{1.0};
+
+	/// Frame which the next Read() returns
+	std::atomic<int64_t> read_position{0};
+	/// Frames which Read() replaced with silence and needs to skip once
+	/// they're in the buffer to stay in sync
+	size_t pending_skip = 0;
+
+	std::atomic<uint64_t> underruns{0};
+	std::atomic<uint64_t> underrun_frames{0};
+	/// Counters as of the last time they were logged
+	uint64_t reported_underruns = 0;
+	uint64_t reported_underrun_frames = 0;
+
+	std::thread thread;
+
+	void FeederThread();
+	/// Read count frames from the provider into the ring buffer, unlocking
+	/// while reading so that the feeder can be restarted in the meantime
+	void Fill(std::unique_lock<std::mutex>& lock, size_t count);
+	/// Log the underruns since the last time this was called
+	void ReportUnderruns();
+
+public:
+	/// @param provider      Provider to read from
+	/// @param buffer_frames Maximum number of frames to read ahead
+	AudioFeeder(AudioProvider *provider, size_t buffer_frames);
+	~AudioFeeder();
+
+	/// @brief Start reading from a new position
+	/// @param start   First frame to read
+	/// @param end     Frame to stop reading at
+	/// @param prefill Number of frames to read before returning, so that the
+	///                output doesn't start with an underrun
+	void Start(int64_t start, int64_t end, size_t prefill);
+	/// Stop reading from the provider
+	void Stop();
+	/// Change the frame to stop reading at
+	void SetEnd(int64_t new_end);
+	/// Set the volume to apply to audio read from now on. As it's applied
+	/// when reading ahead, buffered audio keeps the old volume.
+	void SetVolume(double new_volume) { volume = new_volume; }
+
+	/// @brief Get exactly count frames of audio without blocking
+	///
+	/// If the feeder hasn't read far enough ahead, the missing audio is
+	/// replaced with silence and counted as an underrun, and the same amount
+	/// of audio is later skipped so that playback stays in sync.
+	void Read(void *buf, size_t count);
+
+	/// Frame which the next Read() returns
+	int64_t GetReadPosition() const { return read_position; }
+
+	/// Number of times Read() has run out of audio since the feeder was created
+	uint64_t GetUnderruns() const { return underruns; }
+	/// Total number of frames replaced with silence due to underruns
+	uint64_t GetUnderrunFrames() const { return underrun_frames; }
+};
+}
@@ -0,0 +1,170 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+namespace agi {
+/// Summary of the levels of a range of 16-bit mono audio
+struct AudioPeak {
+	int16_t min = 0;
+	int16_t max = 0;
+	/// Sum of the positive samples divided by the total number of samples
+	float pos_mean = 0.f;
+	/// Sum of the negative samples divided by the total number of samples
+	float neg_mean = 0.f;
+};
+
+/// Loudness and noisiness of a frame of audio
+struct AudioEnvelopeFrame {
+	/// RMS level in dBFS, no lower than AudioPeakIndex::SilenceLevel
+	float level = 0.f;
+	/// Fraction of adjacent pairs of samples which differ in sign
+	float zero_crossings = 0.f;
+};
+
+/// A point where speech starts or stops
+struct SpeechBoundary {
+	/// Time in milliseconds
+	int time;
+	/// Does speech start here, rather than stop?
+	bool onset;
+};
+
+/// @class AudioPeakIndex
+/// @brief Precomputed peaks of 16-bit mono audio at power-of-two resolutions
+///
+/// The cache providers fill this in as they decode, so that the waveform can
+/// be drawn zoomed out without reading every sample in the visible range.
+/// Level k summarizes runs of 2^(BaseBits + k) samples; each level is built
+/// from the one below it. All members may be called from any thread.
+///
+/// If the sample rate is known the index also holds an envelope of the
+/// energy and zero crossing rate of every EnvelopeFrameMs of audio, from
+/// which the points where speech starts and stops are found.
+class AudioPeakIndex {
+public:
+	/// Entry of one level of the index
+	struct Entry {
+		int16_t min;
+		int16_t max;
+		/// Number of samples covered by this entry which have been added
+		uint32_t ready;
+		float pos_mean;
+		float neg_mean;
+	};
+
+	/// log2 of the number of samples summarized by each finest level entry
+	static const int BaseBits = 10;
+	/// Minimum number of entries a queried range must span; ranges shorter
+	/// than this many finest level entries are better read directly
+	static const int MinEntries = 8;
+
+	/// Length of each frame of the envelope in milliseconds
+	static const int EnvelopeFrameMs = 10;
+	/// Level reported for digital silence, in dBFS
+	static const int SilenceLevel = -100;
+
+	/// Envelope of one frame as it's being added
+	struct EnvelopeEntry {
+		/// Sum of the squares of the samples, scaled to [-1, 1]
+		float energy;
+		/// Number of sign changes between adjacent samples
+		uint32_t crossings;
+		/// Number of samples in the frame which have been added
+		uint32_t ready;
+	};
+
+private:
+	int64_t num_samples;
+	int sample_rate;
+	std::vector<std::vector<Entry>> levels;
+	std::vector<EnvelopeEntry> envelope;
+	/// Speech boundaries found in the envelope, once it's complete
+	mutable std::vector<SpeechBoundary> boundaries;
+	mutable bool boundaries_found = false;
+	mutable std::mutex mutex;
+
+	int64_t EntryLength(size_t level, int64_t i) const;
+	/// First sample of an envelope frame
+	int64_t FrameStart(int64_t frame) const;
+	bool EnvelopeComplete() const;
+	AudioEnvelopeFrame EnvelopeFrame(size_t frame) const;
+
+public:
+	/// @param num_samples Length of the audio
+	/// @param sample_rate Sample rate of the audio, or 0 to not build an envelope
+	AudioPeakIndex(int64_t num_samples, int sample_rate = 0);
+
+	/// Add decoded samples to the index
+	/// @param start First sample; must be a multiple of 2^BaseBits
+	/// @param count Number of samples; must be a multiple of 2^BaseBits
+	///              unless the range ends at the end of the audio
+	void AddSamples(const int16_t *samples, int64_t start, int64_t count);
+
+	/// Get the peaks of a range of audio from the coarsest level which still
+	/// spans at least MinEntries entries over the range. The result covers
+	/// every entry which overlaps the range, and so may include up to one
+	/// entry's worth of extra samples on each side.
+	/// @return false if the range is too short to look up in the index or
+	///         not all of it has been added yet
+	bool GetPeak(int64_t start, int64_t count, AudioPeak &out) const;
+
+	/// Has every sample of the audio been added?
+	bool IsComplete() const;
+
+	/// Number of frames in the envelope, or 0 if there isn't one
+	int64_t GetEnvelopeFrames() const { return static_cast<int64_t>(envelope.size()); }
+
+	/// Get the envelope of frames [first, first + count)
+	/// @return false if the range isn't in the envelope or not all of it has
+	///         been added yet
+	bool GetEnvelope(int64_t first, int64_t count, std::vector<AudioEnvelopeFrame> &out) const;
+
+	/// @brief Get the speech boundaries in a time range, in order
+	///
+	/// The boundaries are found once the whole envelope has been added, and
+	/// are then looked up with a binary search.
+	/// @param start First time in milliseconds to look at
+	/// @param end   Last time in milliseconds to look at
+	/// @param[out] out Vector to append the boundaries to
+	/// @return false if the envelope isn't complete
+	bool GetSpeechBoundaries(int start, int end, std::vector<SpeechBoundary> &out) const;
+
+	/// @brief Find where speech starts and stops in an envelope
+	///
+	/// A frame counts as speech if it's well above the noise floor of the
+	/// whole envelope, or somewhat above it and noisy, as with fricatives.
+	/// Speech starts at the first of a run of speech frames and stops at the
+	/// first of a longer run of non-speech ones, so that short pauses within
+	/// words aren't treated as boundaries.
+	static std::vector<SpeechBoundary> FindSpeechBoundaries(std::vector<AudioEnvelopeFrame> const& frames);
+
+	/// Write the index to a stream so that it can be loaded later without
+	/// decoding the audio
+	void Save(std::ostream &out) const;
+
+	/// Replace the contents of the index with ones written by Save
+	/// @return false if the data isn't a saved index for audio of this length
+	bool Load(std::istream &in);
+
+	int64_t GetNumSamples() const { return num_samples; }
+};
+}
@@ -19,10 +19,14 @@
 #include <libaegisub/exception.h>
 #include <libaegisub/fs_fwd.h>
 
+#include <boost/filesystem/path.hpp>
+
 #include <atomic>
 #include <vector>
 
 namespace agi {
+class AudioPeakIndex;
+
 class AudioProvider {
 protected:
 	int channels = 0;
@@ -37,6 +41,12 @@ protected:
 
 	virtual void FillBuffer(void *buf, int64_t start, int64_t count) const = 0;
 
+	/// Get a pointer to samples which the provider already holds contiguously
+	/// in memory. Only called for ranges which lie entirely within the stream.
+	/// The pointer must remain valid until the provider is destroyed.
+	/// @return The samples, or nullptr if they can't be viewed in place
+	virtual const void *ViewBuffer(int64_t start, int64_t count) const { return nullptr; }
+
 	void ZeroFill(void *buf, int64_t count) const;
 
 public:
@@ -45,15 +55,67 @@ public:
 	void GetAudio(void *buf, int64_t start, int64_t count) const;
 	void GetAudioWithVolume(void *buf, int64_t start, int64_t count, double volume) const;
 
+	/// Get read-only access to samples without copying them
+	/// @return Pointer to the samples, which remains valid until the provider
+	///         is destroyed, or nullptr if the range isn't held in one piece
+	const void *ViewAudio(int64_t start, int64_t count) const;
+
+	/// Get read-only access to samples, copying them into buf as GetAudio
+	/// does only if they can't be viewed in place. buf must be large enough
+	/// to hold the samples either way.
+	/// @return Either a view of the samples or buf
+	const void *GetAudioView(void *buf, int64_t start, int64_t count) const;
+
 	int64_t GetNumSamples()     const { return num_samples; }
-	int64_t GetDecodedSamples() const { return decoded_samples; }
 	int     GetSampleRate()     const { return sample_rate; }
 	int     GetBytesPerSample() const { return bytes_per_sample; }
 	int     GetChannels()       const { return channels; }
 	bool    AreSamplesFloat()   const { return float_samples; }
 
+	virtual int64_t GetDecodedSamples() const { return decoded_samples; }
+
+	/// Have all of the samples in the given range been decoded, so that
+	/// GetAudio will return the actual audio rather than silence for them?
+	virtual bool IsDecoded(int64_t start, int64_t count) const { return start + count <= decoded_samples; }
+
+	/// Hint that the audio starting at the given sample will be needed soon.
+	/// Cache providers which decode in the background will decode it next,
+	/// and providers reading from a file read ahead of it. This is called
+	/// repeatedly during playback with the position being played.
+	virtual void Prefetch(int64_t start) const { }
+
 	/// Does this provider benefit from external caching?
 	virtual bool NeedsCache() const { return false; }
+
+	/// Can GetAudio be called from multiple threads at once without any
+	/// external locking?
+	virtual bool SupportsConcurrentReads() const { return false; }
+
+	/// Index of the track being read from the source file, for providers
+	/// which support files with multiple audio tracks
+	virtual int GetTrackNumber() const { return 0; }
+
+	/// Open another instance of this provider reading the same audio, so
+	/// that different parts of it can be decoded in parallel. May be called
+	/// while another thread is reading from this provider.
+	/// @return The new provider, or nullptr if this isn't supported
+	virtual std::unique_ptr<AudioProvider> Clone() const { return nullptr; }
+
+	/// Get the audio in the format it was decoded in, before being downmixed
+	/// and converted to 16-bit for display and playback. This is only
+	/// available when the original format is cached or otherwise cheap to
+	/// read; if not, this provider itself is returned.
+	/// Any provider other than this one which is returned supports concurrent
+	/// reads.
+	virtual AudioProvider const& GetNativeProvider() const { return *this; }
+
+	/// Get the precomputed peaks of the audio, which cache providers build
+	/// for 16-bit mono audio as they decode it
+	/// The index may be filled in from a saved copy from another thread
+	/// while the audio is still being decoded.
+	/// @return The peak index, which lives as long as this provider, or
+	///         nullptr if there isn't one
+	virtual AudioPeakIndex *GetPeakIndex() const { return nullptr; }
 };
 
 /// Helper base class for an audio provider which wraps another provider
@@ -71,6 +133,8 @@ public:
 		bytes_per_sample = source->GetBytesPerSample();
 		float_samples = source->AreSamplesFloat();
 	}
+
+	int GetTrackNumber() const override { return source->GetTrackNumber(); }
 };
 
 DEFINE_EXCEPTION(AudioProviderError, Exception);
@@ -87,9 +151,52 @@ std::unique_ptr<AudioProvider> CreateDummyAudioProvider(fs::path const& filename
 std::unique_ptr<AudioProvider> CreatePCMAudioProvider(fs::path const& filename, BackgroundRunner *);
 
 std::unique_ptr<AudioProvider> CreateConvertAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+/// Wrap a provider so that it can be read from multiple threads. Sources
+/// which don't support concurrent reads themselves are cloned for threads
+/// which would otherwise have to wait, falling back to one read at a time
+/// if they can't be cloned.
 std::unique_ptr<AudioProvider> CreateLockAudioProvider(std::unique_ptr<AudioProvider> source_provider);
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir);
+/// Create a HD cache whose cache file is kept after the provider is destroyed
+/// @param cache_key Identifier for the decoded audio. Must change whenever
+///                  the source or the format of its output does. If a fully
+///                  decoded cache file with this key exists it is reused
+///                  rather than decoding the audio again.
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir, std::string const& cache_key);
 std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+/// Create a RAM cache which stores the audio losslessly compressed. The
+/// source must be 16-bit mono, i.e. already run through the converter.
+std::unique_ptr<AudioProvider> CreateCompressedRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+
+/// Variants of the cache providers which decode with more than one thread
+/// @param extra_sources Additional providers for the same audio as
+///                      source_provider. The audio is split into segments
+///                      which are decoded in parallel, one thread per source.
+std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, std::vector<std::unique_ptr<AudioProvider>> extra_sources, fs::path const& dir, std::string const& cache_key);
+std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider, std::vector<std::unique_ptr<AudioProvider>> extra_sources);
+std::unique_ptr<AudioProvider> CreateCompressedRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider, std::vector<std::unique_ptr<AudioProvider>> extra_sources);
 
 void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time);
+
+/// A clip to save with SaveAudioClips
+struct AudioClip {
+	int start_time; ///< Start of the clip in milliseconds
+	int end_time;   ///< End of the clip in milliseconds
+	fs::path path;  ///< File to save the clip to, or empty to only put it in the container
+};
+
+/// @brief Save many audio clips at once
+///
+/// The clips are read in order of start time, in large sequential reads
+/// which are shared between overlapping and nearby clips, and the files are
+/// written in parallel. This is much faster than calling SaveAudioClip for
+/// each clip when there are many of them.
+///
+/// @param clips Clips to save
+/// @param container If not empty, also write every clip one after another
+///                  to this WAV file, in order of start time. Each clip has a
+///                  cue point and a labelled region giving its position and
+///                  length, labelled with the clip's file name, or its one-based
+///                  index in clips if it doesn't have one.
+void SaveAudioClips(AudioProvider const& provider, std::vector<AudioClip> const& clips, fs::path const& container = fs::path());
 }
@@ -0,0 +1,356 @@
+// Copyright (c) 2009, Niels Martin Hansen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//   * Redistributions of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//   * Redistributions in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//   * Neither the name of the Aegisub Group nor the names of its contributors
+//     may be used to endorse or promote products derived from this software
+//     without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file block_cache.h
+/// @ingroup utility
+/// @brief Template class for creating caches for blocks of data
+
+#pragma once
+
+#include <libaegisub/cache_budget.h>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace agi {
+namespace block_cache_detail {
+	/// Produce a block, reusing a spare block if the factory knows how to
+	template<typename Factory, typename Block>
+	auto Produce(Factory& factory, size_t i, Block& spare, int) -> decltype(factory.ProduceBlock(i, std::move(spare)))
+	{
+		return factory.ProduceBlock(i, std::move(spare));
+	}
+
+	template<typename Factory, typename Block>
+	auto Produce(Factory& factory, size_t i, Block& spare, long) -> decltype(factory.ProduceBlock(i))
+	{
+		spare.reset();
+		return factory.ProduceBlock(i);
+	}
+}
+
+/// @class DataBlockCache
+/// @brief Cache for blocks of data in a stream or similar
+/// @tparam BlockT             Type of blocks to store
+/// @tparam MacroblockExponent Controls the number of blocks per macroblock, for tuning memory usage
+/// @tparam BlockFactoryT      Type of block factory
+///
+/// The factory must have a BlockType typedef for a smart pointer to a block,
+/// a GetBlockSize() member giving the size of each block in bytes, and a
+/// ProduceBlock(i) member which creates and fills block i. If it instead has
+/// ProduceBlock(i, BlockType spare), it's given blocks which have been aged
+/// out of the cache (or null if there aren't any) to refill rather than
+/// having to allocate a new one for every block produced. Spare blocks are
+/// all dropped by Age(0), so the block size must only change along with
+/// that.
+template <typename BlockT, int MacroblockExponent, typename BlockFactoryT>
+class DataBlockCache {
+	typedef typename BlockFactoryT::BlockType BlockPtr;
+
+	/// Type of an array of blocks
+	typedef std::vector<BlockPtr> BlockArray;
+
+	struct MacroBlock {
+		/// Neighbours in the age list, which are valid iff blocks.size() > 0
+		MacroBlock *newer = nullptr;
+		MacroBlock *older = nullptr;
+
+		/// CacheBudget::Tick() value from when this macroblock was last used
+		uint64_t last_used = 0;
+
+		/// The blocks contained in the macroblock
+		BlockArray blocks;
+	};
+
+	/// Type of an array of macro blocks
+	typedef std::vector<MacroBlock> MacroBlockArray;
+
+	/// The data in the cache
+	MacroBlockArray data;
+
+	/// Most and least recently used macroblocks in the age list, which runs
+	/// through the macroblocks themselves so that using one doesn't have to
+	/// allocate or splice anything
+	MacroBlock *newest = nullptr;
+	MacroBlock *oldest = nullptr;
+
+	/// Blocks from macroblocks which have been aged out, to be reused for new
+	/// blocks rather than freeing and reallocating them
+	std::vector<BlockPtr> spare;
+
+	/// Number of blocks per macroblock
+	size_t macroblock_size;
+
+	/// Bitmask to extract the inside-macroblock index for a block by bitwise and
+	size_t macroblock_index_mask;
+
+	/// Current size of the blocks in the cache in bytes, not including spares
+	size_t size = 0;
+
+	/// Factory object for blocks
+	BlockFactoryT factory;
+
+	void Unlink(MacroBlock &mb)
+	{
+		(mb.newer ? mb.newer->older : newest) = mb.older;
+		(mb.older ? mb.older->newer : oldest) = mb.newer;
+		mb.newer = mb.older = nullptr;
+	}
+
+	void PushNewest(MacroBlock &mb)
+	{
+		mb.older = newest;
+		mb.newer = nullptr;
+		(newest ? newest->newer : oldest) = &mb;
+		newest = &mb;
+	}
+
+	/// @brief Dispose of all blocks in a macroblock and mark it empty
+	/// @param mb Macroblock to clear
+	void KillMacroBlock(MacroBlock &mb)
+	{
+		if (mb.blocks.empty())
+			return;
+
+		for (auto& block : mb.blocks)
+		{
+			if (!block) continue;
+			size -= factory.GetBlockSize();
+			if (spare.size() < macroblock_size)
+				spare.push_back(std::move(block));
+		}
+
+		mb.blocks.clear();
+		Unlink(mb);
+	}
+
+public:
+	/// @brief Constructor
+	/// @param block_count Total number of blocks the cache will manage
+	/// @param factory     Factory object to use for producing blocks
+	///
+	/// Note that the block_count is the maximum block index the cache will ever see,
+	/// it is an error to request a block number greater than block_count.
+	///
+	/// The factory object passed must respond well to copying.
+	DataBlockCache(size_t block_count, BlockFactoryT factory = BlockFactoryT())
+	: factory(std::move(factory))
+	{
+		SetBlockCount(block_count);
+	}
+
+	// Moving the macroblock array doesn't move the macroblocks themselves, so
+	// the age list pointers stay valid
+	DataBlockCache(DataBlockCache&& other)
+	: data(std::move(other.data))
+	, newest(other.newest)
+	, oldest(other.oldest)
+	, spare(std::move(other.spare))
+	, macroblock_size(other.macroblock_size)
+	, macroblock_index_mask(other.macroblock_index_mask)
+	, size(other.size)
+	, factory(std::move(other.factory))
+	{
+		other.newest = other.oldest = nullptr;
+		other.size = 0;
+	}
+
+	DataBlockCache& operator=(DataBlockCache&& other)
+	{
+		data = std::move(other.data);
+		newest = other.newest;
+		oldest = other.oldest;
+		spare = std::move(other.spare);
+		macroblock_size = other.macroblock_size;
+		macroblock_index_mask = other.macroblock_index_mask;
+		size = other.size;
+		factory = std::move(other.factory);
+		other.newest = other.oldest = nullptr;
+		other.size = 0;
+		return *this;
+	}
+
+	/// @brief Change the number of blocks in cache
+	/// @param block_count New number of blocks to hold
+	///
+	/// This will completely de-allocate the cache and re-allocate it with the new block count.
+	void SetBlockCount(size_t block_count)
+	{
+		if (data.size() > 0)
+			Age(0);
+
+		macroblock_size = 1UL << MacroblockExponent;
+		macroblock_index_mask = macroblock_size - 1;
+
+		data.resize((block_count + macroblock_size - 1) >> MacroblockExponent);
+		size = 0;
+	}
+
+	/// @brief Clean up the cache
+	/// @param max_size Target maximum size of the cache in bytes
+	///
+	/// Passing a max_size of 0 (zero) causes the cache to be completely flushed
+	/// in a fast manner, including the spare blocks.
+	///
+	/// The max_size is not a hard limit, the cache size might somewhat exceed the max
+	/// after the aging operation, though it shouldn't be by much.
+	void Age(size_t max_size)
+	{
+		// Quick way out: get rid of everything
+		if (max_size == 0)
+		{
+			size_t block_count = data.size();
+			data.clear();
+			data.resize(block_count);
+			newest = oldest = nullptr;
+			spare.clear();
+			size = 0;
+			return;
+		}
+
+		// Remove old entries until we're under the max size
+		while (size > max_size) {
+			// When size > 0, the age list should never be empty
+			assert(oldest);
+			KillMacroBlock(*oldest);
+		}
+	}
+
+	/// Get the current size of the cache in bytes, including spare blocks
+	size_t GetSize() const { return size + spare.size() * factory.GetBlockSize(); }
+
+	/// @brief Get when the least recently used macroblock was last used
+	/// @return A CacheBudget::Tick() value, or CacheBudget::NotEvictable if the cache is empty
+	///
+	/// Spare blocks count as older than anything else.
+	uint64_t GetOldestUse() const
+	{
+		if (!spare.empty()) return 0;
+		return oldest ? oldest->last_used : CacheBudget::NotEvictable;
+	}
+
+	/// Remove the spare blocks, or if there are none the least recently used
+	/// macroblock from the cache
+	void AgeOldest()
+	{
+		if (!spare.empty())
+			spare.clear();
+		else if (oldest)
+		{
+			KillMacroBlock(*oldest);
+			spare.clear();
+		}
+	}
+
+	/// @brief Call a function with each block which is currently in the cache
+	/// @param func Function to call with the index of each block and the block
+	///
+	/// This doesn't count as using the blocks for the purposes of aging.
+	template<typename Func>
+	void ForEachBlock(Func&& func) const
+	{
+		for (size_t mbi = 0; mbi < data.size(); ++mbi)
+		{
+			auto const& blocks = data[mbi].blocks;
+			for (size_t bi = 0; bi < blocks.size(); ++bi)
+			{
+				if (blocks[bi])
+					func((mbi << MacroblockExponent) + bi, static_cast<BlockT const&>(*blocks[bi]));
+			}
+		}
+	}
+
+	/// @brief Is a block currently in the cache?
+	/// @param i Index of the block to check
+	///
+	/// This doesn't count as using the block for the purposes of aging.
+	bool Contains(size_t i) const
+	{
+		size_t mbi = i >> MacroblockExponent;
+		if (mbi >= data.size()) return false;
+		auto const& blocks = data[mbi].blocks;
+		return !blocks.empty() && blocks[i & macroblock_index_mask];
+	}
+
+	/// @brief Obtain a data block from the cache
+	/// @param      i       Index of the block to retrieve
+	/// @param[out] created On return, tells whether the returned block was created during the operation
+	/// @return A pointer to the block in cache
+	///
+	/// It is legal to pass 0 (null) for created, in this case nothing is returned in it.
+	BlockT& Get(size_t i, bool *created = nullptr)
+	{
+		size_t mbi = i >> MacroblockExponent;
+		assert(mbi < data.size());
+
+		auto &mb = data[mbi];
+
+		// Move this macroblock to the front of the age list
+		if (mb.blocks.empty())
+		{
+			mb.blocks.resize(macroblock_size);
+			PushNewest(mb);
+		}
+		else if (&mb != newest)
+		{
+			Unlink(mb);
+			PushNewest(mb);
+		}
+
+		mb.last_used = CacheBudget::Tick();
+
+		size_t block_index = i & macroblock_index_mask;
+		assert(block_index < mb.blocks.size());
+
+		BlockT *b = mb.blocks[block_index].get();
+
+		if (!b)
+		{
+			BlockPtr recycled;
+			if (!spare.empty())
+			{
+				recycled = std::move(spare.back());
+				spare.pop_back();
+			}
+			mb.blocks[block_index] = block_cache_detail::Produce(factory, i, recycled, 0);
+			b = mb.blocks[block_index].get();
+			assert(b != nullptr);
+			size += factory.GetBlockSize();
+
+			if (created) *created = true;
+		}
+		else
+			if (created) *created = false;
+
+		return *b;
+	}
+};
+}
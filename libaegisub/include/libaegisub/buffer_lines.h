@@ -0,0 +1,125 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file buffer_lines.h
+/// @brief Iteration over the lines of a block of memory
+/// @ingroup libaegisub
+///
+/// line_iterator reads a stream one line at a time and converts each line
+/// to UTF-8 separately. When the whole file is in memory anyway (such as
+/// when it's mapped) it's much faster to convert it all at once and then
+/// just find the line breaks, handing out ranges into the buffer rather than
+/// copying each line into a string.
+
+#pragma once
+
+#include <boost/range/iterator_range.hpp>
+
+#include <iterator>
+#include <string>
+
+namespace agi {
+/// A line from a buffer_lines, without the line break
+typedef boost::iterator_range<const char *> BufferLine;
+
+/// Find the first \\n in [begin, end), or end if there isn't one
+const char *find_newline(const char *begin, const char *end);
+
+/// @class buffer_line_iterator
+/// @brief An iterator over the lines of UTF-8 text in memory
+///
+/// Lines are split on \\n, and a \\r before it is dropped. As with
+/// line_iterator, text ending in a line break has an empty last line.
+class buffer_line_iterator final : public std::iterator<std::forward_iterator_tag, BufferLine> {
+	const char *pos = nullptr; ///< Start of the line after this one
+	const char *end = nullptr; ///< End of the buffer
+	BufferLine value;          ///< The current line
+	bool is_end = true;
+
+	void next();
+
+public:
+	buffer_line_iterator(const char *begin, const char *end)
+	: pos(begin), end(end), is_end(false)
+	{
+		next();
+	}
+
+	/// @brief Invalid iterator constructor; use for end iterator
+	buffer_line_iterator() = default;
+
+	BufferLine const& operator*() const { return value; }
+	BufferLine const* operator->() const { return &value; }
+
+	buffer_line_iterator& operator++() {
+		next();
+		return *this;
+	}
+	buffer_line_iterator operator++(int) {
+		buffer_line_iterator tmp(*this);
+		++*this;
+		return tmp;
+	}
+
+	bool operator==(buffer_line_iterator const& rgt) const {
+		if (is_end || rgt.is_end) return is_end == rgt.is_end;
+		return value.begin() == rgt.value.begin();
+	}
+	bool operator!=(buffer_line_iterator const& rgt) const { return !operator==(rgt); }
+};
+
+/// @class buffer_lines
+/// @brief The lines of a buffer in any encoding
+///
+/// UTF-8 text is used in place, so the buffer must outlive this. Anything
+/// else is converted to UTF-8 in one go when this is constructed.
+class buffer_lines {
+	std::string converted; ///< Buffer converted to UTF-8, if needed
+	const char *b;
+	const char *e;
+
+public:
+	/// @param begin Start of the text
+	/// @param end End of the text
+	/// @param encoding Encoding of the text
+	/// @throws agi::charset::ConversionFailure if the text isn't valid in the encoding
+	buffer_lines(const char *begin, const char *end, std::string const& encoding = "utf-8");
+
+	buffer_lines(buffer_lines const&) = delete;
+	buffer_lines& operator=(buffer_lines const&) = delete;
+
+	/// The UTF-8 text being split
+	const char *data() const { return b; }
+	size_t size() const { return e - b; }
+
+	buffer_line_iterator begin() const { return buffer_line_iterator(b, e); }
+	buffer_line_iterator end() const { return buffer_line_iterator(); }
+};
+
+inline void buffer_line_iterator::next() {
+	if (!pos) {
+		is_end = true;
+		return;
+	}
+
+	const char *eol = find_newline(pos, end);
+	const char *line_end = eol;
+	if (line_end != pos && line_end[-1] == '\r')
+		--line_end;
+	value = BufferLine(pos, line_end);
+	pos = eol == end ? nullptr : eol + 1;
+}
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file cache_budget.h
+/// @brief Memory budget shared by all of the caches
+/// @ingroup utility
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace agi {
+/// @class CacheBudget
+/// @brief Keeps the total size of a set of caches under a limit
+///
+/// Caches register themselves with a budget and stamp their entries with
+/// Tick() whenever they're used. When the caches together are over the
+/// limit, Trim() evicts whichever registered cache's least recently used
+/// entry is the oldest until they fit again, so a cache which is in active
+/// use gets memory from ones which aren't rather than each having a fixed
+/// share.
+///
+/// Caches which can't evict anything (such as an audio cache which has to
+/// hold the entire file) can still register to have their size reported and
+/// counted towards the limit.
+class CacheBudget {
+public:
+	/// The callbacks the budget uses to manage a cache
+	struct Cache {
+		/// Name to report the cache's usage under
+		std::string name;
+		/// Get the current size of the cache in bytes
+		std::function<size_t()> size;
+		/// Get the Tick() value of the least recently used entry in the
+		/// cache, or NotEvictable if there's nothing which can be evicted
+		std::function<uint64_t()> oldest;
+		/// Evict the least recently used entry
+		std::function<void()> evict;
+	};
+
+	/// Value for Cache::oldest when nothing can be evicted
+	static const uint64_t NotEvictable = std::numeric_limits<uint64_t>::max();
+
+	/// Current size of a registered cache
+	struct Usage {
+		std::string name;
+		size_t size;
+	};
+
+	/// @class Registration
+	/// @brief Unregisters a cache when destroyed
+	class Registration {
+		friend class CacheBudget;
+		CacheBudget *budget = nullptr;
+		uint64_t id = 0;
+		Registration(CacheBudget *budget, uint64_t id) : budget(budget), id(id) { }
+	public:
+		Registration() = default;
+		Registration(Registration&& other) : budget(other.budget), id(other.id) { other.budget = nullptr; }
+		Registration& operator=(Registration&& other);
+		~Registration() { Unregister(); }
+
+		/// Stop managing the cache. Must be done before it is destroyed.
+		void Unregister();
+	};
+
+private:
+	struct Entry {
+		uint64_t id;
+		Cache cache;
+	};
+
+	std::mutex mutex;
+	std::vector<Entry> caches;
+	uint64_t next_id = 0;
+	std::atomic<size_t> limit;
+
+	void Unregister(uint64_t id);
+
+public:
+	/// @param limit Initial size limit in bytes
+	CacheBudget(size_t limit = std::numeric_limits<size_t>::max());
+
+	/// Get the budget shared by all of Aegisub's caches
+	static CacheBudget& Global();
+
+	/// @brief Get the value to stamp a cache entry with when it is used
+	///
+	/// This is shared by all budgets so that it can be called from code which
+	/// doesn't know which budget it'll be managed by, and is safe to call from
+	/// any thread.
+	static uint64_t Tick();
+
+	/// @brief Start managing a cache
+	/// @return Registration which must be kept alive as long as the cache
+	///
+	/// The callbacks are called from whichever thread calls Trim(), so any
+	/// cache which is used from another thread has to lock in them.
+	Registration Register(Cache cache);
+
+	/// @brief Register a DataBlockCache or anything else with the same aging interface
+	/// @param name  Name to report the cache's usage under
+	/// @param cache Cache to register, which must outlive the registration
+	template<typename CacheT>
+	Registration Register(std::string name, CacheT *cache)
+	{
+		return Register(Cache{
+			std::move(name),
+			[=] { return cache->GetSize(); },
+			[=] { return cache->GetOldestUse(); },
+			[=] { cache->AgeOldest(); }
+		});
+	}
+
+	/// Set the maximum total size of the caches in bytes
+	void SetLimit(size_t limit);
+	size_t GetLimit() const { return limit; }
+
+	/// @brief Evict entries until the caches are within the limit
+	///
+	/// If the caches which can't evict anything are over the limit by
+	/// themselves everything which can be evicted is.
+	void Trim();
+
+	/// Get the total size of the registered caches in bytes
+	size_t GetTotalSize();
+
+	/// Get the size of each registered cache
+	std::vector<Usage> GetUsage();
+};
+}
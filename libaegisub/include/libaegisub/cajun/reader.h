@@ -10,7 +10,8 @@ Author: Terry Caton
 
 #include "elements.h"
 
-#include <vector>
+#include <cstdint>
+#include <string>
 
 namespace json
 {
@@ -50,53 +51,33 @@ public:
 		Reader::Location m_locTokenEnd;
 	};
 
-	static void Read(UnknownElement& elementRoot, std::istream& istr);
-
-private:
-	struct Token {
-		enum Type {
-			TOKEN_OBJECT_BEGIN,  // {
-			TOKEN_OBJECT_END,    // }
-			TOKEN_ARRAY_BEGIN,   // [
-			TOKEN_ARRAY_END,     // ]
-			TOKEN_NEXT_ELEMENT,  // ,
-			TOKEN_MEMBER_ASSIGN, // :
-			TOKEN_STRING,        // "xxx"
-			TOKEN_NUMBER,        // [+/-]000.000[e[+/-]000]
-			TOKEN_BOOLEAN,       // true -or- false
-			TOKEN_NULL           // null
-		};
-
-		Type nType;
-		std::string sValue;
-
-		// for malformed file debugging
-		Reader::Location locBegin;
-		Reader::Location locEnd;
+	/// Receives the contents of a document as it is read, for reading
+	/// documents without building an UnknownElement tree for them. The
+	/// strings passed to the handler are only valid until it returns.
+	class Handler {
+	public:
+		virtual ~Handler() = default;
+		virtual void StartObject() = 0;
+		virtual void Key(std::string const& key) = 0;
+		virtual void EndObject() = 0;
+		virtual void StartArray() = 0;
+		virtual void EndArray() = 0;
+		virtual void String(std::string const& value) = 0;
+		virtual void Integer(int64_t value) = 0;
+		virtual void Double(double value) = 0;
+		virtual void Boolean(bool value) = 0;
+		virtual void Null() = 0;
 	};
 
-	class InputStream;
-	class TokenStream;
-	typedef std::vector<Token> Tokens;
-
-	// scanning istream into token sequence
-	void Scan(Tokens& tokens, InputStream& inputStream);
-
-	void EatWhiteSpace(InputStream& inputStream);
-	void MatchString(std::string& sValue, InputStream& inputStream);
-	void MatchNumber(std::string& sNumber, InputStream& inputStream);
-	void MatchExpectedString(std::string const& sExpected, InputStream& inputStream);
+	static void Read(UnknownElement& elementRoot, std::istream& istr);
+	static void Read(UnknownElement& elementRoot, const char *begin, const char *end);
 
-	// parsing token sequence into element structure
-	UnknownElement Parse(TokenStream& tokenStream);
-	UnknownElement ParseObject(TokenStream& tokenStream);
-	UnknownElement ParseArray(TokenStream& tokenStream);
-	UnknownElement ParseString(TokenStream& tokenStream);
-	UnknownElement ParseNumber(TokenStream& tokenStream);
-	UnknownElement ParseBoolean(TokenStream& tokenStream);
-	UnknownElement ParseNull(TokenStream& tokenStream);
+	/// Read a document, passing its contents to handler
+	static void Read(Handler& handler, const char *begin, const char *end);
 
-	std::string const& MatchExpectedToken(Token::Type nExpected, TokenStream& tokenStream);
+private:
+	class Parser;
+	class DomBuilder;
 };
 
 }
@@ -16,16 +16,46 @@
 
 #include "visitor.h"
 
+#include <cstdint>
 #include <ostream>
 #include <string>
 
 namespace agi {
 
-class JsonWriter final : json::ConstVisitor {
-	std::ostream &ostr;
+/// Writes JSON into a string one value at a time, for writing documents
+/// without building a json::Object for them first. Output is formatted
+/// the same as JsonWriter's.
+class JsonBufferWriter {
+	std::string buffer;
 	std::string indent;
+	/// Number of containers which have been started but not ended
+	size_t depth = 0;
+	/// Has nothing been written to the innermost container yet?
+	bool empty = false;
+	/// Was the last thing written an object key?
+	bool after_key = false;
+
+	void Separator();
+	void Escaped(std::string const& str);
+
+public:
+	void StartObject();
+	void EndObject();
+	void StartArray();
+	void EndArray();
+	void Key(std::string const& key);
+	void String(std::string const& value);
+	void Integer(int64_t value);
+	void Double(double value);
+	void Boolean(bool value);
+	void Null();
 
-	JsonWriter(std::ostream &ostr) : ostr(ostr) { }
+	/// Get the JSON written so far
+	std::string const& Get() const { return buffer; }
+};
+
+class JsonWriter final : json::ConstVisitor {
+	JsonBufferWriter out;
 
 	void Visit(json::Array const& array) override;
 	void Visit(bool boolean) override;
@@ -39,7 +69,10 @@ class JsonWriter final : json::ConstVisitor {
 public:
 	template <typename T>
 	static void Write(T const& value, std::ostream& ostr) {
-		JsonWriter(ostr).Visit(value);
+		JsonWriter writer;
+		writer.Visit(value);
+		auto const& json = writer.out.Get();
+		ostr.write(json.data(), json.size());
 		ostr.flush();
 	}
 };
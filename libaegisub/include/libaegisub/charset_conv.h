@@ -115,6 +115,15 @@ public:
 /// @return false if either charset is not supported or the conversion cannot be done directly, true otherwise
 bool IsConversionSupported(const char *src, const char *dst);
 
+/// Convert UTF-8 to wchar_t, which is UTF-16 on Windows and UTF-32 elsewhere,
+/// without going through iconv
+/// @return false if src is not valid UTF-8, in which case dst is unspecified
+bool Utf8ToWide(const char *src, size_t len, std::wstring &dst);
+
+/// Convert wchar_t to UTF-8 without going through iconv
+/// @return false if src has unpaired surrogates, in which case dst is unspecified
+bool WideToUtf8(const wchar_t *src, size_t len, std::string &dst);
+
 /// Get a list of supported encodings with user-friendly names
 template<class T>
 T const& GetEncodingsList() {
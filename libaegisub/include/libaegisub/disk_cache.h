@@ -0,0 +1,122 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file disk_cache.h
+/// @brief A directory of cache files kept under a size quota
+/// @ingroup utility
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace agi {
+namespace dispatch { class Queue; }
+
+/// @class DiskCache
+/// @brief The files in a cache directory, with least recently used eviction
+///
+/// Everything which caches data derived from the files the user opens (such
+/// as indexes, peaks and thumbnails) stores it in a DiskCache, under a name
+/// derived from a key describing the content. The cache remembers how big
+/// each file is and when it was last used, and when the files together are
+/// over the quota the least recently used ones are deleted.
+///
+/// Finding the existing files, updating their use times and deleting them
+/// are all done on a background queue, so none of the functions here touch
+/// the disk themselves. The last use time of a file is stored as its
+/// modification time, so it carries over to the next session.
+class DiskCache {
+	struct Entry {
+		uint64_t size;
+		/// When the file was last used, in seconds
+		time_t last_use;
+		/// Order of uses within a second
+		uint64_t seq;
+	};
+
+	mutable std::mutex mutex;
+	fs::path root;
+	std::map<std::string, Entry> entries;
+	uint64_t total_size = 0;
+	uint64_t max_size;
+	size_t max_files;
+	uint64_t next_seq = 0;
+	/// Has a Trim() been queued which hasn't run yet?
+	bool trim_queued = false;
+
+	/// Queue which scanning, touching and eviction are done on
+	std::unique_ptr<dispatch::Queue> queue;
+
+	void Scan(fs::path const& dir);
+	void QueueTrim();
+	void Trim();
+	/// Get the name of path in the cache, or an empty string if it isn't in it
+	std::string NameOf(fs::path const& path) const;
+
+public:
+	/// @param root Directory to keep the files in, which is created if needed
+	/// @param max_size Total size of the files in bytes to evict down to
+	/// @param max_files Number of files to evict down to, or 0 for no limit
+	DiskCache(fs::path const& root, uint64_t max_size, size_t max_files = 0);
+	/// Waits for any queued work to finish
+	~DiskCache();
+
+	DiskCache(DiskCache const&) = delete;
+	DiskCache& operator=(DiskCache const&) = delete;
+
+	/// Get the name of the file for a key
+	/// @param key Anything which identifies the contents of the file
+	/// @param extension Suffix for the name, such as ".peaks"
+	static std::string FileName(std::string const& key, std::string const& extension);
+
+	/// @brief Get the path for a key and mark the file as used
+	///
+	/// The file may not exist, or may be deleted at any point after this if
+	/// the cache is over its quota, so users have to check that it's there
+	/// and can be read.
+	fs::path Path(std::string const& key, std::string const& extension);
+
+	/// Record that a file has been written, or has changed size, and evict
+	/// files if the cache is now over its quota
+	void Added(fs::path const& path);
+
+	/// Forget about a file which has been deleted
+	void Removed(fs::path const& path);
+
+	/// Move the cache to a different directory, leaving the files in the old one
+	void SetRoot(fs::path const& root);
+	fs::path Root() const;
+
+	/// Change the quota, evicting files if the cache is now over it
+	void SetQuota(uint64_t max_size, size_t max_files = 0);
+
+	/// Total size of the files in the cache in bytes
+	uint64_t GetSize() const;
+	/// Number of files in the cache
+	size_t GetCount() const;
+
+	/// Wait for the background work queued so far to finish
+	void Flush();
+};
+}
@@ -14,6 +14,8 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 
@@ -21,17 +23,78 @@ namespace agi {
 	namespace dispatch {
 		typedef std::function<void()> Thunk;
 
+		/// Scheduling class of a thunk. The thread pool always runs the
+		/// highest priority thunk which is ready to run, and thunks with the
+		/// same priority run in the order they were queued. The main queue
+		/// ignores priorities.
+		enum class Priority {
+			/// Something the user is waiting on, such as the current video frame
+			Interactive,
+			/// Something the user will probably want soon, such as the frames
+			/// after the current one
+			Prefetch,
+			/// Something nobody is waiting on, such as autosaving
+			Background
+		};
+
+		/// Handle for skipping queued thunks which haven't started yet.
+		/// Copies share their state, so one token can cancel a whole group
+		/// of thunks.
+		class CancelToken {
+			friend class Queue;
+			std::shared_ptr<std::atomic<bool>> cancelled;
+		public:
+			CancelToken();
+
+			/// Skip all thunks queued with this token which haven't started
+			void Cancel() { *cancelled = true; }
+			bool IsCancelled() const { return *cancelled; }
+		};
+
+		/// Counters for a queue, for tuning the code using it
+		struct QueueStats {
+			/// Thunks which have been queued but haven't started yet
+			size_t depth;
+			/// Thunks which have been started
+			uint64_t started;
+			/// Thunks which were skipped due to being cancelled
+			uint64_t cancelled;
+			/// Average time from a thunk being queued to it starting, in
+			/// microseconds
+			uint64_t mean_latency_us;
+			/// Longest time from a thunk being queued to it starting
+			uint64_t max_latency_us;
+		};
+
 		class Queue {
-			virtual void DoInvoke(Thunk thunk)=0;
 		public:
+			struct Counters;
+		private:
+			std::shared_ptr<Counters> counters;
+
+			virtual void DoInvoke(Thunk thunk, Priority priority)=0;
+			void Invoke(Thunk thunk, Priority priority, std::shared_ptr<std::atomic<bool>> cancelled);
+		public:
+			Queue();
 			virtual ~Queue() { }
 
 			/// Invoke the thunk on this processing queue, returning immediately
-			void Async(Thunk thunk);
+			void Async(Thunk thunk, Priority priority = Priority::Interactive);
+
+			/// Invoke the thunk on this processing queue, returning
+			/// immediately, unless the token is cancelled before it starts
+			void Async(Thunk thunk, Priority priority, CancelToken const& token);
 
 			/// Invoke the thunk on this processing queue, returning only when
 			/// it's complete
-			void Sync(Thunk thunk);
+			///
+			/// On a serial queue, this waits for the thunks queued before it
+			/// with the same or higher priority, so Sync([]{}, Priority::Background)
+			/// waits for everything already queued.
+			void Sync(Thunk thunk, Priority priority = Priority::Interactive);
+
+			/// Get the counters for this queue
+			QueueStats Stats() const;
 		};
 
 		/// Initialize the dispatch thread pools
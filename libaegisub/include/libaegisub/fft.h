@@ -0,0 +1,73 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file fft.h
+/// @brief Real FFT and log power for the audio spectrum
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace agi {
+/// Forward transform of real input of a fixed power of two size
+///
+/// The input is packed into a complex transform of half the size, which is
+/// done on separate real and imaginary arrays so that the butterflies can be
+/// vectorised, with the twiddle factors and bit reversal precalculated.
+class RealFFT {
+	/// Number of complex points in the packed transform
+	size_t half_size;
+	/// Twiddle factors for each pass, with those for the pass combining
+	/// transforms of size h starting at index h - 1
+	std::vector<float> twiddle_r, twiddle_i;
+	/// Twiddle factors for unpacking the real transform
+	std::vector<float> unpack_r, unpack_i;
+	/// Destination of each input pair in the packed transform
+	std::vector<unsigned int> bit_reverse;
+	/// Packed transform being worked on
+	std::vector<float> work_r, work_i;
+
+public:
+	/// @param n_samples Number of real input samples, which must be a power of two
+	RealFFT(size_t n_samples);
+
+	/// @brief Transform a block of samples
+	/// @param input          n_samples samples to transform
+	/// @param[out] output_r  Real parts of the first n_samples / 2 bins
+	/// @param[out] output_i  Imaginary parts of the first n_samples / 2 bins
+	void Transform(const float *input, float *output_r, float *output_i);
+};
+
+/// @brief Get the spectrum's display values for transform output
+/// @param count      Number of bins
+/// @param real       Real parts of the bins
+/// @param imag       Imaginary parts of the bins
+/// @param scale      Factor to scale the magnitudes by
+/// @param[out] power log10(|bin| * scale + 1) for each bin
+///
+/// This uses a fast approximation of log10 which is far more precise than the
+/// colour maps the values are drawn with.
+void SpectrumPower(size_t count, const float *real, const float *imag, float scale, float *power);
+
+/// @brief Get the spectrum's display values for interleaved complex output
+/// @param count      Number of bins
+/// @param complex    Real and imaginary part of each bin, as written by FFTW
+/// @param scale      Factor to scale the magnitudes by
+/// @param[out] power log10(|bin| * scale + 1) for each bin
+void SpectrumPower(size_t count, const double *complex, float scale, float *power);
+}
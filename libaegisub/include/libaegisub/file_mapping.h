@@ -14,12 +14,53 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#pragma once
+
+#include <libaegisub/dispatch.h>
 #include <libaegisub/fs_fwd.h>
 
 #include <boost/interprocess/detail/os_file_functions.hpp>
 #include <cstdint>
+#include <mutex>
 
 namespace agi {
+	/// How a mapping is going to be read, so that the OS can read ahead of
+	/// it appropriately
+	enum class access_pattern {
+		/// No particular pattern
+		normal,
+		/// Front to back, such as when playing audio or parsing a file
+		sequential,
+		/// Jumping around, so reading ahead would be wasted
+		random
+	};
+
+	/// A view of part of a file which is moved around as different parts of
+	/// the file are needed
+	struct mapping_view {
+		std::unique_ptr<boost::interprocess::mapped_region> region;
+		uint64_t start = 0;
+		/// How much to map at once when the whole file can't be mapped,
+		/// which grows while the file is read front to back
+		uint64_t window = 0;
+		access_pattern pattern = access_pattern::normal;
+	};
+
+	/// State of read_ahead() for a mapping
+	struct read_ahead_state {
+		/// Offset passed to the last call which read ahead
+		uint64_t position = 0;
+		/// End of what the OS has been asked to read
+		uint64_t end = 0;
+		/// How far ahead to read, which grows while the file is read front
+		/// to back
+		uint64_t window = 0;
+		/// Queue for touching pages in the background when the OS can't be
+		/// asked to read ahead, created when first needed
+		std::unique_ptr<dispatch::Queue> queue;
+		dispatch::CancelToken cancel;
+	};
+
 	// boost::interprocess::file_mapping is awesome and uses CreateFileA on Windows
 	class file_mapping {
 		boost::interprocess::file_handle_t handle;
@@ -32,11 +73,19 @@ namespace agi {
 		}
 	};
 
+	/// Do pointers returned by the mappings' read() and write() stay valid
+	/// until the mapping is destroyed? This is the case whenever the whole
+	/// file can be mapped at once, i.e. everywhere but 32-bit builds, where a
+	/// call which needs a different part of the file replaces the old view.
+	inline bool mapped_views_are_stable() { return sizeof(size_t) > 4; }
+
+	/// read() may be called from multiple threads at once
 	class read_file_mapping {
 		file_mapping file;
-		std::unique_ptr<boost::interprocess::mapped_region> region;
-		uint64_t mapping_start = 0;
+		mapping_view view;
+		read_ahead_state ahead;
 		uint64_t file_size = 0;
+		std::mutex mutex;
 
 	public:
 		read_file_mapping(fs::path const& filename);
@@ -45,22 +94,52 @@ namespace agi {
 		uint64_t size() const { return file_size; }
 		const char *read(int64_t offset, uint64_t length);
 		const char *read(); // Map the entire file
+
+		/// Tell the OS how the file is going to be read
+		void advise(access_pattern pattern);
+
+		/// @brief Start reading the file from the given offset in the background
+		///
+		/// This is meant to be called repeatedly with the current position
+		/// while reading through the file, such as during playback. The
+		/// further it gets without jumping around, the further ahead it
+		/// reads, so that slow disks and network shares can keep up without
+		/// reads stalling on page faults.
+		void read_ahead(int64_t offset);
 	};
 
+	/// read() and write() may be called from multiple threads at once
+	///
+	/// When the whole file can be mapped at once (i.e. when
+	/// mapped_views_are_stable()), it's mapped once up front and read() and
+	/// write() just return pointers into it without locking.
 	class temp_file_mapping {
 		file_mapping file;
 		uint64_t file_size = 0;
+		std::mutex mutex;
 
-		std::unique_ptr<boost::interprocess::mapped_region> read_region;
-		uint64_t read_mapping_start = 0;
-		std::unique_ptr<boost::interprocess::mapped_region> write_region;
-		uint64_t write_mapping_start = 0;
+		/// The whole file, if it's mapped at once
+		char *data = nullptr;
+		mapping_view read_view;
+		mapping_view write_view;
+		read_ahead_state ahead;
 
 	public:
-		temp_file_mapping(fs::path const& filename, uint64_t size);
+		/// @param filename File to back the mapping with
+		/// @param size Size to resize the file to
+		/// @param keep If true the file is left on disk after it is closed
+		///             rather than being deleted, so that it can be reused
+		temp_file_mapping(fs::path const& filename, uint64_t size, bool keep = false);
 		~temp_file_mapping();
 
 		const char *read(int64_t offset, uint64_t length);
 		char *write(int64_t offset, uint64_t length);
+
+		/// Tell the OS how the file is going to be read and written
+		void advise(access_pattern pattern);
+
+		/// Start reading the file from the given offset in the background,
+		/// as with read_file_mapping::read_ahead()
+		void read_ahead(int64_t offset);
 	};
 }
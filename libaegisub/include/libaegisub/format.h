@@ -18,6 +18,8 @@
 
 #include <boost/interprocess/streams/vectorstream.hpp>
 #include <boost/io/ios_state.hpp>
+#include <cstdint>
+#include <string>
 #include <type_traits>
 
 class wxString;
@@ -170,15 +172,220 @@ void format(formatter<Char>&& fmt, T&& first, Args&&... rest) {
 }
 } // namespace format_detail
 
+namespace format_detail {
+template<typename Char>
+class string_formatter;
+
+template<typename T>
+struct is_char : std::false_type { };
+template<> struct is_char<char> : std::true_type { };
+template<> struct is_char<signed char> : std::true_type { };
+template<> struct is_char<unsigned char> : std::true_type { };
+template<> struct is_char<wchar_t> : std::true_type { };
+template<> struct is_char<char16_t> : std::true_type { };
+template<> struct is_char<char32_t> : std::true_type { };
+}
+
+/// Writes values for %s (and unknown conversions) directly into the string
+/// being formatted. Types without a specialization go through writer and a
+/// temporary stream, so specializing writer is all that's needed for new
+/// types to be formattable; specialize this as well only for speed.
+template<typename Char, typename T, typename = void>
+struct string_writer {
+	static void write(format_detail::string_formatter<Char>& out, T const& value) {
+		out.write_stream(value);
+	}
+};
+
+template<typename Char>
+struct string_writer<Char, const Char *> {
+	static void write(format_detail::string_formatter<Char>& out, const Char *value) {
+		out.write_str(value, std::char_traits<Char>::length(value), false);
+	}
+};
+
+template<typename Char>
+struct string_writer<Char, std::basic_string<Char>> {
+	static void write(format_detail::string_formatter<Char>& out, std::basic_string<Char> const& value) {
+		out.write_str(value.data(), value.size(), false);
+	}
+};
+
+template<typename Char>
+struct string_writer<Char, Char *> {
+	// Not a const pointer so this went through operator<< and was padded
+	static void write(format_detail::string_formatter<Char>& out, const Char *value) {
+		out.write_str(value, std::char_traits<Char>::length(value), true);
+	}
+};
+
+template<typename Char>
+struct string_writer<Char, Char> {
+	static void write(format_detail::string_formatter<Char>& out, Char value) {
+		out.write_char(value);
+	}
+};
+
+template<typename Char>
+struct string_writer<Char, bool> {
+	static void write(format_detail::string_formatter<Char>& out, bool value) {
+		out.write_bool(value);
+	}
+};
+
+template<typename Char, typename T>
+struct string_writer<Char, T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !format_detail::is_char<T>::value>::type> {
+	static void write(format_detail::string_formatter<Char>& out, T value) {
+		if (std::is_signed<T>::value)
+			out.write_int(static_cast<intmax_t>(value));
+		else
+			out.write_unsigned(static_cast<uintmax_t>(value), 10);
+	}
+};
+
+template<typename Char, typename T>
+struct string_writer<Char, T, typename std::enable_if<std::is_same<T, float>::value || std::is_same<T, double>::value>::type> {
+	static void write(format_detail::string_formatter<Char>& out, T value) {
+		out.write_double(value, 'g');
+	}
+};
+
+namespace format_detail {
+/// A formatter which appends to a string rather than writing to a stream
+///
+/// This parses format strings the same way as formatter and produces the
+/// same output, but writes numbers and strings straight into the string
+/// without going through the locale and stream machinery.
+template<typename Char>
+class string_formatter {
+	string_formatter(const string_formatter&) = delete;
+	string_formatter& operator=(const string_formatter&) = delete;
+
+	std::basic_string<Char>& out;
+
+	const Char *fmt;
+	const Char *fmt_cur = nullptr;
+
+	bool read_width = false;
+	bool read_precision = false;
+	bool pending = false;
+
+	int width = 0;
+	int precision = -1;
+
+	bool left = false;  ///< '-': pad on the right
+	bool zero = false;  ///< '0': pad with zeros after the sign
+	bool plus = false;  ///< '+': show the sign of positive numbers
+	bool alt = false;   ///< '#': show the base or decimal point
+	bool upper = false; ///< Upper-case conversion specifier
+
+	bool parse_next();
+	Char next_format();
+
+	void write_integer(uintmax_t value, unsigned base, Char sign);
+
+	/// Pad what was written since start to the width, inserting zero padding
+	/// after the first prefix characters
+	void pad(size_t start, size_t prefix);
+
+	/// Set up a stream to match the current conversion specification
+	void apply(std::basic_ostream<Char>& stream) const;
+
+public:
+	string_formatter(std::basic_string<Char>& out, const Char *fmt)
+	: out(out), fmt(fmt) { }
+	~string_formatter();
+
+	void write_int(intmax_t value);
+	void write_unsigned(uintmax_t value, unsigned base);
+	void write_double(double value, Char conversion);
+	void write_pointer(const void *value);
+	void write_char(Char value);
+	void write_bool(bool value);
+	/// @param padded Was this written with operator<< (which pads to the
+	///               width) rather than ostream::write (which doesn't)
+	void write_str(const Char *value, size_t len, bool padded);
+
+	template<typename T>
+	void write_stream(T const& value) {
+		boost::interprocess::basic_vectorstream<std::basic_string<Char>> stream;
+		apply(stream);
+		writer<Char, T>::write(stream, precision, value);
+		out += stream.vector();
+	}
+
+	template<typename T>
+	void operator()(T&& value) {
+		if (!pending && !parse_next()) return;
+
+		if (read_width) {
+			width = runtime_cast<int>(value);
+			read_width = false;
+			return;
+		}
+
+		if (read_precision) {
+			precision = runtime_cast<int>(value);
+			read_precision = false;
+			return;
+		}
+
+		Char c = next_format();
+
+		switch (c) {
+		case 'c':
+			write_char(runtime_cast<Char>(value));
+			break;
+		case 'd': case 'i':
+			write_int(runtime_cast<intmax_t>(value));
+			break;
+		case 'o':
+			write_unsigned(static_cast<uintmax_t>(runtime_cast<intmax_t>(value)), 8);
+			break;
+		case 'x':
+			write_unsigned(static_cast<uintmax_t>(runtime_cast<intmax_t>(value)), 16);
+			break;
+		case 'u':
+			write_unsigned(runtime_cast<uintmax_t>(value), 10);
+			break;
+		case 'e': case 'f': case 'g':
+			write_double(runtime_cast<double>(value), c);
+			break;
+		case 'p':
+			write_pointer(runtime_cast<const void *>(value));
+			break;
+		default: // s and other
+			string_writer<Char, typename std::decay<T>::type>::write(*this, value);
+			break;
+		}
+	}
+};
+
+template<typename Char>
+inline void format(string_formatter<Char>&&) { }
+
+template<typename Char, typename T, typename... Args>
+void format(string_formatter<Char>&& fmt, T&& first, Args&&... rest) {
+	fmt(first);
+	format(std::move(fmt), std::forward<Args>(rest)...);
+}
+} // namespace format_detail
+
 template<typename Char, typename... Args>
 void format(std::basic_ostream<Char>& out, const Char *fmt, Args&&... args) {
 	format(format_detail::formatter<Char>(out, fmt), std::forward<Args>(args)...);
 }
 
+/// Append the formatted string to out, reusing its buffer
+template<typename Char, typename... Args>
+void format_to(std::basic_string<Char>& out, const Char *fmt, Args&&... args) {
+	format(format_detail::string_formatter<Char>(out, fmt), std::forward<Args>(args)...);
+}
+
 template<typename Char, typename... Args>
 std::basic_string<Char> format(const Char *fmt, Args&&... args) {
-	boost::interprocess::basic_vectorstream<std::basic_string<Char>> out;
-	format(out, fmt, std::forward<Args>(args)...);
-	return out.vector();
+	std::basic_string<Char> out;
+	format_to(out, fmt, std::forward<Args>(args)...);
+	return out;
 }
 }
@@ -19,18 +19,25 @@
 #include <boost/flyweight.hpp>
 
 namespace agi {
-template<>
-struct writer<char, boost::flyweight<std::string>> {
-	static void write(std::basic_ostream<char>& out, int max_len, boost::flyweight<std::string> const& value) {
+template<typename A1, typename A2, typename A3, typename A4, typename A5>
+struct writer<char, boost::flyweight<std::string, A1, A2, A3, A4, A5>> {
+	static void write(std::basic_ostream<char>& out, int max_len, boost::flyweight<std::string, A1, A2, A3, A4, A5> const& value) {
 		writer<char, std::string>::write(out, max_len, value.get());
 	}
 };
 
-template<>
-struct writer<wchar_t, boost::flyweight<std::string>> {
-	static void write(std::basic_ostream<wchar_t>& out, int max_len, boost::flyweight<std::string> const& value) {
+template<typename A1, typename A2, typename A3, typename A4, typename A5>
+struct writer<wchar_t, boost::flyweight<std::string, A1, A2, A3, A4, A5>> {
+	static void write(std::basic_ostream<wchar_t>& out, int max_len, boost::flyweight<std::string, A1, A2, A3, A4, A5> const& value) {
 		writer<wchar_t, std::string>::write(out, max_len, value.get());
 	}
 };
+
+template<typename A1, typename A2, typename A3, typename A4, typename A5>
+struct string_writer<char, boost::flyweight<std::string, A1, A2, A3, A4, A5>> {
+	static void write(format_detail::string_formatter<char>& out, boost::flyweight<std::string, A1, A2, A3, A4, A5> const& value) {
+		string_writer<char, std::string>::write(out, value.get());
+	}
+};
 }
 
@@ -131,6 +131,24 @@ namespace agi {
 		/// The destination path will be created if it does not exist.
 		void Copy(path const& from, path const& to);
 
+		/// Make a copy of a file which shares storage with the original
+		/// until either is modified (a reflink)
+		/// @param from Source path
+		/// @param to   Destination path, which must not already exist
+		/// @return false if the filesystem doesn't support this, in which case nothing is created
+		bool Clone(path const& from, path const& to);
+
+		/// Create a hard link to a file
+		/// @param from Existing file
+		/// @param to   Path of the new link, which must not already exist
+		/// @return false if the link could not be created, such as when the paths are on different volumes
+		bool HardLink(path const& from, path const& to);
+
+		/// Is a path on a network share?
+		/// @param p File or directory to check
+		/// @return false if it's on a local disk, or if this can't be determined
+		bool IsRemote(path const& p);
+
 		/// Delete a file
 		/// @param path Path to file to delete
 		/// @throws agi::FileNotAccessibleError if file exists but could not be deleted
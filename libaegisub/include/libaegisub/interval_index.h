@@ -0,0 +1,115 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file interval_index.h
+/// @brief Index for finding the intervals which contain a point
+/// @ingroup utility
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace agi {
+/// @class IntervalIndex
+/// @brief Index of half-open intervals [start, end), each with a value
+///
+/// The intervals are sorted by start, with a tree over them storing the
+/// latest end of each subtree, so finding the k intervals which contain a
+/// point takes O((k + 1) log n) rather than looking at every interval. The
+/// index is built all at once; adding or removing intervals requires
+/// building it again.
+template<typename T>
+class IntervalIndex {
+	struct Entry {
+		int start;
+		int end;
+		T value;
+	};
+
+	std::vector<Entry> entries;
+	/// Latest end in each node's range of entries. Node i has children
+	/// 2i + 1 and 2i + 2, and the root covers all of the entries.
+	std::vector<int> max_end;
+
+	int BuildNode(size_t node, size_t lo, size_t hi) {
+		if (hi - lo == 1)
+			return max_end[node] = entries[lo].end;
+		size_t mid = lo + (hi - lo) / 2;
+		return max_end[node] = std::max(BuildNode(2 * node + 1, lo, mid), BuildNode(2 * node + 2, mid, hi));
+	}
+
+	template<typename Func>
+	void Find(size_t node, size_t lo, size_t hi, size_t limit, int point, Func& f) const {
+		// Entries at or after limit start after the point and entries in
+		// subtrees which all end before the point can't contain it
+		if (lo >= limit || max_end[node] <= point) return;
+		if (hi - lo == 1) {
+			f(entries[lo].value);
+			return;
+		}
+		size_t mid = lo + (hi - lo) / 2;
+		Find(2 * node + 1, lo, mid, limit, point, f);
+		Find(2 * node + 2, mid, hi, limit, point, f);
+	}
+
+public:
+	/// Add an interval. Build() must be called before searching again.
+	void Add(int start, int end, T value) {
+		if (start < end)
+			entries.push_back(Entry{start, end, std::move(value)});
+	}
+
+	/// Remove all intervals
+	void Clear() {
+		entries.clear();
+		max_end.clear();
+	}
+
+	/// Build the index after adding intervals
+	void Build() {
+		std::stable_sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) {
+			return a.start < b.start;
+		});
+		max_end.assign(entries.empty() ? 0 : 4 * entries.size(), 0);
+		if (!entries.empty())
+			BuildNode(0, 0, entries.size());
+	}
+
+	/// Number of intervals in the index
+	size_t size() const { return entries.size(); }
+
+	/// @brief Call a function with the value of each interval which contains a point
+	///
+	/// Intervals are visited in order of start, and in the order they were
+	/// added for intervals with the same start.
+	template<typename Func>
+	void Find(int point, Func&& f) const {
+		if (entries.empty()) return;
+		auto limit = std::upper_bound(entries.begin(), entries.end(), point, [](int point, Entry const& e) {
+			return point < e.start;
+		}) - entries.begin();
+		Find(0, 0, entries.size(), static_cast<size_t>(limit), point, f);
+	}
+
+	/// Get the values of the intervals which contain a point
+	std::vector<T> Find(int point) const {
+		std::vector<T> ret;
+		Find(point, [&](T const& value) { ret.push_back(value); });
+		return ret;
+	}
+};
+}
@@ -19,6 +19,11 @@
 #include <libaegisub/cajun/elements.h>
 #include <libaegisub/fs_fwd.h>
 
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace agi { namespace json_util {
 
 /// Parse a JSON stream.
@@ -26,6 +31,22 @@ namespace agi { namespace json_util {
 /// @return json::UnknownElement
 json::UnknownElement parse(std::istream &stream);
 
+/// Is the buffer a JSON document flattened by tools/respack.lua rather than
+/// JSON text?
+bool is_flat(std::pair<const char *, size_t> data);
+
+/// Read the leaves of a flattened JSON document
+/// @param data Flattened document
+/// @param fn Called with the path of object keys leading to each leaf and
+///           the leaf's value, which it may move from. Only arrays,
+///           scalars and empty objects are leaves.
+void read_flat(std::pair<const char *, size_t> data, std::function<void (std::vector<std::string> const& path, json::UnknownElement& value)> const& fn);
+
+/// Parse an in-memory JSON document, which may be flattened
+/// @param data Document to parse
+/// @return json::UnknownElement
+json::UnknownElement parse(std::pair<const char *, size_t> data);
+
 /// Parse a json stream, with default handler.
 /// @param file Path to JSON file.
 /// @param Default config file to load incase of nonexistent file
@@ -95,75 +95,109 @@ namespace agi {
 				cur_line_width += widths[i];
 			}
 		}
-	}
-
-	/// Get the indices at which the blocks should be wrapped
-	/// @tparam WidthCont A random-access container of Widths
-	/// @tparam Width A numeric type which represents a width
-	/// @param widths The widths of the objects to fit within the space
-	/// @param max_width The available space for the objects
-	/// @param wrap_mode WrapMode to use to decide where to insert breaks
-	/// @return Indices into widths which breaks should be inserted before
-	template<class WidthCont, class Width>
-	std::vector<size_t> get_wrap_points(WidthCont const& widths, Width max_width, WrapMode wrap_mode) {
-		using namespace line_wrap_detail;
-
-		std::vector<size_t> ret;
-
-		if (wrap_mode == Wrap_None || widths.size() < 2)
-			return ret;
-
-		// Check if any wrapping is actually needed
-		Width total_width = std::accumulate(widths.begin(), widths.end(), 0);
-		if (total_width <= max_width)
-			return ret;
 
+		/// Buffers used by the balanced wrapping, which are kept between
+		/// lines when wrapping a batch of them
+		template<class Width>
+		struct wrap_scratch {
+			/// the cost of the optimal arrangement of words [0..i]
+			std::vector<Width> optimal_costs;
+			/// the optimal start word for a line ending at i
+			std::vector<size_t> line_starts;
+		};
+
+		template<class WidthCont, class Width>
+		void wrap_points(std::vector<size_t> &ret, WidthCont const& widths, Width max_width, WrapMode wrap_mode, wrap_scratch<Width> &scratch) {
+			if (wrap_mode == Wrap_None || widths.size() < 2)
+				return;
+
+			// Check if any wrapping is actually needed
+			Width total_width = std::accumulate(widths.begin(), widths.end(), 0);
+			if (total_width <= max_width)
+				return;
+
+
+			if (wrap_mode == Wrap_Greedy) {
+				break_greedy(ret, widths, max_width);
+				return;
+			}
 
-		if (wrap_mode == Wrap_Greedy) {
-			break_greedy(ret, widths, max_width);
-			return ret;
-		}
-
-		size_t num_words = distance(widths.begin(), widths.end());
+			size_t num_words = distance(widths.begin(), widths.end());
 
-		// the cost of the optimal arrangement of words [0..i]
-		std::vector<Width> optimal_costs(num_words, INT_MAX);
+			auto &optimal_costs = scratch.optimal_costs;
+			optimal_costs.assign(num_words, INT_MAX);
 
-		// the optimal start word for a line ending at i
-		std::vector<size_t> line_starts(num_words, INT_MAX);
+			auto &line_starts = scratch.line_starts;
+			line_starts.assign(num_words, INT_MAX);
 
-		// O(num_words * min(num_words, max_width))
-		for (size_t end_word = 0; end_word < num_words; ++end_word) {
-			Width current_line_width = 0;
-			for (int start_word = end_word; start_word >= 0; --start_word) {
-				current_line_width += widths[start_word];
+			// O(num_words * min(num_words, max_width))
+			for (size_t end_word = 0; end_word < num_words; ++end_word) {
+				Width current_line_width = 0;
+				for (int start_word = end_word; start_word >= 0; --start_word) {
+					current_line_width += widths[start_word];
 
-				// Only evaluate lines over the limit if they're one word
-				if (current_line_width > max_width && (size_t)start_word != end_word)
-					break;
+					// Only evaluate lines over the limit if they're one word
+					if (current_line_width > max_width && (size_t)start_word != end_word)
+						break;
 
-				Width cost = waste(current_line_width, max_width);
+					Width cost = waste(current_line_width, max_width);
 
-				if (start_word > 0)
-					cost += optimal_costs[start_word - 1];
+					if (start_word > 0)
+						cost += optimal_costs[start_word - 1];
 
-				if (cost < optimal_costs[end_word]) {
-					optimal_costs[end_word] = cost;
-					line_starts[end_word] = start_word;
+					if (cost < optimal_costs[end_word]) {
+						optimal_costs[end_word] = cost;
+						line_starts[end_word] = start_word;
+					}
 				}
 			}
-		}
 
-		// Select the optimal start word for each line ending with last_word
-		for (size_t last_word = num_words; last_word > 0 && line_starts[last_word - 1] > 0; last_word = line_starts[last_word]) {
-			--last_word;
-			ret.push_back(line_starts[last_word]);
+			// Select the optimal start word for each line ending with last_word
+			for (size_t last_word = num_words; last_word > 0 && line_starts[last_word - 1] > 0; last_word = line_starts[last_word]) {
+				--last_word;
+				ret.push_back(line_starts[last_word]);
+			}
+			std::reverse(ret.begin(), ret.end());
+
+			if (wrap_mode != Wrap_Balanced)
+				unbalance(ret, widths, max_width, wrap_mode);
 		}
-		std::reverse(ret.begin(), ret.end());
+	}
 
-		if (wrap_mode != Wrap_Balanced)
-			unbalance(ret, widths, max_width, wrap_mode);
+	/// Get the indices at which the blocks should be wrapped
+	/// @tparam WidthCont A random-access container of Widths
+	/// @tparam Width A numeric type which represents a width
+	/// @param widths The widths of the objects to fit within the space
+	/// @param max_width The available space for the objects
+	/// @param wrap_mode WrapMode to use to decide where to insert breaks
+	/// @return Indices into widths which breaks should be inserted before
+	template<class WidthCont, class Width>
+	std::vector<size_t> get_wrap_points(WidthCont const& widths, Width max_width, WrapMode wrap_mode) {
+		std::vector<size_t> ret;
+		line_wrap_detail::wrap_scratch<Width> scratch;
+		line_wrap_detail::wrap_points(ret, widths, max_width, wrap_mode, scratch);
+		return ret;
+	}
 
+	/// Get the indices at which each of a batch of lines which share an
+	/// available width should be wrapped, such as all of the lines in a style
+	/// @tparam LineCont A container of WidthConts
+	/// @tparam Width A numeric type which represents a width
+	/// @param lines The widths of the objects in each line
+	/// @param max_width The available space for the objects
+	/// @param wrap_mode WrapMode to use to decide where to insert breaks
+	/// @return For each line, the indices into its widths which breaks should
+	///         be inserted before
+	template<class LineCont, class Width>
+	std::vector<std::vector<size_t>> get_wrap_points_batch(LineCont const& lines, Width max_width, WrapMode wrap_mode) {
+		std::vector<std::vector<size_t>> ret;
+		ret.reserve(lines.size());
+
+		line_wrap_detail::wrap_scratch<Width> scratch;
+		for (auto const& widths : lines) {
+			ret.emplace_back();
+			line_wrap_detail::wrap_points(ret.back(), widths, max_width, wrap_mode, scratch);
+		}
 		return ret;
 	}
 }
@@ -15,13 +15,20 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <boost/interprocess/streams/bufferstream.hpp>
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 // These macros below aren't a perm solution, it will depend on how annoying they are through
 // actual usage, and also depends on msvc support.
-#define LOG_SINK(section, severity) agi::log::Message(section, severity, __FILE__, __FUNCTION__, __LINE__).stream()
+// The severity is checked before the message is created, so nothing after
+// the macro is evaluated for messages which won't be logged.
+#define LOG_SINK(section, severity) \
+	!agi::log::log->Enabled(severity) ? (void)0 : \
+	agi::log::Voidify() & agi::log::Message(section, severity, __FILE__, __FUNCTION__, __LINE__).stream()
 #define LOG_E(section) LOG_SINK(section, agi::log::Exception)
 #define LOG_A(section) LOG_SINK(section, agi::log::Assert)
 #define LOG_W(section) LOG_SINK(section, agi::log::Warning)
@@ -76,12 +83,41 @@ class LogSink {
 	/// List of pointers to emitters
 	std::vector<std::unique_ptr<Emitter>> emitters;
 
+	/// Least severe level of messages to log
+	std::atomic<int> level{Debug};
+
+	/// Messages waiting to be sent to the emitters, and the lock for them
+	/// and the fields after them
+	std::mutex pending_lock;
+	std::vector<SinkMessage> pending;
+	/// Number of messages thrown away since the last batch because too
+	/// many were waiting
+	size_t dropped = 0;
+	/// Is there a task on the queue which will send the pending messages?
+	bool drain_scheduled = false;
+
+	/// Batch being sent to the emitters, kept to reuse its memory
+	std::vector<SinkMessage> batch;
+
+	/// Send the pending messages to the emitters
+	void Drain();
+
 public:
+	/// Most messages which can be waiting for the emitters before new ones
+	/// are dropped
+	static const size_t max_pending = 4096;
+
 	LogSink();
 	~LogSink();
 
 	/// Insert a message into the sink.
-	void Log(SinkMessage const& sm);
+	void Log(SinkMessage sm);
+
+	/// Will messages of the given severity be logged?
+	bool Enabled(Severity severity) const { return severity <= level.load(std::memory_order_relaxed); }
+
+	/// Set the least severe level of messages to log
+	void SetLevel(Severity severity) { level = severity; }
 
 	/// @brief Subscribe an emitter
 	/// @param em Emitter to add
@@ -104,6 +140,9 @@ public:
 
 	/// Accept a single log entry
 	virtual void log(SinkMessage const& sm)=0;
+
+	/// Called after each batch of entries has been passed to log()
+	virtual void Flush() { }
 };
 
 /// A simple emitter which writes the log to a file in json format
@@ -116,6 +155,33 @@ public:
 	JsonEmitter(fs::path const& directory);
 
 	void log(SinkMessage const&) override;
+	void Flush() override;
+};
+
+/// An emitter which writes the log to a file in a compact binary format,
+/// for tracing at rates where formatting JSON for each message is too slow
+///
+/// The file starts with the eight bytes "agilog\0\1", followed by records
+/// which each start with a one byte tag. All integers are little-endian.
+///   'S': u32 id, u32 length, string. Defines a string used by later
+///        messages. Sections, files and functions are string literals, so
+///        each is only written once.
+///   'M': i64 time, u8 severity, u32 line, u32 section id, u32 file id,
+///        u32 function id, u32 length, message
+class BinaryEmitter final : public Emitter {
+	std::unique_ptr<std::ostream> fp;
+	std::unordered_map<const char *, uint32_t> ids;
+	std::string buffer;
+
+	uint32_t Id(const char *str);
+
+public:
+	/// Constructor
+	/// @param directory Directory to write the log file in
+	BinaryEmitter(fs::path const& directory);
+
+	void log(SinkMessage const&) override;
+	void Flush() override;
 };
 
 /// Generates a message and submits it to the log sink.
@@ -130,6 +196,12 @@ public:
 	std::ostream& stream() { return msg; }
 };
 
+/// Turns the stream expression in LOG_SINK into void so that it can be
+/// used in a conditional expression with (void)0
+struct Voidify {
+	void operator&(std::ostream&) { }
+};
+
 /// Emit log entries to stdout.
 class EmitSTDOUT: public Emitter {
 public:
@@ -23,6 +23,9 @@ struct lua_State;
 namespace agi { namespace lua {
 	/// Load a Lua or Moonscript file at the given path
 	bool LoadFile(lua_State *L, agi::fs::path const& filename);
+	/// Have any of the files loaded into the state with LoadFile been
+	/// modified since they were loaded?
+	bool FilesModified(lua_State *L);
 	/// Install our module loader and add include_path to the module search
 	/// path of the given lua state
 	bool Install(lua_State *L, std::vector<fs::path> const& include_path);
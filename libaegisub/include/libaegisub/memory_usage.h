@@ -0,0 +1,76 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file memory_usage.h
+/// @brief Accounting of the memory used by each part of the program
+/// @ingroup utility
+///
+/// The caches managed by CacheBudget are counted automatically. Anything
+/// else which can grow large, such as the undo history or Lua states,
+/// registers a function which estimates its size, so that a report of where
+/// the memory has gone can be put together on demand without the parts
+/// having to keep a shared total up to date.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace agi { namespace memory {
+/// Memory used by one part of the program
+struct Usage {
+	std::string name;
+	/// Size in bytes
+	size_t size;
+};
+
+/// @class Registration
+/// @brief Stops reporting a source's memory use when destroyed
+class Registration {
+	friend Registration Register(std::string name, std::function<size_t()> size);
+	uint64_t id = 0;
+	explicit Registration(uint64_t id) : id(id) { }
+public:
+	Registration() = default;
+	Registration(Registration&& other) : id(other.id) { other.id = 0; }
+	Registration& operator=(Registration&& other);
+	~Registration() { Unregister(); }
+
+	/// Stop reporting the source. Must be done before it is destroyed.
+	void Unregister();
+};
+
+/// @brief Report the memory used by something
+/// @param name Name to report the memory under. The sizes of everything
+///             registered under the same name are added together.
+/// @param size Get the current memory use in bytes
+/// @return Registration which must be kept alive as long as size can be called
+///
+/// size is called on whichever thread asks for the usage, so anything it
+/// reads which is changed on another thread has to be atomic or locked.
+/// The registration must not be destroyed while holding a lock which size
+/// takes.
+Registration Register(std::string name, std::function<size_t()> size);
+
+/// Get the memory used by everything registered and by the caches of the
+/// global CacheBudget, summed by name and sorted from largest to smallest
+std::vector<Usage> GetUsage();
+
+/// Write a memory usage report from GetUsage() to the log
+void LogUsage(std::vector<Usage> const& usage);
+} }
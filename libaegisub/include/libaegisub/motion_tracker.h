@@ -0,0 +1,109 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file motion_tracker.h
+/// @brief Tracking the motion of a region of video for typesetting
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace agi { namespace motion {
+/// A frame's luma and successively half-size copies of it
+class Pyramid {
+	struct Level {
+		std::vector<uint8_t> data;
+		int width;
+		int height;
+	};
+	std::vector<Level> levels;
+
+public:
+	/// @param data   Luma of the frame
+	/// @param width  Width of the frame in pixels
+	/// @param height Height of the frame in pixels
+	/// @param pitch  Bytes per row of data
+	/// @param count  Maximum number of levels, including the full size one
+	Pyramid(const uint8_t *data, int width, int height, ptrdiff_t pitch, size_t count = 3);
+
+	size_t size() const { return levels.size(); }
+	const uint8_t *Data(size_t level) const { return levels[level].data.data(); }
+	int Width(size_t level) const { return levels[level].width; }
+	int Height(size_t level) const { return levels[level].height; }
+};
+
+/// The motion of a region relative to where it was in the first frame
+struct Transform {
+	/// Where the center of the region has moved to
+	double x = 0;
+	double y = 0;
+	/// Clockwise rotation in screen coordinates, in degrees
+	double angle = 0;
+	/// Scale relative to the first frame
+	double scale = 1;
+
+	/// Get where a point which was offset by (px, py) from the center of the
+	/// region in the first frame now is
+	void Apply(double px, double py, double &out_x, double &out_y) const;
+};
+
+/// @class Tracker
+/// @brief Follows a rectangle of a video from frame to frame
+///
+/// The rectangle is split into four quarters, each of which is tracked
+/// independently by matching it against the next frame, first over a wide
+/// area at the smallest pyramid level and then refined at each larger one.
+/// The translation, rotation and uniform scale which best fits where the
+/// quarters went is the region's motion. Quarters which don't match anything
+/// well (such as ones which have been covered up) are left out of the fit
+/// until they're found again.
+class Tracker {
+	struct Point {
+		/// Offset of the point from the center of the region in the first frame
+		double ref_x, ref_y;
+		/// Where the point is in the current frame
+		double x, y;
+		/// How far the point moved in the last frame
+		double dx = 0, dy = 0;
+	};
+	std::vector<Point> points;
+	/// Half the size of the patch around each point which is matched
+	int radius;
+	Transform current;
+	Pyramid prev;
+
+	bool Match(Pyramid const& next, Point &point) const;
+	bool Fit(std::vector<bool> const& found);
+
+public:
+	/// @param first Frame the region is in
+	/// @param x1, y1, x2, y2 Corners of the region, in pixels of first's full size level
+	Tracker(Pyramid first, double x1, double y1, double x2, double y2);
+
+	/// @brief Find the region in the next frame
+	/// @return Was it found? If not, the transform is left unchanged
+	bool Track(Pyramid next);
+
+	/// Get the region's current motion
+	Transform const& Current() const { return current; }
+};
+
+/// Sum of the absolute differences between two blocks of bytes
+uint64_t BlockSumAbsDiff(const uint8_t *a, ptrdiff_t a_pitch, const uint8_t *b, ptrdiff_t b_pitch, int width, int height);
+} }
@@ -56,6 +56,12 @@ private:
 	/// @param ignore_errors Log invalid entires in the option file and continue rather than throwing an exception
 	void LoadConfig(std::istream& stream, bool ignore_errors = false);
 
+	/// Load an in-memory config, which may be flattened by tools/respack.lua
+	void LoadConfig(std::pair<const char *, size_t> config, bool ignore_errors = false);
+
+	/// Merge newly read values into the existing ones
+	void SetValues(std::vector<std::unique_ptr<OptionValue>> new_values, bool ignore_errors);
+
 public:
 	/// @brief Constructor
 	/// @param file User config that will be loaded from and written back to.
@@ -79,8 +85,10 @@ public:
 	/// @param[in] src Stream to load from.
 	/// Load next config which will supersede any values from previous configs
 	/// can be called as many times as required, but only after ConfigDefault() and
-	/// before ConfigUser()
+	/// before ConfigUser(). The values it loads replace the existing OptionValue
+	/// objects, so it must also be called before any are looked up.
 	void ConfigNext(std::istream &stream) { LoadConfig(stream); }
+	void ConfigNext(std::pair<const char *, size_t> config) { LoadConfig(config); }
 
 	/// @brief Set user config file.
 	/// Set the user configuration file and read options from it, closes all
@@ -88,6 +96,8 @@ public:
 	void ConfigUser();
 
 	/// Write the user configuration to disk, throws an exception if something goes wrong.
+	/// Only options which have been changed from their defaults are written,
+	/// so that loading the user config only has to apply the differences.
 	void Flush() const;
 };
 
@@ -47,6 +47,9 @@ enum class OptionType {
 class OptionValue {
 	agi::signal::Signal<OptionValue const&> ValueChanged;
 	std::string name;
+	/// Stored rather than virtual so that the typed getters are an inline
+	/// compare and load
+	const OptionType type;
 
 	std::string TypeToString(OptionType type) const;
 	InternalError TypeError(OptionType type) const;
@@ -68,13 +71,13 @@ class OptionValue {
 protected:
 	void NotifyChanged() { ValueChanged(*this); }
 
-	OptionValue(std::string name) BOOST_NOEXCEPT : name(std::move(name)) { }
+	OptionValue(std::string name, OptionType type) BOOST_NOEXCEPT : name(std::move(name)), type(type) { }
 
 public:
 	virtual ~OptionValue() = default;
 
 	std::string const& GetName() const { return name; }
-	virtual OptionType GetType() const = 0;
+	OptionType GetType() const { return type; }
 	virtual bool IsDefault() const = 0;
 	virtual void Reset() = 0;
 
@@ -114,11 +117,10 @@ public:
 	public:                                                                           \
 		typedef type value_type;                                                      \
 		OptionValue##type_name(std::string member_name, type member_value)            \
-		: OptionValue(std::move(member_name))                                         \
+		: OptionValue(std::move(member_name), OptionType::type_name)                  \
 		, value(member_value), value_default(member_value) { }                        \
 		type const& GetValue() const { return value; }                                \
 		void SetValue(type new_val) { value = std::move(new_val); NotifyChanged(); }  \
-		OptionType GetType() const { return OptionType::type_name; }                  \
 		void Reset() { value = value_default; NotifyChanged(); }                      \
 		bool IsDefault() const { return value == value_default; }                     \
 		void Set(const OptionValue *nv);                                              \
@@ -138,11 +140,10 @@ CONFIG_OPTIONVALUE(Bool, bool)
 	public:                                                                               \
 		typedef std::vector<type> value_type;                                             \
 		OptionValueList##type_name(std::string name, std::vector<type> const& value = std::vector<type>()) \
-		: OptionValue(std::move(name))                                                    \
+		: OptionValue(std::move(name), OptionType::List##type_name)                       \
 		, array(value), array_default(value) { }                                          \
 		std::vector<type> const& GetValue() const { return array; }                       \
 		void SetValue(std::vector<type> val) { array = std::move(val); NotifyChanged(); } \
-		OptionType GetType() const { return OptionType::List##type_name; }                \
 		void Reset() { array = array_default; NotifyChanged(); }                          \
 		bool IsDefault() const { return array == array_default; }                         \
 		void Set(const OptionValue *nv);                                                  \
@@ -0,0 +1,120 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file parallel.h
+/// @brief Data-parallel loops and task graphs on the dispatch thread pool
+/// @ingroup utility
+
+#pragma once
+
+#include <libaegisub/dispatch.h>
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+namespace agi {
+/// Number of threads parallel loops are split over, including the calling
+/// thread
+size_t parallel_concurrency();
+
+/// Run body over the slots of a loop in parallel
+///
+/// The range is split evenly between the calling thread and helpers queued
+/// on the background dispatch queue. Each thread works through its own part
+/// grain indices at a time, and when it runs out steals the back half of
+/// whichever part has the most left. The calling thread always takes part,
+/// so this is safe to call from a thunk on the thread pool, and helpers
+/// which only start once everything has been claimed do nothing.
+///
+/// If body throws, the rest of the range is skipped and the first
+/// exception is rethrown on the calling thread once all running helpers
+/// have finished.
+///
+/// @param begin First index
+/// @param end One past the last index
+/// @param grain Number of indices claimed at a time
+/// @param body Called with (slot, begin, end) for each claimed chunk. slot
+///             is the index of the thread running it, in
+///             [0, parallel_concurrency()), and no two threads run with the
+///             same slot at once.
+/// @param priority Priority of the helper thunks
+void parallel_for_slots(size_t begin, size_t end, size_t grain,
+	std::function<void (size_t slot, size_t begin, size_t end)> const& body,
+	dispatch::Priority priority = dispatch::Priority::Interactive);
+
+/// Run body(begin, end) over chunks of [begin, end) in parallel
+/// @see parallel_for_slots
+template<typename Body>
+void parallel_for(size_t begin, size_t end, size_t grain, Body const& body,
+	dispatch::Priority priority = dispatch::Priority::Interactive)
+{
+	parallel_for_slots(begin, end, grain, [&](size_t, size_t b, size_t e) { body(b, e); }, priority);
+}
+
+/// Map chunks of [begin, end) to values in parallel and combine them
+///
+/// Chunks are not combined in index order, so combine must be both
+/// associative and commutative.
+/// @param identity Value which combine leaves the other argument unchanged with
+/// @param map Called with (begin, end) for each chunk, returning a T
+/// @param combine Called with two Ts, returning a T
+template<typename T, typename Map, typename Combine>
+T parallel_reduce(size_t begin, size_t end, size_t grain, T identity, Map const& map, Combine const& combine,
+	dispatch::Priority priority = dispatch::Priority::Interactive)
+{
+	std::vector<T> partials(parallel_concurrency(), identity);
+	parallel_for_slots(begin, end, grain, [&](size_t slot, size_t b, size_t e) {
+		partials[slot] = combine(partials[slot], map(b, e));
+	}, priority);
+
+	T result = identity;
+	for (auto& partial : partials)
+		result = combine(result, partial);
+	return result;
+}
+
+/// @class TaskGraph
+/// @brief A set of tasks with dependencies between them
+///
+/// Tasks are added with the tasks they depend on, which must have been added
+/// first, and then Run() runs each task once everything it depends on has
+/// finished, running independent tasks in parallel.
+class TaskGraph {
+	std::vector<std::function<void()>> fns;
+	/// Number of tasks each task depends on
+	std::vector<size_t> dependency_counts;
+	/// Tasks which depend on each task
+	std::vector<std::vector<size_t>> dependents;
+
+public:
+	typedef size_t Task;
+
+	/// Add a task
+	/// @param fn Function to run
+	/// @param dependencies Tasks which must finish before this one starts
+	/// @return Handle to use as a dependency of later tasks
+	Task Add(std::function<void()> fn, std::initializer_list<Task> dependencies = {});
+	Task Add(std::function<void()> fn, std::vector<Task> const& dependencies);
+
+	/// Run all of the tasks, returning once they've all finished
+	///
+	/// If a task throws, tasks which haven't started are skipped and the
+	/// first exception is rethrown once the running ones have finished.
+	void Run(dispatch::Priority priority = dispatch::Priority::Interactive);
+};
+}
@@ -0,0 +1,52 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file scene_change.h
+/// @brief Scene change scoring for detecting keyframes from video
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace agi { namespace scene_change {
+/// Sum of the absolute differences between two buffers of bytes
+uint64_t SumAbsDiff(const uint8_t *a, const uint8_t *b, size_t size);
+
+/// @brief Score how different two frames are
+/// @param a    Luma of the first frame
+/// @param b    Luma of the second frame, the same size as the first
+/// @param size Number of pixels in each frame
+/// @return 0 for identical frames up to 1 for frames which share nothing
+///
+/// This averages the mean pixel difference, which is high for cuts but also
+/// for fast motion, and the difference of the luma histograms, which ignores
+/// motion but misses cuts between similarly lit shots.
+double Score(const uint8_t *a, const uint8_t *b, size_t size);
+
+/// @brief Pick the scene changes from the scores of a whole video
+/// @param scores       scores[i] is the Score of frames i - 1 and i; scores[0] is ignored
+/// @param min_interval Minimum number of frames between scene changes
+/// @param threshold    Minimum score of a scene change
+/// @return Sorted frame numbers of the scene changes, always including frame 0
+///
+/// A frame is only a scene change if its score is also well above the
+/// average of the frames before it, so that a shot which is all fast motion
+/// doesn't make every frame a scene change.
+std::vector<int> Choose(std::vector<double> const& scores, int min_interval, double threshold);
+} }
@@ -0,0 +1,34 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file simd.h
+/// @brief Which SIMD instruction set the build can use unconditionally
+/// @ingroup libaegisub
+///
+/// Defines AGI_SSE2 or AGI_NEON and includes the matching intrinsics header.
+/// SSE2 is part of the baseline for x86-64 and NEON for ARM64, so neither
+/// needs a runtime check. NEON is only used on little-endian ARM64, as the
+/// kernels assume that lanes are laid out in memory order.
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && !defined(__AARCH64EB__)
+#define AGI_NEON
+#include <arm_neon.h>
+#endif
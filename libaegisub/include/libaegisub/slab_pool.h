@@ -0,0 +1,79 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file slab_pool.h
+/// @brief Allocator for large numbers of small objects of one size
+/// @ingroup utility
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+
+namespace agi {
+/// @class SlabPool
+/// @brief Fixed-size blocks carved out of larger slabs
+///
+/// Objects which are created and destroyed in bulk (such as the lines of a
+/// subtitle file) are allocated from a pool, so that creating them is a
+/// pointer bump rather than a trip through the general purpose heap, and
+/// objects created together end up next to each other in memory. Each slab
+/// is returned to the heap as a whole as soon as everything in it has been
+/// freed, other than one empty slab which is kept to avoid freeing and
+/// reallocating a slab when a single object is repeatedly created and
+/// destroyed.
+///
+/// All members may be called from any thread.
+class SlabPool {
+	struct Slab;
+
+	std::mutex mutex;
+	/// Size of each block including its header
+	size_t block_size;
+	size_t blocks_per_slab;
+	/// Slabs with at least one free block
+	Slab *partial = nullptr;
+	/// Slabs with no free blocks
+	Slab *full = nullptr;
+	/// An empty slab kept for reuse
+	Slab *spare = nullptr;
+	size_t slab_count = 0;
+
+	Slab *NewSlab();
+	void Release(Slab *slab);
+
+public:
+	/// @param object_size Size of the objects to allocate
+	/// @param slab_size Approximate size in bytes of each slab
+	SlabPool(size_t object_size, size_t slab_size = 64 * 1024);
+	/// Frees every slab. Nothing allocated from the pool may be used after
+	/// it has been destroyed.
+	~SlabPool();
+
+	SlabPool(SlabPool const&) = delete;
+	SlabPool& operator=(SlabPool const&) = delete;
+
+	/// Allocate a block of at least object_size bytes, suitably aligned for
+	/// any type
+	void *Allocate();
+
+	/// Free a block allocated by any SlabPool. Does nothing if p is null.
+	static void Free(void *p);
+
+	/// Number of slabs with blocks in use
+	size_t SlabCount();
+};
+}
@@ -14,7 +14,7 @@
 
 #include "fs_fwd.h"
 
-#include <boost/container/flat_map.hpp>
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
 #include <string>
@@ -26,13 +26,37 @@ class read_file_mapping;
 namespace charset { class IconvWrapper; }
 
 class Thesaurus {
-	/// Map of word -> byte position in the data file
-	boost::container::flat_map<std::string, size_t> offsets;
 	/// Read handle to the data file
 	std::unique_ptr<read_file_mapping> dat;
 	/// Converter from the data file's charset to UTF-8
 	std::unique_ptr<charset::IconvWrapper> conv;
 
+	/// Mapping of the compiled index, if it was cached on disk
+	std::unique_ptr<read_file_mapping> index_file;
+	/// Compiled index, if it couldn't be cached on disk
+	std::vector<char> index_buffer;
+	/// Compiled index: a sorted table of words and their byte positions in
+	/// the data file, followed by the words themselves
+	const char *index = nullptr;
+	/// Size of the compiled index
+	uint64_t index_size = 0;
+	/// Number of words in the index
+	uint32_t word_count = 0;
+	/// Position of the first word's entry in the index
+	uint64_t entries_start = 0;
+
+	/// Map a cached compiled index if it's for the current version of the
+	/// index file
+	/// @return Was the index loaded?
+	bool LoadIndex(agi::fs::path const& idx_path, agi::fs::path const& cache_path);
+	/// Start using a compiled index
+	/// @return false if the index is truncated
+	bool UseIndex(const char *data, uint64_t size);
+	/// Compile a plain-text index file
+	static std::vector<char> CompileIndex(agi::fs::path const& idx_path);
+	/// Compare the ith word in the index to a word
+	int CompareWord(uint32_t i, std::string const& word) const;
+
 public:
 	/// A pair of a word and synonyms for that word
 	typedef std::pair<std::string, std::vector<std::string>> Entry;
@@ -41,6 +65,13 @@ public:
 	/// @param dat_path Path to data file
 	/// @param idx_path Path to index file
 	Thesaurus(agi::fs::path const& dat_path, agi::fs::path const& idx_path);
+
+	/// Constructor
+	/// @param dat_path Path to data file
+	/// @param idx_path Path to index file
+	/// @param cache_path Path to cache the compiled index at, so that later
+	///                   loads can map it rather than parsing the index file
+	Thesaurus(agi::fs::path const& dat_path, agi::fs::path const& idx_path, agi::fs::path const& cache_path);
 	~Thesaurus();
 
 	/// Look up synonyms for a word
@@ -0,0 +1,110 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file trace.h
+/// @brief Timers, counters and histograms for finding where time goes
+/// @ingroup utility
+///
+/// Probes record into a buffer owned by the thread they run on, so threads
+/// never wait on each other to record. While tracing is disabled, which is
+/// the default, each probe is a single relaxed load. Names must be string
+/// literals, as only the pointer is stored.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace agi { namespace trace {
+namespace detail {
+	extern std::atomic<bool> enabled;
+	int64_t Now();
+	void Span(const char *name, int64_t start, int64_t end);
+	void Count(const char *name, int64_t delta);
+	void Sample(const char *name, int64_t value);
+}
+
+/// Are probes currently recording?
+inline bool Enabled() { return detail::enabled.load(std::memory_order_relaxed); }
+
+/// Start or stop recording
+void Enable(bool enable);
+
+/// Throw away everything recorded so far
+void Clear();
+
+/// Records the time from its construction to its destruction as a span,
+/// and adds the duration in nanoseconds to the histogram of the same name
+class Scope {
+	const char *name;
+	int64_t start;
+
+public:
+	explicit Scope(const char *name) : name(name), start(Enabled() ? detail::Now() : -1) { }
+	~Scope() { if (start >= 0) detail::Span(name, start, detail::Now()); }
+
+	Scope(Scope const&) = delete;
+	Scope& operator=(Scope const&) = delete;
+};
+
+/// Add delta to a counter
+inline void Count(const char *name, int64_t delta = 1) {
+	if (Enabled()) detail::Count(name, delta);
+}
+
+/// Add a value to a histogram
+inline void Sample(const char *name, int64_t value) {
+	if (Enabled()) detail::Sample(name, value);
+}
+
+/// Everything recorded for one name, summed over all threads
+struct Metric {
+	std::string name;
+	/// Number of samples, or total of the deltas for counters
+	int64_t count = 0;
+	int64_t total = 0;
+	int64_t min = 0;
+	int64_t max = 0;
+	/// Number of samples whose value has each bit length, so bucket n
+	/// holds the values in [2^(n-1), 2^n)
+	std::array<uint64_t, 64> buckets{};
+
+	/// Approximate the value which the given fraction of samples are at or
+	/// below, from the buckets
+	int64_t Percentile(double fraction) const;
+};
+
+/// Get the metrics recorded so far, sorted by name
+std::vector<Metric> Metrics();
+
+/// Get the metric with the given name, or an empty one if nothing has been
+/// recorded for it
+Metric Get(const char *name);
+
+/// Write the spans and counters recorded so far in the Chrome trace event
+/// format, which can be opened in chrome://tracing
+void WriteChromeTrace(std::ostream& out);
+} }
+
+#define AGI_TRACE_CONCAT2(a, b) a##b
+#define AGI_TRACE_CONCAT(a, b) AGI_TRACE_CONCAT2(a, b)
+
+/// Time the rest of the enclosing block
+#define AGI_TRACE_SCOPE(name) agi::trace::Scope AGI_TRACE_CONCAT(agi_trace_scope_, __LINE__)(name)
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include <libaegisub/exception.h>
@@ -67,14 +68,17 @@ class Framerate {
 	/// rounding past the end of the final override range.
 	int64_t last = 0;
 
-	/// Start time in milliseconds of each frame
-	std::vector<int> timecodes;
+	/// Start time in milliseconds of each frame, stored as runs of frames
+	/// whose times repeat with a fixed period
+	struct Timecodes;
+	/// Never modified once built, so copies of the frame rate share it
+	std::shared_ptr<const Timecodes> timecodes;
 
 	/// Does this frame rate need drop frames and have them enabled?
 	bool drop = false;
 
-	/// Set FPS properties from the timecodes vector
-	void SetFromTimecodes();
+	/// Set the timecodes and the FPS properties from a list of frame times
+	void SetFromTimecodes(std::vector<int> times);
 public:
 	Framerate(Framerate const&) = default;
 	Framerate& operator=(Framerate const&) = default;
@@ -134,6 +138,20 @@ public:
 	/// results for all frame numbers
 	int TimeAtFrame(int frame, Time type = EXACT) const;
 
+	/// @brief Get the frames visible at several times
+	/// @param times Times in milliseconds
+	/// @param[out] frames Frame for each time
+	/// @param count Number of times
+	/// @param type Time mode
+	void FramesAtTimes(const int *times, int *frames, size_t count, Time type = EXACT) const;
+
+	/// @brief Get the times at several frames
+	/// @param frames Frame numbers
+	/// @param[out] times Time for each frame
+	/// @param count Number of frames
+	/// @param type Time mode
+	void TimesAtFrames(const int *frames, int *times, size_t count, Time type = EXACT) const;
+
 	/// @brief Get the components of the SMPTE timecode for the given time
 	/// @param[out] h Hours component
 	/// @param[out] m Minutes component
@@ -193,7 +211,7 @@ public:
 	void Save(fs::path const& file, int length = -1) const;
 
 	/// Is this frame rate possibly variable?
-	bool IsVFR() const {return timecodes.size() > 1; }
+	bool IsVFR() const;
 
 	/// Does this represent a valid frame rate?
 	bool IsLoaded() const { return numerator > 0; }
@@ -15,6 +15,7 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
 #include <libaegisub/color.h>
@@ -40,8 +41,14 @@ class ycbcr_converter {
 	std::array<double, 3> shift_from;
 	std::array<double, 3> shift_to;
 
+	/// rgb_to_rgb as a single affine transform in fixed point, for converting
+	/// many colors at once: three rows of three 4.12 coefficients, then the
+	/// three offsets, which include the rounding
+	std::array<int32_t, 12> rgb_fixed;
+
 	void init_dst(ycbcr_matrix dst_mat, ycbcr_range dst_range);
 	void init_src(ycbcr_matrix src_mat, ycbcr_range src_range);
+	void init_fixed();
 
 	template<typename T>
 	static std::array<double, 3> prod(std::array<double, 9> m, std::array<T, 3> v) {
@@ -87,10 +94,21 @@ public:
 			add(add(prod(to_ycbcr, input), shift_to), shift_from)));
 	}
 
+	/// Convert a color with rgb_to_rgb, keeping its alpha
+	///
+	/// This uses the same fixed point math as the batch versions so that a
+	/// color comes out the same whichever way it was converted.
 	Color rgb_to_rgb(Color c) const {
-		auto arr = rgb_to_rgb(std::array<uint8_t, 3>{{c.r, c.g, c.b}});
-		return Color{arr[0], arr[1], arr[2], c.a};
+		rgb_to_rgb(&c, 1);
+		return c;
 	}
+
+	/// Convert an array of colors in place with rgb_to_rgb
+	void rgb_to_rgb(Color *colors, size_t count) const;
+
+	/// Convert an array of BGRA pixels, as used by VideoFrame, in place with
+	/// rgb_to_rgb, leaving the fourth byte of each alone
+	void bgra_to_bgra(uint8_t *pixels, size_t count) const;
 };
 }
 
@@ -0,0 +1,64 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/karaoke_template.h>
+#include <libaegisub/lua/utils.h>
+
+namespace {
+using namespace agi::lua;
+using agi::ass::TemplatePart;
+
+/// Push the parts as an array of tables of the form {text = "..."},
+/// {var = "name", raw = "$Name"} or {expr = {parts...}}. Expressions which
+/// don't contain any variables also get their code as a string in the
+/// code field, so that they only need to be compiled once.
+void push_parts(lua_State *L, std::vector<TemplatePart> const& parts) {
+	lua_createtable(L, parts.size(), 0);
+	for (size_t i = 0; i < parts.size(); ++i) {
+		auto const& part = parts[i];
+		lua_createtable(L, 0, 2);
+		switch (part.type) {
+			case TemplatePart::TEXT:
+				set_field(L, "text", part.text);
+				break;
+			case TemplatePart::VARIABLE:
+				set_field(L, "var", part.name);
+				set_field(L, "raw", "$" + part.text);
+				break;
+			case TemplatePart::EXPRESSION:
+				push_parts(L, part.code);
+				lua_setfield(L, -2, "expr");
+				if (part.code.empty())
+					set_field(L, "code", "");
+				else if (part.code.size() == 1 && part.code[0].type == TemplatePart::TEXT)
+					set_field(L, "code", part.code[0].text);
+				break;
+		}
+		lua_rawseti(L, -2, i + 1);
+	}
+}
+
+int parse(lua_State *L) {
+	push_parts(L, agi::ass::ParseTemplate(check_string(L, 1)));
+	return 1;
+}
+}
+
+extern "C" int luaopen_karaoke_template_impl(lua_State *L) {
+	lua_createtable(L, 0, 1);
+	set_field<parse>(L, "parse");
+	return 1;
+}
@@ -21,14 +21,6 @@
 
 using boost::u32regex;
 namespace {
-// A cmatch with a match range attached to it so that we can return a pointer to
-// an int pair without an extra heap allocation each time (LuaJIT can't compile
-// ffi calls which return aggregates by value)
-struct agi_re_match {
-	boost::cmatch m;
-	int range[2];
-};
-
 struct agi_re_flag {
 	const char *name;
 	int value;
@@ -37,41 +29,47 @@ struct agi_re_flag {
 
 namespace agi {
 	AGI_DEFINE_TYPE_NAME(u32regex);
-	AGI_DEFINE_TYPE_NAME(agi_re_match);
 	AGI_DEFINE_TYPE_NAME(agi_re_flag);
 }
 
 namespace {
-using match = agi_re_match;
 bool search(u32regex& re, const char *str, size_t len, int start, boost::cmatch& result) {
 	return u32regex_search(str + start, str + len, result, re,
 		start > 0 ? boost::match_prev_avail | boost::match_not_bob : boost::match_default);
 }
 
-match *regex_match(u32regex& re, const char *str, size_t len, int start) {
-	auto result = agi::make_unique<match>();
-	if (!search(re, str, len, start, result->m))
-		return nullptr;
-	return result.release();
+// The match functions write one-based inclusive [first, last] byte ranges
+// into a buffer owned by the caller rather than returning anything which has
+// to be allocated and freed for each match
+
+size_t regex_group_count(u32regex& re) {
+	return re.mark_count() + 1;
 }
 
-int *regex_get_match(match& match, size_t idx) {
-	if (idx > match.m.size() || !match.m[idx].matched)
-		return nullptr;
-	match.range[0] = std::distance(match.m.prefix().first, match.m[idx].first + 1);
-	match.range[1] = std::distance(match.m.prefix().first, match.m[idx].second);
-	return match.range;
+/// Get the ranges of the full match and each capturing group up to the first
+/// one which didn't participate in the match
+/// @return Number of ranges written, or zero if there was no match
+int regex_match(u32regex& re, const char *str, size_t len, int start, int *ranges, size_t max) {
+	boost::cmatch result;
+	if (!search(re, str, len, start, result))
+		return 0;
+
+	size_t count = 0;
+	for (; count < result.size() && count < max && result[count].matched; ++count) {
+		ranges[count * 2] = result[count].first - str + 1;
+		ranges[count * 2 + 1] = result[count].second - str;
+	}
+	return count;
 }
 
-int *regex_search(u32regex& re, const char *str, size_t len, size_t start) {
+bool regex_search(u32regex& re, const char *str, size_t len, size_t start, int *range) {
 	boost::cmatch result;
 	if (!search(re, str, len, start, result))
-		return nullptr;
+		return false;
 
-	auto ret = static_cast<int *>(malloc(sizeof(int) * 2));
-	ret[0] = start + result.position() + 1;
-	ret[1] = start + result.position() + result.length();
-	return ret;
+	range[0] = start + result.position() + 1;
+	range[1] = start + result.position() + result.length();
+	return true;
 }
 
 char *regex_replace(u32regex& re, const char *replacement, const char *str, size_t len, int max_count) {
@@ -108,7 +106,6 @@ u32regex *regex_compile(const char *pattern, int flags, char **err) {
 }
 
 void regex_free(u32regex *re) { delete re; }
-void match_free(match *m) { delete m; }
 
 const agi_re_flag *get_regex_flags() {
 	static const agi_re_flag flags[] = {
@@ -128,14 +125,13 @@ const agi_re_flag *get_regex_flags() {
 }
 
 extern "C" int luaopen_re_impl(lua_State *L) {
-	agi::lua::register_lib_table(L, {"agi_re_match", "u32regex"},
+	agi::lua::register_lib_table(L, {"u32regex"},
 		"search", regex_search,
 		"match", regex_match,
-		"get_match", regex_get_match,
+		"group_count", regex_group_count,
 		"replace", regex_replace,
 		"compile", regex_compile,
 		"get_flags", get_regex_flags,
-		"match_free", match_free,
 		"regex_free", regex_free);
 	return 1;
 }
@@ -23,6 +23,66 @@
 
 #include <boost/algorithm/string/replace.hpp>
 #include <lauxlib.h>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+	/// Lua code compiled from some MoonScript
+	struct CompiledMoonscript {
+		std::string code;
+		/// Pairs of Lua line numbers and the character offsets in the
+		/// MoonScript they came from
+		std::vector<std::pair<int, int>> line_table;
+	};
+
+	/// Compiled MoonScript keyed by the MoonScript source, shared by all of
+	/// the Lua states so that modules used by lots of scripts, and scripts
+	/// which are reloaded without being changed, are only compiled once
+	std::unordered_map<std::string, CompiledMoonscript> moonscript_cache;
+	std::mutex moonscript_cache_mutex;
+
+	/// Compile the MoonScript on the top of the stack, replacing it with the
+	/// error message on failure
+	bool compile_moonscript(lua_State *L, CompiledMoonscript &out) {
+		// The compiler is only loaded the first time something actually
+		// needs compiling, as loading it is rather slow
+		lua_getfield(L, LUA_REGISTRYINDEX, "moonscript");
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			if (luaL_loadstring(L, "return require('moonscript').to_lua") || lua_pcall(L, 0, 1, 0)) {
+				lua_remove(L, -2);
+				return false;
+			}
+			lua_pushvalue(L, -1);
+			lua_setfield(L, LUA_REGISTRYINDEX, "moonscript");
+		}
+
+		lua_insert(L, -2);
+		if (lua_pcall(L, 1, 2, 0))
+			return false; // Leaves error message on stack
+
+		// to_lua returns nil, error on error or the code and line table on success
+		if (lua_isnil(L, -2)) {
+			lua_remove(L, -2);
+			return false;
+		}
+
+		size_t len;
+		const char *code = lua_tolstring(L, -2, &len);
+		out.code.assign(code, len);
+
+		if (lua_istable(L, -1)) {
+			lua_pushnil(L);
+			while (lua_next(L, -2)) {
+				if (lua_isnumber(L, -2) && lua_isnumber(L, -1))
+					out.line_table.emplace_back(lua_tointeger(L, -2), lua_tointeger(L, -1));
+				lua_pop(L, 1);
+			}
+		}
+		lua_pop(L, 2);
+		return true;
+	}
+}
 
 namespace agi { namespace lua {
 	bool LoadFile(lua_State *L, agi::fs::path const& raw_filename) {
@@ -36,6 +96,20 @@ namespace agi { namespace lua {
 
 		agi::read_file_mapping file(filename);
 		auto buff = file.read();
+
+		// Record when each file the state loaded was last modified so that
+		// it can tell if it's out of date
+		lua_getfield(L, LUA_REGISTRYINDEX, "loaded files");
+		if (!lua_istable(L, -1)) {
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_pushvalue(L, -1);
+			lua_setfield(L, LUA_REGISTRYINDEX, "loaded files");
+		}
+		push_value(L, filename);
+		lua_pushnumber(L, static_cast<lua_Number>(agi::fs::ModifiedTime(filename)));
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
 		size_t size = static_cast<size_t>(file.size());
 
 		// Discard the BOM if present
@@ -47,29 +121,61 @@ namespace agi { namespace lua {
 		if (!agi::fs::HasExtension(filename, "moon"))
 			return luaL_loadbuffer(L, buff, size, filename.string().c_str()) == 0;
 
-		// We have a MoonScript file, so we need to load it with that
-		// It might be nice to have a dedicated lua state for compiling
-		// MoonScript to Lua
-		lua_getfield(L, LUA_REGISTRYINDEX, "moonscript");
+		// We have a MoonScript file, so we need to compile it to Lua first,
+		// unless the same source has already been compiled
+		std::string source(buff, size);
+		CompiledMoonscript compiled;
+		bool cached = false;
+		{
+			std::lock_guard<std::mutex> lock(moonscript_cache_mutex);
+			auto it = moonscript_cache.find(source);
+			if (it != moonscript_cache.end()) {
+				compiled = it->second;
+				cached = true;
+			}
+		}
 
-		// Save the text we'll be loading for the line number rewriting in the
-		// error handling
+		if (!cached) {
+			lua_pushlstring(L, buff, size);
+			if (!compile_moonscript(L, compiled))
+				return false; // Leaves error message on stack
+
+			std::lock_guard<std::mutex> lock(moonscript_cache_mutex);
+			moonscript_cache.emplace(source, compiled);
+		}
+
+		// Save the text we loaded and the line table for the line number
+		// rewriting in the error handling
 		lua_pushlstring(L, buff, size);
-		lua_pushvalue(L, -1);
 		lua_setfield(L, LUA_REGISTRYINDEX, ("raw moonscript: " + filename.string()).c_str());
 
-		push_value(L, filename);
-		if (lua_pcall(L, 2, 2, 0))
-			return false; // Leaves error message on stack
-
-		// loadstring returns nil, error on error or a function on success
-		if (lua_isnil(L, 1)) {
-			lua_remove(L, 1);
-			return false;
+		lua_createtable(L, 0, compiled.line_table.size());
+		for (auto const& line : compiled.line_table) {
+			lua_pushinteger(L, line.second);
+			lua_rawseti(L, -2, line.first);
 		}
+		lua_setfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + filename.string()).c_str());
 
-		lua_pop(L, 1); // Remove the extra nil for the stackchecker
-		return true;
+		return luaL_loadbuffer(L, compiled.code.data(), compiled.code.size(), filename.string().c_str()) == 0;
+	}
+
+	bool FilesModified(lua_State *L) {
+		bool modified = false;
+		lua_getfield(L, LUA_REGISTRYINDEX, "loaded files");
+		if (lua_istable(L, -1)) {
+			lua_pushnil(L);
+			while (!modified && lua_next(L, -2)) {
+				try {
+					modified = agi::fs::ModifiedTime(get_string(L, -2)) != static_cast<time_t>(lua_tonumber(L, -1));
+				}
+				catch (agi::fs::FileSystemError const&) {
+					modified = true;
+				}
+				lua_pop(L, modified ? 2 : 1);
+			}
+		}
+		lua_pop(L, 1);
+		return modified;
 	}
 
 	static int module_loader(lua_State *L) {
@@ -146,12 +252,7 @@ namespace agi { namespace lua {
 		lua_rawseti(L, -2, 2);
 		lua_pop(L, 2); // loaders, package
 
-		luaL_loadstring(L, "return require('moonscript').loadstring");
-		if (lua_pcall(L, 0, 1, 0)) {
-			return false; // leave error message
-		}
-		lua_setfield(L, LUA_REGISTRYINDEX, "moonscript");
-
+		// The MoonScript compiler is loaded the first time it's needed
 		return true;
 	}
 } }
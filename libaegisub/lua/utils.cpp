@@ -89,13 +89,21 @@ void *check_udata(lua_State *L, int idx, const char *mt) {
 }
 
 static int moon_line(lua_State *L, int lua_line, std::string const& file) {
-	if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
-		lua_pop(L, 1); // pop error message
-		return lua_line;
-	}
+	// Line tables of files loaded by LoadFile are stored in the registry,
+	// but anything compiled by calling moonscript directly only has one in
+	// moonscript's own table
+	lua_pushnil(L);
+	lua_getfield(L, LUA_REGISTRYINDEX, ("moonscript line table: " + file).c_str());
+	if (!lua_istable(L, -1)) {
+		lua_pop(L, 2);
+		if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
+			lua_pop(L, 1); // pop error message
+			return lua_line;
+		}
 
-	push_value(L, file);
-	lua_rawget(L, -2);
+		push_value(L, file);
+		lua_rawget(L, -2);
+	}
 
 	if (!lua_istable(L, -1)) {
 		lua_pop(L, 2);
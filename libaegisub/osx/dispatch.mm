@@ -16,19 +16,55 @@
 
 #include "libaegisub/dispatch.h"
 
+#include <chrono>
+#include <condition_variable>
 #include <dispatch/dispatch.h>
 #include <mutex>
 
+struct agi::dispatch::Queue::Counters {
+    std::atomic<size_t> depth{0};
+    std::atomic<uint64_t> started{0};
+    std::atomic<uint64_t> cancelled{0};
+    std::atomic<uint64_t> total_latency_us{0};
+    std::atomic<uint64_t> max_latency_us{0};
+};
+
 namespace {
 using namespace agi::dispatch;
 std::function<void (Thunk)> invoke_main;
 
+uint64_t now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/// Wrap a thunk to update the queue's counters and skip it if cancelled
+Thunk counted(std::shared_ptr<Queue::Counters> counters, Thunk thunk, std::shared_ptr<std::atomic<bool>> cancelled) {
+    const uint64_t queued = now_us();
+    ++counters->depth;
+    return [=] {
+        --counters->depth;
+        if (cancelled && *cancelled) {
+            ++counters->cancelled;
+            return;
+        }
+
+        const uint64_t latency = now_us() - queued;
+        ++counters->started;
+        counters->total_latency_us += latency;
+        uint64_t max = counters->max_latency_us;
+        while (latency > max && !counters->max_latency_us.compare_exchange_weak(max, latency)) ;
+
+        thunk();
+    };
+}
+
 struct OSXQueue : Queue {
     virtual void DoSync(Thunk thunk)=0;
 };
 
 struct MainQueue final : OSXQueue {
-    void DoInvoke(Thunk thunk) override { invoke_main(thunk); }
+    void DoInvoke(Thunk thunk, Priority) override { invoke_main(thunk); }
 
     void DoSync(Thunk thunk) override {
         std::mutex m;
@@ -52,36 +88,55 @@ struct MainQueue final : OSXQueue {
     }
 };
 
+void async(dispatch_queue_t queue, Thunk thunk) {
+    dispatch_async(queue, ^{
+        try {
+            thunk();
+        }
+        catch (...) {
+            auto e = std::current_exception();
+            invoke_main([=] { std::rethrow_exception(e); });
+        }
+    });
+}
+
+void sync(dispatch_queue_t queue, Thunk thunk) {
+    std::exception_ptr e;
+    std::exception_ptr *e_ptr = &e;
+    dispatch_sync(queue, ^{
+        try {
+            thunk();
+        }
+        catch (...) {
+            *e_ptr = std::current_exception();
+        }
+    });
+    if (e) std::rethrow_exception(e);
+}
+
+/// Serial queue. GCD serial queues are strictly FIFO, so priorities are
+/// ignored.
 struct GCDQueue final : OSXQueue {
     dispatch_queue_t queue;
     GCDQueue(dispatch_queue_t queue) : queue(queue) { }
     ~GCDQueue() { dispatch_release(queue); }
 
-    void DoInvoke(Thunk thunk) override {
-        dispatch_async(queue, ^{
-            try {
-                thunk();
-            }
-            catch (...) {
-                auto e = std::current_exception();
-                invoke_main([=] { std::rethrow_exception(e); });
-            }
-        });
-    }
+    void DoInvoke(Thunk thunk, Priority) override { async(queue, std::move(thunk)); }
+    void DoSync(Thunk thunk) override { sync(queue, std::move(thunk)); }
+};
 
-    void DoSync(Thunk thunk) override {
-        std::exception_ptr e;
-        std::exception_ptr *e_ptr = &e;
-        dispatch_sync(queue, ^{
-            try {
-                thunk();
-            }
-            catch (...) {
-                *e_ptr = std::current_exception();
-            }
-        });
-        if (e) std::rethrow_exception(e);
+/// Parallel queue, using the global queue matching each priority
+struct GlobalQueue final : OSXQueue {
+    static dispatch_queue_t Get(Priority priority) {
+        switch (priority) {
+            case Priority::Interactive: return dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0);
+            case Priority::Prefetch:    return dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+            default:                    return dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+        }
     }
+
+    void DoInvoke(Thunk thunk, Priority priority) override { async(Get(priority), std::move(thunk)); }
+    void DoSync(Thunk thunk) override { sync(Get(Priority::Interactive), std::move(thunk)); }
 };
 }
 
@@ -90,8 +145,30 @@ void Init(std::function<void (Thunk)> invoke_main) {
     ::invoke_main = std::move(invoke_main);
 }
 
-void Queue::Async(Thunk thunk) { DoInvoke(std::move(thunk)); }
-void Queue::Sync(Thunk thunk) { static_cast<OSXQueue *>(this)->DoSync(std::move(thunk)); }
+CancelToken::CancelToken() : cancelled(std::make_shared<std::atomic<bool>>(false)) { }
+
+Queue::Queue() : counters(std::make_shared<Counters>()) { }
+
+void Queue::Invoke(Thunk thunk, Priority priority, std::shared_ptr<std::atomic<bool>> cancelled) {
+    DoInvoke(counted(counters, std::move(thunk), std::move(cancelled)), priority);
+}
+
+void Queue::Async(Thunk thunk, Priority priority) { Invoke(std::move(thunk), priority, nullptr); }
+void Queue::Async(Thunk thunk, Priority priority, CancelToken const& token) { Invoke(std::move(thunk), priority, token.cancelled); }
+
+void Queue::Sync(Thunk thunk, Priority) {
+    static_cast<OSXQueue *>(this)->DoSync(counted(counters, std::move(thunk), nullptr));
+}
+
+QueueStats Queue::Stats() const {
+    QueueStats stats;
+    stats.depth = counters->depth;
+    stats.started = counters->started;
+    stats.cancelled = counters->cancelled;
+    stats.mean_latency_us = stats.started ? counters->total_latency_us / stats.started : 0;
+    stats.max_latency_us = counters->max_latency_us;
+    return stats;
+}
 
 Queue& Main() {
     static MainQueue q;
@@ -99,7 +176,7 @@ Queue& Main() {
 }
 
 Queue& Background() {
-    static GCDQueue q(dispatch_get_global_queue(0, DISPATCH_QUEUE_PRIORITY_DEFAULT));
+    static GlobalQueue q;
     return q;
 }
 
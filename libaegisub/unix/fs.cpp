@@ -24,6 +24,16 @@
 #include <fnmatch.h>
 #include <istream>
 #include <sys/time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <sys/clonefile.h>
+#include <sys/mount.h>
+#elif defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/vfs.h>
+#endif
 
 namespace bfs = boost::filesystem;
 
@@ -51,6 +61,54 @@ void Copy(fs::path const& from, fs::path const& to) {
 	io::Save(to).Get() << in->rdbuf();
 }
 
+bool Clone(fs::path const& from, fs::path const& to) {
+#if defined(__APPLE__)
+	return !clonefile(from.c_str(), to.c_str(), 0);
+#elif defined(FICLONE)
+	int src = open(from.c_str(), O_RDONLY);
+	if (src < 0) return false;
+	int dst = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+	if (dst < 0) {
+		close(src);
+		return false;
+	}
+
+	bool ok = !ioctl(dst, FICLONE, src);
+	close(src);
+	close(dst);
+	if (!ok)
+		unlink(to.c_str());
+	return ok;
+#else
+	return false;
+#endif
+}
+
+bool IsRemote(path const& p) {
+#if defined(__APPLE__)
+	struct statfs info;
+	return !statfs(p.c_str(), &info) && !(info.f_flags & MNT_LOCAL);
+#elif defined(__linux__)
+	struct statfs info;
+	if (statfs(p.c_str(), &info)) return false;
+	switch (static_cast<unsigned long>(info.f_type)) {
+		case 0x6969:     // NFS
+		case 0x517B:     // SMB
+		case 0xFF534D42: // CIFS
+		case 0xFE534D42: // SMB2
+		case 0x01021997: // 9P
+		case 0x564C:     // NCP
+		case 0x5346414F: // AFS
+		case 0x73757245: // Coda
+			return true;
+		default:
+			return false;
+	}
+#else
+	return false;
+#endif
+}
+
 struct DirectoryIterator::PrivData {
 	boost::system::error_code ec;
 	bfs::directory_iterator it;
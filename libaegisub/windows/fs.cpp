@@ -25,6 +25,7 @@
 using agi::charset::ConvertW;
 using agi::charset::ConvertLocal;
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
 namespace bfs = boost::filesystem;
 
@@ -76,6 +77,19 @@ void Copy(fs::path const& from, fs::path const& to) {
 	}
 }
 
+bool Clone(fs::path const&, fs::path const&) {
+	// Block cloning is only supported by ReFS, which fonts are rarely on
+	return false;
+}
+
+bool IsRemote(path const& p) {
+	auto root = p.root_path().wstring();
+	// UNC paths are always remote, and mapped drives report themselves as such
+	if (boost::starts_with(root, L"\\\\") || boost::starts_with(root, L"//"))
+		return true;
+	return !root.empty() && GetDriveType(root.c_str()) == DRIVE_REMOTE;
+}
+
 struct DirectoryIterator::PrivData {
 	scoped_holder<HANDLE, BOOL (__stdcall *)(HANDLE)> h{INVALID_HANDLE_VALUE, FindClose};
 };
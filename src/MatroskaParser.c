@@ -197,6 +197,7 @@ struct MatroskaFile {
   uint64_t	    readPosition;
   unsigned int	    trackMask;
   uint64_t	    pSegmentTop;  // offset of next byte after the segment
+  uint64_t	    pReadStop;    // if non-zero, offset to stop reading blocks at
   uint64_t	    tcCluster;    // current cluster timecode
 
   // Cues
@@ -1556,7 +1557,7 @@ static void parseCues(MatroskaFile *mf,uint64_t toplen) {
   jmp_buf     jb;
   uint64_t   v;
   struct Cue  cc;
-  unsigned    i,j,k;
+  unsigned    i,j,k,first;
 
   mf->seen.Cues = 1;
   mf->nCues = 0;
@@ -1573,6 +1574,7 @@ static void parseCues(MatroskaFile *mf,uint64_t toplen) {
 
   FOREACH(mf,toplen)
     case 0xbb: // CuePoint
+      first = mf->nCues;
       FOREACH(mf,len)
 	case 0xb3: // CueTime
 	  cc.Time = readUInt(mf,(unsigned)len);
@@ -1611,13 +1613,21 @@ static void parseCues(MatroskaFile *mf,uint64_t toplen) {
 	      ENDFOR(mf);
 	      break;
 	  ENDFOR(mf);
+
+	  if (mf->nCues == 0 && mf->pCluster - mf->pSegment != cc.Position) {
+	    addCue(mf,mf->pCluster - mf->pSegment,mf->firstTimecode);
+	    first = mf->nCues;
+	  }
+
+	  // keep an entry for every track position rather than just the last
+	  // one, so that the positions of each track's cues are all known
+	  memcpy(AGET(mf,Cues),&cc,sizeof(cc));
 	  break;
       ENDFOR(mf);
 
-      if (mf->nCues == 0 && mf->pCluster - mf->pSegment != cc.Position)
-	addCue(mf,mf->pCluster - mf->pSegment,mf->firstTimecode);
-
-      memcpy(AGET(mf,Cues),&cc,sizeof(cc));
+      // CueTime isn't required to come before the track positions
+      for (i = first; i < mf->nCues; ++i)
+	mf->Cues[i].Time = cc.Time;
       break;
   ENDFOR(mf);
 
@@ -2336,8 +2346,9 @@ static int  readMoreBlocks(MatroskaFile *mf) {
   int			cid, ret = 0;
   jmp_buf		jb;
   volatile unsigned	retries = 0;
+  uint64_t		top = mf->pReadStop ? mf->pReadStop : mf->pSegmentTop;
 
-  if (mf->readPosition >= mf->pSegmentTop)
+  if (mf->readPosition >= top)
     return EOF;
 
   memcpy(&jb,&mf->jb,sizeof(jb));
@@ -2353,12 +2364,12 @@ static int  readMoreBlocks(MatroskaFile *mf) {
       goto ex;
 
     for (;;) {
-      if (filepos(mf) >= mf->pSegmentTop)
+      if (filepos(mf) >= top)
 	goto ex;
 
       cp = mf->cache->scan(mf->cache,filepos(mf),0x1f43b675); // cluster
 
-      if (cp < 0 || (uint64_t)cp >= mf->pSegmentTop)
+      if (cp < 0 || (uint64_t)cp >= top)
 	goto ex;
 
       seek(mf,cp);
@@ -2387,7 +2398,7 @@ static int  readMoreBlocks(MatroskaFile *mf) {
 
   seek(mf,mf->readPosition);
 
-  while (filepos(mf) < mf->pSegmentTop) {
+  while (filepos(mf) < top) {
     cid = readID(mf);
     if (cid == EOF) {
       ret = EOF;
@@ -2893,6 +2904,43 @@ uint64_t     mkv_GetSegmentTop(MatroskaFile *mf) {
   return mf->pSegmentTop;
 }
 
+unsigned     mkv_GetTrackCuePositions(MatroskaFile *mf,unsigned track,uint64_t *positions,unsigned max) {
+  unsigned  i, n = 0;
+
+  if (track >= mf->nTracks)
+    return 0;
+
+  for (i = 0; i < mf->nCues; ++i)
+    if (mf->Cues[i].Track == mf->Tracks[track]->Number) {
+      if (positions && n < max)
+	positions[n] = mf->Cues[i].Position + mf->pSegment;
+      ++n;
+    }
+
+  return positions && n > max ? max : n;
+}
+
+int	      mkv_ReadCluster(MatroskaFile *mf,uint64_t pos) {
+  uint64_t  len;
+
+  if (setjmp(mf->jb)!=0)
+    return -1;
+
+  EmptyQueues(mf);
+  mf->flags &= ~MPF_ERROR;
+
+  seek(mf,pos);
+  if (readID(mf) != 0x1f43b675) // Cluster
+    return -1;
+  len = readSize(mf);
+
+  mf->readPosition = pos;
+  // clusters of unknown size run to the end of the segment
+  mf->pReadStop = len < mf->pSegmentTop - filepos(mf) ? filepos(mf) + len : mf->pSegmentTop;
+
+  return 0;
+}
+
 #define	IS_DELTA(f) (!((f)->flags & FRAME_KF) || ((f)->flags & FRAME_UNKNOWN_START))
 
 void  mkv_Seek(MatroskaFile *mf,uint64_t timecode,unsigned flags) {
@@ -2904,6 +2952,8 @@ void  mkv_Seek(MatroskaFile *mf,uint64_t timecode,unsigned flags) {
   if (mf->flags & MKVF_AVOID_SEEKS)
     return;
 
+  mf->pReadStop = 0;
+
   if (timecode == 0) {
     EmptyQueues(mf);
     mf->readPosition = mf->pCluster;
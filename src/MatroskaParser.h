@@ -301,6 +301,23 @@ X void	      mkv_GetTags(/* in */  MatroskaFile *mf,
 
 X uint64_t   mkv_GetSegmentTop(MatroskaFile *mf);
 
+/* Get the file positions of the clusters which the cues point to for a track,
+ * in the order of the cues. Returns the number of positions, and writes up
+ * to max of them to positions if it's not NULL.
+ */
+X unsigned   mkv_GetTrackCuePositions(/* in */  MatroskaFile *mf,
+				    /* in */  unsigned track,
+				    /* out */ uint64_t *positions,
+				    /* in */  unsigned max);
+
+/* Discard all queued frames and read only the cluster at the given file
+ * position, so that mkv_ReadFrame returns the frames in that cluster and
+ * then EOF. Returns 0 on success, or -1 if there's no cluster there.
+ * mkv_Seek goes back to reading the whole file.
+ */
+X int	      mkv_ReadCluster(/* in */ MatroskaFile *mf,
+			      /* in */ uint64_t pos);
+
 /* Seek to specified timecode,
  * if timecode is past end of file,
  * all tracks are set to return EOF
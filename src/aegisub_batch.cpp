@@ -0,0 +1,408 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file aegisub_batch.cpp
+/// @brief Command-line batch processor of subtitle files
+/// @ingroup main
+///
+/// Runs automation macros and export filters over any number of subtitle
+/// files and writes the results, without creating any windows. Files are
+/// processed in parallel, and each file gets its own project context and
+/// its own copy of every script, so no Lua state is shared between files.
+
+#include "ass_dialogue.h"
+#include "ass_exporter.h"
+#include "ass_file.h"
+#include "auto4_base.h"
+#include "auto4_lua_factory.h"
+#include "command/command.h"
+#include "compat.h"
+#include "export_fixstyle.h"
+#include "export_framerate.h"
+#include "include/aegisub/context.h"
+#include "options.h"
+#include "selection_controller.h"
+#include "subtitle_format.h"
+
+#include <libaegisub/background_runner.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/exception.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/path.h>
+#include <libaegisub/util.h>
+#include <libaegisub/vfr.h>
+
+#include "libresrc/libresrc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <boost/locale/generator.hpp>
+#include <wx/init.h>
+
+namespace config {
+	agi::Options *opt = nullptr;
+	agi::MRUManager *mru = nullptr;
+	agi::Path *path = nullptr;
+	Automation4::AutoloadScriptManager *global_scripts = nullptr;
+}
+
+namespace {
+/// Functions queued for the main thread with agi::dispatch::Main()
+struct {
+	std::mutex mutex;
+	std::deque<agi::dispatch::Thunk> thunks;
+} main_queue;
+
+/// Held while writing to stdout, so that files' lines don't get mixed up
+std::mutex output_mutex;
+
+/// Held while creating or destroying a context, as they subscribe to and
+/// unsubscribe from options, which isn't safe to do on several threads at once
+std::mutex context_mutex;
+
+/// Progress of the work on a single file, written to stdout with each line
+/// prefixed by the file's name
+class ConsoleProgress final : public agi::BackgroundRunner, agi::ProgressSink {
+	std::string prefix;
+	/// Log output after the last newline
+	std::string partial_line;
+	/// Last multiple of 10% written
+	int last_percent = -1;
+
+	void Write(std::string const& line) {
+		std::lock_guard<std::mutex> lock(output_mutex);
+		std::cout << prefix << line << "\n";
+	}
+
+	void SetIndeterminate() override { }
+	void SetTitle(std::string const& title) override { Write(title); last_percent = -1; }
+	void SetMessage(std::string const& msg) override { Write(msg); }
+	void SetProgress(int64_t cur, int64_t max) override {
+		if (max <= 0) return;
+		int percent = static_cast<int>(cur * 10 / max) * 10;
+		if (percent == last_percent) return;
+		last_percent = percent;
+		Write(std::to_string(percent) + "%");
+	}
+	void Log(std::string const& str) override {
+		partial_line += str;
+		size_t start = 0, end;
+		while ((end = partial_line.find('\n', start)) != std::string::npos) {
+			Write(partial_line.substr(start, end - start));
+			start = end + 1;
+		}
+		partial_line.erase(0, start);
+	}
+	bool IsCancelled() override { return false; }
+
+public:
+	ConsoleProgress(std::string const& name) : prefix(name + ": ") { }
+	~ConsoleProgress() {
+		if (!partial_line.empty()) Write(partial_line);
+	}
+
+	void Run(std::function<void(agi::ProgressSink *)> task) override { task(this); }
+
+	/// Write a line which isn't from a task
+	void Print(std::string const& line) { Write(line); }
+};
+
+struct Settings {
+	std::vector<agi::fs::path> inputs;
+	std::vector<agi::fs::path> scripts;
+	/// Display names of the macros to run, in order
+	std::vector<std::string> macros;
+	/// Names of the export filters to run when writing, in order
+	std::vector<std::string> filters;
+	agi::fs::path output;
+	/// Extension of the output files, or empty to use the input's
+	std::string format;
+	std::string encoding = "UTF-8";
+	std::string output_encoding = "UTF-8";
+	agi::vfr::Framerate fps;
+	int jobs = 0;
+};
+
+void usage() {
+	std::cerr <<
+		"usage: aegisub-batch [options] --output <dir> <subtitles>...\n"
+		"  --output <dir>             Directory to write the processed files to\n"
+		"  --script <file>            Load an automation script for each file\n"
+		"  --macro <name>             Run a macro from the loaded scripts, by the name\n"
+		"                             shown in the Automation menu, on all lines\n"
+		"  --filter <name>            Run an export filter, built in or from the loaded\n"
+		"                             scripts, when writing each file\n"
+		"  --format <ext>             Extension of the format to write, such as srt\n"
+		"                             (default the input's)\n"
+		"  --fps <rate>               Frame rate for frame-based formats\n"
+		"  --encoding <name>          Character set of the input files (default UTF-8)\n"
+		"  --output-encoding <name>   Character set of the output files (default UTF-8)\n"
+		"  --jobs <n>                 Number of files to process at once (default one\n"
+		"                             per core)\n"
+		"--script, --macro and --filter may be given more than once, and the macros\n"
+		"and filters are run in the order given.\n";
+}
+
+bool parse_args(int argc, char **argv, Settings &settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg.size() < 2 || arg[0] != '-' || arg[1] != '-') {
+			settings.inputs.push_back(arg);
+			continue;
+		}
+		if (i + 1 == argc) return false;
+		const char *value = argv[++i];
+		if (arg == "--output") settings.output = value;
+		else if (arg == "--script") settings.scripts.push_back(value);
+		else if (arg == "--macro") settings.macros.push_back(value);
+		else if (arg == "--filter") settings.filters.push_back(value);
+		else if (arg == "--format") settings.format = value;
+		else if (arg == "--encoding") settings.encoding = value;
+		else if (arg == "--output-encoding") settings.output_encoding = value;
+		else if (arg == "--jobs") settings.jobs = atoi(value);
+		else if (arg == "--fps") {
+			double fps;
+			if (!agi::util::try_parse(value, &fps) || fps <= 0) return false;
+			settings.fps = fps;
+		}
+		else return false;
+	}
+	return !settings.inputs.empty() && !settings.output.empty();
+}
+
+/// A project context which is created and destroyed under context_mutex
+struct LockedContext {
+	std::unique_ptr<agi::Context> c;
+
+	LockedContext() {
+		std::lock_guard<std::mutex> lock(context_mutex);
+		c = agi::make_unique<agi::Context>();
+	}
+
+	~LockedContext() {
+		std::lock_guard<std::mutex> lock(context_mutex);
+		c.reset();
+	}
+};
+
+void process_file(Settings const& settings, agi::fs::path const& input, ConsoleProgress &progress) {
+	// Scripts loaded from here on keep their macros and filters to
+	// themselves and report to the console
+	Automation4::HeadlessScope headless(&progress);
+
+	LockedContext context;
+	agi::Context *c = context.c.get();
+
+	{
+		AssFile subs;
+		SubtitleFormat::GetReader(input, settings.encoding)->ReadFile(&subs, input, settings.fps, settings.encoding);
+		c->ass->swap(subs);
+	}
+	c->path->SetToken("?script", input.parent_path());
+	c->ass->Commit("", AssFile::COMMIT_NEW);
+
+	// Macros which work on the selected lines work on the whole file
+	if (!c->ass->Events.empty()) {
+		Selection sel;
+		for (auto& line : c->ass->Events)
+			sel.insert(&line);
+		c->selectionController->SetSelectionAndActive(std::move(sel), &c->ass->Events.front());
+	}
+
+	// Destroyed before the context so that nothing a script holds outlives it
+	std::vector<std::unique_ptr<Automation4::Script>> scripts;
+	for (auto const& path : settings.scripts) {
+		auto script = Automation4::ScriptFactory::CreateFromFile(path, false, false);
+		if (!script)
+			throw Automation4::ScriptLoadError(path.string() + " is not an automation script");
+		if (!script->GetLoadedState())
+			throw Automation4::ScriptLoadError(script->GetDescription());
+		scripts.push_back(std::move(script));
+	}
+
+	for (auto const& name : settings.macros) {
+		cmd::Command *macro = nullptr;
+		for (auto const& script : scripts) {
+			for (auto command : script->GetMacros()) {
+				if (from_wx(command->StrDisplay(c)) == name)
+					macro = command;
+			}
+		}
+		if (!macro)
+			throw Automation4::MacroRunError("No loaded script has a macro named " + name);
+		if (!macro->Validate(c))
+			throw Automation4::MacroRunError("The macro " + name + " can't be run on this file");
+		(*macro)(c);
+	}
+
+	// The built-in filters keep settings from the last run, so each file
+	// gets its own rather than using the registered ones
+	std::vector<std::unique_ptr<AssExportFilter>> builtin_filters;
+	builtin_filters.push_back(agi::make_unique<AssFixStylesFilter>());
+	builtin_filters.push_back(agi::make_unique<AssTransformFramerateFilter>());
+
+	AssExporter exporter(c);
+	for (auto const& name : settings.filters) {
+		AssExportFilter *filter = nullptr;
+		for (auto const& builtin : builtin_filters) {
+			if (builtin->GetName() == name)
+				filter = builtin.get();
+		}
+		for (auto const& script : scripts) {
+			for (auto script_filter : script->GetFilters()) {
+				if (script_filter->GetName() == name)
+					filter = script_filter;
+			}
+		}
+		if (!filter)
+			throw agi::InvalidInputException("No export filter named " + name);
+		exporter.AddFilter(filter);
+	}
+
+	auto output = settings.output / input.filename();
+	if (!settings.format.empty())
+		output.replace_extension(settings.format);
+
+	AssFile subs(*c->ass);
+	exporter.ApplyFilters(subs);
+	SubtitleFormat::GetWriter(output)->ExportFile(&subs, output, settings.fps, settings.output_encoding);
+	progress.Print("Wrote " + output.string());
+}
+
+/// Run all of the files through process_file on a pool of threads
+/// @return Number of files which failed
+int process_files(Settings const& settings) {
+	size_t count = settings.jobs > 0 ? settings.jobs : std::max(1u, std::thread::hardware_concurrency());
+	count = std::min(count, settings.inputs.size());
+
+	std::atomic<size_t> next_file{0};
+	std::atomic<int> failed{0};
+	std::mutex mutex;
+	std::condition_variable cv;
+	size_t running = count;
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < count; ++i) {
+		threads.emplace_back([&] {
+			for (size_t file = next_file++; file < settings.inputs.size(); file = next_file++) {
+				auto const& input = settings.inputs[file];
+				ConsoleProgress progress(input.filename().string());
+				try {
+					process_file(settings, input, progress);
+				}
+				catch (agi::UserCancelException const&) {
+					// The script's error has already been written
+					progress.Print("Failed: the macro or filter was cancelled");
+					++failed;
+				}
+				catch (agi::Exception const& e) {
+					progress.Print("Failed: " + e.GetMessage());
+					++failed;
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			--running;
+			cv.notify_all();
+		});
+	}
+
+	// Run anything queued for the main thread until all of the files are done
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (cv.wait_for(lock, std::chrono::milliseconds(50), [&] { return running == 0; }))
+				break;
+		}
+
+		std::deque<agi::dispatch::Thunk> thunks;
+		{
+			std::lock_guard<std::mutex> lock(main_queue.mutex);
+			thunks.swap(main_queue.thunks);
+		}
+		for (auto &thunk : thunks) thunk();
+	}
+
+	for (auto &thread : threads)
+		thread.join();
+	return failed;
+}
+}
+
+int main(int argc, char **argv) {
+	Settings settings;
+	if (!parse_args(argc, argv, settings)) {
+		usage();
+		return 1;
+	}
+
+	// Only wxBase is initialized, so there is no GUI and no need for a display
+	wxInitializer wx_init;
+	if (!wx_init.IsOk()) {
+		std::cerr << "Failed to initialize wxWidgets\n";
+		return 1;
+	}
+
+	agi::dispatch::Init([](agi::dispatch::Thunk f) {
+		std::lock_guard<std::mutex> lock(main_queue.mutex);
+		main_queue.thunks.push_back(std::move(f));
+	});
+	std::locale::global(boost::locale::generator().generate(""));
+	agi::log::log = new agi::log::LogSink;
+
+	config::path = new agi::Path;
+	// Use the user's settings for things like automation's include paths,
+	// but never write them back
+	config::opt = new agi::Options(config::path->Decode("?user/config.json"), GET_DEFAULT_CONFIG(default_config), agi::Options::FLUSH_SKIP);
+	config::opt->ConfigUser();
+	// Nothing here is ever undone or recovered, so don't keep journals or
+	// autosaves of the files
+	OPT_SET("App/Auto/Journal")->SetBool(false);
+	OPT_SET("App/Auto/Save")->SetBool(false);
+	OPT_SET("App/Auto/Save on Every Change")->SetBool(false);
+
+	Automation4::ScriptFactory::Register(agi::make_unique<Automation4::LuaScriptFactory>());
+	// The formats are registered on first use, which isn't thread-safe
+	SubtitleFormat::LoadFormats();
+
+	int ret = 0;
+	try {
+		if (!agi::fs::DirectoryExists(settings.output))
+			agi::fs::CreateDirectory(settings.output);
+
+		int failed = process_files(settings);
+		std::cout << settings.inputs.size() - failed << " of " << settings.inputs.size() << " files processed\n";
+		ret = failed ? 1 : 0;
+	}
+	catch (agi::Exception const& e) {
+		std::cerr << e.GetMessage() << "\n";
+		ret = 1;
+	}
+
+	delete config::opt;
+	delete config::path;
+	delete agi::log::log;
+	return ret;
+}
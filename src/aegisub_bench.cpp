@@ -0,0 +1,957 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file aegisub_bench.cpp
+/// @brief Benchmark of whole operations on generated subtitle files
+/// @ingroup main
+///
+/// Writes synthetic scripts of the requested sizes, then times loading,
+/// committing, undoing, sorting, searching, resampling and saving them
+/// through the same code the program uses, and reports how long each
+/// operation took and how much memory the process used while doing it.
+/// The scripts are generated from a fixed seed, so runs on different
+/// machines or builds measure the same work.
+///
+/// With --audio, it instead writes WAV files in several formats and times
+/// opening, decoding and reading them through each type of audio cache, and
+/// rendering them with the waveform and spectrum renderers.
+///
+/// With --video, it renders a script of heavy typesetting onto a dummy video
+/// and optionally a video file through AsyncVideoProvider, and reports the
+/// decoding and rendering frame rates, blending time, cache hit rates and
+/// the cost of loading the subtitles after each commit. Like the subtitle
+/// benchmark, this doesn't need a display.
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "async_video_provider.h"
+#include "audio_provider_factory.h"
+#include "audio_renderer.h"
+#include "audio_renderer_spectrum.h"
+#include "audio_renderer_waveform.h"
+#include "include/aegisub/context.h"
+#include "options.h"
+#include "resolution_resampler.h"
+#include "search_replace_engine.h"
+#include "subs_controller.h"
+#include "subtitle_format.h"
+#include "video_provider_dummy.h"
+
+#include <libaegisub/ass/time.h>
+#include <libaegisub/audio/provider.h>
+#include <libaegisub/ass/uuencode.h>
+#include <libaegisub/background_runner.h>
+#include <libaegisub/color.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/exception.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/path.h>
+#include <libaegisub/trace.h>
+#include <libaegisub/util.h>
+#include <libaegisub/vfr.h>
+
+#include "libresrc/libresrc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/locale/generator.hpp>
+#include <wx/app.h>
+#include <wx/bitmap.h>
+#include <wx/init.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace config {
+	agi::Options *opt = nullptr;
+	agi::MRUManager *mru = nullptr;
+	agi::Path *path = nullptr;
+	Automation4::AutoloadScriptManager *global_scripts = nullptr;
+}
+
+namespace {
+/// Functions queued for the main thread with agi::dispatch::Main()
+struct {
+	std::mutex mutex;
+	std::deque<agi::dispatch::Thunk> thunks;
+} main_queue;
+
+void run_main_thunks() {
+	std::deque<agi::dispatch::Thunk> thunks;
+	{
+		std::lock_guard<std::mutex> lock(main_queue.mutex);
+		thunks.swap(main_queue.thunks);
+	}
+	for (auto& thunk : thunks) thunk();
+}
+
+/// Reset the peak memory use of the process, where the OS allows it. Where
+/// it doesn't, the peaks reported are the highest so far in the run.
+void reset_peak_memory() {
+#ifdef __linux__
+	std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+/// Peak resident memory use of the process in bytes
+uint64_t peak_memory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#elif defined(__linux__)
+	// Unlike getrusage(), VmHWM is reset by reset_peak_memory()
+	std::ifstream status("/proc/self/status");
+	for (std::string line; std::getline(status, line); ) {
+		if (boost::starts_with(line, "VmHWM:"))
+			return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+	}
+	return 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+/// Writes scripts which look like a typical fansub release: mostly dialogue
+/// with a little inline formatting, some karaoke, typesetting with lots of
+/// tags, a few drawings and comments, a couple dozen styles and some
+/// attached fonts
+class CorpusGenerator {
+	// std::mt19937's output is fully specified by the standard, unlike the
+	// distributions, so only the raw output is used. The order of evaluation
+	// of the operands of + and << isn't specified, so each random value is
+	// appended in a statement of its own.
+	std::mt19937 rng;
+
+	int Range(int min, int max) { return min + static_cast<int>(rng() % (max - min + 1)); }
+	bool Chance(int percent) { return Range(0, 99) < percent; }
+	std::string Number(int min, int max) { return std::to_string(Range(min, max)); }
+
+	const char *Pick(std::initializer_list<const char *> list) { return *(list.begin() + rng() % list.size()); }
+
+	std::string Words(int min, int max) {
+		static const std::initializer_list<const char *> words = {
+			"the", "a", "I", "you", "we", "they", "it", "that", "this", "what",
+			"is", "was", "can't", "won't", "should", "never", "always", "again",
+			"know", "think", "going", "come", "back", "here", "there", "now",
+			"today", "tomorrow", "sorry", "really", "believe", "remember",
+			"something", "nothing", "everyone", "together", "promise", "school",
+			"sister", "teacher", "festival", "summer", "train", "station"
+		};
+		std::string ret;
+		for (int i = 0, count = Range(min, max); i < count; ++i) {
+			if (i) ret += ' ';
+			ret += Pick(words);
+		}
+		return ret;
+	}
+
+	std::string Color() {
+		char buf[16];
+		snprintf(buf, sizeof buf, "&H%06X&", static_cast<unsigned>(rng() & 0xFFFFFF));
+		return buf;
+	}
+
+	std::string DialogueText() {
+		std::string text = Words(3, 12);
+		if (Chance(15)) {
+			auto space = text.find(' ');
+			if (space != std::string::npos)
+				text = "{\\i1}" + text.substr(0, space) + "{\\i0}" + text.substr(space);
+		}
+		if (Chance(20)) {
+			text += "\\N";
+			text += Words(2, 8);
+		}
+		text += Pick({".", "?", "!", "...", ","});
+		return text;
+	}
+
+	std::string KaraokeText() {
+		std::string text;
+		for (int i = 0, count = Range(6, 20); i < count; ++i) {
+			text += "{\\k";
+			text += Number(8, 60);
+			text += "}";
+			text += Pick({"ka", "na", "shi", "te", "mo", "ri", "yo", "u", "n", "no", "ko", "ro"});
+			if (Chance(30)) text += " ";
+		}
+		return text;
+	}
+
+	std::string TypesetText() {
+		std::string tags = "{\\an";
+		tags += Number(1, 9);
+		tags += "\\pos(";
+		tags += Number(0, 1280);
+		tags += ",";
+		tags += Number(0, 720);
+		tags += ")";
+		if (Chance(60)) {
+			tags += "\\fad(";
+			tags += Number(0, 300);
+			tags += ",";
+			tags += Number(0, 300);
+			tags += ")";
+		}
+		if (Chance(70)) {
+			int blur = Range(0, 30);
+			tags += "\\blur" + std::to_string(blur / 10) + "." + std::to_string(blur % 10);
+		}
+		if (Chance(50)) {
+			tags += "\\fs";
+			tags += Number(20, 90);
+		}
+		if (Chance(50)) {
+			tags += "\\c";
+			tags += Color();
+			tags += "\\3c";
+			tags += Color();
+		}
+		if (Chance(30)) {
+			tags += "\\frz";
+			tags += Number(-30, 30);
+		}
+		if (Chance(25)) {
+			tags += "\\t(0,";
+			tags += Number(100, 2000);
+			tags += ",\\fscx";
+			tags += Number(80, 130);
+			tags += "\\fscy";
+			tags += Number(80, 130);
+			tags += ")";
+		}
+		if (Chance(20)) {
+			int x = Range(0, 1000);
+			int y = Range(0, 500);
+			int width = Range(50, 280);
+			int height = Range(50, 220);
+			tags += "\\clip(" + std::to_string(x) + "," + std::to_string(y) + "," + std::to_string(x + width) + "," + std::to_string(y + height) + ")";
+		}
+		tags += "}";
+		tags += Words(1, 5);
+		return tags;
+	}
+
+	std::string DrawingText() {
+		std::string text = "{\\an7\\pos(";
+		text += Number(0, 1200);
+		text += ",";
+		text += Number(0, 650);
+		text += ")\\bord0\\shad0\\c";
+		text += Color();
+		text += "\\p1}m 0 0";
+		// Segments of three points, as b needs three and l takes any number
+		for (int i = 0, count = Range(1, 10) * 3; i < count; ++i) {
+			if (i % 3 == 0)
+				text += Chance(50) ? " l" : " b";
+			text += " ";
+			text += Number(0, 400);
+			text += " ";
+			text += Number(0, 300);
+		}
+		text += "{\\p0}";
+		return text;
+	}
+
+	static std::string Time(int ms) { return agi::Time(ms).GetAssFormatted(); }
+
+	static void WriteLine(std::ostream& out, bool comment, int layer, int start, int end, const char *style, const char *actor, std::string const& text) {
+		out << (comment ? "Comment: " : "Dialogue: ") << layer << ","
+			<< Time(start) << "," << Time(end) << "," << style << "," << actor << ",0,0,0,,"
+			<< text << "\r\n";
+	}
+
+	/// Write everything before the lines of the events section
+	void WriteHeader(std::ostream& out, std::string const& title) {
+		out << "[Script Info]\r\n"
+			"; Generated by aegisub-bench\r\n"
+			"Title: " << title << "\r\n"
+			"ScriptType: v4.00+\r\n"
+			"WrapStyle: 0\r\n"
+			"ScaledBorderAndShadow: yes\r\n"
+			"YCbCr Matrix: TV.709\r\n"
+			"PlayResX: 1280\r\n"
+			"PlayResY: 720\r\n\r\n";
+
+		out << "[V4+ Styles]\r\n"
+			"Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\r\n"
+			"Style: Default,Arial,52,&H00FFFFFF,&H000000FF,&H00202020,&H80000000,0,0,0,0,100,100,0,0,1,2.6,1,2,60,60,36,1\r\n"
+			"Style: Default - Top,Arial,52,&H00FFFFFF,&H000000FF,&H00202020,&H80000000,0,0,0,0,100,100,0,0,1,2.6,1,8,60,60,36,1\r\n"
+			"Style: Flashback,Arial,52,&H00E0F0FF,&H000000FF,&H00402010,&H80000000,0,1,0,0,100,100,0,0,1,2.6,1,2,60,60,36,1\r\n"
+			"Style: Karaoke,Bench Sans 0,40,&H00FFFFFF,&H00FF8000,&H00000000,&H00000000,-1,0,0,0,100,100,0,0,1,2,0,8,20,20,20,1\r\n";
+		for (int i = 0; i < 20; ++i) {
+			out << "Style: Sign " << i << ",Bench Sans " << i % 4 << ",";
+			out << Range(24, 80) << ",&H00";
+			out << Color().substr(2, 6) << ",&H000000FF,&H00";
+			out << Color().substr(2, 6) << ",&H00000000,";
+			out << Range(-1, 0) << ",0,0,0,100,100,0,0,1,";
+			out << Range(0, 4) << ",0,";
+			out << Range(1, 9) << ",10,10,10,1\r\n";
+		}
+
+		// Random bytes don't compress or share anything, much like real fonts
+		out << "\r\n[Fonts]\r\n";
+		for (int i = 0; i < 4; ++i) {
+			std::vector<char> data(Range(32, 128) * 1024);
+			for (auto& c : data) c = static_cast<char>(rng());
+			out << "fontname: bench_sans_" << i << "_0.ttf\r\n"
+				<< agi::ass::UUEncode(data.data(), data.data() + data.size()) << "\r\n";
+		}
+
+		out << "\r\n[Events]\r\n"
+			"Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\r\n";
+	}
+
+public:
+	CorpusGenerator(uint32_t seed) : rng(seed) { }
+
+	/// Write a script with the given number of dialogue lines
+	void Write(agi::fs::path const& file, int lines) {
+		agi::io::Save save(file);
+		auto& out = save.Get();
+		WriteHeader(out, "Benchmark " + std::to_string(lines));
+
+		// Dialogue is in order, while the typesetting is placed at random
+		// times, as if it was timed separately and pasted in
+		const int duration = std::max(lines, 1) * 1500;
+		int time = 0;
+		for (int i = 0; i < lines; ++i) {
+			int kind = Range(0, 99);
+			int start, end;
+			const char *style, *actor = "";
+			std::string text;
+			bool comment = false;
+			if (kind < 60) {
+				time += Range(200, 2500);
+				start = time % duration;
+				end = start + Range(800, 5000);
+				style = Pick({"Default", "Default", "Default", "Default - Top", "Flashback"});
+				if (Chance(40)) actor = Pick({"Akari", "Sota", "Hina", "Teacher", "Narrator"});
+				text = DialogueText();
+			}
+			else {
+				start = Range(0, duration);
+				end = start + Range(100, 8000);
+				if (kind < 70) {
+					style = "Karaoke";
+					text = KaraokeText();
+				}
+				else if (kind < 90) {
+					style = "Sign 0";
+					text = TypesetText();
+				}
+				else if (kind < 95) {
+					style = "Sign 1";
+					text = DrawingText();
+				}
+				else {
+					style = "Default";
+					comment = true;
+					text = "{TL note: " + Words(5, 15) + "}";
+				}
+			}
+
+			int layer = kind < 60 ? 0 : Range(0, 5);
+			WriteLine(out, comment, layer, start, end, style, actor, text);
+		}
+	}
+
+	/// Write a script of just signs and drawings spread over the given
+	/// number of milliseconds, for timing rendering rather than editing
+	void WriteTypesetting(agi::fs::path const& file, int lines, int duration) {
+		agi::io::Save save(file);
+		auto& out = save.Get();
+		WriteHeader(out, "Typesetting benchmark " + std::to_string(lines));
+
+		static const std::initializer_list<const char *> styles = {
+			"Sign 0", "Sign 1", "Sign 2", "Sign 3", "Sign 4", "Sign 5", "Sign 6", "Sign 7",
+			"Sign 8", "Sign 9", "Sign 10", "Sign 11", "Sign 12", "Sign 13", "Sign 14", "Sign 15",
+			"Sign 16", "Sign 17", "Sign 18", "Sign 19"
+		};
+		for (int i = 0; i < lines; ++i) {
+			int start = Range(0, std::max(duration - 100, 0));
+			int end = start + Range(100, 8000);
+			const char *style = Pick(styles);
+			std::string text = Chance(80) ? TypesetText() : DrawingText();
+			int layer = Range(0, 5);
+			WriteLine(out, false, layer, start, end, style, "", text);
+		}
+	}
+};
+
+struct Settings {
+	std::vector<int> sizes;
+	agi::fs::path dir;
+	uint32_t seed = 1;
+	/// Length of the generated audio, or 0 to benchmark subtitles instead
+	int audio_seconds = 0;
+	/// Number of frames of video to render, or 0 to benchmark subtitles
+	/// instead
+	int video_frames = 0;
+	/// Video to render in addition to a dummy video
+	agi::fs::path video_file;
+};
+
+void usage() {
+	std::cerr <<
+		"usage: aegisub-bench [options]\n"
+		"  --lines <n>    Number of lines in a generated script; may be given more\n"
+		"                 than once (default 1000, 10000 and 100000)\n"
+		"  --dir <dir>    Directory to write the scripts to (default a temporary\n"
+		"                 directory)\n"
+		"  --seed <n>     Seed for generating the scripts (default 1)\n"
+		"  --audio <s>    Benchmark audio of this many seconds rather than subtitles\n"
+		"  --video <n>    Benchmark rendering this many frames of video with\n"
+		"                 subtitles rather than editing subtitles; --lines is then\n"
+		"                 the number of signs (default 100 and 500)\n"
+		"  --video-file <file>\n"
+		"                 Also render a video file, such as a Y4M file, rather\n"
+		"                 than only a dummy video\n";
+}
+
+bool parse_args(int argc, char **argv, Settings &settings) {
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (i + 1 == argc) return false;
+		const char *value = argv[++i];
+		if (arg == "--lines") {
+			int lines;
+			if (!agi::util::try_parse(value, &lines) || lines < 0) return false;
+			settings.sizes.push_back(lines);
+		}
+		else if (arg == "--dir") settings.dir = value;
+		else if (arg == "--seed") settings.seed = strtoul(value, nullptr, 10);
+		else if (arg == "--audio") {
+			if (!agi::util::try_parse(value, &settings.audio_seconds) || settings.audio_seconds <= 0) return false;
+		}
+		else if (arg == "--video") {
+			if (!agi::util::try_parse(value, &settings.video_frames) || settings.video_frames <= 0) return false;
+		}
+		else if (arg == "--video-file") settings.video_file = value;
+		else return false;
+	}
+
+	if (settings.audio_seconds && settings.video_frames) return false;
+	if (!settings.video_file.empty() && !settings.video_frames) return false;
+	if (settings.sizes.empty() && settings.video_frames)
+		settings.sizes = {100, 500};
+	else if (settings.sizes.empty())
+		settings.sizes = {1000, 10000, 100000};
+	if (settings.dir.empty())
+		settings.dir = boost::filesystem::temp_directory_path() / "aegisub-bench";
+	return true;
+}
+
+/// Time an operation and write a line with the results
+/// @return The time taken in milliseconds
+template<typename Func>
+double measure(std::string const& subject, std::string const& name, Func&& func) {
+	run_main_thunks();
+	reset_peak_memory();
+
+	auto start = std::chrono::steady_clock::now();
+	func();
+	// Anything the operation queued for the main thread is part of its cost
+	run_main_thunks();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << std::left << std::setw(18) << subject << std::setw(24) << name << std::right
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(12) << elapsed.count()
+		<< std::setw(12) << peak_memory() / (1024.0 * 1024.0) << "\n";
+	return elapsed.count();
+}
+
+/// Write a line with a figure worked out from the operations measured, such
+/// as a rate, in the time column
+void report(std::string const& subject, std::string const& name, double value) {
+	std::cout << std::left << std::setw(18) << subject << std::setw(24) << name << std::right
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(12) << value << std::setw(12) << "-" << "\n";
+}
+
+void run(Settings const& settings, int lines) {
+	const std::string subject = std::to_string(lines) + " lines";
+	auto input = settings.dir / ("bench_" + std::to_string(lines) + ".ass");
+	auto output = settings.dir / ("bench_" + std::to_string(lines) + "_saved.ass");
+	auto srt = settings.dir / ("bench_" + std::to_string(lines) + ".srt");
+
+	CorpusGenerator(settings.seed).Write(input, lines);
+
+	{
+		auto c = agi::make_unique<agi::Context>();
+
+		measure(subject, "load", [&] { c->subsController->Load(input, "UTF-8"); });
+
+		measure(subject, "commit line x10", [&] {
+			auto it = c->ass->Events.begin();
+			for (int i = 0; i < 10 && it != c->ass->Events.end(); ++i, ++it) {
+				it->Text = it->Text.get() + " ";
+				c->ass->Commit("bench", AssFile::COMMIT_DIAG_TEXT, -1, &*it);
+			}
+		});
+		measure(subject, "commit all", [&] { c->ass->Commit("bench", AssFile::COMMIT_DIAG_FULL); });
+		measure(subject, "undo", [&] { c->subsController->Undo(); });
+		measure(subject, "redo", [&] { c->subsController->Redo(); });
+
+		measure(subject, "sort", [&] {
+			c->ass->Sort();
+			c->ass->Commit("sort", AssFile::COMMIT_ORDER);
+		});
+
+		SearchReplaceSettings search;
+		search.find = "the";
+		search.replace_with = "teh";
+		search.field = SearchReplaceSettings::Field::TEXT;
+		search.limit_to = SearchReplaceSettings::Limit::ALL;
+		search.match_case = false;
+		search.use_regex = false;
+		search.ignore_comments = false;
+		search.skip_tags = true;
+		search.exact_match = false;
+
+		measure(subject, "search", [&] {
+			auto matcher = SearchReplaceEngine::GetMatcher(search);
+			for (auto const& line : c->ass->Events) {
+				for (auto ms = matcher(&line, 0); ms; ms = matcher(&line, ms.end)) { }
+			}
+		});
+		measure(subject, "replace all", [&] {
+			c->search->Configure(search);
+			c->search->ReplaceAllMatches();
+		});
+
+		measure(subject, "resample", [&] {
+			ResampleResolution(c->ass.get(), {
+				{0, 0, 0, 0},
+				1280, 720, 1920, 1080,
+				ResampleARMode::Stretch,
+				YCbCrMatrix::tv_709, YCbCrMatrix::tv_709
+			});
+		});
+
+		measure(subject, "save ass", [&] { c->subsController->Save(output, "UTF-8"); });
+		measure(subject, "export srt", [&] {
+			AssFile copy(*c->ass);
+			SubtitleFormat::GetWriter(srt)->ExportFile(&copy, srt, agi::vfr::Framerate(), "UTF-8");
+		});
+		measure(subject, "close", [&] { c.reset(); });
+	}
+
+	agi::fs::Remove(input);
+	agi::fs::Remove(output);
+	agi::fs::Remove(srt);
+}
+
+/// A format to write the generated audio in
+struct AudioFormat {
+	const char *name;
+	int sample_rate;
+	int bytes_per_sample;
+	int channels;
+};
+
+const AudioFormat audio_formats[] = {
+	// What the cache and renderers want, so it needs no conversion
+	{"s16 mono 48k", 48000, 2, 1},
+	{"s16 stereo 48k", 48000, 2, 2},
+	{"s24 stereo 48k", 48000, 3, 2},
+	{"s32 stereo 48k", 48000, 4, 2},
+	{"u8 mono 22k", 22050, 1, 1},
+};
+
+/// Write a WAV file of tones which change pitch and volume every quarter of
+/// a second over a little noise, with some gaps, which is closer to speech
+/// than silence or pure noise for the compressed cache and the renderers
+void write_wav(agi::fs::path const& file, AudioFormat const& format, int seconds, uint32_t seed) {
+	const uint64_t frame_size = format.bytes_per_sample * format.channels;
+	const uint64_t data_size = static_cast<uint64_t>(format.sample_rate) * seconds * frame_size;
+	if (data_size > 0xFFFFFFF0)
+		throw agi::InvalidInputException("Too much audio for a WAV file");
+
+	agi::io::Save save(file, true);
+	auto& out = save.Get();
+	auto put = [&](uint64_t value, int bytes) {
+		for (int i = 0; i < bytes; ++i)
+			out.put(static_cast<char>(value >> (i * 8)));
+	};
+
+	out.write("RIFF", 4);
+	put(36 + data_size, 4);
+	out.write("WAVEfmt ", 8);
+	put(16, 4);
+	put(1, 2); // PCM
+	put(format.channels, 2);
+	put(format.sample_rate, 4);
+	put(format.sample_rate * frame_size, 4);
+	put(frame_size, 2);
+	put(format.bytes_per_sample * 8, 2);
+	out.write("data", 4);
+	put(data_size, 4);
+
+	std::mt19937 rng(seed);
+	const int64_t max_value = (1LL << (format.bytes_per_sample * 8 - 1)) - 1;
+	const int segment = format.sample_rate / 4;
+	double phase = 0, step = 0, volume = 0;
+	std::vector<char> buffer(segment * frame_size);
+	for (int64_t sample = 0, end = static_cast<int64_t>(format.sample_rate) * seconds; sample < end; ) {
+		step = (100 + rng() % 400) * 2 * 3.14159265358979 / format.sample_rate;
+		volume = rng() % 4 ? (rng() % 900) / 1000.0 : 0;
+
+		int count = static_cast<int>(std::min<int64_t>(segment, end - sample));
+		char *dst = buffer.data();
+		for (int i = 0; i < count; ++i) {
+			phase += step;
+			double noise = (static_cast<int>(rng() % 2001) - 1000) / 50000.0;
+			double value = volume * std::sin(phase) + noise;
+			for (int channel = 0; channel < format.channels; ++channel) {
+				int64_t v = static_cast<int64_t>(value * (channel ? 0.8 : 1.0) * max_value);
+				if (format.bytes_per_sample == 1)
+					v += 128; // 8-bit WAV is unsigned
+				for (int b = 0; b < format.bytes_per_sample; ++b)
+					*dst++ = static_cast<char>(v >> (b * 8));
+			}
+		}
+		out.write(buffer.data(), count * frame_size);
+		sample += count;
+	}
+}
+
+void wait_for_decode(agi::AudioProvider const& provider, int64_t count) {
+	while (!provider.IsDecoded(0, count)) {
+		run_main_thunks();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+/// Render the start of the audio with each renderer at a few zoom levels
+void render_audio(std::string const& subject, agi::AudioProvider *provider) {
+	AudioRenderer renderer;
+	renderer.SetAudioProvider(provider);
+	renderer.SetHeight(OPT_GET("Audio/Display Height")->GetInt());
+	renderer.SetAmplitudeScale(1.f);
+	renderer.SetCacheMaxSize(1024 * 1024 * 1024);
+
+	AudioWaveformRenderer waveform(OPT_GET("Colour/Audio Display/Waveform")->GetString());
+	AudioSpectrumRenderer spectrum(OPT_GET("Colour/Audio Display/Spectrum")->GetString());
+	// The resolution AudioDisplay uses for the default quality
+	spectrum.SetResolution(9, 8);
+
+	const std::pair<const char *, AudioRendererBitmapProvider *> renderers[] = {
+		{"waveform", &waveform},
+		{"spectrum", &spectrum},
+	};
+	const double duration = provider->GetNumSamples() * 1000.0 / provider->GetSampleRate();
+	// Must match AudioRenderer's cache_bitmap_width
+	const int bitmap_width = 32;
+
+	for (auto const& r : renderers) {
+		renderer.SetRenderer(r.second);
+		for (double pixel_ms : {0.5, 5.0, 50.0}) {
+			renderer.SetMillisecondsPerPixel(pixel_ms);
+			const int bitmaps = std::min(500, static_cast<int>(duration / pixel_ms / bitmap_width));
+			if (bitmaps == 0) continue;
+
+			std::ostringstream name;
+			name << r.first << " " << pixel_ms << " ms/px x" << bitmaps;
+			measure(subject, name.str(), [&] {
+				// Bitmaps which need data computed in the background are skipped
+				// until it's ready
+				for (int rendered = 0; rendered < bitmaps; ) {
+					int count = renderer.Prefetch(0, bitmaps * bitmap_width, AudioStyle_Normal, false, bitmaps - rendered);
+					rendered += count;
+					if (!count) {
+						run_main_thunks();
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}
+				}
+			});
+		}
+	}
+}
+
+void run_audio(Settings const& settings, AudioFormat const& format, bool render) {
+	const std::string subject = format.name;
+	auto file = settings.dir / ("bench_" + std::to_string(format.sample_rate) + "_" + std::to_string(format.bytes_per_sample) + "_" + std::to_string(format.channels) + ".wav");
+	write_wav(file, format, settings.audio_seconds, settings.seed);
+
+	// Indexed by Audio/Cache/Type
+	const char *cache_names[] = {"uncached", "ram", "hd", "compressed"};
+	const int rendering_cache = OPT_GET("Audio/Cache/Type")->GetInt();
+
+	for (int cache = 0; cache < 4; ++cache) {
+		const std::string prefix = std::string(cache_names[cache]) + " ";
+		std::unique_ptr<agi::AudioProvider> provider;
+
+		// Opened just as GetAudioProvider does, but with the cache even though
+		// the PCM provider doesn't ask for one
+		measure(subject, prefix + "first sample", [&] {
+			provider = WrapAudioProvider(agi::CreatePCMAudioProvider(file, nullptr), cache, file, "PCM", *config::path);
+			wait_for_decode(*provider, std::min<int64_t>(provider->GetNumSamples(), provider->GetSampleRate() / 10));
+		});
+		measure(subject, prefix + "decode", [&] { wait_for_decode(*provider, provider->GetNumSamples()); });
+
+		const int64_t block = 65536;
+		std::vector<char> buffer(block * provider->GetBytesPerSample() * provider->GetChannels());
+		measure(subject, prefix + "read all", [&] {
+			for (int64_t start = 0; start < provider->GetNumSamples(); start += block)
+				provider->GetAudio(buffer.data(), start, std::min(block, provider->GetNumSamples() - start));
+		});
+		measure(subject, prefix + "random read x1000", [&] {
+			std::mt19937 rng(settings.seed);
+			// About what the audio display reads for one frame of playback
+			const int64_t count = provider->GetSampleRate() / 25;
+			for (int i = 0; i < 1000; ++i)
+				provider->GetAudio(buffer.data(), rng() % provider->GetNumSamples(), count);
+		});
+
+		if (render && cache == rendering_cache)
+			render_audio(subject, provider.get());
+
+		measure(subject, prefix + "close", [&] { provider.reset(); });
+	}
+
+	boost::filesystem::remove_all(settings.dir / "audiocache");
+	agi::fs::Remove(file);
+}
+
+/// Runs tasks such as scanning fonts in place, with their titles written to
+/// stderr so that they don't end up in the results
+class ConsoleProgress final : public agi::BackgroundRunner, agi::ProgressSink {
+	void SetIndeterminate() override { }
+	void SetTitle(std::string const& title) override { std::cerr << title << "\n"; }
+	void SetMessage(std::string const& msg) override { }
+	void SetProgress(int64_t cur, int64_t max) override { }
+	void Log(std::string const& str) override { std::cerr << str; }
+	bool IsCancelled() override { return false; }
+
+public:
+	void Run(std::function<void(agi::ProgressSink *)> task) override { task(this); }
+};
+
+/// Average time in milliseconds of a traced scope since the trace was last
+/// cleared
+double trace_ms(const char *name) {
+	auto metric = agi::trace::Get(name);
+	return metric.count ? metric.total / 1e6 / metric.count : 0.;
+}
+
+/// Report the percentage of lookups in a cache which were hits, if there
+/// were any lookups
+void report_hits(std::string const& subject, std::string const& name, const char *hit, const char *miss) {
+	const int64_t hits = agi::trace::Get(hit).count;
+	const int64_t lookups = hits + agi::trace::Get(miss).count;
+	if (lookups)
+		report(subject, name, 100. * hits / lookups);
+}
+
+void run_video(Settings const& settings, std::string const& source, agi::fs::path const& video, int lines, agi::BackgroundRunner *br) {
+	const std::string subject = source + " " + std::to_string(lines) + " signs";
+	auto input = settings.dir / ("bench_typeset_" + std::to_string(lines) + ".ass");
+
+	// Declared first as the provider may still have a pending copy of it
+	AssFile subs;
+	// Errors and frames requested asynchronously would be sent to a window
+	wxEvtHandler events;
+	std::unique_ptr<AsyncVideoProvider> provider;
+
+	measure(subject, "open", [&] { provider = agi::make_unique<AsyncVideoProvider>(video, "TV.709", &events, br); });
+	// Failing to create the subtitles provider is reported as an event
+	// rather than thrown, as the video can still be shown without it
+	if (events.HasPendingEvents())
+		throw agi::InternalError("Failed to create the subtitles provider");
+
+	const int frames = std::min(settings.video_frames, provider->GetFrameCount());
+	const auto fps = provider->GetFPS();
+	auto time_at = [&](int frame) { return static_cast<double>(fps.TimeAtFrame(frame, agi::vfr::START)); };
+
+	CorpusGenerator(settings.seed).WriteTypesetting(input, lines, fps.TimeAtFrame(frames));
+	SubtitleFormat::GetReader(input, "UTF-8")->ReadFile(&subs, input, fps, "UTF-8");
+
+	measure(subject, "load subtitles", [&] { provider->LoadSubtitles(&subs); });
+	// Includes waiting for the subtitles provider to load the fonts
+	measure(subject, "first frame", [&] { provider->GetFrame(0, time_at(0)); });
+
+	// Each pass over the video clears the trace first, so that the figures
+	// reported after it are for just that pass
+	agi::trace::Enable(true);
+	auto pass = [&](std::string const& name, bool raw) {
+		agi::trace::Clear();
+		double ms = measure(subject, name + " x" + std::to_string(frames), [&] {
+			for (int frame = 0; frame < frames; ++frame)
+				provider->GetFrame(frame, time_at(frame), raw);
+		});
+		report(subject, name + " fps", frames * 1000. / std::max(ms, 1e-3));
+	};
+
+	pass("decode", true);
+	report_hits(subject, "frame cache hit %", "video/cache/hit", "video/cache/miss");
+
+	pass("render", false);
+	report(subject, "subtitles ms/frame", trace_ms("video/subtitles"));
+	report(subject, "blend ms/frame", trace_ms("video/blend"));
+	report_hits(subject, "frame cache hit %", "video/cache/hit", "video/cache/miss");
+	report_hits(subject, "overlay cache hit %", "video/overlay/hit", "video/overlay/miss");
+
+	// The overlays are all cached by now if they fit, so this is mostly
+	// blending
+	pass("render again", false);
+	report(subject, "blend ms/frame", trace_ms("video/blend"));
+	report_hits(subject, "overlay cache hit %", "video/overlay/hit", "video/overlay/miss");
+
+	// Edit a line shown on the middle frame and commit it, as typing into
+	// the edit box with the video paused there does
+	const int frame = frames / 2;
+	auto line = std::find_if(subs.Events.begin(), subs.Events.end(), [&](AssDialogue const& diag) {
+		return diag.Start <= time_at(frame) && diag.End > time_at(frame);
+	});
+	if (line != subs.Events.end()) {
+		const int commits = 20;
+		agi::trace::Clear();
+		double ms = measure(subject, "commit x" + std::to_string(commits), [&] {
+			for (int i = 0; i < commits; ++i) {
+				line->Text = line->Text.get() + "x";
+				provider->LoadSubtitles(&subs);
+				provider->GetFrame(frame, time_at(frame));
+			}
+		});
+		report(subject, "ms/commit", ms / commits);
+		report(subject, "LoadSubtitles ms/commit", trace_ms("video/subtitles/load"));
+	}
+	agi::trace::Enable(false);
+	agi::trace::Clear();
+
+	measure(subject, "close", [&] { provider.reset(); });
+	agi::fs::Remove(input);
+}
+}
+
+int main(int argc, char **argv) {
+	Settings settings;
+	if (!parse_args(argc, argv, settings)) {
+		usage();
+		return 1;
+	}
+
+	// Rendering audio needs the GUI for its bitmaps, and so a display. For
+	// subtitles and video only wxBase is initialized, so that they can be
+	// run anywhere.
+	std::unique_ptr<wxInitializer> wx_init;
+	if (settings.audio_seconds) {
+		wxApp::SetInstance(new wxApp);
+		if (!wxEntryStart(argc, argv)) {
+			std::cerr << "Failed to initialize wxWidgets; benchmarking audio needs a display\n";
+			return 1;
+		}
+	}
+	else {
+		wx_init = agi::make_unique<wxInitializer>();
+		if (!wx_init->IsOk()) {
+			std::cerr << "Failed to initialize wxWidgets\n";
+			return 1;
+		}
+	}
+
+	agi::dispatch::Init([](agi::dispatch::Thunk f) {
+		std::lock_guard<std::mutex> lock(main_queue.mutex);
+		main_queue.thunks.push_back(std::move(f));
+	});
+	std::locale::global(boost::locale::generator().generate(""));
+	agi::log::log = new agi::log::LogSink;
+
+	int ret = 0;
+	try {
+		if (!agi::fs::DirectoryExists(settings.dir))
+			agi::fs::CreateDirectory(settings.dir);
+
+		config::path = new agi::Path;
+		// Always use the default settings so that runs are comparable, and
+		// don't keep journals, autosaves or backups of the files
+		config::opt = new agi::Options("", GET_DEFAULT_CONFIG(default_config), agi::Options::FLUSH_SKIP);
+		OPT_SET("App/Auto/Backup")->SetBool(false);
+		OPT_SET("App/Auto/Journal")->SetBool(false);
+		OPT_SET("App/Auto/Save")->SetBool(false);
+		OPT_SET("App/Auto/Save on Every Change")->SetBool(false);
+		config::mru = new agi::MRUManager(settings.dir / "mru.json", GET_DEFAULT_CONFIG(default_mru), config::opt);
+
+		OPT_SET("Audio/Cache/HD/Location")->SetString((settings.dir / "audiocache").string());
+
+		SubtitleFormat::LoadFormats();
+
+		std::cout << std::left << std::setw(18) << "subject" << std::setw(24) << "operation" << std::right
+			<< std::setw(12) << "time (ms)" << std::setw(12) << "peak (MB)" << "\n";
+		if (settings.audio_seconds) {
+			for (auto const& format : audio_formats)
+				run_audio(settings, format, &format == audio_formats);
+		}
+		else if (settings.video_frames) {
+			ConsoleProgress progress;
+			// The size of a typical TV release, with a checkerboard so that
+			// the subtitles aren't blended onto a flat colour
+			auto dummy = DummyVideoProvider::MakeFilename(23.976, settings.video_frames, 1280, 720, agi::Color(47, 163, 254), true);
+			for (int lines : settings.sizes) {
+				run_video(settings, "dummy", dummy, lines, &progress);
+				if (!settings.video_file.empty())
+					run_video(settings, "file", settings.video_file, lines, &progress);
+			}
+		}
+		else {
+			for (int lines : settings.sizes)
+				run(settings, lines);
+		}
+
+		agi::fs::Remove(settings.dir / "mru.json");
+	}
+	catch (agi::Exception const& e) {
+		std::cerr << e.GetMessage() << "\n";
+		ret = 1;
+	}
+
+	delete config::mru;
+	delete config::opt;
+	delete config::path;
+	delete agi::log::log;
+	if (!wx_init)
+		wxEntryCleanup();
+	return ret;
+}
@@ -0,0 +1,366 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file aegisub_render.cpp
+/// @brief Command-line renderer of video frames with subtitles
+/// @ingroup main
+///
+/// Renders a range of frames of a video with a script's subtitles drawn on
+/// them, either to numbered PNG files or as raw BGRA video on stdout, without
+/// creating any windows. Each worker thread has its own video provider and
+/// subtitles provider, and the frames are written in order.
+
+#include "ass_file.h"
+#include "ass_parser.h"
+#include "include/aegisub/subtitles_provider.h"
+#include "include/aegisub/video_provider.h"
+#include "options.h"
+#include "text_file_reader.h"
+#include "video_frame.h"
+#include "video_provider_manager.h"
+
+#include <libaegisub/background_runner.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/exception.h>
+#include <libaegisub/format.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/path.h>
+#include <libaegisub/vfr.h>
+
+#include "libresrc/libresrc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <boost/locale/generator.hpp>
+#include <wx/image.h>
+#include <wx/init.h>
+
+namespace config {
+	agi::Options *opt = nullptr;
+	agi::MRUManager *mru = nullptr;
+	agi::Path *path = nullptr;
+	Automation4::AutoloadScriptManager *global_scripts = nullptr;
+}
+
+namespace {
+/// Number of frames each worker renders at a time. Workers render runs of
+/// frames rather than every nth frame so that they seek less.
+const int frames_per_block = 8;
+
+/// Functions queued for the main thread with agi::dispatch::Main()
+struct {
+	std::mutex mutex;
+	std::deque<agi::dispatch::Thunk> thunks;
+} main_queue;
+
+/// Progress of indexing and font scanning, written to stderr
+class ConsoleProgress final : public agi::BackgroundRunner, agi::ProgressSink {
+	void SetIndeterminate() override { }
+	void SetTitle(std::string const& title) override { std::cerr << title << "\n"; }
+	void SetMessage(std::string const& msg) override { std::cerr << msg << "\n"; }
+	void SetProgress(int64_t cur, int64_t max) override { }
+	void Log(std::string const& str) override { std::cerr << str; }
+	bool IsCancelled() override { return false; }
+
+public:
+	void Run(std::function<void(agi::ProgressSink *)> task) override { task(this); }
+};
+
+struct Settings {
+	agi::fs::path video;
+	agi::fs::path subtitles;
+	std::string encoding = "UTF-8";
+	/// Output filename pattern, or "-" for raw video on stdout
+	std::string output = "-";
+	int start = 0;
+	/// Last frame to render, or -1 for the end of the video
+	int end = -1;
+	int threads = 0;
+};
+
+void usage() {
+	std::cerr <<
+		"usage: aegisub-render [options] <video> <subtitles>\n"
+		"  --start <frame>     First frame to render (default 0)\n"
+		"  --end <frame>       Last frame to render (default the last frame)\n"
+		"  --output <pattern>  Write each frame to a PNG named with a printf-style\n"
+		"                      pattern such as frame%05d.png, or - to write raw\n"
+		"                      BGRA video to stdout (default -)\n"
+		"  --threads <n>       Number of frames to render at once (default one\n"
+		"                      per core)\n"
+		"  --encoding <name>   Character set of the subtitles (default UTF-8)\n";
+}
+
+bool parse_args(int argc, char **argv, Settings &settings) {
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg.size() < 2 || arg[0] != '-' || arg[1] != '-') {
+			files.push_back(arg);
+			continue;
+		}
+		if (i + 1 == argc) return false;
+		const char *value = argv[++i];
+		if (arg == "--start") settings.start = atoi(value);
+		else if (arg == "--end") settings.end = atoi(value);
+		else if (arg == "--output") settings.output = value;
+		else if (arg == "--threads") settings.threads = atoi(value);
+		else if (arg == "--encoding") settings.encoding = value;
+		else return false;
+	}
+	if (files.size() != 2 || settings.start < 0) return false;
+	settings.video = files[0];
+	settings.subtitles = files[1];
+	return true;
+}
+
+void load_subtitles(AssFile &file, Settings const& settings) {
+	TextFileReader reader(settings.subtitles, settings.encoding);
+	AssParser parser(&file, !agi::fs::HasExtension(settings.subtitles, "ssa"));
+	while (reader.HasMoreLines())
+		parser.AddLine(reader.ReadLineFromFile());
+}
+
+/// Video and subtitles providers used by a single worker thread
+struct Renderer {
+	std::unique_ptr<VideoProvider> video;
+	std::unique_ptr<SubtitlesProvider> subs;
+};
+
+class BatchRenderer {
+	Settings const& settings;
+	agi::vfr::Framerate fps;
+	std::vector<Renderer> renderers;
+
+	/// Last frame to render
+	int last_frame = 0;
+	int block_count = 0;
+	/// Next block for a worker to start on
+	std::atomic<int> next_block{0};
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	/// Rendered blocks which haven't been written yet
+	std::map<int, std::vector<VideoFrame>> done;
+	/// Number of blocks which have been written
+	int written = 0;
+	std::string error;
+
+	void Work(Renderer &r);
+	void Write(int block, std::vector<VideoFrame> const& frames);
+
+public:
+	BatchRenderer(Settings const& settings, AssFile &subs, agi::BackgroundRunner *br);
+	void Run();
+};
+
+BatchRenderer::BatchRenderer(Settings const& settings, AssFile &subs, agi::BackgroundRunner *br)
+: settings(settings)
+{
+	auto matrix = subs.GetScriptInfo("YCbCr Matrix");
+	size_t count = settings.threads > 0 ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+	renderers.resize(count);
+	for (auto &r : renderers) {
+		r.video = VideoProviderFactory::GetProvider(settings.video, matrix, br);
+		r.subs = SubtitlesProviderFactory::GetProvider(br);
+		r.subs->WaitUntilReady();
+		r.subs->LoadSubtitles(&subs);
+	}
+	fps = renderers[0].video->GetFPS();
+
+	const int frame_count = renderers[0].video->GetFrameCount();
+	last_frame = settings.end < 0 ? frame_count - 1 : std::min(settings.end, frame_count - 1);
+	if (settings.start <= last_frame)
+		block_count = (last_frame - settings.start) / frames_per_block + 1;
+}
+
+void BatchRenderer::Work(Renderer &r) {
+	for (int block = next_block++; block < block_count; block = next_block++) {
+		{
+			// Don't get too far ahead of the writer, as every rendered frame
+			// is kept in memory until it's written
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&] { return block < written + 2 * (int)renderers.size() || !error.empty(); });
+			if (!error.empty()) return;
+		}
+
+		std::vector<VideoFrame> frames;
+		try {
+			const int first = settings.start + block * frames_per_block;
+			for (int n = first; n < first + frames_per_block && n <= last_frame; ++n) {
+				VideoFrame frame;
+				r.video->GetFrame(n, frame);
+				if (frame.format != VideoFrameFormat::BGRA) {
+					VideoFrame converted;
+					ConvertToBGRA(frame, converted);
+					frame = std::move(converted);
+				}
+				r.subs->DrawSubtitles(frame, fps.TimeAtFrame(n, agi::vfr::START) / 1000.);
+				frames.push_back(std::move(frame));
+			}
+		}
+		catch (agi::Exception const& e) {
+			std::lock_guard<std::mutex> lock(mutex);
+			error = e.GetMessage();
+			cv.notify_all();
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		done[block] = std::move(frames);
+		cv.notify_all();
+	}
+}
+
+void BatchRenderer::Write(int block, std::vector<VideoFrame> const& frames) {
+	for (size_t i = 0; i < frames.size(); ++i) {
+		auto const& frame = frames[i];
+		if (settings.output == "-") {
+			for (size_t y = 0; y < frame.height; ++y) {
+				size_t row = frame.flipped ? frame.height - 1 - y : y;
+				fwrite(&frame.data[row * frame.pitch], 4, frame.width, stdout);
+			}
+			continue;
+		}
+
+		int n = settings.start + block * frames_per_block + (int)i;
+		auto filename = agi::format(settings.output.c_str(), n);
+		if (!GetImage(frame).SaveFile(wxString::FromUTF8(filename.c_str()), wxBITMAP_TYPE_PNG))
+			throw agi::InternalError("Failed to write " + filename);
+	}
+}
+
+void BatchRenderer::Run() {
+	if (!block_count) return;
+
+	auto const& video = renderers[0].video;
+	std::cerr << "Rendering frames " << settings.start << "-" << last_frame << " at "
+		<< video->GetWidth() << "x" << video->GetHeight() << " with "
+		<< renderers.size() << " threads\n";
+
+	std::vector<std::thread> threads;
+	for (auto &r : renderers)
+		threads.emplace_back([&] { Work(r); });
+
+	// Write the blocks in order on this thread, running anything the
+	// providers queue on the main thread while waiting
+	try {
+		while (written < block_count) {
+			std::vector<VideoFrame> frames;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait_for(lock, std::chrono::milliseconds(50), [&] {
+					return done.count(written) || !error.empty();
+				});
+				if (!error.empty()) break;
+				auto it = done.find(written);
+				if (it != done.end()) {
+					frames = std::move(it->second);
+					done.erase(it);
+				}
+			}
+
+			if (frames.empty()) {
+				std::deque<agi::dispatch::Thunk> thunks;
+				{
+					std::lock_guard<std::mutex> lock(main_queue.mutex);
+					thunks.swap(main_queue.thunks);
+				}
+				for (auto &thunk : thunks) thunk();
+				continue;
+			}
+
+			Write(written, frames);
+			std::lock_guard<std::mutex> lock(mutex);
+			++written;
+			cv.notify_all();
+		}
+	}
+	catch (agi::Exception const& e) {
+		std::lock_guard<std::mutex> lock(mutex);
+		error = e.GetMessage();
+		cv.notify_all();
+	}
+
+	for (auto &thread : threads)
+		thread.join();
+	fflush(stdout);
+
+	if (!error.empty())
+		throw agi::InternalError(error);
+}
+}
+
+int main(int argc, char **argv) {
+	Settings settings;
+	if (!parse_args(argc, argv, settings)) {
+		usage();
+		return 1;
+	}
+
+	// Only wxBase is initialized, for strings and writing images; there is no
+	// GUI and so no need for a display
+	wxInitializer wx_init;
+	if (!wx_init.IsOk()) {
+		std::cerr << "Failed to initialize wxWidgets\n";
+		return 1;
+	}
+	wxImage::AddHandler(new wxPNGHandler);
+
+	agi::dispatch::Init([](agi::dispatch::Thunk f) {
+		std::lock_guard<std::mutex> lock(main_queue.mutex);
+		main_queue.thunks.push_back(std::move(f));
+	});
+	std::locale::global(boost::locale::generator().generate(""));
+	agi::log::log = new agi::log::LogSink;
+
+	config::path = new agi::Path;
+	// Use the user's settings for things like the video provider and cache
+	// locations, but never write them back
+	config::opt = new agi::Options(config::path->Decode("?user/config.json"), GET_DEFAULT_CONFIG(default_config), agi::Options::FLUSH_SKIP);
+	config::opt->ConfigUser();
+
+	int ret = 0;
+	try {
+		AssFile subs;
+		load_subtitles(subs, settings);
+
+		ConsoleProgress progress;
+		BatchRenderer renderer(settings, subs, &progress);
+		renderer.Run();
+	}
+	catch (agi::Exception const& e) {
+		std::cerr << e.GetMessage() << "\n";
+		ret = 1;
+	}
+
+	delete config::opt;
+	delete config::path;
+	delete agi::log::log;
+	return ret;
+}
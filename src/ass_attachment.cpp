@@ -16,6 +16,7 @@
 
 #include "ass_attachment.h"
 
+#include <libaegisub/ass/font_subset.h>
 #include <libaegisub/ass/uuencode.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/io.h>
@@ -32,7 +33,7 @@ AssAttachment::AssAttachment(std::string const& header, AssEntryGroup group)
 {
 }
 
-AssAttachment::AssAttachment(agi::fs::path const& name, AssEntryGroup group)
+AssAttachment::AssAttachment(agi::fs::path const& name, AssEntryGroup group, std::vector<int> const* characters)
 : filename(name.filename().string())
 , group(group)
 {
@@ -43,8 +44,19 @@ AssAttachment::AssAttachment(agi::fs::path const& name, AssEntryGroup group)
 
 	agi::read_file_mapping file(name);
 	auto buff = file.read();
+	auto size = file.size();
+
+	std::vector<char> subset;
+	if (group == AssEntryGroup::FONT && characters) {
+		subset = agi::ass::SubsetFont(buff, size, *characters);
+		if (!subset.empty() && subset.size() < size) {
+			buff = subset.data();
+			size = subset.size();
+		}
+	}
+
 	entry_data = (group == AssEntryGroup::FONT ? "fontname: " : "filename: ") + filename.get() + "\r\n";
-	entry_data = entry_data.get() + agi::ass::UUEncode(buff, buff + file.size());
+	entry_data = entry_data.get() + agi::ass::UUEncode(buff, buff + size);
 }
 
 size_t AssAttachment::GetSize() const {
@@ -52,9 +64,13 @@ size_t AssAttachment::GetSize() const {
 	return entry_data.get().size() - header_end - 1;
 }
 
-void AssAttachment::Extract(agi::fs::path const& filename) const {
+std::vector<char> AssAttachment::GetData() const {
 	auto header_end = entry_data.get().find('\n');
-	auto decoded = agi::ass::UUDecode(entry_data.get().c_str() + header_end + 1, &entry_data.get().back() + 1);
+	return agi::ass::UUDecode(entry_data.get().c_str() + header_end + 1, &entry_data.get().back() + 1);
+}
+
+void AssAttachment::Extract(agi::fs::path const& filename) const {
+	auto decoded = GetData();
 	agi::io::Save(filename, true).Get().write(&decoded[0], decoded.size());
 }
 
@@ -19,6 +19,7 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <boost/flyweight.hpp>
+#include <vector>
 
 /// @class AssAttachment
 class AssAttachment final : public AssEntry {
@@ -37,6 +38,9 @@ public:
 	/// Add a line of data (without newline) read from a subtitle file
 	void AddData(std::string const& data) { entry_data = entry_data.get() + data + "\r\n"; }
 
+	/// Get the decoded contents of the attached file
+	std::vector<char> GetData() const;
+
 	/// Extract the contents of this attachment to a file
 	/// @param filename Path to save the attachment to
 	void Extract(agi::fs::path const& filename) const;
@@ -50,5 +54,9 @@ public:
 
 	AssAttachment(AssAttachment const& rgt) = default;
 	AssAttachment(std::string const& header, AssEntryGroup group);
-	AssAttachment(agi::fs::path const& name, AssEntryGroup group);
+	/// @param name File to attach
+	/// @param group Section the attachment goes in
+	/// @param characters If not null and the file is a font, only the glyphs
+	///                   for these characters (sorted) are kept when possible
+	AssAttachment(agi::fs::path const& name, AssEntryGroup group, std::vector<int> const* characters = nullptr);
 };
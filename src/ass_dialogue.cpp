@@ -39,17 +39,25 @@
 #include <libaegisub/split.h>
 #include <libaegisub/make_unique.h>
 
+#include <atomic>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
-#include <boost/spirit/include/karma_generate.hpp>
-#include <boost/spirit/include/karma_int.hpp>
 
 using namespace boost::adaptors;
 
-static int next_id = 0;
+// Lines may be created on several threads at once when loading a file
+static std::atomic<int> next_id{0};
+
+struct AssDialogue::ParsedBlocks {
+	/// Text the blocks were parsed from. Holding on to the flyweight keeps
+	/// the interned string alive, so comparing it with the line's current
+	/// text is a valid check for whether it has changed.
+	FlyweightString text;
+	std::vector<std::unique_ptr<AssDialogueBlock>> blocks;
+};
 
 AssDialogue::AssDialogue() {
 	Id = ++next_id;
@@ -58,6 +66,7 @@ AssDialogue::AssDialogue() {
 AssDialogue::AssDialogue(AssDialogue const& that)
 : AssDialogueBase(that)
 , AssEntryListHook(that)
+, parsed_blocks(std::atomic_load(&that.parsed_blocks))
 {
 	Id = ++next_id;
 }
@@ -88,6 +97,25 @@ public:
 	std::string next_str_trim() { return agi::str(boost::trim_copy(next_tok())); }
 };
 
+/// Parse an integer field, which is nearly always a few plain digits, without
+/// the overhead of lexical_cast. Anything unusual is left to lexical_cast so
+/// that malformed fields are still rejected in the same way.
+static int parse_int(agi::StringRange const& range) {
+	auto it = range.begin(), end = range.end();
+	bool negative = it != end && *it == '-';
+	if (negative) ++it;
+	if (it == end || end - it > 9)
+		return boost::lexical_cast<int>(agi::str(range));
+
+	int value = 0;
+	for (; it != end; ++it) {
+		if (*it < '0' || *it > '9')
+			return boost::lexical_cast<int>(agi::str(range));
+		value = value * 10 + (*it - '0');
+	}
+	return negative ? -value : value;
+}
+
 void AssDialogue::Parse(std::string const& raw) {
 	agi::StringRange str;
 	if (boost::starts_with(raw, "Dialogue:")) {
@@ -104,21 +132,21 @@ void AssDialogue::Parse(std::string const& raw) {
 	tokenizer tkn(str);
 
 	// Get first token and see if it has "Marked=" in it
-	auto tmp = tkn.next_str_trim();
+	auto tmp = boost::trim_copy(tkn.next_tok());
 	bool ssa = boost::istarts_with(tmp, "marked=");
 
 	// Get layer number
 	if (ssa)
 		Layer = 0;
 	else
-		Layer = boost::lexical_cast<int>(tmp);
+		Layer = parse_int(tmp);
 
 	Start = tkn.next_str_trim();
 	End = tkn.next_str_trim();
 	Style = tkn.next_str_trim();
 	Actor = tkn.next_str_trim();
 	for (int& margin : Margin)
-		margin = mid(0, boost::lexical_cast<int>(tkn.next_str()), 9999);
+		margin = mid(0, parse_int(tkn.next_tok()), 9999);
 	Effect = tkn.next_str_trim();
 
 	std::string text{tkn.next_tok().begin(), str.end()};
@@ -143,70 +171,105 @@ void AssDialogue::Parse(std::string const& raw) {
 		}
 	}
 
-	Text = text;
+	Text = std::move(text);
 }
 
-static void append_int(std::string &str, int v) {
-	boost::spirit::karma::generate(back_inserter(str), boost::spirit::karma::int_, v);
+static void append_int(std::string &str, int64_t v) {
+	char buf[20];
+	char *end = buf + sizeof(buf), *p = end;
+	uint64_t u = v < 0 ? 0u - static_cast<uint64_t>(v) : v;
+	do {
+		*--p = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	if (v < 0) *--p = '-';
+	str.append(p, end);
+}
+
+static void append_field(std::string &str, int v) {
+	append_int(str, v);
 	str += ',';
 }
 
-static void append_str(std::string &out, std::string const& str) {
-	out += str;
-	out += ',';
+/// Same format as agi::Time::GetAssFormatted, without the temporary string
+static void append_time(std::string &str, agi::Time t) {
+	const int time = t;
+	char buf[11] = {
+		char('0' + time / 3600000), ':',
+		char('0' + (time % (60 * 60 * 1000)) / (60 * 1000 * 10)),
+		char('0' + (time % (10 * 60 * 1000)) / (60 * 1000)), ':',
+		char('0' + (time % (60 * 1000)) / (1000 * 10)),
+		char('0' + (time % (10 * 1000)) / 1000), '.',
+		char('0' + (time % 1000) / 100),
+		char('0' + (time % 100) / 10), ','
+	};
+	str.append(buf, sizeof(buf));
 }
 
 static void append_unsafe_str(std::string &out, std::string const& str) {
-	for (auto c : str) {
-		if (c == ',')
-			out += ';';
-		else
-			out += c;
+	size_t pos = 0, comma;
+	while ((comma = str.find(',', pos)) != std::string::npos) {
+		out.append(str, pos, comma - pos);
+		out += ';';
+		pos = comma + 1;
 	}
+	out.append(str, pos, std::string::npos);
 	out += ',';
 }
 
 std::string AssDialogue::GetEntryData() const {
-	std::string str = Comment ? "Comment: " : "Dialogue: ";
-	str.reserve(51 + Style.get().size() + Actor.get().size() + Effect.get().size() + Text.get().size());
+	std::string str;
+	str.reserve(60 + Style.get().size() + Actor.get().size() + Effect.get().size() + Text.get().size());
+	AppendEntryData(str);
+	return str;
+}
 
-	append_int(str, Layer);
-	append_str(str, Start.GetAssFormatted());
-	append_str(str, End.GetAssFormatted());
+void AssDialogue::AppendEntryData(std::string &str) const {
+	str += Comment ? "Comment: " : "Dialogue: ";
+
+	append_field(str, Layer);
+	append_time(str, Start);
+	append_time(str, End);
 	append_unsafe_str(str, Style);
 	append_unsafe_str(str, Actor);
 	for (auto margin : Margin)
-		append_int(str, margin);
+		append_field(str, margin);
 	append_unsafe_str(str, Effect);
 
 	if (ExtradataIds.get().size() > 0) {
 		str += '{';
 		for (auto id : ExtradataIds.get()) {
 			str += '=';
-			boost::spirit::karma::generate(back_inserter(str), boost::spirit::karma::int_, id);
+			append_int(str, id);
 		}
 		str += '}';
 	}
 
-	for (auto c : Text.get()) {
-		if (c != '\n' && c != '\r')
-			str += c;
+	std::string const& text = Text.get();
+	if (text.find_first_of("\r\n") == std::string::npos)
+		str += text;
+	else {
+		for (auto c : text) {
+			if (c != '\n' && c != '\r')
+				str += c;
+		}
 	}
-
-	return str;
 }
 
 std::vector<std::unique_ptr<AssDialogueBlock>> AssDialogue::ParseTags() const {
+	return ParseTags(Text.get());
+}
+
+std::vector<std::unique_ptr<AssDialogueBlock>> AssDialogue::ParseTags(std::string const& text) {
 	std::vector<std::unique_ptr<AssDialogueBlock>> Blocks;
 
 	// Empty line, make an empty block
-	if (Text.get().empty()) {
+	if (text.empty()) {
 		Blocks.push_back(agi::make_unique<AssDialogueBlockPlain>());
 		return Blocks;
 	}
 
 	int drawingLevel = 0;
-	std::string const& text(Text.get());
 
 	for (size_t len = text.size(), cur = 0; cur < len; ) {
 		// Overrides block
@@ -266,6 +329,18 @@ plain:
 	return Blocks;
 }
 
+std::shared_ptr<const std::vector<std::unique_ptr<AssDialogueBlock>>> AssDialogue::GetParsedBlocks() const {
+	auto parsed = std::atomic_load(&parsed_blocks);
+	if (!parsed || parsed->text != Text) {
+		auto fresh = std::make_shared<ParsedBlocks>();
+		fresh->text = Text;
+		fresh->blocks = ParseTags();
+		parsed = fresh;
+		std::atomic_store(&parsed_blocks, parsed);
+	}
+	return std::shared_ptr<const std::vector<std::unique_ptr<AssDialogueBlock>>>(parsed, &parsed->blocks);
+}
+
 void AssDialogue::StripTags() {
 	Text = GetStrippedText();
 }
@@ -281,8 +356,13 @@ bool AssDialogue::CollidesWith(const AssDialogue *target) const {
 	return ((Start < target->Start) ? (target->Start < End) : (Start < target->End));
 }
 
-static std::string get_text_p(AssDialogueBlock *d) { return d->GetText(); }
 std::string AssDialogue::GetStrippedText() const {
-	auto blocks = ParseTags();
-	return join(blocks | agi::of_type<AssDialogueBlockPlain>() | transformed(get_text_p), "");
+	// Called on every line of the file when checking if it can be saved in
+	// other formats, so don't fill the parsed block cache with all of them
+	std::string ret;
+	for (auto const& block : ParseTags()) {
+		if (block->GetType() == AssBlockType::PLAIN)
+			ret += block->GetText();
+	}
+	return ret;
 }
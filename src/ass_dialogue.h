@@ -29,11 +29,13 @@
 
 #include "ass_entry.h"
 #include "ass_override.h"
+#include "flyweight_string.h"
 
 #include <libaegisub/ass/time.h>
 
 #include <array>
 #include <boost/flyweight.hpp>
+#include <memory>
 #include <vector>
 
 enum class AssBlockType {
@@ -135,26 +137,42 @@ struct AssDialogueBase {
 	/// Ending time
 	agi::Time End = 5000;
 	/// Style name
-	boost::flyweight<std::string> Style = boost::flyweight<std::string>("Default");
+	FlyweightString Style = FlyweightString("Default");
 	/// Actor name
-	boost::flyweight<std::string> Actor;
+	FlyweightString Actor;
 	/// Effect name
-	boost::flyweight<std::string> Effect;
+	FlyweightString Effect;
 	/// IDs of extradata entries for line
 	boost::flyweight<std::vector<uint32_t>> ExtradataIds;
 	/// Raw text data
-	boost::flyweight<std::string> Text;
+	FlyweightString Text;
 };
 
 class AssDialogue final : public AssEntry, public AssDialogueBase, public AssEntryListHook {
 	/// @brief Parse raw ASS data into everything else
 	/// @param data ASS line
 	void Parse(std::string const& data);
+
+	struct ParsedBlocks;
+	/// Blocks from the most recent GetParsedBlocks() call, along with the
+	/// text they were parsed from. Only accessed atomically, as lines can be
+	/// read from several threads at once.
+	mutable std::shared_ptr<const ParsedBlocks> parsed_blocks;
 public:
 	AssEntryGroup Group() const override { return AssEntryGroup::DIALOGUE; }
 
 	/// Parse text as ASS and return block information
 	std::vector<std::unique_ptr<AssDialogueBlock>> ParseTags() const;
+	/// Parse text which isn't part of a line into blocks
+	static std::vector<std::unique_ptr<AssDialogueBlock>> ParseTags(std::string const& text);
+
+	/// @brief Get the parsed blocks of the current text without copying them
+	///
+	/// The text is only reparsed if it has changed since the last call, so
+	/// this is much cheaper than ParseTags() for code which only reads the
+	/// blocks. The blocks are shared with every other caller and must not be
+	/// modified; use ParseTags() to get blocks to edit and pass to UpdateText().
+	std::shared_ptr<const std::vector<std::unique_ptr<AssDialogueBlock>>> GetParsedBlocks() const;
 
 	/// Strip all ASS tags from the text
 	void StripTags();
@@ -165,6 +183,8 @@ public:
 	/// Update the text of the line from parsed blocks
 	void UpdateText(std::vector<std::unique_ptr<AssDialogueBlock>>& blocks);
 	std::string GetEntryData() const;
+	/// Append the line in the same format as GetEntryData
+	void AppendEntryData(std::string &out) const;
 
 	/// Does this line collide with the passed line?
 	bool CollidesWith(const AssDialogue *target) const;
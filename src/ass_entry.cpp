@@ -21,6 +21,41 @@
 
 #include "ass_entry.h"
 
+#include <libaegisub/slab_pool.h>
+
+namespace {
+/// Entries are rounded up to a multiple of this size to pick a pool
+const size_t PoolGranularity = 32;
+/// Entries bigger than this go straight to the heap
+const size_t MaxPooledSize = 512;
+
+agi::SlabPool *PoolFor(size_t size) {
+	if (size > MaxPooledSize) return nullptr;
+
+	// Never destroyed, as entries can outlive static destruction
+	static agi::SlabPool **pools = [] {
+		auto pools = new agi::SlabPool*[MaxPooledSize / PoolGranularity];
+		for (size_t i = 0; i < MaxPooledSize / PoolGranularity; ++i)
+			pools[i] = new agi::SlabPool((i + 1) * PoolGranularity);
+		return pools;
+	}();
+	return pools[(size - 1) / PoolGranularity];
+}
+}
+
+void *AssEntry::operator new(size_t size) {
+	if (auto pool = PoolFor(size))
+		return pool->Allocate();
+	return ::operator new(size);
+}
+
+void AssEntry::operator delete(void *p, size_t size) {
+	if (PoolFor(size))
+		agi::SlabPool::Free(p);
+	else
+		::operator delete(p);
+}
+
 std::string const& AssEntry::GroupHeader() const {
 	static std::string ass_headers[] = {
 		"[Script Info]",
@@ -53,6 +53,12 @@ class AssEntry {
 public:
 	virtual ~AssEntry() = default;
 
+	/// Entries are allocated from pools of slabs shared by every entry of the
+	/// same size, as files are loaded, copied for undo and freed thousands
+	/// of lines at a time
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
+
 	/// Section of the file this entry belongs to
 	virtual AssEntryGroup Group() const=0;
 
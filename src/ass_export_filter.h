@@ -38,6 +38,7 @@
 #include <memory>
 #include <string>
 
+class AssDialogue;
 class AssFile;
 class AssExportFilterChain;
 class wxWindow;
@@ -71,6 +72,22 @@ public:
 	///                      to open a progress dialog
 	virtual void ProcessSubs(AssFile *subs, wxWindow *parent_window=nullptr)=0;
 
+	/// Prepare to process the dialogue lines of a file one at a time
+	/// @param subs Subtitles which will be processed
+	/// @return Can this filter process each line on its own? If not,
+	///         ProcessSubs is used instead.
+	///
+	/// Filters which process lines on their own are run together in a single
+	/// pass over the lines, so earlier filters may not have processed the
+	/// lines yet when this is called. Only the other sections of the file
+	/// should be looked at here.
+	virtual bool BeginLines(AssFile *subs) { return false; }
+
+	/// Process a single dialogue line after BeginLines has returned true
+	///
+	/// This may be called for several lines at once from different threads.
+	virtual void ProcessLine(AssDialogue *line) const { }
+
 	/// Draw setup controls
 	/// @param parent Parent window to add controls to
 	/// @param c Project context
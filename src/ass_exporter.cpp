@@ -34,6 +34,7 @@
 
 #include "ass_exporter.h"
 
+#include "ass_dialogue.h"
 #include "ass_export_filter.h"
 #include "ass_file.h"
 #include "compat.h"
@@ -41,9 +42,36 @@
 #include "project.h"
 #include "subtitle_format.h"
 
+#include <libaegisub/parallel.h>
+
+#include <algorithm>
 #include <memory>
 #include <wx/sizer.h>
 
+namespace {
+/// Number of lines each thread takes at a time when running line filters
+const size_t lines_per_batch = 256;
+
+/// Run the filters which process lines on their own over all of the lines
+/// in a single pass, then clear the list
+void run_line_filters(AssFile& subs, std::vector<AssExportFilter *>& line_filters) {
+	if (line_filters.empty()) return;
+
+	std::vector<AssDialogue *> lines;
+	for (auto& line : subs.Events)
+		lines.push_back(&line);
+
+	agi::parallel_for(0, lines.size(), lines_per_batch, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			for (auto filter : line_filters)
+				filter->ProcessLine(lines[i]);
+		}
+	});
+
+	line_filters.clear();
+}
+}
+
 AssExporter::AssExporter(agi::Context *c) : c(c) { }
 
 void AssExporter::DrawSettings(wxWindow *parent, wxSizer *target_sizer) {
@@ -79,19 +107,55 @@ std::vector<std::string> AssExporter::GetAllFilterNames() const {
 	return names;
 }
 
-void AssExporter::Export(agi::fs::path const& filename, std::string const& charset, wxWindow *export_dialog) {
-	AssFile subs(*c->ass);
-
+void AssExporter::ApplyFilters(AssFile &subs, wxWindow *export_dialog) {
+	// Consecutive filters which can process each line on its own are run
+	// together in one pass over the lines
+	std::vector<AssExportFilter *> line_filters;
 	for (auto filter : filters) {
 		filter->LoadSettings(is_default, c);
+		if (filter->BeginLines(&subs)) {
+			line_filters.push_back(filter);
+			continue;
+		}
+
+		run_line_filters(subs, line_filters);
 		filter->ProcessSubs(&subs, export_dialog);
 	}
+	run_line_filters(subs, line_filters);
+}
+
+void AssExporter::Export(agi::fs::path const& filename, std::string const& charset, wxWindow *export_dialog) {
+	Export(std::vector<agi::fs::path>{filename}, charset, export_dialog);
+}
 
-	const SubtitleFormat *writer = SubtitleFormat::GetWriter(filename);
-	if (!writer)
-		throw agi::InvalidInputException("Unknown file type.");
+void AssExporter::Export(std::vector<agi::fs::path> const& files, std::string const& charset, wxWindow *export_dialog) {
+	std::vector<const SubtitleFormat *> writers;
+	for (auto const& file : files) {
+		const SubtitleFormat *writer = SubtitleFormat::GetWriter(file);
+		if (!writer)
+			throw agi::InvalidInputException("Unknown file type: " + file.filename().string());
+		writers.push_back(writer);
+	}
+
+	AssFile subs(*c->ass);
+	ApplyFilters(subs, export_dialog);
+
+	// The writers only read the filtered file, making their own copy if they
+	// need to change anything, so they can all share it. The ones which show
+	// dialogs have to run on this thread, so do them first.
+	auto const& fps = c->project->Timecodes();
+	std::vector<size_t> background;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (writers[i]->PromptsOnWrite())
+			writers[i]->ExportFile(&subs, files[i], fps, charset);
+		else
+			background.push_back(i);
+	}
 
-	writer->ExportFile(&subs, filename, c->project->Timecodes(), charset);
+	agi::parallel_for(0, background.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			writers[background[i]]->ExportFile(&subs, files[background[i]], fps, charset);
+	});
 }
 
 wxSizer *AssExporter::GetSettingsSizer(std::string const& name) {
@@ -39,6 +39,7 @@
 #include <vector>
 
 class AssExportFilter;
+class AssFile;
 namespace agi { struct Context; }
 class wxSizer;
 class wxWindow;
@@ -69,12 +70,30 @@ public:
 	/// @throws std::string if filter is not found
 	void AddFilter(std::string const& name);
 
+	/// Add a filter which isn't registered, such as one of a headless
+	/// automation script, to the list of filters to be run
+	void AddFilter(AssExportFilter *filter) { filters.push_back(filter); }
+
+	/// Apply the selected export filters to a file
+	/// @param subs File to filter, normally a copy of the context's file
+	/// @param parent_window Parent window the filters should use when opening dialogs
+	void ApplyFilters(AssFile &subs, wxWindow *parent_window = nullptr);
+
 	/// Apply selected export filters and save with the given charset
 	/// @param file Target filename
 	/// @param charset Target charset
 	/// @param parent_window Parent window the filters should use when opening dialogs
 	void Export(agi::fs::path const& file, std::string const& charset, wxWindow *parent_window= nullptr);
 
+	/// @brief Apply selected export filters once and save the result in several formats
+	/// @param files Target filenames, whose extensions determine the formats
+	/// @param charset Target charset
+	/// @param parent_window Parent window the filters should use when opening dialogs
+	///
+	/// Writers which don't need to ask the user anything are run in parallel.
+	/// If any of the files has an unknown extension nothing is written.
+	void Export(std::vector<agi::fs::path> const& files, std::string const& charset, wxWindow *parent_window = nullptr);
+
 	/// Add configuration panels for all registered filters to the target sizer
 	/// @param parent Parent window for controls
 	/// @param target_sizer Sizer to add configuration panels to
@@ -23,13 +23,97 @@
 #include "ass_style_storage.h"
 #include "options.h"
 
+#include <libaegisub/trace.h>
+
 #include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem/path.hpp>
 #include <cassert>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <wx/string.h>
+
+namespace {
+/// Minimum number of lines to split sorting between threads
+const size_t min_parallel_sort = 20000;
+
+/// Stable sort, split between threads for large inputs
+template<typename T, typename Comp>
+void parallel_stable_sort(std::vector<T>& vec, Comp comp) {
+	size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+	if (vec.size() < min_parallel_sort)
+		thread_count = 1;
+
+	const size_t chunk = (vec.size() + thread_count - 1) / thread_count;
+	auto chunk_begin = [&](size_t i) { return vec.begin() + std::min(i * chunk, vec.size()); };
+
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < thread_count; ++t)
+		threads.emplace_back([&, t] { std::stable_sort(chunk_begin(t), chunk_begin(t + 1), comp); });
+	std::stable_sort(chunk_begin(0), chunk_begin(1), comp);
+	for (auto& thread : threads)
+		thread.join();
+
+	// Merge neighbouring chunks until there's only one left. inplace_merge
+	// puts equal elements from the earlier chunk first, so this is stable.
+	for (size_t width = 1; width < thread_count; width *= 2) {
+		for (size_t t = 0; t + width < thread_count; t += 2 * width)
+			std::inplace_merge(chunk_begin(t), chunk_begin(t + width),
+				chunk_begin(std::min(t + 2 * width, thread_count)), comp);
+	}
+}
+
+/// Get the string field compared by a comparison function, if it's one of
+/// the ones which compare strings
+FlyweightString AssDialogueBase::*string_field(AssFile::CompFunc comp) {
+	if (comp == AssFile::CompStyle) return &AssDialogueBase::Style;
+	if (comp == AssFile::CompActor) return &AssDialogueBase::Actor;
+	if (comp == AssFile::CompEffect) return &AssDialogueBase::Effect;
+	return nullptr;
+}
+
+/// Stable sort of an entire list, relinking it once at the end
+void sort_lines(EntryList<AssDialogue>& lst, AssFile::CompFunc comp) {
+	std::vector<AssDialogue *> lines;
+	for (auto& line : lst)
+		lines.push_back(&line);
+
+	if (auto field = string_field(comp)) {
+		// Comparing the strings for every pair of lines is slow and there
+		// are usually only a few distinct values, so sort the distinct values
+		// once and then sort the lines by the rank of their value
+		std::unordered_map<std::string const*, size_t> ranks;
+		for (auto line : lines)
+			ranks.emplace(&(line->*field).get(), 0);
+
+		std::vector<std::string const*> values;
+		values.reserve(ranks.size());
+		for (auto const& rank : ranks)
+			values.push_back(rank.first);
+		std::sort(begin(values), end(values), [](std::string const* a, std::string const* b) { return *a < *b; });
+		for (size_t i = 0; i < values.size(); ++i)
+			ranks[values[i]] = i;
+
+		std::vector<std::pair<size_t, AssDialogue *>> ranked;
+		ranked.reserve(lines.size());
+		for (auto line : lines)
+			ranked.emplace_back(ranks[&(line->*field).get()], line);
+		parallel_stable_sort(ranked, [](std::pair<size_t, AssDialogue *> const& a, std::pair<size_t, AssDialogue *> const& b) {
+			return a.first < b.first;
+		});
+		for (size_t i = 0; i < lines.size(); ++i)
+			lines[i] = ranked[i].second;
+	}
+	else
+		parallel_stable_sort(lines, [=](AssDialogue *a, AssDialogue *b) { return comp(*a, *b); });
+
+	lst.clear();
+	for (auto line : lines)
+		lst.push_back(*line);
+}
+}
 
 AssFile::AssFile() { }
 
@@ -98,14 +182,14 @@ EntryList<AssDialogue>::iterator AssFile::iterator_to(AssDialogue& line) {
 	return in_list ? Events.iterator_to(line) : Events.end();
 }
 
-void AssFile::InsertAttachment(agi::fs::path const& filename) {
+void AssFile::InsertAttachment(agi::fs::path const& filename, std::vector<int> const* characters) {
 	AssEntryGroup group = AssEntryGroup::GRAPHIC;
 
 	auto ext = boost::to_lower_copy(filename.extension().string());
 	if (ext == ".ttf" || ext == ".ttc" || ext == ".pfb")
 		group = AssEntryGroup::FONT;
 
-	Attachments.emplace_back(filename, group);
+	Attachments.emplace_back(filename, group, characters);
 }
 
 std::string AssFile::GetScriptInfo(std::string const& key) const {
@@ -168,17 +252,76 @@ AssStyle *AssFile::GetStyle(std::string const& name) {
 	return nullptr;
 }
 
+struct AssFile::PendingCommit {
+	wxString desc;
+	int type;
+	int amend_id;
+	/// Did every commit list the lines it changed?
+	bool have_lines;
+	std::vector<AssDialogue *> lines;
+};
+
+void AssFile::EndTransaction() {
+	if (--transaction_depth > 0 || !pending_commit) return;
+
+	auto commit = std::move(pending_commit);
+	if (commit->have_lines) {
+		std::sort(begin(commit->lines), end(commit->lines));
+		commit->lines.erase(std::unique(begin(commit->lines), end(commit->lines)), end(commit->lines));
+	}
+	else
+		commit->lines.clear();
+	Commit(commit->desc, commit->type, commit->amend_id, commit->lines);
+}
+
 int AssFile::Commit(wxString const& desc, int type, int amend_id, AssDialogue *single_line) {
+	std::vector<AssDialogue *> lines;
+	if (single_line)
+		lines.push_back(single_line);
+	return Commit(desc, type, amend_id, lines);
+}
+
+int AssFile::Commit(wxString const& desc, int type, int amend_id, std::vector<AssDialogue *> const& lines) {
+	if (transaction_depth > 0) {
+		if (!pending_commit) {
+			pending_commit.reset(new PendingCommit{desc, type, amend_id, !lines.empty(), lines});
+			return amend_id;
+		}
+
+		auto& commit = *pending_commit;
+		// COMMIT_NEW can't be combined with anything else
+		if (commit.type == COMMIT_NEW || type == COMMIT_NEW)
+			commit.type = COMMIT_NEW;
+		else
+			commit.type |= type;
+		commit.have_lines = commit.have_lines && !lines.empty();
+		if (commit.have_lines)
+			commit.lines.insert(end(commit.lines), begin(lines), end(lines));
+		return commit.amend_id;
+	}
+
+	AGI_TRACE_SCOPE("subs/commit");
 	if (type == COMMIT_NEW || (type & COMMIT_DIAG_ADDREM) || (type & COMMIT_ORDER)) {
 		int i = 0;
 		for (auto& event : Events)
 			event.Row = i++;
 	}
 
+	AssDialogue *single_line = lines.size() == 1 ? lines.front() : nullptr;
+
+	// The changed lines are only enough to go on if nothing else changed.
+	// Listeners can commit in response to a commit, so the outer commit's
+	// lines are restored afterwards.
+	std::vector<const AssDialogue *> changed;
+	if (type != COMMIT_NEW && !(type & ~COMMIT_DIAG_FULL))
+		changed.assign(lines.begin(), lines.end());
+	changed.swap(changed_lines);
+
 	PushState({desc, &amend_id, single_line});
 
 	AnnounceCommit(type, single_line);
 
+	changed.swap(changed_lines);
 	return amend_id;
 }
 
@@ -207,7 +350,7 @@ void AssFile::Sort(CompFunc comp, std::set<AssDialogue*> const& limit) {
 
 void AssFile::Sort(EntryList<AssDialogue> &lst, CompFunc comp, std::set<AssDialogue*> const& limit) {
 	if (limit.empty()) {
-		lst.sort(comp);
+		sort_lines(lst, comp);
 		return;
 	}
 
@@ -220,7 +363,7 @@ void AssFile::Sort(EntryList<AssDialogue> &lst, CompFunc comp, std::set<AssDialo
 		// sort doesn't support only sorting a sublist, so move them to a temp list
 		EntryList<AssDialogue> tmp;
 		tmp.splice(tmp.begin(), lst, begin, end);
-		tmp.sort(comp);
+		sort_lines(tmp, comp);
 		lst.splice(end, tmp);
 
 		begin = --end;
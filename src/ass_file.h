@@ -34,6 +34,7 @@
 
 #include <boost/intrusive/list.hpp>
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -82,6 +83,15 @@ class AssFile {
 	/// A set of changes has been committed to the file (AssFile::COMMITType)
 	agi::signal::Signal<int, const AssDialogue*> AnnounceCommit;
 	agi::signal::Signal<AssFileCommit> PushState;
+	/// Lines changed by the commit currently being announced
+	std::vector<const AssDialogue *> changed_lines;
+
+	/// Number of CommitTransactions open on this file
+	int transaction_depth = 0;
+	/// Commits made during the current transaction, merged into one
+	struct PendingCommit;
+	std::unique_ptr<PendingCommit> pending_commit;
+	void EndTransaction();
 public:
 	/// The lines in the file
 	std::vector<AssInfo> Info;
@@ -105,7 +115,8 @@ public:
 	/// @param style_catalog Style catalog name to fill styles from, blank to use default style
 	void LoadDefault(bool defline = true, std::string const& style_catalog = std::string());
 	/// Attach a file to the ass file
-	void InsertAttachment(agi::fs::path const& filename);
+	/// @param characters If not null, fonts are subset to these characters
+	void InsertAttachment(agi::fs::path const& filename, std::vector<int> const* characters = nullptr);
 	/// Get the names of all of the styles available
 	std::vector<std::string> GetStyles() const;
 	/// @brief Get a style by name
@@ -179,6 +190,45 @@ public:
 	/// @return Unique identifier for the new undo group
 	int Commit(wxString const& desc, int type, int commitId = -1, AssDialogue *single_line = nullptr);
 
+	/// @brief Commit changes to a set of existing lines
+	/// @param desc     Undo description
+	/// @param type     Type of changes made to the file in this commit
+	/// @param commitId Commit to amend rather than pushing a new commit
+	/// @param lines    Lines which were changed
+	/// @return Unique identifier for the new undo group
+	///
+	/// Commit listeners can get the lines from ChangedLines() to update just
+	/// what's affected by them rather than everything.
+	int Commit(wxString const& desc, int type, int commitId, std::vector<AssDialogue *> const& lines);
+
+	/// @class CommitTransaction
+	/// @brief Merge the commits made to a file while this exists into one
+	///
+	/// For operations which commit several times in a row. Rather than
+	/// listeners updating and the undo stack being pushed for each one, a
+	/// single commit is made when the transaction ends, with all of the
+	/// change types and changed lines of the commits made during it and the
+	/// description and amend ID of the first. Transactions can be nested,
+	/// in which case only the outermost one commits.
+	///
+	/// Commit returns the first commit's amend ID during a transaction, as
+	/// the real ID isn't known until the transaction ends.
+	class CommitTransaction {
+		AssFile &file;
+		CommitTransaction(CommitTransaction const&) = delete;
+		CommitTransaction& operator=(CommitTransaction const&) = delete;
+	public:
+		CommitTransaction(AssFile &file) : file(file) { ++file.transaction_depth; }
+		~CommitTransaction() { file.EndTransaction(); }
+	};
+
+	/// @brief Get the lines changed by the commit currently being announced
+	///
+	/// Only valid in commit listeners. Empty unless the commit only changed
+	/// the fields of some existing lines, in which case the listener can
+	/// update just those lines.
+	std::vector<const AssDialogue *> const& ChangedLines() const { return changed_lines; }
+
 	/// Comparison function for use when sorting
 	typedef bool (*CompFunc)(AssDialogue const& lft, AssDialogue const& rgt);
 
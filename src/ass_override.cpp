@@ -39,10 +39,10 @@
 
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/algorithm/string/trim.hpp>
 #include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include <functional>
+#include <mutex>
 
 using namespace boost::adaptors;
 
@@ -54,6 +54,11 @@ AssOverrideParameter::AssOverrideParameter(VariableDataType type, AssParameterCl
 
 AssOverrideParameter::~AssOverrideParameter() = default;
 
+bool AssOverrideParameter::HasNumber() const {
+	return type == VariableDataType::INT || type == VariableDataType::FLOAT || type == VariableDataType::BOOL
+		|| classification == AssParameterClass::ALPHA;
+}
+
 template<> std::string AssOverrideParameter::Get<std::string>() const {
 	if (omitted) throw agi::InternalError("AssOverrideParameter::Get() called on omitted parameter");
 	if (block.get()) {
@@ -66,18 +71,19 @@ template<> std::string AssOverrideParameter::Get<std::string>() const {
 }
 
 template<> int AssOverrideParameter::Get<int>() const {
-	if (classification == AssParameterClass::ALPHA)
-		// &Hxx&, but vsfilter lets you leave everything out
-		return mid<int>(0, strtol(std::find_if(value.c_str(), value.c_str() + value.size(), isxdigit), nullptr, 16), 255);
+	if (HasNumber() && !omitted)
+		return integer;
 	return atoi(Get<std::string>().c_str());
 }
 
 template<> double AssOverrideParameter::Get<double>() const {
+	if (HasNumber() && !omitted)
+		return number;
 	return atof(Get<std::string>().c_str());
 }
 
 template<> float AssOverrideParameter::Get<float>() const {
-	return atof(Get<std::string>().c_str());
+	return Get<double>();
 }
 
 template<> bool AssOverrideParameter::Get<bool>() const {
@@ -85,6 +91,13 @@ template<> bool AssOverrideParameter::Get<bool>() const {
 }
 
 template<> agi::Color AssOverrideParameter::Get<agi::Color>() const {
+	// &HBBGGRR&, which is what nearly every override tag colour looks like,
+	// is decoded here rather than going through the general colour parser
+	if (!omitted && !block && value.size() == 9 && value[0] == '&' && (value[1] == 'H' || value[1] == 'h') && value[8] == '&'
+		&& std::all_of(value.begin() + 2, value.begin() + 8, [](char c) { return !!isxdigit((unsigned char)c); })) {
+		unsigned long bgr = strtoul(value.c_str() + 2, nullptr, 16);
+		return agi::Color(bgr & 0xFF, (bgr >> 8) & 0xFF, (bgr >> 16) & 0xFF);
+	}
 	return Get<std::string>();
 }
 
@@ -98,8 +111,17 @@ template<> AssDialogueBlockOverride *AssOverrideParameter::Get<AssDialogueBlockO
 
 template<> void AssOverrideParameter::Set<std::string>(std::string new_value) {
 	omitted = false;
-	value = new_value;
+	value = std::move(new_value);
 	block.reset();
+
+	const char *str = value.c_str();
+	if (classification == AssParameterClass::ALPHA)
+		// &Hxx&, but vsfilter lets you leave everything out
+		integer = mid<int>(0, strtol(std::find_if(str, str + value.size(), isxdigit), nullptr, 16), 255);
+	else if (HasNumber())
+		integer = atoi(str);
+	if (HasNumber())
+		number = atof(str);
 }
 
 template<> void AssOverrideParameter::Set<int>(int new_value) {
@@ -174,9 +196,11 @@ struct AssOverrideTagProto {
 };
 
 static std::vector<AssOverrideTagProto> proto;
-static void load_protos() {
-	if (!proto.empty()) return;
-
+/// Indices in proto of the tags whose names start with each character after
+/// the backslash, in the same order as proto, so that looking up a tag only
+/// compares it against the few names it could be
+static std::vector<size_t> proto_index[256];
+static void init_protos() {
 	proto.resize(56);
 	int i = 0;
 
@@ -305,25 +329,43 @@ static void load_protos() {
 	proto[i].AddParam(VariableDataType::INT, AssParameterClass::RELATIVE_TIME_START,OPTIONAL_3 | OPTIONAL_4);
 	proto[i].AddParam(VariableDataType::FLOAT, AssParameterClass::NORMAL,OPTIONAL_2 | OPTIONAL_4);
 	proto[i].AddParam(VariableDataType::BLOCK);
+
+	for (size_t j = 0; j < proto.size(); ++j)
+		proto_index[static_cast<unsigned char>(proto[j].name[1])].push_back(j);
 }
 
-std::vector<std::string> tokenize(const std::string &text) {
-	std::vector<std::string> paramList;
-	paramList.reserve(6);
+/// Lines may be parsed on several threads at once
+static void load_protos() {
+	static std::once_flag loaded;
+	std::call_once(loaded, init_protos);
+}
+
+typedef std::pair<const char *, const char *> Token;
+
+Token trimmed(const char *begin, const char *end) {
+	while (begin < end && isspace(static_cast<unsigned char>(*begin))) ++begin;
+	while (end > begin && isspace(static_cast<unsigned char>(end[-1]))) --end;
+	return Token(begin, end);
+}
 
-	if (text.empty())
-		return paramList;
+/// Split the parameters of a tag into ranges of the tag's text, so that each
+/// one is only copied once, into the parameter it's for
+void tokenize(const char *text, const char *end, std::vector<Token> &paramList) {
+	paramList.clear();
+
+	if (text == end)
+		return;
 
 	if (text[0] != '(') {
 		// There's just one parameter (because there's no parentheses)
 		// This means text is all our parameters
-		paramList.emplace_back(boost::trim_copy(text));
-		return paramList;
+		paramList.push_back(trimmed(text, end));
+		return;
 	}
 
 	// Ok, so there are parentheses used here, so there may be more than one parameter
 	// Enter fullscale parsing!
-	size_t i = 0, textlen = text.size();
+	size_t i = 0, textlen = end - text;
 	int parDepth = 1;
 	while (i < textlen && parDepth > 0) {
 		// Just skip until next ',' or ')', whichever comes first
@@ -344,22 +386,23 @@ std::vector<std::string> tokenize(const std::string &text) {
 			i++;
 		}
 		// i now points to the first character not member of this parameter
-		paramList.emplace_back(boost::trim_copy(text.substr(start, i - start)));
+		paramList.push_back(trimmed(text + start, text + i));
 	}
 
 	if (i+1 < textlen) {
 		// There's some additional garbage after the parentheses
 		// Just add it in for completeness
-		paramList.emplace_back(text.begin() + i + 1, text.end());
+		paramList.emplace_back(text + i + 1, end);
 	}
-	return paramList;
 }
 
-void parse_parameters(AssOverrideTag *tag, const std::string &text, AssOverrideTagProto::iterator proto_it) {
+void parse_parameters(AssOverrideTag *tag, const char *text, const char *end, AssOverrideTagProto::iterator proto_it) {
 	tag->Clear();
 
 	// Tokenize text, attempting to find all parameters
-	std::vector<std::string> paramList = tokenize(text);
+	std::vector<Token> paramList;
+	paramList.reserve(6);
+	tokenize(text, end, paramList);
 	size_t totalPars = paramList.size();
 
 	int parsFlag = 1 << (totalPars - 1); // Get optional parameters flag
@@ -377,7 +420,8 @@ void parse_parameters(AssOverrideTag *tag, const std::string &text, AssOverrideT
 		if (!(curproto.optional & parsFlag) || curPar >= totalPars)
 			continue;
 
-		tag->Params.back().Set(paramList[curPar++]);
+		auto const& token = paramList[curPar++];
+		tag->Params.back().Set(std::string(token.first, token.second));
 	}
 }
 
@@ -395,15 +439,18 @@ void AssDialogueBlockOverride::ParseTags() {
 				--depth;
 		}
 		else if (text[i] == '\\') {
-			Tags.emplace_back(text.substr(start, i - start));
+			Tags.emplace_back();
+			Tags.back().SetText(&text[start], &text[i]);
 			start = i;
 		}
 		else if (text[i] == '(')
 			++depth;
 	}
 
-	if (!text.empty())
-		Tags.emplace_back(text.substr(start));
+	if (!text.empty()) {
+		Tags.emplace_back();
+		Tags.back().SetText(&text[start], &text[0] + text.size());
+	}
 }
 
 void AssDialogueBlockOverride::AddTag(std::string const& tag) {
@@ -441,18 +488,26 @@ void AssOverrideTag::Clear() {
 }
 
 void AssOverrideTag::SetText(const std::string &text) {
+	SetText(text.data(), text.data() + text.size());
+}
+
+void AssOverrideTag::SetText(const char *begin, const char *end) {
 	load_protos();
-	for (auto cur = proto.begin(); cur != proto.end(); ++cur) {
-		if (boost::starts_with(text, cur->name)) {
-			Name = cur->name;
-			parse_parameters(this, text.substr(Name.size()), cur);
-			valid = true;
-			return;
+	const size_t len = end - begin;
+	if (len >= 2 && *begin == '\\') {
+		for (size_t i : proto_index[static_cast<unsigned char>(begin[1])]) {
+			auto const& name = proto[i].name;
+			if (name.size() <= len && std::equal(name.begin(), name.end(), begin)) {
+				Name = name;
+				parse_parameters(this, begin + name.size(), end, proto.begin() + i);
+				valid = true;
+				return;
+			}
 		}
 	}
 
 	// Junk tag
-	Name = text;
+	Name.assign(begin, end);
 	valid = false;
 }
 
@@ -67,6 +67,13 @@ class AssOverrideParameter {
 	mutable std::unique_ptr<AssDialogueBlockOverride> block;
 	VariableDataType type;
 
+	/// value converted to a number when it was set, so that reading numeric
+	/// parameters doesn't have to parse the string every time
+	double number = 0.;
+	int integer = 0;
+	/// Are number and integer valid for this parameter?
+	bool HasNumber() const;
+
 public:
 	AssOverrideParameter(VariableDataType type, AssParameterClass classification);
 	AssOverrideParameter(AssOverrideParameter&&) = default;
@@ -102,5 +109,6 @@ public:
 	bool IsValid() const { return valid; }
 	void Clear();
 	void SetText(const std::string &text);
+	void SetText(const char *begin, const char *end);
 	operator std::string() const;
 };
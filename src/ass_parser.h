@@ -40,4 +40,9 @@ public:
 	~AssParser();
 
 	void AddLine(std::string const& data);
+
+	/// Is the parser in the events section? Events don't depend on anything
+	/// else in the file, so the caller may parse them itself instead of
+	/// passing them to AddLine, as long as they end up in the file in order.
+	bool InEvents() const { return !attach && state == &AssParser::ParseEventLine; }
 };
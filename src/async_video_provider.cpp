@@ -24,34 +24,42 @@
 #include "video_provider_manager.h"
 
 #include <libaegisub/dispatch.h>
+#include <libaegisub/trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
 
 enum {
 	NEW_SUBS_FILE = -1,
 	SUBS_FILE_ALREADY_LOADED = -2
 };
 
-std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, double time, bool raw) {
-	// Find an unused buffer to use or allocate a new one if needed
-	std::shared_ptr<VideoFrame> frame;
-	for (auto& buffer : buffers) {
-		if (buffer.use_count() == 1) {
-			frame = buffer;
-			break;
-		}
-	}
-
-	if (!frame) {
-		frame = std::make_shared<VideoFrame>();
-		buffers.push_back(frame);
-	}
-
+/// Number of frames to prefetch when moving forwards
+static const int prefetch_ahead = 15;
+/// Maximum memory used by cached subtitle overlays
+static const size_t max_overlay_cache_size = 32 * 1024 * 1024;
+/// Milliseconds the subtitles of each frame have to render in while
+/// scrubbing, and during playback when the frame rate can't be worked out
+static const double default_frame_budget = 40.;
+/// Smallest fraction of the frame size subtitles are rendered at
+static const double min_motion_scale = 0.25;
+
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::DecodeFrame(int frame_number) {
+	AGI_TRACE_SCOPE("video/decode");
 	try {
-		source_provider->GetFrame(frame_number, *frame);
+		return source_provider->GetSharedFrame(frame_number);
 	}
 	catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
+}
 
-	if (raw || !subs_provider || !subs) return frame;
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::RenderFrame(std::shared_ptr<const VideoFrame> source, int frame_number, double time, double budget) {
+	// Without subtitles to draw the source's frame can be handed out as is
+	if (!subs_provider || !subs) return source;
 
+	AGI_TRACE_SCOPE("video/subtitles");
 	try {
 		if (single_frame != frame_number && single_frame != SUBS_FILE_ALREADY_LOADED) {
 			// Generally edits and seeks come in groups; if the last thing done
@@ -60,6 +68,7 @@ std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, doub
 			// an edit, only export the currently visible lines (because the
 			// other lines will probably not be viewed before the file changes
 			// again), and if it's a different frame, export the entire file.
+			AGI_TRACE_SCOPE("video/subtitles/load");
 			if (single_frame != NEW_SUBS_FILE) {
 				subs_provider->LoadSubtitles(subs.get());
 				single_frame = SUBS_FILE_ALREADY_LOADED;
@@ -69,18 +78,201 @@ std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, doub
 				single_frame = frame_number;
 				subs_provider->LoadSubtitles(subs.get(), time);
 			}
+			ClearOverlays();
 		}
 	}
 	catch (agi::Exception const& err) { throw SubtitlesProviderErrorEvent(err.GetMessage()); }
 
+	std::shared_ptr<const SubtitleOverlay> overlay;
+	try {
+		overlay = GetOverlay(source->width, source->height, time, budget);
+	}
+	catch (agi::UserCancelException const&) {
+		return source;
+	}
+
+	// Frames with no subtitles visible don't need to be copied
+	if (overlay && overlay->images.empty()) {
+		drawn_frame.reset();
+		return source;
+	}
+
+	// Subtitles are always drawn in RGB, and the RGB version of the source
+	// is kept to redraw parts of it when only the subtitles change
+	if (source != drawn_source) {
+		drawn_source = source;
+		drawn_frame.reset();
+		if (source->format != VideoFrameFormat::BGRA)
+			ConvertToBGRA(*source, drawn_source_bgra);
+	}
+	VideoFrame const& raw = source->format == VideoFrameFormat::BGRA ? *source : drawn_source_bgra;
+
+	// When only the subtitles have changed since the last frame, such as
+	// while typing on a paused frame, only the area where the old and new
+	// images differ has to be redrawn
+	if (overlay && drawn_frame && drawn_overlay && drawn_overlay->width == overlay->width && drawn_overlay->height == overlay->height) {
+		auto area = overlay->ChangedArea(*drawn_overlay);
+		drawn_overlay = overlay;
+		if (area.empty()) return drawn_frame;
+
+		auto frame = GetBuffer();
+		*frame = *drawn_frame;
+		const int first_row = frame->flipped ? (int)frame->height - area.y - area.h : area.y;
+		for (int y = first_row; y < first_row + area.h; ++y)
+			memcpy(&frame->data[y * frame->pitch + area.x * 4], &raw.data[y * raw.pitch + area.x * 4], area.w * 4);
+		{
+			AGI_TRACE_SCOPE("video/blend");
+			overlay->Blend(*frame, area);
+		}
+		CountBuffers();
+
+		frame->id = ++last_frame_id;
+		frame->base_id = drawn_frame->id;
+		frame->changed = area;
+		frame->changed.y = first_row;
+		drawn_frame = frame;
+		return frame;
+	}
+
+	auto frame = GetBuffer();
+	*frame = raw;
+	CountBuffers();
+	frame->id = ++last_frame_id;
+	frame->base_id = 0;
+
 	try {
-		subs_provider->DrawSubtitles(*frame, time / 1000.);
+		if (overlay) {
+			AGI_TRACE_SCOPE("video/blend");
+			overlay->Blend(*frame);
+		}
+		else
+			subs_provider->DrawSubtitles(*frame, time / 1000.);
 	}
 	catch (agi::UserCancelException const&) { }
 
+	drawn_overlay = overlay;
+	if (overlay)
+		drawn_frame = frame;
+	else
+		drawn_frame.reset();
 	return frame;
 }
 
+std::shared_ptr<VideoFrame> AsyncVideoProvider::GetBuffer() {
+	// Find an unused buffer to draw the subtitles into or allocate a new one
+	// if needed
+	for (auto& buffer : buffers) {
+		if (buffer.use_count() == 1)
+			return buffer;
+	}
+
+	buffers.push_back(std::make_shared<VideoFrame>());
+	return buffers.back();
+}
+
+void AsyncVideoProvider::CountBuffers() {
+	size_t size = drawn_source_bgra.data.capacity();
+	for (auto const& buffer : buffers)
+		size += buffer->data.capacity();
+	buffer_memory = size;
+}
+
+std::shared_ptr<const SubtitleOverlay> AsyncVideoProvider::GetOverlay(int width, int height, double time, double budget) {
+	const int key = int(time);
+	auto it = overlays.find(key);
+	// Frames shown still have to be full quality, but anything will do for
+	// frames which are only on screen briefly
+	if (it != overlays.end() && it->second->width == width && it->second->height == height && (budget > 0 || it->second->scale == 1.)) {
+		agi::trace::Count("video/overlay/hit");
+		return it->second;
+	}
+
+	agi::trace::Count("video/overlay/miss");
+	auto start = std::chrono::steady_clock::now();
+	auto overlay = RenderScaledOverlay(width, height, time / 1000., RenderScale(budget));
+	if (!overlay) return nullptr;
+	if (budget > 0)
+		AdaptMotionScale(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), budget);
+	if (overlay->provisional)
+		RefreshWhenReady();
+	else
+		CacheOverlay(key, overlay);
+	return overlay;
+}
+
+double AsyncVideoProvider::RenderScale(double budget) const {
+	return budget > 0 && adaptive_quality ? motion_scale : 1.;
+}
+
+std::shared_ptr<const SubtitleOverlay> AsyncVideoProvider::RenderScaledOverlay(int width, int height, double time, double scale) {
+	if (scale >= 1.)
+		return subs_provider->RenderOverlay(width, height, time);
+
+	// libass scales everything to the frame size, so rendering at a smaller
+	// size makes blur and borders proportionally cheaper
+	auto overlay = subs_provider->RenderOverlay(std::max(1, int(width * scale + .5)), std::max(1, int(height * scale + .5)), time);
+	if (!overlay) return nullptr;
+	AGI_TRACE_SCOPE("video/subtitles/upscale");
+	return overlay->Upscale(width, height);
+}
+
+void AsyncVideoProvider::AdaptMotionScale(double ms, double budget) {
+	// Drop quickly when rendering falls behind, but only go back up once
+	// there's plenty of room, as each step up makes rendering take nearly
+	// twice as long and the quality shouldn't flicker between steps
+	if (ms > budget)
+		motion_scale = std::max(min_motion_scale, motion_scale * .75);
+	else if (ms < budget / 3 && motion_scale < 1.)
+		motion_scale = std::min(1., motion_scale / .75);
+	agi::trace::Sample("video/subtitles/scale_percent", static_cast<int64_t>(motion_scale * 100));
+}
+
+void AsyncVideoProvider::RefreshWhenReady() {
+	if (waiting_for_fonts) return;
+	waiting_for_fonts = true;
+
+	auto state = callback_state;
+	subs_provider->NotifyWhenReady([state] {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		auto self = state->self;
+		if (!self) return;
+
+		uint_fast32_t req_version = ++self->version;
+		self->worker->Async([=] {
+			self->ClearOverlays();
+			self->ProcAsync(req_version, false);
+		});
+	});
+}
+
+void AsyncVideoProvider::CacheOverlay(int key, std::shared_ptr<const SubtitleOverlay> overlay) {
+	auto it = overlays.find(key);
+	if (it != overlays.end()) {
+		overlay_cache_size -= it->second->GetSize();
+		overlays.erase(it);
+	}
+
+	// Evict the overlays furthest from this one, as they're the least likely
+	// to be needed again soon. Overlays which libass handed back for several
+	// frames are counted for each of them, which only makes this evict a
+	// little early.
+	overlay_cache_size += overlay->GetSize();
+	while (overlay_cache_size > max_overlay_cache_size && !overlays.empty()) {
+		auto first = overlays.begin();
+		auto last = std::prev(overlays.end());
+		auto victim = key - first->first > last->first - key ? first : last;
+		overlay_cache_size -= victim->second->GetSize();
+		overlays.erase(victim);
+	}
+
+	overlays[key] = std::move(overlay);
+}
+
+void AsyncVideoProvider::ClearOverlays() {
+	overlays.clear();
+	overlay_cache_size = 0;
+}
+
 static std::unique_ptr<SubtitlesProvider> get_subs_provider(wxEvtHandler *evt_handler, agi::BackgroundRunner *br) {
 	try {
 		return SubtitlesProviderFactory::GetProvider(br);
@@ -92,58 +284,338 @@ static std::unique_ptr<SubtitlesProvider> get_subs_provider(wxEvtHandler *evt_ha
 }
 
 AsyncVideoProvider::AsyncVideoProvider(agi::fs::path const& video_filename, std::string const& colormatrix, wxEvtHandler *parent, agi::BackgroundRunner *br)
-: worker(agi::dispatch::Create())
+: decoder(agi::dispatch::Create())
+, worker(agi::dispatch::Create())
 , subs_provider(get_subs_provider(parent, br))
-, source_provider(VideoProviderFactory::GetProvider(video_filename, colormatrix, br))
+, source_provider(VideoProviderFactory::GetSharedProvider(video_filename, colormatrix, br))
 , parent(parent)
+, keyframes(source_provider->GetKeyFrames())
+, callback_state(std::make_shared<CallbackState>())
 {
+	callback_state->self = this;
+	buffer_registration = agi::memory::Register("Video render buffers", [this] { return buffer_memory.load(); });
+	overlay_registration = agi::memory::Register("Subtitle overlays", [this] { return overlay_cache_size.load(); });
 }
 
 AsyncVideoProvider::~AsyncVideoProvider() {
-	// Block until all currently queued jobs are complete
-	worker->Sync([]{});
+	{
+		std::lock_guard<std::mutex> lock(callback_state->mutex);
+		callback_state->self = nullptr;
+	}
+
+	// Skip any queued prefetching, then block until all currently queued
+	// jobs are complete. The decoder goes first as it queues jobs on the
+	// worker.
+	++seek_version;
+	++playback_version;
+	handoff_cond.notify_all();
+	decoder->Sync([]{}, agi::dispatch::Priority::Background);
+	worker->Sync([]{}, agi::dispatch::Priority::Background);
 }
 
 void AsyncVideoProvider::LoadSubtitles(const AssFile *new_subs) throw() {
-	uint_fast32_t req_version = ++version;
+	// Frames requested before the copy is made are for the old file
+	++version;
+
+	const bool scheduled = pending_subs != nullptr;
+	pending_subs = new_subs;
+	if (scheduled) return;
+
+	auto state = callback_state;
+	agi::dispatch::Main().Async([state] {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		if (state->self)
+			state->self->FlushSubtitles();
+	});
+}
 
-	auto copy = new AssFile(*new_subs);
+void AsyncVideoProvider::FlushSubtitles() {
+	if (!pending_subs) return;
+
+	uint_fast32_t req_version = ++version;
+	auto copy = new AssFile(*pending_subs);
+	pending_subs = nullptr;
 	worker->Async([=]{
 		subs.reset(copy);
+		IndexSubtitles();
 		single_frame = NEW_SUBS_FILE;
 		ProcAsync(req_version, false);
 	});
 }
 
-void AsyncVideoProvider::UpdateSubtitles(const AssFile *new_subs, const AssDialogue *changed) throw() {
+void AsyncVideoProvider::UpdateSubtitles(const AssFile *new_subs, std::vector<const AssDialogue *> const& changed) throw() {
+	// The pending copy of the whole file will include this change
+	if (pending_subs) {
+		pending_subs = new_subs;
+		++version;
+		return;
+	}
+
 	uint_fast32_t req_version = ++version;
 
-	// Copy just the line which were changed, then replace the line at the
-	// same index in the worker's copy of the file with the new entry
-	auto copy = new AssDialogue(*changed);
+	// Copy just the lines which were changed, then replace the lines at the
+	// same indices in the worker's copy of the file with the new entries
+	std::vector<AssDialogue *> copies;
+	copies.reserve(changed.size());
+	for (auto line : changed)
+		copies.push_back(new AssDialogue(*line));
+
 	worker->Async([=]{
-		int i = 0;
-		auto it = subs->Events.begin();
-		std::advance(it, copy->Row - i);
-		i = copy->Row;
+		ReplaceLines(copies);
+		ProcAsync(req_version, true);
+	});
+}
+
+void AsyncVideoProvider::PreviewSubtitles(const AssFile *new_subs, std::vector<const AssDialogue *> const& changed) throw() {
+	if (pending_subs) {
+		UpdateSubtitles(new_subs, changed);
+		return;
+	}
+
+	++version;
+	{
+		std::lock_guard<std::mutex> lock(preview_mutex);
+		for (auto line : changed)
+			preview_lines[line->Row].reset(new AssDialogue(*line));
+		if (preview_queued) return;
+		preview_queued = true;
+	}
+
+	worker->Async([=]{
+		std::vector<AssDialogue *> copies;
+		{
+			std::lock_guard<std::mutex> lock(preview_mutex);
+			preview_queued = false;
+			copies.reserve(preview_lines.size());
+			for (auto& line : preview_lines)
+				copies.push_back(line.second.release());
+			preview_lines.clear();
+		}
+		ReplaceLines(copies);
+		// Previews merged into this one have bumped the version since it
+		// was queued, but are drawn by it
+		ProcAsync(version, true);
+	});
+}
+
+void AsyncVideoProvider::ReplaceLines(std::vector<AssDialogue *> const& copies) {
+	bool retimed = false;
+	for (auto copy : copies) {
+		auto it = subs->Events.iterator_to(*rows[copy->Row]);
+		retimed = retimed || it->Start != copy->Start || it->End != copy->End || it->Comment != copy->Comment;
 		subs->Events.insert(it, *copy);
-		delete &*it--;
+		subs->Events.erase_and_dispose(it, [](AssDialogue *line) { delete line; });
+		rows[copy->Row] = copy;
+	}
+
+	if (retimed)
+		IndexSubtitles();
 
+	// If the provider has the whole file loaded it may be able to swap
+	// in just the changed lines rather than parsing the file again
+	bool updated = subs_provider && single_frame == SUBS_FILE_ALREADY_LOADED;
+	try {
+		for (size_t i = 0; updated && i < copies.size(); ++i)
+			updated = subs_provider->UpdateLine(copies[i]->Row, *copies[i]);
+	}
+	catch (agi::Exception const&) {
+		updated = false;
+	}
+
+	if (updated)
+		ClearOverlays();
+	else
 		single_frame = NEW_SUBS_FILE;
-		ProcAsync(req_version, true);
-	});
 }
 
 void AsyncVideoProvider::RequestFrame(int new_frame, double new_time) throw() {
 	uint_fast32_t req_version = ++version;
+	uint_fast32_t req_seek = ++seek_version;
+	last_request = new_frame;
+	last_request_time = new_time;
+	const double budget = scrubbing ? default_frame_budget : 0.;
+
+	decoder->Async([=]{
+		if (req_seek != seek_version) return;
+
+		std::shared_ptr<const VideoFrame> frame;
+		try {
+			frame = DecodeFrame(new_frame);
+		}
+		catch (wxEvent const& err) {
+			parent->QueueEvent(err.Clone());
+			return;
+		}
+		QueuePrefetch(new_frame);
+
+		// Don't let decoding get more than a few frames ahead of rendering
+		{
+			std::unique_lock<std::mutex> lock(handoff_mutex);
+			handoff_cond.wait(lock, [&]{
+				return pending_renders < max_pending_renders || req_seek != seek_version;
+			});
+			if (req_seek != seek_version) return;
+			++pending_renders;
+		}
+
+		worker->Async([=]{
+			{
+				std::lock_guard<std::mutex> lock(handoff_mutex);
+				--pending_renders;
+			}
+			handoff_cond.notify_all();
+
+			if (req_seek != seek_version) return;
+			time = new_time;
+			frame_number = new_frame;
+			source_frame = frame;
+			// Subtitle changes made while this frame was being decoded have
+			// already been processed by the worker and only rendered the
+			// old frame, so they shouldn't stop this from being rendered
+			ProcAsync(std::max(req_version, processed_version), false, budget);
+		});
+	});
+}
 
+void AsyncVideoProvider::IndexSubtitles() {
+	rows.clear();
+	visible_index.Clear();
+	for (auto const& line : subs->Events) {
+		if (!line.Comment)
+			visible_index.Add(line.Start, line.End, static_cast<int>(rows.size()));
+		rows.push_back(&line);
+	}
+	visible_index.Build();
+}
+
+void AsyncVideoProvider::PrerenderSubtitles(std::vector<double> times) throw() {
 	worker->Async([=]{
-		time = new_time;
-		frame_number = new_frame;
-		ProcAsync(req_version, false);
+		if (!subs_provider || !subs || !source_frame) return;
+		const int width = source_frame->width;
+		const int height = source_frame->height;
+
+		std::vector<int> keys;
+		std::vector<double> needed;
+		for (double time : times) {
+			auto it = overlays.find(int(time));
+			if (it == overlays.end() || it->second->width != width || it->second->height != height) {
+				keys.push_back(int(time));
+				needed.push_back(time / 1000.);
+			}
+		}
+		if (needed.empty()) return;
+
+		// The times are consecutive frames, which each have until the next
+		// is due to render in
+		const double budget = times.size() > 1 ? (times.back() - times.front()) / (times.size() - 1) : default_frame_budget;
+		const double scale = RenderScale(budget);
+
+		try {
+			// Rendering ahead only happens while playing, when the whole
+			// file is wanted anyway
+			if (single_frame != SUBS_FILE_ALREADY_LOADED) {
+				subs_provider->LoadSubtitles(subs.get());
+				single_frame = SUBS_FILE_ALREADY_LOADED;
+				ClearOverlays();
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::shared_ptr<const SubtitleOverlay>> rendered;
+			if (scale >= 1.)
+				rendered = subs_provider->RenderOverlays(width, height, needed);
+			else {
+				rendered = subs_provider->RenderOverlays(std::max(1, int(width * scale + .5)), std::max(1, int(height * scale + .5)), needed);
+				for (auto& overlay : rendered)
+					overlay = overlay->Upscale(width, height);
+			}
+			if (!rendered.empty())
+				AdaptMotionScale(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / rendered.size(), budget);
+
+			for (size_t i = 0; i < rendered.size(); ++i) {
+				if (!rendered[i]->provisional)
+					CacheOverlay(keys[i], std::move(rendered[i]));
+			}
+		}
+		catch (agi::UserCancelException const&) { }
+		catch (agi::Exception const& err) {
+			parent->QueueEvent(SubtitlesProviderErrorEvent(err.GetMessage()).Clone());
+		}
+	}, agi::dispatch::Priority::Prefetch);
+}
+
+void AsyncVideoProvider::QueuePlaybackFrame(int new_frame, double new_time) throw() {
+	uint_fast32_t req_playback = playback_version;
+
+	decoder->Async([=]{
+		if (req_playback != playback_version) return;
+
+		std::shared_ptr<const VideoFrame> frame;
+		try {
+			frame = DecodeFrame(new_frame);
+		}
+		catch (wxEvent const& err) {
+			parent->QueueEvent(err.Clone());
+			return;
+		}
+
+		worker->Async([=]{
+			if (req_playback != playback_version) return;
+
+			// Make this the current frame so that subtitle changes made
+			// during playback are drawn onto a frame near the one showing
+			time = new_time;
+			frame_number = new_frame;
+			source_frame = frame;
+
+			// Each frame has until the next one is due to render in
+			double budget = new_time - last_playback_time;
+			if (budget <= 0 || budget > 1000)
+				budget = default_frame_budget;
+			last_playback_time = new_time;
+
+			std::shared_ptr<const VideoFrame> rendered;
+			try {
+				rendered = RenderFrame(frame, new_frame, new_time, budget);
+			}
+			catch (wxEvent const& err) {
+				parent->QueueEvent(err.Clone());
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(playback_mutex);
+			if (req_playback == playback_version)
+				playback_frames.emplace_back(new_frame, std::move(rendered));
+		});
 	});
 }
 
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::TakePlaybackFrame(int frame, int& taken) {
+	std::lock_guard<std::mutex> lock(playback_mutex);
+	auto due = std::find_if(playback_frames.begin(), playback_frames.end(),
+		[=](std::pair<int, std::shared_ptr<const VideoFrame>> const& queued) { return queued.first > frame; });
+	if (due == playback_frames.begin()) return nullptr;
+
+	auto newest = std::prev(due);
+	taken = newest->first;
+	auto ret = std::move(newest->second);
+	playback_frames.erase(playback_frames.begin(), due);
+	return ret;
+}
+
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::TakeReadyFrame(double &time, std::chrono::steady_clock::time_point &queued) {
+	auto ready = std::atomic_exchange(&ready_frame, std::shared_ptr<ReadyFrame>());
+	if (!ready) return nullptr;
+	time = ready->time;
+	queued = ready->queued;
+	return std::move(ready->frame);
+}
+
+void AsyncVideoProvider::StopPlayback() throw() {
+	std::lock_guard<std::mutex> lock(playback_mutex);
+	++playback_version;
+	playback_frames.clear();
+}
+
 bool AsyncVideoProvider::NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines) {
 	// Always need to render after a seek
 	if (single_frame != NEW_SUBS_FILE || frame_number != last_rendered)
@@ -173,15 +645,21 @@ bool AsyncVideoProvider::NeedUpdate(std::vector<AssDialogueBase const*> const& v
 	return false;
 }
 
-void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated) {
+void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated, double budget) {
+	processed_version = std::max(processed_version, req_version);
+
 	// Only actually produce the frame if there's no queued changes waiting
-	if (req_version < version || frame_number < 0) return;
+	if (req_version < version || frame_number < 0 || !source_frame) return;
+
+	// Times are whole milliseconds, so a line is visible at a fractional
+	// time exactly when it's visible at the millisecond before it
+	auto visible_rows = visible_index.Find(static_cast<int>(std::floor(time)));
+	std::sort(visible_rows.begin(), visible_rows.end());
 
 	std::vector<AssDialogueBase const*> visible_lines;
-	for (auto const& line : subs->Events) {
-		if (!line.Comment && !(line.Start > time || line.End <= time))
-			visible_lines.push_back(&line);
-	}
+	visible_lines.reserve(visible_rows.size());
+	for (int row : visible_rows)
+		visible_lines.push_back(rows[row]);
 
 	if (check_updated && !NeedUpdate(visible_lines)) return;
 
@@ -192,9 +670,17 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	last_rendered = frame_number;
 
 	try {
-		FrameReadyEvent *evt = new FrameReadyEvent(ProcFrame(frame_number, time), time);
-		evt->SetEventType(EVT_FRAME_READY);
-		parent->QueueEvent(evt);
+		auto ready = std::make_shared<ReadyFrame>();
+		ready->frame = RenderFrame(source_frame, frame_number, time, budget);
+		ready->time = time;
+		ready->queued = std::chrono::steady_clock::now();
+
+		// If a frame is already waiting, the parent hasn't handled the event
+		// for it yet and will take this one instead when it does
+		if (std::atomic_exchange(&ready_frame, std::move(ready)))
+			agi::trace::Count("video/superseded");
+		else
+			parent->QueueEvent(new wxThreadEvent(EVT_FRAME_AVAILABLE));
 	}
 	catch (wxEvent const& err) {
 		// Pass error back to parent thread
@@ -202,17 +688,189 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	}
 }
 
-std::shared_ptr<VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time, bool raw) {
-	std::shared_ptr<VideoFrame> ret;
-	worker->Sync([&]{ ret = ProcFrame(frame, time, raw); });
+void AsyncVideoProvider::QueuePrefetch(int frame_number) {
+	if (frame_number == prefetch_center) return;
+	const bool backwards = frame_number < prefetch_center;
+	prefetch_center = frame_number;
+
+	const int limit = source_provider->GetPrefetchLimit();
+	if (limit <= 0) return;
+
+	int first, last;
+	if (backwards) {
+		// Everything from the keyframe before the previous frame, as that
+		// all has to be decoded to get the previous frame anyway
+		last = frame_number - 1;
+		auto next_keyframe = std::upper_bound(keyframes.begin(), keyframes.end(), last);
+		first = next_keyframe == keyframes.begin() ? 0 : *std::prev(next_keyframe);
+		first = std::max(first, last - limit + 1);
+	}
+	else {
+		first = frame_number + 1;
+		last = std::min(frame_number + std::min(limit, prefetch_ahead), source_provider->GetFrameCount() - 1);
+	}
+
+	// Each frame is a separate job so that a request for a frame never has
+	// to wait for more than one frame to be prefetched, and the rest are
+	// skipped once the user has moved on
+	const uint_fast32_t req_seek = seek_version;
+	for (int i = std::max(first, 0); i <= last; ++i) {
+		decoder->Async([=]{
+			if (req_seek != seek_version) return;
+			try {
+				source_provider->Prefetch(i);
+			}
+			catch (VideoProviderError const&) {
+				// Reported if the frame is actually requested
+			}
+		}, agi::dispatch::Priority::Prefetch);
+	}
+}
+
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time, bool raw) {
+	std::shared_ptr<const VideoFrame> ret;
+	decoder->Sync([&]{
+		// Frames fetched directly are for exporting, so they're always full
+		// size even when the display is using proxy frames
+		if (proxy_scale == 1.) {
+			ret = DecodeFrame(frame);
+			return;
+		}
+
+		source_provider->SetProxyScale(1.);
+		try {
+			ret = DecodeFrame(frame);
+		}
+		catch (...) {
+			source_provider->SetProxyScale(proxy_scale);
+			throw;
+		}
+		source_provider->SetProxyScale(proxy_scale);
+	});
+	if (!raw) {
+		FlushSubtitles();
+		// Frames fetched directly are saved rather than just shown, so they
+		// can't be rendered without all of the fonts
+		if (subs_provider)
+			subs_provider->WaitUntilReady();
+		worker->Sync([&]{ ret = RenderFrame(ret, frame, time); });
+	}
 	return ret;
 }
 
+void AsyncVideoProvider::GetFrames(std::vector<std::pair<int, double>> const& frames, bool raw, std::function<void (int, std::shared_ptr<const VideoFrame>)> const& callback) {
+	if (!raw) {
+		FlushSubtitles();
+		if (subs_provider)
+			subs_provider->WaitUntilReady();
+	}
+
+	// Only written under mutex, and read on this thread once the worker
+	// has finished with every frame
+	std::mutex mutex;
+	std::condition_variable cond;
+	int pending = 0;
+	std::exception_ptr error;
+
+	decoder->Sync([&]{
+		// Frames fetched directly are always full size, as in GetFrame
+		if (proxy_scale != 1.)
+			source_provider->SetProxyScale(1.);
+
+		for (auto const& frame : frames) {
+			{
+				// Don't decode too far ahead of the renderer, as each frame
+				// waiting to be rendered holds on to its memory
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [&]{ return pending < max_pending_renders || error; });
+				if (error) break;
+				++pending;
+			}
+
+			std::shared_ptr<const VideoFrame> decoded;
+			try {
+				decoded = DecodeFrame(frame.first);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(mutex);
+				error = std::current_exception();
+				--pending;
+				break;
+			}
+
+			worker->Async([=, &mutex, &cond, &pending, &error, &callback]{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (error) {
+						--pending;
+						cond.notify_all();
+						return;
+					}
+				}
+
+				std::exception_ptr failed;
+				try {
+					callback(frame.first, raw ? decoded : RenderFrame(decoded, frame.first, frame.second));
+				}
+				catch (...) {
+					failed = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (failed && !error)
+					error = failed;
+				--pending;
+				cond.notify_all();
+			});
+		}
+
+		if (proxy_scale != 1.)
+			source_provider->SetProxyScale(proxy_scale);
+	});
+
+	// Wait for the frames which were handed off before returning, as the
+	// worker refers to the locals above
+	worker->Sync([]{});
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void AsyncVideoProvider::SetScrubbing(bool new_scrubbing) {
+	if (scrubbing == new_scrubbing) return;
+	scrubbing = new_scrubbing;
+
+	// The frame the drag stopped on may have been drawn at a lower quality
+	if (!scrubbing && last_request >= 0)
+		RequestFrame(last_request, last_request_time);
+}
+
+void AsyncVideoProvider::SetAdaptiveQuality(bool enable) {
+	adaptive_quality = enable;
+}
+
 void AsyncVideoProvider::SetColorSpace(std::string const& matrix) {
-	worker->Async([=] { source_provider->SetColorSpace(matrix); });
+	decoder->Async([=] { source_provider->SetColorSpace(matrix); });
+}
+
+void AsyncVideoProvider::SetProxyScale(double scale) {
+	if (scale == proxy_scale) return;
+	proxy_scale = scale;
+
+	decoder->Async([=] {
+		try {
+			source_provider->SetProxyScale(scale);
+		}
+		catch (VideoProviderError const& err) {
+			parent->QueueEvent(VideoProviderErrorEvent(err).Clone());
+		}
+	});
+
+	if (last_request >= 0)
+		RequestFrame(last_request, last_request_time);
 }
 
 wxDEFINE_EVENT(EVT_FRAME_READY, FrameReadyEvent);
+wxDEFINE_EVENT(EVT_FRAME_AVAILABLE, wxThreadEvent);
 wxDEFINE_EVENT(EVT_VIDEO_ERROR, VideoProviderErrorEvent);
 wxDEFINE_EVENT(EVT_SUBTITLES_ERROR, SubtitlesProviderErrorEvent);
 
@@ -15,22 +15,31 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include "include/aegisub/video_provider.h"
+#include "video_frame.h"
 
 #include <libaegisub/exception.h>
 #include <libaegisub/fs_fwd.h>
+#include <libaegisub/interval_index.h>
+#include <libaegisub/memory_usage.h>
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <wx/event.h>
 
 class AssDialogue;
 class AssFile;
 class SubtitlesProvider;
+struct SubtitleOverlay;
 class VideoProvider;
 class VideoProviderError;
 struct AssDialogueBase;
-struct VideoFrame;
 namespace agi {
 	class BackgroundRunner;
 	namespace dispatch { class Queue; }
@@ -38,14 +47,17 @@ namespace agi {
 
 /// An asynchronous video decoding and subtitle rendering wrapper
 class AsyncVideoProvider {
-	/// Asynchronous work queue
+	/// Queue which decodes frames. Only it touches source_provider.
+	std::unique_ptr<agi::dispatch::Queue> decoder;
+	/// Queue which renders subtitles onto decoded frames, so that rendering
+	/// one frame can overlap with decoding the next
 	std::unique_ptr<agi::dispatch::Queue> worker;
 
 	/// Subtitles provider
 	std::unique_ptr<SubtitlesProvider> subs_provider;
 	/// Video provider
 	std::unique_ptr<VideoProvider> source_provider;
-	/// Event handler to send FrameReady events to
+	/// Event handler to notify of rendered frames and errors
 	wxEvtHandler *parent;
 
 	int frame_number = -1; ///< Last frame number requested
@@ -53,6 +65,13 @@ class AsyncVideoProvider {
 
 	/// Copy of the subtitles file to avoid having to touch the project context
 	std::unique_ptr<AssFile> subs;
+	/// Lines of subs by row
+	std::vector<const AssDialogue *> rows;
+	/// Rows of the uncommented lines of subs by time, so that finding the
+	/// lines visible on a frame doesn't have to look at every line
+	agi::IntervalIndex<int> visible_index;
+	/// Rebuild rows and visible_index from subs
+	void IndexSubtitles();
 
 	/// If >= 0, the subtitles provider current has just the lines visible on
 	/// that frame loaded. If -1, the entire file is loaded. If -2, the
@@ -67,23 +86,186 @@ class AsyncVideoProvider {
 	/// lines have actually changed
 	bool NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines);
 
-	std::shared_ptr<VideoFrame> ProcFrame(int frame, double time, bool raw = false);
+	/// Decoded frame which frame_number refers to
+	std::shared_ptr<const VideoFrame> source_frame;
+
+	/// Get a frame from the video provider. Only called on the decoder.
+	std::shared_ptr<const VideoFrame> DecodeFrame(int frame);
+	/// Draw the subtitles onto a copy of a decoded frame. Only called on the
+	/// worker.
+	/// @param budget Milliseconds the subtitles have to be rendered in to
+	///               keep up with playback or scrubbing, or 0 if the frame
+	///               is being shown still and should be full quality
+	std::shared_ptr<const VideoFrame> RenderFrame(std::shared_ptr<const VideoFrame> source, int frame, double time, double budget = 0.);
 
 	/// Produce a frame if req_version is still the current version
-	void ProcAsync(uint_fast32_t req_version, bool check_updated);
+	void ProcAsync(uint_fast32_t req_version, bool check_updated, double budget = 0.);
 
 	/// Monotonic counter used to drop frames when changes arrive faster than
 	/// they can be rendered
 	std::atomic<uint_fast32_t> version{ 0 };
+	/// Newest version the worker has seen
+	uint_fast32_t processed_version = 0;
+
+	/// Number of decoded frames which have been handed to the worker but
+	/// not picked up yet
+	int pending_renders = 0;
+	/// Maximum value of pending_renders before the decoder waits
+	static const int max_pending_renders = 2;
+	std::mutex handoff_mutex;
+	std::condition_variable handoff_cond;
+
+	/// Counter of frame requests, used to drop prefetching when the user
+	/// moves on to another frame. Unlike version, this isn't bumped by
+	/// subtitle changes, which don't change which frames will be wanted.
+	std::atomic<uint_fast32_t> seek_version{ 0 };
+
+	/// Counter of playback runs, used to drop the frames queued for one run
+	/// when playback stops
+	std::atomic<uint_fast32_t> playback_version{ 0 };
+	/// Frames rendered ahead of time for playback which haven't been taken
+	/// yet, in frame order
+	std::deque<std::pair<int, std::shared_ptr<const VideoFrame>>> playback_frames;
+	std::mutex playback_mutex;
+
+	/// A rendered frame waiting to be taken by the parent
+	struct ReadyFrame {
+		std::shared_ptr<const VideoFrame> frame;
+		/// Time which was used for subtitle rendering
+		double time;
+		/// When the frame finished rendering
+		std::chrono::steady_clock::time_point queued;
+	};
+	/// @brief Newest frame rendered by ProcAsync which hasn't been taken yet
+	///
+	/// Only accessed with the atomic shared_ptr functions. A frame which is
+	/// replaced before it's taken is never shown, and the parent is only sent
+	/// EVT_FRAME_AVAILABLE when this goes from empty to full, so there's
+	/// never more than one of them waiting in its event queue.
+	std::shared_ptr<ReadyFrame> ready_frame;
+
+	/// Keyframes of the video, for working out which frames are cheap to
+	/// decode together
+	std::vector<int> keyframes;
+	/// Frame which the last prefetch was centered on. Only used on the
+	/// decoder.
+	int prefetch_center = -1;
+
+	/// @brief Queue decoding the frames around the current frame which are
+	///        likely to be requested next
+	///
+	/// Moving forwards prefetches the next few frames. Moving backwards
+	/// prefetches all of the GOP before the current frame at once, as each
+	/// step back would otherwise mean seeking to its keyframe and decoding
+	/// forward again.
+	void QueuePrefetch(int frame);
 
 	std::vector<std::shared_ptr<VideoFrame>> buffers;
+	/// Get a buffer which nothing else is using to draw a frame into
+	std::shared_ptr<VideoFrame> GetBuffer();
+	/// Memory used by buffers and drawn_source_bgra, for the memory usage
+	/// report. Only written on the worker.
+	std::atomic<size_t> buffer_memory{0};
+	/// Update buffer_memory after drawing into a buffer
+	void CountBuffers();
+
+	/// Source frame which subtitles were last drawn onto
+	std::shared_ptr<const VideoFrame> drawn_source;
+	/// drawn_source converted to RGB, if it wasn't already
+	VideoFrame drawn_source_bgra;
+	/// Overlay which was last drawn onto drawn_source
+	std::shared_ptr<const SubtitleOverlay> drawn_overlay;
+	/// The result of drawing drawn_overlay onto drawn_source, which later
+	/// overlays for the same source are drawn by patching a copy of
+	std::shared_ptr<const VideoFrame> drawn_frame;
+	/// Last VideoFrame::id given to a rendered frame
+	uint32_t last_frame_id = 0;
+
+	/// Scale which frames are being decoded at. Only written on the main
+	/// thread.
+	double proxy_scale = 1.;
+	/// Last frame requested with RequestFrame, to request again at the new
+	/// size when the scale changes
+	int last_request = -1;
+	double last_request_time = 0.;
+
+	/// Rendered subtitles for the current subtitle file by time in
+	/// milliseconds, so that seeking back to a frame or editing the
+	/// subtitles only has to blend rather than render them again
+	std::map<int, std::shared_ptr<const SubtitleOverlay>> overlays;
+	/// Sum of the sizes of overlays. Atomic so that the memory usage report
+	/// can read it.
+	std::atomic<size_t> overlay_cache_size{0};
+
+	/// Get the overlay for a time, rendering it if it isn't cached
+	/// @param budget As for RenderFrame
+	/// @return The overlay, or nullptr if the subtitles provider can't render
+	///         overlays
+	std::shared_ptr<const SubtitleOverlay> GetOverlay(int width, int height, double time, double budget = 0.);
+
+	/// Can subtitles be rendered at a lower resolution when they can't keep
+	/// up with playback or scrubbing?
+	std::atomic<bool> adaptive_quality{true};
+	/// Fraction of the frame size subtitles are rendered at when they have a
+	/// budget. Only used on the worker.
+	double motion_scale = 1.;
+	/// Time of the last frame rendered for playback, to work out how long
+	/// the next one has to render in. Only used on the worker.
+	double last_playback_time = -1.;
+	/// Is the user dragging through the video? Only used on the main thread.
+	bool scrubbing = false;
+	/// Scale of the subtitles to render with a budget
+	double RenderScale(double budget) const;
+	/// Render an overlay at a fraction of the frame size and scale it up
+	std::shared_ptr<const SubtitleOverlay> RenderScaledOverlay(int width, int height, double time, double scale);
+	/// Adjust motion_scale after spending ms rendering subtitles which had
+	/// budget milliseconds to render in
+	void AdaptMotionScale(double ms, double budget);
+	/// Add an overlay to the cache, evicting the ones furthest from it if
+	/// the cache is full
+	void CacheOverlay(int key, std::shared_ptr<const SubtitleOverlay> overlay);
+	/// Discard all cached overlays after the subtitles change
+	void ClearOverlays();
+
+	/// Shared with callbacks such as the subtitles provider's ready
+	/// callback, which may be called after this has been destroyed
+	struct CallbackState {
+		std::mutex mutex;
+		AsyncVideoProvider *self;
+	};
+	std::shared_ptr<CallbackState> callback_state;
+	/// Has a ready callback been registered with the subtitles provider?
+	bool waiting_for_fonts = false;
+	/// Render the current frame again once the subtitles provider has all
+	/// of its fonts, after rendering it with only some of them
+	void RefreshWhenReady();
+
+	/// File passed to LoadSubtitles which hasn't been copied for the worker
+	/// yet. Copying is put off until the main thread is idle so that a burst
+	/// of commits only copies the file once.
+	const AssFile *pending_subs = nullptr;
+	/// Copy pending_subs for the worker, if there is one
+	void FlushSubtitles();
+
+	/// Copies of lines passed to PreviewSubtitles which the worker hasn't
+	/// picked up yet, by row
+	std::map<int, std::unique_ptr<AssDialogue>> preview_lines;
+	/// Is a job to pick up preview_lines queued on the worker?
+	bool preview_queued = false;
+	std::mutex preview_mutex;
+
+	/// Swap copies of changed lines into subs. Only called on the worker.
+	void ReplaceLines(std::vector<AssDialogue *> const& copies);
+
+	agi::memory::Registration buffer_registration;
+	agi::memory::Registration overlay_registration;
 
 public:
 	/// @brief Load the passed subtitle file
 	/// @param subs File to load
 	///
-	/// This function blocks until is it is safe for the calling thread to
-	/// modify subs
+	/// The file is copied once the main thread is next idle, so it must not
+	/// be destroyed before then, and must only be modified on the main thread
 	void LoadSubtitles(const AssFile *subs) throw();
 
 	/// @brief Update a previously loaded subtitle file
@@ -92,7 +274,16 @@ public:
 	///
 	/// This function only supports changes to existing lines, and not
 	/// insertions or deletions.
-	void UpdateSubtitles(const AssFile *subs, const AssDialogue *changes) throw();
+	void UpdateSubtitles(const AssFile *subs, std::vector<const AssDialogue *> const& changes) throw();
+
+	/// @brief Show changes to lines which haven't been committed yet
+	/// @param subs File which was last passed to LoadSubtitles
+	/// @param changes Lines which have changed
+	///
+	/// Like UpdateSubtitles, but changes made while the worker is busy are
+	/// merged and drawn together, so that the lines can be previewed on
+	/// every mouse move without queueing up more renders than can be done.
+	void PreviewSubtitles(const AssFile *subs, std::vector<const AssDialogue *> const& changes) throw();
 
 	/// @brief Queue a request for a frame
 	/// @brief frame Frame number
@@ -102,15 +293,83 @@ public:
 	/// is no guarantee that the requested frame will ever actually be produced
 	void RequestFrame(int frame, double time) throw();
 
+	/// @brief Render the subtitles of frames which are about to be requested
+	/// @param times Exact start times of the frames in milliseconds
+	///
+	/// The overlays which aren't already cached are rendered in one batch,
+	/// in parallel if the subtitles provider supports it, so that playing
+	/// heavily typeset video isn't limited to rendering a frame at a time.
+	void PrerenderSubtitles(std::vector<double> times) throw();
+
+	/// @brief Decode and render a frame ahead of time for playback
+	/// @param frame Frame number
+	/// @param time  Exact start time of the frame in milliseconds
+	///
+	/// Frames must be queued in order. Rather than being sent to the parent,
+	/// rendered frames are held until they're taken with TakePlaybackFrame,
+	/// so that they can be shown when they're due rather than when they
+	/// happen to finish.
+	void QueuePlaybackFrame(int frame, double time) throw();
+
+	/// @brief Take the newest rendered playback frame which is due
+	/// @param frame      Frame which is due to be shown now
+	/// @param[out] taken Number of the frame returned
+	/// @return The frame, or nullptr if none up to frame has been rendered
+	///
+	/// Rendered frames before the returned one are discarded.
+	std::shared_ptr<const VideoFrame> TakePlaybackFrame(int frame, int& taken);
+
+	/// Discard all frames queued with QueuePlaybackFrame, rendered or not
+	void StopPlayback() throw();
+
+	/// @brief Take the newest frame rendered for a request since the last call
+	/// @param time   Receives the time which was used for subtitle rendering
+	/// @param queued Receives when the frame finished rendering
+	/// @return The frame, or nullptr if there isn't a new one
+	///
+	/// Called by the parent when it gets EVT_FRAME_AVAILABLE.
+	std::shared_ptr<const VideoFrame> TakeReadyFrame(double &time, std::chrono::steady_clock::time_point &queued);
+
+	/// @brief Tell the provider whether the user is dragging through the video
+	///
+	/// While scrubbing, subtitles may be rendered at a lower resolution to
+	/// keep up. The last requested frame is rendered again at full quality
+	/// once scrubbing stops.
+	void SetScrubbing(bool scrubbing);
+
+	/// Allow or disallow rendering subtitles at a lower resolution when they
+	/// can't keep up with playback or scrubbing
+	void SetAdaptiveQuality(bool enable);
+
 	/// @brief Synchronously get a frame
 	/// @brief frame Frame number
 	/// @brief time  Exact start time of the frame in seconds
 	/// @brief raw   Get raw frame without subtitles
-	std::shared_ptr<VideoFrame> GetFrame(int frame, double time, bool raw = false);
+	std::shared_ptr<const VideoFrame> GetFrame(int frame, double time, bool raw = false);
+
+	/// @brief Synchronously get a series of frames for exporting
+	/// @param frames   Frame numbers and exact start times, as for GetFrame
+	/// @param raw      Get raw frames without subtitles
+	/// @param callback Called on the subtitle rendering thread with each
+	///                 frame, in order
+	///
+	/// Decoding each frame overlaps with rendering the subtitles onto the
+	/// one before it, which GetFrame can't do as it returns a single frame.
+	/// Returns once every frame has been passed to callback. Errors from
+	/// decoding, rendering or the callback are thrown after the frames
+	/// already being worked on have finished.
+	void GetFrames(std::vector<std::pair<int, double>> const& frames, bool raw, std::function<void (int, std::shared_ptr<const VideoFrame>)> const& callback);
 
 	/// Ask the video provider to change YCbCr matricies
 	void SetColorSpace(std::string const& matrix);
 
+	/// @brief Decode frames for display at a fraction of the video's size
+	/// @param scale Fraction of the full size, with 1 being full size
+	///
+	/// The last requested frame is requested again at the new size. Frames
+	/// from GetFrame are always full size.
+	void SetProxyScale(double scale);
+
 	int GetFrameCount() const             { return source_provider->GetFrameCount(); }
 	int GetWidth() const                  { return source_provider->GetWidth(); }
 	int GetHeight() const                 { return source_provider->GetHeight(); }
@@ -126,19 +385,19 @@ public:
 
 	/// @brief Constructor
 	/// @param videoFileName File to open
-	/// @param parent Event handler to send FrameReady events to
+	/// @param parent Event handler to send EVT_FRAME_AVAILABLE and errors to
 	AsyncVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, wxEvtHandler *parent, agi::BackgroundRunner *br);
 	~AsyncVideoProvider();
 };
 
-/// Event which signals that a requested frame is ready
+/// Event which signals that a frame is ready to be shown
 struct FrameReadyEvent final : public wxEvent {
 	/// Frame which is ready
-	std::shared_ptr<VideoFrame> frame;
+	std::shared_ptr<const VideoFrame> frame;
 	/// Time which was used for subtitle rendering
 	double time;
 	wxEvent *Clone() const override { return new FrameReadyEvent(*this); };
-	FrameReadyEvent(std::shared_ptr<VideoFrame> frame, double time)
+	FrameReadyEvent(std::shared_ptr<const VideoFrame> frame, double time)
 	: frame(std::move(frame)), time(time) { }
 };
 
@@ -155,5 +414,7 @@ struct SubtitlesProviderErrorEvent final : public wxEvent, public agi::Exception
 };
 
 wxDECLARE_EVENT(EVT_FRAME_READY, FrameReadyEvent);
+/// Sent to the parent when a rendered frame is waiting for TakeReadyFrame
+wxDECLARE_EVENT(EVT_FRAME_AVAILABLE, wxThreadEvent);
 wxDECLARE_EVENT(EVT_VIDEO_ERROR, VideoProviderErrorEvent);
 wxDECLARE_EVENT(EVT_SUBTITLES_ERROR, SubtitlesProviderErrorEvent);
@@ -100,4 +100,9 @@ public:
 		const unsigned char *color = get_color(val);
 		return wxColour(color[0], color[1], color[2]);
 	}
+
+	/// @brief Get the palette as RGB triples
+	///
+	/// A value v is mapped to entry mid(0, v * (entries - 1), entries - 1).
+	std::vector<unsigned char> const& GetPalette() const { return palette; }
 };
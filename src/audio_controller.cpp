@@ -63,7 +63,7 @@ void AudioController::OnPlaybackTimer(wxTimerEvent &)
 {
 	if (!player) return;
 
-	int64_t pos = player->GetCurrentPosition();
+	int64_t pos = GetHeardSample();
 	if (!player->IsPlaying() ||
 		(playback_mode != PM_ToEnd && pos >= player->GetEndPosition()+200))
 	{
@@ -73,10 +73,18 @@ void AudioController::OnPlaybackTimer(wxTimerEvent &)
 	}
 	else
 	{
+		// Keep the audio ahead of what's playing read in, for sources which
+		// are slow to read from or still being decoded
+		provider->Prefetch(pos);
 		AnnouncePlaybackPosition(MillisecondsFromSamples(pos));
 	}
 }
 
+int64_t AudioController::GetHeardSample()
+{
+	return std::max(playback_start, player->GetClock().PositionAt(PlaybackClock::clock::now()));
+}
+
 #ifdef wxHAS_POWER_EVENTS
 void AudioController::OnComputerSuspending(wxPowerEvent &)
 {
@@ -135,8 +143,12 @@ void AudioController::OnTimingControllerUpdatedPrimaryRange()
 void AudioController::PlayRange(const TimeRange &range)
 {
 	if (!player) return;
+	if (player->IsScrubbing())
+		player->StopScrub();
 
-	player->Play(SamplesFromMilliseconds(range.begin()), SamplesFromMilliseconds(range.length()));
+	playback_start = SamplesFromMilliseconds(range.begin());
+	provider->Prefetch(playback_start);
+	player->Play(playback_start, SamplesFromMilliseconds(range.length()));
 	playback_mode = PM_Range;
 	playback_timer.Start(20);
 
@@ -160,8 +172,12 @@ void AudioController::PlayToEndOfPrimary(int start_ms)
 void AudioController::PlayToEnd(int start_ms)
 {
 	if (!player) return;
+	if (player->IsScrubbing())
+		player->StopScrub();
 
 	int64_t start_sample = SamplesFromMilliseconds(start_ms);
+	playback_start = start_sample;
+	provider->Prefetch(start_sample);
 	player->Play(start_sample, provider->GetNumSamples()-start_sample);
 	playback_mode = PM_ToEnd;
 	playback_timer.Start(20);
@@ -169,11 +185,38 @@ void AudioController::PlayToEnd(int start_ms)
 	AnnouncePlaybackPosition(start_ms);
 }
 
+void AudioController::Scrub(int ms)
+{
+	if (!player) return;
+
+	const int64_t position = SamplesFromMilliseconds(std::max(ms, 0));
+	if (playback_mode == PM_Scrub)
+		player->SetScrubPosition(position);
+	else
+	{
+		// The position is announced as it moves, so no timer is needed
+		playback_timer.Stop();
+		player->StartScrub(position, SamplesFromMilliseconds(OPT_GET("Audio/Scrub/Length")->GetInt()));
+		playback_mode = PM_Scrub;
+	}
+
+	AnnouncePlaybackPosition(ms);
+}
+
+void AudioController::StopScrub()
+{
+	if (playback_mode == PM_Scrub)
+		Stop();
+}
+
 void AudioController::Stop()
 {
 	if (!player) return;
 
-	player->Stop();
+	if (player->IsScrubbing())
+		player->StopScrub();
+	else
+		player->Stop();
 	playback_mode = PM_NotPlaying;
 	playback_timer.Stop();
 
@@ -189,7 +232,7 @@ int AudioController::GetPlaybackPosition()
 {
 	if (!IsPlaying()) return 0;
 
-	return MillisecondsFromSamples(player->GetCurrentPosition());
+	return MillisecondsFromSamples(GetHeardSample());
 }
 
 int AudioController::GetDuration() const
@@ -75,11 +75,16 @@ class AudioController final : public wxEvtHandler {
 		PM_NotPlaying,
 		PM_Range,
 		PM_PrimaryRange,
-		PM_ToEnd
+		PM_ToEnd,
+		PM_Scrub
 	};
 	/// The current playback mode
 	PlaybackMode playback_mode = PM_NotPlaying;
 
+	/// First sample of the current playback, which the reported position is
+	/// kept from going before while the output's latency is being played out
+	int64_t playback_start = 0;
+
 	/// Timer used for playback position updates
 	wxTimer playback_timer;
 
@@ -92,6 +97,9 @@ class AudioController final : public wxEvtHandler {
 	/// Event handler for the playback timer
 	void OnPlaybackTimer(wxTimerEvent &event);
 
+	/// Get the sample being heard now according to the player's clock
+	int64_t GetHeardSample();
+
 	/// @brief Timing controller signals primary playback range changed
 	void OnTimingControllerUpdatedPrimaryRange();
 
@@ -155,6 +163,17 @@ public:
 	/// or restarted.
 	void PlayToEnd(int start_ms);
 
+	/// @brief Start scrub playback or move it to a new position
+	/// @param ms Time in milliseconds to play from
+	///
+	/// A short piece of audio is played from each position, with the output
+	/// kept open between positions so that this can be called for every
+	/// mouse movement of a drag.
+	void Scrub(int ms);
+
+	/// @brief Stop scrub playback, if that's what is playing
+	void StopScrub();
+
 	/// @brief Stop all audio playback
 	void Stop();
 
@@ -163,9 +182,11 @@ public:
 	bool IsPlaying();
 
 	/// @brief Get the current playback position
-	/// @return Approximate current time in milliseconds being heard by the user
+	/// @return Time in milliseconds being heard by the user
 	///
-	/// Returns 0 if playback is stopped. The return value is only approximate.
+	/// Returns 0 if playback is stopped. This accounts for the output's
+	/// latency and only reads the player's last report rather than querying
+	/// the device, so it can be called as often as needed.
 	int GetPlaybackPosition();
 
 	/// @brief Get the primary playback range
@@ -40,12 +40,15 @@
 #include "include/aegisub/context.h"
 #include "include/aegisub/hotkey.h"
 #include "options.h"
+#include "performance_hud.h"
 #include "project.h"
 #include "utils.h"
 #include "video_controller.h"
 
 #include <libaegisub/ass/time.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/format.h>
+#include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
@@ -541,16 +544,26 @@ class AudioMarkerInteractionObject final : public AudioDisplayInteractionObject
 	bool default_snap = OPT_GET("Audio/Snap/Enable")->GetBool();
 	// Range in pixels to snap at
 	int snap_range = OPT_GET("Audio/Snap/Distance")->GetInt();
+	// Audio controller to scrub with, or null if scrubbing is disabled
+	AudioController *scrub_controller;
 
 public:
-	AudioMarkerInteractionObject(std::vector<AudioMarker*> markers, AudioTimingController *timing_controller, AudioDisplay *display, wxMouseButton button_used)
+	AudioMarkerInteractionObject(std::vector<AudioMarker*> markers, AudioTimingController *timing_controller, AudioDisplay *display, AudioController *controller, wxMouseButton button_used)
 	: markers(std::move(markers))
 	, timing_controller(timing_controller)
 	, display(display)
 	, button_used(button_used)
+	, scrub_controller(OPT_GET("Audio/Scrub/Enable")->GetBool() ? controller : nullptr)
 	{
 	}
 
+	~AudioMarkerInteractionObject()
+	{
+		timing_controller->OnMarkerDragEnd();
+		if (scrub_controller)
+			scrub_controller->StopScrub();
+	}
+
 	bool OnMouseEvent(wxMouseEvent &event) override
 	{
 		if (event.Dragging())
@@ -559,6 +572,10 @@ public:
 				markers,
 				display->TimeFromRelativeX(event.GetPosition().x),
 				default_snap != event.ShiftDown() ? display->TimeFromAbsoluteX(snap_range) : 0);
+
+			// Play from wherever the markers ended up after snapping
+			if (scrub_controller)
+				scrub_controller->Scrub(GetPosition());
 		}
 
 		// We lose the marker drag if the button used to initiate it goes up
@@ -601,12 +618,18 @@ AudioDisplay::AudioDisplay(wxWindow *parent, AudioController *controller, agi::C
 	Bind(wxEVT_SET_FOCUS, &AudioDisplay::OnFocus, this);
 	Bind(wxEVT_CHAR_HOOK, &AudioDisplay::OnKeyDown, this);
 	Bind(wxEVT_KEY_DOWN, &AudioDisplay::OnKeyDown, this);
+	Bind(wxEVT_IDLE, &AudioDisplay::OnIdle, this);
 	scroll_timer.Bind(wxEVT_TIMER, &AudioDisplay::OnScrollTimer, this);
 	load_timer.Bind(wxEVT_TIMER, &AudioDisplay::OnLoadTimer, this);
+	hud_timer.Bind(wxEVT_TIMER, &AudioDisplay::OnHudTimer, this);
+
+	hud_connection = OPT_SUB("App/Performance HUD", &AudioDisplay::OnHudToggled, this);
+	OnHudToggled();
 }
 
 AudioDisplay::~AudioDisplay()
 {
+	SaveRendererCache();
 }
 
 void AudioDisplay::ScrollBy(int pixel_amount)
@@ -623,6 +646,8 @@ void AudioDisplay::ScrollPixelToLeft(int pixel_position)
 	if (pixel_position < 0)
 		pixel_position = 0;
 
+	if (pixel_position != scroll_left)
+		scroll_direction = pixel_position > scroll_left ? 1 : -1;
 	scroll_left = pixel_position;
 	scrollbar->SetPosition(scroll_left);
 	timeline->SetPosition(scroll_left);
@@ -740,6 +765,8 @@ void AudioDisplay::ReloadRenderingSettings()
 {
 	std::string colour_scheme_name;
 
+	SaveRendererCache();
+
 	if (OPT_GET("Audio/Spectrum")->GetBool())
 	{
 		colour_scheme_name = OPT_GET("Colour/Audio Display/Spectrum")->GetString();
@@ -760,6 +787,14 @@ void AudioDisplay::ReloadRenderingSettings()
 			spectrum_width[spectrum_quality],
 			spectrum_distance[spectrum_quality]);
 
+		audio_spectrum_renderer->SetFrequencyRange(
+			(SpectrumScale)mid<int64_t>(0, OPT_GET("Audio/Renderer/Spectrum/Frequency Scale")->GetInt(), 2),
+			OPT_GET("Audio/Renderer/Spectrum/Min Frequency")->GetInt(),
+			OPT_GET("Audio/Renderer/Spectrum/Max Frequency")->GetInt());
+
+		if (OPT_GET("Audio/Renderer/Spectrum/OpenGL")->GetBool())
+			audio_spectrum_renderer->EnableOpenGL(this);
+
 		audio_renderer_provider = std::move(audio_spectrum_renderer);
 	}
 	else
@@ -768,7 +803,10 @@ void AudioDisplay::ReloadRenderingSettings()
 		audio_renderer_provider = agi::make_unique<AudioWaveformRenderer>(colour_scheme_name);
 	}
 
+	renderer_data_ready_connection = audio_renderer_provider->AddDataReadyListener([=] { Refresh(); });
 	audio_renderer->SetRenderer(audio_renderer_provider.get());
+	if (provider && !renderer_cache_file.empty())
+		audio_renderer_provider->LoadCache(renderer_cache_file);
 	scrollbar->SetColourScheme(colour_scheme_name);
 	timeline->SetColourScheme(colour_scheme_name);
 
@@ -793,14 +831,19 @@ void AudioDisplay::OnLoadTimer(wxTimerEvent&)
 		if (new_pos > audio_load_position)
 			audio_load_position = new_pos;
 
-		const double left = last_sample_decoded * 1000.0 / provider->GetSampleRate() / ms_per_pixel;
-		const double right = new_decoded_count * 1000.0 / provider->GetSampleRate() / ms_per_pixel;
+		// Audio isn't necessarily decoded in order, so repaint if anything
+		// visible either is still being decoded or was on the last tick
+		const double samples_per_pixel = ms_per_pixel * provider->GetSampleRate() / 1000.0;
+		const bool visible_decoded = provider->IsDecoded(
+			static_cast<int64_t>(scroll_left * samples_per_pixel),
+			static_cast<int64_t>(pixel_audio_width * samples_per_pixel));
 
-		if (left < scroll_left + pixel_audio_width && right >= scroll_left)
+		if (!visible_decoded || !last_visible_decoded)
 			Refresh();
 		else
 			RefreshRect(scrollbar->GetBounds());
 		last_sample_decoded = new_decoded_count;
+		last_visible_decoded = visible_decoded;
 	}
 
 	if (!provider || last_sample_decoded == provider->GetNumSamples()) {
@@ -809,6 +852,21 @@ void AudioDisplay::OnLoadTimer(wxTimerEvent&)
 	}
 }
 
+void AudioDisplay::OnHudTimer(wxTimerEvent&)
+{
+	// The text may have grown since it was last painted
+	RefreshRect(wxRect(0, hud_bounds.y, GetClientSize().GetWidth(), hud_bounds.height));
+}
+
+void AudioDisplay::OnHudToggled()
+{
+	if (performance_hud::Visible())
+		hud_timer.Start(500);
+	else
+		hud_timer.Stop();
+	Refresh();
+}
+
 void AudioDisplay::OnPaint(wxPaintEvent&)
 {
 	if (!audio_renderer_provider || !provider) return;
@@ -845,6 +903,58 @@ void AudioDisplay::OnPaint(wxPaintEvent&)
 		scrollbar->Paint(dc, HasFocus(), audio_load_position);
 	if (redraw_timeline)
 		timeline->Paint(dc);
+
+	if (performance_hud::Visible())
+		PaintPerformanceHud(dc);
+
+	prefetch_pending = true;
+}
+
+void AudioDisplay::OnIdle(wxIdleEvent &event)
+{
+	if (!prefetch_pending || !audio_renderer_provider || !provider) return;
+
+	const int client_width = GetClientSize().GetWidth();
+	const int length = audio_renderer->GetPrefetchLength(client_width);
+	int start = scroll_direction > 0 ? scroll_left + client_width : scroll_left - length;
+	const int stop = std::min(start + length, pixel_audio_width);
+	start = std::max(start, 0);
+	if (stop <= start)
+	{
+		prefetch_pending = false;
+		return;
+	}
+
+	// Split the range up by style just as PaintAudio does
+	std::vector<std::pair<int, AudioRenderingStyle>> pieces;
+	auto pt = begin(style_ranges), pe = end(style_ranges);
+	const TimeRange range(TimeFromAbsoluteX(start), TimeFromAbsoluteX(stop));
+	while (pt != pe && pt + 1 != pe && (pt + 1)->first < range.begin()) ++pt;
+	while (pt != pe && pt->first < range.end())
+	{
+		pieces.emplace_back(std::max(start, AbsoluteXFromTime(pt->first)), static_cast<AudioRenderingStyle>(pt->second));
+		++pt;
+	}
+	if (scroll_direction < 0)
+		std::reverse(pieces.begin(), pieces.end());
+
+	// Only render a few bitmaps per idle event so that input isn't held up
+	int budget = 4;
+	for (size_t i = 0; i < pieces.size() && budget > 0; ++i)
+	{
+		const int piece_start = pieces[i].first;
+		int piece_end = stop;
+		if (scroll_direction > 0 && i + 1 < pieces.size())
+			piece_end = pieces[i + 1].first;
+		else if (scroll_direction < 0 && i > 0)
+			piece_end = pieces[i - 1].first;
+		budget -= audio_renderer->Prefetch(piece_start, piece_end - piece_start, pieces[i].second, scroll_direction < 0, budget);
+	}
+
+	if (budget > 0)
+		prefetch_pending = false;
+	else
+		event.RequestMore();
 }
 
 void AudioDisplay::PaintAudio(wxDC &dc, const TimeRange updtime, const wxRect updrect)
@@ -901,6 +1011,33 @@ void AudioDisplay::PaintFoot(wxDC &dc, int marker_x, int dir)
 	dc.DrawPolygon(3, foot_bot, marker_x, audio_top+audio_height);
 }
 
+void AudioDisplay::PaintPerformanceHud(wxDC &dc)
+{
+	auto lines = performance_hud::AudioLines(provider);
+
+	wxSize extent;
+	std::vector<wxString> text;
+	for (auto const& line : lines)
+	{
+		text.push_back(to_wx(line));
+		wxSize line_extent = dc.GetTextExtent(text.back());
+		extent.x = std::max(extent.x, line_extent.x);
+		extent.y = std::max(extent.y, line_extent.y);
+	}
+
+	// The labels are along the top, so keep out of their way
+	const int margin = 4;
+	const int height = extent.y * text.size() + margin * 2;
+	hud_bounds = wxRect(0, audio_top + audio_height - height, extent.x + margin * 2, height);
+
+	dc.SetPen(*wxTRANSPARENT_PEN);
+	dc.SetBrush(*wxBLACK_BRUSH);
+	dc.DrawRectangle(hud_bounds);
+	dc.SetTextForeground(*wxWHITE);
+	for (size_t i = 0; i < text.size(); ++i)
+		dc.DrawText(text[i], margin, hud_bounds.y + margin + extent.y * i);
+}
+
 void AudioDisplay::PaintLabels(wxDC &dc, TimeRange updtime)
 {
 	std::vector<AudioLabelProvider::AudioLabel> labels;
@@ -1106,7 +1243,7 @@ void AudioDisplay::OnMouseEvent(wxMouseEvent& event)
 		if (markers.size())
 		{
 			RemoveTrackCursor();
-			audio_marker = agi::make_unique<AudioMarkerInteractionObject>(markers, timing, this, (wxMouseButton)event.GetButton());
+			audio_marker = agi::make_unique<AudioMarkerInteractionObject>(markers, timing, this, controller, (wxMouseButton)event.GetButton());
 			SetDraggedObject(audio_marker.get());
 			return;
 		}
@@ -1199,14 +1336,28 @@ int AudioDisplay::GetDuration() const
 	return (provider->GetNumSamples() * 1000 + provider->GetSampleRate() - 1) / provider->GetSampleRate();
 }
 
+void AudioDisplay::SaveRendererCache()
+{
+	if (audio_renderer_provider && !renderer_cache_file.empty())
+		audio_renderer_provider->SaveCache(renderer_cache_file);
+}
+
 void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 {
+	SaveRendererCache();
+	renderer_cache_file.clear();
+
 	this->provider = provider;
+	if (provider && agi::fs::FileExists(context->project->AudioName()))
+		renderer_cache_file = GetSourceCacheFilename(context->project->AudioName(),
+			agi::format("_%d.spectrum", provider->GetTrackNumber()));
 
 	if (!audio_renderer_provider)
 		ReloadRenderingSettings();
 
 	audio_renderer->SetAudioProvider(provider);
+	if (!renderer_cache_file.empty())
+		audio_renderer_provider->LoadCache(renderer_cache_file);
 	audio_renderer->SetCacheMaxSize(OPT_GET("Audio/Renderer/Spectrum/Memory Max")->GetInt() * 1024 * 1024);
 
 	timeline->ChangeAudio(GetDuration());
@@ -1229,11 +1380,16 @@ void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 				OPT_SUB("Colour/Audio Display/Spectrum", &AudioDisplay::ReloadRenderingSettings, this),
 				OPT_SUB("Colour/Audio Display/Waveform", &AudioDisplay::ReloadRenderingSettings, this),
 				OPT_SUB("Audio/Renderer/Spectrum/Quality", &AudioDisplay::ReloadRenderingSettings, this),
+				OPT_SUB("Audio/Renderer/Spectrum/OpenGL", &AudioDisplay::ReloadRenderingSettings, this),
+				OPT_SUB("Audio/Renderer/Spectrum/Frequency Scale", &AudioDisplay::ReloadRenderingSettings, this),
+				OPT_SUB("Audio/Renderer/Spectrum/Min Frequency", &AudioDisplay::ReloadRenderingSettings, this),
+				OPT_SUB("Audio/Renderer/Spectrum/Max Frequency", &AudioDisplay::ReloadRenderingSettings, this),
 			});
 			OnTimingController();
 		}
 
 		last_sample_decoded = provider->GetDecodedSamples();
+		last_visible_decoded = false;
 		audio_load_position = -1;
 		audio_load_speed = 0;
 		audio_load_start_time = std::chrono::steady_clock::now();
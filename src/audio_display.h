@@ -30,6 +30,7 @@
 //
 #include <libaegisub/signal.h>
 
+#include <boost/filesystem/path.hpp>
 #include <chrono>
 #include <cstdint>
 #include <memory>
@@ -73,6 +74,13 @@ class AudioDisplay: public wxWindow {
 	/// The current audio renderer
 	std::unique_ptr<AudioRendererBitmapProvider> audio_renderer_provider;
 
+	/// Repaints when the current renderer finishes computing data in the background
+	agi::signal::Connection renderer_data_ready_connection;
+
+	/// File next to the FFMS2 index which the renderer's cached data for the
+	/// current audio is saved to, if any
+	agi::fs::path renderer_cache_file;
+
 	/// The controller managing us
 	AudioController *controller = nullptr;
 
@@ -99,6 +107,8 @@ class AudioDisplay: public wxWindow {
 
 	wxTimer load_timer;
 	int64_t last_sample_decoded = 0;
+	/// Was all of the visible audio decoded on the previous load timer tick?
+	bool last_visible_decoded = false;
 	/// Time at which audio loading began, for calculating loading speed
 	std::chrono::steady_clock::time_point audio_load_start_time;
 	/// Estimated speed of audio decoding in samples per ms
@@ -106,9 +116,22 @@ class AudioDisplay: public wxWindow {
 	/// Current position of the audio loading progress in absolute pixels
 	int audio_load_position = 0;
 
+	/// Timer for updating the performance overlay
+	wxTimer hud_timer;
+	/// Area covered by the performance overlay when it was last painted
+	wxRect hud_bounds;
+	agi::signal::Connection hud_connection;
+
 	/// Leftmost pixel in the virtual audio image being displayed
 	int scroll_left = 0;
 
+	/// Direction of the most recent scroll, which is the side of the visible
+	/// audio that bitmaps are prefetched on: 1 for right, -1 for left
+	int scroll_direction = 1;
+
+	/// Might there be bitmaps to prefetch when idle?
+	bool prefetch_pending = false;
+
 	/// Total width of the audio in pixels
 	int pixel_audio_width = 0;
 
@@ -178,6 +201,10 @@ class AudioDisplay: public wxWindow {
 	/// @param dc DC to paint to
 	void PaintTrackCursor(wxDC &dc);
 
+	/// Paint the decoding progress and render timings over the top left
+	/// corner of the audio
+	void PaintPerformanceHud(wxDC &dc);
+
 	/// Forward the mouse event to the appropriate child control, if any
 	/// @return Was the mouse event forwarded somewhere?
 	bool ForwardMouseEvent(wxMouseEvent &event);
@@ -194,12 +221,19 @@ class AudioDisplay: public wxWindow {
 	void OnKeyDown(wxKeyEvent& event);
 	void OnScrollTimer(wxTimerEvent &event);
 	void OnLoadTimer(wxTimerEvent &);
+	void OnHudTimer(wxTimerEvent &);
+	void OnHudToggled();
 	void OnMouseEnter(wxMouseEvent&);
 	void OnMouseLeave(wxMouseEvent&);
+	/// Render bitmaps next to the visible audio in the scroll direction
+	void OnIdle(wxIdleEvent &event);
 
 	int GetDuration() const;
 
 	void OnAudioOpen(agi::AudioProvider *provider);
+
+	/// Save the current renderer's cached data for the current audio
+	void SaveRendererCache();
 	void OnPlaybackPosition(int ms_position);
 	void OnSelectionChanged();
 	void OnStyleRangesChanged();
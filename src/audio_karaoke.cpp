@@ -114,10 +114,16 @@ void AudioKaraoke::OnActiveLineChanged(AssDialogue *new_line) {
 }
 
 void AudioKaraoke::OnFileChanged(int type, const AssDialogue *changed) {
-	if (enabled && (type & AssFile::COMMIT_DIAG_FULL) && (!changed || changed == active_line)) {
-		LoadFromLine();
-		split_area->Refresh(false);
-	}
+	if (!enabled || !(type & (AssFile::COMMIT_DIAG_TIME | AssFile::COMMIT_DIAG_TEXT))) return;
+	if (changed && changed != active_line) return;
+
+	// Reloading throws away uncommitted splits and rebuilds all of the
+	// timing markers, so only do it if the line actually changed
+	if (active_line->Text.get() == loaded_text && active_line->Start == loaded_start && active_line->End == loaded_end)
+		return;
+
+	LoadFromLine();
+	split_area->Refresh(false);
 }
 
 void AudioKaraoke::OnAudioOpened(agi::AudioProvider *provider) {
@@ -336,6 +342,9 @@ void AudioKaraoke::LoadFromLine() {
 	scroll_x = 0;
 	scroll_timer.Stop();
 	kara->SetLine(active_line, true);
+	loaded_text = active_line->Text;
+	loaded_start = active_line->Start;
+	loaded_end = active_line->End;
 	SetDisplayText();
 	accept_button->Enable(kara->GetText() != active_line->Text);
 	cancel_button->Enable(false);
@@ -18,6 +18,7 @@
 
 #include <memory>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <wx/bitmap.h>
@@ -73,6 +74,12 @@ class AudioKaraoke final : public wxWindow {
 	/// Karaoke data
 	std::unique_ptr<AssKaraoke> kara;
 
+	/// Text and times of the active line when kara was last loaded from it,
+	/// to skip reloading for commits which didn't change any of them
+	std::string loaded_text;
+	int loaded_start = 0;
+	int loaded_end = 0;
+
 	/// Current line's stripped text with spaces added between each syllable
 	std::vector<wxString> spaced_text;
 
@@ -27,6 +27,8 @@
 #include "project.h"
 #include "video_controller.h"
 
+#include <libaegisub/audio/peak_index.h>
+#include <libaegisub/audio/provider.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
@@ -156,3 +158,34 @@ void SecondsMarkerProvider::GetMarkers(TimeRange const& range, AudioMarkerVector
 wxPen SecondsMarkerProvider::Marker::GetStyle() const {
 	return *style;
 }
+
+SpeechBoundaryMarkerProvider::SpeechBoundaryMarkerProvider(agi::Context *c)
+: p(c->project.get())
+, pen(agi::make_unique<Pen>("Colour/Audio Display/Seconds Line", 1, wxPENSTYLE_DOT))
+, enabled(OPT_GET("Audio/Snap/Speech Boundaries"))
+{
+}
+
+SpeechBoundaryMarkerProvider::~SpeechBoundaryMarkerProvider() { }
+
+void SpeechBoundaryMarkerProvider::GetMarkers(TimeRange const& range, AudioMarkerVector &out) const {
+	if (!enabled->GetBool()) return;
+
+	auto provider = p->AudioProvider();
+	auto peaks = provider ? provider->GetPeakIndex() : nullptr;
+	if (!peaks) return;
+
+	std::vector<agi::SpeechBoundary> boundaries;
+	if (!peaks->GetSpeechBoundaries(range.begin(), range.end(), boundaries)) return;
+
+	if (boundaries.size() > markers.size())
+		markers.resize(boundaries.size(), Marker(pen.get()));
+	for (size_t i = 0; i < boundaries.size(); ++i) {
+		markers[i].position = boundaries[i].time;
+		out.push_back(&markers[i]);
+	}
+}
+
+wxPen SpeechBoundaryMarkerProvider::Marker::GetStyle() const {
+	return *style;
+}
@@ -188,3 +188,40 @@ public:
 	SecondsMarkerProvider();
 	void GetMarkers(TimeRange const& range, AudioMarkerVector &out) const override;
 };
+
+/// Marker provider for the starts and ends of speech found in the audio's
+/// energy envelope, for snapping to
+class SpeechBoundaryMarkerProvider final : public AudioMarkerProvider {
+	struct Marker final : public AudioMarker {
+		Pen *style;
+		int position = 0;
+
+		Marker(Pen *style) : style(style) { }
+		int GetPosition() const override { return position; }
+		FeetStyle GetFeet() const override { return Feet_None; }
+		wxPen GetStyle() const override;
+		operator int() const { return position; }
+	};
+
+	/// Project to get the audio from
+	Project *p;
+
+	/// Pen used by all boundary markers
+	std::unique_ptr<Pen> pen;
+
+	/// Markers returned from last call to GetMarkers
+	mutable std::vector<Marker> markers;
+
+	/// Cached reference to the option to enable/disable snapping to speech
+	const agi::OptionValue *enabled;
+
+public:
+	/// Constructor
+	/// @param c Project context
+	SpeechBoundaryMarkerProvider(agi::Context *c);
+	~SpeechBoundaryMarkerProvider();
+
+	/// Get the speech boundaries within a range, if the audio's envelope has
+	/// been fully indexed
+	void GetMarkers(TimeRange const& range, AudioMarkerVector &out) const override;
+};
@@ -38,7 +38,11 @@
 #include "factory_manager.h"
 #include "options.h"
 
+#include <libaegisub/audio/provider.h>
+
+#include <algorithm>
 #include <boost/range/iterator_range.hpp>
+#include <cstring>
 
 std::unique_ptr<AudioPlayer> CreateAlsaPlayer(agi::AudioProvider *providers, wxWindow *window);
 std::unique_ptr<AudioPlayer> CreateDirectSoundPlayer(agi::AudioProvider *providers, wxWindow *window);
@@ -78,6 +82,106 @@ namespace {
 	};
 }
 
+int64_t PlaybackClock::PositionAt(clock::time_point time) const {
+	using namespace std::chrono;
+	const auto until_heard = duration_cast<microseconds>(time - host_time) - latency;
+	return std::min(position, position + until_heard.count() * sample_rate / 1000000);
+}
+
+void AudioPlayer::UpdateClock(int64_t position, std::chrono::microseconds latency) {
+	// Normally only the audio thread reports, but starting playback may
+	// report from another thread, so writers take the odd sequence number
+	// as a lock
+	uint32_t seq = clock_seq.load(std::memory_order_relaxed) & ~1u;
+	while (!clock_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire))
+		seq &= ~1u;
+
+	clock_position.store(position, std::memory_order_relaxed);
+	clock_host_time.store(PlaybackClock::clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+	clock_latency.store(latency.count(), std::memory_order_relaxed);
+	clock_seq.store(seq + 2, std::memory_order_release);
+	clock_reported = true;
+}
+
+PlaybackClock AudioPlayer::GetClock() {
+	PlaybackClock ret;
+	ret.sample_rate = provider->GetSampleRate();
+
+	if (!clock_reported) {
+		ret.position = GetCurrentPosition();
+		ret.host_time = PlaybackClock::clock::now();
+		return ret;
+	}
+
+	uint32_t before, after;
+	do {
+		before = clock_seq.load(std::memory_order_acquire);
+		ret.position = clock_position.load(std::memory_order_relaxed);
+		ret.host_time = PlaybackClock::clock::time_point(PlaybackClock::clock::duration(clock_host_time.load(std::memory_order_relaxed)));
+		ret.latency = std::chrono::microseconds(clock_latency.load(std::memory_order_relaxed));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = clock_seq.load(std::memory_order_relaxed);
+	} while ((before & 1) || before != after);
+
+	return ret;
+}
+
+void AudioPlayer::StartScrub(int64_t position, int64_t length) {
+	if (scrubbing)
+		StopScrub();
+	else
+		Stop();
+
+	scrub_length = length;
+	scrub_target = position;
+	scrubbing = true;
+	native_scrub = StartNativeScrub();
+	if (!native_scrub)
+		Play(position, length);
+}
+
+void AudioPlayer::SetScrubPosition(int64_t position) {
+	if (!scrubbing) return;
+	if (position == scrub_target) return;
+
+	scrub_target = position;
+	if (!native_scrub)
+		Play(position, scrub_length);
+}
+
+void AudioPlayer::StopScrub() {
+	if (!scrubbing) return;
+
+	scrub_target = -1;
+	scrubbing = false;
+	if (native_scrub)
+		StopNativeScrub();
+	else
+		Stop();
+	native_scrub = false;
+}
+
+void AudioPlayer::FillScrubBuffer(ScrubReader &reader, void *buf, int64_t count, double volume) {
+	const int64_t target = scrub_target.load(std::memory_order_acquire);
+	if (target != reader.target) {
+		reader.target = target;
+		reader.position = target;
+		reader.end = target < 0 ? target : std::min(target + scrub_length, provider->GetNumSamples());
+	}
+
+	const int64_t frame_size = provider->GetBytesPerSample() * provider->GetChannels();
+	const int64_t play = std::max<int64_t>(0, std::min(count, reader.end - reader.position));
+	if (play > 0) {
+		provider->GetAudioWithVolume(buf, reader.position, play, volume);
+		reader.position += play;
+	}
+
+	// 8-bit audio is unsigned, so its silence isn't zero
+	memset(static_cast<char *>(buf) + play * frame_size,
+		provider->GetBytesPerSample() == 1 ? 0x80 : 0,
+		static_cast<size_t>((count - play) * frame_size));
+}
+
 std::vector<std::string> AudioPlayerFactory::GetClasses() {
 	return ::GetClasses(boost::make_iterator_range(std::begin(factories), std::end(factories)));
 }
@@ -40,6 +40,7 @@
 #include "frame_main.h"
 #include "options.h"
 
+#include <libaegisub/audio/feeder.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
@@ -61,6 +62,7 @@ namespace {
 enum class Message {
 	None,
 	Start,
+	Scrub,
 	Stop,
 	Close
 };
@@ -80,25 +82,27 @@ class AlsaPlayer final : public AudioPlayer {
 	int64_t start_position = 0;
 	std::atomic<int64_t> end_position{0};
 
-	std::mutex position_mutex;
-	int64_t last_position = 0;
-	clock::time_point last_position_time;
-
 	std::vector<char> decode_buffer;
 
+	/// Reads ahead from the provider so that this thread never blocks on it
+	agi::AudioFeeder feeder{provider, (size_t)provider->GetSampleRate()};
+
 	std::thread thread;
 
 	void PlaybackThread();
 
+	/// @brief Play scrub output until told to do something else
+	/// @return false if the thread should exit
+	bool ScrubLoop(snd_pcm_t *pcm, size_t framesize, std::unique_lock<std::mutex> &lock);
+
+	bool StartNativeScrub() override;
+	void StopNativeScrub() override;
+
 	void UpdatePlaybackPosition(snd_pcm_t *pcm, int64_t position)
 	{
 		snd_pcm_sframes_t delay;
 		if (snd_pcm_delay(pcm, &delay) == 0)
-		{
-			std::unique_lock<std::mutex> playback_lock;
-			last_position = position - delay;
-			last_position_time = clock::now();
-		}
+			UpdateClock(position, std::chrono::microseconds(delay * 1000000 / provider->GetSampleRate()));
 	}
 
 public:
@@ -109,7 +113,7 @@ public:
 	void Stop() override;
 	bool IsPlaying() override { return playing; }
 
-	void SetVolume(double vol) override { volume = vol; }
+	void SetVolume(double vol) override { volume = vol; feeder.SetVolume(vol); }
 	int64_t GetEndPosition() override { return end_position; }
 	int64_t GetCurrentPosition() override;
 	void SetEndPosition(int64_t pos) override;
@@ -161,6 +165,13 @@ do_setup:
 			cond.wait(lock, [&] { return message != Message::None; });
 			if (message == Message::Close)
 				return;
+			if (message == Message::Scrub)
+			{
+				message = Message::None;
+				if (!ScrubLoop(pcm, framesize, lock))
+					return;
+				continue;
+			}
 			if (message == Message::Start && end_position > start_position)
 				break;
 			// Not playing, so don't need to stop...
@@ -174,8 +185,9 @@ do_setup:
 		// Initial buffer-fill
 		{
 			auto avail = std::min(snd_pcm_avail(pcm), (snd_pcm_sframes_t)(end_position-position));
+			feeder.Start(position, end_position, avail);
 			decode_buffer.resize(avail * framesize);
-			provider->GetAudioWithVolume(decode_buffer.data(), position, avail, volume);
+			feeder.Read(decode_buffer.data(), avail);
 
 			snd_pcm_sframes_t written = 0;
 			while (written <= 0)
@@ -189,7 +201,7 @@ do_setup:
 					return;
 				}
 			}
-			position += written;
+			position += avail;
 		}
 
 		// Start playback
@@ -198,7 +210,7 @@ do_setup:
 
 		UpdatePlaybackPosition(pcm, position);
 		playing = true;
-		BOOST_SCOPE_EXIT_ALL(&) { playing = false; };
+		BOOST_SCOPE_EXIT_ALL(&) { playing = false; feeder.Stop(); };
 		while (true)
 		{
 			// Sleep a bit, or until an event
@@ -211,7 +223,7 @@ do_setup:
 			}
 
 			// Check for stop signal
-			if (message == Message::Stop || message == Message::Start)
+			if (message == Message::Stop || message == Message::Start || message == Message::Scrub)
 			{
 				LOG_D("audio/player/alsa") << "playback loop, stop signal";
 				snd_pcm_drop(pcm);
@@ -235,11 +247,14 @@ do_setup:
 
 			{
 				decode_buffer.resize(avail * framesize);
-				provider->GetAudioWithVolume(decode_buffer.data(), position, avail, volume);
-				snd_pcm_sframes_t written = 0;
-				while (written <= 0)
+				feeder.Read(decode_buffer.data(), avail);
+
+				// The feeder has moved on past everything it returned, so
+				// write all of it even if the device only takes some at once
+				snd_pcm_sframes_t done = 0;
+				while (done < avail)
 				{
-					written = snd_pcm_writei(pcm, decode_buffer.data(), avail);
+					snd_pcm_sframes_t written = snd_pcm_writei(pcm, decode_buffer.data() + done * framesize, avail - done);
 					if (written == -ESTRPIPE || written == -EPIPE)
 						snd_pcm_recover(pcm, written, 0);
 					else if (written == 0)
@@ -249,8 +264,10 @@ do_setup:
 						LOG_D("audio/player/alsa") << "error filling buffer, written=" << written;
 						return;
 					}
+					else
+						done += written;
 				}
-				position += written;
+				position += avail;
 			}
 
 			UpdatePlaybackPosition(pcm, position);
@@ -289,6 +306,78 @@ do_setup:
 	}
 }
 
+bool AlsaPlayer::ScrubLoop(snd_pcm_t *pcm, size_t framesize, std::unique_lock<std::mutex> &lock)
+{
+	snd_pcm_uframes_t buffer_size, period_size;
+	if (snd_pcm_get_params(pcm, &buffer_size, &period_size) != 0)
+		return false;
+
+	// Normal playback keeps the whole 100 ms buffer full, but that would
+	// make moving the scrub position take that long to be heard, so only
+	// keep about 10 ms queued and top it up every couple of milliseconds
+	const snd_pcm_sframes_t fill = std::min<snd_pcm_sframes_t>(buffer_size,
+		std::max<snd_pcm_sframes_t>(period_size, provider->GetSampleRate() / 100));
+
+	LOG_D("audio/player/alsa") << "starting scrub, buffer " << fill << " frames";
+	ScrubReader reader;
+	while (true)
+	{
+		if (message != Message::None)
+		{
+			snd_pcm_drop(pcm);
+			if (message == Message::Close)
+				return false;
+			snd_pcm_prepare(pcm);
+			LOG_D("audio/player/alsa") << "scrub finished";
+			return true;
+		}
+
+		snd_pcm_sframes_t avail = snd_pcm_avail(pcm);
+		if (avail == -EPIPE)
+		{
+			if (snd_pcm_recover(pcm, -EPIPE, 1) < 0)
+				return false;
+			avail = snd_pcm_avail(pcm);
+		}
+		if (avail < 0)
+			return false;
+
+		const snd_pcm_sframes_t queued = (snd_pcm_sframes_t)buffer_size - avail;
+		if (queued < fill)
+		{
+			const snd_pcm_sframes_t count = fill - queued;
+			decode_buffer.resize(count * framesize);
+			FillScrubBuffer(reader, decode_buffer.data(), count, volume);
+			snd_pcm_sframes_t written = snd_pcm_writei(pcm, decode_buffer.data(), count);
+			if (written == -ESTRPIPE || written == -EPIPE)
+				snd_pcm_recover(pcm, written, 0);
+			else if (written < 0)
+			{
+				LOG_D("audio/player/alsa") << "error filling scrub buffer, written=" << written;
+				return false;
+			}
+
+			if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED)
+				snd_pcm_start(pcm);
+		}
+
+		cond.wait_for(lock, std::chrono::milliseconds{2});
+	}
+}
+
+bool AlsaPlayer::StartNativeScrub()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	message = Message::Scrub;
+	cond.notify_all();
+	return true;
+}
+
+void AlsaPlayer::StopNativeScrub()
+{
+	Stop();
+}
+
 AlsaPlayer::AlsaPlayer(agi::AudioProvider *provider) try
 : AudioPlayer(provider)
 , thread(&AlsaPlayer::PlaybackThread, this)
@@ -315,6 +404,7 @@ void AlsaPlayer::Play(int64_t start, int64_t count)
 	message = Message::Start;
 	start_position = start;
 	end_position = start + count;
+	UpdateClock(start, std::chrono::microseconds(0));
 	cond.notify_all();
 }
 
@@ -329,21 +419,12 @@ void AlsaPlayer::SetEndPosition(int64_t pos)
 {
 	std::unique_lock<std::mutex> lock(mutex);
 	end_position = pos;
+	feeder.SetEnd(pos);
 }
 
 int64_t AlsaPlayer::GetCurrentPosition()
 {
-	int64_t lastpos;
-	clock::time_point lasttime;
-
-	{
-		std::unique_lock<std::mutex> playback_lock;
-		lastpos = last_position;
-		lasttime = last_position_time;
-	}
-
-	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - lasttime).count();
-	return lastpos + ms * provider->GetSampleRate() / 1000;
+	return GetClock().PositionAt(clock::now());
 }
 }
 
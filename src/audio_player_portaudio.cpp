@@ -173,28 +173,47 @@ void PortAudioPlayer::paStreamFinishedCallback(void *) {
 	LOG_D("audio/player/portaudio") << "stopping stream";
 }
 
+bool PortAudioPlayer::StartStream() {
+	if (IsPlaying()) return true;
+
+	PaError err = Pa_SetStreamFinishedCallback(stream, paStreamFinishedCallback);
+	if (err != paNoError) {
+		LOG_D("audio/player/portaudio") << "could not set FinishedCallback";
+		return false;
+	}
+
+	err = Pa_StartStream(stream);
+	if (err != paNoError) {
+		LOG_D("audio/player/portaudio") << "error playing stream";
+		return false;
+	}
+	return true;
+}
+
 void PortAudioPlayer::Play(int64_t start_sample, int64_t count) {
 	current = start_sample;
 	start = start_sample;
 	end = start_sample + count;
+	UpdateClock(start_sample, std::chrono::microseconds(0));
 
 	// Start playing
-	if (!IsPlaying()) {
-		PaError err = Pa_SetStreamFinishedCallback(stream, paStreamFinishedCallback);
-		if (err != paNoError) {
-			LOG_D("audio/player/portaudio") << "could not set FinishedCallback";
-			return;
-		}
-
-		err = Pa_StartStream(stream);
-		if (err != paNoError) {
-			LOG_D("audio/player/portaudio") << "error playing stream";
-			return;
-		}
-	}
+	if (!StartStream()) return;
 	pa_start = Pa_GetStreamTime(stream);
 }
 
+bool PortAudioPlayer::StartNativeScrub() {
+	scrub_reader = ScrubReader();
+	scrub_active = true;
+	if (StartStream()) return true;
+	scrub_active = false;
+	return false;
+}
+
+void PortAudioPlayer::StopNativeScrub() {
+	Pa_StopStream(stream);
+	scrub_active = false;
+}
+
 void PortAudioPlayer::Stop() {
 	Pa_StopStream(stream);
 }
@@ -217,6 +236,13 @@ int PortAudioPlayer::paCallback(const void *inputBuffer, void *outputBuffer,
 		<< " CPU: " << Pa_GetStreamCpuLoad(player->stream);
 #endif
 
+	// The stream is already running with PortAudio's low latency setting,
+	// so scrubbing just has to follow the target
+	if (player->scrub_active) {
+		player->FillScrubBuffer(player->scrub_reader, outputBuffer, framesPerBuffer, player->GetVolume());
+		return paContinue;
+	}
+
 	// Calculate how much left
 	int64_t lenAvailable = std::min<int64_t>(player->end - player->current, framesPerBuffer);
 
@@ -227,6 +253,15 @@ int PortAudioPlayer::paCallback(const void *inputBuffer, void *outputBuffer,
 		// Set play position
 		player->current += lenAvailable;
 
+		// The DAC time is when the start of this buffer will be heard, but
+		// not all host APIs supply it
+		const int rate = player->provider->GetSampleRate();
+		PaTime latency = timeInfo->outputBufferDacTime > 0
+			? timeInfo->outputBufferDacTime - timeInfo->currentTime
+			: Pa_GetStreamInfo(player->stream)->outputLatency;
+		latency += (double)lenAvailable / rate;
+		player->UpdateClock(player->current, std::chrono::microseconds((int64_t)(latency * 1000000)));
+
 		// Continue as normal
 		return 0;
 	}
@@ -237,25 +272,7 @@ int PortAudioPlayer::paCallback(const void *inputBuffer, void *outputBuffer,
 
 int64_t PortAudioPlayer::GetCurrentPosition() {
 	if (!IsPlaying()) return 0;
-
-	PaTime pa_time = Pa_GetStreamTime(stream);
-	int64_t real = (pa_time - pa_start) * provider->GetSampleRate() + start;
-
-	// If portaudio isn't giving us time info then estimate based on buffer fill and current latency
-	if (pa_time == 0 && pa_start == 0)
-		real = current - Pa_GetStreamInfo(stream)->outputLatency * provider->GetSampleRate();
-
-#ifdef PORTAUDIO_DEBUG
-	LOG_D("audio/player/portaudio") << "GetCurrentPosition:"
-		<< " pa_time: " << pa_time
-		<< " start: " << start
-		<< " current: " << current
-		<< " pa_start: " << pa_start
-		<< " real: " << real
-		<< " diff: " << pa_time - pa_start;
-#endif
-
-	return real;
+	return GetClock().PositionAt(PlaybackClock::clock::now());
 }
 
 wxArrayString PortAudioPlayer::GetOutputDevices() {
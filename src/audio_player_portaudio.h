@@ -65,6 +65,9 @@ class PortAudioPlayer final : public AudioPlayer {
 
 	PaStream *stream = nullptr; ///< PortAudio stream
 
+	std::atomic<bool> scrub_active{false}; ///< Is the callback scrubbing?
+	ScrubReader scrub_reader;              ///< Callback's scrub state
+
 	/// @brief PortAudio callback, used to fill buffer for playback, and prime the playback buffer.
 	/// @param inputBuffer     Input buffer.
 	/// @param outputBuffer    Output buffer.
@@ -93,6 +96,12 @@ class PortAudioPlayer final : public AudioPlayer {
 
 	void OpenStream();
 
+	/// Start the stream if it isn't already running
+	bool StartStream();
+
+	bool StartNativeScrub() override;
+	void StopNativeScrub() override;
+
 public:
 	/// @brief Constructor
 	PortAudioPlayer(agi::AudioProvider *provider);
@@ -38,10 +38,12 @@
 #include "audio_controller.h"
 #include "utils.h"
 
+#include <libaegisub/audio/feeder.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
+#include <atomic>
 #include <cstdio>
 #include <pulse/pulseaudio.h>
 #include <wx/thread.h>
@@ -69,16 +71,34 @@ class PulseAudioPlayer final : public AudioPlayer {
 	pa_stream *stream = nullptr;
 	volatile pa_stream_state_t sstate;
 
-	volatile pa_usec_t play_start_time; // timestamp when playback was started
-
 	int paerror = 0;
 
+	/// Reads ahead from the provider so that the write callback, which runs
+	/// on the mainloop thread, never blocks on it. The server asks for about
+	/// two seconds at once by default, so this has to hold more than that.
+	agi::AudioFeeder feeder{provider, (size_t)provider->GetSampleRate() * 4};
+
+	/// Is the write callback producing scrub output?
+	std::atomic<bool> scrub_active{false};
+	/// Write callback's scrub state
+	ScrubReader scrub_reader;
+	/// Buffer attributes to restore after scrubbing
+	pa_buffer_attr normal_buffer_attr;
+
+	/// Set the stream's buffer attributes and wait for it to finish
+	void SetBufferAttr(pa_buffer_attr const& attr);
+
+	bool StartNativeScrub() override;
+	void StopNativeScrub() override;
+
 	/// Called by PA to notify about other context-related stuff
 	static void pa_context_notify(pa_context *c, PulseAudioPlayer *thread);
 	/// Called by PA when a stream operation completes
 	static void pa_stream_success(pa_stream *p, int success, PulseAudioPlayer *thread);
 	/// Called by PA to request more data written to stream
 	static void pa_stream_write(pa_stream *p, size_t length, PulseAudioPlayer *thread);
+	/// Report the position written up to and the stream's latency to the clock
+	void UpdateStreamClock();
 	/// Called by PA to notify about other stream-related stuff
 	static void pa_stream_notify(pa_stream *p, PulseAudioPlayer *thread);
 
@@ -94,7 +114,7 @@ public:
 	int64_t GetCurrentPosition();
 	void SetEndPosition(int64_t pos);
 
-	void SetVolume(double vol) { volume = vol; }
+	void SetVolume(double vol) { volume = vol; feeder.SetVolume(vol); }
 };
 
 PulseAudioPlayer::PulseAudioPlayer(agi::AudioProvider *provider) : AudioPlayer(provider) {
@@ -206,17 +226,14 @@ void PulseAudioPlayer::Play(int64_t start,int64_t count)
 	end_frame = start + count;
 
 	is_playing = true;
+	UpdateClock(start, std::chrono::microseconds(0));
 
-	play_start_time = 0;
-	pa_threaded_mainloop_lock(mainloop);
-	paerror = pa_stream_get_time(stream, (pa_usec_t*) &play_start_time);
-	pa_threaded_mainloop_unlock(mainloop);
-	if (paerror)
-		LOG_E("audio/player/pulse") << "Error getting stream time: " << pa_strerror(paerror) << "(" << paerror << ")";
-
-	PulseAudioPlayer::pa_stream_write(stream, pa_stream_writable_size(stream), this);
-
+	// The write callback is called with the mainloop locked, so this keeps
+	// it from reading from the feeder while it's being restarted
 	pa_threaded_mainloop_lock(mainloop);
+	size_t writable = pa_stream_writable_size(stream);
+	feeder.Start(start, start + count, writable / bpf);
+	PulseAudioPlayer::pa_stream_write(stream, writable, this);
 	pa_operation *op = pa_stream_trigger(stream, (pa_stream_success_cb_t)pa_stream_success, this);
 	pa_threaded_mainloop_unlock(mainloop);
 	stream_success.Wait();
@@ -236,6 +253,7 @@ void PulseAudioPlayer::Stop()
 	start_frame = 0;
 	cur_frame = 0;
 	end_frame = 0;
+	feeder.Stop();
 
 	// Flush the stream of data
 	pa_threaded_mainloop_lock(mainloop);
@@ -249,24 +267,87 @@ void PulseAudioPlayer::Stop()
 	}
 }
 
+void PulseAudioPlayer::SetBufferAttr(pa_buffer_attr const& attr)
+{
+	pa_threaded_mainloop_lock(mainloop);
+	pa_operation *op = pa_stream_set_buffer_attr(stream, &attr, (pa_stream_success_cb_t)pa_stream_success, this);
+	pa_threaded_mainloop_unlock(mainloop);
+	stream_success.Wait();
+	pa_operation_unref(op);
+	if (!stream_success_val) {
+		paerror = pa_context_errno(context);
+		LOG_E("audio/player/pulse") << "Error setting buffer attributes: " << pa_strerror(paerror) << "(" << paerror << ")";
+	}
+}
+
+bool PulseAudioPlayer::StartNativeScrub()
+{
+	pa_threaded_mainloop_lock(mainloop);
+	const pa_buffer_attr *current = pa_stream_get_buffer_attr(stream);
+	if (current)
+		normal_buffer_attr = *current;
+	pa_threaded_mainloop_unlock(mainloop);
+	if (!current)
+		return false;
+
+	// The server normally asks for a couple of seconds of audio, all of
+	// which would have to play out before a new scrub position is heard,
+	// so keep only about 10 ms buffered while scrubbing
+	pa_sample_spec const& ss = *pa_stream_get_sample_spec(stream);
+	pa_buffer_attr attr;
+	attr.maxlength = (uint32_t)-1;
+	attr.tlength = pa_usec_to_bytes(10 * 1000, &ss);
+	attr.prebuf = 0;
+	attr.minreq = pa_usec_to_bytes(2 * 1000, &ss);
+	attr.fragsize = (uint32_t)-1;
+	SetBufferAttr(attr);
+
+	scrub_reader = ScrubReader();
+	scrub_active = true;
+
+	pa_threaded_mainloop_lock(mainloop);
+	PulseAudioPlayer::pa_stream_write(stream, pa_stream_writable_size(stream), this);
+	pa_operation *op = pa_stream_trigger(stream, (pa_stream_success_cb_t)pa_stream_success, this);
+	pa_threaded_mainloop_unlock(mainloop);
+	stream_success.Wait();
+	pa_operation_unref(op);
+
+	return true;
+}
+
+void PulseAudioPlayer::StopNativeScrub()
+{
+	scrub_active = false;
+
+	pa_threaded_mainloop_lock(mainloop);
+	pa_operation *op = pa_stream_flush(stream, (pa_stream_success_cb_t)pa_stream_success, this);
+	pa_threaded_mainloop_unlock(mainloop);
+	stream_success.Wait();
+	pa_operation_unref(op);
+
+	SetBufferAttr(normal_buffer_attr);
+}
+
 void PulseAudioPlayer::SetEndPosition(int64_t pos)
 {
 	end_frame = pos;
+	feeder.SetEnd(pos);
 }
 
 int64_t PulseAudioPlayer::GetCurrentPosition()
 {
 	if (!is_playing) return 0;
+	return GetClock().PositionAt(PlaybackClock::clock::now());
+}
 
-	// FIXME: this should be based on not duration played but actual sample being heard
-	// (during vidoeo playback, cur_frame might get changed to resync)
-
-	// Calculation duration we have played, in microseconds
-	pa_usec_t play_cur_time;
-	pa_stream_get_time(stream, &play_cur_time);
-	pa_usec_t playtime = play_cur_time - play_start_time;
-
-	return start_frame + playtime * provider->GetSampleRate() / (1000*1000);
+void PulseAudioPlayer::UpdateStreamClock()
+{
+	// Fails until the server has sent the first timing update, in which
+	// case the clock just keeps counting from the last report
+	pa_usec_t latency;
+	int negative;
+	if (pa_stream_get_latency(stream, &latency, &negative) == 0)
+		UpdateClock(cur_frame, std::chrono::microseconds(negative ? 0 : latency));
 }
 
 /// @brief Called by PA to notify about other context-related stuff
@@ -286,6 +367,15 @@ void PulseAudioPlayer::pa_stream_success(pa_stream *p, int success, PulseAudioPl
 /// @brief Called by PA to request more data (and other things?)
 void PulseAudioPlayer::pa_stream_write(pa_stream *p, size_t length, PulseAudioPlayer *thread)
 {
+	if (thread->scrub_active) {
+		unsigned long frames = length / thread->bpf;
+		if (!frames) return;
+		void *buf = malloc(frames * thread->bpf);
+		thread->FillScrubBuffer(thread->scrub_reader, buf, frames, thread->volume);
+		::pa_stream_write(p, buf, frames * thread->bpf, free, 0, PA_SEEK_RELATIVE);
+		return;
+	}
+
 	if (!thread->is_playing) return;
 
 	if (thread->cur_frame >= thread->end_frame + thread->provider->GetSampleRate()) {
@@ -300,6 +390,7 @@ void PulseAudioPlayer::pa_stream_write(pa_stream *p, size_t length, PulseAudioPl
 		void *buf = calloc(length, 1);
 		::pa_stream_write(p, buf, length, free, 0, PA_SEEK_RELATIVE);
 		thread->cur_frame += length / thread->bpf;
+		thread->UpdateStreamClock();
 		return;
 	}
 
@@ -308,9 +399,10 @@ void PulseAudioPlayer::pa_stream_write(pa_stream *p, size_t length, PulseAudioPl
 	unsigned long maxframes = thread->end_frame - thread->cur_frame;
 	if (frames > maxframes) frames = maxframes;
 	void *buf = malloc(frames * bpf);
-	thread->provider->GetAudioWithVolume(buf, thread->cur_frame, frames, thread->volume);
+	thread->feeder.Read(buf, frames);
 	::pa_stream_write(p, buf, frames*bpf, free, 0, PA_SEEK_RELATIVE);
 	thread->cur_frame += frames;
+	thread->UpdateStreamClock();
 }
 
 /// @brief Called by PA to notify about other stuff
@@ -17,15 +17,23 @@
 #include "audio_provider_factory.h"
 
 #include "factory_manager.h"
+#include "media_staging.h"
 #include "options.h"
 #include "utils.h"
 
+#include <libaegisub/audio/peak_index.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/disk_cache.h>
+#include <libaegisub/format.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/io.h>
 #include <libaegisub/log.h>
 #include <libaegisub/path.h>
 
+#include <boost/crc.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <map>
+#include <mutex>
 
 using namespace agi;
 
@@ -39,6 +47,29 @@ struct factory {
 	bool hidden;
 };
 
+/// Generate a name for the saved peak index, which is keyed on the source
+/// file in the same way as the FFMS2 index
+fs::path PeaksFilename(fs::path const& filename, AudioProvider const& provider) {
+	return GetSourceCacheFilename(filename, agi::format("_%d.peaks", provider.GetTrackNumber()));
+}
+
+/// Generate a name for the HD cache file which is unique to both the source
+/// file and the format the audio will be decoded to
+std::string CacheKey(fs::path const& filename, const char *provider_name, int track, AudioProvider const& provider) {
+	if (!fs::FileExists(filename)) return "";
+
+	auto const& str = filename.string();
+	boost::crc_32_type hash;
+	hash.process_bytes(str.c_str(), str.size());
+	hash.process_bytes(provider_name, strlen(provider_name));
+
+	return agi::format("%u_%d_%d_%d_%d_%d_%d_%d", hash.checksum(),
+		fs::Size(filename), fs::ModifiedTime(filename), track,
+		provider.GetNumSamples(), provider.GetSampleRate(),
+		provider.GetChannels() * provider.GetBytesPerSample(),
+		provider.AreSamplesFloat());
+}
+
 const factory providers[] = {
 	{"Dummy", CreateDummyAudioProvider, true},
 	{"PCM", CreatePCMAudioProvider, true},
@@ -62,16 +93,19 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 	auto sorted = GetSorted(boost::make_iterator_range(std::begin(providers), std::end(providers)), preferred);
 
 	std::unique_ptr<AudioProvider> provider;
+	const char *provider_name = nullptr;
 	bool found_file = false;
 	bool found_audio = false;
 	std::string msg_all;     // error messages from all attempted providers
 	std::string msg_partial; // error messages from providers that could partially load the file (knows container, missing codec)
+	auto source = StagedMediaPath(filename);
 
 	for (auto const& factory : sorted) {
 		try {
-			provider = factory->create(filename, br);
+			provider = factory->create(source, br);
 			if (!provider) continue;
 			LOG_I("audio_provider") << "Using audio provider: " << factory->name;
+			provider_name = factory->name;
 			break;
 		}
 		catch (fs::FileNotFound const& err) {
@@ -101,28 +135,154 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 		throw fs::FileNotFound(filename);
 	}
 
-	bool needs_cache = provider->NeedsCache();
+	int cache = provider->NeedsCache() ? OPT_GET("Audio/Cache/Type")->GetInt() : 0;
+	return WrapAudioProvider(std::move(provider), cache, filename, provider_name, path_helper);
+}
+
+std::unique_ptr<AudioProvider> WrapAudioProvider(std::unique_ptr<AudioProvider> provider, int cache,
+                                                 fs::path const& filename, const char *provider_name,
+                                                 Path const& path_helper) {
+	int track = provider->GetTrackNumber();
 
 	// Give it a converter if needed
-	if (provider->GetBytesPerSample() != 2 || provider->GetSampleRate() < 32000 || provider->GetChannels() != 1)
-		provider = CreateConvertAudioProvider(std::move(provider));
+	auto needs_convert = [](AudioProvider const& p) {
+		return p.GetBytesPerSample() != 2 || p.GetSampleRate() < 32000 || p.GetChannels() != 1;
+	};
 
 	// Change provider to RAM/HD cache if needed
-	int cache = OPT_GET("Audio/Cache/Type")->GetInt();
-	if (!cache || !needs_cache)
+	if (!cache) {
+		if (needs_convert(*provider))
+			provider = CreateConvertAudioProvider(std::move(provider));
 		return CreateLockAudioProvider(std::move(provider));
+	}
+
+	// Cache the audio as decoded and convert it when it's read from the
+	// cache, so that exporting gets the original channels and bit depth.
+	// The compressed cache only handles 16-bit mono.
+	const bool native = (cache == 1 || cache == 2) && OPT_GET("Audio/Cache/Native Format")->GetBool();
+	auto convert = [&](std::unique_ptr<AudioProvider> p) {
+		if (!native && needs_convert(*p))
+			p = CreateConvertAudioProvider(std::move(p));
+		return p;
+	};
+	auto convert_cache = [&](std::unique_ptr<AudioProvider> p) {
+		if (native && needs_convert(*p))
+			p = CreateConvertAudioProvider(std::move(p));
+		return p;
+	};
+
+	// Open more instances of the source for decoding in parallel, if wanted
+	// and supported by the provider
+	std::vector<std::unique_ptr<AudioProvider>> extra_sources;
+	for (int64_t i = 1; i < OPT_GET("Audio/Cache/Decoder Threads")->GetInt(); ++i) {
+		auto clone = provider->Clone();
+		if (!clone) break;
+		extra_sources.push_back(convert(std::move(clone)));
+	}
+
+	provider = convert(std::move(provider));
 
 	// Convert to RAM
-	if (cache == 1) return CreateRAMAudioProvider(std::move(provider));
+	if (cache == 1) return convert_cache(CreateRAMAudioProvider(std::move(provider), std::move(extra_sources)));
 
 	// Convert to HD
 	if (cache == 2) {
 		auto path = OPT_GET("Audio/Cache/HD/Location")->GetString();
 		if (path == "default")
-			path = "?temp";
+			path = "?local/audiocache";
 		auto cache_dir = path_helper.MakeAbsolute(path_helper.Decode(path), "?temp");
-		return CreateHDAudioProvider(std::move(provider), cache_dir);
+		fs::CreateDirectory(cache_dir);
+
+		auto key = CacheKey(filename, provider_name, track, *provider);
+		auto hd = CreateHDAudioProvider(std::move(provider), std::move(extra_sources), cache_dir, key);
+		// Files which aren't kept are deleted when the provider is closed
+		if (!key.empty())
+			GetAudioDiskCache(cache_dir).Added(cache_dir / ("audio-" + key + ".pcm"));
+		return convert_cache(std::move(hd));
 	}
 
+	// Convert to compressed RAM
+	if (cache == 3) return CreateCompressedRAMAudioProvider(std::move(provider), std::move(extra_sources));
+
 	throw InternalError("Invalid audio caching method");
 }
+
+namespace {
+/// Open audio by the file and the settings it was opened with
+struct {
+	std::mutex mutex;
+	std::map<std::string, std::weak_ptr<AudioProvider>> providers;
+} shared_providers;
+
+/// Key for an audio file in shared_providers. Everything which changes how
+/// the audio is decoded or cached is part of the key, so that reloading the
+/// audio after changing one of them opens it again.
+std::string SharedProviderKey(fs::path const& filename) {
+	std::string key = filename.string();
+	for (auto name : {"Audio/Provider", "Audio/Cache/HD/Location", "Provider/Audio/FFmpegSource/Decode Error Handling"})
+		key += '\0' + OPT_GET(name)->GetString();
+	for (auto name : {"Audio/Cache/Type", "Audio/Cache/Decoder Threads"})
+		key += '\0' + std::to_string(OPT_GET(name)->GetInt());
+	key += OPT_GET("Audio/Cache/Native Format")->GetBool() ? '1' : '0';
+	return key;
+}
+}
+
+std::shared_ptr<AudioProvider> GetSharedAudioProvider(fs::path const& filename,
+                                                      Path const& path_helper,
+                                                      BackgroundRunner *br) {
+	auto key = SharedProviderKey(filename);
+	{
+		std::lock_guard<std::mutex> lock(shared_providers.mutex);
+		if (auto provider = shared_providers.providers[key].lock())
+			return provider;
+	}
+
+	// Opened without holding the lock, as caching can take a while
+	std::shared_ptr<AudioProvider> provider = GetAudioProvider(filename, path_helper, br);
+
+	std::lock_guard<std::mutex> lock(shared_providers.mutex);
+	// Drop the entries for audio which nothing has open any more
+	for (auto it = shared_providers.providers.begin(); it != shared_providers.providers.end(); ) {
+		if (it->second.expired())
+			it = shared_providers.providers.erase(it);
+		else
+			++it;
+	}
+	// If another window opened the audio at the same time, use its copy
+	auto& slot = shared_providers.providers[key];
+	if (auto existing = slot.lock())
+		return existing;
+	slot = provider;
+	return provider;
+}
+
+void LoadAudioPeaks(AudioProvider const& provider, fs::path const& filename) {
+	auto peaks = provider.GetPeakIndex();
+	if (!peaks || !fs::FileExists(filename)) return;
+
+	try {
+		auto path = PeaksFilename(filename, provider);
+		if (!fs::FileExists(path)) return;
+		if (peaks->Load(*io::Open(path, true)))
+			LOG_D("audio_provider") << "Loaded peaks from " << path;
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("audio_provider") << "Failed to load peaks: " << e.GetMessage();
+	}
+}
+
+void SaveAudioPeaks(AudioProvider const& provider, fs::path const& filename) {
+	auto peaks = provider.GetPeakIndex();
+	if (!peaks || !peaks->IsComplete() || !fs::FileExists(filename)) return;
+
+	try {
+		auto path = PeaksFilename(filename, provider);
+		if (fs::FileExists(path)) return;
+		peaks->Save(io::Save(path, true).Get());
+		GetMediaCache().Added(path);
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("audio_provider") << "Failed to save peaks: " << e.GetMessage();
+	}
+}
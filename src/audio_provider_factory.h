@@ -29,3 +29,35 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(agi::fs::path const& filena
                                                      agi::Path const& path_helper,
                                                      agi::BackgroundRunner *br);
 std::vector<std::string> GetAudioProviderNames();
+
+/// @brief Wrap an opened audio source in the converter and cache which
+///        GetAudioProvider would give it
+/// @param provider Source to wrap
+/// @param cache Type of cache to use, as in Audio/Cache/Type, or 0 for none
+/// @param filename File the source was opened from, for naming the HD cache
+/// @param provider_name Name of the source's provider, for naming the HD cache
+/// @param path_helper Path helper for finding the HD cache directory
+///
+/// The other cache settings are read from the options.
+std::unique_ptr<agi::AudioProvider> WrapAudioProvider(std::unique_ptr<agi::AudioProvider> provider, int cache,
+                                                      agi::fs::path const& filename, const char *provider_name,
+                                                      agi::Path const& path_helper);
+
+/// @brief Get a provider for an audio file which is shared with everything
+///        else which has the file open with the same settings
+///
+/// Windows with the same audio open would otherwise each decode and cache
+/// it separately. Audio providers can be read from several threads at once,
+/// so the windows use the same provider, which is closed once all of them
+/// let go of it.
+std::shared_ptr<agi::AudioProvider> GetSharedAudioProvider(agi::fs::path const& filename,
+                                                           agi::Path const& path_helper,
+                                                           agi::BackgroundRunner *br);
+
+/// Fill in the provider's peak index from the copy saved next to the FFMS2
+/// index for the file, if there is one
+void LoadAudioPeaks(agi::AudioProvider const& provider, agi::fs::path const& filename);
+
+/// Save the provider's peak index next to the FFMS2 index for the file, if
+/// every sample has been decoded and it hasn't been saved already
+void SaveAudioPeaks(agi::AudioProvider const& provider, agi::fs::path const& filename);
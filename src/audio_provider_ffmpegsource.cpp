@@ -47,11 +47,19 @@ namespace {
 class FFmpegSourceAudioProvider final : public agi::AudioProvider, FFmpegSourceProvider {
 	/// audio source object
 	agi::scoped_holder<FFMS_AudioSource*, void (FFMS_CC *)(FFMS_AudioSource*)> AudioSource;
+	/// Index of the file, kept around for opening more sources for the track
+	std::shared_ptr<FFMS_Index> Index;
+	agi::fs::path Filename;
+	/// Index of the audio track being decoded
+	int TrackNumber = -1;
 
 	mutable char FFMSErrMsg[1024];			///< FFMS error message
 	mutable FFMS_ErrorInfo ErrInfo;			///< FFMS error codes/messages
 
+	FFmpegSourceAudioProvider(FFmpegSourceAudioProvider const& other);
+	void InitErrorInfo();
 	void LoadAudio(agi::fs::path const& filename);
+	void OpenAudioSource();
 	void FillBuffer(void *Buf, int64_t Start, int64_t Count) const override {
 		if (FFMS_GetAudio(AudioSource, Buf, Start, Count, &ErrInfo))
 			throw agi::AudioDecodeError(std::string("Failed to get audio samples: ") + ErrInfo.Buffer);
@@ -61,6 +69,8 @@ public:
 	FFmpegSourceAudioProvider(agi::fs::path const& filename, agi::BackgroundRunner *br);
 
 	bool NeedsCache() const override { return true; }
+	int GetTrackNumber() const override { return TrackNumber; }
+	std::unique_ptr<agi::AudioProvider> Clone() const override;
 };
 
 /// @brief Constructor
@@ -69,10 +79,7 @@ FFmpegSourceAudioProvider::FFmpegSourceAudioProvider(agi::fs::path const& filena
 : FFmpegSourceProvider(br)
 , AudioSource(nullptr, FFMS_DestroyAudioSource)
 {
-	ErrInfo.Buffer		= FFMSErrMsg;
-	ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
-	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
-	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+	InitErrorInfo();
 	SetLogLevel();
 
 	LoadAudio(filename);
@@ -81,6 +88,29 @@ catch (agi::EnvironmentError const& err) {
 	throw agi::AudioProviderError(err.GetMessage());
 }
 
+/// @brief Open another audio source for the same track, reusing the index
+FFmpegSourceAudioProvider::FFmpegSourceAudioProvider(FFmpegSourceAudioProvider const& other)
+: FFmpegSourceProvider(nullptr)
+, AudioSource(nullptr, FFMS_DestroyAudioSource)
+, Index(other.Index)
+, Filename(other.Filename)
+, TrackNumber(other.TrackNumber)
+{
+	InitErrorInfo();
+	OpenAudioSource();
+}
+
+std::unique_ptr<agi::AudioProvider> FFmpegSourceAudioProvider::Clone() const {
+	return std::unique_ptr<agi::AudioProvider>(new FFmpegSourceAudioProvider(*this));
+}
+
+void FFmpegSourceAudioProvider::InitErrorInfo() {
+	ErrInfo.Buffer		= FFMSErrMsg;
+	ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
+	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
+	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+}
+
 void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 	FFMS_Indexer *Indexer = FFMS_CreateIndexer(filename.string().c_str(), &ErrInfo);
 	if (!Indexer) {
@@ -94,7 +124,7 @@ void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 
 	// initialize the track number to an invalid value so we can detect later on
 	// whether the user actually had to choose a track or not
-	int TrackNumber = -1;
+	TrackNumber = -1;
 	if (TrackList.size() > 1) {
 		auto Selection = AskForTrackSelection(TrackList, FFMS_TYPE_AUDIO);
 		if (Selection == TrackSelection::None)
@@ -106,45 +136,14 @@ void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 	else
 		throw agi::AudioDataNotFound("no audio tracks found");
 
-	// generate a name for the cache file
-	agi::fs::path CacheName = GetCacheFilename(filename);
-
-	// try to read index
-	agi::scoped_holder<FFMS_Index*, void (FFMS_CC*)(FFMS_Index*)>
-		Index(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo), FFMS_DestroyIndex);
-
-	if (Index && FFMS_IndexBelongsToFile(Index, filename.string().c_str(), &ErrInfo))
-		Index = nullptr;
-
-	if (Index) {
-		// we already have an index, but the desired track may not have been
-		// indexed, and if it wasn't we need to reindex
-		FFMS_Track *TempTrackData = FFMS_GetTrackFromIndex(Index, TrackNumber);
-		if (FFMS_GetNumFrames(TempTrackData) <= 0)
-			Index = nullptr;
-	}
-
-	// reindex if the error handling mode has changed
-	FFMS_IndexErrorHandling ErrorHandling = GetErrorHandlingMode();
-#if FFMS_VERSION >= ((2 << 24) | (17 << 16) | (2 << 8) | 0)
-	if (Index && FFMS_GetErrorHandling(Index) != ErrorHandling)
-		Index = nullptr;
-#endif
+	Index = GetIndex(Indexer, filename, TrackNumber);
 
-	// moment of truth
-	if (!Index) {
-		TrackSelection TrackMask = static_cast<TrackSelection>(TrackNumber);
-		if (OPT_GET("Provider/FFmpegSource/Index All Tracks")->GetBool())
-			TrackMask = TrackSelection::All;
-		Index = DoIndexing(Indexer, CacheName, TrackMask, ErrorHandling);
-	}
-	else
-		FFMS_CancelIndexing(Indexer);
-
-	// update access time of index file so it won't get cleaned away
-	agi::fs::Touch(CacheName);
+	Filename = filename;
+	OpenAudioSource();
+}
 
-	AudioSource = FFMS_CreateAudioSource(filename.string().c_str(), TrackNumber, Index, FFMS_DELAY_FIRST_VIDEO_TRACK, &ErrInfo);
+void FFmpegSourceAudioProvider::OpenAudioSource() {
+	AudioSource = FFMS_CreateAudioSource(Filename.string().c_str(), TrackNumber, Index.get(), FFMS_DELAY_FIRST_VIDEO_TRACK, &ErrInfo);
 	if (!AudioSource)
 		throw agi::AudioProviderError(std::string("Failed to open audio track: ") + ErrInfo.Buffer);
 
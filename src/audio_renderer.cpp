@@ -35,6 +35,7 @@
 
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include <algorithm>
 #include <wx/dc.h>
@@ -55,8 +56,12 @@ AudioRendererBitmapCacheBitmapFactory::AudioRendererBitmapCacheBitmapFactory(Aud
 	assert(renderer);
 }
 
-std::unique_ptr<wxBitmap> AudioRendererBitmapCacheBitmapFactory::ProduceBlock(int /* i */)
+std::unique_ptr<wxBitmap> AudioRendererBitmapCacheBitmapFactory::ProduceBlock(int /* i */, std::unique_ptr<wxBitmap> spare)
 {
+	// Everything is drawn over when rendering, so an old bitmap of the right
+	// size is as good as a new one
+	if (spare && spare->GetWidth() == renderer->cache_bitmap_width && spare->GetHeight() == renderer->pixel_height)
+		return spare;
 	return agi::make_unique<wxBitmap>(renderer->cache_bitmap_width, renderer->pixel_height, 24);
 }
 
@@ -70,6 +75,8 @@ AudioRenderer::AudioRenderer()
 	bitmaps.reserve(AudioStyle_MAX);
 	for (int i = 0; i < AudioStyle_MAX; ++i)
 		bitmaps.emplace_back(256, AudioRendererBitmapCacheBitmapFactory(this));
+	for (auto& bmp : bitmaps)
+		budget_registrations.push_back(agi::CacheBudget::Global().Register("Audio bitmaps", &bmp));
 
 	// Make sure there's *some* values for those fields, and in the caches
 	SetMillisecondsPerPixel(1);
@@ -158,6 +165,14 @@ size_t AudioRenderer::NumBlocks(const int64_t samples) const
 	return static_cast<size_t>(duration / pixel_ms / cache_bitmap_width);
 }
 
+bool AudioRenderer::CanRender(const int i) const
+{
+	const double samples_per_bitmap = cache_bitmap_width * pixel_ms * provider->GetSampleRate() / 1000.0;
+	const auto block_start = static_cast<int64_t>(i * samples_per_bitmap);
+	const auto block_end = static_cast<int64_t>((i + 1) * samples_per_bitmap);
+	return provider->IsDecoded(block_start, block_end - block_start) || renderer->CanRenderUndecoded(i * cache_bitmap_width, cache_bitmap_width);
+}
+
 wxBitmap const& AudioRenderer::GetCachedBitmap(const int i, const AudioRenderingStyle style)
 {
 	assert(provider);
@@ -183,6 +198,8 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 	if (!renderer) return;
 	if (length <= 0) return;
 
+	AGI_TRACE_SCOPE("audio/render");
+
 	// One past last absolute pixel strip to render
 	const int end = start + length;
 	// One past last X coordinate to render on
@@ -192,19 +209,48 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 	// And the offset in it to start its use at
 	const int firstbitmapoffset = start % cache_bitmap_width;
 	// The last bitmap required
-	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetDecodedSamples()) - 1);
+	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetNumSamples()) - 1);
 
 	// Set a clipping region so that the first and last bitmaps don't draw
 	// outside the requested range
 	const wxDCClipper clipper(dc, wxRect(origin, wxSize(length, pixel_height)));
 	origin.x -= firstbitmapoffset;
 
+	const double samples_per_bitmap = cache_bitmap_width * pixel_ms * provider->GetSampleRate() / 1000.0;
+
+	bool requested_decode = false;
 	for (int i = firstbitmap; i <= lastbitmap; ++i)
 	{
-		dc.DrawBitmap(GetCachedBitmap(i, style), origin);
+		// Bitmaps must only be cached once all of the audio in them has been
+		// decoded and the renderer has the data for them, so draw blank space
+		// for anything which is still missing and have the provider decode
+		// the first such block next
+		const bool available = CanRender(i);
+		if (available && (bitmaps[style].Contains(i) || renderer->PrepareRender(i * cache_bitmap_width, cache_bitmap_width)))
+			dc.DrawBitmap(GetCachedBitmap(i, style), origin);
+		else
+		{
+			if (!available && !requested_decode)
+			{
+				provider->Prefetch(static_cast<int64_t>(i * samples_per_bitmap));
+				requested_decode = true;
+			}
+			renderer->RenderBlank(dc, wxRect(origin.x, origin.y, cache_bitmap_width, pixel_height), style);
+		}
 		origin.x += cache_bitmap_width;
 	}
 
+	// Get the renderer started on the bitmaps a screen's width to either side
+	// so that they're likely to be ready by the time they're scrolled to
+	const int margin = lastbitmap - firstbitmap + 1;
+	const int total_bitmaps = static_cast<int>(NumBlocks(provider->GetNumSamples()));
+	for (int i = std::max(0, firstbitmap - margin); i < std::min(total_bitmaps, lastbitmap + 1 + margin); ++i)
+	{
+		if (i >= firstbitmap && i <= lastbitmap) continue;
+		if (!bitmaps[style].Contains(i) && CanRender(i))
+			renderer->PrepareRender(i * cache_bitmap_width, cache_bitmap_width);
+	}
+
 	// Now render blank audio from origin to end
 	if (origin.x < lastx)
 		renderer->RenderBlank(dc, wxRect(origin.x-1, origin.y, lastx-origin.x+1, pixel_height), style);
@@ -213,10 +259,41 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 	{
 		bitmaps[style].Age(cache_bitmap_maxsize);
 		renderer->AgeCache(cache_renderer_maxsize);
+		agi::CacheBudget::Global().Trim();
 		needs_age = false;
 	}
 }
 
+int AudioRenderer::GetPrefetchLength(const int visible_length) const
+{
+	// Leave room in the cache for everything that's visible, as prefetching
+	// must not push those bitmaps out
+	const size_t bitmap_size = sizeof(wxBitmap) + cache_bitmap_width * pixel_height * 3;
+	const int cache_length = static_cast<int>(cache_bitmap_maxsize / bitmap_size) * cache_bitmap_width;
+	return std::max(0, std::min(visible_length, cache_length - visible_length - 2 * cache_bitmap_width));
+}
+
+int AudioRenderer::Prefetch(const int start, const int length, const AudioRenderingStyle style, const bool backwards, const int max_bitmaps)
+{
+	if (!provider || !renderer || length <= 0) return 0;
+
+	const int first = std::max(0, start / cache_bitmap_width);
+	const int last = std::min<int>((start + length - 1) / cache_bitmap_width, NumBlocks(provider->GetNumSamples()) - 1);
+
+	int rendered = 0;
+	for (int n = 0; n <= last - first && rendered < max_bitmaps; ++n)
+	{
+		const int i = backwards ? last - n : first + n;
+		if (bitmaps[style].Contains(i) || !CanRender(i)) continue;
+		// Anything the renderer is still computing will be picked up when
+		// it announces that it's done and the display repaints
+		if (!renderer->PrepareRender(i * cache_bitmap_width, cache_bitmap_width)) continue;
+		GetCachedBitmap(i, style);
+		++rendered;
+	}
+	return rendered;
+}
+
 void AudioRenderer::Invalidate()
 {
 	for (auto& bmp : bitmaps) bmp.Age(0);
@@ -34,8 +34,11 @@
 
 #include <wx/gdicmn.h>
 
+#include <libaegisub/block_cache.h>
+#include <libaegisub/fs_fwd.h>
+#include <libaegisub/signal.h>
+
 #include "audio_rendering_style.h"
-#include "block_cache.h"
 
 class AudioRenderer;
 class AudioRendererBitmapProvider;
@@ -55,11 +58,12 @@ struct AudioRendererBitmapCacheBitmapFactory {
 	AudioRendererBitmapCacheBitmapFactory(AudioRenderer *renderer);
 
 	/// @brief Create a new bitmap
-	/// @param i Unused
-	/// @return A fresh wxBitmap
+	/// @param i     Unused
+	/// @param spare Bitmap aged out of the cache to reuse, if any
+	/// @return A wxBitmap to render to
 	///
 	/// Produces a wxBitmap with dimensions pulled from our master AudioRenderer.
-	std::unique_ptr<wxBitmap> ProduceBlock(int i);
+	std::unique_ptr<wxBitmap> ProduceBlock(int i, std::unique_ptr<wxBitmap> spare);
 
 	/// @brief Calculate the size of bitmaps
 	/// @return The size of bitmaps created
@@ -67,7 +71,7 @@ struct AudioRendererBitmapCacheBitmapFactory {
 };
 
 /// The type of a bitmap cache
-typedef DataBlockCache<wxBitmap, 8, AudioRendererBitmapCacheBitmapFactory> AudioRendererBitmapCache;
+typedef agi::DataBlockCache<wxBitmap, 8, AudioRendererBitmapCacheBitmapFactory> AudioRendererBitmapCache;
 
 
 /// @class AudioRenderer
@@ -97,6 +101,8 @@ class AudioRenderer {
 	size_t cache_renderer_maxsize = 0;
 	/// Do the caches need to be aged?
 	bool needs_age = false;
+	/// Registrations of the bitmap caches with the global cache budget
+	std::vector<agi::CacheBudget::Registration> budget_registrations;
 
 	/// Actual renderer for bitmaps
 	AudioRendererBitmapProvider *renderer = nullptr;
@@ -113,6 +119,12 @@ class AudioRenderer {
 	/// if the cache doesn't have it.
 	wxBitmap const& GetCachedBitmap(int i, AudioRenderingStyle style);
 
+	/// @brief Can bitmap index i be rendered yet?
+	///
+	/// Bitmaps must only be cached once all of the audio in them has been
+	/// decoded or the renderer can draw them without it.
+	bool CanRender(int i) const;
+
 	/// @brief Update the block count in the bitmap caches
 	///
 	/// Should be called when the width of the virtual bitmap has changed, i.e.
@@ -204,6 +216,25 @@ public:
 	/// of audio samples rendered is length*pixel_samples.
 	void Render(wxDC &dc, wxPoint origin, int start, int length, AudioRenderingStyle style);
 
+	/// @brief Get how far beyond the visible audio should be prefetched
+	/// @param visible_length Number of pixels of audio visible
+	/// @return Number of pixels to prefetch, which fits in the cache alongside
+	///         the visible audio
+	int GetPrefetchLength(int visible_length) const;
+
+	/// @brief Render bitmaps which aren't visible yet so that they're cached
+	/// @param start       First pixel from beginning of the audio stream to render
+	/// @param length      Number of pixels of audio to render
+	/// @param style       Style to render audio in
+	/// @param backwards   Render the end of the range first rather than the start
+	/// @param max_bitmaps Maximum number of bitmaps to render
+	/// @return Number of bitmaps rendered
+	///
+	/// Bitmaps which are already cached or which can't be rendered yet are
+	/// skipped. If fewer than max_bitmaps were rendered there's nothing left
+	/// in the range which can be rendered right now.
+	int Prefetch(int start, int length, AudioRenderingStyle style, bool backwards, int max_bitmaps);
+
 	/// @brief Invalidate all cached data
 	///
 	/// Invalidates all cached bitmaps for another reason, usually as a signal that
@@ -244,7 +275,12 @@ protected:
 	/// Implementations can override this method to do something when the vertical zoom is changed
 	virtual void OnSetAmplitudeScale() { }
 
+	/// Data requested by PrepareRender has finished being computed
+	agi::signal::Signal<> AnnounceDataReady;
+
 public:
+	DEFINE_SIGNAL_ADDERS(AnnounceDataReady, AddDataReadyListener)
+
 	/// @brief Constructor
 	AudioRendererBitmapProvider() : provider(nullptr), pixel_ms(0), amplitude_scale(0) { };
 
@@ -269,6 +305,24 @@ public:
 	/// of the entire canvas the audio is being rendered in.
 	virtual void RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style) = 0;
 
+	/// @brief Can a range be rendered before the audio in it has been decoded?
+	/// @param start First pixel from beginning of the audio stream
+	/// @param width Number of pixels
+	///
+	/// Deriving classes which can render from precomputed data should
+	/// override this to report when that data covers the range.
+	virtual bool CanRenderUndecoded(int start, int width) const { return false; }
+
+	/// @brief Get ready to render a range
+	/// @param start First pixel from beginning of the audio stream
+	/// @param width Number of pixels
+	/// @return Can the range be rendered right away?
+	///
+	/// Deriving classes which compute their data in the background should
+	/// override this to start computing anything missing for the range,
+	/// return false until it's done, and then announce that it's ready.
+	virtual bool PrepareRender(int start, int width) { return true; }
+
 	/// @brief Change audio provider
 	/// @param provider Audio provider to change to
 	void SetProvider(agi::AudioProvider *provider);
@@ -287,4 +341,15 @@ public:
 	/// Deriving classes should override this method if they implement any
 	/// kind of caching.
 	virtual void AgeCache(size_t max_size) { }
+
+	/// @brief Load cached data for the current audio saved by SaveCache
+	/// @param filename File to load from
+	///
+	/// Deriving classes should override this method if their cached data is
+	/// expensive enough to compute that it's worth keeping between sessions.
+	virtual void LoadCache(agi::fs::path const& filename) { }
+
+	/// @brief Save the cached data for the current audio
+	/// @param filename File to save to
+	virtual void SaveCache(agi::fs::path const& filename) const { }
 };
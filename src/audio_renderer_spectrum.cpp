@@ -35,18 +35,184 @@
 #include "audio_renderer_spectrum.h"
 
 #include "audio_colorscheme.h"
-#ifndef WITH_FFTW3
-#include "fft.h"
-#endif
+#include "audio_renderer_spectrum_gl.h"
+#include "options.h"
+#include "utils.h"
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/disk_cache.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/fft.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
+#include <boost/filesystem/path.hpp>
+#include <cmath>
+#include <cstring>
+#include <thread>
 
 #include <wx/image.h>
 #include <wx/dcmemory.h>
 
+#ifdef WITH_FFTW3
+#include <fftw3.h>
+#endif
+
+namespace {
+/// Identifies saved spectrum caches, and changes whenever the format does
+const char cache_magic[] = "AGISPEC2";
+const size_t cache_magic_size = sizeof(cache_magic) - 1;
+
+/// Saved caches from the two FFT implementations aren't interchangeable
+#ifdef WITH_FFTW3
+const uint32_t fft_implementation = 1;
+#else
+const uint32_t fft_implementation = 0;
+#endif
+
+/// Header of a saved spectrum cache, followed by num_blocks block indexes
+/// each followed by block_bins values
+struct SavedCacheHeader {
+	char magic[8];
+	int64_t num_samples;
+	uint32_t derivation_size;
+	uint32_t derivation_dist;
+	uint32_t fft_implementation;
+	uint32_t num_blocks;
+	uint32_t block_bins;
+	uint32_t padding;
+};
+
+/// Scale of the fixed point values in saved caches. The derived values are
+/// log10 of the magnitude, so are well under 16.
+const float fixed_scale = 4096.f;
+
+/// Number of blocks given to a worker at a time by PrepareRender
+const size_t blocks_per_batch = 16;
+
+/// Lowest frequency the log scale can show, as it can't go down to 0
+const int min_log_freq = 20;
+
+double HzToMel(double hz) {
+	return 2595 * log10(1 + hz / 700);
+}
+
+double MelToHz(double mel) {
+	return 700 * (pow(10, mel / 2595) - 1);
+}
+
+/// @brief Convert audio data to float range [-1;+1)
+/// @param count Samples to convert
+/// @param src Audio data to read
+/// @param dest Buffer to fill
+template<class T>
+void ConvertToFloat(size_t count, const int16_t *src, T *dest) {
+	for (size_t si = 0; si < count; ++si)
+	{
+		dest[si] = (T)(src[si]) / 32768.0;
+	}
+}
+}
+
+struct AudioSpectrumRenderer::Derivation {
+	/// Binary logarithm of number of samples to use in deriving frequency-power data
+	size_t derivation_size;
+
+#ifdef WITH_FFTW3
+	/// FFTW plan data
+	fftw_plan dft_plan;
+	/// Pre-allocated input array for FFTW
+	double *dft_input;
+	/// Pre-allocated output array for FFTW
+	fftw_complex *dft_output;
+#else
+	/// Transform of 2^(derivation_size+1) samples
+	agi::RealFFT fft;
+	/// Pre-allocated input and output arrays for the transform
+	std::vector<float> fft_input, fft_real, fft_imag;
+#endif
+
+	/// Pre-allocated scratch area for raw audio data which the provider
+	/// can't give us a view of
+	std::vector<int16_t> audio_scratch;
+
+	/// FFTW's planner isn't thread-safe, so this must only be called on the
+	/// GUI thread even for the workers' derivations
+	Derivation(size_t derivation_size)
+	: derivation_size(derivation_size)
+#ifndef WITH_FFTW3
+	, fft(2 << derivation_size)
+	, fft_input(2 << derivation_size)
+	, fft_real(1 << derivation_size)
+	, fft_imag(1 << derivation_size)
+#endif
+	, audio_scratch(2 << derivation_size)
+	{
+#ifdef WITH_FFTW3
+		dft_input = fftw_alloc_real(2<<derivation_size);
+		dft_output = fftw_alloc_complex(2<<derivation_size);
+		dft_plan = fftw_plan_dft_r2c_1d(
+			2<<derivation_size,
+			dft_input,
+			dft_output,
+			FFTW_MEASURE);
+#endif
+	}
+
+	~Derivation()
+	{
+#ifdef WITH_FFTW3
+		fftw_destroy_plan(dft_plan);
+		fftw_free(dft_input);
+		fftw_free(dft_output);
+#endif
+	}
+
+	Derivation(Derivation const&) = delete;
+	Derivation& operator=(Derivation const&) = delete;
+
+	/// @brief Derive the frequency-power data for a block
+	/// @param provider     Audio provider to read from
+	/// @param first_sample First sample of the derivation window
+	/// @param bins         Number of bins to compute, from the lowest
+	/// @param[out] block   Address to write bins values to
+	void Derive(agi::AudioProvider *provider, int64_t first_sample, size_t bins, float *block)
+	{
+		auto audio = static_cast<const int16_t *>(provider->GetAudioView(&audio_scratch[0], first_sample, 2 << derivation_size));
+
+		// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
+		// although the FFT output can apparently get greater magnitudes than 1
+		// despite the input being limited to [-1;+1).
+		float scale_factor = 9 / sqrt(2 * (float)(2<<derivation_size));
+
+#ifdef WITH_FFTW3
+		ConvertToFloat(2 << derivation_size, audio, dft_input);
+
+		fftw_execute(dft_plan);
+
+		agi::SpectrumPower(bins, &dft_output[0][0], scale_factor, block);
+#else
+		ConvertToFloat(2 << derivation_size, audio, &fft_input[0]);
+
+		fft.Transform(&fft_input[0], &fft_real[0], &fft_imag[0]);
+
+		agi::SpectrumPower(bins, &fft_real[0], &fft_imag[0], scale_factor, block);
+#endif
+	}
+};
+
+struct AudioSpectrumRenderer::Worker {
+	Derivation derivation;
+	/// Declared after the derivation so that it's stopped before the
+	/// derivation is destroyed
+	std::unique_ptr<agi::dispatch::Queue> queue = agi::dispatch::Create();
+
+	Worker(size_t derivation_size) : derivation(derivation_size) { }
+};
+
 /// Allocates blocks of derived data for the audio spectrum
 struct AudioSpectrumCacheBlockFactory {
 	typedef std::unique_ptr<float, std::default_delete<float[]>> BlockType;
@@ -54,29 +220,31 @@ struct AudioSpectrumCacheBlockFactory {
 	/// Pointer back to the owning spectrum renderer
 	AudioSpectrumRenderer *spectrum;
 
-	/// @brief Allocate and fill a data block
-	/// @param i Index of the block to produce data for
-	/// @return Newly allocated and filled block
+	/// @brief Fill a data block
+	/// @param i     Index of the block to produce data for
+	/// @param spare Block aged out of the cache to reuse, if any
+	/// @return Filled block
 	///
 	/// The filling is delegated to the spectrum renderer
-	BlockType ProduceBlock(size_t i)
+	BlockType ProduceBlock(size_t i, BlockType spare)
 	{
-		auto res = new float[((size_t)1)<<spectrum->derivation_size];
-		spectrum->FillBlock(i, res);
-		return BlockType(res);
+		if (!spare)
+			spare.reset(new float[spectrum->block_bins]);
+		spectrum->FillBlock(i, spare.get());
+		return spare;
 	}
 
 	/// @brief Calculate the in-memory size of a spec
 	/// @return The size in bytes of a spectrum cache block
 	size_t GetBlockSize() const
 	{
-		return sizeof(float) << spectrum->derivation_size;
+		return sizeof(float) * spectrum->block_bins;
 	}
 };
 
 /// @brief Cache for audio spectrum frequency-power data
 class AudioSpectrumCache
-: public DataBlockCache<float, 10, AudioSpectrumCacheBlockFactory> {
+: public agi::DataBlockCache<float, 10, AudioSpectrumCacheBlockFactory> {
 public:
 	AudioSpectrumCache(size_t block_count, AudioSpectrumRenderer *renderer)
 	: DataBlockCache(block_count, AudioSpectrumCacheBlockFactory{renderer})
@@ -84,6 +252,43 @@ public:
 	}
 };
 
+SpectrumBandRange::SpectrumBandRange(SpectrumScale scale, int min_freq, int max_freq, int sample_rate, size_t bins)
+: scale(scale)
+, bins_per_hz(2.0 * bins / sample_rate)
+{
+	const int nyquist = sample_rate / 2;
+	if (max_freq <= 0 || max_freq > nyquist)
+		max_freq = nyquist;
+	min_freq = mid(0, min_freq, max_freq - 1);
+
+	switch (scale)
+	{
+		case SpectrumScale::Log:
+			low = log(std::max(min_freq, min_log_freq));
+			high = log(std::max(max_freq, min_log_freq + 1));
+			break;
+		case SpectrumScale::Mel:
+			low = HzToMel(min_freq);
+			high = HzToMel(max_freq);
+			break;
+		default:
+			low = min_freq;
+			high = max_freq;
+			break;
+	}
+}
+
+double SpectrumBandRange::BinAt(double pos) const
+{
+	const double value = low + (high - low) * pos;
+	switch (scale)
+	{
+		case SpectrumScale::Log: return exp(value) * bins_per_hz;
+		case SpectrumScale::Mel: return MelToHz(value) * bins_per_hz;
+		default:                 return value * bins_per_hz;
+	}
+}
+
 AudioSpectrumRenderer::AudioSpectrumRenderer(std::string const& color_scheme_name)
 {
 	colors.reserve(AudioStyle_MAX);
@@ -100,54 +305,80 @@ AudioSpectrumRenderer::~AudioSpectrumRenderer()
 
 void AudioSpectrumRenderer::RecreateCache()
 {
-#ifdef WITH_FFTW3
-	if (dft_plan)
-	{
-		fftw_destroy_plan(dft_plan);
-		fftw_free(dft_input);
-		fftw_free(dft_output);
-		dft_plan = nullptr;
-		dft_input = nullptr;
-		dft_output = nullptr;
-	}
-#endif
+	CancelPendingBlocks();
+	workers.clear();
+	derivation.reset();
+	cache_registration.Unregister();
+	cache.reset();
+	if (gl)
+		gl->Invalidate();
+
+	saved_blocks.clear();
+	band_rows.clear();
+	num_samples = provider ? provider->GetNumSamples() : 0;
 
 	if (provider)
 	{
-		size_t block_count = (size_t)((provider->GetNumSamples() + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
-		cache = agi::make_unique<AudioSpectrumCache>(block_count, this);
-
-#ifdef WITH_FFTW3
-		dft_input = fftw_alloc_real(2<<derivation_size);
-		dft_output = fftw_alloc_complex(2<<derivation_size);
-		dft_plan = fftw_plan_dft_r2c_1d(
-			2<<derivation_size,
-			dft_input,
-			dft_output,
-			FFTW_MEASURE);
-#else
-		// Allocate scratch for 6x the derivation size:
-		// 2x for the input sample data
-		// 2x for the real part of the output
-		// 2x for the imaginary part of the output
-		fft_scratch.resize(6 << derivation_size);
-#endif
-		audio_scratch.resize(2 << derivation_size);
+		const size_t total_bins = (size_t)1 << derivation_size;
+		band_range = SpectrumBandRange(freq_scale, min_freq, max_freq, provider->GetSampleRate(), total_bins);
+		// The top row can interpolate up to the bin above the top of the range
+		block_bins = std::min(total_bins, (size_t)ceil(band_range.BinAt(1)) + 1);
+
+		cache = agi::make_unique<AudioSpectrumCache>(BlockCount(), this);
+		cache_registration = agi::CacheBudget::Global().Register("Audio spectrum", cache.get());
+		derivation = agi::make_unique<Derivation>(derivation_size);
+
+		// Leave a core free for decoding and the GUI
+		unsigned worker_count = std::max(2u, std::min(5u, std::thread::hardware_concurrency())) - 1;
+		for (unsigned i = 0; i < worker_count; ++i)
+			workers.push_back(agi::make_unique<Worker>(derivation_size));
+		next_worker = 0;
 	}
 }
 
+void AudioSpectrumRenderer::CancelPendingBlocks()
+{
+	++generation;
+	for (auto& worker : workers)
+		worker->queue->Sync([]{ }, agi::dispatch::Priority::Background);
+
+	std::lock_guard<std::mutex> lock(pending_mutex);
+	ready_blocks.clear();
+	queued_blocks.clear();
+}
+
+size_t AudioSpectrumRenderer::BlockCount() const
+{
+	return (size_t)((num_samples + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
+}
+
 void AudioSpectrumRenderer::OnSetProvider()
 {
 	RecreateCache();
 }
 
+void AudioSpectrumRenderer::OnSetMillisecondsPerPixel()
+{
+	if (gl)
+		gl->Invalidate();
+}
+
+void AudioSpectrumRenderer::EnableOpenGL(wxWindow *parent)
+{
+	gl = agi::make_unique<AudioSpectrumGL>(parent, colors);
+}
+
 void AudioSpectrumRenderer::SetResolution(size_t _derivation_size, size_t _derivation_dist)
 {
 	if (derivation_dist != _derivation_dist)
 	{
+		CancelPendingBlocks();
 		derivation_dist = _derivation_dist;
+		saved_blocks.clear();
 		if (cache)
 			cache->Age(0);
+		if (gl)
+			gl->Invalidate();
 	}
 
 	if (derivation_size != _derivation_size)
@@ -157,12 +388,16 @@ void AudioSpectrumRenderer::SetResolution(size_t _derivation_size, size_t _deriv
 	}
 }
 
-template<class T>
-void AudioSpectrumRenderer::ConvertToFloat(size_t count, T *dest) {
-	for (size_t si = 0; si < count; ++si)
-	{
-		dest[si] = (T)(audio_scratch[si]) / 32768.0;
-	}
+void AudioSpectrumRenderer::SetFrequencyRange(SpectrumScale scale, int low, int high)
+{
+	if (scale == freq_scale && low == min_freq && high == max_freq)
+		return;
+
+	freq_scale = scale;
+	min_freq = low;
+	max_freq = high;
+	if (provider)
+		RecreateCache();
 }
 
 void AudioSpectrumRenderer::FillBlock(size_t block_index, float *block)
@@ -170,43 +405,122 @@ void AudioSpectrumRenderer::FillBlock(size_t block_index, float *block)
 	assert(cache);
 	assert(block);
 
-	int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << derivation_size);
-	provider->GetAudio(&audio_scratch[0], first_sample, 2 << derivation_size);
+	{
+		std::lock_guard<std::mutex> lock(pending_mutex);
+		auto ready = ready_blocks.find(block_index);
+		if (ready != ready_blocks.end())
+		{
+			memcpy(block, ready->second.get(), sizeof(float) * block_bins);
+			ready_blocks.erase(ready);
+			return;
+		}
+	}
 
-#ifdef WITH_FFTW3
-	ConvertToFloat(2 << derivation_size, dft_input);
+	auto saved = saved_blocks.find(block_index);
+	if (saved != saved_blocks.end())
+	{
+		for (auto value : saved->second)
+			*block++ = value / fixed_scale;
+		return;
+	}
 
-	fftw_execute(dft_plan);
+	int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << derivation_size);
+	derivation->Derive(provider, first_sample, block_bins, block);
+}
 
-	double scale_factor = 9 / sqrt(2 << (derivation_size + 1));
+void AudioSpectrumRenderer::ComputeBlocks(Worker &worker, agi::AudioProvider *audio, std::vector<size_t> const& blocks, uint32_t for_generation)
+{
+	const size_t size = worker.derivation.derivation_size;
+	for (size_t block_index : blocks)
+	{
+		// If the settings or provider have changed the renderer is waiting
+		// for us to stop, so don't bother with the rest
+		if (generation != for_generation) return;
+
+		std::unique_ptr<float[]> block(new float[block_bins]);
+		int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << size);
+		worker.derivation.Derive(audio, first_sample, block_bins, block.get());
+
+		std::lock_guard<std::mutex> lock(pending_mutex);
+		if (generation != for_generation) return;
+		queued_blocks.erase(block_index);
+		ready_blocks[block_index] = std::move(block);
+	}
+
+	std::weak_ptr<bool> weak_alive = alive;
+	agi::dispatch::Main().Async([=]
+	{
+		if (weak_alive.lock() && generation == for_generation)
+		{
+			StoreReadyBlocks();
+			AnnounceDataReady();
+		}
+	});
+}
 
-	fftw_complex *o = dft_output;
-	for (size_t si = (size_t)1<<derivation_size; si > 0; --si)
+void AudioSpectrumRenderer::StoreReadyBlocks()
+{
+	std::vector<size_t> ready;
 	{
-		*block++ = log10( sqrt(o[0][0] * o[0][0] + o[0][1] * o[0][1]) * scale_factor + 1 );
-		o++;
+		std::lock_guard<std::mutex> lock(pending_mutex);
+		ready.reserve(ready_blocks.size());
+		for (auto const& block : ready_blocks)
+			ready.push_back(block.first);
 	}
-#else
-	ConvertToFloat(2 << derivation_size, &fft_scratch[0]);
 
-	float *fft_input = &fft_scratch[0];
-	float *fft_real = &fft_scratch[0] + (2 << derivation_size);
-	float *fft_imag = &fft_scratch[0] + (4 << derivation_size);
+	// Getting a block which isn't cached yet takes it from ready_blocks in
+	// FillBlock
+	for (size_t block_index : ready)
+		cache->Get(block_index);
 
-	FFT fft;
-	fft.Transform(2<<derivation_size, fft_input, fft_real, fft_imag);
+	// Anything left was already in the cache
+	std::lock_guard<std::mutex> lock(pending_mutex);
+	for (size_t block_index : ready)
+		ready_blocks.erase(block_index);
+}
 
-	float scale_factor = 9 / sqrt(2 * (float)(2<<derivation_size));
+size_t AudioSpectrumRenderer::BlockIndex(int ax) const
+{
+	return (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
+}
+
+bool AudioSpectrumRenderer::PrepareRender(int start, int width)
+{
+	if (!cache || workers.empty())
+		return true;
 
-	for (size_t si = 1<<derivation_size; si > 0; --si)
+	const size_t block_count = BlockCount();
+	std::vector<size_t> missing;
+	bool available = true;
 	{
-		// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
-		// although the FFT output can apparently get greater magnitudes than 1
-		// despite the input being limited to [-1;+1).
-		*block++ = log10( sqrt(*fft_real * *fft_real + *fft_imag * *fft_imag) * scale_factor + 1 );
-		fft_real++; fft_imag++;
+		std::lock_guard<std::mutex> lock(pending_mutex);
+		for (int ax = start; ax < start + width; ++ax)
+		{
+			size_t block_index = BlockIndex(ax);
+			if (block_index >= block_count)
+				break;
+			if (cache->Contains(block_index) || saved_blocks.count(block_index) || ready_blocks.count(block_index))
+				continue;
+			available = false;
+			if (queued_blocks.insert(block_index).second)
+				missing.push_back(block_index);
+		}
 	}
-#endif
+
+	const uint32_t for_generation = generation;
+	for (size_t i = 0; i < missing.size(); i += blocks_per_batch)
+	{
+		std::vector<size_t> batch(missing.begin() + i, missing.begin() + std::min(missing.size(), i + blocks_per_batch));
+		Worker *worker = workers[next_worker].get();
+		next_worker = (next_worker + 1) % workers.size();
+		agi::AudioProvider *audio = provider;
+		worker->queue->Async([=]
+		{
+			ComputeBlocks(*worker, audio, batch, for_generation);
+		}, agi::dispatch::Priority::Prefetch);
+	}
+
+	return available;
 }
 
 void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
@@ -223,6 +537,10 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	assert(end >= 0);
 	assert(end >= start);
 
+	if (gl && gl->Render(bmp, start, block_bins, band_range, amplitude_scale, style,
+		[&](int x) { return &cache->Get(BlockIndex(start + x)); }))
+		return;
+
 	// Prepare an image buffer to write
 	wxImage img(bmp.GetSize());
 	unsigned char *imgdata = img.GetData();
@@ -230,57 +548,79 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	int imgheight = img.GetHeight();
 
 	const AudioColorScheme *pal = &colors[style];
-
-	/// @todo Make minband and maxband configurable
-	int minband = 0;
-	int maxband = 1 << derivation_size;
+	UpdateBandRows(imgheight);
 
 	// ax = absolute x, absolute to the virtual spectrum bitmap
 	for (int ax = start; ax < end; ++ax)
 	{
 		// Derived audio data
-		size_t block_index = (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
+		size_t block_index = BlockIndex(ax);
 		float *power = &cache->Get(block_index);
 
 		// Prepare bitmap writing
 		unsigned char *px = imgdata + (imgheight-1) * stride + (ax - start) * 3;
 
-		// Scale up or down vertically?
-		if (imgheight > 1<<derivation_size)
+		for (auto const& row : band_rows)
 		{
-			// Interpolate
-			for (int y = 0; y < imgheight; ++y)
-			{
-				assert(px >= imgdata);
-				assert(px < imgdata + imgheight*stride);
-				auto ideal = (double)(y+1.)/imgheight * (maxband-minband) + minband;
-				float sample1 = power[(int)floor(ideal)+minband];
-				float sample2 = power[(int)ceil(ideal)+minband];
-				float frac = ideal - floor(ideal);
-				float val = (1-frac)*sample1 + frac*sample2;
-				pal->map(val*amplitude_scale, px);
-				px -= stride;
-			}
+			assert(px >= imgdata);
+			assert(px < imgdata + imgheight*stride);
+			float val;
+			if (row.frac >= 0)
+				val = (1 - row.frac) * power[row.first] + row.frac * power[row.last];
+			else
+				val = *std::max_element(&power[row.first], &power[row.last + 1]);
+			pal->map(val*amplitude_scale, px);
+			px -= stride;
+		}
+	}
+
+	wxBitmap tmpbmp(img);
+	wxMemoryDC targetdc(bmp);
+	targetdc.DrawBitmap(tmpbmp, 0, 0);
+}
+
+void AudioSpectrumRenderer::UpdateBandRows(int height)
+{
+	if ((int)band_rows.size() == height)
+		return;
+
+	band_rows.resize(height);
+	const int last_bin = (int)block_bins - 1;
+	for (int y = 0; y < height; ++y)
+	{
+		auto& row = band_rows[y];
+		const double low = band_range.BinAt((double)y / height);
+		const double high = band_range.BinAt((y + 1.) / height);
+		if (high - low < 1)
+		{
+			// Row is narrower than a bin, so interpolate at its top edge
+			const double ideal = std::min<double>(high, last_bin);
+			row.first = (int)floor(ideal);
+			row.last = (int)ceil(ideal);
+			row.frac = (float)(ideal - row.first);
 		}
 		else
 		{
 			// Pick greatest
-			for (int y = 0; y < imgheight; ++y)
-			{
-				assert(px >= imgdata);
-				assert(px < imgdata + imgheight*stride);
-				int sample1 = std::max(0, maxband * y/imgheight + minband);
-				int sample2 = std::min((1<<derivation_size)-1, maxband * (y+1)/imgheight + minband);
-				float maxval = *std::max_element(&power[sample1], &power[sample2 + 1]);
-				pal->map(maxval*amplitude_scale, px);
-				px -= stride;
-			}
+			row.first = mid(0, (int)low, last_bin);
+			row.last = mid(row.first, (int)high, last_bin);
+			row.frac = -1;
 		}
 	}
+}
 
-	wxBitmap tmpbmp(img);
-	wxMemoryDC targetdc(bmp);
-	targetdc.DrawBitmap(tmpbmp, 0, 0);
+bool AudioSpectrumRenderer::CanRenderUndecoded(int start, int width) const
+{
+	if (!cache || saved_blocks.empty())
+		return false;
+
+	for (int ax = start; ax < start + width; ++ax)
+	{
+		size_t block_index = BlockIndex(ax);
+		if (!saved_blocks.count(block_index))
+			return false;
+	}
+	return true;
 }
 
 void AudioSpectrumRenderer::RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style)
@@ -296,4 +636,103 @@ void AudioSpectrumRenderer::AgeCache(size_t max_size)
 {
 	if (cache)
 		cache->Age(max_size);
+	if (gl)
+		gl->AgeCache(max_size);
+}
+
+void AudioSpectrumRenderer::LoadCache(agi::fs::path const& filename)
+{
+	if (!cache || !agi::fs::FileExists(filename)) return;
+
+	try
+	{
+		auto in = agi::io::Open(filename, true);
+		SavedCacheHeader header;
+		in->read(reinterpret_cast<char *>(&header), sizeof(header));
+		if (!*in || memcmp(header.magic, cache_magic, cache_magic_size)
+			|| header.num_samples != num_samples
+			|| header.derivation_size != derivation_size
+			|| header.derivation_dist != derivation_dist
+			|| header.fft_implementation != fft_implementation
+			|| header.block_bins != block_bins)
+			return;
+
+		const size_t block_count = BlockCount();
+		std::vector<uint16_t> values(block_bins);
+		for (uint32_t i = 0; i < header.num_blocks; ++i)
+		{
+			uint64_t index = 0;
+			in->read(reinterpret_cast<char *>(&index), sizeof(index));
+			in->read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(uint16_t));
+			if (!*in || index >= block_count) break;
+			saved_blocks[(size_t)index] = values;
+		}
+		LOG_D("audio/renderer/spectrum") << "Loaded " << saved_blocks.size() << " blocks from " << filename;
+	}
+	catch (agi::Exception const& e)
+	{
+		LOG_E("audio/renderer/spectrum") << "Failed to load spectrum cache: " << e.GetMessage();
+	}
+}
+
+void AudioSpectrumRenderer::SaveCache(agi::fs::path const& filename) const
+{
+	if (!cache) return;
+
+	const size_t block_values = block_bins;
+	const size_t max_blocks = OPT_GET("Audio/Renderer/Spectrum/Memory Max")->GetInt() * 1024 * 1024 / (block_values * sizeof(uint16_t));
+
+	// Quantize the blocks in the cache, then fill any remaining space with
+	// the ones loaded from the previous save
+	std::vector<std::pair<uint64_t, std::vector<uint16_t>>> blocks;
+	cache->ForEachBlock([&](size_t index, float const& block)
+	{
+		if (blocks.size() >= max_blocks) return;
+		const float *values = &block;
+		std::vector<uint16_t> fixed(block_values);
+		for (size_t i = 0; i < block_values; ++i)
+			fixed[i] = (uint16_t)std::min(values[i] * fixed_scale + 0.5f, 65535.f);
+		blocks.emplace_back(index, std::move(fixed));
+	});
+
+	std::unordered_set<size_t> in_cache;
+	for (auto const& block : blocks)
+		in_cache.insert((size_t)block.first);
+	for (auto const& block : saved_blocks)
+	{
+		if (blocks.size() >= max_blocks) break;
+		if (!in_cache.count(block.first))
+			blocks.emplace_back(block.first, block.second);
+	}
+
+	if (blocks.empty()) return;
+
+	try
+	{
+		SavedCacheHeader header;
+		memcpy(header.magic, cache_magic, cache_magic_size);
+		header.num_samples = num_samples;
+		header.derivation_size = (uint32_t)derivation_size;
+		header.derivation_dist = (uint32_t)derivation_dist;
+		header.fft_implementation = fft_implementation;
+		header.num_blocks = (uint32_t)blocks.size();
+		header.block_bins = (uint32_t)block_bins;
+		header.padding = 0;
+
+		agi::io::Save file(filename, true);
+		auto& out = file.Get();
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		for (auto const& block : blocks)
+		{
+			out.write(reinterpret_cast<const char *>(&block.first), sizeof(block.first));
+			out.write(reinterpret_cast<const char *>(block.second.data()), block_values * sizeof(uint16_t));
+		}
+	}
+	catch (agi::Exception const& e)
+	{
+		LOG_E("audio/renderer/spectrum") << "Failed to save spectrum cache: " << e.GetMessage();
+		return;
+	}
+
+	GetMediaCache().Added(filename);
 }
@@ -33,19 +33,66 @@
 ///
 /// Calculate and render a frequency-power spectrum for PCM audio data.
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "audio_renderer.h"
 
-#ifdef WITH_FFTW3
-#include <fftw3.h>
-#endif
-
 class AudioColorScheme;
+class AudioSpectrumGL;
 class AudioSpectrumCache;
 struct AudioSpectrumCacheBlockFactory;
+class wxWindow;
+
+/// Frequency scales the spectrum can be drawn with
+enum class SpectrumScale {
+	Linear,
+	Log,
+	Mel
+};
+
+/// @class SpectrumBandRange
+/// @brief The range of frequencies shown by the spectrum and how they're scaled
+///
+/// Positions from 0 at the bottom of the spectrum to 1 at the top are mapped
+/// linearly to the scale's units between low and high, and then to FFT bins.
+struct SpectrumBandRange {
+	SpectrumScale scale = SpectrumScale::Linear;
+	/// Bottom of the displayed range, in Hz for the linear scale, the natural
+	/// log of Hz for the log scale and mels for the mel scale
+	double low = 0;
+	/// Top of the displayed range, in the same units as low
+	double high = 0;
+	/// Number of FFT bins per Hz
+	double bins_per_hz = 0;
+
+	/// @param scale       Scale to use
+	/// @param min_freq    Lowest frequency to show in Hz
+	/// @param max_freq    Highest frequency to show in Hz, or 0 for everything
+	/// @param sample_rate Sample rate of the audio
+	/// @param bins        Number of bins from 0 Hz to the Nyquist frequency
+	SpectrumBandRange(SpectrumScale scale, int min_freq, int max_freq, int sample_rate, size_t bins);
+	SpectrumBandRange() = default;
+
+	/// Fractional bin at a position from 0 to 1
+	double BinAt(double pos) const;
+};
+
+/// Bins shown by a row of the spectrum
+struct SpectrumBandRow {
+	/// First bin, and the lower of the bins to interpolate between
+	int first;
+	/// Last bin, and the upper of the bins to interpolate between
+	int last;
+	/// Weight of last when interpolating, or negative to show the greatest
+	/// value in [first, last]
+	float frac;
+};
 
 /// @class AudioSpectrumRenderer
 /// @brief Render frequency-power spectrum graphs for audio data.
@@ -57,6 +104,8 @@ class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 
 	/// Internal cache management for the spectrum
 	std::unique_ptr<AudioSpectrumCache> cache;
+	/// Registration of the cache with the global cache budget
+	agi::CacheBudget::Registration cache_registration;
 
 	/// Colour tables used for rendering
 	std::vector<AudioColorScheme> colors;
@@ -67,43 +116,97 @@ class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	/// Binary logarithm of number of samples between the start of derivations
 	size_t derivation_dist = 0;
 
+	/// Length of the audio the cache was created for
+	int64_t num_samples = 0;
+
+	/// Frequency scale and range set by SetFrequencyRange
+	SpectrumScale freq_scale = SpectrumScale::Linear;
+	int min_freq = 0;
+	int max_freq = 0;
+
+	/// Frequency range for the current provider
+	SpectrumBandRange band_range;
+	/// Number of bins stored in each block. Only the bins up to the top of
+	/// the displayed range are computed and stored.
+	size_t block_bins = 0;
+	/// Bins shown by each row, for bitmaps of band_rows.size() rows
+	std::vector<SpectrumBandRow> band_rows;
+
+	/// Recompute band_rows for a bitmap height, if it's changed
+	void UpdateBandRows(int height);
+
+	/// Blocks loaded by LoadCache, in 4.12 fixed point
+	std::unordered_map<size_t, std::vector<uint16_t>> saved_blocks;
+
 	/// @brief Reset in response to changing audio provider
 	///
 	/// Overrides the OnSetProvider event handler in the base class, to reset things
 	/// when the audio provider is changed.
 	void OnSetProvider() override;
 
+	/// Discard the data uploaded for OpenGL drawing when the zoom changes
+	void OnSetMillisecondsPerPixel() override;
+
+	/// OpenGL drawing, if enabled
+	std::unique_ptr<AudioSpectrumGL> gl;
+
 	/// @brief Recreates the cache
 	///
 	/// To be called when the number of blocks in cache might have changed,
 	/// e.g. new audio provider or new resolution.
 	void RecreateCache();
 
+	/// Number of derivations in the audio the cache was created for
+	size_t BlockCount() const;
+
 	/// @brief Fill a block with frequency-power data for a time range
 	/// @param      block_index Index of the block to fill data for
 	/// @param[out] block       Address to write the data to
 	void FillBlock(size_t block_index, float *block);
 
-	/// @brief Convert audio data to float range [-1;+1)
-	/// @param count Samples to convert
-	/// @param dest Buffer to fill
-	template<class T>
-	void ConvertToFloat(size_t count, T *dest);
-
-#ifdef WITH_FFTW3
-	/// FFTW plan data
-	fftw_plan dft_plan = nullptr;
-	/// Pre-allocated input array for FFTW
-	double *dft_input = nullptr;
-	/// Pre-allocated output array for FFTW
-	fftw_complex *dft_output = nullptr;
-#else
-	/// Pre-allocated scratch area for doing FFT derivations
-	std::vector<float> fft_scratch;
-#endif
-
-	/// Pre-allocated scratch area for storing raw audio data
-	std::vector<int16_t> audio_scratch;
+	/// Get the index of the block drawn in a column of the virtual bitmap
+	size_t BlockIndex(int ax) const;
+
+	/// FFT plan and scratch buffers for deriving blocks on one thread
+	struct Derivation;
+	/// Background queue which derives blocks requested by PrepareRender
+	struct Worker;
+
+	/// Derivation state for blocks computed on the GUI thread
+	std::unique_ptr<Derivation> derivation;
+	/// Background workers, each with its own derivation state
+	std::vector<std::unique_ptr<Worker>> workers;
+	/// Worker to give the next batch of blocks to
+	size_t next_worker = 0;
+
+	/// Incremented whenever the blocks being computed become invalid, so
+	/// that the workers can abandon them
+	std::atomic<uint32_t> generation{0};
+	/// Protects ready_blocks and queued_blocks
+	std::mutex pending_mutex;
+	/// Blocks computed by the workers which haven't been put in the cache
+	/// yet. They're moved into the cache as soon as the GUI thread hears
+	/// about them, so that they're aged and counted against the cache budget
+	/// even if they're never drawn.
+	std::unordered_map<size_t, std::unique_ptr<float[]>> ready_blocks;
+	/// Blocks waiting for or being computed by a worker
+	std::unordered_set<size_t> queued_blocks;
+	/// Lets the workers' notifications check that the renderer still exists
+	std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+
+	/// Discard all of the blocks being computed and wait for the workers to
+	/// finish what they're doing
+	void CancelPendingBlocks();
+
+	/// @brief Compute blocks for PrepareRender on a worker's thread
+	/// @param worker         Worker to compute the blocks with
+	/// @param audio          Provider to read from
+	/// @param blocks         Indexes of the blocks to compute
+	/// @param for_generation Value of generation when the blocks were requested
+	void ComputeBlocks(Worker &worker, agi::AudioProvider *audio, std::vector<size_t> const& blocks, uint32_t for_generation);
+
+	/// Move the blocks the workers have finished into the cache
+	void StoreReadyBlocks();
 
 public:
 	/// @brief Constructor
@@ -122,6 +225,19 @@ public:
 	/// @brief Render blank area
 	void RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style) override;
 
+	/// @brief Are all of the blocks for a range loaded from a saved cache?
+	bool CanRenderUndecoded(int start, int width) const override;
+
+	/// @brief Start computing any blocks missing for a range in the background
+	/// @return Are all of the blocks already available?
+	bool PrepareRender(int start, int width) override;
+
+	/// @brief Draw the spectrum with OpenGL when possible
+	/// @param parent Window to create the OpenGL canvas in
+	///
+	/// If OpenGL isn't usable the spectrum is drawn as it would be otherwise.
+	void EnableOpenGL(wxWindow *parent);
+
 	/// @brief Set the derivation resolution
 	/// @param derivation_size Binary logarithm of number of samples to use in deriving frequency-power data
 	/// @param derivation_dist Binary logarithm of number of samples between the start of derivations
@@ -133,7 +249,28 @@ public:
 	/// is specified too large, it will be clamped to the size.
 	void SetResolution(size_t derivation_size, size_t derivation_dist);
 
+	/// @brief Set the range of frequencies to show
+	/// @param scale    Scale to draw the frequencies with
+	/// @param min_freq Lowest frequency to show in Hz
+	/// @param max_freq Highest frequency to show in Hz, or 0 for everything up
+	///                 to the Nyquist frequency
+	///
+	/// Frequencies above the range aren't computed at all.
+	void SetFrequencyRange(SpectrumScale scale, int min_freq, int max_freq);
+
 	/// @brief Cleans up the cache
 	/// @param max_size Maximum size in bytes for the cache
 	void AgeCache(size_t max_size) override;
+
+	/// @brief Load spectrum blocks saved by SaveCache
+	///
+	/// Blocks saved with a different resolution or for audio of a different
+	/// length are ignored.
+	void LoadCache(agi::fs::path const& filename) override;
+
+	/// @brief Save the spectrum blocks which have been computed or loaded
+	///
+	/// At most Audio/Renderer/Spectrum/Memory Max worth of blocks are saved,
+	/// preferring those which are currently in the cache.
+	void SaveCache(agi::fs::path const& filename) const override;
 };
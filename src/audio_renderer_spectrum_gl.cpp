@@ -0,0 +1,474 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file audio_renderer_spectrum_gl.cpp
+/// @brief OpenGL drawing of the audio spectrum
+/// @ingroup audio_ui
+///
+
+#include "audio_renderer_spectrum_gl.h"
+
+#include "audio_colorscheme.h"
+#include "audio_renderer_spectrum.h"
+#include "gl_wrap.h"
+
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <wx/dcmemory.h>
+#include <wx/glcanvas.h>
+#include <wx/image.h>
+
+#ifdef HAVE_OPENGL_GL_H
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#else
+#include <GL/gl.h>
+#include "gl/glext.h"
+#endif
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace {
+const char vertex_shader[] =
+	"void main() {\n"
+	"	gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+	"	gl_Position = ftransform();\n"
+	"}\n";
+
+// This does the same thing as AudioSpectrumRenderer::Render does for each
+// pixel, with row 0 being the bottom of the bitmap
+const char fragment_shader[] =
+	"uniform sampler2D power;\n"
+	"uniform sampler1D palette;\n"
+	"uniform float power_scale;\n"
+	"uniform float bins;\n"
+	"uniform float height;\n"
+	"uniform float amplitude;\n"
+	"uniform float palette_max;\n"
+	"uniform float scale;\n"
+	"uniform float low;\n"
+	"uniform float high;\n"
+	"uniform float bins_per_hz;\n"
+	"\n"
+	"float Power(float bin) {\n"
+	"	return texture2D(power, vec2(gl_TexCoord[0].x, (bin + 0.5) / bins)).r * power_scale;\n"
+	"}\n"
+	"\n"
+	"// SpectrumBandRange::BinAt\n"
+	"float BinAt(float pos) {\n"
+	"	float value = low + (high - low) * pos;\n"
+	"	if (scale == 1.0) return exp(value) * bins_per_hz;\n"
+	"	if (scale == 2.0) return 700.0 * (pow(10.0, value / 2595.0) - 1.0) * bins_per_hz;\n"
+	"	return value * bins_per_hz;\n"
+	"}\n"
+	"\n"
+	"void main() {\n"
+	"	float y = floor(gl_FragCoord.y);\n"
+	"	float bottom = BinAt(y / height);\n"
+	"	float top = BinAt((y + 1.0) / height);\n"
+	"	float val = 0.0;\n"
+	"	if (top - bottom < 1.0) {\n"
+	"		// Interpolate\n"
+	"		float ideal = min(top, bins - 1.0);\n"
+	"		val = mix(Power(floor(ideal)), Power(ceil(ideal)), fract(ideal));\n"
+	"	}\n"
+	"	else {\n"
+	"		// Pick greatest\n"
+	"		float first = clamp(floor(bottom), 0.0, bins - 1.0);\n"
+	"		float last = clamp(floor(top), first, bins - 1.0);\n"
+	"		for (float bin = first; bin <= last; bin += 1.0)\n"
+	"			val = max(val, Power(bin));\n"
+	"	}\n"
+	"	float index = clamp(floor(val * amplitude * palette_max), 0.0, palette_max);\n"
+	"	gl_FragColor = texture1D(palette, (index + 0.5) / (palette_max + 1.0));\n"
+	"}\n";
+
+/// Largest value stored in 16-bit textures; the spectrum's values can go
+/// slightly over 1
+const float max_16bit_power = 4.f;
+}
+
+struct AudioSpectrumGL::Functions {
+#define GL_FN(ret, name, args) \
+	ret (APIENTRY *name) args = reinterpret_cast<ret (APIENTRY *) args>(OpenGLWrapper::GetProcAddress("gl" #name))
+
+	GL_FN(GLuint, CreateShader, (GLenum));
+	GL_FN(void, ShaderSource, (GLuint, GLsizei, const char *const *, const GLint *));
+	GL_FN(void, CompileShader, (GLuint));
+	GL_FN(void, GetShaderiv, (GLuint, GLenum, GLint *));
+	GL_FN(void, GetShaderInfoLog, (GLuint, GLsizei, GLsizei *, char *));
+	GL_FN(void, DeleteShader, (GLuint));
+	GL_FN(GLuint, CreateProgram, ());
+	GL_FN(void, AttachShader, (GLuint, GLuint));
+	GL_FN(void, LinkProgram, (GLuint));
+	GL_FN(void, GetProgramiv, (GLuint, GLenum, GLint *));
+	GL_FN(void, GetProgramInfoLog, (GLuint, GLsizei, GLsizei *, char *));
+	GL_FN(void, DeleteProgram, (GLuint));
+	GL_FN(void, UseProgram, (GLuint));
+	GL_FN(GLint, GetUniformLocation, (GLuint, const char *));
+	GL_FN(void, Uniform1i, (GLint, GLint));
+	GL_FN(void, Uniform1f, (GLint, GLfloat));
+	GL_FN(void, ActiveTexture, (GLenum));
+	GL_FN(void, GenFramebuffersEXT, (GLsizei, GLuint *));
+	GL_FN(void, DeleteFramebuffersEXT, (GLsizei, const GLuint *));
+	GL_FN(void, BindFramebufferEXT, (GLenum, GLuint));
+	GL_FN(void, FramebufferRenderbufferEXT, (GLenum, GLenum, GLenum, GLuint));
+	GL_FN(GLenum, CheckFramebufferStatusEXT, (GLenum));
+	GL_FN(void, GenRenderbuffersEXT, (GLsizei, GLuint *));
+	GL_FN(void, DeleteRenderbuffersEXT, (GLsizei, const GLuint *));
+	GL_FN(void, BindRenderbufferEXT, (GLenum, GLuint));
+	GL_FN(void, RenderbufferStorageEXT, (GLenum, GLenum, GLsizei, GLsizei));
+
+#undef GL_FN
+
+	bool Loaded() const {
+		return CreateShader && ShaderSource && CompileShader && GetShaderiv
+			&& GetShaderInfoLog && DeleteShader && CreateProgram && AttachShader
+			&& LinkProgram && GetProgramiv && GetProgramInfoLog && DeleteProgram
+			&& UseProgram && GetUniformLocation && Uniform1i && Uniform1f
+			&& ActiveTexture && GenFramebuffersEXT && DeleteFramebuffersEXT
+			&& BindFramebufferEXT && FramebufferRenderbufferEXT
+			&& CheckFramebufferStatusEXT && GenRenderbuffersEXT
+			&& DeleteRenderbuffersEXT && BindRenderbufferEXT && RenderbufferStorageEXT;
+	}
+};
+
+AudioSpectrumGL::AudioSpectrumGL(wxWindow *parent, std::vector<AudioColorScheme> const& colors)
+: colors(colors)
+{
+	int attribs[] = { WX_GL_RGBA, 0 };
+	canvas = new wxGLCanvas(parent, -1, attribs, wxPoint(0, 0), wxSize(1, 1));
+	canvas->Enable(false);
+}
+
+AudioSpectrumGL::~AudioSpectrumGL()
+{
+	if (initialized && gl && context && canvas->SetCurrent(*context))
+	{
+		DeleteTextures();
+		if (!palettes.empty())
+			glDeleteTextures(palettes.size(), &palettes[0]);
+		if (program)
+			gl->DeleteProgram(program);
+		if (framebuffer)
+			gl->DeleteFramebuffersEXT(1, &framebuffer);
+		if (renderbuffer)
+			gl->DeleteRenderbuffersEXT(1, &renderbuffer);
+	}
+	context.reset();
+	canvas->Destroy();
+}
+
+bool AudioSpectrumGL::MakeCurrent()
+{
+	if (failed || !canvas->IsShownOnScreen())
+		return false;
+
+	if (!context)
+		context = agi::make_unique<wxGLContext>(canvas);
+	if (!canvas->SetCurrent(*context))
+		return false;
+
+	if (!initialized)
+	{
+		initialized = true;
+		failed = !Init();
+		if (failed)
+			LOG_W("audio/renderer/spectrum/gl") << "Falling back to drawing the spectrum without OpenGL";
+	}
+	return !failed;
+}
+
+bool AudioSpectrumGL::Init()
+{
+	if (!OpenGLWrapper::IsExtensionSupported("GL_EXT_framebuffer_object"))
+	{
+		LOG_W("audio/renderer/spectrum/gl") << "GL_EXT_framebuffer_object is not supported";
+		return false;
+	}
+
+	gl = agi::make_unique<Functions>();
+	if (!gl->Loaded())
+	{
+		LOG_W("audio/renderer/spectrum/gl") << "OpenGL 2.0 is not supported";
+		gl.reset();
+		return false;
+	}
+
+	float_textures = OpenGLWrapper::IsExtensionSupported("GL_ARB_texture_float");
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+
+	auto compile = [&](GLenum type, const char *source) -> GLuint {
+		GLuint shader = gl->CreateShader(type);
+		gl->ShaderSource(shader, 1, &source, nullptr);
+		gl->CompileShader(shader);
+
+		GLint status = 0;
+		gl->GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+		if (!status)
+		{
+			char log[1024] = {0};
+			gl->GetShaderInfoLog(shader, sizeof log, nullptr, log);
+			LOG_W("audio/renderer/spectrum/gl") << "Compiling shader failed: " << log;
+			gl->DeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	};
+
+	GLuint vertex = compile(GL_VERTEX_SHADER, vertex_shader);
+	GLuint fragment = compile(GL_FRAGMENT_SHADER, fragment_shader);
+	if (vertex && fragment)
+	{
+		program = gl->CreateProgram();
+		gl->AttachShader(program, vertex);
+		gl->AttachShader(program, fragment);
+		gl->LinkProgram(program);
+	}
+	// The program keeps the shaders alive for as long as they're attached
+	if (vertex) gl->DeleteShader(vertex);
+	if (fragment) gl->DeleteShader(fragment);
+	if (!program)
+		return false;
+
+	GLint status = 0;
+	gl->GetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status)
+	{
+		char log[1024] = {0};
+		gl->GetProgramInfoLog(program, sizeof log, nullptr, log);
+		LOG_W("audio/renderer/spectrum/gl") << "Linking shader failed: " << log;
+		return false;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	palettes.resize(colors.size());
+	glGenTextures(palettes.size(), &palettes[0]);
+	for (size_t i = 0; i < colors.size(); ++i)
+	{
+		auto const& palette = colors[i].GetPalette();
+		const GLsizei entries = palette.size() / 3;
+		if (entries > max_texture_size)
+		{
+			LOG_W("audio/renderer/spectrum/gl") << "Maximum texture size " << max_texture_size << " is too small for the palette";
+			return false;
+		}
+
+		glBindTexture(GL_TEXTURE_1D, palettes[i]);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB8, entries, 0, GL_RGB, GL_UNSIGNED_BYTE, &palette[0]);
+	}
+
+	gl->GenFramebuffersEXT(1, &framebuffer);
+	gl->GenRenderbuffersEXT(1, &renderbuffer);
+
+	if (GLenum err = glGetError())
+	{
+		LOG_W("audio/renderer/spectrum/gl") << "Setting up failed with error code " << err;
+		return false;
+	}
+
+	LOG_I("audio/renderer/spectrum/gl") << "Drawing the spectrum with OpenGL using " << (float_textures ? "float" : "16-bit") << " textures";
+	return true;
+}
+
+void AudioSpectrumGL::DeleteTextures()
+{
+	for (auto const& texture : textures)
+		glDeleteTextures(1, &texture.second.texture);
+	textures.clear();
+	texture_bytes = 0;
+}
+
+void AudioSpectrumGL::Invalidate()
+{
+	if (textures.empty()) return;
+
+	if (MakeCurrent())
+		DeleteTextures();
+	else
+	{
+		textures.clear();
+		texture_bytes = 0;
+	}
+}
+
+void AudioSpectrumGL::AgeCache(size_t max_size)
+{
+	if (texture_bytes <= max_size || !MakeCurrent()) return;
+
+	std::vector<std::pair<uint64_t, int>> by_age;
+	by_age.reserve(textures.size());
+	for (auto const& texture : textures)
+		by_age.emplace_back(texture.second.last_used, texture.first);
+	sort(begin(by_age), end(by_age));
+
+	for (auto const& oldest : by_age)
+	{
+		if (texture_bytes <= max_size) break;
+		auto it = textures.find(oldest.second);
+		glDeleteTextures(1, &it->second.texture);
+		texture_bytes -= it->second.bytes;
+		textures.erase(it);
+	}
+}
+
+bool AudioSpectrumGL::Render(wxBitmap &bmp, int start, size_t bins, SpectrumBandRange const& range, float amplitude, int style, std::function<const float *(int)> const& column)
+{
+	const int width = bmp.GetWidth();
+	const int height = bmp.GetHeight();
+	if (width <= 0 || height <= 0 || !MakeCurrent())
+		return false;
+	if ((int)bins > max_texture_size || width > max_texture_size || height > max_texture_size)
+		return false;
+
+	gl->BindFramebufferEXT(GL_FRAMEBUFFER_EXT, framebuffer);
+	if (width > framebuffer_width || height > framebuffer_height)
+	{
+		framebuffer_width = std::max(width, framebuffer_width);
+		framebuffer_height = std::max(height, framebuffer_height);
+		gl->BindRenderbufferEXT(GL_RENDERBUFFER_EXT, renderbuffer);
+		gl->RenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_RGBA8, framebuffer_width, framebuffer_height);
+		gl->FramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_RENDERBUFFER_EXT, renderbuffer);
+		if (gl->CheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT)
+		{
+			LOG_W("audio/renderer/spectrum/gl") << "Framebuffer of " << framebuffer_width << "x" << framebuffer_height << " is incomplete";
+			gl->BindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+			failed = true;
+			return false;
+		}
+	}
+
+	// Upload the data for the bitmap with a column per texel column and a
+	// bin per texel row, if it isn't already
+	auto it = textures.find(start);
+	if (it != textures.end() && it->second.bytes != width * bins * (float_textures ? sizeof(float) : sizeof(uint16_t)))
+	{
+		glDeleteTextures(1, &it->second.texture);
+		texture_bytes -= it->second.bytes;
+		textures.erase(it);
+		it = textures.end();
+	}
+	if (it == textures.end())
+	{
+		PowerTexture texture;
+		glGenTextures(1, &texture.texture);
+		glBindTexture(GL_TEXTURE_2D, texture.texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		if (float_textures)
+		{
+			upload_buffer.resize(width * bins);
+			for (int x = 0; x < width; ++x)
+			{
+				const float *power = column(x);
+				for (size_t bin = 0; bin < bins; ++bin)
+					upload_buffer[bin * width + x] = power[bin];
+			}
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE32F_ARB, width, bins, 0, GL_LUMINANCE, GL_FLOAT, &upload_buffer[0]);
+			texture.bytes = upload_buffer.size() * sizeof(float);
+		}
+		else
+		{
+			upload_buffer_16.resize(width * bins);
+			for (int x = 0; x < width; ++x)
+			{
+				const float *power = column(x);
+				for (size_t bin = 0; bin < bins; ++bin)
+				{
+					float val = std::min(std::max(power[bin] / max_16bit_power, 0.f), 1.f);
+					upload_buffer_16[bin * width + x] = static_cast<uint16_t>(val * 65535 + .5f);
+				}
+			}
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE16, width, bins, 0, GL_LUMINANCE, GL_UNSIGNED_SHORT, &upload_buffer_16[0]);
+			texture.bytes = upload_buffer_16.size() * sizeof(uint16_t);
+		}
+
+		texture_bytes += texture.bytes;
+		it = textures.emplace(start, texture).first;
+	}
+	it->second.last_used = ++use_count;
+
+	glViewport(0, 0, width, height);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0, 1, 0, 1, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	const float palette_max = colors[style].GetPalette().size() / 3 - 1;
+	gl->UseProgram(program);
+	gl->Uniform1i(gl->GetUniformLocation(program, "power"), 0);
+	gl->Uniform1i(gl->GetUniformLocation(program, "palette"), 1);
+	gl->Uniform1f(gl->GetUniformLocation(program, "power_scale"), float_textures ? 1.f : max_16bit_power);
+	gl->Uniform1f(gl->GetUniformLocation(program, "bins"), bins);
+	gl->Uniform1f(gl->GetUniformLocation(program, "height"), height);
+	gl->Uniform1f(gl->GetUniformLocation(program, "amplitude"), amplitude);
+	gl->Uniform1f(gl->GetUniformLocation(program, "palette_max"), palette_max);
+	gl->Uniform1f(gl->GetUniformLocation(program, "scale"), (float)range.scale);
+	gl->Uniform1f(gl->GetUniformLocation(program, "low"), range.low);
+	gl->Uniform1f(gl->GetUniformLocation(program, "high"), range.high);
+	gl->Uniform1f(gl->GetUniformLocation(program, "bins_per_hz"), range.bins_per_hz);
+
+	gl->ActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_1D, palettes[style]);
+	gl->ActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, it->second.texture);
+
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0); glVertex2f(0, 0);
+	glTexCoord2f(1, 0); glVertex2f(1, 0);
+	glTexCoord2f(1, 1); glVertex2f(1, 1);
+	glTexCoord2f(0, 1); glVertex2f(0, 1);
+	glEnd();
+
+	pixels.resize(width * height * 3);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	gl->UseProgram(0);
+	gl->BindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+	if (GLenum err = glGetError())
+	{
+		LOG_W("audio/renderer/spectrum/gl") << "Drawing failed with error code " << err;
+		failed = true;
+		return false;
+	}
+
+	// OpenGL's rows go from the bottom up
+	wxImage img(width, height, false);
+	unsigned char *imgdata = img.GetData();
+	for (int y = 0; y < height; ++y)
+		memcpy(imgdata + y * width * 3, &pixels[(height - 1 - y) * width * 3], width * 3);
+
+	wxBitmap tmpbmp(img);
+	wxMemoryDC targetdc(bmp);
+	targetdc.DrawBitmap(tmpbmp, 0, 0);
+	return true;
+}
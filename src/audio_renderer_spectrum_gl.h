@@ -0,0 +1,115 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file audio_renderer_spectrum_gl.h
+/// @see audio_renderer_spectrum_gl.cpp
+/// @ingroup audio_ui
+///
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+class AudioColorScheme;
+struct SpectrumBandRange;
+class wxBitmap;
+class wxGLCanvas;
+class wxGLContext;
+class wxWindow;
+
+/// @class AudioSpectrumGL
+/// @brief Draws spectrum bitmaps with OpenGL
+///
+/// The frequency-power data for each bitmap is kept in a texture, and a
+/// fragment shader does the band scaling and colour mapping, so changing the
+/// amplitude scale only has to redraw from the existing textures. Drawing is
+/// done to an offscreen framebuffer which is then read into the bitmap, so
+/// the rest of the audio display is drawn just as it is without OpenGL.
+class AudioSpectrumGL {
+	struct Functions;
+	/// OpenGL 2.0 and framebuffer object entry points
+	std::unique_ptr<Functions> gl;
+
+	/// Canvas which the context is created for. It's one pixel big rather
+	/// than hidden as GTK can't make a context current for a hidden window.
+	wxGLCanvas *canvas;
+	std::unique_ptr<wxGLContext> context;
+
+	/// Set if initialization failed, in which case Render always fails
+	bool failed = false;
+	/// Has the context been set up?
+	bool initialized = false;
+
+	unsigned int program = 0;
+	unsigned int framebuffer = 0;
+	unsigned int renderbuffer = 0;
+	int framebuffer_width = 0;
+	int framebuffer_height = 0;
+	int max_texture_size = 0;
+	/// Are float textures supported? If not the data is stored in 16 bits.
+	bool float_textures = false;
+
+	/// Palette texture for each rendering style
+	std::vector<unsigned int> palettes;
+	/// Palettes to upload once the context is set up
+	std::vector<AudioColorScheme> const& colors;
+
+	struct PowerTexture {
+		unsigned int texture;
+		size_t bytes;
+		uint64_t last_used;
+	};
+	/// Frequency-power data for bitmaps, by their first pixel
+	std::map<int, PowerTexture> textures;
+	/// Total size of the textures
+	size_t texture_bytes = 0;
+	/// Incremented whenever a texture is used
+	uint64_t use_count = 0;
+
+	std::vector<float> upload_buffer;
+	std::vector<uint16_t> upload_buffer_16;
+	std::vector<unsigned char> pixels;
+
+	/// Make the context current, setting it up if needed
+	bool MakeCurrent();
+	bool Init();
+	void DeleteTextures();
+
+public:
+	/// @param parent Window to create the canvas in
+	/// @param colors Colour scheme for each rendering style, which must live as long as this
+	AudioSpectrumGL(wxWindow *parent, std::vector<AudioColorScheme> const& colors);
+	~AudioSpectrumGL();
+
+	/// @brief Draw a bitmap
+	/// @param bmp       Bitmap to draw to, whose size is the area to draw
+	/// @param start     First pixel from the beginning of the audio stream
+	/// @param bins      Number of frequency bins in each column's data
+	/// @param range     Frequencies to draw
+	/// @param amplitude Amplitude scale to draw with
+	/// @param style     Rendering style to draw with
+	/// @param column    Gets the data for a column of the bitmap, if it needs uploading
+	/// @return Was it drawn? If not it should be drawn without OpenGL.
+	bool Render(wxBitmap &bmp, int start, size_t bins, SpectrumBandRange const& range, float amplitude, int style, std::function<const float *(int)> const& column);
+
+	/// Discard the uploaded data, as it no longer matches what would be drawn
+	void Invalidate();
+
+	/// Discard the least recently used data until it fits in max_size bytes
+	void AgeCache(size_t max_size);
+};
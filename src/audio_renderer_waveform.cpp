@@ -32,7 +32,9 @@
 #include "audio_colorscheme.h"
 #include "options.h"
 
+#include <libaegisub/audio/peak_index.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/make_unique.h>
 
 #include <algorithm>
 #include <wx/dcmemory.h>
@@ -45,6 +47,43 @@ enum {
 	Waveform_Continuous
 };
 
+/// Allocates blocks of column summaries for the waveform
+struct AudioWaveformColumnFactory {
+	typedef AudioWaveformRenderer::Column Column;
+	typedef std::unique_ptr<Column, std::default_delete<Column[]>> BlockType;
+
+	/// Pointer back to the owning waveform renderer
+	AudioWaveformRenderer *waveform;
+
+	/// @brief Fill a block of columns
+	/// @param i     Index of the block to produce
+	/// @param spare Block aged out of the cache to reuse, if any
+	/// @return Filled block
+	BlockType ProduceBlock(size_t i, BlockType spare)
+	{
+		if (!spare)
+			spare.reset(new Column[waveform->columns_per_block]);
+		waveform->FillColumns(i, spare.get());
+		return spare;
+	}
+
+	/// @brief Calculate the in-memory size of a block
+	size_t GetBlockSize() const
+	{
+		return sizeof(Column) * waveform->columns_per_block;
+	}
+};
+
+/// @brief Cache for the waveform's column summaries
+class AudioWaveformColumnCache
+: public agi::DataBlockCache<AudioWaveformRenderer::Column, 8, AudioWaveformColumnFactory> {
+public:
+	AudioWaveformColumnCache(size_t block_count, AudioWaveformRenderer *renderer)
+	: DataBlockCache(block_count, AudioWaveformColumnFactory{renderer})
+	{
+	}
+};
+
 AudioWaveformRenderer::AudioWaveformRenderer(std::string const& color_scheme_name)
 : render_averages(OPT_GET("Audio/Display/Waveform Style")->GetInt() == Waveform_MaxAvg)
 {
@@ -55,21 +94,24 @@ AudioWaveformRenderer::AudioWaveformRenderer(std::string const& color_scheme_nam
 
 AudioWaveformRenderer::~AudioWaveformRenderer() { }
 
-void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
+void AudioWaveformRenderer::OnSetProvider()
 {
-	wxMemoryDC dc(bmp);
-	wxRect rect(wxPoint(0, 0), bmp.GetSize());
-	int midpoint = rect.height / 2;
+	audio_buffer.reset();
+	columns_registration.Unregister();
+	columns.reset();
+}
 
-	const AudioColorScheme *pal = &colors[style];
+void AudioWaveformRenderer::OnSetMillisecondsPerPixel()
+{
+	audio_buffer.reset();
+	columns_registration.Unregister();
+	columns.reset();
+}
 
+void AudioWaveformRenderer::FillColumns(size_t block, Column *column)
+{
 	double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
 
-	// Fill the background
-	dc.SetBrush(wxBrush(pal->get(0.0f)));
-	dc.SetPen(*wxTRANSPARENT_PEN);
-	dc.DrawRectangle(rect);
-
 	// Make sure we've got a buffer to fill with audio data
 	if (!audio_buffer)
 	{
@@ -78,41 +120,95 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 		audio_buffer.reset(new char[buffer_needed]);
 	}
 
-	double cur_sample = start * pixel_samples;
+	double cur_sample = block * columns_per_block * pixel_samples;
 
 	assert(provider->GetBytesPerSample() == 2);
 	assert(provider->GetChannels() == 1);
 
-	wxPen pen_peaks(wxPen(pal->get(0.4f)));
-	wxPen pen_avgs(wxPen(pal->get(0.7f)));
+	// When zoomed out far enough, summarize each column from the cache's
+	// peak index rather than reading every sample in it
+	auto peak_index = provider->GetPeakIndex();
 
-	for (int x = 0; x < rect.width; ++x)
+	for (int x = 0; x < columns_per_block; ++x, ++column)
 	{
-		provider->GetAudio(audio_buffer.get(), (int64_t)cur_sample, (int64_t)pixel_samples);
-		cur_sample += pixel_samples;
-
 		int peak_min = 0, peak_max = 0;
-		int64_t avg_min_accum = 0, avg_max_accum = 0;
-		auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
-		for (int si = pixel_samples; si > 0; --si, ++aud)
+		double avg_min_mean = 0, avg_max_mean = 0;
+
+		agi::AudioPeak peak;
+		if (peak_index && peak_index->GetPeak((int64_t)cur_sample, (int64_t)pixel_samples, peak))
 		{
-			if (*aud > 0)
-			{
-				peak_max = std::max(peak_max, (int)*aud);
-				avg_max_accum += *aud;
-			}
-			else
+			peak_min = peak.min;
+			peak_max = peak.max;
+			avg_min_mean = peak.neg_mean;
+			avg_max_mean = peak.pos_mean;
+		}
+		else
+		{
+			auto aud = static_cast<const int16_t *>(provider->GetAudioView(audio_buffer.get(), (int64_t)cur_sample, (int64_t)pixel_samples));
+
+			int64_t avg_min_accum = 0, avg_max_accum = 0;
+			for (int si = pixel_samples; si > 0; --si, ++aud)
 			{
-				peak_min = std::min(peak_min, (int)*aud);
-				avg_min_accum += *aud;
+				if (*aud > 0)
+				{
+					peak_max = std::max(peak_max, (int)*aud);
+					avg_max_accum += *aud;
+				}
+				else
+				{
+					peak_min = std::min(peak_min, (int)*aud);
+					avg_min_accum += *aud;
+				}
 			}
+			avg_min_mean = avg_min_accum / pixel_samples;
+			avg_max_mean = avg_max_accum / pixel_samples;
 		}
+		cur_sample += pixel_samples;
+
+		column->peak_min = peak_min;
+		column->peak_max = peak_max;
+		column->avg_min = avg_min_mean;
+		column->avg_max = avg_max_mean;
+	}
+}
+
+void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
+{
+	wxMemoryDC dc(bmp);
+	wxRect rect(wxPoint(0, 0), bmp.GetSize());
+	int midpoint = rect.height / 2;
+
+	const AudioColorScheme *pal = &colors[style];
+
+	// Fill the background
+	dc.SetBrush(wxBrush(pal->get(0.0f)));
+	dc.SetPen(*wxTRANSPARENT_PEN);
+	dc.DrawRectangle(rect);
 
+	// The bitmaps are all the same width and start at multiples of it, so
+	// each is drawn from exactly one block of columns
+	if (!columns || columns_per_block != rect.width)
+	{
+		columns_per_block = rect.width;
+		double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
+		size_t total_columns = (size_t)(provider->GetNumSamples() / pixel_samples) + 1;
+		columns_registration.Unregister();
+		columns = agi::make_unique<AudioWaveformColumnCache>(total_columns / columns_per_block + 1, this);
+		columns_registration = agi::CacheBudget::Global().Register("Audio waveform", columns.get());
+	}
+	assert(start % columns_per_block == 0);
+	const Column *column = &columns->Get(start / columns_per_block);
+
+	wxPen pen_peaks(wxPen(pal->get(0.4f)));
+	wxPen pen_avgs(wxPen(pal->get(0.7f)));
+
+	for (int x = 0; x < rect.width; ++x, ++column)
+	{
 		// midpoint is half height
-		peak_min = std::max((int)(peak_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
-		peak_max = std::min((int)(peak_max * amplitude_scale * midpoint) / 0x8000, midpoint);
-		int avg_min = std::max((int)(avg_min_accum * amplitude_scale * midpoint / pixel_samples) / 0x8000, -midpoint);
-		int avg_max = std::min((int)(avg_max_accum * amplitude_scale * midpoint / pixel_samples) / 0x8000, midpoint);
+		int peak_min = std::max((int)(column->peak_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
+		int peak_max = std::min((int)(column->peak_max * amplitude_scale * midpoint) / 0x8000, midpoint);
+		int avg_min = std::max((int)(column->avg_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
+		int avg_max = std::min((int)(column->avg_max * amplitude_scale * midpoint) / 0x8000, midpoint);
 
 		dc.SetPen(pen_peaks);
 		dc.DrawLine(x, midpoint - peak_max, x, midpoint - peak_min);
@@ -131,6 +227,29 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	dc.DrawLine(0, midpoint, rect.width, midpoint);
 }
 
+bool AudioWaveformRenderer::CanRenderUndecoded(int start, int width) const
+{
+	auto peak_index = provider->GetPeakIndex();
+	if (!peak_index) return false;
+
+	// Must step through the columns exactly as Render does
+	double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
+	double cur_sample = start * pixel_samples;
+	agi::AudioPeak peak;
+	for (int x = 0; x < width; ++x, cur_sample += pixel_samples)
+	{
+		if (!peak_index->GetPeak((int64_t)cur_sample, (int64_t)pixel_samples, peak))
+			return false;
+	}
+	return true;
+}
+
+void AudioWaveformRenderer::AgeCache(size_t max_size)
+{
+	if (columns)
+		columns->Age(max_size);
+}
+
 void AudioWaveformRenderer::RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style)
 {
 	const AudioColorScheme *pal = &colors[style];
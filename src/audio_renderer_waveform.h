@@ -29,25 +29,54 @@
 
 #include "audio_renderer.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 class AudioColorScheme;
+class AudioWaveformColumnCache;
+struct AudioWaveformColumnFactory;
 class wxArrayString;
 
 /// Render a waveform display of PCM audio data
 class AudioWaveformRenderer final : public AudioRendererBitmapProvider {
+	friend struct AudioWaveformColumnFactory;
+	friend class AudioWaveformColumnCache;
+
 	/// Colour tables used for rendering
 	std::vector<AudioColorScheme> colors;
 
 	/// Pre-allocated buffer for audio fetched from provider
 	std::unique_ptr<char[]> audio_buffer;
 
+	/// Peaks and averages of each column, independent of the amplitude
+	/// scale, height and style, so that changing those only has to redraw
+	/// the bitmaps rather than read the audio again
+	std::unique_ptr<AudioWaveformColumnCache> columns;
+	/// Registration of the column cache with the global cache budget
+	agi::CacheBudget::Registration columns_registration;
+
+	/// Number of columns in each block of the column cache
+	int columns_per_block = 0;
+
 	/// Whether to render max+avg or just max
 	bool render_averages;
 
-	void OnSetProvider() override { audio_buffer.reset(); }
-	void OnSetMillisecondsPerPixel() override { audio_buffer.reset(); }
+	void OnSetProvider() override;
+	void OnSetMillisecondsPerPixel() override;
+
+	/// Summary of the audio in one column of the waveform
+	struct Column {
+		int16_t peak_min;
+		int16_t peak_max;
+		float avg_min;
+		float avg_max;
+	};
+
+	/// @brief Read the audio for a block of columns
+	/// @param block       Index of the block
+	/// @param[out] column First of the block's columns to fill
+	void FillColumns(size_t block, Column *column);
 
 public:
 	/// @brief Constructor
@@ -66,11 +95,12 @@ public:
 	/// @brief Render blank area
 	void RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style) override;
 
-	/// @brief Cleans up the cache
+	/// @brief Can every column of a range be drawn from the peak index?
+	bool CanRenderUndecoded(int start, int width) const override;
+
+	/// @brief Cleans up the column cache
 	/// @param max_size Maximum size in bytes for the cache
-	///
-	/// Does nothing for waveform renderer, since it does not have a backend cache
-	void AgeCache(size_t max_size) override { }
+	void AgeCache(size_t max_size) override;
 
 	/// Get a list of waveform rendering modes
 	static wxArrayString GetWaveformStyles();
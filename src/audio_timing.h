@@ -172,6 +172,12 @@ public:
 	/// @param snap_range   Maximum snapping range in milliseconds
 	virtual void OnMarkerDrag(std::vector<AudioMarker*> const& marker, int new_position, int snap_range) = 0;
 
+	/// @brief The user released the markers passed to OnMarkerDrag
+	///
+	/// Controllers which are expensive to commit can wait until this to do so
+	/// rather than committing on every drag event.
+	virtual void OnMarkerDragEnd() { }
+
 	/// @brief Destructor
 	virtual ~AudioTimingController() = default;
 
@@ -42,7 +42,9 @@
 #include <libaegisub/ass/time.h>
 #include <libaegisub/make_unique.h>
 
+#include <algorithm>
 #include <boost/range/algorithm.hpp>
+#include <unordered_set>
 #include <wx/pen.h>
 
 namespace {
@@ -314,6 +316,9 @@ class AudioTimingControllerDialogue final : public AudioTimingController {
 	/// Marker provider for seconds lines
 	SecondsMarkerProvider seconds_provider;
 
+	/// Marker provider for the edges of speech, which is only snapped to
+	SpeechBoundaryMarkerProvider speech_provider;
+
 	/// The set of lines which have been modified and need to have their
 	/// changes applied on commit
 	std::set<TimeableLine*> modified_lines;
@@ -355,6 +360,10 @@ class AudioTimingControllerDialogue final : public AudioTimingController {
 	/// Regenerate the list of active and inactive line markers
 	void RegenerateMarkers();
 
+	/// Sort the markers from first_unsorted on and merge them into the
+	/// already sorted markers before them
+	void MergeMarkers(size_t first_unsorted);
+
 	/// Get the start markers for the active line and all selected lines
 	std::vector<AudioMarker*> GetLeftMarkers();
 
@@ -380,6 +389,8 @@ class AudioTimingControllerDialogue final : public AudioTimingController {
 
 	// AssFile events
 	void OnFileChanged(int type);
+	/// Update the markers for lines whose times were changed by a commit
+	void UpdateChangedLines(std::vector<const AssDialogue *> const& changed);
 
 public:
 	// AudioMarkerProvider interface
@@ -416,6 +427,7 @@ AudioTimingControllerDialogue::AudioTimingControllerDialogue(agi::Context *c)
 : active_line(AudioStyle_Primary, &style_left, &style_right)
 , keyframes_provider(c, "Audio/Display/Draw/Keyframes in Dialogue Mode")
 , video_position_provider(c)
+, speech_provider(c)
 , context(c)
 , commit_connection(c->ass->AddCommitListener(&AudioTimingControllerDialogue::OnFileChanged, this))
 , inactive_line_mode_connection(OPT_SUB("Audio/Inactive Lines Display Mode", &AudioTimingControllerDialogue::RegenerateInactiveLines, this))
@@ -449,17 +461,108 @@ void AudioTimingControllerDialogue::GetMarkers(const TimeRange &range, AudioMark
 
 void AudioTimingControllerDialogue::OnSelectedSetChanged()
 {
-	RegenerateSelectedLines();
-	RegenerateInactiveLines();
+	// If the active line is changing too, Revert will regenerate everything
+	// once that's announced
+	AssDialogue *active = context->selectionController->GetActiveLine();
+	if (!active || active != active_line.GetLine())
+	{
+		RegenerateSelectedLines();
+		RegenerateInactiveLines();
+		return;
+	}
+
+	auto const& added = context->selectionController->GetAddedLines();
+	auto const& removed = context->selectionController->GetRemovedLines();
+
+	selected_lines.remove_if([&](TimeableLine const& line) {
+		return boost::binary_search(removed, line.GetLine());
+	});
+	std::vector<DialogueTimingMarker*> added_markers;
+	for (auto line : added)
+	{
+		if (line == active) continue;
+		selected_lines.emplace_back(AudioStyle_Selected, &style_inactive, &style_inactive);
+		selected_lines.back().SetLine(line);
+		selected_lines.back().GetMarkers(&added_markers);
+	}
+
+	// Lines which were deselected may have been deleted, so only lines which
+	// were selected can be moved between the lists without a rescan
+	if (inactive_line_mode->GetInt() == 3 && removed.empty())
+	{
+		// Rather than rebuilding and resorting all of the markers, drop the
+		// ones for the newly selected lines' inactive lines and merge in the
+		// ones for their selected lines
+		markers.erase(remove_if(markers.begin(), markers.end(), [&](DialogueTimingMarker *m) {
+			return m->GetLine() != &active_line
+				&& boost::binary_search(added, m->GetLine()->GetLine());
+		}), markers.end());
+		inactive_lines.remove_if([&](TimeableLine const& line) {
+			return boost::binary_search(added, line.GetLine());
+		});
+
+		size_t first_new = markers.size();
+		markers.insert(markers.end(), added_markers.begin(), added_markers.end());
+		MergeMarkers(first_new);
+
+		AnnounceUpdatedStyleRanges();
+		AnnounceMarkerMoved();
+	}
+	else
+		RegenerateInactiveLines();
 }
 
 void AudioTimingControllerDialogue::OnFileChanged(int type) {
-	if (type & AssFile::COMMIT_DIAG_TIME)
-		Revert();
+	if (type & AssFile::COMMIT_DIAG_TIME) {
+		auto const& changed = context->ass->ChangedLines();
+		if (changed.empty())
+			Revert();
+		else
+			UpdateChangedLines(changed);
+	}
 	else if (type & AssFile::COMMIT_DIAG_ADDREM)
 		RegenerateInactiveLines();
 }
 
+void AudioTimingControllerDialogue::UpdateChangedLines(std::vector<const AssDialogue *> const& changed)
+{
+	commit_id = -1;
+
+	std::unordered_set<const AssDialogue *> changed_set(changed.begin(), changed.end());
+	AssDialogue *line = context->selectionController->GetActiveLine();
+	if (line && changed_set.count(line))
+	{
+		modified_lines.clear();
+		if (active_line.SetLine(line))
+			AnnounceUpdatedPrimaryRange();
+		else
+			modified_lines.insert(&active_line);
+	}
+
+	// Only the times of the lines changed, so the set of lines shown doesn't
+	// change and just the ones which were changed need their markers updated
+	for (auto& timeable : inactive_lines)
+	{
+		if (changed_set.count(timeable.GetLine()))
+			timeable.SetLine(timeable.GetLine());
+	}
+	for (auto& timeable : selected_lines)
+	{
+		if (changed_set.count(timeable.GetLine()))
+			timeable.SetLine(timeable.GetLine());
+	}
+
+	// The markers of the lines which didn't change are still in order, so
+	// only the changed ones need sorting and merging back in
+	auto first_changed = std::stable_partition(markers.begin(), markers.end(), [&](DialogueTimingMarker *m) {
+		return !changed_set.count(m->GetLine()->GetLine());
+	});
+	MergeMarkers(first_changed - markers.begin());
+
+	AnnounceUpdatedStyleRanges();
+	AnnounceMarkerMoved();
+}
+
 void AudioTimingControllerDialogue::GetRenderingStyles(AudioRenderingStyleRanges &ranges) const
 {
 	active_line.GetStyleRange(&ranges);
@@ -503,20 +606,22 @@ void AudioTimingControllerDialogue::DoCommit(bool user_triggered)
 	// Store back new times
 	if (modified_lines.size())
 	{
+		std::vector<AssDialogue *> lines;
+		lines.reserve(modified_lines.size());
 		for (auto line : modified_lines)
+		{
 			line->Apply();
+			lines.push_back(line->GetLine());
+		}
 
 		commit_connection.Block();
 		if (user_triggered)
 		{
-			context->ass->Commit(_("timing"), AssFile::COMMIT_DIAG_TIME);
+			context->ass->Commit(_("timing"), AssFile::COMMIT_DIAG_TIME, -1, lines);
 			commit_id = -1; // never coalesce with a manually triggered commit
 		}
 		else
-		{
-			AssDialogue *amend = modified_lines.size() == 1 ? (*modified_lines.begin())->GetLine() : nullptr;
-			commit_id = context->ass->Commit(_("timing"), AssFile::COMMIT_DIAG_TIME, commit_id, amend);
-		}
+			commit_id = context->ass->Commit(_("timing"), AssFile::COMMIT_DIAG_TIME, commit_id, lines);
 
 		commit_connection.Unblock();
 		modified_lines.clear();
@@ -661,7 +766,7 @@ void AudioTimingControllerDialogue::SetMarkers(std::vector<AudioMarker*> const&
 
 	// Since we're moving markers, the sorted list of markers will need to be
 	// resorted. To avoid resorting the entire thing, find the subrange that
-	// is effected.
+	// is effected, including anywhere the markers might be snapped to.
 	int min_ms = ms;
 	int max_ms = ms;
 	for (AudioMarker *upd_marker : upd_markers)
@@ -677,8 +782,8 @@ void AudioTimingControllerDialogue::SetMarkers(std::vector<AudioMarker*> const&
 		}
 	}
 
-	auto begin = boost::lower_bound(markers, min_ms, marker_ptr_cmp());
-	auto end = upper_bound(begin, markers.end(), max_ms, marker_ptr_cmp());
+	auto begin = boost::lower_bound(markers, min_ms - std::max(snap_range, 0), marker_ptr_cmp());
+	auto end = upper_bound(begin, markers.end(), max_ms + std::max(snap_range, 0), marker_ptr_cmp());
 
 	// Update the markers
 	for (auto upd_marker : upd_markers)
@@ -688,13 +793,15 @@ void AudioTimingControllerDialogue::SetMarkers(std::vector<AudioMarker*> const&
 		modified_lines.insert(marker->GetLine());
 	}
 
+	// Snapping looks up the markers it could snap to in the sorted list, so
+	// the range has to be resorted first, and again if they were snapped
+	sort(begin, end, marker_ptr_cmp());
 	int snap = SnapMarkers(snap_range, upd_markers);
+	if (snap)
+		sort(begin, end, marker_ptr_cmp());
 	if (clicked_ms != INT_MIN)
 		clicked_ms += snap;
 
-	// Resort the range
-	sort(begin, end, marker_ptr_cmp());
-
 	if (auto_commit->GetBool()) DoCommit(false);
 	UpdateSelection();
 
@@ -805,6 +912,13 @@ void AudioTimingControllerDialogue::RegenerateMarkers()
 	AnnounceMarkerMoved();
 }
 
+void AudioTimingControllerDialogue::MergeMarkers(size_t first_unsorted)
+{
+	auto mid = markers.begin() + first_unsorted;
+	std::sort(mid, markers.end(), marker_ptr_cmp());
+	std::inplace_merge(markers.begin(), mid, markers.end(), marker_ptr_cmp());
+}
+
 std::vector<AudioMarker*> AudioTimingControllerDialogue::GetLeftMarkers()
 {
 	std::vector<AudioMarker*> ret;
@@ -842,40 +956,21 @@ int AudioTimingControllerDialogue::SnapMarkers(int snap_range, std::vector<Audio
 		return TimeRange{min - snap_range, max + snap_range};
 	}();
 
-	std::vector<int> inactive_markers;
-	inactive_markers.reserve(inactive_lines.size() * 2 + selected_lines.size() * 2 + 2 - active.size());
-
-	// Add a marker to the set to check for snaps if it's in the right time
-	// range, isn't at the same place as a marker already in the set, and isn't
-	// one of the markers being moved
-	auto add_inactive = [&](const DialogueTimingMarker *m, bool check)
-	{
-		if (!marker_range.contains(*m)) return;
-		if (!inactive_markers.empty() && inactive_markers.back() == *m) return;
-		if (check && boost::find(active, m) != end(active)) return;
-		inactive_markers.push_back(*m);
-	};
-
-	bool moving_entire_selection = clicked_ms != INT_MIN;
-	for (auto const& line : inactive_lines)
-	{
-		// If we're alt-dragging the entire selection, there can't be any
-		// markers from inactive lines in the active set, so no need to check
-		// for them
-		add_inactive(line.GetLeftMarker(), !moving_entire_selection);
-		add_inactive(line.GetRightMarker(), !moving_entire_selection);
-	}
+	std::vector<const DialogueTimingMarker *> sorted_active;
+	sorted_active.reserve(active.size());
+	for (auto m : active)
+		sorted_active.push_back(static_cast<const DialogueTimingMarker *>(m));
+	boost::sort(sorted_active);
 
-	// And similarly, there can't be any inactive markers from selected lines
-	if (!moving_entire_selection)
+	// Positions of the markers near enough to be snapped to which aren't being
+	// moved, without duplicates
+	std::vector<int> inactive_markers;
+	auto last = boost::lower_bound(markers, marker_range.end(), marker_ptr_cmp());
+	for (auto it = boost::lower_bound(markers, marker_range.begin(), marker_ptr_cmp()); it != last; ++it)
 	{
-		for (auto const& line : selected_lines)
-		{
-			add_inactive(line.GetLeftMarker(), true);
-			add_inactive(line.GetRightMarker(), true);
-		}
-		add_inactive(active_line.GetLeftMarker(), true);
-		add_inactive(active_line.GetRightMarker(), true);
+		if (!inactive_markers.empty() && inactive_markers.back() == **it) continue;
+		if (boost::binary_search(sorted_active, *it)) continue;
+		inactive_markers.push_back(**it);
 	}
 
 	int snap_distance = INT_MAX;
@@ -897,6 +992,7 @@ int AudioTimingControllerDialogue::SnapMarkers(int snap_range, std::vector<Audio
 		TimeRange range(pos - snap_range, pos + snap_range);
 		keyframes_provider.GetMarkers(range, snap_markers);
 		video_position_provider.GetMarkers(range, snap_markers);
+		speech_provider.GetMarkers(range, snap_markers);
 
 		for (const auto marker : snap_markers)
 		{
@@ -108,6 +108,10 @@ class AudioTimingControllerKaraoke final : public AudioTimingController {
 	bool auto_commit = OPT_GET("Audio/Auto/Commit")->GetBool();
 	int commit_id = -1;   ///< Last commit id used for an autocommit
 	bool pending_changes; ///< Are there any pending changes to be committed?
+	/// Are markers being dragged? Autocommits are held until the drag ends,
+	/// as regenerating the line's text and committing it on every mouse move
+	/// makes dragging on long lines jerky.
+	bool dragging = false;
 
 	void DoCommit();
 	void ApplyLead(bool announce_primary);
@@ -135,6 +139,7 @@ public:
 	std::vector<AudioMarker*> OnLeftClick(int ms, bool, bool, int sensitivity, int) override;
 	std::vector<AudioMarker*> OnRightClick(int ms, bool, int, int) override;
 	void OnMarkerDrag(std::vector<AudioMarker*> const& marker, int new_position, int) override;
+	void OnMarkerDragEnd() override;
 
 	AudioTimingControllerKaraoke(agi::Context *c, AssKaraoke *kara, agi::signal::Connection& file_changed);
 };
@@ -254,6 +259,7 @@ void AudioTimingControllerKaraoke::Revert() {
 	cur_syl = 0;
 	commit_id = -1;
 	pending_changes = false;
+	dragging = false;
 
 	start_marker.Move(active_line->Start);
 	end_marker.Move(active_line->End);
@@ -397,7 +403,9 @@ void AudioTimingControllerKaraoke::AnnounceChanges(int syl) {
 	AnnounceMarkerMoved();
 	AnnounceLabelChanged();
 
-	if (auto_commit)
+	if (dragging)
+		pending_changes = true;
+	else if (auto_commit)
 		DoCommit();
 	else {
 		pending_changes = true;
@@ -406,6 +414,7 @@ void AudioTimingControllerKaraoke::AnnounceChanges(int syl) {
 }
 
 void AudioTimingControllerKaraoke::OnMarkerDrag(std::vector<AudioMarker*> const& m, int new_position, int) {
+	dragging = true;
 	int old_position = m[0]->GetPosition();
 	int syl = MoveMarker(static_cast<KaraokeMarker *>(m[0]), new_position);
 	if (syl < 0) return;
@@ -420,6 +429,17 @@ void AudioTimingControllerKaraoke::OnMarkerDrag(std::vector<AudioMarker*> const&
 	AnnounceChanges(syl);
 }
 
+void AudioTimingControllerKaraoke::OnMarkerDragEnd() {
+	if (!dragging) return;
+	dragging = false;
+	if (!pending_changes) return;
+
+	if (auto_commit)
+		DoCommit();
+	else
+		commit_id = -1;
+}
+
 void AudioTimingControllerKaraoke::GetLabels(TimeRange const& range, std::vector<AudioLabel> &out) const {
 	copy(labels | boost::adaptors::filtered([&](AudioLabel const& l) {
 		return range.overlaps(l.range);
@@ -48,6 +48,8 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <future>
+#include <mutex>
+#include <unordered_map>
 
 #include <wx/dcmemory.h>
 #include <wx/log.h>
@@ -60,112 +62,207 @@
 #include <libaegisub/charset_conv_win.h>
 #endif
 
-namespace Automation4 {
-	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead)
-	{
-		width = height = descent = extlead = 0;
+namespace {
+	using Automation4::TextExtents;
 
-		double fontsize = style->fontsize * 64;
-		double spacing = style->spacing * 64;
+	/// A font set up for measuring text in a style
+	class FontMeasurer {
+		AssStyle *style;
+		double fontsize;
+		double spacing;
 
 #ifdef WIN32
-		// This is almost copypasta from TextSub
-		auto dc = CreateCompatibleDC(nullptr);
-		if (!dc) return false;
-
-		SetMapMode(dc, MM_TEXT);
-
-		LOGFONTW lf = {0};
-		lf.lfHeight = (LONG)fontsize;
-		lf.lfWeight = style->bold ? FW_BOLD : FW_NORMAL;
-		lf.lfItalic = style->italic;
-		lf.lfUnderline = style->underline;
-		lf.lfStrikeOut = style->strikeout;
-		lf.lfCharSet = style->encoding;
-		lf.lfOutPrecision = OUT_TT_PRECIS;
-		lf.lfClipPrecision = CLIP_DEFAULT_PRECIS;
-		lf.lfQuality = ANTIALIASED_QUALITY;
-		lf.lfPitchAndFamily = DEFAULT_PITCH|FF_DONTCARE;
-		wcsncpy(lf.lfFaceName, agi::charset::ConvertW(style->font).c_str(), 31);
-
-		auto font = CreateFontIndirect(&lf);
-		if (!font) return false;
-
-		auto old_font = SelectObject(dc, font);
-
-		std::wstring wtext(agi::charset::ConvertW(text));
-		if (spacing != 0 ) {
-			width = 0;
-			for (auto c : wtext) {
-				SIZE sz;
-				GetTextExtentPoint32(dc, &c, 1, &sz);
-				width += sz.cx + spacing;
-				height = sz.cy;
-			}
+		HDC dc = nullptr;
+		HFONT font = nullptr;
+		HGDIOBJ old_font = nullptr;
+#else
+		wxMemoryDC thedc;
+#endif
+
+	public:
+		FontMeasurer(AssStyle *style)
+		: style(style)
+		, fontsize(style->fontsize * 64)
+		, spacing(style->spacing * 64)
+		{
+#ifdef WIN32
+			// This is almost copypasta from TextSub
+			dc = CreateCompatibleDC(nullptr);
+			if (!dc) return;
+
+			SetMapMode(dc, MM_TEXT);
+
+			LOGFONTW lf = {0};
+			lf.lfHeight = (LONG)fontsize;
+			lf.lfWeight = style->bold ? FW_BOLD : FW_NORMAL;
+			lf.lfItalic = style->italic;
+			lf.lfUnderline = style->underline;
+			lf.lfStrikeOut = style->strikeout;
+			lf.lfCharSet = style->encoding;
+			lf.lfOutPrecision = OUT_TT_PRECIS;
+			lf.lfClipPrecision = CLIP_DEFAULT_PRECIS;
+			lf.lfQuality = ANTIALIASED_QUALITY;
+			lf.lfPitchAndFamily = DEFAULT_PITCH|FF_DONTCARE;
+			wcsncpy(lf.lfFaceName, agi::charset::ConvertW(style->font).c_str(), 31);
+
+			font = CreateFontIndirect(&lf);
+			if (!font) return;
+
+			old_font = SelectObject(dc, font);
+#else
+			// fix fontsize to be 72 DPI
+			//fontsize = -FT_MulDiv((int)(fontsize+0.5), 72, thedc.GetPPI().y);
+
+			// now try to get a font!
+			// use the font list to get some caching... (chance is the script will need the same font very often)
+			// USING wxTheFontList SEEMS TO CAUSE BAD LEAKS!
+			//wxFont *thefont = wxTheFontList->FindOrCreateFont(
+			wxFont thefont(
+				(int)fontsize,
+				wxFONTFAMILY_DEFAULT,
+				style->italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
+				style->bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
+				style->underline,
+				to_wx(style->font),
+				wxFONTENCODING_SYSTEM); // FIXME! make sure to get the right encoding here, make some translation table between windows and wx encodings
+			thedc.SetFont(thefont);
+#endif
 		}
-		else {
-			SIZE sz;
-			GetTextExtentPoint32(dc, &wtext[0], (int)wtext.size(), &sz);
-			width = sz.cx;
-			height = sz.cy;
+
+		~FontMeasurer() {
+#ifdef WIN32
+			if (old_font) SelectObject(dc, old_font);
+			if (font) DeleteObject(font);
+			if (dc) DeleteObject(dc);
+#endif
 		}
 
-		TEXTMETRIC tm;
-		GetTextMetrics(dc, &tm);
-		descent = tm.tmDescent;
-		extlead = tm.tmExternalLeading;
+		bool Measure(std::string const& text, TextExtents &extents) {
+			double width = 0, height = 0, descent = 0, extlead = 0;
 
-		SelectObject(dc, old_font);
-		DeleteObject(font);
-		DeleteObject(dc);
+#ifdef WIN32
+			if (!font) return false;
+
+			std::wstring wtext(agi::charset::ConvertW(text));
+			if (spacing != 0 ) {
+				width = 0;
+				for (auto c : wtext) {
+					SIZE sz;
+					GetTextExtentPoint32(dc, &c, 1, &sz);
+					width += sz.cx + spacing;
+					height = sz.cy;
+				}
+			}
+			else {
+				SIZE sz;
+				GetTextExtentPoint32(dc, &wtext[0], (int)wtext.size(), &sz);
+				width = sz.cx;
+				height = sz.cy;
+			}
 
+			TEXTMETRIC tm;
+			GetTextMetrics(dc, &tm);
+			descent = tm.tmDescent;
+			extlead = tm.tmExternalLeading;
 #else // not WIN32
-		wxMemoryDC thedc;
+			wxString wtext(to_wx(text));
+			if (spacing) {
+				// If there's inter-character spacing, kerning info must not be used, so calculate width per character
+				// NOTE: Is kerning actually done either way?!
+				for (auto const& wc : wtext) {
+					int a, b, c, d;
+					thedc.GetTextExtent(wc, &a, &b, &c, &d);
+					double scaling = fontsize / (double)(b > 0 ? b : 1); // semi-workaround for missing OS/2 table data for scaling
+					width += (a + spacing)*scaling;
+					height = b > height ? b*scaling : height;
+					descent = c > descent ? c*scaling : descent;
+					extlead = d > extlead ? d*scaling : extlead;
+				}
+			} else {
+				// If the inter-character spacing should be zero, kerning info can (and must) be used, so calculate everything in one go
+				wxCoord lwidth, lheight, ldescent, lextlead;
+				thedc.GetTextExtent(wtext, &lwidth, &lheight, &ldescent, &lextlead);
+				double scaling = fontsize / (double)(lheight > 0 ? lheight : 1); // semi-workaround for missing OS/2 table data for scaling
+				width = lwidth*scaling; height = lheight*scaling; descent = ldescent*scaling; extlead = lextlead*scaling;
+			}
+#endif
+
+			// Compensate for scaling
+			extents.width = style->scalex / 100 * width / 64;
+			extents.height = style->scaley / 100 * height / 64;
+			extents.descent = style->scaley / 100 * descent / 64;
+			extents.extlead = style->scaley / 100 * extlead / 64;
 
-		// fix fontsize to be 72 DPI
-		//fontsize = -FT_MulDiv((int)(fontsize+0.5), 72, thedc.GetPPI().y);
-
-		// now try to get a font!
-		// use the font list to get some caching... (chance is the script will need the same font very often)
-		// USING wxTheFontList SEEMS TO CAUSE BAD LEAKS!
-		//wxFont *thefont = wxTheFontList->FindOrCreateFont(
-		wxFont thefont(
-			(int)fontsize,
-			wxFONTFAMILY_DEFAULT,
-			style->italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
-			style->bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
-			style->underline,
-			to_wx(style->font),
-			wxFONTENCODING_SYSTEM); // FIXME! make sure to get the right encoding here, make some translation table between windows and wx encodings
-		thedc.SetFont(thefont);
-
-		wxString wtext(to_wx(text));
-		if (spacing) {
-			// If there's inter-character spacing, kerning info must not be used, so calculate width per character
-			// NOTE: Is kerning actually done either way?!
-			for (auto const& wc : wtext) {
-				int a, b, c, d;
-				thedc.GetTextExtent(wc, &a, &b, &c, &d);
-				double scaling = fontsize / (double)(b > 0 ? b : 1); // semi-workaround for missing OS/2 table data for scaling
-				width += (a + spacing)*scaling;
-				height = b > height ? b*scaling : height;
-				descent = c > descent ? c*scaling : descent;
-				extlead = d > extlead ? d*scaling : extlead;
+			return true;
+		}
+	};
+
+	/// Maximum number of cached extents before the cache is emptied
+	const size_t max_cached_extents = 1 << 18;
+
+	/// Extents of text which has already been measured, keyed by the font
+	/// parameters of the style followed by the text. Automation scripts such
+	/// as karaskel measure the same syllables over and over again.
+	std::unordered_map<std::string, TextExtents> extents_cache;
+	std::mutex extents_cache_mutex;
+	/// Fonts are only set up and measured on one thread at a time, as
+	/// automation scripts can measure text from several threads at once
+	std::mutex measure_mutex;
+
+	/// Get the part of the cache key for the style's font parameters
+	std::string font_key(AssStyle const& style) {
+		return agi::format("%s\x1F%g\x1F%d%d%d%d\x1F%d\x1F%g\x1F%g\x1F%g\x1F",
+			style.font, style.fontsize, style.bold, style.italic, style.underline,
+			style.strikeout, style.encoding, style.spacing, style.scalex, style.scaley);
+	}
+}
+
+namespace Automation4 {
+	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead)
+	{
+		std::vector<TextExtents> extents;
+		bool ok = CalculateTextExtents(style, std::vector<std::string>{text}, extents);
+		width = extents[0].width;
+		height = extents[0].height;
+		descent = extents[0].descent;
+		extlead = extents[0].extlead;
+		return ok;
+	}
+
+	bool CalculateTextExtents(AssStyle *style, std::vector<std::string> const& texts, std::vector<TextExtents> &extents)
+	{
+		extents.assign(texts.size(), TextExtents());
+
+		const std::string key_prefix = font_key(*style);
+		std::vector<size_t> unmeasured;
+		{
+			std::lock_guard<std::mutex> lock(extents_cache_mutex);
+			for (size_t i = 0; i < texts.size(); ++i) {
+				auto it = extents_cache.find(key_prefix + texts[i]);
+				if (it != extents_cache.end())
+					extents[i] = it->second;
+				else
+					unmeasured.push_back(i);
+			}
+		}
+		if (unmeasured.empty()) return true;
+
+		// The font is only set up once for all of the text which wasn't
+		// already in the cache
+		{
+			std::lock_guard<std::mutex> lock(measure_mutex);
+			FontMeasurer measurer(style);
+			for (auto i : unmeasured) {
+				if (!measurer.Measure(texts[i], extents[i]))
+					return false;
 			}
-		} else {
-			// If the inter-character spacing should be zero, kerning info can (and must) be used, so calculate everything in one go
-			wxCoord lwidth, lheight, ldescent, lextlead;
-			thedc.GetTextExtent(wtext, &lwidth, &lheight, &ldescent, &lextlead);
-			double scaling = fontsize / (double)(lheight > 0 ? lheight : 1); // semi-workaround for missing OS/2 table data for scaling
-			width = lwidth*scaling; height = lheight*scaling; descent = ldescent*scaling; extlead = lextlead*scaling;
 		}
-#endif
 
-		// Compensate for scaling
-		width = style->scalex / 100 * width / 64;
-		height = style->scaley / 100 * height / 64;
-		descent = style->scaley / 100 * descent / 64;
-		extlead = style->scaley / 100 * extlead / 64;
+		std::lock_guard<std::mutex> lock(extents_cache_mutex);
+		if (extents_cache.size() + unmeasured.size() > max_cached_extents)
+			extents_cache.clear();
+		for (auto i : unmeasured)
+			extents_cache[key_prefix + texts[i]] = extents[i];
 
 		return true;
 	}
@@ -208,6 +305,7 @@ namespace Automation4 {
 
 	void ProgressSink::ShowDialog(ScriptDialog *config_dialog)
 	{
+		if (!CanShowDialogs()) return;
 		agi::dispatch::Main().Sync([=] {
 			wxDialog w; // container dialog box
 			w.SetExtraStyle(wxWS_EX_VALIDATE_RECURSIVELY);
@@ -223,14 +321,42 @@ namespace Automation4 {
 
 	int ProgressSink::ShowDialog(wxDialog *dialog)
 	{
+		if (!CanShowDialogs()) return wxID_CANCEL;
 		int ret = 0;
 		agi::dispatch::Main().Sync([&] { ret = dialog->ShowModal(); });
 		return ret;
 	}
 
+	// HeadlessScope
+	namespace {
+		thread_local agi::BackgroundRunner *headless_runner = nullptr;
+	}
+
+	HeadlessScope::HeadlessScope(agi::BackgroundRunner *br)
+	: prev(headless_runner)
+	{
+		headless_runner = br;
+	}
+
+	HeadlessScope::~HeadlessScope()
+	{
+		headless_runner = prev;
+	}
+
+	agi::BackgroundRunner *HeadlessScope::Runner()
+	{
+		return headless_runner;
+	}
+
+	// BackgroundScriptRunner
 	BackgroundScriptRunner::BackgroundScriptRunner(wxWindow *parent, std::string const& title)
-	: impl(new DialogProgress(parent, to_wx(title)))
+	: impl(HeadlessScope::Runner())
+	, title(title)
 	{
+		if (!impl) {
+			dialog = agi::make_unique<DialogProgress>(parent, to_wx(title));
+			impl = dialog.get();
+		}
 	}
 
 	BackgroundScriptRunner::~BackgroundScriptRunner()
@@ -240,6 +366,8 @@ namespace Automation4 {
 	void BackgroundScriptRunner::Run(std::function<void (ProgressSink*)> task)
 	{
 		impl->Run([&](agi::ProgressSink *ps) {
+			// The dialog already shows the title
+			if (!dialog) ps->SetTitle(title);
 			ProgressSink aps(ps, this);
 			task(&aps);
 		});
@@ -247,12 +375,12 @@ namespace Automation4 {
 
 	wxWindow *BackgroundScriptRunner::GetParentWindow() const
 	{
-		return impl.get();
+		return dialog.get();
 	}
 
 	std::string BackgroundScriptRunner::GetTitle() const
 	{
-		return from_wx(impl->GetTitle());
+		return title;
 	}
 
 	// Script
@@ -293,6 +421,15 @@ namespace Automation4 {
 		ScriptsChanged();
 	}
 
+	std::unique_ptr<Script> ScriptManager::TakeUnmodified(std::vector<std::unique_ptr<Script>>& from, agi::fs::path const& filename)
+	{
+		for (auto& script : from) {
+			if (script && script->GetFilename() == filename && script->GetLoadedState() && !script->IsModified())
+				return std::move(script);
+		}
+		return nullptr;
+	}
+
 	void ScriptManager::Reload(Script *script)
 	{
 		script->Reload();
@@ -310,31 +447,93 @@ namespace Automation4 {
 	}
 
 	// AutoloadScriptManager
+	struct AutoloadScriptManager::PendingLoad {
+		/// The manager to add the scripts to, or nullptr if they've already
+		/// been added or the manager is gone
+		AutoloadScriptManager *owner;
+		std::vector<agi::fs::path> files;
+		/// Scripts kept from the previous load, indexed like files
+		std::vector<std::unique_ptr<Script>> kept;
+		std::vector<std::future<std::unique_ptr<Script>>> script_futures;
+	};
+
 	AutoloadScriptManager::AutoloadScriptManager(std::string path)
 	: path(std::move(path))
+	, pending(StartLoad())
 	{
-		Reload();
+		// Nothing needs the scripts for the main window to open, so rather
+		// than blocking startup on them, wait for them on a worker and add
+		// them from the main thread once they're done
+		auto load = pending;
+		agi::dispatch::Background().Async([=] {
+			for (auto& future : load->script_futures) {
+				if (future.valid()) future.wait();
+			}
+			agi::dispatch::Main().Async([=] {
+				if (load->owner) load->owner->WaitForLoad();
+			});
+		});
+	}
+
+	AutoloadScriptManager::~AutoloadScriptManager()
+	{
+		if (pending) pending->owner = nullptr;
+	}
+
+	void AutoloadScriptManager::WaitForLoad()
+	{
+		if (!pending) return;
+		auto load = std::move(pending);
+		load->owner = nullptr;
+		FinishLoad(*load);
 	}
 
 	void AutoloadScriptManager::Reload()
 	{
-		scripts.clear();
+		WaitForLoad();
+		FinishLoad(*StartLoad());
+	}
 
-		std::vector<std::future<std::unique_ptr<Script>>> script_futures;
+	std::shared_ptr<AutoloadScriptManager::PendingLoad> AutoloadScriptManager::StartLoad()
+	{
+		auto load = std::make_shared<PendingLoad>();
+		load->owner = this;
+
+		auto old_scripts = std::move(scripts);
+		scripts.clear();
 
 		for (auto tok : agi::Split(path, '|')) {
 			auto dirname = config::path->Decode(agi::str(tok));
 			if (!agi::fs::DirectoryExists(dirname)) continue;
 
 			for (auto filename : agi::fs::DirectoryIterator(dirname, "*.*"))
-				script_futures.emplace_back(std::async(std::launch::async, [=] {
-					return ScriptFactory::CreateFromFile(dirname/filename, false, false);
-				}));
+				load->files.push_back(dirname/filename);
 		}
 
+		// Keep the already-loaded state of scripts which haven't changed, and
+		// get rid of the rest before loading their replacements so that their
+		// macros are unregistered first
+		for (auto const& file : load->files)
+			load->kept.emplace_back(TakeUnmodified(old_scripts, file));
+		old_scripts.clear();
+
+		load->script_futures.resize(load->files.size());
+		for (size_t i = 0; i < load->files.size(); ++i) {
+			if (load->kept[i]) continue;
+			auto filename = load->files[i];
+			load->script_futures[i] = std::async(std::launch::async, [=] {
+				return ScriptFactory::CreateFromFile(filename, false, false);
+			});
+		}
+
+		return load;
+	}
+
+	void AutoloadScriptManager::FinishLoad(PendingLoad& load)
+	{
 		int error_count = 0;
-		for (auto& future : script_futures) {
-			auto s = future.get();
+		for (size_t i = 0; i < load.files.size(); ++i) {
+			auto s = load.kept[i] ? std::move(load.kept[i]) : load.script_futures[i].get();
 			if (s) {
 				if (!s->GetLoadedState()) ++error_count;
 				scripts.emplace_back(std::move(s));
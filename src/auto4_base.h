@@ -58,8 +58,23 @@ namespace Automation4 {
 	DEFINE_EXCEPTION(ScriptLoadError, AutomationError);
 	DEFINE_EXCEPTION(MacroRunError, AutomationError);
 
+	/// Size of a piece of text in script pixels
+	struct TextExtents {
+		double width = 0;
+		double height = 0;
+		double descent = 0;
+		double extlead = 0;
+	};
+
 	// Calculate the extents of a text string given a style
 	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead);
+	/// Calculate the extents of several strings in one style, setting up the
+	/// font only once for all of them
+	/// @param style Style to measure the text in
+	/// @param texts Strings to measure
+	/// @param[out] extents Extents of each string
+	/// @return false if the font couldn't be set up
+	bool CalculateTextExtents(AssStyle *style, std::vector<std::string> const& texts, std::vector<TextExtents> &extents);
 
 	class ScriptDialog;
 
@@ -102,8 +117,32 @@ namespace Automation4 {
 
 	class ProgressSink;
 
+	/// @class HeadlessScope
+	/// @brief Run scripts without any windows on the calling thread
+	///
+	/// While one of these exists, scripts created on the thread keep their
+	/// macros and export filters to themselves rather than registering them
+	/// with the rest of the program, so that several copies of a script can
+	/// be loaded at once, and their background tasks are run with the given
+	/// runner rather than in a progress dialog. Any dialogs the scripts try
+	/// to open are treated as cancelled.
+	class HeadlessScope {
+		agi::BackgroundRunner *prev;
+
+	public:
+		HeadlessScope(agi::BackgroundRunner *br);
+		~HeadlessScope();
+
+		/// Get the runner for the calling thread, or nullptr if there's no
+		/// HeadlessScope on it
+		static agi::BackgroundRunner *Runner();
+	};
+
 	class BackgroundScriptRunner {
-		std::unique_ptr<DialogProgress> impl;
+		/// Progress dialog, or nullptr if running headless
+		std::unique_ptr<DialogProgress> dialog;
+		agi::BackgroundRunner *impl;
+		std::string title;
 
 	public:
 		wxWindow *GetParentWindow() const;
@@ -134,6 +173,8 @@ namespace Automation4 {
 		void ShowDialog(ScriptDialog *config_dialog);
 		int ShowDialog(wxDialog *dialog);
 		wxWindow *GetParentWindow() const { return bsr->GetParentWindow(); }
+		/// Can the script open dialogs, or is it running headless?
+		bool CanShowDialogs() const { return !!bsr->GetParentWindow(); }
 
 		/// Get the current automation trace level
 		int GetTraceLevel() const { return trace_level; }
@@ -170,6 +211,9 @@ namespace Automation4 {
 		virtual std::string GetVersion() const=0;
 		/// Did the script load correctly?
 		virtual bool GetLoadedState() const=0;
+		/// Has the script changed on disk since it was loaded? Scripts which
+		/// can't tell are always considered modified.
+		virtual bool IsModified() const { return true; }
 
 		/// Get a list of commands provided by this script
 		virtual std::vector<cmd::Command*> GetMacros() const=0;
@@ -185,6 +229,11 @@ namespace Automation4 {
 
 		agi::signal::Signal<> ScriptsChanged;
 
+		/// Take the script for a file out of a list of scripts if it loaded
+		/// and hasn't been modified since, so that it can be kept rather
+		/// than loaded again
+		static std::unique_ptr<Script> TakeUnmodified(std::vector<std::unique_ptr<Script>>& from, agi::fs::path const& filename);
+
 	public:
 		/// Deletes all scripts managed
 		virtual ~ScriptManager() = default;
@@ -223,9 +272,27 @@ namespace Automation4 {
 	/// Manager for scripts in the autoload directory
 	class AutoloadScriptManager final : public ScriptManager {
 		std::string path;
+
+		/// Scripts which are being loaded in the background
+		struct PendingLoad;
+		std::shared_ptr<PendingLoad> pending;
+
+		/// Start loading the scripts in the autoload directories
+		std::shared_ptr<PendingLoad> StartLoad();
+		/// Wait for the scripts from a load and add them
+		void FinishLoad(PendingLoad& load);
+
 	public:
+		/// Starts loading the scripts in the background; they're added once
+		/// the main loop is running and all of them have loaded
 		AutoloadScriptManager(std::string path);
+		~AutoloadScriptManager();
 		void Reload() override;
+
+		/// Is the initial load of the scripts still running?
+		bool IsLoading() const { return !!pending; }
+		/// Wait for the initial load of the scripts to finish, if it hasn't
+		void WaitForLoad();
 	};
 
 	/// Both a base class for script factories and a manager of registered
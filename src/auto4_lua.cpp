@@ -51,28 +51,45 @@
 #include "selection_controller.h"
 #include "subs_controller.h"
 #include "video_controller.h"
+#include "video_frame.h"
 #include "utils.h"
 
+#include <libaegisub/audio/peak_index.h>
+#include <libaegisub/audio/provider.h>
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
 #include <libaegisub/lua/ffi.h>
 #include <libaegisub/lua/modules.h>
 #include <libaegisub/lua/script_reader.h>
 #include <libaegisub/lua/utils.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
 #include <libaegisub/path.h>
 
 #include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/replace.hpp>
 #include <boost/scope_exit.hpp>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <wx/clipbrd.h>
 #include <wx/log.h>
 #include <wx/msgdlg.h>
 
+namespace agi {
+	template<> struct type_name<agi::vfr::Framerate> {
+		static const char *name() { return "agi_framerate"; }
+	};
+}
+
 using namespace agi::lua;
 using namespace Automation4;
 
@@ -182,6 +199,48 @@ namespace {
 		return 1;
 	}
 
+	/// Push a copy of the project's timecodes for the aegisub.frames module,
+	/// or nil if there aren't any
+	int get_timecodes(lua_State *L)
+	{
+		const agi::Context *c = get_context(L);
+		if (!c || !c->project->Timecodes().IsLoaded()) {
+			lua_pushnil(L);
+			return 1;
+		}
+
+		auto fps = static_cast<agi::vfr::Framerate *>(lua_newuserdata(L, sizeof(agi::vfr::Framerate)));
+		new (fps) agi::vfr::Framerate(c->project->Timecodes());
+
+		lua_createtable(L, 0, 1);
+		lua_pushcfunction(L, [](lua_State *L) -> int {
+			static_cast<agi::vfr::Framerate *>(lua_touserdata(L, 1))->~Framerate();
+			return 0;
+		});
+		lua_setfield(L, -2, "__gc");
+		lua_setmetatable(L, -2);
+		return 1;
+	}
+
+	// Batch versions of frame_from_ms and ms_from_frame for the FFI
+	void frames_from_ms(agi::vfr::Framerate const& fps, const int *ms, int *frames, size_t count)
+	{
+		fps.FramesAtTimes(ms, frames, count, agi::vfr::START);
+	}
+
+	void ms_from_frames(agi::vfr::Framerate const& fps, const int *frames, int *ms, size_t count)
+	{
+		fps.TimesAtFrames(frames, ms, count, agi::vfr::START);
+	}
+
+	int init_frames_lib(lua_State *L)
+	{
+		register_lib_table(L, {"agi_framerate"},
+			"frames_from_ms", frames_from_ms,
+			"ms_from_frames", ms_from_frames);
+		return 1;
+	}
+
 	int video_size(lua_State *L)
 	{
 		const agi::Context *c = get_context(L);
@@ -199,6 +258,99 @@ namespace {
 		}
 	}
 
+	/// @brief Get a decoded video frame for the aegisub.video module
+	///
+	/// Arguments are the frame number, whether to include subtitles, and
+	/// optionally the x, y, width and height of the region to get and an
+	/// integer factor to shrink it by. Returns a userdata which keeps the
+	/// frame alive, a pointer to the first BGRA pixel of the region, its
+	/// width and height, and the number of bytes from one row to the next,
+	/// which is negative for frames which are stored bottom-up. The pixels
+	/// are only copied if the frame has to be converted or shrunk.
+	int get_video_frame(lua_State *L)
+	{
+		const agi::Context *c = get_context(L);
+		AsyncVideoProvider *provider = c ? c->project->VideoProvider() : nullptr;
+		if (!provider) {
+			lua_pushnil(L);
+			return 1;
+		}
+
+		int n = check_int(L, 1);
+		argcheck(L, n >= 0 && n < provider->GetFrameCount(), 1, "frame number out of range");
+		bool subtitles = !!lua_toboolean(L, 2);
+		int scale = luaL_optinteger(L, 7, 1);
+		argcheck(L, scale >= 1, 7, "scale must be at least 1");
+
+		std::shared_ptr<const VideoFrame> frame = provider->GetFrame(n, c->project->Timecodes().TimeAtFrame(n), !subtitles);
+		if (frame->format != VideoFrameFormat::BGRA) {
+			auto bgra = std::make_shared<VideoFrame>();
+			ConvertToBGRA(*frame, *bgra);
+			frame = bgra;
+		}
+
+		const int width = frame->width, height = frame->height;
+		int x = mid<int>(0, luaL_optinteger(L, 3, 0), width);
+		int y = mid<int>(0, luaL_optinteger(L, 4, 0), height);
+		int w = mid<int>(0, luaL_optinteger(L, 5, width), width - x);
+		int h = mid<int>(0, luaL_optinteger(L, 6, height), height - y);
+		argcheck(L, w >= scale && h >= scale, 5, "region is smaller than the scale");
+
+		// Rows which are displayed from the top down
+		ptrdiff_t pitch = frame->flipped ? -(ptrdiff_t)frame->pitch : (ptrdiff_t)frame->pitch;
+		const unsigned char *first = frame->data.data() + x * 4
+			+ (frame->flipped ? frame->height - 1 - y : y) * frame->pitch;
+
+		if (scale > 1) {
+			// Average each scale x scale block of pixels
+			auto scaled = std::make_shared<VideoFrame>();
+			scaled->width = w / scale;
+			scaled->height = h / scale;
+			scaled->pitch = scaled->width * 4;
+			scaled->flipped = false;
+			scaled->data.resize(scaled->pitch * scaled->height);
+
+			const int area = scale * scale;
+			for (size_t sy = 0; sy < scaled->height; ++sy) {
+				unsigned char *dst = &scaled->data[sy * scaled->pitch];
+				for (size_t sx = 0; sx < scaled->width; ++sx) {
+					int sums[4] = {0, 0, 0, 0};
+					for (int by = 0; by < scale; ++by) {
+						const unsigned char *src = first + (sy * scale + by) * pitch + sx * scale * 4;
+						for (int bx = 0; bx < scale * 4; ++bx)
+							sums[bx & 3] += src[bx];
+					}
+					for (int ch = 0; ch < 4; ++ch)
+						*dst++ = (unsigned char)((sums[ch] + area / 2) / area);
+				}
+			}
+
+			frame = scaled;
+			first = scaled->data.data();
+			pitch = scaled->pitch;
+			w = scaled->width;
+			h = scaled->height;
+		}
+
+		typedef std::shared_ptr<const VideoFrame> FramePtr;
+		auto holder = static_cast<FramePtr *>(lua_newuserdata(L, sizeof(FramePtr)));
+		new (holder) FramePtr(std::move(frame));
+
+		lua_createtable(L, 0, 1);
+		lua_pushcfunction(L, [](lua_State *L) -> int {
+			static_cast<FramePtr *>(lua_touserdata(L, 1))->~FramePtr();
+			return 0;
+		});
+		lua_setfield(L, -2, "__gc");
+		lua_setmetatable(L, -2);
+
+		push_value(L, const_cast<unsigned char *>(first));
+		push_value(L, w);
+		push_value(L, h);
+		push_value(L, (int)pitch);
+		return 5;
+	}
+
 	int get_keyframes(lua_State *L)
 	{
 		if (const agi::Context *c = get_context(L))
@@ -208,6 +360,220 @@ namespace {
 		return 1;
 	}
 
+	const agi::AudioPeakIndex *get_peak_index(lua_State *L)
+	{
+		const agi::Context *c = get_context(L);
+		if (!c || !c->project->AudioProvider()) return nullptr;
+		return c->project->AudioProvider()->GetPeakIndex();
+	}
+
+	int audio_envelope(lua_State *L)
+	{
+		int start = std::max(0, check_int(L, 1));
+		int end = check_int(L, 2);
+		auto peaks = get_peak_index(L);
+		std::vector<agi::AudioEnvelopeFrame> frames;
+		if (peaks && end >= start) {
+			int first = start / agi::AudioPeakIndex::EnvelopeFrameMs;
+			int last = std::min<int>(end / agi::AudioPeakIndex::EnvelopeFrameMs, peaks->GetEnvelopeFrames() - 1);
+			if (first > last || !peaks->GetEnvelope(first, last - first + 1, frames))
+				peaks = nullptr;
+		}
+		if (!peaks) {
+			lua_pushnil(L);
+			return 1;
+		}
+
+		std::vector<double> levels, crossings;
+		levels.reserve(frames.size());
+		crossings.reserve(frames.size());
+		for (auto const& frame : frames) {
+			levels.push_back(frame.level);
+			crossings.push_back(frame.zero_crossings);
+		}
+		push_value(L, levels);
+		push_value(L, crossings);
+		push_value(L, (int)agi::AudioPeakIndex::EnvelopeFrameMs);
+		return 3;
+	}
+
+	int speech_boundaries(lua_State *L)
+	{
+		int start = check_int(L, 1);
+		int end = check_int(L, 2);
+		auto peaks = get_peak_index(L);
+		std::vector<agi::SpeechBoundary> boundaries;
+		if (!peaks || !peaks->GetSpeechBoundaries(start, end, boundaries)) {
+			lua_pushnil(L);
+			return 1;
+		}
+
+		lua_createtable(L, boundaries.size(), 0);
+		for (size_t i = 0; i < boundaries.size(); ++i) {
+			lua_createtable(L, 0, 2);
+			set_field(L, "time", boundaries[i].time);
+			set_field(L, "onset", boundaries[i].onset);
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 1;
+	}
+
+	/// @brief Push a buffer for the aegisub.audio module to fill
+	///
+	/// Reuses the buffer at idx if it's one which was previously returned and
+	/// is big enough, so that scripts reading audio in chunks don't allocate
+	/// a new buffer for every chunk.
+	void *push_audio_buffer(lua_State *L, int idx, size_t size)
+	{
+		if (lua_type(L, idx) == LUA_TUSERDATA && lua_getmetatable(L, idx)) {
+			luaL_getmetatable(L, "aegisub.audio_buffer");
+			bool ours = !!lua_rawequal(L, -1, -2);
+			lua_pop(L, 2);
+			if (ours && lua_objlen(L, idx) >= size) {
+				lua_pushvalue(L, idx);
+				return lua_touserdata(L, idx);
+			}
+		}
+
+		void *buf = lua_newuserdata(L, std::max<size_t>(size, 1));
+		luaL_newmetatable(L, "aegisub.audio_buffer");
+		lua_setmetatable(L, -2);
+		return buf;
+	}
+
+	/// Get the project's audio provider, which is always 16-bit mono
+	const agi::AudioProvider *get_audio_provider(lua_State *L)
+	{
+		const agi::Context *c = get_context(L);
+		auto provider = c ? c->project->AudioProvider() : nullptr;
+		if (!provider || provider->GetBytesPerSample() != 2 || provider->GetChannels() != 1 || provider->AreSamplesFloat())
+			return nullptr;
+		return provider;
+	}
+
+	int audio_info(lua_State *L)
+	{
+		auto provider = get_audio_provider(L);
+		if (!provider) {
+			lua_pushnil(L);
+			return 1;
+		}
+		push_value(L, provider->GetSampleRate());
+		push_value(L, (double)provider->GetNumSamples());
+		push_value(L, (double)provider->GetDecodedSamples());
+		return 3;
+	}
+
+	/// @brief Read samples into a buffer for the aegisub.audio module
+	///
+	/// Arguments are the first sample, the number of samples, and optionally
+	/// a buffer to reuse. Returns the buffer, the number of int16_t samples
+	/// put in it, and whether they've all been decoded yet.
+	int audio_samples(lua_State *L)
+	{
+		auto provider = get_audio_provider(L);
+		if (!provider) {
+			lua_pushnil(L);
+			return 1;
+		}
+
+		int64_t start = static_cast<int64_t>(luaL_checknumber(L, 1));
+		int64_t count = static_cast<int64_t>(luaL_checknumber(L, 2));
+		argcheck(L, start >= 0, 1, "start must not be negative");
+		argcheck(L, count >= 0, 2, "count must not be negative");
+		count = std::max<int64_t>(0, std::min(count, provider->GetNumSamples() - start));
+
+		auto buf = push_audio_buffer(L, 3, count * sizeof(int16_t));
+		if (count)
+			provider->GetAudio(buf, start, count);
+		push_value(L, (double)count);
+		push_value(L, provider->IsDecoded(start, count));
+		return 3;
+	}
+
+	/// @brief Get the peaks of consecutive blocks of audio
+	///
+	/// Arguments are the first sample, the number of samples, the number of
+	/// samples per block, and optionally a buffer to reuse. Returns the buffer
+	/// and the number of agi::AudioPeak in it. Blocks which are long enough
+	/// are looked up in the peak index; the rest are read from the samples.
+	int audio_peaks(lua_State *L)
+	{
+		auto provider = get_audio_provider(L);
+		if (!provider) {
+			lua_pushnil(L);
+			return 1;
+		}
+
+		int64_t start = static_cast<int64_t>(luaL_checknumber(L, 1));
+		int64_t count = static_cast<int64_t>(luaL_checknumber(L, 2));
+		int64_t block = static_cast<int64_t>(luaL_checknumber(L, 3));
+		argcheck(L, start >= 0, 1, "start must not be negative");
+		argcheck(L, count >= 0, 2, "count must not be negative");
+		argcheck(L, block > 0, 3, "block size must be positive");
+		count = std::max<int64_t>(0, std::min(count, provider->GetNumSamples() - start));
+
+		const int64_t blocks = (count + block - 1) / block;
+		auto peaks = static_cast<agi::AudioPeak *>(push_audio_buffer(L, 4, blocks * sizeof(agi::AudioPeak)));
+		auto index = provider->GetPeakIndex();
+
+		std::vector<int16_t> scratch;
+		for (int64_t i = 0; i < blocks; ++i) {
+			const int64_t first = start + i * block;
+			const int64_t len = std::min(block, start + count - first);
+			agi::AudioPeak &peak = peaks[i];
+			if (index && index->GetPeak(first, len, peak)) continue;
+
+			scratch.resize(len);
+			auto samples = static_cast<const int16_t *>(provider->GetAudioView(scratch.data(), first, len));
+			peak = agi::AudioPeak();
+			double pos = 0, neg = 0;
+			for (int64_t s = 0; s < len; ++s) {
+				peak.min = std::min(peak.min, samples[s]);
+				peak.max = std::max(peak.max, samples[s]);
+				(samples[s] < 0 ? neg : pos) += samples[s];
+			}
+			peak.pos_mean = static_cast<float>(pos / len);
+			peak.neg_mean = static_cast<float>(neg / len);
+		}
+
+		push_value(L, (double)blocks);
+		return 2;
+	}
+
+	/// @brief Get the envelope of frames of audio
+	///
+	/// Arguments are the first envelope frame, the number of frames, and
+	/// optionally a buffer to reuse. Returns the buffer, the number of
+	/// agi::AudioEnvelopeFrame in it, and the length of each frame in ms, or
+	/// nil if the envelope for the range hasn't been computed yet.
+	int audio_envelope_frames(lua_State *L)
+	{
+		auto peaks = get_peak_index(L);
+		int64_t first = static_cast<int64_t>(luaL_checknumber(L, 1));
+		int64_t count = static_cast<int64_t>(luaL_checknumber(L, 2));
+		argcheck(L, first >= 0, 1, "first frame must not be negative");
+		argcheck(L, count >= 0, 2, "count must not be negative");
+
+		std::vector<agi::AudioEnvelopeFrame> frames;
+		if (peaks) {
+			count = std::max<int64_t>(0, std::min(count, peaks->GetEnvelopeFrames() - first));
+			if (count && !peaks->GetEnvelope(first, count, frames))
+				peaks = nullptr;
+		}
+		if (!peaks) {
+			lua_pushnil(L);
+			return 1;
+		}
+
+		auto buf = push_audio_buffer(L, 3, frames.size() * sizeof(agi::AudioEnvelopeFrame));
+		if (!frames.empty())
+			memcpy(buf, frames.data(), frames.size() * sizeof(agi::AudioEnvelopeFrame));
+		push_value(L, (int)frames.size());
+		push_value(L, (int)agi::AudioPeakIndex::EnvelopeFrameMs);
+		return 3;
+	}
+
 	int decode_path(lua_State *L)
 	{
 		std::string path = check_string(L, 1);
@@ -225,10 +591,16 @@ namespace {
 		throw error_tag();
 	}
 
-	int lua_text_textents(lua_State *L)
+	int ignore_registration(lua_State *)
+	{
+		return 0;
+	}
+
+	int parallel_map(lua_State *L);
+
+	std::unique_ptr<AssEntry> check_style(lua_State *L)
 	{
 		argcheck(L, !!lua_istable(L, 1), 1, "");
-		argcheck(L, !!lua_isstring(L, 2), 2, "");
 
 		// have to check that it looks like a style table before actually converting
 		// if it's a dialogue table then an active AssFile object is required
@@ -237,7 +609,7 @@ namespace {
 			std::string actual_class{lua_tostring(L, -1)};
 			boost::to_lower(actual_class);
 			if (actual_class != "style")
-				return error(L, "Not a style entry");
+				error(L, "Not a style entry");
 			lua_pop(L, 1);
 		}
 
@@ -245,8 +617,18 @@ namespace {
 		std::unique_ptr<AssEntry> et(Automation4::LuaAssFile::LuaToAssEntry(L));
 		lua_pop(L, 1);
 		if (typeid(*et) != typeid(AssStyle))
-			return error(L, "Not a style entry");
+			error(L, "Not a style entry");
+		return et;
+	}
+
+	int lua_text_textents(lua_State *L)
+	{
+		argcheck(L, !!lua_istable(L, 1), 1, "");
+		argcheck(L, !!lua_isstring(L, 2), 2, "");
 
+		auto et = check_style(L);
+
+		MarshalProfile::Scope profile(MarshalProfile::TEXT_EXTENTS);
 		double width, height, descent, extlead;
 		if (!Automation4::CalculateTextExtents(static_cast<AssStyle*>(et.get()),
 				check_string(L, 2), width, height, descent, extlead))
@@ -259,6 +641,46 @@ namespace {
 		return 4;
 	}
 
+	/// Vectorized version of text_extents which takes a table of strings and
+	/// returns tables of widths, heights, descents and external leadings
+	int lua_text_textents_batch(lua_State *L)
+	{
+		argcheck(L, !!lua_istable(L, 1), 1, "");
+		argcheck(L, !!lua_istable(L, 2), 2, "");
+
+		auto et = check_style(L);
+
+		std::vector<std::string> texts;
+		size_t count = lua_objlen(L, 2);
+		texts.reserve(count);
+		for (size_t i = 1; i <= count; ++i) {
+			lua_rawgeti(L, 2, i);
+			if (!lua_isstring(L, -1))
+				return error(L, "text_extents_batch: item %d is not a string", (int)i);
+			texts.push_back(get_string(L, -1));
+			lua_pop(L, 1);
+		}
+
+		MarshalProfile::Scope profile(MarshalProfile::TEXT_EXTENTS);
+		std::vector<Automation4::TextExtents> extents;
+		if (!Automation4::CalculateTextExtents(static_cast<AssStyle*>(et.get()), texts, extents))
+			return error(L, "Some internal error occurred calculating text_extents");
+
+		std::vector<double> widths, heights, descents, extleads;
+		for (auto const& e : extents) {
+			widths.push_back(e.width);
+			heights.push_back(e.height);
+			descents.push_back(e.descent);
+			extleads.push_back(e.extlead);
+		}
+
+		push_value(L, widths);
+		push_value(L, heights);
+		push_value(L, descents);
+		push_value(L, extleads);
+		return 4;
+	}
+
 	int lua_get_audio_selection(lua_State *L)
 	{
 		const agi::Context *c = get_context(L);
@@ -372,6 +794,89 @@ namespace {
 
 		void ProcessSubs(AssFile *subs, wxWindow *export_dialog) override;
 	};
+	/// @class LuaHeap
+	/// @brief Memory statistics for a Lua state
+	///
+	/// 64-bit LuaJIT has to allocate its objects from the low 2 GB of the
+	/// address space, which only its own allocator does, so rather than
+	/// replacing that this wraps it to count what the state allocates.
+	/// Objects created by a macro can outlive the run (in globals, upvalues
+	/// or the registry), so the runs' allocations can't be thrown away in
+	/// bulk; instead the statistics are used to decide when a run has
+	/// produced enough garbage to be worth a full collection.
+	struct LuaHeap {
+		lua_Alloc base;
+		void *base_ud;
+		/// Bytes currently allocated. Only the thread running the state
+		/// changes it, but the memory usage report reads it from another.
+		std::atomic<size_t> current{0};
+		/// Most bytes allocated at once since the last call to Reset
+		size_t peak = 0;
+		size_t allocations = 0;
+		size_t frees = 0;
+
+		agi::memory::Registration memory_registration;
+
+		static void *Alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+		/// Reset the peak and counters to measure a single run
+		void Reset() {
+			peak = current;
+			allocations = frees = 0;
+		}
+
+		/// Get the heap of a state created by new_state
+		static LuaHeap *Get(lua_State *L);
+	};
+
+	void *LuaHeap::Alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+	{
+		auto heap = static_cast<LuaHeap *>(ud);
+		void *ret = heap->base(heap->base_ud, ptr, osize, nsize);
+		if (nsize && !ret) return ret;
+
+		if (!ptr) osize = 0;
+		// Not an atomic add, as nothing else writes it
+		const size_t current = heap->current.load(std::memory_order_relaxed) + nsize - osize;
+		heap->current.store(current, std::memory_order_relaxed);
+		heap->peak = std::max(heap->peak, current);
+		if (!ptr && nsize) ++heap->allocations;
+		else if (ptr && !nsize) ++heap->frees;
+		return ret;
+	}
+
+	LuaHeap *LuaHeap::Get(lua_State *L)
+	{
+		void *ud;
+		if (lua_getallocf(L, &ud) != Alloc) return nullptr;
+		return static_cast<LuaHeap *>(ud);
+	}
+
+	/// Create a Lua state whose allocations are counted by a LuaHeap
+	lua_State *new_state()
+	{
+		lua_State *L = luaL_newstate();
+		if (!L) return nullptr;
+
+		auto heap = new LuaHeap;
+		heap->base = lua_getallocf(L, &heap->base_ud);
+		heap->current = lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+		heap->peak = heap->current;
+		heap->memory_registration = agi::memory::Register("Lua", [heap] { return heap->current.load(std::memory_order_relaxed); });
+		lua_setallocf(L, LuaHeap::Alloc, heap);
+		return L;
+	}
+
+	/// Close a state created by new_state
+	void close_state(lua_State *L)
+	{
+		// LuaJIT only releases its arena when closing if the state is
+		// still using its own allocator
+		std::unique_ptr<LuaHeap> heap(LuaHeap::Get(L));
+		if (heap) lua_setallocf(L, heap->base, heap->base_ud);
+		lua_close(L);
+	}
+
 	class LuaScript final : public Script {
 		lua_State *L = nullptr;
 
@@ -383,11 +888,23 @@ namespace {
 		std::vector<cmd::Command*> macros;
 		std::vector<std::unique_ptr<ExportFilter>> filters;
 
+		/// Was the script created in a HeadlessScope?
+		bool headless;
+		/// Macros of a headless script, which aren't registered as commands
+		std::vector<std::unique_ptr<cmd::Command>> headless_macros;
+
 		/// load script and create internal structures etc.
 		void Create();
 		/// destroy internal structures, unreg features and delete environment
 		void Destroy();
 
+		/// Set up the libraries and globals of a new Lua state and run the
+		/// script in it
+		/// @param worker Is the state a parallel_map worker rather than the
+		///               script's main state?
+		/// @return Error message, or empty on success
+		std::string InitState(lua_State *L, bool worker) const;
+
 		static int LuaInclude(lua_State *L);
 
 	public:
@@ -398,8 +915,19 @@ namespace {
 		void UnregisterCommand(LuaCommand *command);
 		void RegisterFilter(LuaExportFilter *filter);
 
+		/// Does the script keep its macros and filters to itself rather
+		/// than registering them with the rest of the program?
+		bool IsHeadless() const { return headless; }
+		/// Take ownership of a macro of a headless script
+		void AdoptCommand(std::unique_ptr<cmd::Command> command) { headless_macros.push_back(std::move(command)); }
+
 		static LuaScript* GetScriptObject(lua_State *L);
 
+		/// Create a state for running the script's functions on another thread
+		/// @param[out] err Error message if the state couldn't be created
+		/// @return The new state, or nullptr on failure
+		lua_State *CreateWorkerState(std::string &err) const;
+
 		// Script implementation
 		void Reload() override { Create(); }
 
@@ -408,6 +936,7 @@ namespace {
 		std::string GetAuthor() const override { return author; }
 		std::string GetVersion() const override { return version; }
 		bool GetLoadedState() const override { return L != nullptr; }
+		bool IsModified() const override { return !L || FilesModified(L); }
 
 		std::vector<cmd::Command*> GetMacros() const override { return macros; }
 		std::vector<ExportFilter*> GetFilters() const override;
@@ -415,6 +944,7 @@ namespace {
 
 	LuaScript::LuaScript(agi::fs::path const& filename)
 	: Script(filename)
+	, headless(!!HeadlessScope::Runner())
 	{
 		Create();
 	}
@@ -426,7 +956,7 @@ namespace {
 		name = GetPrettyFilename().string();
 
 		// create lua environment
-		L = luaL_newstate();
+		L = new_state();
 		if (!L) {
 			description = "Could not initialize Lua state";
 			return;
@@ -434,6 +964,32 @@ namespace {
 
 		bool loaded = false;
 		BOOST_SCOPE_EXIT_ALL(&) { if (!loaded) Destroy(); };
+
+		description = InitState(L, false);
+		if (!description.empty()) return;
+
+		lua_getglobal(L, "version");
+		if (lua_isnumber(L, -1) && lua_tointeger(L, -1) == 3) {
+			lua_pop(L, 1); // just to avoid tripping the stackcheck in debug
+			description = "Attempted to load an Automation 3 script as an Automation 4 Lua script. Automation 3 is no longer supported.";
+			return;
+		}
+
+		name = get_global_string(L, "script_name");
+		description = get_global_string(L, "script_description");
+		author = get_global_string(L, "script_author");
+		version = get_global_string(L, "script_version");
+
+		if (name.empty())
+			name = GetPrettyFilename().string();
+
+		lua_pop(L, 1);
+		// if we got this far, the script should be ready
+		loaded = true;
+	}
+
+	std::string LuaScript::InitState(lua_State *L, bool worker) const
+	{
 		LuaStackcheck stackcheck(L);
 
 		// register standard libs
@@ -451,9 +1007,9 @@ namespace {
 		// Replace the default lua module loader with our unicode compatible
 		// one and set the module search path
 		if (!Install(L, include_path)) {
-			description = get_string_or_default(L, 1);
+			std::string err = get_string_or_default(L, 1);
 			lua_pop(L, 1);
-			return;
+			return err;
 		}
 		stackcheck.check_stack(0);
 
@@ -465,30 +1021,52 @@ namespace {
 		stackcheck.check_stack(0);
 
 		// reference to the script object
-		push_value(L, this);
+		push_value(L, (void *)this);
 		lua_setfield(L, LUA_REGISTRYINDEX, "aegisub");
 		stackcheck.check_stack(0);
 
 		// make "aegisub" table
 		lua_pushstring(L, "aegisub");
-		lua_createtable(L, 0, 13);
-
-		set_field<LuaCommand::LuaRegister>(L, "register_macro");
-		set_field<LuaExportFilter::LuaRegister>(L, "register_filter");
+		lua_createtable(L, 0, 17);
+
+		if (worker) {
+			// Workers run the script only to get its functions, so anything
+			// it registers is ignored. Things which need the GUI thread or
+			// shouldn't happen more than once aren't available at all.
+			set_field<ignore_registration>(L, "register_macro");
+			set_field<ignore_registration>(L, "register_filter");
+		}
+		else {
+			set_field<LuaCommand::LuaRegister>(L, "register_macro");
+			set_field<LuaExportFilter::LuaRegister>(L, "register_filter");
+			set_field<clipboard_init>(L, "__init_clipboard");
+			set_field<lua_get_audio_selection>(L, "get_audio_selection");
+			set_field<lua_set_status_text>(L, "set_status_text");
+			set_field<parallel_map>(L, "parallel_map");
+		}
 		set_field<lua_text_textents>(L, "text_extents");
+		set_field<lua_text_textents_batch>(L, "text_extents_batch");
 		set_field<frame_from_ms>(L, "frame_from_ms");
 		set_field<ms_from_frame>(L, "ms_from_frame");
+		set_field<get_timecodes>(L, "__timecodes");
+		set_field<init_frames_lib>(L, "__init_frames");
 		set_field<video_size>(L, "video_size");
+		set_field<get_video_frame>(L, "__video_frame");
 		set_field<get_keyframes>(L, "keyframes");
+		set_field<audio_envelope>(L, "audio_envelope");
+		set_field<speech_boundaries>(L, "speech_boundaries");
+		set_field<audio_info>(L, "__audio_info");
+		set_field<audio_samples>(L, "__audio_samples");
+		set_field<audio_peaks>(L, "__audio_peaks");
+		set_field<audio_envelope_frames>(L, "__audio_envelope");
 		set_field<decode_path>(L, "decode_path");
 		set_field<cancel_script>(L, "cancel");
 		set_field(L, "lua_automation_version", 4);
-		set_field<clipboard_init>(L, "__init_clipboard");
+		set_field<Automation4::LuaAssFile::InitBulkLib>(L, "__init_lines");
+		set_field<Automation4::LuaInitTagsLib>(L, "__init_tags");
 		set_field<get_file_name>(L, "file_name");
 		set_field<get_translation>(L, "gettext");
 		set_field<project_properties>(L, "project_properties");
-		set_field<lua_get_audio_selection>(L, "get_audio_selection");
-		set_field<lua_set_status_text>(L, "set_status_text");
 
 		// store aegisub table to globals
 		lua_settable(L, LUA_GLOBALSINDEX);
@@ -496,9 +1074,9 @@ namespace {
 
 		// load user script
 		if (!LoadFile(L, GetFilename())) {
-			description = get_string_or_default(L, 1);
+			std::string err = get_string_or_default(L, 1);
 			lua_pop(L, 1);
-			return;
+			return err;
 		}
 		stackcheck.check_stack(1);
 
@@ -510,31 +1088,14 @@ namespace {
 		// this is where features are registered
 		if (lua_pcall(L, 0, 0, -2)) {
 			// error occurred, assumed to be on top of Lua stack
-			description = agi::format("Error initialising Lua script \"%s\":\n\n%s", GetPrettyFilename().string(), get_string_or_default(L, -1));
+			std::string err = agi::format("Error initialising Lua script \"%s\":\n\n%s", GetPrettyFilename().string(), get_string_or_default(L, -1));
 			lua_pop(L, 2); // error + error handler
-			return;
+			return err;
 		}
 		lua_pop(L, 1); // error handler
 		stackcheck.check_stack(0);
 
-		lua_getglobal(L, "version");
-		if (lua_isnumber(L, -1) && lua_tointeger(L, -1) == 3) {
-			lua_pop(L, 1); // just to avoid tripping the stackcheck in debug
-			description = "Attempted to load an Automation 3 script as an Automation 4 Lua script. Automation 3 is no longer supported.";
-			return;
-		}
-
-		name = get_global_string(L, "script_name");
-		description = get_global_string(L, "script_description");
-		author = get_global_string(L, "script_author");
-		version = get_global_string(L, "script_version");
-
-		if (name.empty())
-			name = GetPrettyFilename().string();
-
-		lua_pop(L, 1);
-		// if we got this far, the script should be ready
-		loaded = true;
+		return "";
 	}
 
 	void LuaScript::Destroy()
@@ -542,6 +1103,10 @@ namespace {
 		// Assume the script object is clean if there's no Lua state
 		if (!L) return;
 
+		// headless scripts' macros were never registered, so they're just
+		// deleted, which removes them from macros
+		headless_macros.clear();
+
 		// loops backwards because commands remove themselves from macros when
 		// they're unregistered
 		for (int i = macros.size() - 1; i >= 0; --i)
@@ -549,7 +1114,7 @@ namespace {
 
 		filters.clear();
 
-		lua_close(L);
+		close_state(L);
 		L = nullptr;
 	}
 
@@ -620,6 +1185,127 @@ namespace {
 		return lua_gettop(L) - pretop;
 	}
 
+	/// @class LuaProfiler
+	/// @brief Sampling profiler for a single run of a macro
+	///
+	/// LuaJIT 2.0 has no built-in profiler, so a thread periodically sets a
+	/// hook which records the Lua call stack the next time the script runs
+	/// an instruction. Hooks aren't run by JIT-compiled code, so the JIT is
+	/// turned off while profiling. The samples are written in the folded
+	/// stack format used by flame graph tools, and the time spent in the
+	/// C++ marshalling functions is written to the log.
+	class LuaProfiler {
+		lua_State *L;
+		std::string name;
+		std::unordered_map<std::string, int> samples;
+		std::atomic<bool> stop{false};
+		std::thread sampler;
+
+		static void Hook(lua_State *L, lua_Debug *);
+		/// Record the current call stack of a thread
+		void Sample(lua_State *thread);
+		void Write();
+
+	public:
+		/// Start profiling if it's enabled
+		/// @param L Lua state the macro runs in
+		/// @param name Name of the macro, used as the root of each stack
+		LuaProfiler(lua_State *L, std::string name);
+		~LuaProfiler();
+	};
+
+	LuaProfiler::LuaProfiler(lua_State *L, std::string name)
+	: L(L)
+	, name(std::move(name))
+	{
+		if (!OPT_GET("Automation/Profile Macros")->GetBool()) return;
+
+		lua_pushlightuserdata(L, this);
+		lua_setfield(L, LUA_REGISTRYINDEX, "profiler");
+		luaJIT_setmode(L, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_OFF);
+		MarshalProfile::Reset();
+		MarshalProfile::enabled = true;
+
+		sampler = std::thread([=] {
+			while (!stop) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				// lua_sethook is safe to call asynchronously
+				lua_sethook(L, Hook, LUA_MASKCOUNT, 1);
+			}
+		});
+	}
+
+	LuaProfiler::~LuaProfiler()
+	{
+		if (!sampler.joinable()) return;
+
+		stop = true;
+		sampler.join();
+		lua_sethook(L, nullptr, 0, 0);
+		luaJIT_setmode(L, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_ON);
+		MarshalProfile::enabled = false;
+
+		lua_pushnil(L);
+		lua_setfield(L, LUA_REGISTRYINDEX, "profiler");
+
+		try {
+			Write();
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("automation/lua/profile") << "Failed to write profile: " << e.GetMessage();
+		}
+	}
+
+	void LuaProfiler::Hook(lua_State *L, lua_Debug *)
+	{
+		lua_sethook(L, nullptr, 0, 0);
+
+		lua_getfield(L, LUA_REGISTRYINDEX, "profiler");
+		auto profiler = static_cast<LuaProfiler *>(lua_touserdata(L, -1));
+		lua_pop(L, 1);
+		if (profiler) profiler->Sample(L);
+	}
+
+	void LuaProfiler::Sample(lua_State *thread)
+	{
+		std::vector<std::string> frames;
+		lua_Debug ar;
+		for (int level = 0; lua_getstack(thread, level, &ar); ++level) {
+			lua_getinfo(thread, "Sn", &ar);
+			std::string frame = ar.name ? ar.name : "?";
+			if (*ar.what == 'C')
+				frame = "[C] " + frame;
+			else
+				frame += agi::format(" (%s:%d)", ar.short_src, ar.linedefined);
+			boost::replace_all(frame, ";", ":");
+			frames.push_back(std::move(frame));
+		}
+
+		std::string stack = name;
+		for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+			stack += ";" + *it;
+		++samples[stack];
+	}
+
+	void LuaProfiler::Write()
+	{
+		auto path = config::path->Decode("?user/automation-profile.folded");
+		{
+			agi::io::Save file(path);
+			auto& out = file.Get();
+			for (auto const& sample : samples)
+				out << sample.first << " " << sample.second << "\n";
+		}
+
+		LOG_I("automation/lua/profile") << "Profile of " << name << " written to " << path;
+		for (int i = 0; i < MarshalProfile::COUNTER_COUNT; ++i) {
+			auto counter = static_cast<MarshalProfile::Counter>(i);
+			LOG_I("automation/lua/profile") << MarshalProfile::Name(counter) << ": "
+				<< MarshalProfile::calls[i] << " calls, "
+				<< MarshalProfile::nanoseconds[i] / 1000000 << " ms";
+		}
+	}
+
 	void LuaThreadedCall(lua_State *L, int nargs, int nresults, std::string const& title, wxWindow *parent, bool can_open_config)
 	{
 		bool failed = false;
@@ -627,6 +1313,10 @@ namespace {
 		bsr.Run([&](ProgressSink *ps) {
 			LuaProgressSink lps(L, ps, can_open_config);
 
+			LuaHeap *heap = LuaHeap::Get(L);
+			const size_t start_size = heap ? heap->current.load() : 0;
+			if (heap) heap->Reset();
+
 			// Insert our error handler under the function to call
 			lua_pushcclosure(L, add_stack_trace, 0);
 			lua_insert(L, -nargs - 2);
@@ -643,12 +1333,255 @@ namespace {
 			else
 				lua_remove(L, -nresults - 1);
 
-			lua_gc(L, LUA_GCCOLLECT, 0);
+			// A full collection after every run keeps scripts' memory use
+			// down but is slow for big scripts which run lots of quick
+			// macros, so it's skipped if the run didn't leave much behind
+			// and the incremental collector is left to deal with it
+			const size_t threshold = OPT_GET("Automation/Collection Threshold")->GetInt() * 1024 * 1024;
+			if (!heap || heap->current - std::min(start_size, heap->current.load()) >= threshold)
+				lua_gc(L, LUA_GCCOLLECT, 0);
+
+			if (heap)
+				LOG_D("automation/lua/memory") << title << ": "
+					<< heap->allocations << " allocations, "
+					<< heap->frees << " frees, peak "
+					<< heap->peak / 1024 << " KB, now "
+					<< heap->current / 1024 << " KB";
 		});
 		if (failed)
 			throw agi::UserCancelException("Script threw an error");
 	}
 
+	lua_State *LuaScript::CreateWorkerState(std::string &err) const
+	{
+		lua_State *L = new_state();
+		if (!L) {
+			err = "Could not initialize Lua state";
+			return nullptr;
+		}
+
+		err = InitState(L, true);
+		if (!err.empty()) {
+			close_state(L);
+			return nullptr;
+		}
+		return L;
+	}
+
+	/// A Lua value copied out of a state so that it can be pushed onto another
+	struct LuaValue {
+		int type = LUA_TNIL;
+		bool boolean = false;
+		double number = 0;
+		std::string string;
+		/// Alternating keys and values of a table
+		std::vector<LuaValue> table;
+	};
+
+	/// Copy the value at idx
+	/// @return false if the value isn't made up of only nil, booleans,
+	///         numbers, strings and tables
+	bool read_value(lua_State *L, int idx, LuaValue &value, int depth = 0)
+	{
+		if (idx < 0) idx = lua_gettop(L) + idx + 1;
+
+		value.type = lua_type(L, idx);
+		switch (value.type) {
+			case LUA_TNIL: return true;
+			case LUA_TBOOLEAN:
+				value.boolean = !!lua_toboolean(L, idx);
+				return true;
+			case LUA_TNUMBER:
+				value.number = lua_tonumber(L, idx);
+				return true;
+			case LUA_TSTRING: {
+				size_t len;
+				const char *str = lua_tolstring(L, idx, &len);
+				value.string.assign(str, len);
+				return true;
+			}
+			case LUA_TTABLE:
+				// Deeper than this is almost certainly a table which contains itself
+				if (depth > 100) return false;
+				lua_pushnil(L);
+				while (lua_next(L, idx)) {
+					value.table.emplace_back();
+					value.table.emplace_back();
+					if (!read_value(L, -2, value.table[value.table.size() - 2], depth + 1) ||
+						!read_value(L, -1, value.table.back(), depth + 1)) {
+						lua_pop(L, 2);
+						return false;
+					}
+					lua_pop(L, 1);
+				}
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	void push_copy(lua_State *L, LuaValue const& value)
+	{
+		switch (value.type) {
+			case LUA_TBOOLEAN: lua_pushboolean(L, value.boolean); break;
+			case LUA_TNUMBER:  lua_pushnumber(L, value.number); break;
+			case LUA_TSTRING:  lua_pushlstring(L, value.string.data(), value.string.size()); break;
+			case LUA_TTABLE:
+				lua_createtable(L, 0, value.table.size() / 2);
+				for (size_t i = 0; i + 1 < value.table.size(); i += 2) {
+					push_copy(L, value.table[i]);
+					push_copy(L, value.table[i + 1]);
+					lua_rawset(L, -3);
+				}
+				break;
+			default: lua_pushnil(L); break;
+		}
+	}
+
+	/// Minimum number of items for each worker state, as every worker has
+	/// to load the whole script before it can do anything
+	const size_t min_items_per_worker = 50;
+
+	/// aegisub.parallel_map(items, function_name[, max_workers])
+	///
+	/// Call the global function named function_name on each of the items,
+	/// returning an array of the results in the same order. The items are
+	/// split between worker states running the script on their own threads,
+	/// so the function can only see globals set by the script when it is
+	/// loaded, and the items and results can only be made up of nil,
+	/// booleans, numbers, strings and tables.
+	int parallel_map(lua_State *L)
+	{
+		argcheck(L, !!lua_istable(L, 1), 1, "");
+		const std::string function = check_string(L, 2);
+		const size_t count = lua_objlen(L, 1);
+
+		size_t worker_count = std::min<size_t>(std::thread::hardware_concurrency(), count / min_items_per_worker);
+		if (lua_isnumber(L, 3))
+			worker_count = std::min<size_t>(worker_count, std::max<int>(lua_tointeger(L, 3), 1));
+
+		if (worker_count < 2) {
+			lua_createtable(L, count, 0);
+			for (size_t i = 1; i <= count; ++i) {
+				lua_getglobal(L, function.c_str());
+				if (!lua_isfunction(L, -1))
+					return error(L, "parallel_map: '%s' is not a global function", function.c_str());
+				lua_rawgeti(L, 1, i);
+				lua_call(L, 1, 1);
+				lua_rawseti(L, -2, i);
+			}
+			return 1;
+		}
+
+		std::vector<LuaValue> items(count);
+		for (size_t i = 0; i < count; ++i) {
+			lua_rawgeti(L, 1, i + 1);
+			if (!read_value(L, -1, items[i]))
+				return error(L, "parallel_map: item %d is not made up of only nil, booleans, numbers, strings and tables", (int)i + 1);
+			lua_pop(L, 1);
+		}
+
+		ProgressSink *ps = nullptr;
+		lua_getfield(L, LUA_REGISTRYINDEX, "progress_sink");
+		if (lua_isuserdata(L, -1))
+			ps = LuaProgressSink::GetObjPointer(L, -1);
+		lua_pop(L, 1);
+
+		const LuaScript *script = LuaScript::GetScriptObject(L);
+		const agi::Context *c = get_context(L);
+
+		std::vector<LuaValue> results(count);
+		std::vector<std::string> errors(worker_count);
+		std::atomic<size_t> done(0);
+		std::atomic<bool> failed(false);
+
+		auto run_worker = [&](size_t worker, size_t first, size_t last) {
+			std::string& err = errors[worker];
+			lua_State *WL = script->CreateWorkerState(err);
+			if (!WL) {
+				failed = true;
+				return;
+			}
+			BOOST_SCOPE_EXIT_ALL(&) { close_state(WL); };
+
+			set_context(WL, c);
+			std::unique_ptr<LuaProgressSink> lps;
+			if (ps) {
+				// Each worker can log and check for cancellation, but the
+				// overall progress is set from the number of items finished
+				lps = agi::make_unique<LuaProgressSink>(WL, ps, false);
+				lua_getglobal(WL, "aegisub");
+				lua_getfield(WL, -1, "progress");
+				set_field<ignore_registration>(WL, "set");
+				lua_pop(WL, 2);
+			}
+
+			lua_pushcclosure(WL, add_stack_trace, 0);
+			lua_getglobal(WL, function.c_str());
+			if (!lua_isfunction(WL, -1)) {
+				err = agi::format("parallel_map: '%s' is not a global function", function);
+				failed = true;
+				return;
+			}
+
+			for (size_t i = first; i < last && !failed; ++i) {
+				if (ps && ps->IsCancelled()) break;
+
+				lua_pushvalue(WL, -1);
+				push_copy(WL, items[i]);
+				if (lua_pcall(WL, 1, 1, -4)) {
+					err = get_string_or_default(WL, -1);
+					failed = true;
+					break;
+				}
+				if (!read_value(WL, -1, results[i])) {
+					err = agi::format("parallel_map: result %d is not made up of only nil, booleans, numbers, strings and tables", i + 1);
+					failed = true;
+					break;
+				}
+				lua_pop(WL, 1);
+				++done;
+			}
+		};
+
+		std::vector<std::thread> workers;
+		const size_t per_worker = (count + worker_count - 1) / worker_count;
+		for (size_t i = 0; i < worker_count; ++i) {
+			size_t first = i * per_worker;
+			size_t last = std::min(count, first + per_worker);
+			workers.emplace_back([&, i, first, last] {
+				try {
+					run_worker(i, first, last);
+				}
+				catch (std::exception const& e) {
+					errors[i] = e.what();
+					failed = true;
+				}
+			});
+		}
+
+		// Report the progress of all of the workers while waiting for them
+		while (done < count && !failed && !(ps && ps->IsCancelled())) {
+			if (ps) ps->SetProgress(done, count);
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+		for (auto& worker : workers)
+			worker.join();
+		if (ps) ps->SetProgress(done, count);
+
+		for (auto const& err : errors) {
+			if (!err.empty())
+				return error(L, "%s", err.c_str());
+		}
+
+		lua_createtable(L, count, 0);
+		for (size_t i = 0; i < count; ++i) {
+			push_copy(L, results[i]);
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 1;
+	}
+
 	// LuaFeature
 	void LuaFeature::RegisterFeature()
 	{
@@ -675,12 +1608,12 @@ namespace {
 	// LuaFeatureMacro
 	int LuaCommand::LuaRegister(lua_State *L)
 	{
-		static std::mutex mutex;
 		auto command = agi::make_unique<LuaCommand>(L);
-		{
-			std::lock_guard<std::mutex> lock(mutex);
+		auto script = LuaScript::GetScriptObject(L);
+		if (script->IsHeadless())
+			script->AdoptCommand(std::move(command));
+		else
 			cmd::reg(std::move(command));
-		}
 		return 0;
 	}
 
@@ -803,11 +1736,16 @@ namespace {
 		push_value(L, original_active);
 
 		try {
+			LuaProfiler profiler(L, from_wx(StrDisplay(c)));
 			LuaThreadedCall(L, 3, 2, from_wx(StrDisplay(c)), c->parent, true);
 		}
 		catch (agi::UserCancelException const&) {
 			subsobj->Cancel();
 			stackcheck.check_stack(0);
+			// There's no one to have seen the error in the progress dialog,
+			// so let whatever ran the macro know it failed
+			if (LuaScript::GetScriptObject(L)->IsHeadless())
+				throw;
 			return;
 		}
 
@@ -950,6 +1888,12 @@ namespace {
 	{
 		static std::mutex mutex;
 		auto filter = agi::make_unique<LuaExportFilter>(L);
+		// The script owns the filter either way, and headless scripts' filters
+		// are only used through the script
+		if (LuaScript::GetScriptObject(L)->IsHeadless()) {
+			filter.release();
+			return 0;
+		}
 		{
 			std::lock_guard<std::mutex> lock(mutex);
 			AssExportFilterChain::Register(std::move(filter));
@@ -1025,6 +1969,28 @@ namespace {
 }
 
 namespace Automation4 {
+	std::atomic<bool> MarshalProfile::enabled{false};
+	std::atomic<int64_t> MarshalProfile::nanoseconds[MarshalProfile::COUNTER_COUNT];
+	std::atomic<int64_t> MarshalProfile::calls[MarshalProfile::COUNTER_COUNT];
+
+	void MarshalProfile::Reset()
+	{
+		for (int i = 0; i < COUNTER_COUNT; ++i) {
+			nanoseconds[i] = 0;
+			calls[i] = 0;
+		}
+	}
+
+	const char *MarshalProfile::Name(Counter counter)
+	{
+		switch (counter) {
+			case ASS_ENTRY_TO_LUA: return "AssEntryToLua";
+			case LUA_TO_ASS_ENTRY: return "LuaToAssEntry";
+			case TEXT_EXTENTS:     return "text_extents";
+			default:               return "";
+		}
+	}
+
 	LuaScriptFactory::LuaScriptFactory()
 	: ScriptFactory("Lua", "*.lua,*.moon")
 	{
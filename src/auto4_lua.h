@@ -29,23 +29,168 @@
 
 #include "auto4_base.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <deque>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <wx/string.h>
 
+class AssDialogue;
 class AssEntry;
 class wxControl;
 class wxWindow;
+struct agi_lua_dialogue;
+struct agi_lua_karaoke_line;
+struct agi_lua_syllable;
 struct lua_State;
 
 namespace Automation4 {
+	/// @class MarshalProfile
+	/// @brief Time spent converting values between Lua and C++ while a macro
+	///        is being profiled
+	///
+	/// The sampling profiler only sees Lua code, so the C++ functions which
+	/// scripts spend a lot of time in are timed directly.
+	class MarshalProfile {
+	public:
+		enum Counter {
+			ASS_ENTRY_TO_LUA,
+			LUA_TO_ASS_ENTRY,
+			TEXT_EXTENTS,
+			COUNTER_COUNT
+		};
+
+		/// Is time currently being measured?
+		static std::atomic<bool> enabled;
+		/// Total time spent in each counter's functions
+		static std::atomic<int64_t> nanoseconds[COUNTER_COUNT];
+		/// Number of calls to each counter's functions
+		static std::atomic<int64_t> calls[COUNTER_COUNT];
+
+		/// Zero all of the counters
+		static void Reset();
+		/// Get the display name of a counter
+		static const char *Name(Counter counter);
+
+		/// Adds the time between construction and destruction to a counter
+		class Scope {
+			Counter counter;
+			bool active;
+			std::chrono::steady_clock::time_point start;
+		public:
+			Scope(Counter counter)
+			: counter(counter)
+			, active(enabled)
+			{
+				if (active) start = std::chrono::steady_clock::now();
+			}
+
+			~Scope() {
+				if (!active) return;
+				nanoseconds[counter] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				++calls[counter];
+			}
+		};
+	};
+
+	/// @class LuaLineBuffer
+	/// @brief Array of lines with a gap at the position of the last change
+	///
+	/// Scripts tend to insert and delete lines in runs at or next to the same
+	/// place, such as deleting every old effect line while iterating over the
+	/// file. Keeping the free space where the last change was made means that
+	/// each of these only has to move the lines between it and the previous
+	/// change rather than every line after it.
+	class LuaLineBuffer {
+		std::vector<AssEntry *> buffer;
+		/// Unused range of buffer
+		size_t gap_begin = 0, gap_end = 0;
+
+		/// Move the gap so that it starts at pos
+		void MoveGap(size_t pos) {
+			if (pos < gap_begin) {
+				std::move_backward(buffer.begin() + pos, buffer.begin() + gap_begin, buffer.begin() + gap_end);
+				gap_end -= gap_begin - pos;
+				gap_begin = pos;
+			}
+			else if (pos > gap_begin) {
+				size_t count = pos - gap_begin;
+				std::move(buffer.begin() + gap_end, buffer.begin() + gap_end + count, buffer.begin() + gap_begin);
+				gap_begin += count;
+				gap_end += count;
+			}
+		}
+
+		/// Make the gap at least count entries long
+		void GrowGap(size_t count) {
+			size_t gap = gap_end - gap_begin;
+			if (gap >= count) return;
+			size_t grow = std::max(count - gap, buffer.size() + 16);
+			buffer.insert(buffer.begin() + gap_end, grow, nullptr);
+			gap_end += grow;
+		}
+
+	public:
+		size_t size() const { return buffer.size() - (gap_end - gap_begin); }
+		bool empty() const { return size() == 0; }
+
+		AssEntry *&operator[](size_t i) {
+			return buffer[i < gap_begin ? i : i + gap_end - gap_begin];
+		}
+
+		void push_back(AssEntry *line) { insert(size(), line); }
+
+		void insert(size_t pos, AssEntry *line) {
+			MoveGap(pos);
+			GrowGap(1);
+			buffer[gap_begin++] = line;
+		}
+
+		template<typename Iterator>
+		void insert(size_t pos, Iterator first, Iterator last) {
+			size_t count = std::distance(first, last);
+			MoveGap(pos);
+			GrowGap(count);
+			std::copy(first, last, buffer.begin() + gap_begin);
+			gap_begin += count;
+		}
+
+		/// Remove the lines in [first, last)
+		void erase(size_t first, size_t last) {
+			MoveGap(first);
+			gap_end += last - first;
+		}
+
+		/// Get the lines as a contiguous array
+		std::vector<AssEntry *> Lines() const {
+			std::vector<AssEntry *> ret;
+			ret.reserve(size());
+			ret.insert(ret.end(), buffer.begin(), buffer.begin() + gap_begin);
+			ret.insert(ret.end(), buffer.begin() + gap_end, buffer.end());
+			return ret;
+		}
+	};
+
 	/// @class LuaAssFile
 	/// @brief Object wrapping an AssFile object for modification through Lua
 	class LuaAssFile {
+		/// A dialogue line in the file and the line replacing it
+		typedef std::pair<AssDialogue *, AssDialogue *> Replacement;
+
 		struct PendingCommit {
 			wxString mesage;
 			int modification_type;
+			/// Were lines added, removed or reordered?
+			bool restructured;
+			/// All of the lines, if restructured
 			std::vector<AssEntry*> lines;
+			/// The replaced dialogue lines, if not restructured
+			std::vector<Replacement> replacements;
 		};
 
 		/// Pointer to file being modified
@@ -71,14 +216,27 @@ namespace Automation4 {
 		int references = 2;
 
 		/// Set of subtitle lines being modified; initially a shallow copy of ass->Line
-		std::vector<AssEntry*> lines;
+		LuaLineBuffer lines;
 		bool script_info_copied = false;
 
+		/// Dialogue lines replaced with other dialogue lines since the last
+		/// undo point, in the order they were first replaced
+		std::vector<Replacement> replacements;
+		/// Index in replacements of each replacing line
+		std::unordered_map<AssEntry *, size_t> replacement_index;
+		/// Have any changes other than replacing dialogue lines been made since
+		/// the last undo point? If not, the changes can be applied to the file
+		/// without rebuilding it.
+		bool lines_restructured = false;
+
 		/// Commits to apply once processing completes successfully
 		std::deque<PendingCommit> pending_commits;
 		/// Lines to delete once processing complete successfully
 		std::vector<std::unique_ptr<AssEntry>> lines_to_delete;
 
+		/// Strings pointed to by the result of the last KaraokeLayout call
+		std::deque<std::string> karaoke_strings;
+
 		/// Create copies of all of the lines in the script info section if it
 		/// hasn't already happened. This is done lazily, since it only needs
 		/// to happen when the user modifies the headers in some way, which
@@ -90,7 +248,21 @@ namespace Automation4 {
 		void QueueLineForDeletion(size_t idx);
 		/// Set the line at the index to the given value
 		void AssignLine(size_t idx, std::unique_ptr<AssEntry> e);
-		void InsertLine(std::vector<AssEntry *> &vec, size_t idx, std::unique_ptr<AssEntry> e);
+		/// Take ownership of a new line, returning the pointer to put in lines
+		AssEntry *AdoptLine(std::unique_ptr<AssEntry> e);
+
+		/// Push the table of line tables given to the script to the lines they
+		/// were made from
+		void PushTrackingTable(lua_State *L);
+		/// Record that the table on the top of the stack was made from e
+		void TrackLine(lua_State *L, const AssEntry *e);
+		/// Get the dialogue line at idx if the table on the top of the stack
+		/// was made from it
+		const AssDialogue *TrackedDialogue(lua_State *L, size_t idx);
+		/// Create a copy of orig with the fields which differ in the table on
+		/// the top of the stack changed
+		/// @return nullptr if nothing has changed
+		std::unique_ptr<AssEntry> UpdateDialogue(lua_State *L, AssDialogue const& orig);
 
 		int ObjectIndexRead(lua_State *L);
 		void ObjectIndexWrite(lua_State *L);
@@ -108,6 +280,23 @@ namespace Automation4 {
 
 		void LuaSetUndoPoint(lua_State *L);
 
+		/// Copy the fields of the dialogue lines in [first, first + count) to
+		/// out for the FFI bulk line API
+		/// @return Number of lines read, or -1 if the file is no longer valid
+		static int BulkRead(LuaAssFile *file, size_t first, size_t count, agi_lua_dialogue *out);
+		/// Apply the modified fields of each of the rows to the dialogue line
+		/// they were read from
+		/// @return 0 on success, or a BulkWriteError
+		static int BulkWrite(LuaAssFile *file, const agi_lua_dialogue *rows, size_t count);
+		/// Split the dialogue line at index into karaoke syllables and lay
+		/// them out the same way karaskel does for lines without furigana
+		/// @param x_factor Factor to scale horizontal sizes by
+		/// @param[out] line Information about the whole line
+		/// @param[out] syls Up to max syllables, including the empty zeroth one
+		/// @return Number of syllables, which may be greater than max, or a
+		///         negative KaraokeLayoutError
+		static int KaraokeLayout(LuaAssFile *file, size_t index, double x_factor, agi_lua_karaoke_line *line, agi_lua_syllable *syls, size_t max);
+
 		// LuaAssFile can only be deleted by the reference count hitting zero
 		~LuaAssFile();
 	public:
@@ -118,6 +307,9 @@ namespace Automation4 {
 		/// assumes a Lua representation of AssEntry on the top of the stack, and creates an AssEntry object of it
 		static std::unique_ptr<AssEntry> LuaToAssEntry(lua_State *L, AssFile *ass=nullptr);
 
+		/// Push the table of FFI functions used by the aegisub.lines module
+		static int InitBulkLib(lua_State *L);
+
 		/// @brief Signal that the script using this file is now done running
 		/// @param set_undo If there's any uncommitted changes to the file,
 		///                 they will be automatically committed with this
@@ -154,6 +346,9 @@ namespace Automation4 {
 		static ProgressSink* GetObjPointer(lua_State *L, int idx);
 	};
 
+	/// Push the table of FFI functions used by the aegisub.tags module
+	int LuaInitTagsLib(lua_State *L);
+
 	/// Base class for controls in dialogs
 	class LuaDialogControl {
 	public:
@@ -43,17 +43,148 @@
 
 #include <libaegisub/exception.h>
 #include <libaegisub/log.h>
+#include <libaegisub/lua/ffi.h>
 #include <libaegisub/lua/utils.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <cassert>
+#include <cstring>
 #include <memory>
 
+/// A dialogue line as seen by the aegisub.lines module. The layout must
+/// match the definition in automation/include/aegisub/lines.moon.
+struct agi_lua_dialogue {
+	/// One-based index of the line in the subtitles object, or 0 if the
+	/// line isn't a dialogue line
+	int index;
+	/// Bitmask of the fields which have been modified
+	int modified;
+	int comment;
+	int layer;
+	int start_time;
+	int end_time;
+	int margin_l;
+	int margin_r;
+	int margin_t;
+	const char *style;
+	const char *actor;
+	const char *effect;
+	const char *text;
+};
+
+/// A line laid out by LuaAssFile::KaraokeLayout. The layout must match the
+/// definition in automation/include/aegisub/lines.moon.
+struct agi_lua_karaoke_line {
+	int duration;
+	/// Number of syllables, including the empty zeroth one
+	int syllable_count;
+	double width;
+	double height;
+	double descent;
+	double extlead;
+	/// Effective margins, using the style's when the line's are zero
+	int eff_margin_l;
+	int eff_margin_r;
+	int eff_margin_v;
+	double left;
+	double center;
+	double right;
+	double top;
+	double middle;
+	double bottom;
+	const char *text_stripped;
+};
+
+/// A syllable of a line laid out by LuaAssFile::KaraokeLayout, after
+/// merging multi-highlight syllables. Times are relative to the line start
+/// and positions are relative to the line's left edge.
+struct agi_lua_syllable {
+	int start_time;
+	int end_time;
+	int duration;
+	/// Number of karaoke tags merged into this syllable
+	int highlights;
+	double width;
+	double height;
+	double prespacewidth;
+	double postspacewidth;
+	double left;
+	double center;
+	double right;
+	const char *tag;
+	const char *text;
+	const char *text_stripped;
+	const char *text_spacestripped;
+	const char *prespace;
+	const char *postspace;
+	const char *inline_fx;
+};
+
+namespace agi {
+	template<> struct type_name<Automation4::LuaAssFile> {
+		static const char *name() { return "agi_lua_ass_file"; }
+	};
+	AGI_DEFINE_TYPE_NAME(agi_lua_dialogue);
+	AGI_DEFINE_TYPE_NAME(agi_lua_karaoke_line);
+	AGI_DEFINE_TYPE_NAME(agi_lua_syllable);
+}
+
 namespace {
 	using namespace agi::lua;
 
+	/// Fields of agi_lua_dialogue which can be marked as modified
+	enum BulkField {
+		BULK_COMMENT    = 0x1,
+		BULK_LAYER      = 0x2,
+		BULK_START_TIME = 0x4,
+		BULK_END_TIME   = 0x8,
+		BULK_MARGIN_L   = 0x10,
+		BULK_MARGIN_R   = 0x20,
+		BULK_MARGIN_T   = 0x40,
+		BULK_STYLE      = 0x80,
+		BULK_ACTOR      = 0x100,
+		BULK_EFFECT     = 0x200,
+		BULK_TEXT       = 0x400
+	};
+
+	/// Errors returned by LuaAssFile::BulkWrite
+	enum BulkWriteError {
+		BULK_EXPIRED = 1,
+		BULK_READ_ONLY,
+		BULK_BAD_INDEX,
+		BULK_NULL_STRING
+	};
+
+	/// Errors returned by LuaAssFile::KaraokeLayout
+	enum KaraokeLayoutError {
+		KARAOKE_EXPIRED = -1,
+		KARAOKE_BAD_INDEX = -2,
+		KARAOKE_NO_STYLE = -3
+	};
+
+	/// Does a stripped syllable continue the previous one's highlight?
+	bool is_multi_highlight(std::string const& text)
+	{
+		return boost::starts_with(text, "#") || boost::starts_with(text, "\xEF\xBC\x83"); // fullwidth #
+	}
+
+	/// Get the last inline-fx name (\-name) in a syllable's text
+	std::string inline_fx(std::string const& text)
+	{
+		auto brace = text.find('{');
+		if (brace == std::string::npos) return "";
+		for (auto pos = text.rfind("\\-"); pos != std::string::npos && pos > brace; pos = text.rfind("\\-", pos - 1)) {
+			auto end = text.find_first_of("}\\", pos + 2);
+			if (end == std::string::npos) end = text.size();
+			if (end > pos + 2)
+				return text.substr(pos + 2, end - pos - 2);
+		}
+		return "";
+	}
+
 	DEFINE_EXCEPTION(BadField, Automation4::MacroRunError);
 	BadField bad_field(const char *expected_type, const char *name, const char *line_clasee)
 	{
@@ -100,6 +231,44 @@ namespace {
 		return ret;
 	}
 
+	/// Check if a string field of the table on the top of the stack is equal
+	/// to value without copying it
+	bool string_field_equals(lua_State *L, const char *name, std::string const& value, const char *line_class)
+	{
+		lua_getfield(L, -1, name);
+		if (!lua_isstring(L, -1))
+			throw bad_field("string", name, line_class);
+		size_t len;
+		const char *str = lua_tolstring(L, -1, &len);
+		bool ret = len == value.size() && !memcmp(str, value.data(), len);
+		lua_pop(L, 1);
+		return ret;
+	}
+
+	std::vector<uint32_t> get_extradata_field(lua_State *L, AssFile *ass)
+	{
+		std::vector<uint32_t> ids;
+
+		lua_getfield(L, -1, "extra");
+		auto type = lua_type(L, -1);
+		if (type == LUA_TTABLE) {
+			lua_for_each(L, [&] {
+				if (lua_type(L, -2) != LUA_TSTRING) return;
+				ids.push_back(ass->AddExtradata(
+					get_string_or_default(L, -2),
+					get_string_or_default(L, -1)));
+			});
+			std::sort(begin(ids), end(ids));
+		}
+		else if (type != LUA_TNIL) {
+			error(L, "dialogue extradata must be a table");
+		}
+		else
+			lua_pop(L, 1);
+
+		return ids;
+	}
+
 	using namespace Automation4;
 	template<int (LuaAssFile::*closure)(lua_State *)>
 	int closure_wrapper(lua_State *L)
@@ -124,6 +293,22 @@ namespace {
 		}
 	}
 
+	/// Get the commit type for replacing one dialogue line with another
+	int changed_fields(AssDialogue const& a, AssDialogue const& b)
+	{
+		int type = 0;
+		if (a.Start != b.Start || a.End != b.End)
+			type |= AssFile::COMMIT_DIAG_TIME;
+		if (a.Text != b.Text)
+			type |= AssFile::COMMIT_DIAG_TEXT;
+		if (a.Comment != b.Comment || a.Layer != b.Layer || a.Margin != b.Margin ||
+			a.Style != b.Style || a.Actor != b.Actor || a.Effect != b.Effect)
+			type |= AssFile::COMMIT_DIAG_META;
+		if (a.ExtradataIds != b.ExtradataIds)
+			type |= AssFile::COMMIT_EXTRADATA;
+		return type;
+	}
+
 	template<typename T, typename U>
 	const T *check_cast_constptr(const U *value) {
 		return typeid(const T) == typeid(*value) ? static_cast<const T *>(value) : nullptr;
@@ -147,6 +332,7 @@ namespace Automation4 {
 
 	void LuaAssFile::AssEntryToLua(lua_State *L, size_t idx)
 	{
+		MarshalProfile::Scope profile(MarshalProfile::ASS_ENTRY_TO_LUA);
 		lua_newtable(L);
 
 		const AssEntry *e = lines[idx];
@@ -191,6 +377,8 @@ namespace Automation4 {
 			lua_setfield(L, -2, "extra");
 
 			set_field(L, "class", "dialogue");
+
+			TrackLine(L, dia);
 		}
 		else if (auto sty = check_cast_constptr<AssStyle>(e)) {
 			set_field(L, "raw", sty->GetEntryData());
@@ -238,8 +426,89 @@ namespace Automation4 {
 		}
 	}
 
+	void LuaAssFile::PushTrackingTable(lua_State *L)
+	{
+		lua_pushlightuserdata(L, this);
+		lua_rawget(L, LUA_REGISTRYINDEX);
+	}
+
+	void LuaAssFile::TrackLine(lua_State *L, const AssEntry *e)
+	{
+		PushTrackingTable(L);
+		lua_pushvalue(L, -2);
+		lua_pushlightuserdata(L, const_cast<AssEntry *>(e));
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+	}
+
+	const AssDialogue *LuaAssFile::TrackedDialogue(lua_State *L, size_t idx)
+	{
+		if (!lua_istable(L, -1) || !lines[idx]) return nullptr;
+
+		PushTrackingTable(L);
+		lua_pushvalue(L, -2);
+		lua_rawget(L, -2);
+		void *origin = lua_touserdata(L, -1);
+		lua_pop(L, 2);
+		if (origin != lines[idx]) return nullptr;
+
+		// The script could have turned it into some other sort of line
+		lua_getfield(L, -1, "class");
+		std::string lclass(lua_isstring(L, -1) ? lua_tostring(L, -1) : "");
+		lua_pop(L, 1);
+		boost::to_lower(lclass);
+		if (lclass != "dialogue") return nullptr;
+
+		return check_cast_constptr<AssDialogue>(lines[idx]);
+	}
+
+	std::unique_ptr<AssEntry> LuaAssFile::UpdateDialogue(lua_State *L, AssDialogue const& orig)
+	{
+		std::unique_ptr<AssDialogue> dia;
+		auto modify = [&]() -> AssDialogue& {
+			if (!dia)
+				dia = agi::make_unique<AssDialogue>(orig);
+			return *dia;
+		};
+
+		bool comment = get_bool_field(L, "comment", "dialogue");
+		if (comment != orig.Comment) modify().Comment = comment;
+
+		int layer = get_int_field(L, "layer", "dialogue");
+		if (layer != orig.Layer) modify().Layer = layer;
+
+		int start = get_int_field(L, "start_time", "dialogue");
+		if (start != (int)orig.Start) modify().Start = start;
+
+		int end = get_int_field(L, "end_time", "dialogue");
+		if (end != (int)orig.End) modify().End = end;
+
+		const char *margins[] = {"margin_l", "margin_r", "margin_t"};
+		for (size_t i = 0; i < 3; ++i) {
+			int margin = get_int_field(L, margins[i], "dialogue");
+			if (margin != orig.Margin[i]) modify().Margin[i] = margin;
+		}
+
+		// Only the strings which have actually changed need to be copied out
+		// of Lua and interned
+		if (!string_field_equals(L, "style", orig.Style, "dialogue"))
+			modify().Style = get_string_field(L, "style", "dialogue");
+		if (!string_field_equals(L, "actor", orig.Actor, "dialogue"))
+			modify().Actor = get_string_field(L, "actor", "dialogue");
+		if (!string_field_equals(L, "effect", orig.Effect, "dialogue"))
+			modify().Effect = get_string_field(L, "effect", "dialogue");
+		if (!string_field_equals(L, "text", orig.Text, "dialogue"))
+			modify().Text = get_string_field(L, "text", "dialogue");
+
+		auto ids = get_extradata_field(L, ass);
+		if (ids != orig.ExtradataIds.get()) modify().ExtradataIds = std::move(ids);
+
+		return std::move(dia);
+	}
+
 	std::unique_ptr<AssEntry> LuaAssFile::LuaToAssEntry(lua_State *L, AssFile *ass)
 	{
+		MarshalProfile::Scope profile(MarshalProfile::LUA_TO_ASS_ENTRY);
 		// assume an assentry table is on the top of the stack
 		// convert it to a real AssEntry object, and pop the table from the stack
 
@@ -301,24 +570,7 @@ namespace Automation4 {
 			dia->Margin[2] = get_int_field(L, "margin_t", "dialogue");
 			dia->Effect = get_string_field(L, "effect", "dialogue");
 			dia->Text = get_string_field(L, "text", "dialogue");
-
-			std::vector<uint32_t> new_ids;
-
-			lua_getfield(L, -1, "extra");
-			auto type = lua_type(L, -1);
-			if (type == LUA_TTABLE) {
-				lua_for_each(L, [&] {
-					if (lua_type(L, -2) != LUA_TSTRING) return;
-					new_ids.push_back(ass->AddExtradata(
-						get_string_or_default(L, -2),
-						get_string_or_default(L, -1)));
-				});
-				std::sort(begin(new_ids), end(new_ids));
-				dia->ExtradataIds = std::move(new_ids);
-			}
-			else if (type != LUA_TNIL) {
-				error(L, "dialogue extradata must be a table");
-			}
+			dia->ExtradataIds = get_extradata_field(L, ass);
 		}
 		else {
 			error(L, "Found line with unknown class: %s", lclass.c_str());
@@ -351,6 +603,12 @@ namespace Automation4 {
 					return 1;
 				}
 
+				if (strcmp(idx, "bulk_handle") == 0) {
+					// pointer to this for the FFI functions used by aegisub.lines
+					lua_pushlightuserdata(L, this);
+					return 1;
+				}
+
 				lua_pushvalue(L, 1);
 				if (strcmp(idx, "delete") == 0)
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectDelete, false>, 1);
@@ -407,6 +665,25 @@ namespace Automation4 {
 		auto group = e->Group();
 		if (group == AssEntryGroup::INFO)
 			InitScriptInfoIfNeeded();
+
+		auto old = lines[idx];
+		if (!lines_restructured && old && check_cast_constptr<AssDialogue>(old) && check_cast_constptr<AssDialogue>(e.get())) {
+			auto it = replacement_index.find(old);
+			if (it != replacement_index.end()) {
+				// Replacing a replacement still only changes the original line
+				size_t i = it->second;
+				replacement_index.erase(it);
+				replacements[i].second = static_cast<AssDialogue *>(e.get());
+				replacement_index[e.get()] = i;
+			}
+			else {
+				replacement_index[e.get()] = replacements.size();
+				replacements.emplace_back(static_cast<AssDialogue *>(old), static_cast<AssDialogue *>(e.get()));
+			}
+		}
+		else
+			lines_restructured = true;
+
 		lines[idx] = e.get();
 		if (group == AssEntryGroup::INFO)
 			lines_to_delete.emplace_back(std::move(e));
@@ -414,16 +691,16 @@ namespace Automation4 {
 			e.release();
 	}
 
-	void LuaAssFile::InsertLine(std::vector<AssEntry *> &vec, size_t idx, std::unique_ptr<AssEntry> e)
+	AssEntry *LuaAssFile::AdoptLine(std::unique_ptr<AssEntry> e)
 	{
-		auto group = e->Group();
-		if (group == AssEntryGroup::INFO)
+		auto ret = e.get();
+		if (e->Group() == AssEntryGroup::INFO) {
 			InitScriptInfoIfNeeded();
-		vec.insert(vec.begin() + idx, e.get());
-		if (group == AssEntryGroup::INFO)
 			lines_to_delete.emplace_back(std::move(e));
+		}
 		else
 			e.release();
+		return ret;
 	}
 
 	void LuaAssFile::ObjectIndexWrite(lua_State *L)
@@ -453,10 +730,21 @@ namespace Automation4 {
 				// insert
 				CheckBounds(n);
 
-				auto e = LuaToAssEntry(L, ass);
+				std::unique_ptr<AssEntry> e;
+				if (auto orig = TrackedDialogue(L, n - 1)) {
+					// Writing back a line read from this index only needs to
+					// copy the fields which have been changed, if any
+					e = UpdateDialogue(L, *orig);
+					if (!e) return;
+				}
+				else
+					e = LuaToAssEntry(L, ass);
+
 				modification_type |= modification_mask(e.get());
 				QueueLineForDeletion(n - 1);
 				AssignLine(n - 1, std::move(e));
+				if (lua_istable(L, -1) && lines[n - 1])
+					TrackLine(L, lines[n - 1]);
 			}
 			else {
 				// delete
@@ -501,20 +789,22 @@ namespace Automation4 {
 		}
 
 		sort(ids.begin(), ids.end());
-
-		size_t id_idx = 0, out = 0;
-		for (size_t i = 0; i < lines.size(); ++i) {
-			if (id_idx < ids.size() && ids[id_idx] == i) {
-				modification_type |= modification_mask(lines[i]);
-				QueueLineForDeletion(i);
-				++id_idx;
-			}
-			else {
-				lines[out++] = lines[i];
+		ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+		// Delete from the back so that the earlier indices stay valid, and
+		// merge adjacent lines into a single erase
+		for (size_t i = ids.size(); i > 0; ) {
+			size_t last = ids[--i] + 1;
+			while (i > 0 && ids[i - 1] + 1 == ids[i]) --i;
+			size_t first = ids[i];
+
+			lines_restructured = true;
+			for (size_t j = first; j < last; ++j) {
+				modification_type |= modification_mask(lines[j]);
+				QueueLineForDeletion(j);
 			}
+			lines.erase(first, last);
 		}
-
-		lines.erase(lines.begin() + out, lines.end());
 	}
 
 	void LuaAssFile::ObjectDeleteRange(lua_State *L)
@@ -526,12 +816,13 @@ namespace Automation4 {
 
 		if (a >= b) return;
 
+		lines_restructured = true;
 		for (size_t i = a; i < b; ++i) {
 			modification_type |= modification_mask(lines[i]);
 			QueueLineForDeletion(i);
 		}
 
-		lines.erase(lines.begin() + a, lines.begin() + b);
+		lines.erase(a, b);
 	}
 
 	void LuaAssFile::ObjectAppend(lua_State *L)
@@ -544,9 +835,10 @@ namespace Automation4 {
 			lua_pushvalue(L, i);
 			auto e = LuaToAssEntry(L, ass);
 			modification_type |= modification_mask(e.get());
+			lines_restructured = true;
 
 			if (lines.empty()) {
-				InsertLine(lines, 0, std::move(e));
+				lines.insert(0, AdoptLine(std::move(e)));
 				continue;
 			}
 
@@ -555,13 +847,13 @@ namespace Automation4 {
 			for (size_t i = lines.size(); i > 0; --i) {
 				auto cur_group = lines[i - 1] ? lines[i - 1]->Group() : AssEntryGroup::INFO;
 				if (cur_group == group) {
-					InsertLine(lines, i, std::move(e));
+					lines.insert(i, AdoptLine(std::move(e)));
 					break;
 				}
 			}
 
 			// No lines of this type exist already, so just append it to the end
-			if (e) InsertLine(lines, lines.size(), std::move(e));
+			if (e) lines.push_back(AdoptLine(std::move(e)));
 		}
 	}
 
@@ -588,14 +880,19 @@ namespace Automation4 {
 			lua_pushvalue(L, i);
 			auto e = LuaToAssEntry(L, ass);
 			modification_type |= modification_mask(e.get());
-			InsertLine(new_entries, i - 2, std::move(e));
+			lines_restructured = true;
+			new_entries.push_back(AdoptLine(std::move(e)));
 			lua_pop(L, 1);
 		}
-		lines.insert(lines.begin() + before - 1, new_entries.begin(), new_entries.end());
+		lines.insert(before - 1, new_entries.begin(), new_entries.end());
 	}
 
 	void LuaAssFile::ObjectGarbageCollect(lua_State *L)
 	{
+		lua_pushlightuserdata(L, this);
+		lua_pushnil(L);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+
 		references--;
 		if (!references) delete this;
 		LOG_D("automation/lua") << "Garbage collected LuaAssFile";
@@ -678,9 +975,267 @@ namespace Automation4 {
 
 			back.modification_type = modification_type;
 			back.mesage = to_wx(check_string(L, 1));
-			back.lines = lines;
+			back.restructured = lines_restructured;
+			if (lines_restructured)
+				back.lines = lines.Lines();
+			else
+				back.replacements = std::move(replacements);
 			modification_type = 0;
+			replacements.clear();
+			replacement_index.clear();
+			lines_restructured = false;
+		}
+	}
+
+	int LuaAssFile::BulkRead(LuaAssFile *file, size_t first, size_t count, agi_lua_dialogue *out)
+	{
+		if (file->references < 2) return -1;
+		if (first >= file->lines.size()) return 0;
+		count = std::min(count, file->lines.size() - first);
+
+		for (size_t i = 0; i < count; ++i) {
+			auto& row = out[i];
+			row = agi_lua_dialogue();
+
+			auto line = file->lines[first + i];
+			auto dia = line ? check_cast_constptr<AssDialogue>(line) : nullptr;
+			if (!dia) continue;
+
+			// The strings point into the line, which isn't deleted until the
+			// script finishes running even if it is replaced
+			row.index = static_cast<int>(first + i + 1);
+			row.comment = dia->Comment;
+			row.layer = dia->Layer;
+			row.start_time = dia->Start;
+			row.end_time = dia->End;
+			row.margin_l = dia->Margin[0];
+			row.margin_r = dia->Margin[1];
+			row.margin_t = dia->Margin[2];
+			row.style = dia->Style.get().c_str();
+			row.actor = dia->Actor.get().c_str();
+			row.effect = dia->Effect.get().c_str();
+			row.text = dia->Text.get().c_str();
+		}
+		return static_cast<int>(count);
+	}
+
+	int LuaAssFile::BulkWrite(LuaAssFile *file, const agi_lua_dialogue *rows, size_t count)
+	{
+		if (file->references < 2) return BULK_EXPIRED;
+		if (!file->can_modify) return BULK_READ_ONLY;
+
+		// Check everything before changing anything so that a bad row doesn't
+		// leave the batch half-applied
+		for (size_t i = 0; i < count; ++i) {
+			auto const& row = rows[i];
+			if (row.index <= 0 || row.index > (int)file->lines.size())
+				return BULK_BAD_INDEX;
+			auto line = file->lines[row.index - 1];
+			if (!line || !check_cast_constptr<AssDialogue>(line))
+				return BULK_BAD_INDEX;
+			if (((row.modified & BULK_STYLE) && !row.style) ||
+				((row.modified & BULK_ACTOR) && !row.actor) ||
+				((row.modified & BULK_EFFECT) && !row.effect) ||
+				((row.modified & BULK_TEXT) && !row.text))
+				return BULK_NULL_STRING;
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			auto const& row = rows[i];
+			if (!row.modified) continue;
+
+			size_t idx = row.index - 1;
+			auto dia = agi::make_unique<AssDialogue>(*static_cast<AssDialogue *>(file->lines[idx]));
+			if (row.modified & BULK_COMMENT)    dia->Comment = !!row.comment;
+			if (row.modified & BULK_LAYER)      dia->Layer = row.layer;
+			if (row.modified & BULK_START_TIME) dia->Start = row.start_time;
+			if (row.modified & BULK_END_TIME)   dia->End = row.end_time;
+			if (row.modified & BULK_MARGIN_L)   dia->Margin[0] = row.margin_l;
+			if (row.modified & BULK_MARGIN_R)   dia->Margin[1] = row.margin_r;
+			if (row.modified & BULK_MARGIN_T)   dia->Margin[2] = row.margin_t;
+			if (row.modified & BULK_STYLE)      dia->Style = row.style;
+			if (row.modified & BULK_ACTOR)      dia->Actor = row.actor;
+			if (row.modified & BULK_EFFECT)     dia->Effect = row.effect;
+			if (row.modified & BULK_TEXT)       dia->Text = row.text;
+
+			file->modification_type |= modification_mask(dia.get());
+			file->QueueLineForDeletion(idx);
+			file->AssignLine(idx, std::move(dia));
+		}
+		return 0;
+	}
+
+	int LuaAssFile::KaraokeLayout(LuaAssFile *file, size_t index, double x_factor, agi_lua_karaoke_line *line, agi_lua_syllable *syls, size_t max)
+	{
+		if (file->references < 2) return KARAOKE_EXPIRED;
+		if (index < 1 || index > file->lines.size()) return KARAOKE_BAD_INDEX;
+		auto dia = file->lines[index - 1] ? check_cast_constptr<AssDialogue>(file->lines[index - 1]) : nullptr;
+		if (!dia) return KARAOKE_BAD_INDEX;
+
+		// Use the style as the script currently has it, falling back to the
+		// first style like karaskel does
+		AssStyle *style = nullptr;
+		for (size_t i = 0; i < file->lines.size(); ++i) {
+			auto e = file->lines[i];
+			if (!e) continue;
+			if (e->Group() == AssEntryGroup::DIALOGUE) break;
+			auto sty = dynamic_cast<AssStyle *>(e);
+			if (!sty) continue;
+			if (!style) style = sty;
+			if (sty->name == dia->Style.get()) {
+				style = sty;
+				break;
+			}
+		}
+		if (!style) return KARAOKE_NO_STYLE;
+
+		struct Syllable {
+			int start_time = 0, end_time = 0, highlights = 0;
+			std::string tag, text, prespace, spacestripped, postspace, inline_fx;
+		};
+		// karaskel's zeroth syllable is the empty one parse_karaoke_data adds
+		std::vector<Syllable> merged(1);
+		merged[0].highlights = 1;
+
+		std::string cur_inline_fx;
+		AssKaraoke kara(dia, false, false);
+		for (auto const& syl : kara) {
+			auto text = syl.GetText(false);
+			auto fx = inline_fx(text);
+			if (!fx.empty()) cur_inline_fx = std::move(fx);
+
+			size_t begin = syl.text.find_first_not_of(" \t");
+			if (begin == std::string::npos) begin = syl.text.size();
+			size_t end = syl.text.find_last_not_of(" \t");
+			end = end == std::string::npos || end < begin ? begin : end + 1;
+
+			int start_time = syl.start_time - dia->Start;
+			int end_time = start_time + syl.duration;
+
+			auto spacestripped = syl.text.substr(begin, end - begin);
+			if (is_multi_highlight(spacestripped)) {
+				merged.back().end_time = end_time;
+				++merged.back().highlights;
+				continue;
+			}
+
+			merged.emplace_back();
+			auto& out = merged.back();
+			out.start_time = start_time;
+			out.end_time = end_time;
+			out.highlights = 1;
+			out.tag = syl.tag_type;
+			out.text = std::move(text);
+			out.prespace = syl.text.substr(0, begin);
+			out.spacestripped = std::move(spacestripped);
+			out.postspace = syl.text.substr(end);
+			out.inline_fx = cur_inline_fx;
+		}
+
+		std::string text_stripped;
+		for (auto const& syl : merged)
+			text_stripped += syl.prespace + syl.spacestripped + syl.postspace;
+
+		// Measure everything in one batch so that the font is only set up once
+		std::vector<std::string> texts;
+		texts.reserve(merged.size() * 3 + 1);
+		texts.push_back(text_stripped);
+		for (auto const& syl : merged) {
+			texts.push_back(syl.spacestripped);
+			texts.push_back(syl.prespace);
+			texts.push_back(syl.postspace);
+		}
+		std::vector<TextExtents> extents;
+		CalculateTextExtents(style, texts, extents);
+		extents.resize(texts.size());
+
+		auto& strings = file->karaoke_strings;
+		strings.clear();
+		auto store = [&](std::string str) -> const char * {
+			strings.emplace_back(std::move(str));
+			return strings.back().c_str();
+		};
+
+		*line = agi_lua_karaoke_line();
+		line->duration = dia->End - dia->Start;
+		line->syllable_count = static_cast<int>(merged.size());
+		line->width = extents[0].width * x_factor;
+		line->height = extents[0].height;
+		line->descent = extents[0].descent;
+		line->extlead = extents[0].extlead;
+		line->text_stripped = store(std::move(text_stripped));
+
+		double x = 0;
+		for (size_t i = 0; i < merged.size(); ++i) {
+			auto& syl = merged[i];
+			auto const& size = extents[i * 3 + 1];
+			double prespacewidth = extents[i * 3 + 2].width * x_factor;
+			double postspacewidth = extents[i * 3 + 3].width * x_factor;
+			double left = x + prespacewidth;
+			x = left + size.width * x_factor + postspacewidth;
+
+			if (i >= max) continue;
+			auto& out = syls[i];
+			out = agi_lua_syllable();
+			out.start_time = syl.start_time;
+			out.end_time = syl.end_time;
+			out.duration = syl.end_time - syl.start_time;
+			out.highlights = syl.highlights;
+			out.width = size.width * x_factor;
+			out.height = size.height;
+			out.prespacewidth = prespacewidth;
+			out.postspacewidth = postspacewidth;
+			out.left = left;
+			out.center = left + out.width / 2;
+			out.right = left + out.width;
+			out.tag = store(std::move(syl.tag));
+			out.text = store(std::move(syl.text));
+			out.text_stripped = store(syl.prespace + syl.spacestripped + syl.postspace);
+			out.text_spacestripped = store(std::move(syl.spacestripped));
+			out.prespace = store(std::move(syl.prespace));
+			out.postspace = store(std::move(syl.postspace));
+			out.inline_fx = store(std::move(syl.inline_fx));
+		}
+
+		// Position the line within the video the same way as karaskel
+		int res_x, res_y;
+		file->ass->GetResolution(res_x, res_y);
+		line->eff_margin_l = dia->Margin[0] > 0 ? dia->Margin[0] : style->Margin[0];
+		line->eff_margin_r = dia->Margin[1] > 0 ? dia->Margin[1] : style->Margin[1];
+		line->eff_margin_v = dia->Margin[2] > 0 ? dia->Margin[2] : style->Margin[2];
+
+		switch (style->alignment % 3) {
+			case 1: line->left = line->eff_margin_l; break;
+			case 2: line->left = (res_x - line->eff_margin_l - line->eff_margin_r - line->width) / 2 + line->eff_margin_l; break;
+			default: line->left = res_x - line->eff_margin_r - line->width; break;
+		}
+		line->center = line->left + line->width / 2;
+		line->right = line->left + line->width;
+
+		if (style->alignment <= 3) {
+			line->bottom = res_y - line->eff_margin_v;
+			line->top = line->bottom - line->height;
 		}
+		else if (style->alignment <= 6) {
+			line->top = (res_y - 2 * line->eff_margin_v - line->height) / 2 + line->eff_margin_v;
+			line->bottom = line->top + line->height;
+		}
+		else {
+			line->top = line->eff_margin_v;
+			line->bottom = line->top + line->height;
+		}
+		line->middle = line->top + line->height / 2;
+
+		return line->syllable_count;
+	}
+
+	int LuaAssFile::InitBulkLib(lua_State *L)
+	{
+		agi::lua::register_lib_table(L, {"agi_lua_ass_file", "agi_lua_dialogue", "agi_lua_karaoke_line", "agi_lua_syllable"},
+			"read", BulkRead,
+			"write", BulkWrite,
+			"karaoke", KaraokeLayout);
+		return 1;
 	}
 
 	LuaAssFile *LuaAssFile::GetObjPointer(lua_State *L, int idx, bool allow_expired)
@@ -711,21 +1266,54 @@ namespace Automation4 {
 				}
 			}
 		};
+
+		// If only existing dialogue lines were replaced, swap the new lines
+		// into the file in place and commit just those lines
+		std::vector<AssDialogue *> changed;
+		auto apply_replacements = [&](std::vector<Replacement> const& replacements) -> int {
+			int type = 0;
+			changed.clear();
+			for (auto const& r : replacements) {
+				auto old = r.first, line = r.second;
+				line->Row = old->Row;
+				auto it = ass->iterator_to(*old);
+				ass->Events.insert(it, *line);
+				ass->Events.erase(it);
+
+				if (int line_type = changed_fields(*old, *line)) {
+					type |= line_type;
+					changed.push_back(line);
+				}
+			}
+			return type;
+		};
+
 		// Apply any pending commits
 		for (auto const& pc : pending_commits) {
-			apply_lines(pc.lines);
-			ass->Commit(pc.mesage, pc.modification_type);
+			if (pc.restructured) {
+				apply_lines(pc.lines);
+				ass->Commit(pc.mesage, pc.modification_type);
+			}
+			else if (int type = apply_replacements(pc.replacements))
+				ass->Commit(pc.mesage, type, -1, changed);
 		}
 
 		// Commit any changes after the last undo point was set
-		if (modification_type)
-			apply_lines(lines);
-		if (modification_type && can_set_undo && !undo_description.empty())
-			ass->Commit(undo_description, modification_type);
+		auto ret = lines.Lines();
+		int type = modification_type;
+		if (type && lines_restructured)
+			apply_lines(ret);
+		else if (type)
+			type = apply_replacements(replacements);
+		if (type && can_set_undo && !undo_description.empty()) {
+			if (lines_restructured)
+				ass->Commit(undo_description, type);
+			else
+				ass->Commit(undo_description, type, -1, changed);
+		}
 
 		lines_to_delete.clear();
 
-		auto ret = std::move(lines);
 		references--;
 		if (!references) delete this;
 		return ret;
@@ -751,6 +1339,16 @@ namespace Automation4 {
 		for (auto& line : ass->Events)
 			lines.push_back(&line);
 
+		// weak-keyed table mapping the line tables given to the script to
+		// the lines they were made from, so that writing back an unmodified
+		// line can be skipped
+		lua_pushlightuserdata(L, this);
+		lua_createtable(L, 0, 0);
+		lua_createtable(L, 0, 1);
+		set_field(L, "__mode", "k");
+		lua_setmetatable(L, -2);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+
 		// prepare userdata object
 		*static_cast<LuaAssFile**>(lua_newuserdata(L, sizeof(LuaAssFile*))) = this;
 
@@ -205,6 +205,11 @@ namespace Automation4 {
 		bool multiple = !!lua_toboolean(L, 5);
 		bool must_exist = lua_toboolean(L, 6) || lua_isnil(L, 6);
 
+		if (!ps->CanShowDialogs()) {
+			lua_pushnil(L);
+			return 1;
+		}
+
 		int flags = wxFD_OPEN;
 		if (multiple)
 			flags |= wxFD_MULTIPLE;
@@ -243,6 +248,11 @@ namespace Automation4 {
 		wxString wildcard(check_wxstring(L, 4));
 		bool prompt_overwrite = !lua_toboolean(L, 5);
 
+		if (!ps->CanShowDialogs()) {
+			lua_pushnil(L);
+			return 1;
+		}
+
 		int flags = wxFD_SAVE;
 		if (prompt_overwrite)
 			flags |= wxFD_OVERWRITE_PROMPT;
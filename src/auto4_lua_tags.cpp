@@ -0,0 +1,237 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file auto4_lua_tags.cpp
+/// @brief Override tag parsing for the aegisub.tags module
+/// @ingroup scripting
+
+#include "auto4_lua.h"
+
+#include "ass_dialogue.h"
+
+#include <libaegisub/lua/ffi.h>
+#include <libaegisub/make_unique.h>
+
+#include <algorithm>
+
+/// A line's text split into blocks, with the override blocks split into
+/// tags. Indices passed in from Lua are zero-based.
+struct agi_lua_tags {
+	std::vector<std::unique_ptr<AssDialogueBlock>> blocks;
+	/// Storage for the most recently returned string, which Lua copies
+	/// before making another call
+	std::string result;
+};
+
+namespace agi {
+	AGI_DEFINE_TYPE_NAME(agi_lua_tags);
+}
+
+namespace {
+	AssDialogueBlockOverride *override_block(agi_lua_tags *tags, size_t block)
+	{
+		if (block >= tags->blocks.size()) return nullptr;
+		if (tags->blocks[block]->GetType() != AssBlockType::OVERRIDE) return nullptr;
+		return static_cast<AssDialogueBlockOverride *>(tags->blocks[block].get());
+	}
+
+	AssOverrideTag *get_tag(agi_lua_tags *tags, size_t block, size_t tag)
+	{
+		auto ovr = override_block(tags, block);
+		if (!ovr || tag >= ovr->Tags.size()) return nullptr;
+		return &ovr->Tags[tag];
+	}
+
+	const char *result(agi_lua_tags *tags, std::string str)
+	{
+		tags->result = std::move(str);
+		return tags->result.c_str();
+	}
+
+	agi_lua_tags *parse(const char *text)
+	{
+		auto tags = new agi_lua_tags;
+		tags->blocks = AssDialogue::ParseTags(text);
+		return tags;
+	}
+
+	void free_tags(agi_lua_tags *tags)
+	{
+		delete tags;
+	}
+
+	const char *get_text(agi_lua_tags *tags)
+	{
+		std::string text;
+		for (auto& block : tags->blocks)
+			text += block->GetText();
+		return result(tags, std::move(text));
+	}
+
+	size_t block_count(agi_lua_tags *tags)
+	{
+		return tags->blocks.size();
+	}
+
+	/// @return The block's AssBlockType, or -1 if there's no such block
+	int block_type(agi_lua_tags *tags, size_t block)
+	{
+		if (block >= tags->blocks.size()) return -1;
+		return static_cast<int>(tags->blocks[block]->GetType());
+	}
+
+	const char *block_text(agi_lua_tags *tags, size_t block)
+	{
+		if (block >= tags->blocks.size()) return nullptr;
+		return result(tags, tags->blocks[block]->GetText());
+	}
+
+	/// @return Number of tags in the block, which is zero for blocks which
+	///         aren't override blocks
+	size_t tag_count(agi_lua_tags *tags, size_t block)
+	{
+		auto ovr = override_block(tags, block);
+		return ovr ? ovr->Tags.size() : 0;
+	}
+
+	const char *tag_name(agi_lua_tags *tags, size_t block, size_t tag)
+	{
+		auto t = get_tag(tags, block, tag);
+		return t ? t->Name.c_str() : nullptr;
+	}
+
+	size_t param_count(agi_lua_tags *tags, size_t block, size_t tag)
+	{
+		auto t = get_tag(tags, block, tag);
+		return t ? t->Params.size() : 0;
+	}
+
+	/// @return The parameter's text, or null if it was omitted
+	const char *get_param(agi_lua_tags *tags, size_t block, size_t tag, size_t param)
+	{
+		auto t = get_tag(tags, block, tag);
+		if (!t || param >= t->Params.size() || t->Params[param].omitted) return nullptr;
+		return result(tags, t->Params[param].Get<std::string>());
+	}
+
+	/// @return 1 if the parameter was set, or 0 if there's no such parameter
+	int set_param(agi_lua_tags *tags, size_t block, size_t tag, size_t param, const char *value)
+	{
+		auto t = get_tag(tags, block, tag);
+		if (!t || param >= t->Params.size()) return 0;
+		t->Params[param].Set<std::string>(value);
+		return 1;
+	}
+
+	/// Find the last tag with the given name, which is the one which takes
+	/// effect for the end of the line
+	/// @return 1 if one was found, or 0 if not
+	int find_last(agi_lua_tags *tags, const char *name, size_t *block, size_t *tag)
+	{
+		for (size_t i = tags->blocks.size(); i > 0; --i) {
+			auto ovr = override_block(tags, i - 1);
+			if (!ovr) continue;
+			for (size_t j = ovr->Tags.size(); j > 0; --j) {
+				if (ovr->Tags[j - 1].Name == name) {
+					*block = i - 1;
+					*tag = j - 1;
+					return 1;
+				}
+			}
+		}
+		return 0;
+	}
+
+	/// Replace every tag with the same name as text (such as "\pos(1,2)")
+	/// with it, or add it to the start of the line if there aren't any
+	/// @return Number of tags replaced, or -1 if text isn't a known tag
+	int set_tag(agi_lua_tags *tags, const char *text)
+	{
+		AssOverrideTag tag(text);
+		if (!tag.IsValid()) return -1;
+
+		int replaced = 0;
+		for (size_t i = 0; i < tags->blocks.size(); ++i) {
+			auto ovr = override_block(tags, i);
+			if (!ovr) continue;
+			for (auto& t : ovr->Tags) {
+				if (t.Name == tag.Name) {
+					t.SetText(text);
+					++replaced;
+				}
+			}
+		}
+
+		if (!replaced) {
+			auto ovr = override_block(tags, 0);
+			if (!ovr) {
+				tags->blocks.insert(tags->blocks.begin(), agi::make_unique<AssDialogueBlockOverride>());
+				ovr = override_block(tags, 0);
+			}
+			ovr->Tags.push_back(std::move(tag));
+		}
+		return replaced;
+	}
+
+	/// Remove every tag with the given name, along with any override blocks
+	/// which are left empty
+	/// @return Number of tags removed
+	int remove_tag(agi_lua_tags *tags, const char *name)
+	{
+		int removed = 0;
+		for (size_t i = 0; i < tags->blocks.size(); ) {
+			auto ovr = override_block(tags, i);
+			if (!ovr) {
+				++i;
+				continue;
+			}
+
+			auto& t = ovr->Tags;
+			auto it = std::remove_if(t.begin(), t.end(), [&](AssOverrideTag const& tag) { return tag.Name == name; });
+			const bool changed = it != t.end();
+			removed += std::distance(it, t.end());
+			t.erase(it, t.end());
+
+			if (changed && t.empty())
+				tags->blocks.erase(tags->blocks.begin() + i);
+			else
+				++i;
+		}
+		return removed;
+	}
+}
+
+namespace Automation4 {
+	int LuaInitTagsLib(lua_State *L)
+	{
+		agi::lua::register_lib_table(L, {"agi_lua_tags"},
+			"parse", parse,
+			"free", free_tags,
+			"text", get_text,
+			"block_count", block_count,
+			"block_type", block_type,
+			"block_text", block_text,
+			"tag_count", tag_count,
+			"tag_name", tag_name,
+			"param_count", param_count,
+			"get_param", get_param,
+			"set_param", set_param,
+			"find_last", find_last,
+			"set_tag", set_tag,
+			"remove_tag", remove_tag);
+		return 1;
+	}
+}
@@ -49,8 +49,10 @@
 #include <libaegisub/util.h>
 
 #include <algorithm>
+#include <cstdlib>
 
-#include <wx/dcbuffer.h>
+#include <wx/dcclient.h>
+#include <wx/dcmemory.h>
 #include <wx/menu.h>
 #include <wx/scrolbar.h>
 #include <wx/sizer.h>
@@ -90,7 +92,7 @@ BaseGrid::BaseGrid(wxWindow* parent, agi::Context *context)
 		context->ass->AddCommitListener(&BaseGrid::OnSubtitlesCommit, this),
 
 		context->selectionController->AddActiveLineListener(&BaseGrid::OnActiveLineChanged, this),
-		context->selectionController->AddSelectionListener([&]{ Refresh(false); }),
+		context->selectionController->AddSelectionListener([&]{ Redraw(); }),
 
 		OPT_SUB("Subtitle/Grid/Font Face", &BaseGrid::UpdateStyle, this),
 		OPT_SUB("Subtitle/Grid/Font Size", &BaseGrid::UpdateStyle, this),
@@ -108,10 +110,11 @@ BaseGrid::BaseGrid(wxWindow* parent, agi::Context *context)
 		OPT_SUB("Colour/Subtitle Grid/Standard", &BaseGrid::UpdateStyle, this),
 
 		OPT_SUB("Subtitle/Grid/Highlight Subtitles in Frame", &BaseGrid::OnHighlightVisibleChange, this),
-		OPT_SUB("Subtitle/Grid/Hide Overrides", [&](agi::OptionValue const&) { Refresh(false); }),
+		OPT_SUB("Subtitle/Grid/Hide Overrides", [&](agi::OptionValue const&) { Redraw(); }),
 	});
 
 	Bind(wxEVT_CONTEXT_MENU, &BaseGrid::OnContextMenu, this);
+	Bind(wxEVT_IDLE, &BaseGrid::OnIdle, this);
 }
 
 BaseGrid::~BaseGrid() { }
@@ -131,15 +134,16 @@ void BaseGrid::OnSubtitlesCommit(int type) {
 		UpdateMaps();
 
 	if (type & AssFile::COMMIT_DIAG_META) {
-		SetColumnWidths();
-		Refresh(false);
+		auto const& changed = context->ass->ChangedLines();
+		SetColumnWidths(changed.empty() ? nullptr : &changed);
+		Redraw();
 		return;
 	}
 	if (type & AssFile::COMMIT_DIAG_TIME)
-		Refresh(false);
+		Redraw();
 	else if (type & AssFile::COMMIT_DIAG_TEXT) {
 		for (auto const& rect : text_refresh_rects)
-			RefreshRect(rect, false);
+			Redraw(rect);
 	}
 }
 
@@ -154,11 +158,13 @@ void BaseGrid::OnShowColMenu(wxCommandEvent &event) {
 
 	SetColumnWidths();
 
-	Refresh(false);
+	Redraw();
 }
 
 void BaseGrid::OnHighlightVisibleChange(agi::OptionValue const& opt) {
-	if (opt.GetBool())
+	highlight_visible = opt.GetBool();
+	Redraw();
+	if (highlight_visible)
 		seek_listener.Unblock();
 	else
 		seek_listener.Block();
@@ -186,10 +192,17 @@ void BaseGrid::UpdateStyle() {
 	row_colors.SelectedComment.SetColour(to_wx(OPT_GET("Colour/Subtitle Grid/Background/Selected Comment")->GetColor()));
 	row_colors.LeftCol.SetColour(to_wx(OPT_GET("Colour/Subtitle Grid/Left Column")->GetColor()));
 
+	// Set text colors and pens
+	text_colors.Standard = to_wx(OPT_GET("Colour/Subtitle Grid/Standard")->GetColor());
+	text_colors.Selection = to_wx(OPT_GET("Colour/Subtitle Grid/Selection")->GetColor());
+	text_colors.Collision = to_wx(OPT_GET("Colour/Subtitle Grid/Collision")->GetColor());
+	grid_pen = wxPen(to_wx(OPT_GET("Colour/Subtitle Grid/Lines")->GetColor()));
+	active_border_pen = wxPen(to_wx(OPT_GET("Colour/Subtitle Grid/Active Border")->GetColor()));
+
 	SetColumnWidths();
 
 	AdjustScrollbar();
-	Refresh(false);
+	Redraw();
 }
 
 void BaseGrid::UpdateMaps() {
@@ -200,7 +213,7 @@ void BaseGrid::UpdateMaps() {
 
 	SetColumnWidths();
 	AdjustScrollbar();
-	Refresh(false);
+	Redraw();
 }
 
 void BaseGrid::OnActiveLineChanged(AssDialogue *new_active) {
@@ -208,7 +221,7 @@ void BaseGrid::OnActiveLineChanged(AssDialogue *new_active) {
 		if (new_active->Row != active_row)
 			MakeRowVisible(new_active->Row);
 		extendRow = active_row = new_active->Row;
-		Refresh(false);
+		Redraw();
 	}
 	else
 		active_row = -1;
@@ -252,59 +265,121 @@ void BaseGrid::OnSeek() {
 	for (int i : boost::irange(yPos, yPos + lines)) {
 		if (IsDisplayed(index_line_map[i])) {
 			if (it == end(visible_rows) || *it != i) {
-				Refresh(false);
+				Redraw();
 				return;
 			}
 			++it;
 		}
 	}
 	if (it != end(visible_rows))
-		Refresh(false);
+		Redraw();
+}
+
+void BaseGrid::Redraw() {
+	dirty_rect = wxRect(GetClientSize());
+	Refresh(false);
+}
+
+void BaseGrid::Redraw(wxRect const& rect) {
+	dirty_rect.Union(rect);
+	RefreshRect(rect, false);
+}
+
+void BaseGrid::ScrollBuffer(int w, int h) {
+	// Distance in pixels that the rows move down by
+	const int delta = (buffer_y_pos - yPos) * lineHeight;
+	const int body_top = lineHeight + 1;
+	const int body_height = h - body_top;
+	if (std::abs(delta) >= body_height) {
+		dirty_rect = wxRect(0, 0, w, h);
+		return;
+	}
+
+	if (!scroll_buffer.IsOk())
+		scroll_buffer.CreateScaled(w, h, -1, GetContentScaleFactor());
+
+	{
+		wxMemoryDC src(buffer);
+		wxMemoryDC dst(scroll_buffer);
+		dst.Blit(0, 0, w, body_top, &src, 0, 0);
+		dst.Blit(0, body_top + std::max(0, delta), w, body_height - std::abs(delta),
+			&src, 0, body_top + std::max(0, -delta));
+	}
+	std::swap(buffer, scroll_buffer);
+
+	// Draw the rows which have scrolled into view, plus the line between
+	// them and the rows which were moved
+	if (delta > 0)
+		dirty_rect.Union(wxRect(0, lineHeight, w, delta + 2));
+	else
+		dirty_rect.Union(wxRect(0, h + delta - 1, w, 1 - delta));
 }
 
 void BaseGrid::OnPaint(wxPaintEvent &) {
+	wxPaintDC dc(this);
+
+	int w = 0;
+	int h = 0;
+	GetClientSize(&w,&h);
+	w -= scrollBar->GetSize().GetWidth();
+	if (w <= 0 || h <= 0) return;
+
+	const int nDraw = mid(0, h/lineHeight + 1, GetRows() - yPos);
+	visible_rows.clear();
+	if (highlight_visible) {
+		for (int i : agi::util::range(nDraw)) {
+			if (IsDisplayed(index_line_map[i + yPos]))
+				visible_rows.push_back(i + yPos);
+		}
+	}
+
+	// Rows which are already drawn in the buffer are reused, so that
+	// scrolling only has to draw the rows scrolled into view
+	if (!buffer.IsOk() || buffer.GetScaledWidth() != w || buffer.GetScaledHeight() != h) {
+		buffer.CreateScaled(w, h, -1, GetContentScaleFactor());
+		scroll_buffer = wxBitmap();
+		dirty_rect = wxRect(0, 0, w, h);
+	}
+	else if (buffer_y_pos != yPos)
+		ScrollBuffer(w, h);
+	buffer_y_pos = yPos;
+
+	dirty_rect.Intersect(wxRect(0, 0, w, h));
+	if (!dirty_rect.IsEmpty()) {
+		wxMemoryDC buffer_dc(buffer);
+		buffer_dc.SetClippingRegion(dirty_rect);
+		DrawRows(buffer_dc, w, h, nDraw);
+		dirty_rect = wxRect();
+	}
+
+	dc.DrawBitmap(buffer, 0, 0);
+}
+
+void BaseGrid::DrawRows(wxDC &dc, int w, int h, int nDraw) {
 	// Find which columns need to be repainted
 	std::vector<char> paint_columns;
 	paint_columns.resize(columns.size(), false);
-	bool any = false;
-	for (wxRegionIterator region(GetUpdateRegion()); region; ++region) {
-		wxRect updrect = region.GetRect();
+	{
 		int x = 0;
 		for (size_t i : agi::util::range(columns.size())) {
 			int width = columns[i]->Width();
-			if (width && updrect.x < x + width && updrect.x + updrect.width > x) {
+			if (width && dirty_rect.x < x + width && dirty_rect.x + dirty_rect.width > x)
 				paint_columns[i] = true;
-				any = true;
-			}
 			x += width;
 		}
 	}
 
-	if (!any) return;
-
-	int w = 0;
-	int h = 0;
-	GetClientSize(&w,&h);
-	w -= scrollBar->GetSize().GetWidth();
-
-	wxAutoBufferedPaintDC dc(this);
 	dc.SetFont(font);
 
-	dc.SetBackground(row_colors.Default);
-	dc.Clear();
+	dc.SetPen(*wxTRANSPARENT_PEN);
+	dc.SetBrush(row_colors.Default);
+	dc.DrawRectangle(0, 0, w, h);
 
 	// Draw labels
-	dc.SetPen(*wxTRANSPARENT_PEN);
 	dc.SetBrush(row_colors.LeftCol);
 	dc.DrawRectangle(0, lineHeight, columns[0]->Width(), h-lineHeight);
 
-	// Row colors
-	wxColour text_standard(to_wx(OPT_GET("Colour/Subtitle Grid/Standard")->GetColor()));
-	wxColour text_selection(to_wx(OPT_GET("Colour/Subtitle Grid/Selection")->GetColor()));
-	wxColour text_collision(to_wx(OPT_GET("Colour/Subtitle Grid/Collision")->GetColor()));
-
 	// First grid row
-	wxPen grid_pen(to_wx(OPT_GET("Colour/Subtitle Grid/Lines")->GetColor()));
 	dc.SetPen(grid_pen);
 	dc.DrawLine(0, 0, w, 0);
 	dc.SetPen(*wxTRANSPARENT_PEN);
@@ -320,8 +395,8 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 	};
 
 	// Paint header
-	{
-		dc.SetTextForeground(text_standard);
+	if (dirty_rect.y <= lineHeight) {
+		dc.SetTextForeground(text_colors.Standard);
 		dc.SetBrush(row_colors.Header);
 		dc.DrawRectangle(0, 0, w, lineHeight);
 
@@ -337,15 +412,16 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 	}
 
 	// Paint the rows
-	const int drawPerScreen = h/lineHeight + 1;
-	const int nDraw = mid(0, drawPerScreen, GetRows() - yPos);
 	const int grid_x = columns[0]->Width();
 
 	const auto active_line = context->selectionController->GetActiveLine();
 	auto const& selection = context->selectionController->GetSelectedSet();
-	visible_rows.clear();
 
 	for (int i : agi::util::range(nDraw)) {
+		int y = (i + 1) * lineHeight;
+		if (y + lineHeight < dirty_rect.y || y > dirty_rect.GetBottom())
+			continue;
+
 		wxBrush color = row_colors.Default;
 		AssDialogue *curDiag = index_line_map[i + yPos];
 
@@ -357,29 +433,25 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 		else if (curDiag->Comment)
 			color = row_colors.Comment;
 
-		if (OPT_GET("Subtitle/Grid/Highlight Subtitles in Frame")->GetBool() && IsDisplayed(curDiag)) {
-			if (color == row_colors.Default)
-				color = row_colors.Visible;
-			visible_rows.push_back(i + yPos);
-		}
+		if (color == row_colors.Default && std::binary_search(begin(visible_rows), end(visible_rows), i + yPos))
+			color = row_colors.Visible;
 		dc.SetBrush(color);
 
 		// Draw row background color
 		if (color != row_colors.Default) {
 			dc.SetPen(*wxTRANSPARENT_PEN);
-			dc.DrawRectangle(grid_x, (i + 1) * lineHeight + 1, w, lineHeight);
+			dc.DrawRectangle(grid_x, y + 1, w, lineHeight);
 		}
 
 		if (active_line != curDiag && curDiag->CollidesWith(active_line))
-			dc.SetTextForeground(text_collision);
+			dc.SetTextForeground(text_colors.Collision);
 		else if (inSel)
-			dc.SetTextForeground(text_selection);
+			dc.SetTextForeground(text_colors.Selection);
 		else
-			dc.SetTextForeground(text_standard);
+			dc.SetTextForeground(text_colors.Standard);
 
 		// Draw text
 		int x = 0;
-		int y = (i + 1) * lineHeight;
 		for (size_t j : agi::util::range(columns.size())) {
 			if (paint_columns[j])
 				columns[j]->Paint(dc, x, y, curDiag, context);
@@ -407,7 +479,7 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 	}
 
 	if (active_line && active_line->Row >= yPos && active_line->Row < yPos + nDraw) {
-		dc.SetPen(wxPen(to_wx(OPT_GET("Colour/Subtitle Grid/Active Border")->GetColor())));
+		dc.SetPen(active_border_pen);
 		dc.SetBrush(*wxTRANSPARENT_BRUSH);
 		dc.DrawRectangle(0, (active_line->Row - yPos + 1) * lineHeight, w, lineHeight + 1);
 	}
@@ -589,28 +661,79 @@ void BaseGrid::AdjustScrollbar() {
 	scrollBar->Thaw();
 }
 
-void BaseGrid::SetColumnWidths() {
-	int w, h;
-	GetClientSize(&w, &h);
-
+void BaseGrid::SetColumnWidths(std::vector<const AssDialogue *> const* changed) {
 	// DC for text extents test
 	wxClientDC dc(this);
 	dc.SetFont(font);
 
-	text_refresh_rects.clear();
-	int x = 0;
-
 	if (!width_helper)
 		width_helper = agi::make_unique<WidthHelper>();
 	width_helper->SetDC(&dc);
 
 	for (auto const& column : columns) {
-		column->UpdateWidth(context, *width_helper);
+		if (changed)
+			column->UpdateWidth(context, *width_helper, *changed);
+		else
+			column->UpdateWidth(context, *width_helper);
+	}
+
+	if (changed) {
+		// The changed lines can only make columns wider, so check if they
+		// should be narrower once there's nothing else to do
+		recheck_widths = true;
+	}
+	else {
+		width_helper->Age();
+		recheck_widths = false;
+		refine_widths = true;
+	}
+
+	UpdateTextRefreshRects();
+}
+
+void BaseGrid::UpdateTextRefreshRects() {
+	int h = GetClientSize().GetHeight();
+
+	text_refresh_rects.clear();
+	int x = 0;
+	for (auto const& column : columns) {
 		if (column->Width() && column->RefreshOnTextChange())
 			text_refresh_rects.emplace_back(x, 0, column->Width(), h);
 		x += column->Width();
 	}
-	width_helper->Age();
+}
+
+void BaseGrid::OnIdle(wxIdleEvent &event) {
+	if (!recheck_widths && !refine_widths) return;
+
+	std::vector<int> old_widths;
+	for (auto const& column : columns)
+		old_widths.push_back(column->Width());
+
+	if (recheck_widths)
+		SetColumnWidths();
+
+	wxClientDC dc(this);
+	dc.SetFont(font);
+	width_helper->SetDC(&dc);
+
+	// Measure the values which were skipped when setting the widths a
+	// batch at a time, so that the UI stays responsive
+	refine_widths = false;
+	for (auto const& column : columns) {
+		if (column->RefineWidth(context, *width_helper))
+			refine_widths = true;
+	}
+	if (refine_widths)
+		event.RequestMore();
+
+	for (size_t i = 0; i < columns.size(); ++i) {
+		if (columns[i]->Width() != old_widths[i]) {
+			UpdateTextRefreshRects();
+			Redraw();
+			break;
+		}
+	}
 }
 
 AssDialogue *BaseGrid::GetDialogue(int n) const {
@@ -719,5 +842,5 @@ void BaseGrid::SetByFrame(bool state) {
 	for (auto& column : columns)
 		column->SetByFrame(byFrame);
 	SetColumnWidths();
-	Refresh(false);
+	Redraw();
 }
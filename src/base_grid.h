@@ -32,6 +32,8 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <wx/bitmap.h>
+#include <wx/pen.h>
 #include <wx/window.h>
 
 namespace agi {
@@ -39,6 +41,7 @@ namespace agi {
 	class OptionValue;
 }
 class AssDialogue;
+class wxDC;
 class GridColumn;
 class WidthHelper;
 
@@ -71,6 +74,11 @@ class BaseGrid final : public wxWindow {
 
 	std::vector<wxRect> text_refresh_rects;
 
+	/// Are there column values which haven't been measured yet?
+	bool refine_widths = false;
+	/// Have the column widths only been widened for changed lines?
+	bool recheck_widths = false;
+
 	/// Cached brushes used for row backgrounds
 	struct {
 		wxBrush Default;
@@ -82,6 +90,28 @@ class BaseGrid final : public wxWindow {
 		wxBrush LeftCol;
 	} row_colors;
 
+	/// Cached text colors
+	struct {
+		wxColour Standard;
+		wxColour Selection;
+		wxColour Collision;
+	} text_colors;
+
+	wxPen grid_pen;          ///< Pen for the lines between rows and columns
+	wxPen active_border_pen; ///< Pen for the border around the active line
+
+	/// Should lines visible on the current video frame be highlighted?
+	bool highlight_visible = false;
+
+	/// The rendered grid, which is only drawn into where it is out of date
+	wxBitmap buffer;
+	/// Bitmap which the buffer is copied into when scrolling
+	wxBitmap scroll_buffer;
+	/// Value of yPos when the buffer was last drawn
+	int buffer_y_pos = 0;
+	/// Area of the buffer which needs to be drawn again
+	wxRect dirty_rect;
+
 	std::vector<AssDialogue*> index_line_map;  ///< Row number -> dialogue line
 
 	/// Connection for video seek event. Stored explicitly so that it can be
@@ -103,9 +133,22 @@ class BaseGrid final : public wxWindow {
 	void OnSubtitlesCommit(int type);
 	void OnActiveLineChanged(AssDialogue *);
 	void OnSeek();
+	void OnIdle(wxIdleEvent &event);
+
+	/// Draw the whole grid again on the next paint
+	void Redraw();
+	/// Draw part of the grid again on the next paint
+	void Redraw(wxRect const& rect);
+	/// Move the rows in the buffer to the current scroll position
+	void ScrollBuffer(int w, int h);
+	/// Draw the part of the grid in dirty_rect
+	void DrawRows(wxDC &dc, int w, int h, int nDraw);
 
 	void AdjustScrollbar();
-	void SetColumnWidths();
+	/// Set the width of each column
+	/// @param changed Lines which changed, or nullptr to check every line
+	void SetColumnWidths(std::vector<const AssDialogue *> const* changed = nullptr);
+	void UpdateTextRefreshRects();
 
 	bool IsDisplayed(const AssDialogue *line) const;
 
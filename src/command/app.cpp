@@ -34,7 +34,9 @@
 #include "command.h"
 
 #include <libaegisub/log.h>
+#include <libaegisub/io.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include "../compat.h"
 #include "../dialog_detached_video.h"
@@ -187,6 +189,17 @@ struct app_log final : public Command {
 	}
 };
 
+struct app_memory final : public Command {
+	CMD_NAME("app/memory")
+	STR_MENU("&Memory Usage...")
+	STR_DISP("Memory Usage")
+	STR_HELP("Show how much memory each part of Aegisub is using")
+
+	void operator()(agi::Context *c) override {
+		ShowMemoryUsageDialog(c);
+	}
+};
+
 struct app_new_window final : public Command {
 	CMD_NAME("app/new_window")
 	CMD_ICON(new_window_menu)
@@ -233,6 +246,26 @@ struct app_toggle_global_hotkeys final : public Command {
 	}
 };
 
+struct app_toggle_performance_hud final : public Command {
+	CMD_NAME("app/toggle/performance_hud")
+	STR_MENU("Show &Performance Overlay")
+	STR_DISP("Show Performance Overlay")
+	STR_HELP("Show how long decoding and rendering are taking over the video and audio displays")
+	CMD_TYPE(COMMAND_TOGGLE)
+
+	bool IsActive(const agi::Context *) override {
+		return OPT_GET("App/Performance HUD")->GetBool();
+	}
+
+	void operator()(agi::Context *) override {
+		agi::OptionValue *opt = OPT_SET("App/Performance HUD");
+		// The overlay has nothing to show unless the probes are recording
+		if (!opt->GetBool())
+			agi::trace::Enable(true);
+		opt->SetBool(!opt->GetBool());
+	}
+};
+
 struct app_toggle_toolbar final : public Command {
 	CMD_NAME("app/toggle/toolbar")
 	STR_HELP("Toggle the main toolbar")
@@ -254,6 +287,37 @@ struct app_toggle_toolbar final : public Command {
 	}
 };
 
+struct app_toggle_trace final : public Command {
+	CMD_NAME("app/toggle/trace")
+	STR_MENU("Record &Trace")
+	STR_DISP("Record Trace")
+	STR_HELP("Record how long decoding, rendering and editing take")
+	CMD_TYPE(COMMAND_TOGGLE)
+
+	bool IsActive(const agi::Context *) override {
+		return agi::trace::Enabled();
+	}
+
+	void operator()(agi::Context *) override {
+		if (!agi::trace::Enabled())
+			agi::trace::Clear();
+		agi::trace::Enable(!agi::trace::Enabled());
+	}
+};
+
+struct app_trace_save final : public Command {
+	CMD_NAME("app/trace/save")
+	STR_MENU("&Save Trace...")
+	STR_DISP("Save Trace")
+	STR_HELP("Save the recorded trace for viewing in chrome://tracing")
+
+	void operator()(agi::Context *c) override {
+		auto filename = SaveFileSelector(_("Save trace"), "", "trace.json", "json", "JSON files (*.json)|*.json", c->parent);
+		if (filename.empty()) return;
+		agi::trace::WriteChromeTrace(agi::io::Save(filename).Get());
+	}
+};
+
 struct app_updates final : public Command {
 	CMD_NAME("app/updates")
 	STR_MENU("&Check for Updates...")
@@ -312,10 +376,14 @@ namespace cmd {
 		reg(agi::make_unique<app_exit>());
 		reg(agi::make_unique<app_language>());
 		reg(agi::make_unique<app_log>());
+		reg(agi::make_unique<app_memory>());
 		reg(agi::make_unique<app_new_window>());
 		reg(agi::make_unique<app_options>());
 		reg(agi::make_unique<app_toggle_global_hotkeys>());
+		reg(agi::make_unique<app_toggle_performance_hud>());
 		reg(agi::make_unique<app_toggle_toolbar>());
+		reg(agi::make_unique<app_toggle_trace>());
+		reg(agi::make_unique<app_trace_save>());
 #ifdef __WXMAC__
 		reg(agi::make_unique<app_minimize>());
 		reg(agi::make_unique<app_maximize>());
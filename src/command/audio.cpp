@@ -50,6 +50,9 @@
 #include <libaegisub/make_unique.h>
 #include <libaegisub/io.h>
 
+#include <wx/dirdlg.h>
+#include <wx/utils.h>
+
 namespace {
 	using cmd::Command;
 
@@ -184,7 +187,36 @@ struct audio_save_clip final : public Command {
 			end = std::max(end, line->End);
 		}
 
-		agi::SaveAudioClip(*c->project->AudioProvider(), filename, start, end);
+		agi::SaveAudioClip(c->project->AudioProvider()->GetNativeProvider(), filename, start, end);
+	}
+};
+
+struct audio_save_clips final : public Command {
+	CMD_NAME("audio/save/clips")
+	STR_MENU("Create audio clips for each line")
+	STR_DISP("Create audio clips for each line")
+	STR_HELP("Save a separate audio clip of each selected line, named after the line number")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *c) override {
+		return c->project->AudioProvider() && !c->selectionController->GetSelectedSet().empty();
+	}
+
+	void operator()(agi::Context *c) override {
+		auto const& sel = c->selectionController->GetSelectedSet();
+		if (sel.empty()) return;
+
+		agi::fs::path dir;
+		dir = wxDirSelector(_("Select folder to save the audio clips to"), "", 0, wxDefaultPosition, c->parent).c_str();
+		if (dir.empty()) return;
+
+		std::vector<agi::AudioClip> clips;
+		clips.reserve(sel.size());
+		for (auto line : sel)
+			clips.push_back(agi::AudioClip{line->Start, line->End, dir/(std::to_string(line->Row + 1) + ".wav")});
+
+		wxBusyCursor wait;
+		agi::SaveAudioClips(c->project->AudioProvider()->GetNativeProvider(), clips);
 	}
 };
 
@@ -559,6 +591,7 @@ namespace cmd {
 		reg(agi::make_unique<audio_play_to_end>());
 		reg(agi::make_unique<audio_play_toggle>());
 		reg(agi::make_unique<audio_save_clip>());
+		reg(agi::make_unique<audio_save_clips>());
 		reg(agi::make_unique<audio_scroll_left>());
 		reg(agi::make_unique<audio_scroll_right>());
 		reg(agi::make_unique<audio_stop>());
@@ -19,11 +19,15 @@
 
 #include <libaegisub/log.h>
 
+#include <mutex>
 #include <wx/intl.h>
 
 namespace cmd {
 	static std::map<std::string, std::unique_ptr<Command>> cmd_map;
 	typedef std::map<std::string, std::unique_ptr<Command>>::iterator iterator;
+	/// Autoload scripts register their macros from the threads loading them
+	/// while the main thread may be looking commands up
+	static std::mutex cmd_map_mutex;
 
 	static iterator find_command(std::string const& name) {
 		auto it = cmd_map.find(name);
@@ -33,24 +37,37 @@ namespace cmd {
 	}
 
 	void reg(std::unique_ptr<Command> cmd) {
-		cmd_map[cmd->name()] = std::move(cmd);
+		std::unique_ptr<Command> replaced;
+		std::lock_guard<std::mutex> lock(cmd_map_mutex);
+		auto& slot = cmd_map[cmd->name()];
+		replaced = std::move(slot);
+		slot = std::move(cmd);
 	}
 
 	void unreg(std::string const& name) {
-		cmd_map.erase(find_command(name));
+		std::unique_ptr<Command> cmd;
+		{
+			std::lock_guard<std::mutex> lock(cmd_map_mutex);
+			auto it = find_command(name);
+			cmd = std::move(it->second);
+			cmd_map.erase(it);
+		}
+		// Deleted outside the lock as deleting a command may unregister others
 	}
 
 	Command *get(std::string const& name) {
+		std::lock_guard<std::mutex> lock(cmd_map_mutex);
 		return find_command(name)->second.get();
 	}
 
 	void call(std::string const& name, agi::Context*c) {
-		Command &cmd = *find_command(name)->second;
+		Command &cmd = *get(name);
 		if (cmd.Validate(c))
 			cmd(c);
 	}
 
 	std::vector<std::string> get_registered_commands() {
+		std::lock_guard<std::mutex> lock(cmd_map_mutex);
 		std::vector<std::string> ret;
 		ret.reserve(cmd_map.size());
 		for (auto const& it : cmd_map)
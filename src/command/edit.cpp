@@ -41,6 +41,7 @@
 #include "../format.h"
 #include "../include/aegisub/context.h"
 #include "../initial_line_state.h"
+#include "../line_transform.h"
 #include "../libresrc/libresrc.h"
 #include "../options.h"
 #include "../project.h"
@@ -64,6 +65,7 @@
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/regex.hpp>
 #include <boost/tokenizer.hpp>
+#include <cstring>
 
 #include <wx/clipbrd.h>
 #include <wx/fontdlg.h>
@@ -94,6 +96,106 @@ struct validate_sel_multiple : public Command {
 	}
 };
 
+/// Start of the private clipboard format for lines, so that data from other
+/// versions isn't misread
+const char copied_lines_header[] = "Aegisub dialogue 1\n";
+
+void write_int(std::string &out, int32_t value) {
+	out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void write_str(std::string &out, std::string const& str) {
+	write_int(out, static_cast<int32_t>(str.size()));
+	out += str;
+}
+
+/// Append a line to the private clipboard format
+void write_line(std::string &out, AssDialogueBase const& line) {
+	out += line.Comment ? '\1' : '\0';
+	write_int(out, line.Layer);
+	for (auto margin : line.Margin)
+		write_int(out, margin);
+	write_int(out, line.Start);
+	write_int(out, line.End);
+	write_str(out, line.Style);
+	write_str(out, line.Actor);
+	write_str(out, line.Effect);
+	write_str(out, line.Text);
+	auto const& extradata = line.ExtradataIds.get();
+	write_int(out, static_cast<int32_t>(extradata.size()));
+	for (auto id : extradata)
+		write_int(out, static_cast<int32_t>(id));
+}
+
+struct line_reader {
+	const char *pos;
+	const char *end;
+
+	bool read(int32_t &value) {
+		if (end - pos < (ptrdiff_t)sizeof(value)) return false;
+		memcpy(&value, pos, sizeof(value));
+		pos += sizeof(value);
+		return true;
+	}
+
+	bool read(std::string &str) {
+		int32_t size;
+		if (!read(size) || size < 0 || end - pos < size) return false;
+		str.assign(pos, size);
+		pos += size;
+		return true;
+	}
+
+	bool read(AssDialogue &line) {
+		if (pos == end) return false;
+		line.Comment = *pos++ != 0;
+
+		int32_t start, end_time, count;
+		std::string style, actor, effect, text;
+		if (!read(line.Layer) || !read(line.Margin[0]) || !read(line.Margin[1]) || !read(line.Margin[2])
+			|| !read(start) || !read(end_time)
+			|| !read(style) || !read(actor) || !read(effect) || !read(text)
+			|| !read(count) || count < 0 || (end - pos) / 4 < count)
+			return false;
+
+		std::vector<uint32_t> extradata(count);
+		for (auto& id : extradata) {
+			int32_t value;
+			read(value);
+			id = static_cast<uint32_t>(value);
+		}
+
+		line.Start = start;
+		line.End = end_time;
+		line.Style = style;
+		line.Actor = actor;
+		line.Effect = effect;
+		line.Text = text;
+		line.ExtradataIds = extradata;
+		return true;
+	}
+};
+
+/// Get the lines put on the clipboard by copy_lines, or nothing if the
+/// clipboard has text from somewhere else
+std::vector<std::unique_ptr<AssDialogue>> get_copied_lines() {
+	std::vector<std::unique_ptr<AssDialogue>> lines;
+	std::string data = GetClipboardLines();
+	if (!boost::starts_with(data, copied_lines_header)) return lines;
+
+	line_reader reader{data.data() + strlen(copied_lines_header), data.data() + data.size()};
+	while (reader.pos != reader.end) {
+		auto line = agi::make_unique<AssDialogue>();
+		if (!reader.read(*line)) {
+			// Truncated or garbled, so let the text version be used instead
+			lines.clear();
+			break;
+		}
+		lines.push_back(std::move(line));
+	}
+	return lines;
+}
+
 template<typename String>
 AssDialogue *get_dialogue(String data) {
 	boost::trim(data);
@@ -113,21 +215,34 @@ AssDialogue *get_dialogue(String data) {
 
 template<typename Paster>
 void paste_lines(agi::Context *c, bool paste_over, Paster&& paste_line) {
-	std::string data = GetClipboard();
-	if (data.empty()) return;
-
 	AssDialogue *first = nullptr;
 	Selection newsel;
 
-	boost::char_separator<char> sep("\r\n");
-	for (auto curdata : boost::tokenizer<boost::char_separator<char>>(data, sep)) {
-		AssDialogue *inserted = paste_line(get_dialogue(curdata));
+	auto paste = [&](AssDialogue *line) {
+		AssDialogue *inserted = paste_line(line);
 		if (!inserted)
-			break;
+			return false;
 
 		newsel.insert(inserted);
 		if (!first)
 			first = inserted;
+		return true;
+	};
+
+	auto copied = get_copied_lines();
+	if (!copied.empty()) {
+		for (auto& line : copied) {
+			if (!paste(line.release()))
+				break;
+		}
+	}
+	else {
+		std::string data = GetClipboard();
+		boost::char_separator<char> sep("\r\n");
+		for (auto curdata : boost::tokenizer<boost::char_separator<char>>(data, sep)) {
+			if (!paste(get_dialogue(curdata)))
+				break;
+		}
 	}
 
 	if (first) {
@@ -302,14 +417,15 @@ void update_lines(const agi::Context *c, wxString const& undo_msg, Func&& f) {
 	const int norm_sel_end = normalize_pos(active_line->Text, sel_end);
 	int active_sel_shift = 0;
 
-	for (const auto line : c->selectionController->GetSelectedSet()) {
-		int shift = f(line, sel_start, sel_end, norm_sel_start, norm_sel_end);
-		if (line == active_line)
+	// f is run on copies of the lines in parallel, so it mustn't touch
+	// anything other than the line it's given
+	TransformSelection(c, undo_msg, AssFile::COMMIT_DIAG_TEXT, [&](AssDialogue &line, const AssDialogue *orig) {
+		int shift = f(&line, sel_start, sel_end, norm_sel_start, norm_sel_end);
+		if (orig == active_line)
 			active_sel_shift = shift;
-	}
+		return line.Text != orig->Text;
+	});
 
-	auto const& sel = c->selectionController->GetSelectedSet();
-	c->ass->Commit(undo_msg, AssFile::COMMIT_DIAG_TEXT, -1, sel.size() == 1 ? *sel.begin() : nullptr);
 	if (active_sel_shift != 0)
 		c->textSelectionController->SetSelection(sel_start + active_sel_shift, sel_end + active_sel_shift);
 }
@@ -490,7 +606,15 @@ struct edit_font final : public Command {
 		const parsed_line active(c->selectionController->GetActiveLine());
 		const int insertion_point = normalize_pos(active.line->Text, c->textSelectionController->GetInsertionPoint());
 
-		auto font_for_line = [&](parsed_line const& line) -> wxFont {
+		struct font_state {
+			std::string face;
+			int size;
+			bool bold, italic, underline;
+		};
+
+		// This is called from several threads at once by update_lines, so
+		// it can't make wxFonts
+		auto font_for_line = [&](parsed_line const& line) -> font_state {
 			const int blockn = line.block_at_pos(insertion_point);
 
 			const AssStyle *style = c->ass->GetStyle(line.line->Style);
@@ -498,37 +622,49 @@ struct edit_font final : public Command {
 			if (!style)
 				style = &default_style;
 
-			return wxFont(
+			return font_state{
+				line.get_value(blockn, style->font, "\\fn"),
 				line.get_value(blockn, (int)style->fontsize, "\\fs"),
-				wxFONTFAMILY_DEFAULT,
-				line.get_value(blockn, style->italic, "\\i") ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
-				line.get_value(blockn, style->bold, "\\b") ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
-				line.get_value(blockn, style->underline, "\\u"),
-				to_wx(line.get_value(blockn, style->font, "\\fn")));
+				line.get_value(blockn, style->bold, "\\b"),
+				line.get_value(blockn, style->italic, "\\i"),
+				line.get_value(blockn, style->underline, "\\u")};
 		};
 
-		const wxFont initial = font_for_line(active);
+		const font_state active_font = font_for_line(active);
+		const wxFont initial(
+			active_font.size,
+			wxFONTFAMILY_DEFAULT,
+			active_font.italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
+			active_font.bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
+			active_font.underline,
+			to_wx(active_font.face));
 		const wxFont font = wxGetFontFromUser(c->parent, initial);
 		if (!font.Ok() || font == initial) return;
 
+		const std::string face = from_wx(font.GetFaceName());
+		const int size = font.GetPointSize();
+		const bool bold = font.GetWeight() == wxFONTWEIGHT_BOLD;
+		const bool italic = font.GetStyle() == wxFONTSTYLE_ITALIC;
+		const bool underline = font.GetUnderlined();
+
 		update_lines(c, _("set font"), [&](AssDialogue *line, int sel_start, int sel_end, int norm_sel_start, int norm_sel_end) {
 			parsed_line parsed(line);
-			const wxFont startfont = font_for_line(parsed);
+			const font_state startfont = font_for_line(parsed);
 			int shift = 0;
 			auto do_set_tag = [&](const char *tag_name, std::string const& value) {
 				shift += parsed.set_tag(tag_name, value, norm_sel_start, sel_start + shift);
 			};
 
-			if (font.GetFaceName() != startfont.GetFaceName())
-				do_set_tag("\\fn", from_wx(font.GetFaceName()));
-			if (font.GetPointSize() != startfont.GetPointSize())
-				do_set_tag("\\fs", std::to_string(font.GetPointSize()));
-			if (font.GetWeight() != startfont.GetWeight())
-				do_set_tag("\\b", std::to_string(font.GetWeight() == wxFONTWEIGHT_BOLD));
-			if (font.GetStyle() != startfont.GetStyle())
-				do_set_tag("\\i", std::to_string(font.GetStyle() == wxFONTSTYLE_ITALIC));
-			if (font.GetUnderlined() != startfont.GetUnderlined())
-				do_set_tag("\\i", std::to_string(font.GetUnderlined()));
+			if (face != startfont.face)
+				do_set_tag("\\fn", face);
+			if (size != startfont.size)
+				do_set_tag("\\fs", std::to_string(size));
+			if (bold != startfont.bold)
+				do_set_tag("\\b", std::to_string(bold));
+			if (italic != startfont.italic)
+				do_set_tag("\\i", std::to_string(italic));
+			if (underline != startfont.underline)
+				do_set_tag("\\i", std::to_string(underline));
 
 			return shift;
 		});
@@ -549,9 +685,15 @@ struct edit_find_replace final : public Command {
 };
 
 static void copy_lines(agi::Context *c) {
-	SetClipboard(join(c->selectionController->GetSortedSelection()
-		| transformed(static_cast<std::string(*)(AssDialogue*)>([](AssDialogue *d) { return d->GetEntryData(); })),
-		"\r\n"));
+	std::string text;
+	std::string lines = copied_lines_header;
+	for (auto line : c->selectionController->GetSortedSelection()) {
+		if (!text.empty())
+			text += "\r\n";
+		line->AppendEntryData(text);
+		write_line(lines, *line);
+	}
+	SetClipboardLines(text, lines);
 }
 
 static void delete_lines(agi::Context *c, wxString const& commit_message) {
@@ -815,20 +957,30 @@ struct edit_line_join_keep_first final : public validate_sel_multiple {
 };
 
 static bool try_paste_lines(agi::Context *c) {
-	std::string data = GetClipboard();
-	boost::trim_left(data);
-	if (!boost::starts_with(data, "Dialogue:")) return false;
-
 	EntryList<AssDialogue> parsed;
-	boost::char_separator<char> sep("\r\n");
-	for (auto curdata : boost::tokenizer<boost::char_separator<char>>(data, sep)) {
-		boost::trim(curdata);
-		try {
-			parsed.push_back(*new AssDialogue(curdata));
-		}
-		catch (...) {
-			parsed.clear_and_dispose([](AssDialogue *e) { delete e; });
-			return false;
+
+	// Same rule as for the text: only paste lines if the first isn't a comment
+	auto copied = get_copied_lines();
+	if (!copied.empty()) {
+		if (copied.front()->Comment) return false;
+		for (auto& line : copied)
+			parsed.push_back(*line.release());
+	}
+	else {
+		std::string data = GetClipboard();
+		boost::trim_left(data);
+		if (!boost::starts_with(data, "Dialogue:")) return false;
+
+		boost::char_separator<char> sep("\r\n");
+		for (auto curdata : boost::tokenizer<boost::char_separator<char>>(data, sep)) {
+			boost::trim(curdata);
+			try {
+				parsed.push_back(*new AssDialogue(curdata));
+			}
+			catch (...) {
+				parsed.clear_and_dispose([](AssDialogue *e) { delete e; });
+				return false;
+			}
 		}
 	}
 
@@ -33,6 +33,7 @@
 
 #include "../ass_dialogue.h"
 #include "../ass_file.h"
+#include "../ass_style.h"
 #include "../compat.h"
 #include "../dialog_search_replace.h"
 #include "../dialogs.h"
@@ -46,14 +47,20 @@
 #include "../selection_controller.h"
 #include "../subs_controller.h"
 #include "../subtitle_format.h"
+#include "../text_width_table.h"
 #include "../utils.h"
 #include "../video_controller.h"
 
 #include <libaegisub/address_of_adaptor.h>
 #include <libaegisub/charset_conv.h>
+#include <libaegisub/line_wrap.h>
 #include <libaegisub/make_unique.h>
 
+#include <algorithm>
+#include <boost/algorithm/string/replace.hpp>
 #include <boost/range/algorithm/copy.hpp>
+#include <cmath>
+#include <map>
 #include <wx/msgdlg.h>
 #include <wx/choicdlg.h>
 
@@ -404,6 +411,175 @@ struct subtitle_select_all final : public Command {
 	}
 };
 
+struct subtitle_select_overlaps final : public Command {
+	CMD_NAME("subtitle/select/overlaps")
+	STR_MENU("Select &Overlaps")
+	STR_DISP("Select Overlaps")
+	STR_HELP("Select lines which begin while another non-comment line is active")
+
+	void operator()(agi::Context *c) override {
+		// Only look at the selected lines if there's more than one of them
+		auto const& sel = c->selectionController->GetSelectedSet();
+		std::vector<AssDialogue *> lines;
+		if (sel.size() <= 1) {
+			for (auto& line : c->ass->Events) {
+				if (!line.Comment)
+					lines.push_back(&line);
+			}
+		}
+		else {
+			for (auto line : sel) {
+				if (!line->Comment)
+					lines.push_back(line);
+			}
+		}
+
+		std::sort(begin(lines), end(lines), [](const AssDialogue *a, const AssDialogue *b) {
+			return a->Start < b->Start || (a->Start == b->Start && a->Row < b->Row);
+		});
+
+		// Sweep through the lines in order of start time, remembering when
+		// the latest-ending line which didn't overlap anything ends
+		Selection overlaps;
+		AssDialogue *first = nullptr;
+		agi::Time end_time;
+		for (auto line : lines) {
+			if (line->Start >= end_time)
+				end_time = line->End;
+			else {
+				overlaps.insert(line);
+				if (!first || line->Row < first->Row)
+					first = line;
+			}
+		}
+
+		if (first)
+			c->selectionController->SetSelectionAndActive(std::move(overlaps), first);
+		// As with the macro this replaced, finding nothing selects just the
+		// active line rather than clearing the selection
+		else if (AssDialogue *active = c->selectionController->GetActiveLine())
+			c->selectionController->SetSelectedSet({ active });
+	}
+};
+
+struct subtitle_select_too_wide final : public Command {
+	CMD_NAME("subtitle/select/too_wide")
+	STR_MENU("Select Lines Too &Wide")
+	STR_DISP("Select Lines Too Wide")
+	STR_HELP("Select lines which are wider than the space between their margins, even after wrapping")
+
+	/// Rows of text which all have the same style and available width, so
+	/// that they can be wrapped as a batch
+	struct Group {
+		/// Width of each word in each row, with the space before it
+		std::vector<std::vector<int>> rows;
+		/// Line which each row is from
+		std::vector<AssDialogue *> lines;
+		/// Width of a space in the style's font
+		int space_width = 0;
+	};
+
+	void operator()(agi::Context *c) override {
+		// Only look at the selected lines if there's more than one of them
+		auto const& sel = c->selectionController->GetSelectedSet();
+		std::vector<AssDialogue *> lines;
+		if (sel.size() <= 1) {
+			for (auto& line : c->ass->Events) {
+				if (!line.Comment)
+					lines.push_back(&line);
+			}
+		}
+		else {
+			for (auto line : sel) {
+				if (!line->Comment)
+					lines.push_back(line);
+			}
+		}
+
+		int res_x, res_y;
+		c->ass->GetResolution(res_x, res_y);
+		int wrap_style = c->ass->GetScriptInfoAsInt("WrapStyle");
+		auto wrap_mode = wrap_style >= 0 && wrap_style <= 3 ? static_cast<agi::WrapMode>(wrap_style) : agi::Wrap_Balanced_FirstLonger;
+
+		// Each style's characters are measured once, rather than measuring
+		// every line with the platform's text layout
+		std::map<std::string, TextWidthTable> tables;
+		std::map<std::pair<std::string, int>, Group> groups;
+		for (auto line : lines) {
+			AssStyle *style = c->ass->GetStyle(line->Style);
+			if (!style) continue;
+
+			int width = res_x
+				- (line->Margin[0] ? line->Margin[0] : style->Margin[0])
+				- (line->Margin[1] ? line->Margin[1] : style->Margin[1]);
+
+			auto table = tables.find(style->name);
+			if (table == tables.end())
+				table = tables.emplace(style->name, TextWidthTable(*style)).first;
+
+			auto& group = groups[std::make_pair(style->name, width)];
+			group.space_width = static_cast<int>(std::round(table->second.GetWidth(" ")));
+
+			// \n is only a line break with wrapping disabled, and \h is a
+			// space which can't be broken at
+			std::string text = line->GetStrippedText();
+			boost::replace_all(text, "\\n", wrap_mode == agi::Wrap_None ? "\\N" : " ");
+			boost::replace_all(text, "\\h", "\xC2\xA0");
+
+			for (size_t row_start = 0; row_start <= text.size(); ) {
+				size_t row_end = std::min(text.find("\\N", row_start), text.size());
+
+				std::vector<int> words;
+				for (size_t word_start = row_start; word_start < row_end; ) {
+					size_t word_end = std::min(text.find(' ', word_start + 1), row_end);
+					words.push_back(static_cast<int>(std::round(table->second.GetWidth(text.substr(word_start, word_end - word_start)))));
+					word_start = word_end;
+				}
+				group.rows.push_back(std::move(words));
+				group.lines.push_back(line);
+
+				row_start = row_end + 2;
+			}
+		}
+
+		Selection too_wide;
+		AssDialogue *first = nullptr;
+		for (auto const& group : groups) {
+			const int max_width = group.first.second;
+			auto const& rows = group.second.rows;
+			auto wrap_points = agi::get_wrap_points_batch(rows, max_width, wrap_mode);
+
+			for (size_t i = 0; i < rows.size(); ++i) {
+				auto line = group.second.lines[i];
+				if (too_wide.count(line)) continue;
+
+				// Measure each of the wrapped lines, dropping the space
+				// which the break replaces
+				bool fits = true;
+				size_t word = 0;
+				for (size_t j = 0; j <= wrap_points[i].size() && fits; ++j) {
+					size_t end = j < wrap_points[i].size() ? wrap_points[i][j] : rows[i].size();
+					int width = j > 0 ? -group.second.space_width : 0;
+					for (; word < end; ++word)
+						width += rows[i][word];
+					fits = width <= max_width;
+				}
+
+				if (!fits) {
+					too_wide.insert(line);
+					if (!first || line->Row < first->Row)
+						first = line;
+				}
+			}
+		}
+
+		if (first)
+			c->selectionController->SetSelectionAndActive(std::move(too_wide), first);
+		else
+			c->selectionController->SetSelectedSet(std::move(too_wide));
+	}
+};
+
 struct subtitle_select_visible final : public Command {
 	CMD_NAME("subtitle/select/visible")
 	CMD_ICON(select_visible_button)
@@ -469,6 +645,8 @@ namespace cmd {
 		reg(agi::make_unique<subtitle_save>());
 		reg(agi::make_unique<subtitle_save_as>());
 		reg(agi::make_unique<subtitle_select_all>());
+		reg(agi::make_unique<subtitle_select_overlaps>());
+		reg(agi::make_unique<subtitle_select_too_wide>());
 		reg(agi::make_unique<subtitle_select_visible>());
 		reg(agi::make_unique<subtitle_spellcheck>());
 	}
@@ -144,7 +144,7 @@ struct time_frame_current final : public validate_video_loaded {
 			line->End = line->End + shift_by;
 		}
 
-		c->ass->Commit(_("shift to frame"), AssFile::COMMIT_DIAG_TIME);
+		c->ass->Commit(_("shift to frame"), AssFile::COMMIT_DIAG_TIME, -1, std::vector<AssDialogue *>(sel.begin(), sel.end()));
 	}
 };
 
@@ -174,7 +174,7 @@ static void snap_subs_video(agi::Context *c, bool set_start) {
 			line->End = end;
 	}
 
-	c->ass->Commit(_("timing"), AssFile::COMMIT_DIAG_TIME);
+	c->ass->Commit(_("timing"), AssFile::COMMIT_DIAG_TIME, -1, std::vector<AssDialogue *>(sel.begin(), sel.end()));
 }
 
 struct time_snap_end_video final : public validate_video_loaded {
@@ -226,12 +226,13 @@ struct time_snap_scene final : public validate_video_loaded {
 		int start_ms = con->TimeAtFrame(prev,agi::vfr::START);
 		int end_ms = con->TimeAtFrame(next-1,agi::vfr::END);
 
-		for (auto line : c->selectionController->GetSelectedSet()) {
+		auto const& sel = c->selectionController->GetSelectedSet();
+		for (auto line : sel) {
 			line->Start = start_ms;
 			line->End = end_ms;
 		}
 
-		c->ass->Commit(_("snap to scene"), AssFile::COMMIT_DIAG_TIME);
+		c->ass->Commit(_("snap to scene"), AssFile::COMMIT_DIAG_TIME, -1, std::vector<AssDialogue *>(sel.begin(), sel.end()));
 	}
 };
 
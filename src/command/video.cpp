@@ -36,6 +36,7 @@
 #include "../compat.h"
 #include "../dialog_detached_video.h"
 #include "../dialog_manager.h"
+#include "../dialog_progress.h"
 #include "../dialogs.h"
 #include "../format.h"
 #include "../frame_main.h"
@@ -51,15 +52,21 @@
 #include "../video_frame.h"
 
 #include <libaegisub/ass/time.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/path.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/parallel.h>
 #include <libaegisub/util.h>
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <condition_variable>
+#include <mutex>
 #include <wx/msgdlg.h>
+#include <wx/numdlg.h>
 #include <wx/textdlg.h>
 
 namespace {
@@ -516,6 +523,112 @@ struct video_frame_save_raw final : public validator_video_loaded {
 	}
 };
 
+static void save_snapshot_range(agi::Context *c, bool raw) {
+	auto const& sel = c->selectionController->GetSelectedSet();
+	if (sel.empty()) return;
+
+	agi::Time start = INT_MAX, end = 0;
+	for (auto line : sel) {
+		start = std::min(start, line->Start);
+		end = std::max(end, line->End);
+	}
+
+	auto const& fps = c->project->Timecodes();
+	auto provider = c->project->VideoProvider();
+	int first = std::max(0, fps.FrameAtTime(start, agi::vfr::START));
+	int last = std::min(fps.FrameAtTime(end, agi::vfr::END), provider->GetFrameCount() - 1);
+	if (last < first) return;
+
+	long step = wxGetNumberFromUser(
+		fmt_tl("The selected lines span %d frames.", last - first + 1),
+		_("Save every Nth frame, N:"), _("Save snapshots"), 1, 1, last - first + 1, c->parent);
+	if (step < 1) return;
+
+	auto filename = SaveFileSelector(_("Save snapshots"), "Path/Last/Snapshots", "", "png",
+		from_wx(_("PNG images")) + " (*.png)|*.png|" + from_wx(_("JPEG images")) + " (*.jpg)|*.jpg", c->parent);
+	if (filename.empty()) return;
+
+	// Each frame is saved as <name>_<frame number>.<ext>
+	auto ext = boost::to_lower_copy(filename.extension().string());
+	auto type = ext == ".jpg" || ext == ".jpeg" ? wxBITMAP_TYPE_JPEG : wxBITMAP_TYPE_PNG;
+	auto base = (filename.parent_path() / filename.stem()).string();
+
+	std::vector<std::pair<int, double>> frames;
+	for (int i = first; i <= last; i += step)
+		frames.emplace_back(i, fps.TimeAtFrame(i));
+
+	DialogProgress progress(c->parent, _("Save snapshots"));
+	progress.Run([&](agi::ProgressSink *ps) {
+		// Frames are decoded and rendered in order by the video provider,
+		// and converted and compressed in parallel on the thread pool
+		std::mutex mutex;
+		std::condition_variable cond;
+		size_t encoding = 0, saved = 0;
+		std::vector<std::string> failed;
+		const size_t max_encoding = agi::parallel_concurrency();
+		const size_t total = frames.size();
+
+		auto wait_for_encoding = [&](size_t limit) {
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]{ return encoding <= limit; });
+		};
+
+		try {
+			provider->GetFrames(frames, raw, [&](int n, std::shared_ptr<const VideoFrame> frame) {
+				if (ps->IsCancelled())
+					throw agi::UserCancelException("Saving snapshots cancelled");
+
+				wait_for_encoding(max_encoding - 1);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					++encoding;
+				}
+
+				auto path = agi::format("%s_%06d%s", base, n, ext);
+				agi::dispatch::Background().Async([=, &mutex, &cond, &encoding, &saved, &failed] {
+					bool ok = GetImage(*frame).SaveFile(to_wx(path), type);
+
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!ok) failed.push_back(path);
+					ps->SetProgress(++saved, total);
+					--encoding;
+					cond.notify_all();
+				});
+			});
+		}
+		catch (...) {
+			wait_for_encoding(0);
+			throw;
+		}
+		wait_for_encoding(0);
+
+		for (auto const& path : failed)
+			ps->Log(agi::format("Failed to save %s\n", path));
+	});
+}
+
+struct video_frame_save_range final : public validator_video_loaded {
+	CMD_NAME("video/frame/save/range")
+	STR_MENU("Save snapshots of selected lines...")
+	STR_DISP("Save snapshots of selected lines")
+	STR_HELP("Save every Nth frame of the time span of the selected lines to image files")
+
+	void operator()(agi::Context *c) override {
+		save_snapshot_range(c, false);
+	}
+};
+
+struct video_frame_save_range_raw final : public validator_video_loaded {
+	CMD_NAME("video/frame/save/range/raw")
+	STR_MENU("Save snapshots of selected lines (no subtitles)...")
+	STR_DISP("Save snapshots of selected lines (no subtitles)")
+	STR_HELP("Save every Nth frame of the time span of the selected lines without the subtitles to image files")
+
+	void operator()(agi::Context *c) override {
+		save_snapshot_range(c, true);
+	}
+};
+
 struct video_jump final : public validator_video_loaded {
 	CMD_NAME("video/jump")
 	CMD_ICON(jumpto_button)
@@ -761,6 +874,8 @@ namespace cmd {
 		reg(agi::make_unique<video_frame_prev_large>());
 		reg(agi::make_unique<video_frame_save>());
 		reg(agi::make_unique<video_frame_save_raw>());
+		reg(agi::make_unique<video_frame_save_range>());
+		reg(agi::make_unique<video_frame_save_range_raw>());
 		reg(agi::make_unique<video_jump>());
 		reg(agi::make_unique<video_jump_end>());
 		reg(agi::make_unique<video_jump_start>());
@@ -2,6 +2,8 @@
 
 #include "options.h"
 
+#include <libaegisub/charset_conv.h>
+
 #include <algorithm>
 
 wxArrayString lagi_MRU_wxAS(const char *list) {
@@ -25,6 +27,13 @@ wxColour to_wx(agi::Color color) {
 }
 
 wxString to_wx(std::string const& str) {
+#if wxUSE_UNICODE_WCHAR
+	// wx's UTF-8 conversion goes a character at a time, which adds up when
+	// it's done for every visible cell of the grid on every paint
+	std::wstring wide;
+	if (agi::charset::Utf8ToWide(str.data(), str.size(), wide))
+		return wxString(wide.data(), wide.size());
+#endif
 	return wxString(str.c_str(), wxConvUTF8);
 }
 
@@ -33,5 +42,10 @@ agi::Color from_wx(wxColour color) {
 }
 
 std::string from_wx(wxString const& str) {
+#if wxUSE_UNICODE_WCHAR
+	std::string ret;
+	if (agi::charset::WideToUtf8(str.wx_str(), str.size(), ret))
+		return ret;
+#endif
 	return std::string(str.utf8_str());
 }
@@ -30,12 +30,14 @@
 #include "ass_attachment.h"
 #include "ass_file.h"
 #include "compat.h"
+#include "font_file_lister.h"
 #include "help_button.h"
 #include "libresrc/libresrc.h"
 #include "options.h"
 #include "utils.h"
 
 #include <wx/button.h>
+#include <wx/checkbox.h>
 #include <wx/dialog.h>
 #include <wx/filedlg.h>
 #include <wx/dirdlg.h>
@@ -50,6 +52,7 @@ struct DialogAttachments {
 	wxListView *listView;
 	wxButton *extractButton;
 	wxButton *deleteButton;
+	wxCheckBox *subsetFonts;
 
 	void OnAttachFont(wxCommandEvent &event);
 	void OnAttachGraphics(wxCommandEvent &event);
@@ -58,7 +61,7 @@ struct DialogAttachments {
 	void OnListClick(wxListEvent &event);
 
 	void UpdateList();
-	void AttachFile(wxFileDialog &diag, wxString const& commit_msg);
+	void AttachFile(wxFileDialog &diag, wxString const& commit_msg, bool fonts);
 
 public:
 	DialogAttachments(wxWindow *parent, AssFile *ass);
@@ -80,6 +83,9 @@ DialogAttachments::DialogAttachments(wxWindow *parent, AssFile *ass)
 	extractButton->Enable(false);
 	deleteButton->Enable(false);
 
+	subsetFonts = new wxCheckBox(&d, -1, _("&Only include the characters used in the script when attaching fonts"));
+	subsetFonts->SetValue(OPT_GET("Tool/Attachments/Subset Fonts")->GetBool());
+
 	auto buttonSizer = new wxBoxSizer(wxHORIZONTAL);
 	buttonSizer->Add(attachFont, 1);
 	buttonSizer->Add(attachGraphics, 1);
@@ -90,6 +96,7 @@ DialogAttachments::DialogAttachments(wxWindow *parent, AssFile *ass)
 
 	auto mainSizer = new wxBoxSizer(wxVERTICAL);
 	mainSizer->Add(listView, 1, wxTOP | wxLEFT | wxRIGHT | wxEXPAND, 5);
+	mainSizer->Add(subsetFonts, 0, wxTOP | wxLEFT | wxRIGHT, 5);
 	mainSizer->Add(buttonSizer, 0, wxALL | wxEXPAND, 5);
 	d.SetSizerAndFit(mainSizer);
 	d.CenterOnParent();
@@ -119,14 +126,22 @@ void DialogAttachments::UpdateList() {
 	}
 }
 
-void DialogAttachments::AttachFile(wxFileDialog &diag, wxString const& commit_msg) {
+void DialogAttachments::AttachFile(wxFileDialog &diag, wxString const& commit_msg, bool fonts) {
 	if (diag.ShowModal() == wxID_CANCEL) return;
 
 	wxArrayString paths;
 	diag.GetPaths(paths);
 
+	// Attached fonts can be tens of megabytes for CJK fonts, which then
+	// slows down every save, undo and reload of the script
+	std::vector<int> characters;
+	bool subset = fonts && subsetFonts->GetValue();
+	OPT_SET("Tool/Attachments/Subset Fonts")->SetBool(subsetFonts->GetValue());
+	if (subset)
+		characters = FontCollector([](wxString, int) { }).GetUsedCharacters(ass);
+
 	for (auto const& fn : paths)
-		ass->InsertAttachment(agi::fs::path(fn.wx_str()));
+		ass->InsertAttachment(agi::fs::path(fn.wx_str()), subset ? &characters : nullptr);
 
 	ass->Commit(commit_msg, AssFile::COMMIT_ATTACHMENT);
 
@@ -139,7 +154,7 @@ void DialogAttachments::OnAttachFont(wxCommandEvent &) {
 		to_wx(OPT_GET("Path/Fonts Collector Destination")->GetString()), "", "Font Files (*.ttf)|*.ttf",
 		wxFD_OPEN | wxFD_FILE_MUST_EXIST | wxFD_MULTIPLE);
 
-	AttachFile(diag, _("attach font file"));
+	AttachFile(diag, _("attach font file"), true);
 }
 
 void DialogAttachments::OnAttachGraphics(wxCommandEvent &) {
@@ -149,7 +164,7 @@ void DialogAttachments::OnAttachGraphics(wxCommandEvent &) {
 		"Graphic Files (*.bmp, *.gif, *.jpg, *.ico, *.wmf)|*.bmp;*.gif;*.jpg;*.ico;*.wmf",
 		wxFD_OPEN | wxFD_FILE_MUST_EXIST | wxFD_MULTIPLE);
 
-	AttachFile(diag, _("attach graphics file"));
+	AttachFile(diag, _("attach graphics file"), false);
 }
 
 void DialogAttachments::OnExtract(wxCommandEvent &) {
@@ -14,13 +14,18 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include "ass_file.h"
 #include "compat.h"
 #include "format.h"
 #include "libresrc/libresrc.h"
 #include "options.h"
+#include "subs_journal.h"
+#include "subtitle_format_ass.h"
 
+#include <libaegisub/fs.h>
 #include <libaegisub/path.h>
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <map>
 #include <string>
@@ -30,6 +35,7 @@
 #include <wx/dir.h>
 #include <wx/filename.h>
 #include <wx/listbox.h>
+#include <wx/msgdlg.h>
 #include <wx/sizer.h>
 #include <wx/string.h>
 
@@ -91,6 +97,7 @@ DialogAutosave::DialogAutosave(wxWindow *parent)
 
 	std::map<wxString, AutosaveFile> files_map;
 	Populate(files_map, OPT_GET("Path/Auto/Save")->GetString(), ".AUTOSAVE.ass", "%s");
+	Populate(files_map, OPT_GET("Path/Auto/Save")->GetString(), journal::extension, _("%s [JOURNAL]"));
 	Populate(files_map, OPT_GET("Path/Auto/Backup")->GetString(), ".ORIGINAL.ass", _("%s [ORIGINAL BACKUP]"));
 	Populate(files_map, "?user/recovered", ".ass", _("%s [RECOVERED]"));
 
@@ -171,7 +178,28 @@ std::string DialogAutosave::ChosenFile() const {
 
 std::string PickAutosaveFile(wxWindow *parent) {
 	DialogAutosave dialog(parent);
-	if (dialog.ShowModal() == wxID_OK)
-		return dialog.ChosenFile();
-	return "";
+	if (dialog.ShowModal() != wxID_OK)
+		return "";
+
+	auto filename = dialog.ChosenFile();
+	if (!boost::ends_with(filename, journal::extension))
+		return filename;
+
+	// Journals have to be replayed to get the file, which is saved with the
+	// other recovered files so that it shows up here again
+	try {
+		agi::fs::path journal(filename);
+		AssFile subs;
+		journal::Replay(journal, &subs);
+
+		auto directory = config::path->Decode("?user/recovered");
+		agi::fs::CreateDirectory(directory);
+		auto recovered = directory / (journal.stem().string() + ".ass");
+		AssSubtitleFormat().WriteFile(&subs, recovered, 0, "UTF-8");
+		return recovered.string();
+	}
+	catch (agi::Exception const& e) {
+		wxMessageBox(to_wx(e.GetMessage()), _("Error recovering journal"), wxOK | wxICON_ERROR | wxCENTER, parent);
+		return "";
+	}
 }
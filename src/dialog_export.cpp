@@ -33,6 +33,7 @@
 #include "include/aegisub/context.h"
 #include "help_button.h"
 #include "libresrc/libresrc.h"
+#include "options.h"
 #include "subtitle_format.h"
 #include "utils.h"
 
@@ -40,6 +41,7 @@
 #include <libaegisub/split.h>
 
 #include <algorithm>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/filesystem/path.hpp>
 #include <wx/button.h>
 #include <wx/dialog.h>
@@ -67,6 +69,9 @@ class DialogExport {
 	/// A list of available target charsets
 	wxChoice *charset_list;
 
+	/// Extensions of other formats to write along with the chosen file
+	wxTextCtrl *additional_formats;
+
 	wxSizer *opt_sizer;
 
 	void OnProcess(wxCommandEvent &);
@@ -146,11 +151,19 @@ DialogExport::DialogExport(agi::Context *c)
 	if (!charset_list->SetStringSelection(to_wx(c->ass->Properties.export_encoding)))
 		charset_list->SetStringSelection("Unicode (UTF-8)");
 
+	wxStaticText *additional_formats_label = new wxStaticText(&d, -1, _("Also export as:"));
+	additional_formats = new wxTextCtrl(&d, -1, to_wx(OPT_GET("Tool/Export/Additional Formats")->GetString()));
+	additional_formats->SetToolTip(_("Extensions of other formats to save the exported subtitles as, separated by commas (such as \"srt, stl\"). Each is saved next to the chosen file."));
+	wxSizer *additional_formats_sizer = new wxBoxSizer(wxHORIZONTAL);
+	additional_formats_sizer->Add(additional_formats_label, wxSizerFlags().Center().Border(wxRIGHT));
+	additional_formats_sizer->Add(additional_formats, wxSizerFlags(1).Expand());
+
 	wxSizer *top_sizer = new wxStaticBoxSizer(wxVERTICAL, &d, _("Filters"));
 	top_sizer->Add(filter_list, wxSizerFlags(1).Expand());
 	top_sizer->Add(top_buttons, wxSizerFlags(0).Expand());
 	top_sizer->Add(filter_description, wxSizerFlags(0).Expand().Border(wxTOP));
 	top_sizer->Add(charset_list_sizer, wxSizerFlags(0).Expand().Border(wxTOP));
+	top_sizer->Add(additional_formats_sizer, wxSizerFlags(0).Expand().Border(wxTOP));
 
 	auto btn_sizer = d.CreateStdDialogButtonSizer(wxOK | wxCANCEL | wxHELP);
 	btn_sizer->GetAffirmativeButton()->SetLabelText(_("Export..."));
@@ -188,6 +201,17 @@ void DialogExport::OnProcess(wxCommandEvent &) {
 	auto filename = SaveFileSelector(_("Export subtitles file"), "", "", "", SubtitleFormat::GetWildcards(1), &d);
 	if (filename.empty()) return;
 
+	std::string additional = from_wx(additional_formats->GetValue());
+	OPT_SET("Tool/Export/Additional Formats")->SetString(additional);
+
+	std::vector<agi::fs::path> files{filename};
+	for (auto ext : agi::Split(additional, ',')) {
+		auto file = filename;
+		file.replace_extension(boost::trim_copy(agi::str(ext)));
+		if (file.has_extension() && find(begin(files), end(files), file) == end(files))
+			files.push_back(file);
+	}
+
 	for (size_t i = 0; i < filter_list->GetCount(); ++i) {
 		if (filter_list->IsChecked(i))
 			exporter.AddFilter(from_wx(filter_list->GetString(i)));
@@ -196,7 +220,7 @@ void DialogExport::OnProcess(wxCommandEvent &) {
 	try {
 		wxBusyCursor busy;
 		c->ass->Properties.export_encoding = from_wx(charset_list->GetStringSelection());
-		exporter.Export(filename, from_wx(charset_list->GetStringSelection()), &d);
+		exporter.Export(files, from_wx(charset_list->GetStringSelection()), &d);
 	}
 	catch (agi::UserCancelException const&) { }
 	catch (agi::Exception const& err) {
@@ -27,16 +27,21 @@
 #include "value_event.h"
 
 #include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/parallel.h>
 #include <libaegisub/path.h>
 #include <libaegisub/make_unique.h>
 
+#include <cstring>
+
 #include <wx/button.h>
 #include <wx/dialog.h>
 #include <wx/dirdlg.h>
 #include <wx/filedlg.h>
 #include <wx/filename.h>
+#include <wx/mstream.h>
 #include <wx/msgdlg.h>
 #include <wx/radiobox.h>
 #include <wx/sizer.h>
@@ -53,7 +58,17 @@ enum class FcMode {
 	CopyToFolder = 1,
 	CopyToScriptFolder = 2,
 	CopyToZip = 3,
-	SymlinkToFolder = 4
+	SymlinkToFolder = 4,
+	HardLinkToFolder = 5
+};
+
+enum class CopyResult {
+	Failed,
+	Copied,
+	Exists,
+	Identical,
+	Symlinked,
+	HardLinked
 };
 
 class DialogFontsCollector final : public wxDialog {
@@ -88,6 +103,66 @@ using color_str_pair = std::pair<int, wxString>;
 wxDEFINE_EVENT(EVT_ADD_TEXT, ValueEvent<color_str_pair>);
 wxDEFINE_EVENT(EVT_COLLECTION_DONE, wxThreadEvent);
 
+/// Do two files have the same contents?
+bool SameContents(agi::fs::path const& a, agi::fs::path const& b) {
+	try {
+		if (agi::fs::Size(a) != agi::fs::Size(b))
+			return false;
+
+		agi::read_file_mapping file_a(a), file_b(b);
+		const uint64_t chunk = 16 * 1024 * 1024;
+		for (uint64_t offset = 0; offset < file_a.size(); offset += chunk) {
+			auto len = std::min(chunk, file_a.size() - offset);
+			if (memcmp(file_a.read(offset, len), file_b.read(offset, len), len))
+				return false;
+		}
+		return true;
+	}
+	catch (...) {
+		return false;
+	}
+}
+
+/// Copy, link or symlink a single font into the destination folder
+CopyResult CopyFont(agi::fs::path const& path, agi::fs::path const& dest, FcMode oper) {
+	if (agi::fs::FileExists(dest))
+		return SameContents(path, dest) ? CopyResult::Identical : CopyResult::Exists;
+
+#ifndef _WIN32
+	if (oper == FcMode::SymlinkToFolder)
+		return symlink(path.c_str(), dest.c_str()) ? CopyResult::Failed : CopyResult::Symlinked;
+#endif
+
+	// Links are tried first, and if the filesystem doesn't support them or
+	// the font is on a different volume it's copied instead
+	if (oper == FcMode::HardLinkToFolder && agi::fs::HardLink(path, dest))
+		return CopyResult::HardLinked;
+	if (agi::fs::Clone(path, dest))
+		return CopyResult::Copied;
+
+	try {
+		agi::fs::Copy(path, dest);
+		return CopyResult::Copied;
+	}
+	catch (...) {
+		return CopyResult::Failed;
+	}
+}
+
+/// Compress a single font into a one-entry zip file in memory, which is then
+/// copied into the real archive without recompressing it
+CopyResult CompressFont(agi::fs::path const& path, wxMemoryOutputStream& out) {
+	wxFFileInputStream in(path.wstring());
+	if (!in.IsOk())
+		return CopyResult::Failed;
+
+	wxZipOutputStream zip(out);
+	if (!zip.PutNextEntry(path.filename().wstring()))
+		return CopyResult::Failed;
+	zip.Write(in);
+	return zip.Close() ? CopyResult::Copied : CopyResult::Failed;
+}
+
 void FontsCollectorThread(AssFile *subs, agi::fs::path const& destination, FcMode oper, wxEvtHandler *collector) {
 	agi::dispatch::Background().Async([=]{
 		auto AppendText = [&](wxString text, int colour) {
@@ -108,6 +183,9 @@ void FontsCollectorThread(AssFile *subs, agi::fs::path const& destination, FcMod
 			case FcMode::SymlinkToFolder:
 				AppendText(_("Symlinking fonts to folder...\n"), 0);
 				break;
+			case FcMode::HardLinkToFolder:
+				AppendText(_("Hard linking fonts to folder...\n"), 0);
+				break;
 			case FcMode::CopyToScriptFolder:
 			case FcMode::CopyToFolder:
 				AppendText(_("Copying fonts to folder...\n"), 0);
@@ -142,63 +220,74 @@ void FontsCollectorThread(AssFile *subs, agi::fs::path const& destination, FcMod
 			}
 		}
 
+		// Fonts are copied a batch at a time so that progress is still shown
+		// for large collections, and in zip mode so that only one batch of
+		// compressed fonts is held in memory at once
+		const size_t batch_size = agi::parallel_concurrency() * 2;
+		std::vector<CopyResult> results(batch_size);
+		std::vector<uintmax_t> sizes(batch_size);
+		std::vector<std::unique_ptr<wxMemoryOutputStream>> compressed(batch_size);
+
 		int64_t total_size = 0;
 		bool allOk = true;
-		for (auto path : paths) {
-			path.make_preferred();
-
-			int ret = 0;
-			total_size += agi::fs::Size(path);
-
-			switch (oper) {
-				case FcMode::SymlinkToFolder:
-				case FcMode::CopyToScriptFolder:
-				case FcMode::CopyToFolder: {
-					auto dest = destination/path.filename();
-					if (agi::fs::FileExists(dest))
-						ret = 2;
-#ifndef _WIN32
-					else if (oper == FcMode::SymlinkToFolder) {
-						// returns 0 on success, -1 on error...
-						if (symlink(path.c_str(), dest.c_str()))
-							ret = 0;
-						else
-							ret = 3;
+		for (size_t batch = 0; batch < paths.size(); batch += batch_size) {
+			size_t count = std::min(batch_size, paths.size() - batch);
+			agi::parallel_for(0, count, 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					auto path = paths[batch + i];
+					path.make_preferred();
+					if (oper == FcMode::CopyToZip) {
+						compressed[i] = agi::make_unique<wxMemoryOutputStream>();
+						results[i] = CompressFont(path, *compressed[i]);
 					}
-#endif
-					else {
-						try {
-							agi::fs::Copy(path, dest);
-							ret = true;
-						}
-						catch (...) {
-							ret = false;
-						}
+					else
+						results[i] = CopyFont(path, destination/path.filename(), oper);
+					try {
+						sizes[i] = agi::fs::Size(path);
 					}
-				}
-				break;
-
-				case FcMode::CopyToZip: {
-					wxFFileInputStream in(path.wstring());
-					if (!in.IsOk())
-						ret = false;
-					else {
-						ret = zip->PutNextEntry(path.filename().wstring());
-						zip->Write(in);
+					catch (agi::Exception const&) {
+						sizes[i] = 0;
 					}
 				}
-				default: break;
-			}
-
-			if (ret == 1)
-				AppendText(fmt_tl("* Copied %s.\n", path), 1);
-			else if (ret == 2)
-				AppendText(fmt_tl("* %s already exists on destination.\n", path.filename()), 3);
-			else if (ret == 3)
-				AppendText(fmt_tl("* Symlinked %s.\n", path), 1);
-			else {
-				AppendText(fmt_tl("* Failed to copy %s.\n", path), 2);
-				allOk = false;
+			}, agi::dispatch::Priority::Background);
+
+			for (size_t i = 0; i < count; ++i) {
+				auto path = paths[batch + i];
+				path.make_preferred();
+				total_size += sizes[i];
+
+				// The entries are compressed already, so this just copies
+				// the bytes into the archive
+				if (oper == FcMode::CopyToZip && results[i] == CopyResult::Copied) {
+					wxMemoryInputStream in(*compressed[i]);
+					wxZipInputStream entries(in);
+					std::unique_ptr<wxZipEntry> entry(entries.GetNextEntry());
+					if (!entry || !zip->CopyEntry(entry.release(), entries))
+						results[i] = CopyResult::Failed;
+				}
+				compressed[i].reset();
+
+				switch (results[i]) {
+					case CopyResult::Copied:
+						AppendText(fmt_tl("* Copied %s.\n", path), 1);
+						break;
+					case CopyResult::Exists:
+						AppendText(fmt_tl("* %s already exists on destination.\n", path.filename()), 3);
+						break;
+					case CopyResult::Identical:
+						AppendText(fmt_tl("* %s is already on destination.\n", path.filename()), 1);
+						break;
+					case CopyResult::Symlinked:
+						AppendText(fmt_tl("* Symlinked %s.\n", path), 1);
+						break;
+					case CopyResult::HardLinked:
+						AppendText(fmt_tl("* Hard linked %s.\n", path), 1);
+						break;
+					case CopyResult::Failed:
+						AppendText(fmt_tl("* Failed to copy %s.\n", path), 2);
+						allOk = false;
+						break;
+				}
 			}
 		}
 
@@ -228,13 +317,19 @@ DialogFontsCollector::DialogFontsCollector(agi::Context *c)
 		,_("Copy fonts to folder")
 		,_("Copy fonts to subtitle file's folder")
 		,_("Copy fonts to zipped archive")
-#ifndef _WIN32
 		,_("Symlink fonts to folder")
-#endif
+		,_("Hard link fonts to folder")
 	};
 
-	mode = static_cast<FcMode>(mid<int>(0, OPT_GET("Tool/Fonts Collector/Action")->GetInt(), countof(modes)));
+	mode = static_cast<FcMode>(mid<int>(0, OPT_GET("Tool/Fonts Collector/Action")->GetInt(), countof(modes) - 1));
 	collection_mode = new wxRadioBox(this, -1, _("Action"), wxDefaultPosition, wxDefaultSize, countof(modes), modes, 1);
+#ifdef _WIN32
+	// The option values have to stay the same on every platform, so the
+	// unsupported mode is hidden rather than left out
+	collection_mode->Show(static_cast<int>(FcMode::SymlinkToFolder), false);
+	if (mode == FcMode::SymlinkToFolder)
+		mode = FcMode::CopyToFolder;
+#endif
 	collection_mode->SetSelection(static_cast<int>(mode));
 
 	if (c->path->Decode("?script") == "?script")
@@ -367,7 +462,7 @@ void DialogFontsCollector::UpdateControls() {
 		dest_browse_button->Enable(true);
 		dest_label->Enable(true);
 
-		if (mode == FcMode::CopyToFolder || mode == FcMode::SymlinkToFolder) {
+		if (mode == FcMode::CopyToFolder || mode == FcMode::SymlinkToFolder || mode == FcMode::HardLinkToFolder) {
 			dest_label->SetLabel(_("Choose the folder where the fonts will be collected to. It will be created if it doesn't exist."));
 
 			// Remove filename from browse box
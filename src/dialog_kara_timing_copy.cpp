@@ -38,6 +38,7 @@
 #include "options.h"
 
 #include <libaegisub/karaoke_matcher.h>
+#include <libaegisub/parallel.h>
 
 #include <boost/locale/boundary.hpp>
 #include <deque>
@@ -433,6 +434,48 @@ bool KaraokeLineMatchDisplay::UndoMatch()
 	return true;
 }
 
+/// Time a whole line as if auto-matching and linking until no source is left
+/// @param source Syllables of the source line
+/// @param dest Stripped text of the destination line
+/// @return The destination line with karaoke tags
+std::string AutoMatchLine(std::vector<AssKaraoke::Syllable> const& source, std::string const& dest)
+{
+	using namespace boost::locale::boundary;
+	ssegment_index destination(character, begin(dest), end(dest));
+	auto match_begin = destination.begin();
+
+	std::vector<std::string> remaining;
+	for (auto const& syl : source)
+		remaining.emplace_back(syl.text);
+
+	std::string res;
+	for (size_t src_pos = 0; src_pos < source.size(); ) {
+		auto result = agi::auto_match_karaoke(
+			std::vector<std::string>(remaining.begin() + src_pos, remaining.end()),
+			match_begin == destination.end() ? "" : &*match_begin->begin());
+
+		size_t src_len = std::min(std::max<size_t>(result.source_length, 1), source.size() - src_pos);
+		auto match_end = match_begin;
+		for (size_t i = 0; i < result.destination_length && match_end != destination.end(); ++i)
+			++match_end;
+		// The last group gets whatever is left of the destination rather than dropping it
+		if (src_pos + src_len == source.size())
+			match_end = destination.end();
+
+		int duration = 0;
+		for (size_t i = src_pos; i < src_pos + src_len; ++i)
+			duration += source[i].duration;
+		res += "{\\k" + std::to_string(duration / 10) + "}";
+		if (match_begin != destination.end())
+			res.append(match_begin->begin(), match_end == destination.end() ? dest.end() : match_end->begin());
+
+		src_pos += src_len;
+		match_begin = match_end;
+	}
+
+	return res;
+}
+
 class DialogKanjiTimer final : public wxDialog {
 	AssFile *subs;
 
@@ -454,6 +497,7 @@ class DialogKanjiTimer final : public wxDialog {
 	void OnSkipDest(wxCommandEvent &event);
 	void OnGoBack(wxCommandEvent &event);
 	void OnAccept(wxCommandEvent &event);
+	void OnAutoMatchAll(wxCommandEvent &event);
 	void OnKeyDown(wxKeyEvent &event);
 
 	void ResetForNewLine();
@@ -501,6 +545,7 @@ DialogKanjiTimer::DialogKanjiTimer(agi::Context *c)
 	wxButton *SkipDestLine = new wxButton(this, -1,_("Skip &Dest Line"));
 	wxButton *GoBackLine = new wxButton(this, -1,_("&Go Back a Line"));
 	wxButton *AcceptLine = new wxButton(this, -1,_("&Accept Line"));
+	wxButton *AutoMatchAll = new wxButton(this, -1,_("Auto-&match All Lines"));
 	wxButton *CloseKT = new wxButton(this,wxID_CLOSE,_("&Close"));
 
 	//Frame: Text
@@ -523,6 +568,7 @@ DialogKanjiTimer::DialogKanjiTimer(agi::Context *c)
 	ButtonsBoxSizer->Add(SkipDestLine, 0, wxEXPAND|(wxALL&~wxTOP), 6);
 	ButtonsBoxSizer->Add(GoBackLine, 0, wxEXPAND|(wxALL&~wxTOP), 6);
 	ButtonsBoxSizer->Add(AcceptLine, 0, wxEXPAND|(wxALL&~wxTOP), 6);
+	ButtonsBoxSizer->Add(AutoMatchAll, 0, wxEXPAND|(wxALL&~wxTOP), 6);
 	ButtonsBoxSizer->AddStretchSpacer(1);
 
 	// Button sizer
@@ -554,6 +600,7 @@ DialogKanjiTimer::DialogKanjiTimer(agi::Context *c)
 	SkipDestLine->Bind(wxEVT_BUTTON, &DialogKanjiTimer::OnSkipDest, this);
 	GoBackLine->Bind(wxEVT_BUTTON, &DialogKanjiTimer::OnGoBack, this);
 	AcceptLine->Bind(wxEVT_BUTTON, &DialogKanjiTimer::OnAccept, this);
+	AutoMatchAll->Bind(wxEVT_BUTTON, &DialogKanjiTimer::OnAutoMatchAll, this);
 }
 
 void DialogKanjiTimer::OnClose(wxCommandEvent &) {
@@ -633,6 +680,44 @@ void DialogKanjiTimer::OnAccept(wxCommandEvent &) {
 	}
 }
 
+void DialogKanjiTimer::OnAutoMatchAll(wxCommandEvent &) {
+	if (!currentSourceLine || !currentDestinationLine) {
+		wxBell();
+		return;
+	}
+
+	auto sourceStyle = from_wx(SourceStyle->GetValue());
+	auto destStyle = from_wx(DestStyle->GetValue());
+
+	// Everything which touches the file is done up front on this thread so
+	// that only the matching itself runs in parallel. Whatever has been
+	// linked by hand on the current line is redone.
+	struct LinePair {
+		AssDialogue *line;
+		std::vector<AssKaraoke::Syllable> source;
+		std::string dest;
+		std::string output;
+	};
+	std::vector<LinePair> pairs;
+	for (; currentSourceLine && currentDestinationLine;
+		currentSourceLine = FindNextStyleMatch(currentSourceLine, sourceStyle),
+		currentDestinationLine = FindNextStyleMatch(currentDestinationLine, destStyle))
+	{
+		AssKaraoke kara(currentSourceLine);
+		pairs.push_back(LinePair{currentDestinationLine, {kara.begin(), kara.end()}, currentDestinationLine->GetStrippedText(), ""});
+	}
+
+	agi::parallel_for(0, pairs.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			pairs[i].output = AutoMatchLine(pairs[i].source, pairs[i].dest);
+	});
+
+	for (auto& pair : pairs)
+		LinesToChange.emplace_back(pair.line, std::move(pair.output));
+
+	ResetForNewLine();
+}
+
 void DialogKanjiTimer::OnKeyDown(wxKeyEvent &event) {
 	wxCommandEvent evt;
 	switch(event.GetKeyCode()) {
@@ -0,0 +1,85 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "compat.h"
+#include "dialog_manager.h"
+#include "format.h"
+#include "include/aegisub/context.h"
+
+#include <libaegisub/memory_usage.h>
+
+#include <wx/button.h>
+#include <wx/dialog.h>
+#include <wx/listctrl.h>
+#include <wx/sizer.h>
+
+namespace {
+wxString megabytes(size_t bytes) {
+	return fmt_wx("%.1f MB", bytes / (1024.0 * 1024.0));
+}
+
+class MemoryUsageDialog final : public wxDialog {
+	wxListView *list;
+
+	void UpdateUsage();
+
+public:
+	MemoryUsageDialog(agi::Context *c);
+};
+
+MemoryUsageDialog::MemoryUsageDialog(agi::Context *c)
+: wxDialog(c->parent, -1, _("Memory Usage"), wxDefaultPosition, wxDefaultSize, wxCAPTION | wxCLOSE_BOX | wxRESIZE_BORDER)
+{
+	list = new wxListView(this, -1, wxDefaultPosition, wxSize(350, 300), wxLC_REPORT | wxLC_SINGLE_SEL);
+	list->AppendColumn(_("Part"), wxLIST_FORMAT_LEFT, 220);
+	list->AppendColumn(_("Memory"), wxLIST_FORMAT_RIGHT, 100);
+
+	auto refresh = new wxButton(this, -1, _("&Refresh"));
+	refresh->Bind(wxEVT_BUTTON, [=](wxCommandEvent&) { UpdateUsage(); });
+
+	auto buttons = new wxBoxSizer(wxHORIZONTAL);
+	buttons->Add(refresh, wxSizerFlags().Border(wxRIGHT));
+	buttons->Add(new wxButton(this, wxID_CANCEL, _("&Close")));
+
+	auto sizer = new wxBoxSizer(wxVERTICAL);
+	sizer->Add(list, wxSizerFlags(1).Expand().Border());
+	sizer->Add(buttons, wxSizerFlags().Right().Border(wxLEFT | wxRIGHT | wxBOTTOM));
+	SetSizerAndFit(sizer);
+
+	UpdateUsage();
+}
+
+void MemoryUsageDialog::UpdateUsage() {
+	auto usage = agi::memory::GetUsage();
+	// Also write it to the log so that it ends up in bug reports
+	agi::memory::LogUsage(usage);
+
+	list->DeleteAllItems();
+	size_t total = 0;
+	for (auto const& part : usage) {
+		long item = list->InsertItem(list->GetItemCount(), to_wx(part.name));
+		list->SetItem(item, 1, megabytes(part.size));
+		total += part.size;
+	}
+
+	long item = list->InsertItem(list->GetItemCount(), _("Total accounted for"));
+	list->SetItem(item, 1, megabytes(total));
+}
+}
+
+void ShowMemoryUsageDialog(agi::Context *c) {
+	c->dialog->Show<MemoryUsageDialog>(c);
+}
@@ -75,7 +75,7 @@ enum Mode {
 	REGEXP
 };
 
-std::set<AssDialogue*> process(std::string const& match_text, bool match_case, Mode mode, bool invert, bool comments, bool dialogue, int field_n, AssFile *ass) {
+std::set<AssDialogue*> process(std::string const& match_text, bool match_case, Mode mode, bool invert, bool comments, bool dialogue, int field_n, agi::Context *c) {
 	SearchReplaceSettings settings = {
 		match_text,
 		std::string(),
@@ -90,11 +90,22 @@ std::set<AssDialogue*> process(std::string const& match_text, bool match_case, M
 
 	auto predicate = SearchReplaceEngine::GetMatcher(settings);
 
+	// Lines which aren't candidates can't match, so only need checking when
+	// selecting the lines which don't match
+	std::unordered_set<const AssDialogue *> candidates;
+	bool use_candidates = c->search->GetCandidates(settings, candidates);
+
 	std::set<AssDialogue*> matches;
-	for (auto& diag : ass->Events) {
+	for (auto& diag : c->ass->Events) {
 		if (diag.Comment && !comments) continue;
 		if (!diag.Comment && !dialogue) continue;
 
+		if (use_candidates && !candidates.count(&diag)) {
+			if (invert)
+				matches.insert(&diag);
+			continue;
+		}
+
 		if (invert != predicate(&diag, 0))
 			matches.insert(&diag);
 	}
@@ -189,7 +200,7 @@ void DialogSelection::Process(wxCommandEvent&) {
 			from_wx(match_text->GetValue()), case_sensitive->IsChecked(),
 			static_cast<Mode>(match_mode->GetSelection()), select_unmatching_lines->GetValue(),
 			apply_to_comments->IsChecked(), apply_to_dialogue->IsChecked(),
-			dialogue_field->GetSelection(), con->ass.get());
+			dialogue_field->GetSelection(), con);
 	}
 	catch (agi::Exception const&) {
 		Close();
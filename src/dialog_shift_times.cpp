@@ -71,7 +71,8 @@ class DialogShiftTimes final : public wxDialog {
 	void SaveHistory(json::Array shifted_blocks);
 	void LoadHistory();
 	void Process(wxCommandEvent&);
-	int Shift(int initial_time, int shift, bool by_time, agi::vfr::Time type);
+	/// Shift times in place by either milliseconds or frames
+	void Shift(std::vector<int> &times, int shift, bool by_time, agi::vfr::Time type);
 
 	void OnClear(wxCommandEvent&);
 	void OnByTime(wxCommandEvent&);
@@ -382,49 +383,73 @@ void DialogShiftTimes::Process(wxCommandEvent &) {
 	if (reverse)
 		shift = -shift;
 
-	// Track which rows were shifted for the log
+	// Track which rows were shifted for the log. Only the selected mode uses
+	// them, and "from selection onward" only needs where it started.
 	int block_start = 0;
 	json::Array shifted_blocks;
+	auto end_block = [&](int end_row) {
+		if (mode == 1 || (mode == 2 && shifted_blocks.empty())) {
+			json::Object block;
+			block["start"] = block_start;
+			block["end"] = end_row;
+			shifted_blocks.push_back(std::move(block));
+		}
+		block_start = 0;
+	};
 
+	std::vector<AssDialogue *> shifted;
 	for (auto& line : context->ass->Events) {
 		if (!sel.count(&line)) {
-			if (block_start) {
-				json::Object block;
-				block["start"] = block_start;
-				block["end"] = line.Row;
-				shifted_blocks.push_back(std::move(block));
-				block_start = 0;
-			}
+			if (block_start)
+				end_block(line.Row);
 			if (mode == 1) continue;
-			if (mode == 2 && shifted_blocks.empty()) continue;
+			if (mode == 2 && shifted.empty()) continue;
 		}
 		else if (!block_start)
 			block_start = line.Row + 1;
 
-		if (start)
-			line.Start = Shift(line.Start, shift, by_time, agi::vfr::START);
-		if (end)
-			line.End = Shift(line.End, shift, by_time, agi::vfr::END);
+		shifted.push_back(&line);
 	}
 
-	context->ass->Commit(_("shifting"), AssFile::COMMIT_DIAG_TIME);
-
-	if (block_start) {
-		json::Object block;
-		block["start"] = block_start;
-		block["end"] = context->ass->Events.back().Row + 1;
-		shifted_blocks.push_back(std::move(block));
+	if (block_start)
+		end_block(context->ass->Events.back().Row + 1);
+
+	// Shift all of the starts and then all of the ends at once so that frame
+	// shifting can use the batch frame/time conversions
+	std::vector<int> times(shifted.size());
+	if (start) {
+		for (size_t i = 0; i < shifted.size(); ++i)
+			times[i] = shifted[i]->Start;
+		Shift(times, shift, by_time, agi::vfr::START);
+		for (size_t i = 0; i < shifted.size(); ++i)
+			shifted[i]->Start = times[i];
 	}
+	if (end) {
+		for (size_t i = 0; i < shifted.size(); ++i)
+			times[i] = shifted[i]->End;
+		Shift(times, shift, by_time, agi::vfr::END);
+		for (size_t i = 0; i < shifted.size(); ++i)
+			shifted[i]->End = times[i];
+	}
+
+	context->ass->Commit(_("shifting"), AssFile::COMMIT_DIAG_TIME, -1, shifted);
 
 	SaveHistory(std::move(shifted_blocks));
 	Close();
 }
 
-int DialogShiftTimes::Shift(int initial_time, int shift, bool by_time, agi::vfr::Time type) {
-	if (by_time)
-		return initial_time + shift;
-	else
-		return fps.TimeAtFrame(shift + fps.FrameAtTime(initial_time, type), type);
+void DialogShiftTimes::Shift(std::vector<int> &times, int shift, bool by_time, agi::vfr::Time type) {
+	if (by_time) {
+		for (auto& time : times)
+			time += shift;
+		return;
+	}
+
+	std::vector<int> frames(times.size());
+	fps.FramesAtTimes(times.data(), frames.data(), times.size(), type);
+	for (auto& frame : frames)
+		frame += shift;
+	fps.TimesAtFrames(frames.data(), times.data(), times.size(), type);
 }
 }
 
@@ -18,6 +18,7 @@
 #include "ass_file.h"
 #include "compat.h"
 #include "dialog_manager.h"
+#include "format.h"
 #include "help_button.h"
 #include "include/aegisub/context.h"
 #include "include/aegisub/spellchecker.h"
@@ -28,12 +29,15 @@
 
 #include <libaegisub/ass/dialogue_parser.h>
 #include <libaegisub/exception.h>
+#include <libaegisub/parallel.h>
 #include <libaegisub/spellchecker.h>
 
+#include <algorithm>
 #include <boost/locale/conversion.hpp>
 #include <map>
 #include <memory>
 #include <set>
+#include <unordered_map>
 #include <wx/arrstr.h>
 #include <wx/checkbox.h>
 #include <wx/combobox.h>
@@ -46,6 +50,25 @@
 #include <wx/textctrl.h>
 
 namespace {
+/// Number of lines in each chunk of the whole file scan done in parallel
+const size_t min_parallel_scan = 2000;
+
+/// Count the occurrences of each word in some lines
+void count_words(const AssDialogue *const *begin, const AssDialogue *const *end, std::unordered_map<std::string, size_t>& counts) {
+	for (; begin != end; ++begin) {
+		std::string const& text = (*begin)->Text.get();
+		auto tokens = agi::ass::TokenizeDialogueBody(text);
+		agi::ass::SplitWords(text, tokens);
+
+		size_t pos = 0;
+		for (auto const& tok : tokens) {
+			if (tok.type == agi::ass::DialogueTokenType::WORD)
+				++counts[text.substr(pos, tok.length)];
+			pos += tok.length;
+		}
+	}
+}
+
 class DialogSpellChecker final : public wxDialog {
 	agi::Context *context; ///< The project context
 	std::unique_ptr<agi::SpellChecker> spellchecker; ///< The spellchecking engine
@@ -65,6 +88,11 @@ class DialogSpellChecker final : public wxDialog {
 	wxTextCtrl *orig_word;    ///< The word being corrected
 	wxTextCtrl *replace_word; ///< The replacement that will be used if "Replace" is clicked
 	wxListBox *suggest_list;  ///< The list of suggested replacements
+	wxListBox *misspelling_list; ///< Misspelled words found by scanning the whole file
+	wxSizer *misspelling_sizer;  ///< Sizer holding misspelling_list, hidden until a scan
+
+	/// Misspelled words in the file and the number of times each occurs
+	std::vector<std::pair<std::string, size_t>> misspellings;
 
 	wxComboBox *language;      ///< The list of available languages
 	wxButton *add_button;      ///< Add word to currently active dictionary
@@ -85,6 +113,16 @@ class DialogSpellChecker final : public wxDialog {
 	/// @return Was a misspelling found?
 	bool CheckLine(AssDialogue *active_line, int start_pos, int *commit_id);
 
+	/// Find the next occurrence of a specific word, starting from the
+	/// active line
+	/// @return Was the word found?
+	bool FindWord(std::string const& word);
+
+	/// Check every line in the file at once and list the misspelled words
+	void ScanFile();
+	/// Drop a word from the whole file scan's results
+	void RemoveMisspelling(std::string const& word);
+
 	/// Set the current word to be corrected
 	void SetWord(std::string const& word);
 	/// Correct the currently selected word
@@ -168,6 +206,18 @@ DialogSpellChecker::DialogSpellChecker(agi::Context *context)
 		bottom_left_sizer->Add(language, wxSizerFlags().Expand().Border(wxTOP, 5));
 	}
 
+	// Results of scanning the whole file
+	misspelling_sizer = new wxBoxSizer(wxVERTICAL);
+	misspelling_sizer->Add(new wxStaticText(this, -1, _("Misspelled words in file:")), wxSizerFlags().Border(wxTOP, 5));
+	misspelling_sizer->Add(misspelling_list = new wxListBox(this, -1, wxDefaultPosition, wxSize(300, 150)), wxSizerFlags(1).Expand());
+	misspelling_list->Bind(wxEVT_LISTBOX, [=](wxCommandEvent& evt) {
+		int sel = evt.GetSelection();
+		if (sel >= 0 && sel < (int)misspellings.size())
+			FindWord(misspellings[sel].first);
+	});
+	bottom_left_sizer->Add(misspelling_sizer, wxSizerFlags(1).Expand());
+	bottom_left_sizer->Hide(misspelling_sizer);
+
 	{
 		wxSizerFlags button_flags = wxSizerFlags().Expand().Border(wxBOTTOM, 5);
 
@@ -190,6 +240,7 @@ DialogSpellChecker::DialogSpellChecker(agi::Context *context)
 		actions_sizer->Add(button = new wxButton(this, -1, _("Replace &all")), button_flags);
 		button->Bind(wxEVT_BUTTON, [=](wxCommandEvent&) {
 			auto_replace[from_wx(orig_word->GetValue())] = from_wx(replace_word->GetValue());
+			RemoveMisspelling(from_wx(orig_word->GetValue()));
 			Replace();
 			FindNext();
 		});
@@ -200,12 +251,14 @@ DialogSpellChecker::DialogSpellChecker(agi::Context *context)
 		actions_sizer->Add(button = new wxButton(this, -1, _("Ignore a&ll")), button_flags);
 		button->Bind(wxEVT_BUTTON, [=](wxCommandEvent&) {
 			auto_ignore.insert(from_wx(orig_word->GetValue()));
+			RemoveMisspelling(from_wx(orig_word->GetValue()));
 			FindNext();
 		});
 
 		actions_sizer->Add(add_button = new wxButton(this, -1, _("Add to &dictionary")), button_flags);
 		add_button->Bind(wxEVT_BUTTON, [=](wxCommandEvent&) {
 			spellchecker->AddWord(from_wx(orig_word->GetValue()));
+			RemoveMisspelling(from_wx(orig_word->GetValue()));
 			FindNext();
 		});
 
@@ -215,6 +268,9 @@ DialogSpellChecker::DialogSpellChecker(agi::Context *context)
 			SetWord(from_wx(orig_word->GetValue()));
 		});
 
+		actions_sizer->Add(button = new wxButton(this, -1, _("Scan &whole file")), button_flags);
+		button->Bind(wxEVT_BUTTON, [=](wxCommandEvent&) { ScanFile(); });
+
 		actions_sizer->Add(new HelpButton(this, "Spell Checker"), button_flags);
 
 		actions_sizer->Add(new wxButton(this, wxID_CANCEL), button_flags.Border(0));
@@ -254,27 +310,35 @@ bool DialogSpellChecker::FindNext() {
 
 	int start_pos = context->textSelectionController->GetInsertionPoint();
 	int commit_id = -1;
+	bool found;
 
-	if (CheckLine(active_line, start_pos, &commit_id))
-		return true;
-
-	auto it = context->ass->iterator_to(*active_line);
-
-	// Note that it is deliberate that the start line is checked twice, as if
-	// the cursor is past the first misspelled word in the current line, that
-	// word should be hit last
-	while(!has_looped || active_line != start_line) {
-		// Wrap around to the beginning if we hit the end
-		if (++it == context->ass->Events.end()) {
-			it = context->ass->Events.begin();
-			has_looped = true;
+	{
+		// Auto-replacements can be made in any number of lines on the way to
+		// the next misspelling, so commit them all at once
+		AssFile::CommitTransaction transaction(*context->ass);
+
+		found = CheckLine(active_line, start_pos, &commit_id);
+
+		auto it = context->ass->iterator_to(*active_line);
+
+		// Note that it is deliberate that the start line is checked twice, as if
+		// the cursor is past the first misspelled word in the current line, that
+		// word should be hit last
+		while(!found && (!has_looped || active_line != start_line)) {
+			// Wrap around to the beginning if we hit the end
+			if (++it == context->ass->Events.end()) {
+				it = context->ass->Events.begin();
+				has_looped = true;
+			}
+
+			active_line = &*it;
+			found = CheckLine(active_line, 0, &commit_id);
 		}
-
-		active_line = &*it;
-		if (CheckLine(active_line, 0, &commit_id))
-			return true;
 	}
 
+	if (found)
+		return true;
+
 	if (IsShown()) {
 		wxMessageBox(_("Aegisub has finished checking spelling of this script."), _("Spell checking complete."));
 		Close();
@@ -332,6 +396,109 @@ bool DialogSpellChecker::CheckLine(AssDialogue *active_line, int start_pos, int
 	return false;
 }
 
+bool DialogSpellChecker::FindWord(std::string const& word) {
+	if (context->ass->Events.empty()) return false;
+	bool skip_comments = OPT_GET("Tool/Spell Checker/Skip Comments")->GetBool();
+
+	auto start = context->ass->Events.begin();
+	if (auto line = context->selectionController->GetActiveLine())
+		start = context->ass->iterator_to(*line);
+	auto it = start;
+	do {
+		AssDialogue *line = &*it;
+		if (!(skip_comments && line->Comment)) {
+			std::string const& text = line->Text.get();
+			auto tokens = agi::ass::TokenizeDialogueBody(text);
+			agi::ass::SplitWords(text, tokens);
+
+			int pos = 0;
+			for (auto const& tok : tokens) {
+				if (tok.type == agi::ass::DialogueTokenType::WORD && text.compare(pos, tok.length, word) == 0) {
+					// Carry on with the normal search from here
+					active_line = start_line = line;
+					has_looped = false;
+
+					word_start = pos;
+					word_len = tok.length;
+					context->selectionController->SetSelectionAndActive({ line }, line);
+					SetWord(word);
+					return true;
+				}
+				pos += tok.length;
+			}
+		}
+
+		if (++it == context->ass->Events.end())
+			it = context->ass->Events.begin();
+	} while (it != start);
+
+	return false;
+}
+
+void DialogSpellChecker::ScanFile() {
+	bool skip_comments = OPT_GET("Tool/Spell Checker/Skip Comments")->GetBool();
+	bool ignore_uppercase = OPT_GET("Tool/Spell Checker/Skip Uppercase")->GetBool();
+
+	std::vector<const AssDialogue *> lines;
+	for (auto const& line : context->ass->Events) {
+		if (!(skip_comments && line.Comment))
+			lines.push_back(&line);
+	}
+
+	// Tokenizing is the slow part for files with many lines, and each chunk
+	// only reads its own lines, so the chunks can be counted in parallel
+	const size_t slot_count = agi::parallel_concurrency();
+	std::vector<std::unordered_map<std::string, size_t>> counts(slot_count);
+	agi::parallel_for_slots(0, lines.size(), min_parallel_scan, [&](size_t slot, size_t begin, size_t end) {
+		count_words(lines.data() + begin, lines.data() + end, counts[slot]);
+	});
+
+	for (size_t t = 1; t < slot_count; ++t) {
+		for (auto const& word : counts[t])
+			counts[0][word.first] += word.second;
+	}
+
+	// Each distinct word only needs to be checked once
+	std::vector<std::string> words;
+	words.reserve(counts[0].size());
+	for (auto const& word : counts[0]) {
+		if (auto_ignore.count(word.first)) continue;
+		if (ignore_uppercase && word.first == boost::locale::to_upper(word.first)) continue;
+		words.push_back(word.first);
+	}
+
+	misspellings.clear();
+	for (auto const& word : SpellCheckerFactory::GetMisspelledWords(words))
+		misspellings.emplace_back(word, counts[0][word]);
+	sort(begin(misspellings), end(misspellings), [](std::pair<std::string, size_t> const& a, std::pair<std::string, size_t> const& b) {
+		return a.second != b.second ? a.second > b.second : a.first < b.first;
+	});
+
+	if (misspellings.empty()) {
+		wxMessageBox(_("Aegisub has found no spelling mistakes in this script."), _("Spell checking complete."));
+		return;
+	}
+
+	wxArrayString items;
+	for (auto const& word : misspellings)
+		items.push_back(fmt_wx("%s (%d)", word.first, word.second));
+	misspelling_list->Set(items);
+
+	GetSizer()->Show(misspelling_sizer, true, true);
+	Layout();
+	Fit();
+}
+
+void DialogSpellChecker::RemoveMisspelling(std::string const& word) {
+	auto it = find_if(begin(misspellings), end(misspellings), [&](std::pair<std::string, size_t> const& misspelling) {
+		return misspelling.first == word;
+	});
+	if (it == end(misspellings)) return;
+
+	misspelling_list->Delete(distance(begin(misspellings), it));
+	misspellings.erase(it);
+}
+
 void DialogSpellChecker::Replace() {
 	AssDialogue *active_line = context->selectionController->GetActiveLine();
 
@@ -48,6 +48,7 @@
 #include <boost/range/algorithm.hpp>
 #include <boost/range/algorithm_ext/push_back.hpp>
 #include <functional>
+#include <set>
 #include <vector>
 #include <wx/button.h>
 #include <wx/checkbox.h>
@@ -325,10 +326,10 @@ void DialogTimingProcessor::OnApply(wxCommandEvent &) {
 }
 
 std::vector<AssDialogue*> DialogTimingProcessor::SortDialogues() {
-	std::set<boost::flyweight<std::string>> styles;
+	std::set<FlyweightString> styles;
 	for (size_t i = 0; i < StyleList->GetCount(); ++i) {
 		if (StyleList->IsChecked(i))
-			styles.insert(boost::flyweight<std::string>(from_wx(StyleList->GetString(i))));
+			styles.insert(FlyweightString(from_wx(StyleList->GetString(i))));
 	}
 
 	std::vector<AssDialogue*> sorted;
@@ -368,35 +369,43 @@ static int get_closest_kf(std::vector<int> const& kf, int frame) {
 	return (pos == begin(kf) || *pos - frame < frame - *(pos - 1)) ? *pos : *(pos - 1);
 }
 
-template<class Iter, class Field>
-static int safe_time(Iter begin, Iter end, AssDialogue *comp, int initial, Field field, int const& (*cmp)(int const&, int const&)) {
-	// Compare to every previous line (yay for O(n^2)!) to see if it's OK to add lead-in
-	for (; begin != end; ++begin) {
-		// If the line doesn't already collide with this line, extend it only
-		// to the edge of the line
-		if (!comp->CollidesWith(*begin))
-			initial = cmp(initial, (*begin)->*field);
-	}
-	return initial;
-}
-
 void DialogTimingProcessor::Process() {
 	std::vector<AssDialogue*> sorted = SortDialogues();
 	if (sorted.empty()) return;
 
-	// Add lead-in/out
+	// Lines are only extended up to the edge of lines which they don't
+	// already overlap. Sweeping through them in order with the edges seen so
+	// far makes finding the nearest edge O(log n) rather than O(n).
+	std::multiset<int> edges;
+
+	// Add lead-in
 	if (hasLeadIn->IsChecked() && leadIn) {
-		for (size_t i = 0; i < sorted.size(); ++i)
-			sorted[i]->Start = safe_time(sorted.rend() - i, sorted.rend(),
-				sorted[i], sorted[i]->Start - leadIn,
-				&AssDialogue::End, &std::max<int>);
+		for (AssDialogue *cur : sorted) {
+			const int end = cur->End;
+			// The latest end of an earlier line which ends before this starts
+			auto it = edges.upper_bound(cur->Start);
+			if (it != edges.begin())
+				cur->Start = std::max<int>(cur->Start - leadIn, *std::prev(it));
+			else
+				cur->Start = cur->Start - leadIn;
+			edges.insert(end);
+		}
 	}
 
+	// Add lead-out
 	if (hasLeadOut->IsChecked() && leadOut) {
-		for (size_t i = 0; i < sorted.size(); ++i)
-			sorted[i]->End = safe_time(sorted.begin() + i + 1, sorted.end(),
-				sorted[i], sorted[i]->End + leadOut,
-				&AssDialogue::Start, &std::min<int>);
+		edges.clear();
+		for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
+			AssDialogue *cur = *it;
+			const int start = cur->Start;
+			// The earliest start of a later line which starts after this ends
+			auto next = edges.lower_bound(cur->End);
+			if (next != edges.end())
+				cur->End = std::min<int>(cur->End + leadOut, *next);
+			else
+				cur->End = cur->End + leadOut;
+			edges.insert(start);
+		}
 	}
 
 	// Make adjacent
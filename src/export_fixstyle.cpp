@@ -47,13 +47,31 @@ AssFixStylesFilter::AssFixStylesFilter()
 {
 }
 
-void AssFixStylesFilter::ProcessSubs(AssFile *subs) {
+namespace {
+std::vector<std::string> sorted_lower_styles(AssFile *subs) {
 	auto styles = subs->GetStyles();
 	for (auto& str : styles) boost::to_lower(str);
 	sort(begin(styles), end(styles));
+	return styles;
+}
+
+void fix_style(std::vector<std::string> const& styles, AssDialogue& diag) {
+	if (!binary_search(begin(styles), end(styles), boost::to_lower_copy(diag.Style.get())))
+		diag.Style = "Default";
+}
+}
+
+void AssFixStylesFilter::ProcessSubs(AssFile *subs) {
+	auto styles = sorted_lower_styles(subs);
+	for (auto& diag : subs->Events)
+		fix_style(styles, diag);
+}
+
+bool AssFixStylesFilter::BeginLines(AssFile *subs) {
+	styles = sorted_lower_styles(subs);
+	return true;
+}
 
-	for (auto& diag : subs->Events) {
-		if (!binary_search(begin(styles), end(styles), boost::to_lower_copy(diag.Style.get())))
-			diag.Style = "Default";
-	}
+void AssFixStylesFilter::ProcessLine(AssDialogue *line) const {
+	fix_style(styles, *line);
 }
@@ -34,11 +34,19 @@
 
 #include "ass_export_filter.h"
 
+#include <string>
+#include <vector>
+
 /// @class AssFixStylesFilter
 /// @brief Fixes styles by replacing any style that isn't available on file with Default
 class AssFixStylesFilter final : public AssExportFilter {
+	/// Lowercased names of the styles in the file being exported, sorted
+	std::vector<std::string> styles;
+
 public:
 	static void ProcessSubs(AssFile *subs);
 	void ProcessSubs(AssFile *subs, wxWindow *) override { ProcessSubs(subs); }
+	bool BeginLines(AssFile *subs) override;
+	void ProcessLine(AssDialogue *line) const override;
 	AssFixStylesFilter();
 };
@@ -41,12 +41,12 @@
 #include "utils.h"
 
 #include <libaegisub/background_runner.h>
+#include <libaegisub/disk_cache.h>
 #include <libaegisub/fs.h>
-#include <libaegisub/path.h>
 
 #include <boost/algorithm/string/case_conv.hpp>
-#include <boost/crc.hpp>
 #include <boost/filesystem/path.hpp>
+#include <mutex>
 #include <wx/intl.h>
 #include <wx/choicdlg.h>
 
@@ -70,6 +70,71 @@ FFmpegSourceProvider::FFmpegSourceProvider(agi::BackgroundRunner *br)
 	FFMS_Init(0, 0);
 }
 
+namespace {
+/// The most recently used index, so that opening the audio of a video which
+/// was just opened doesn't have to read the index from disk again
+struct {
+	std::mutex mutex;
+	agi::fs::path filename;
+	std::shared_ptr<FFMS_Index> index;
+} last_index;
+
+std::shared_ptr<FFMS_Index> GetLastIndex(agi::fs::path const& filename) {
+	std::lock_guard<std::mutex> lock(last_index.mutex);
+	if (last_index.filename == filename)
+		return last_index.index;
+	return nullptr;
+}
+
+void SetLastIndex(agi::fs::path const& filename, std::shared_ptr<FFMS_Index> index) {
+	std::lock_guard<std::mutex> lock(last_index.mutex);
+	last_index.filename = filename;
+	last_index.index = std::move(index);
+}
+
+/// Check if an index is for the given file and can be used to open a track
+/// @param Track Track which must have been indexed, or -1 for any
+bool IndexIsUsable(FFMS_Index *Index, agi::fs::path const& filename, int Track,
+                   FFMS_IndexErrorHandling IndexEH, FFMS_ErrorInfo *ErrInfo) {
+	if (!Index || FFMS_IndexBelongsToFile(Index, filename.string().c_str(), ErrInfo))
+		return false;
+
+	// the desired track may not have been indexed
+	if (Track >= 0 && FFMS_GetNumFrames(FFMS_GetTrackFromIndex(Index, Track)) <= 0)
+		return false;
+
+	// reindex if the error handling mode has changed
+#if FFMS_VERSION >= ((2 << 24) | (17 << 16) | (2 << 8) | 0)
+	if (FFMS_GetErrorHandling(Index) != IndexEH)
+		return false;
+#endif
+
+	return true;
+}
+
+FFMS_Index *RunIndexer(FFMS_Indexer *Indexer, FFmpegSourceProvider::TrackSelection Track,
+                       FFMS_IndexErrorHandling IndexEH, TIndexCallback callback,
+                       void *callback_data, FFMS_ErrorInfo *ErrInfo) {
+	using TrackSelection = FFmpegSourceProvider::TrackSelection;
+#if FFMS_VERSION >= ((2 << 24) | (21 << 16) | (0 << 8) | 0)
+	if (Track == TrackSelection::All)
+		FFMS_TrackTypeIndexSettings(Indexer, FFMS_TYPE_AUDIO, 1, 0);
+	else if (Track != TrackSelection::None)
+		FFMS_TrackIndexSettings(Indexer, static_cast<int>(Track), 1, 0);
+	FFMS_SetProgressCallback(Indexer, callback, callback_data);
+	return FFMS_DoIndexing2(Indexer, IndexEH, ErrInfo);
+#else
+	int Trackmask = 0;
+	if (Track == TrackSelection::All)
+		Trackmask = std::numeric_limits<int>::max();
+	else if (Track != TrackSelection::None)
+		Trackmask = 1 << static_cast<int>(Track);
+	return FFMS_DoIndexing(Indexer, Trackmask, 0,
+		nullptr, nullptr, IndexEH, callback, callback_data, ErrInfo);
+#endif
+}
+}
+
 /// @brief Does indexing of a source file
 /// @param Indexer		A pointer to the indexer object representing the file to be indexed
 /// @param CacheName    The filename of the output index file
@@ -95,22 +160,7 @@ FFMS_Index *FFmpegSourceProvider::DoIndexing(FFMS_Indexer *Indexer,
 			ps->SetProgress(Current, Total);
 			return ps->IsCancelled();
 		};
-#if FFMS_VERSION >= ((2 << 24) | (21 << 16) | (0 << 8) | 0)
-		if (Track == TrackSelection::All)
-			FFMS_TrackTypeIndexSettings(Indexer, FFMS_TYPE_AUDIO, 1, 0);
-		else if (Track != TrackSelection::None)
-			FFMS_TrackIndexSettings(Indexer, static_cast<int>(Track), 1, 0);
-		FFMS_SetProgressCallback(Indexer, callback, ps);
-		Index = FFMS_DoIndexing2(Indexer, IndexEH, &ErrInfo);
-#else
-		int Trackmask = 0;
-		if (Track == TrackSelection::All)
-			Trackmask = std::numeric_limits<int>::max();
-		else if (Track != TrackSelection::None)
-			Trackmask = 1 << static_cast<int>(Track);
-		Index = FFMS_DoIndexing(Indexer, Trackmask, 0,
-			nullptr, nullptr, IndexEH, callback, ps, &ErrInfo);
-#endif
+		Index = RunIndexer(Indexer, Track, IndexEH, callback, ps, &ErrInfo);
 	});
 
 	if (Index == nullptr)
@@ -118,10 +168,104 @@ FFMS_Index *FFmpegSourceProvider::DoIndexing(FFMS_Indexer *Indexer,
 
 	// write index to disk for later use
 	FFMS_WriteIndex(CacheName.string().c_str(), Index, &ErrInfo);
+	GetMediaCache().Added(CacheName);
+
+	return Index;
+}
+
+/// @brief Get an index for a file, from the cache if possible
+/// @param Indexer  The indexer object representing the source file; consumed
+/// @param filename The source file
+/// @param Track    The track which is going to be opened, or -1 for the first video track
+///
+/// The video and audio providers share indexes, so when the file has to be
+/// indexed, all of the tracks which are going to be opened are indexed in
+/// the same pass rather than just the requested one.
+std::shared_ptr<FFMS_Index> FFmpegSourceProvider::GetIndex(FFMS_Indexer *Indexer,
+	                                                       agi::fs::path const& filename,
+	                                                       int Track) {
+	char FFMSErrMsg[1024];
+	FFMS_ErrorInfo ErrInfo;
+	ErrInfo.Buffer		= FFMSErrMsg;
+	ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
+	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
+	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+
+	auto CacheName = GetCacheFilename(filename);
+	auto IndexEH = GetErrorHandlingMode();
+
+	auto Index = GetLastIndex(filename);
+	if (!IndexIsUsable(Index.get(), filename, Track, IndexEH, &ErrInfo))
+		Index.reset(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo), FFMS_DestroyIndex);
+
+	if (!IndexIsUsable(Index.get(), filename, Track, IndexEH, &ErrInfo)) {
+		auto Tracks = TrackSelection::None;
+		if (IndexAllAudioTracks())
+			Tracks = TrackSelection::All;
+		else if (Track >= 0 && FFMS_GetTrackTypeI(Indexer, Track) == FFMS_TYPE_AUDIO)
+			Tracks = static_cast<TrackSelection>(Track);
+		Index.reset(DoIndexing(Indexer, CacheName, Tracks, IndexEH), FFMS_DestroyIndex);
+	}
+	else
+		FFMS_CancelIndexing(Indexer);
+
+	SetLastIndex(filename, Index);
 
 	return Index;
 }
 
+/// @brief Index a file into the index cache without showing any UI
+/// @param filename  The file to index
+/// @param CacheName The filename of the output index file
+/// @param Track     The audio tracks to index
+/// @param IndexEH   The error handling mode to index with
+/// @param progress  Called with the current and total progress; return true to cancel
+/// @return False if indexing was cancelled
+///
+/// Safe to call from a background thread. Nothing is done if the cache
+/// already has an index for the file. Failing to index is not reported, as
+/// the provider will try again when the file is opened and report it then.
+bool FFmpegSourceProvider::IndexToCache(agi::fs::path const& filename,
+	                                    agi::fs::path const& CacheName,
+	                                    TrackSelection Track,
+	                                    FFMS_IndexErrorHandling IndexEH,
+	                                    std::function<bool(int64_t, int64_t)> const& progress) {
+	char FFMSErrMsg[1024];
+	FFMS_ErrorInfo ErrInfo;
+	ErrInfo.Buffer		= FFMSErrMsg;
+	ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
+	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
+	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+
+	std::shared_ptr<FFMS_Index> Index(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo), FFMS_DestroyIndex);
+	if (IndexIsUsable(Index.get(), filename, -1, IndexEH, &ErrInfo))
+		return true;
+
+	FFMS_Indexer *Indexer = FFMS_CreateIndexer(filename.string().c_str(), &ErrInfo);
+	if (!Indexer) return true;
+
+	struct CallbackData {
+		std::function<bool(int64_t, int64_t)> const& progress;
+		bool cancelled;
+	} data{progress, false};
+	TIndexCallback callback = [](int64_t Current, int64_t Total, void *Private) -> int {
+		auto data = static_cast<CallbackData *>(Private);
+		data->cancelled = data->progress(Current, Total);
+		return data->cancelled;
+	};
+	Index.reset(RunIndexer(Indexer, Track, IndexEH, callback, &data, &ErrInfo), FFMS_DestroyIndex);
+	if (!Index) return !data.cancelled;
+
+	FFMS_WriteIndex(CacheName.string().c_str(), Index.get(), &ErrInfo);
+	GetMediaCache().Added(CacheName);
+	SetLastIndex(filename, Index);
+	return true;
+}
+
+bool FFmpegSourceProvider::IndexAllAudioTracks() {
+	return OPT_GET("Provider/FFmpegSource/Index All Tracks")->GetBool() || OPT_GET("Video/Open Audio")->GetBool();
+}
+
 /// @brief Finds all tracks of the given type and return their track numbers and respective codec names
 /// @param Indexer	The indexer object representing the source file
 /// @param Type		The track type to look for
@@ -208,27 +352,7 @@ FFMS_IndexErrorHandling FFmpegSourceProvider::GetErrorHandlingMode() {
 /// @param filename	The name of the source file
 /// @return			Returns the generated filename.
 agi::fs::path FFmpegSourceProvider::GetCacheFilename(agi::fs::path const& filename) {
-	// Get the size of the file to be hashed
-	uintmax_t len = agi::fs::Size(filename);
-
-	// Get the hash of the filename
-	boost::crc_32_type hash;
-	hash.process_bytes(filename.string().c_str(), filename.string().size());
-
-	// Generate the filename
-	auto result = config::path->Decode("?local/ffms2cache/" + std::to_string(hash.checksum()) + "_" + std::to_string(len) + "_" + std::to_string(agi::fs::ModifiedTime(filename)) + ".ffindex");
-
-	// Ensure that folder exists
-	agi::fs::CreateDirectory(result.parent_path());
-
-	return result;
-}
-
-void FFmpegSourceProvider::CleanCache() {
-	::CleanCache(config::path->Decode("?local/ffms2cache/"),
-		"*.ffindex",
-		OPT_GET("Provider/FFmpegSource/Cache/Size")->GetInt(),
-		OPT_GET("Provider/FFmpegSource/Cache/Files")->GetInt());
+	return GetSourceCacheFilename(filename, ".ffindex");
 }
 
 #endif // WITH_FFMS2
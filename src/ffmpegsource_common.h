@@ -33,7 +33,9 @@
 ///
 
 #ifdef WITH_FFMS2
+#include <functional>
 #include <map>
+#include <memory>
 
 #include <ffms.h>
 
@@ -59,16 +61,20 @@ public:
 		All = -2
 	};
 
-	void CleanCache();
-
 	FFMS_Index *DoIndexing(FFMS_Indexer *Indexer, agi::fs::path const& Cachename,
 		                   TrackSelection Track,
 		                   FFMS_IndexErrorHandling IndexEH);
+	std::shared_ptr<FFMS_Index> GetIndex(FFMS_Indexer *Indexer, agi::fs::path const& filename, int Track);
+	static bool IndexToCache(agi::fs::path const& filename, agi::fs::path const& CacheName,
+	                         TrackSelection Track, FFMS_IndexErrorHandling IndexEH,
+	                         std::function<bool(int64_t, int64_t)> const& progress);
 	std::map<int, std::string> GetTracksOfType(FFMS_Indexer *Indexer, FFMS_TrackType Type);
 	TrackSelection AskForTrackSelection(const std::map<int, std::string>& TrackList, FFMS_TrackType Type);
 	agi::fs::path GetCacheFilename(agi::fs::path const& filename);
 	void SetLogLevel();
 	FFMS_IndexErrorHandling GetErrorHandlingMode();
+	/// Should all audio tracks be indexed when indexing a file for any reason?
+	static bool IndexAllAudioTracks();
 };
 
 #endif /* WITH_FFMS2 */
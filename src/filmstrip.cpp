@@ -0,0 +1,305 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file filmstrip.cpp
+/// @brief Background decoding of keyframe thumbnails
+/// @ingroup video_input
+
+#include "filmstrip.h"
+
+#include "include/aegisub/video_provider.h"
+#include "utils.h"
+#include "video_frame.h"
+#include "video_provider_manager.h"
+
+#include <libaegisub/disk_cache.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace {
+const char cache_magic[] = "AGITHMB1";
+const size_t cache_magic_size = sizeof(cache_magic) - 1;
+
+/// Header of a saved filmstrip, followed by num_thumbnails frame numbers and
+/// then the pixels of each thumbnail
+struct SavedCacheHeader {
+	char magic[8];
+	int32_t frame_count;
+	int32_t thumb_width;
+	int32_t thumb_height;
+	uint32_t num_thumbnails;
+};
+}
+
+void MakeThumbnail(VideoFrame const& frame, int width, int height, unsigned char *out) {
+	for (int y = 0; y < height; ++y) {
+		const size_t y0 = y * frame.height / height;
+		const size_t y1 = std::max(y0 + 1, (y + 1) * frame.height / height);
+		for (int x = 0; x < width; ++x) {
+			const size_t x0 = x * frame.width / width;
+			const size_t x1 = std::max(x0 + 1, (x + 1) * frame.width / width);
+
+			unsigned int b = 0, g = 0, r = 0;
+			for (size_t sy = y0; sy < y1; ++sy) {
+				const size_t row = frame.flipped ? frame.height - 1 - sy : sy;
+				const unsigned char *in = &frame.data[row * frame.pitch + x0 * 4];
+				for (size_t sx = x0; sx < x1; ++sx, in += 4) {
+					b += in[0];
+					g += in[1];
+					r += in[2];
+				}
+			}
+
+			const unsigned int count = static_cast<unsigned int>((y1 - y0) * (x1 - x0));
+			*out++ = static_cast<unsigned char>(r / count);
+			*out++ = static_cast<unsigned char>(g / count);
+			*out++ = static_cast<unsigned char>(b / count);
+		}
+	}
+}
+
+Filmstrip::Filmstrip(agi::fs::path const& video, std::string const& colormatrix, int height, agi::BackgroundRunner *br, std::function<void()> on_update)
+: provider(VideoProviderFactory::GetProvider(video, colormatrix, br))
+, queue(agi::dispatch::Create())
+, on_update(std::move(on_update))
+, frame_count(provider->GetFrameCount())
+, thumb_height(height)
+, cancelled(std::make_shared<std::atomic<bool>>(false))
+{
+	double dar = provider->GetDAR();
+	if (dar <= 0)
+		dar = double(provider->GetWidth()) / provider->GetHeight();
+	thumb_width = std::max(1, static_cast<int>(std::lround(height * dar)));
+
+	// Decoding at a bit over the thumbnail size is much faster than at full
+	// size for providers which support it, and still leaves enough pixels
+	// to average for a smooth thumbnail
+	provider->SetProxyScale(std::min(1.0, 2.0 * height / provider->GetHeight()));
+
+	ChooseFrames(provider->GetKeyFrames());
+	pixels.resize(frames.size() * thumb_width * thumb_height * 3);
+	ready.resize(frames.size());
+
+	// Dummy video has no file to key the cache on
+	if (agi::fs::FileExists(video))
+		cache_file = GetSourceCacheFilename(video, ".thumbs");
+
+	queue->Async([=] {
+		if (LoadCache())
+			NotifyUpdate();
+		else
+			QueueDecoding();
+	});
+}
+
+Filmstrip::~Filmstrip() {
+	*cancelled = true;
+	// Wait for the thumbnail currently being decoded; the rest of the queue
+	// sees that it's been cancelled and does nothing
+	queue->Sync([] { }, agi::dispatch::Priority::Background);
+}
+
+void Filmstrip::ChooseFrames(std::vector<int> const& all_keyframes) {
+	std::vector<int> keyframes;
+	for (int frame : all_keyframes) {
+		if (frame >= 0 && frame < frame_count)
+			keyframes.push_back(frame);
+	}
+
+	if (keyframes.size() <= max_thumbnails && !keyframes.empty()) {
+		frames = std::move(keyframes);
+		return;
+	}
+
+	// Too many keyframes (or none at all, in which case any frame will do),
+	// so pick the keyframe at or before the middle of each of max_thumbnails
+	// evenly sized ranges of the video
+	const size_t count = std::min<size_t>(max_thumbnails, frame_count);
+	for (size_t i = 0; i < count; ++i) {
+		int frame = static_cast<int>((2 * i + 1) * static_cast<int64_t>(frame_count) / (2 * count));
+		if (!keyframes.empty()) {
+			auto it = std::upper_bound(keyframes.begin(), keyframes.end(), frame);
+			frame = it == keyframes.begin() ? keyframes.front() : *std::prev(it);
+		}
+		if (frames.empty() || frames.back() != frame)
+			frames.push_back(frame);
+	}
+}
+
+void Filmstrip::QueueDecoding() {
+	// Decode every 2^nth thumbnail, then every 2^(n-1)th and so on, so that
+	// the whole filmstrip fills in at low detail first
+	size_t step = 1;
+	while (step * 2 < frames.size()) step *= 2;
+
+	std::vector<char> queued(frames.size());
+	for (; step > 0; step /= 2) {
+		for (size_t i = 0; i < frames.size(); i += step) {
+			if (queued[i]) continue;
+			queued[i] = true;
+			// Each thumbnail is a separate task so that the queue's thread is
+			// given up between them
+			queue->Async([=] { DecodeThumbnail(i); }, agi::dispatch::Priority::Background);
+		}
+	}
+
+	queue->Async([=] { SaveCache(); }, agi::dispatch::Priority::Background);
+}
+
+void Filmstrip::DecodeThumbnail(size_t i) {
+	if (*cancelled) return;
+
+	std::vector<unsigned char> rgb(thumb_width * thumb_height * 3);
+	try {
+		auto frame = provider->GetSharedFrame(frames[i]);
+		if (frame->format == VideoFrameFormat::BGRA)
+			MakeThumbnail(*frame, thumb_width, thumb_height, rgb.data());
+		else {
+			VideoFrame converted;
+			ConvertToBGRA(*frame, converted);
+			MakeThumbnail(converted, thumb_width, thumb_height, rgb.data());
+		}
+	}
+	catch (VideoProviderError const& err) {
+		LOG_D("video/filmstrip") << "Failed to decode frame " << frames[i] << ": " << err.GetMessage();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::copy(rgb.begin(), rgb.end(), pixels.begin() + i * rgb.size());
+		ready[i] = true;
+		++ready_count;
+	}
+	NotifyUpdate();
+}
+
+void Filmstrip::NotifyUpdate() {
+	// Only queue one update at a time, as thumbnails can be decoded faster
+	// than the display can be repainted
+	if (update_pending.exchange(true)) return;
+
+	auto cancelled = this->cancelled;
+	agi::dispatch::Main().Async([=] {
+		if (*cancelled) return;
+		update_pending = false;
+		on_update();
+	});
+}
+
+bool Filmstrip::GetThumbnail(int frame, int &thumb_frame, std::vector<unsigned char> &rgb) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!ready_count) return false;
+
+	// Search outwards from the thumbnails on either side of the frame for
+	// the nearest one which is ready
+	const size_t count = frames.size();
+	size_t after = std::lower_bound(frames.begin(), frames.end(), frame) - frames.begin();
+	size_t before = after;
+	size_t found = count;
+	while (found == count && (before > 0 || after < count)) {
+		bool use_before = before > 0 && (after >= count || frame - frames[before - 1] <= frames[after] - frame);
+		if (use_before) {
+			if (ready[--before]) found = before;
+		}
+		else if (ready[after]) found = after;
+		else ++after;
+	}
+	if (found == count) return false;
+
+	const size_t size = thumb_width * thumb_height * 3;
+	thumb_frame = frames[found];
+	rgb.assign(pixels.begin() + found * size, pixels.begin() + (found + 1) * size);
+	return true;
+}
+
+bool Filmstrip::LoadCache() {
+	if (cache_file.empty() || !agi::fs::FileExists(cache_file)) return false;
+
+	try {
+		auto in = agi::io::Open(cache_file, true);
+
+		SavedCacheHeader header;
+		in->read(reinterpret_cast<char *>(&header), sizeof(header));
+		if (!*in || memcmp(header.magic, cache_magic, cache_magic_size)
+			|| header.frame_count != frame_count
+			|| header.thumb_width != thumb_width
+			|| header.thumb_height != thumb_height
+			|| header.num_thumbnails != frames.size())
+			return false;
+
+		std::vector<int32_t> saved_frames(frames.size());
+		in->read(reinterpret_cast<char *>(saved_frames.data()), saved_frames.size() * sizeof(int32_t));
+		if (!*in || !std::equal(saved_frames.begin(), saved_frames.end(), frames.begin()))
+			return false;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		in->read(reinterpret_cast<char *>(pixels.data()), pixels.size());
+		if (!*in) return false;
+		std::fill(ready.begin(), ready.end(), true);
+		ready_count = ready.size();
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("video/filmstrip") << "Failed to load filmstrip cache: " << e.GetMessage();
+		return false;
+	}
+
+	// update access time of the cache file so it won't get cleaned away
+	agi::fs::Touch(cache_file);
+	LOG_D("video/filmstrip") << "Loaded thumbnails from " << cache_file;
+	return true;
+}
+
+void Filmstrip::SaveCache() {
+	if (*cancelled || cache_file.empty()) return;
+
+	std::vector<int32_t> saved_frames(frames.begin(), frames.end());
+	std::vector<unsigned char> saved_pixels;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Frames which failed to decode would be retried next time
+		if (ready_count != frames.size()) return;
+		saved_pixels = pixels;
+	}
+
+	try {
+		SavedCacheHeader header;
+		memcpy(header.magic, cache_magic, cache_magic_size);
+		header.frame_count = frame_count;
+		header.thumb_width = thumb_width;
+		header.thumb_height = thumb_height;
+		header.num_thumbnails = static_cast<uint32_t>(frames.size());
+
+		agi::io::Save file(cache_file, true);
+		auto& out = file.Get();
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char *>(saved_frames.data()), saved_frames.size() * sizeof(int32_t));
+		out.write(reinterpret_cast<const char *>(saved_pixels.data()), saved_pixels.size());
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("video/filmstrip") << "Failed to save filmstrip cache: " << e.GetMessage();
+		return;
+	}
+
+	GetMediaCache().Added(cache_file);
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file filmstrip.h
+/// @see filmstrip.cpp
+/// @ingroup video_input
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <boost/filesystem/path.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class VideoProvider;
+struct VideoFrame;
+namespace agi {
+	class BackgroundRunner;
+	namespace dispatch { class Queue; }
+}
+
+/// @class Filmstrip
+/// @brief Small thumbnails of a video's keyframes, decoded in the background
+///
+/// The thumbnails are decoded with a separate provider on a separate queue
+/// from the one which displays the video, so building the filmstrip never
+/// makes seeking wait. Only keyframes are decoded, as they don't need any
+/// other frames to be decoded first, and at most max_thumbnails of them.
+/// Once every thumbnail has been decoded they're saved to a cache file next
+/// to the FFMS2 indexes, so reopening the video doesn't decode them again.
+class Filmstrip {
+	/// Provider used only for decoding thumbnails
+	std::unique_ptr<VideoProvider> provider;
+	/// Queue which thumbnails are decoded on
+	std::unique_ptr<agi::dispatch::Queue> queue;
+	/// Called on the main thread when more thumbnails are ready
+	std::function<void()> on_update;
+	agi::fs::path cache_file;
+
+	int frame_count = 0;
+	int thumb_width = 0;
+	int thumb_height = 0;
+	/// Frame number of each thumbnail, in ascending order
+	std::vector<int> frames;
+
+	/// Guards pixels and ready, which are written by the decoding queue
+	mutable std::mutex mutex;
+	/// 24-bit RGB pixels of each thumbnail, one after another
+	std::vector<unsigned char> pixels;
+	/// Has each thumbnail been decoded?
+	std::vector<char> ready;
+	size_t ready_count = 0;
+
+	/// Set when the filmstrip is destroyed. Shared with the updates queued on
+	/// the main thread so that they can tell if they're too late.
+	std::shared_ptr<std::atomic<bool>> cancelled;
+	/// Is there already an update queued on the main thread?
+	std::atomic<bool> update_pending{false};
+
+	/// Choose which frames to make thumbnails of
+	void ChooseFrames(std::vector<int> const& keyframes);
+	/// Queue decoding of the thumbnails which weren't in the cache
+	void QueueDecoding();
+	/// Decode one thumbnail
+	void DecodeThumbnail(size_t i);
+	/// Tell the owner that more thumbnails are ready
+	void NotifyUpdate();
+
+	bool LoadCache();
+	void SaveCache();
+
+public:
+	/// Maximum number of thumbnails to decode
+	static const size_t max_thumbnails = 256;
+
+	/// @param video       Video file to make thumbnails of
+	/// @param colormatrix YCbCr matrix to decode the video with
+	/// @param height      Height of each thumbnail in pixels
+	/// @param br          Progress reporter for if the video has to be indexed
+	/// @param on_update   Called on the main thread when more thumbnails are ready
+	///
+	/// Throws the same errors as VideoProviderFactory::GetProvider if the
+	/// video can't be opened.
+	Filmstrip(agi::fs::path const& video, std::string const& colormatrix, int height, agi::BackgroundRunner *br, std::function<void()> on_update);
+	~Filmstrip();
+
+	int GetThumbnailWidth() const { return thumb_width; }
+	int GetThumbnailHeight() const { return thumb_height; }
+	int GetFrameCount() const { return frame_count; }
+
+	/// @brief Find the ready thumbnail closest to a frame
+	/// @param frame Frame to find the thumbnail for
+	/// @param[out] thumb_frame Frame number of the thumbnail found
+	/// @param[out] rgb Receives the thumbnail's pixels
+	/// @return Was a thumbnail found? None are if none are ready yet.
+	bool GetThumbnail(int frame, int &thumb_frame, std::vector<unsigned char> &rgb) const;
+};
+
+/// @brief Scale a frame down to a 24-bit RGB thumbnail
+/// @param frame  BGRA frame to scale
+/// @param width  Width of the thumbnail
+/// @param height Height of the thumbnail
+/// @param out    Receives width * height * 3 bytes of pixels
+///
+/// Each thumbnail pixel is the average of the frame pixels it covers.
+void MakeThumbnail(VideoFrame const& frame, int width, int height, unsigned char *out);
@@ -17,12 +17,17 @@
 #pragma once
 
 #include <boost/flyweight.hpp>
+#include <boost/version.hpp>
 
+// Boost 1.56 and later provide this (also hashing by address) for every
+// flyweight configuration
+#if BOOST_VERSION < 105600
 namespace std {
-	template <typename T>
-	struct hash<boost::flyweight<T>> {
-		size_t operator()(boost::flyweight<T> const& ss) const {
+	template <typename T, typename A1, typename A2, typename A3, typename A4, typename A5>
+	struct hash<boost::flyweight<T, A1, A2, A3, A4, A5>> {
+		size_t operator()(boost::flyweight<T, A1, A2, A3, A4, A5> const& ss) const {
 			return hash<const void*>()(&ss.get());
 		}
 	};
 }
+#endif
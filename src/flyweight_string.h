@@ -0,0 +1,34 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <boost/flyweight.hpp>
+#include <boost/flyweight/hashed_factory.hpp>
+#include <functional>
+#include <string>
+
+/// Hash used to intern the strings of dialogue lines. boost::hash combines
+/// strings one byte at a time, which is slow for the long lines produced by
+/// karaoke templates; std::hash hashes a word at a time.
+struct FlyweightStringHash {
+	size_t operator()(std::string const& str) const {
+		return std::hash<std::string>()(str);
+	}
+};
+
+/// Interned string used for the text fields of dialogue lines
+typedef boost::flyweight<std::string, boost::flyweights::hashed_factory<FlyweightStringHash>> FlyweightString;
@@ -24,6 +24,8 @@
 
 #include <libaegisub/format_flyweight.h>
 #include <libaegisub/format_path.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/parallel.h>
 
 #include <algorithm>
 #include <tuple>
@@ -31,6 +33,9 @@
 #include <wx/intl.h>
 
 namespace {
+/// Number of lines parsed at a time by each thread
+const size_t lines_per_batch = 1000;
+
 wxString format_missing(wxString const& str) {
 	wxString printable;
 	wxString unprintable;
@@ -55,17 +60,15 @@ wxString format_missing(wxString const& str) {
 
 FontCollector::FontCollector(FontCollectorStatusCallback status_callback)
 : status_callback(std::move(status_callback))
-, lister(this->status_callback)
 {
 }
 
-void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
+void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index, ParseResults& results) const {
 	if (line->Comment) return;
 
 	auto style_it = styles.find(line->Style);
 	if (style_it == end(styles)) {
-		status_callback(fmt_tl("Style '%s' does not exist\n", line->Style), 2);
-		++missing;
+		results.missing_styles.emplace_back(index, line->Style);
 		return;
 	}
 
@@ -74,12 +77,14 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 
 	bool overriden = false;
 
-	for (auto& block : line->ParseTags()) {
+	auto blocks = line->GetParsedBlocks();
+	for (auto& block : *blocks) {
 		switch (block->GetType()) {
 		case AssBlockType::OVERRIDE:
-			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
+			for (auto const& tag : static_cast<AssDialogueBlockOverride const&>(*block).Tags) {
 				if (tag.Name == "\\r") {
-					style = styles[tag.Params[0].Get(line->Style.get())];
+					auto it = styles.find(tag.Params[0].Get(line->Style.get()));
+					style = it == end(styles) ? StyleInfo{} : it->second;
 					overriden = false;
 				}
 				else if (tag.Name == "\\b") {
@@ -102,7 +107,7 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 			if (text.empty())
 				continue;
 
-			auto& usage = used_styles[style];
+			auto& usage = results.used_styles[style];
 
 			if (overriden) {
 				auto& lines = usage.lines;
@@ -133,9 +138,6 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 				U8_NEXT(&text[0], i, size, c);
 				chars.push_back(c);
 			}
-
-			sort(begin(chars), end(chars));
-			chars.erase(unique(chars.begin(), chars.end()), chars.end());
 			break;
 		}
 		case AssBlockType::DRAWING:
@@ -148,7 +150,7 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 void FontCollector::ProcessChunk(std::pair<StyleInfo, UsageData> const& style) {
 	if (style.second.chars.empty()) return;
 
-	auto res = lister.GetFontPaths(style.first.facename, style.first.bold, style.first.italic, style.second.chars);
+	auto res = lister->GetFontPaths(style.first.facename, style.first.bold, style.first.italic, style.second.chars);
 
 	if (res.paths.empty()) {
 		status_callback(fmt_tl("Could not find font '%s'\n", style.first.facename), 2);
@@ -198,10 +200,7 @@ void FontCollector::PrintUsage(UsageData const& data) {
 	status_callback("\n", 2);
 }
 
-std::vector<agi::fs::path> FontCollector::GetFontPaths(const AssFile *file) {
-	missing = 0;
-	missing_glyphs = 0;
-
+void FontCollector::ParseFile(const AssFile *file) {
 	status_callback(_("Parsing file\n"), 0);
 
 	for (auto const& style : file->Styles) {
@@ -212,9 +211,57 @@ std::vector<agi::fs::path> FontCollector::GetFontPaths(const AssFile *file) {
 		used_styles[info].styles.push_back(style.name);
 	}
 
-	int index = 0;
+	std::vector<const AssDialogue *> lines;
 	for (auto const& diag : file->Events)
-		ProcessDialogueLine(&diag, ++index);
+		lines.push_back(&diag);
+
+	std::vector<ParseResults> partials(agi::parallel_concurrency());
+	agi::parallel_for_slots(0, lines.size(), lines_per_batch, [&](size_t slot, size_t begin, size_t end) {
+		auto& results = partials[slot];
+		for (size_t i = begin; i < end; ++i)
+			ProcessDialogueLine(lines[i], i + 1, results);
+
+		// Characters are deduplicated once per batch rather than once per
+		// block, which made long scripts quadratic
+		for (auto& usage : results.used_styles) {
+			auto& chars = usage.second.chars;
+			sort(chars.begin(), chars.end());
+			chars.erase(unique(chars.begin(), chars.end()), chars.end());
+		}
+	});
+
+	std::vector<std::pair<int, std::string>> missing_styles;
+	for (auto& partial : partials) {
+		for (auto& style : partial.used_styles) {
+			auto& usage = used_styles[style.first];
+			usage.chars.insert(usage.chars.end(), style.second.chars.begin(), style.second.chars.end());
+			usage.lines.insert(usage.lines.end(), style.second.lines.begin(), style.second.lines.end());
+		}
+		missing_styles.insert(missing_styles.end(), partial.missing_styles.begin(), partial.missing_styles.end());
+	}
+
+	for (auto& style : used_styles) {
+		auto& usage = style.second;
+		sort(begin(usage.chars), end(usage.chars));
+		usage.chars.erase(unique(usage.chars.begin(), usage.chars.end()), usage.chars.end());
+		sort(begin(usage.lines), end(usage.lines));
+	}
+
+	sort(begin(missing_styles), end(missing_styles));
+	for (auto const& style : missing_styles) {
+		status_callback(fmt_tl("Style '%s' does not exist\n", style.second), 2);
+		++missing;
+	}
+}
+
+std::vector<agi::fs::path> FontCollector::GetFontPaths(const AssFile *file) {
+	missing = 0;
+	missing_glyphs = 0;
+
+	ParseFile(file);
+
+	if (!lister)
+		lister = agi::make_unique<FontFileLister>(status_callback);
 
 	status_callback(_("Searching for font files\n"), 0);
 	for (auto const& style : used_styles) ProcessChunk(style);
@@ -237,6 +284,18 @@ std::vector<agi::fs::path> FontCollector::GetFontPaths(const AssFile *file) {
 	return paths;
 }
 
+std::vector<int> FontCollector::GetUsedCharacters(const AssFile *file) {
+	missing = 0;
+	ParseFile(file);
+
+	std::vector<int> chars;
+	for (auto const& style : used_styles)
+		chars.insert(chars.end(), style.second.chars.begin(), style.second.chars.end());
+	sort(begin(chars), end(chars));
+	chars.erase(unique(chars.begin(), chars.end()), chars.end());
+	return chars;
+}
+
 bool FontCollector::StyleInfo::operator<(StyleInfo const& rgt) const {
 	return std::tie(facename, bold, italic) < std::tie(rgt.facename, rgt.bold, rgt.italic);
 }
@@ -20,6 +20,7 @@
 #include <boost/filesystem/path.hpp>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -84,12 +85,17 @@ using FontFileLister = CoreTextFontFileLister;
 
 typedef struct _FcConfig FcConfig;
 typedef struct _FcFontSet FcFontSet;
+typedef struct _FcPattern FcPattern;
 
 /// @class FontConfigFontFileLister
 /// @brief fontconfig powered font lister
 class FontConfigFontFileLister {
 	agi::scoped_holder<FcConfig*> config;
 
+	/// Lowercase family and full names -> outline fonts with that name, in
+	/// the order fontconfig lists them. Owned by config.
+	std::unordered_map<std::string, std::vector<FcPattern *>> families;
+
 	/// @brief Case-insensitive match ASS/SSA font family against full name. (also known as "name for humans")
 	/// @param family font fullname
 	/// @param bold weight attribute
@@ -131,10 +137,18 @@ class FontCollector {
 		std::vector<std::string> styles; ///< ASS styles which use this style
 	};
 
+	/// What was found on one thread's share of the lines
+	struct ParseResults {
+		std::map<StyleInfo, UsageData> used_styles;
+		/// Lines whose style doesn't exist, and the style's name
+		std::vector<std::pair<int, std::string>> missing_styles;
+	};
+
 	/// Message callback provider by caller
 	FontCollectorStatusCallback status_callback;
 
-	FontFileLister lister;
+	/// Created when first needed, as setting it up can be slow
+	std::unique_ptr<FontFileLister> lister;
 
 	/// The set of all glyphs used in the file
 	std::map<StyleInfo, UsageData> used_styles;
@@ -147,8 +161,11 @@ class FontCollector {
 	/// Number of fonts which were found, but did not contain all used glyphs
 	int missing_glyphs = 0;
 
+	/// Find the characters used by each style in the file
+	void ParseFile(const AssFile *file);
+
 	/// Gather all of the unique styles with text on a line
-	void ProcessDialogueLine(const AssDialogue *line, int index);
+	void ProcessDialogueLine(const AssDialogue *line, int index, ParseResults& results) const;
 
 	/// Get the font for a single style
 	void ProcessChunk(std::pair<StyleInfo, UsageData> const& style);
@@ -167,4 +184,9 @@ public:
 	/// @param status Callback function for messages
 	/// @return List of paths to fonts
 	std::vector<agi::fs::path> GetFontPaths(const AssFile *file);
+
+	/// Get every character which glyphs are needed for in any style
+	/// @param file Subtitle file to check
+	/// @return Sorted list of codepoints
+	std::vector<int> GetUsedCharacters(const AssFile *file);
 };
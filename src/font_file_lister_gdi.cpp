@@ -17,14 +17,20 @@
 #include "font_file_lister.h"
 
 #include "compat.h"
+#include "options.h"
 
 #include <libaegisub/charset_conv_win.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/io.h>
 #include <libaegisub/log.h>
+#include <libaegisub/path.h>
 
 #include <ShlObj.h>
 #include <boost/scope_exit.hpp>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
 #include <unicode/utf16.h>
 #include <Usp10.h>
 
@@ -97,21 +103,73 @@ std::vector<agi::fs::path> get_installed_fonts() {
 
 using font_index = std::unordered_multimap<uint32_t, agi::fs::path>;
 
+/// Hash of the start of a font file, and what the file was like when it
+/// was computed
+struct CachedHash {
+	uint32_t hash;
+	time_t modified;
+	uintmax_t size;
+};
+
+/// Read the hashes saved by the last run, as opening every installed font
+/// takes a long time when there are thousands of them
+std::unordered_map<std::string, CachedHash> read_hash_cache(agi::fs::path const& cache_path) {
+	std::unordered_map<std::string, CachedHash> cache;
+	try {
+		auto stream = agi::io::Open(cache_path);
+		CachedHash entry;
+		long long modified;
+		std::string path;
+		// One font per line: hash, modification time, size, path
+		while (*stream >> entry.hash >> modified >> entry.size && stream->get() == ' ' && getline(*stream, path)) {
+			entry.modified = static_cast<time_t>(modified);
+			cache[path] = entry;
+		}
+	}
+	catch (agi::Exception const&) {
+		// Missing or unreadable; everything gets hashed again
+	}
+	return cache;
+}
+
 font_index index_fonts(FontCollectorStatusCallback &cb) {
 	font_index hash_to_path;
 	auto fonts = get_installed_fonts();
+
+	auto cache_path = config::path->Decode("?local/font_index.txt");
+	auto cache = read_hash_cache(cache_path);
+	std::unordered_map<std::string, CachedHash> new_cache;
+
 	std::unique_ptr<char[]> buffer(new char[1024]);
 	for (auto const& path : fonts) {
 		try {
-			auto stream = agi::io::Open(path, true);
-			stream->read(&buffer[0], 1024);
-			auto hash = murmur3(&buffer[0], stream->tellg());
-			hash_to_path.emplace(hash, path);
+			CachedHash entry{0, agi::fs::ModifiedTime(path), agi::fs::Size(path)};
+			auto it = cache.find(path.string());
+			if (it != cache.end() && it->second.modified == entry.modified && it->second.size == entry.size)
+				entry.hash = it->second.hash;
+			else {
+				auto stream = agi::io::Open(path, true);
+				stream->read(&buffer[0], 1024);
+				entry.hash = murmur3(&buffer[0], stream->tellg());
+			}
+			hash_to_path.emplace(entry.hash, path);
+			new_cache[path.string()] = entry;
 		}
 		catch (agi::Exception const& e) {
 			cb(to_wx(e.GetMessage() + "\n"), 3);
 		}
 	}
+
+	try {
+		agi::io::Save file(cache_path);
+		auto& out = file.Get();
+		for (auto const& entry : new_cache)
+			out << entry.second.hash << ' ' << (long long)entry.second.modified << ' ' << entry.second.size << ' ' << entry.first << '\n';
+	}
+	catch (agi::Exception const& e) {
+		LOG_W("font_collector") << "Could not save the font index: " << e.GetMessage();
+	}
+
 	return hash_to_path;
 }
 
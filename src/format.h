@@ -34,25 +34,32 @@ struct writer<wchar_t, wxString> {
 	}
 };
 
+template<>
+struct string_writer<wxStringCharType, wxString> {
+	static void write(format_detail::string_formatter<wxStringCharType>& out, wxString const& value) {
+		string_writer<wxStringCharType, const wxStringCharType *>::write(out, value.wx_str());
+	}
+};
+
 template<typename... Args>
 std::string format(wxString const& fmt, Args&&... args) {
-	boost::interprocess::basic_vectorstream<std::basic_string<char>> out;
-	format(out, (const char *)fmt.utf8_str(), std::forward<Args>(args)...);
-	return out.vector();
+	std::string out;
+	format_to(out, (const char *)fmt.utf8_str(), std::forward<Args>(args)...);
+	return out;
 }
 
 template<typename... Args>
 wxString wxformat(wxString const& fmt, Args&&... args) {
-	boost::interprocess::basic_vectorstream<std::basic_string<wxStringCharType>> out;
-	format(out, fmt.wx_str(), std::forward<Args>(args)...);
-	return out.vector();
+	std::basic_string<wxStringCharType> out;
+	format_to(out, fmt.wx_str(), std::forward<Args>(args)...);
+	return out;
 }
 
 template<typename... Args>
 wxString wxformat(const wxStringCharType *fmt, Args&&... args) {
-	boost::interprocess::basic_vectorstream<std::basic_string<wxStringCharType>> out;
-	format(out, fmt, std::forward<Args>(args)...);
-	return out.vector();
+	std::basic_string<wxStringCharType> out;
+	format_to(out, fmt, std::forward<Args>(args)...);
+	return out;
 }
 }
 
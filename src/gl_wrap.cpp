@@ -36,7 +36,10 @@ static const float pi = 3.1415926535897932384626433832795f;
 
 #ifdef __WIN32__
 #define glGetProc(a) wglGetProcAddress(a)
-#elif !defined(__APPLE__)
+#elif defined(__APPLE__)
+#include <dlfcn.h>
+#define glGetProc(a) dlsym(RTLD_DEFAULT, a)
+#else
 #include <GL/glx.h>
 #define glGetProc(a) glXGetProcAddress((const GLubyte *)(a))
 #endif
@@ -53,44 +56,44 @@ static const float pi = 3.1415926535897932384626433832795f;
 	}
 #endif
 
-class VertexArray {
-	std::vector<float> data;
-	size_t dim;
-public:
-	VertexArray(size_t dims, size_t elems) {
-		SetSize(dims, elems);
-	}
+namespace {
+struct BufferFunctions {
+#define GL_FN(ret, name, args) \
+	ret (APIENTRY *name) args = reinterpret_cast<ret (APIENTRY *) args>(OpenGLWrapper::GetProcAddress("gl" #name))
 
-	void SetSize(size_t dims, size_t elems) {
-		dim = dims;
-		data.resize(elems * dim);
-	}
+	GL_FN(void, GenBuffers, (GLsizei, GLuint *));
+	GL_FN(void, DeleteBuffers, (GLsizei, const GLuint *));
+	GL_FN(void, BindBuffer, (GLenum, GLuint));
+	GL_FN(void, BufferData, (GLenum, GLsizeiptr, const void *, GLenum));
+	GL_FN(void, BufferSubData, (GLenum, GLintptr, GLsizeiptr, const void *));
+#undef GL_FN
 
-	void Set(size_t i, float x, float y) {
-		data[i * dim] = x;
-		data[i * dim + 1] = y;
+	bool Loaded() const {
+		return GenBuffers && DeleteBuffers && BindBuffer && BufferData && BufferSubData;
 	}
+};
 
-	void Set(size_t i, float x, float y, float z) {
-		data[i * dim] = x;
-		data[i * dim + 1] = y;
-		data[i * dim + 2] = z;
-	}
+/// Vertex buffer functions, which can only be looked up once a context is
+/// current
+BufferFunctions const& Buffers() {
+	static BufferFunctions functions;
+	return functions;
+}
 
-	void Set(size_t i, Vector2D p) {
-		data[i * dim] = p.X();
-		data[i * dim + 1] = p.Y();
-	}
+void Append(std::vector<float>& vec, Vector2D p) {
+	vec.push_back(p.X());
+	vec.push_back(p.Y());
+}
 
-	void Draw(GLenum mode, bool clear = true) {
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glVertexPointer(dim, GL_FLOAT, 0, &data[0]);
-		glDrawArrays(mode, 0, data.size() / dim);
-		glDisableClientState(GL_VERTEX_ARRAY);
-		if (clear)
-			data.clear();
+void Append(std::vector<float>& vec, float r, float g, float b, float a, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		vec.push_back(r);
+		vec.push_back(g);
+		vec.push_back(b);
+		vec.push_back(a);
 	}
-};
+}
+}
 
 OpenGLWrapper::OpenGLWrapper() {
 	line_r = line_g = line_b = line_a = 1.f;
@@ -100,12 +103,113 @@ OpenGLWrapper::OpenGLWrapper() {
 	smooth = true;
 }
 
+OpenGLWrapper::~OpenGLWrapper() {
+	if (vertex_buffer)
+		Buffers().DeleteBuffers(1, &vertex_buffer);
+}
+
+void OpenGLWrapper::AddTriangle(Vector2D p1, Vector2D p2, Vector2D p3) const {
+	Append(fill_vertices, p1);
+	Append(fill_vertices, p2);
+	Append(fill_vertices, p3);
+	Append(fill_colours, fill_r, fill_g, fill_b, fill_a, 3);
+}
+
+void OpenGLWrapper::AddLine(Vector2D p1, Vector2D p2) const {
+	// All of the lines in a draw call have the same width
+	if (!line_vertices.empty() && (line_width != batch_line_width || smooth != batch_smooth))
+		Flush();
+	batch_line_width = line_width;
+	batch_smooth = smooth;
+
+	Append(line_vertices, p1);
+	Append(line_vertices, p2);
+	Append(line_colours, line_r, line_g, line_b, line_a, 2);
+}
+
+void OpenGLWrapper::BeginBatch() {
+	batching = true;
+}
+
+void OpenGLWrapper::EndBatch() {
+	batching = false;
+	Flush();
+}
+
+void OpenGLWrapper::Flush() const {
+	if (fill_vertices.empty() && line_vertices.empty()) return;
+
+	if (!vertex_buffer_tried) {
+		vertex_buffer_tried = true;
+		if (Buffers().Loaded()) {
+			Buffers().GenBuffers(1, &vertex_buffer);
+			if (glGetError())
+				vertex_buffer = 0;
+		}
+	}
+
+	// Everything goes in one buffer laid out as the fill vertices, fill
+	// colours, line vertices and then line colours
+	const std::vector<float> *parts[] = { &fill_vertices, &fill_colours, &line_vertices, &line_colours };
+	const float *pointers[4];
+	if (vertex_buffer) {
+		size_t total = 0;
+		for (auto part : parts)
+			total += part->size() * sizeof(float);
+
+		Buffers().BindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+		// Orphan the last batch's storage rather than waiting for it to be drawn
+		Buffers().BufferData(GL_ARRAY_BUFFER, total, nullptr, GL_STREAM_DRAW);
+		size_t offset = 0;
+		for (size_t i = 0; i < 4; ++i) {
+			const size_t size = parts[i]->size() * sizeof(float);
+			if (size)
+				Buffers().BufferSubData(GL_ARRAY_BUFFER, offset, size, parts[i]->data());
+			pointers[i] = reinterpret_cast<const float *>(offset);
+			offset += size;
+		}
+	}
+	else {
+		for (size_t i = 0; i < 4; ++i)
+			pointers[i] = parts[i]->data();
+	}
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	if (!fill_vertices.empty()) {
+		glVertexPointer(2, GL_FLOAT, 0, pointers[0]);
+		glColorPointer(4, GL_FLOAT, 0, pointers[1]);
+		glDrawArrays(GL_TRIANGLES, 0, fill_vertices.size() / 2);
+	}
+
+	if (!line_vertices.empty()) {
+		glLineWidth(batch_line_width);
+		if (batch_smooth)
+			glEnable(GL_LINE_SMOOTH);
+		else
+			glDisable(GL_LINE_SMOOTH);
+		glVertexPointer(2, GL_FLOAT, 0, pointers[2]);
+		glColorPointer(4, GL_FLOAT, 0, pointers[3]);
+		glDrawArrays(GL_LINES, 0, line_vertices.size() / 2);
+	}
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	if (vertex_buffer)
+		Buffers().BindBuffer(GL_ARRAY_BUFFER, 0);
+
+	fill_vertices.clear();
+	fill_colours.clear();
+	line_vertices.clear();
+	line_colours.clear();
+}
+
 void OpenGLWrapper::DrawLine(Vector2D p1, Vector2D p2) const {
-	SetModeLine();
-	VertexArray buf(2, 2);
-	buf.Set(0, p1);
-	buf.Set(1, p2);
-	buf.Draw(GL_LINES);
+	AddLine(p1, p2);
+	EndShape();
 }
 
 static inline Vector2D interp(Vector2D p1, Vector2D p2, float t) {
@@ -115,8 +219,9 @@ static inline Vector2D interp(Vector2D p1, Vector2D p2, float t) {
 void OpenGLWrapper::DrawDashedLine(Vector2D p1, Vector2D p2, float step) const {
 	step /= (p2 - p1).Len();
 	for (float t = 0; t < 1.f; t += 2 * step) {
-		DrawLine(interp(p1, p2, t), interp(p1, p2, t + step));
+		AddLine(interp(p1, p2, t), interp(p1, p2, t + step));
 	}
+	EndShape();
 }
 
 void OpenGLWrapper::DrawEllipse(Vector2D center, Vector2D radius) const {
@@ -124,40 +229,32 @@ void OpenGLWrapper::DrawEllipse(Vector2D center, Vector2D radius) const {
 }
 
 void OpenGLWrapper::DrawRectangle(Vector2D p1, Vector2D p2) const {
-	VertexArray buf(2, 4);
-	buf.Set(0, p1);
-	buf.Set(1, Vector2D(p2, p1));
-	buf.Set(2, p2);
-	buf.Set(3, Vector2D(p1, p2));
+	Vector2D corners[] = { p1, Vector2D(p2, p1), p2, Vector2D(p1, p2) };
 
 	// Fill
 	if (fill_a != 0.f) {
-		SetModeFill();
-		buf.Draw(GL_QUADS, false);
+		AddTriangle(corners[0], corners[1], corners[2]);
+		AddTriangle(corners[0], corners[2], corners[3]);
 	}
 	// Outline
 	if (line_a != 0.f) {
-		SetModeLine();
-		buf.Draw(GL_LINE_LOOP);
+		for (size_t i = 0; i < 4; ++i)
+			AddLine(corners[i], corners[(i + 1) % 4]);
 	}
+	EndShape();
 }
 
 void OpenGLWrapper::DrawTriangle(Vector2D p1, Vector2D p2, Vector2D p3) const {
-	VertexArray buf(2, 3);
-	buf.Set(0, p1);
-	buf.Set(1, p2);
-	buf.Set(2, p3);
-
 	// Fill
-	if (fill_a != 0.f) {
-		SetModeFill();
-		buf.Draw(GL_TRIANGLES, false);
-	}
+	if (fill_a != 0.f)
+		AddTriangle(p1, p2, p3);
 	// Outline
 	if (line_a != 0.f) {
-		SetModeLine();
-		buf.Draw(GL_LINE_LOOP);
+		AddLine(p1, p2);
+		AddLine(p2, p3);
+		AddLine(p3, p1);
 	}
+	EndShape();
 }
 
 void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, float arc_start, float arc_end) const {
@@ -176,72 +273,55 @@ void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, floa
 	// Math
 	int steps = std::max<int>(((r1 + r1 * ar) * range / (2.f * pi)) * 4, 12);
 	float step = range / steps;
-	float cur_angle = arc_start;
-
-	VertexArray buf(2, steps);
 
 	Vector2D scale_inner = Vector2D(ar, 1) * r1;
 	Vector2D scale_outer = Vector2D(ar, 1) * r2;
 
-	if (fill_a != 0.f) {
-		SetModeFill();
+	// Points around the outside of the ring, including both ends of the arc
+	std::vector<Vector2D> inner, outer;
+	inner.reserve(steps + 1);
+	outer.reserve(steps + 1);
+	float cur_angle = arc_start;
+	for (int i = 0; i <= steps; i++) {
+		Vector2D offset = Vector2D::FromAngle(cur_angle);
+		inner.push_back(center + offset * scale_inner);
+		outer.push_back(center + offset * scale_outer);
+		cur_angle += step;
+	}
 
+	if (fill_a != 0.f) {
 		// Annulus
 		if (r1 != r2) {
-			buf.SetSize(2, (steps + 1) * 2);
-			for (int i = 0; i <= steps; i++) {
-				Vector2D offset = Vector2D::FromAngle(cur_angle);
-				buf.Set(i * 2 + 0, center + offset * scale_inner);
-				buf.Set(i * 2 + 1, center + offset * scale_outer);
-				cur_angle += step;
+			for (int i = 0; i < steps; i++) {
+				AddTriangle(inner[i], outer[i], inner[i + 1]);
+				AddTriangle(outer[i], outer[i + 1], inner[i + 1]);
 			}
-			buf.Draw(GL_QUAD_STRIP);
 		}
 		// Circle
 		else {
-			buf.SetSize(2, steps);
-			for (int i = 0; i < steps; i++) {
-				buf.Set(i, center + Vector2D::FromAngle(cur_angle) * scale_inner);
-				cur_angle += step;
-			}
-			buf.Draw(GL_POLYGON);
+			for (int i = 1; i + 1 < steps; i++)
+				AddTriangle(inner[0], inner[i], inner[i + 1]);
 		}
-
-		cur_angle = arc_start;
 	}
 
-	if (line_a == 0.f) return;
-
-	// Outer
-	steps++;
-	buf.SetSize(2, steps);
-
-	SetModeLine();
-	for (int i = 0; i < steps; i++) {
-		buf.Set(i, center + Vector2D::FromAngle(cur_angle) * scale_outer);
-		cur_angle += step;
-	}
-	buf.Draw(GL_LINE_STRIP);
+	if (line_a != 0.f) {
+		// Outer
+		for (int i = 0; i < steps; i++)
+			AddLine(outer[i], outer[i + 1]);
 
-	// Inner
-	if (r1 == r2) return;
+		// Inner
+		if (r1 != r2) {
+			for (int i = 0; i < steps; i++)
+				AddLine(inner[i], inner[i + 1]);
 
-	cur_angle = arc_start;
-	buf.SetSize(2, steps);
-	for (int i = 0; i < steps; i++) {
-		buf.Set(i, center + Vector2D::FromAngle(cur_angle) * scale_inner);
-		cur_angle += step;
+			if (needs_end_caps) {
+				AddLine(center + Vector2D::FromAngle(arc_start) * scale_inner, center + Vector2D::FromAngle(arc_start) * scale_outer);
+				AddLine(center + Vector2D::FromAngle(arc_end) * scale_inner, center + Vector2D::FromAngle(arc_end) * scale_outer);
+			}
+		}
 	}
-	buf.Draw(GL_LINE_STRIP);
-
-	if (!needs_end_caps) return;
 
-	buf.SetSize(2, 4);
-	buf.Set(0, center + Vector2D::FromAngle(arc_start) * scale_inner);
-	buf.Set(1, center + Vector2D::FromAngle(arc_start) * scale_outer);
-	buf.Set(2, center + Vector2D::FromAngle(arc_end) * scale_inner);
-	buf.Set(3, center + Vector2D::FromAngle(arc_end) * scale_outer);
-	buf.Draw(GL_LINES);
+	EndShape();
 }
 
 void OpenGLWrapper::SetLineColour(wxColour col, float alpha, int width) {
@@ -260,6 +340,7 @@ void OpenGLWrapper::SetFillColour(wxColour col, float alpha) {
 }
 
 void OpenGLWrapper::SetModeLine() const {
+	Flush();
 	glColor4f(line_r, line_g, line_b, line_a);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -271,6 +352,7 @@ void OpenGLWrapper::SetModeLine() const {
 }
 
 void OpenGLWrapper::SetModeFill() const {
+	Flush();
 	glColor4f(fill_r, fill_g, fill_b, fill_a);
 	if (fill_a == 1.f) glDisable(GL_BLEND);
 	else {
@@ -280,6 +362,7 @@ void OpenGLWrapper::SetModeFill() const {
 }
 
 void OpenGLWrapper::SetInvert() {
+	Flush();
 	glEnable(GL_COLOR_LOGIC_OP);
 	glLogicOp(GL_INVERT);
 
@@ -288,6 +371,7 @@ void OpenGLWrapper::SetInvert() {
 }
 
 void OpenGLWrapper::ClearInvert() {
+	Flush();
 	glDisable(GL_COLOR_LOGIC_OP);
 	smooth = true;
 }
@@ -297,11 +381,16 @@ bool OpenGLWrapper::IsExtensionSupported(const char *ext) {
 	return extList && !!strstr(extList, ext);
 }
 
+void *OpenGLWrapper::GetProcAddress(const char *name) {
+	return reinterpret_cast<void *>(glGetProc(name));
+}
+
 void OpenGLWrapper::DrawLines(size_t dim, std::vector<float> const& lines) {
 	DrawLines(dim, &lines[0], lines.size() / dim);
 }
 
 void OpenGLWrapper::DrawLines(size_t dim, std::vector<float> const& lines, size_t c_dim, std::vector<float> const& colors) {
+	Flush();
 	glShadeModel(GL_SMOOTH);
 	glEnableClientState(GL_COLOR_ARRAY);
 	glColorPointer(c_dim, GL_FLOAT, 0, &colors[0]);
@@ -338,6 +427,7 @@ static void APIENTRY glMultiDrawArraysFallback(GLenum mode, const GLint *first,
 
 void OpenGLWrapper::DrawMultiPolygon(std::vector<float> const& points, std::vector<int> &start, std::vector<int> &count, Vector2D video_pos, Vector2D video_size, bool invert) {
 	GL_EXT(PFNGLMULTIDRAWARRAYSPROC, glMultiDrawArrays);
+	Flush();
 
 	float real_line_a = line_a;
 	line_a = 0;
@@ -355,6 +445,7 @@ void OpenGLWrapper::DrawMultiPolygon(std::vector<float> const& points, std::vect
 
 	Vector2D video_max = video_pos + video_size;
 	DrawRectangle(video_pos, video_max);
+	Flush();
 
 	// Increment the winding number for each forward facing triangle
 	glStencilOp(GL_INCR, GL_INCR, GL_INCR);
@@ -379,6 +470,7 @@ void OpenGLWrapper::DrawMultiPolygon(std::vector<float> const& points, std::vect
 	// wrapping combined with unsigned numbers)
 	glStencilFunc(invert ? GL_EQUAL : GL_NOTEQUAL, 128, 0xFF);
 	DrawRectangle(video_pos, video_max);
+	Flush();
 	glDisable(GL_STENCIL_TEST);
 
 	// Draw lines
@@ -423,6 +515,7 @@ void OpenGLWrapper::SetShear(float x, float y) {
 }
 
 void OpenGLWrapper::PrepareTransform() {
+	Flush();
 	if (!transform_pushed) {
 		glMatrixMode(GL_MODELVIEW);
 		glPushMatrix();
@@ -432,6 +525,7 @@ void OpenGLWrapper::PrepareTransform() {
 }
 
 void OpenGLWrapper::ResetTransform() {
+	Flush();
 	if (transform_pushed) {
 		glPopMatrix();
 		transform_pushed = false;
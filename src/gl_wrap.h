@@ -35,8 +35,46 @@ class OpenGLWrapper {
 	bool transform_pushed;
 	void PrepareTransform();
 
+	/// Vertices (x, y) and colours (r, g, b, a) of the triangles drawn since
+	/// the last flush
+	mutable std::vector<float> fill_vertices, fill_colours;
+	/// Vertices and colours of the line segments drawn since the last flush
+	mutable std::vector<float> line_vertices, line_colours;
+	/// Width and smoothing of the lines in line_vertices
+	mutable int batch_line_width = 1;
+	mutable bool batch_smooth = true;
+
+	/// Is a batch open? If not, each shape is drawn as soon as it's added.
+	bool batching = false;
+
+	/// Vertex buffer which batches are uploaded to, or 0 if there isn't one
+	mutable unsigned int vertex_buffer = 0;
+	/// Has creating vertex_buffer been tried?
+	mutable bool vertex_buffer_tried = false;
+
+	void AddTriangle(Vector2D p1, Vector2D p2, Vector2D p3) const;
+	void AddLine(Vector2D p1, Vector2D p2) const;
+	/// Draw the shapes just added unless a batch is open
+	void EndShape() const { if (!batching) Flush(); }
+	/// Draw and clear the shapes added since the last flush
+	void Flush() const;
+
 public:
 	OpenGLWrapper();
+	~OpenGLWrapper();
+	OpenGLWrapper(OpenGLWrapper const&) = delete;
+	OpenGLWrapper& operator=(OpenGLWrapper const&) = delete;
+
+	/// @brief Collect the shapes drawn until EndBatch to draw them all at once
+	///
+	/// Lines, rectangles, triangles and rings drawn in a batch are uploaded
+	/// in a single buffer and drawn with one call per primitive type, rather
+	/// than one or more calls each. Within a batch all filled areas are drawn
+	/// beneath all lines, and changing the transform or invert mode draws
+	/// what has been batched so far.
+	void BeginBatch();
+	/// Draw everything collected since BeginBatch
+	void EndBatch();
 
 	void SetLineColour(wxColour col, float alpha = 1.0f, int width = 1);
 	void SetFillColour(wxColour col, float alpha = 1.0f);
@@ -75,4 +113,9 @@ public:
 	void DrawMultiPolygon(std::vector<float> const& points, std::vector<int> &start, std::vector<int> &count, Vector2D video_pos, Vector2D video_size, bool invert);
 
 	static bool IsExtensionSupported(const char *ext);
+
+	/// Get the address of an OpenGL function which may not be exported by
+	/// the system's OpenGL library, or nullptr if it isn't available. A
+	/// context must be current.
+	static void *GetProcAddress(const char *name);
 };
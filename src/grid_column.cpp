@@ -25,6 +25,10 @@
 
 #include <libaegisub/character_count.h>
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
 #include <wx/dc.h>
 
 void WidthHelper::Age() {
@@ -37,7 +41,7 @@ void WidthHelper::Age() {
 	++age;
 }
 
-int WidthHelper::operator()(boost::flyweight<std::string> const& str) {
+int WidthHelper::operator()(FlyweightString const& str) {
 	if (str.get().empty()) return 0;
 	auto it = widths.find(str);
 	if (it != end(widths)) {
@@ -183,61 +187,97 @@ struct GridColumnEndTime final : GridColumnTime {
 	}
 };
 
-template<typename T>
-int max_width(T AssDialogueBase::*field, EntryList<AssDialogue> const& lines, WidthHelper &helper) {
-	int w = 0;
-	for (AssDialogue const& line : lines) {
-		auto const& v = line.*field;
-		if (v.get().empty()) continue;
-		int width = helper(v);
-		if (width > w)
-			w = width;
-	}
-	return w;
-}
+/// Column showing a string field, which is wide enough for the widest value
+///
+/// Measuring text is slow, so on files with a very large number of distinct
+/// values only the longest ones are measured right away, and the rest are
+/// measured a few at a time by RefineWidth.
+struct GridColumnString : GridColumn {
+	/// Most distinct values which UpdateWidth measures
+	static const size_t max_measured = 256;
+
+	FlyweightString AssDialogueBase::*field;
+	/// Width of the widest value measured so far
+	int text_width = 0;
+	/// Values which haven't been measured yet
+	std::vector<FlyweightString> unmeasured;
+
+	GridColumnString(FlyweightString AssDialogueBase::*field) : field(field) { }
 
-struct GridColumnStyle final : GridColumn {
-	COLUMN_HEADER(_("Style"))
-	COLUMN_DESCRIPTION(_("Style"))
 	bool Centered() const override { return false; }
 
-	wxString Value(const AssDialogue *d, const agi::Context *c) const override {
-		return to_wx(d->Style);
+	wxString Value(const AssDialogue *d, const agi::Context *) const override {
+		return to_wx(d->*field);
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Style, c->ass->Events, helper);
+	int Width(const agi::Context *, WidthHelper &) const override {
+		return text_width;
 	}
-};
 
-struct GridColumnEffect final : GridColumn {
-	COLUMN_HEADER(_("Effect"))
-	COLUMN_DESCRIPTION(_("Effect"))
-	bool Centered() const override { return false; }
+	void UpdateWidth(const agi::Context *c, WidthHelper &helper) override {
+		text_width = 0;
+		unmeasured.clear();
+		if (!visible) return GridColumn::UpdateWidth(c, helper);
 
-	wxString Value(const AssDialogue *d, const agi::Context *) const override {
-		return to_wx(d->Effect);
-	}
+		std::unordered_set<FlyweightString> values;
+		for (AssDialogue const& line : c->ass->Events) {
+			if (!(line.*field).get().empty())
+				values.insert(line.*field);
+		}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Effect, c->ass->Events, helper);
+		unmeasured.assign(begin(values), end(values));
+		if (unmeasured.size() > max_measured) {
+			// Longer strings are usually wider, so measure them first
+			std::nth_element(begin(unmeasured), end(unmeasured) - max_measured, end(unmeasured),
+				[](FlyweightString const& a, FlyweightString const& b) {
+					return a.get().size() < b.get().size();
+				});
+		}
+		Measure(helper, max_measured);
+		GridColumn::UpdateWidth(c, helper);
 	}
-};
 
-struct GridColumnActor final : GridColumn {
-	COLUMN_HEADER(_("Actor"))
-	COLUMN_DESCRIPTION(_("Actor"))
-	bool Centered() const override { return false; }
+	void UpdateWidth(const agi::Context *c, WidthHelper &helper, std::vector<const AssDialogue *> const& lines) override {
+		if (!visible) return;
+		for (auto line : lines)
+			text_width = std::max(text_width, helper(line->*field));
+		GridColumn::UpdateWidth(c, helper);
+	}
 
-	wxString Value(const AssDialogue *d, const agi::Context *) const override {
-		return to_wx(d->Actor);
+	bool RefineWidth(const agi::Context *c, WidthHelper &helper) override {
+		if (unmeasured.empty()) return false;
+		Measure(helper, max_measured);
+		GridColumn::UpdateWidth(c, helper);
+		return !unmeasured.empty();
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Actor, c->ass->Events, helper);
+	/// Measure up to count of the values at the end of unmeasured
+	void Measure(WidthHelper &helper, size_t count) {
+		for (; count && !unmeasured.empty(); --count) {
+			text_width = std::max(text_width, helper(unmeasured.back()));
+			unmeasured.pop_back();
+		}
 	}
 };
 
+struct GridColumnStyle final : GridColumnString {
+	GridColumnStyle() : GridColumnString(&AssDialogue::Style) { }
+	COLUMN_HEADER(_("Style"))
+	COLUMN_DESCRIPTION(_("Style"))
+};
+
+struct GridColumnEffect final : GridColumnString {
+	GridColumnEffect() : GridColumnString(&AssDialogue::Effect) { }
+	COLUMN_HEADER(_("Effect"))
+	COLUMN_DESCRIPTION(_("Effect"))
+};
+
+struct GridColumnActor final : GridColumnString {
+	GridColumnActor() : GridColumnString(&AssDialogue::Actor) { }
+	COLUMN_HEADER(_("Actor"))
+	COLUMN_DESCRIPTION(_("Actor"))
+};
+
 struct GridColumnMargin : GridColumn {
 	int index;
 	GridColumnMargin(int index) : index(index) { }
@@ -290,6 +330,29 @@ class GridColumnCPS final : public GridColumn {
 	const agi::OptionValue *cps_error = OPT_GET("Subtitle/Character Counter/CPS Error Threshold");
 	const agi::OptionValue *bg_color = OPT_GET("Colour/Subtitle Grid/CPS Error");
 
+	/// Character counts of line texts, keyed by the interned text so that
+	/// looking one up doesn't hash the text. The FlyweightString keeps the
+	/// text alive so that its address can't be reused for a different text.
+	mutable std::unordered_map<const std::string *, std::pair<FlyweightString, size_t>> counts;
+	/// Ignore mask the cached counts are for
+	mutable int counts_ignore = -1;
+
+	size_t CharacterCount(FlyweightString const& text, int ignore) const {
+		if (ignore != counts_ignore || counts.size() > max_cached_counts) {
+			counts.clear();
+			counts_ignore = ignore;
+		}
+
+		auto it = counts.find(&text.get());
+		if (it == counts.end())
+			it = counts.emplace(&text.get(), std::make_pair(text, agi::CharacterCount(text.get(), ignore))).first;
+		return it->second.second;
+	}
+
+	/// Cap on the number of cached counts, as edited lines leave behind the
+	/// counts for their old text
+	static const size_t max_cached_counts = 1 << 18;
+
 public:
 	COLUMN_HEADER(_("CPS"))
 	COLUMN_DESCRIPTION(_("Characters Per Second"))
@@ -313,7 +376,7 @@ public:
 		if (ignore_punctuation->GetBool())
 			ignore |= agi::IGNORE_PUNCTUATION;
 
-		return agi::CharacterCount(text, ignore) * 1000 / duration;
+		return CharacterCount(d->Text, ignore) * 1000 / duration;
 	}
 
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
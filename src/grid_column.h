@@ -15,6 +15,7 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include "flyweight_hash.h"
+#include "flyweight_string.h"
 
 #include <memory>
 #include <string>
@@ -33,7 +34,7 @@ class WidthHelper {
 	};
 	int age = 0;
 	wxDC *dc = nullptr;
-	std::unordered_map<boost::flyweight<std::string>, Entry> widths;
+	std::unordered_map<FlyweightString, Entry> widths;
 #ifdef _WIN32
 	wxString scratch;
 #endif
@@ -42,7 +43,7 @@ public:
 	void SetDC(wxDC *dc) { this->dc = dc; }
 	void Age();
 
-	int operator()(boost::flyweight<std::string> const& str);
+	int operator()(FlyweightString const& str);
 	int operator()(std::string const& str);
 	int operator()(wxString const& str);
 	int operator()(const char *str);
@@ -72,6 +73,11 @@ public:
 	bool Visible() const { return visible; }
 
 	virtual void UpdateWidth(const agi::Context *c, WidthHelper &helper);
+	/// Widen the column if needed to fit the given changed lines
+	virtual void UpdateWidth(const agi::Context *c, WidthHelper &helper, std::vector<const AssDialogue *> const&) { UpdateWidth(c, helper); }
+	/// Measure some of the values which UpdateWidth didn't have time for
+	/// @return Are there still values left to measure?
+	virtual bool RefineWidth(const agi::Context *, WidthHelper &) { return false; }
 	virtual void SetByFrame(bool /* by_frame */) { }
 	void SetVisible(bool new_value) { visible = new_value; }
 };
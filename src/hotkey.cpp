@@ -17,6 +17,7 @@
 #include "include/aegisub/hotkey.h"
 
 #include "libresrc/libresrc.h"
+#include "auto4_base.h"
 #include "command/command.h"
 #include "compat.h"
 #include "options.h"
@@ -256,6 +257,13 @@ bool check(std::string const& context, agi::Context *c, wxKeyEvent &evt) {
 		return true;
 	}
 	catch (cmd::CommandNotFound const& e) {
+		// Macros from autoload scripts aren't registered until the scripts
+		// have loaded, which may not have happened yet right after startup
+		if (config::global_scripts && config::global_scripts->IsLoading()) {
+			config::global_scripts->WaitForLoad();
+			return check(context, c, evt);
+		}
+
 		wxMessageBox(to_wx(e.GetMessage()), _("Invalid command name for hotkey"),
 			wxOK | wxICON_ERROR | wxCENTER | wxSTAY_ON_TOP);
 		return true;
@@ -36,6 +36,8 @@
 
 #include <libaegisub/exception.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -44,14 +46,122 @@
 namespace agi { class AudioProvider; }
 class wxWindow;
 
+/// @class PlaybackClock
+/// @brief Snapshot of an audio player's output, for working out which sample
+///        is being heard at a given time
+///
+/// Players report the position they've handed the audio output up to and
+/// how long it'll take for that to be heard, rather than a guess at what's
+/// being heard, so that the time at which something is heard can be found
+/// without asking the player again.
+struct PlaybackClock {
+	typedef std::chrono::steady_clock clock;
+
+	/// Sample after the last one which has been handed to the output
+	int64_t position = 0;
+	/// Time at which position was reported
+	clock::time_point host_time;
+	/// Time between the report and the sample at position being heard
+	std::chrono::microseconds latency{0};
+	/// Samples per second of the audio
+	int sample_rate = 0;
+
+	/// @brief Get the sample being heard at a time
+	///
+	/// This never goes past position, so playback which has stalled or hasn't
+	/// started yet doesn't look like it's still moving.
+	int64_t PositionAt(clock::time_point time) const;
+};
+
 class AudioPlayer {
+	/// Is a scrub in progress?
+	bool scrubbing = false;
+	/// Is the player doing the scrubbing itself, rather than it being done
+	/// with Play()?
+	bool native_scrub = false;
+
+	/// Latest clock reported by UpdateClock, written by the audio thread
+	/// without locking as a seqlock: the sequence number is odd while an
+	/// update is in progress
+	std::atomic<uint32_t> clock_seq{0};
+	std::atomic<int64_t> clock_position{0};
+	std::atomic<int64_t> clock_host_time{0};
+	std::atomic<int64_t> clock_latency{0};
+	/// Has the player ever called UpdateClock?
+	std::atomic<bool> clock_reported{false};
+
 protected:
 	agi::AudioProvider *provider;
 
+	/// Position most recently passed to SetScrubPosition, or -1 when not
+	/// scrubbing. Written by the GUI thread and read by the audio thread.
+	std::atomic<int64_t> scrub_target{-1};
+
+	/// Number of samples to play from each scrub position
+	int64_t scrub_length = 0;
+
+	/// Scrub playback state owned by the audio thread
+	struct ScrubReader {
+		/// Scrub target the reader last saw
+		int64_t target = -1;
+		/// Next sample to play
+		int64_t position = 0;
+		/// Sample to stop at until the target changes
+		int64_t end = 0;
+	};
+
+	/// @brief Fill a buffer with the next part of the scrub output
+	/// @param reader Audio thread's scrub state
+	/// @param buf    Buffer to fill
+	/// @param count  Number of samples to fill the buffer with
+	/// @param volume Volume to play at
+	///
+	/// Picks up any change to the scrub target, then plays from the target
+	/// for scrub_length samples followed by silence, so that the output
+	/// stream never has to stop while scrubbing. Only to be called from the
+	/// audio thread.
+	void FillScrubBuffer(ScrubReader &reader, void *buf, int64_t count, double volume);
+
+	/// @brief Start scrubbing with the player's own low-latency output
+	/// @return false if the player can't, in which case each scrub position
+	///         is played with Play()
+	///
+	/// Players which implement this should keep their stream open until
+	/// StopNativeScrub and fill it with FillScrubBuffer, preferably with a
+	/// much shorter buffer than they use for normal playback.
+	virtual bool StartNativeScrub() { return false; }
+	/// Stop scrubbing started by StartNativeScrub
+	virtual void StopNativeScrub() { }
+
+	/// @brief Report the output's progress for GetClock
+	/// @param position Sample after the last one handed to the output
+	/// @param latency  Time until the sample at position will be heard
+	///
+	/// Safe to call from realtime threads, as it never blocks. Players which
+	/// call this should do so when starting playback and whenever they hand
+	/// more audio to the output, and should generally implement
+	/// GetCurrentPosition in terms of GetClock.
+	void UpdateClock(int64_t position, std::chrono::microseconds latency);
+
 public:
 	AudioPlayer(agi::AudioProvider *provider) : provider(provider) { }
 	virtual ~AudioPlayer() = default;
 
+	/// @brief Start scrub playback
+	/// @param position Sample to play from
+	/// @param length   Number of samples to play from each position
+	///
+	/// Any other playback is stopped.
+	void StartScrub(int64_t position, int64_t length);
+	/// @brief Move scrub playback to a new position
+	///
+	/// This only updates the position which the audio thread reads from, so
+	/// it's cheap enough to call on every mouse move.
+	void SetScrubPosition(int64_t position);
+	/// Stop scrub playback
+	void StopScrub();
+	bool IsScrubbing() const { return scrubbing; }
+
 	virtual void Play(int64_t start,int64_t count)=0;	// Play sample range
 	virtual void Stop()=0;			// Stop playing
 	virtual bool IsPlaying()=0;
@@ -61,6 +171,13 @@ public:
 	virtual int64_t GetEndPosition()=0;
 	virtual int64_t GetCurrentPosition()=0;
 	virtual void SetEndPosition(int64_t pos)=0;
+
+	/// @brief Get the playback clock
+	///
+	/// For players which report their progress with UpdateClock this just
+	/// reads the last report, so it's cheap enough to call as often as
+	/// needed. For others it's made from GetCurrentPosition.
+	PlaybackClock GetClock();
 };
 
 struct AudioPlayerFactory {
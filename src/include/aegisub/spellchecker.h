@@ -20,9 +20,20 @@
 ///
 
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace agi { class SpellChecker; }
 
 struct SpellCheckerFactory {
 	static std::unique_ptr<agi::SpellChecker> GetSpellChecker();
+
+	/// Check a large batch of words at once
+	///
+	/// Words which haven't been checked before are split between threads,
+	/// each with its own spell checker, when there are enough of them to be
+	/// worth loading the dictionary again for.
+	/// @param words Distinct words to check
+	/// @return The misspelled words
+	static std::vector<std::string> GetMisspelledWords(std::vector<std::string> const& words);
 };
@@ -34,22 +34,115 @@
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
+class AssAttachment;
+class AssDialogue;
 class AssFile;
+struct FrameRect;
 struct VideoFrame;
 
+/// Rendered subtitles for a single time, which can be drawn onto any number
+/// of frames of the size they were rendered for
+struct SubtitleOverlay {
+	/// A single-color alpha mask to draw at a position in the frame
+	struct Image {
+		int x, y, w, h;
+		/// RGBA, with 0 alpha being opaque
+		uint32_t color;
+		/// w * h bytes of coverage
+		std::vector<unsigned char> mask;
+	};
+
+	int width = 0;
+	int height = 0;
+	std::vector<Image> images;
+	/// Was this rendered before the provider had all of its fonts? If so it
+	/// should be rendered again once NotifyWhenReady's callback is called.
+	bool provisional = false;
+	/// Fraction of the size which the images were rendered at before being
+	/// scaled up to it. Anything less than 1 is a lower quality preview.
+	double scale = 1.;
+
+	/// Draw the images onto the frame, which must be the size the overlay
+	/// was rendered for
+	void Blend(VideoFrame &dst) const;
+	/// Draw just the parts of the images inside an area of the frame
+	void Blend(VideoFrame &dst, FrameRect const& area) const;
+
+	/// @brief Find the area where this overlay differs from another of the
+	///        same size
+	/// @return The bounding box of the images which are only in one of them,
+	///         which is empty if they have the same images
+	FrameRect ChangedArea(SubtitleOverlay const& other) const;
+
+	/// Approximate memory used by the overlay in bytes
+	size_t GetSize() const;
+
+	/// Scale this up to a larger size with bilinear filtering, for drawing
+	/// subtitles rendered at a reduced size onto a full size frame
+	std::shared_ptr<SubtitleOverlay> Upscale(int width, int height) const;
+};
+
 class SubtitlesProvider {
 	std::vector<char> buffer;
+	/// Names and sizes of the fonts which were last passed to AddFont
+	std::string loaded_fonts;
 	virtual void LoadSubtitles(const char *data, size_t len)=0;
 
+protected:
+	/// Index in the last loaded script's events of each line of the file,
+	/// or -1 for lines which weren't loaded. Empty if the script was only
+	/// the lines visible at a single time.
+	std::vector<int> loaded_events;
+
+	/// Does the provider load font attachments itself with AddFont? If not,
+	/// they're written to the script's [Fonts] section.
+	virtual bool LoadsFonts() const { return false; }
+	/// @brief Load a font attachment
+	///
+	/// Only called when the attachments have changed since the last load,
+	/// so providers have to keep the fonts they're given.
+	virtual void AddFont(AssAttachment const&) { }
+
 public:
 	virtual ~SubtitlesProvider() = default;
 	void LoadSubtitles(AssFile *subs, int time = -1);
 	virtual void DrawSubtitles(VideoFrame &dst, double time)=0;
 	virtual void Reinitialize() { }
+
+	/// Block until the provider can render with all of its fonts, showing
+	/// progress if that takes a while
+	virtual void WaitUntilReady() { }
+	/// @brief Call a function once the provider can render with all of its fonts
+	///
+	/// The function may be called on any thread, including immediately on
+	/// this one if the provider is already ready.
+	virtual void NotifyWhenReady(std::function<void()> callback) { callback(); }
+
+	/// @brief Replace a single line of the loaded subtitles
+	/// @param row  Index of the line in the file's events
+	/// @param line New version of the line
+	/// @return Was the line replaced? If not, the whole file has to be
+	///         loaded again for the change to show up.
+	virtual bool UpdateLine(int row, AssDialogue const& line) { return false; }
+
+	/// @brief Render the subtitles at a time without drawing them onto a frame
+	/// @return The overlay, or nullptr if the provider can only draw directly
+	///         onto frames
+	virtual std::shared_ptr<const SubtitleOverlay> RenderOverlay(int width, int height, double time) { return nullptr; }
+
+	/// @brief Render the subtitles at several times
+	/// @return The overlay for each time, or nothing if the provider can only
+	///         draw directly onto frames
+	///
+	/// Providers which can render more than one time at once render them in
+	/// parallel; the rest just render each in turn.
+	virtual std::vector<std::shared_ptr<const SubtitleOverlay>> RenderOverlays(int width, int height, std::vector<double> const& times);
 };
 
 namespace agi { class BackgroundRunner; }
@@ -37,6 +37,7 @@
 #include <libaegisub/exception.h>
 #include <libaegisub/vfr.h>
 
+#include <memory>
 #include <string>
 
 struct VideoFrame;
@@ -48,12 +49,37 @@ public:
 	/// Override this method to actually get frames
 	virtual void GetFrame(int n, VideoFrame &frame)=0;
 
+	/// @brief Get a frame which may be shared with other users of the provider
+	///
+	/// The frame must not be modified. By default this decodes into a new
+	/// frame with GetFrame, but caching providers hand out the cached frame
+	/// rather than copying it.
+	virtual std::shared_ptr<const VideoFrame> GetSharedFrame(int n);
+
+	/// @brief Decode a frame which is likely to be requested soon
+	/// @return Was the frame decoded, rather than already being ready?
+	///
+	/// Only caching providers do anything with this.
+	virtual bool Prefetch(int n) { return false; }
+
+	/// Maximum number of frames which can usefully be prefetched at once, or
+	/// 0 if Prefetch does nothing
+	virtual int GetPrefetchLimit() const { return 0; }
+
 	/// Set the YCbCr matrix to the specified one
 	///
 	/// Providers are free to disregard this, and should if the requested
 	/// matrix makes no sense or the input isn't YCbCr.
 	virtual void SetColorSpace(std::string const& matrix)=0;
 
+	/// @brief Decode frames at a fraction of the video's size
+	/// @param scale Fraction of the full size, with 1 being full size
+	///
+	/// This is only a hint for when the video is being displayed zoomed
+	/// out, and providers which can't cheaply produce smaller frames should
+	/// ignore it. GetWidth() and GetHeight() still return the full size.
+	virtual void SetProxyScale(double scale) { }
+
 	// Override the following methods to get video information:
 	virtual int GetFrameCount() const=0;			///< Get total number of frames
 	virtual int GetWidth() const=0;					///< Returns the video width in pixels
@@ -0,0 +1,189 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file keyframe_detector.cpp
+/// @brief Detecting keyframes from the scene changes in a video
+/// @ingroup video_input
+
+#include "keyframe_detector.h"
+
+#include "compat.h"
+#include "filmstrip.h"
+#include "include/aegisub/video_provider.h"
+#include "utils.h"
+#include "video_frame.h"
+#include "video_provider_manager.h"
+
+#include <libaegisub/background_runner.h>
+#include <libaegisub/disk_cache.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/keyframe.h>
+#include <libaegisub/log.h>
+#include <libaegisub/parallel.h>
+#include <libaegisub/scene_change.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <wx/intl.h>
+
+namespace {
+/// Size of the luma thumbnails which frames are compared at
+const int thumb_width = 64;
+const int thumb_height = 36;
+const size_t thumb_size = thumb_width * thumb_height;
+
+/// Minimum score of a scene change
+const double threshold = 0.12;
+/// Minimum number of frames between scene changes
+const int min_interval = 10;
+
+/// Scale a frame down to a luma thumbnail of thumb_size bytes
+void MakeLumaThumbnail(VideoFrame const& frame, uint8_t *out) {
+	unsigned char rgb[thumb_size * 3];
+	if (frame.format == VideoFrameFormat::BGRA)
+		MakeThumbnail(frame, thumb_width, thumb_height, rgb);
+	else {
+		VideoFrame converted;
+		ConvertToBGRA(frame, converted);
+		MakeThumbnail(converted, thumb_width, thumb_height, rgb);
+	}
+
+	for (size_t i = 0; i < thumb_size; ++i)
+		out[i] = static_cast<uint8_t>((rgb[i * 3] * 77 + rgb[i * 3 + 1] * 150 + rgb[i * 3 + 2] * 29) >> 8);
+}
+
+/// Split a video into about count segments which can be scanned separately
+///
+/// Segments start on the video's own keyframes where it has any, so that
+/// seeking to the start of one doesn't have to decode the frames before it.
+std::vector<int> SegmentStarts(std::vector<int> const& keyframes, int frame_count, size_t count) {
+	const int target = std::max<int>(1, frame_count / count);
+	std::vector<int> starts{0};
+	if (keyframes.size() < 2) {
+		for (size_t i = 1; i < count; ++i) {
+			int start = static_cast<int>(i * static_cast<int64_t>(frame_count) / count);
+			if (start > starts.back())
+				starts.push_back(start);
+		}
+	}
+	else {
+		for (int frame : keyframes) {
+			if (frame < frame_count && frame - starts.back() >= target)
+				starts.push_back(frame);
+		}
+	}
+	return starts;
+}
+}
+
+agi::fs::path DetectKeyframes(agi::fs::path const& video, std::string const& colormatrix, agi::BackgroundRunner *br) {
+	// Dummy video has no file to scan or to key the cache on
+	if (!agi::fs::FileExists(video)) return agi::fs::path();
+
+	auto cache_file = GetSourceCacheFilename(video, ".keyframes");
+	if (agi::fs::FileExists(cache_file)) {
+		// update access time of the cache file so it won't get cleaned away
+		agi::fs::Touch(cache_file);
+		return cache_file;
+	}
+
+	// Each thread scanning the video needs a provider of its own
+	std::vector<std::unique_ptr<VideoProvider>> providers(agi::parallel_concurrency());
+	providers[0] = VideoProviderFactory::GetProvider(video, colormatrix, br);
+	const int frame_count = providers[0]->GetFrameCount();
+	const double scale = std::min(1.0, 2.0 * thumb_height / providers[0]->GetHeight());
+	providers[0]->SetProxyScale(scale);
+	auto starts = SegmentStarts(providers[0]->GetKeyFrames(), frame_count, providers.size() * 4);
+
+	// scores[i] is how different frame i is from frame i - 1
+	std::vector<double> scores(frame_count);
+	// First and last thumbnails of each segment, for scoring the first frame
+	// of each segment once the one before it has been scanned
+	std::vector<uint8_t> firsts(starts.size() * thumb_size);
+	std::vector<uint8_t> lasts(starts.size() * thumb_size);
+
+	bool finished = false;
+	br->Run([&](agi::ProgressSink *ps) {
+		ps->SetTitle(from_wx(_("Detecting keyframes")));
+		ps->SetMessage(from_wx(_("Looking for scene changes...")));
+
+		std::atomic<int> scanned{0};
+		std::atomic<bool> cancelled{false};
+		std::mutex open_mutex;
+
+		agi::parallel_for_slots(0, starts.size(), 1, [&](size_t slot, size_t begin, size_t end) {
+			auto& provider = providers[slot];
+			if (!provider) {
+				// The video has been indexed by now, so opening it again
+				// just loads the index, but that's still worth not doing
+				// several times at once
+				std::lock_guard<std::mutex> lock(open_mutex);
+				provider = VideoProviderFactory::GetProvider(video, colormatrix, nullptr);
+				provider->SetProxyScale(scale);
+			}
+
+			std::vector<uint8_t> prev(thumb_size), cur(thumb_size);
+			for (size_t segment = begin; segment < end; ++segment) {
+				const int first = starts[segment];
+				const int last = segment + 1 < starts.size() ? starts[segment + 1] : frame_count;
+				for (int frame = first; frame < last && !cancelled; ++frame) {
+					try {
+						MakeLumaThumbnail(*provider->GetSharedFrame(frame), cur.data());
+					}
+					catch (VideoProviderError const& err) {
+						// Treat frames which can't be decoded as repeats
+						LOG_D("video/keyframes") << "Failed to decode frame " << frame << ": " << err.GetMessage();
+						cur = prev;
+					}
+
+					if (frame == first)
+						std::copy(cur.begin(), cur.end(), &firsts[segment * thumb_size]);
+					else
+						scores[frame] = agi::scene_change::Score(prev.data(), cur.data(), thumb_size);
+					std::swap(prev, cur);
+
+					++scanned;
+					// The progress sink can only be used from this thread,
+					// which is the one running slot 0
+					if (slot == 0) {
+						ps->SetProgress(scanned, frame_count);
+						if (ps->IsCancelled())
+							cancelled = true;
+					}
+				}
+				std::copy(prev.begin(), prev.end(), &lasts[segment * thumb_size]);
+			}
+		});
+
+		if (cancelled) return;
+
+		for (size_t segment = 1; segment < starts.size(); ++segment) {
+			if (starts[segment] < frame_count)
+				scores[starts[segment]] = agi::scene_change::Score(
+					&lasts[(segment - 1) * thumb_size], &firsts[segment * thumb_size], thumb_size);
+		}
+
+		agi::keyframe::Save(cache_file, agi::scene_change::Choose(scores, min_interval, threshold));
+		finished = true;
+	});
+
+	if (!finished) return agi::fs::path();
+
+	GetMediaCache().Added(cache_file);
+	return cache_file;
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file keyframe_detector.h
+/// @see keyframe_detector.cpp
+/// @ingroup video_input
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+#include <string>
+
+namespace agi { class BackgroundRunner; }
+
+/// @brief Find the scene changes in a video to use as keyframes
+/// @param video       Video file to scan
+/// @param colormatrix YCbCr matrix to decode the video with
+/// @param br          Progress reporter for indexing and scanning the video
+/// @return Keyframe file holding the scene changes, or an empty path if
+///         scanning failed
+///
+/// For videos with no keyframes, or whose encoder didn't put them at scene
+/// changes, such as intra-only or fixed-GOP encodes. The keyframe file is
+/// kept next to the FFMS2 indexes, so scanning a video again just returns
+/// the file from the last time.
+///
+/// Throws the same errors as VideoProviderFactory::GetProvider if the video
+/// can't be opened, and agi::UserCancelException if scanning is cancelled.
+agi::fs::path DetectKeyframes(agi::fs::path const& video, std::string const& colormatrix, agi::BackgroundRunner *br);
@@ -0,0 +1,84 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file line_transform.h
+/// @brief Applying an edit to many lines at once in parallel
+/// @ingroup utility
+
+#pragma once
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "include/aegisub/context.h"
+#include "selection_controller.h"
+
+#include <libaegisub/make_unique.h>
+#include <libaegisub/parallel.h>
+
+#include <memory>
+#include <vector>
+
+/// Minimum number of lines to transform on each thread
+static const size_t min_parallel_transform = 64;
+
+/// @brief Apply an edit to copies of lines in parallel
+///
+/// f is called with a copy of each line and the line itself, and returns
+/// whether it changed the copy. It runs on several threads at once, so it
+/// may only modify the copy and must not touch anything which belongs to the
+/// UI. Once every line has been done the changed copies are written back to
+/// their lines on the calling thread.
+///
+/// @param lines Lines to edit
+/// @param f Called as f(AssDialogue &copy, const AssDialogue *line) -> bool
+/// @return The lines which were changed
+template<typename Func>
+std::vector<AssDialogue *> TransformLines(std::vector<AssDialogue *> const& lines, Func const& f) {
+	std::vector<std::unique_ptr<AssDialogueBase>> results(lines.size());
+	agi::parallel_for(0, lines.size(), min_parallel_transform, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			// Copying just the fields keeps the line's id and doesn't touch
+			// the list it's in
+			AssDialogue copy(static_cast<AssDialogueBase const&>(*lines[i]));
+			if (f(copy, static_cast<const AssDialogue *>(lines[i])))
+				results[i] = agi::make_unique<AssDialogueBase>(copy);
+		}
+	});
+
+	std::vector<AssDialogue *> changed;
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (!results[i]) continue;
+		static_cast<AssDialogueBase&>(*lines[i]) = *results[i];
+		changed.push_back(lines[i]);
+	}
+	return changed;
+}
+
+/// @brief Apply an edit to each of the selected lines in parallel and commit it
+/// @see TransformLines
+/// @param c Project context
+/// @param desc Undo description of the edit
+/// @param type AssFile::CommitType of the edit
+/// @param f Per-line edit
+/// @return Number of lines changed; nothing is committed if this is zero
+template<typename Func>
+size_t TransformSelection(const agi::Context *c, wxString const& desc, int type, Func const& f) {
+	auto const& sel = c->selectionController->GetSelectedSet();
+	auto changed = TransformLines(std::vector<AssDialogue *>(sel.begin(), sel.end()), f);
+	if (!changed.empty())
+		c->ass->Commit(desc, type, -1, changed);
+	return changed.size();
+}
@@ -56,6 +56,7 @@
 #include "value_event.h"
 #include "version.h"
 
+#include <libaegisub/cache_budget.h>
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
@@ -63,10 +64,11 @@
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
+#include <libaegisub/trace.h>
 #include <libaegisub/util.h>
 
-#include <boost/interprocess/streams/bufferstream.hpp>
 #include <boost/locale.hpp>
+#include <chrono>
 #include <locale>
 #include <wx/clipbrd.h>
 #include <wx/msgdlg.h>
@@ -83,11 +85,25 @@ namespace config {
 wxIMPLEMENT_APP(AegisubApp);
 
 static const char *LastStartupState = nullptr;
+static std::chrono::steady_clock::time_point StartupBegin, LastStartupTime;
+
+/// Log how long the previous startup step took and start timing the next one
+static void StartupStep(const char *state) {
+	auto now = std::chrono::steady_clock::now();
+	if (LastStartupState && agi::log::log) {
+		LOG_I("main/startup") << LastStartupState << ": "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(now - LastStartupTime).count() << " ms";
+	}
+	else if (!LastStartupState)
+		StartupBegin = now;
+	LastStartupState = state;
+	LastStartupTime = now;
+}
 
 #ifdef WITH_STARTUPLOG
-#define StartupLog(a) MessageBox(0, L ## a, L"Aegisub startup log", 0)
+#define StartupLog(a) (StartupStep(a), MessageBox(0, L ## a, L"Aegisub startup log", 0))
 #else
-#define StartupLog(a) LastStartupState = a
+#define StartupLog(a) StartupStep(a)
 #endif
 
 void AegisubApp::OnAssertFailure(const wxChar *file, int line, const wxChar *func, const wxChar *cond, const wxChar *msg) {
@@ -199,8 +215,7 @@ bool AegisubApp::OnInit() {
 	try {
 		if (!config::opt)
 			config::opt = new agi::Options(config::path->Decode("?user/config.json"), GET_DEFAULT_CONFIG(default_config));
-		boost::interprocess::ibufferstream stream((const char *)default_config_platform, sizeof(default_config_platform));
-		config::opt->ConfigNext(stream);
+		config::opt->ConfigNext(GET_DEFAULT_CONFIG(default_config_platform));
 	} catch (agi::Exception& e) {
 		LOG_E("config/init") << "Caught exception: " << e.GetMessage();
 	}
@@ -224,6 +239,18 @@ bool AegisubApp::OnInit() {
 	}
 #endif
 
+	StartupLog("Set cache memory limit");
+	auto set_cache_limit = [](agi::OptionValue const& opt) {
+		const int64_t max_mb = opt.GetInt();
+		agi::CacheBudget::Global().SetLimit(max_mb > 0 ? static_cast<size_t>(max_mb) * 1024 * 1024 : std::numeric_limits<size_t>::max());
+	};
+	set_cache_limit(*OPT_GET("Audio/Cache/Memory Max"));
+	OPT_SUB("Audio/Cache/Memory Max", set_cache_limit);
+
+	// The performance overlay shows what the trace probes record
+	if (OPT_GET("App/Performance HUD")->GetBool())
+		agi::trace::Enable(true);
+
 	// Init commands.
 	cmd::init_builtin_commands();
 
@@ -280,7 +307,7 @@ bool AegisubApp::OnInit() {
 		libass::CacheFonts();
 
 		// Load Automation scripts
-		StartupLog("Load global Automation scripts");
+		StartupLog("Start loading global Automation scripts");
 		config::global_scripts = new Automation4::AutoloadScriptManager(OPT_GET("Path/Automation/Autoload")->GetString());
 
 		// Load export filters
@@ -288,8 +315,11 @@ bool AegisubApp::OnInit() {
 		AssExportFilterChain::Register(agi::make_unique<AssFixStylesFilter>());
 		AssExportFilterChain::Register(agi::make_unique<AssTransformFramerateFilter>());
 
-		StartupLog("Install PNG handler");
+		StartupLog("Install image handlers");
 		wxImage::AddHandler(new wxPNGHandler);
+#if wxUSE_LIBJPEG
+		wxImage::AddHandler(new wxJPEGHandler);
+#endif
 
 		// Open main frame
 		StartupLog("Create main window");
@@ -340,6 +370,8 @@ bool AegisubApp::OnInit() {
 	CleanCache(config::path->Decode(OPT_GET("Path/Auto/Save")->GetString()), "*.AUTOSAVE.ass", 100, 1000);
 
 	StartupLog("Initialization complete");
+	LOG_I("main/startup") << "Total: "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - StartupBegin).count() << " ms";
 	return true;
 }
 
@@ -0,0 +1,206 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "media_staging.h"
+
+#include "options.h"
+
+#include <libaegisub/disk_cache.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+#include <libaegisub/path.h>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace {
+struct {
+	std::mutex mutex;
+	/// The original file of each local copy which has been opened
+	std::map<agi::fs::path, agi::fs::path> sources;
+	/// Files which are currently being copied
+	std::set<agi::fs::path> copying;
+} staging;
+
+agi::signal::Signal<agi::fs::path const&> MediaStaged;
+
+uint64_t StagingQuota() {
+	return static_cast<uint64_t>(OPT_GET("Provider/Staging/Size")->GetInt()) << 20;
+}
+
+bool ShouldStage(agi::fs::path const& path) {
+	return OPT_GET("Provider/Staging/Enabled")->GetBool() && agi::fs::IsRemote(path);
+}
+
+/// The key changes whenever the file is replaced or modified, so a stale
+/// copy is never used
+std::string StagingKey(agi::fs::path const& path) {
+	return path.string() + "|" + std::to_string(agi::fs::Size(path)) + "|" + std::to_string(agi::fs::ModifiedTime(path));
+}
+
+/// Copy a file, returning the checksum of what was read
+uint32_t CopyWithChecksum(agi::fs::path const& from, agi::fs::path const& to) {
+	auto in = agi::io::Open(from, true);
+	boost::filesystem::ofstream out(to, std::ios::binary);
+	if (!out.good())
+		throw agi::fs::WriteDenied(to);
+
+	boost::crc_32_type crc;
+	std::vector<char> buffer(4 << 20);
+	while (in->read(buffer.data(), buffer.size()), in->gcount() > 0) {
+		crc.process_bytes(buffer.data(), in->gcount());
+		out.write(buffer.data(), in->gcount());
+	}
+	if (in->bad() || !out.flush())
+		throw agi::fs::FileSystemError("Failed to copy " + from.string());
+	return crc.checksum();
+}
+
+uint32_t Checksum(agi::fs::path const& path) {
+	auto in = agi::io::Open(path, true);
+	boost::crc_32_type crc;
+	std::vector<char> buffer(4 << 20);
+	while (in->read(buffer.data(), buffer.size()), in->gcount() > 0)
+		crc.process_bytes(buffer.data(), in->gcount());
+	return crc.checksum();
+}
+}
+
+agi::DiskCache& GetStagingCache() {
+	auto path = OPT_GET("Provider/Staging/Location")->GetString();
+	if (path == "default")
+		path = "?local/staging";
+	auto dir = config::path->MakeAbsolute(config::path->Decode(path), "?local");
+
+	// Never destroyed for the same reason as the media cache
+	static agi::DiskCache *cache = new agi::DiskCache(dir, StagingQuota());
+	cache->SetRoot(dir);
+	cache->SetQuota(StagingQuota());
+	return *cache;
+}
+
+agi::fs::path StagedMediaPath(agi::fs::path const& path) {
+	if (!ShouldStage(path)) return path;
+
+	try {
+		auto local = GetStagingCache().Path(StagingKey(path), path.extension().string());
+		// Copies are only given their final name once they've been verified,
+		// so this just guards against it having been truncated since
+		if (!agi::fs::FileExists(local) || agi::fs::Size(local) != agi::fs::Size(path))
+			return path;
+
+		LOG_D("media_staging") << "opening " << local << " in place of " << path;
+		std::lock_guard<std::mutex> lock(staging.mutex);
+		staging.sources[local] = path;
+		return local;
+	}
+	catch (agi::fs::FileSystemError const&) {
+		return path;
+	}
+}
+
+agi::fs::path StagedMediaSource(agi::fs::path const& path) {
+	std::lock_guard<std::mutex> lock(staging.mutex);
+	auto it = staging.sources.find(path);
+	return it == staging.sources.end() ? path : it->second;
+}
+
+bool StageMedia(agi::fs::path const& path) {
+	if (!ShouldStage(path)) return false;
+
+	std::string key;
+	uintmax_t size;
+	try {
+		key = StagingKey(path);
+		size = agi::fs::Size(path);
+	}
+	catch (agi::fs::FileSystemError const&) {
+		return false;
+	}
+
+	// It'd just evict everything else and then be evicted itself
+	if (size > StagingQuota()) {
+		LOG_D("media_staging") << path << " is too big to stage";
+		return false;
+	}
+
+	auto& cache = GetStagingCache();
+	auto local = cache.Path(key, path.extension().string());
+	if (agi::fs::FileExists(local)) return false;
+
+	{
+		std::lock_guard<std::mutex> lock(staging.mutex);
+		if (!staging.copying.insert(path).second) return false;
+	}
+
+	// Copies are done one at a time on their own queue, as they can take
+	// minutes and would otherwise tie up the thread pool and the network
+	static std::unique_ptr<agi::dispatch::Queue> queue;
+	if (!queue)
+		queue = agi::dispatch::Create();
+
+	LOG_I("media_staging") << "copying " << path << " to " << local;
+	queue->Async([=, &cache] {
+		auto partial = local;
+		partial += ".part";
+
+		bool verified = false;
+		try {
+			auto checksum = CopyWithChecksum(path, partial);
+			// The original may have been modified while it was being copied,
+			// and the copy may not have been written correctly
+			verified = StagingKey(path) == key
+				&& agi::fs::Size(partial) == size
+				&& Checksum(partial) == checksum;
+			if (verified)
+				agi::fs::Rename(partial, local);
+			else
+				LOG_E("media_staging") << "copy of " << path << " did not match the original";
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("media_staging") << "failed to copy " << path << ": " << e.GetMessage();
+			verified = false;
+		}
+
+		if (!verified) {
+			try {
+				agi::fs::Remove(partial);
+			}
+			catch (agi::Exception const&) { }
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(staging.mutex);
+			staging.copying.erase(path);
+		}
+
+		if (!verified) return;
+		cache.Added(local);
+		LOG_I("media_staging") << "finished copying " << path;
+		agi::dispatch::Main().Async([=] { MediaStaged(path); });
+	});
+	return true;
+}
+
+agi::signal::Connection AddMediaStagedListener(std::function<void (agi::fs::path const&)> const& listener) {
+	return MediaStaged.Connect(listener);
+}
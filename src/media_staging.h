@@ -0,0 +1,58 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file media_staging.h
+/// @brief Local copies of media files which are on network shares
+/// @ingroup utility
+///
+/// Seeking in a file over SMB or NFS is slow enough to make video scrubbing
+/// painful, so when enabled, files opened from a network share are copied to
+/// a local staging directory in the background. The providers keep reading
+/// the original until the copy is complete and has been verified, and from
+/// then on (including in later sessions) open the local copy instead.
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+#include <libaegisub/signal.h>
+
+#include <boost/filesystem/path.hpp>
+#include <functional>
+
+namespace agi { class DiskCache; }
+
+/// Get the file which should be opened to read a media file: a verified local
+/// copy of it if there is one, or the file itself if not
+agi::fs::path StagedMediaPath(agi::fs::path const& path);
+
+/// Get the file which a path returned by StagedMediaPath is a copy of, so that
+/// anything cached for the original is also used for the copy
+agi::fs::path StagedMediaSource(agi::fs::path const& path);
+
+/// @brief Start copying a media file to the staging directory in the background
+///
+/// Does nothing if staging is disabled, the file is on a local disk or is too
+/// big for the staging directory, or a copy of it already exists or is
+/// already being made.
+/// @return Was a copy started?
+bool StageMedia(agi::fs::path const& path);
+
+/// Listen for copies of files being completed. The listener is called on the
+/// main thread with the path of the original file.
+agi::signal::Connection AddMediaStagedListener(std::function<void (agi::fs::path const&)> const& listener);
+
+/// Get the cache which the staged copies are kept in
+agi::DiskCache& GetStagingCache();
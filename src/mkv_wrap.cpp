@@ -34,6 +34,7 @@
 
 #include "mkv_wrap.h"
 
+#include "ass_dialogue.h"
 #include "ass_file.h"
 #include "ass_parser.h"
 #include "compat.h"
@@ -44,6 +45,7 @@
 #include <libaegisub/ass/time.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/format.h>
+#include <libaegisub/make_unique.h>
 #include <libaegisub/scoped_ptr.h>
 
 #include <algorithm>
@@ -82,12 +84,18 @@ struct MkvStdIO final : InputStream {
 	static int64_t Scan(InputStream *st, uint64_t start, unsigned signature) {
 		auto *self = static_cast<MkvStdIO*>(st);
 		try {
+			// Map a chunk at a time rather than a byte at a time, as each
+			// read has to lock the mapping
+			const uint64_t chunk_size = 1 << 16;
 			unsigned cmp = 0;
-			for (auto i : boost::irange(start, self->file.size())) {
-				int c = *self->file.read(i, 1);
-				cmp = ((cmp << 8) | c) & 0xffffffff;
-				if (cmp == signature)
-					return i - 4;
+			for (uint64_t pos = start; pos < self->file.size(); pos += chunk_size) {
+				auto len = std::min(chunk_size, self->file.size() - pos);
+				auto data = reinterpret_cast<const unsigned char *>(self->file.read(pos, len));
+				for (uint64_t i = 0; i < len; ++i) {
+					cmp = ((cmp << 8) | data[i]) & 0xffffffff;
+					if (cmp == signature)
+						return pos + i - 4;
+				}
 			}
 		}
 		catch (agi::Exception const& e) {
@@ -114,62 +122,123 @@ struct MkvStdIO final : InputStream {
 	}
 };
 
-static void read_subtitles(agi::ProgressSink *ps, MatroskaFile *file, MkvStdIO *input, bool srt, double totalTime, AssParser *parser) {
-	std::vector<std::pair<int, std::string>> subList;
-
-	// Load blocks
-	uint64_t startTime, endTime, filePos;
-	unsigned int rt, frameSize, frameFlags;
-
-	while (mkv_ReadFrame(file, 0, &rt, &startTime, &endTime, &filePos, &frameSize, &frameFlags) == 0) {
-		if (ps->IsCancelled()) return;
-		if (frameSize == 0) continue;
-
-		const auto readBuf = input->file.read(filePos, frameSize);
-		const auto readBufEnd = readBuf + frameSize;
+namespace {
+/// Read the frames queued by the parser, either for the whole file or for a
+/// single cluster, into lines
+class SubtitleReader {
+	MatroskaFile *file;
+	MkvStdIO *input;
+	bool srt;
+	/// ReadOrder of each line for ASS, and the order they were read in for SRT
+	std::vector<std::pair<int, std::unique_ptr<AssDialogue>>> lines;
+	std::string buffer;
+
+	void AddFrame(uint64_t startTime, uint64_t endTime, const char *data, size_t size) {
+		const char *end = data + size;
+		using str_range = boost::iterator_range<const char *>;
 
 		// Get start and end times
 		int64_t timecodeScaleLow = 1000000;
 		agi::Time subStart = startTime / timecodeScaleLow;
 		agi::Time subEnd = endTime / timecodeScaleLow;
 
-		using str_range = boost::iterator_range<const char *>;
+		buffer = "Dialogue: ";
+		int order;
 
 		// Process SSA/ASS
 		if (!srt) {
-			auto first = std::find(readBuf, readBufEnd, ',');
-			if (first == readBufEnd) continue;
-			auto second = std::find(first + 1, readBufEnd, ',');
-			if (second == readBufEnd) continue;
-
-			subList.emplace_back(
-				boost::lexical_cast<int>(str_range(readBuf, first)),
-				agi::format("Dialogue: %d,%s,%s,%s"
-					, boost::lexical_cast<int>(str_range(first + 1, second))
-					, subStart.GetAssFormatted()
-					, subEnd.GetAssFormatted()
-					, str_range(second + 1, readBufEnd)));
+			auto first = std::find(data, end, ',');
+			if (first == end) return;
+			auto second = std::find(first + 1, end, ',');
+			if (second == end) return;
+
+			order = boost::lexical_cast<int>(str_range(data, first));
+			buffer += std::to_string(boost::lexical_cast<int>(str_range(first + 1, second)));
+			buffer += ',';
+			buffer += subStart.GetAssFormatted();
+			buffer += ',';
+			buffer += subEnd.GetAssFormatted();
+			buffer += ',';
+			buffer.append(second + 1, end);
 		}
 		// Process SRT
 		else {
-			auto line = agi::format("Dialogue: 0,%s,%s,Default,,0,0,0,,%s"
-				, subStart.GetAssFormatted()
-				, subEnd.GetAssFormatted()
-				, str_range(readBuf, readBufEnd));
-			boost::replace_all(line, "\r\n", "\\N");
-			boost::replace_all(line, "\r", "\\N");
-			boost::replace_all(line, "\n", "\\N");
-
-			subList.emplace_back(subList.size(), std::move(line));
+			order = static_cast<int>(lines.size());
+			buffer += "0,";
+			buffer += subStart.GetAssFormatted();
+			buffer += ',';
+			buffer += subEnd.GetAssFormatted();
+			buffer += ",Default,,0,0,0,,";
+			buffer.append(data, end);
+			boost::replace_all(buffer, "\r\n", "\\N");
+			boost::replace_all(buffer, "\r", "\\N");
+			boost::replace_all(buffer, "\n", "\\N");
 		}
 
-		ps->SetProgress(startTime / timecodeScaleLow, totalTime);
+		lines.emplace_back(order, agi::make_unique<AssDialogue>(buffer));
 	}
 
-	// Insert into file
-	sort(begin(subList), end(subList));
-	for (auto order_value_pair : subList)
-		parser->AddLine(order_value_pair.second);
+public:
+	SubtitleReader(MatroskaFile *file, MkvStdIO *input, bool srt)
+	: file(file), input(input), srt(srt) { }
+
+	/// Read all of the queued frames
+	/// @return false if cancelled
+	bool ReadFrames(agi::ProgressSink *ps, double totalTime) {
+		uint64_t startTime, endTime, filePos;
+		unsigned int rt, frameSize, frameFlags;
+
+		while (mkv_ReadFrame(file, 0, &rt, &startTime, &endTime, &filePos, &frameSize, &frameFlags) == 0) {
+			if (ps->IsCancelled()) return false;
+			if (frameSize == 0) continue;
+
+			AddFrame(startTime, endTime, input->file.read(filePos, frameSize), frameSize);
+			if (totalTime > 0)
+				ps->SetProgress(startTime / 1000000, totalTime);
+		}
+		return true;
+	}
+
+	/// Add the lines to the file in their original order
+	void Finish(AssFile *target) {
+		std::stable_sort(begin(lines), end(lines), [](decltype(lines)::value_type const& a, decltype(lines)::value_type const& b) {
+			return a.first < b.first;
+		});
+		for (auto& line : lines)
+			target->Events.push_back(*line.second.release());
+	}
+};
+}
+
+static void read_subtitles(agi::ProgressSink *ps, MatroskaFile *file, MkvStdIO *input, unsigned track, bool srt, double totalTime, AssFile *target) {
+	SubtitleReader reader(file, input, srt);
+
+	// Muxers which index subtitle tracks (such as mkvmerge) add a cue for
+	// every subtitle block, so only the clusters which the cues point to need
+	// to be read rather than the entire file, which for a large video on a
+	// network drive is a very big difference
+	std::vector<uint64_t> clusters(mkv_GetTrackCuePositions(file, track, nullptr, 0));
+	mkv_GetTrackCuePositions(file, track, clusters.data(), clusters.size());
+	sort(begin(clusters), end(clusters));
+	clusters.erase(unique(begin(clusters), end(clusters)), end(clusters));
+
+	bool read_clusters = !clusters.empty();
+	for (size_t i = 0; i < clusters.size(); ++i) {
+		if (mkv_ReadCluster(file, clusters[i]) != 0) {
+			// The cues are wrong, so fall back to reading everything
+			reader = SubtitleReader(file, input, srt);
+			mkv_Seek(file, 0, 0);
+			read_clusters = false;
+			break;
+		}
+		if (!reader.ReadFrames(ps, 0)) return;
+		ps->SetProgress(i + 1, clusters.size());
+	}
+
+	if (!read_clusters && !reader.ReadFrames(ps, totalTime))
+		return;
+
+	reader.Finish(target);
 }
 
 void MatroskaWrapper::GetSubtitles(agi::fs::path const& filename, AssFile *target) {
@@ -249,7 +318,7 @@ void MatroskaWrapper::GetSubtitles(agi::fs::path const& filename, AssFile *targe
 	// Progress bar
 	auto totalTime = double(segInfo->Duration) / timecodeScale;
 	DialogProgress progress(nullptr, _("Parsing Matroska"), _("Reading subtitles from Matroska file."));
-	progress.Run([&](agi::ProgressSink *ps) { read_subtitles(ps, file, &input, srt, totalTime, &parser); });
+	progress.Run([&](agi::ProgressSink *ps) { read_subtitles(ps, file, &input, trackToRead, srt, totalTime, target); });
 }
 
 bool MatroskaWrapper::HasSubtitles(agi::fs::path const& filename) {
@@ -31,11 +31,29 @@ namespace config {
 	extern Automation4::AutoloadScriptManager *global_scripts;
 }
 
+namespace config {
+	/// Look up an option by a string literal, only searching for it the
+	/// first time each call site runs. Option values live as long as
+	/// config::opt once the configs have been loaded, so the pointer can be
+	/// kept. Site is a distinct lambda type for each use of the OPT_ macros.
+	template<typename Site, size_t N>
+	agi::OptionValue *get(Site, const char (&name)[N]) {
+		static agi::OptionValue *const value = opt->Get(name);
+		return value;
+	}
+
+	/// Look up an option by a name built at runtime
+	template<typename Site, typename String>
+	agi::OptionValue *get(Site, String const& name) {
+		return opt->Get(name);
+	}
+}
+
 /// Macro to get OptionValue object
-#define OPT_GET(x) const_cast<const agi::OptionValue*>(config::opt->Get(x))
+#define OPT_GET(x) const_cast<const agi::OptionValue*>(config::get([]{}, x))
 
 /// Macro to set OptionValue object
-#define OPT_SET(x) config::opt->Get(x)
+#define OPT_SET(x) config::get([]{}, x)
 
 /// Macro to subscribe to OptionValue changes
-#define OPT_SUB(x, ...) config::opt->Get(x)->Subscribe(__VA_ARGS__)
+#define OPT_SUB(x, ...) config::get([]{}, x)->Subscribe(__VA_ARGS__)
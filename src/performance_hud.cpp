@@ -0,0 +1,83 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "performance_hud.h"
+
+#include "options.h"
+
+#include <libaegisub/audio/provider.h>
+#include <libaegisub/format.h>
+#include <libaegisub/trace.h>
+
+namespace {
+std::string timing(const char *label, const char *name) {
+	auto metric = agi::trace::Get(name);
+	if (!metric.count)
+		return agi::format("%s: -", label);
+	return agi::format("%s: %.2f ms avg, %.2f ms 95%%, %.2f ms max (%d)", label,
+		metric.total / 1e6 / metric.count, metric.Percentile(.95) / 1e6,
+		metric.max / 1e6, metric.count);
+}
+
+std::string hit_rate(const char *label, const char *hit, const char *miss) {
+	const int64_t hits = agi::trace::Get(hit).count;
+	const int64_t misses = agi::trace::Get(miss).count;
+	if (hits + misses == 0)
+		return agi::format("%s: -", label);
+	return agi::format("%s: %.1f%% hits (%d of %d)", label, 100. * hits / (hits + misses), hits, hits + misses);
+}
+
+std::vector<std::string> lines(std::vector<std::string> ret) {
+	if (!agi::trace::Enabled())
+		ret.insert(ret.begin(), "Recording paused");
+	return ret;
+}
+}
+
+namespace performance_hud {
+bool Visible() {
+	return OPT_GET("App/Performance HUD")->GetBool();
+}
+
+std::vector<std::string> VideoLines() {
+	const int64_t dropped = agi::trace::Get("video/dropped").count;
+
+	return lines({
+		timing("Decode", "video/decode"),
+		timing("Subtitles", "video/subtitles"),
+		timing("Blend", "video/blend"),
+		timing("Upload", "video/upload"),
+		hit_rate("Frame cache", "video/cache/hit", "video/cache/miss"),
+		hit_rate("Overlay cache", "video/overlay/hit", "video/overlay/miss"),
+		agi::format("Dropped frames: %d", dropped)
+	});
+}
+
+std::vector<std::string> AudioLines(agi::AudioProvider *provider) {
+	std::string progress = "Decoded: -";
+	if (provider && provider->GetNumSamples() > 0) {
+		const int64_t decoded = provider->GetDecodedSamples();
+		const int64_t total = provider->GetNumSamples();
+		progress = agi::format("Decoded: %.1f%% (%d of %d samples)", 100. * decoded / total, decoded, total);
+	}
+
+	return lines({
+		progress,
+		timing("Decode block", "audio/decode"),
+		timing("Render", "audio/render")
+	});
+}
+}
@@ -0,0 +1,37 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file performance_hud.h
+/// @brief Text of the performance overlays on the video and audio displays
+/// @ingroup utility
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace agi { class AudioProvider; }
+
+namespace performance_hud {
+/// Is the overlay turned on?
+bool Visible();
+
+/// Describe the time taken by each stage of getting a video frame on screen
+std::vector<std::string> VideoLines();
+
+/// Describe how far decoding the audio has got and how long rendering takes
+std::vector<std::string> AudioLines(agi::AudioProvider *provider);
+}
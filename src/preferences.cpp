@@ -72,6 +72,7 @@ void General(wxTreebook *book, Preferences *parent) {
 	wxArrayString autoload_modes_arr(3, autoload_modes);
 	p->OptionChoice(general, _("Automatically load linked files"), autoload_modes_arr, "App/Auto/Load Linked Files");
 	p->OptionAdd(general, _("Undo Levels"), "Limits/Undo Levels", 2, 10000);
+	p->OptionAdd(general, _("Undo Memory Limit (MB, 0 for none)"), "Limits/Undo Memory", 0, 100000);
 
 	auto recent = p->PageSizer(_("Recently Used Lists"));
 	p->OptionAdd(recent, _("Files"), "Limits/MRU", 0, 16);
@@ -129,9 +130,11 @@ void Audio(wxTreebook *book, Preferences *parent) {
 	p->OptionAdd(general, _("Default mouse wheel to zoom"), "Audio/Wheel Default to Zoom");
 	p->OptionAdd(general, _("Lock scroll on cursor"), "Audio/Lock Scroll on Cursor");
 	p->OptionAdd(general, _("Snap markers by default"), "Audio/Snap/Enable");
+	p->OptionAdd(general, _("Snap to the edges of speech"), "Audio/Snap/Speech Boundaries");
 	p->OptionAdd(general, _("Auto-focus on mouse over"), "Audio/Auto/Focus");
 	p->OptionAdd(general, _("Play audio when stepping in video"), "Audio/Plays When Stepping Video");
 	p->OptionAdd(general, _("Left-click-drag moves end marker"), "Audio/Drag Timing");
+	p->OptionAdd(general, _("Play audio while dragging markers"), "Audio/Scrub/Enable");
 	p->OptionAdd(general, _("Default timing length (ms)"), "Timing/Default Duration", 0, 36000);
 	p->OptionAdd(general, _("Default lead-in length (ms)"), "Audio/Lead/IN", 0, 36000);
 	p->OptionAdd(general, _("Default lead-out length (ms)"), "Audio/Lead/OUT", 0, 36000);
@@ -139,6 +142,7 @@ void Audio(wxTreebook *book, Preferences *parent) {
 	p->OptionAdd(general, _("Marker drag-start sensitivity (px)"), "Audio/Start Drag Sensitivity", 1, 15);
 	p->OptionAdd(general, _("Line boundary thickness (px)"), "Audio/Line Boundaries Thickness", 1, 5);
 	p->OptionAdd(general, _("Maximum snap distance (px)"), "Audio/Snap/Distance", 0, 25);
+	p->OptionAdd(general, _("Marker drag playback length (ms)"), "Audio/Scrub/Length", 10, 1000);
 
 	const wxString dtl_arr[] = { _("Don't show"), _("Show previous"), _("Show previous and next"), _("Show all") };
 	wxArrayString choice_dtl(4, dtl_arr);
@@ -168,12 +172,18 @@ void Video(wxTreebook *book, Preferences *parent) {
 	auto general = p->PageSizer(_("Options"));
 	p->OptionAdd(general, _("Show keyframes in slider"), "Video/Slider/Show Keyframes");
 	p->CellSkip(general);
+	p->OptionAdd(general, _("Show keyframe thumbnails above slider"), "Video/Slider/Show Filmstrip");
+	p->CellSkip(general);
 	p->OptionAdd(general, _("Only show visual tools when mouse is over video"), "Tool/Visual/Autohide");
 	p->CellSkip(general);
 	p->OptionAdd(general, _("Seek video to line start on selection change"), "Video/Subtitle Sync");
 	p->CellSkip(general);
 	p->OptionAdd(general, _("Automatically open audio when opening video"), "Video/Open Audio");
 	p->CellSkip(general);
+	p->OptionAdd(general, _("Decode video at a lower resolution when zoomed out"), "Video/Proxy Decoding");
+	p->CellSkip(general);
+	p->OptionAdd(general, _("Render subtitles at a lower resolution when playback can't keep up"), "Video/Adaptive Subtitle Quality");
+	p->CellSkip(general);
 
 	const wxString czoom_arr[24] = { "12.5%", "25%", "37.5%", "50%", "62.5%", "75%", "87.5%", "100%", "112.5%", "125%", "137.5%", "150%", "162.5%", "175%", "187.5%", "200%", "212.5%", "225%", "237.5%", "250%", "262.5%", "275%", "287.5%", "300%" };
 	wxArrayString choice_zoom(24, czoom_arr);
@@ -314,6 +324,7 @@ void Backup(wxTreebook *book, Preferences *parent) {
 		p->OptionAdd(save, _("Interval in seconds"), "App/Auto/Save Every Seconds", 1));
 	p->OptionBrowse(save, _("Path"), "Path/Auto/Save", cb, true);
 	p->OptionAdd(save, _("Autosave after every change"), "App/Auto/Save on Every Change");
+	p->OptionAdd(save, _("Keep a crash recovery journal of every change"), "App/Auto/Journal");
 
 	auto backup = p->PageSizer(_("Automatic Backup"));
 	cb = p->OptionAdd(backup, _("Enable"), "App/Auto/Backup");
@@ -341,6 +352,9 @@ void Automation(wxTreebook *book, Preferences *parent) {
 	wxArrayString ar_choice(4, ar_arr);
 	p->OptionChoice(general, _("Autoreload on Export"), ar_choice, "Automation/Autoreload Mode");
 
+	p->OptionAdd(general, _("Full collection after macros using (MB, 0 for always)"), "Automation/Collection Threshold", 0, 4096);
+	p->OptionAdd(general, _("Profile macros"), "Automation/Profile Macros");
+
 	p->SetSizerAndFit(p->sizer);
 }
 
@@ -372,10 +386,19 @@ void Advanced_Audio(wxTreebook *book, Preferences *parent) {
 	p->OptionChoice(expert, _("Audio player"), apl_choice, "Audio/Player");
 
 	auto cache = p->PageSizer(_("Cache"));
-	const wxString ct_arr[3] = { _("None (NOT RECOMMENDED)"), _("RAM"), _("Hard Disk") };
-	wxArrayString ct_choice(3, ct_arr);
+	const wxString ct_arr[4] = { _("None (NOT RECOMMENDED)"), _("RAM"), _("Hard Disk"), _("RAM (compressed)") };
+	wxArrayString ct_choice(4, ct_arr);
 	p->OptionChoice(cache, _("Cache type"), ct_choice, "Audio/Cache/Type");
 	p->OptionBrowse(cache, _("Path"), "Audio/Cache/HD/Location");
+	p->OptionAdd(cache, _("Max HD cache size (MB)"), "Audio/Cache/HD/Size", 0, 1000000);
+	p->OptionAdd(cache, _("Decoder threads"), "Audio/Cache/Decoder Threads", 1, 64);
+	p->OptionAdd(cache, _("Cache original format"), "Audio/Cache/Native Format");
+	p->OptionAdd(cache, _("Total cache memory max (MB, 0 for no limit)"), "Audio/Cache/Memory Max", 0, 1000000);
+	p->OptionBrowse(cache, _("Index and visualization cache path"), "Provider/FFmpegSource/Cache/Location");
+	p->OptionAdd(cache, _("Max index and visualization cache size (MB)"), "Provider/FFmpegSource/Cache/Size", 1, 1000000);
+	p->OptionAdd(cache, _("Copy media from network shares to the local disk"), "Provider/Staging/Enabled");
+	p->OptionBrowse(cache, _("Local media copy path"), "Provider/Staging/Location");
+	p->OptionAdd(cache, _("Max local media copy size (MB)"), "Provider/Staging/Size", 1, 10000000);
 
 	auto spectrum = p->PageSizer(_("Spectrum"));
 
@@ -383,7 +406,14 @@ void Advanced_Audio(wxTreebook *book, Preferences *parent) {
 	wxArrayString sq_choice(4, sq_arr);
 	p->OptionChoice(spectrum, _("Quality"), sq_choice, "Audio/Renderer/Spectrum/Quality");
 
+	const wxString fs_arr[3] = { _("Linear"), _("Logarithmic"), _("Mel") };
+	wxArrayString fs_choice(3, fs_arr);
+	p->OptionChoice(spectrum, _("Frequency scale"), fs_choice, "Audio/Renderer/Spectrum/Frequency Scale");
+	p->OptionAdd(spectrum, _("Lowest frequency (Hz)"), "Audio/Renderer/Spectrum/Min Frequency", 0, 96000);
+	p->OptionAdd(spectrum, _("Highest frequency (Hz, 0 for all)"), "Audio/Renderer/Spectrum/Max Frequency", 0, 96000);
+
 	p->OptionAdd(spectrum, _("Cache memory max (MB)"), "Audio/Renderer/Spectrum/Memory Max", 2, 1024);
+	p->OptionAdd(spectrum, _("Draw with OpenGL"), "Audio/Renderer/Spectrum/OpenGL");
 
 #ifdef WITH_AVISYNTH
 	auto avisynth = p->PageSizer("Avisynth");
@@ -439,6 +469,7 @@ void Advanced_Video(wxTreebook *book, Preferences *parent) {
 	p->OptionAdd(avisynth, _("Allow pre-2.56a Avisynth"), "Provider/Avisynth/Allow Ancient");
 	p->CellSkip(avisynth);
 	p->OptionAdd(avisynth, _("Avisynth memory limit"), "Provider/Avisynth/Memory Max");
+	p->OptionAdd(avisynth, _("Prefetch threads"), "Provider/Avisynth/Prefetch Threads");
 #endif
 
 #ifdef WITH_FFMS2
@@ -450,6 +481,7 @@ void Advanced_Video(wxTreebook *book, Preferences *parent) {
 
 	p->OptionAdd(ffms, _("Decoding threads"), "Provider/Video/FFmpegSource/Decoding Threads", -1);
 	p->OptionAdd(ffms, _("Enable unsafe seeking"), "Provider/Video/FFmpegSource/Unsafe Seeking");
+	p->OptionAdd(ffms, _("Convert YUV video to RGB on the GPU"), "Provider/Video/FFmpegSource/Native YUV");
 #endif
 
 	p->SetSizerAndFit(p->sizer);
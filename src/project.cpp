@@ -26,9 +26,13 @@
 #include "compat.h"
 #include "dialog_progress.h"
 #include "dialogs.h"
+#include "ffmpegsource_common.h"
 #include "format.h"
+#include "frame_main.h"
+#include "keyframe_detector.h"
 #include "include/aegisub/context.h"
 #include "include/aegisub/video_provider.h"
+#include "media_staging.h"
 #include "mkv_wrap.h"
 #include "options.h"
 #include "selection_controller.h"
@@ -38,6 +42,7 @@
 #include "video_display.h"
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/keyframe.h>
@@ -45,23 +50,46 @@
 #include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
 
+#include <atomic>
+#include <future>
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <wx/msgdlg.h>
 
-Project::Project(agi::Context *c) : context(c) {
+struct Project::BackgroundIndexing {
+	std::atomic<bool> cancelled{false};
+	/// Last progress percentage shown in the status bar
+	std::atomic<int> percent{-1};
+	/// Progress percentage of each file being indexed
+	std::vector<std::atomic<int>> file_percent;
+	/// Number of files still being indexed
+	std::atomic<size_t> remaining;
+
+	BackgroundIndexing(size_t files) : file_percent(files), remaining(files) { }
+};
+
+Project::Project(agi::Context *c)
+: context(c)
+, media_staged(AddMediaStagedListener([=](agi::fs::path const& path) { OnMediaStaged(path); }))
+{
 	OPT_SUB("Audio/Cache/Type", &Project::ReloadAudio, this);
 	OPT_SUB("Audio/Provider", &Project::ReloadAudio, this);
 	OPT_SUB("Provider/Audio/FFmpegSource/Decode Error Handling", &Project::ReloadAudio, this);
 	OPT_SUB("Provider/Avisynth/Allow Ancient", &Project::ReloadVideo, this);
 	OPT_SUB("Provider/Avisynth/Memory Max", &Project::ReloadVideo, this);
+	OPT_SUB("Provider/Avisynth/Prefetch Threads", &Project::ReloadVideo, this);
 	OPT_SUB("Provider/Video/FFmpegSource/Decoding Threads", &Project::ReloadVideo, this);
 	OPT_SUB("Provider/Video/FFmpegSource/Unsafe Seeking", &Project::ReloadVideo, this);
 	OPT_SUB("Subtitle/Provider", &Project::ReloadVideo, this);
 	OPT_SUB("Video/Provider", &Project::ReloadVideo, this);
 }
 
-Project::~Project() { }
+Project::~Project() {
+	CancelIndexing();
+	if (audio_provider)
+		SaveAudioPeaks(*audio_provider, audio_file);
+}
 
 void Project::UpdateRelativePaths() {
 	context->ass->Properties.audio_file     = context->path->MakeRelative(audio_file, "?script").generic_string();
@@ -82,6 +110,36 @@ void Project::ReloadVideo() {
 	}
 }
 
+void Project::StageFile(agi::fs::path const& path) {
+	if (StageMedia(path))
+		context->frame->StatusTimeout(agi::wxformat(_("Copying %s to the local disk"), to_wx(path.filename().string())));
+}
+
+void Project::OnMediaStaged(agi::fs::path const& path) {
+	// Audio is normally decoded into the RAM or HD cache as it's opened, so
+	// it's done reading from the share long before a copy could be made, and
+	// just uses the copy the next time it's opened
+	if (!video_provider || path != video_file) return;
+
+	// Only the provider is replaced, as nothing about the video has changed
+	// and fully reloading it would discard any timecodes or keyframes which
+	// were loaded from other files
+	try {
+		auto matrix = context->ass->GetScriptInfo("YCbCr Matrix");
+		video_provider = agi::make_unique<AsyncVideoProvider>(path, matrix, context->videoController.get(), progress);
+	}
+	catch (agi::Exception const& e) {
+		// Keep using the original
+		LOG_E("project/staging") << "Failed to open the copy of " << path << ": " << e.GetMessage();
+		return;
+	}
+
+	AnnounceVideoProviderModified(video_provider.get());
+	video_provider->LoadSubtitles(context->ass.get());
+	context->videoController->JumpToFrame(context->videoController->GetFrameN());
+	context->frame->StatusTimeout(agi::wxformat(_("Now reading %s from the local disk"), to_wx(path.filename().string())));
+}
+
 void Project::ShowError(wxString const& message) {
 	wxMessageBox(message, "Error loading file", wxOK | wxICON_ERROR | wxCENTER, context->parent);
 }
@@ -172,6 +230,8 @@ void Project::CloseSubtitles() {
 }
 
 void Project::LoadUnloadFiles(ProjectProperties properties) {
+	CancelIndexing();
+
 	auto load_linked = OPT_GET("App/Auto/Load Linked Files")->GetInt();
 	if (!load_linked) return;
 
@@ -207,6 +267,26 @@ void Project::LoadUnloadFiles(ProjectProperties properties) {
 			return;
 	}
 
+	bool started = IndexInBackground(
+		video != video_file ? video : agi::fs::path(),
+		audio != audio_file ? audio : agi::fs::path(),
+		[=] { DoLoadUnloadFiles(properties, audio, video, timecodes, keyframes); });
+	if (!started)
+		DoLoadUnloadFiles(properties, audio, video, timecodes, keyframes);
+}
+
+void Project::DoLoadUnloadFiles(ProjectProperties const& properties, agi::fs::path const& audio,
+                                agi::fs::path const& video, agi::fs::path const& timecodes,
+                                agi::fs::path const& keyframes) {
+	// The timecodes and keyframes files don't depend on anything else, so
+	// parse them while the video opens
+	std::future<agi::vfr::Framerate> parsed_timecodes;
+	std::future<std::vector<int>> parsed_keyframes;
+	if (!timecodes.empty())
+		parsed_timecodes = std::async(std::launch::async, [=] { return agi::vfr::Framerate(timecodes); });
+	if (!keyframes.empty())
+		parsed_keyframes = std::async(std::launch::async, [=] { return agi::keyframe::Load(keyframes); });
+
 	bool loaded_video = false;
 	if (video != video_file) {
 		if (video.empty())
@@ -224,8 +304,8 @@ void Project::LoadUnloadFiles(ProjectProperties properties) {
 		}
 	}
 
-	if (!timecodes.empty()) LoadTimecodes(timecodes);
-	if (!keyframes.empty()) LoadKeyframes(keyframes);
+	if (!timecodes.empty()) FinishLoadTimecodes(timecodes, std::move(parsed_timecodes));
+	if (!keyframes.empty()) FinishLoadKeyframes(keyframes, std::move(parsed_keyframes));
 
 	if (audio != audio_file) {
 		if (audio.empty())
@@ -241,9 +321,13 @@ void Project::DoLoadAudio(agi::fs::path const& path, bool quiet) {
 	if (!progress)
 		progress = new DialogProgress(context->parent);
 
+	if (audio_provider)
+		SaveAudioPeaks(*audio_provider, audio_file);
+
+	std::shared_ptr<agi::AudioProvider> new_provider;
 	try {
 		try {
-			audio_provider = GetAudioProvider(path, *context->path, progress);
+			new_provider = GetSharedAudioProvider(path, *context->path, progress);
 		}
 		catch (agi::UserCancelException const&) { return; }
 		catch (...) {
@@ -269,7 +353,14 @@ void Project::DoLoadAudio(agi::fs::path const& path, bool quiet) {
 		return ShowError(e.GetMessage());
 	}
 
+	LoadAudioPeaks(*new_provider, path);
 	SetPath(audio_file, "?audio", "Audio", path);
+	StageFile(path);
+
+	// Keep the old provider alive until everything using it has switched to
+	// the new one, as the audio renderers may still be reading from it on
+	// other threads
+	std::swap(audio_provider, new_provider);
 	AnnounceAudioProviderModified(audio_provider.get());
 }
 
@@ -279,6 +370,8 @@ void Project::LoadAudio(agi::fs::path path) {
 
 void Project::CloseAudio() {
 	AnnounceAudioProviderModified(nullptr);
+	if (audio_provider)
+		SaveAudioPeaks(*audio_provider, audio_file);
 	audio_provider.reset();
 	SetPath(audio_file, "?audio", "", "");
 }
@@ -321,14 +414,112 @@ bool Project::DoLoadVideo(agi::fs::path const& path) {
 	video_has_subtitles = false;
 	if (agi::fs::HasExtension(path, "mkv"))
 		video_has_subtitles = MatroskaWrapper::HasSubtitles(path);
+	StageFile(path);
 
 	AnnounceKeyframesModified(keyframes);
 	AnnounceTimecodesModified(timecodes);
 	return true;
 }
 
+bool Project::IndexInBackground(agi::fs::path const& video, agi::fs::path const& audio, std::function<void()> on_indexed) {
+#ifdef WITH_FFMS2
+	struct IndexJob {
+		agi::fs::path path;
+		agi::fs::path cache_name;
+		FFmpegSourceProvider::TrackSelection track;
+	};
+	std::vector<IndexJob> jobs;
+
+	// Only checks that there's an index at all, as reading it to check if
+	// it's up to date could be nearly as slow as opening the file. A stale
+	// index is replaced when the file is opened, as before.
+	FFmpegSourceProvider ffms(nullptr);
+	auto add_job = [&](agi::fs::path const& path, const char *provider, FFmpegSourceProvider::TrackSelection track) {
+		if (path.empty() || !boost::iequals(OPT_GET(provider)->GetString(), "ffmpegsource"))
+			return;
+		auto cache_name = ffms.GetCacheFilename(path);
+		if (!agi::fs::FileExists(cache_name))
+			jobs.push_back(IndexJob{path, cache_name, track});
+	};
+
+	auto track = FFmpegSourceProvider::TrackSelection::None;
+	if (FFmpegSourceProvider::IndexAllAudioTracks() || audio == video)
+		track = FFmpegSourceProvider::TrackSelection::All;
+	add_job(video, "Video/Provider", track);
+	// Audio from the video file is covered by the video's index
+	if (audio != video)
+		add_job(audio, "Audio/Provider", FFmpegSourceProvider::TrackSelection::All);
+	if (jobs.empty())
+		return false;
+
+	auto error_handling = ffms.GetErrorHandlingMode();
+
+	auto state = std::make_shared<BackgroundIndexing>(jobs.size());
+	indexing = state;
+
+	std::string names;
+	for (auto const& job : jobs) {
+		if (!names.empty()) names += ", ";
+		names += job.path.filename().string();
+	}
+
+	// The files are indexed at the same time, so that opening them costs as
+	// long as the slowest one rather than all of them, and the status bar
+	// shows their combined progress
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		auto progress = [=](int64_t current, int64_t total) {
+			state->file_percent[i] = total > 0 ? static_cast<int>(current * 100 / total) : 0;
+			int percent = 0;
+			for (auto const& file_percent : state->file_percent)
+				percent += file_percent;
+			percent /= static_cast<int>(state->file_percent.size());
+
+			if (state->percent.exchange(percent) != percent) {
+				agi::dispatch::Main().Async([=] {
+					if (!state->cancelled)
+						context->frame->StatusTimeout(agi::wxformat(_("Indexing %s: %d%%"), to_wx(names), percent));
+				});
+			}
+			return state->cancelled.load();
+		};
+
+		auto job = jobs[i];
+		agi::dispatch::Background().Async([=] {
+			if (!FFmpegSourceProvider::IndexToCache(job.path, job.cache_name, job.track, error_handling, progress))
+				return;
+			if (--state->remaining > 0)
+				return;
+			agi::dispatch::Main().Async([=] {
+				if (state->cancelled) return;
+				indexing.reset();
+				context->frame->StatusTimeout(agi::wxformat(_("Indexed %s"), to_wx(names)));
+				on_indexed();
+			});
+		});
+	}
+
+	context->frame->StatusTimeout(agi::wxformat(_("Indexing %s"), to_wx(names)));
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Project::CancelIndexing() {
+	if (indexing) {
+		indexing->cancelled = true;
+		indexing.reset();
+	}
+}
+
 void Project::LoadVideo(agi::fs::path path) {
 	if (path.empty()) return;
+	CancelIndexing();
+	if (!IndexInBackground(path, agi::fs::path(), [=] { FinishLoadVideo(path); }))
+		FinishLoadVideo(path);
+}
+
+void Project::FinishLoadVideo(agi::fs::path const& path) {
 	if (!DoLoadVideo(path)) return;
 	if (OPT_GET("Video/Open Audio")->GetBool() && audio_file != video_file && video_provider->HasAudio())
 		DoLoadAudio(video_file, true);
@@ -342,6 +533,7 @@ void Project::LoadVideo(agi::fs::path path) {
 }
 
 void Project::CloseVideo() {
+	CancelIndexing();
 	AnnounceVideoProviderModified(nullptr);
 	video_provider.reset();
 	SetPath(video_file, "?video", "", "");
@@ -358,8 +550,14 @@ void Project::DoLoadTimecodes(agi::fs::path const& path) {
 }
 
 void Project::LoadTimecodes(agi::fs::path path) {
+	FinishLoadTimecodes(path, std::async(std::launch::deferred, [=] { return agi::vfr::Framerate(path); }));
+}
+
+void Project::FinishLoadTimecodes(agi::fs::path const& path, std::future<agi::vfr::Framerate> parsed) {
 	try {
-		DoLoadTimecodes(path);
+		timecodes = parsed.get();
+		SetPath(timecodes_file, "", "Timecodes", path);
+		AnnounceTimecodesModified(timecodes);
 	}
 	catch (agi::fs::FileSystemError const& e) {
 		ShowError(e.GetMessage());
@@ -384,8 +582,14 @@ void Project::DoLoadKeyframes(agi::fs::path const& path) {
 }
 
 void Project::LoadKeyframes(agi::fs::path path) {
+	FinishLoadKeyframes(path, std::async(std::launch::deferred, [=] { return agi::keyframe::Load(path); }));
+}
+
+void Project::FinishLoadKeyframes(agi::fs::path const& path, std::future<std::vector<int>> parsed) {
 	try {
-		DoLoadKeyframes(path);
+		keyframes = parsed.get();
+		SetPath(keyframes_file, "", "Keyframes", path);
+		AnnounceKeyframesModified(keyframes);
 	}
 	catch (agi::fs::FileSystemError const& e) {
 		ShowError(e.GetMessage());
@@ -403,6 +607,26 @@ void Project::CloseKeyframes() {
 	AnnounceKeyframesModified(keyframes);
 }
 
+void Project::DetectKeyframes() {
+	if (!video_provider) return;
+	if (!progress)
+		progress = new DialogProgress(context->parent);
+
+	try {
+		auto path = ::DetectKeyframes(video_file, video_provider->GetColorSpace(), progress);
+		if (path.empty()) return;
+
+		keyframes = agi::keyframe::Load(path);
+		// Not added to the MRU as the file is in the cache
+		SetPath(keyframes_file, "", "", path);
+		AnnounceKeyframesModified(keyframes);
+	}
+	catch (agi::UserCancelException const&) { }
+	catch (agi::Exception const& e) {
+		ShowError(e.GetMessage());
+	}
+}
+
 void Project::LoadList(std::vector<agi::fs::path> const& files) {
 	// Keep these lists sorted
 
@@ -509,6 +733,15 @@ void Project::LoadList(std::vector<agi::fs::path> const& files) {
 			subs.clear();
 	}
 
+	CancelIndexing();
+	auto finish = [=] { FinishLoadList(properties, audio, video, subs, timecodes, keyframes); };
+	if (!IndexInBackground(video, audio, finish))
+		finish();
+}
+
+void Project::FinishLoadList(ProjectProperties const& properties, agi::fs::path const& audio,
+                             agi::fs::path const& video, agi::fs::path const& subs,
+                             agi::fs::path const& timecodes, agi::fs::path const& keyframes) {
 	if (!video.empty() && DoLoadVideo(video)) {
 		double dar = video_provider->GetDAR();
 		if (dar > 0)
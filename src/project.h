@@ -19,6 +19,8 @@
 #include <libaegisub/vfr.h>
 
 #include <boost/filesystem/path.hpp>
+#include <functional>
+#include <future>
 #include <memory>
 #include <vector>
 
@@ -30,7 +32,8 @@ namespace agi { struct Context; }
 struct ProjectProperties;
 
 class Project {
-	std::unique_ptr<agi::AudioProvider> audio_provider;
+	/// Shared with any other windows which have the same audio open
+	std::shared_ptr<agi::AudioProvider> audio_provider;
 	std::unique_ptr<AsyncVideoProvider> video_provider;
 	agi::vfr::Framerate timecodes;
 	std::vector<int> keyframes;
@@ -47,7 +50,11 @@ class Project {
 
 	bool video_has_subtitles = false;
 	DialogProgress *progress = nullptr;
+	/// State of the files being indexed in the background, if any
+	struct BackgroundIndexing;
+	std::shared_ptr<BackgroundIndexing> indexing;
 	agi::Context *context = nullptr;
+	agi::signal::Connection media_staged;
 
 	void ShowError(wxString const& message);
 	void ShowError(std::string const& message);
@@ -58,7 +65,28 @@ class Project {
 	void DoLoadTimecodes(agi::fs::path const& path);
 	void DoLoadKeyframes(agi::fs::path const& path);
 
+	/// @brief Index files in the background if opening them would otherwise block on indexing
+	/// @param video Video file to index, or empty for none
+	/// @param audio Audio file to index, or empty for none
+	/// @param on_indexed Called on the main thread once all of them are indexed
+	/// @return Was indexing started? If not, the files should be opened immediately.
+	bool IndexInBackground(agi::fs::path const& video, agi::fs::path const& audio, std::function<void()> on_indexed);
+	void CancelIndexing();
+	void FinishLoadVideo(agi::fs::path const& path);
+	void FinishLoadTimecodes(agi::fs::path const& path, std::future<agi::vfr::Framerate> parsed);
+	void FinishLoadKeyframes(agi::fs::path const& path, std::future<std::vector<int>> parsed);
+	void FinishLoadList(ProjectProperties const& properties, agi::fs::path const& audio,
+	                    agi::fs::path const& video, agi::fs::path const& subs,
+	                    agi::fs::path const& timecodes, agi::fs::path const& keyframes);
+
 	void LoadUnloadFiles(ProjectProperties properties);
+	void DoLoadUnloadFiles(ProjectProperties const& properties, agi::fs::path const& audio,
+	                       agi::fs::path const& video, agi::fs::path const& timecodes,
+	                       agi::fs::path const& keyframes);
+	/// Switch to a local copy of a file on a network share once it's ready
+	void OnMediaStaged(agi::fs::path const& path);
+	/// Start making a local copy of a file if it's on a network share
+	void StageFile(agi::fs::path const& path);
 	void UpdateRelativePaths();
 	void ReloadAudio();
 	void ReloadVideo();
@@ -90,6 +118,8 @@ public:
 
 	void LoadKeyframes(agi::fs::path path);
 	void CloseKeyframes();
+	/// Replace the keyframes with the scene changes detected in the video
+	void DetectKeyframes();
 	bool CanCloseKeyframes() const { return !keyframes_file.empty(); }
 	std::vector<int> const& Keyframes() const { return keyframes; }
 
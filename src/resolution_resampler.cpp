@@ -23,11 +23,13 @@
 
 #include <libaegisub/exception.h>
 #include <libaegisub/of_type_adaptor.h>
+#include <libaegisub/parallel.h>
 #include <libaegisub/split.h>
 #include <libaegisub/util.h>
 #include <libaegisub/ycbcr_conv.h>
 
 #include <algorithm>
+#include <array>
 #include <boost/algorithm/string/predicate.hpp>
 #include <cmath>
 #include <wx/intl.h>
@@ -156,8 +158,31 @@ namespace {
 			cur->Set<int>((cur->Get<int>() + shift) * resizer + 0.5);
 	}
 
-	void resample_line(resample_state *state, AssDialogue &diag) {
-		if (diag.Comment && (boost::starts_with(diag.Effect.get(), "template") || boost::starts_with(diag.Effect.get(), "code")))
+	/// New values for the fields of a line which resampling changes
+	struct resampled_line {
+		bool skipped = false;
+		/// Only set if the text changed
+		std::string text;
+		std::array<int, 3> margin;
+	};
+
+	/// Work out what a line becomes without modifying it, so that this can
+	/// be run on several lines at once
+	void resample_line(resample_state *state, AssDialogue const& diag, resampled_line &out) {
+		if (diag.Comment && (boost::starts_with(diag.Effect.get(), "template") || boost::starts_with(diag.Effect.get(), "code"))) {
+			out.skipped = true;
+			return;
+		}
+
+		for (size_t i = 0; i < 3; ++i) {
+			out.margin[i] = diag.Margin[i];
+			if (diag.Margin[i])
+				out.margin[i] = int((diag.Margin[i] + state->margin[i]) * (i < 2 ? state->rx : state->ry) + 0.5);
+		}
+
+		// Without override blocks there's nothing in the text to scale, as
+		// drawings need a \p tag
+		if (diag.Text.get().find('{') == std::string::npos)
 			return;
 
 		auto blocks = diag.ParseTags();
@@ -168,12 +193,8 @@ namespace {
 		for (auto drawing : blocks | agi::of_type<AssDialogueBlockDrawing>())
 			drawing->text = transform_drawing(drawing->text, 0, 0, state->rx / state->ar, state->ry);
 
-		for (size_t i = 0; i < 3; ++i) {
-			if (diag.Margin[i])
-				diag.Margin[i] = int((diag.Margin[i] + state->margin[i]) * (i < 2 ? state->rx : state->ry) + 0.5);
-		}
-
-		diag.UpdateText(blocks);
+		for (auto const& block : blocks)
+			out.text += block->GetText();
 	}
 
 	void resample_style(resample_state *state, AssStyle &style) {
@@ -185,10 +206,12 @@ namespace {
 		for (int i = 0; i < 3; i++)
 			style.Margin[i] = int((style.Margin[i] + state->margin[i]) * (i < 2 ? state->rx : state->ry) + 0.5);
 		if (state->convert_colors) {
-			style.primary = state->conv.rgb_to_rgb(style.primary);
-			style.secondary = state->conv.rgb_to_rgb(style.secondary);
-			style.outline = state->conv.rgb_to_rgb(style.outline);
-			style.shadow = state->conv.rgb_to_rgb(style.shadow);
+			agi::Color colors[] = {style.primary, style.secondary, style.outline, style.shadow};
+			state->conv.rgb_to_rgb(colors, 4);
+			style.primary = colors[0];
+			style.secondary = colors[1];
+			style.outline = colors[2];
+			style.shadow = colors[3];
 		}
 		style.UpdateData();
 	}
@@ -278,8 +301,26 @@ void ResampleResolution(AssFile *ass, ResampleSettings settings) {
 
 	for (auto& line : ass->Styles)
 		resample_style(&state, line);
+
+	// The lines are resampled in parallel into a separate list of results,
+	// which are then all applied on this thread
+	std::vector<AssDialogue *> lines;
 	for (auto& line : ass->Events)
-		resample_line(&state, line);
+		lines.push_back(&line);
+
+	std::vector<resampled_line> results(lines.size());
+	agi::parallel_for(0, lines.size(), 256, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			resample_line(&state, *lines[i], results[i]);
+	});
+
+	for (size_t i = 0; i < lines.size(); ++i) {
+		auto& result = results[i];
+		if (result.skipped) continue;
+		lines[i]->Margin = result.margin;
+		if (!result.text.empty())
+			lines[i]->Text = result.text;
+	}
 
 	ass->SetScriptInfo("PlayResX", std::to_string(settings.dest_x));
 	ass->SetScriptInfo("PlayResY", std::to_string(settings.dest_y));
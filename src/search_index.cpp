@@ -0,0 +1,166 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "search_index.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+FlyweightString AssDialogueBase::*const index_fields[] = {
+	&AssDialogueBase::Text,
+	&AssDialogueBase::Style,
+	&AssDialogueBase::Actor,
+	&AssDialogueBase::Effect
+};
+
+inline unsigned char fold(unsigned char c) {
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+/// Get the distinct trigrams of an ASCII string
+/// @return false if the string isn't ASCII
+bool trigrams(std::string const& str, std::vector<uint32_t>& out) {
+	out.clear();
+	uint32_t trigram = 0;
+	for (size_t i = 0; i < str.size(); ++i) {
+		unsigned char c = str[i];
+		if (c >= 0x80) return false;
+		trigram = ((trigram << 8) | fold(c)) & 0xFFFFFF;
+		if (i >= 2)
+			out.push_back(trigram);
+	}
+	std::sort(begin(out), end(out));
+	out.erase(std::unique(begin(out), end(out)), end(out));
+	return true;
+}
+}
+
+SearchIndex::SearchIndex(AssFile *file)
+: file(file)
+, commit_connection(file->AddCommitListener(&SearchIndex::OnCommit, this))
+{
+}
+
+void SearchIndex::Clear() {
+	valid = false;
+	for (auto& field : fields) {
+		field.postings.clear();
+		field.unindexed.clear();
+	}
+	slots.clear();
+	slot_of.clear();
+	dead_slots = 0;
+}
+
+void SearchIndex::Build() {
+	Clear();
+	for (auto const& line : file->Events)
+		Add(&line);
+	valid = true;
+}
+
+void SearchIndex::Add(const AssDialogue *line) {
+	const uint32_t slot = slots.size();
+	slots.push_back(line);
+	slot_of[line] = slot;
+
+	std::vector<uint32_t> line_trigrams;
+	for (size_t i = 0; i < fields.size(); ++i) {
+		if (!trigrams((line->*index_fields[i]).get(), line_trigrams)) {
+			fields[i].unindexed.push_back(slot);
+			continue;
+		}
+		for (auto trigram : line_trigrams)
+			fields[i].postings[trigram].push_back(slot);
+	}
+}
+
+void SearchIndex::OnCommit(int type) {
+	if (!valid) return;
+
+	// Changes which can't have touched the text fields
+	if (type != AssFile::COMMIT_NEW && !(type & ~(AssFile::COMMIT_ORDER | AssFile::COMMIT_SCRIPTINFO | AssFile::COMMIT_ATTACHMENT | AssFile::COMMIT_EXTRADATA | AssFile::COMMIT_DIAG_TIME)))
+		return;
+
+	auto const& changed = file->ChangedLines();
+	if (changed.empty()) {
+		Clear();
+		return;
+	}
+
+	for (auto line : changed) {
+		auto it = slot_of.find(line);
+		if (it != slot_of.end()) {
+			slots[it->second] = nullptr;
+			++dead_slots;
+		}
+		Add(line);
+	}
+
+	// Rebuild rather than letting the posting lists fill up with changed lines
+	if (dead_slots > slots.size() / 2)
+		Clear();
+}
+
+bool SearchIndex::Candidates(SearchReplaceSettings::Field field, std::string const& needle, std::unordered_set<const AssDialogue *>& candidates) {
+	std::vector<uint32_t> needle_trigrams;
+	if (!trigrams(needle, needle_trigrams) || needle_trigrams.empty())
+		return false;
+
+	if (!valid)
+		Build();
+
+	auto const& index = fields[static_cast<size_t>(field)];
+
+	// Intersect the posting lists, starting with the shortest
+	std::vector<std::vector<uint32_t> const*> lists;
+	for (auto trigram : needle_trigrams) {
+		auto it = index.postings.find(trigram);
+		if (it == index.postings.end()) {
+			lists.clear();
+			break;
+		}
+		lists.push_back(&it->second);
+	}
+	std::sort(begin(lists), end(lists), [](std::vector<uint32_t> const* a, std::vector<uint32_t> const* b) {
+		return a->size() < b->size();
+	});
+
+	std::vector<uint32_t> matches, next;
+	if (!lists.empty()) {
+		matches = *lists[0];
+		for (size_t i = 1; i < lists.size() && !matches.empty(); ++i) {
+			next.clear();
+			std::set_intersection(begin(matches), end(matches), begin(*lists[i]), end(*lists[i]), back_inserter(next));
+			swap(matches, next);
+		}
+	}
+
+	candidates.clear();
+	for (auto slot : matches) {
+		if (slots[slot])
+			candidates.insert(slots[slot]);
+	}
+	for (auto slot : index.unindexed) {
+		if (slots[slot])
+			candidates.insert(slots[slot]);
+	}
+	return true;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include "search_replace_engine.h"
+
+#include <libaegisub/signal.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class AssDialogue;
+class AssFile;
+
+/// @class SearchIndex
+/// @brief Trigram index of the text fields of the dialogue lines
+///
+/// Used to find which lines could contain a literal string before running
+/// the real matcher on them. Trigrams are indexed with ASCII letters
+/// lowercased, so the index works for both case-sensitive and insensitive
+/// searches. Case folding and normalization can turn non-ASCII characters
+/// into ASCII, so lines with any non-ASCII text in a field aren't indexed
+/// and are always candidates for that field.
+///
+/// The index is built on the first search, and then kept up to date with
+/// the lines changed by each commit. Commits which don't say which lines
+/// they changed throw it away, and it's rebuilt on the next search.
+class SearchIndex {
+	struct FieldIndex {
+		/// Slots of the lines containing each trigram, in increasing order
+		std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+		/// Slots of the lines with non-ASCII text in this field
+		std::vector<uint32_t> unindexed;
+	};
+
+	AssFile *file;
+	agi::signal::Connection commit_connection;
+
+	/// Is the index up to date with the file?
+	bool valid = false;
+	std::array<FieldIndex, 4> fields;
+	/// Line in each slot, or nullptr if the line has changed since it was
+	/// indexed. Changed lines get a new slot so that posting lists only
+	/// ever have slots appended to them.
+	std::vector<const AssDialogue *> slots;
+	/// Current slot of each line
+	std::unordered_map<const AssDialogue *, uint32_t> slot_of;
+	/// Number of slots whose line has changed
+	size_t dead_slots = 0;
+
+	void Build();
+	void Clear();
+	void Add(const AssDialogue *line);
+	void OnCommit(int type);
+
+public:
+	SearchIndex(AssFile *file);
+
+	/// Get the lines which could contain a string
+	/// @param field Field to search
+	/// @param needle String to look for
+	/// @param[out] candidates Lines which may contain needle
+	/// @return false if the index can't narrow down the search for this
+	///         string, in which case every line has to be checked
+	bool Candidates(SearchReplaceSettings::Field field, std::string const& needle, std::unordered_set<const AssDialogue *>& candidates);
+};
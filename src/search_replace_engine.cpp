@@ -20,12 +20,16 @@
 #include "ass_file.h"
 #include "format.h"
 #include "include/aegisub/context.h"
+#include "search_index.h"
 #include "selection_controller.h"
 #include "text_selection_controller.h"
 
 #include <libaegisub/exception.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/parallel.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
 #include <boost/locale/conversion.hpp>
 
 #include <wx/msgdlg.h>
@@ -34,6 +38,9 @@ namespace {
 static const size_t bad_pos = -1;
 static const MatchState bad_match{nullptr, 0, bad_pos};
 
+/// Number of lines in each chunk of Replace All done in parallel
+const size_t min_parallel_replace = 2000;
+
 auto get_dialogue_field(SearchReplaceSettings::Field field) -> decltype(&AssDialogueBase::Text) {
 	switch (field) {
 		case SearchReplaceSettings::Field::TEXT: return &AssDialogueBase::Text;
@@ -46,6 +53,12 @@ auto get_dialogue_field(SearchReplaceSettings::Field field) -> decltype(&AssDial
 
 std::string const& get_normalized(const AssDialogue *diag, decltype(&AssDialogueBase::Text) field) {
 	auto& value = const_cast<AssDialogue*>(diag)->*field;
+
+	// ASCII text is always already normalized
+	auto const& str = value.get();
+	if (std::none_of(begin(str), end(str), [](char c) { return static_cast<unsigned char>(c) >= 0x80; }))
+		return str;
+
 	auto normalized = boost::locale::normalize(value.get());
 	if (normalized != value)
 		value = normalized;
@@ -55,7 +68,7 @@ std::string const& get_normalized(const AssDialogue *diag, decltype(&AssDialogue
 typedef std::function<MatchState (const AssDialogue*, size_t)> matcher;
 
 class noop_accessor {
-	boost::flyweight<std::string> AssDialogueBase::*field;
+	FlyweightString AssDialogueBase::*field;
 	size_t start = 0;
 
 public:
@@ -72,7 +85,7 @@ public:
 };
 
 class skip_tags_accessor {
-	boost::flyweight<std::string> AssDialogueBase::*field;
+	FlyweightString AssDialogueBase::*field;
 	agi::util::tagless_find_helper helper;
 
 public:
@@ -146,10 +159,21 @@ std::function<MatchState (const AssDialogue*, size_t)> SearchReplaceEngine::GetM
 
 SearchReplaceEngine::SearchReplaceEngine(agi::Context *c)
 : context(c)
+, index(agi::make_unique<SearchIndex>(c->ass.get()))
 {
 }
 
-void SearchReplaceEngine::Replace(AssDialogue *diag, MatchState &ms) {
+SearchReplaceEngine::~SearchReplaceEngine() { }
+
+bool SearchReplaceEngine::GetCandidates(SearchReplaceSettings const& settings, std::unordered_set<const AssDialogue *>& candidates) {
+	// The index only has the raw text, which doesn't match what regexes and
+	// tag-skipping searches look at
+	if (settings.use_regex || settings.skip_tags)
+		return false;
+	return index->Candidates(settings.field, settings.find, candidates);
+}
+
+void SearchReplaceEngine::Replace(AssDialogue *diag, MatchState &ms) const {
 	auto& diag_field = diag->*get_dialogue_field(settings.field);
 	auto text = diag_field.get();
 
@@ -186,7 +210,7 @@ bool SearchReplaceEngine::FindReplace(bool replace) {
 			if (end == bad_pos || (pos == replace_ms.start && end == replace_ms.end)) {
 				Replace(line, replace_ms);
 				pos = replace_ms.end;
-				context->ass->Commit(_("replace"), AssFile::COMMIT_DIAG_TEXT);
+				context->ass->Commit(_("replace"), AssFile::COMMIT_DIAG_TEXT, -1, line);
 			}
 			else {
 				// The current line matches, but it wasn't already selected,
@@ -208,7 +232,11 @@ bool SearchReplaceEngine::FindReplace(bool replace) {
 	auto const& sel = context->selectionController->GetSelectedSet();
 	bool selection_only = sel.size() > 1 && settings.limit_to == SearchReplaceSettings::Limit::SELECTED;
 
+	std::unordered_set<const AssDialogue *> candidates;
+	bool use_candidates = GetCandidates(settings, candidates);
+
 	do {
+		if (use_candidates && !candidates.count(&*it)) continue;
 		if (selection_only && !sel.count(&*it)) continue;
 		if (settings.ignore_comments && it->Comment) continue;
 
@@ -234,52 +262,94 @@ bool SearchReplaceEngine::FindReplace(bool replace) {
 	return true;
 }
 
-bool SearchReplaceEngine::ReplaceAll() {
-	if (!initialized)
-		return false;
-
+size_t SearchReplaceEngine::ReplaceLines(AssDialogue *const *begin, AssDialogue *const *end, std::vector<AssDialogue *>& changed) const {
 	size_t count = 0;
-
 	auto matches = GetMatcher(settings);
+	auto field = get_dialogue_field(settings.field);
 
-	auto const& sel = context->selectionController->GetSelectedSet();
-	bool selection_only = settings.limit_to == SearchReplaceSettings::Limit::SELECTED;
-
-	for (auto& diag : context->ass->Events) {
-		if (selection_only && !sel.count(&diag)) continue;
-		if (settings.ignore_comments && diag.Comment) continue;
+	for (; begin != end; ++begin) {
+		AssDialogue *diag = *begin;
 
 		if (settings.use_regex) {
-			if (MatchState ms = matches(&diag, 0)) {
-				auto& diag_field = diag.*get_dialogue_field(settings.field);
+			if (MatchState ms = matches(diag, 0)) {
+				auto& diag_field = diag->*field;
 				std::string const& text = diag_field.get();
 				count += std::distance(
-					boost::u32regex_iterator<std::string::const_iterator>(begin(text), end(text), *ms.re),
+					boost::u32regex_iterator<std::string::const_iterator>(text.begin(), text.end(), *ms.re),
 					boost::u32regex_iterator<std::string::const_iterator>());
 				diag_field = u32regex_replace(text, *ms.re, settings.replace_with);
+				changed.push_back(diag);
 			}
 			continue;
 		}
 
 		size_t pos = 0;
-		while (MatchState ms = matches(&diag, pos)) {
-			++count;
-			Replace(&diag, ms);
+		size_t line_count = 0;
+		while (MatchState ms = matches(diag, pos)) {
+			++line_count;
+			Replace(diag, ms);
 			pos = ms.end;
 		}
+		if (line_count) {
+			count += line_count;
+			changed.push_back(diag);
+		}
 	}
 
-	if (count > 0) {
-		context->ass->Commit(_("replace"), AssFile::COMMIT_DIAG_TEXT);
+	return count;
+}
+
+bool SearchReplaceEngine::ReplaceAll() {
+	if (!initialized)
+		return false;
+
+	size_t count = ReplaceAllMatches();
+	if (count > 0)
 		wxMessageBox(fmt_plural(count, "One match was replaced.", "%d matches were replaced.", (int)count));
-	}
-	else {
+	else
 		wxMessageBox(_("No matches found."));
-	}
 
 	return true;
 }
 
+size_t SearchReplaceEngine::ReplaceAllMatches() {
+	if (!initialized)
+		return 0;
+
+	auto const& sel = context->selectionController->GetSelectedSet();
+	bool selection_only = settings.limit_to == SearchReplaceSettings::Limit::SELECTED;
+
+	std::unordered_set<const AssDialogue *> candidates;
+	bool use_candidates = GetCandidates(settings, candidates);
+
+	std::vector<AssDialogue *> lines;
+	for (auto& diag : context->ass->Events) {
+		if (use_candidates && !candidates.count(&diag)) continue;
+		if (selection_only && !sel.count(&diag)) continue;
+		if (settings.ignore_comments && diag.Comment) continue;
+		lines.push_back(&diag);
+	}
+
+	// Each line is only touched by the chunk it's in, and each chunk has its
+	// own matcher, so the chunks can be done in parallel
+	const size_t slot_count = agi::parallel_concurrency();
+	std::vector<size_t> counts(slot_count);
+	std::vector<std::vector<AssDialogue *>> changed(slot_count);
+	agi::parallel_for_slots(0, lines.size(), min_parallel_replace, [&](size_t slot, size_t begin, size_t end) {
+		counts[slot] += ReplaceLines(lines.data() + begin, lines.data() + end, changed[slot]);
+	});
+
+	size_t count = 0;
+	for (auto chunk_count : counts)
+		count += chunk_count;
+	for (size_t t = 1; t < slot_count; ++t)
+		changed[0].insert(changed[0].end(), changed[t].begin(), changed[t].end());
+
+	if (count > 0)
+		context->ass->Commit(_("replace"), AssFile::COMMIT_DIAG_TEXT, -1, changed[0]);
+	return count;
+}
+
 void SearchReplaceEngine::Configure(SearchReplaceSettings const& new_settings) {
 	settings = new_settings;
 	initialized = true;
@@ -16,10 +16,14 @@
 
 #include <functional>
 #include <boost/regex/icu.hpp>
+#include <memory>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 namespace agi { struct Context; }
 class AssDialogue;
+class SearchIndex;
 
 struct MatchState {
 	boost::u32regex *re;
@@ -58,18 +62,36 @@ class SearchReplaceEngine {
 	agi::Context *context;
 	bool initialized = false;
 	SearchReplaceSettings settings;
+	std::unique_ptr<SearchIndex> index;
 
 	bool FindReplace(bool replace);
-	void Replace(AssDialogue *line, MatchState &ms);
+	void Replace(AssDialogue *line, MatchState &ms) const;
+
+	/// Replace every match in a range of lines
+	/// @param begin First line
+	/// @param end One past the last line
+	/// @param[out] changed Lines which had any matches are appended to this
+	/// @return Number of matches replaced
+	size_t ReplaceLines(AssDialogue *const *begin, AssDialogue *const *end, std::vector<AssDialogue *>& changed) const;
 
 public:
 	bool FindNext() { return FindReplace(false); }
 	bool ReplaceNext() { return FindReplace(true); }
 	bool ReplaceAll();
+	/// Replace every match without telling the user how many there were
+	/// @return Number of matches replaced
+	size_t ReplaceAllMatches();
 
 	void Configure(SearchReplaceSettings const& new_settings);
 
 	static std::function<MatchState (const AssDialogue*, size_t)> GetMatcher(SearchReplaceSettings const& settings);
 
+	/// Get the lines which could be matched by some settings
+	/// @param settings Settings to match with
+	/// @param[out] candidates Lines which could match
+	/// @return false if every line has to be checked
+	bool GetCandidates(SearchReplaceSettings const& settings, std::unordered_set<const AssDialogue *>& candidates);
+
 	SearchReplaceEngine(agi::Context *c);
+	~SearchReplaceEngine();
 };
@@ -22,12 +22,22 @@
 #include "subs_controller.h"
 
 #include <algorithm>
+#include <iterator>
 
 SelectionController::SelectionController(agi::Context *c) : context(c) { }
 
-void SelectionController::SetSelectedSet(Selection new_selection) {
+bool SelectionController::UpdateSelection(Selection new_selection) {
+	added_lines.clear();
+	removed_lines.clear();
+	set_difference(begin(new_selection), end(new_selection), begin(selection), end(selection), back_inserter(added_lines));
+	set_difference(begin(selection), end(selection), begin(new_selection), end(new_selection), back_inserter(removed_lines));
 	selection = std::move(new_selection);
-	AnnounceSelectedSetChanged();
+	return !added_lines.empty() || !removed_lines.empty();
+}
+
+void SelectionController::SetSelectedSet(Selection new_selection) {
+	if (UpdateSelection(std::move(new_selection)))
+		AnnounceSelectedSetChanged();
 }
 
 void SelectionController::SetActiveLine(AssDialogue *new_line) {
@@ -41,12 +51,13 @@ void SelectionController::SetActiveLine(AssDialogue *new_line) {
 
 void SelectionController::SetSelectionAndActive(Selection new_selection, AssDialogue *new_line) {
 	bool active_line_changed = new_line != active_line;
-	selection = std::move(new_selection);
+	bool selection_changed = UpdateSelection(std::move(new_selection));
 	active_line = new_line;
 	if (active_line)
 		context->ass->Properties.active_row = active_line->Row;
 
-	AnnounceSelectedSetChanged();
+	if (selection_changed)
+		AnnounceSelectedSetChanged();
 	if (active_line_changed)
 		AnnounceActiveLineChanged(new_line);
 }
@@ -46,6 +46,15 @@ class SelectionController {
 	Selection selection; ///< Currently selected lines
 	AssDialogue *active_line = nullptr; ///< The currently active line or 0 if none
 
+	/// Lines added to the selection by the most recent change
+	std::vector<AssDialogue *> added_lines;
+	/// Lines removed from the selection by the most recent change
+	std::vector<AssDialogue *> removed_lines;
+
+	/// Replace the selection and work out which lines were added and removed
+	/// @return Did the selection change?
+	bool UpdateSelection(Selection new_selection);
+
 public:
 	SelectionController(agi::Context *context);
 
@@ -84,6 +93,18 @@ public:
 	/// Get the selection sorted by row number
 	std::vector<AssDialogue *> GetSortedSelection() const;
 
+	/// @brief Get the lines added to the selection by the change being announced
+	///
+	/// Lets selection listeners update only what changed rather than
+	/// looking at the whole selection. Sorted by address, like Selection.
+	std::vector<AssDialogue *> const& GetAddedLines() const { return added_lines; }
+
+	/// @brief Get the lines removed from the selection by the change being announced
+	///
+	/// Sorted by address. The lines may have been deleted from the file, so
+	/// they must only be compared against and not dereferenced.
+	std::vector<AssDialogue *> const& GetRemovedLines() const { return removed_lines; }
+
 	/// @brief Set both the selected set and active line
 	/// @param new_line Subtitle line to become the new active line
 	/// @param new_selection The set of subtitle lines to become the new selected set
@@ -20,8 +20,15 @@
 #include "options.h"
 
 #include <libaegisub/make_unique.h>
+#include <libaegisub/signal.h>
 #include <libaegisub/spellchecker.h>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <unordered_map>
+
 #ifdef __APPLE__
 namespace agi {
 class OptionValue;
@@ -29,12 +36,153 @@ std::unique_ptr<agi::SpellChecker> CreateCocoaSpellChecker(OptionValue *opt);
 }
 #endif
 
+namespace {
+/// Number of unchecked words needed to justify each extra thread, as each
+/// one loads its own copy of the dictionary
+const size_t min_words_per_thread = 2000;
+
+/// Number of words a thread claims at a time
+const size_t words_per_batch = 256;
+
+/// Results of checking words, shared by all of the spell checkers as they
+/// all use the current dictionary
+std::unordered_map<std::string, bool> checked_words;
+
+/// Spell checker which remembers the result of checking each word, as the
+/// edit box rechecks every word in the line on each change and the backends
+/// can be slow with large dictionaries
+class CachingSpellChecker final : public agi::SpellChecker {
+	std::unique_ptr<agi::SpellChecker> checker;
+	agi::signal::Connection lang_listener;
+	agi::signal::Connection dict_path_listener;
+
+public:
+	CachingSpellChecker(std::unique_ptr<agi::SpellChecker> checker)
+	: checker(std::move(checker))
+	, lang_listener(OPT_SUB("Tool/Spell Checker/Language", [] { checked_words.clear(); }))
+	, dict_path_listener(OPT_SUB("Path/Dictionary", [] { checked_words.clear(); }))
+	{
+	}
+
+	void AddWord(std::string const& word) override {
+		checker->AddWord(word);
+		checked_words.clear();
+	}
+
+	void RemoveWord(std::string const& word) override {
+		checker->RemoveWord(word);
+		checked_words.clear();
+	}
+
+	bool CanAddWord(std::string const& word) override { return checker->CanAddWord(word); }
+	bool CanRemoveWord(std::string const& word) override { return checker->CanRemoveWord(word); }
+
+	bool CheckWord(std::string const& word) override {
+		auto it = checked_words.find(word);
+		if (it == checked_words.end())
+			it = checked_words.emplace(word, checker->CheckWord(word)).first;
+		return it->second;
+	}
+
+	std::vector<std::string> GetSuggestions(std::string const& word) override { return checker->GetSuggestions(word); }
+	std::vector<std::string> GetLanguageList() override { return checker->GetLanguageList(); }
+};
+
+/// Create a spell checker which can be used off the main thread
+/// @return nullptr if the backend can only be used from the main thread
+std::unique_ptr<agi::SpellChecker> CreateThreadSpellChecker() {
+#if defined(WITH_HUNSPELL) && !defined(__APPLE__)
+	return agi::make_unique<HunspellSpellChecker>();
+#else
+	return {};
+#endif
+}
+}
+
 std::unique_ptr<agi::SpellChecker> SpellCheckerFactory::GetSpellChecker() {
 #ifdef __APPLE__
-	return agi::CreateCocoaSpellChecker(OPT_SET("Tool/Spell Checker/Language"));
+	auto checker = agi::CreateCocoaSpellChecker(OPT_SET("Tool/Spell Checker/Language"));
 #elif defined(WITH_HUNSPELL)
-	return agi::make_unique<HunspellSpellChecker>();
+	std::unique_ptr<agi::SpellChecker> checker = agi::make_unique<HunspellSpellChecker>();
 #else
-	return {};
+	std::unique_ptr<agi::SpellChecker> checker;
 #endif
+	if (!checker) return checker;
+	return agi::make_unique<CachingSpellChecker>(std::move(checker));
+}
+
+std::vector<std::string> SpellCheckerFactory::GetMisspelledWords(std::vector<std::string> const& words) {
+	std::vector<std::string> misspelled;
+
+	std::vector<std::string const*> unchecked;
+	for (auto const& word : words) {
+		auto it = checked_words.find(word);
+		if (it == checked_words.end())
+			unchecked.push_back(&word);
+		else if (!it->second)
+			misspelled.push_back(word);
+	}
+	if (unchecked.empty()) return misspelled;
+
+	size_t thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), unchecked.size() / min_words_per_thread);
+
+	// Hunspell isn't thread-safe, so each thread gets its own instance.
+	// They're created here as the constructor subscribes to options.
+	std::vector<std::unique_ptr<agi::SpellChecker>> checkers;
+	if (thread_count > 1) {
+		for (size_t t = 0; t < thread_count; ++t) {
+			checkers.push_back(CreateThreadSpellChecker());
+			if (!checkers.back()) {
+				checkers.clear();
+				break;
+			}
+		}
+	}
+
+	if (checkers.empty()) {
+		auto checker = GetSpellChecker();
+		if (!checker) return misspelled;
+		for (auto word : unchecked) {
+			if (!checker->CheckWord(*word))
+				misspelled.push_back(*word);
+		}
+		return misspelled;
+	}
+
+	// Threads claim a batch of words at a time so that a slow batch doesn't
+	// leave the others idle
+	std::vector<char> results(unchecked.size());
+	std::atomic<size_t> next_batch{0};
+	std::vector<std::exception_ptr> errors(thread_count);
+	auto check_words = [&](size_t t) {
+		try {
+			for (size_t begin; (begin = next_batch.fetch_add(words_per_batch)) < unchecked.size(); ) {
+				size_t end = std::min(begin + words_per_batch, unchecked.size());
+				for (size_t i = begin; i < end; ++i)
+					results[i] = checkers[t]->CheckWord(*unchecked[i]);
+			}
+		}
+		catch (...) {
+			errors[t] = std::current_exception();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < thread_count; ++t)
+		threads.emplace_back(check_words, t);
+	check_words(0);
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto const& error : errors) {
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	for (size_t i = 0; i < unchecked.size(); ++i) {
+		checked_words[*unchecked[i]] = !!results[i];
+		if (!results[i])
+			misspelled.push_back(*unchecked[i]);
+	}
+	return misspelled;
 }
@@ -43,7 +43,16 @@ HunspellSpellChecker::HunspellSpellChecker()
 HunspellSpellChecker::~HunspellSpellChecker() {
 }
 
+void HunspellSpellChecker::FinishLoading() {
+	if (!loading.valid()) return;
+	auto dict = loading.get();
+	hunspell = std::move(dict.hunspell);
+	conv = std::move(dict.conv);
+	rconv = std::move(dict.rconv);
+}
+
 bool HunspellSpellChecker::CanAddWord(std::string const& word) {
+	FinishLoading();
 	if (!hunspell) return false;
 	try {
 		conv->Convert(word);
@@ -59,6 +68,7 @@ bool HunspellSpellChecker::CanRemoveWord(std::string const& word) {
 }
 
 void HunspellSpellChecker::AddWord(std::string const& word) {
+	FinishLoading();
 	if (!hunspell) return;
 
 	// Add it to the in-memory dictionary
@@ -70,6 +80,7 @@ void HunspellSpellChecker::AddWord(std::string const& word) {
 }
 
 void HunspellSpellChecker::RemoveWord(std::string const& word) {
+	FinishLoading();
 	if (!hunspell) return;
 
 	// Remove it from the in-memory dictionary
@@ -118,6 +129,7 @@ void HunspellSpellChecker::WriteUserDictionary() {
 }
 
 bool HunspellSpellChecker::CheckWord(std::string const& word) {
+	FinishLoading();
 	if (!hunspell) return true;
 	try {
 		return hunspell->spell(conv->Convert(word).c_str()) == 1;
@@ -129,6 +141,7 @@ bool HunspellSpellChecker::CheckWord(std::string const& word) {
 
 std::vector<std::string> HunspellSpellChecker::GetSuggestions(std::string const& word) {
 	std::vector<std::string> suggestions;
+	FinishLoading();
 	if (!hunspell) return suggestions;
 
 	char **results;
@@ -181,6 +194,10 @@ static bool check_path(agi::fs::path const& path, std::string const& language, a
 }
 
 void HunspellSpellChecker::OnLanguageChanged() {
+	// Any dictionary still loading for the old language has to be finished
+	// with before it can be replaced
+	if (loading.valid()) loading.wait();
+	loading = std::future<Dictionary>();
 	hunspell.reset();
 
 	auto language = OPT_GET("Tool/Spell Checker/Language")->GetString();
@@ -196,29 +213,34 @@ void HunspellSpellChecker::OnLanguageChanged() {
 
 	LOG_I("dictionary/file") << dic;
 
-#ifdef _WIN32
-	// The prefix makes hunspell assume the paths are UTF-8 and use _wfopen
-	hunspell = agi::make_unique<Hunspell>(("\\\\?\\" + aff.string()).c_str(), ("\\\\?\\" + dic.string()).c_str());
-#else
-	hunspell = agi::make_unique<Hunspell>(aff.string().c_str(), dic.string().c_str());
-#endif
-	if (!hunspell) return;
-
-	conv = agi::make_unique<agi::charset::IconvWrapper>("utf-8", hunspell->get_dic_encoding());
-	rconv = agi::make_unique<agi::charset::IconvWrapper>(hunspell->get_dic_encoding(), "utf-8");
-
 	userDicPath = config::path->Decode("?user/dictionaries")/agi::format("user_%s.dic", language);
 	ReadUserDictionary();
 
-	for (auto const& word : customWords) {
-		try {
-			hunspell->add(conv->Convert(word).c_str());
-		}
-		catch (agi::charset::ConvError const&) {
-			// Normally this shouldn't happen, but some versions of Aegisub
-			// wrote words in the wrong charset
+	// Parsing a dictionary takes long enough to be noticeable, so it's done
+	// on a worker and only waited for once a word actually needs checking
+	auto words = customWords;
+	loading = std::async(std::launch::async, [=] {
+		Dictionary dict;
+#ifdef _WIN32
+		// The prefix makes hunspell assume the paths are UTF-8 and use _wfopen
+		dict.hunspell = agi::make_unique<Hunspell>(("\\\\?\\" + aff.string()).c_str(), ("\\\\?\\" + dic.string()).c_str());
+#else
+		dict.hunspell = agi::make_unique<Hunspell>(aff.string().c_str(), dic.string().c_str());
+#endif
+		dict.conv = agi::make_unique<agi::charset::IconvWrapper>("utf-8", dict.hunspell->get_dic_encoding());
+		dict.rconv = agi::make_unique<agi::charset::IconvWrapper>(dict.hunspell->get_dic_encoding(), "utf-8");
+
+		for (auto const& word : words) {
+			try {
+				dict.hunspell->add(dict.conv->Convert(word).c_str());
+			}
+			catch (agi::charset::ConvError const&) {
+				// Normally this shouldn't happen, but some versions of Aegisub
+				// wrote words in the wrong charset
+			}
 		}
-	}
+		return dict;
+	});
 }
 
 void HunspellSpellChecker::OnPathChanged() {
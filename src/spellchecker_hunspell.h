@@ -26,6 +26,7 @@
 #include <libaegisub/signal.h>
 
 #include <boost/filesystem/path.hpp>
+#include <future>
 #include <memory>
 #include <set>
 
@@ -41,6 +42,17 @@ class HunspellSpellChecker final : public agi::SpellChecker {
 	std::unique_ptr<agi::charset::IconvWrapper> conv;
 	std::unique_ptr<agi::charset::IconvWrapper> rconv;
 
+	/// A dictionary and the conversions for it
+	struct Dictionary {
+		std::unique_ptr<Hunspell> hunspell;
+		std::unique_ptr<agi::charset::IconvWrapper> conv;
+		std::unique_ptr<agi::charset::IconvWrapper> rconv;
+	};
+	/// The dictionary being loaded on a worker thread, if any
+	std::future<Dictionary> loading;
+	/// Wait for the dictionary being loaded, if any, and start using it
+	void FinishLoading();
+
 	/// Languages which we have dictionaries for
 	std::vector<std::string> languages;
 
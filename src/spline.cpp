@@ -39,8 +39,35 @@
 #include <libaegisub/split.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
 #include <limits>
 
+namespace {
+/// Append a point in the format used by ASS drawings
+void AppendPoint(std::string &out, Vector2D pt) {
+	out += std::to_string(static_cast<int>(pt.X()));
+	out += ' ';
+	out += std::to_string(static_cast<int>(pt.Y()));
+}
+
+/// Squared distance from a point to the bounding box of a curve's control
+/// points, which no point on the curve can be closer than
+float BoundsSquareDistance(SplineCurve const& curve, Vector2D ref) {
+	Vector2D min = curve.p1, max = curve.p1;
+	if (curve.type != SplineCurve::POINT) {
+		min = min.Min(curve.p2);
+		max = max.Max(curve.p2);
+	}
+	if (curve.type == SplineCurve::BICUBIC) {
+		min = min.Min(curve.p3).Min(curve.p4);
+		max = max.Max(curve.p3).Max(curve.p4);
+	}
+	float dx = std::max({min.X() - ref.X(), 0.f, ref.X() - max.X()});
+	float dy = std::max({min.Y() - ref.Y(), 0.f, ref.Y() - max.Y()});
+	return dx * dx + dy * dy;
+}
+}
+
 Spline::Spline(const VisualToolBase &tl)
 : coord_translator(tl)
 {
@@ -71,7 +98,7 @@ std::string Spline::EncodeToAss() const {
 					result += "m ";
 					last = 'm';
 				}
-				result += ToScript(pt.p1).DStr(' ');
+				AppendPoint(result, ToScript(pt.p1));
 				break;
 
 			case SplineCurve::LINE:
@@ -79,7 +106,7 @@ std::string Spline::EncodeToAss() const {
 					result += "l ";
 					last = 'l';
 				}
-				result += ToScript(pt.p2).DStr(' ');
+				AppendPoint(result, ToScript(pt.p2));
 				break;
 
 			case SplineCurve::BICUBIC:
@@ -87,9 +114,11 @@ std::string Spline::EncodeToAss() const {
 					result += "b ";
 					last = 'b';
 				}
-				result += ToScript(pt.p2).DStr(' ') + " ";
-				result += ToScript(pt.p3).DStr(' ') + " ";
-				result += ToScript(pt.p4).DStr(' ');
+				AppendPoint(result, ToScript(pt.p2));
+				result += ' ';
+				AppendPoint(result, ToScript(pt.p3));
+				result += ' ';
+				AppendPoint(result, ToScript(pt.p4));
 				break;
 
 			default: break;
@@ -234,13 +263,13 @@ void Spline::GetClosestParametricPoint(Vector2D reference, iterator &curve, floa
 	t = 0.f;
 	if (empty()) return;
 
-	// Close the shape
-	emplace_back(back().EndPoint(), front().p1);
-
 	float closest = std::numeric_limits<float>::infinity();
 	size_t idx = 0;
-	for (size_t i = 0; i < size(); ++i) {
-		auto& cur = (*this)[i];
+	auto check = [&](SplineCurve const& cur, size_t i) {
+		// Most curves of a large spline are nowhere near the reference point,
+		// so skip searching along the ones which can't be any closer
+		if (BoundsSquareDistance(cur, reference) >= closest) return;
+
 		float param = cur.GetClosestParam(reference);
 		Vector2D p1 = cur.GetPoint(param);
 		float dist = (p1-reference).SquareLen();
@@ -250,9 +279,13 @@ void Spline::GetClosestParametricPoint(Vector2D reference, iterator &curve, floa
 			idx = i;
 			pt = p1;
 		}
-	}
+	};
+
+	for (size_t i = 0; i < size(); ++i)
+		check((*this)[i], i);
+	// The line closing the shape, which is reported as end()
+	check(SplineCurve(back().EndPoint(), front().p1), size());
 
-	pop_back();
 	curve = begin() + idx;
 }
 
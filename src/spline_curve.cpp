@@ -35,8 +35,54 @@
 #include "spline_curve.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <limits>
 
+namespace {
+/// Call func(i, point) for the points at t = i / steps along a bicubic curve
+/// for i from 0 to steps
+///
+/// This uses forward differencing, so each point after the first takes six
+/// additions rather than evaluating the whole polynomial. The differences
+/// are accumulated in doubles so that the error doesn't build up noticeably
+/// over the few thousand steps a very long curve can have.
+template<typename Func>
+void ForEachBicubicPoint(Vector2D p1, Vector2D p2, Vector2D p3, Vector2D p4, int steps, Func&& func) {
+	if (steps <= 0) {
+		func(0, p4);
+		return;
+	}
+
+	struct Axis {
+		double f, df, ddf, dddf;
+		Axis(double p1, double p2, double p3, double p4, double h) {
+			double a = p4 - p1 + 3 * (p2 - p3);
+			double b = 3 * (p3 - 2 * p2 + p1);
+			double c = 3 * (p2 - p1);
+			f = p1;
+			df = ((a * h + b) * h + c) * h;
+			ddf = (6 * a * h + 2 * b) * h * h;
+			dddf = 6 * a * h * h * h;
+		}
+		void Step() {
+			f += df;
+			df += ddf;
+			ddf += dddf;
+		}
+	};
+
+	double h = 1.0 / steps;
+	Axis x(p1.X(), p2.X(), p3.X(), p4.X(), h);
+	Axis y(p1.Y(), p2.Y(), p3.Y(), p4.Y(), h);
+	for (int i = 0; i < steps; ++i) {
+		func(i, Vector2D(static_cast<float>(x.f), static_cast<float>(y.f)));
+		x.Step();
+		y.Step();
+	}
+	func(steps, p4);
+}
+}
+
 SplineCurve::SplineCurve(Vector2D p1) : p1(p1), type(POINT) { }
 SplineCurve::SplineCurve(Vector2D p1, Vector2D p2) : p1(p1), p2(p2), type(LINE) { }
 SplineCurve::SplineCurve(Vector2D p1, Vector2D p2, Vector2D p3, Vector2D p4)
@@ -124,18 +170,17 @@ float SplineCurve::GetClosestParam(Vector2D ref) const {
 		return GetClosestSegmentPart(p1, p2, ref);
 
 	if (type == BICUBIC) {
-		int steps = 100;
+		const int steps = 100;
 		float bestDist = std::numeric_limits<float>::max();
-		float bestT = 0.f;
-		for (int i = 0; i <= steps; ++i) {
-			float t = i / float(steps);
-			float dist = (GetPoint(t) - ref).SquareLen();
+		int bestStep = 0;
+		ForEachBicubicPoint(p1, p2, p3, p4, steps, [&](int i, Vector2D p) {
+			float dist = (p - ref).SquareLen();
 			if (dist < bestDist) {
 				bestDist = dist;
-				bestT = t;
+				bestStep = i;
 			}
-		}
-		return bestT;
+		});
+		return bestStep / float(steps);
 	}
 
 	return 0.f;
@@ -184,15 +229,12 @@ int SplineCurve::GetPoints(std::vector<float> &points) const {
 				(p4 - p3).Len());
 			int steps = len/8;
 
-			for (int i = 0; i <= steps; ++i) {
-				// Get t and t-1 (u)
-				float t = i / float(steps);
-				Vector2D p = GetPoint(t);
+			ForEachBicubicPoint(p1, p2, p3, p4, steps, [&](int, Vector2D p) {
 				points.push_back(p.X());
 				points.push_back(p.Y());
-			}
+			});
 
-			return steps + 1;
+			return std::max(steps, 0) + 1;
 		}
 
 		default:
@@ -29,18 +29,123 @@
 #include "options.h"
 #include "project.h"
 #include "selection_controller.h"
+#include "subs_journal.h"
 #include "subtitle_format.h"
 #include "text_selection_controller.h"
 
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
+#include <libaegisub/trace.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
 #include <wx/msgdlg.h>
 
 namespace {
+	/// Average number of lines in each block of an undo state's events
+	const size_t event_block_size = 256;
+	/// Maximum number of lines in a block, for runs of lines without a
+	/// block boundary
+	const size_t max_event_block_size = event_block_size * 4;
+
+	/// Should a block of events end after this line?
+	///
+	/// Blocks end after lines picked by a hash of their ID rather than at
+	/// fixed positions, so that inserting or removing a line only changes the
+	/// block containing it and the following blocks can still be shared.
+	bool ends_block(AssDialogueBase const& line) {
+		return (static_cast<uint32_t>(line.Id) * 2654435761u) >> 24 < 256 / event_block_size;
+	}
+
+	typedef std::vector<AssDialogueBase> EventBlock;
+
+	/// agi::Time compares at centisecond precision, but undo needs to restore
+	/// the exact value
+	bool same_time(agi::Time a, agi::Time b) {
+		return memcmp(&a, &b, sizeof(agi::Time)) == 0;
+	}
+
+	/// Do two lines have the same contents, ignoring their row?
+	bool same_content(AssDialogueBase const& a, AssDialogueBase const& b) {
+		return a.Id == b.Id
+			&& a.Comment == b.Comment
+			&& a.Layer == b.Layer
+			&& a.Margin == b.Margin
+			&& same_time(a.Start, b.Start)
+			&& same_time(a.End, b.End)
+			&& a.Style == b.Style
+			&& a.Actor == b.Actor
+			&& a.Effect == b.Effect
+			&& a.ExtradataIds == b.ExtradataIds
+			&& a.Text == b.Text;
+	}
+
+	bool same_attachment(AssAttachment const& a, AssAttachment const& b) {
+		// Attachment data is interned, so identical attachments share their
+		// data and comparing it byte by byte isn't needed
+		return &a.GetEntryData() == &b.GetEntryData();
+	}
+
+	bool same_style(AssStyle const& a, AssStyle const& b) {
+		return a.GetEntryData() == b.GetEntryData();
+	}
+
+	bool same_extradata(ExtradataEntry const& a, ExtradataEntry const& b) {
+		return a.id == b.id && a.key == b.key && a.value == b.value;
+	}
+
+	/// Get a copy of the items in a section of the file, sharing the previous
+	/// undo state's copy if nothing in the section has changed
+	template<typename T, typename Range, typename Equal>
+	std::shared_ptr<const std::vector<T>> share_section(std::shared_ptr<const std::vector<T>> const& prev, Range const& range, Equal eq) {
+		if (prev && prev->size() == static_cast<size_t>(std::distance(range.begin(), range.end())) && std::equal(prev->begin(), prev->end(), range.begin(), eq))
+			return prev;
+		return std::make_shared<std::vector<T>>(range.begin(), range.end());
+	}
+
+	/// Estimate the memory used by a string which is interned, and so is
+	/// shared by everything with the same value, if it isn't in seen yet
+	size_t interned_usage(std::string const& str, std::unordered_set<const void *>& seen) {
+		if (!seen.insert(&str).second) return 0;
+		// The string and the flyweight factory's node for it
+		return sizeof(str) + str.capacity() + 2 * sizeof(void *);
+	}
+
+	/// Estimate the memory used by the current state of a file, adding its
+	/// interned strings to seen
+	size_t file_usage(AssFile const& file, std::unordered_set<const void *>& seen) {
+		size_t usage = sizeof(file);
+		for (auto const& info : file.Info)
+			usage += sizeof(info) + info.Key().size() + info.Value().size();
+		for (auto const& style : file.Styles)
+			usage += sizeof(style) + style.GetEntryData().size();
+		for (auto const& line : file.Events)
+			usage += sizeof(line) + interned_usage(line.Text.get(), seen);
+		for (auto const& attachment : file.Attachments)
+			usage += sizeof(attachment) + interned_usage(attachment.GetEntryData(), seen);
+		for (auto const& entry : file.Extradata)
+			usage += sizeof(entry) + entry.key.size() + entry.value.size();
+		return usage;
+	}
+
+	/// Number of records after which a journal is restarted from a new
+	/// snapshot, so that replaying it stays fast
+	const size_t max_journal_records = 2000;
+
+	agi::fs::path autosave_directory(const agi::Context *c, agi::fs::path const& filename) {
+		auto directory = c->path->Decode(OPT_GET("Path/Auto/Save")->GetString());
+		if (directory.empty())
+			directory = filename.parent_path();
+		return directory;
+	}
+
 	void autosave_timer_changed(wxTimer *timer) {
 		int freq = OPT_GET("App/Auto/Save Every Seconds")->GetInt();
 		if (freq > 0 && OPT_GET("App/Auto/Save")->GetBool())
@@ -54,37 +159,97 @@ struct SubsController::UndoInfo {
 	wxString undo_description;
 	int commit_id;
 
-	std::vector<std::pair<std::string, std::string>> script_info;
-	std::vector<AssStyle> styles;
-	std::vector<AssDialogueBase> events;
-	std::vector<AssAttachment> attachments;
-	std::vector<ExtradataEntry> extradata;
+	typedef std::pair<std::string, std::string> InfoEntry;
+	/// Script info, styles and extradata are shared with the previous undo
+	/// state when they haven't changed, which is the case for most commits
+	std::shared_ptr<const std::vector<InfoEntry>> script_info;
+	std::shared_ptr<const std::vector<AssStyle>> styles;
+	/// Events in blocks of around event_block_size lines. Most commits only
+	/// change a few lines, so blocks which haven't changed are shared with
+	/// the previous undo state rather than storing a full copy of the file
+	/// for every undo level. The Row of the lines in a shared block may be
+	/// out of date, as rows are renumbered when a state is applied.
+	std::vector<std::shared_ptr<const EventBlock>> events;
+	/// Attachments can be very large, so they are shared in the same way
+	std::shared_ptr<const std::vector<AssAttachment>> attachments;
+	std::shared_ptr<const std::vector<ExtradataEntry>> extradata;
 
 	mutable std::vector<int> selection;
 	int active_line_id = 0;
 	int pos = 0, sel_start = 0, sel_end = 0;
 
-	UndoInfo(const agi::Context *c, wxString const& d, int commit_id)
+	UndoInfo(const agi::Context *c, wxString const& d, int commit_id, UndoInfo const* prev)
 	: undo_description(d)
 	, commit_id(commit_id)
-	, attachments(c->ass->Attachments)
-	, extradata(c->ass->Extradata)
 	{
-		script_info.reserve(c->ass->Info.size());
-		for (auto const& info : c->ass->Info)
-			script_info.emplace_back(info.Key(), info.Value());
+		std::vector<InfoEntry> info;
+		info.reserve(c->ass->Info.size());
+		for (auto const& entry : c->ass->Info)
+			info.emplace_back(entry.Key(), entry.Value());
+		script_info = share_section(prev ? prev->script_info : nullptr, info, [](InfoEntry const& a, InfoEntry const& b) { return a == b; });
+
+		styles = share_section(prev ? prev->styles : nullptr, c->ass->Styles, same_style);
+		attachments = share_section(prev ? prev->attachments : nullptr, c->ass->Attachments, same_attachment);
+		extradata = share_section(prev ? prev->extradata : nullptr, c->ass->Extradata, same_extradata);
+
+		// Blocks of the previous state by the ID of their first line
+		std::unordered_map<int, std::shared_ptr<const EventBlock> const*> prev_blocks;
+		if (prev) {
+			prev_blocks.reserve(prev->events.size());
+			for (auto const& block : prev->events)
+				prev_blocks.emplace(block->front().Id, &block);
+		}
+
+		auto it = c->ass->Events.begin(), end = c->ass->Events.end();
+		while (it != end) {
+			auto block_end = it;
+			size_t count = 0;
+			while (block_end != end && count < max_event_block_size) {
+				++count;
+				if (ends_block(*block_end++)) break;
+			}
 
-		styles.reserve(c->ass->Styles.size());
-		styles.assign(c->ass->Styles.begin(), c->ass->Styles.end());
+			// Reuse the previous state's block if every line is the same
+			auto prev_block = prev_blocks.find(it->Id);
+			if (prev_block != prev_blocks.end()) {
+				auto const& block = **prev_block->second;
+				if (block.size() == count && std::equal(it, block_end, block.begin(), same_content)) {
+					events.push_back(*prev_block->second);
+					it = block_end;
+					continue;
+				}
+			}
 
-		events.reserve(c->ass->Events.size());
-		events.assign(c->ass->Events.begin(), c->ass->Events.end());
+			events.push_back(std::make_shared<EventBlock>(it, block_end));
+			it = block_end;
+		}
 
 		UpdateActiveLine(c);
 		UpdateSelection(c);
 		UpdateTextSelection(c);
 	}
 
+	/// Copy everything but the events to a file
+	void CopySections(AssFile *file) const {
+		for (auto const& info : *script_info)
+			file->Info.emplace_back(info.first, info.second);
+		for (auto const& style : *styles)
+			file->Styles.push_back(*new AssStyle(style));
+		file->Attachments = *attachments;
+		file->Extradata = *extradata;
+	}
+
+	/// Copy this state to an empty file. Undo states are immutable once
+	/// they're no longer the newest state, so this can be called from any
+	/// thread on a copy of the state.
+	void CopyTo(AssFile *file) const {
+		CopySections(file);
+		for (auto const& block : events) {
+			for (auto const& event : *block)
+				file->Events.push_back(*new AssDialogue(event));
+		}
+	}
+
 	void Apply(agi::Context *c) const {
 		// Keep old dialogue lines alive until after the commit is complete
 		// since a bunch of stuff holds references to them
@@ -97,23 +262,38 @@ struct SubsController::UndoInfo {
 
 		sort(begin(selection), end(selection));
 
+		// Lines which are the same in the state being restored are moved
+		// back into the file rather than reallocated, so an undo only has
+		// to create the lines which actually changed
+		std::unordered_map<int, AssDialogue *> current;
+		size_t line_count = 0;
+		for (auto const& block : events)
+			line_count += block->size();
+		current.reserve(line_count);
+		for (auto& line : old.Events)
+			current.emplace(line.Id, &line);
+
 		AssDialogue *active_line = nullptr;
 		Selection new_sel;
 
-		for (auto const& info : script_info)
-			c->ass->Info.push_back(*new AssInfo(info.first, info.second));
-		for (auto const& style : styles)
-			c->ass->Styles.push_back(*new AssStyle(style));
-		c->ass->Attachments = attachments;
-		for (auto const& event : events) {
-			auto copy = new AssDialogue(event);
-			c->ass->Events.push_back(*copy);
-			if (copy->Id == active_line_id)
-				active_line = copy;
-			if (binary_search(begin(selection), end(selection), copy->Id))
-				new_sel.insert(copy);
+		CopySections(c->ass.get());
+		for (auto const& block : events) {
+			for (auto const& event : *block) {
+				AssDialogue *line;
+				auto it = current.find(event.Id);
+				if (it != current.end() && same_content(*it->second, event)) {
+					line = it->second;
+					line->unlink();
+				}
+				else
+					line = new AssDialogue(event);
+				c->ass->Events.push_back(*line);
+				if (line->Id == active_line_id)
+					active_line = line;
+				if (binary_search(begin(selection), end(selection), line->Id))
+					new_sel.insert(line);
+			}
 		}
-		c->ass->Extradata = extradata;
 
 		c->ass->Commit("", AssFile::COMMIT_NEW);
 		c->selectionController->SetSelectionAndActive(std::move(new_sel), active_line);
@@ -122,6 +302,79 @@ struct SubsController::UndoInfo {
 		c->textSelectionController->SetSelection(sel_start, sel_end);
 	}
 
+	/// Get the journal record for the changes from an older state to this one
+	/// @param prev State the journal is currently at
+	/// @param[out] record Record to write, or empty if nothing changed
+	/// @return false if something other than the events changed, so a new
+	///         snapshot is needed instead
+	bool JournalChanges(UndoInfo const& prev, std::string& record) const {
+		if (script_info != prev.script_info || styles != prev.styles || attachments != prev.attachments || extradata != prev.extradata)
+			return false;
+
+		// Skip the blocks at each end which are shared with the previous
+		// state, then find the changed range of lines within the rest
+		size_t first = 0, row = 0;
+		while (first < events.size() && first < prev.events.size() && events[first] == prev.events[first])
+			row += events[first++]->size();
+		size_t last = events.size(), prev_last = prev.events.size();
+		while (last > first && prev_last > first && events[last - 1] == prev.events[prev_last - 1])
+			--last, --prev_last;
+
+		std::vector<AssDialogueBase const*> lines, prev_lines;
+		for (size_t i = first; i < last; ++i) {
+			for (auto const& line : *events[i])
+				lines.push_back(&line);
+		}
+		for (size_t i = first; i < prev_last; ++i) {
+			for (auto const& line : *prev.events[i])
+				prev_lines.push_back(&line);
+		}
+
+		auto same = [](AssDialogueBase const* a, AssDialogueBase const* b) { return same_content(*a, *b); };
+		auto mismatch = std::mismatch(lines.begin(), lines.begin() + std::min(lines.size(), prev_lines.size()), prev_lines.begin(), same);
+		size_t prefix = mismatch.first - lines.begin();
+		size_t suffix = 0;
+		while (suffix < lines.size() - prefix && suffix < prev_lines.size() - prefix && same(lines[lines.size() - suffix - 1], prev_lines[prev_lines.size() - suffix - 1]))
+			++suffix;
+
+		if (prefix == lines.size() && prefix == prev_lines.size())
+			return true;
+
+		lines.erase(lines.end() - suffix, lines.end());
+		lines.erase(lines.begin(), lines.begin() + prefix);
+		record = journal::ReplaceRecord(row + prefix, prev_lines.size() - prefix - suffix, lines);
+		return true;
+	}
+
+	/// Estimate the memory used by this state which isn't shared with any
+	/// of the states already in seen, and add this state's data to seen
+	size_t MemoryUsage(std::unordered_set<const void *>& seen) const {
+		size_t usage = sizeof(*this);
+		if (seen.insert(script_info.get()).second) {
+			for (auto const& info : *script_info)
+				usage += sizeof(info) + info.first.size() + info.second.size();
+		}
+		if (seen.insert(styles.get()).second) {
+			for (auto const& style : *styles)
+				usage += sizeof(style) + style.GetEntryData().size();
+		}
+		for (auto const& block : events) {
+			if (!seen.insert(block.get()).second) continue;
+			usage += block->size() * sizeof(AssDialogueBase);
+			for (auto const& line : *block)
+				usage += interned_usage(line.Text.get(), seen);
+		}
+		if (seen.insert(attachments.get()).second) {
+			for (auto const& attachment : *attachments)
+				usage += sizeof(attachment) + interned_usage(attachment.GetEntryData(), seen);
+		}
+		if (seen.insert(extradata.get()).second) {
+			for (auto const& entry : *extradata)
+				usage += sizeof(entry) + entry.key.size() + entry.value.size();
+		}
+		return usage;
+	}
+
 	void UpdateActiveLine(const agi::Context *c) {
 		auto line = c->selectionController->GetActiveLine();
 		if (line)
@@ -153,11 +406,30 @@ SubsController::SubsController(agi::Context *context)
 	OPT_SUB("App/Auto/Save", [=] { autosave_timer_changed(&autosave_timer); });
 	OPT_SUB("App/Auto/Save Every Seconds", [=] { autosave_timer_changed(&autosave_timer); });
 	autosave_timer.Bind(wxEVT_TIMER, [=](wxTimerEvent&) { AutoSave(); });
+
+	// The memory usage report is made on the main thread, which is the only
+	// one which touches the file and the undo history. Text which the undo
+	// history shares with the file is counted as part of the file.
+	file_memory_registration = agi::memory::Register("Subtitles", [=] {
+		std::unordered_set<const void *> seen;
+		return file_usage(*context->ass, seen);
+	});
+	undo_memory_registration = agi::memory::Register("Undo history", [=] {
+		std::unordered_set<const void *> seen;
+		file_usage(*context->ass, seen);
+		size_t usage = 0;
+		for (auto const& state : undo_stack)
+			usage += state.MemoryUsage(seen);
+		for (auto const& state : redo_stack)
+			usage += state.MemoryUsage(seen);
+		return usage;
+	});
 }
 
 SubsController::~SubsController() {
+	RemoveJournal();
 	// Make sure there are no autosaves in progress
-	autosave_queue->Sync([]{ });
+	autosave_queue->Sync([]{ }, agi::dispatch::Priority::Background);
 }
 
 void SubsController::SetSelectionController(SelectionController *selection_controller) {
@@ -166,6 +438,7 @@ void SubsController::SetSelectionController(SelectionController *selection_contr
 }
 
 ProjectProperties SubsController::Load(agi::fs::path const& filename, std::string charset) {
+	AGI_TRACE_SCOPE("subs/load");
 	AssFile temp;
 
 	SubtitleFormat::GetReader(filename, charset)->ReadFile(&temp, filename, context->project->Timecodes(), charset);
@@ -175,6 +448,8 @@ ProjectProperties SubsController::Load(agi::fs::path const& filename, std::strin
 
 	SetFileName(filename);
 
+	RemoveJournal();
+
 	// Push the initial state of the file onto the undo stack
 	undo_stack.clear();
 	redo_stack.clear();
@@ -212,6 +487,7 @@ void SubsController::Save(agi::fs::path const& filename, std::string const& enco
 		context->path->SetToken("?script", filename.parent_path());
 
 		context->ass->CleanExtradata();
+		AGI_TRACE_SCOPE("subs/save");
 		writer->WriteFile(context->ass.get(), filename, 0, encoding);
 		FileSave();
 	}
@@ -225,6 +501,7 @@ void SubsController::Save(agi::fs::path const& filename, std::string const& enco
 }
 
 void SubsController::Close() {
+	RemoveJournal();
 	undo_stack.clear();
 	redo_stack.clear();
 	autosaved_commit_id = saved_commit_id = commit_id + 1;
@@ -253,25 +530,26 @@ int SubsController::TryToClose(bool allow_cancel) const {
 }
 
 void SubsController::AutoSave() {
-	if (commit_id == autosaved_commit_id)
+	if (commit_id == autosaved_commit_id || undo_stack.empty())
 		return;
 
-	auto directory = context->path->Decode(OPT_GET("Path/Auto/Save")->GetString());
-	if (directory.empty())
-		directory = filename.parent_path();
-
+	auto directory = autosave_directory(context, filename);
 	auto name = filename.filename();
 	if (name.empty())
 		name = "Untitled";
 
 	autosaved_commit_id = commit_id;
 	auto frame = context->frame;
-	auto subs_copy = new AssFile(*context->ass);
-	autosave_queue->Async([subs_copy, name, directory, frame] {
+	// The newest undo state is the current committed state of the file, and
+	// copying it only copies references to its data, so the full copy of
+	// the file can be built on the autosave thread rather than this one
+	auto state = std::make_shared<const UndoInfo>(undo_stack.back());
+	autosave_queue->Async([state, name, directory, frame] {
 		wxString msg;
-		std::unique_ptr<AssFile> subs(subs_copy);
 
 		try {
+			auto subs = agi::make_unique<AssFile>();
+			state->CopyTo(subs.get());
 			agi::fs::CreateDirectory(directory);
 			auto path = directory /  agi::format("%s.%s.AUTOSAVE.ass", name.string(),
 			                                     agi::util::strftime("%Y-%m-%d-%H-%M-%S"));
@@ -288,7 +566,74 @@ void SubsController::AutoSave() {
 		agi::dispatch::Main().Async([frame, msg] {
 			frame->StatusTimeout(msg);
 		});
-	});
+	}, agi::dispatch::Priority::Background);
+}
+
+void SubsController::UpdateJournal() {
+	if (undo_stack.empty() || !OPT_GET("App/Auto/Journal")->GetBool())
+		return;
+
+	auto state = std::make_shared<const UndoInfo>(undo_stack.back());
+	std::string record;
+	bool snapshot = !journaled_state || journal_records >= max_journal_records
+		|| !state->JournalChanges(*journaled_state, record);
+	journaled_state = state;
+
+	if (!snapshot) {
+		if (record.empty()) return;
+		++journal_records;
+		auto path = journal_path;
+		autosave_queue->Async([path, record] {
+			try {
+				journal::Append(path, record);
+			}
+			catch (agi::Exception const& e) {
+				LOG_E("subs/journal") << e.GetMessage();
+			}
+		}, agi::dispatch::Priority::Background);
+		return;
+	}
+
+	journal_records = 0;
+	if (journal_path.empty()) {
+		auto name = filename.filename();
+		if (name.empty())
+			name = "Untitled";
+		journal_path = autosave_directory(context, filename) / agi::format("%s.%s%s", name.string(),
+			agi::util::strftime("%Y-%m-%d-%H-%M-%S"), journal::extension);
+	}
+
+	// The copy of the file is built on the autosave thread for the same
+	// reason as for autosaves
+	auto path = journal_path;
+	autosave_queue->Async([path, state] {
+		try {
+			AssFile subs;
+			state->CopyTo(&subs);
+			agi::fs::CreateDirectory(path.parent_path());
+			journal::WriteSnapshot(subs, path);
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("subs/journal") << e.GetMessage();
+		}
+	}, agi::dispatch::Priority::Background);
+}
+
+void SubsController::RemoveJournal() {
+	journaled_state.reset();
+	journal_records = 0;
+	if (journal_path.empty()) return;
+
+	auto path = journal_path;
+	journal_path.clear();
+	autosave_queue->Async([path] {
+		try {
+			agi::fs::Remove(path);
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("subs/journal") << e.GetMessage();
+		}
+	}, agi::dispatch::Priority::Background);
 }
 
 bool SubsController::CanSave() const {
@@ -316,13 +661,38 @@ void SubsController::OnCommit(AssFileCommit c) {
 	if (commit_id == *c.commit_id+1 && redo_stack.empty() && saved_commit_id+1 != commit_id) {
 		// If only one line changed just modify it instead of copying the file
 		if (c.single_line && c.single_line->Group() == AssEntryGroup::DIALOGUE) {
-			for (auto& diag : undo_stack.back().events) {
-				if (diag.Id == c.single_line->Id) {
-					diag = *c.single_line;
-					break;
+			auto& events = undo_stack.back().events;
+			// Blocks may be shared with older undo states, so replace the
+			// block containing the line with an updated copy
+			auto replace = [&](size_t block, size_t index) {
+				auto copy = std::make_shared<EventBlock>(*events[block]);
+				(*copy)[index] = *c.single_line;
+				events[block] = std::move(copy);
+			};
+
+			// Lines haven't been added, removed or reordered since the last
+			// commit, so the line should be at its row in the undo state.
+			// Checking the ID avoids a search through the whole file on
+			// every keystroke in the edit box.
+			size_t block = 0, index = static_cast<size_t>(c.single_line->Row);
+			while (block < events.size() && index >= events[block]->size())
+				index -= events[block++]->size();
+			if (block < events.size() && (*events[block])[index].Id == c.single_line->Id)
+				replace(block, index);
+			else {
+				bool found = false;
+				for (block = 0; block < events.size() && !found; ++block) {
+					for (index = 0; index < events[block]->size(); ++index) {
+						if ((*events[block])[index].Id == c.single_line->Id) {
+							replace(block, index);
+							found = true;
+							break;
+						}
+					}
 				}
 			}
 			*c.commit_id = commit_id;
+			UpdateJournal();
 			return;
 		}
 
@@ -339,16 +709,31 @@ void SubsController::OnCommit(AssFileCommit c) {
 
 	redo_stack.clear();
 
-	undo_stack.emplace_back(context, c.message, commit_id);
+	undo_stack.emplace_back(context, c.message, commit_id, undo_stack.empty() ? nullptr : &undo_stack.back());
 
 	int depth = std::max<int>(OPT_GET("Limits/Undo Levels")->GetInt(), 2);
 	while ((int)undo_stack.size() > depth)
 		undo_stack.pop_front();
 
+	// Drop the oldest states once the history goes over the memory limit,
+	// counting data shared between states only once
+	size_t memory_limit = static_cast<size_t>(OPT_GET("Limits/Undo Memory")->GetInt()) << 20;
+	if (memory_limit && undo_stack.size() > 2) {
+		std::unordered_set<const void *> seen;
+		size_t usage = 0, kept = 0;
+		for (auto it = undo_stack.rbegin(); it != undo_stack.rend(); ++it, ++kept) {
+			usage += it->MemoryUsage(seen);
+			if (usage > memory_limit && kept >= 2) break;
+		}
+		while (undo_stack.size() > kept)
+			undo_stack.pop_front();
+	}
+
 	if (undo_stack.size() > 1 && OPT_GET("App/Auto/Save on Every Change")->GetBool() && !filename.empty() && CanSave())
 		Save(filename);
 
 	*c.commit_id = commit_id;
+	UpdateJournal();
 }
 
 void SubsController::OnActiveLineChanged() {
@@ -375,6 +760,7 @@ void SubsController::Undo() {
 	text_selection_connection.Block();
 	undo_stack.back().Apply(context);
 	text_selection_connection.Unblock();
+	UpdateJournal();
 }
 
 void SubsController::Redo() {
@@ -386,6 +772,7 @@ void SubsController::Redo() {
 	text_selection_connection.Block();
 	undo_stack.back().Apply(context);
 	text_selection_connection.Unblock();
+	UpdateJournal();
 }
 
 wxString SubsController::GetUndoDescription() const {
@@ -15,10 +15,12 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include <libaegisub/fs_fwd.h>
+#include <libaegisub/memory_usage.h>
 #include <libaegisub/signal.h>
 
 #include <boost/container/list.hpp>
 #include <boost/filesystem/path.hpp>
+#include <memory>
 #include <wx/timer.h>
 
 class SelectionController;
@@ -59,6 +61,16 @@ class SubsController {
 	/// Queue which autosaves are performed on
 	std::unique_ptr<agi::dispatch::Queue> autosave_queue;
 
+	/// Crash recovery journal for the open file, if one has been started
+	agi::fs::path journal_path;
+	/// The state of the file as of the last write to the journal
+	std::shared_ptr<const UndoInfo> journaled_state;
+	/// Number of records written to the journal since its last snapshot
+	size_t journal_records = 0;
+
+	agi::memory::Registration file_memory_registration;
+	agi::memory::Registration undo_memory_registration;
+
 	/// A new file has been opened (filename)
 	agi::signal::Signal<agi::fs::path> FileOpen;
 	/// The file has been saved
@@ -73,6 +85,11 @@ class SubsController {
 	/// Autosave the file if there have been any chances since the last autosave
 	void AutoSave();
 
+	/// Write the changes made since the last call to the journal
+	void UpdateJournal();
+	/// Delete the journal, as the file it's for has been closed
+	void RemoveJournal();
+
 	void OnCommit(AssFileCommit c);
 	void OnActiveLineChanged();
 	void OnSelectionChanged();
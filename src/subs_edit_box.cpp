@@ -370,10 +370,10 @@ void SubsEditBox::UpdateFields(int type, bool repopulate_lists) {
 	}
 }
 
-void SubsEditBox::PopulateList(wxComboBox *combo, boost::flyweight<std::string> AssDialogue::*field) {
+void SubsEditBox::PopulateList(wxComboBox *combo, FlyweightString AssDialogue::*field) {
 	wxEventBlocker blocker(this);
 
-	std::unordered_set<boost::flyweight<std::string>> values;
+	std::unordered_set<FlyweightString> values;
 	for (auto const& line : c->ass->Events) {
 		auto const& value = line.*field;
 		if (!value.get().empty())
@@ -443,9 +443,9 @@ void SubsEditBox::OnChange(wxStyledTextEvent &event) {
 	}
 }
 
-void SubsEditBox::Commit(wxString const& desc, int type, bool amend, AssDialogue *line) {
+void SubsEditBox::Commit(wxString const& desc, int type, bool amend, std::vector<AssDialogue *> const& lines) {
 	file_changed_slot.Block();
-	commit_id = c->ass->Commit(desc, type, (amend && desc == last_commit_type) ? commit_id : -1, line);
+	commit_id = c->ass->Commit(desc, type, (amend && desc == last_commit_type) ? commit_id : -1, lines);
 	file_changed_slot.Unblock();
 	last_commit_type = desc;
 	last_time_commit_type = -1;
@@ -457,7 +457,7 @@ template<class setter>
 void SubsEditBox::SetSelectedRows(setter set, wxString const& desc, int type, bool amend) {
 	auto const& sel = c->selectionController->GetSelectedSet();
 	for_each(sel.begin(), sel.end(), set);
-	Commit(desc, type, amend, sel.size() == 1 ? *sel.begin() : nullptr);
+	Commit(desc, type, amend, std::vector<AssDialogue *>(sel.begin(), sel.end()));
 }
 
 template<class T>
@@ -467,13 +467,13 @@ void SubsEditBox::SetSelectedRows(T AssDialogueBase::*field, T value, wxString c
 
 template<class T>
 void SubsEditBox::SetSelectedRows(T AssDialogueBase::*field, wxString const& value, wxString const& desc, int type, bool amend) {
-	boost::flyweight<std::string> conv_value(from_wx(value));
+	FlyweightString conv_value(from_wx(value));
 	SetSelectedRows([&](AssDialogue *d) { d->*field = conv_value; }, desc, type, amend);
 }
 
 void SubsEditBox::CommitText(wxString const& desc) {
 	auto data = edit_ctrl->GetTextRaw();
-	SetSelectedRows(&AssDialogue::Text, boost::flyweight<std::string>(data.data(), data.length()), desc, AssFile::COMMIT_DIAG_TEXT, true);
+	SetSelectedRows(&AssDialogue::Text, FlyweightString(data.data(), data.length()), desc, AssFile::COMMIT_DIAG_TEXT, true);
 }
 
 void SubsEditBox::CommitTimes(TimeField field) {
@@ -516,7 +516,7 @@ void SubsEditBox::CommitTimes(TimeField field) {
 
 	last_time_commit_type = field;
 	file_changed_slot.Block();
-	commit_id = c->ass->Commit(_("modify times"), AssFile::COMMIT_DIAG_TIME, commit_id, sel.size() == 1 ? *sel.begin() : nullptr);
+	commit_id = c->ass->Commit(_("modify times"), AssFile::COMMIT_DIAG_TIME, commit_id, std::vector<AssDialogue *>(sel.begin(), sel.end()));
 	file_changed_slot.Unblock();
 }
 
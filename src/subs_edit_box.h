@@ -27,9 +27,10 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include "flyweight_string.h"
+
 #include <array>
 #include <boost/container/map.hpp>
-#include <boost/flyweight/flyweight_fwd.hpp>
 #include <vector>
 
 #include <wx/combobox.h>
@@ -113,7 +114,7 @@ class SubsEditBox final : public wxPanel {
 	/// @brief Commits the current edit box contents
 	/// @param desc Undo description to use
 	void CommitText(wxString const& desc);
-	void Commit(wxString const& desc, int type, bool amend, AssDialogue *line);
+	void Commit(wxString const& desc, int type, bool amend, std::vector<AssDialogue *> const& lines);
 
 	/// Last commit ID for undo coalescing
 	int commit_id = -1;
@@ -185,7 +186,7 @@ class SubsEditBox final : public wxPanel {
 	void UpdateFields(int type, bool repopulate_lists);
 
 	/// Regenerate a dropdown list with the unique values of a dialogue field
-	void PopulateList(wxComboBox *combo, boost::flyweight<std::string> AssDialogue::*field);
+	void PopulateList(wxComboBox *combo, FlyweightString AssDialogue::*field);
 
 	/// @brief Enable or disable frame timing mode
 	void UpdateFrameTiming(agi::vfr::Framerate const& fps);
@@ -47,8 +47,10 @@
 #include <libaegisub/make_unique.h>
 #include <libaegisub/spellchecker.h>
 
+#include <algorithm>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <chrono>
 #include <functional>
 
 #include <wx/clipbrd.h>
@@ -124,7 +126,7 @@ SubsTextEditCtrl::SubsTextEditCtrl(wxWindow* parent, wxSize wsize, long style, a
 	}
 
 	Bind(wxEVT_CONTEXT_MENU, &SubsTextEditCtrl::OnContextMenu, this);
-	Bind(wxEVT_IDLE, std::bind(&SubsTextEditCtrl::UpdateCallTip, this));
+	Bind(wxEVT_IDLE, &SubsTextEditCtrl::OnIdle, this);
 	Bind(wxEVT_STC_DOUBLECLICK, &SubsTextEditCtrl::OnDoubleClick, this);
 	Bind(wxEVT_STC_STYLENEEDED, [=](wxStyledTextEvent&) {
 		{
@@ -265,30 +267,85 @@ void SubsTextEditCtrl::UpdateStyle() {
 	cursor_pos = -1;
 	UpdateCallTip();
 
-	StartStyling(0,255);
+	unchecked_words.clear();
 
-	if (!OPT_GET("Subtitle/Highlight/Syntax")->GetBool()) {
-		SetStyling(line_text.size(), 0);
-		return;
+	// Misspellings are marked when idle rather than here so that checking
+	// words not yet in the spell checker's cache doesn't hold up typing
+	std::vector<char> styles(line_text.size(), 0);
+	if (OPT_GET("Subtitle/Highlight/Syntax")->GetBool() && !line_text.empty()) {
+		size_t pos = 0;
+		for (auto const& style_range : agi::ass::SyntaxHighlight(line_text, tokenized_line, nullptr)) {
+			std::fill_n(styles.begin() + pos, style_range.length, static_cast<char>(style_range.type));
+			pos += style_range.length;
+		}
+	}
+
+	// Only restyle the range which has actually changed, as restyling and
+	// redrawing all of a line with a large drawing on every keypress makes
+	// typing very slow. Drawings are a single range, so their bodies only
+	// need restyling when they're edited.
+	auto current = GetStyledText(0, line_text.size());
+	auto current_style = [&](size_t i) -> char {
+		return 2 * i + 1 < current.GetDataLen() ? static_cast<const char *>(current.GetData())[2 * i + 1] : 0;
+	};
+
+	size_t changed_begin = 0, changed_end = styles.size();
+	while (changed_begin < changed_end && styles[changed_begin] == current_style(changed_begin)) ++changed_begin;
+	while (changed_end > changed_begin && styles[changed_end - 1] == current_style(changed_end - 1)) --changed_end;
+
+	if (changed_begin < changed_end) {
+		StartStyling(changed_begin, 255);
+		for (size_t i = changed_begin; i < changed_end; ) {
+			size_t run = i + 1;
+			while (run < changed_end && styles[run] == styles[i]) ++run;
+			SetStyling(run - i, styles[i]);
+			i = run;
+		}
 	}
+	// Mark the rest of the line as styled so that Scintilla doesn't keep
+	// asking for it to be styled
+	StartStyling(line_text.size(), 255);
 
-	if (line_text.empty()) return;
+	if (!OPT_GET("Subtitle/Highlight/Syntax")->GetBool() || line_text.empty()) return;
 
 	SetIndicatorCurrent(0);
+	IndicatorClearRange(0, line_text.size());
+
+	if (!spellchecker) return;
 	size_t pos = 0;
-	for (auto const& style_range : agi::ass::SyntaxHighlight(line_text, tokenized_line, spellchecker.get())) {
-		if (style_range.type == agi::ass::SyntaxStyle::SPELLING) {
-			SetStyling(style_range.length, agi::ass::SyntaxStyle::NORMAL);
-			IndicatorFillRange(pos, style_range.length);
-		}
-		else {
-			SetStyling(style_range.length, style_range.type);
-			IndicatorClearRange(pos, style_range.length);
+	for (auto const& tok : tokenized_line) {
+		if (tok.type == agi::ass::DialogueTokenType::WORD)
+			unchecked_words.emplace_back(pos, tok.length);
+		pos += tok.length;
+	}
+	std::reverse(begin(unchecked_words), end(unchecked_words));
+}
+
+void SubsTextEditCtrl::CheckSpelling(wxIdleEvent &event) {
+	if (unchecked_words.empty()) return;
+
+	using namespace std::chrono;
+	const auto deadline = steady_clock::now() + milliseconds(10);
+
+	SetIndicatorCurrent(0);
+	while (!unchecked_words.empty()) {
+		auto word = unchecked_words.back();
+		unchecked_words.pop_back();
+		if (!spellchecker->CheckWord(line_text.substr(word.first, word.second)))
+			IndicatorFillRange(word.first, word.second);
+
+		if (!unchecked_words.empty() && steady_clock::now() > deadline) {
+			event.RequestMore();
+			break;
 		}
-		pos += style_range.length;
 	}
 }
 
+void SubsTextEditCtrl::OnIdle(wxIdleEvent &event) {
+	UpdateCallTip();
+	CheckSpelling(event);
+}
+
 void SubsTextEditCtrl::UpdateCallTip() {
 	if (!OPT_GET("App/Call Tips")->GetBool()) return;
 
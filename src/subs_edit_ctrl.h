@@ -80,6 +80,10 @@ class SubsTextEditCtrl final : public wxStyledTextCtrl {
 	/// Tokenized version of line_text
 	std::vector<agi::ass::DialogueToken> tokenized_line;
 
+	/// Start and length of the words in line_text which still need to be
+	/// spell checked, in reverse order
+	std::vector<std::pair<size_t, size_t>> unchecked_words;
+
 	void OnContextMenu(wxContextMenuEvent &);
 	void OnDoubleClick(wxStyledTextEvent&);
 	void OnUseSuggestion(wxCommandEvent &event);
@@ -87,11 +91,15 @@ class SubsTextEditCtrl final : public wxStyledTextCtrl {
 	void OnSetThesLanguage(wxCommandEvent &event);
 	void OnLoseFocus(wxFocusEvent &event);
 	void OnKeyDown(wxKeyEvent &event);
+	void OnIdle(wxIdleEvent &event);
 
 	void SetSyntaxStyle(int id, wxFont &font, std::string const& name, wxColor const& default_background);
 	void Subscribe(std::string const& name);
 
 	void StyleSpellCheck();
+	/// Mark misspellings in the words which haven't been checked yet, for
+	/// as long as the control can spare
+	void CheckSpelling(wxIdleEvent &event);
 	void UpdateCallTip();
 	void SetStyles();
 
@@ -0,0 +1,184 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "subs_journal.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "ass_parser.h"
+#include "subtitle_format_ass.h"
+
+#include <libaegisub/file_mapping.h>
+#include <libaegisub/fs.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/lexical_cast.hpp>
+#include <cstring>
+#include <memory>
+
+namespace {
+/// Line separating the snapshot from the records
+const char journal_header[] = "[Aegisub Journal]";
+
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/// A replace record which has been read, but not necessarily all of the
+/// lines for it
+struct Record {
+	size_t row = 0;
+	size_t removed = 0;
+	size_t added = 0;
+	std::vector<AssDialogue *> lines;
+
+	~Record() {
+		for (auto line : lines) delete line;
+	}
+
+	/// Parse the header of a record
+	/// @return Was it a valid header?
+	bool Parse(std::string const& data) {
+		std::string fields = data.substr(strlen("Replace:"));
+		size_t first = fields.find(','), second = fields.find(',', first + 1);
+		if (first == std::string::npos || second == std::string::npos) return false;
+
+		try {
+			row = boost::lexical_cast<size_t>(boost::trim_copy(fields.substr(0, first)));
+			removed = boost::lexical_cast<size_t>(boost::trim_copy(fields.substr(first + 1, second - first - 1)));
+			added = boost::lexical_cast<size_t>(boost::trim_copy(fields.substr(second + 1)));
+		}
+		catch (boost::bad_lexical_cast const&) {
+			return false;
+		}
+		return true;
+	}
+
+	/// Apply the record to the events
+	/// @return false if the record doesn't fit the events, meaning that
+	///         something has gone wrong and nothing after it can be trusted
+	bool Apply(std::vector<AssDialogue *>& events) {
+		if (lines.size() != added || row > events.size() || removed > events.size() - row)
+			return false;
+
+		for (size_t i = row; i < row + removed; ++i)
+			delete events[i];
+		events.erase(events.begin() + row, events.begin() + row + removed);
+		events.insert(events.begin() + row, lines.begin(), lines.end());
+		lines.clear();
+		return true;
+	}
+};
+}
+
+namespace journal {
+const char *const extension = ".JOURNAL";
+
+void WriteSnapshot(AssFile const& file, agi::fs::path const& path) {
+	AssSubtitleFormat().WriteFile(&file, path, 0, "UTF-8");
+	Append(path, std::string(journal_header) + "\n");
+}
+
+std::string ReplaceRecord(size_t row, size_t removed, std::vector<AssDialogueBase const*> const& added) {
+	std::string record = "Replace: " + std::to_string(row) + "," + std::to_string(removed) + "," + std::to_string(added.size()) + "\n";
+	for (auto line : added) {
+		AssDialogue(*line).AppendEntryData(record);
+		record += '\n';
+	}
+	// Records without an end line were cut off part way through writing them
+	record += "End\n";
+	return record;
+}
+
+void Append(agi::fs::path const& path, std::string const& records) {
+	boost::filesystem::ofstream file(path, std::ios::app | std::ios::binary);
+	file.write(records.data(), records.size());
+	file.flush();
+	if (!file.good())
+		throw agi::fs::WriteDenied(path);
+}
+
+void Replay(agi::fs::path const& path, AssFile *target) {
+	agi::read_file_mapping file(path);
+	const char *data = file.size() ? file.read() : "";
+	const char *const data_end = data + file.size();
+
+	std::unique_ptr<AssParser> parser(new AssParser(target, 1));
+	std::vector<AssDialogue *> events;
+	std::unique_ptr<Record> record;
+
+	while (data < data_end) {
+		const char *eol = static_cast<const char *>(memchr(data, '\n', data_end - data));
+		if (!eol) eol = data_end;
+
+		const char *begin = data, *end = eol;
+		data = eol == data_end ? eol : eol + 1;
+
+		while (begin < end && is_space(*begin)) ++begin;
+		while (end > begin && is_space(end[-1])) --end;
+		if (end - begin >= 3 && !memcmp(begin, "\xEF\xBB\xBF", 3))
+			begin += 3;
+		std::string line(begin, end);
+
+		// Snapshot
+		if (parser) {
+			if (line != journal_header) {
+				parser->AddLine(line);
+				continue;
+			}
+
+			parser.reset();
+			for (auto& event : target->Events)
+				events.push_back(&event);
+			for (auto event : events)
+				event->unlink();
+			continue;
+		}
+
+		// Records
+		if (boost::starts_with(line, "Replace:")) {
+			record.reset(new Record);
+			if (!record->Parse(line))
+				break;
+		}
+		else if (!record)
+			break;
+		else if (line == "End") {
+			if (!record->Apply(events))
+				break;
+			record.reset();
+		}
+		else if (record->lines.size() < record->added) {
+			try {
+				record->lines.push_back(new AssDialogue(line));
+			}
+			catch (agi::Exception const&) {
+				break;
+			}
+		}
+		else
+			break;
+	}
+
+	// A journal which ends inside the snapshot has nothing to replay
+	if (parser) return;
+
+	for (auto event : events)
+		target->Events.push_back(*event);
+}
+}
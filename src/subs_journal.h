@@ -0,0 +1,60 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <string>
+#include <vector>
+
+class AssFile;
+struct AssDialogueBase;
+
+/// @file subs_journal.h
+/// @brief Crash recovery journal of the changes made to the open file
+///
+/// A journal starts with a snapshot of the file in ASS format, followed by
+/// records which each replace a range of rows in the events. Records are
+/// appended as the file is edited, so after a crash the file can be
+/// recovered up to the last commit without waiting for the next autosave.
+/// Anything other than a change to the events is journaled by starting over
+/// with a new snapshot.
+namespace journal {
+	/// Suffix of the names of journal files
+	extern const char *const extension;
+
+	/// Write the snapshot which starts a journal, replacing the file if it exists
+	/// @param file File to write
+	/// @param path Path to write the journal to
+	void WriteSnapshot(AssFile const& file, agi::fs::path const& path);
+
+	/// Format a record which replaces a range of rows of the events
+	/// @param row First row to replace
+	/// @param removed Number of rows to remove
+	/// @param added Lines to insert in their place
+	std::string ReplaceRecord(size_t row, size_t removed, std::vector<AssDialogueBase const*> const& added);
+
+	/// Append records to a journal
+	void Append(agi::fs::path const& path, std::string const& records);
+
+	/// Rebuild a file from a journal
+	///
+	/// Records cut off by a crash part way through writing them are ignored.
+	/// @param path Journal to read
+	/// @param target Empty file to fill
+	void Replay(agi::fs::path const& path, AssFile *target);
+}
@@ -38,20 +38,90 @@
 #include "dialog_progress.h"
 #include "subs_preview.h"
 #include "include/aegisub/subtitles_provider.h"
+#include "options.h"
 #include "video_frame.h"
 #include "video_provider_dummy.h"
 
+#include <libaegisub/background_runner.h>
+#include <libaegisub/exception.h>
 #include <libaegisub/make_unique.h>
 
 #include <wx/dcclient.h>
 #include <wx/msgdlg.h>
 
+/// A subtitles provider for previews, which shows the progress of anything
+/// slow it has to do in whichever preview is currently using it
+class PreviewRenderer final : public agi::BackgroundRunner {
+public:
+	std::unique_ptr<SubtitlesProvider> provider;
+	/// Runner of the preview using this, or nullptr while it's in the pool
+	agi::BackgroundRunner *progress = nullptr;
+
+	void Run(std::function<void(agi::ProgressSink *)> task) override {
+		if (!progress)
+			throw agi::UserCancelException("Preview was closed");
+		progress->Run(std::move(task));
+	}
+};
+
+namespace {
+/// Number of previews which have their renderer kept for the next ones
+const size_t max_pooled_renderers = 2;
+/// Minimum time between renders while the style is being changed, in
+/// milliseconds, as dragging a spin control changes it far more often than
+/// the screen refreshes
+const int render_interval = 16;
+
+struct RendererPool {
+	/// Subtitle provider option when the pooled renderers were created
+	std::string provider_name;
+	std::vector<std::unique_ptr<PreviewRenderer>> idle;
+};
+
+RendererPool& renderer_pool() {
+	// Never destroyed, as the providers can't be torn down once the
+	// libraries they use have been
+	static RendererPool *pool = new RendererPool;
+	return *pool;
+}
+
+/// Get a renderer from the pool, or make a new one if it's empty
+std::unique_ptr<PreviewRenderer> acquire_renderer(agi::BackgroundRunner *progress) {
+	auto& pool = renderer_pool();
+	auto name = OPT_GET("Subtitle/Provider")->GetString();
+	if (name != pool.provider_name) {
+		pool.idle.clear();
+		pool.provider_name = name;
+	}
+
+	std::unique_ptr<PreviewRenderer> renderer;
+	if (!pool.idle.empty()) {
+		renderer = std::move(pool.idle.back());
+		pool.idle.pop_back();
+	}
+	else
+		renderer = agi::make_unique<PreviewRenderer>();
+	renderer->progress = progress;
+	if (!renderer->provider)
+		renderer->provider = SubtitlesProviderFactory::GetProvider(renderer.get());
+	return renderer;
+}
+
+void release_renderer(std::unique_ptr<PreviewRenderer> renderer) {
+	renderer->progress = nullptr;
+	auto& pool = renderer_pool();
+	if (pool.provider_name == OPT_GET("Subtitle/Provider")->GetString() && pool.idle.size() < max_pooled_renderers)
+		pool.idle.push_back(std::move(renderer));
+}
+}
+
 SubtitlesPreview::SubtitlesPreview(wxWindow *parent, wxSize size, int winStyle, agi::Color col)
 : wxWindow(parent, -1, wxDefaultPosition, size, winStyle)
 , style(new AssStyle)
 , back_color(col)
 , sub_file(agi::make_unique<AssFile>())
 , line(new AssDialogue)
+, render_timer(this)
 {
 	line->Text = "{\\q2}preview";
 
@@ -68,28 +138,32 @@ SubtitlesPreview::SubtitlesPreview(wxWindow *parent, wxSize size, int winStyle,
 
 	Bind(wxEVT_PAINT, &SubtitlesPreview::OnPaint, this);
 	Bind(wxEVT_SIZE, &SubtitlesPreview::OnSize, this);
+	Bind(wxEVT_TIMER, [=](wxTimerEvent&) { UpdateBitmap(); });
 }
 
 SubtitlesPreview::~SubtitlesPreview() {
+	if (renderer)
+		release_renderer(std::move(renderer));
 }
 
 void SubtitlesPreview::SetStyle(AssStyle const& new_style) {
-	if (provider && style->font != new_style.font)
-		provider->Reinitialize();
+	if (renderer && style->font != new_style.font)
+		renderer->provider->Reinitialize();
 
 	*style = new_style;
 	style->name = "Default";
 	style->alignment = 5;
 	std::fill(style->Margin.begin(), style->Margin.end(), 0);
 	style->UpdateData();
-	UpdateBitmap();
+	subs_loaded = false;
+	QueueUpdate();
 }
 
 void SubtitlesPreview::SetText(std::string const& text) {
 	std::string new_text = "{\\q2}" + text;
 	if (new_text != line->Text) {
 		line->Text = new_text;
-		UpdateBitmap();
+		QueueUpdate();
 	}
 }
 
@@ -97,22 +171,38 @@ void SubtitlesPreview::SetColour(agi::Color col) {
 	if (col != back_color) {
 		back_color = col;
 		vid = agi::make_unique<DummyVideoProvider>(0.0, 10, bmp->GetWidth(), bmp->GetHeight(), back_color, true);
-		UpdateBitmap();
+		QueueUpdate();
 	}
 }
 
+void SubtitlesPreview::QueueUpdate() {
+	if (!render_timer.IsRunning())
+		render_timer.Start(render_interval, wxTIMER_ONE_SHOT);
+}
+
 void SubtitlesPreview::UpdateBitmap() {
+	render_timer.Stop();
 	if (!vid) return;
 
 	VideoFrame frame;
 	vid->GetFrame(0, frame);
 
-	if (provider) {
+	if (renderer) {
+		auto provider = renderer->provider.get();
 		try {
-			provider->LoadSubtitles(sub_file.get());
+			// The preview is for picking fonts, so it has to wait for them
+			provider->WaitUntilReady();
+			// Changing the text only changes the one line, so there's no
+			// need to parse the styles again
+			if (!subs_loaded || !provider->UpdateLine(0, *line)) {
+				provider->LoadSubtitles(sub_file.get());
+				subs_loaded = true;
+			}
 			provider->DrawSubtitles(frame, 0.1);
 		}
-		catch (...) { }
+		catch (...) {
+			subs_loaded = false;
+		}
 	}
 
 	// Convert frame to bitmap
@@ -135,8 +225,8 @@ void SubtitlesPreview::OnSize(wxSizeEvent &evt) {
 	try {
 		if (!progress)
 			progress = agi::make_unique<DialogProgress>(this);
-		if (!provider)
-			provider = SubtitlesProviderFactory::GetProvider(progress.get());
+		if (!renderer)
+			renderer = acquire_renderer(progress.get());
 	}
 	catch (...) {
 		wxMessageBox(
@@ -147,6 +237,7 @@ void SubtitlesPreview::OnSize(wxSizeEvent &evt) {
 
 	sub_file->SetScriptInfo("PlayResX", std::to_string(w));
 	sub_file->SetScriptInfo("PlayResY", std::to_string(h));
+	subs_loaded = false;
 
 	UpdateBitmap();
 }
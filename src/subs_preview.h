@@ -35,17 +35,19 @@
 #include <memory>
 #include <wx/window.h>
 #include <wx/bitmap.h>
+#include <wx/timer.h>
 
 class AssFile;
 class AssStyle;
 class DialogProgress;
-class SubtitlesProvider;
+class PreviewRenderer;
 class VideoProvider;
 
 /// Preview window to show a short string with a given ass style
 class SubtitlesPreview final : public wxWindow {
-	/// The subtitle provider used to render the string
-	std::unique_ptr<SubtitlesProvider> provider;
+	/// The subtitle provider used to render the string, which is borrowed
+	/// from a pool shared by all previews
+	std::unique_ptr<PreviewRenderer> renderer;
 	/// Bitmap to render into
 	std::unique_ptr<wxBitmap> bmp;
 	/// The currently display style
@@ -58,11 +60,18 @@ class SubtitlesPreview final : public wxWindow {
 	std::unique_ptr<AssFile> sub_file;
 	/// Line used to render the specified text
 	AssDialogue* line;
+	/// Has the provider been given the current version of sub_file? If so,
+	/// only the line has to be updated when the text changes.
+	bool subs_loaded = false;
+	/// Timer for rendering the changes made since the last render
+	wxTimer render_timer;
 
 	std::unique_ptr<DialogProgress> progress;
 
 	/// Regenerate the bitmap
 	void UpdateBitmap();
+	/// Regenerate the bitmap soon, along with any other changes made before then
+	void QueueUpdate();
 	/// Resize event handler
 	void OnSize(wxSizeEvent &event);
 	/// Paint event handler
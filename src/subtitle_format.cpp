@@ -49,6 +49,7 @@
 #include "subtitle_format_ttxt.h"
 #include "subtitle_format_txt.h"
 
+#include <libaegisub/ass/overlaps.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/vfr.h>
@@ -56,10 +57,28 @@
 #include <algorithm>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <wx/app.h>
 #include <wx/choicdlg.h>
 
 namespace {
 	std::vector<std::unique_ptr<SubtitleFormat>> formats;
+
+	/// Text of the lines visible in a piece, stacked with the last line on top
+	template<typename Line>
+	std::string StackedText(std::vector<Line *> const& lines, agi::ass::OverlapPiece const& piece) {
+		size_t size = 0;
+		for (size_t i : piece.lines)
+			size += lines[i]->Text.get().size() + 2;
+
+		std::string text;
+		text.reserve(size);
+		for (auto it = piece.lines.rbegin(); it != piece.lines.rend(); ++it) {
+			if (it != piece.lines.rbegin())
+				text += "\\N";
+			text += lines[*it]->Text.get();
+		}
+		return text;
+	}
 }
 
 SubtitleFormat::SubtitleFormat(std::string name)
@@ -83,7 +102,7 @@ bool SubtitleFormat::CanSave(const AssFile *subs) const {
 	if (!subs->Attachments.empty())
 		return false;
 
-	auto def = boost::flyweight<std::string>("Default");
+	auto def = FlyweightString("Default");
 	for (auto const& line : subs->Events) {
 		if (line.Style != def || line.GetStrippedText() != line.Text)
 			return false;
@@ -93,6 +112,14 @@ bool SubtitleFormat::CanSave(const AssFile *subs) const {
 }
 
 agi::vfr::Framerate SubtitleFormat::AskForFPS(bool allow_vfr, bool show_smpte, agi::vfr::Framerate const& fps) {
+	// Without a GUI there's no one to ask, so the frame rate has to have
+	// been given
+	if (!wxTheApp || !wxTheApp->IsGUI()) {
+		if (fps.IsLoaded() && (allow_vfr || !fps.IsVFR()))
+			return fps;
+		throw agi::InvalidInputException("A frame rate is needed for this subtitle format");
+	}
+
 	wxArrayString choices;
 
 	bool vidLoaded = false;
@@ -159,21 +186,31 @@ void SubtitleFormat::StripTags(AssFile &file) {
 		current.StripTags();
 }
 
+void SubtitleFormat::StripTags(std::string &text) {
+	AssDialogue line;
+	line.Text = text;
+	text = line.GetStrippedText();
+}
+
 void SubtitleFormat::ConvertNewlines(AssFile &file, std::string const& newline, bool mergeLineBreaks) {
 	for (auto& current : file.Events) {
 		std::string repl = current.Text;
-		boost::replace_all(repl, "\\h", " ");
-		boost::ireplace_all(repl, "\\n", newline);
-		if (mergeLineBreaks) {
-			std::string dbl(newline + newline);
-			size_t pos = 0;
-			while ((pos = repl.find(dbl, pos)) != std::string::npos)
-				boost::replace_all(repl, dbl, newline);
-		}
+		ConvertNewlines(repl, newline, mergeLineBreaks);
 		current.Text = repl;
 	}
 }
 
+void SubtitleFormat::ConvertNewlines(std::string &text, std::string const& newline, bool mergeLineBreaks) {
+	boost::replace_all(text, "\\h", " ");
+	boost::ireplace_all(text, "\\n", newline);
+	if (mergeLineBreaks) {
+		std::string dbl(newline + newline);
+		size_t pos = 0;
+		while ((pos = text.find(dbl, pos)) != std::string::npos)
+			boost::replace_all(text, dbl, newline);
+	}
+}
+
 void SubtitleFormat::StripComments(AssFile &file) {
 	file.Events.remove_and_dispose_if([](AssDialogue const& diag) {
 		return diag.Comment || diag.Text.get().empty();
@@ -182,64 +219,42 @@ void SubtitleFormat::StripComments(AssFile &file) {
 
 /// @brief Split and merge lines so there are no overlapping lines
 ///
-/// Algorithm described at http://devel.aegisub.org/wiki/Technical/SplitMerge
+/// Each span of time during which the same lines are visible becomes a line
+/// of its own, with the text of the visible lines stacked with the last one
+/// in the file on top. The file should already be sorted by start time.
 void SubtitleFormat::RecombineOverlaps(AssFile &file) {
-	auto cur = file.Events.begin();
-	for (auto next = std::next(cur); next != file.Events.end(); cur = std::prev(next)) {
-		if (next == file.Events.begin() || cur->End <= next->Start) {
-			++next;
-			continue;
-		}
-
-		std::unique_ptr<AssDialogue> prevdlg(&*cur);
-		std::unique_ptr<AssDialogue> curdlg(&*next);
-		++next;
-
-		auto insert_line = [&](AssDialogue *newdlg) {
-			file.Events.insert(std::find_if(next, file.Events.end(), [&](AssDialogue const& pos) {
-				return pos.Start >= newdlg->Start;
-			}), *newdlg);
-		};
-
-		//Is there an A part before the overlap?
-		if (curdlg->Start > prevdlg->Start) {
-			// Produce new entry with correct values
-			auto newdlg = new AssDialogue(*prevdlg);
-			newdlg->Start = prevdlg->Start;
-			newdlg->End = curdlg->Start;
-			newdlg->Text = prevdlg->Text;
-			insert_line(newdlg);
-		}
+	std::vector<AssDialogue *> lines;
+	std::vector<int> starts, ends;
+	for (auto& line : file.Events) {
+		lines.push_back(&line);
+		starts.push_back(line.Start);
+		ends.push_back(line.End);
+	}
 
-		// Overlapping A+B part
-		{
-			auto newdlg = new AssDialogue(*prevdlg);
-			newdlg->Start = curdlg->Start;
-			newdlg->End = (prevdlg->End < curdlg->End) ? prevdlg->End : curdlg->End;
-			// Put an ASS format hard linewrap between lines
-			newdlg->Text = curdlg->Text.get() + "\\N" + prevdlg->Text.get();
-			insert_line(newdlg);
+	auto pieces = agi::ass::SplitOverlaps(starts, ends);
+
+	// Relink the whole list once rather than inserting each new line at its
+	// position, which made heavily overlapping files quadratic
+	std::vector<bool> reused(lines.size());
+	file.Events.clear();
+	for (auto const& piece : pieces) {
+		size_t first = piece.lines.front();
+		if (piece.lines.size() == 1 && !reused[first] && piece.start == starts[first] && piece.end == ends[first]) {
+			reused[first] = true;
+			file.Events.push_back(*lines[first]);
+			continue;
 		}
 
-		// Is there an A part after the overlap?
-		if (prevdlg->End > curdlg->End) {
-			// Produce new entry with correct values
-			auto newdlg = new AssDialogue(*prevdlg);
-			newdlg->Start = curdlg->End;
-			newdlg->End = prevdlg->End;
-			newdlg->Text = prevdlg->Text;
-			insert_line(newdlg);
-		}
+		auto newdlg = new AssDialogue(*lines[first]);
+		newdlg->Start = piece.start;
+		newdlg->End = piece.end;
+		newdlg->Text = StackedText(lines, piece);
+		file.Events.push_back(*newdlg);
+	}
 
-		// Is there a B part after the overlap?
-		if (curdlg->End > prevdlg->End) {
-			// Produce new entry with correct values
-			auto newdlg = new AssDialogue(*prevdlg);
-			newdlg->Start = prevdlg->End;
-			newdlg->End = curdlg->End;
-			newdlg->Text = curdlg->Text;
-			insert_line(newdlg);
-		}
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (!reused[i])
+			delete lines[i];
 	}
 }
 
@@ -260,6 +275,40 @@ void SubtitleFormat::MergeIdentical(AssFile &file) {
 	}
 }
 
+std::vector<SubtitleFormat::FlatLine> SubtitleFormat::FlattenLines(const AssFile *file) {
+	// Same as StripComments on a sorted copy of the file
+	std::vector<const AssDialogue *> sorted;
+	for (auto const& line : file->Events) {
+		if (!line.Comment && !line.Text.get().empty())
+			sorted.push_back(&line);
+	}
+	std::stable_sort(begin(sorted), end(sorted), [](const AssDialogue *a, const AssDialogue *b) {
+		return a->Start < b->Start;
+	});
+
+	// Same as RecombineOverlaps followed by MergeIdentical
+	std::vector<int> starts, ends;
+	for (auto line : sorted) {
+		starts.push_back(line->Start);
+		ends.push_back(line->End);
+	}
+
+	std::vector<FlatLine> lines;
+	for (auto const& piece : agi::ass::SplitOverlaps(starts, ends)) {
+		FlatLine line{piece.start, piece.end, StackedText(sorted, piece)};
+
+		if (!lines.empty() && lines.back().End == line.Start && lines.back().Text == line.Text) {
+			line.Start = std::min(line.Start, lines.back().Start);
+			line.End = std::max(line.End, lines.back().End);
+			lines.back() = std::move(line);
+		}
+		else
+			lines.push_back(std::move(line));
+	}
+
+	return lines;
+}
+
 void SubtitleFormat::LoadFormats() {
 	if (formats.empty()) {
 		formats.emplace_back(agi::make_unique<AssSubtitleFormat>());
@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include <libaegisub/ass/time.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/fs_fwd.h>
 
@@ -47,12 +48,23 @@ class SubtitleFormat {
 	virtual std::vector<std::string> GetWriteWildcards() const { return {}; }
 
 public:
+	/// Times and text of a line returned by FlattenLines
+	struct FlatLine {
+		agi::Time Start;
+		agi::Time End;
+		std::string Text;
+	};
+
 	/// Strip override tags
 	static void StripTags(AssFile &file);
+	/// Strip override tags from the text of one line
+	static void StripTags(std::string &text);
 	/// Convert newlines to the specified character(s)
 	/// @param lineEnd newline character(s)
 	/// @param mergeLineBreaks Should multiple consecutive line breaks be merged into one?
 	static void ConvertNewlines(AssFile &file, std::string const& newline, bool mergeLineBreaks = true);
+	/// Convert newlines in the text of one line to the specified character(s)
+	static void ConvertNewlines(std::string &text, std::string const& newline, bool mergeLineBreaks = true);
 	/// Remove All commented and empty lines
 	static void StripComments(AssFile &file);
 	/// @brief Split and merge lines so there are no overlapping lines
@@ -61,10 +73,20 @@ public:
 	static void RecombineOverlaps(AssFile &file);
 	/// Merge sequential identical lines
 	static void MergeIdentical(AssFile &file);
+	/// @brief Get the lines which sorting a copy of the file and then running
+	///        StripComments, RecombineOverlaps and MergeIdentical on it would
+	///        leave
+	///
+	/// For writers of formats with no overlapping lines. Only the times and
+	/// text of each line are copied, rather than the entire file.
+	static std::vector<FlatLine> FlattenLines(const AssFile *file);
 
 	/// Prompt the user for a frame rate to use
 	/// @param allow_vfr Include video frame rate as an option even if it's vfr
 	/// @param show_smpte Show SMPTE drop frame option
+	///
+	/// When running without a GUI, fps is used if it's loaded and usable, and
+	/// agi::InvalidInputException is thrown otherwise.
 	static agi::vfr::Framerate AskForFPS(bool allow_vfr, bool show_smpte, agi::vfr::Framerate const& fps);
 
 	/// Constructor
@@ -115,6 +137,10 @@ public:
 		WriteFile(src, filename, fps, encoding);
 	}
 
+	/// Does writing this format ask the user for anything? Formats which
+	/// don't can be written on a background thread.
+	virtual bool PromptsOnWrite() const { return false; }
+
 	/// Get the wildcards for a save or load dialog
 	/// @param mode 0: load 1: save
 	static std::string GetWildcards(int mode);
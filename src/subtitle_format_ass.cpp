@@ -24,22 +24,89 @@
 #include "ass_parser.h"
 #include "options.h"
 #include "string_codec.h"
-#include "text_file_reader.h"
 #include "text_file_writer.h"
 #include "version.h"
 
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/buffer_lines.h>
+#include <libaegisub/file_mapping.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/parallel.h>
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstring>
 
 DEFINE_EXCEPTION(AssParseError, SubtitleFormatParseError);
 
-void AssSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
-	int version = !agi::fs::HasExtension(filename, "ssa");
+namespace {
+/// Number of events parsed in each chunk. Files with fewer events than this
+/// are parsed on a single thread, as handing them out to other threads
+/// would take longer than parsing them
+const size_t min_parallel_events = 10000;
+
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/// Parse the events on as many threads as there are cores, then add them to
+/// the file in order
+void parse_events(AssFile *target, std::vector<std::pair<const char *, const char *>> const& lines) {
+	std::vector<AssDialogue *> parsed(lines.size());
+	auto parse = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			parsed[i] = new AssDialogue(std::string(lines[i].first, lines[i].second));
+	};
+
+	try {
+		agi::parallel_for(0, lines.size(), min_parallel_events, parse);
+	}
+	catch (...) {
+		for (auto line : parsed) delete line;
+		throw;
+	}
+
+	for (auto line : parsed)
+		target->Events.push_back(*line);
+}
+
+/// @brief Read a file directly from its mapping
+///
+/// Equivalent to reading it with TextFileReader, but without copying each
+/// line, and with the events parsed in parallel. UTF-8 files are used as-is
+/// and anything else is converted all at once first.
+void read_mapped(AssFile *target, agi::fs::path const& filename, std::string const& encoding, int version) {
+	agi::read_file_mapping file(filename);
+	const char *data = file.size() ? file.read() : nullptr;
+	// Events point into this, so it has to live until they're parsed
+	agi::buffer_lines lines(data, data + file.size(), encoding);
 
-	TextFileReader file(filename, encoding);
 	AssParser parser(target, version);
-	while (file.HasMoreLines())
-		parser.AddLine(file.ReadLineFromFile());
+	std::vector<std::pair<const char *, const char *>> events;
+	for (auto const& line : lines) {
+		const char *begin = line.begin(), *end = line.end();
+		while (begin < end && is_space(*begin)) ++begin;
+		while (end > begin && is_space(end[-1])) --end;
+		if (end - begin >= 3 && !memcmp(begin, "\xEF\xBB\xBF", 3))
+			begin += 3;
+
+		// Events are only collected here, and everything else is parsed as
+		// it's read
+		if (parser.InEvents() && begin != end && *begin != '[') {
+			if (boost::starts_with(boost::make_iterator_range(begin, end), "Dialogue:") ||
+				boost::starts_with(boost::make_iterator_range(begin, end), "Comment:"))
+				events.emplace_back(begin, end);
+			continue;
+		}
+		parser.AddLine(std::string(begin, end));
+	}
+
+	parse_events(target, events);
+}
+}
+
+void AssSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
+	read_mapped(target, filename, encoding, !agi::fs::HasExtension(filename, "ssa"));
 }
 
 #ifdef _WIN32
@@ -60,6 +127,10 @@ const char *format(AssEntryGroup group) {
 struct Writer {
 	TextFileWriter file;
 	AssEntryGroup group = AssEntryGroup::INFO;
+	/// Lines waiting to be written. Lines are written in large chunks rather
+	/// than one at a time, and events are formatted straight into it.
+	std::string buffer;
+	static const size_t flush_size = 1 << 20;
 
 	Writer(agi::fs::path const& filename, std::string const& encoding)
 	: file(filename, encoding)
@@ -67,12 +138,15 @@ struct Writer {
 		file.WriteLineToFile("[Script Info]");
 		file.WriteLineToFile(std::string("; Script generated by Aegisub ") + GetAegisubLongVersionString());
 		file.WriteLineToFile("; http://www.aegisub.org/");
+		buffer.reserve(flush_size);
 	}
 
 	template<typename T>
 	void Write(T const& list) {
 		for (auto const& line : list) {
 			if (line.Group() != group) {
+				Flush();
+
 				// Add a blank line between each group
 				file.WriteLineToFile("");
 
@@ -83,8 +157,28 @@ struct Writer {
 				group = line.Group();
 			}
 
-			file.WriteLineToFile(line.GetEntryData());
+			Append(line);
+			if (buffer.size() >= flush_size)
+				Flush();
 		}
+		Flush();
+	}
+
+	void Append(AssDialogue const& line) {
+		line.AppendEntryData(buffer);
+		buffer += LINEBREAK;
+	}
+
+	template<typename T>
+	void Append(T const& line) {
+		buffer += line.GetEntryData();
+		buffer += LINEBREAK;
+	}
+
+	void Flush() {
+		if (buffer.empty()) return;
+		file.WriteLineToFile(buffer, false);
+		buffer.clear();
 	}
 
 	void Write(ProjectProperties const& properties) {
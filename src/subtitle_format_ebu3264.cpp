@@ -36,6 +36,7 @@
 #include <libaegisub/exception.h>
 #include <libaegisub/io.h>
 #include <libaegisub/line_wrap.h>
+#include <libaegisub/parallel.h>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <wx/utils.h>
@@ -355,48 +356,61 @@ namespace
 		int timecode_bias = fps.FrameAtSmpte(tcofs.h, tcofs.m, tcofs.s, tcofs.s);
 
 		AssStyle default_style;
-		std::vector<EbuSubtitle> subs_list;
-		subs_list.reserve(copy.Events.size());
-
-		// convert to intermediate format
+		std::vector<AssDialogue *> lines;
+		lines.reserve(copy.Events.size());
 		for (auto& line : copy.Events)
+			lines.push_back(&line);
+
+		// convert to intermediate format, with each line converted
+		// independently so that they can be done in parallel
+		std::vector<EbuSubtitle> converted(lines.size());
+		std::vector<char> over_length(lines.size(), 0);
+		agi::parallel_for(0, lines.size(), 64, [&](size_t begin, size_t end)
 		{
-			// add a new subtitle and work on it
-			subs_list.emplace_back();
-			EbuSubtitle &imline = subs_list.back();
-
-			// some defaults for compatibility
-			imline.group_number = 0;
-			imline.comment_flag = false;
-			imline.cumulative_status = EbuSubtitle::NotCumulative;
-
-			// convert times
-			imline.time_in = fps.FrameAtTime(line.Start) + timecode_bias;
-			imline.time_out = fps.FrameAtTime(line.End) + timecode_bias;
-			if (export_settings.inclusive_end_times)
-				// cheap and possibly wrong way to ensure exclusive times, subtract one frame from end time
-				imline.time_out -= 1;
-
-			// convert alignment from style
-			AssStyle *style = copy.GetStyle(line.Style);
-			if (!style)
-				style = &default_style;
-
-			// add text, translate formatting
-			imline.SetTextFromAss(&line, style->underline, style->italic, style->alignment, line_wrap_type);
-
-			// line breaking handling
-			if (export_settings.line_wrapping_mode == EbuExportSettings::AutoWrap)
-				imline.SplitLines(export_settings.max_line_length, line_wrap_type);
-			else if (export_settings.line_wrapping_mode == EbuExportSettings::AutoWrapBalance)
-				imline.SplitLines(export_settings.max_line_length, agi::Wrap_Balanced);
-			else if (!imline.CheckLineLengths(export_settings.max_line_length))
+			for (size_t i = begin; i < end; ++i)
 			{
-				if (export_settings.line_wrapping_mode == EbuExportSettings::AbortOverLength)
-					throw Ebu3264SubtitleFormat::ConversionFailed(agi::format(_("Line over maximum length: %s"), line.Text));
-				else // skip over-long lines
-					subs_list.pop_back();
+				AssDialogue &line = *lines[i];
+				EbuSubtitle &imline = converted[i];
+
+				// some defaults for compatibility
+				imline.group_number = 0;
+				imline.comment_flag = false;
+				imline.cumulative_status = EbuSubtitle::NotCumulative;
+
+				// convert times
+				imline.time_in = fps.FrameAtTime(line.Start) + timecode_bias;
+				imline.time_out = fps.FrameAtTime(line.End) + timecode_bias;
+				if (export_settings.inclusive_end_times)
+					// cheap and possibly wrong way to ensure exclusive times, subtract one frame from end time
+					imline.time_out -= 1;
+
+				// convert alignment from style
+				AssStyle *style = copy.GetStyle(line.Style);
+				if (!style)
+					style = &default_style;
+
+				// add text, translate formatting
+				imline.SetTextFromAss(&line, style->underline, style->italic, style->alignment, line_wrap_type);
+
+				// line breaking handling
+				if (export_settings.line_wrapping_mode == EbuExportSettings::AutoWrap)
+					imline.SplitLines(export_settings.max_line_length, line_wrap_type);
+				else if (export_settings.line_wrapping_mode == EbuExportSettings::AutoWrapBalance)
+					imline.SplitLines(export_settings.max_line_length, agi::Wrap_Balanced);
+				else if (!imline.CheckLineLengths(export_settings.max_line_length))
+					over_length[i] = 1;
 			}
+		});
+
+		std::vector<EbuSubtitle> subs_list;
+		subs_list.reserve(converted.size());
+		for (size_t i = 0; i < converted.size(); ++i)
+		{
+			if (!over_length[i])
+				subs_list.push_back(std::move(converted[i]));
+			else if (export_settings.line_wrapping_mode == EbuExportSettings::AbortOverLength)
+				throw Ebu3264SubtitleFormat::ConversionFailed(agi::format(_("Line over maximum length: %s"), lines[i]->Text));
+			// else skip over-long lines
 		}
 
 		// produce an empty line if there are none
@@ -454,7 +468,20 @@ namespace
 
 	std::vector<BlockTTI> create_blocks(std::vector<EbuSubtitle> const& subs_list, EbuExportSettings const& export_settings)
 	{
-		auto encoder = export_settings.GetTextEncoder();
+		// encode the text of each subtitle in parallel, with an encoder for
+		// each thread as they aren't safe to share
+		bool enable_formatting = export_settings.display_standard == EbuExportSettings::DSC_Open;
+		std::vector<std::string> encoded(subs_list.size());
+		std::vector<std::unique_ptr<agi::charset::IconvWrapper>> encoders(agi::parallel_concurrency());
+		agi::parallel_for_slots(0, subs_list.size(), 64, [&](size_t slot, size_t begin, size_t end)
+		{
+			auto &encoder = encoders[slot];
+			if (!encoder)
+				encoder = export_settings.GetTextEncoder();
+			for (size_t i = begin; i < end; ++i)
+				encoded[i] = convert_subtitle_line(subs_list[i], encoder.get(), enable_formatting);
+		});
+
 		auto fps = export_settings.GetFramerate();
 
 		// Teletext captions are 1-23; Open subtitles are 0-99
@@ -469,10 +496,10 @@ namespace
 
 		std::vector<BlockTTI> tti;
 		tti.reserve(subs_list.size());
-		for (auto const& sub : subs_list)
+		for (size_t i = 0; i < subs_list.size(); ++i)
 		{
-			std::string fullstring = convert_subtitle_line(sub, encoder.get(),
-				export_settings.display_standard == EbuExportSettings::DSC_Open);
+			EbuSubtitle const& sub = subs_list[i];
+			std::string const& fullstring = encoded[i];
 
 			// construct a base block that can be copied and filled
 			BlockTTI base;
@@ -637,9 +664,8 @@ void Ebu3264SubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& f
 	fieldprintf(gsi.tnb, 5, "%5u", (unsigned int)tti.size());
 	fieldprintf(gsi.tns, 5, "%5u", (unsigned int)subs_list.size());
 
-	// write file
+	// write file; the blocks are packed, so they can all go in one write
 	agi::io::Save f(filename, true);
 	f.Get().write((const char *)&gsi, sizeof(gsi));
-	for (auto const& block : tti)
-		f.Get().write((const char *)&block, sizeof(block));
+	f.Get().write((const char *)tti.data(), tti.size() * sizeof(BlockTTI));
 }
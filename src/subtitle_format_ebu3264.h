@@ -29,6 +29,7 @@ public:
 	Ebu3264SubtitleFormat();
 	std::vector<std::string> GetWriteWildcards() const override { return {"stl"}; }
 	void WriteFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const override;
+	bool PromptsOnWrite() const override { return true; }
 
 	DEFINE_EXCEPTION(ConversionFailed, agi::InvalidInputException);
 };
@@ -47,8 +47,7 @@
 #include <libaegisub/vfr.h>
 
 #include <boost/algorithm/string/replace.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/regex.hpp>
+#include <limits>
 
 MicroDVDSubtitleFormat::MicroDVDSubtitleFormat()
 : SubtitleFormat("MicroDVD")
@@ -63,7 +62,30 @@ std::vector<std::string> MicroDVDSubtitleFormat::GetWriteWildcards() const {
 	return GetReadWildcards();
 }
 
-static const boost::regex line_regex(R"(^[\{\[]([0-9]+)[\}\]][\{\[]([0-9]+)[\}\]](.*)$)");
+namespace {
+/// Parse a frame number in either {} or [] at pos
+bool parse_frame(std::string const& line, size_t &pos, int &frame) {
+	if (pos >= line.size() || (line[pos] != '{' && line[pos] != '[')) return false;
+	size_t start = ++pos;
+	int64_t value = 0;
+	for (; pos < line.size() && line[pos] >= '0' && line[pos] <= '9'; ++pos) {
+		value = value * 10 + (line[pos] - '0');
+		if (value > std::numeric_limits<int>::max()) return false;
+	}
+	if (pos == start || pos >= line.size() || (line[pos] != '}' && line[pos] != ']')) return false;
+	++pos;
+	frame = static_cast<int>(value);
+	return true;
+}
+
+/// Parse a line of the form {start}{end}text
+bool parse_line(std::string const& line, int &start, int &end, std::string &text) {
+	size_t pos = 0;
+	if (!parse_frame(line, pos, start) || !parse_frame(line, pos, end)) return false;
+	text.assign(line, pos, std::string::npos);
+	return true;
+}
+}
 
 bool MicroDVDSubtitleFormat::CanReadFile(agi::fs::path const& filename, std::string const& encoding) const {
 	// Return false immediately if extension is wrong
@@ -71,8 +93,10 @@ bool MicroDVDSubtitleFormat::CanReadFile(agi::fs::path const& filename, std::str
 
 	// Since there is an infinity of .sub formats, load first line and check if it's valid
 	TextFileReader file(filename, encoding);
+	int start, end;
+	std::string text;
 	if (file.HasMoreLines())
-		return regex_match(file.ReadLineFromFile(), line_regex);
+		return parse_line(file.ReadLineFromFile(), start, end, text);
 
 	return false;
 }
@@ -85,12 +109,10 @@ void MicroDVDSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& file
 	agi::vfr::Framerate fps;
 
 	bool isFirst = true;
+	int f1, f2;
+	std::string text;
 	while (file.HasMoreLines()) {
-		boost::smatch match;
-		std::string line = file.ReadLineFromFile();
-		if (!regex_match(line, match, line_regex)) continue;
-
-		std::string text = match[3].str();
+		if (!parse_line(file.ReadLineFromFile(), f1, f2, text)) continue;
 
 		// If it's the first, check if it contains fps information
 		if (isFirst) {
@@ -107,9 +129,6 @@ void MicroDVDSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& file
 			if (!fps.IsLoaded()) return;
 		}
 
-		int f1 = boost::lexical_cast<int>(match[1]);
-		int f2 = boost::lexical_cast<int>(match[2]);
-
 		boost::replace_all(text, "|", "\\N");
 
 		auto diag = new AssDialogue;
@@ -124,14 +143,6 @@ void MicroDVDSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const&
 	agi::vfr::Framerate fps = AskForFPS(true, false, vfps);
 	if (!fps.IsLoaded()) return;
 
-	AssFile copy(*src);
-	copy.Sort();
-	StripComments(copy);
-	RecombineOverlaps(copy);
-	MergeIdentical(copy);
-	StripTags(copy);
-	ConvertNewlines(copy, "|");
-
 	TextFileWriter file(filename, encoding);
 
 	// Write FPS line
@@ -139,10 +150,13 @@ void MicroDVDSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const&
 		file.WriteLineToFile(agi::format("{1}{1}%.6f", fps.FPS()));
 
 	// Write lines
-	for (auto const& current : copy.Events) {
+	for (auto& current : FlattenLines(src)) {
+		StripTags(current.Text);
+		ConvertNewlines(current.Text, "|");
+
 		int start = fps.FrameAtTime(current.Start, agi::vfr::START);
 		int end = fps.FrameAtTime(current.End, agi::vfr::END);
 
-		file.WriteLineToFile(agi::format("{%i}{%i}%s", start, end, boost::replace_all_copy(current.Text.get(), "\\N", "|")));
+		file.WriteLineToFile(agi::format("{%i}{%i}%s", start, end, current.Text));
 	}
 }
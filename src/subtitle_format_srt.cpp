@@ -48,7 +48,8 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
-#include <boost/regex.hpp>
+#include <cctype>
+#include <cstring>
 
 DEFINE_EXCEPTION(SRTParseError, SubtitleFormatParseError);
 
@@ -119,6 +120,88 @@ struct ToggleTag {
 	}
 };
 
+/// Find the next tag in SRT text which the tag parser knows about
+///
+/// Tags are matched as b, i, u, s or font, optionally preceded by a slash,
+/// followed by anything up to the next >. Note that this means that <br>
+/// is a b tag with the attributes "r", as has always been the case.
+/// @param srt Text to search
+/// @param pos Where to start searching
+/// @param[out] tag_start Position of the tag's <
+/// @param[out] name_end Position after the tag's name
+/// @param[out] tag_end Position of the tag's >
+bool find_tag(std::string const& srt, size_t pos, size_t &tag_start, size_t &name_end, size_t &tag_end) {
+	for (tag_start = srt.find('<', pos); tag_start != std::string::npos; tag_start = srt.find('<', tag_start + 1)) {
+		size_t name_start = tag_start + 1;
+		if (name_start < srt.size() && srt[name_start] == '/')
+			++name_start;
+		if (name_start >= srt.size()) return false;
+
+		switch (tolower(static_cast<unsigned char>(srt[name_start]))) {
+			case 'b': case 'i': case 'u': case 's':
+				name_end = name_start + 1;
+				break;
+			case 'f':
+				if (!boost::istarts_with(srt.c_str() + name_start, "font"))
+					continue;
+				name_end = name_start + 4;
+				break;
+			default:
+				continue;
+		}
+
+		tag_end = srt.find('>', name_end);
+		// No > after this one means there isn't one after any later < either
+		return tag_end != std::string::npos;
+	}
+	return false;
+}
+
+bool is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+/// Read the next face, size or color attribute of a font tag
+/// @param attrs Attributes of the tag
+/// @param[in,out] pos Where to start reading, and then where the attribute ended
+/// @param[out] name Attribute name in lowercase
+/// @param[out] value Attribute value, without any quotes
+/// @return Was an attribute found immediately after some whitespace?
+bool next_font_attrib(std::string const& attrs, size_t &pos, std::string &name, std::string &value) {
+	size_t p = pos;
+	while (p < attrs.size() && is_space(attrs[p])) ++p;
+	if (p == pos) return false;
+
+	name.clear();
+	for (const char *attr_name : {"face", "size", "color"}) {
+		size_t len = strlen(attr_name);
+		if (boost::istarts_with(attrs.c_str() + p, attr_name) && p + len < attrs.size() && attrs[p + len] == '=') {
+			name = attr_name;
+			p += len + 1;
+			break;
+		}
+	}
+	if (name.empty() || p >= attrs.size()) return false;
+
+	char quote = attrs[p];
+	if (quote == '\'' || quote == '"') {
+		size_t close = attrs.find(quote, p + 1);
+		if (close != std::string::npos) {
+			value = attrs.substr(p + 1, close - p - 1);
+			pos = close + 1;
+			return true;
+		}
+	}
+
+	size_t end = p;
+	while (end < attrs.size() && !is_space(attrs[end])) ++end;
+	if (end == p) return false;
+	// Includes the quote if it was unterminated
+	value = attrs.substr(p, end - p);
+	pos = end;
+	return true;
+}
+
 class SrtTagParser {
 	struct FontAttribs {
 		std::string face;
@@ -126,19 +209,8 @@ class SrtTagParser {
 		std::string color;
 	};
 
-	const boost::regex tag_matcher;
-	const boost::regex attrib_matcher;
-	const boost::regex is_quoted;
-
 public:
-	SrtTagParser()
-	: tag_matcher("^(.*?)<(/?b|/?i|/?u|/?s|/?font)([^>]*)>(.*)$", boost::regex::icase)
-	, attrib_matcher(R"(^[[:space:]]+(face|size|color)=('[^']*'|"[^"]*"|[^[:space:]]+))", boost::regex::icase)
-	, is_quoted(R"(^(['"]).*\1$)")
-	{
-	}
-
-	std::string ToAss(std::string srt)
+	std::string ToAss(std::string const& srt)
 	{
 		ToggleTag bold('b');
 		ToggleTag italic('i');
@@ -147,27 +219,25 @@ public:
 		std::vector<FontAttribs> font_stack;
 
 		std::string ass; // result to be built
+		ass.reserve(srt.size());
 
-		while (!srt.empty())
+		size_t pos = 0;
+		while (pos < srt.size())
 		{
-			boost::smatch result;
-			if (!regex_match(srt, result, tag_matcher))
+			size_t tag_start, name_end, tag_end;
+			if (!find_tag(srt, pos, tag_start, name_end, tag_end))
 			{
 				// no more tags could be matched, end of string
-				ass.append(srt);
+				ass.append(srt, pos, std::string::npos);
 				break;
 			}
 
-			// we found a tag, translate it
-			std::string pre_text  = result.str(1);
-			std::string tag_name  = result.str(2);
-			std::string tag_attrs = result.str(3);
-			std::string post_text = result.str(4);
-
 			// the text before the tag goes through unchanged
-			ass.append(pre_text);
+			ass.append(srt, pos, tag_start - pos);
+			std::string tag_name = srt.substr(tag_start + 1, name_end - tag_start - 1);
+			std::string tag_attrs = srt.substr(name_end, tag_end - name_end);
 			// the text after the tag is the input for next iteration
-			srt = post_text;
+			pos = tag_end + 1;
 
 			boost::to_lower(tag_name);
 			switch (type_from_name(tag_name))
@@ -190,18 +260,10 @@ public:
 						old_attribs = font_stack.back();
 					new_attribs = old_attribs;
 					// now find all attributes on this font tag
-					boost::smatch result;
-					while (regex_search(tag_attrs, result, attrib_matcher))
+					size_t attr_pos = 0;
+					std::string attr_name, attr_value;
+					while (next_font_attrib(tag_attrs, attr_pos, attr_name, attr_value))
 					{
-						// get attribute name and values
-						std::string attr_name = result.str(1);
-						std::string attr_value = result.str(2);
-
-						// clean them
-						boost::to_lower(attr_name);
-						if (regex_match(attr_value, is_quoted))
-							attr_value = attr_value.substr(1, attr_value.size() - 2);
-
 						// handle the attributes
 						if (attr_name == "face")
 							new_attribs.face = agi::format("{\\fn%s}", attr_value);
@@ -209,9 +271,6 @@ public:
 							new_attribs.size = agi::format("{\\fs%s}", attr_value);
 						else if (attr_name == "color")
 							new_attribs.color = agi::format("{\\c%s}", agi::Color(attr_value).GetAssOverrideFormatted());
-
-						// remove this attribute to prepare for the next
-						tag_attrs = result.suffix().str();
 					}
 
 					// the attributes changed from old are then written out
@@ -277,6 +336,42 @@ public:
 	}
 };
 
+/// Parse a time of the form h:m:s,f, where h, m and s are one or two digits
+/// and f is any number of digits
+bool parse_time(std::string const& str, size_t &pos, int &ms) {
+	int fields[3];
+	for (int i = 0; i < 3; ++i) {
+		fields[i] = 0;
+		size_t digits = 0;
+		for (; digits < 2 && pos < str.size() && isdigit(static_cast<unsigned char>(str[pos])); ++digits, ++pos)
+			fields[i] = fields[i] * 10 + (str[pos] - '0');
+		if (!digits || pos >= str.size() || str[pos] != (i < 2 ? ':' : ','))
+			return false;
+		++pos;
+	}
+
+	if (pos >= str.size() || !isdigit(static_cast<unsigned char>(str[pos])))
+		return false;
+
+	// Digits past milliseconds are ignored, as with agi::Time's parser
+	int fraction = 0;
+	for (int place = 100; pos < str.size() && isdigit(static_cast<unsigned char>(str[pos])); ++pos, place /= 10)
+		fraction += (str[pos] - '0') * place;
+
+	ms = ((fields[0] * 60 + fields[1]) * 60 + fields[2]) * 1000 + fraction;
+	return true;
+}
+
+/// Parse the "hh:mm:ss,fff --> hh:mm:ss,fff" at the start of a line
+/// (e.g. "00:00:04,070 --> 00:00:10,04"), ignoring anything after it
+bool parse_timestamps(std::string const& line, int &start, int &end) {
+	size_t pos = 0;
+	if (!parse_time(line, pos, start)) return false;
+	if (line.compare(pos, 5, " --> ") != 0) return false;
+	pos += 5;
+	return parse_time(line, pos, end);
+}
+
 std::string WriteSRTTime(agi::Time const& ts)
 {
 	return ts.GetSrtFormatted();
@@ -313,9 +408,6 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 
 	// See parsing algorithm at <http://devel.aegisub.org/wiki/SubtitleFormats/SRT>
 
-	// "hh:mm:ss,fff --> hh:mm:ss,fff" (e.g. "00:00:04,070 --> 00:00:10,04")
-	const boost::regex timestamp_regex("^([0-9]{1,2}:[0-9]{1,2}:[0-9]{1,2},[0-9]{1,}) --> ([0-9]{1,2}:[0-9]{1,2}:[0-9]{1,2},[0-9]{1,})");
-
 	SrtTagParser tag_parser;
 
 	ParseState state = ParseState::INITIAL;
@@ -328,7 +420,7 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 		++line_num;
 		boost::trim(text_line);
 
-		boost::smatch timestamp_match;
+		int start_time, end_time;
 		bool found_timestamps = false;
 		switch (state) {
 			case ParseState::INITIAL:
@@ -339,7 +431,7 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 					state = ParseState::TIMESTAMP;
 					break;
 				}
-				if (regex_search(text_line, timestamp_match, timestamp_regex)) {
+				if (parse_timestamps(text_line, start_time, end_time)) {
 					found_timestamps = true;
 					break;
 				}
@@ -347,7 +439,7 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 				throw SRTParseError(agi::format("Parsing SRT: Expected subtitle index at line %d", line_num));
 
 			case ParseState::TIMESTAMP:
-				if (!regex_search(text_line, timestamp_match, timestamp_regex))
+				if (!parse_timestamps(text_line, start_time, end_time))
 					throw SRTParseError(agi::format("Parsing SRT: Expected timestamp pair at line %d", line_num));
 
 				found_timestamps = true;
@@ -387,7 +479,7 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 					state = ParseState::TIMESTAMP;
 					break;
 				}
-				if (regex_search(text_line, timestamp_match, timestamp_regex)) {
+				if (parse_timestamps(text_line, start_time, end_time)) {
 					found_timestamps = true;
 					break;
 				}
@@ -409,8 +501,8 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 
 			// create new subtitle
 			line = new AssDialogue;
-			line->Start = timestamp_match.str(1);
-			line->End = timestamp_match.str(2);
+			line->Start = start_time;
+			line->End = end_time;
 			// store pointer to subtitle, we'll continue working on it
 			target->Events.push_back(*line);
 			// next we're reading the text
@@ -428,24 +520,19 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 void SRTSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
 	TextFileWriter file(filename, encoding);
 
-	// Convert to SRT
-	AssFile copy(*src);
-	copy.Sort();
-	StripComments(copy);
-	RecombineOverlaps(copy);
-	MergeIdentical(copy);
 #ifdef _WIN32
-	ConvertNewlines(copy, "\r\n", false);
+	const std::string newline = "\r\n";
 #else
-	ConvertNewlines(copy, "\n", false);
+	const std::string newline = "\n";
 #endif
 
 	// Write lines
 	int i=0;
-	for (auto const& current : copy.Events) {
+	for (auto& current : FlattenLines(src)) {
+		ConvertNewlines(current.Text, newline, false);
 		file.WriteLineToFile(std::to_string(++i));
 		file.WriteLineToFile(WriteSRTTime(current.Start) + " --> " + WriteSRTTime(current.End));
-		file.WriteLineToFile(ConvertTags(&current));
+		file.WriteLineToFile(ConvertTags(current.Text));
 		file.WriteLineToFile("");
 	}
 }
@@ -454,13 +541,13 @@ bool SRTSubtitleFormat::CanSave(const AssFile *file) const {
 	if (!file->Attachments.empty())
 		return false;
 
-	auto def = boost::flyweight<std::string>("Default");
+	auto def = FlyweightString("Default");
 	for (auto const& line : file->Events) {
 		if (line.Style != def)
 			return false;
 
-		auto blocks = line.ParseTags();
-		for (auto ovr : blocks | agi::of_type<AssDialogueBlockOverride>()) {
+		auto blocks = line.GetParsedBlocks();
+		for (auto ovr : *blocks | agi::of_type<AssDialogueBlockOverride>()) {
 			// Verify that all overrides used are supported
 			for (auto const& tag : ovr->Tags) {
 				if (tag.Name.size() != 2)
@@ -474,7 +561,7 @@ bool SRTSubtitleFormat::CanSave(const AssFile *file) const {
 	return true;
 }
 
-std::string SRTSubtitleFormat::ConvertTags(const AssDialogue *diag) const {
+std::string SRTSubtitleFormat::ConvertTags(std::string const& text) const {
 	struct tag_state { char tag; bool value; };
 	tag_state tag_states[] = {
 		{'b', false},
@@ -483,8 +570,11 @@ std::string SRTSubtitleFormat::ConvertTags(const AssDialogue *diag) const {
 		{'u', false}
 	};
 
+	AssDialogue diag;
+	diag.Text = text;
+
 	std::string final;
-	for (auto& block : diag->ParseTags()) {
+	for (auto& block : diag.ParseTags()) {
 		switch (block->GetType()) {
 		case AssBlockType::OVERRIDE:
 			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
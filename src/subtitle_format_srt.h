@@ -34,10 +34,8 @@
 
 #include "subtitle_format.h"
 
-class AssDialogue;
-
 class SRTSubtitleFormat final : public SubtitleFormat {
-	std::string ConvertTags(const AssDialogue *diag) const;
+	std::string ConvertTags(std::string const& text) const;
 public:
 	SRTSubtitleFormat();
 	std::vector<std::string> GetReadWildcards() const override;
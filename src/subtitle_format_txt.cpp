@@ -73,11 +73,12 @@ void TXTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 	std::string actor;
 	std::string separator = OPT_GET("Tool/Import/Text/Actor Separator")->GetString();
 	std::string comment = OPT_GET("Tool/Import/Text/Comment Starter")->GetString();
+	bool include_blank = OPT_GET("Tool/Import/Text/Include Blank")->GetBool();
 
 	// Parse file
 	while (file.HasMoreLines()) {
 		std::string value = file.ReadLineFromFile();
-		if (value.empty() && !OPT_GET("Tool/Import/Text/Include Blank")->GetBool()) continue;
+		if (value.empty() && !include_blank) continue;
 
 		// Check if this isn't a timecodes file
 		if (boost::starts_with(value, "# timecode"))
@@ -139,19 +140,21 @@ void TXTSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& filen
 	file.WriteLineToFile(std::string("# Exported by Aegisub ") + GetAegisubShortVersionString());
 
 	// Write the file
+	std::string out_line;
 	for (auto const& dia : src->Events) {
-		std::string out_line;
+		std::string out_text = strip_formatting ? dia.GetStrippedText() : dia.Text;
+		if (out_text.empty()) continue;
 
+		out_line.clear();
 		if (dia.Comment)
 			out_line = "# ";
 
-		if (write_actors)
-			out_line += dia.Actor.get() + ": ";
+		if (write_actors) {
+			out_line += dia.Actor.get();
+			out_line += ": ";
+		}
 
-		std::string out_text = strip_formatting ? dia.GetStrippedText() : dia.Text;
 		out_line += out_text;
-
-		if (!out_text.empty())
-			file.WriteLineToFile(out_line);
+		file.WriteLineToFile(out_line);
 	}
 }
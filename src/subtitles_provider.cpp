@@ -25,6 +25,12 @@
 #include "options.h"
 #include "subtitles_provider_csri.h"
 #include "subtitles_provider_libass.h"
+#include "video_frame.h"
+
+#include <libaegisub/simd.h>
+
+#include <algorithm>
+#include <cmath>
 
 namespace {
 	struct factory {
@@ -87,7 +93,22 @@ void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
 	for (auto const& line : subs->Styles)
 		push_line(line.GetEntryData());
 
-	if (!subs->Attachments.empty()) {
+	std::string fonts;
+	for (auto const& attachment : subs->Attachments) {
+		if (attachment.Group() == AssEntryGroup::FONT)
+			fonts += attachment.GetFileName() + ":" + std::to_string(attachment.GetSize()) + "\n";
+	}
+	if (LoadsFonts()) {
+		// Decoding the fonts can take far longer than parsing the rest of
+		// the file, so only hand them over when they've changed
+		if (fonts != loaded_fonts) {
+			for (auto const& attachment : subs->Attachments)
+				if (attachment.Group() == AssEntryGroup::FONT)
+					AddFont(attachment);
+		}
+		loaded_fonts = std::move(fonts);
+	}
+	else if (!fonts.empty()) {
 		// TODO: some scripts may have a lot of attachments, 
 		// so ideally we'd want to write only those actually used on the requested video frame,
 		// but this would require some pre-parsing of the attached font files with FreeType,
@@ -99,10 +120,273 @@ void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
 	}
 
 	push_header("[Events]\n");
+	loaded_events.clear();
+	if (time < 0)
+		loaded_events.reserve(subs->Events.size());
+	int event = 0;
 	for (auto const& line : subs->Events) {
-		if (!line.Comment && (time < 0 || !(line.Start > time || line.End <= time)))
+		bool visible = !line.Comment && (time < 0 || !(line.Start > time || line.End <= time));
+		if (visible)
 			push_line(line.GetEntryData());
+		if (time < 0)
+			loaded_events.push_back(visible ? event++ : -1);
 	}
 
 	LoadSubtitles(&buffer[0], buffer.size());
 }
+
+std::vector<std::shared_ptr<const SubtitleOverlay>> SubtitlesProvider::RenderOverlays(int width, int height, std::vector<double> const& times) {
+	std::vector<std::shared_ptr<const SubtitleOverlay>> overlays;
+	for (double time : times) {
+		auto overlay = RenderOverlay(width, height, time);
+		if (!overlay) return {};
+		overlays.push_back(std::move(overlay));
+	}
+	return overlays;
+}
+
+namespace {
+/// x / 255 for x up to 255 * 255
+inline unsigned int Div255(unsigned int x) { return (x + 1 + (x >> 8)) >> 8; }
+
+/// Blend one pixel of a mask onto a BGRA pixel
+inline void BlendPixel(unsigned char *dst, unsigned int mask, unsigned int opacity, const unsigned int bgr[3]) {
+	const unsigned int k = Div255(mask * opacity);
+	const unsigned int ck = 255 - k;
+	dst[0] = Div255(k * bgr[0] + ck * dst[0]);
+	dst[1] = Div255(k * bgr[1] + ck * dst[1]);
+	dst[2] = Div255(k * bgr[2] + ck * dst[2]);
+	dst[3] = 0;
+}
+
+#ifdef AGI_SSE2
+inline __m128i Div255(__m128i x) {
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+/// Blend two pixels widened to 16 bits per channel, with each pixel's
+/// coverage repeated across its four channels
+inline __m128i BlendPixels(__m128i dst, __m128i k, __m128i color) {
+	const __m128i ck = _mm_sub_epi16(_mm_set1_epi16(255), k);
+	return Div255(_mm_add_epi16(_mm_mullo_epi16(k, color), _mm_mullo_epi16(ck, dst)));
+}
+
+/// Blend as much of a row as fits in blocks of 16 pixels
+/// @return Number of pixels blended
+int BlendRowSIMD(unsigned char *dst, const unsigned char *mask, int w, unsigned int opacity, const unsigned int bgr[3]) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i op = _mm_set1_epi16(static_cast<short>(opacity));
+	const __m128i color = _mm_setr_epi16(bgr[0], bgr[1], bgr[2], 0, bgr[0], bgr[1], bgr[2], 0);
+	const __m128i no_alpha = _mm_set1_epi32(0x00FFFFFF);
+
+	int x = 0;
+	for (; x + 16 <= w; x += 16) {
+		const __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask + x));
+		// Most of the area of most images is fully transparent
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(m, zero)) == 0xFFFF) continue;
+
+		const __m128i k8[2] = {
+			Div255(_mm_mullo_epi16(_mm_unpacklo_epi8(m, zero), op)),
+			Div255(_mm_mullo_epi16(_mm_unpackhi_epi8(m, zero), op))
+		};
+		for (int i = 0; i < 4; ++i) {
+			auto p = reinterpret_cast<__m128i *>(dst + (x + i * 4) * 4);
+			const __m128i px = _mm_loadu_si128(p);
+			const __m128i k4 = i % 2 ? _mm_unpackhi_epi16(k8[i / 2], k8[i / 2]) : _mm_unpacklo_epi16(k8[i / 2], k8[i / 2]);
+			const __m128i lo = BlendPixels(_mm_unpacklo_epi8(px, zero), _mm_unpacklo_epi32(k4, k4), color);
+			const __m128i hi = BlendPixels(_mm_unpackhi_epi8(px, zero), _mm_unpackhi_epi32(k4, k4), color);
+			_mm_storeu_si128(p, _mm_and_si128(_mm_packus_epi16(lo, hi), no_alpha));
+		}
+	}
+	return x;
+}
+#elif defined(AGI_NEON)
+inline uint16x8_t Div255(uint16x8_t x) {
+	return vshrq_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)), 8);
+}
+
+inline uint8x8_t BlendChannel(uint8x8_t dst, uint8x8_t k, uint8x8_t ck, uint8x8_t color) {
+	return vmovn_u16(Div255(vmlal_u8(vmull_u8(k, color), ck, dst)));
+}
+
+int BlendRowSIMD(unsigned char *dst, const unsigned char *mask, int w, unsigned int opacity, const unsigned int bgr[3]) {
+	const uint8x8_t op = vdup_n_u8(static_cast<uint8_t>(opacity));
+	const uint8x8_t b = vdup_n_u8(static_cast<uint8_t>(bgr[0]));
+	const uint8x8_t g = vdup_n_u8(static_cast<uint8_t>(bgr[1]));
+	const uint8x8_t r = vdup_n_u8(static_cast<uint8_t>(bgr[2]));
+	const uint8x8_t full = vdup_n_u8(255);
+
+	int x = 0;
+	for (; x + 16 <= w; x += 16) {
+		const uint8x16_t m = vld1q_u8(mask + x);
+		// Most of the area of most images is fully transparent
+		if (vmaxvq_u8(m) == 0) continue;
+
+		const uint8x8_t halves[2] = {vget_low_u8(m), vget_high_u8(m)};
+		for (int i = 0; i < 2; ++i) {
+			unsigned char *p = dst + (x + i * 8) * 4;
+			const uint8x8_t k = vmovn_u16(Div255(vmull_u8(halves[i], op)));
+			const uint8x8_t ck = vsub_u8(full, k);
+			uint8x8x4_t px = vld4_u8(p);
+			px.val[0] = BlendChannel(px.val[0], k, ck, b);
+			px.val[1] = BlendChannel(px.val[1], k, ck, g);
+			px.val[2] = BlendChannel(px.val[2], k, ck, r);
+			px.val[3] = vdup_n_u8(0);
+			vst4_u8(p, px);
+		}
+	}
+	return x;
+}
+#else
+int BlendRowSIMD(unsigned char *, const unsigned char *, int, unsigned int, const unsigned int *) {
+	return 0;
+}
+#endif
+}
+
+void SubtitleOverlay::Blend(VideoFrame &frame) const {
+	FrameRect all;
+	all.w = width;
+	all.h = height;
+	Blend(frame, all);
+}
+
+void SubtitleOverlay::Blend(VideoFrame &frame, FrameRect const& area) const {
+	for (auto const& img : images) {
+		const int x0 = std::max(img.x, area.x);
+		const int x1 = std::min(img.x + img.w, area.x + area.w);
+		const int y0 = std::max(img.y, area.y);
+		const int y1 = std::min(img.y + img.h, area.y + area.h);
+		if (x0 >= x1 || y0 >= y1) continue;
+
+		const unsigned int opacity = 255 - (img.color & 0xFF);
+		const unsigned int bgr[3] = {
+			(img.color >> 8) & 0xFF,
+			(img.color >> 16) & 0xFF,
+			img.color >> 24
+		};
+
+		const int w = x1 - x0;
+		for (int y = y0; y < y1; ++y) {
+			const int row = frame.flipped ? frame.height - 1 - y : y;
+			unsigned char *dst = &frame.data[row * frame.pitch + x0 * 4];
+			const unsigned char *mask = &img.mask[(y - img.y) * img.w + x0 - img.x];
+
+			// Fully transparent pixels are left alone, including their
+			// unused alpha
+			for (int x = BlendRowSIMD(dst, mask, w, opacity, bgr); x < w; ++x) {
+				if (mask[x])
+					BlendPixel(dst + x * 4, mask[x], opacity, bgr);
+			}
+		}
+	}
+}
+
+FrameRect SubtitleOverlay::ChangedArea(SubtitleOverlay const& other) const {
+	// libass gives the images of each line together, so changing one line
+	// leaves a run of images in the middle which differ and the same images
+	// before and after it. Only the middle has to be drawn again, and the
+	// images on either side keep their order relative to everything else.
+	auto same = [](Image const& a, Image const& b) {
+		return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h
+			&& a.color == b.color && a.mask == b.mask;
+	};
+
+	size_t prefix = 0;
+	const size_t shorter = std::min(images.size(), other.images.size());
+	while (prefix < shorter && same(images[prefix], other.images[prefix]))
+		++prefix;
+	size_t suffix = 0;
+	while (suffix < shorter - prefix && same(images[images.size() - 1 - suffix], other.images[other.images.size() - 1 - suffix]))
+		++suffix;
+
+	int x0 = width, y0 = height, x1 = 0, y1 = 0;
+	auto add = [&](std::vector<Image> const& list) {
+		for (size_t i = prefix; i < list.size() - suffix; ++i) {
+			x0 = std::min(x0, list[i].x);
+			y0 = std::min(y0, list[i].y);
+			x1 = std::max(x1, list[i].x + list[i].w);
+			y1 = std::max(y1, list[i].y + list[i].h);
+		}
+	};
+	add(images);
+	add(other.images);
+
+	FrameRect area;
+	area.x = std::max(x0, 0);
+	area.y = std::max(y0, 0);
+	area.w = std::min(x1, width) - area.x;
+	area.h = std::min(y1, height) - area.y;
+	return area;
+}
+
+namespace {
+/// The source pixel to the left of (or above) each destination pixel in a
+/// range, and the weight of the one after it out of 256
+struct Tap {
+	int index;
+	unsigned int weight;
+};
+
+std::vector<Tap> Taps(int dst_begin, int count, int src_begin, double step) {
+	std::vector<Tap> taps(count);
+	for (int i = 0; i < count; ++i) {
+		// Pixel centers are at +0.5 in both
+		const double pos = (dst_begin + i + .5) * step - .5 - src_begin;
+		const double index = std::floor(pos);
+		taps[i].index = static_cast<int>(index);
+		taps[i].weight = static_cast<unsigned int>((pos - index) * 256 + .5);
+	}
+	return taps;
+}
+}
+
+std::shared_ptr<SubtitleOverlay> SubtitleOverlay::Upscale(int new_width, int new_height) const {
+	auto ret = std::make_shared<SubtitleOverlay>();
+	ret->width = new_width;
+	ret->height = new_height;
+	ret->provisional = provisional;
+	ret->scale = scale * width / new_width;
+	ret->images.reserve(images.size());
+
+	const double step_x = static_cast<double>(width) / new_width;
+	const double step_y = static_cast<double>(height) / new_height;
+
+	for (auto const& img : images) {
+		Image out;
+		out.color = img.color;
+		// Filtering spreads the edges out by half a source pixel
+		out.x = std::max(0, static_cast<int>(std::floor((img.x - .5) / step_x)));
+		out.y = std::max(0, static_cast<int>(std::floor((img.y - .5) / step_y)));
+		out.w = std::min(new_width, static_cast<int>(std::ceil((img.x + img.w + .5) / step_x))) - out.x;
+		out.h = std::min(new_height, static_cast<int>(std::ceil((img.y + img.h + .5) / step_y))) - out.y;
+		if (out.w <= 0 || out.h <= 0) continue;
+
+		auto cols = Taps(out.x, out.w, img.x, step_x);
+		auto rows = Taps(out.y, out.h, img.y, step_y);
+
+		// Samples outside of the image are transparent
+		auto sample = [&](int x, int y) -> unsigned int {
+			return x >= 0 && x < img.w && y >= 0 && y < img.h ? img.mask[y * img.w + x] : 0;
+		};
+
+		out.mask.resize(out.w * out.h);
+		unsigned char *dst = out.mask.data();
+		for (auto const& row : rows) {
+			for (auto const& col : cols) {
+				const unsigned int top = sample(col.index, row.index) * (256 - col.weight) + sample(col.index + 1, row.index) * col.weight;
+				const unsigned int bottom = sample(col.index, row.index + 1) * (256 - col.weight) + sample(col.index + 1, row.index + 1) * col.weight;
+				*dst++ = static_cast<unsigned char>((top * (256 - row.weight) + bottom * row.weight + (1 << 15)) >> 16);
+			}
+		}
+		ret->images.push_back(std::move(out));
+	}
+	return ret;
+}
+
+size_t SubtitleOverlay::GetSize() const {
+	size_t size = sizeof(*this);
+	for (auto const& img : images)
+		size += sizeof(img) + img.mask.size();
+	return size;
+}
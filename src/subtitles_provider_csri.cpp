@@ -35,12 +35,17 @@
 #ifdef WITH_CSRI
 #include "subtitles_provider_csri.h"
 
+#include "ass_dialogue.h"
 #include "include/aegisub/subtitles_provider.h"
 #include "subtitle_format_ass.h"
 #include "video_frame.h"
 
+#include <libaegisub/ass/time.h>
 #include <libaegisub/make_unique.h>
 
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstring>
 #include <mutex>
 
 #ifdef WIN32
@@ -48,6 +53,7 @@
 #endif
 
 #include <csri/csri.h>
+#include <csri/stream.h>
 
 namespace {
 // CSRI renderers are not required to be thread safe (and VSFilter very much
@@ -58,18 +64,71 @@ struct closer {
 	void operator()(csri_inst *inst) { if (inst) csri_close(inst); }
 };
 
+/// A line of the script in Matroska's ASS packet format
+struct Packet {
+	std::string data;
+	double start;
+	double end;
+};
+
+/// @brief Convert a Dialogue line to a stream packet
+/// @return Was the line a Dialogue line?
+bool make_packet(std::string const& line, int read_order, Packet &out) {
+	if (!boost::starts_with(line, "Dialogue: ")) return false;
+
+	// Dialogue: Layer,Start,End,Style,Name,MarginL,MarginR,MarginV,Effect,Text
+	// becomes ReadOrder,Layer,Style,Name,MarginL,MarginR,MarginV,Effect,Text
+	// with the times passed separately
+	size_t layer = strlen("Dialogue: ");
+	size_t start = line.find(',', layer);
+	if (start == std::string::npos) return false;
+	size_t end = line.find(',', start + 1);
+	if (end == std::string::npos) return false;
+	size_t rest = line.find(',', end + 1);
+	if (rest == std::string::npos) return false;
+
+	out.data = std::to_string(read_order) + "," + line.substr(layer, start - layer) + line.substr(rest);
+	out.start = agi::Time(line.substr(start + 1, end - start - 1)) / 1000.;
+	out.end = agi::Time(line.substr(end + 1, rest - end - 1)) / 1000.;
+	return true;
+}
+
 class CSRISubtitlesProvider final : public SubtitlesProvider {
 	std::unique_ptr<csri_inst, closer> instance;
 	csri_rend *renderer = nullptr;
+	/// Streaming interface, if the renderer supports the ASS stream extension
+	/// with explicitly discarded packets
+	csri_stream_ext *stream = nullptr;
+
+	/// Script to load before the next frame is drawn. Loading is put off
+	/// until then so that several changes in a row only reload once.
+	std::vector<char> pending;
+	bool reload = false;
+
+	/// Script header the stream instance was created with
+	std::string header;
+	/// Lines of the script in the stream instance, by event index
+	std::vector<Packet> packets;
+	/// Have packets changed since they were pushed to the stream instance?
+	bool repush = false;
 
 	void LoadSubtitles(const char *data, size_t len) override {
 		std::lock_guard<std::mutex> lock(csri_mutex);
-		instance.reset(csri_open_mem(renderer, data, len, nullptr));
+		pending.assign(data, data + len);
+		reload = true;
 	}
 
+	/// Load any changes to the script into the renderer
+	void Apply();
+	/// Load the pending script into a stream instance
+	void ApplyStream();
+	/// Push all of the packets to the stream instance
+	void PushPackets();
+
 public:
 	CSRISubtitlesProvider(std::string subType);
 
+	bool UpdateLine(int row, AssDialogue const& line) override;
 	void DrawSubtitles(VideoFrame &dst, double time) override;
 };
 
@@ -84,11 +143,87 @@ CSRISubtitlesProvider::CSRISubtitlesProvider(std::string type) {
 
 	if (!renderer)
 		throw agi::InternalError("CSRI renderer vanished between initial list and creation?");
+
+	// Replacing a line in a stream means discarding every packet and pushing
+	// them again, so the renderer has to support keeping packets until then
+	auto ext = static_cast<csri_stream_ext *>(csri_query_ext(renderer, CSRI_EXT_STREAM_ASS));
+	if (ext && ext->init_stream && ext->push_packet && ext->discard && csri_query_ext(renderer, CSRI_EXT_STREAM_DISCARD))
+		stream = ext;
 }
 
-void CSRISubtitlesProvider::DrawSubtitles(VideoFrame &dst, double time) {
-	if (!instance) return;
+void CSRISubtitlesProvider::Apply() {
+	if (reload) {
+		reload = false;
+		if (stream)
+			ApplyStream();
+		else
+			instance.reset(csri_open_mem(renderer, pending.data(), pending.size(), nullptr));
+		pending.clear();
+	}
+	if (repush)
+		PushPackets();
+}
+
+void CSRISubtitlesProvider::ApplyStream() {
+	// The stream header is everything up to the events, which are turned
+	// into packets
+	static const char events_header[] = "[Events]\n";
+	auto events = std::search(pending.begin(), pending.end(), events_header, events_header + strlen(events_header));
+	std::string new_header(pending.begin(), events);
+	new_header += "[Events]\nFormat: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
 
+	packets.clear();
+	auto it = events == pending.end() ? events : events + strlen(events_header);
+	while (it != pending.end()) {
+		auto eol = std::find(it, pending.end(), '\n');
+		Packet packet;
+		if (make_packet(std::string(it, eol), (int)packets.size(), packet))
+			packets.push_back(std::move(packet));
+		it = eol == pending.end() ? eol : eol + 1;
+	}
+
+	// Only the events changed, so keep the instance and its parsed styles
+	if (instance && new_header == header) {
+		repush = true;
+		return;
+	}
+
+	header = std::move(new_header);
+	csri_stream_discard_flag lifetime = { CSRI_STREAM_DISCARD_EXPLICIT };
+	csri_openflag flag;
+	flag.name = CSRI_EXT_STREAM_DISCARD;
+	flag.data.otherval = &lifetime;
+	flag.next = nullptr;
+	instance.reset(stream->init_stream(renderer, header.data(), header.size(), &flag));
+	repush = !!instance;
+}
+
+void CSRISubtitlesProvider::PushPackets() {
+	repush = false;
+	stream->discard(instance.get(), 1);
+	for (auto const& packet : packets)
+		stream->push_packet(instance.get(), packet.data.data(), packet.data.size(), packet.start, packet.end);
+}
+
+bool CSRISubtitlesProvider::UpdateLine(int row, AssDialogue const& line) {
+	if (!stream || row < 0 || row >= (int)loaded_events.size()) return false;
+
+	// Commenting or uncommenting a line changes which events exist
+	const int event = loaded_events[row];
+	if (line.Comment)
+		return event < 0;
+
+	std::lock_guard<std::mutex> lock(csri_mutex);
+	if (reload || !instance || event < 0 || event >= (int)packets.size())
+		return false;
+
+	if (!make_packet(line.GetEntryData(), event, packets[event]))
+		return false;
+	repush = true;
+	return true;
+}
+
+void CSRISubtitlesProvider::DrawSubtitles(VideoFrame &dst, double time) {
 	csri_frame frame;
 	if (dst.flipped) {
 		frame.planes[0] = dst.data.data() + (dst.height-1) * dst.width * 4;
@@ -103,6 +238,8 @@ void CSRISubtitlesProvider::DrawSubtitles(VideoFrame &dst, double time) {
 	csri_fmt format = { frame.pixfmt, dst.width, dst.height };
 
 	std::lock_guard<std::mutex> lock(csri_mutex);
+	Apply();
+	if (!instance) return;
 	if (!csri_request_fmt(instance.get(), &format))
 		csri_render(instance.get(), &frame, time);
 }
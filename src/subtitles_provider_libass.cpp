@@ -34,6 +34,8 @@
 
 #include "subtitles_provider_libass.h"
 
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
 #include "compat.h"
 #include "include/aegisub/subtitles_provider.h"
 #include "video_frame.h"
@@ -43,16 +45,18 @@
 #include <libaegisub/exception.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
 #include <atomic>
-#if BOOST_VERSION >= 106900
-#include <boost/gil.hpp>
-#else
-#include <boost/gil/gil_all.hpp>
-#endif
+#include <condition_variable>
+#include <cstring>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_set>
 
 #include <wx/intl.h>
 #include <wx/thread.h>
@@ -80,22 +84,114 @@ void msg_callback(int level, const char *fmt, va_list args, void *) {
 		LOG_D("subtitle/provider/libass") << buf;
 }
 
+/// Guards adding fonts to the library against renderers reading the
+/// library's fonts at the start of each frame. Any number of renders can run
+/// at once, while adding a font waits for them all to finish.
+struct {
+	std::mutex mutex;
+	std::condition_variable idle;
+	int renders = 0;
+	/// Hashes of the attachments which have been added to the library
+	std::unordered_set<size_t> added;
+	/// Total size of the fonts which have been added to the library, which
+	/// keeps its own copy of each for as long as the program runs
+	std::atomic<size_t> size{0};
+} fonts;
+
+/// libass doesn't report the size of its glyph and bitmap caches, so only
+/// the fonts added to it are counted
+agi::memory::Registration font_registration;
+
+/// Holds off adding fonts while rendering
+struct render_lock {
+	render_lock() {
+		std::lock_guard<std::mutex> lock(fonts.mutex);
+		++fonts.renders;
+	}
+	~render_lock() {
+		std::lock_guard<std::mutex> lock(fonts.mutex);
+		if (--fonts.renders == 0)
+			fonts.idle.notify_all();
+	}
+};
+
 // Stuff used on the cache thread, owned by a shared_ptr in case the provider
 // gets deleted before the cache finishing updating
 struct cache_thread_shared {
 	ASS_Renderer *renderer = nullptr;
 	std::atomic<bool> ready{false};
+	/// Guards on_ready
+	std::mutex mutex;
+	/// Called on the cache thread once renderer is ready
+	std::function<void()> on_ready;
 	~cache_thread_shared() { if (renderer) ass_renderer_done(renderer); }
 };
 
+/// Most threads to render with at once, including the calling thread
+const size_t max_render_threads = 8;
+
+/// An extra renderer for rendering several times at once, along with the
+/// thread which it's used on
+struct render_worker {
+	std::unique_ptr<agi::dispatch::Queue> queue = agi::dispatch::Create();
+	ASS_Renderer *renderer = nullptr;
+
+	render_worker() {
+		renderer = ass_renderer_init(library);
+		if (renderer) {
+			ass_set_font_scale(renderer, 1.);
+			ass_set_fonts(renderer, nullptr, "Sans", 1, nullptr, true);
+		}
+	}
+
+	~render_worker() {
+		queue->Sync([] { }, agi::dispatch::Priority::Background);
+		if (renderer) ass_renderer_done(renderer);
+	}
+};
+
+/// Copy libass's images into an overlay, as they only live until the next
+/// render, without the padding at the end of each row
+std::shared_ptr<SubtitleOverlay> copy_images(ASS_Image *img, int width, int height) {
+	auto overlay = std::make_shared<SubtitleOverlay>();
+	overlay->width = width;
+	overlay->height = height;
+	for (; img; img = img->next) {
+		if (img->w == 0 || img->h == 0) continue;
+
+		SubtitleOverlay::Image image{img->dst_x, img->dst_y, img->w, img->h, img->color, {}};
+		image.mask.resize(img->w * img->h);
+		for (int y = 0; y < img->h; ++y)
+			memcpy(&image.mask[y * img->w], img->bitmap + y * img->stride, img->w);
+		overlay->images.push_back(std::move(image));
+	}
+	return overlay;
+}
+
 class LibassSubtitlesProvider final : public SubtitlesProvider {
 	agi::BackgroundRunner *br;
 	std::shared_ptr<cache_thread_shared> shared;
 	ASS_Track* ass_track = nullptr;
+	/// Last overlay rendered, returned again if libass reports that nothing
+	/// has changed since
+	std::shared_ptr<const SubtitleOverlay> last_overlay;
+	/// Extra renderers for RenderOverlays, created the first time it's used
+	std::vector<std::unique_ptr<render_worker>> workers;
+	/// Renderer without any system fonts, used until fontconfig has finished
+	/// scanning them so that the first frames don't have to wait for it.
+	/// It can still use the fonts attached to the script.
+	ASS_Renderer *fallback = nullptr;
 
 	ASS_Renderer *renderer() {
-		if (shared->ready)
-			return shared->renderer;
+		return shared->ready ? shared->renderer : fallback;
+	}
+
+public:
+	LibassSubtitlesProvider(agi::BackgroundRunner *br);
+	~LibassSubtitlesProvider();
+
+	void WaitUntilReady() override {
+		if (shared->ready) return;
 
 		auto block = [&] {
 			if (shared->ready)
@@ -116,12 +212,18 @@ class LibassSubtitlesProvider final : public SubtitlesProvider {
 			block();
 		else
 			agi::dispatch::Main().Sync(block);
-		return shared->renderer;
 	}
 
-public:
-	LibassSubtitlesProvider(agi::BackgroundRunner *br);
-	~LibassSubtitlesProvider();
+	void NotifyWhenReady(std::function<void()> callback) override {
+		{
+			std::lock_guard<std::mutex> lock(shared->mutex);
+			if (!shared->ready) {
+				shared->on_ready = std::move(callback);
+				return;
+			}
+		}
+		callback();
+	}
 
 	void LoadSubtitles(const char *data, size_t len) override {
 		if (ass_track) ass_free_track(ass_track);
@@ -129,7 +231,13 @@ public:
 		if (!ass_track) throw agi::InternalError("libass failed to load subtitles.");
 	}
 
+	bool LoadsFonts() const override { return true; }
+	void AddFont(AssAttachment const& font) override;
+	bool UpdateLine(int row, AssDialogue const& line) override;
+
 	void DrawSubtitles(VideoFrame &dst, double time) override;
+	std::shared_ptr<const SubtitleOverlay> RenderOverlay(int width, int height, double time) override;
+	std::vector<std::shared_ptr<const SubtitleOverlay>> RenderOverlays(int width, int height, std::vector<double> const& times) override;
 
 	void Reinitialize() override {
 		// No need to reinit if we're not even done with the initial init
@@ -138,6 +246,8 @@ public:
 
 		ass_renderer_done(shared->renderer);
 		shared->renderer = ass_renderer_init(library);
+		last_overlay.reset();
+		workers.clear();
 		ass_set_font_scale(shared->renderer, 1.);
 		ass_set_fonts(shared->renderer, nullptr, "Sans", 1, nullptr, true);
 	}
@@ -156,53 +266,172 @@ LibassSubtitlesProvider::LibassSubtitlesProvider(agi::BackgroundRunner *br)
 		}
 		state->renderer = ass_renderer;
 		state->ready = true;
+
+		std::function<void()> on_ready;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			on_ready.swap(state->on_ready);
+		}
+		if (on_ready)
+			on_ready();
 	});
+
+	// Not using fontconfig makes this fast enough to do here
+	if (!shared->ready) {
+		fallback = ass_renderer_init(library);
+		if (fallback) {
+			ass_set_font_scale(fallback, 1.);
+			ass_set_fonts(fallback, nullptr, "Sans", 0, nullptr, false);
+		}
+	}
 }
 
 LibassSubtitlesProvider::~LibassSubtitlesProvider() {
 	if (ass_track) ass_free_track(ass_track);
+	if (fallback) ass_renderer_done(fallback);
 }
 
-#define _r(c) ((c)>>24)
-#define _g(c) (((c)>>16)&0xFF)
-#define _b(c) (((c)>>8)&0xFF)
-#define _a(c) ((c)&0xFF)
+bool LibassSubtitlesProvider::UpdateLine(int row, AssDialogue const& line) {
+	if (!ass_track || row < 0 || row >= (int)loaded_events.size()) return false;
+
+	// Lines being commented or uncommented change which events exist, which
+	// isn't worth handling here as it's rare compared to editing a line
+	const int event = loaded_events[row];
+	if (line.Comment)
+		return event < 0;
+	if (event < 0 || event >= ass_track->n_events)
+		return false;
+
+	// libass has no way to parse a line into an existing event, so parse it
+	// as a new event at the end of the track and then move it into place
+	auto data = line.GetEntryData() + "\n";
+	const int count = ass_track->n_events;
+	ass_process_data(ass_track, &data[0], data.size());
+	if (ass_track->n_events != count + 1) return false;
+
+	ASS_Event parsed = ass_track->events[count];
+	parsed.ReadOrder = ass_track->events[event].ReadOrder;
+	ass_free_event(ass_track, event);
+	ass_track->events[event] = parsed;
+	--ass_track->n_events;
+
+	return true;
+}
 
-void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
-	ass_set_frame_size(renderer(), frame.width, frame.height);
+void LibassSubtitlesProvider::AddFont(AssAttachment const& font) {
+	// Fonts are added to the library, which outlives every provider, so
+	// each font only has to be decoded once no matter how many times it's
+	// loaded
+	const size_t hash = std::hash<std::string>()(font.GetEntryData());
+	{
+		std::lock_guard<std::mutex> lock(fonts.mutex);
+		if (fonts.added.count(hash)) return;
+	}
 
-	ASS_Image* img = ass_render_frame(renderer(), ass_track, int(time * 1000), nullptr);
+	auto data = font.GetData();
+	if (data.empty()) return;
+	auto name = font.GetFileName();
 
-	// libass actually returns several alpha-masked monochrome images.
-	// Here, we loop through their linked list, get the colour of the current, and blend into the frame.
-	// This is repeated for all of them.
+	std::unique_lock<std::mutex> lock(fonts.mutex);
+	fonts.idle.wait(lock, [] { return fonts.renders == 0; });
+	if (fonts.added.insert(hash).second) {
+		ass_add_font(library, &name[0], &data[0], (int)data.size());
+		fonts.size += data.size();
+	}
+}
 
-	using namespace boost::gil;
-	auto dst = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.width * 4);
-	if (frame.flipped)
-		dst = flipped_up_down_view(dst);
+std::shared_ptr<const SubtitleOverlay> LibassSubtitlesProvider::RenderOverlay(int width, int height, double time) {
+	auto r = renderer();
+	// Without a fallback there's nothing to render with until fontconfig
+	// is done
+	if (!r) {
+		WaitUntilReady();
+		r = shared->renderer;
+	}
+	const bool provisional = r == fallback;
+	ass_set_frame_size(r, width, height);
+
+	render_lock lock;
+	int changed = 2;
+	ASS_Image* img = ass_render_frame(r, ass_track, int(time * 1000), &changed);
+
+	// Moving between frames where the same lines are visible and static
+	// doesn't need the images to be copied again
+	if (!changed && last_overlay && last_overlay->width == width && last_overlay->height == height && last_overlay->provisional == provisional)
+		return last_overlay;
+
+	auto overlay = copy_images(img, width, height);
+	overlay->provisional = provisional;
+	last_overlay = overlay;
+	return last_overlay;
+}
 
-	for (; img; img = img->next) {
-		unsigned int opacity = 255 - ((unsigned int)_a(img->color));
-		unsigned int r = (unsigned int)_r(img->color);
-		unsigned int g = (unsigned int)_g(img->color);
-		unsigned int b = (unsigned int)_b(img->color);
-
-		auto srcview = interleaved_view(img->w, img->h, (gray8_pixel_t*)img->bitmap, img->stride);
-		auto dstview = subimage_view(dst, img->dst_x, img->dst_y, img->w, img->h);
-
-		transform_pixels(dstview, srcview, dstview, [=](const bgra8_pixel_t frame, const gray8_pixel_t src) -> bgra8_pixel_t {
-			unsigned int k = ((unsigned)src) * opacity / 255;
-			unsigned int ck = 255 - k;
-
-			bgra8_pixel_t ret;
-			ret[0] = (k * b + ck * frame[0]) / 255;
-			ret[1] = (k * g + ck * frame[1]) / 255;
-			ret[2] = (k * r + ck * frame[2]) / 255;
-			ret[3] = 0;
-			return ret;
+std::vector<std::shared_ptr<const SubtitleOverlay>> LibassSubtitlesProvider::RenderOverlays(int width, int height, std::vector<double> const& times) {
+	std::vector<std::shared_ptr<const SubtitleOverlay>> overlays(times.size());
+	if (times.empty()) return overlays;
+
+	// Rendering the first time on the main renderer waits for the font
+	// cache and lets libass finish its lazy setup of the track, after which
+	// rendering only reads the track and the renderers can share it
+	overlays[0] = RenderOverlay(width, height, times[0]);
+
+	// The extra renderers use fontconfig, so they'd have to wait for it
+	const size_t threads = !shared->ready ? 1 : std::min({max_render_threads, times.size() - 1,
+		std::max<size_t>(1, std::thread::hardware_concurrency())});
+	if (threads <= 1) {
+		for (size_t i = 1; i < times.size(); ++i)
+			overlays[i] = RenderOverlay(width, height, times[i]);
+		return overlays;
+	}
+
+	while (workers.size() < threads - 1)
+		workers.push_back(agi::make_unique<render_worker>());
+
+	// Each renderer gets a consecutive run of times so that its caches are
+	// reused between the similar frames
+	const size_t per_thread = (times.size() - 1 + threads - 1) / threads;
+	std::mutex mutex;
+	std::condition_variable done;
+	size_t remaining = threads - 1;
+
+	for (size_t t = 1; t < threads; ++t) {
+		const size_t begin = std::min(times.size(), 1 + t * per_thread);
+		const size_t end = std::min(times.size(), begin + per_thread);
+		auto renderer = workers[t - 1]->renderer;
+		workers[t - 1]->queue->Async([&, renderer, begin, end] {
+			if (renderer) {
+				render_lock lock;
+				ass_set_frame_size(renderer, width, height);
+				for (size_t i = begin; i < end; ++i) {
+					int changed;
+					auto img = ass_render_frame(renderer, ass_track, int(times[i] * 1000), &changed);
+					overlays[i] = copy_images(img, width, height);
+				}
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--remaining == 0)
+				done.notify_one();
 		});
 	}
+
+	for (size_t i = 1; i < std::min(times.size(), 1 + per_thread); ++i)
+		overlays[i] = RenderOverlay(width, height, times[i]);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&] { return remaining == 0; });
+	lock.unlock();
+
+	// Workers which failed to create a renderer leave their times to be
+	// rendered here
+	for (size_t i = 1; i < times.size(); ++i) {
+		if (!overlays[i])
+			overlays[i] = RenderOverlay(width, height, times[i]);
+	}
+	return overlays;
+}
+
+void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
+	RenderOverlay(frame.width, frame.height, time)->Blend(frame);
 }
 }
 
@@ -218,6 +447,7 @@ void CacheFonts() {
 	// Initialize libass
 	library = ass_library_init();
 	ass_set_message_cb(library, msg_callback, nullptr);
+	font_registration = agi::memory::Register("libass fonts", [] { return fonts.size.load(); });
 
 	// Initialize a renderer to force fontconfig to update its cache
 	cache_queue->Async([] {
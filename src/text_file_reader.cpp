@@ -21,13 +21,19 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
-#include <boost/interprocess/streams/bufferstream.hpp>
+
+namespace {
+std::unique_ptr<agi::buffer_lines> split_lines(agi::read_file_mapping& file, std::string const& encoding) {
+	const char *data = file.size() ? file.read() : nullptr;
+	return agi::make_unique<agi::buffer_lines>(data, data + file.size(), encoding);
+}
+}
 
 TextFileReader::TextFileReader(agi::fs::path const& filename, std::string encoding, bool trim)
 : file(agi::make_unique<agi::read_file_mapping>(filename))
-, stream(agi::make_unique<boost::interprocess::ibufferstream>(file->read(), file->size()))
+, lines(split_lines(*file, encoding))
 , trim(trim)
-, iter(agi::line_iterator<std::string>(*stream, encoding))
+, iter(lines->begin())
 {
 }
 
@@ -35,7 +41,7 @@ TextFileReader::~TextFileReader() {
 }
 
 std::string TextFileReader::ReadLineFromFile() {
-	std::string str = *iter;
+	std::string str(iter->begin(), iter->end());
 	++iter;
 	if (trim)
 		boost::trim(str);
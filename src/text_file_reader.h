@@ -14,12 +14,11 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
-#include <iosfwd>
 #include <memory>
 #include <string>
 
+#include <libaegisub/buffer_lines.h>
 #include <libaegisub/fs_fwd.h>
-#include <libaegisub/line_iterator.h>
 
 namespace agi { class read_file_mapping; }
 
@@ -27,9 +26,9 @@ namespace agi { class read_file_mapping; }
 /// @brief A line-based text file reader
 class TextFileReader {
 	std::unique_ptr<agi::read_file_mapping> file;
-	std::unique_ptr<std::istream> stream;
+	std::unique_ptr<agi::buffer_lines> lines;
 	bool trim;
-	agi::line_iterator<std::string> iter;
+	agi::buffer_line_iterator iter;
 
 public:
 	/// @brief Constructor
@@ -44,5 +43,5 @@ public:
 	/// @return The line, possibly trimmed
 	std::string ReadLineFromFile();
 	/// @brief Check if there are any more lines to read
-	bool HasMoreLines() const { return iter != agi::line_iterator<std::string>(); }
+	bool HasMoreLines() const { return iter != lines->end(); }
 };
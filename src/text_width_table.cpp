@@ -0,0 +1,64 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include "text_width_table.h"
+
+#include "auto4_base.h"
+
+#include <algorithm>
+
+TextWidthTable::TextWidthTable(AssStyle const& style)
+: style(style)
+{
+	ascii_widths.fill(-1);
+}
+
+double TextWidthTable::Measure(std::string const& character) {
+	double width, height, descent, extlead;
+	if (!Automation4::CalculateTextExtents(&style, character, width, height, descent, extlead))
+		return 0;
+	return width;
+}
+
+double TextWidthTable::GetWidth(std::string const& text) {
+	double width = 0;
+	for (size_t i = 0; i < text.size(); ) {
+		unsigned char lead = text[i];
+		if (lead < 0x80) {
+			auto& char_width = ascii_widths[lead];
+			if (char_width < 0)
+				char_width = Measure(std::string(1, lead));
+			width += char_width;
+			++i;
+			continue;
+		}
+
+		// The bytes of the character are its key, so there's no need to
+		// decode it
+		size_t len = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+		len = std::min(len, text.size() - i);
+		uint32_t key = 0;
+		for (size_t j = 0; j < len; ++j)
+			key = (key << 8) | static_cast<unsigned char>(text[i + j]);
+
+		auto it = widths.find(key);
+		if (it == widths.end())
+			it = widths.emplace(key, Measure(text.substr(i, len))).first;
+		width += it->second;
+		i += len;
+	}
+	return width;
+}
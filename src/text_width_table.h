@@ -0,0 +1,49 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#pragma once
+
+#include "ass_style.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/// @class TextWidthTable
+/// @brief Cached widths of the characters in a style's font
+///
+/// Each character is measured once, and the width of a piece of text is
+/// the sum of the widths of its characters. This ignores kerning, so it's
+/// an estimate, but it's much faster than measuring each line through the
+/// platform's text layout when checking every line in a file.
+class TextWidthTable {
+	AssStyle style;
+
+	/// Widths of the ASCII characters, or negative if not yet measured
+	std::array<double, 128> ascii_widths;
+	/// Widths of other characters, keyed by their UTF-8 bytes
+	std::unordered_map<uint32_t, double> widths;
+
+	double Measure(std::string const& character);
+
+public:
+	TextWidthTable(AssStyle const& style);
+
+	/// Get the width of a piece of text in script pixels
+	/// @param text Text with no override blocks or line breaks
+	double GetWidth(std::string const& text);
+};
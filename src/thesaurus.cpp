@@ -98,12 +98,14 @@ void Thesaurus::OnLanguageChanged() {
 
 	LOG_I("thesaurus/file") << "Using thesaurus: " << dat;
 
+	auto cache = config::path->Decode("?local/thesaurus")/agi::format("th_%s.idx.cache", language);
+
 	if (cancel_load) *cancel_load = true;
 	cancel_load = new bool{false};
 	auto cancel = cancel_load; // Needed to avoid capturing via `this`
 	agi::dispatch::Background().Async([=]{
 		try {
-			auto thes = agi::make_unique<agi::Thesaurus>(dat, idx);
+			auto thes = agi::make_unique<agi::Thesaurus>(dat, idx, cache);
 			agi::dispatch::Main().Sync([&thes, cancel, this]{
 				if (!*cancel) {
 					impl = std::move(thes);
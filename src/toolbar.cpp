@@ -31,7 +31,6 @@
 #include <libaegisub/signal.h>
 
 #include <boost/algorithm/string/join.hpp>
-#include <boost/interprocess/streams/bufferstream.hpp>
 #include <vector>
 
 #include <wx/frame.h>
@@ -41,8 +40,7 @@ namespace {
 	json::Object const& get_root() {
 		static json::Object root;
 		if (root.empty()) {
-			boost::interprocess::ibufferstream stream((const char *)default_toolbar, sizeof(default_toolbar));
-			root = std::move(static_cast<json::Object&>(agi::json_util::parse(stream)));
+			root = std::move(static_cast<json::Object&>(agi::json_util::parse(GET_DEFAULT_CONFIG(default_toolbar))));
 		}
 		return root;
 	}
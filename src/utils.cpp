@@ -31,12 +31,15 @@
 
 #include "compat.h"
 #include "format.h"
+#include "media_staging.h"
 #include "options.h"
 #include "retina_helper.h"
 
 #include <libaegisub/dispatch.h>
+#include <libaegisub/disk_cache.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/log.h>
+#include <libaegisub/path.h>
 
 #ifdef __UNIX__
 #include <unistd.h>
@@ -155,6 +158,78 @@ void SetClipboard(wxBitmap const& new_data) {
 	}
 }
 
+static wxDataFormat const& ClipboardLinesFormat() {
+	static wxDataFormat format("application/x-aegisub-dialogue");
+	return format;
+}
+
+void SetClipboardLines(std::string const& text, std::string const& lines) {
+	wxClipboard *cb = wxClipboard::Get();
+	if (cb->Open()) {
+		auto data = new wxDataObjectComposite;
+		auto custom = new wxCustomDataObject(ClipboardLinesFormat());
+		custom->SetData(lines.size(), lines.data());
+		data->Add(custom, true);
+		data->Add(new wxTextDataObject(to_wx(text)));
+		cb->SetData(data);
+		cb->Flush();
+		cb->Close();
+	}
+}
+
+std::string GetClipboardLines() {
+	std::string data;
+	wxClipboard *cb = wxClipboard::Get();
+	if (cb->Open()) {
+		if (cb->IsSupported(ClipboardLinesFormat())) {
+			wxCustomDataObject raw_data(ClipboardLinesFormat());
+			if (cb->GetData(raw_data))
+				data.assign(static_cast<const char *>(raw_data.GetData()), raw_data.GetSize());
+		}
+		cb->Close();
+	}
+	return data;
+}
+
+agi::fs::path GetSourceCacheDirectory() {
+	auto path = OPT_GET("Provider/FFmpegSource/Cache/Location")->GetString();
+	if (path == "default")
+		path = "?local/ffms2cache";
+	auto dir = config::path->MakeAbsolute(config::path->Decode(path), "?local");
+	agi::fs::CreateDirectory(dir);
+	return dir;
+}
+
+agi::fs::path GetSourceCacheFilename(agi::fs::path const& filename, std::string const& extension) {
+	// A local copy of a file on a network share shares the original's caches
+	auto source = StagedMediaSource(filename);
+	// The key changes whenever the file is replaced or modified
+	auto key = source.string() + "|" + std::to_string(agi::fs::Size(source)) + "|" + std::to_string(agi::fs::ModifiedTime(source));
+	return GetMediaCache().Path(key, extension);
+}
+
+// The caches are never destroyed, as the thread pool they clean up on may
+// already be gone by the time static objects are
+agi::DiskCache& GetMediaCache() {
+	auto dir = GetSourceCacheDirectory();
+	uint64_t max_size = static_cast<uint64_t>(OPT_GET("Provider/FFmpegSource/Cache/Size")->GetInt()) << 20;
+	size_t max_files = OPT_GET("Provider/FFmpegSource/Cache/Files")->GetInt();
+
+	static agi::DiskCache *cache = new agi::DiskCache(dir, max_size, max_files);
+	cache->SetRoot(dir);
+	cache->SetQuota(max_size, max_files);
+	return *cache;
+}
+
+agi::DiskCache& GetAudioDiskCache(agi::fs::path const& dir) {
+	uint64_t max_size = static_cast<uint64_t>(OPT_GET("Audio/Cache/HD/Size")->GetInt()) << 20;
+
+	static agi::DiskCache *cache = new agi::DiskCache(dir, max_size);
+	cache->SetRoot(dir);
+	cache->SetQuota(max_size);
+	return *cache;
+}
+
 void CleanCache(agi::fs::path const& directory, std::string const& file_type, uint64_t max_size, uint64_t max_files) {
 	static std::unique_ptr<agi::dispatch::Queue> queue;
 	if (!queue)
@@ -41,6 +41,7 @@ class wxKeyEvent;
 class wxMouseEvent;
 class wxStyledTextCtrl;
 class wxWindow;
+namespace agi { class DiskCache; }
 
 wxString PrettySize(int bytes);
 
@@ -75,6 +76,26 @@ bool ForwardMouseWheelEvent(wxWindow *source, wxMouseEvent &evt);
 /// @param max_files Maximum number of files
 void CleanCache(agi::fs::path const& directory, std::string const& file_type, uint64_t max_size, uint64_t max_files = -1);
 
+/// Get the directory holding the FFMS2 indexes and the other files derived
+/// from source files which are worth keeping between sessions, creating it
+/// if it doesn't exist
+agi::fs::path GetSourceCacheDirectory();
+
+/// Generate a name in the source cache directory for a file derived from
+/// the given source file, which changes if the source file does, and mark
+/// the file as used in the media cache
+/// @param filename Source file
+/// @param extension Extension identifying the kind of derived file, including the dot
+agi::fs::path GetSourceCacheFilename(agi::fs::path const& filename, std::string const& extension);
+
+/// Get the cache of the files in the source cache directory, which everything
+/// writing to it has to report the files it writes to
+agi::DiskCache& GetMediaCache();
+
+/// Get the cache of decoded audio used by the hard disk audio cache
+/// @param dir Directory the audio is being cached in
+agi::DiskCache& GetAudioDiskCache(agi::fs::path const& dir);
+
 /// @brief Templated abs() function
 template <typename T> T tabs(T x) { return x < 0 ? -x : x; }
 
@@ -89,6 +110,12 @@ std::string GetClipboard();
 /// Try to set the clipboard to the given string
 void SetClipboard(std::string const& new_value);
 void SetClipboard(wxBitmap const& new_value);
+/// Set the clipboard to subtitle lines, both as text for other programs and
+/// in a private format which Aegisub can paste without reparsing the text
+void SetClipboardLines(std::string const& text, std::string const& lines);
+/// Get lines set with SetClipboardLines in the private format, or an empty
+/// string if the clipboard has anything else
+std::string GetClipboardLines();
 
 #define countof(array) (sizeof(array) / sizeof(array[0]))
 
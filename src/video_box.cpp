@@ -40,6 +40,7 @@
 #include "selection_controller.h"
 #include "video_controller.h"
 #include "video_display.h"
+#include "video_filmstrip.h"
 #include "video_slider.h"
 
 #include <boost/range/algorithm/binary_search.hpp>
@@ -56,6 +57,9 @@ VideoBox::VideoBox(wxWindow *parent, bool isDetached, agi::Context *context)
 	auto videoSlider = new VideoSlider(this, context);
 	videoSlider->SetToolTip(_("Seek video"));
 
+	auto filmstrip = new VideoFilmstrip(this, context);
+	filmstrip->SetToolTip(_("Click to seek to a keyframe"));
+
 	auto mainToolbar = toolbar::GetToolbar(this, "video", context, "Video", false);
 
 	VideoPosition = new wxTextCtrl(this, -1, "", wxDefaultPosition, wxSize(110, -1), wxTE_READONLY);
@@ -92,6 +96,7 @@ VideoBox::VideoBox(wxWindow *parent, bool isDetached, agi::Context *context)
 	auto VideoSizer = new wxBoxSizer(wxVERTICAL);
 	VideoSizer->Add(topSizer, 1, wxEXPAND, 0);
 	VideoSizer->Add(new wxStaticLine(this), 0, wxEXPAND, 0);
+	VideoSizer->Add(filmstrip, 0, wxEXPAND, 0);
 	VideoSizer->Add(videoSlider, 0, wxEXPAND, 0);
 	VideoSizer->Add(videoBottomSizer, 0, wxEXPAND | wxBOTTOM, 5);
 	SetSizer(VideoSizer);
@@ -42,9 +42,19 @@
 #include "utils.h"
 
 #include <libaegisub/ass/time.h>
+#include <libaegisub/log.h>
+#include <libaegisub/trace.h>
 
+#include <algorithm>
 #include <wx/log.h>
 
+namespace {
+/// Number of frames to render the subtitles of ahead of time during playback
+const int prerender_frames = 24;
+/// Number of frames to decode and render ahead of time during playback
+const int playback_queue_frames = 6;
+}
+
 VideoController::VideoController(agi::Context *c)
 : context(c)
 , playAudioOnStep(OPT_GET("Audio/Plays When Stepping Video"))
@@ -52,20 +62,28 @@ VideoController::VideoController(agi::Context *c)
 	context->ass->AddCommitListener(&VideoController::OnSubtitlesCommit, this),
 	context->project->AddVideoProviderListener(&VideoController::OnNewVideoProvider, this),
 	context->selectionController->AddActiveLineListener(&VideoController::OnActiveLineChanged, this),
+	OPT_SUB("Video/Adaptive Subtitle Quality", [=](agi::OptionValue const& opt) {
+		if (provider) provider->SetAdaptiveQuality(opt.GetBool());
+	}),
 }))
 {
+	Bind(EVT_FRAME_AVAILABLE, &VideoController::OnFrameAvailable, this);
 	Bind(EVT_VIDEO_ERROR, &VideoController::OnVideoError, this);
 	Bind(EVT_SUBTITLES_ERROR, &VideoController::OnSubtitlesError, this);
 	playback.Bind(wxEVT_TIMER, &VideoController::OnPlayTimer, this);
 }
 
 void VideoController::OnNewVideoProvider(AsyncVideoProvider *new_provider) {
+	// The old provider has already been destroyed, so Stop mustn't use it
+	provider = nullptr;
 	Stop();
 	provider = new_provider;
 	color_matrix = provider ? provider->GetColorSpace() : "";
+	if (provider)
+		provider->SetAdaptiveQuality(OPT_GET("Video/Adaptive Subtitle Quality")->GetBool());
 }
 
-void VideoController::OnSubtitlesCommit(int type, const AssDialogue *changed) {
+void VideoController::OnSubtitlesCommit(int type) {
 	if (!provider) return;
 
 	if ((type & AssFile::COMMIT_SCRIPTINFO) || type == AssFile::COMMIT_NEW) {
@@ -76,12 +94,25 @@ void VideoController::OnSubtitlesCommit(int type, const AssDialogue *changed) {
 		}
 	}
 
-	if (!changed)
+	// Overlays rendered ahead of time are discarded by the change
+	prerendered_frame = -1;
+
+	// Past a few thousand lines, copying and replacing each changed line
+	// is slower than copying the whole file and loading it again
+	auto const& changed = context->ass->ChangedLines();
+	if (changed.empty() || changed.size() > 2000)
 		provider->LoadSubtitles(context->ass.get());
 	else
 		provider->UpdateSubtitles(context->ass.get(), changed);
 }
 
+void VideoController::PreviewLines(std::vector<const AssDialogue *> const& lines) {
+	if (!provider || lines.empty()) return;
+
+	prerendered_frame = -1;
+	provider->PreviewSubtitles(context->ass.get(), lines);
+}
+
 void VideoController::OnActiveLineChanged(AssDialogue *line) {
 	if (line && provider && OPT_GET("Video/Subtitle Sync")->GetBool()) {
 		Stop();
@@ -94,6 +125,21 @@ void VideoController::RequestFrame() {
 	provider->RequestFrame(frame_n, TimeAtFrame(frame_n));
 }
 
+void VideoController::PrerenderSubtitles() {
+	if (prerendered_frame >= frame_n + prerender_frames / 2) return;
+
+	const int first = std::max(frame_n, prerendered_frame) + 1;
+	const int last = std::min(frame_n + prerender_frames, end_frame - 1);
+	if (first > last) return;
+
+	std::vector<double> times;
+	times.reserve(last - first + 1);
+	for (int frame = first; frame <= last; ++frame)
+		times.push_back(TimeAtFrame(frame));
+	provider->PrerenderSubtitles(std::move(times));
+	prerendered_frame = last;
+}
+
 void VideoController::JumpToFrame(int n) {
 	if (!provider) return;
 
@@ -143,9 +189,7 @@ void VideoController::Play() {
 	end_frame = provider->GetFrameCount() - 1;
 
 	context->audioController->PlayToEnd(start_ms);
-
-	playback_start_time = std::chrono::steady_clock::now();
-	playback.Start(10);
+	StartPlayback();
 }
 
 void VideoController::PlayLine() {
@@ -162,30 +206,123 @@ void VideoController::PlayLine() {
 	end_frame = FrameAtTime(context->selectionController->GetActiveLine()->End, agi::vfr::END) + 1;
 
 	JumpToFrame(startFrame);
+	StartPlayback();
+}
+
+void VideoController::StartPlayback() {
+	prerendered_frame = -1;
+	PrerenderSubtitles();
 
+	// The current frame has already been requested the usual way
+	presented_frame = frame_n;
+	queued_frame = frame_n + 1;
+	frames_presented = 0;
+	frames_dropped = 0;
+	QueuePlaybackFrames();
+
+	playing = true;
 	playback_start_time = std::chrono::steady_clock::now();
-	playback.Start(10);
+	playback.Start(std::max(1, TimeAtFrame(frame_n + 1) - start_ms), wxTIMER_ONE_SHOT);
 }
 
 void VideoController::Stop() {
-	if (IsPlaying()) {
-		playback.Stop();
-		context->audioController->Stop();
+	if (!IsPlaying()) return;
+
+	playing = false;
+	playback.Stop();
+	context->audioController->Stop();
+
+	LOG_I("video/playback") << "Showed " << frames_presented << " frames, dropped " << frames_dropped;
+
+	if (provider) {
+		provider->StopPlayback();
+		// The frame which is due may not have been ready in time to be shown
+		RequestFrame();
+	}
+}
+
+void VideoController::SetScrubbing(bool scrubbing) {
+	if (provider)
+		provider->SetScrubbing(scrubbing);
+}
+
+void VideoController::QueuePlaybackFrames() {
+	// Frames which are already due won't be ready in time, so there's no
+	// point in starting on them
+	queued_frame = std::max(queued_frame, frame_n + 1);
+	const int last = std::min(frame_n + playback_queue_frames, end_frame - 1);
+	for (; queued_frame <= last; ++queued_frame)
+		provider->QueuePlaybackFrame(queued_frame, TimeAtFrame(queued_frame));
+}
+
+void VideoController::PresentFrame() {
+	if (presented_frame >= frame_n) return;
+
+	int taken;
+	auto frame = provider->TakePlaybackFrame(frame_n, taken);
+	if (!frame) return;
+
+	if (taken > presented_frame + 1) {
+		frames_dropped += taken - presented_frame - 1;
+		agi::trace::Count("video/dropped", taken - presented_frame - 1);
 	}
+	++frames_presented;
+	presented_frame = taken;
+
+	FrameReadyEvent evt(std::move(frame), TimeAtFrame(taken));
+	evt.SetEventType(EVT_FRAME_READY);
+	ProcessEvent(evt);
+}
+
+void VideoController::OnFrameAvailable(wxThreadEvent &) {
+	if (!provider) return;
+
+	double time;
+	std::chrono::steady_clock::time_point queued;
+	auto frame = provider->TakeReadyFrame(time, queued);
+	if (!frame) return;
+
+	FrameReadyEvent evt(std::move(frame), time);
+	evt.SetEventType(EVT_FRAME_READY);
+	ProcessEvent(evt);
+
+	using namespace std::chrono;
+	agi::trace::Sample("video/present_latency", duration_cast<nanoseconds>(steady_clock::now() - queued).count());
 }
 
 void VideoController::OnPlayTimer(wxTimerEvent &) {
 	using namespace std::chrono;
-	int next_frame = FrameAtTime(start_ms + duration_cast<milliseconds>(steady_clock::now() - playback_start_time).count());
-	if (next_frame == frame_n) return;
+	auto now = steady_clock::now();
+	int ms;
+	if (context->audioController->IsPlaying()) {
+		// Follow what's actually being heard so that the video doesn't
+		// drift from the audio, and keep the wall clock in step with it in
+		// case the audio ends before the video does
+		ms = std::max(start_ms, context->audioController->GetPlaybackPosition());
+		playback_start_time = now - milliseconds(ms - start_ms);
+	}
+	else
+		ms = start_ms + duration_cast<milliseconds>(now - playback_start_time).count();
 
-	if (next_frame >= end_frame)
+	int next_frame = FrameAtTime(ms);
+	if (next_frame >= end_frame) {
 		Stop();
-	else {
+		return;
+	}
+
+	if (next_frame != frame_n) {
 		frame_n = next_frame;
-		RequestFrame();
+		context->ass->Properties.video_position = frame_n;
 		Seek(frame_n);
+		PrerenderSubtitles();
+		QueuePlaybackFrames();
 	}
+	PresentFrame();
+
+	// Wake up when the next frame is due, or check again shortly if the
+	// current one wasn't ready yet
+	int wait = presented_frame < frame_n ? 2 : TimeAtFrame(frame_n + 1) - ms;
+	playback.Start(mid(1, wait, 100), wxTIMER_ONE_SHOT);
 }
 
 double VideoController::GetARFromType(AspectRatio type) const {
@@ -69,10 +69,14 @@ class VideoController final : public wxEvtHandler {
 	/// Last seen script color matrix
 	std::string color_matrix;
 
-	/// Playback timer used to periodically check if we should go to the next
-	/// frame while playing video
+	/// One-shot timer which fires when the next frame is due to be shown
+	/// while playing video
 	wxTimer playback;
 
+	/// Is the video playing? The playback timer isn't running while its
+	/// handler is, so it can't be used for this.
+	bool playing = false;
+
 	/// Time when playback was last started
 	std::chrono::steady_clock::time_point playback_start_time;
 
@@ -87,6 +91,23 @@ class VideoController final : public wxEvtHandler {
 	/// which may not be the same thing as the currently displayed frame
 	int frame_n = 0;
 
+	/// Last frame whose subtitles have been queued for rendering ahead of
+	/// time during playback
+	int prerendered_frame = -1;
+
+	/// Next frame to queue for decoding and rendering ahead of time during
+	/// playback
+	int queued_frame = 0;
+
+	/// Frame which was last shown during playback
+	int presented_frame = 0;
+
+	/// Number of frames shown during the current playback
+	int frames_presented = 0;
+	/// Number of frames skipped over during the current playback because
+	/// they weren't ready in time
+	int frames_dropped = 0;
+
 	/// The picture aspect ratio of the video if the aspect ratio has been
 	/// overridden by the user
 	double ar_value = 1.;
@@ -100,21 +121,34 @@ class VideoController final : public wxEvtHandler {
 	std::vector<agi::signal::Connection> connections;
 
 	void OnPlayTimer(wxTimerEvent &event);
+	/// Show the newest frame the provider has rendered, if it hasn't been
+	/// shown already
+	void OnFrameAvailable(wxThreadEvent &);
 
 	void OnVideoError(VideoProviderErrorEvent const& err);
 	void OnSubtitlesError(SubtitlesProviderErrorEvent const& err);
 
-	void OnSubtitlesCommit(int type, const AssDialogue *changed);
+	void OnSubtitlesCommit(int type);
 	void OnNewVideoProvider(AsyncVideoProvider *provider);
 	void OnActiveLineChanged(AssDialogue *line);
 
 	void RequestFrame();
+	/// Queue rendering the subtitles of the next batch of frames to be
+	/// played if playback is getting close to the end of the last batch
+	void PrerenderSubtitles();
+	/// Start the playback timer and queueing frames from frame_n
+	void StartPlayback();
+	/// Queue the frames up to a short while after frame_n for decoding and
+	/// rendering ahead of time
+	void QueuePlaybackFrames();
+	/// Show the newest rendered frame which is due by the current frame
+	void PresentFrame();
 
 public:
 	VideoController(agi::Context *context);
 
 	/// Is the video currently playing?
-	bool IsPlaying() const { return playback.IsRunning(); }
+	bool IsPlaying() const { return playing; }
 
 	/// Get the current frame number
 	int GetFrameN() const { return frame_n; }
@@ -154,6 +188,21 @@ public:
 	/// Stop playing
 	void Stop();
 
+	/// @brief Tell the video whether the user is dragging through it
+	///
+	/// Subtitles may be drawn at a lower resolution while scrubbing if they
+	/// can't be rendered fast enough, and are drawn at full quality again
+	/// once it stops.
+	void SetScrubbing(bool scrubbing);
+
+	/// @brief Show uncommitted changes to lines on the video
+	/// @param lines Lines which have been changed in the project's file
+	///
+	/// For changes such as dragging with a visual tool which are committed
+	/// once they're finished. Previews made faster than the video can be
+	/// redrawn are merged.
+	void PreviewLines(std::vector<const AssDialogue *> const& lines);
+
 	DEFINE_SIGNAL_ADDERS(Seek, AddSeekListener)
 	DEFINE_SIGNAL_ADDERS(ARChange, AddARChangeListener)
 
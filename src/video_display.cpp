@@ -39,10 +39,13 @@
 #include "command/command.h"
 #include "compat.h"
 #include "format.h"
+#include "gl_text.h"
+#include "gl_wrap.h"
 #include "include/aegisub/context.h"
 #include "include/aegisub/hotkey.h"
 #include "include/aegisub/menu.h"
 #include "options.h"
+#include "performance_hud.h"
 #include "project.h"
 #include "retina_helper.h"
 #include "spline_curve.h"
@@ -78,6 +81,21 @@ public:
 
 #define E(cmd) cmd; if (GLenum err = glGetError()) throw OpenGlException(#cmd, err)
 
+/// Video output shared by all of the displays
+struct SharedVideoOutput {
+	VideoOutGL out;
+	/// Frame in out's textures
+	std::shared_ptr<const VideoFrame> frame;
+};
+
+namespace {
+/// Displays which have a GL context, all of which share their objects
+std::vector<VideoDisplay *> displays_with_context;
+/// The output shared by the displays in displays_with_context, if any of
+/// them have made it yet
+std::weak_ptr<SharedVideoOutput> shared_output;
+}
+
 VideoDisplay::VideoDisplay(wxToolBar *toolbar, bool freeSize, wxComboBox *zoomBox, wxWindow *parent, agi::Context *c)
 : wxGLCanvas(parent, -1, attribList)
 , autohideTools(OPT_GET("Tool/Visual/Autohide"))
@@ -102,6 +120,8 @@ VideoDisplay::VideoDisplay(wxToolBar *toolbar, bool freeSize, wxComboBox *zoomBo
 	connections = agi::signal::make_vector({
 		con->project->AddVideoProviderListener(&VideoDisplay::UpdateSize, this),
 		con->videoController->AddARChangeListener(&VideoDisplay::UpdateSize, this),
+		OPT_SUB("Video/Proxy Decoding", &VideoDisplay::UpdateProxyScale, this),
+		OPT_SUB("App/Performance HUD", &VideoDisplay::Render, this),
 	});
 
 	Bind(wxEVT_PAINT, std::bind(&VideoDisplay::Render, this));
@@ -139,31 +159,48 @@ bool VideoDisplay::InitContext() {
 	if (GetClientSize() == wxSize(0, 0))
 		return false;
 
-	if (!glContext)
-		glContext = agi::make_unique<wxGLContext>(this);
+	if (!glContext) {
+		wxGLContext *share = displays_with_context.empty() ? nullptr : displays_with_context.front()->glContext.get();
+		glContext = agi::make_unique<wxGLContext>(this, share);
+		displays_with_context.push_back(this);
+	}
 
 	SetCurrent(*glContext);
 	return true;
 }
 
 void VideoDisplay::UploadFrameData(FrameReadyEvent &evt) {
+	// Let every display showing the video see the frame
+	evt.Skip();
 	pending_frame = evt.frame;
 	Render();
 }
 
 void VideoDisplay::Render() try {
-	if (!con->project->VideoProvider() || !InitContext() || (!videoOut && !pending_frame))
+	if (!con->project->VideoProvider() || !InitContext())
+		return;
+
+	if (!output)
+		output = shared_output.lock();
+	if (!output && !pending_frame)
 		return;
 
-	if (!videoOut)
-		videoOut = agi::make_unique<VideoOutGL>();
+	if (!output) {
+		output = std::make_shared<SharedVideoOutput>();
+		shared_output = output;
+	}
 
 	if (!tool)
 		cmd::call("video/tool/cross", con);
 
 	try {
 		if (pending_frame) {
-			videoOut->UploadFrameData(*pending_frame);
+			// Another display may have already uploaded this frame
+			if (pending_frame != output->frame) {
+				output->frame.reset();
+				output->out.UploadFrameData(*pending_frame);
+				output->frame = pending_frame;
+			}
 			pending_frame.reset();
 		}
 	}
@@ -190,7 +227,7 @@ void VideoDisplay::Render() try {
 	if (!viewport_height || !viewport_width)
 		PositionVideo();
 
-	videoOut->Render(viewport_left, viewport_bottom, viewport_width, viewport_height);
+	output->out.Render(viewport_left, viewport_bottom, viewport_width, viewport_height);
 	E(glViewport(0, std::min(viewport_bottom, 0), videoSize.GetWidth(), videoSize.GetHeight()));
 
 	E(glMatrixMode(GL_PROJECTION));
@@ -216,6 +253,9 @@ void VideoDisplay::Render() try {
 	if ((mouse_pos || !autohideTools->GetBool()) && tool)
 		tool->Draw();
 
+	if (performance_hud::Visible())
+		DrawPerformanceHud();
+
 	SwapBuffers();
 }
 catch (const agi::Exception &err) {
@@ -264,6 +304,32 @@ void VideoDisplay::DrawOverscanMask(float horizontal_percent, float vertical_per
 	gl.DrawMultiPolygon(points, vstart, vcount, Vector2D(viewport_left, viewport_top), Vector2D(viewport_width, viewport_height), true);
 }
 
+void VideoDisplay::DrawPerformanceHud() {
+	if (!hud_text) {
+		hud_text = agi::make_unique<OpenGLText>();
+		hud_text->SetFont("Verdana", 10, false, false);
+		hud_text->SetColour(agi::Color(255, 255, 255, 255));
+	}
+
+	auto lines = performance_hud::VideoLines();
+	int width = 0, line_height = 0;
+	for (auto const& line : lines) {
+		int w, h;
+		hud_text->GetExtent(line, w, h);
+		width = std::max(width, w);
+		line_height = std::max(line_height, h);
+	}
+
+	const int margin = 4;
+	OpenGLWrapper gl;
+	gl.SetFillColour(*wxBLACK, .6f);
+	gl.SetLineColour(*wxBLACK, 0, 1);
+	gl.DrawRectangle(Vector2D(0, 0), Vector2D(width + margin * 2, line_height * lines.size() + margin * 2));
+
+	for (size_t i = 0; i < lines.size(); ++i)
+		hud_text->Print(lines[i], margin, margin + line_height * i);
+}
+
 void VideoDisplay::PositionVideo() {
 	auto provider = con->project->VideoProvider();
 	if (!provider || !IsShownOnScreen()) return;
@@ -296,6 +362,8 @@ void VideoDisplay::PositionVideo() {
 		}
 	}
 
+	UpdateProxyScale();
+
 	if (tool)
 		tool->SetDisplayArea(viewport_left / scale_factor, viewport_top / scale_factor,
 		                     viewport_width / scale_factor, viewport_height / scale_factor);
@@ -303,6 +371,23 @@ void VideoDisplay::PositionVideo() {
 	Render();
 }
 
+void VideoDisplay::UpdateProxyScale() {
+	auto provider = con->project->VideoProvider();
+	if (!provider || viewport_width <= 0 || viewport_height <= 0) return;
+
+	double scale = 1.;
+	if (OPT_GET("Video/Proxy Decoding")->GetBool()) {
+		// Halve the size for as long as the frames would still be at least
+		// as large as the viewport, rather than using the exact zoom, so that
+		// resizing the window doesn't redecode the frame every time
+		double shown = std::max(double(viewport_width) / provider->GetWidth(),
+		                        double(viewport_height) / provider->GetHeight());
+		while (scale > .25 && scale / 2 >= shown)
+			scale /= 2;
+	}
+	provider->SetProxyScale(scale);
+}
+
 void VideoDisplay::UpdateSize() {
 	auto provider = con->project->VideoProvider();
 	if (!provider || !IsShownOnScreen()) return;
@@ -441,8 +526,9 @@ void VideoDisplay::Unload() {
 	if (glContext) {
 		SetCurrent(*glContext);
 	}
-	videoOut.reset();
+	output.reset();
 	tool.reset();
 	glContext.reset();
 	pending_frame.reset();
+	displays_with_context.erase(std::remove(displays_with_context.begin(), displays_with_context.end(), this), displays_with_context.end());
 }
@@ -42,14 +42,15 @@
 #include <wx/glcanvas.h>
 
 // Prototypes
+class OpenGLText;
 class RetinaHelper;
 class VideoController;
-class VideoOutGL;
 class VisualToolBase;
 class wxComboBox;
 class wxTextCtrl;
 class wxToolBar;
 struct FrameReadyEvent;
+struct SharedVideoOutput;
 struct VideoFrame;
 
 namespace agi {
@@ -87,15 +88,17 @@ class VideoDisplay final : public wxGLCanvas {
 	/// The current zoom level, where 1.0 = 100%
 	double zoomValue;
 
-	/// The video renderer
-	std::unique_ptr<VideoOutGL> videoOut;
+	/// The video renderer, which is shared by all of the displays so that a
+	/// frame is only uploaded once however many of them show it
+	std::shared_ptr<SharedVideoOutput> output;
 
 	/// The active visual typesetting tool
 	std::unique_ptr<VisualToolBase> tool;
 	/// The toolbar used by individual typesetting tools
 	wxToolBar* toolBar;
 
-	/// The OpenGL context for this display
+	/// The OpenGL context for this display, which shares its textures with
+	/// the other displays' contexts
 	std::unique_ptr<wxGLContext> glContext;
 
 	/// The dropdown box for selecting zoom levels
@@ -105,17 +108,23 @@ class VideoDisplay final : public wxGLCanvas {
 	bool freeSize;
 
 	/// Frame which will replace the currently visible frame on the next render
-	std::shared_ptr<VideoFrame> pending_frame;
+	std::shared_ptr<const VideoFrame> pending_frame;
 
 	std::unique_ptr<RetinaHelper> retina_helper;
 	int scale_factor;
 	agi::signal::Connection scale_factor_connection;
 
+	/// Font renderer for the performance overlay, created when first shown
+	std::unique_ptr<OpenGLText> hud_text;
+
 	/// @brief Draw an overscan mask
 	/// @param horizontal_percent The percent of the video reserved horizontally
 	/// @param vertical_percent The percent of the video reserved vertically
 	void DrawOverscanMask(float horizontal_percent, float vertical_percent) const;
 
+	/// Draw the decode, render and upload timings over the top left corner
+	void DrawPerformanceHud();
+
 	/// Upload the image for the current frame to the video card
 	void UploadFrameData(FrameReadyEvent&);
 
@@ -126,6 +135,8 @@ class VideoDisplay final : public wxGLCanvas {
 	/// @brief Set the size of the display based on the current zoom and video resolution
 	void UpdateSize();
 	void PositionVideo();
+	/// Pick the size to decode frames at for the current viewport size
+	void UpdateProxyScale();
 	/// Set the zoom level to that indicated by the dropdown
 	void SetZoomFromBox(wxCommandEvent&);
 	/// Set the zoom level to that indicated by the text
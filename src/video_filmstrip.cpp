@@ -0,0 +1,150 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file video_filmstrip.cpp
+/// @brief Strip of keyframe thumbnails above the video slider
+/// @ingroup custom_control
+
+#include "video_filmstrip.h"
+
+#include "async_video_provider.h"
+#include "dialog_progress.h"
+#include "filmstrip.h"
+#include "include/aegisub/context.h"
+#include "options.h"
+#include "project.h"
+#include "video_controller.h"
+
+#include <libaegisub/exception.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+
+#include <cstring>
+#include <wx/dcbuffer.h>
+#include <wx/image.h>
+#include <wx/settings.h>
+
+namespace {
+/// Height of each thumbnail in pixels
+const int thumbnail_height = 36;
+/// Space between the thumbnails and the edges of the window
+const int border = 2;
+}
+
+VideoFilmstrip::VideoFilmstrip(wxWindow *parent, agi::Context *c)
+: wxWindow(parent, -1, wxDefaultPosition, wxDefaultSize, wxFULL_REPAINT_ON_RESIZE)
+, c(c)
+, connections(agi::signal::make_vector({
+	OPT_SUB("Video/Slider/Show Filmstrip", &VideoFilmstrip::Reload, this),
+	c->project->AddVideoProviderListener(&VideoFilmstrip::VideoOpened, this),
+}))
+{
+	SetMinSize(wxSize(20, thumbnail_height + 2 * border));
+	SetBackgroundStyle(wxBG_STYLE_PAINT);
+
+	Bind(wxEVT_PAINT, &VideoFilmstrip::OnPaint, this);
+	Bind(wxEVT_LEFT_DOWN, &VideoFilmstrip::OnMouse, this);
+
+	Reload();
+}
+
+VideoFilmstrip::~VideoFilmstrip() { }
+
+void VideoFilmstrip::VideoOpened(AsyncVideoProvider *) {
+	// The project announces the new provider before it updates the video
+	// filename, so wait until it's done
+	CallAfter(&VideoFilmstrip::Reload);
+}
+
+void VideoFilmstrip::Reload() {
+	filmstrip.reset();
+	bitmaps.clear();
+
+	auto provider = c->project->VideoProvider();
+	if (provider && OPT_GET("Video/Slider/Show Filmstrip")->GetBool()) {
+		max = provider->GetFrameCount() - 1;
+		if (!progress)
+			progress = new DialogProgress(c->parent);
+		try {
+			filmstrip = agi::make_unique<Filmstrip>(c->project->VideoName(),
+				provider->GetColorSpace(), thumbnail_height, progress,
+				[=] { Refresh(false); });
+		}
+		catch (agi::UserCancelException const&) { }
+		catch (agi::Exception const& e) {
+			LOG_E("video/filmstrip") << "Failed to open video for thumbnails: " << e.GetMessage();
+		}
+	}
+
+	if (IsShown() != !!filmstrip) {
+		Show(!!filmstrip);
+		GetParent()->Layout();
+	}
+	Refresh(false);
+}
+
+int VideoFilmstrip::GetValueAtX(int x) const {
+	// Same scale as the slider
+	int w = GetClientSize().GetWidth();
+	if (w <= 10) return 0;
+	return (int64_t)(x-5)*(int64_t)max/(int64_t)(w-10);
+}
+
+wxBitmap const *VideoFilmstrip::GetBitmap(int frame, int &thumb_frame) {
+	std::vector<unsigned char> rgb;
+	if (!filmstrip || !filmstrip->GetThumbnail(frame, thumb_frame, rgb))
+		return nullptr;
+
+	auto it = bitmaps.find(thumb_frame);
+	if (it == bitmaps.end()) {
+		wxImage img(filmstrip->GetThumbnailWidth(), filmstrip->GetThumbnailHeight(), false);
+		memcpy(img.GetData(), rgb.data(), rgb.size());
+		it = bitmaps.emplace(thumb_frame, wxBitmap(img)).first;
+	}
+	return &it->second;
+}
+
+void VideoFilmstrip::OnPaint(wxPaintEvent &) {
+	wxAutoBufferedPaintDC dc(this);
+	int w, h;
+	GetClientSize(&w, &h);
+
+	dc.SetPen(*wxTRANSPARENT_PEN);
+	dc.SetBrush(wxSystemSettings::GetColour(wxSYS_COLOUR_3DFACE));
+	dc.DrawRectangle(0, 0, w, h);
+	if (!filmstrip) return;
+
+	// Fill the width with thumbnails, each showing the keyframe closest to
+	// the part of the slider below its middle
+	const int thumb_width = filmstrip->GetThumbnailWidth();
+	for (int x = 5; x + thumb_width <= w - 5; x += thumb_width) {
+		int thumb_frame;
+		if (auto bmp = GetBitmap(GetValueAtX(x + thumb_width / 2), thumb_frame))
+			dc.DrawBitmap(*bmp, x, border);
+	}
+}
+
+void VideoFilmstrip::OnMouse(wxMouseEvent &event) {
+	if (!filmstrip || event.GetX() < 5) return;
+
+	const int thumb_width = filmstrip->GetThumbnailWidth();
+	const int x = event.GetX() - (event.GetX() - 5) % thumb_width + thumb_width / 2;
+
+	int thumb_frame;
+	std::vector<unsigned char> rgb;
+	if (filmstrip->GetThumbnail(GetValueAtX(x), thumb_frame, rgb))
+		c->videoController->JumpToFrame(thumb_frame);
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+/// @file video_filmstrip.h
+/// @see video_filmstrip.cpp
+/// @ingroup custom_control
+
+#pragma once
+
+#include <libaegisub/signal.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <wx/bitmap.h>
+#include <wx/window.h>
+
+namespace agi { struct Context; }
+
+class AsyncVideoProvider;
+class DialogProgress;
+class Filmstrip;
+
+/// @class VideoFilmstrip
+/// @brief Strip of keyframe thumbnails shown above the video slider
+///
+/// The thumbnails are laid out on the same scale as the slider, so each one
+/// is above the part of the slider it was taken from. Clicking a thumbnail
+/// seeks to the keyframe it shows.
+class VideoFilmstrip final : public wxWindow {
+	agi::Context *c;
+	std::unique_ptr<Filmstrip> filmstrip;
+	DialogProgress *progress = nullptr;
+	std::vector<agi::signal::Connection> connections;
+
+	/// Bitmaps of the thumbnails which have been drawn, by frame number
+	std::map<int, wxBitmap> bitmaps;
+
+	/// Last frame number
+	int max = 1;
+
+	/// Get the frame number for the given x coordinate
+	int GetValueAtX(int x) const;
+	/// Get the bitmap of the thumbnail closest to a frame
+	/// @param[out] thumb_frame Frame number of the thumbnail
+	wxBitmap const *GetBitmap(int frame, int &thumb_frame);
+
+	/// Video open event handler
+	void VideoOpened(AsyncVideoProvider *provider);
+	/// Open or close the filmstrip for the current video
+	void Reload();
+
+	void OnPaint(wxPaintEvent &);
+	void OnMouse(wxMouseEvent &event);
+
+public:
+	VideoFilmstrip(wxWindow *parent, agi::Context *c);
+	~VideoFilmstrip();
+};
@@ -16,35 +16,173 @@
 
 #include "video_frame.h"
 
-#if BOOST_VERSION >= 106900
-#include <boost/gil.hpp>
-#else
-#include <boost/gil/gil_all.hpp>
-#endif
+#include <libaegisub/simd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <wx/image.h>
 
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+#define AGI_LITTLE_ENDIAN
+#endif
+
 namespace {
-	// We actually have bgr_, not bgra, so we need a custom converter which ignores the alpha channel
-	struct color_converter {
-		template <typename P1, typename P2>
-		void operator()(P1 const& src, P2& dst) const {
-			using namespace boost::gil;
-			dst = rgb8_pixel_t(
-				get_color(src, red_t()),
-				get_color(src, green_t()),
-				get_color(src, blue_t()));
+	/// Convert a row of BGRX pixels to RGB, dropping the unused byte
+	void BGRAToRGB(const unsigned char *src, unsigned char *dst, size_t width) {
+		size_t x = 0;
+#ifdef AGI_LITTLE_ENDIAN
+		// Four pixels at a time, swapping R and B within each pixel's word
+		// and then packing the four 24-bit pixels into three words
+		auto rgb = [](uint32_t p) { return (p >> 16 & 0xFF) | (p & 0xFF00) | (p & 0xFF) << 16; };
+		for (; x + 4 <= width; x += 4, src += 16, dst += 12) {
+			uint32_t in[4], out[3];
+			memcpy(in, src, sizeof in);
+			const uint32_t p0 = rgb(in[0]), p1 = rgb(in[1]), p2 = rgb(in[2]), p3 = rgb(in[3]);
+			out[0] = p0 | p1 << 24;
+			out[1] = p1 >> 8 | p2 << 16;
+			out[2] = p2 >> 16 | p3 << 8;
+			memcpy(dst, out, sizeof out);
 		}
+#endif
+		for (; x < width; ++x, src += 4, dst += 3) {
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+		}
+	}
+}
+
+YCbCrCoefficients GetYCbCrCoefficients(std::string const& name) {
+	YCbCrCoefficients matrix;
+	matrix.full_range = name.compare(0, 3, "PC.") == 0;
+	if (name.size() < 3) return matrix;
+
+	auto type = name.substr(3);
+	if (type == "709") {
+		matrix.kr = 0.2126;
+		matrix.kb = 0.0722;
+	}
+	else if (type == "FCC") {
+		matrix.kr = 0.30;
+		matrix.kb = 0.11;
+	}
+	else if (type == "240M") {
+		matrix.kr = 0.212;
+		matrix.kb = 0.087;
+	}
+	return matrix;
+}
+
+void GetYCbCrTransform(YCbCrCoefficients const& matrix, float coefficients[9], float offsets[3]) {
+	const double kr = matrix.kr, kb = matrix.kb, kg = 1 - kr - kb;
+	const double luma_scale = matrix.full_range ? 1. : 255. / 219.;
+	const double chroma_scale = matrix.full_range ? 1. : 255. / 224.;
+
+	const double m[9] = {
+		luma_scale, 0, chroma_scale * 2 * (1 - kr),
+		luma_scale, -chroma_scale * 2 * kb * (1 - kb) / kg, -chroma_scale * 2 * kr * (1 - kr) / kg,
+		luma_scale, chroma_scale * 2 * (1 - kb), 0
 	};
+	std::copy(std::begin(m), std::end(m), coefficients);
+
+	offsets[0] = matrix.full_range ? 0.f : -16.f / 255.f;
+	offsets[1] = offsets[2] = -128.f / 255.f;
+}
+
+void ConvertToBGRA(VideoFrame const& src, VideoFrame &dst) {
+	float coefficients[9], offsets[3];
+	GetYCbCrTransform(src.matrix, coefficients, offsets);
+
+	// 16.16 fixed point versions which work on 0-255 samples
+	int m[9], o[3];
+	for (int i = 0; i < 9; ++i)
+		m[i] = (int)std::lround(coefficients[i] * 65536);
+	for (int i = 0; i < 3; ++i)
+		o[i] = (int)std::lround(offsets[i] * 255);
+
+	dst.width = src.width;
+	dst.height = src.height;
+	dst.pitch = src.width * 4;
+	dst.flipped = src.flipped;
+	dst.format = VideoFrameFormat::BGRA;
+	dst.matrix = src.matrix;
+	dst.data.resize(dst.pitch * dst.height);
+
+	const size_t chroma_pitch = src.pitch / 2;
+	const unsigned char *y_plane = src.data.data();
+	const unsigned char *u_plane = y_plane + src.pitch * src.height;
+	const unsigned char *v_plane = u_plane + chroma_pitch * ((src.height + 1) / 2);
+
+#ifdef AGI_SSE2
+	__m128 vm[9], vo[3];
+	for (int i = 0; i < 9; ++i)
+		vm[i] = _mm_set1_ps(coefficients[i]);
+	for (int i = 0; i < 3; ++i)
+		vo[i] = _mm_set1_ps(offsets[i] * 255.f);
+	const __m128i zero = _mm_setzero_si128();
+#endif
+
+	auto clamp = [](int v) { return (unsigned char)std::min(std::max((v + 32768) >> 16, 0), 255); };
+	for (size_t y = 0; y < src.height; ++y) {
+		const unsigned char *y_row = y_plane + y * src.pitch;
+		const unsigned char *u_row = u_plane + y / 2 * chroma_pitch;
+		const unsigned char *v_row = v_plane + y / 2 * chroma_pitch;
+		unsigned char *out = &dst.data[y * dst.pitch];
+		size_t x = 0;
+#ifdef AGI_SSE2
+		// Four pixels at a time in float, which rounds slightly differently
+		// from the fixed point version but never by more than one step
+		for (; x + 4 <= src.width; x += 4) {
+			const float u0 = u_row[x / 2], u1 = u_row[x / 2 + 1];
+			const float v0 = v_row[x / 2], v1 = v_row[x / 2 + 1];
+			__m128 Y = _mm_add_ps(_mm_setr_ps(y_row[x], y_row[x + 1], y_row[x + 2], y_row[x + 3]), vo[0]);
+			__m128 U = _mm_add_ps(_mm_setr_ps(u0, u0, u1, u1), vo[1]);
+			__m128 V = _mm_add_ps(_mm_setr_ps(v0, v0, v1, v1), vo[2]);
+
+			auto channel = [&](int row) {
+				__m128 sum = _mm_add_ps(_mm_mul_ps(vm[row * 3], Y),
+					_mm_add_ps(_mm_mul_ps(vm[row * 3 + 1], U), _mm_mul_ps(vm[row * 3 + 2], V)));
+				return _mm_cvtps_epi32(sum);
+			};
+			__m128i R = channel(0), G = channel(1), B = channel(2);
+
+			// Interleave into B G R 0 for each pixel, then narrow with saturation
+			__m128i br_lo = _mm_unpacklo_epi32(B, R), br_hi = _mm_unpackhi_epi32(B, R);
+			__m128i g_lo = _mm_unpacklo_epi32(G, zero), g_hi = _mm_unpackhi_epi32(G, zero);
+			__m128i p01 = _mm_packs_epi32(_mm_unpacklo_epi32(br_lo, g_lo), _mm_unpackhi_epi32(br_lo, g_lo));
+			__m128i p23 = _mm_packs_epi32(_mm_unpacklo_epi32(br_hi, g_hi), _mm_unpackhi_epi32(br_hi, g_hi));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(p01, p23));
+			out += 16;
+		}
+#endif
+		for (; x < src.width; ++x) {
+			const int Y = y_row[x] + o[0];
+			const int U = u_row[x / 2] + o[1];
+			const int V = v_row[x / 2] + o[2];
+			out[0] = clamp(m[6] * Y + m[7] * U + m[8] * V);
+			out[1] = clamp(m[3] * Y + m[4] * U + m[5] * V);
+			out[2] = clamp(m[0] * Y + m[1] * U + m[2] * V);
+			out[3] = 0;
+			out += 4;
+		}
+	}
 }
 
 wxImage GetImage(VideoFrame const& frame) {
-	using namespace boost::gil;
-
-	wxImage img(frame.width, frame.height);
-	auto src = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.pitch);
-	auto dst = interleaved_view(frame.width, frame.height, (rgb8_pixel_t*)img.GetData(), 3 * frame.width);
-	if (frame.flipped)
-		src = flipped_up_down_view(src);
-	copy_and_convert_pixels(src, dst, color_converter());
+	if (frame.format != VideoFrameFormat::BGRA) {
+		VideoFrame converted;
+		ConvertToBGRA(frame, converted);
+		return GetImage(converted);
+	}
+
+	wxImage img(frame.width, frame.height, false);
+	unsigned char *dst = img.GetData();
+	for (size_t y = 0; y < frame.height; ++y) {
+		size_t row = frame.flipped ? frame.height - 1 - y : y;
+		BGRAToRGB(&frame.data[row * frame.pitch], dst + y * frame.width * 3, frame.width);
+	}
 	return img;
 }
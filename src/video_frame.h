@@ -14,16 +14,75 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#pragma once
+
+#include <cstdint>
+#include <string>
 #include <vector>
 
 class wxImage;
 
+/// Layout of a VideoFrame's pixel data
+enum class VideoFrameFormat {
+	/// A single plane of 32-bit BGRX pixels
+	BGRA,
+	/// A full-size Y plane with pitch bytes per row, followed by half-width
+	/// and half-height U and V planes with pitch / 2 bytes per row
+	YUV420P
+};
+
+/// A rectangle of pixels in a frame
+struct FrameRect {
+	int x = 0;
+	int y = 0;
+	int w = 0;
+	int h = 0;
+
+	bool empty() const { return w <= 0 || h <= 0; }
+};
+
+/// The YCbCr matrix which a YUV frame was encoded with
+struct YCbCrCoefficients {
+	double kr = 0.299;
+	double kb = 0.114;
+	bool full_range = false;
+};
+
 struct VideoFrame {
 	std::vector<unsigned char> data;
 	size_t width;
 	size_t height;
 	size_t pitch;
 	bool flipped;
+	VideoFrameFormat format = VideoFrameFormat::BGRA;
+	/// Matrix to convert YUV frames to RGB with
+	YCbCrCoefficients matrix;
+
+	/// Identifies the contents of rendered frames, which are drawn into
+	/// reused buffers, or 0 if the frame isn't tracked
+	uint32_t id = 0;
+	/// If nonzero, the id of an earlier frame which this frame only differs
+	/// from within changed, so that only that area has to be uploaded if
+	/// the earlier frame is already being displayed
+	uint32_t base_id = 0;
+	/// The area which differs from the base frame, in rows of data rather
+	/// than displayed rows for flipped frames
+	FrameRect changed;
 };
 
+/// Get the matrix for a color matrix name such as "TV.601"
+YCbCrCoefficients GetYCbCrCoefficients(std::string const& name);
+
+/// @brief Get the transform from YUV to RGB for a matrix
+/// @param matrix       Matrix to get the transform for
+/// @param coefficients Receives the 3x3 matrix, in row-major order
+/// @param offsets      Receives the offsets to add to each YUV component
+///                     before multiplying by the matrix
+///
+/// All values are for components scaled to 0-1 rather than 0-255.
+void GetYCbCrTransform(YCbCrCoefficients const& matrix, float coefficients[9], float offsets[3]);
+
+/// Convert a YUV frame to a BGRA frame. dst is reused if it's large enough.
+void ConvertToBGRA(VideoFrame const& src, VideoFrame &dst);
+
 wxImage GetImage(VideoFrame const& frame);
@@ -20,21 +20,33 @@
 ///
 
 #include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <utility>
 
 #include <libaegisub/log.h>
+#include <libaegisub/trace.h>
 
 // These must be included before local headers.
 #ifdef HAVE_OPENGL_GL_H
 #include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
 #else
 #include <GL/gl.h>
+#include "gl/glext.h"
 #endif
 
 #include "video_out_gl.h"
+#include "gl_wrap.h"
 #include "utils.h"
 #include "video_frame.h"
 
+#include <libaegisub/make_unique.h>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
 namespace {
 template<typename Exception>
 BOOST_NOINLINE void throw_error(GLenum err, const char *msg) {
@@ -53,10 +65,74 @@ BOOST_NOINLINE void throw_error(GLenum err, const char *msg) {
 #define CHECK_INIT_ERROR(cmd) DO_CHECK_ERROR(cmd, VideoOutInitException, #cmd)
 #define CHECK_ERROR(cmd) DO_CHECK_ERROR(cmd, VideoOutRenderException, #cmd)
 
+namespace {
+/// Converts the planes of a YUV frame to RGB, using the fixed-function
+/// pipeline for the vertices
+const char yuv_fragment_shader[] =
+	"uniform sampler2D y_plane;\n"
+	"uniform sampler2D u_plane;\n"
+	"uniform sampler2D v_plane;\n"
+	"uniform mat3 coefficients;\n"
+	"uniform vec3 offsets;\n"
+	"\n"
+	"void main() {\n"
+	"	vec2 pos = gl_TexCoord[0].st;\n"
+	"	vec3 yuv = vec3(texture2D(y_plane, pos).r, texture2D(u_plane, pos).r, texture2D(v_plane, pos).r);\n"
+	"	gl_FragColor = vec4(clamp(coefficients * (yuv + offsets), 0.0, 1.0), 1.0);\n"
+	"}\n";
+}
+
+struct VideoOutGL::Functions {
+#define GL_FN(ret, name, args) \
+	ret (APIENTRY *name) args = reinterpret_cast<ret (APIENTRY *) args>(OpenGLWrapper::GetProcAddress("gl" #name))
+
+	GL_FN(GLuint, CreateShader, (GLenum));
+	GL_FN(void, ShaderSource, (GLuint, GLsizei, const char *const *, const GLint *));
+	GL_FN(void, CompileShader, (GLuint));
+	GL_FN(void, GetShaderiv, (GLuint, GLenum, GLint *));
+	GL_FN(void, GetShaderInfoLog, (GLuint, GLsizei, GLsizei *, char *));
+	GL_FN(void, DeleteShader, (GLuint));
+	GL_FN(GLuint, CreateProgram, ());
+	GL_FN(void, AttachShader, (GLuint, GLuint));
+	GL_FN(void, LinkProgram, (GLuint));
+	GL_FN(void, GetProgramiv, (GLuint, GLenum, GLint *));
+	GL_FN(void, GetProgramInfoLog, (GLuint, GLsizei, GLsizei *, char *));
+	GL_FN(void, DeleteProgram, (GLuint));
+	GL_FN(void, UseProgram, (GLuint));
+	GL_FN(GLint, GetUniformLocation, (GLuint, const char *));
+	GL_FN(void, Uniform1i, (GLint, GLint));
+	GL_FN(void, Uniform3fv, (GLint, GLsizei, const GLfloat *));
+	GL_FN(void, UniformMatrix3fv, (GLint, GLsizei, GLboolean, const GLfloat *));
+	GL_FN(void, ActiveTexture, (GLenum));
+	GL_FN(void, GenBuffers, (GLsizei, GLuint *));
+	GL_FN(void, DeleteBuffers, (GLsizei, const GLuint *));
+	GL_FN(void, BindBuffer, (GLenum, GLuint));
+	GL_FN(void, BufferData, (GLenum, GLsizeiptr, const void *, GLenum));
+	GL_FN(void *, MapBuffer, (GLenum, GLenum));
+	GL_FN(GLboolean, UnmapBuffer, (GLenum));
+
+#undef GL_FN
+
+	bool ShadersLoaded() const {
+		return CreateShader && ShaderSource && CompileShader && GetShaderiv
+			&& GetShaderInfoLog && DeleteShader && CreateProgram && AttachShader
+			&& LinkProgram && GetProgramiv && GetProgramInfoLog && DeleteProgram
+			&& UseProgram && GetUniformLocation && Uniform1i && Uniform3fv
+			&& UniformMatrix3fv && ActiveTexture;
+	}
+
+	bool BuffersLoaded() const {
+		return GenBuffers && DeleteBuffers && BindBuffer && BufferData
+			&& MapBuffer && UnmapBuffer;
+	}
+};
+
 /// @brief Structure tracking all precomputable information about a subtexture
 struct VideoOutGL::TextureInfo {
 	GLuint textureID = 0;
 	int dataOffset = 0;
+	int sourceX = 0;
+	int sourceY = 0;
 	int sourceH = 0;
 	int sourceW = 0;
 };
@@ -93,6 +169,121 @@ void VideoOutGL::DetectOpenGLCapabilities() {
 
 	// Test for rectangular texture support
 	supportsRectangularTextures = TestTexture(maxTextureSize, maxTextureSize >> 1, internalFormat);
+
+	gl = agi::make_unique<Functions>();
+
+	supportsShaders = InitShaders();
+	if (!supportsShaders) {
+		LOG_I("video/out/gl") << "Converting YUV video to RGB on the CPU";
+		if (yuvProgram) gl->DeleteProgram(yuvProgram);
+		yuvProgram = 0;
+	}
+
+	// Pixel buffer objects let the driver copy the frame to the texture in
+	// the background rather than blocking glTexSubImage2D until it's done
+	if (gl->BuffersLoaded() && OpenGLWrapper::IsExtensionSupported("GL_ARB_pixel_buffer_object")) {
+		gl->GenBuffers(2, pixelBuffers);
+		if (glGetError()) {
+			LOG_W("video/out/gl") << "Creating pixel buffer objects failed";
+			pixelBuffers[0] = pixelBuffers[1] = 0;
+		}
+	}
+	LOG_I("video/out/gl") << (pixelBuffers[0] ? "Uploading frames through pixel buffer objects" : "Uploading frames directly");
+}
+
+const unsigned char *VideoOutGL::StageUpload(VideoFrame const& frame) {
+	if (!pixelBuffers[0])
+		return frame.data.data();
+
+	// Alternate between the buffers and orphan the old storage, so that
+	// writing this frame never has to wait for the previous frame's upload
+	// to finish
+	nextPixelBuffer = !nextPixelBuffer;
+	gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, pixelBuffers[nextPixelBuffer]);
+	gl->BufferData(GL_PIXEL_UNPACK_BUFFER_ARB, frame.data.size(), nullptr, GL_STREAM_DRAW_ARB);
+	void *dst = gl->MapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+	if (!dst) {
+		gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+		while (glGetError()) { }
+		return frame.data.data();
+	}
+	memcpy(dst, frame.data.data(), frame.data.size());
+	gl->UnmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB);
+
+	// Texture uploads now read from offsets into the bound buffer
+	return nullptr;
+}
+
+void VideoOutGL::FinishUpload() {
+	if (pixelBuffers[0])
+		gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+}
+
+bool VideoOutGL::InitShaders() {
+	if (!gl->ShadersLoaded()) {
+		LOG_I("video/out/gl") << "OpenGL 2.0 is not supported";
+		return false;
+	}
+
+	GLuint shader = gl->CreateShader(GL_FRAGMENT_SHADER);
+	const char *source = yuv_fragment_shader;
+	gl->ShaderSource(shader, 1, &source, nullptr);
+	gl->CompileShader(shader);
+
+	GLint status = 0;
+	gl->GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		char log[1024] = {0};
+		gl->GetShaderInfoLog(shader, sizeof log, nullptr, log);
+		LOG_W("video/out/gl") << "Compiling YUV shader failed: " << log;
+		gl->DeleteShader(shader);
+		return false;
+	}
+
+	yuvProgram = gl->CreateProgram();
+	gl->AttachShader(yuvProgram, shader);
+	gl->LinkProgram(yuvProgram);
+	// The program keeps the shader alive for as long as it's attached
+	gl->DeleteShader(shader);
+
+	gl->GetProgramiv(yuvProgram, GL_LINK_STATUS, &status);
+	if (!status) {
+		char log[1024] = {0};
+		gl->GetProgramInfoLog(yuvProgram, sizeof log, nullptr, log);
+		LOG_W("video/out/gl") << "Linking YUV shader failed: " << log;
+		return false;
+	}
+
+	gl->UseProgram(yuvProgram);
+	gl->Uniform1i(gl->GetUniformLocation(yuvProgram, "y_plane"), 0);
+	gl->Uniform1i(gl->GetUniformLocation(yuvProgram, "u_plane"), 1);
+	gl->Uniform1i(gl->GetUniformLocation(yuvProgram, "v_plane"), 2);
+	yuvCoefficients = gl->GetUniformLocation(yuvProgram, "coefficients");
+	yuvOffsets = gl->GetUniformLocation(yuvProgram, "offsets");
+	gl->UseProgram(0);
+
+	if (GLenum err = glGetError()) {
+		LOG_W("video/out/gl") << "Setting up YUV shader failed with error code " << err;
+		return false;
+	}
+	return true;
+}
+
+void VideoOutGL::DeleteTextures() {
+	uploadedId = 0;
+	if (textureIdList.size() > 0) {
+		CHECK_INIT_ERROR(glDeleteTextures(textureIdList.size(), &textureIdList[0]));
+		textureIdList.clear();
+		textureList.clear();
+	}
+	if (yuvTextures[0]) {
+		CHECK_INIT_ERROR(glDeleteTextures(3, yuvTextures));
+		std::fill(std::begin(yuvTextures), std::end(yuvTextures), 0);
+	}
+	if (dl) {
+		CHECK_INIT_ERROR(glDeleteLists(dl, 1));
+		dl = 0;
+	}
 }
 
 /// @brief If needed, create the grid of textures for displaying frames of the given format
@@ -113,12 +304,7 @@ void VideoOutGL::InitTextures(int width, int height, GLenum format, int bpp, boo
 
 	DetectOpenGLCapabilities();
 
-	// Clean up old textures
-	if (textureIdList.size() > 0) {
-		CHECK_INIT_ERROR(glDeleteTextures(textureIdList.size(), &textureIdList[0]));
-		textureIdList.clear();
-		textureList.clear();
-	}
+	DeleteTextures();
 
 	// Create the textures
 	int textureArea = maxTextureSize - 2;
@@ -188,6 +374,8 @@ void VideoOutGL::InitTextures(int width, int height, GLenum format, int bpp, boo
 			// Width and height of the area read from the frame data
 			int sourceX = col * textureArea;
 			int sourceY = row * textureArea;
+			ti.sourceX  = sourceX;
+			ti.sourceY  = sourceY;
 			ti.sourceW  = std::min(frameWidth  - sourceX, maxTextureSize);
 			ti.sourceH  = std::min(frameHeight - sourceY, maxTextureSize);
 
@@ -250,34 +438,186 @@ void VideoOutGL::InitTextures(int width, int height, GLenum format, int bpp, boo
 	}
 }
 
+void VideoOutGL::InitYUVTextures(int width, int height, bool flipped) {
+	if (width == frameWidth && height == frameHeight && frameFormat == GL_LUMINANCE && flipped == frameFlipped) return;
+	frameWidth  = width;
+	frameHeight = height;
+	frameFormat = GL_LUMINANCE;
+	frameFlipped = flipped;
+	LOG_I("video/out/gl") << "Video size: " << width << "x" << height << " YUV";
+
+	DeleteTextures();
+
+	// OpenGL 2.0 supports non-power-of-two textures, so unlike the RGB grid
+	// each plane is a single texture of exactly the plane's size
+	CHECK_INIT_ERROR(glGenTextures(3, yuvTextures));
+	for (int i = 0; i < 3; ++i) {
+		int w = i == 0 ? width : (width + 1) / 2;
+		int h = i == 0 ? height : (height + 1) / 2;
+		CHECK_INIT_ERROR(glBindTexture(GL_TEXTURE_2D, yuvTextures[i]));
+		CHECK_INIT_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	}
+
+	CHECK_ERROR(dl = glGenLists(1));
+	CHECK_ERROR(glNewList(dl, GL_COMPILE));
+
+	CHECK_ERROR(glClearColor(0,0,0,0));
+	CHECK_ERROR(glClearStencil(0));
+	CHECK_ERROR(glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
+
+	CHECK_ERROR(glShadeModel(GL_FLAT));
+	CHECK_ERROR(glDisable(GL_BLEND));
+
+	CHECK_ERROR(glMatrixMode(GL_PROJECTION));
+	CHECK_ERROR(glLoadIdentity());
+	CHECK_ERROR(glPushMatrix());
+	if (frameFlipped) {
+		CHECK_ERROR(glOrtho(0.0f, frameWidth, 0.0f, frameHeight, -1000.0f, 1000.0f));
+	}
+	else {
+		CHECK_ERROR(glOrtho(0.0f, frameWidth, frameHeight, 0.0f, -1000.0f, 1000.0f));
+	}
+
+	// The textures are bound by Render() as binding them to units other
+	// than the first needs OpenGL 2.0 functions
+	glBegin(GL_QUADS);
+		glTexCoord2f(0, 0);  glVertex2f(0, 0);
+		glTexCoord2f(1, 0);  glVertex2f(width, 0);
+		glTexCoord2f(1, 1);  glVertex2f(width, height);
+		glTexCoord2f(0, 1);  glVertex2f(0, height);
+	glEnd();
+	if (GLenum err = glGetError()) throw VideoOutRenderException("GL_QUADS", err);
+	CHECK_ERROR(glPopMatrix());
+
+	glEndList();
+}
+
+void VideoOutGL::UploadYUVFrameData(VideoFrame const& frame) {
+	InitYUVTextures(frame.width, frame.height, frame.flipped);
+
+	float coefficients[9], offsets[3];
+	GetYCbCrTransform(frame.matrix, coefficients, offsets);
+	gl->UseProgram(yuvProgram);
+	gl->UniformMatrix3fv(yuvCoefficients, 1, GL_TRUE, coefficients);
+	gl->Uniform3fv(yuvOffsets, 1, offsets);
+	gl->UseProgram(0);
+
+	const size_t chroma_pitch = frame.pitch / 2;
+	const size_t chroma_height = (frame.height + 1) / 2;
+	const unsigned char *data = StageUpload(frame);
+	const unsigned char *planes[] = {
+		data,
+		data + frame.pitch * frame.height,
+		data + frame.pitch * frame.height + chroma_pitch * chroma_height
+	};
+
+	CHECK_ERROR(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	for (int i = 0; i < 3; ++i) {
+		CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, i == 0 ? frame.pitch : chroma_pitch));
+		CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, yuvTextures[i]));
+		CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+			i == 0 ? frame.width : (frame.width + 1) / 2,
+			i == 0 ? frame.height : chroma_height,
+			GL_LUMINANCE, GL_UNSIGNED_BYTE, planes[i]));
+	}
+	CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+	CHECK_ERROR(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+	FinishUpload();
+}
+
 void VideoOutGL::UploadFrameData(VideoFrame const& frame) {
 	if (frame.height == 0 || frame.width == 0) return;
+	AGI_TRACE_SCOPE("video/upload");
+
+	if (frame.format == VideoFrameFormat::YUV420P) {
+		DetectOpenGLCapabilities();
+		yuvActive = supportsShaders && (int)frame.width <= maxTextureSize && (int)frame.height <= maxTextureSize;
+		uploadedId = 0;
+		if (yuvActive)
+			return UploadYUVFrameData(frame);
+
+		ConvertToBGRA(frame, converted);
+		return UploadFrameData(converted);
+	}
+	yuvActive = false;
 
 	InitTextures(frame.width, frame.height, GL_BGRA_EXT, 4, frame.flipped);
 
+	// Frames which only differ from the one already on the textures in a
+	// small area, such as after editing a line on a paused frame, only
+	// need that area uploaded
+	if (frame.id && frame.id == uploadedId) return;
+	const bool changed_only = frame.base_id && frame.base_id == uploadedId;
+	uploadedId = frame.id;
+	if (changed_only)
+		return UploadChangedArea(frame);
+
 	// Set the row length, needed to be able to upload partial rows
 	CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.pitch / 4));
 
+	const unsigned char *data = StageUpload(frame);
 	for (auto& ti : textureList) {
 		CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, ti.textureID));
 		CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ti.sourceW,
-			ti.sourceH, GL_BGRA_EXT, GL_UNSIGNED_BYTE, &frame.data[ti.dataOffset]));
+			ti.sourceH, GL_BGRA_EXT, GL_UNSIGNED_BYTE, data + ti.dataOffset));
 	}
 
 	CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+	FinishUpload();
+}
+
+void VideoOutGL::UploadChangedArea(VideoFrame const& frame) {
+	auto const& area = frame.changed;
+	if (area.empty()) return;
+
+	// The area is usually small enough that going through the pixel buffer
+	// would cost more than it saves
+	CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.pitch / 4));
+	for (auto& ti : textureList) {
+		const int x0 = std::max(area.x, ti.sourceX);
+		const int x1 = std::min(area.x + area.w, ti.sourceX + ti.sourceW);
+		const int y0 = std::max(area.y, ti.sourceY);
+		const int y1 = std::min(area.y + area.h, ti.sourceY + ti.sourceH);
+		if (x0 >= x1 || y0 >= y1) continue;
+
+		CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, ti.textureID));
+		CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, x0 - ti.sourceX, y0 - ti.sourceY,
+			x1 - x0, y1 - y0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, &frame.data[y0 * frame.pitch + x0 * 4]));
+	}
+	CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
 }
 
 void VideoOutGL::Render(int dx1, int dy1, int dx2, int dy2) {
 	CHECK_ERROR(glViewport(dx1, dy1, dx2, dy2));
-	CHECK_ERROR(glCallList(dl));
+	if (yuvActive) {
+		gl->UseProgram(yuvProgram);
+		for (int i = 2; i >= 0; --i) {
+			gl->ActiveTexture(GL_TEXTURE0 + i);
+			CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, yuvTextures[i]));
+		}
+		CHECK_ERROR(glCallList(dl));
+		gl->UseProgram(0);
+	}
+	else
+		CHECK_ERROR(glCallList(dl));
 	CHECK_ERROR(glMatrixMode(GL_MODELVIEW));
 	CHECK_ERROR(glLoadIdentity());
 
 }
 
 VideoOutGL::~VideoOutGL() {
-	if (textureIdList.size() > 0) {
+	if (textureIdList.size() > 0)
 		glDeleteTextures(textureIdList.size(), &textureIdList[0]);
+	if (yuvTextures[0])
+		glDeleteTextures(3, yuvTextures);
+	if (dl)
 		glDeleteLists(dl, 1);
-	}
+	if (yuvProgram)
+		gl->DeleteProgram(yuvProgram);
+	if (pixelBuffers[0])
+		gl->DeleteBuffers(2, pixelBuffers);
 }
@@ -21,14 +21,16 @@
 
 #include <libaegisub/exception.h>
 
+#include <memory>
 #include <vector>
 
-struct VideoFrame;
+#include "video_frame.h"
 
 /// @class VideoOutGL
 /// @brief OpenGL based video renderer
 class VideoOutGL {
 	struct TextureInfo;
+	struct Functions;
 
 	/// The maximum texture size supported by the user's graphics card
 	int maxTextureSize = 0;
@@ -58,8 +60,48 @@ class VideoOutGL {
 	/// The number of columns of textures
 	int textureCols = 0;
 
+	/// OpenGL functions which have to be looked up at runtime
+	std::unique_ptr<Functions> gl;
+	/// Whether YUV frames can be converted to RGB with a shader
+	bool supportsShaders = false;
+	/// Pixel buffer objects which frames are uploaded through, alternating
+	/// between the two, or 0 if they aren't supported
+	GLuint pixelBuffers[2] = {0, 0};
+	/// Index in pixelBuffers of the buffer used for the last upload
+	int nextPixelBuffer = 0;
+	/// Shader program which converts YUV frames to RGB
+	GLuint yuvProgram = 0;
+	/// Y, U and V plane textures, used instead of the texture grid for YUV
+	/// frames
+	GLuint yuvTextures[3] = {0, 0, 0};
+	/// Location of the program's matrix and offset uniforms
+	GLint yuvCoefficients = -1;
+	GLint yuvOffsets = -1;
+	/// Whether the frame currently uploaded is in the YUV textures
+	bool yuvActive = false;
+	/// VideoFrame::id of the frame in the texture grid, or 0 if unknown
+	uint32_t uploadedId = 0;
+	/// Buffer which YUV frames are converted into when they can't be
+	/// converted on the GPU
+	VideoFrame converted;
+
 	void DetectOpenGLCapabilities();
+	/// Set up the YUV program, returning false if it isn't supported
+	bool InitShaders();
+	/// Delete the textures and display list for the current frame size
+	void DeleteTextures();
+	/// @brief Copy a frame's data to where texture uploads should read it from
+	/// @return Pointer to pass to glTexSubImage2D for the start of the data,
+	///         which is an offset into the bound pixel buffer if they're used
+	const unsigned char *StageUpload(VideoFrame const& frame);
+	/// Unbind the pixel buffer after the uploads reading from it are queued
+	void FinishUpload();
 	void InitTextures(int width, int height, GLenum format, int bpp, bool flipped);
+	void InitYUVTextures(int width, int height, bool flipped);
+	void UploadYUVFrameData(VideoFrame const& frame);
+	/// Upload just the area of a frame which differs from the frame already
+	/// in the texture grid
+	void UploadChangedArea(VideoFrame const& frame);
 
 	VideoOutGL(const VideoOutGL &) = delete;
 	VideoOutGL& operator=(const VideoOutGL&) = delete;
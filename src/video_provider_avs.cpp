@@ -40,6 +40,7 @@
 #include <libaegisub/path.h>
 #include <libaegisub/make_unique.h>
 
+#include <algorithm>
 #include <boost/algorithm/string/predicate.hpp>
 #include <mutex>
 
@@ -62,6 +63,8 @@ class AvisynthVideoProvider: public VideoProvider {
 	std::string colorspace;
 	std::string real_colorspace;
 	bool has_audio = false;
+	/// Threads for Avisynth+ to decode ahead with, or 0 to not prefetch
+	int prefetch_threads = 0;
 
 	AVSValue source_clip;
 	PClip RGB32Video;
@@ -91,11 +94,16 @@ public:
 	std::string GetColorSpace() const override     { return colorspace; }
 	std::string GetRealColorSpace() const override { return real_colorspace; }
 	bool HasAudio() const override                 { return has_audio; }
+	// Only worth caching if frames are being decoded ahead of when they're
+	// needed, as otherwise Avisynth's own cache does the same thing
+	bool WantsCaching() const override             { return prefetch_threads > 0; }
 };
 
 AvisynthVideoProvider::AvisynthVideoProvider(agi::fs::path const& filename, std::string const& colormatrix) {
 	agi::acs::CheckFileRead(filename);
 
+	prefetch_threads = std::max<int>(0, OPT_GET("Provider/Avisynth/Prefetch Threads")->GetInt());
+
 	std::lock_guard<std::mutex> lock(avs.GetMutex());
 
 #ifdef _WIN32
@@ -205,6 +213,20 @@ void AvisynthVideoProvider::Init(std::string const& colormatrix) {
 		script = avs.GetEnv()->Invoke("ConvertToRGB32", AVSValue(args, 2), argnames);
 	}
 
+	// Avisynth+ can run the filter chain on several threads, decoding the
+	// frames after each one requested while the caller is busy with it
+	if (prefetch_threads > 0 && avs.GetEnv()->FunctionExists("Prefetch")) {
+		try {
+			AVSValue args[2] = { script, prefetch_threads };
+			script = avs.GetEnv()->Invoke("Prefetch", AVSValue(args, 2));
+			LOG_I("avisynth/video") << "Prefetching with " << prefetch_threads << " threads";
+		}
+		catch (AvisynthError const& err) {
+			// Scripts which already call Prefetch can't have it added again
+			LOG_E("avisynth/video") << "Prefetch failed: " << err.msg;
+		}
+	}
+
 	RGB32Video = avs.GetEnv()->Invoke("Cache", script).AsClip();
 	vi = RGB32Video->GetVideoInfo();
 	fps = (double)vi.fps_numerator / vi.fps_denominator;
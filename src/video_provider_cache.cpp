@@ -20,19 +20,23 @@
 #include "video_frame.h"
 
 #include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
+#include <libaegisub/trace.h>
 
-#include <list>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <unordered_map>
 
 namespace {
-/// A video frame and its frame number
+/// A cached video frame and its place in the age list
 struct CachedFrame {
-	VideoFrame frame;
-	int frame_number;
-
-	CachedFrame(VideoFrame const& frame, int frame_number)
-	: frame(frame), frame_number(frame_number) { }
-
-	CachedFrame(CachedFrame const&) = delete;
+	std::shared_ptr<const VideoFrame> frame;
+	int frame_number = 0;
+	/// Next more recently used frame
+	CachedFrame *newer = nullptr;
+	/// Next less recently used frame
+	CachedFrame *older = nullptr;
 };
 
 /// @class VideoProviderCache
@@ -43,23 +47,58 @@ class VideoProviderCache final : public VideoProvider {
 
 	/// @brief Maximum size of the cache in bytes
 	///
-	/// Note that this is a soft limit. The cache stops allocating new frames
-	/// once it has exceeded the limit, but it never tries to shrink
+	/// The least recently used frames are dropped whenever the cache goes
+	/// over this, other than the most recent frame which is always kept.
 	const size_t max_cache_size = OPT_GET("Provider/Video/Cache/Size")->GetInt() << 20; // convert MB to bytes
 
-	/// Cache of video frames with the most recently used ones at the front
-	std::list<CachedFrame> cache;
+	/// Cached frames by frame number. Elements of an unordered_map aren't
+	/// moved by rehashing, so the age list can point into it.
+	std::unordered_map<int, CachedFrame> cache;
+	/// Most recently used frame
+	CachedFrame *newest = nullptr;
+	/// Least recently used frame
+	CachedFrame *oldest = nullptr;
+	/// Total size of the cached frames' data in bytes. Atomic so that the
+	/// memory usage report can read it from another thread.
+	std::atomic<size_t> cache_size{0};
+
+	/// Frame dropped from the cache which nothing else was still using, to
+	/// decode the next frame into rather than allocating a new one
+	std::shared_ptr<VideoFrame> spare;
+
+	/// Scale which the cached frames were decoded at
+	double proxy_scale = 1.;
+
+	agi::memory::Registration memory_registration = agi::memory::Register("Video frame cache", [this] { return cache_size.load(); });
+
+	void Unlink(CachedFrame *frame);
+	void PushNewest(CachedFrame *frame);
+	/// Drop the least recently used frame
+	void DropOldest();
+	void Clear();
+	/// Decode a frame and add it to the cache
+	std::shared_ptr<const VideoFrame> Insert(int n);
 
 public:
 	VideoProviderCache(std::unique_ptr<VideoProvider> master) : master(std::move(master)) { }
 
-	void GetFrame(int n, VideoFrame &frame) override;
+	void GetFrame(int n, VideoFrame &frame) override { frame = *GetSharedFrame(n); }
+	std::shared_ptr<const VideoFrame> GetSharedFrame(int n) override;
+	bool Prefetch(int n) override;
+	int GetPrefetchLimit() const override;
 
 	void SetColorSpace(std::string const& m) override {
-		cache.clear();
+		Clear();
 		return master->SetColorSpace(m);
 	}
 
+	void SetProxyScale(double scale) override {
+		if (scale == proxy_scale) return;
+		Clear();
+		proxy_scale = scale;
+		master->SetProxyScale(scale);
+	}
+
 	int GetFrameCount() const override             { return master->GetFrameCount(); }
 	int GetWidth() const override                  { return master->GetWidth(); }
 	int GetHeight() const override                 { return master->GetHeight(); }
@@ -74,28 +113,84 @@ public:
 	bool HasAudio() const override                 { return master->HasAudio(); }
 };
 
-void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
-	size_t total_size = 0;
+void VideoProviderCache::Unlink(CachedFrame *frame) {
+	(frame->newer ? frame->newer->older : newest) = frame->older;
+	(frame->older ? frame->older->newer : oldest) = frame->newer;
+	frame->newer = frame->older = nullptr;
+}
 
-	for (auto cur = cache.begin(); cur != cache.end(); ++cur) {
-		if (cur->frame_number == n) {
-			cache.splice(cache.begin(), cache, cur); // Move to front
-			out = cache.front().frame;
-			return;
-		}
+void VideoProviderCache::PushNewest(CachedFrame *frame) {
+	frame->older = newest;
+	frame->newer = nullptr;
+	(newest ? newest->newer : oldest) = frame;
+	newest = frame;
+}
 
-		total_size += cur->frame.data.size();
-	}
+void VideoProviderCache::DropOldest() {
+	CachedFrame *frame = oldest;
+	Unlink(frame);
+	cache_size -= frame->frame->data.size();
+
+	// Only this cache created the frame, so it's safe to reuse once no one
+	// else has a reference to it
+	if (frame->frame.use_count() == 1)
+		spare = std::const_pointer_cast<VideoFrame>(std::move(frame->frame));
 
-	master->GetFrame(n, out);
+	cache.erase(frame->frame_number);
+}
+
+void VideoProviderCache::Clear() {
+	cache.clear();
+	newest = oldest = nullptr;
+	cache_size = 0;
+	spare.reset();
+}
 
-	if (total_size >= max_cache_size) {
-		cache.splice(cache.begin(), cache, --cache.end()); // Move last to front
-		cache.front().frame_number = n;
-		cache.front().frame = out;
+std::shared_ptr<const VideoFrame> VideoProviderCache::GetSharedFrame(int n) {
+	auto it = cache.find(n);
+	if (it != cache.end()) {
+		agi::trace::Count("video/cache/hit");
+		CachedFrame *frame = &it->second;
+		if (frame != newest) {
+			Unlink(frame);
+			PushNewest(frame);
+		}
+		return frame->frame;
 	}
-	else
-		cache.emplace_front(out, n);
+
+	agi::trace::Count("video/cache/miss");
+	return Insert(n);
+}
+
+bool VideoProviderCache::Prefetch(int n) {
+	if (cache.count(n)) return false;
+	Insert(n);
+	return true;
+}
+
+int VideoProviderCache::GetPrefetchLimit() const {
+	// Leave half of the cache for the frames which have been viewed, so that
+	// prefetching can't push out the frame being looked at
+	const size_t frame_size = (size_t)std::max(GetWidth() * GetHeight() * 4, 1);
+	return (int)std::min<size_t>(max_cache_size / 2 / frame_size, std::numeric_limits<int>::max());
+}
+
+std::shared_ptr<const VideoFrame> VideoProviderCache::Insert(int n) {
+	auto frame = std::move(spare);
+	if (!frame)
+		frame = std::make_shared<VideoFrame>();
+	master->GetFrame(n, *frame);
+
+	CachedFrame& entry = cache[n];
+	entry.frame = frame;
+	entry.frame_number = n;
+	PushNewest(&entry);
+	cache_size += frame->data.size();
+
+	while (cache_size > max_cache_size && oldest != newest)
+		DropOldest();
+
+	return frame;
 }
 }
 
@@ -43,6 +43,9 @@
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace {
 typedef enum AGI_ColorSpaces {
 	AGI_CS_RGB = 0,
@@ -61,6 +64,18 @@ typedef enum AGI_ColorSpaces {
 	AGI_CS_ICTCP = 14
 } AGI_ColorSpaces;
 
+/// Can frames in the given format be handed to the video display as 8-bit
+/// 4:2:0 planes without any conversion other than dropping the extra bits?
+/// HEVC and AV1 sources are usually 10-bit, and for those reducing the depth
+/// while staying in YUV is much cheaper than swscale's conversion to RGB.
+bool IsPlanar420(int format) {
+	for (auto name : {"yuv420p", "yuv420p10le", "yuv420p10be", "yuv420p12le", "yuv420p12be"}) {
+		if (format == FFMS_GetPixFmt(name))
+			return true;
+	}
+	return false;
+}
+
 /// @class FFmpegSourceVideoProvider
 /// @brief Implements video loading through the FFMS library.
 class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvider {
@@ -70,6 +85,8 @@ class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvid
 
 	int Width = -1;                 ///< width in pixels
 	int Height = -1;                ///< height in pixels
+	int OutWidth = -1;              ///< width of decoded frames, smaller than Width for proxy decoding
+	int OutHeight = -1;             ///< height of decoded frames
 	int CS = -1;                    ///< Reported colorspace of first frame
 	int CR = -1;                    ///< Reported colorrange of first frame
 	double DAR;                     ///< display aspect ratio
@@ -77,17 +94,22 @@ class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvid
 	agi::vfr::Framerate Timecodes;  ///< vfr object
 	std::string ColorSpace;         ///< Colorspace name
 	std::string RealColorSpace;     ///< Colorspace name
+	bool NativeYUV = false;         ///< Output frames in the video's own YUV format
+	YCbCrCoefficients Matrix;       ///< Matrix for ColorSpace, for YUV output
 
 	char FFMSErrMsg[1024];          ///< FFMS error message
 	FFMS_ErrorInfo ErrInfo;         ///< FFMS error codes/messages
 	bool has_audio = false;
 
 	void LoadVideo(agi::fs::path const& filename, std::string const& colormatrix);
+	/// Set the size which frames are decoded at
+	void SetOutputSize(int width, int height);
 
 public:
 	FFmpegSourceVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br);
 
 	void GetFrame(int n, VideoFrame &out) override;
+	void SetProxyScale(double scale) override;
 
 	void SetColorSpace(std::string const& matrix) override {
 #if FFMS_VERSION >= ((2 << 24) | (17 << 16) | (1 << 8) | 0)
@@ -99,6 +121,7 @@ public:
 		else
 			return;
 		ColorSpace = matrix;
+		Matrix = GetYCbCrCoefficients(ColorSpace);
 #endif
 	}
 
@@ -182,57 +205,23 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 		TrackNumber = static_cast<int>(Selection);
 	}
 
-	// generate a name for the cache file
-	auto CacheName = GetCacheFilename(filename);
-
-	// try to read index
-	agi::scoped_holder<FFMS_Index*, void (FFMS_CC*)(FFMS_Index*)>
-		Index(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo), FFMS_DestroyIndex);
-
-	if (Index && FFMS_IndexBelongsToFile(Index, filename.string().c_str(), &ErrInfo))
-		Index = nullptr;
-
-	// time to examine the index and check if the track we want is indexed
-	// technically this isn't really needed since all video tracks should always be indexed,
-	// but a bit of sanity checking never hurt anyone
-	if (Index && TrackNumber >= 0) {
-		FFMS_Track *TempTrackData = FFMS_GetTrackFromIndex(Index, TrackNumber);
-		if (FFMS_GetNumFrames(TempTrackData) <= 0)
-			Index = nullptr;
-	}
-
-	// moment of truth
-	if (!Index) {
-		auto TrackMask = TrackSelection::None;
-		if (OPT_GET("Provider/FFmpegSource/Index All Tracks")->GetBool() || OPT_GET("Video/Open Audio")->GetBool())
-			TrackMask = TrackSelection::All;
-		Index = DoIndexing(Indexer, CacheName, TrackMask, GetErrorHandlingMode());
-	}
-	else {
-		FFMS_CancelIndexing(Indexer);
-	}
-
-	// update access time of index file so it won't get cleaned away
-	agi::fs::Touch(CacheName);
-
-	// we have now read the index and may proceed with cleaning the index cache
-	CleanCache();
+	auto Index = GetIndex(Indexer, filename, TrackNumber);
 
 	// track number still not set?
 	if (TrackNumber < 0) {
 		// just grab the first track
-		TrackNumber = FFMS_GetFirstIndexedTrackOfType(Index, FFMS_TYPE_VIDEO, &ErrInfo);
+		TrackNumber = FFMS_GetFirstIndexedTrackOfType(Index.get(), FFMS_TYPE_VIDEO, &ErrInfo);
 		if (TrackNumber < 0)
 			throw VideoNotSupported(std::string("Couldn't find any video tracks: ") + ErrInfo.Buffer);
 	}
 
 	// Check if there's an audio track
-	has_audio = FFMS_GetFirstTrackOfType(Index, FFMS_TYPE_AUDIO, nullptr) != -1;
+	has_audio = FFMS_GetFirstTrackOfType(Index.get(), FFMS_TYPE_AUDIO, nullptr) != -1;
 
 	// set thread count
 	int Threads = OPT_GET("Provider/Video/FFmpegSource/Decoding Threads")->GetInt();
 #if FFMS_VERSION < ((2 << 24) | (30 << 16) | (0 << 8) | 0)
-	if (FFMS_GetVersion() < ((2 << 24) | (17 << 16) | (2 << 8) | 1) && FFMS_GetSourceType(Index) == FFMS_SOURCE_LAVF)
+	if (FFMS_GetVersion() < ((2 << 24) | (17 << 16) | (2 << 8) | 1) && FFMS_GetSourceType(Index.get()) == FFMS_SOURCE_LAVF)
 		Threads = 1;
 #endif
 
@@ -244,7 +233,7 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 	else
 		SeekMode = FFMS_SEEK_NORMAL;
 
-	VideoSource = FFMS_CreateVideoSource(filename.string().c_str(), TrackNumber, Index, Threads, SeekMode, &ErrInfo);
+	VideoSource = FFMS_CreateVideoSource(filename.string().c_str(), TrackNumber, Index.get(), Threads, SeekMode, &ErrInfo);
 	if (!VideoSource)
 		throw VideoOpenError(std::string("Failed to open video track: ") + ErrInfo.Buffer);
 
@@ -281,9 +270,23 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 	}
 #endif
 
-	const int TargetFormat[] = { FFMS_GetPixFmt("bgra"), -1 };
-	if (FFMS_SetOutputFormatV2(VideoSource, TargetFormat, Width, Height, FFMS_RESIZER_BICUBIC, &ErrInfo))
-		throw VideoOpenError(std::string("Failed to set output format: ") + ErrInfo.Buffer);
+	Matrix = GetYCbCrCoefficients(ColorSpace);
+
+	// Converting to RGB with swscale is a large part of the time spent on
+	// each frame for high resolution video, so when the video display can
+	// do the conversion let it. Flipped or rotated video still goes through
+	// the conversion so that GetFrame doesn't have to rearrange each plane.
+	NativeYUV = OPT_GET("Provider/Video/FFmpegSource/Native YUV")->GetBool()
+		&& CS != AGI_CS_RGB
+		&& IsPlanar420(TempFrame->EncodedPixelFormat);
+#if FFMS_VERSION >= ((2 << 24) | (24 << 16) | (0 << 8) | 0)
+	NativeYUV = NativeYUV && VideoInfo->Rotation % 360 == 0;
+#endif
+#if FFMS_VERSION >= ((2 << 24) | (31 << 16) | (0 << 8) | 0)
+	NativeYUV = NativeYUV && VideoInfo->Flip == 0;
+#endif
+
+	SetOutputSize(Width, Height);
 
 	// get frame info data
 	FFMS_Track *FrameData = FFMS_GetTrackFromVideo(VideoSource);
@@ -314,6 +317,26 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 		Timecodes = agi::vfr::Framerate(TimecodesVector);
 }
 
+void FFmpegSourceVideoProvider::SetOutputSize(int width, int height) {
+	if (width == OutWidth && height == OutHeight) return;
+
+	// Proxy frames are only for display, so favor speed over quality when
+	// scaling them down
+	const int TargetFormat[] = { FFMS_GetPixFmt(NativeYUV ? "yuv420p" : "bgra"), -1 };
+	const int Resizer = width == Width && height == Height ? FFMS_RESIZER_BICUBIC : FFMS_RESIZER_FAST_BILINEAR;
+	if (FFMS_SetOutputFormatV2(VideoSource, TargetFormat, width, height, Resizer, &ErrInfo))
+		throw VideoOpenError(std::string("Failed to set output format: ") + ErrInfo.Buffer);
+	OutWidth = width;
+	OutHeight = height;
+}
+
+void FFmpegSourceVideoProvider::SetProxyScale(double scale) {
+	if (scale >= 1)
+		return SetOutputSize(Width, Height);
+	// Keep the size even so that 4:2:0 frames don't need padding
+	SetOutputSize(std::max(2, (int)(Width * scale) & ~1), std::max(2, (int)(Height * scale) & ~1));
+}
+
 void FFmpegSourceVideoProvider::GetFrame(int n, VideoFrame &out) {
 	n = mid(0, n, GetFrameCount() - 1);
 
@@ -321,57 +344,82 @@ void FFmpegSourceVideoProvider::GetFrame(int n, VideoFrame &out) {
 	if (!frame)
 		throw VideoDecodeError(std::string("Failed to retrieve frame: ") +  ErrInfo.Buffer);
 
-	out.data.assign(frame->Data[0], frame->Data[0] + frame->Linesize[0] * Height);
+	if (NativeYUV) {
+		// Pack the planes together without the decoder's padding
+		const int ChromaWidth = (OutWidth + 1) / 2;
+		const int ChromaHeight = (OutHeight + 1) / 2;
+		out.format = VideoFrameFormat::YUV420P;
+		out.matrix = Matrix;
+		out.flipped = false;
+		out.width = OutWidth;
+		out.height = OutHeight;
+		out.pitch = ChromaWidth * 2;
+		out.data.resize(out.pitch * OutHeight + 2 * ChromaWidth * ChromaHeight);
+
+		unsigned char *dst = out.data.data();
+		for (int plane = 0; plane < 3; ++plane) {
+			const int RowBytes = plane == 0 ? OutWidth : ChromaWidth;
+			const int Pitch = plane == 0 ? (int)out.pitch : ChromaWidth;
+			const int Rows = plane == 0 ? OutHeight : ChromaHeight;
+			for (int y = 0; y < Rows; ++y)
+				memcpy(dst + y * Pitch, frame->Data[plane] + y * frame->Linesize[plane], RowBytes);
+			dst += Pitch * Rows;
+		}
+		return;
+	}
+
+	out.format = VideoFrameFormat::BGRA;
+	out.data.assign(frame->Data[0], frame->Data[0] + frame->Linesize[0] * OutHeight);
 	out.flipped = false;
-	out.width = Width;
-	out.height = Height;
+	out.width = OutWidth;
+	out.height = OutHeight;
 	out.pitch = frame->Linesize[0];
 #if FFMS_VERSION >= ((2 << 24) | (31 << 16) | (0 << 8) | 0)
 	// Handle flip
 	if (VideoInfo->Flip > 0)
-		for (int x = 0; x < Height; ++x)
-			for (int y = 0; y < Width / 2; ++y)
+		for (int x = 0; x < OutHeight; ++x)
+			for (int y = 0; y < OutWidth / 2; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * x + 4 * (Width - 1 - y) + ch]);
+					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * x + 4 * (OutWidth - 1 - y) + ch]);
 
 	else if (VideoInfo->Flip < 0)
-		for (int x = 0; x < Height / 2; ++x)
-			for (int y = 0; y < Width; ++y)
+		for (int x = 0; x < OutHeight / 2; ++x)
+			for (int y = 0; y < OutWidth; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * (Height - 1 - x) + 4 * y + ch]);
+					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * (OutHeight - 1 - x) + 4 * y + ch]);
 #endif
 #if FFMS_VERSION >= ((2 << 24) | (24 << 16) | (0 << 8) | 0)
 	// Handle rotation
 	if (VideoInfo->Rotation % 360 == 180 || VideoInfo->Rotation % 360 == -180) {
 		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Height; ++x)
-			for (int y = 0; y < Width; ++y)
+		out.data.resize(OutWidth * OutHeight * 4);
+		for (int x = 0; x < OutHeight; ++x)
+			for (int y = 0; y < OutWidth; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Width * x + y) + ch] = data[frame->Linesize[0] * (Height - 1 - x) + 4 * (Width - 1 - y) + ch];
-		out.pitch = 4 * Width;
+					out.data[4 * (OutWidth * x + y) + ch] = data[frame->Linesize[0] * (OutHeight - 1 - x) + 4 * (OutWidth - 1 - y) + ch];
+		out.pitch = 4 * OutWidth;
 	}
 	else if (VideoInfo->Rotation % 180 == 90 || VideoInfo->Rotation % 360 == -270) {
 		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Width; ++x)
-			for (int y = 0; y < Height; ++y)
+		out.data.resize(OutWidth * OutHeight * 4);
+		for (int x = 0; x < OutWidth; ++x)
+			for (int y = 0; y < OutHeight; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Height * x + y) + ch] = data[frame->Linesize[0] * y + 4 * (Width - 1 - x) + ch];
-		out.width = Height;
-		out.height = Width;
-		out.pitch = 4 * Height;
+					out.data[4 * (OutHeight * x + y) + ch] = data[frame->Linesize[0] * y + 4 * (OutWidth - 1 - x) + ch];
+		out.width = OutHeight;
+		out.height = OutWidth;
+		out.pitch = 4 * OutHeight;
 	}
 	else if (VideoInfo->Rotation % 180 == 270 || VideoInfo->Rotation % 360 == -90) {
 		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Width; ++x)
-			for (int y = 0; y < Height; ++y)
+		out.data.resize(OutWidth * OutHeight * 4);
+		for (int x = 0; x < OutWidth; ++x)
+			for (int y = 0; y < OutHeight; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Height * x + y) + ch] = data[frame->Linesize[0] * (Height - 1 - y) + 4 * x + ch];
-		out.width = Height;
-		out.height = Width;
-		out.pitch = 4 * Height;
+					out.data[4 * (OutHeight * x + y) + ch] = data[frame->Linesize[0] * (OutHeight - 1 - y) + 4 * x + ch];
+		out.width = OutHeight;
+		out.height = OutWidth;
+		out.pitch = 4 * OutHeight;
 	}
 #endif
 }
@@ -18,12 +18,17 @@
 
 #include "factory_manager.h"
 #include "include/aegisub/video_provider.h"
+#include "media_staging.h"
 #include "options.h"
+#include "video_frame.h"
 
 #include <libaegisub/fs.h>
 #include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
 
 #include <boost/range/iterator_range.hpp>
+#include <map>
+#include <mutex>
 
 std::unique_ptr<VideoProvider> CreateDummyVideoProvider(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
 std::unique_ptr<VideoProvider> CreateYUV4MPEGVideoProvider(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
@@ -49,6 +54,103 @@ namespace {
 		{"Avisynth", CreateAvisynthVideoProvider, false},
 #endif
 	};
+
+	/// A video provider which is shared by every window with the video open
+	struct SharedSource {
+		std::mutex mutex;
+		std::unique_ptr<VideoProvider> provider;
+		/// Settings the provider was last used with
+		double scale = 1.;
+		std::string matrix;
+	};
+
+	/// One window's handle to a shared video provider. The windows may want
+	/// frames at different sizes or in different color spaces, so each
+	/// handle remembers its own settings and switches the provider to them
+	/// when it uses it.
+	class SharedVideoProvider final : public VideoProvider {
+		std::shared_ptr<SharedSource> source;
+		double scale = 1.;
+		std::string matrix;
+
+		/// Lock the source and switch it to this handle's settings
+		std::unique_lock<std::mutex> Use() const {
+			std::unique_lock<std::mutex> lock(source->mutex);
+			if (source->scale != scale) {
+				source->provider->SetProxyScale(scale);
+				source->scale = scale;
+			}
+			if (source->matrix != matrix) {
+				source->provider->SetColorSpace(matrix);
+				source->matrix = matrix;
+			}
+			return lock;
+		}
+
+	public:
+		SharedVideoProvider(std::shared_ptr<SharedSource> source, std::string matrix)
+		: source(std::move(source))
+		, matrix(std::move(matrix))
+		{
+		}
+
+		void GetFrame(int n, VideoFrame &frame) override {
+			auto lock = Use();
+			source->provider->GetFrame(n, frame);
+		}
+		std::shared_ptr<const VideoFrame> GetSharedFrame(int n) override {
+			auto lock = Use();
+			return source->provider->GetSharedFrame(n);
+		}
+		bool Prefetch(int n) override {
+			auto lock = Use();
+			return source->provider->Prefetch(n);
+		}
+
+		void SetColorSpace(std::string const& m) override { matrix = m; }
+		void SetProxyScale(double s) override { scale = s; }
+
+		std::string GetColorSpace() const override {
+			auto lock = Use();
+			return source->provider->GetColorSpace();
+		}
+		std::string GetRealColorSpace() const override {
+			auto lock = Use();
+			return source->provider->GetRealColorSpace();
+		}
+
+		// The rest don't change once the video is open
+		int GetPrefetchLimit() const override { return source->provider->GetPrefetchLimit(); }
+		int GetFrameCount() const override { return source->provider->GetFrameCount(); }
+		int GetWidth() const override { return source->provider->GetWidth(); }
+		int GetHeight() const override { return source->provider->GetHeight(); }
+		double GetDAR() const override { return source->provider->GetDAR(); }
+		agi::vfr::Framerate GetFPS() const override { return source->provider->GetFPS(); }
+		std::vector<int> GetKeyFrames() const override { return source->provider->GetKeyFrames(); }
+		std::string GetWarning() const override { return source->provider->GetWarning(); }
+		std::string GetDecoderName() const override { return source->provider->GetDecoderName(); }
+		bool ShouldSetVideoProperties() const override { return source->provider->ShouldSetVideoProperties(); }
+		bool HasAudio() const override { return source->provider->HasAudio(); }
+	};
+
+	/// Open videos by the file and the settings they were opened with
+	struct {
+		std::mutex mutex;
+		std::map<std::string, std::weak_ptr<SharedSource>> sources;
+	} shared_sources;
+
+	/// Key for a video in shared_sources. Everything which changes how the
+	/// video is decoded other than the color matrix is part of the key, so
+	/// that reloading the video after changing one of them opens it again.
+	std::string SharedSourceKey(agi::fs::path const& filename) {
+		std::string key = filename.string();
+		key += '\0' + OPT_GET("Video/Provider")->GetString();
+		for (auto name : {"Provider/Avisynth/Memory Max", "Provider/Avisynth/Prefetch Threads", "Provider/Video/FFmpegSource/Decoding Threads"})
+			key += '\0' + std::to_string(OPT_GET(name)->GetInt());
+		for (auto name : {"Provider/Avisynth/Allow Ancient", "Provider/Video/FFmpegSource/Unsafe Seeking"})
+			key += OPT_GET(name)->GetBool() ? '1' : '0';
+		return key;
+	}
 }
 
 std::vector<std::string> VideoProviderFactory::GetClasses() {
@@ -63,13 +165,14 @@ std::unique_ptr<VideoProvider> VideoProviderFactory::GetProvider(agi::fs::path c
 	bool supported = false;
 	std::string errors;
 	errors.reserve(1024);
+	auto source = StagedMediaPath(filename);
 
 	for (auto factory : sorted) {
 		std::string err;
 		try {
-			auto provider = factory->create(filename, colormatrix, br);
+			auto provider = factory->create(source, colormatrix, br);
 			if (!provider) continue;
-			LOG_I("manager/video/provider") << factory->name << ": opened " << filename;
+			LOG_I("manager/video/provider") << factory->name << ": opened " << source;
 			return provider->WantsCaching() ? CreateCacheVideoProvider(std::move(provider)) : std::move(provider);
 		}
 		catch (agi::fs::FileNotFound const&) {
@@ -102,3 +205,42 @@ std::unique_ptr<VideoProvider> VideoProviderFactory::GetProvider(agi::fs::path c
 	if (!supported) throw VideoNotSupported(msg);
 	throw VideoOpenError(msg);
 }
+
+std::unique_ptr<VideoProvider> VideoProviderFactory::GetSharedProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br) {
+	auto key = SharedSourceKey(filename);
+	std::shared_ptr<SharedSource> source;
+	{
+		std::lock_guard<std::mutex> lock(shared_sources.mutex);
+		source = shared_sources.sources[key].lock();
+	}
+
+	if (!source) {
+		// Opened without holding the lock, as indexing can take a while
+		source = std::make_shared<SharedSource>();
+		source->provider = GetProvider(filename, colormatrix, br);
+		source->matrix = colormatrix;
+
+		std::lock_guard<std::mutex> lock(shared_sources.mutex);
+		// Drop the entries for videos which nothing has open any more
+		for (auto it = shared_sources.sources.begin(); it != shared_sources.sources.end(); ) {
+			if (it->second.expired())
+				it = shared_sources.sources.erase(it);
+			else
+				++it;
+		}
+		// If another window opened the video at the same time, use its copy
+		auto& slot = shared_sources.sources[key];
+		if (auto existing = slot.lock())
+			source = std::move(existing);
+		else
+			slot = source;
+	}
+
+	return agi::make_unique<SharedVideoProvider>(std::move(source), colormatrix);
+}
+
+std::shared_ptr<const VideoFrame> VideoProvider::GetSharedFrame(int n) {
+	auto frame = std::make_shared<VideoFrame>();
+	GetFrame(n, *frame);
+	return frame;
+}
@@ -26,4 +26,12 @@ namespace agi { class BackgroundRunner; }
 struct VideoProviderFactory {
 	static std::vector<std::string> GetClasses();
 	static std::unique_ptr<VideoProvider> GetProvider(agi::fs::path const& video_file, std::string const& colormatrix, agi::BackgroundRunner *br);
+
+	/// @brief Get a provider for a video which shares its decoder and frame
+	///        cache with every other provider for the same video
+	///
+	/// Windows with the same video open would otherwise each index, decode
+	/// and cache it separately. The shared decoder is only used by one
+	/// provider at a time, and is closed once all of them are destroyed.
+	static std::unique_ptr<VideoProvider> GetSharedProvider(agi::fs::path const& video_file, std::string const& colormatrix, agi::BackgroundRunner *br);
 };
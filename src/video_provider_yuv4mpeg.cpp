@@ -41,9 +41,10 @@
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/util.h>
-#include <libaegisub/ycbcr_conv.h>
 
 #include <boost/algorithm/string/case_conv.hpp>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -117,6 +118,7 @@ class YUV4MPEGVideoProvider final : public VideoProvider {
 	int num_frames = -1; /// length of file in frames
 	int frame_sz;	/// size of each frame in bytes
 	int luma_sz;	/// size of the luma plane of each frame, in bytes
+	int chroma_w;	/// width of the chroma planes
 	int chroma_sz;	/// size of one of the two chroma planes of each frame, in bytes
 
 	Y4M_PixelFormat pixfmt = Y4M_PIXFMT_NONE;		/// colorspace/pixel format
@@ -128,7 +130,7 @@ class YUV4MPEGVideoProvider final : public VideoProvider {
 
 	agi::vfr::Framerate fps;
 
-	agi::ycbcr_converter conv{agi::ycbcr_matrix::bt601, agi::ycbcr_range::tv};
+	YCbCrCoefficients matrix = GetYCbCrCoefficients("TV.601");
 
 	/// a list of byte positions detailing where in the file
 	/// each frame header can be found
@@ -138,6 +140,7 @@ class YUV4MPEGVideoProvider final : public VideoProvider {
 	Y4M_FrameFlags ParseFrameHeader(const std::vector<std::string>& tags);
 	std::vector<std::string> ReadHeader(uint64_t &startpos);
 	int IndexFile(uint64_t pos);
+	bool IndexUniformFrames(uint64_t pos);
 
 public:
 	YUV4MPEGVideoProvider(agi::fs::path const& filename);
@@ -186,7 +189,8 @@ YUV4MPEGVideoProvider::YUV4MPEGVideoProvider(agi::fs::path const& filename)
 	case Y4M_PIXFMT_420JPEG:
 	case Y4M_PIXFMT_420MPEG2:
 	case Y4M_PIXFMT_420PALDV:
-		chroma_sz	= (w * h) >> 2; break;
+		chroma_w	= (w + 1) / 2;
+		chroma_sz	= chroma_w * ((h + 1) / 2); break;
 	default:
 		/// @todo add support for more pixel formats
 		throw VideoOpenError("Unsupported pixel format");
@@ -356,6 +360,9 @@ YUV4MPEGVideoProvider::Y4M_FrameFlags YUV4MPEGVideoProvider::ParseFrameHeader(co
 /// and creates a seek table that lists the byte positions of all frames so seeking
 /// can easily be done.
 int YUV4MPEGVideoProvider::IndexFile(uint64_t pos) {
+	if (IndexUniformFrames(pos))
+		return static_cast<int>(seek_table.size());
+
 	int framecount = 0;
 
 	// the ParseFileHeader() call in LoadVideo() will already have read
@@ -387,42 +394,58 @@ int YUV4MPEGVideoProvider::IndexFile(uint64_t pos) {
 	return framecount;
 }
 
+/// @brief Index the file without parsing each header if all of the frames have bare headers
+/// @return Was the file indexed?
+/// Nearly every file has nothing but "FRAME\n" headers after the file header,
+/// so the frames are evenly spaced and only the headers need checking.
+bool YUV4MPEGVideoProvider::IndexUniformFrames(uint64_t pos) {
+	static const char frame_header[] = "FRAME\n";
+	const uint64_t header_sz = sizeof(frame_header) - 1;
+	const uint64_t stride = header_sz + frame_sz;
+
+	const uint64_t remaining = file.size() - pos;
+	if (remaining < stride || remaining % stride != 0)
+		return false;
+
+	const uint64_t count = remaining / stride;
+	if (count > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+		return false;
+
+	std::vector<uint64_t> offsets;
+	offsets.reserve(count);
+	for (uint64_t frame_pos = pos; frame_pos < file.size(); frame_pos += stride) {
+		if (memcmp(file.read(frame_pos, header_sz), frame_header, header_sz))
+			return false;
+		offsets.push_back(frame_pos + header_sz);
+	}
+
+	seek_table = std::move(offsets);
+	return true;
+}
+
 void YUV4MPEGVideoProvider::GetFrame(int n, VideoFrame &frame) {
 	n = mid(0, n, num_frames - 1);
 
-	int uv_width = w / 2;
-
-	auto src_y = reinterpret_cast<const unsigned char *>(file.read(seek_table[n], luma_sz + chroma_sz * 2));
-	auto src_u = src_y + luma_sz;
-	auto src_v = src_u + chroma_sz;
-	frame.data.resize(w * h * 4);
-	unsigned char *dst = &frame.data[0];
-
-	for (int py = 0; py < h; ++py) {
-		for (int px = 0; px < w / 2; ++px) {
-			const uint8_t u = *src_u++;
-			const uint8_t v = *src_v++;
-			for (unsigned int i = 0; i < 2; ++i) {
-				const uint8_t y = *src_y++;
-				auto rgb = conv.ycbcr_to_rgb({{y, u, v}});
-				*dst++ = rgb[2];
-				*dst++ = rgb[1];
-				*dst++ = rgb[0];
-				*dst++ = 0;
-			}
-		}
-
-		// Roll back u/v on even lines
-		if (!(py & 1)) {
-			src_u -= uv_width;
-			src_v -= uv_width;
-		}
+	// The file's planes are already laid out the way YUV420P frames are, so
+	// this is a straight copy unless the width is odd and the luma rows
+	// need padding to twice the chroma width
+	auto src = file.read(seek_table[n], frame_sz);
+	const int pitch = chroma_w * 2;
+	frame.data.resize(pitch * h + chroma_sz * 2);
+	if (pitch == w)
+		memcpy(frame.data.data(), src, frame_sz);
+	else {
+		for (int y = 0; y < h; ++y)
+			memcpy(&frame.data[y * pitch], src + y * w, w);
+		memcpy(&frame.data[pitch * h], src + luma_sz, chroma_sz * 2);
 	}
 
+	frame.format = VideoFrameFormat::YUV420P;
+	frame.matrix = matrix;
 	frame.flipped = false;
 	frame.width = w;
 	frame.height = h;
-	frame.pitch = w * 4;
+	frame.pitch = pitch;
 }
 }
 
@@ -114,6 +114,12 @@ void VideoSlider::OnMouse(wxMouseEvent &event) {
 	if (event.ButtonDown())
 		SetFocus();
 
+	// The slider doesn't capture the mouse, so leaving it ends the drag too
+	if (event.LeftDown())
+		c->videoController->SetScrubbing(true);
+	else if (event.LeftUp() || event.Leaving())
+		c->videoController->SetScrubbing(false);
+
 	if (event.LeftIsDown()) {
 		int x = event.GetX();
 
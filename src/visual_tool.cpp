@@ -35,6 +35,7 @@
 
 #include <libaegisub/ass/time.h>
 #include <libaegisub/format.h>
+#include <libaegisub/make_unique.h>
 #include <libaegisub/of_type_adaptor.h>
 
 #include <algorithm>
@@ -59,9 +60,15 @@ VisualToolBase::VisualToolBase(VideoDisplay *parent, agi::Context *context)
 	parent->Bind(wxEVT_MOUSE_CAPTURE_LOST, &VisualToolBase::OnMouseCaptureLost, this);
 }
 
+VisualToolBase::~VisualToolBase() = default;
+
 void VisualToolBase::OnCommit(int type) {
 	holding = false;
 	dragging = false;
+	// Any changes which were being previewed have been committed with this
+	commit_pending = false;
+	changed_lines.clear();
+	parsed_overrides.clear();
 
 	if (type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_SCRIPTINFO) {
 		int script_w, script_h;
@@ -93,6 +100,7 @@ void VisualToolBase::OnSeek(int new_frame) {
 void VisualToolBase::OnMouseCaptureLost(wxMouseCaptureLostEvent &) {
 	holding = false;
 	dragging = false;
+	FlushDragCommit();
 }
 
 void VisualToolBase::OnActiveLineChanged(AssDialogue *new_line) {
@@ -123,6 +131,27 @@ void VisualToolBase::Commit(wxString message) {
 
 	commit_id = c->ass->Commit(message, AssFile::COMMIT_DIAG_TEXT, commit_id);
 	file_changed_connection.Unblock();
+	changed_lines.clear();
+	parsed_overrides.clear();
+}
+
+void VisualToolBase::Preview() {
+	// Dragging many lines sets overrides on all of them for each mouse move
+	std::sort(changed_lines.begin(), changed_lines.end());
+	changed_lines.erase(std::unique(changed_lines.begin(), changed_lines.end()), changed_lines.end());
+	c->videoController->PreviewLines(changed_lines);
+}
+
+void VisualToolBase::PreviewDrag() {
+	Preview();
+	commit_pending = true;
+}
+
+void VisualToolBase::FlushDragCommit() {
+	if (commit_pending) {
+		commit_pending = false;
+		Commit();
+	}
 }
 
 AssDialogue* VisualToolBase::GetActiveDialogueLine() {
@@ -193,11 +222,12 @@ void VisualTool<FeatureType>::OnMouseEvent(wxMouseEvent &event) {
 				sel->UpdateDrag(mouse_pos - drag_start, shift_down);
 			for (auto sel : sel_features)
 				UpdateDrag(sel);
-			Commit();
+			PreviewDrag();
 		}
 		// end drag
 		else {
 			dragging = false;
+			FlushDragCommit();
 
 			// mouse didn't move, fiddle with selection
 			if (active_feature && !active_feature->HasMoved()) {
@@ -224,8 +254,13 @@ void VisualTool<FeatureType>::OnMouseEvent(wxMouseEvent &event) {
 		}
 
 		UpdateHold();
-		Commit();
-
+		if (holding)
+			PreviewDrag();
+		else {
+			// Always commit the final state of the hold
+			commit_pending = false;
+			Commit();
+		}
 	}
 	else if (left_click) {
 		drag_start = mouse_pos;
@@ -278,6 +313,7 @@ void VisualTool<FeatureType>::DrawAllFeatures() {
 	wxColour base_fill = to_wx(line_color_primary_opt->GetColor());
 	wxColour active_fill = to_wx(highlight_color_secondary_opt->GetColor());
 	wxColour alt_fill = to_wx(line_color_primary_opt->GetColor());
+	gl.BeginBatch();
 	for (auto& feature : features) {
 		wxColour fill = base_fill;
 		if (&feature == active_feature)
@@ -287,6 +323,7 @@ void VisualTool<FeatureType>::DrawAllFeatures() {
 		gl.SetFillColour(fill, 0.3f);
 		feature.Draw(gl);
 	}
+	gl.EndBatch();
 }
 
 template<class FeatureType>
@@ -330,7 +367,7 @@ void VisualTool<FeatureType>::RemoveSelection(FeatureType *feat) {
 typedef const std::vector<AssOverrideParameter> * param_vec;
 
 // Find a tag's parameters in a line or return nullptr if it's not found
-static param_vec find_tag(std::vector<std::unique_ptr<AssDialogueBlock>>& blocks, std::string const& tag_name) {
+static param_vec find_tag(std::vector<std::unique_ptr<AssDialogueBlock>> const& blocks, std::string const& tag_name) {
 	for (auto ovr : blocks | agi::of_type<AssDialogueBlockOverride>()) {
 		for (auto const& tag : ovr->Tags) {
 			if (tag.Name == tag_name)
@@ -353,10 +390,10 @@ static Vector2D vec_or_bad(param_vec tag, size_t x_idx, size_t y_idx) {
 }
 
 Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedBlocks();
 
-	if (Vector2D ret = vec_or_bad(find_tag(blocks, "\\pos"), 0, 1)) return ret;
-	if (Vector2D ret = vec_or_bad(find_tag(blocks, "\\move"), 0, 1)) return ret;
+	if (Vector2D ret = vec_or_bad(find_tag(*blocks, "\\pos"), 0, 1)) return ret;
+	if (Vector2D ret = vec_or_bad(find_tag(*blocks, "\\move"), 0, 1)) return ret;
 
 	// Get default position
 	auto margin = diag->Margin;
@@ -372,9 +409,9 @@ Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
 
 	param_vec align_tag;
 	int ovr_align = 0;
-	if ((align_tag = find_tag(blocks, "\\an")))
+	if ((align_tag = find_tag(*blocks, "\\an")))
 		ovr_align = (*align_tag)[0].Get<int>(ovr_align);
-	else if ((align_tag = find_tag(blocks, "\\a")))
+	else if ((align_tag = find_tag(*blocks, "\\a")))
 		ovr_align = AssStyle::SsaToAss((*align_tag)[0].Get<int>(2));
 
 	if (ovr_align > 0 && ovr_align <= 9)
@@ -404,14 +441,14 @@ Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
 }
 
 Vector2D VisualToolBase::GetLineOrigin(AssDialogue *diag) {
-	auto blocks = diag->ParseTags();
-	return vec_or_bad(find_tag(blocks, "\\org"), 0, 1);
+	auto blocks = diag->GetParsedBlocks();
+	return vec_or_bad(find_tag(*blocks, "\\org"), 0, 1);
 }
 
 bool VisualToolBase::GetLineMove(AssDialogue *diag, Vector2D &p1, Vector2D &p2, int &t1, int &t2) {
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedBlocks();
 
-	param_vec tag = find_tag(blocks, "\\move");
+	param_vec tag = find_tag(*blocks, "\\move");
 	if (!tag)
 		return false;
 
@@ -430,26 +467,26 @@ void VisualToolBase::GetLineRotation(AssDialogue *diag, float &rx, float &ry, fl
 	if (AssStyle *style = c->ass->GetStyle(diag->Style))
 		rz = style->angle;
 
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedBlocks();
 
-	if (param_vec tag = find_tag(blocks, "\\frx"))
+	if (param_vec tag = find_tag(*blocks, "\\frx"))
 		rx = tag->front().Get(rx);
-	if (param_vec tag = find_tag(blocks, "\\fry"))
+	if (param_vec tag = find_tag(*blocks, "\\fry"))
 		ry = tag->front().Get(ry);
-	if (param_vec tag = find_tag(blocks, "\\frz"))
+	if (param_vec tag = find_tag(*blocks, "\\frz"))
 		rz = tag->front().Get(rz);
-	else if ((tag = find_tag(blocks, "\\fr")))
+	else if ((tag = find_tag(*blocks, "\\fr")))
 		rz = tag->front().Get(rz);
 }
 
 void VisualToolBase::GetLineShear(AssDialogue *diag, float& fax, float& fay) {
 	fax = fay = 0.f;
 
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedBlocks();
 
-	if (param_vec tag = find_tag(blocks, "\\fax"))
+	if (param_vec tag = find_tag(*blocks, "\\fax"))
 		fax = tag->front().Get(fax);
-	if (param_vec tag = find_tag(blocks, "\\fay"))
+	if (param_vec tag = find_tag(*blocks, "\\fay"))
 		fay = tag->front().Get(fay);
 }
 
@@ -461,11 +498,11 @@ void VisualToolBase::GetLineScale(AssDialogue *diag, Vector2D &scale) {
 		y = style->scaley;
 	}
 
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedBlocks();
 
-	if (param_vec tag = find_tag(blocks, "\\fscx"))
+	if (param_vec tag = find_tag(*blocks, "\\fscx"))
 		x = tag->front().Get(x);
-	if (param_vec tag = find_tag(blocks, "\\fscy"))
+	if (param_vec tag = find_tag(*blocks, "\\fscy"))
 		y = tag->front().Get(y);
 
 	scale = Vector2D(x, y);
@@ -474,12 +511,12 @@ void VisualToolBase::GetLineScale(AssDialogue *diag, Vector2D &scale) {
 void VisualToolBase::GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2, bool &inverse) {
 	inverse = false;
 
-	auto blocks = diag->ParseTags();
-	param_vec tag = find_tag(blocks, "\\iclip");
+	auto blocks = diag->GetParsedBlocks();
+	param_vec tag = find_tag(*blocks, "\\iclip");
 	if (tag)
 		inverse = true;
 	else
-		tag = find_tag(blocks, "\\clip");
+		tag = find_tag(*blocks, "\\clip");
 
 	if (tag && tag->size() == 4) {
 		p1 = vec_or_bad(tag, 0, 1);
@@ -492,16 +529,16 @@ void VisualToolBase::GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2,
 }
 
 std::string VisualToolBase::GetLineVectorClip(AssDialogue *diag, int &scale, bool &inverse) {
-	auto blocks = diag->ParseTags();
+	auto blocks = diag->GetParsedBlocks();
 
 	scale = 1;
 	inverse = false;
 
-	param_vec tag = find_tag(blocks, "\\iclip");
+	param_vec tag = find_tag(*blocks, "\\iclip");
 	if (tag)
 		inverse = true;
 	else
-		tag = find_tag(blocks, "\\clip");
+		tag = find_tag(*blocks, "\\clip");
 
 	if (tag && tag->size() == 4) {
 		return agi::format("m %d %d l %d %d %d %d %d %d"
@@ -523,9 +560,20 @@ void VisualToolBase::SetSelectedOverride(std::string const& tag, std::string con
 		SetOverride(line, tag, value);
 }
 
+struct VisualToolBase::ParsedOverrides {
+	/// Text of the line when block and rest were last in sync with it
+	FlyweightString text;
+	/// The line's first override block, which is added if it had none
+	std::unique_ptr<AssDialogueBlockOverride> block;
+	/// All of the line's text after block
+	std::string rest;
+};
+
 void VisualToolBase::SetOverride(AssDialogue* line, std::string const& tag, std::string const& value) {
 	if (!line) return;
 
+	changed_lines.push_back(line);
+
 	std::string removeTag;
 	if (tag == "\\1c") removeTag = "\\c";
 	else if (tag == "\\frz") removeTag = "\\fr";
@@ -534,26 +582,32 @@ void VisualToolBase::SetOverride(AssDialogue* line, std::string const& tag, std:
 	else if (tag == "\\clip") removeTag = "\\iclip";
 	else if (tag == "\\iclip") removeTag = "\\clip";
 
-	// Get block at start
-	auto blocks = line->ParseTags();
-	AssDialogueBlock *block = blocks.front().get();
-
-	if (block->GetType() == AssBlockType::OVERRIDE) {
-		auto ovr = static_cast<AssDialogueBlockOverride*>(block);
-		// Remove old of same
-		for (size_t i = 0; i < ovr->Tags.size(); i++) {
-			std::string const& name = ovr->Tags[i].Name;
-			if (tag == name || removeTag == name) {
-				ovr->Tags.erase(ovr->Tags.begin() + i);
-				i--;
-			}
+	// Reparse the line only if it's been changed by something else since
+	// the last time
+	auto& parsed = parsed_overrides[line];
+	if (!parsed || parsed->text != line->Text) {
+		parsed = agi::make_unique<ParsedOverrides>();
+		auto blocks = line->ParseTags();
+		auto first = blocks.begin();
+		if (first != blocks.end() && (*first)->GetType() == AssBlockType::OVERRIDE) {
+			parsed->block.reset(static_cast<AssDialogueBlockOverride *>(first->release()));
+			++first;
 		}
-		ovr->AddTag(tag + value);
-
-		line->UpdateText(blocks);
+		else
+			parsed->block = agi::make_unique<AssDialogueBlockOverride>();
+		for (; first != blocks.end(); ++first)
+			parsed->rest += (*first)->GetText();
 	}
-	else
-		line->Text = "{" + tag + value + "}" + line->Text.get();
+
+	// Remove old of same
+	auto& tags = parsed->block->Tags;
+	tags.erase(std::remove_if(tags.begin(), tags.end(), [&](AssOverrideTag const& ovr) {
+		return ovr.Name == tag || ovr.Name == removeTag;
+	}), tags.end());
+	parsed->block->AddTag(tag + value);
+
+	line->Text = parsed->block->GetText() + parsed->rest;
+	parsed->text = line->Text;
 }
 
 // If only export worked
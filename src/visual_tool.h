@@ -27,6 +27,8 @@
 #include <libaegisub/owning_intrusive_list.h>
 #include <libaegisub/signal.h>
 
+#include <map>
+#include <memory>
 #include <set>
 
 class AssDialogue;
@@ -114,9 +116,28 @@ protected:
 	agi::signal::Connection file_changed_connection;
 	int commit_id = -1; ///< Last used commit id for coalescing
 
+	/// Has a change made by a drag or hold not been committed yet?
+	bool commit_pending = false;
+	/// Lines changed by SetOverride since the last commit, possibly with
+	/// duplicates
+	std::vector<const AssDialogue *> changed_lines;
+
 	/// @brief Commit the current file state
 	/// @param message Description of changes for undo
 	virtual void Commit(wxString message = wxString());
+
+	/// @brief Show the changed lines on the video without committing them
+	///
+	/// Committing updates the grid and edit box, saves an undo point and
+	/// rerenders the subtitles, which for something like a clip with
+	/// thousands of points can take longer than the time between mouse
+	/// events. Drags and holds instead just redraw the video while they're
+	/// in progress and commit once when they finish.
+	virtual void Preview();
+	/// Preview a change made by a drag or hold in progress
+	void PreviewDrag();
+	/// Commit the changes previewed by PreviewDrag, if any
+	void FlushDragCommit();
 	bool IsDisplayed(AssDialogue *line) const;
 
 	/// Get the line's position if it's set, or it's default based on style if not
@@ -130,6 +151,12 @@ protected:
 	void GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2, bool &inverse);
 	std::string GetLineVectorClip(AssDialogue *diag, int &scale, bool &inverse);
 
+	/// A line's first override block and the text after it, kept across
+	/// the calls to SetOverride made by a drag so that each one only has to
+	/// change that block rather than parse the whole line again
+	struct ParsedOverrides;
+	std::map<AssDialogue *, std::unique_ptr<ParsedOverrides>> parsed_overrides;
+
 	void SetOverride(AssDialogue* line, std::string const& tag, std::string const& value);
 	void SetSelectedOverride(std::string const& tag, std::string const& value);
 
@@ -146,7 +173,7 @@ public:
 	virtual void Draw()=0;
 	virtual void SetDisplayArea(int x, int y, int w, int h);
 	virtual void SetToolbar(wxToolBar *) { }
-	virtual ~VisualToolBase() = default;
+	virtual ~VisualToolBase();
 };
 
 /// Visual tool base class containing all common feature-related functionality
@@ -21,14 +21,72 @@
 #include "visual_tool_clip.h"
 
 #include "ass_dialogue.h"
+#include "ass_file.h"
+#include "async_video_provider.h"
 #include "compat.h"
+#include "dialog_progress.h"
+#include "format.h"
 #include "include/aegisub/context.h"
+#include "libresrc/libresrc.h"
 #include "options.h"
+#include "project.h"
 #include "selection_controller.h"
+#include "utils.h"
+#include "video_frame.h"
 
 #include <libaegisub/format.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/motion_tracker.h>
+#include <libaegisub/of_type_adaptor.h>
+
+#include <algorithm>
 
 #include <wx/colour.h>
+#include <wx/msgdlg.h>
+#include <wx/toolbar.h>
+
+#define ICON(name) (OPT_GET("App/Toolbar Icon Size")->GetInt() == 16 ? GETIMAGE(name ## _16) : GETIMAGE(name ## _24))
+
+namespace {
+/// Widest image which motion is tracked in, as scaling frames down makes
+/// tracking much faster and barely less accurate
+const int max_track_width = 640;
+
+/// Get a frame's luma scaled down by factor in each direction
+std::vector<uint8_t> track_luma(VideoFrame const& frame, int factor, int width, int height) {
+	std::vector<uint8_t> out(width * height);
+	std::vector<unsigned> row(width);
+	for (int y = 0; y < height; ++y) {
+		std::fill(row.begin(), row.end(), 0);
+		for (int sy = y * factor; sy < (y + 1) * factor; ++sy) {
+			const unsigned char *src = &frame.data[(frame.flipped ? frame.height - 1 - sy : sy) * frame.pitch];
+			if (frame.format == VideoFrameFormat::YUV420P) {
+				for (int x = 0; x < width * factor; ++x)
+					row[x / factor] += src[x];
+			}
+			else {
+				for (int x = 0; x < width * factor; ++x, src += 4)
+					row[x / factor] += (src[2] * 77 + src[1] * 150 + src[0] * 29) >> 8;
+			}
+		}
+		for (int x = 0; x < width; ++x)
+			out[y * width + x] = static_cast<uint8_t>(row[x] / (factor * factor));
+	}
+	return out;
+}
+
+/// Remove the rectangular clip which picked the area to track from a line
+void remove_clip(AssDialogue *line) {
+	auto blocks = line->ParseTags();
+	for (auto ovr : blocks | agi::of_type<AssDialogueBlockOverride>()) {
+		auto& tags = ovr->Tags;
+		tags.erase(std::remove_if(tags.begin(), tags.end(), [](AssOverrideTag const& tag) {
+			return (tag.Name == "\\clip" || tag.Name == "\\iclip") && tag.Params.size() == 4;
+		}), tags.end());
+	}
+	line->UpdateText(blocks);
+}
+}
 
 VisualToolClip::VisualToolClip(VideoDisplay *parent, agi::Context *context)
 : VisualTool<ClipCorner>(parent, context)
@@ -63,6 +121,14 @@ VisualToolClip::VisualToolClip(VideoDisplay *parent, agi::Context *context)
 	feats[i]->vert = feats[1];
 }
 
+void VisualToolClip::SetToolbar(wxToolBar *tb) {
+	tb->AddTool(-1, _("Track the area inside the clip to the end of the selected lines"), ICON(visual_move));
+	tb->Realize();
+	tb->Show(true);
+
+	tb->Bind(wxEVT_TOOL, &VisualToolClip::OnTrack, this);
+}
+
 void VisualToolClip::Draw() {
 	if (!active_line) return;
 
@@ -146,3 +212,153 @@ void VisualToolClip::DoRefresh() {
 		SetFeaturePositions();
 	}
 }
+
+void VisualToolClip::OnTrack(wxCommandEvent &) {
+	auto provider = c->project->VideoProvider();
+	AssDialogue *tracked = active_line;
+	if (!tracked || !provider) return;
+
+	Vector2D p1, p2;
+	bool tracked_inverse;
+	GetLineClip(tracked, p1, p2, tracked_inverse);
+	if (p1 == Vector2D(0, 0) && p2 == script_res - 1) {
+		wxMessageBox(_("Draw a clip around the area to track first."), _("Track motion"), wxOK | wxICON_INFORMATION, c->parent);
+		return;
+	}
+
+	auto const& fps = c->project->Timecodes();
+	auto const& sel = c->selectionController->GetSelectedSet();
+	const int first = frame_number;
+	int last = first;
+	for (auto line : sel)
+		last = std::max(last, fps.FrameAtTime(line->End, agi::vfr::END));
+	last = std::min(last, provider->GetFrameCount() - 1);
+	if (last <= first) return;
+
+	std::vector<std::pair<int, double>> frames;
+	for (int i = first; i <= last; ++i)
+		frames.emplace_back(i, fps.TimeAtFrame(i));
+
+	// The region's motion at each frame, in the pixels of the scaled down
+	// images it was tracked in
+	std::vector<agi::motion::Transform> transforms;
+	Vector2D track_scale;
+	bool finished = false;
+
+	DialogProgress progress(c->parent, _("Track motion"));
+	try {
+		progress.Run([&](agi::ProgressSink *ps) {
+			ps->SetMessage(from_wx(_("Tracking...")));
+
+			std::unique_ptr<agi::motion::Tracker> tracker;
+			int factor = 1, width = 0, height = 0;
+			size_t lost = 0;
+
+			// The frames are decoded ahead on the video provider's decoder
+			// thread while the ones already decoded are tracked
+			provider->GetFrames(frames, true, [&](int n, std::shared_ptr<const VideoFrame> frame) {
+				if (ps->IsCancelled())
+					throw agi::UserCancelException("Motion tracking cancelled");
+
+				if (!tracker) {
+					factor = std::max<int>(1, (frame->width + max_track_width - 1) / max_track_width);
+					width = frame->width / factor;
+					height = frame->height / factor;
+					track_scale = Vector2D(width, height) / script_res;
+				}
+
+				auto luma = track_luma(*frame, factor, width, height);
+				agi::motion::Pyramid pyramid(luma.data(), width, height, width);
+				if (!tracker) {
+					auto a = p1.Min(p2) * track_scale, b = p1.Max(p2) * track_scale;
+					tracker = agi::make_unique<agi::motion::Tracker>(std::move(pyramid), a.X(), a.Y(), b.X(), b.Y());
+				}
+				else if (!tracker->Track(std::move(pyramid)))
+					++lost;
+
+				transforms.push_back(tracker->Current());
+				ps->SetProgress(n - first + 1, frames.size());
+			});
+
+			if (lost)
+				ps->Log(from_wx(fmt_plural(lost,
+					"The area could not be found on one frame, which was given the last position it was found at.",
+					"The area could not be found on %u frames, which were given the last position it was found at.",
+					lost)));
+			finished = true;
+		});
+	}
+	catch (agi::UserCancelException const&) {
+		return;
+	}
+	if (!finished || transforms.size() != frames.size()) return;
+
+	auto move = [&](Vector2D p, agi::motion::Transform const& t) {
+		auto offset = p * track_scale - Vector2D(transforms[0].x, transforms[0].y);
+		double x, y;
+		t.Apply(offset.X(), offset.Y(), x, y);
+		return Vector2D(x, y) / track_scale;
+	};
+
+	// Everything is read from the lines before any of them are changed
+	struct Original {
+		AssDialogue *line;
+		int first, last;
+		Vector2D pos, org, scale;
+		float rz;
+	};
+	std::vector<Original> originals;
+	for (auto& line : c->ass->Events) {
+		if (!sel.count(&line)) continue;
+		Original orig;
+		orig.line = &line;
+		orig.first = fps.FrameAtTime(line.Start, agi::vfr::START);
+		orig.last = fps.FrameAtTime(line.End, agi::vfr::END);
+		orig.pos = GetLinePosition(&line);
+		orig.org = GetLineOrigin(&line);
+		GetLineScale(&line, orig.scale);
+		float rx, ry;
+		GetLineRotation(&line, rx, ry, orig.rz);
+		originals.push_back(orig);
+	}
+
+	// Each line is split into one line per tracked frame, with the part
+	// before the current frame (if any) left as it was
+	Selection new_sel;
+	AssDialogue *new_active = tracked;
+	for (auto const& orig : originals) {
+		new_sel.insert(orig.line);
+		const int start = std::max(first, orig.first), end = std::min(last, orig.last);
+		if (start > end) continue;
+
+		remove_clip(orig.line);
+		auto next = ++c->ass->iterator_to(*orig.line);
+		for (int frame = start; frame <= end; ++frame) {
+			AssDialogue *line = orig.line;
+			if (frame != orig.first) {
+				line = new AssDialogue(*orig.line);
+				c->ass->Events.insert(next, *line);
+				new_sel.insert(line);
+			}
+			line->Start = fps.TimeAtFrame(frame, agi::vfr::START);
+			line->End = fps.TimeAtFrame(frame, agi::vfr::END);
+
+			auto const& t = transforms[frame - first];
+			SetOverride(line, "\\pos", move(orig.pos, t).PStr());
+			if (orig.org)
+				SetOverride(line, "\\org", move(orig.org, t).PStr());
+			SetOverride(line, "\\frz", agi::format("%.4g", orig.rz - t.angle));
+			SetOverride(line, "\\fscx", float_to_string(orig.scale.X() * t.scale));
+			SetOverride(line, "\\fscy", float_to_string(orig.scale.Y() * t.scale));
+
+			if (orig.line == tracked && frame == first)
+				new_active = line;
+		}
+
+		if (orig.first < start)
+			orig.line->End = fps.TimeAtFrame(start, agi::vfr::START);
+	}
+
+	c->ass->Commit(_("track motion"), AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_FULL);
+	c->selectionController->SetSelectionAndActive(std::move(new_sel), new_active);
+}
@@ -29,6 +29,9 @@ struct ClipCorner final : public VisualDraggableFeature {
 	ClipCorner() { type = DRAG_SMALL_CIRCLE; }
 };
 
+class wxCommandEvent;
+class wxToolBar;
+
 class VisualToolClip final : public VisualTool<ClipCorner> {
 	Vector2D cur_1;
 	Vector2D cur_2;
@@ -46,6 +49,13 @@ class VisualToolClip final : public VisualTool<ClipCorner> {
 	void UpdateDrag(ClipCorner *feature) override;
 
 	void Draw() override;
+
+	/// Track the motion of the area inside the clip from the current frame
+	/// to the end of the selected lines, and split the lines into one per
+	/// frame which follows it
+	void OnTrack(wxCommandEvent &);
 public:
 	VisualToolClip(VideoDisplay *parent, agi::Context *context);
+
+	void SetToolbar(wxToolBar *tb) override;
 };
@@ -48,8 +48,6 @@ VisualToolDrag::VisualToolDrag(VideoDisplay *parent, agi::Context *context)
 : VisualTool<VisualToolDragDraggableFeature>(parent, context)
 {
 	connections.push_back(c->selectionController->AddSelectionListener(&VisualToolDrag::OnSelectedSetChanged, this));
-	auto const& sel_set = c->selectionController->GetSelectedSet();
-	selection.insert(begin(selection), begin(sel_set), end(sel_set));
 }
 
 void VisualToolDrag::SetToolbar(wxToolBar *tb) {
@@ -79,7 +77,7 @@ void VisualToolDrag::UpdateToggleButtons() {
 void VisualToolDrag::OnSubTool(wxCommandEvent &) {
 	// Toggle \move <-> \pos
 	VideoController *vc = c->videoController.get();
-	for (auto line : selection) {
+	for (auto line : c->selectionController->GetSelectedSet()) {
 		Vector2D p1, p2;
 		int t1, t2;
 
@@ -155,19 +153,17 @@ template<class C, class T> static bool line_not_present(C const& set, T const& i
 }
 
 void VisualToolDrag::OnSelectedSetChanged() {
-	auto const& new_sel_set = c->selectionController->GetSelectedSet();
-	std::vector<AssDialogue *> new_sel(begin(new_sel_set), end(new_sel_set));
+	auto const& added = c->selectionController->GetAddedLines();
+	auto const& removed = c->selectionController->GetRemovedLines();
 
 	bool any_changed = false;
 	for (auto it = features.begin(); it != features.end(); ) {
-		bool was_selected = boost::binary_search(selection, it->line);
-		bool is_selected = boost::binary_search(new_sel, it->line);
-		if (was_selected && !is_selected) {
+		if (boost::binary_search(removed, it->line)) {
 			sel_features.erase(&*it++);
 			any_changed = true;
 		}
 		else {
-			if (is_selected && !was_selected && it->type == DRAG_START && line_not_present(sel_features, it)) {
+			if (it->type == DRAG_START && boost::binary_search(added, it->line) && line_not_present(sel_features, it)) {
 				sel_features.insert(&*it);
 				any_changed = true;
 			}
@@ -177,7 +173,6 @@ void VisualToolDrag::OnSelectedSetChanged() {
 
 	if (any_changed)
 		parent->Render();
-	selection = std::move(new_sel);
 }
 
 void VisualToolDrag::Draw() {
@@ -238,7 +233,7 @@ void VisualToolDrag::MakeFeatures(AssDialogue *diag, feature_list::iterator pos)
 	feat->type = DRAG_START;
 	feat->line = diag;
 
-	if (boost::binary_search(selection, diag))
+	if (c->selectionController->GetSelectedSet().count(diag))
 		sel_features.insert(feat.get());
 	features.insert(pos, *feat.release());
 
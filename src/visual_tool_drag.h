@@ -44,8 +44,6 @@ class VisualToolDrag final : public VisualTool<VisualToolDragDraggableFeature> {
 	/// nullptr if no features have been clicked on or the last clicked on one no
 	/// longer exists
 	Feature *primary = nullptr;
-	/// The last announced selection set
-	std::vector<AssDialogue *> selection;
 
 	/// When the button is pressed, will it convert the line to a move (vs. from
 	/// move to pos)? Used to avoid changing the button's icon unnecessarily
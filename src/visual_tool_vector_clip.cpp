@@ -130,6 +130,7 @@ void VisualToolVectorClip::Draw() {
 	}
 
 	// Draw lines connecting the bicubic features
+	gl.BeginBatch();
 	gl.SetLineColour(line_color, 0.9f, 1);
 	for (auto const& curve : spline) {
 		if (curve.type == SplineCurve::BICUBIC) {
@@ -156,6 +157,7 @@ void VisualToolVectorClip::Draw() {
 			gl.DrawCircle(feature.pos, 2.f);
 		}
 	}
+	gl.EndBatch();
 
 	// Draw preview of inserted line
 	if (mode == 1 || mode == 2) {
@@ -239,6 +241,11 @@ void VisualToolVectorClip::Commit(wxString message) {
 	VisualToolBase::Commit(message);
 }
 
+void VisualToolVectorClip::Preview() {
+	Save();
+	VisualToolBase::Preview();
+}
+
 void VisualToolVectorClip::UpdateDrag(Feature *feature) {
 	spline.MovePoint(spline.begin() + feature->idx, feature->point, feature->pos);
 }
@@ -416,7 +423,18 @@ void VisualToolVectorClip::UpdateHold() {
 		else
 			curve.p2 = curve.p1 * 0.75 + curve.p4 * 0.25;
 		curve.p3 = curve.p1 * 0.25 + curve.p4 * 0.75;
-		MakeFeatures();
+
+		// Only the features of the curve being drawn have moved, and
+		// recreating all of them on every mouse move is slow for large clips
+		const size_t idx = spline.size() - 1;
+		for (auto it = features.rbegin(); it != features.rend() && it->idx == idx; ++it) {
+			switch (it->point) {
+				case 0: it->pos = curve.p1; break;
+				case 1: it->pos = curve.p2; break;
+				case 2: it->pos = curve.p3; break;
+				case 3: it->pos = curve.p4; break;
+			}
+		}
 	}
 
 	// Freehand
@@ -0,0 +1,59 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/block_cache.h>
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+namespace {
+/// Same shape as the spectrum's blocks: a fixed-size float array per block
+struct SpectrumFactory {
+	typedef std::unique_ptr<float, std::default_delete<float[]>> BlockType;
+	static const size_t block_values = 256;
+	BlockType ProduceBlock(size_t i, BlockType spare) {
+		if (!spare)
+			spare.reset(new float[block_values]);
+		for (size_t j = 0; j < block_values; ++j)
+			spare.get()[j] = static_cast<float>(i + j);
+		return spare;
+	}
+	size_t GetBlockSize() const { return block_values * sizeof(float); }
+};
+
+/// Get with the access pattern of scrolling through the spectrum: a
+/// screen-sized window of blocks which are all hits, sliding forward so
+/// that each step misses on the new blocks and ages out the ones which
+/// scrolled off
+void BM_spectrum_scrolling(benchmark::State &state) {
+	const size_t block_count = 1 << 17;
+	const size_t window = 2000;
+	const size_t step = 16;
+	const size_t max_size = 4 * window * SpectrumFactory::block_values * sizeof(float);
+
+	agi::DataBlockCache<float, 10, SpectrumFactory> cache(block_count, SpectrumFactory{});
+	size_t first = 0;
+	for (auto _ : state) {
+		for (size_t i = first; i < first + window; ++i)
+			benchmark::DoNotOptimize(cache.Get(i));
+		cache.Age(max_size);
+		first = first + window + step < block_count ? first + step : 0;
+	}
+	state.SetItemsProcessed(state.iterations() * window);
+}
+BENCHMARK(BM_spectrum_scrolling);
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/character_count.h>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+void BM_CharacterCount(benchmark::State &state, std::string const& text) {
+	const int mask = static_cast<int>(state.range(0));
+	for (auto _ : state)
+		benchmark::DoNotOptimize(agi::CharacterCount(text, mask));
+	state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+const std::string ascii = "{\\i1}Some plain ASCII text,{\\i0} which is the common case. With punctuation!";
+const std::string japanese = "{\\i1}\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE6\x96\x87\xE7\xAB\xA0{\\i0}\xE3\x80\x81\xE3\x81\x93\xE3\x82\x8C\xE3\x81\xAF\xE3\x83\x86\xE3\x82\xB9\xE3\x83\x88\xE3\x81\xA7\xE3\x81\x99\xE3\x80\x82";
+
+BENCHMARK_CAPTURE(BM_CharacterCount, ascii, ascii)
+	->Arg(agi::IGNORE_NONE)
+	->Arg(agi::IGNORE_BLOCKS)
+	->Arg(agi::IGNORE_WHITESPACE | agi::IGNORE_PUNCTUATION | agi::IGNORE_BLOCKS);
+BENCHMARK_CAPTURE(BM_CharacterCount, japanese, japanese)
+	->Arg(agi::IGNORE_NONE)
+	->Arg(agi::IGNORE_WHITESPACE | agi::IGNORE_PUNCTUATION | agi::IGNORE_BLOCKS);
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/dialogue_parser.h>
+
+#include <benchmark/benchmark.h>
+
+using namespace agi::ass;
+
+namespace {
+const std::string line = "{\\an8\\pos(640,50)\\fad(200,200)\\blur2}Some text {\\i1}with italics{\\i0} and a\\Nline break "
+	"{\\t(0,500,\\fscx120\\fscy120)\\1c&H00FFFF&}then a transform, {comment} and {\\p1}m 0 0 l 100 0 100 100 0 100{\\p0} a drawing";
+
+void BM_TokenizeDialogueBody(benchmark::State &state) {
+	for (auto _ : state)
+		benchmark::DoNotOptimize(TokenizeDialogueBody(line));
+	state.SetBytesProcessed(state.iterations() * line.size());
+}
+BENCHMARK(BM_TokenizeDialogueBody);
+
+void BM_SplitWords(benchmark::State &state) {
+	auto tokens = TokenizeDialogueBody(line);
+	for (auto _ : state) {
+		auto copy = tokens;
+		SplitWords(line, copy);
+		benchmark::DoNotOptimize(copy);
+	}
+	state.SetBytesProcessed(state.iterations() * line.size());
+}
+BENCHMARK(BM_SplitWords);
+
+void BM_SyntaxHighlight(benchmark::State &state) {
+	auto tokens = TokenizeDialogueBody(line);
+	SplitWords(line, tokens);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(SyntaxHighlight(line, tokens, nullptr));
+	state.SetBytesProcessed(state.iterations() * line.size());
+}
+BENCHMARK(BM_SyntaxHighlight);
+}
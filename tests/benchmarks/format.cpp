@@ -0,0 +1,47 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/format.h>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/interprocess/streams/vectorstream.hpp>
+
+namespace {
+// A timestamp, a style name and a number, as in writing out a line
+void BM_format_stream(benchmark::State &state) {
+	int i = 0;
+	for (auto _ : state) {
+		boost::interprocess::basic_vectorstream<std::string> out;
+		agi::format(out, "%d:%02d:%02d.%02d,%s,%g", i / 360000, i / 6000 % 60, i / 100 % 60, i % 100, "Default", i / 7.0);
+		benchmark::DoNotOptimize(out.vector().data());
+		++i;
+	}
+}
+BENCHMARK(BM_format_stream);
+
+void BM_format_to_string(benchmark::State &state) {
+	int i = 0;
+	std::string out;
+	for (auto _ : state) {
+		out.clear();
+		agi::format_to(out, "%d:%02d:%02d.%02d,%s,%g", i / 360000, i / 6000 % 60, i / 100 % 60, i % 100, "Default", i / 7.0);
+		benchmark::DoNotOptimize(out.data());
+		++i;
+	}
+}
+BENCHMARK(BM_format_to_string);
+}
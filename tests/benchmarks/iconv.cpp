@@ -0,0 +1,50 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/charset_conv.h>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+std::string make_text(size_t size) {
+	const std::string sample = "Some text with a little \xC3\xA9\xC3\xA8 and \xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E in it. ";
+	std::string text;
+	while (text.size() < size)
+		text += sample;
+	return text;
+}
+
+void BM_IconvWrapper(benchmark::State &state, const char *dest) {
+	const std::string text = make_text(state.range(0));
+	agi::charset::IconvWrapper conv("utf-8", dest);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(conv.Convert(text));
+	state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_CAPTURE(BM_IconvWrapper, utf16le, "utf-16le")->Arg(64)->Arg(64 * 1024);
+BENCHMARK_CAPTURE(BM_IconvWrapper, shift_jis, "shift_jis")->Arg(64)->Arg(64 * 1024);
+
+void BM_IconvWrapper_RoundTrip(benchmark::State &state) {
+	const std::string text = make_text(state.range(0));
+	agi::charset::IconvWrapper to("utf-8", "utf-16le");
+	agi::charset::IconvWrapper from("utf-16le", "utf-8");
+	const std::string utf16 = to.Convert(text);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(from.Convert(utf16));
+	state.SetBytesProcessed(state.iterations() * utf16.size());
+}
+BENCHMARK(BM_IconvWrapper_RoundTrip)->Arg(64 * 1024);
+}
@@ -0,0 +1,33 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/karaoke_matcher.h>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+void BM_auto_match_karaoke(benchmark::State &state, std::vector<std::string> const& src, std::string const& dst) {
+	for (auto _ : state)
+		benchmark::DoNotOptimize(agi::auto_match_karaoke(src, dst));
+}
+
+BENCHMARK_CAPTURE(BM_auto_match_karaoke, romaji,
+	std::vector<std::string>{"ha", "ji", "me", "te ", "no ", "ko", "to", "ba"},
+	"\xE5\x88\x9D\xE3\x82\x81\xE3\x81\xA6\xE3\x81\xAE\xE8\xA8\x80\xE8\x91\x89");
+BENCHMARK_CAPTURE(BM_auto_match_karaoke, kana,
+	std::vector<std::string>{"\xE3\x81\xAF", "\xE3\x81\x98", "\xE3\x82\x81", "\xE3\x81\xA6"},
+	"\xE5\x88\x9D\xE3\x82\x81\xE3\x81\xA6");
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/line_iterator.h>
+
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+
+namespace {
+std::string make_file(size_t lines) {
+	std::string file;
+	for (size_t i = 0; i < lines; ++i)
+		file += "Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,,Some line of dialogue\r\n";
+	return file;
+}
+
+void BM_line_iterator(benchmark::State &state, const char *encoding) {
+	const std::string file = make_file(state.range(0));
+	for (auto _ : state) {
+		std::stringstream stream(file);
+		size_t count = 0;
+		for (auto const& line : agi::line_iterator<std::string>(stream, encoding)) {
+			benchmark::DoNotOptimize(line);
+			++count;
+		}
+		benchmark::DoNotOptimize(count);
+	}
+	state.SetBytesProcessed(state.iterations() * file.size());
+}
+BENCHMARK_CAPTURE(BM_line_iterator, utf8, "utf-8")->Arg(10000);
+BENCHMARK_CAPTURE(BM_line_iterator, latin1, "iso-8859-1")->Arg(10000);
+}
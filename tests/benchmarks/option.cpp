@@ -0,0 +1,57 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/option.h>
+#include <libaegisub/option_value.h>
+
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <iterator>
+
+namespace {
+/// Aegisub's own default options, as the most realistic thing to load
+std::string read_default_config() {
+	std::ifstream file("../src/libresrc/default_config.json", std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void BM_Options_Load(benchmark::State &state) {
+	const std::string config = read_default_config();
+	if (config.empty()) {
+		state.SkipWithError("Couldn't read src/libresrc/default_config.json");
+		return;
+	}
+
+	for (auto _ : state)
+		agi::Options opt("", {config.data(), config.size()}, agi::Options::FLUSH_SKIP);
+	state.SetBytesProcessed(state.iterations() * config.size());
+}
+BENCHMARK(BM_Options_Load);
+
+void BM_Options_Get(benchmark::State &state) {
+	const std::string config = read_default_config();
+	if (config.empty()) {
+		state.SkipWithError("Couldn't read src/libresrc/default_config.json");
+		return;
+	}
+
+	agi::Options opt("", {config.data(), config.size()}, agi::Options::FLUSH_SKIP);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(opt.Get("Subtitle/Grid/Font Size")->GetInt());
+}
+BENCHMARK(BM_Options_Get);
+}
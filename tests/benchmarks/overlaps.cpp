@@ -0,0 +1,37 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/overlaps.h>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+void BM_SplitOverlaps(benchmark::State &state) {
+	// Lots of long signs on screen at once along with ordinary dialogue,
+	// which is the worst case for splitting lines one pair at a time
+	const int count = static_cast<int>(state.range(0));
+	std::vector<int> starts, ends;
+	for (int i = 0; i < count; ++i) {
+		starts.push_back(i * 1000);
+		ends.push_back(i * 1000 + (i % 10 == 0 ? 30000 : 2500));
+	}
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(agi::ass::SplitOverlaps(starts, ends));
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_SplitOverlaps)->Arg(200000)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/parallel.h>
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+
+namespace {
+const size_t count = 20000000;
+
+double work(size_t begin, size_t end) {
+	double sum = 0;
+	for (size_t i = begin; i < end; ++i)
+		sum += std::sqrt(static_cast<double>(i));
+	return sum;
+}
+
+void BM_sqrt_sum_serial(benchmark::State &state) {
+	for (auto _ : state)
+		benchmark::DoNotOptimize(work(0, count));
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_sqrt_sum_serial)->Unit(benchmark::kMillisecond);
+
+void BM_sqrt_sum_parallel(benchmark::State &state) {
+	for (auto _ : state)
+		benchmark::DoNotOptimize(agi::parallel_reduce(size_t(0), count, 10000, 0.0, work,
+			[](double a, double b) { return a + b; }));
+	state.SetItemsProcessed(state.iterations() * count);
+	state.counters["threads"] = static_cast<double>(agi::parallel_concurrency());
+}
+BENCHMARK(BM_sqrt_sum_parallel)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
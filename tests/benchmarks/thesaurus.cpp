@@ -0,0 +1,65 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/fs.h>
+#include <libaegisub/thesaurus.h>
+
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+
+namespace {
+const int word_count = 50000;
+
+std::string word(int i) {
+	return "word" + std::to_string(i);
+}
+
+/// Write a thesaurus with word_count entries in the same format as the
+/// MyThes files the real ones come in
+void write_thesaurus(std::string const& idx_path, std::string const& dat_path) {
+	std::ofstream idx(idx_path, std::ios_base::binary);
+	std::ofstream dat(dat_path, std::ios_base::binary);
+
+	idx << "UTF-8\n" << word_count << "\n";
+	dat << "UTF-8\n";
+	for (int i = 0; i < word_count; ++i) {
+		idx << word(i) << "|" << dat.tellp() << "\n";
+		dat << word(i) << "|2\n";
+		dat << "(noun)|" << word(i + 1) << "|" << word(i + 2) << "|" << word(i + 3) << "\n";
+		dat << "(verb)|" << word(i + 4) << "|" << word(i + 5) << "\n";
+	}
+}
+
+void BM_Thesaurus_Lookup(benchmark::State &state) {
+	const std::string idx_path = "data/bench_thes.idx";
+	const std::string dat_path = "data/bench_thes.dat";
+	write_thesaurus(idx_path, dat_path);
+
+	{
+		agi::Thesaurus thes(dat_path, idx_path);
+		int i = 0;
+		for (auto _ : state) {
+			benchmark::DoNotOptimize(thes.Lookup(word(i)));
+			i = (i + 7919) % word_count;
+		}
+	}
+
+	agi::fs::Remove(idx_path);
+	agi::fs::Remove(dat_path);
+}
+BENCHMARK(BM_Thesaurus_Lookup);
+}
@@ -0,0 +1,35 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/time.h>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+void BM_Time_Parse(benchmark::State &state) {
+	const std::string text = "1:23:45.67";
+	for (auto _ : state)
+		benchmark::DoNotOptimize(agi::Time(text));
+}
+BENCHMARK(BM_Time_Parse);
+
+void BM_Time_Format(benchmark::State &state) {
+	const agi::Time time(5025670);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(time.GetAssFormatted());
+}
+BENCHMARK(BM_Time_Format);
+}
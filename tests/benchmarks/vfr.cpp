@@ -0,0 +1,56 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/vfr.h>
+
+#include <benchmark/benchmark.h>
+
+using namespace agi::vfr;
+
+namespace {
+/// Timecodes for about an hour of video which alternates between 24 and
+/// 30 fps every thousand frames
+Framerate make_vfr() {
+	std::vector<int> timecodes;
+	double time = 0;
+	for (int frame = 0; frame < 100000; ++frame) {
+		timecodes.push_back(static_cast<int>(time));
+		time += (frame / 1000) % 2 ? 1000. / 30 : 1000. / 24;
+	}
+	return Framerate(std::move(timecodes));
+}
+
+void BM_FrameAtTime(benchmark::State &state, Framerate const& fps) {
+	const int end = fps.TimeAtFrame(99999);
+	int ms = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(fps.FrameAtTime(ms, START));
+		ms = (ms + 7919) % end;
+	}
+}
+BENCHMARK_CAPTURE(BM_FrameAtTime, cfr, Framerate(24000, 1001));
+BENCHMARK_CAPTURE(BM_FrameAtTime, vfr, make_vfr());
+
+void BM_TimeAtFrame(benchmark::State &state, Framerate const& fps) {
+	int frame = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(fps.TimeAtFrame(frame, START));
+		frame = (frame + 7919) % 100000;
+	}
+}
+BENCHMARK_CAPTURE(BM_TimeAtFrame, cfr, Framerate(24000, 1001));
+BENCHMARK_CAPTURE(BM_TimeAtFrame, vfr, make_vfr());
+}
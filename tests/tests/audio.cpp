@@ -16,6 +16,8 @@
 
 #include <main.h>
 
+#include <libaegisub/audio/feeder.h>
+#include <libaegisub/audio/peak_index.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
@@ -23,6 +25,10 @@
 #include <libaegisub/util.h>
 
 #include <boost/filesystem/fstream.hpp>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 namespace bfs = boost::filesystem;
 
@@ -170,6 +176,82 @@ TEST(lagi_audio, save_audio_clip_out_of_audio_range) {
 	agi::fs::Remove(path);
 }
 
+namespace {
+std::string read_file(agi::fs::path const& path) {
+	bfs::ifstream s(path, std::ios_base::binary);
+	std::stringstream ss;
+	ss << s.rdbuf();
+	return ss.str();
+}
+}
+
+TEST(lagi_audio, save_audio_clips_matches_single_clips) {
+	TestAudioProvider<> provider;
+	const auto end_time = 90 * 1000;
+
+	// Out of order, overlapping, far apart, empty and past the end
+	std::vector<agi::AudioClip> clips;
+	const int ranges[][2] = {
+		{50000, 51000}, {1000, 3000}, {2000, 2500}, {2999, 4000},
+		{80000, 80000}, {end_time - 500, end_time + 500}, {1000, 3000}
+	};
+	for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); ++i)
+		clips.push_back(agi::AudioClip{ranges[i][0], ranges[i][1], agi::Path().Decode("?temp/save_clips_" + std::to_string(i))});
+	const auto single_path = agi::Path().Decode("?temp/save_clip");
+
+	agi::SaveAudioClips(provider, clips);
+	for (auto const& clip : clips) {
+		agi::SaveAudioClip(provider, single_path, clip.start_time, clip.end_time);
+		EXPECT_EQ(read_file(single_path), read_file(clip.path)) << clip.start_time;
+		agi::fs::Remove(clip.path);
+	}
+	agi::fs::Remove(single_path);
+}
+
+TEST(lagi_audio, save_audio_clips_container) {
+	TestAudioProvider<> provider;
+	const auto path = agi::Path().Decode("?temp/save_clips_container");
+	const auto clip_path = agi::Path().Decode("?temp/save_clips_named");
+
+	// The second clip only goes in the container
+	std::vector<agi::AudioClip> clips{
+		{2000, 3000, clip_path},
+		{1000, 1500, agi::fs::path()},
+	};
+	agi::SaveAudioClips(provider, clips, path);
+	EXPECT_TRUE(agi::fs::FileExists(clip_path));
+	agi::fs::Remove(clip_path);
+
+	auto data = read_file(path);
+	agi::fs::Remove(path);
+	ASSERT_LT(44u, data.size());
+
+	auto read32 = [&](size_t pos) { int32_t v; memcpy(&v, &data[pos], 4); return v; };
+	EXPECT_EQ("RIFF", data.substr(0, 4));
+	EXPECT_EQ(data.size() - 8, (size_t)read32(4));
+	EXPECT_EQ("data", data.substr(36, 4));
+
+	// Clips are in order of start time
+	const int32_t data_size = read32(40);
+	EXPECT_EQ((24000 + 48000) * 2, data_size);
+	auto samples = reinterpret_cast<const uint16_t *>(&data[44]);
+	EXPECT_EQ(48000, samples[0]);
+	EXPECT_EQ((uint16_t)(48000 + 23999), samples[23999]);
+	EXPECT_EQ((uint16_t)96000, samples[24000]);
+
+	size_t cue = 44 + data_size;
+	EXPECT_EQ("cue ", data.substr(cue, 4));
+	EXPECT_EQ(2, read32(cue + 8));
+	EXPECT_EQ(0, read32(cue + 12 + 20));
+	EXPECT_EQ(24000, read32(cue + 36 + 20));
+
+	size_t list = cue + 8 + read32(cue + 4);
+	EXPECT_EQ("LIST", data.substr(list, 4));
+	EXPECT_EQ("adtl", data.substr(list + 8, 4));
+	EXPECT_NE(std::string::npos, data.find(std::string("save_clips_named\0", 17), list));
+	EXPECT_NE(std::string::npos, data.find(std::string("2\0", 2), list));
+}
+
 TEST(lagi_audio, get_with_volume) {
 	TestAudioProvider<> provider;
 	uint16_t buff[4];
@@ -200,6 +282,24 @@ TEST(lagi_audio, volume_should_clamp_rather_than_wrap) {
 	EXPECT_EQ(SHRT_MAX, buff[0]);
 }
 
+TEST(lagi_audio, volume_matches_scalar_scaling) {
+	// Samples which cover the whole 16-bit range, both signs and lengths
+	// which aren't a multiple of the vector width
+	TestAudioProvider<int16_t> provider;
+	provider.bias = -0x8000;
+	for (double volume : {0.3, 0.5, 1.5, 2.0, 7.9, -1.0}) {
+		for (int64_t start : {int64_t(0), int64_t(1000), int64_t(0x7FF0), int64_t(0xFFE0)}) {
+			int16_t buff[37];
+			provider.GetAudioWithVolume(buff, start, 37, volume);
+			for (int i = 0; i < 37; ++i) {
+				int16_t sample = (int16_t)(start + i - 0x8000);
+				int expected = agi::util::mid(-0x8000, static_cast<int>(sample * volume + 0.5), 0x7FFF);
+				ASSERT_EQ(expected, buff[i]) << volume << " " << start + i;
+			}
+		}
+	}
+}
+
 TEST(lagi_audio, ram_cache) {
 	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
 	EXPECT_EQ(1, provider->GetChannels());
@@ -228,6 +328,584 @@ TEST(lagi_audio, hd_cache) {
 		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
 }
 
+TEST(lagi_audio, hd_cache_persistent) {
+	auto dir = agi::Path().Decode("?temp");
+	agi::fs::Remove(dir / "audio-persistent_test.pcm");
+
+	{
+		auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), dir, "persistent_test");
+		while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	}
+	ASSERT_TRUE(agi::fs::FileExists(dir / "audio-persistent_test.pcm"));
+
+	// The second source gives different samples, so getting the original ones
+	// back means that the cache file was reused rather than regenerated
+	auto src = agi::make_unique<TestAudioProvider<>>();
+	src->bias = 10;
+	auto provider = agi::CreateHDAudioProvider(std::move(src), dir, "persistent_test");
+	EXPECT_EQ(provider->GetNumSamples(), provider->GetDecodedSamples());
+
+	uint16_t buff[512];
+	provider->GetAudio(buff, (1 << 22) - 256, 512);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
+
+	provider.reset();
+	agi::fs::Remove(dir / "audio-persistent_test.pcm");
+}
+
+TEST(lagi_audio, hd_cache_persistent_incomplete) {
+	auto dir = agi::Path().Decode("?temp");
+	auto path = dir / "audio-incomplete_test.pcm";
+	agi::fs::Remove(path);
+
+	// Right size but missing the end marker, as if decoding was interrupted
+	{
+		bfs::ofstream s(path, std::ios_base::binary);
+		std::vector<char> zeros(90 * 48000 * 2 + 8);
+		s.write(zeros.data(), zeros.size());
+	}
+
+	auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), dir, "incomplete_test");
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	uint16_t buff[512];
+	provider->GetAudio(buff, (1 << 22) - 256, 512);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
+
+	provider.reset();
+	agi::fs::Remove(path);
+}
+
+struct SlowTestAudioProvider : TestAudioProvider<> {
+	mutable std::vector<int64_t> reads;
+	mutable std::mutex mutex;
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			reads.push_back(start);
+		}
+		agi::util::sleep_for(1);
+		TestAudioProvider<>::FillBuffer(buf, start, count);
+	}
+};
+
+TEST(lagi_audio, hd_cache_decodes_requested_audio_first) {
+	auto src = agi::make_unique<SlowTestAudioProvider>();
+	auto& reads = src->reads;
+	auto& mutex = src->mutex;
+	auto provider = agi::CreateHDAudioProvider(std::move(src), agi::Path().Decode("?temp"));
+
+	const int64_t target = provider->GetNumSamples() - 1000;
+	uint16_t buff[512];
+	provider->GetAudio(buff, target, 512);
+	EXPECT_FALSE(provider->IsDecoded(target, 512));
+
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	EXPECT_TRUE(provider->IsDecoded(0, provider->GetNumSamples()));
+
+	// The block at the end should have been picked up long before the
+	// linear sweep from the start could have reached it
+	std::lock_guard<std::mutex> lock(mutex);
+	auto pos = std::find(reads.begin(), reads.end(), target / 65536 * 65536);
+	ASSERT_NE(reads.end(), pos);
+	EXPECT_GT(reads.size() / 2, static_cast<size_t>(pos - reads.begin()));
+
+	provider->GetAudio(buff, target, 512);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(target + i), buff[i]);
+}
+
+TEST(lagi_audio, ram_cache_prefetch) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<SlowTestAudioProvider>());
+	provider->Prefetch(provider->GetNumSamples() - 1);
+	while (!provider->IsDecoded(provider->GetNumSamples() - 512, 512)) agi::util::sleep_for(0);
+
+	uint16_t buff[512];
+	provider->GetAudio(buff, provider->GetNumSamples() - 512, 512);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(provider->GetNumSamples() - 512 + i), buff[i]);
+}
+
+TEST(lagi_audio, ram_cache_parallel) {
+	std::vector<std::unique_ptr<agi::AudioProvider>> extra;
+	for (int i = 0; i < 3; ++i)
+		extra.push_back(agi::make_unique<TestAudioProvider<>>(300));
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>(300), std::move(extra));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	std::vector<uint16_t> buff(provider->GetNumSamples());
+	provider->GetAudio(&buff[0], 0, buff.size());
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<uint16_t>(i), buff[i]);
+}
+
+TEST(lagi_audio, hd_cache_parallel) {
+	auto dir = agi::Path().Decode("?temp");
+	agi::fs::Remove(dir / "audio-parallel_test.pcm");
+
+	std::vector<std::unique_ptr<agi::AudioProvider>> extra;
+	for (int i = 0; i < 3; ++i)
+		extra.push_back(agi::make_unique<SlowTestAudioProvider>());
+	auto provider = agi::CreateHDAudioProvider(agi::make_unique<SlowTestAudioProvider>(), std::move(extra), dir, "parallel_test");
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	std::vector<uint16_t> buff(provider->GetNumSamples());
+	provider->GetAudio(&buff[0], 0, buff.size());
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<uint16_t>(i), buff[i]);
+
+	// Should be reusable once every thread is done
+	provider.reset();
+	provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), dir, "parallel_test");
+	EXPECT_EQ(provider->GetNumSamples(), provider->GetDecodedSamples());
+	provider.reset();
+	agi::fs::Remove(dir / "audio-parallel_test.pcm");
+}
+
+struct NoiseAudioProvider : TestAudioProvider<int16_t> {
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		auto out = static_cast<int16_t *>(buf);
+		for (int64_t end = start + count; start < end; ++start) {
+			uint32_t x = static_cast<uint32_t>(start) * 1103515245u + 12345u;
+			// Mostly small values with the occasional full-scale spike
+			*out++ = static_cast<int16_t>(x % 97 == 0 ? x >> 16 : (x >> 16) % 64 - 32);
+		}
+	}
+};
+
+TEST(lagi_audio, compressed_ram_cache) {
+	auto provider = agi::CreateCompressedRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	EXPECT_EQ(1, provider->GetChannels());
+	EXPECT_EQ(90 * 48000, provider->GetNumSamples());
+	EXPECT_EQ(2, provider->GetBytesPerSample());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	std::vector<uint16_t> buff(provider->GetNumSamples());
+	provider->GetAudio(&buff[0], 0, buff.size());
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<uint16_t>(i), buff[i]);
+}
+
+TEST(lagi_audio, compressed_ram_cache_is_lossless) {
+	NoiseAudioProvider src;
+	std::vector<int16_t> expected(src.GetNumSamples());
+	src.GetAudio(&expected[0], 0, expected.size());
+
+	std::vector<std::unique_ptr<agi::AudioProvider>> extra;
+	extra.push_back(agi::make_unique<NoiseAudioProvider>());
+	auto provider = agi::CreateCompressedRAMAudioProvider(agi::make_unique<NoiseAudioProvider>(), std::move(extra));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	// Read in pieces which don't line up with the blocks, going backwards so
+	// that the hot block cache has to evict things
+	std::vector<int16_t> buff(expected.size());
+	const int64_t piece = 100000;
+	for (int64_t start = (buff.size() - 1) / piece * piece; start >= 0; start -= piece)
+		provider->GetAudio(&buff[start], start, std::min<int64_t>(piece, buff.size() - start));
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(expected[i], buff[i]);
+}
+
+TEST(lagi_audio, compressed_ram_cache_prefetch) {
+	auto provider = agi::CreateCompressedRAMAudioProvider(agi::make_unique<SlowTestAudioProvider>());
+	provider->Prefetch(provider->GetNumSamples() - 1);
+	while (!provider->IsDecoded(provider->GetNumSamples() - 512, 512)) agi::util::sleep_for(0);
+
+	uint16_t buff[512];
+	provider->GetAudio(buff, provider->GetNumSamples() - 512, 512);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(provider->GetNumSamples() - 512 + i), buff[i]);
+}
+
+/// Stereo source with the sample index in the left channel and its negation
+/// in the right, slowed down so that decoding stays in progress for a while
+struct StereoTestAudioProvider : agi::AudioProvider {
+	StereoTestAudioProvider() {
+		channels = 2;
+		num_samples = 10 * 48000;
+		decoded_samples = num_samples;
+		sample_rate = 48000;
+		bytes_per_sample = 2;
+		float_samples = false;
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		agi::util::sleep_for(1);
+		auto out = static_cast<int16_t *>(buf);
+		for (int64_t end = start + count; start < end; ++start) {
+			*out++ = static_cast<int16_t>(start);
+			*out++ = static_cast<int16_t>(-start);
+		}
+	}
+};
+
+void TestStereoCache(std::unique_ptr<agi::AudioProvider> provider) {
+	EXPECT_EQ(2, provider->GetChannels());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	std::vector<int16_t> buff(provider->GetNumSamples() * 2);
+	provider->GetAudio(&buff[0], 0, provider->GetNumSamples());
+	for (int64_t i = 0; i < provider->GetNumSamples(); ++i) {
+		ASSERT_EQ(static_cast<int16_t>(i), buff[i * 2]);
+		ASSERT_EQ(static_cast<int16_t>(-i), buff[i * 2 + 1]);
+	}
+}
+
+static agi::AudioPeak ExpectedPeak(std::vector<int16_t> const& samples, int64_t start, int64_t count) {
+	agi::AudioPeak peak;
+	double pos = 0, neg = 0;
+	for (int64_t i = start; i < start + count; ++i) {
+		if (samples[i] > 0) {
+			peak.max = std::max(peak.max, samples[i]);
+			pos += samples[i];
+		}
+		else {
+			peak.min = std::min(peak.min, samples[i]);
+			neg += samples[i];
+		}
+	}
+	peak.pos_mean = static_cast<float>(pos / count);
+	peak.neg_mean = static_cast<float>(neg / count);
+	return peak;
+}
+
+TEST(lagi_audio, peak_index) {
+	NoiseAudioProvider src;
+	std::vector<int16_t> samples(src.GetNumSamples());
+	src.GetAudio(&samples[0], 0, samples.size());
+
+	agi::AudioPeakIndex index(src.GetNumSamples());
+	agi::AudioPeak peak;
+	const int64_t block = 65536;
+	const int64_t last_block = (src.GetNumSamples() - 1) / block * block;
+
+	// Add the blocks out of order, as parallel decoding would
+	for (int64_t start = last_block; start >= 0; start -= block) {
+		index.AddSamples(&samples[start], start, std::min(block, src.GetNumSamples() - start));
+		if (start > 0) {
+			EXPECT_FALSE(index.GetPeak(0, src.GetNumSamples(), peak));
+		}
+	}
+
+	// Too short to be worth looking up
+	EXPECT_FALSE(index.GetPeak(0, 1000, peak));
+
+	// Ranges which line up with the entries used are summarized exactly
+	for (int64_t count : {block / 8, block * 3, block * 15}) {
+		for (int64_t start : {int64_t(0), block, (src.GetNumSamples() - count) / block * block}) {
+			ASSERT_TRUE(index.GetPeak(start, count, peak));
+			auto expected = ExpectedPeak(samples, start, count);
+			EXPECT_EQ(expected.min, peak.min);
+			EXPECT_EQ(expected.max, peak.max);
+			EXPECT_NEAR(expected.pos_mean, peak.pos_mean, 0.01);
+			EXPECT_NEAR(expected.neg_mean, peak.neg_mean, 0.01);
+		}
+	}
+
+	// Others can only be wider
+	ASSERT_TRUE(index.GetPeak(12345, 100000, peak));
+	auto expected = ExpectedPeak(samples, 12345, 100000);
+	EXPECT_GE(expected.min, peak.min);
+	EXPECT_LE(expected.max, peak.max);
+}
+
+TEST(lagi_audio, peak_index_save_load) {
+	NoiseAudioProvider src;
+	std::vector<int16_t> samples(src.GetNumSamples());
+	src.GetAudio(&samples[0], 0, samples.size());
+
+	agi::AudioPeakIndex index(src.GetNumSamples());
+	EXPECT_FALSE(index.IsComplete());
+	index.AddSamples(&samples[0], 0, src.GetNumSamples());
+	EXPECT_TRUE(index.IsComplete());
+
+	std::stringstream saved;
+	index.Save(saved);
+
+	agi::AudioPeakIndex loaded(src.GetNumSamples());
+	ASSERT_TRUE(loaded.Load(saved));
+	EXPECT_TRUE(loaded.IsComplete());
+	for (int64_t start = 0; start + 100000 < src.GetNumSamples(); start += 777777) {
+		agi::AudioPeak expected, actual;
+		ASSERT_TRUE(index.GetPeak(start, 100000, expected));
+		ASSERT_TRUE(loaded.GetPeak(start, 100000, actual));
+		EXPECT_EQ(expected.min, actual.min);
+		EXPECT_EQ(expected.max, actual.max);
+		EXPECT_EQ(expected.pos_mean, actual.pos_mean);
+		EXPECT_EQ(expected.neg_mean, actual.neg_mean);
+	}
+
+	// Indexes for audio of a different length are rejected
+	saved.clear();
+	saved.seekg(0);
+	agi::AudioPeakIndex other(src.GetNumSamples() - 1);
+	EXPECT_FALSE(other.Load(saved));
+
+	// As are truncated ones, which leave the index as it was
+	auto data = saved.str();
+	std::stringstream truncated(data.substr(0, data.size() / 2));
+	agi::AudioPeakIndex partial(src.GetNumSamples());
+	EXPECT_FALSE(partial.Load(truncated));
+	EXPECT_FALSE(partial.IsComplete());
+}
+
+TEST(lagi_audio, peak_index_envelope) {
+	// A second of silence, a second of a tone and then more silence, at a
+	// sample rate which doesn't divide evenly into frames
+	const int rate = 22050;
+	std::vector<int16_t> samples(rate * 3 + 1234);
+	for (int i = rate; i < rate * 2; ++i)
+		samples[i] = static_cast<int16_t>(10000 * sin(i * 2 * 3.14159265358979 * 441 / rate));
+
+	agi::AudioPeakIndex index(samples.size(), rate);
+	EXPECT_EQ(306, index.GetEnvelopeFrames());
+
+	std::vector<agi::AudioEnvelopeFrame> frames;
+	std::vector<agi::SpeechBoundary> boundaries;
+	const int64_t block = 4096;
+	for (int64_t start = (samples.size() - 1) / block * block; start >= 0; start -= block) {
+		EXPECT_FALSE(index.GetSpeechBoundaries(0, 3000, boundaries));
+		index.AddSamples(&samples[start], start, std::min<int64_t>(block, samples.size() - start));
+	}
+
+	ASSERT_TRUE(index.GetEnvelope(0, index.GetEnvelopeFrames(), frames));
+	ASSERT_EQ(306u, frames.size());
+	EXPECT_EQ(float(agi::AudioPeakIndex::SilenceLevel), frames[50].level);
+	EXPECT_EQ(0.f, frames[50].zero_crossings);
+	// RMS of a sine is its amplitude over root two
+	EXPECT_NEAR(20 * log10(10000 / 32768. / sqrt(2.)), frames[150].level, 0.1);
+	EXPECT_NEAR(2. * 441 / rate, frames[150].zero_crossings, 0.01);
+	EXPECT_FALSE(index.GetEnvelope(305, 2, frames));
+
+	ASSERT_TRUE(index.GetSpeechBoundaries(0, 3000, boundaries));
+	ASSERT_EQ(2u, boundaries.size());
+	EXPECT_EQ(1000, boundaries[0].time);
+	EXPECT_TRUE(boundaries[0].onset);
+	EXPECT_EQ(2000, boundaries[1].time);
+	EXPECT_FALSE(boundaries[1].onset);
+
+	boundaries.clear();
+	ASSERT_TRUE(index.GetSpeechBoundaries(1500, 2500, boundaries));
+	ASSERT_EQ(1u, boundaries.size());
+	EXPECT_EQ(2000, boundaries[0].time);
+
+	// The envelope is saved with the peaks
+	std::stringstream saved;
+	index.Save(saved);
+	agi::AudioPeakIndex loaded(samples.size(), rate);
+	ASSERT_TRUE(loaded.Load(saved));
+	std::vector<agi::AudioEnvelopeFrame> loaded_frames;
+	ASSERT_TRUE(loaded.GetEnvelope(0, loaded.GetEnvelopeFrames(), loaded_frames));
+	EXPECT_EQ(frames[150].level, loaded_frames[150].level);
+
+	// Adding the samples again after loading doesn't count them twice
+	loaded.AddSamples(&samples[0], 0, block);
+	loaded_frames.clear();
+	ASSERT_TRUE(loaded.GetEnvelope(0, 1, loaded_frames));
+	EXPECT_EQ(frames[0].level, loaded_frames[0].level);
+
+	// Indexes without an envelope don't match ones with one
+	saved.clear();
+	saved.seekg(0);
+	agi::AudioPeakIndex no_envelope(samples.size());
+	EXPECT_FALSE(no_envelope.Load(saved));
+	EXPECT_FALSE(no_envelope.GetSpeechBoundaries(0, 3000, boundaries));
+}
+
+TEST(lagi_audio, speech_boundaries_ignore_short_gaps) {
+	auto frame = [](float level) {
+		agi::AudioEnvelopeFrame f;
+		f.level = level;
+		return f;
+	};
+	std::vector<agi::AudioEnvelopeFrame> frames(100, frame(-80));
+	// Speech from 200 ms to 600 ms with a 50 ms pause in the middle, and a
+	// 20 ms click which is too short to be speech
+	for (int i = 20; i < 60; ++i) frames[i] = frame(-20);
+	for (int i = 35; i < 40; ++i) frames[i] = frame(-80);
+	for (int i = 80; i < 82; ++i) frames[i] = frame(-20);
+
+	auto boundaries = agi::AudioPeakIndex::FindSpeechBoundaries(frames);
+	ASSERT_EQ(2u, boundaries.size());
+	EXPECT_EQ(200, boundaries[0].time);
+	EXPECT_TRUE(boundaries[0].onset);
+	EXPECT_EQ(600, boundaries[1].time);
+	EXPECT_FALSE(boundaries[1].onset);
+
+	// Quiet but noisy frames count as speech
+	frames.assign(100, frame(-80));
+	for (int i = 20; i < 60; ++i) {
+		frames[i] = frame(-70);
+		frames[i].zero_crossings = 0.5f;
+	}
+	EXPECT_EQ(2u, agi::AudioPeakIndex::FindSpeechBoundaries(frames).size());
+}
+
+TEST(lagi_audio, cache_peak_index) {
+	NoiseAudioProvider src;
+	std::vector<int16_t> samples(src.GetNumSamples());
+	src.GetAudio(&samples[0], 0, samples.size());
+	auto expected = ExpectedPeak(samples, 0, samples.size());
+
+	auto check = [&](std::unique_ptr<agi::AudioProvider> provider) {
+		while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+		auto index = provider->GetPeakIndex();
+		ASSERT_NE(nullptr, index);
+		agi::AudioPeak peak;
+		ASSERT_TRUE(index->GetPeak(0, provider->GetNumSamples(), peak));
+		EXPECT_EQ(expected.min, peak.min);
+		EXPECT_EQ(expected.max, peak.max);
+	};
+
+	check(agi::CreateRAMAudioProvider(agi::make_unique<NoiseAudioProvider>()));
+	check(agi::CreateHDAudioProvider(agi::make_unique<NoiseAudioProvider>(), agi::Path().Decode("?temp")));
+	check(agi::CreateCompressedRAMAudioProvider(agi::make_unique<NoiseAudioProvider>()));
+	check(agi::CreateLockAudioProvider(agi::CreateRAMAudioProvider(agi::make_unique<NoiseAudioProvider>())));
+
+	// Only audio in the display format gets an index
+	EXPECT_EQ(nullptr, agi::CreateRAMAudioProvider(agi::make_unique<StereoTestAudioProvider>())->GetPeakIndex());
+}
+
+TEST(lagi_audio, ram_cache_stereo) {
+	TestStereoCache(agi::CreateRAMAudioProvider(agi::make_unique<StereoTestAudioProvider>()));
+}
+
+TEST(lagi_audio, hd_cache_stereo) {
+	TestStereoCache(agi::CreateHDAudioProvider(agi::make_unique<StereoTestAudioProvider>(), agi::Path().Decode("?temp")));
+}
+
+TEST(lagi_audio, convert_native_cache) {
+	auto cache = agi::CreateRAMAudioProvider(agi::make_unique<StereoTestAudioProvider>());
+	auto native = cache.get();
+	auto provider = agi::CreateConvertAudioProvider(std::move(cache));
+	EXPECT_EQ(1, provider->GetChannels());
+	EXPECT_EQ(native, &provider->GetNativeProvider());
+	EXPECT_TRUE(provider->SupportsConcurrentReads());
+
+	// Decoding progress should come from the cache underneath
+	provider->Prefetch(provider->GetNumSamples() - 1);
+	while (!provider->IsDecoded(provider->GetNumSamples() - 512, 512)) agi::util::sleep_for(0);
+	EXPECT_TRUE(native->IsDecoded(native->GetNumSamples() - 512, 512));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	int16_t buff[512];
+	provider->GetAudio(buff, 1000, 512);
+	for (int i = 0; i < 512; ++i)
+		ASSERT_EQ(0, buff[i]);
+
+
+	// Sources which can't be read concurrently stay behind the lock
+	auto lock = agi::CreateLockAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	EXPECT_EQ(lock.get(), &lock->GetNativeProvider());
+}
+
+/// Source which records it if it's ever read from by two threads at once
+struct ExclusiveTestAudioProvider : TestAudioProvider<> {
+	std::shared_ptr<std::atomic<int>> overlaps = std::make_shared<std::atomic<int>>(0);
+	std::shared_ptr<std::atomic<int>> clones = std::make_shared<std::atomic<int>>(0);
+	mutable std::atomic<bool> busy{false};
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		if (busy.exchange(true)) ++*overlaps;
+		agi::util::sleep_for(1);
+		TestAudioProvider<>::FillBuffer(buf, start, count);
+		busy = false;
+	}
+
+	std::unique_ptr<agi::AudioProvider> Clone() const override {
+		++*clones;
+		auto clone = agi::make_unique<ExclusiveTestAudioProvider>();
+		clone->overlaps = overlaps;
+		clone->clones = clones;
+		return std::move(clone);
+	}
+};
+
+void ReadConcurrently(agi::AudioProvider const& provider) {
+	std::vector<std::thread> threads;
+	std::atomic<int> errors{0};
+	for (int t = 0; t < 8; ++t) {
+		threads.emplace_back([&, t] {
+			uint16_t buff[256];
+			for (int i = 0; i < 20; ++i) {
+				const int64_t start = (t * 20 + i) * 1000;
+				provider.GetAudio(buff, start, 256);
+				for (size_t j = 0; j < 256; ++j) {
+					if (buff[j] != static_cast<uint16_t>(start + j))
+						++errors;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT_EQ(0, errors);
+}
+
+TEST(lagi_audio, lock_clones_source_for_concurrent_reads) {
+	auto src = agi::make_unique<ExclusiveTestAudioProvider>();
+	auto overlaps = src->overlaps;
+	auto clones = src->clones;
+	auto provider = agi::CreateLockAudioProvider(std::move(src));
+	EXPECT_TRUE(provider->SupportsConcurrentReads());
+
+	ReadConcurrently(*provider);
+	EXPECT_EQ(0, *overlaps);
+	EXPECT_LE(*clones, 4);
+}
+
+TEST(lagi_audio, lock_without_clone_support) {
+	auto provider = agi::CreateLockAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	ReadConcurrently(*provider);
+}
+
+TEST(lagi_audio, ram_cache_view) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	uint16_t buff[512];
+	auto view = static_cast<const uint16_t *>(provider->GetAudioView(buff, 1000, 512));
+	EXPECT_NE(buff, view);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(1000 + i), view[i]);
+
+	// Straddles two cache blocks, so has to be copied
+	EXPECT_EQ(nullptr, provider->ViewAudio((1 << 21) - 256, 512));
+	view = static_cast<const uint16_t *>(provider->GetAudioView(buff, (1 << 21) - 256, 512));
+	EXPECT_EQ(buff, view);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>((1 << 21) - 256 + i), view[i]);
+
+	EXPECT_EQ(nullptr, provider->ViewAudio(-10, 20));
+	EXPECT_EQ(nullptr, provider->ViewAudio(provider->GetNumSamples() - 10, 20));
+}
+
+TEST(lagi_audio, hd_cache_view) {
+	auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	uint16_t buff[512];
+	auto view = static_cast<const uint16_t *>(provider->GetAudioView(buff, (1 << 22) - 256, 512));
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), view[i]);
+}
+
+TEST(lagi_audio, view_through_lock) {
+	auto ram = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	while (!ram->IsDecoded(0, 512)) agi::util::sleep_for(0);
+	auto provider = agi::CreateLockAudioProvider(std::move(ram));
+	auto view = static_cast<const uint16_t *>(provider->ViewAudio(0, 512));
+	ASSERT_NE(nullptr, view);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(i), view[i]);
+
+	provider = agi::CreateLockAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	EXPECT_EQ(nullptr, provider->ViewAudio(0, 512));
+}
+
 TEST(lagi_audio, convert_8bit) {
 	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<TestAudioProvider<uint8_t>>());
 
@@ -358,6 +1036,109 @@ TEST(lagi_audio, double_conversion) {
 		ASSERT_EQ(i + SHRT_MIN, samples[i]);
 }
 
+/// Plays back a fixed set of interleaved samples
+template<typename Sample>
+struct VectorAudioProvider : agi::AudioProvider {
+	std::vector<Sample> samples;
+
+	VectorAudioProvider(std::vector<Sample> data, int channels_ = 1, int bytes = sizeof(Sample), int rate = 48000)
+	: samples(std::move(data))
+	{
+		channels = channels_;
+		num_samples = samples.size() * sizeof(Sample) / bytes / channels;
+		decoded_samples = num_samples;
+		sample_rate = rate;
+		bytes_per_sample = bytes;
+		float_samples = std::is_floating_point<Sample>::value;
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		auto frame = bytes_per_sample * channels;
+		memcpy(buf, reinterpret_cast<const char *>(samples.data()) + start * frame, count * frame);
+	}
+};
+
+template<typename Float>
+void TestFloatClamping() {
+	std::vector<Float> data;
+	for (int i = 0; i < 37; ++i) {
+		data.push_back(1.5);
+		data.push_back(-2);
+		data.push_back((Float)0.5);
+	}
+	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<VectorAudioProvider<Float>>(data));
+
+	std::vector<int16_t> out(data.size());
+	provider->GetAudio(&out[0], 0, out.size());
+	for (size_t i = 0; i < out.size(); i += 3) {
+		ASSERT_EQ(SHRT_MAX, out[i]);
+		ASSERT_EQ(SHRT_MIN, out[i + 1]);
+		ASSERT_EQ(16383, out[i + 2]);
+	}
+}
+
+TEST(lagi_audio, float_conversion_clamps) {
+	TestFloatClamping<float>();
+	TestFloatClamping<double>();
+}
+
+TEST(lagi_audio, convert_24bit) {
+	std::vector<uint8_t> data;
+	for (int i = 0; i < 1000; ++i) {
+		int32_t sample = (i - 500) * 12345;
+		data.push_back(static_cast<uint8_t>(sample));
+		data.push_back(static_cast<uint8_t>(sample >> 8));
+		data.push_back(static_cast<uint8_t>(sample >> 16));
+	}
+	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<VectorAudioProvider<uint8_t>>(data, 1, 3));
+	ASSERT_EQ(1000, provider->GetNumSamples());
+
+	std::vector<int16_t> out(1000);
+	provider->GetAudio(&out[0], 0, out.size());
+	for (int i = 0; i < 1000; ++i)
+		ASSERT_EQ(static_cast<int16_t>(((i - 500) * 12345) >> 8), out[i]);
+}
+
+TEST(lagi_audio, downmix_rounds_towards_zero) {
+	for (int channels : {2, 6}) {
+		SCOPED_TRACE(channels);
+		std::vector<int16_t> data;
+		for (int i = 0; i < 1001 * channels; ++i)
+			data.push_back(static_cast<int16_t>((i * 7919) % 65536 - 32768));
+		auto provider = agi::CreateConvertAudioProvider(agi::make_unique<VectorAudioProvider<int16_t>>(data, channels));
+
+		std::vector<int16_t> out(1001);
+		provider->GetAudio(&out[0], 0, out.size());
+		for (int i = 0; i < 1001; ++i) {
+			int sum = 0;
+			for (int c = 0; c < channels; ++c)
+				sum += data[i * channels + c];
+			ASSERT_EQ(sum / channels, out[i]);
+		}
+	}
+}
+
+TEST(lagi_audio, sample_doubling_long) {
+	std::vector<int16_t> data;
+	for (int i = 0; i < 10000; ++i)
+		data.push_back(static_cast<int16_t>((i * 7919) % 65536 - 32768));
+	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<VectorAudioProvider<int16_t>>(data, 1, 2, 24000));
+	ASSERT_EQ(20000, provider->GetNumSamples());
+
+	for (int start : {0, 1, 4095, 4096}) {
+		SCOPED_TRACE(start);
+		std::vector<int16_t> out(20000 - start);
+		provider->GetAudio(&out[0], start, out.size());
+		for (size_t i = 0; i < out.size(); ++i) {
+			size_t pos = start + i;
+			int expected = data[pos / 2];
+			if (pos & 1)
+				expected = (expected + (pos / 2 + 1 < data.size() ? data[pos / 2 + 1] : 0)) / 2;
+			ASSERT_EQ(expected, out[i]);
+		}
+	}
+}
+
 TEST(lagi_audio, pcm_simple) {
 	auto path = agi::Path().Decode("?temp/pcm_simple");
 	{
@@ -379,6 +1160,11 @@ TEST(lagi_audio, pcm_simple) {
 			provider->GetAudio(&sample, i, 1);
 			ASSERT_EQ(i, sample);
 		}
+
+		uint16_t buff[100];
+		auto view = static_cast<const uint16_t *>(provider->GetAudioView(buff, 0, 100));
+		for (int i = 0; i < 100; ++i)
+			ASSERT_EQ(i, view[i]);
 	}
 
 	agi::fs::Remove(path);
@@ -416,6 +1202,51 @@ TEST(lagi_audio, pcm_truncated) {
 	agi::fs::Remove(path);
 }
 
+TEST(lagi_audio, pcm_prefetch) {
+	auto path = agi::Path().Decode("?temp/pcm_prefetch");
+	{
+		TestAudioProvider<> provider;
+		agi::SaveAudioClip(provider, path, 0, 60000);
+	}
+
+	{
+		auto provider = agi::CreatePCMAudioProvider(path, nullptr);
+
+		// Read through it as playback does, which reads further and further
+		// ahead, then jump somewhere else
+		std::vector<uint16_t> buff(4800);
+		for (int64_t start : {0, 1000000, 48000}) {
+			for (int64_t pos = start; pos < start + 480000; pos += 4800) {
+				provider->Prefetch(pos);
+				provider->GetAudio(buff.data(), pos, 4800);
+				for (size_t i = 0; i < buff.size(); ++i)
+					ASSERT_EQ(static_cast<uint16_t>(pos + i), buff[i]);
+			}
+		}
+
+		// Past the end does nothing
+		provider->Prefetch(provider->GetNumSamples());
+		provider->Prefetch(provider->GetNumSamples() * 2);
+	}
+
+	{
+		// Claims to be longer than the file is
+		char file[1000];
+		{ bfs::ifstream s(path, std::ios_base::binary); s.read(file, sizeof file); }
+		{ bfs::ofstream s(path, std::ios_base::binary); s.write(file, sizeof file); }
+
+		auto provider = agi::CreatePCMAudioProvider(path, nullptr);
+		provider->Prefetch(0);
+		provider->Prefetch(10000);
+
+		uint16_t sample;
+		provider->GetAudio(&sample, 10, 1);
+		EXPECT_EQ(10, sample);
+	}
+
+	agi::fs::Remove(path);
+}
+
 #define RIFF "RIFF\0\0\0\x60WAVE"
 #define FMT_VALID "fmt \x10\0\0\0\1\0\1\0\x10\0\0\0\x20\0\0\0\2\0\x10\0"
 #define DATA_VALID "data\1\0\0\0\0\0"
@@ -552,3 +1383,108 @@ TEST(lagi_audio, wave64_truncated) {
 
 	agi::fs::Remove(path);
 }
+
+TEST(lagi_audio, ring_buffer_wraps) {
+	agi::AudioRingBuffer ring(4, sizeof(uint16_t));
+	uint16_t in[] = {1, 2, 3, 4, 5, 6};
+	uint16_t out[6] = {0};
+
+	EXPECT_EQ(3u, ring.Write(in, 3));
+	EXPECT_EQ(2u, ring.Read(out, 2));
+	EXPECT_EQ(1, out[0]);
+	EXPECT_EQ(2, out[1]);
+
+	// Only three frames of space left, which wrap around the end
+	EXPECT_EQ(3u, ring.Space());
+	EXPECT_EQ(3u, ring.Write(in + 3, 6));
+	EXPECT_EQ(4u, ring.Available());
+	EXPECT_EQ(1u, ring.Skip(1));
+	EXPECT_EQ(3u, ring.Read(out, 6));
+	EXPECT_EQ(4, out[0]);
+	EXPECT_EQ(5, out[1]);
+	EXPECT_EQ(6, out[2]);
+	EXPECT_EQ(0u, ring.Available());
+}
+
+TEST(lagi_audio, feeder_reads_ahead) {
+	TestAudioProvider<> provider;
+	agi::AudioFeeder feeder(&provider, 4800);
+	feeder.Start(1000, 1000 + 48000, 480);
+
+	std::vector<uint16_t> buf(4800);
+	feeder.Read(buf.data(), 480);
+	for (int i = 0; i < 480; ++i) ASSERT_EQ(1000 + i, buf[i]);
+
+	// Give the feeder thread time to fill the rest of the buffer
+	agi::util::sleep_for(100);
+	feeder.Read(buf.data(), 4000);
+	for (int i = 0; i < 4000; ++i) ASSERT_EQ(1480 + i, buf[i]);
+	EXPECT_EQ(0u, feeder.GetUnderruns());
+	EXPECT_EQ(5480, feeder.GetReadPosition());
+}
+
+TEST(lagi_audio, feeder_silence_after_end_is_not_underrun) {
+	TestAudioProvider<> provider;
+	agi::AudioFeeder feeder(&provider, 4800);
+	feeder.Start(0, 100, 480);
+
+	std::vector<uint16_t> buf(200, 1);
+	feeder.Read(buf.data(), 200);
+	EXPECT_EQ(99, buf[99]);
+	EXPECT_EQ(0, buf[100]);
+	EXPECT_EQ(0, buf[199]);
+	EXPECT_EQ(0u, feeder.GetUnderruns());
+}
+
+namespace {
+struct GatedTestAudioProvider : TestAudioProvider<> {
+	std::atomic<bool> open{false};
+	int64_t gate = 0;
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		while (start >= gate && !open)
+			agi::util::sleep_for(1);
+		TestAudioProvider<>::FillBuffer(buf, start, count);
+	}
+};
+}
+
+TEST(lagi_audio, feeder_underrun_keeps_sync) {
+	GatedTestAudioProvider provider;
+	provider.gate = 100;
+	agi::AudioFeeder feeder(&provider, 4800);
+	feeder.Start(0, 48000, 100);
+
+	std::vector<uint16_t> buf(200, 1);
+	feeder.Read(buf.data(), 200);
+	EXPECT_EQ(99, buf[99]);
+	EXPECT_EQ(0, buf[100]);
+	EXPECT_EQ(0, buf[199]);
+	EXPECT_EQ(1u, feeder.GetUnderruns());
+	EXPECT_EQ(100u, feeder.GetUnderrunFrames());
+
+	// The audio which was replaced by silence is skipped once it arrives
+	provider.open = true;
+	agi::util::sleep_for(100);
+	feeder.Read(buf.data(), 100);
+	for (int i = 0; i < 100; ++i) ASSERT_EQ(200 + i, buf[i]);
+	EXPECT_EQ(1u, feeder.GetUnderruns());
+}
+
+TEST(lagi_audio, feeder_restart_discards_old_audio) {
+	TestAudioProvider<> provider;
+	agi::AudioFeeder feeder(&provider, 4800);
+	feeder.Start(0, 48000, 480);
+	agi::util::sleep_for(50);
+
+	feeder.Start(10000, 48000, 480);
+	std::vector<uint16_t> buf(480);
+	feeder.Read(buf.data(), 480);
+	for (int i = 0; i < 480; ++i) ASSERT_EQ(10000 + i, buf[i]);
+
+	feeder.Stop();
+	feeder.Start(20000, 48000, 0);
+	agi::util::sleep_for(50);
+	feeder.Read(buf.data(), 480);
+	for (int i = 0; i < 480; ++i) ASSERT_EQ(20000 + i, buf[i]);
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/block_cache.h>
+
+#include <main.h>
+
+#include <memory>
+
+namespace {
+struct IntFactory {
+	typedef std::unique_ptr<int> BlockType;
+	int *produced;
+	BlockType ProduceBlock(size_t i) {
+		++*produced;
+		return BlockType(new int(static_cast<int>(i)));
+	}
+	size_t GetBlockSize() const { return sizeof(int); }
+};
+
+/// Same shape as the spectrum's blocks: a fixed-size float array per block
+struct RecyclingFactory {
+	typedef std::unique_ptr<float, std::default_delete<float[]>> BlockType;
+	size_t block_values;
+	int *allocated;
+	BlockType ProduceBlock(size_t i, BlockType spare) {
+		if (!spare) {
+			spare.reset(new float[block_values]);
+			++*allocated;
+		}
+		for (size_t j = 0; j < block_values; ++j)
+			spare.get()[j] = static_cast<float>(i + j);
+		return spare;
+	}
+	size_t GetBlockSize() const { return block_values * sizeof(float); }
+};
+}
+
+TEST(lagi_block_cache, get_produces_once) {
+	int produced = 0;
+	agi::DataBlockCache<int, 2, IntFactory> cache(16, IntFactory{&produced});
+
+	bool created = false;
+	EXPECT_EQ(5, cache.Get(5, &created));
+	EXPECT_TRUE(created);
+	EXPECT_EQ(5, cache.Get(5, &created));
+	EXPECT_FALSE(created);
+	EXPECT_EQ(1, produced);
+	EXPECT_TRUE(cache.Contains(5));
+	EXPECT_FALSE(cache.Contains(6));
+	EXPECT_EQ(sizeof(int), cache.GetSize());
+}
+
+TEST(lagi_block_cache, age_removes_least_recently_used) {
+	int produced = 0;
+	agi::DataBlockCache<int, 0, IntFactory> cache(16, IntFactory{&produced});
+
+	cache.Get(0);
+	cache.Get(1);
+	cache.Get(2);
+	cache.Get(0);
+
+	cache.Age(2 * sizeof(int));
+	EXPECT_TRUE(cache.Contains(0));
+	EXPECT_FALSE(cache.Contains(1));
+	EXPECT_TRUE(cache.Contains(2));
+
+	cache.Get(2);
+	cache.Age(sizeof(int));
+	EXPECT_FALSE(cache.Contains(0));
+	EXPECT_TRUE(cache.Contains(2));
+
+	cache.Age(0);
+	EXPECT_FALSE(cache.Contains(2));
+	EXPECT_EQ(0u, cache.GetSize());
+
+	// The age list must still work after being flushed
+	cache.Get(3);
+	cache.Get(4);
+	cache.Age(sizeof(int));
+	EXPECT_FALSE(cache.Contains(3));
+	EXPECT_TRUE(cache.Contains(4));
+}
+
+TEST(lagi_block_cache, aged_blocks_are_reused) {
+	int allocated = 0;
+	agi::DataBlockCache<float, 2, RecyclingFactory> cache(64, RecyclingFactory{16, &allocated});
+
+	for (size_t i = 0; i < 8; ++i)
+		cache.Get(i);
+	EXPECT_EQ(8, allocated);
+
+	// Drops the first macroblock, whose blocks are then reused
+	cache.Age(4 * 16 * sizeof(float));
+	for (size_t i = 8; i < 12; ++i)
+		EXPECT_EQ(static_cast<float>(i), cache.Get(i));
+	EXPECT_EQ(8, allocated);
+
+	cache.Age(0);
+	cache.Get(0);
+	EXPECT_EQ(9, allocated);
+}
+
+TEST(lagi_block_cache, move_keeps_age_list) {
+	int produced = 0;
+	agi::DataBlockCache<int, 0, IntFactory> cache(16, IntFactory{&produced});
+	cache.Get(0);
+	cache.Get(1);
+
+	auto moved = std::move(cache);
+	moved.Get(0);
+	moved.Age(sizeof(int));
+	EXPECT_TRUE(moved.Contains(0));
+	EXPECT_FALSE(moved.Contains(1));
+}
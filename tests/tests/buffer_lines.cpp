@@ -0,0 +1,110 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/buffer_lines.h>
+#include <libaegisub/charset_conv.h>
+#include <libaegisub/line_iterator.h>
+
+#include <main.h>
+
+#include <sstream>
+
+namespace {
+std::vector<std::string> lines(std::string const& str, const char *encoding = "utf-8") {
+	std::vector<std::string> ret;
+	agi::buffer_lines buffer(str.data(), str.data() + str.size(), encoding);
+	for (auto const& line : buffer)
+		ret.emplace_back(line.begin(), line.end());
+	return ret;
+}
+
+std::vector<std::string> stream_lines(std::string const& str) {
+	std::stringstream ss(str);
+	return std::vector<std::string>(agi::line_iterator<std::string>(ss), agi::line_iterator<std::string>());
+}
+
+std::vector<std::string> v(std::initializer_list<std::string> values) {
+	return values;
+}
+}
+
+TEST(lagi_buffer_lines, basic) {
+	EXPECT_EQ(v({"line 1", "line 2", "line 3"}), lines("line 1\nline 2\nline 3"));
+	EXPECT_EQ(v({" white space "}), lines(" white space "));
+	EXPECT_EQ(v({"blank", "", "lines", ""}), lines("blank\n\nlines\n"));
+}
+
+TEST(lagi_buffer_lines, empty) {
+	EXPECT_EQ(v({""}), lines(""));
+	EXPECT_EQ(v({""}), lines("", "utf-16le"));
+
+	agi::buffer_lines buffer(nullptr, nullptr);
+	EXPECT_EQ(1, std::distance(buffer.begin(), buffer.end()));
+}
+
+TEST(lagi_buffer_lines, crlf) {
+	EXPECT_EQ(v({"a", "b", ""}), lines("a\r\nb\r\n"));
+	EXPECT_EQ(v({"a\rb", "c"}), lines("a\rb\r\nc"));
+	EXPECT_EQ(v({"", ""}), lines("\r\n"));
+	EXPECT_EQ(v({""}), lines("\r"));
+}
+
+TEST(lagi_buffer_lines, long_lines) {
+	// Line breaks at every position within and across the 16 byte blocks
+	for (size_t len = 0; len < 40; ++len) {
+		std::string line(len, 'x');
+		std::string text = line + "\n" + line + "\r\n" + line;
+		EXPECT_EQ(v({line, line, line}), lines(text)) << len;
+	}
+}
+
+TEST(lagi_buffer_lines, same_as_line_iterator) {
+	for (auto str : {"a\nb", "a\nb\n", "\n\n", "x\r\ny\r\n", "a\n\nb\r\n\r\nc", "only"})
+		EXPECT_EQ(stream_lines(str), lines(str)) << str;
+}
+
+TEST(lagi_buffer_lines, converts_encoding) {
+	std::string utf8 = "\xE3\x81\x82\r\nline 2\n\xC3\xA9";
+	auto utf16 = agi::charset::IconvWrapper("utf-8", "utf-16le").Convert(utf8);
+	EXPECT_EQ(v({"\xE3\x81\x82", "line 2", "\xC3\xA9"}), lines(utf16, "utf-16le"));
+
+	auto latin1 = agi::charset::IconvWrapper("utf-8", "iso-8859-1").Convert("caf\xC3\xA9\nna\xC3\xAFve");
+	EXPECT_EQ(v({"caf\xC3\xA9", "na\xC3\xAFve"}), lines(latin1, "iso-8859-1"));
+}
+
+TEST(lagi_buffer_lines, utf8_is_not_copied) {
+	std::string str = "abc\ndef";
+	agi::buffer_lines buffer(str.data(), str.data() + str.size(), "UTF-8");
+	EXPECT_EQ(str.data(), buffer.data());
+	auto it = buffer.begin();
+	EXPECT_EQ(str.data(), it->begin());
+	++it;
+	EXPECT_EQ(str.data() + 4, it->begin());
+}
+
+TEST(lagi_buffer_lines, find_newline) {
+	std::string str(100, 'a');
+	const char *begin = str.data(), *end = begin + str.size();
+	EXPECT_EQ(end, agi::find_newline(begin, end));
+	EXPECT_EQ(begin, agi::find_newline(begin, begin));
+	for (size_t i = 0; i < str.size(); ++i) {
+		str[i] = '\n';
+		EXPECT_EQ(begin + i, agi::find_newline(begin, end));
+		// Starting after the newline shouldn't find it
+		EXPECT_EQ(end, agi::find_newline(begin + i + 1, end));
+		str[i] = 'a';
+	}
+}
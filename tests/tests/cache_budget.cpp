@@ -0,0 +1,115 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/cache_budget.h>
+
+#include <libaegisub/block_cache.h>
+
+#include <main.h>
+
+#include <memory>
+
+namespace {
+struct IntFactory {
+	typedef std::unique_ptr<int> BlockType;
+	BlockType ProduceBlock(size_t i) { return BlockType(new int(static_cast<int>(i))); }
+	size_t GetBlockSize() const { return 100; }
+};
+
+typedef agi::DataBlockCache<int, 0, IntFactory> IntCache;
+}
+
+TEST(lagi_cache_budget, tick_increases) {
+	auto a = agi::CacheBudget::Tick();
+	auto b = agi::CacheBudget::Tick();
+	EXPECT_LT(a, b);
+}
+
+TEST(lagi_cache_budget, reports_usage) {
+	agi::CacheBudget budget;
+	IntCache a(10), b(10);
+	auto reg_a = budget.Register("a", &a);
+	auto reg_b = budget.Register("b", &b);
+
+	a.Get(0);
+	a.Get(1);
+	b.Get(0);
+
+	auto usage = budget.GetUsage();
+	ASSERT_EQ(2u, usage.size());
+	EXPECT_EQ("a", usage[0].name);
+	EXPECT_EQ(200u, usage[0].size);
+	EXPECT_EQ("b", usage[1].name);
+	EXPECT_EQ(100u, usage[1].size);
+	EXPECT_EQ(300u, budget.GetTotalSize());
+}
+
+TEST(lagi_cache_budget, evicts_oldest_across_caches) {
+	agi::CacheBudget budget(250);
+	IntCache a(10), b(10);
+	auto reg_a = budget.Register("a", &a);
+	auto reg_b = budget.Register("b", &b);
+
+	a.Get(0);
+	b.Get(0);
+	a.Get(1);
+	b.Get(1);
+	a.Get(0);
+
+	budget.Trim();
+	EXPECT_EQ(200u, budget.GetTotalSize());
+	EXPECT_TRUE(a.Contains(0));
+	EXPECT_FALSE(a.Contains(1));
+	EXPECT_FALSE(b.Contains(0));
+	EXPECT_TRUE(b.Contains(1));
+}
+
+TEST(lagi_cache_budget, unregister) {
+	agi::CacheBudget budget(0);
+	IntCache a(10);
+	a.Get(0);
+	{
+		auto reg = budget.Register("a", &a);
+	}
+	budget.Trim();
+	EXPECT_TRUE(a.Contains(0));
+	EXPECT_TRUE(budget.GetUsage().empty());
+}
+
+TEST(lagi_cache_budget, fixed_size_caches) {
+	agi::CacheBudget budget(200);
+	IntCache a(10);
+	auto reg_a = budget.Register("a", &a);
+	auto reg_fixed = budget.Register(agi::CacheBudget::Cache{
+		"fixed",
+		[] { return size_t(100); },
+		[] { return agi::CacheBudget::NotEvictable; },
+		[] { }
+	});
+
+	a.Get(0);
+	budget.Trim();
+	EXPECT_TRUE(a.Contains(0));
+
+	a.Get(1);
+	budget.Trim();
+	EXPECT_FALSE(a.Contains(0));
+	EXPECT_TRUE(a.Contains(1));
+
+	budget.SetLimit(50);
+	EXPECT_FALSE(a.Contains(1));
+	EXPECT_EQ(100u, budget.GetTotalSize());
+}
@@ -282,3 +282,84 @@ TEST(lagi_cajun, bool_roundtrips) {
 TEST(lagi_cajun, null_roundtrips) {
 	EXPECT_STREQ("null", roundtrip_test("null").c_str());
 }
+
+struct event_recorder final : json::Reader::Handler {
+	std::string events;
+
+	void StartObject() override { events += "{"; }
+	void Key(std::string const& key) override { events += key + ":"; }
+	void EndObject() override { events += "}"; }
+	void StartArray() override { events += "["; }
+	void EndArray() override { events += "]"; }
+	void String(std::string const& value) override { events += "s" + value + " "; }
+	void Integer(int64_t value) override { events += "i" + std::to_string(value) + " "; }
+	void Double(double value) override { events += "d "; }
+	void Boolean(bool value) override { events += value ? "t " : "f "; }
+	void Null() override { events += "n "; }
+};
+
+std::string read_events(std::string const& doc) {
+	event_recorder recorder;
+	json::Reader::Read(recorder, doc.data(), doc.data() + doc.size());
+	return recorder.events;
+}
+
+TEST(lagi_cajun, handler_gets_contents_in_order) {
+	EXPECT_EQ("{b:i1 a:[s\"x\\ t f n d {}]}", read_events(R"({"b": 1, "a": ["\"x\\", true, false, null, 1.5, {}]})"));
+}
+
+TEST(lagi_cajun, trailing_commas_are_allowed) {
+	EXPECT_EQ("{a:[i1 ]}", read_events("{\"a\": [1,],}"));
+}
+
+TEST(lagi_cajun, integer_limits) {
+	EXPECT_EQ("i-9223372036854775808 ", read_events("-9223372036854775808"));
+	EXPECT_EQ("i9223372036854775807 ", read_events("9223372036854775807"));
+	EXPECT_EQ("d ", read_events("9223372036854775808"));
+}
+
+TEST(lagi_cajun, parse_error_location) {
+	json::UnknownElement ue;
+	std::istringstream doc("{\n\t\"a\" : 1\n\t\"b\" : 2\n}");
+	try {
+		json::Reader::Read(ue, doc);
+		FAIL() << "Expected a parse error";
+	}
+	catch (json::Reader::ParseException const& e) {
+		EXPECT_EQ(2u, e.m_locTokenBegin.m_nLine);
+		EXPECT_EQ(1u, e.m_locTokenBegin.m_nLineOffset);
+	}
+}
+
+TEST(lagi_cajun, buffer_writer_matches_writer) {
+	std::istringstream doc(R"({"a" : [1, 2.5, {"b" : null}, [], {}], "c" : "d\ne", "f" : true})");
+	json::UnknownElement root;
+	json::Reader::Read(root, doc);
+
+	std::stringstream stream;
+	agi::JsonWriter::Write(root, stream);
+
+	agi::JsonBufferWriter out;
+	out.StartObject();
+	out.Key("a");
+	out.StartArray();
+	out.Integer(1);
+	out.Double(2.5);
+	out.StartObject();
+	out.Key("b");
+	out.Null();
+	out.EndObject();
+	out.StartArray();
+	out.EndArray();
+	out.StartObject();
+	out.EndObject();
+	out.EndArray();
+	out.Key("c");
+	out.String("d\ne");
+	out.Key("f");
+	out.Boolean(true);
+	out.EndObject();
+
+	EXPECT_EQ(stream.str(), out.Get());
+	EXPECT_EQ("{\n\t\"a\" : [\n\t\t1,\n\t\t2.5,\n\t\t{\n\t\t\t\"b\" : null\n\t\t},\n\t\t[],\n\t\t{}\n\t],\n\t\"c\" : \"d\\ne\",\n\t\"f\" : true\n}", out.Get());
+}
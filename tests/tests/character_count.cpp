@@ -86,3 +86,18 @@ TEST(lagi_character_count, character_index) {
 }
 
 
+
+TEST(lagi_character_count, crlf) {
+	EXPECT_EQ(3, agi::CharacterCount("a\r\nb", agi::IGNORE_NONE));
+	EXPECT_EQ(4, agi::CharacterCount("a\n\rb", agi::IGNORE_NONE));
+}
+
+TEST(lagi_character_count, ascii_matches_unicode) {
+	// Text with a non-ASCII character goes through the break iterator, so
+	// should count one more than the same text without it
+	const char *texts[] = {"hello, world.", "a\\Nb\\hc \\n", "\\h\\h", "x\r\ny", "!?\\N \t"};
+	for (auto text : texts) {
+		for (int mask = 0; mask < 4; ++mask)
+			EXPECT_EQ(agi::CharacterCount(text, mask) + 1, agi::CharacterCount(std::string(text) + "ド", mask)) << text << " " << mask;
+	}
+}
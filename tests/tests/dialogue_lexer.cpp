@@ -359,3 +359,29 @@ TEST(lagi_dialogue_lexer, templater_expression) {
 		expect_tok(ARG, 1u);
 	);
 }
+
+TEST(lagi_dialogue_lexer, long_text) {
+	// Long enough that the special characters fall in different places in
+	// the blocks scanned at once
+	std::string text(37, 'a');
+
+	tok_str(text + "\\N" + text + "{\\b1}" + text + "\\" + text, false,
+		expect_tok(TEXT, 37u);
+		expect_tok(LINE_BREAK, 2u);
+		expect_tok(TEXT, 37u);
+		expect_tok(OVR_BEGIN, 1u);
+		expect_tok(TAG_START, 1u);
+		expect_tok(TAG_NAME, 1u);
+		expect_tok(ARG, 1u);
+		expect_tok(OVR_END, 1u);
+		expect_tok(TEXT, 75u);
+	);
+
+	tok_str(text + "!x!" + text + "$y " + text, true,
+		expect_tok(TEXT, 37u);
+		expect_tok(KARAOKE_TEMPLATE, 3u);
+		expect_tok(TEXT, 37u);
+		expect_tok(KARAOKE_VARIABLE, 2u);
+		expect_tok(TEXT, 38u);
+	);
+}
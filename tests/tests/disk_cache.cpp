@@ -0,0 +1,164 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/disk_cache.h>
+#include <libaegisub/fs.h>
+
+#include <main.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+namespace {
+agi::fs::path fresh_dir(const char *name) {
+	agi::fs::path dir = agi::fs::path("data") / name;
+	boost::filesystem::remove_all(dir);
+	return dir;
+}
+
+void write(agi::fs::path const& path, size_t size) {
+	boost::filesystem::ofstream file(path, std::ios::binary);
+	file << std::string(size, 'x');
+}
+
+agi::fs::path add(agi::DiskCache &cache, const char *key, size_t size) {
+	auto path = cache.Path(key, ".bin");
+	write(path, size);
+	cache.Added(path);
+	return path;
+}
+}
+
+TEST(lagi_disk_cache, file_names) {
+	auto a = agi::DiskCache::FileName("a", ".peaks");
+	EXPECT_EQ(22u, a.size());
+	EXPECT_EQ(".peaks", a.substr(16));
+	EXPECT_EQ(a, agi::DiskCache::FileName("a", ".peaks"));
+	EXPECT_NE(a, agi::DiskCache::FileName("b", ".peaks"));
+}
+
+TEST(lagi_disk_cache, creates_root) {
+	auto dir = fresh_dir("disk_cache_root");
+	agi::DiskCache cache(dir, 1000);
+	cache.Flush();
+	EXPECT_TRUE(agi::fs::DirectoryExists(dir));
+	EXPECT_EQ(dir / agi::DiskCache::FileName("key", ".x"), cache.Path("key", ".x"));
+}
+
+TEST(lagi_disk_cache, finds_existing_files) {
+	auto dir = fresh_dir("disk_cache_scan");
+	agi::fs::CreateDirectory(dir);
+	write(dir / "a", 10);
+	write(dir / "b", 20);
+
+	agi::DiskCache cache(dir, 1000);
+	cache.Flush();
+	EXPECT_EQ(2u, cache.GetCount());
+	EXPECT_EQ(30u, cache.GetSize());
+}
+
+TEST(lagi_disk_cache, evicts_least_recently_used) {
+	auto dir = fresh_dir("disk_cache_lru");
+	agi::DiskCache cache(dir, 250);
+	auto a = add(cache, "a", 100);
+	auto b = add(cache, "b", 100);
+	cache.Flush();
+	EXPECT_EQ(200u, cache.GetSize());
+
+	// Using a makes b the oldest
+	cache.Path("a", ".bin");
+	auto c = add(cache, "c", 100);
+	cache.Flush();
+
+	EXPECT_TRUE(agi::fs::FileExists(a));
+	EXPECT_FALSE(agi::fs::FileExists(b));
+	EXPECT_TRUE(agi::fs::FileExists(c));
+	EXPECT_EQ(2u, cache.GetCount());
+	EXPECT_EQ(200u, cache.GetSize());
+}
+
+TEST(lagi_disk_cache, evicts_down_to_file_count) {
+	auto dir = fresh_dir("disk_cache_count");
+	agi::DiskCache cache(dir, 100000, 2);
+	auto a = add(cache, "a", 1);
+	add(cache, "b", 1);
+	add(cache, "c", 1);
+	cache.Flush();
+
+	EXPECT_FALSE(agi::fs::FileExists(a));
+	EXPECT_EQ(2u, cache.GetCount());
+}
+
+TEST(lagi_disk_cache, keeps_newest_file) {
+	auto dir = fresh_dir("disk_cache_newest");
+	agi::DiskCache cache(dir, 10);
+	auto a = add(cache, "a", 100);
+	cache.Flush();
+	EXPECT_TRUE(agi::fs::FileExists(a));
+
+	// Growing the file counts the new size
+	write(a, 200);
+	cache.Added(a);
+	cache.Flush();
+	EXPECT_EQ(200u, cache.GetSize());
+}
+
+TEST(lagi_disk_cache, set_quota_evicts) {
+	auto dir = fresh_dir("disk_cache_quota");
+	agi::DiskCache cache(dir, 1000);
+	auto a = add(cache, "a", 100);
+	auto b = add(cache, "b", 100);
+	cache.Flush();
+
+	cache.SetQuota(150);
+	cache.Flush();
+	EXPECT_FALSE(agi::fs::FileExists(a));
+	EXPECT_TRUE(agi::fs::FileExists(b));
+}
+
+TEST(lagi_disk_cache, removed) {
+	auto dir = fresh_dir("disk_cache_removed");
+	agi::DiskCache cache(dir, 1000);
+	auto a = add(cache, "a", 100);
+	cache.Flush();
+
+	agi::fs::Remove(a);
+	cache.Removed(a);
+	EXPECT_EQ(0u, cache.GetCount());
+	EXPECT_EQ(0u, cache.GetSize());
+
+	// Files outside of the cache are ignored
+	cache.Added(agi::fs::path("data") / "disk_cache_elsewhere");
+	cache.Flush();
+	EXPECT_EQ(0u, cache.GetCount());
+}
+
+TEST(lagi_disk_cache, set_root) {
+	auto dir = fresh_dir("disk_cache_root_a");
+	auto other = fresh_dir("disk_cache_root_b");
+	agi::fs::CreateDirectory(other);
+	write(other / "x", 10);
+
+	agi::DiskCache cache(dir, 1000);
+	add(cache, "a", 100);
+	cache.Flush();
+
+	cache.SetRoot(other);
+	cache.Flush();
+	EXPECT_EQ(other, cache.Root());
+	EXPECT_EQ(1u, cache.GetCount());
+	EXPECT_EQ(10u, cache.GetSize());
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/dispatch.h>
+
+#include <main.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using namespace agi::dispatch;
+
+namespace {
+/// Blocks a serial queue until released, so that thunks can be queued up
+/// behind it
+struct Gate {
+	std::mutex m;
+	std::condition_variable cv;
+	bool running = false;
+	bool open = false;
+
+	/// Block the queue, returning once the blocking thunk has started
+	void Block(Queue& queue) {
+		queue.Async([=] {
+			std::unique_lock<std::mutex> l(m);
+			running = true;
+			cv.notify_all();
+			cv.wait(l, [=] { return open; });
+		});
+		std::unique_lock<std::mutex> l(m);
+		cv.wait(l, [=] { return running; });
+	}
+
+	void Open() {
+		std::lock_guard<std::mutex> l(m);
+		open = true;
+		cv.notify_all();
+	}
+};
+}
+
+TEST(lagi_dispatch, sync_runs_thunk) {
+	auto queue = Create();
+	int x = 0;
+	queue->Sync([&] { x = 5; });
+	EXPECT_EQ(5, x);
+}
+
+TEST(lagi_dispatch, priority_order) {
+	auto queue = Create();
+	Gate gate;
+	gate.Block(*queue);
+
+	std::vector<int> order;
+	queue->Async([&] { order.push_back(3); }, Priority::Background);
+	queue->Async([&] { order.push_back(2); }, Priority::Prefetch);
+	queue->Async([&] { order.push_back(1); });
+	queue->Async([&] { order.push_back(4); }, Priority::Background);
+
+	gate.Open();
+	queue->Sync([] { }, Priority::Background);
+
+	ASSERT_EQ(4u, order.size());
+	EXPECT_EQ(1, order[0]);
+	EXPECT_EQ(2, order[1]);
+	EXPECT_EQ(3, order[2]);
+	EXPECT_EQ(4, order[3]);
+}
+
+TEST(lagi_dispatch, cancel) {
+	auto queue = Create();
+	Gate gate;
+	gate.Block(*queue);
+
+	CancelToken token;
+	int x = 0;
+	queue->Async([&] { x += 1; }, Priority::Interactive, token);
+	queue->Async([&] { x += 10; }, Priority::Interactive, token);
+	queue->Async([&] { x += 100; });
+	token.Cancel();
+
+	gate.Open();
+	queue->Sync([] { }, Priority::Background);
+
+	EXPECT_EQ(100, x);
+	EXPECT_TRUE(token.IsCancelled());
+
+	auto stats = queue->Stats();
+	EXPECT_EQ(0u, stats.depth);
+	EXPECT_EQ(2u, stats.cancelled);
+	EXPECT_EQ(3u, stats.started);
+}
+
+TEST(lagi_dispatch, stats_depth) {
+	auto queue = Create();
+	Gate gate;
+	gate.Block(*queue);
+
+	queue->Async([] { });
+	queue->Async([] { }, Priority::Prefetch);
+	EXPECT_EQ(2u, queue->Stats().depth);
+
+	gate.Open();
+	queue->Sync([] { }, Priority::Background);
+	EXPECT_EQ(0u, queue->Stats().depth);
+	EXPECT_EQ(4u, queue->Stats().started);
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/fft.h>
+#include <libaegisub/exception.h>
+
+#include <main.h>
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace agi;
+
+namespace {
+/// Samples in [-1, 1), as the spectrum's input is
+std::vector<float> noise(size_t count) {
+	srand(1);
+	std::vector<float> samples(count);
+	for (auto& s : samples)
+		s = static_cast<float>(rand() % 65536 - 32768) / 32768.f;
+	return samples;
+}
+
+/// The first half of the bins of the DFT of real input, worked out directly
+void naive_dft(std::vector<float> const& input, std::vector<double> &real, std::vector<double> &imag) {
+	const double pi = 3.1415926535897932384626433832795;
+	const size_t n = input.size();
+	real.assign(n / 2, 0);
+	imag.assign(n / 2, 0);
+	for (size_t k = 0; k < n / 2; ++k) {
+		for (size_t i = 0; i < n; ++i) {
+			// Reduce the angle exactly so that it stays accurate for large k * i
+			const double angle = 2 * pi * ((k * i) % n) / n;
+			real[k] += input[i] * cos(angle);
+			imag[k] -= input[i] * sin(angle);
+		}
+	}
+}
+}
+
+TEST(lagi_fft, matches_naive_dft) {
+	// From too small for the vectorized butterflies up to the spectrum's
+	// default size. Rounding error grows with log2(n) passes over sums of up
+	// to n samples, so the tolerance is relative to n.
+	for (size_t n : {2, 4, 8, 64, 1024, 4096}) {
+		auto input = noise(n);
+		std::vector<double> expected_r, expected_i;
+		naive_dft(input, expected_r, expected_i);
+
+		RealFFT fft(n);
+		std::vector<float> real(n / 2), imag(n / 2);
+		fft.Transform(&input[0], &real[0], &imag[0]);
+
+		const double tolerance = 1e-6 * n;
+		for (size_t k = 0; k < n / 2; ++k) {
+			ASSERT_NEAR(expected_r[k], real[k], tolerance) << "n = " << n << ", bin " << k;
+			ASSERT_NEAR(expected_i[k], imag[k], tolerance) << "n = " << n << ", bin " << k;
+		}
+	}
+}
+
+TEST(lagi_fft, reusable) {
+	auto input = noise(256);
+	RealFFT fft(256);
+	std::vector<float> real1(128), imag1(128), real2(128), imag2(128);
+	fft.Transform(&input[0], &real1[0], &imag1[0]);
+	fft.Transform(&input[0], &real2[0], &imag2[0]);
+	EXPECT_EQ(real1, real2);
+	EXPECT_EQ(imag1, imag2);
+}
+
+TEST(lagi_fft, not_power_of_two) {
+	EXPECT_THROW(RealFFT(0), InternalError);
+	EXPECT_THROW(RealFFT(1), InternalError);
+	EXPECT_THROW(RealFFT(1000), InternalError);
+}
+
+TEST(lagi_fft, spectrum_power) {
+	// An odd count to cover both the vectorized part and the tail, with
+	// magnitudes from zero up to well past the top of the colour maps
+	const size_t count = 1023;
+	std::vector<float> real(count), imag(count);
+	std::vector<double> complex(count * 2);
+	for (size_t i = 0; i < count; ++i) {
+		real[i] = complex[i * 2] = std::pow(10., i / 100.) - 1.;
+		imag[i] = complex[i * 2 + 1] = i % 3 ? -0.5 * real[i] : 0.;
+	}
+
+	const float scale = 0.3f;
+	std::vector<float> power(count), power_complex(count);
+	SpectrumPower(count, &real[0], &imag[0], scale, &power[0]);
+	SpectrumPower(count, &complex[0], scale, &power_complex[0]);
+
+	// The values go up to about 10 and are drawn with 256-entry colour maps
+	// covering 0-1, so this is far finer than anything visible
+	const double tolerance = 1e-5;
+	for (size_t i = 0; i < count; ++i) {
+		const double expected = log10(std::hypot(double(real[i]), double(imag[i])) * scale + 1);
+		ASSERT_NEAR(expected, power[i], tolerance) << "bin " << i;
+		ASSERT_NEAR(expected, power_complex[i], tolerance) << "bin " << i;
+	}
+}
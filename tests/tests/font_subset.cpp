@@ -0,0 +1,200 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/font_subset.h>
+
+#include <main.h>
+
+#include <cstdint>
+#include <string>
+
+using agi::ass::SubsetFont;
+
+namespace {
+void put16(std::string& str, uint32_t value) {
+	str += static_cast<char>(value >> 8);
+	str += static_cast<char>(value);
+}
+
+void put32(std::string& str, uint32_t value) {
+	put16(str, value >> 16);
+	put16(str, value & 0xFFFF);
+}
+
+uint32_t get32(std::vector<char> const& data, size_t offset) {
+	auto p = reinterpret_cast<const unsigned char *>(&data[offset]);
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+/// A simple glyph with the given number of bytes of made-up outline
+std::string simple_glyph(size_t size) {
+	std::string glyph;
+	put16(glyph, 1);
+	glyph.append(size - 2, 'x');
+	return glyph;
+}
+
+/// A minimal TrueType font with glyphs:
+///  0: .notdef
+///  1: 'A'
+///  2: 'B'
+///  3: 'C', a composite of glyph 2
+///  4: not in the cmap
+std::string make_font(const char *version = "\0\1\0\0") {
+	std::vector<std::string> glyphs{
+		simple_glyph(12), simple_glyph(20), simple_glyph(24), "", simple_glyph(8)
+	};
+	put16(glyphs[3], 0xFFFF); // one component
+	glyphs[3].append(8, '\0'); // bounding box
+	put16(glyphs[3], 0); // flags: byte args, no more components
+	put16(glyphs[3], 2); // component glyph
+	put16(glyphs[3], 0); // args
+
+	std::string glyf, loca;
+	for (auto const& glyph : glyphs) {
+		put32(loca, glyf.size());
+		glyf += glyph;
+	}
+	put32(loca, glyf.size());
+
+	std::string head(54, '\0');
+	head[51] = 1; // long loca offsets
+
+	std::string maxp;
+	put32(maxp, 0x00005000);
+	put16(maxp, glyphs.size());
+
+	// Format 4 with one segment for A-C and the terminating segment
+	std::string cmap;
+	put16(cmap, 0);
+	put16(cmap, 1);
+	put16(cmap, 3);
+	put16(cmap, 1);
+	put32(cmap, 12);
+	put16(cmap, 4);
+	put16(cmap, 32); // length
+	put16(cmap, 0);
+	put16(cmap, 4); // segCountX2
+	put16(cmap, 4);
+	put16(cmap, 1);
+	put16(cmap, 0);
+	put16(cmap, 'C'); // end codes
+	put16(cmap, 0xFFFF);
+	put16(cmap, 0);
+	put16(cmap, 'A'); // start codes
+	put16(cmap, 0xFFFF);
+	put16(cmap, 1 - 'A'); // deltas
+	put16(cmap, 1);
+	put16(cmap, 0); // range offsets
+	put16(cmap, 0);
+
+	std::string dsig(8, '\0');
+
+	std::pair<const char *, std::string *> tables[] = {
+		{"DSIG", &dsig}, {"cmap", &cmap}, {"glyf", &glyf}, {"head", &head}, {"loca", &loca}, {"maxp", &maxp}
+	};
+
+	std::string font(version, 4);
+	put16(font, 6);
+	put16(font, 64);
+	put16(font, 2);
+	put16(font, 32);
+
+	std::string body;
+	size_t offset = 12 + 16 * 6;
+	for (auto const& table : tables) {
+		font.append(table.first, 4);
+		put32(font, 0);
+		put32(font, offset + body.size());
+		put32(font, table.second->size());
+		body += *table.second;
+		body.resize((body.size() + 3) & ~3);
+	}
+	return font + body;
+}
+
+struct Font {
+	std::vector<char> data;
+	std::vector<std::string> tags;
+	std::vector<uint32_t> loca;
+
+	Font(std::vector<char> data) : data(std::move(data)) {
+		uint32_t loca_offset = 0, loca_length = 0;
+		for (size_t i = 0; i < (get32(this->data, 4) >> 16); ++i) {
+			size_t record = 12 + i * 16;
+			tags.emplace_back(&this->data[record], 4);
+			if (tags.back() == "loca") {
+				loca_offset = get32(this->data, record + 8);
+				loca_length = get32(this->data, record + 12);
+			}
+		}
+		for (size_t i = 0; i < loca_length; i += 4)
+			loca.push_back(get32(this->data, loca_offset + i));
+	}
+
+	size_t GlyphSize(size_t glyph) const { return loca[glyph + 1] - loca[glyph]; }
+};
+}
+
+TEST(lagi_font_subset, drops_unused_glyphs) {
+	auto src = make_font();
+	Font font(SubsetFont(src.data(), src.size(), {'A'}));
+	ASSERT_EQ(6u, font.loca.size());
+	EXPECT_EQ(12u, font.GlyphSize(0));
+	EXPECT_EQ(20u, font.GlyphSize(1));
+	EXPECT_EQ(0u, font.GlyphSize(2));
+	EXPECT_EQ(0u, font.GlyphSize(3));
+	EXPECT_EQ(8u, font.GlyphSize(4));
+	EXPECT_LT(font.data.size(), src.size());
+}
+
+TEST(lagi_font_subset, keeps_components_of_used_glyphs) {
+	auto src = make_font();
+	Font font(SubsetFont(src.data(), src.size(), {'C'}));
+	ASSERT_EQ(6u, font.loca.size());
+	EXPECT_EQ(0u, font.GlyphSize(1));
+	EXPECT_EQ(24u, font.GlyphSize(2));
+	EXPECT_EQ(16u, font.GlyphSize(3));
+}
+
+TEST(lagi_font_subset, drops_signature) {
+	auto src = make_font();
+	Font font(SubsetFont(src.data(), src.size(), {'A'}));
+	EXPECT_EQ((std::vector<std::string>{"cmap", "glyf", "head", "loca", "maxp"}), font.tags);
+	EXPECT_EQ(5u, get32(font.data, 4) >> 16);
+}
+
+TEST(lagi_font_subset, checksum_adjustment_is_valid) {
+	auto src = make_font();
+	auto font = SubsetFont(src.data(), src.size(), {'B'});
+	ASSERT_FALSE(font.empty());
+	ASSERT_EQ(0u, font.size() % 4);
+	uint32_t sum = 0;
+	for (size_t i = 0; i < font.size(); i += 4)
+		sum += get32(font, i);
+	EXPECT_EQ(0xB1B0AFBAu, sum);
+}
+
+TEST(lagi_font_subset, rejects_cff_fonts) {
+	auto src = make_font("OTTO");
+	EXPECT_TRUE(SubsetFont(src.data(), src.size(), {'A'}).empty());
+}
+
+TEST(lagi_font_subset, rejects_truncated_fonts) {
+	auto src = make_font();
+	EXPECT_TRUE(SubsetFont(src.data(), 100, {'A'}).empty());
+	EXPECT_TRUE(SubsetFont(src.data(), 3, {'A'}).empty());
+}
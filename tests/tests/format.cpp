@@ -138,3 +138,26 @@ TEST(lagi_format, path) {
 	EXPECT_EQ("/usr/bin", agi::format("%s", agi::fs::path("/usr/bin")));
 	EXPECT_EQ(L"/usr/bin", agi::format(L"%s", agi::fs::path("/usr/bin")));
 }
+
+TEST(lagi_format, format_to) {
+	std::string out = "a=";
+	agi::format_to(out, "%d, b=%s", 10, "str");
+	EXPECT_EQ("a=10, b=str", out);
+	agi::format_to(out, "%%%c", 'c');
+	EXPECT_EQ("a=10, b=str%c", out);
+}
+
+TEST(lagi_format, missing_arguments) {
+	EXPECT_EQ("1 %d %s", agi::format("%d %d %s", 1));
+	EXPECT_EQ("1", agi::format("%d", 1, 2, 3));
+}
+
+TEST(lagi_format, s_width) {
+	// Only strings written with operator<< are padded, as with iostreams
+	char buf[] = "str";
+	EXPECT_EQ("  str", agi::format("%5s", buf));
+	EXPECT_EQ("str", agi::format("%5s", "str"));
+	EXPECT_EQ("   10", agi::format("%5s", 10));
+	EXPECT_EQ("true ", agi::format("%-5s", true));
+	EXPECT_EQ("1.5", agi::format("%s", 1.5));
+}
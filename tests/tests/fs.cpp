@@ -133,6 +133,41 @@ TEST(lagi_fs, copy_overwrites) {
 TEST(lagi_fs, copy_creates_path) {
 }
 
+TEST(lagi_fs, clone) {
+	int expected_value = util::write_rand("data/clone_in");
+	ASSERT_NO_THROW(Remove("data/clone_out"));
+
+	// Whether this works depends on the filesystem the tests are run on
+	if (Clone("data/clone_in", "data/clone_out"))
+		EXPECT_EQ(expected_value, util::read_written_rand("data/clone_out"));
+	else
+		EXPECT_FALSE(Exists("data/clone_out"));
+}
+
+TEST(lagi_fs, hard_link) {
+	int expected_value = util::write_rand("data/link_in");
+	ASSERT_NO_THROW(Remove("data/link_out"));
+
+	ASSERT_TRUE(HardLink("data/link_in", "data/link_out"));
+
+	EXPECT_TRUE(FileExists("data/link_in"));
+	EXPECT_TRUE(FileExists("data/link_out"));
+	EXPECT_EQ(expected_value, util::read_written_rand("data/link_out"));
+}
+
+TEST(lagi_fs, hard_link_does_not_overwrite) {
+	ASSERT_NO_THROW(Touch("data/link_in"));
+	ASSERT_NO_THROW(Touch("data/link_out"));
+	EXPECT_FALSE(HardLink("data/link_in", "data/link_out"));
+}
+
+TEST(lagi_fs, is_remote) {
+	// Whether this is on a network share depends on where the tests are run,
+	// so only check that it copes with paths which don't exist
+	EXPECT_NO_THROW(IsRemote("data"));
+	EXPECT_FALSE(IsRemote("data/does/not/exist"));
+}
+
 TEST(lagi_fs, has_extension) {
 	EXPECT_TRUE(HasExtension("foo.txt", "txt"));
 	EXPECT_TRUE(HasExtension("foo.TXT", "txt"));
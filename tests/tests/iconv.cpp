@@ -178,3 +178,88 @@ TEST(lagi_iconv, Iso6937) {
 	EXPECT_STREQ("?", ret.c_str());
 	EXPECT_THROW(no_subst.Convert("\xCB\x97"), BadInput);
 }
+
+namespace {
+std::string raw_iconv(const char *src_enc, const char *dst_enc, std::string const& str) {
+	iconv_t cd = iconv_open(dst_enc, src_enc);
+	std::string ret(str.size() * 4 + 4, '\0');
+	char *in = const_cast<char *>(str.data()), *out = &ret[0];
+	size_t in_left = str.size(), out_left = ret.size();
+	iconv(cd, &in, &in_left, &out, &out_left);
+	iconv_close(cd);
+	ret.resize(ret.size() - out_left);
+	return ret;
+}
+}
+
+TEST(lagi_iconv, UnicodeMatchesIconv) {
+	const std::string long_ascii(100, 'a');
+	const char *strings[] = {
+		"",
+		"a",
+		"Jackdaws love my big sphinx of quartz",
+		"\xC3\xA9t\xC3\xA9",
+		"\xE3\x81\x82\xE3\x81\x84\xE3\x81\x86",
+		"\xF0\x9F\x98\x80 astral",
+	};
+	const char *encodings[] = { "UTF-8", "UTF-16LE", "UTF-16BE" };
+
+	for (const char *str : strings) {
+		// Put the multibyte characters at each position within the blocks of
+		// ASCII which are converted together
+		for (size_t pad : {0, 7, 15, 31}) {
+			std::string utf8 = long_ascii.substr(0, pad) + str + long_ascii;
+			for (const char *src : encodings) {
+				std::string in = raw_iconv("UTF-8", src, utf8);
+				for (const char *dst : encodings)
+					EXPECT_EQ(raw_iconv(src, dst, in), IconvWrapper(src, dst).Convert(in)) << src << " -> " << dst << ": " << utf8;
+			}
+		}
+	}
+}
+
+TEST(lagi_iconv, UnicodeBadInput) {
+	IconvWrapper utf8("UTF-8", "UTF-16LE");
+	// Overlong, surrogate, past the end of Unicode and truncated
+	EXPECT_THROW(utf8.Convert("\xC0\xAF"), BadInput);
+	EXPECT_THROW(utf8.Convert("\xED\xA0\x80"), BadInput);
+	EXPECT_THROW(utf8.Convert("\xF4\x90\x80\x80"), BadInput);
+	EXPECT_THROW(utf8.Convert(std::string(40, 'a') + "\xE3\x81"), BadInput);
+
+	IconvWrapper utf16("UTF-16LE", "UTF-8");
+	EXPECT_THROW(utf16.Convert(std::string("\x00\xD8 \x00", 4)), BadInput);
+	EXPECT_THROW(utf16.Convert(std::string("\x00\xDC", 2)), BadInput);
+}
+
+TEST(lagi_iconv, UnicodeBuffer) {
+	IconvWrapper conv("UTF-8", "UTF-16LE");
+	char buff[8];
+	memset(buff, 0xFF, sizeof(buff));
+
+	// The character which doesn't fit mustn't be partially written
+	EXPECT_THROW(conv.Convert("a\xF0\x9F\x98\x80", 5, buff, 5), BufferTooSmall);
+	EXPECT_EQ('a', buff[0]);
+	EXPECT_EQ('\xFF', buff[2]);
+	EXPECT_NO_THROW(conv.Convert("a\xF0\x9F\x98\x80", 5, buff, 6));
+	EXPECT_EQ('\x3D', buff[2]);
+	EXPECT_EQ('\xD8', buff[3]);
+}
+
+TEST(lagi_iconv, Wide) {
+	const std::string utf8 = std::string(40, 'a') + "\xC3\xA9\xE3\x81\x82\xF0\x9F\x98\x80" + std::string(20, 'b');
+
+	std::wstring wide;
+	ASSERT_TRUE(Utf8ToWide(utf8.data(), utf8.size(), wide));
+	std::wstring expected = std::wstring(40, L'a') + L"éあ\U0001F600" + std::wstring(20, L'b');
+	EXPECT_EQ(expected, wide);
+
+	std::string narrow;
+	ASSERT_TRUE(WideToUtf8(wide.data(), wide.size(), narrow));
+	EXPECT_EQ(utf8, narrow);
+
+	EXPECT_FALSE(Utf8ToWide("a\xFF", 2, wide));
+	if (sizeof(wchar_t) == 2) {
+		const wchar_t lone[] = { L'a', static_cast<wchar_t>(0xD800), L'b' };
+		EXPECT_FALSE(WideToUtf8(lone, 3, narrow));
+	}
+}
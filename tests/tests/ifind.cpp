@@ -43,6 +43,24 @@ TEST(lagi_ifind, basic_match) {
 	EXPECT_NO_MATCH(" a ", "b");
 }
 
+TEST(lagi_ifind, ascii) {
+	EXPECT_IFIND("Hello World", "world", 6, 11);
+	EXPECT_IFIND("hello world", "WORLD", 6, 11);
+	EXPECT_IFIND("aaab", "AAB", 1, 4);
+	EXPECT_IFIND("abc", "abc", 0, 3);
+	EXPECT_IFIND("{\\i1}text", "\\I1", 1, 4);
+	EXPECT_NO_MATCH("abc", "abcd");
+	EXPECT_NO_MATCH("a[c", "A{C");
+	EXPECT_NO_MATCH("hello", "hellp");
+}
+
+TEST(lagi_ifind, ascii_haystack_with_unicode_needle) {
+	// LATIN SMALL LETTER LONG S folds to s
+	EXPECT_IFIND(" s ", "\xC5\xBF", 1, 2);
+	// KELVIN SIGN folds to k
+	EXPECT_IFIND(" k ", "\xE2\x84\xAA", 1, 2);
+}
+
 TEST(lagi_ifind, sharp_s_matches_ss) {
 	// lowercase
 	EXPECT_IFIND(" \xC3\x9F ", "ss", 1, 3);
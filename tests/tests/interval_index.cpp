@@ -0,0 +1,90 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/interval_index.h>
+
+#include <main.h>
+
+#include <algorithm>
+#include <random>
+
+TEST(lagi_interval_index, empty) {
+	agi::IntervalIndex<int> index;
+	index.Build();
+	EXPECT_TRUE(index.Find(0).empty());
+}
+
+TEST(lagi_interval_index, half_open) {
+	agi::IntervalIndex<int> index;
+	index.Add(10, 20, 1);
+	index.Build();
+
+	EXPECT_TRUE(index.Find(9).empty());
+	EXPECT_EQ(std::vector<int>{1}, index.Find(10));
+	EXPECT_EQ(std::vector<int>{1}, index.Find(19));
+	EXPECT_TRUE(index.Find(20).empty());
+}
+
+TEST(lagi_interval_index, empty_intervals_are_skipped) {
+	agi::IntervalIndex<int> index;
+	index.Add(10, 10, 1);
+	index.Add(20, 10, 2);
+	index.Build();
+
+	EXPECT_EQ(0u, index.size());
+	EXPECT_TRUE(index.Find(10).empty());
+}
+
+TEST(lagi_interval_index, order) {
+	agi::IntervalIndex<int> index;
+	index.Add(5, 100, 3);
+	index.Add(0, 50, 1);
+	index.Add(5, 10, 2);
+	index.Add(0, 200, 0);
+	index.Build();
+
+	EXPECT_EQ((std::vector<int>{1, 0, 3, 2}), index.Find(5));
+	EXPECT_EQ((std::vector<int>{0, 3}), index.Find(60));
+	EXPECT_EQ((std::vector<int>{0}), index.Find(150));
+}
+
+TEST(lagi_interval_index, matches_linear_scan) {
+	struct Interval { int start, end; };
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> start_dist(0, 10000);
+	std::uniform_int_distribution<int> length_dist(1, 500);
+
+	std::vector<Interval> intervals;
+	agi::IntervalIndex<int> index;
+	for (int i = 0; i < 1000; ++i) {
+		int start = start_dist(rng);
+		intervals.push_back(Interval{start, start + length_dist(rng)});
+		index.Add(intervals.back().start, intervals.back().end, i);
+	}
+	index.Build();
+
+	for (int point = -10; point < 10600; point += 7) {
+		std::vector<int> expected;
+		for (size_t i = 0; i < intervals.size(); ++i) {
+			if (intervals[i].start <= point && point < intervals[i].end)
+				expected.push_back(static_cast<int>(i));
+		}
+
+		auto found = index.Find(point);
+		std::sort(found.begin(), found.end());
+		ASSERT_EQ(expected, found) << "at " << point;
+	}
+}
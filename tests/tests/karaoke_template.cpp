@@ -0,0 +1,73 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/karaoke_template.h>
+
+#include <main.h>
+
+using namespace agi::ass;
+
+namespace {
+// Write the parts back out in a form which shows their types
+std::string dump(std::vector<TemplatePart> const& parts) {
+	std::string ret;
+	for (auto const& part : parts) {
+		switch (part.type) {
+			case TemplatePart::TEXT: ret += "[" + part.text + "]"; break;
+			case TemplatePart::VARIABLE: ret += "$" + part.name; break;
+			case TemplatePart::EXPRESSION: ret += "!" + dump(part.code) + "!"; break;
+		}
+	}
+	return ret;
+}
+}
+
+TEST(lagi_karaoke_template, empty) {
+	EXPECT_TRUE(ParseTemplate("").empty());
+}
+
+TEST(lagi_karaoke_template, text) {
+	EXPECT_EQ("[{\\k10}abc]", dump(ParseTemplate("{\\k10}abc")));
+}
+
+TEST(lagi_karaoke_template, variables) {
+	auto parts = ParseTemplate("{\\pos($X,$y)}");
+	EXPECT_EQ("[{\\pos(]$x[,]$y[)}]", dump(parts));
+	ASSERT_EQ(5u, parts.size());
+	EXPECT_EQ("X", parts[1].text);
+	EXPECT_EQ("x", parts[1].name);
+
+	EXPECT_EQ("$s_start$send", dump(ParseTemplate("$s_start$send")));
+	// A $ without a name is just text
+	EXPECT_EQ("[$ 10$]", dump(ParseTemplate("$ 10$")));
+}
+
+TEST(lagi_karaoke_template, expressions) {
+	EXPECT_EQ("[a]![1 + 2]![b]", dump(ParseTemplate("a!1 + 2!b")));
+	EXPECT_EQ("![x]!![y]!", dump(ParseTemplate("!x!!y!")));
+	EXPECT_EQ("!!", dump(ParseTemplate("!!")));
+}
+
+TEST(lagi_karaoke_template, variables_in_expressions) {
+	EXPECT_EQ("[{\\t(]!$start[ + ]$dur[ / 2]![)}]", dump(ParseTemplate("{\\t(!$start + $dur / 2!)}")));
+	EXPECT_EQ("![retime(\"syl\", ]$i[)]!", dump(ParseTemplate("!retime(\"syl\", $i)!")));
+}
+
+TEST(lagi_karaoke_template, unpaired) {
+	EXPECT_EQ("[a!b]", dump(ParseTemplate("a!b")));
+	EXPECT_EQ("![x]![ !y ]$z", dump(ParseTemplate("!x! !y $z")));
+	EXPECT_EQ("[!]$x", dump(ParseTemplate("!$x")));
+}
@@ -139,3 +139,15 @@ TEST(lagi_keyframe, aegi) {
 
 	EXPECT_TRUE(expected == res);
 }
+
+TEST(lagi_keyframe, crlf_without_trailing_newline) {
+	{
+		std::ofstream out("data/keyframe/crlf.txt", std::ios::binary);
+		out << "# keyframe format v1\r\nfps 0\r\n0\r\n 5\r\n-\r\n70 junk\r\n180";
+	}
+
+	std::vector<int> res;
+	ASSERT_NO_THROW(res = Load("data/keyframe/crlf.txt"));
+
+	EXPECT_EQ((std::vector<int>{0, 5, 70, 180}), res);
+}
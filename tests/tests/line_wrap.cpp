@@ -151,3 +151,20 @@ TEST(lagi_wrap, balanced) {
 	EXPECT_EQ(5, ret[1]);
 	EXPECT_EQ(7, ret[2]);
 }
+
+TEST(lagi_wrap, batch) {
+	std::vector<std::vector<int>> lines{
+		{},
+		{ 25, 25, 25, 24 },
+		{ 20, 20, 20, 20, 20, 20 },
+		{ 60, 50, 40, 30, 20, 10, 20, 30 },
+		{ 20, 20, 20, 20, 20, 20, 20 }
+	};
+
+	for (int i = Wrap_Balanced_FirstLonger; i <= Wrap_Balanced; ++i) {
+		auto batch = get_wrap_points_batch(lines, 100, (agi::WrapMode)i);
+		ASSERT_EQ(lines.size(), batch.size());
+		for (size_t j = 0; j < lines.size(); ++j)
+			EXPECT_EQ(get_wrap_points(lines[j], 100, (agi::WrapMode)i), batch[j]);
+	}
+}
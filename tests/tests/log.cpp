@@ -0,0 +1,127 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/log.h>
+
+#include <libaegisub/fs.h>
+#include <libaegisub/make_unique.h>
+
+#include <main.h>
+
+#include <fstream>
+#include <iterator>
+
+namespace {
+struct recorder final : agi::log::Emitter {
+	std::vector<std::string>& messages;
+	size_t& flushes;
+
+	recorder(std::vector<std::string>& messages, size_t& flushes) : messages(messages), flushes(flushes) { }
+	void log(agi::log::SinkMessage const& sm) override { messages.push_back(sm.message); }
+	void Flush() override { ++flushes; }
+};
+
+agi::log::SinkMessage message(std::string text) {
+	agi::log::SinkMessage sm;
+	sm.message = std::move(text);
+	sm.time = 0;
+	sm.section = "section";
+	sm.file = "file";
+	sm.func = "func";
+	sm.severity = agi::log::Info;
+	sm.line = 1;
+	return sm;
+}
+
+int evaluations = 0;
+int evaluate() { return ++evaluations; }
+}
+
+TEST(lagi_log, disabled_messages_are_not_formatted) {
+	evaluations = 0;
+	agi::log::log->SetLevel(agi::log::Info);
+	LOG_D("test") << evaluate();
+	EXPECT_EQ(0, evaluations);
+	LOG_I("test") << evaluate();
+	EXPECT_EQ(1, evaluations);
+
+	agi::log::log->SetLevel(agi::log::Debug);
+	LOG_D("test") << evaluate();
+	EXPECT_EQ(2, evaluations);
+}
+
+TEST(lagi_log, messages_reach_emitters_in_order) {
+	std::vector<std::string> messages;
+	size_t flushes = 0;
+	agi::log::LogSink sink;
+	sink.Subscribe(agi::make_unique<recorder>(messages, flushes));
+
+	for (int i = 0; i < 100; ++i)
+		sink.Log(message(std::to_string(i)));
+	auto ring = sink.GetMessages();
+
+	ASSERT_EQ(100u, messages.size());
+	for (int i = 0; i < 100; ++i)
+		EXPECT_EQ(std::to_string(i), messages[i]);
+	EXPECT_LE(1u, flushes);
+	EXPECT_GE(100u, flushes);
+	ASSERT_EQ(100u, ring.size());
+	EXPECT_EQ("99", ring.back().message);
+}
+
+TEST(lagi_log, ring_keeps_the_newest_messages) {
+	agi::log::LogSink sink;
+	for (int i = 0; i < 300; ++i)
+		sink.Log(message(std::to_string(i)));
+
+	auto ring = sink.GetMessages();
+	ASSERT_EQ(250u, ring.size());
+	EXPECT_EQ("50", ring.front().message);
+	EXPECT_EQ("299", ring.back().message);
+}
+
+TEST(lagi_log, binary_emitter) {
+	agi::fs::CreateDirectory("data/binary_log");
+	for (auto const& file : agi::fs::DirectoryIterator("data/binary_log", "*.agilog"))
+		agi::fs::Remove("data/binary_log/" + file);
+
+	{
+		agi::log::BinaryEmitter emitter("data/binary_log");
+		auto sm = message("hello");
+		emitter.log(sm);
+		sm.message = "world";
+		sm.line = 2;
+		emitter.log(sm);
+		emitter.Flush();
+	}
+
+	std::string name;
+	for (auto const& file : agi::fs::DirectoryIterator("data/binary_log", "*.agilog"))
+		name = file;
+	ASSERT_FALSE(name.empty());
+
+	std::ifstream file("data/binary_log/" + name, std::ios::binary);
+	std::string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+	static const char expected[] =
+		"agilog\0\1"
+		"S\0\0\0\0\7\0\0\0section"
+		"S\1\0\0\0\4\0\0\0file"
+		"S\2\0\0\0\4\0\0\0func"
+		"M\0\0\0\0\0\0\0\0\3\1\0\0\0\0\0\0\0\1\0\0\0\2\0\0\0\5\0\0\0hello"
+		"M\0\0\0\0\0\0\0\0\3\2\0\0\0\0\0\0\0\1\0\0\0\2\0\0\0\5\0\0\0world";
+	EXPECT_EQ(std::string(expected, sizeof(expected) - 1), data);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/memory_usage.h>
+
+#include <libaegisub/cache_budget.h>
+
+#include <main.h>
+
+namespace {
+// Other tests and static objects may have registered things of their own,
+// so only the names used here are looked at
+size_t usage_of(std::vector<agi::memory::Usage> const& usage, std::string const& name) {
+	for (auto const& u : usage) {
+		if (u.name == name) return u.size;
+	}
+	return 0;
+}
+}
+
+TEST(lagi_memory_usage, sums_by_name) {
+	auto a = agi::memory::Register("test/a", [] { return size_t(100); });
+	auto b = agi::memory::Register("test/a", [] { return size_t(50); });
+	auto c = agi::memory::Register("test/c", [] { return size_t(10); });
+
+	auto usage = agi::memory::GetUsage();
+	EXPECT_EQ(150u, usage_of(usage, "test/a"));
+	EXPECT_EQ(10u, usage_of(usage, "test/c"));
+}
+
+TEST(lagi_memory_usage, sorted_largest_first) {
+	auto a = agi::memory::Register("test/small", [] { return size_t(1); });
+	auto b = agi::memory::Register("test/large", [] { return size_t(1) << 40; });
+
+	auto usage = agi::memory::GetUsage();
+	ASSERT_FALSE(usage.empty());
+	EXPECT_EQ("test/large", usage[0].name);
+	for (size_t i = 1; i < usage.size(); ++i)
+		EXPECT_GE(usage[i - 1].size, usage[i].size);
+}
+
+TEST(lagi_memory_usage, reads_current_size) {
+	size_t size = 10;
+	auto reg = agi::memory::Register("test/current", [&] { return size; });
+	EXPECT_EQ(10u, usage_of(agi::memory::GetUsage(), "test/current"));
+	size = 20;
+	EXPECT_EQ(20u, usage_of(agi::memory::GetUsage(), "test/current"));
+}
+
+TEST(lagi_memory_usage, unregister) {
+	auto reg = agi::memory::Register("test/unregister", [] { return size_t(10); });
+	reg.Unregister();
+	EXPECT_EQ(0u, usage_of(agi::memory::GetUsage(), "test/unregister"));
+
+	{
+		auto scoped = agi::memory::Register("test/unregister", [] { return size_t(10); });
+		auto moved = std::move(scoped);
+		EXPECT_EQ(10u, usage_of(agi::memory::GetUsage(), "test/unregister"));
+	}
+	EXPECT_EQ(0u, usage_of(agi::memory::GetUsage(), "test/unregister"));
+}
+
+TEST(lagi_memory_usage, includes_global_cache_budget) {
+	auto reg = agi::CacheBudget::Global().Register(agi::CacheBudget::Cache{
+		"test/budget",
+		[] { return size_t(30); },
+		[] { return agi::CacheBudget::NotEvictable; },
+		[] { }
+	});
+	EXPECT_EQ(30u, usage_of(agi::memory::GetUsage(), "test/budget"));
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/motion_tracker.h>
+
+#include <main.h>
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace agi::motion;
+
+namespace {
+const int width = 320;
+const int height = 240;
+
+/// Smooth random texture, sampled with bilinear filtering so that it can be
+/// moved by fractions of a pixel
+struct Texture {
+	static const int cell = 6;
+	static const int cells = 128;
+	std::vector<double> values;
+
+	Texture() : values(cells * cells) {
+		srand(1);
+		for (auto& v : values)
+			v = rand() % 256;
+	}
+
+	double At(double x, double y) const {
+		x = x / cell + cells / 2;
+		y = y / cell + cells / 2;
+		int ix = std::max(0, std::min(cells - 2, int(std::floor(x))));
+		int iy = std::max(0, std::min(cells - 2, int(std::floor(y))));
+		double fx = x - ix, fy = y - iy;
+		auto v = [&](int dx, int dy) { return values[(iy + dy) * cells + ix + dx]; };
+		return (v(0, 0) * (1 - fx) + v(1, 0) * fx) * (1 - fy) + (v(0, 1) * (1 - fx) + v(1, 1) * fx) * fy;
+	}
+};
+
+/// Draw the texture moved so that its origin is at (x, y), rotated clockwise
+/// by angle degrees and scaled by scale
+Pyramid Frame(Texture const& tex, double x, double y, double angle, double scale) {
+	std::vector<uint8_t> pixels(width * height);
+	double rad = angle * 3.14159265358979323846 / 180;
+	double c = std::cos(rad) / scale, s = std::sin(rad) / scale;
+	for (int py = 0; py < height; ++py) {
+		for (int px = 0; px < width; ++px) {
+			double dx = px - x, dy = py - y;
+			pixels[py * width + px] = uint8_t(tex.At(c * dx + s * dy, -s * dx + c * dy));
+		}
+	}
+	return Pyramid(pixels.data(), width, height, width);
+}
+}
+
+TEST(lagi_motion_tracker, block_sum_abs_diff) {
+	std::vector<uint8_t> a(40 * 10), b(50 * 10);
+	for (size_t i = 0; i < a.size(); ++i) a[i] = uint8_t(i * 7);
+	for (size_t i = 0; i < b.size(); ++i) b[i] = uint8_t(i * 13 + 5);
+
+	uint64_t expected = 0;
+	for (int y = 0; y < 10; ++y) {
+		for (int x = 0; x < 37; ++x)
+			expected += std::abs(int(a[y * 40 + x]) - int(b[y * 50 + x]));
+	}
+	EXPECT_EQ(expected, BlockSumAbsDiff(a.data(), 40, b.data(), 50, 37, 10));
+	EXPECT_EQ(0u, BlockSumAbsDiff(a.data(), 40, a.data(), 40, 37, 10));
+}
+
+TEST(lagi_motion_tracker, pyramid) {
+	std::vector<uint8_t> pixels(66 * 64);
+	for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = i % 66 < 64 ? 100 : 0;
+
+	Pyramid p(pixels.data(), 64, 64, 66, 10);
+	ASSERT_EQ(3u, p.size());
+	EXPECT_EQ(64, p.Width(0));
+	EXPECT_EQ(32, p.Width(1));
+	EXPECT_EQ(16, p.Height(2));
+	for (size_t level = 0; level < p.size(); ++level) {
+		for (int i = 0; i < p.Width(level) * p.Height(level); ++i)
+			ASSERT_EQ(100, p.Data(level)[i]);
+	}
+}
+
+TEST(lagi_motion_tracker, still) {
+	Texture tex;
+	Tracker tracker(Frame(tex, 160, 120, 0, 1), 120, 90, 200, 150);
+	for (int i = 0; i < 3; ++i)
+		ASSERT_TRUE(tracker.Track(Frame(tex, 160, 120, 0, 1)));
+	EXPECT_NEAR(160, tracker.Current().x, 0.01);
+	EXPECT_NEAR(120, tracker.Current().y, 0.01);
+	EXPECT_NEAR(0, tracker.Current().angle, 0.01);
+	EXPECT_NEAR(1, tracker.Current().scale, 0.001);
+}
+
+TEST(lagi_motion_tracker, translation) {
+	Texture tex;
+	Tracker tracker(Frame(tex, 100, 100, 0, 1), 60, 70, 140, 130);
+	for (int i = 1; i <= 10; ++i) {
+		ASSERT_TRUE(tracker.Track(Frame(tex, 100 + i * 6.5, 100 - i * 2.25, 0, 1)));
+		EXPECT_NEAR(100 + i * 6.5, tracker.Current().x, 0.5);
+		EXPECT_NEAR(100 - i * 2.25, tracker.Current().y, 0.5);
+	}
+	EXPECT_NEAR(0, tracker.Current().angle, 1);
+	EXPECT_NEAR(1, tracker.Current().scale, 0.02);
+
+	double x, y;
+	tracker.Current().Apply(-40, 0, x, y);
+	EXPECT_NEAR(125, x, 1);
+	EXPECT_NEAR(77.5, y, 1);
+}
+
+TEST(lagi_motion_tracker, rotation_and_scale) {
+	Texture tex;
+	Tracker tracker(Frame(tex, 160, 120, 0, 1), 110, 80, 210, 160);
+	for (int i = 1; i <= 8; ++i)
+		ASSERT_TRUE(tracker.Track(Frame(tex, 160 + i, 120, i * 1.5, 1 + i * 0.01)));
+	EXPECT_NEAR(168, tracker.Current().x, 1);
+	EXPECT_NEAR(120, tracker.Current().y, 1);
+	EXPECT_NEAR(12, tracker.Current().angle, 1.5);
+	EXPECT_NEAR(1.08, tracker.Current().scale, 0.03);
+}
+
+TEST(lagi_motion_tracker, lost) {
+	Texture tex;
+	Tracker tracker(Frame(tex, 160, 120, 0, 1), 120, 90, 200, 150);
+	ASSERT_TRUE(tracker.Track(Frame(tex, 163, 120, 0, 1)));
+
+	std::vector<uint8_t> flat(width * height, 255);
+	EXPECT_FALSE(tracker.Track(Pyramid(flat.data(), width, height, width)));
+	EXPECT_NEAR(163, tracker.Current().x, 0.5);
+	EXPECT_NEAR(120, tracker.Current().y, 0.5);
+}
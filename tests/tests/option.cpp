@@ -12,6 +12,8 @@
 // ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
 // OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
+#include <libaegisub/cajun/elements.h>
+#include <libaegisub/cajun/reader.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/option.h>
 #include <libaegisub/option_value.h>
@@ -220,3 +222,68 @@ TEST_F(lagi_option, color_vs_string) {
 	CHECK_TYPE("&H000000&", Color);
 	CHECK_TYPE("&H00000000", Color);
 }
+
+TEST_F(lagi_option, flattened_default) {
+	// {"a" : {"b" : "value", "c" : 5}, "d" : [{"int" : 1}]} as flattened by
+	// tools/respack.lua
+	static const char flat[] =
+		"\0agi-flat\1"
+		"\0\2" "\1\0\0\0a" "\1\0\0\0b" "s\5\0\0\0value"
+		"\1\1" "\1\0\0\0c" "i\1\0\0\0" "5"
+		"\0\1" "\1\0\0\0d" "a\1\0\0\0" "o\1\0\0\0" "\3\0\0\0int" "i\1\0\0\0" "1";
+
+	agi::Options opt("", std::make_pair(flat, sizeof(flat) - 1), agi::Options::FLUSH_SKIP);
+	EXPECT_EQ("value", opt.Get("a/b")->GetString());
+	EXPECT_EQ(5, opt.Get("a/c")->GetInt());
+	ASSERT_EQ(1u, opt.Get("d")->GetListInt().size());
+	EXPECT_EQ(1, opt.Get("d")->GetListInt()[0]);
+}
+
+TEST_F(lagi_option, flush_writes_only_changed_options) {
+	agi::fs::Remove("data/options/tmp");
+
+	{
+		agi::Options opt("data/options/tmp", all_types);
+		opt.Get("Integer")->SetInt(1);
+	}
+
+	std::ifstream file("data/options/tmp");
+	json::UnknownElement root;
+	json::Reader::Read(root, file);
+	json::Object const& obj = root;
+	ASSERT_EQ(1u, obj.size());
+	EXPECT_EQ(1, static_cast<int64_t>(static_cast<json::Integer const&>(obj.begin()->second)));
+}
+
+TEST_F(lagi_option, flush_roundtrips_nested_and_list_options) {
+	agi::fs::Remove("data/options/tmp");
+
+	{
+		agi::Options opt("data/options/tmp", all_types);
+		opt.Get("String")->SetString("a \"quoted\" string");
+		opt.Get("Array/Integer")->SetListInt({1, 2, 3});
+		opt.Get("Array/Color")->SetListColor({agi::Color(1, 2, 3)});
+		opt.Get("Array/Boolean")->SetListBool({true});
+	}
+
+	agi::Options opt("data/options/tmp", all_types, agi::Options::FLUSH_SKIP);
+	opt.ConfigUser();
+	EXPECT_EQ("a \"quoted\" string", opt.Get("String")->GetString());
+	EXPECT_EQ((std::vector<int64_t>{1, 2, 3}), opt.Get("Array/Integer")->GetListInt());
+	EXPECT_EQ(std::vector<agi::Color>{agi::Color(1, 2, 3)}, opt.Get("Array/Color")->GetListColor());
+	EXPECT_EQ(std::vector<bool>{true}, opt.Get("Array/Boolean")->GetListBool());
+	EXPECT_TRUE(opt.Get("Array/Double")->IsDefault());
+	EXPECT_TRUE(opt.Get("Integer")->IsDefault());
+}
+
+TEST_F(lagi_option, last_duplicate_key_wins) {
+	agi::Options opt("", "{ \"a\" : 1, \"a\" : 2 }", agi::Options::FLUSH_SKIP);
+	EXPECT_EQ(2, opt.Get("a")->GetInt());
+}
+
+TEST_F(lagi_option, invalid_array_members_are_errors) {
+	EXPECT_THROW(agi::Options("", "{ \"a\" : [1] }", agi::Options::FLUSH_SKIP), agi::Exception);
+	EXPECT_THROW(agi::Options("", "{ \"a\" : [{\"int\" : 1, \"bool\" : true}] }", agi::Options::FLUSH_SKIP), agi::Exception);
+	EXPECT_THROW(agi::Options("", "{ \"a\" : [{\"int\" : 1}, {\"bool\" : true}] }", agi::Options::FLUSH_SKIP), agi::Exception);
+	EXPECT_THROW(agi::Options("", "{ \"a\" : [{\"int\" : \"1\"}] }", agi::Options::FLUSH_SKIP), agi::Exception);
+}
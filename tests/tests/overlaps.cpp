@@ -0,0 +1,89 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ass/overlaps.h>
+
+#include <main.h>
+
+using namespace agi::ass;
+
+TEST(lagi_overlaps, empty) {
+	EXPECT_TRUE(SplitOverlaps({}, {}).empty());
+}
+
+TEST(lagi_overlaps, no_overlaps) {
+	auto pieces = SplitOverlaps({0, 10, 30}, {10, 20, 40});
+	ASSERT_EQ(3u, pieces.size());
+	for (size_t i = 0; i < 3; ++i)
+		EXPECT_EQ(std::vector<size_t>{i}, pieces[i].lines);
+	EXPECT_EQ(10, pieces[1].start);
+	EXPECT_EQ(20, pieces[1].end);
+	EXPECT_EQ(30, pieces[2].start);
+}
+
+TEST(lagi_overlaps, partial_overlap) {
+	auto pieces = SplitOverlaps({0, 5}, {10, 15});
+	ASSERT_EQ(3u, pieces.size());
+	EXPECT_EQ(0, pieces[0].start);
+	EXPECT_EQ(5, pieces[0].end);
+	EXPECT_EQ(std::vector<size_t>{0}, pieces[0].lines);
+	EXPECT_EQ(5, pieces[1].start);
+	EXPECT_EQ(10, pieces[1].end);
+	EXPECT_EQ((std::vector<size_t>{0, 1}), pieces[1].lines);
+	EXPECT_EQ(10, pieces[2].start);
+	EXPECT_EQ(15, pieces[2].end);
+	EXPECT_EQ(std::vector<size_t>{1}, pieces[2].lines);
+}
+
+TEST(lagi_overlaps, contained) {
+	auto pieces = SplitOverlaps({0, 5, 6}, {20, 10, 8});
+	ASSERT_EQ(5u, pieces.size());
+	EXPECT_EQ((std::vector<size_t>{0}), pieces[0].lines);
+	EXPECT_EQ((std::vector<size_t>{0, 1}), pieces[1].lines);
+	EXPECT_EQ((std::vector<size_t>{0, 1, 2}), pieces[2].lines);
+	EXPECT_EQ(6, pieces[2].start);
+	EXPECT_EQ(8, pieces[2].end);
+	EXPECT_EQ((std::vector<size_t>{0, 1}), pieces[3].lines);
+	EXPECT_EQ((std::vector<size_t>{0}), pieces[4].lines);
+	EXPECT_EQ(10, pieces[4].start);
+	EXPECT_EQ(20, pieces[4].end);
+}
+
+TEST(lagi_overlaps, identical_times) {
+	auto pieces = SplitOverlaps({0, 0}, {10, 10});
+	ASSERT_EQ(1u, pieces.size());
+	EXPECT_EQ((std::vector<size_t>{0, 1}), pieces[0].lines);
+}
+
+TEST(lagi_overlaps, unsorted_input) {
+	auto pieces = SplitOverlaps({10, 0}, {20, 15});
+	ASSERT_EQ(3u, pieces.size());
+	EXPECT_EQ(std::vector<size_t>{1}, pieces[0].lines);
+	EXPECT_EQ((std::vector<size_t>{0, 1}), pieces[1].lines);
+	EXPECT_EQ(std::vector<size_t>{0}, pieces[2].lines);
+}
+
+TEST(lagi_overlaps, zero_duration) {
+	auto pieces = SplitOverlaps({0, 5, 20}, {10, 5, 20});
+	ASSERT_EQ(3u, pieces.size());
+	EXPECT_EQ(std::vector<size_t>{0}, pieces[0].lines);
+	EXPECT_EQ(0, pieces[0].start);
+	EXPECT_EQ(10, pieces[0].end);
+	EXPECT_EQ(std::vector<size_t>{1}, pieces[1].lines);
+	EXPECT_EQ(5, pieces[1].start);
+	EXPECT_EQ(5, pieces[1].end);
+	EXPECT_EQ(std::vector<size_t>{2}, pieces[2].lines);
+}
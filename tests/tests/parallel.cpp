@@ -0,0 +1,120 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/parallel.h>
+
+#include <main.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace agi;
+
+TEST(lagi_parallel, for_covers_range_once) {
+	std::vector<std::atomic<int>> hits(10007);
+	for (auto& hit : hits) hit = 0;
+
+	parallel_for(0, hits.size(), 13, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			++hits[i];
+	});
+
+	for (size_t i = 0; i < hits.size(); ++i)
+		ASSERT_EQ(1, hits[i]) << i;
+}
+
+TEST(lagi_parallel, for_offset_range) {
+	std::atomic<size_t> sum{0};
+	parallel_for(100, 200, 7, [&](size_t begin, size_t end) {
+		EXPECT_LE(100u, begin);
+		EXPECT_GE(200u, end);
+		for (size_t i = begin; i < end; ++i)
+			sum += i;
+	});
+	EXPECT_EQ(14950u, sum);
+}
+
+TEST(lagi_parallel, for_empty_range) {
+	bool called = false;
+	parallel_for(5, 5, 1, [&](size_t, size_t) { called = true; });
+	EXPECT_FALSE(called);
+}
+
+TEST(lagi_parallel, for_rethrows) {
+	EXPECT_THROW(parallel_for(0, 1000, 1, [&](size_t begin, size_t) {
+		if (begin == 500) throw std::runtime_error("error");
+	}), std::runtime_error);
+}
+
+TEST(lagi_parallel, for_slots_are_exclusive) {
+	std::vector<std::atomic<int>> in_use(parallel_concurrency());
+	for (auto& slot : in_use) slot = 0;
+	std::atomic<bool> overlapped{false};
+
+	parallel_for_slots(0, 5000, 1, [&](size_t slot, size_t, size_t) {
+		ASSERT_LT(slot, in_use.size());
+		if (++in_use[slot] != 1) overlapped = true;
+		--in_use[slot];
+	});
+	EXPECT_FALSE(overlapped);
+}
+
+TEST(lagi_parallel, reduce) {
+	size_t sum = parallel_reduce(size_t(0), size_t(100000), 100, size_t(0),
+		[](size_t begin, size_t end) {
+			size_t sum = 0;
+			for (size_t i = begin; i < end; ++i) sum += i;
+			return sum;
+		},
+		[](size_t a, size_t b) { return a + b; });
+	EXPECT_EQ(4999950000u, sum);
+}
+
+TEST(lagi_parallel, task_graph_order) {
+	TaskGraph graph;
+	std::atomic<int> a{0}, b{0}, c{0}, d{0};
+
+	auto ta = graph.Add([&] { a = 1; });
+	auto tb = graph.Add([&] { b = a + 1; }, {ta});
+	auto tc = graph.Add([&] { c = a + 10; }, {ta});
+	graph.Add([&] { d = b + c; }, {tb, tc});
+	graph.Run();
+
+	EXPECT_EQ(1, a);
+	EXPECT_EQ(2, b);
+	EXPECT_EQ(11, c);
+	EXPECT_EQ(13, d);
+}
+
+TEST(lagi_parallel, task_graph_rethrows) {
+	TaskGraph graph;
+	bool ran_dependent = false;
+	auto t = graph.Add([] { throw std::runtime_error("error"); });
+	graph.Add([&] { ran_dependent = true; }, {t});
+	EXPECT_THROW(graph.Run(), std::runtime_error);
+	EXPECT_FALSE(ran_dependent);
+}
+
+TEST(lagi_parallel, nested) {
+	std::atomic<size_t> count{0};
+	parallel_for(0, 16, 1, [&](size_t, size_t) {
+		parallel_for(0, 100, 10, [&](size_t begin, size_t end) {
+			count += end - begin;
+		});
+	});
+	EXPECT_EQ(1600u, count);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/scene_change.h>
+
+#include <main.h>
+
+#include <cstdlib>
+
+using namespace agi::scene_change;
+
+TEST(lagi_scene_change, sum_abs_diff) {
+	// Long enough to cover both the vectorized part and the tail
+	std::vector<uint8_t> a(1000), b(1000);
+	uint64_t expected = 0;
+	for (size_t i = 0; i < a.size(); ++i) {
+		a[i] = static_cast<uint8_t>(i * 7);
+		b[i] = static_cast<uint8_t>(i * 13 + 5);
+		expected += std::abs(int(a[i]) - int(b[i]));
+	}
+	EXPECT_EQ(expected, SumAbsDiff(a.data(), b.data(), a.size()));
+	EXPECT_EQ(expected, SumAbsDiff(b.data(), a.data(), a.size()));
+	EXPECT_EQ(0u, SumAbsDiff(a.data(), a.data(), a.size()));
+	EXPECT_EQ(0u, SumAbsDiff(a.data(), b.data(), 0));
+}
+
+TEST(lagi_scene_change, score) {
+	std::vector<uint8_t> black(256, 0), white(256, 255), ramp(256), shifted(256);
+	for (size_t i = 0; i < ramp.size(); ++i) {
+		ramp[i] = static_cast<uint8_t>(i);
+		shifted[i] = static_cast<uint8_t>((i + 128) % 256);
+	}
+
+	EXPECT_EQ(0, Score(ramp.data(), ramp.data(), ramp.size()));
+	EXPECT_DOUBLE_EQ(1, Score(black.data(), white.data(), black.size()));
+	// Same histogram, so only the pixel difference counts
+	double moved = Score(ramp.data(), shifted.data(), ramp.size());
+	EXPECT_GT(moved, 0);
+	EXPECT_LT(moved, 0.5);
+}
+
+TEST(lagi_scene_change, choose_empty) {
+	EXPECT_TRUE(Choose({}, 1, 0.1).empty());
+	EXPECT_EQ(std::vector<int>{0}, Choose({0}, 1, 0.1));
+}
+
+TEST(lagi_scene_change, choose_cuts) {
+	std::vector<double> scores(100, 0.01);
+	scores[20] = 0.5;
+	scores[60] = 0.5;
+	scores[80] = 0.05; // below the threshold
+	EXPECT_EQ((std::vector<int>{0, 20, 60}), Choose(scores, 1, 0.1));
+}
+
+TEST(lagi_scene_change, choose_min_interval) {
+	std::vector<double> scores(100, 0.01);
+	scores[20] = 0.5;
+	scores[25] = 0.5;
+	scores[40] = 0.5;
+	EXPECT_EQ((std::vector<int>{0, 20, 40}), Choose(scores, 10, 0.1));
+	EXPECT_EQ((std::vector<int>{0, 25}), Choose(scores, 21, 0.1));
+}
+
+TEST(lagi_scene_change, choose_ignores_sustained_motion) {
+	std::vector<double> scores(100, 0.01);
+	for (size_t i = 30; i < 50; ++i)
+		scores[i] = 0.3;
+	// Once the minimum interval has passed the rest of the fast section
+	// doesn't stand out from what came before
+	EXPECT_EQ((std::vector<int>{0, 30}), Choose(scores, 10, 0.1));
+}
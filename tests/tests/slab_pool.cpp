@@ -0,0 +1,92 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/slab_pool.h>
+
+#include <main.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+TEST(lagi_slab_pool, distinct_aligned_blocks) {
+	agi::SlabPool pool(24, 1024);
+	std::set<char *> blocks;
+	for (int i = 0; i < 100; ++i) {
+		auto p = static_cast<char *>(pool.Allocate());
+		EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t));
+		std::fill(p, p + 24, (char)i);
+		blocks.insert(p);
+	}
+	EXPECT_EQ(100u, blocks.size());
+
+	// Nothing overlaps, so every block still holds what was written to it
+	for (auto p : blocks)
+		EXPECT_TRUE(std::all_of(p, p + 24, [=](char c) { return c == p[0]; }));
+
+	for (auto p : blocks)
+		agi::SlabPool::Free(p);
+}
+
+TEST(lagi_slab_pool, empty_slabs_are_released) {
+	agi::SlabPool pool(100, 1024);
+	std::vector<void *> blocks;
+	for (int i = 0; i < 50; ++i)
+		blocks.push_back(pool.Allocate());
+	size_t slabs = pool.SlabCount();
+	EXPECT_LT(1u, slabs);
+
+	// Freeing every other block doesn't empty any slab
+	for (size_t i = 0; i < blocks.size(); i += 2)
+		agi::SlabPool::Free(blocks[i]);
+	EXPECT_EQ(slabs, pool.SlabCount());
+
+	for (size_t i = 1; i < blocks.size(); i += 2)
+		agi::SlabPool::Free(blocks[i]);
+	EXPECT_EQ(0u, pool.SlabCount());
+}
+
+TEST(lagi_slab_pool, freed_blocks_are_reused) {
+	agi::SlabPool pool(16);
+	void *a = pool.Allocate();
+	void *b = pool.Allocate();
+	agi::SlabPool::Free(a);
+	EXPECT_EQ(a, pool.Allocate());
+	agi::SlabPool::Free(a);
+	agi::SlabPool::Free(b);
+
+	// The empty slab is kept as a spare rather than freed
+	EXPECT_EQ(0u, pool.SlabCount());
+	void *c = pool.Allocate();
+	EXPECT_TRUE(c == a || c == b);
+	agi::SlabPool::Free(c);
+}
+
+TEST(lagi_slab_pool, free_null) {
+	agi::SlabPool::Free(nullptr);
+}
+
+TEST(lagi_slab_pool, oversized_objects) {
+	// Objects bigger than the requested slab size get a slab each
+	agi::SlabPool pool(4096, 1024);
+	void *a = pool.Allocate();
+	void *b = pool.Allocate();
+	EXPECT_EQ(2u, pool.SlabCount());
+	agi::SlabPool::Free(a);
+	agi::SlabPool::Free(b);
+	EXPECT_EQ(0u, pool.SlabCount());
+}
@@ -18,6 +18,8 @@
 #include <main.h>
 #include <util.h>
 
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 
 class lagi_thes : public libagi {
@@ -146,3 +148,55 @@ TEST_F(lagi_thes, unindexed_word) {
 	ASSERT_NO_THROW(entries = thes.Lookup("Unindexed Word"));
 	EXPECT_EQ(0, entries.size());
 }
+
+TEST_F(lagi_thes, cached_index) {
+	std::string cache_path = "data/thes.idx.cache";
+	std::remove(cache_path.c_str());
+
+	std::vector<agi::Thesaurus::Entry> entries;
+	{
+		agi::Thesaurus thes(dat_path, idx_path, cache_path);
+		ASSERT_NO_THROW(entries = thes.Lookup("Word 1"));
+		EXPECT_EQ(1, entries.size());
+	}
+	EXPECT_TRUE(agi::fs::FileExists(cache_path));
+
+	agi::Thesaurus thes(dat_path, idx_path, cache_path);
+	ASSERT_NO_THROW(entries = thes.Lookup("Word 2"));
+	ASSERT_EQ(2, entries.size());
+	EXPECT_STREQ("(adj) Word 2", entries[0].first.c_str());
+	ASSERT_NO_THROW(entries = thes.Lookup("Nonexistent word"));
+	EXPECT_EQ(0, entries.size());
+	ASSERT_NO_THROW(entries = thes.Lookup("Not a number"));
+	EXPECT_EQ(0, entries.size());
+}
+
+TEST_F(lagi_thes, stale_cached_index) {
+	std::string cache_path = "data/thes.idx.cache";
+	std::remove(cache_path.c_str());
+	{ agi::Thesaurus thes(dat_path, idx_path, cache_path); }
+
+	{
+		std::ofstream idx(idx_path.c_str(), std::ios_base::binary | std::ios_base::app);
+		idx << "Word 4|" << strlen("UTF-8\n") << '\n';
+	}
+
+	agi::Thesaurus thes(dat_path, idx_path, cache_path);
+	std::vector<agi::Thesaurus::Entry> entries;
+	ASSERT_NO_THROW(entries = thes.Lookup("Word 4"));
+	ASSERT_EQ(1, entries.size());
+	EXPECT_STREQ("(noun) Word 1", entries[0].first.c_str());
+}
+
+TEST_F(lagi_thes, corrupt_cached_index) {
+	std::string cache_path = "data/thes.idx.cache";
+	{
+		std::ofstream cache(cache_path.c_str(), std::ios_base::binary);
+		cache << "not an index";
+	}
+
+	agi::Thesaurus thes(dat_path, idx_path, cache_path);
+	std::vector<agi::Thesaurus::Entry> entries;
+	ASSERT_NO_THROW(entries = thes.Lookup("Word 3"));
+	EXPECT_EQ(1, entries.size());
+}
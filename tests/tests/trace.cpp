@@ -0,0 +1,108 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/trace.h>
+
+#include <libaegisub/cajun/elements.h>
+#include <libaegisub/cajun/reader.h>
+
+#include <main.h>
+
+#include <sstream>
+#include <thread>
+
+class lagi_trace : public libagi {
+protected:
+	void SetUp() override {
+		agi::trace::Clear();
+		agi::trace::Enable(true);
+	}
+
+	void TearDown() override {
+		agi::trace::Enable(false);
+		agi::trace::Clear();
+	}
+};
+
+TEST_F(lagi_trace, nothing_is_recorded_while_disabled) {
+	agi::trace::Enable(false);
+	{
+		AGI_TRACE_SCOPE("span");
+	}
+	agi::trace::Count("counter");
+	agi::trace::Sample("histogram", 5);
+	EXPECT_TRUE(agi::trace::Metrics().empty());
+}
+
+TEST_F(lagi_trace, scopes_record_spans) {
+	for (int i = 0; i < 3; ++i) {
+		AGI_TRACE_SCOPE("span");
+	}
+
+	auto metric = agi::trace::Get("span");
+	EXPECT_EQ("span", metric.name);
+	EXPECT_EQ(3, metric.count);
+	EXPECT_LE(metric.min, metric.max);
+	EXPECT_LE(0, metric.min);
+}
+
+TEST_F(lagi_trace, counters_are_summed_across_threads) {
+	agi::trace::Count("counter", 2);
+	std::thread([] { agi::trace::Count("counter", 3); }).join();
+	EXPECT_EQ(5, agi::trace::Get("counter").total);
+}
+
+TEST_F(lagi_trace, histogram) {
+	for (int64_t value : {1, 2, 3, 100, 1000})
+		agi::trace::Sample("histogram", value);
+
+	auto metric = agi::trace::Get("histogram");
+	EXPECT_EQ(5, metric.count);
+	EXPECT_EQ(1106, metric.total);
+	EXPECT_EQ(1, metric.min);
+	EXPECT_EQ(1000, metric.max);
+	EXPECT_EQ(1u, metric.buckets[1]);
+	EXPECT_EQ(2u, metric.buckets[2]);
+	EXPECT_EQ(1u, metric.buckets[7]);
+	EXPECT_EQ(1u, metric.buckets[10]);
+	EXPECT_EQ(3, metric.Percentile(0.5));
+	EXPECT_EQ(1000, metric.Percentile(1.0));
+}
+
+TEST_F(lagi_trace, chrome_trace) {
+	{
+		AGI_TRACE_SCOPE("span");
+	}
+	agi::trace::Count("counter", 2);
+	agi::trace::Count("counter", 2);
+
+	std::stringstream stream;
+	agi::trace::WriteChromeTrace(stream);
+
+	json::UnknownElement root;
+	ASSERT_NO_THROW(json::Reader::Read(root, stream));
+	json::Array const& events = static_cast<json::Object const&>(root).at("traceEvents");
+	ASSERT_EQ(3u, events.size());
+
+	json::Object const& span = events[0];
+	EXPECT_EQ("span", static_cast<std::string const&>(span.at("name")));
+	EXPECT_EQ("X", static_cast<std::string const&>(span.at("ph")));
+
+	json::Object const& counter = events[2];
+	EXPECT_EQ("C", static_cast<std::string const&>(counter.at("ph")));
+	json::Object const& args = counter.at("args");
+	EXPECT_EQ(4, static_cast<int64_t>(static_cast<json::Integer const&>(args.at("value"))));
+}
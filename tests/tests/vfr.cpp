@@ -17,6 +17,7 @@
 #include <libaegisub/fs.h>
 #include <libaegisub/vfr.h>
 
+#include <algorithm>
 #include <climits>
 #include <fstream>
 #include <iterator>
@@ -444,6 +445,57 @@ TEST(lagi_vfr, duplicate_timestamps) {
 	EXPECT_EQ(3, fps.FrameAtTime(200, EXACT));
 }
 
+TEST(lagi_vfr, batch_conversion) {
+	Framerate fps;
+	ASSERT_NO_THROW(fps = Framerate({ 0, 1000, 1500, 2000, 2001, 2002, 2003 }));
+
+	std::vector<int> times{-10, 0, 999, 1000, 1750, 2002, 2003, 5000};
+	std::vector<int> frames(times.size());
+	for (auto type : {EXACT, START, END}) {
+		fps.FramesAtTimes(times.data(), frames.data(), times.size(), type);
+		for (size_t i = 0; i < times.size(); ++i)
+			EXPECT_EQ(fps.FrameAtTime(times[i], type), frames[i]);
+	}
+
+	frames = {-2, 0, 1, 3, 6, 7, 20};
+	times.resize(frames.size());
+	for (auto type : {EXACT, START, END}) {
+		fps.TimesAtFrames(frames.data(), times.data(), frames.size(), type);
+		for (size_t i = 0; i < frames.size(); ++i)
+			EXPECT_EQ(fps.TimeAtFrame(frames[i], type), times[i]);
+	}
+}
+
+TEST(lagi_vfr, mixed_runs) {
+	// 23.976 and 59.94 fps stretches with an irregular one and some repeated
+	// times between them
+	std::vector<int> times;
+	for (int i = 0; i < 1000; ++i)
+		times.push_back(int(i * 1001 / 24.));
+	for (int i = 1; i < 10; ++i)
+		times.push_back(times.back() + i * 7 % 13 + 1);
+	times.push_back(times.back());
+	times.push_back(times.back());
+	int start = times.back() + 10;
+	for (int i = 0; i < 500; ++i)
+		times.push_back(start + int(i * 1001 / 60. + .5));
+
+	Framerate fps;
+	ASSERT_NO_THROW(fps = Framerate(times));
+	ASSERT_TRUE(fps.IsVFR());
+
+	for (int i = 0; i < (int)times.size(); ++i)
+		ASSERT_EQ(times[i], fps.TimeAtFrame(i));
+	for (int ms = 0; ms <= times.back(); ++ms) {
+		int frame = int(std::upper_bound(times.begin(), times.end(), ms) - times.begin()) - 1;
+		ASSERT_EQ(frame, fps.FrameAtTime(ms)) << ms;
+	}
+
+	// Copies share the same timecodes
+	Framerate copy(fps);
+	EXPECT_EQ(times.back(), copy.TimeAtFrame((int)times.size() - 1));
+}
+
 #define EXPECT_SMPTE(eh, em, es, ef) \
 	EXPECT_EQ(eh, h); \
 	EXPECT_EQ(em, m); \
@@ -0,0 +1,80 @@
+// Copyright (c) 2026, agent <agent@local>
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+//
+// Aegisub Project http://www.aegisub.org/
+
+#include <libaegisub/ycbcr_conv.h>
+
+#include <main.h>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace agi;
+
+namespace {
+std::vector<Color> test_colors() {
+	// Odd count so that both the vectorized part and the tail are used
+	std::vector<Color> colors;
+	for (int r = 0; r < 256; r += 15) {
+		for (int g = 0; g < 256; g += 17) {
+			for (int b = 0; b < 256; b += 51)
+				colors.emplace_back(r, g, b, (r + g + b) & 0xFF);
+		}
+	}
+	colors.emplace_back(255, 255, 255, 7);
+	return colors;
+}
+}
+
+TEST(lagi_ycbcr, same_matrix_is_identity) {
+	ycbcr_converter conv(ycbcr_matrix::bt601, ycbcr_range::tv, ycbcr_matrix::bt601, ycbcr_range::tv);
+	auto colors = test_colors();
+	auto converted = colors;
+	conv.rgb_to_rgb(converted.data(), converted.size());
+	EXPECT_EQ(colors, converted);
+}
+
+TEST(lagi_ycbcr, batch_matches_double) {
+	ycbcr_converter conv(ycbcr_matrix::bt601, ycbcr_range::tv, ycbcr_matrix::bt709, ycbcr_range::pc);
+	auto colors = test_colors();
+	auto converted = colors;
+	conv.rgb_to_rgb(converted.data(), converted.size());
+
+	for (size_t i = 0; i < colors.size(); ++i) {
+		auto expected = conv.rgb_to_rgb(std::array<uint8_t, 3>{{colors[i].r, colors[i].g, colors[i].b}});
+		EXPECT_GE(1, std::abs(expected[0] - converted[i].r));
+		EXPECT_GE(1, std::abs(expected[1] - converted[i].g));
+		EXPECT_GE(1, std::abs(expected[2] - converted[i].b));
+		EXPECT_EQ(colors[i].a, converted[i].a);
+		EXPECT_EQ(converted[i], conv.rgb_to_rgb(colors[i]));
+	}
+}
+
+TEST(lagi_ycbcr, bgra_matches_rgba) {
+	ycbcr_converter conv(ycbcr_matrix::bt709, ycbcr_range::pc, ycbcr_matrix::fcc, ycbcr_range::tv);
+	auto colors = test_colors();
+	std::vector<uint8_t> pixels;
+	for (auto const& c : colors) {
+		pixels.push_back(c.b);
+		pixels.push_back(c.g);
+		pixels.push_back(c.r);
+		pixels.push_back(c.a);
+	}
+
+	conv.rgb_to_rgb(colors.data(), colors.size());
+	conv.bgra_to_bgra(pixels.data(), colors.size());
+	for (size_t i = 0; i < colors.size(); ++i)
+		EXPECT_EQ(colors[i], Color(pixels[i * 4 + 2], pixels[i * 4 + 1], pixels[i * 4], pixels[i * 4 + 3]));
+}
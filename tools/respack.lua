@@ -39,6 +39,236 @@ local out_h = try_open(arg[3], 'w')
 
 local path = arg[1]:match'(.*/).*' or ''
 
+-- JSON files are stored pre-parsed, so that reading the default configs at
+-- startup doesn't have to tokenize them. The format is read by
+-- agi::json_util::read_flat, and is a header followed by one record for
+-- each leaf of the document:
+--
+--   u8 number of path components shared with the previous leaf
+--   u8 number of new path components, then that many strings
+--   the leaf's value
+--
+-- Strings are a u32 length followed by the bytes, and values are a tag byte
+-- followed by the value:
+--
+--   'i', 'd': integer or double, as the string from the JSON
+--   's': string
+--   't', 'f', 'n': true, false, null
+--   'a': u32 count, then that many values
+--   'o': u32 count, then that many strings and values
+--
+-- Objects are only stored whole inside arrays or when empty.
+local flat_header = '\0agi-flat\1'
+
+-- minilua, which is used to run this on Windows, has no math library
+local function div(n, d) return (n - n % d) / d end
+
+local function u32(n)
+  return string.char(n % 256, div(n, 256) % 256, div(n, 65536) % 256, div(n, 16777216) % 256)
+end
+
+local function encode_string(str) return u32(#str) .. str end
+
+local function utf8(code)
+  if code < 0x80 then return string.char(code) end
+  if code < 0x800 then
+    return string.char(0xC0 + div(code, 64), 0x80 + code % 64)
+  end
+  if code < 0x10000 then
+    return string.char(0xE0 + div(code, 4096), 0x80 + div(code, 64) % 64, 0x80 + code % 64)
+  end
+  return string.char(0xF0 + div(code, 262144), 0x80 + div(code, 4096) % 64,
+                     0x80 + div(code, 64) % 64, 0x80 + code % 64)
+end
+
+-- Parse a JSON document into tables. Objects are {kind='object', keys={...},
+-- values={...}} to keep track of empty objects and key order, arrays are
+-- {kind='array', ...}, and scalars are {kind=tag, value=string}.
+local function parse_json(text, filename)
+  local pos = 1
+
+  local function fail(message)
+    io.stdout:write(string.format('%s: %s at byte %d\n', filename, message, pos))
+    os.exit(1)
+  end
+
+  local function skip_space()
+    pos = text:find('[^ \t\r\n]', pos) or #text + 1
+  end
+
+  local escapes = {['"'] = '"', ['\\'] = '\\', ['/'] = '/', b = '\b', f = '\f', n = '\n', r = '\r', t = '\t'}
+
+  local function parse_string()
+    local parts = {}
+    pos = pos + 1
+    while true do
+      local stop = text:find('["\\]', pos)
+      if not stop then fail('Unterminated string') end
+      parts[#parts + 1] = text:sub(pos, stop - 1)
+      pos = stop + 1
+      if text:sub(stop, stop) == '"' then break end
+
+      local c = text:sub(pos, pos)
+      if c == 'u' then
+        local code = tonumber(text:sub(pos + 1, pos + 4), 16)
+        if not code then fail('Invalid unicode escape') end
+        pos = pos + 5
+        -- Surrogate pair
+        if code >= 0xD800 and code < 0xDC00 and text:sub(pos, pos + 1) == '\\u' then
+          local low = tonumber(text:sub(pos + 2, pos + 5), 16)
+          if low and low >= 0xDC00 and low < 0xE000 then
+            code = 0x10000 + (code - 0xD800) * 1024 + (low - 0xDC00)
+            pos = pos + 6
+          end
+        end
+        parts[#parts + 1] = utf8(code)
+      else
+        if not escapes[c] then fail('Invalid escape') end
+        parts[#parts + 1] = escapes[c]
+        pos = pos + 1
+      end
+    end
+    return table.concat(parts)
+  end
+
+  local parse_value
+
+  local function parse_object()
+    local object = {kind = 'object', keys = {}, values = {}}
+    pos = pos + 1
+    skip_space()
+    if text:sub(pos, pos) == '}' then
+      pos = pos + 1
+      return object
+    end
+    while true do
+      skip_space()
+      if text:sub(pos, pos) ~= '"' then fail('Expected member name') end
+      local key = parse_string()
+      skip_space()
+      if text:sub(pos, pos) ~= ':' then fail('Expected ":"') end
+      pos = pos + 1
+      object.keys[#object.keys + 1] = key
+      object.values[#object.values + 1] = parse_value()
+      skip_space()
+      local c = text:sub(pos, pos)
+      pos = pos + 1
+      if c ~= ',' and c ~= '}' then fail('Expected "," or "}"') end
+      -- Trailing commas are accepted, as they are by the cajun reader
+      skip_space()
+      if c == '}' or text:sub(pos, pos) == '}' then
+        if c == ',' then pos = pos + 1 end
+        return object
+      end
+    end
+  end
+
+  local function parse_array()
+    local array = {kind = 'array'}
+    pos = pos + 1
+    skip_space()
+    if text:sub(pos, pos) == ']' then
+      pos = pos + 1
+      return array
+    end
+    while true do
+      array[#array + 1] = parse_value()
+      skip_space()
+      local c = text:sub(pos, pos)
+      pos = pos + 1
+      if c ~= ',' and c ~= ']' then fail('Expected "," or "]"') end
+      skip_space()
+      if c == ']' or text:sub(pos, pos) == ']' then
+        if c == ',' then pos = pos + 1 end
+        return array
+      end
+    end
+  end
+
+  parse_value = function()
+    skip_space()
+    local c = text:sub(pos, pos)
+    if c == '{' then return parse_object() end
+    if c == '[' then return parse_array() end
+    if c == '"' then return {kind = 's', value = parse_string()} end
+
+    for word, tag in pairs({['true'] = 't', ['false'] = 'f', ['null'] = 'n'}) do
+      if text:sub(pos, pos + #word - 1) == word then
+        pos = pos + #word
+        return {kind = tag}
+      end
+    end
+
+    -- Same split between integers and doubles as the cajun reader
+    local number = text:match('^[0-9.eE+-]+', pos)
+    if not number then fail('Unexpected character') end
+    pos = pos + #number
+    return {kind = number:find('[.eE]') and 'd' or 'i', value = number}
+  end
+
+  local root = parse_value()
+  skip_space()
+  if pos <= #text then fail('Trailing data') end
+  return root
+end
+
+local function encode_value(value, out)
+  if value.kind == 'object' then
+    out[#out + 1] = 'o' .. u32(#value.keys)
+    for i, key in ipairs(value.keys) do
+      out[#out + 1] = encode_string(key)
+      encode_value(value.values[i], out)
+    end
+  elseif value.kind == 'array' then
+    out[#out + 1] = 'a' .. u32(#value)
+    for _, element in ipairs(value) do
+      encode_value(element, out)
+    end
+  elseif value.value then
+    out[#out + 1] = value.kind .. encode_string(value.value)
+  else
+    out[#out + 1] = value.kind
+  end
+end
+
+local function flatten(root)
+  local out = {flat_header}
+  local prev = {}
+
+  local function leaf(path, value)
+    local shared = 0
+    while shared < #path and shared < #prev and path[shared + 1] == prev[shared + 1] do
+      shared = shared + 1
+    end
+    out[#out + 1] = string.char(shared, #path - shared)
+    for i = shared + 1, #path do
+      out[#out + 1] = encode_string(path[i])
+    end
+    encode_value(value, out)
+
+    prev = {}
+    for i, key in ipairs(path) do prev[i] = key end
+  end
+
+  local function walk(path, value)
+    if value.kind ~= 'object' or (#value.keys == 0 and #path > 0) then
+      return leaf(path, value)
+    end
+    if #path == 255 then
+      io.stdout:write('JSON nested too deeply\n')
+      os.exit(1)
+    end
+    for i, key in ipairs(value.keys) do
+      path[#path + 1] = key
+      walk(path, value.values[i])
+      path[#path] = nil
+    end
+  end
+
+  walk({}, root)
+  return table.concat(out)
+end
+
 out_cpp:write('#include "libresrc.h"\n')
 
 for line in manifest:lines() do
@@ -47,19 +277,17 @@ for line in manifest:lines() do
     local id = line:gsub('^.*/', ''):gsub('%.[a-z]+$', '')
     out_cpp:write("const unsigned char " .. id .. "[] = {")
 
-    local len = 0
-    while true do
-      local bytes = file:read(65536)
-      if not bytes then break end
+    local bytes = file:read('*a')
+    if line:find('%.json$') then
+      bytes = flatten(parse_json(bytes, line))
+    end
 
-      for i = 1, #bytes do
-        if len > 0 then out_cpp:write(',') end
-        out_cpp:write(string.format('%d', bytes:byte(i)))
-        len = len + 1
-      end
+    for i = 1, #bytes do
+      if i > 1 then out_cpp:write(',') end
+      out_cpp:write(string.format('%d', bytes:byte(i)))
     end
     out_cpp:write('};\n')
-    out_h:write(string.format('extern const unsigned char %s[%d];\n', id, len))
+    out_h:write(string.format('extern const unsigned char %s[%d];\n', id, #bytes))
     file:close()
   end
 end